@@ -0,0 +1,43 @@
+#
+# zstd
+#
+option(USE_BUNDLED_ZSTD "Enable building of the bundled zstd" ${USE_BUNDLED_DEPS})
+
+if(ZSTD_INCLUDE)
+	# we already have zstd
+elseif(NOT USE_BUNDLED_ZSTD)
+	find_path(ZSTD_INCLUDE zstd.h)
+	find_library(ZSTD_LIB NAMES zstd)
+	if(ZSTD_INCLUDE AND ZSTD_LIB)
+		message(STATUS "Found zstd: include: ${ZSTD_INCLUDE}, lib: ${ZSTD_LIB}")
+	else()
+		message(FATAL_ERROR "Couldn't find system zstd")
+	endif()
+else()
+	set(ZSTD_SRC "${PROJECT_BINARY_DIR}/zstd-prefix/src/zstd")
+	set(ZSTD_INCLUDE "${ZSTD_SRC}/lib")
+	set(ZSTD_LIB "${ZSTD_SRC}/lib/libzstd.a")
+	if(NOT TARGET zstd)
+		message(STATUS "Using bundled zstd in '${ZSTD_SRC}'")
+		ExternalProject_Add(zstd
+			PREFIX "${PROJECT_BINARY_DIR}/zstd-prefix"
+			URL "https://github.com/facebook/zstd/releases/download/v1.5.5/zstd-1.5.5.tar.gz"
+			URL_HASH "SHA256=9c4396cc829cfae319a6e2615202e82aad41372073482fce286fac78646d3ee4"
+			CONFIGURE_COMMAND ""
+			# Position independent, so that it can end up in a shared libscap too
+			BUILD_COMMAND ${CMD_MAKE} -C lib libzstd.a "CFLAGS=-O3 -fPIC"
+			BUILD_IN_SOURCE 1
+			BUILD_BYPRODUCTS ${ZSTD_LIB}
+			INSTALL_COMMAND "")
+		install(FILES "${ZSTD_LIB}" DESTINATION "${CMAKE_INSTALL_LIBDIR}/${LIBS_PACKAGE_NAME}"
+				COMPONENT "libs-deps")
+		install(FILES "${ZSTD_INCLUDE}/zstd.h" DESTINATION "${CMAKE_INSTALL_INCLUDEDIR}/${LIBS_PACKAGE_NAME}/zstd"
+				COMPONENT "libs-deps")
+	endif()
+endif()
+
+if(NOT TARGET zstd)
+	add_custom_target(zstd)
+endif()
+
+include_directories(${ZSTD_INCLUDE})
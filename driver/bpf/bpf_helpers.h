@@ -29,6 +29,12 @@ static unsigned long long (*bpf_ktime_get_boot_ns)(void) =
 	(void *)BPF_FUNC_ktime_get_ns;
 #endif
 
+/* Introduced in linux 4.18, see https://github.com/torvalds/linux/commit/bf6fa2c893c5237b48569a13fa3c673041430b6c */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,18,0)
+static unsigned long long (*bpf_get_current_cgroup_id)(void) =
+	(void *)BPF_FUNC_get_current_cgroup_id;
+#endif
+
 static int (*bpf_trace_printk)(const char *fmt, int fmt_size, ...) =
 	(void *)BPF_FUNC_trace_printk;
 static void (*bpf_tail_call)(void *ctx, void *map, int index) =
@@ -304,12 +304,55 @@ static __always_inline int bpf_addr_to_kernel(void *uaddr, int ulen,
 
 #define get_buf(x) data->buf[(data->state->tail_ctx.curoff + (x)) & SCRATCH_SIZE_HALF]
 
+/*
+ * Return the snaplen set for the kind of data->fd (socket, pipe or anything
+ * else), or the global snaplen if there is none.
+ */
+static __always_inline u32 bpf_fd_type_snaplen(struct filler_data *data)
+{
+	u32 *snaplens = data->settings->fd_type_snaplen;
+	u32 res = data->settings->snaplen;
+	struct file *fil;
+	struct inode *f_inode;
+	umode_t i_mode;
+	int fd_type;
+
+	if (snaplens[PPM_SNAPLEN_FD_FILE] == PPM_SNAPLEN_FD_TYPE_DEFAULT &&
+	    snaplens[PPM_SNAPLEN_FD_SOCKET] == PPM_SNAPLEN_FD_TYPE_DEFAULT &&
+	    snaplens[PPM_SNAPLEN_FD_PIPE] == PPM_SNAPLEN_FD_TYPE_DEFAULT)
+		return res;
+
+	if (data->fd == -1)
+		return res;
+
+	fil = bpf_fget(data->fd);
+	if (!fil)
+		return res;
+
+	f_inode = _READ(fil->f_inode);
+	if (!f_inode)
+		return res;
+
+	i_mode = _READ(f_inode->i_mode);
+	if (S_ISSOCK(i_mode))
+		fd_type = PPM_SNAPLEN_FD_SOCKET;
+	else if (S_ISFIFO(i_mode))
+		fd_type = PPM_SNAPLEN_FD_PIPE;
+	else
+		fd_type = PPM_SNAPLEN_FD_FILE;
+
+	if (snaplens[fd_type] != PPM_SNAPLEN_FD_TYPE_DEFAULT)
+		res = snaplens[fd_type];
+
+	return res;
+}
+
 static __always_inline u32 bpf_compute_snaplen(struct filler_data *data,
 					       u32 lookahead_size)
 {
 	struct sockaddr_storage *sock_address;
 	struct sockaddr_storage *peer_address;
-	u32 res = data->settings->snaplen;
+	u32 res = bpf_fd_type_snaplen(data);
 	struct socket *sock;
 	struct sock *sk;
 	u16 sport;
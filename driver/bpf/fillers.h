@@ -87,14 +87,9 @@ static __always_inline int bpf_##x(void *ctx)				\
 									\
 static __always_inline int __bpf_##x(struct filler_data *data)		\
 
-FILLER_RAW(terminate_filler)
+/* Updates the drop counters according to the result of the filler */
+static __always_inline void account_filler_result(struct scap_bpf_per_cpu_state *state)
 {
-	struct scap_bpf_per_cpu_state *state;
-
-	state = get_local_state(bpf_get_smp_processor_id());
-	if (!state)
-		return 0;
-
 	switch (state->tail_ctx.prev_res) {
 	case PPM_SUCCESS:
 		break;
@@ -311,7 +306,17 @@ FILLER_RAW(terminate_filler)
 			   state->tail_ctx.curarg);
 		break;
 	}
+}
 
+FILLER_RAW(terminate_filler)
+{
+	struct scap_bpf_per_cpu_state *state;
+
+	state = get_local_state(bpf_get_smp_processor_id());
+	if (!state)
+		return 0;
+
+	account_filler_result(state);
 	release_local_state(state);
 	return 0;
 }
@@ -437,18 +442,25 @@ FILLER(sys_read_x, true)
 	res = bpf_push_s64_to_ring(data, (s64)retval);
 	CHECK_RES(res);
 
+	s32 fd = (s32)bpf_syscall_get_argument(data, 0);
 	if (retval < 0)
 	{
 		/* Parameter 2: data (type: PT_BYTEBUF) */
-		return bpf_push_empty_param(data);
+		res = bpf_push_empty_param(data);
 	}
+	else
+	{
+		val = bpf_syscall_get_argument(data, 1);
+		bufsize = retval;
 
-	val = bpf_syscall_get_argument(data, 1);
-	bufsize = retval;
+		/* Parameter 2: data (type: PT_BYTEBUF) */
+		data->fd = fd;
+		res = __bpf_val_to_ring(data, val, bufsize, PT_BYTEBUF, -1, true, USER);
+	}
+	CHECK_RES(res);
 
-	/* Parameter 2: data (type: PT_BYTEBUF) */
-	data->fd = bpf_syscall_get_argument(data, 0);
-	return __bpf_val_to_ring(data, val, bufsize, PT_BYTEBUF, -1, true, USER);;
+	/* Parameter 3: fd (type: PT_FD) */
+	return bpf_push_s64_to_ring(data, (s64)fd);
 }
 
 FILLER(sys_write_e, true)
@@ -476,8 +488,13 @@ FILLER(sys_write_x, true)
 	 */
 	unsigned long bytes_to_read = retval > 0 ? retval : bpf_syscall_get_argument(data, 2);
 	unsigned long sent_data_pointer = bpf_syscall_get_argument(data, 1);
-	data->fd = bpf_syscall_get_argument(data, 0);
-	return __bpf_val_to_ring(data, sent_data_pointer, bytes_to_read, PT_BYTEBUF, -1, true, USER);
+	s32 fd = (s32)bpf_syscall_get_argument(data, 0);
+	data->fd = fd;
+	res = __bpf_val_to_ring(data, sent_data_pointer, bytes_to_read, PT_BYTEBUF, -1, true, USER);
+	CHECK_RES(res);
+
+	/* Parameter 3: fd (type: PT_FD) */
+	return bpf_push_s64_to_ring(data, (s64)fd);
 }
 
 #define POLL_MAXFDS 16
@@ -2855,7 +2872,12 @@ FILLER(sys_close_x, true)
 {
 	/* Parameter 1: res (type: PT_ERRNO)*/
 	long retval = bpf_syscall_get_retval(data->ctx);
-	return bpf_push_s64_to_ring(data, retval);
+	int res = bpf_push_s64_to_ring(data, retval);
+	CHECK_RES(res);
+
+	/* Parameter 2: fd (type: PT_FD)*/
+	s32 fd = (s32)bpf_syscall_get_argument(data, 0);
+	return bpf_push_s64_to_ring(data, (s64)fd);
 }
 
 FILLER(sys_fchdir_e, true)
@@ -6725,4 +6747,135 @@ FILLER(sys_prctl_x, true)
 	return res;
 }
 
+/*
+ * Fillers of the most frequent syscall events. They only push fixed-size
+ * parameters taken from the registers, so they fit in the program of the
+ * syscall tracepoint and can run there, saving the tail calls to the filler
+ * and to the terminate filler.
+ */
+static __always_inline bool is_fast_filler(enum ppm_filler_id filler_id)
+{
+	switch (filler_id) {
+	case PPM_FILLER_sys_empty:
+	case PPM_FILLER_sys_single_x:
+	case PPM_FILLER_sys_read_e:
+	case PPM_FILLER_sys_write_e:
+	case PPM_FILLER_sys_pread64_e:
+	case PPM_FILLER_sys_pwrite64_e:
+	case PPM_FILLER_sys_readv_e:
+	case PPM_FILLER_sys_recvfrom_e:
+	case PPM_FILLER_sys_recvmsg_e:
+	case PPM_FILLER_sys_close_e:
+	case PPM_FILLER_sys_close_x:
+	case PPM_FILLER_sys_fstat_e:
+	case PPM_FILLER_sys_futex_e:
+	case PPM_FILLER_sys_ioctl_e:
+	case PPM_FILLER_sys_fcntl_e:
+	case PPM_FILLER_sys_lseek_e:
+	case PPM_FILLER_sys_getdents_e:
+	case PPM_FILLER_sys_getdents64_e:
+	case PPM_FILLER_sys_shutdown_e:
+	case PPM_FILLER_sys_dup_e:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static __always_inline int run_fast_filler(struct filler_data *data,
+					   enum ppm_filler_id filler_id)
+{
+	switch (filler_id) {
+	case PPM_FILLER_sys_empty:
+		return __bpf_sys_empty(data);
+	case PPM_FILLER_sys_single_x:
+		return __bpf_sys_single_x(data);
+	case PPM_FILLER_sys_read_e:
+		return __bpf_sys_read_e(data);
+	case PPM_FILLER_sys_write_e:
+		return __bpf_sys_write_e(data);
+	case PPM_FILLER_sys_pread64_e:
+		return __bpf_sys_pread64_e(data);
+	case PPM_FILLER_sys_pwrite64_e:
+		return __bpf_sys_pwrite64_e(data);
+	case PPM_FILLER_sys_readv_e:
+		return __bpf_sys_readv_e(data);
+	case PPM_FILLER_sys_recvfrom_e:
+		return __bpf_sys_recvfrom_e(data);
+	case PPM_FILLER_sys_recvmsg_e:
+		return __bpf_sys_recvmsg_e(data);
+	case PPM_FILLER_sys_close_e:
+		return __bpf_sys_close_e(data);
+	case PPM_FILLER_sys_close_x:
+		return __bpf_sys_close_x(data);
+	case PPM_FILLER_sys_fstat_e:
+		return __bpf_sys_fstat_e(data);
+	case PPM_FILLER_sys_futex_e:
+		return __bpf_sys_futex_e(data);
+	case PPM_FILLER_sys_ioctl_e:
+		return __bpf_sys_ioctl_e(data);
+	case PPM_FILLER_sys_fcntl_e:
+		return __bpf_sys_fcntl_e(data);
+	case PPM_FILLER_sys_lseek_e:
+		return __bpf_sys_lseek_e(data);
+	case PPM_FILLER_sys_getdents_e:
+		return __bpf_sys_getdents_e(data);
+	case PPM_FILLER_sys_getdents64_e:
+		return __bpf_sys_getdents64_e(data);
+	case PPM_FILLER_sys_shutdown_e:
+		return __bpf_sys_shutdown_e(data);
+	case PPM_FILLER_sys_dup_e:
+		return __bpf_sys_dup_e(data);
+	default:
+		return PPM_FAILURE_BUG;
+	}
+}
+
+/*
+ * Same as call_filler(), but the events with a fast filler are filled and
+ * pushed to the perf buffer directly by the calling program. All the other
+ * events are sent to their filler through the tail call as usual.
+ */
+static __always_inline void call_syscall_filler(void *ctx,
+						void *stack_ctx,
+						ppm_event_code evt_type,
+						enum syscall_flags drop_flags)
+{
+	const struct ppm_event_entry *filler_info;
+	struct scap_bpf_per_cpu_state *state;
+	struct filler_data data = {0};
+	int res;
+
+	state = prepare_filler(ctx, stack_ctx, evt_type, drop_flags);
+	if (!state)
+		return;
+
+	filler_info = get_event_filler_info(state->tail_ctx.evt_type);
+	if (!filler_info)
+		goto cleanup;
+
+	if (!is_fast_filler(filler_info->filler_id)) {
+		bpf_tail_call(ctx, &tail_map, filler_info->filler_id);
+		bpf_printk("Can't tail call filler evt=%d, filler=%d\n",
+			   state->tail_ctx.evt_type,
+			   filler_info->filler_id);
+		goto cleanup;
+	}
+
+	res = init_filler_data(ctx, &data, true);
+	if (res == PPM_SUCCESS) {
+		write_evt_hdr(&data);
+		res = run_fast_filler(&data, filler_info->filler_id);
+	}
+
+	if (res == PPM_SUCCESS)
+		res = push_evt_frame(ctx, &data);
+
+	state->tail_ctx.prev_res = res;
+	account_filler_result(state);
+
+cleanup:
+	release_local_state(state);
+}
+
 #endif
@@ -90,6 +90,14 @@ struct bpf_map_def __bpf_section("maps") interesting_syscalls_table = {
 	.max_entries = SYSCALL_TABLE_SIZE,
 };
 
+/* Cgroups listed in the cgroup filter, the value is unused */
+struct bpf_map_def __bpf_section("maps") cgroup_filter_map = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(u64),
+	.value_size = sizeof(u8),
+	.max_entries = PPM_MAX_CGROUP_FILTER_IDS,
+};
+
 #ifndef BPF_SUPPORTS_RAW_TRACEPOINTS
 struct bpf_map_def __bpf_section("maps") stash_map = {
 	.type = BPF_MAP_TYPE_HASH,
@@ -487,6 +487,107 @@ static __always_inline bool bpf_drop_syscall_exit_events(void *ctx, ppm_event_co
 }
 #endif
 
+/* Return true if the syscall events of the current task must be dropped
+ * because its comm is suppressed. The syscalls that create or exec a task
+ * are always kept, userspace needs them to track the suppressed threads.
+ */
+static __always_inline bool bpf_drop_suppressed_comm(struct scap_bpf_settings *settings,
+						     const struct syscall_evt_pair *sc_evt)
+{
+	char comm[PPM_COMM_LEN] = {0};
+	uint32_t n_comms = settings->suppressed_comms.n_comms;
+	int j;
+	int k;
+
+	if (n_comms == 0)
+		return false;
+
+	switch (sc_evt->ppm_sc)
+	{
+		case PPM_SC_CLONE:
+		case PPM_SC_CLONE3:
+		case PPM_SC_FORK:
+		case PPM_SC_VFORK:
+		case PPM_SC_EXECVE:
+		case PPM_SC_EXECVEAT:
+			return false;
+		default:
+			break;
+	}
+
+	if (bpf_get_current_comm(comm, sizeof(comm)) != 0)
+		return false;
+
+	#pragma unroll
+	for (j = 0; j < PPM_MAX_SUPPRESSED_COMMS; j++) {
+		bool match = true;
+
+		if (j >= n_comms)
+			break;
+
+		#pragma unroll
+		for (k = 0; k < PPM_COMM_LEN; k++) {
+			if (comm[k] != settings->suppressed_comms.comms[j][k]) {
+				match = false;
+				break;
+			}
+		}
+
+		if (match)
+			return true;
+	}
+
+	return false;
+}
+
+/* Return true if the syscall events of the current task must be dropped
+ * because of the cgroup it runs in. The syscalls that build up the process
+ * tree are always kept, userspace needs them to track the filtered tasks.
+ * The cgroup id can't be read before linux 4.18, where nothing is dropped.
+ */
+static __always_inline bool bpf_drop_cgroup_filtered(struct scap_bpf_settings *settings,
+						     const struct syscall_evt_pair *sc_evt)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
+	uint8_t mode = settings->cgroup_filter_mode;
+	u64 cgroup_id;
+	bool listed;
+
+	if (mode == PPM_CGROUP_FILTER_NONE)
+		return false;
+
+	switch (sc_evt->ppm_sc)
+	{
+		case PPM_SC_CLONE:
+		case PPM_SC_CLONE3:
+		case PPM_SC_FORK:
+		case PPM_SC_VFORK:
+		case PPM_SC_EXECVE:
+		case PPM_SC_EXECVEAT:
+		case PPM_SC_CHDIR:
+		case PPM_SC_FCHDIR:
+		case PPM_SC_CHROOT:
+		case PPM_SC_SETPGID:
+		case PPM_SC_SETSID:
+		case PPM_SC_PRCTL:
+		case PPM_SC_CAPSET:
+		case PPM_SC_SETUID:
+		case PPM_SC_SETGID:
+		case PPM_SC_SETRESUID:
+		case PPM_SC_SETRESGID:
+			return false;
+		default:
+			break;
+	}
+
+	cgroup_id = bpf_get_current_cgroup_id();
+	listed = bpf_map_lookup_elem(&cgroup_filter_map, &cgroup_id) != NULL;
+	return mode == PPM_CGROUP_FILTER_ALLOW ? !listed : listed;
+#else
+	return false;
+#endif
+}
+
 static __always_inline bool drop_event(void *ctx,
 				       struct scap_bpf_per_cpu_state *state,
 				       ppm_event_code evt_type,
@@ -595,15 +696,18 @@ static __always_inline void reset_tail_ctx(struct scap_bpf_per_cpu_state *state,
 	state->tail_ctx.prev_res = 0;
 }
 
-static __always_inline void call_filler(void *ctx,
-					void *stack_ctx,
-					ppm_event_code evt_type,
-					enum syscall_flags drop_flags)
+/*
+ * Acquires the per-CPU state and decides whether the event has to be sent.
+ * On success the state is returned still acquired, with the tail context
+ * ready for the filler: the caller is in charge of releasing it.
+ */
+static __always_inline struct scap_bpf_per_cpu_state *prepare_filler(void *ctx,
+								     void *stack_ctx,
+								     ppm_event_code evt_type,
+								     enum syscall_flags drop_flags)
 {
 	struct scap_bpf_settings *settings;
-	const struct ppm_event_entry *filler_info;
 	struct scap_bpf_per_cpu_state *state;
-	unsigned long long pid;
 	unsigned long long ts;
 	unsigned int cpu;
 
@@ -611,14 +715,14 @@ static __always_inline void call_filler(void *ctx,
 
 	state = get_local_state(cpu);
 	if (!state)
-		return;
+		return NULL;
 
 	settings = get_bpf_settings();
 	if (!settings)
-		return;
+		return NULL;
 
 	if (!acquire_local_state(state))
-		return;
+		return NULL;
 
 	if (cpu == 0 && state->hotplug_cpu != 0) {
 		evt_type = PPME_CPU_HOTPLUG_E;
@@ -629,11 +733,28 @@ static __always_inline void call_filler(void *ctx,
 	reset_tail_ctx(state, evt_type, ts);
 
 	/* drop_event can change state->tail_ctx.evt_type */
-	if (drop_event(stack_ctx, state, evt_type, settings, drop_flags))
-		goto cleanup;
+	if (drop_event(stack_ctx, state, evt_type, settings, drop_flags)) {
+		release_local_state(state);
+		return NULL;
+	}
 
 	++state->n_evts;
 
+	return state;
+}
+
+static __always_inline void call_filler(void *ctx,
+					void *stack_ctx,
+					ppm_event_code evt_type,
+					enum syscall_flags drop_flags)
+{
+	const struct ppm_event_entry *filler_info;
+	struct scap_bpf_per_cpu_state *state;
+
+	state = prepare_filler(ctx, stack_ctx, evt_type, drop_flags);
+	if (!state)
+		return;
+
 	filler_info = get_event_filler_info(state->tail_ctx.evt_type);
 	if (!filler_info)
 		goto cleanup;
@@ -43,6 +43,7 @@ BPF_PROBE("raw_syscalls/", sys_enter, sys_enter_args)
 	int drop_flags;
 	long id;
 	bool enabled;
+	struct scap_bpf_settings *settings;
 
 	if (bpf_in_ia32_syscall())
 		return 0;
@@ -68,6 +69,16 @@ BPF_PROBE("raw_syscalls/", sys_enter, sys_enter_args)
 	if (!sc_evt)
 		return 0;
 
+	settings = get_bpf_settings();
+	if (!settings)
+		return 0;
+
+	if (bpf_drop_suppressed_comm(settings, sc_evt))
+		return 0;
+
+	if (bpf_drop_cgroup_filtered(settings, sc_evt))
+		return 0;
+
 	if (sc_evt->flags & UF_USED) {
 		evt_type = sc_evt->enter_event_type;
 		drop_flags = sc_evt->flags;
@@ -77,7 +88,7 @@ BPF_PROBE("raw_syscalls/", sys_enter, sys_enter_args)
 	}
 
 #ifdef BPF_SUPPORTS_RAW_TRACEPOINTS
-	call_filler(ctx, ctx, evt_type, drop_flags);
+	call_syscall_filler(ctx, ctx, evt_type, drop_flags);
 #else
 	/* Duplicated here to avoid verifier madness */
 	struct sys_enter_args stack_ctx;
@@ -86,7 +97,7 @@ BPF_PROBE("raw_syscalls/", sys_enter, sys_enter_args)
 	if (stash_args(stack_ctx.args))
 		return 0;
 
-	call_filler(ctx, &stack_ctx, evt_type, drop_flags);
+	call_syscall_filler(ctx, &stack_ctx, evt_type, drop_flags);
 #endif
 	return 0;
 }
@@ -139,6 +150,12 @@ BPF_PROBE("raw_syscalls/", sys_exit, sys_exit_args)
 	if (!sc_evt)
 		return 0;
 
+	if (bpf_drop_suppressed_comm(settings, sc_evt))
+		return 0;
+
+	if (bpf_drop_cgroup_filtered(settings, sc_evt))
+		return 0;
+
 	if (sc_evt->flags & UF_USED) {
 		evt_type = sc_evt->exit_event_type;
 		drop_flags = sc_evt->flags;
@@ -152,7 +169,7 @@ BPF_PROBE("raw_syscalls/", sys_exit, sys_exit_args)
 		return 0;
 #endif
 
-	call_filler(ctx, ctx, evt_type, drop_flags);
+	call_syscall_filler(ctx, ctx, evt_type, drop_flags);
 	return 0;
 }
 
@@ -224,8 +224,9 @@ enum scap_map_types {
 	SCAP_SETTINGS_MAP = 7,
 	SCAP_LOCAL_STATE_MAP = 8,
 	SCAP_INTERESTING_SYSCALLS_TABLE = 9,
+	SCAP_CGROUP_FILTER_MAP = 10,
 #ifndef BPF_SUPPORTS_RAW_TRACEPOINTS
-	SCAP_STASH_MAP = 10,
+	SCAP_STASH_MAP = 11,
 #endif
 };
 
@@ -242,6 +243,9 @@ struct scap_bpf_settings {
 	uint16_t fullcapture_port_range_start;
 	uint16_t fullcapture_port_range_end;
 	uint16_t statsd_port;
+	struct ppm_suppressed_comms suppressed_comms;
+	uint32_t fd_type_snaplen[PPM_SNAPLEN_FD_MAX];
+	uint8_t cgroup_filter_mode;
 } __attribute__((packed));
 
 struct tail_context {
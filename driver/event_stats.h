@@ -3,6 +3,6 @@
 /* These numbers must be updated when we add new events in the event table */
 #define SYSCALL_EVENTS_NUM 356
 #define TRACEPOINT_EVENTS_NUM 6
-#define METAEVENTS_NUM 19
+#define METAEVENTS_NUM 21
 #define PLUGIN_EVENTS_NUM 1
-#define UNKNOWN_EVENTS_NUM 20
+#define UNKNOWN_EVENTS_NUM 22
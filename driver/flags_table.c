@@ -109,6 +109,7 @@ const struct ppm_name_value clone_flags[] = {
 	{"CLONE_STOPPED", PPM_CL_CLONE_STOPPED},
 	{"CLONE_VFORK", PPM_CL_CLONE_VFORK},
 	{"CLONE_NEWCGROUP", PPM_CL_CLONE_NEWCGROUP},
+	{"STRINGS_INTERNED", PPM_CL_STRINGS_INTERNED},
 	{0, 0},
 };
 
@@ -547,6 +548,7 @@ const struct ppm_name_value openat2_flags[] = {
 const struct ppm_name_value execve_flags[] = {
 	{"EXE_WRITABLE", PPM_EXE_WRITABLE},
 	{"EXE_UPPER_LAYER", PPM_EXE_UPPER_LAYER},
+	{"EXE_STRINGS_INTERNED", PPM_EXE_STRINGS_INTERNED},
 	{0, 0},
 };
 
@@ -672,3 +674,9 @@ const struct ppm_name_value prctl_options[] = {
 	{"PR_CAP_AMBIENT",PPM_PR_CAP_AMBIENT},
 	{0, 0},
 };
+
+const struct ppm_name_value io_aggregate_directions[] = {
+	{"READ", PPM_IO_AGGREGATE_READ},
+	{"WRITE", PPM_IO_AGGREGATE_WRITE},
+	{0, 0},
+};
@@ -135,6 +135,12 @@ struct event_data_t {
 	} event_info;
 };
 
+struct suppressed_tid {
+	struct list_head node;
+	pid_t tid;
+	struct rcu_head rcu;
+};
+
 /*
  * FORWARD DECLARATIONS
  */
@@ -148,7 +154,9 @@ static int record_event_consumer(struct ppm_consumer_t *consumer,
                                  enum syscall_flags drop_flags,
                                  nanoseconds ns,
                                  struct event_data_t *event_datap,
-				 kmod_prog_codes tp_type);
+				 kmod_prog_codes tp_type,
+				 const struct ppm_evt_hdr *shared_evt,
+				 struct ppm_evt_hdr **recorded_evt);
 static void record_event_all_consumers(ppm_event_code event_type,
                                        enum syscall_flags drop_flags,
                                        struct event_data_t *event_datap,
@@ -343,6 +351,199 @@ static struct ppm_consumer_t *ppm_find_consumer(struct task_struct *consumer_id)
 	return NULL;
 }
 
+static inline struct list_head *suppressed_tid_bucket(struct ppm_consumer_t *consumer, pid_t tid)
+{
+	return &consumer->suppressed_tids[(u32)tid % PPM_SUPPRESSED_TIDS_BUCKETS];
+}
+
+/*
+ * Must be called under rcu_read_lock()
+ */
+static struct suppressed_tid *find_suppressed_tid(struct ppm_consumer_t *consumer, pid_t tid)
+{
+	struct suppressed_tid *st;
+
+	list_for_each_entry_rcu(st, suppressed_tid_bucket(consumer, tid), node) {
+		if (st->tid == tid)
+			return st;
+	}
+
+	return NULL;
+}
+
+static void free_suppressed_tid(struct rcu_head *rcu)
+{
+	kfree(container_of(rcu, struct suppressed_tid, rcu));
+}
+
+/*
+ * The suppressed tids change under g_consumer_mutex
+ */
+static int suppress_tid(struct ppm_consumer_t *consumer, pid_t tid)
+{
+	struct suppressed_tid *st;
+
+	rcu_read_lock();
+	st = find_suppressed_tid(consumer, tid);
+	rcu_read_unlock();
+	if (st)
+		return 0;
+
+	if (consumer->n_suppressed_tids >= PPM_MAX_SUPPRESSED_TIDS)
+		return -ENOSPC;
+
+	st = kmalloc(sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return -ENOMEM;
+
+	st->tid = tid;
+	list_add_rcu(&st->node, suppressed_tid_bucket(consumer, tid));
+	consumer->n_suppressed_tids++;
+	return 0;
+}
+
+static void unsuppress_tid(struct ppm_consumer_t *consumer, pid_t tid)
+{
+	struct suppressed_tid *st;
+
+	rcu_read_lock();
+	st = find_suppressed_tid(consumer, tid);
+	rcu_read_unlock();
+	if (!st)
+		return;
+
+	list_del_rcu(&st->node);
+	consumer->n_suppressed_tids--;
+	call_rcu(&st->rcu, free_suppressed_tid);
+}
+
+/*
+ * Only once the tracepoints can't see the consumer anymore
+ */
+static void clear_suppressed_tids(struct ppm_consumer_t *consumer)
+{
+	struct suppressed_tid *st;
+	struct suppressed_tid *tmp;
+	int j;
+
+	for (j = 0; j < PPM_SUPPRESSED_TIDS_BUCKETS; j++) {
+		list_for_each_entry_safe(st, tmp, &consumer->suppressed_tids[j], node) {
+			list_del(&st->node);
+			kfree(st);
+		}
+	}
+	consumer->n_suppressed_tids = 0;
+}
+
+/*
+ * PPM_IOCTL_WAIT_READY_CPUS helpers
+ */
+static void ready_work_fn(struct irq_work *work)
+{
+	struct ppm_consumer_t *consumer = container_of(work, struct ppm_consumer_t, ready_work);
+
+	wake_up_interruptible(&consumer->ready_wq);
+}
+
+static inline u32 ring_used_bytes(struct ppm_consumer_t *consumer, struct ppm_ring_buffer_info *info)
+{
+	u32 head = info->head;
+	u32 tail = info->tail;
+
+	return head >= tail ? head - tail : consumer->buffer_bytes_dim - tail + head;
+}
+
+static bool any_ring_over_watermark(struct ppm_consumer_t *consumer, u32 watermark)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct ppm_ring_buffer_context *ring = per_cpu_ptr(consumer->ring_buffers, cpu);
+
+		if (ring->open && ring->info && ring_used_bytes(consumer, ring->info) >= watermark)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Called by the tracepoints after publishing an event, only while the consumer is waiting.
+ * Since there is no full barrier between the head update and the read of ready_waiting,
+ * the consumer can miss a wakeup in a tiny window: it then wakes up at its timeout.
+ */
+static inline void notify_ready(struct ppm_consumer_t *consumer, struct ppm_ring_buffer_info *info)
+{
+	if (ring_used_bytes(consumer, info) >= consumer->ready_watermark &&
+	    atomic_cmpxchg(&consumer->ready_waiting, 1, 0) == 1)
+		irq_work_queue(&consumer->ready_work);
+}
+
+static long wait_ready_cpus(struct task_struct *consumer_id, unsigned long arg)
+{
+	struct ppm_consumer_t *consumer;
+	struct ppm_ready_cpus req;
+	u64 *mask;
+	u32 n_words;
+	u32 watermark;
+	long remaining;
+	int cpu;
+
+	if (copy_from_user(&req, (void *)arg, sizeof(req)))
+		return -EINVAL;
+
+	n_words = DIV_ROUND_UP(nr_cpu_ids, 64);
+	if (req.n_words < n_words)
+		return -ENOSPC;
+
+	/*
+	 * The consumer can't go away while we sleep: the file we have been called on keeps
+	 * its ring open.
+	 */
+	mutex_lock(&g_consumer_mutex);
+	consumer = ppm_find_consumer(consumer_id);
+	mutex_unlock(&g_consumer_mutex);
+	if (!consumer) {
+		pr_err("ioctl: unknown consumer %p\n", consumer_id);
+		return -EBUSY;
+	}
+
+	watermark = req.watermark ? req.watermark : 1;
+	if (req.timeout_ms > 0 && !any_ring_over_watermark(consumer, watermark)) {
+		consumer->ready_watermark = watermark;
+		atomic_set(&consumer->ready_waiting, 1);
+		remaining = wait_event_interruptible_timeout(consumer->ready_wq,
+							     any_ring_over_watermark(consumer, watermark),
+							     msecs_to_jiffies(req.timeout_ms));
+		atomic_set(&consumer->ready_waiting, 0);
+		if (remaining < 0)
+			return remaining;
+	}
+
+	mask = kcalloc(n_words, sizeof(u64), GFP_KERNEL);
+	if (!mask)
+		return -ENOMEM;
+
+	req.n_ready = 0;
+	for_each_possible_cpu(cpu) {
+		struct ppm_ring_buffer_context *ring = per_cpu_ptr(consumer->ring_buffers, cpu);
+
+		if (ring->open && ring->info && ring->info->head != ring->info->tail) {
+			mask[cpu / 64] |= 1ULL << (cpu % 64);
+			req.n_ready++;
+		}
+	}
+
+	if (copy_to_user((void __user *)(unsigned long)req.mask, mask, n_words * sizeof(u64)) ||
+	    copy_to_user((void *)arg, &req, sizeof(req))) {
+		kfree(mask);
+		return -EINVAL;
+	}
+
+	kfree(mask);
+	return 0;
+}
+
 static void check_remove_consumer(struct ppm_consumer_t *consumer, int remove_from_list)
 {
 	int cpu;
@@ -373,6 +574,10 @@ static void check_remove_consumer(struct ppm_consumer_t *consumer, int remove_fr
 
 		free_percpu(consumer->ring_buffers);
 
+		clear_suppressed_tids(consumer);
+
+		irq_work_sync(&consumer->ready_work);
+
 		vfree(consumer);
 	}
 }
@@ -384,6 +589,7 @@ static int ppm_open(struct inode *inode, struct file *filp)
 {
 	int ret;
 	int in_list = false;
+	int fd_type;
 #if LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 20)
 	int ring_no = iminor(filp->f_path.dentry->d_inode);
 #else
@@ -404,6 +610,7 @@ static int ppm_open(struct inode *inode, struct file *filp)
 	consumer = ppm_find_consumer(consumer_id);
 	if (!consumer) {
 		unsigned int cpu;
+		unsigned int j;
 		unsigned int num_consumers = 0;
 		struct ppm_consumer_t *el = NULL;
 
@@ -433,6 +640,15 @@ static int ppm_open(struct inode *inode, struct file *filp)
 		consumer->buffer_bytes_dim = g_buffer_bytes_dim;
 		consumer->tracepoints_attached = 0; /* Start with no tracepoints */
 
+		for (j = 0; j < PPM_SUPPRESSED_TIDS_BUCKETS; j++)
+			INIT_LIST_HEAD(&consumer->suppressed_tids[j]);
+		consumer->n_suppressed_tids = 0;
+
+		init_waitqueue_head(&consumer->ready_wq);
+		init_irq_work(&consumer->ready_work, ready_work_fn);
+		atomic_set(&consumer->ready_waiting, 0);
+		consumer->ready_watermark = 1;
+
 		/*
 		 * Initialize the ring buffers array
 		 */
@@ -525,6 +741,9 @@ static int ppm_open(struct inode *inode, struct file *filp)
 	consumer->is_dropping = 0;
 	consumer->do_dynamic_snaplen = false;
 	consumer->drop_failed = false;
+	consumer->suppressed_comms.n_comms = 0;
+	for (fd_type = 0; fd_type < PPM_SNAPLEN_FD_MAX; fd_type++)
+		consumer->fd_type_snaplen[fd_type] = PPM_SNAPLEN_FD_TYPE_DEFAULT;
 	consumer->need_to_insert_drop_e = 0;
 	consumer->need_to_insert_drop_x = 0;
 	consumer->fullcapture_port_range_start = 0;
@@ -929,6 +1148,10 @@ cleanup_ioctl_procinfo:
 		if(put_user(PPM_SCHEMA_CURRENT_VERSION, out))
 			ret = -EINVAL;
 		goto cleanup_ioctl_nolock;
+	} else if (cmd == PPM_IOCTL_WAIT_READY_CPUS) {
+		/* It sleeps, so it must not hold g_consumer_mutex */
+		ret = wait_ready_cpus(consumer_id, arg);
+		goto cleanup_ioctl_nolock;
 	}
 
 	mutex_lock(&g_consumer_mutex);
@@ -1173,6 +1396,105 @@ cleanup_ioctl_procinfo:
 		ret = 0;
 		goto cleanup_ioctl;
 	}
+	case PPM_IOCTL_SUPPRESS_TID:
+	{
+		ret = suppress_tid(consumer, (pid_t)arg);
+		goto cleanup_ioctl;
+	}
+	case PPM_IOCTL_UNSUPPRESS_TID:
+	{
+		unsuppress_tid(consumer, (pid_t)arg);
+		ret = 0;
+		goto cleanup_ioctl;
+	}
+	case PPM_IOCTL_SET_SUPPRESSED_COMMS:
+	{
+		struct ppm_suppressed_comms comms;
+		u32 j;
+
+		if (copy_from_user(&comms, (void *)arg, sizeof(comms))) {
+			ret = -EINVAL;
+			goto cleanup_ioctl;
+		}
+
+		if (comms.n_comms > PPM_MAX_SUPPRESSED_COMMS) {
+			pr_err("invalid number of suppressed comms %u\n", comms.n_comms);
+			ret = -EINVAL;
+			goto cleanup_ioctl;
+		}
+
+		for (j = 0; j < comms.n_comms; j++)
+			comms.comms[j][PPM_COMM_LEN - 1] = '\0';
+
+		/*
+		 * The tracepoints keep running: disable the check while the
+		 * comms are copied, so that they never see a partial entry.
+		 */
+		consumer->suppressed_comms.n_comms = 0;
+		smp_wmb();
+		memcpy(consumer->suppressed_comms.comms, comms.comms, sizeof(comms.comms));
+		smp_wmb();
+		consumer->suppressed_comms.n_comms = comms.n_comms;
+
+		ret = 0;
+		goto cleanup_ioctl;
+	}
+	case PPM_IOCTL_SET_FD_TYPE_SNAPLEN:
+	{
+		struct ppm_fd_type_snaplen fd_snaplen;
+
+		if (copy_from_user(&fd_snaplen, (void *)arg, sizeof(fd_snaplen))) {
+			ret = -EINVAL;
+			goto cleanup_ioctl;
+		}
+
+		if (fd_snaplen.fd_type >= PPM_SNAPLEN_FD_MAX ||
+		    (fd_snaplen.snaplen > SNAPLEN_MAX && fd_snaplen.snaplen != PPM_SNAPLEN_FD_TYPE_DEFAULT)) {
+			pr_err("invalid snaplen %u for fd type %u\n", fd_snaplen.snaplen, fd_snaplen.fd_type);
+			ret = -EINVAL;
+			goto cleanup_ioctl;
+		}
+
+		consumer->fd_type_snaplen[fd_snaplen.fd_type] = fd_snaplen.snaplen;
+
+		vpr_info("new snaplen for fd type %u: %u\n", fd_snaplen.fd_type, fd_snaplen.snaplen);
+
+		ret = 0;
+		goto cleanup_ioctl;
+	}
+	case PPM_IOCTL_SET_RING_SNAPLEN:
+	{
+		u32 new_limit = (u32)arg;
+#if LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 20)
+		int ring_no = iminor(filp->f_path.dentry->d_inode);
+#else
+		int ring_no = iminor(filp->f_dentry->d_inode);
+#endif
+		struct ppm_ring_buffer_context *ring;
+
+		if (new_limit > SNAPLEN_MAX && new_limit != PPM_SNAPLEN_NO_LIMIT) {
+			pr_err("invalid snaplen limit %u\n", new_limit);
+			ret = -EINVAL;
+			goto cleanup_ioctl;
+		}
+
+		ring = per_cpu_ptr(consumer->ring_buffers, ring_no);
+		if (!ring || !ring->cpu_online) {
+			ret = -ENODEV;
+			goto cleanup_ioctl;
+		}
+
+		/*
+		 * Read locklessly by the probes of that CPU, an event being
+		 * recorded can still get the previous limit.
+		 */
+		ring->snaplen_limit = new_limit;
+
+		vpr_info("new snaplen limit for CPU %d: %u\n", ring_no, new_limit);
+
+		ret = 0;
+		goto cleanup_ioctl;
+	}
 	default:
 		ret = -ENOTTY;
 		goto cleanup_ioctl;
@@ -1527,7 +1849,7 @@ static inline void record_drop_e(struct ppm_consumer_t *consumer,
 {
 	struct event_data_t event_data = {0};
 
-	if (record_event_consumer(consumer, PPME_DROP_E, UF_NEVER_DROP, ns, &event_data, INTERNAL_EVENTS) == 0) {
+	if (record_event_consumer(consumer, PPME_DROP_E, UF_NEVER_DROP, ns, &event_data, INTERNAL_EVENTS, NULL, NULL) == 0) {
 		consumer->need_to_insert_drop_e = 1;
 	} else {
 		if (consumer->need_to_insert_drop_e == 1 && !(drop_flags & UF_ATOMIC)) {
@@ -1697,7 +2019,7 @@ static inline void record_drop_x(struct ppm_consumer_t *consumer,
 {
 	struct event_data_t event_data = {0};
 
-	if (record_event_consumer(consumer, PPME_DROP_X, UF_NEVER_DROP, ns, &event_data, INTERNAL_EVENTS) == 0) {
+	if (record_event_consumer(consumer, PPME_DROP_X, UF_NEVER_DROP, ns, &event_data, INTERNAL_EVENTS, NULL, NULL) == 0) {
 		consumer->need_to_insert_drop_x = 1;
 	} else {
 		if (consumer->need_to_insert_drop_x == 1 && !(drop_flags & UF_ATOMIC)) {
@@ -1817,30 +2139,110 @@ static inline int drop_event(struct ppm_consumer_t *consumer,
 	return 0;
 }
 
+// Return true if the syscall events of the current task must be dropped
+// because its comm or its tid is suppressed. Called under rcu_read_lock()
+static inline bool drop_suppressed(struct ppm_consumer_t *consumer,
+				   ppm_sc_code ppm_sc)
+{
+	u32 n_comms = consumer->suppressed_comms.n_comms;
+	u32 j;
+
+	if (likely(n_comms == 0 && consumer->n_suppressed_tids == 0))
+		return false;
+
+	/*
+	 * Userspace needs these to track the suppressed threads, they are
+	 * filtered there.
+	 */
+	switch (ppm_sc) {
+	case PPM_SC_CLONE:
+	case PPM_SC_CLONE3:
+	case PPM_SC_FORK:
+	case PPM_SC_VFORK:
+	case PPM_SC_EXECVE:
+	case PPM_SC_EXECVEAT:
+		return false;
+	default:
+		break;
+	}
+
+	if (consumer->n_suppressed_tids > 0 && find_suppressed_tid(consumer, current->pid))
+		return true;
+
+	smp_rmb();
+	for (j = 0; j < n_comms && j < PPM_MAX_SUPPRESSED_COMMS; j++) {
+		if (strncmp(current->comm, consumer->suppressed_comms.comms[j], PPM_COMM_LEN) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * True if the fillers produce the same event for both consumers, i.e. if
+ * none of the settings they read differ.
+ */
+static inline bool same_serialization(const struct ppm_consumer_t *a,
+				      const struct ppm_consumer_t *b)
+{
+	return a->snaplen == b->snaplen &&
+	       memcmp(a->fd_type_snaplen, b->fd_type_snaplen, sizeof(a->fd_type_snaplen)) == 0 &&
+	       a->do_dynamic_snaplen == b->do_dynamic_snaplen &&
+	       a->fullcapture_port_range_start == b->fullcapture_port_range_start &&
+	       a->fullcapture_port_range_end == b->fullcapture_port_range_end &&
+	       a->statsd_port == b->statsd_port &&
+	       a->sampling_ratio == b->sampling_ratio;
+}
+
 static void record_event_all_consumers(ppm_event_code event_type,
 	enum syscall_flags drop_flags,
 	struct event_data_t *event_datap,
 				       kmod_prog_codes tp_type)
 {
 	struct ppm_consumer_t *consumer;
+	struct ppm_consumer_t *shared_consumer = NULL;
+	struct ppm_evt_hdr *shared_evt = NULL;
+	struct ppm_evt_hdr *recorded_evt;
 	nanoseconds ns = ppm_nsecs();
 
+	/*
+	 * The event is serialized by the fillers only for the first consumer
+	 * that records it, the following ones with the same settings copy it
+	 * from the ring of that one. It stays intact there until we are done:
+	 * only this CPU writes to the ring, and to reach it again the writes
+	 * would have to go around the whole buffer.
+	 */
 	rcu_read_lock();
 	list_for_each_entry_rcu(consumer, &g_consumer_list, node) {
-		record_event_consumer(consumer, event_type, drop_flags, ns, event_datap, tp_type);
+		recorded_evt = NULL;
+		if (shared_evt != NULL && same_serialization(consumer, shared_consumer)) {
+			record_event_consumer(consumer, event_type, drop_flags, ns, event_datap, tp_type, shared_evt, NULL);
+		} else {
+			record_event_consumer(consumer, event_type, drop_flags, ns, event_datap, tp_type, NULL, &recorded_evt);
+			if (shared_evt == NULL && recorded_evt != NULL) {
+				shared_consumer = consumer;
+				shared_evt = recorded_evt;
+			}
+		}
 	}
 	rcu_read_unlock();
 }
 
 /*
- * Returns 0 if the event is dropped
+ * Returns 0 if the event is dropped.
+ *
+ * If shared_evt is set, the event is copied from it instead of being
+ * serialized by the fillers. If recorded_evt is set, it gets the event
+ * written to the ring, NULL if it is dropped.
  */
 static int record_event_consumer(struct ppm_consumer_t *consumer,
 	ppm_event_code event_type,
 	enum syscall_flags drop_flags,
 	nanoseconds ns,
 	struct event_data_t *event_datap,
-				 kmod_prog_codes tp_type)
+				 kmod_prog_codes tp_type,
+				 const struct ppm_evt_hdr *shared_evt,
+				 struct ppm_evt_hdr **recorded_evt)
 {
 	int res = 0;
 	size_t event_size = 0;
@@ -1873,6 +2275,11 @@ static int record_event_consumer(struct ppm_consumer_t *consumer,
 			return res;
 		}
 
+		if (drop_suppressed(consumer, event_datap->event_info.syscall_data.cur_g_syscall_table[table_index].ppm_sc))
+		{
+			return res;
+		}
+
 		if (tp_type == KMOD_PROG_SYS_EXIT && consumer->drop_failed)
 		{
 			retval = (int64_t)syscall_get_return_value(current, event_datap->event_info.syscall_data.regs);
@@ -1886,8 +2293,8 @@ static int record_event_consumer(struct ppm_consumer_t *consumer,
 		args.syscall_id = event_datap->event_info.syscall_data.id;
 		args.cur_g_syscall_table = event_datap->event_info.syscall_data.cur_g_syscall_table;
 		args.compat = event_datap->compat;
-		/* If the syscall is interesting we need to preload params */
-		if(unlikely(preload_params(&args, event_datap->is_socketcall) == -1))
+		/* If the syscall is interesting we need to preload params, unless the fillers don't run */
+		if(shared_evt == NULL && unlikely(preload_params(&args, event_datap->is_socketcall) == -1))
 		{
 			return res;
 		}
@@ -1980,7 +2387,20 @@ static int record_event_consumer(struct ppm_consumer_t *consumer,
 	 * Make sure we have enough space for the event header.
 	 * We need at least space for the header plus 16 bit per parameter for the lengths.
 	 */
-	if (likely(freespace >= sizeof(struct ppm_evt_hdr) + args.arg_data_offset)) {
+	if (shared_evt != NULL) {
+		/*
+		 * Already serialized for another consumer, copy it as is. Like
+		 * the fillers, it can go into the cushion space at the end of
+		 * the buffer.
+		 */
+		if (likely(shared_evt->len <= min(freespace, delta_from_end))) {
+			memcpy(ring->buffer + head, shared_evt, shared_evt->len);
+			event_size = shared_evt->len;
+			drop = 0;
+		} else {
+			cbres = PPM_FAILURE_BUFFER_FULL;
+		}
+	} else if (likely(freespace >= sizeof(struct ppm_evt_hdr) + args.arg_data_offset)) {
 		/*
 		 * Populate the header
 		 */
@@ -2055,6 +2475,7 @@ static int record_event_consumer(struct ppm_consumer_t *consumer,
 		args.nevents = ring->nevents;
 		args.str_storage = ring->str_storage;
 		args.enforce_snaplen = false;
+		args.snaplen_limit = ring->snaplen_limit;
 
 		/*
 		 * Fire the filler callback
@@ -2117,6 +2538,12 @@ static int record_event_consumer(struct ppm_consumer_t *consumer,
 	if (likely(!drop)) {
 		res = 1;
 
+#ifndef PPM_ENABLE_SENTINEL
+		/* The sentinels are specific to each ring, so the events aren't shared with them */
+		if (recorded_evt != NULL)
+			*recorded_evt = (struct ppm_evt_hdr *)(ring->buffer + head);
+#endif
+
 		next = head + event_size;
 
 		if (unlikely(next >= consumer->buffer_bytes_dim)) {
@@ -2145,6 +2572,9 @@ static int record_event_consumer(struct ppm_consumer_t *consumer,
 		ring_info->head = next;
 
 		++ring->nevents;
+
+		if (unlikely(atomic_read(&consumer->ready_waiting)))
+			notify_ready(consumer, ring_info);
 	} else {
 		if (cbres == PPM_SUCCESS) {
 			ASSERT(freespace < sizeof(struct ppm_evt_hdr) + args.arg_data_offset);
@@ -2658,6 +3088,7 @@ static void reset_ring_buffer(struct ppm_ring_buffer_context *ring)
 	ring->info->n_preemptions = 0;
 	ring->info->n_context_switches = 0;
 	ring->last_print_time = ppm_nsecs();
+	ring->snaplen_limit = PPM_SNAPLEN_NO_LIMIT;
 }
 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 15, 0))
@@ -3060,6 +3491,9 @@ void scap_exit(void)
 	tracepoint_synchronize_unregister();
 #endif
 
+	/* Wait for the suppressed tids still being freed */
+	rcu_barrier();
+
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4, 10, 0))
 	if (hp_state > 0)
 		cpuhp_remove_state_nocalls(hp_state);
@@ -40,7 +40,7 @@
 #define MUNMAP_X_SIZE HEADER_LEN + sizeof(int64_t) + sizeof(uint32_t) * 3 + PARAM_LEN * 4
 #define OPEN_BY_HANDLE_AT_E_SIZE HEADER_LEN
 #define CLOSE_E_SIZE HEADER_LEN + sizeof(int64_t) + PARAM_LEN
-#define CLOSE_X_SIZE HEADER_LEN + sizeof(int64_t) + PARAM_LEN
+#define CLOSE_X_SIZE HEADER_LEN + sizeof(int64_t) * 2 + PARAM_LEN * 2
 #define COPY_FILE_RANGE_E_SIZE HEADER_LEN + sizeof(int64_t) + sizeof(uint64_t) * 2 + PARAM_LEN * 3
 #define COPY_FILE_RANGE_X_SIZE HEADER_LEN + sizeof(int64_t) * 2 + sizeof(uint64_t) + PARAM_LEN * 3
 #define DUP_E_SIZE HEADER_LEN + sizeof(int64_t) + PARAM_LEN
@@ -243,6 +243,16 @@
 #define PAGE_FAULT_SIZE HEADER_LEN + sizeof(uint64_t) * 2 + sizeof(uint32_t) + PARAM_LEN * 3
 #define SIGNAL_DELIVER_SIZE HEADER_LEN + sizeof(int64_t) * 2 + sizeof(uint8_t) + PARAM_LEN * 3
 
+/* Bounded size events: their variable size params have a known max size,
+ * so they reserve it in the ringbuf instead of going through the auxmap,
+ * and set their actual size in the header (see `ringbuf__finalize_event_header`).
+ */
+
+/* Socket family, two kernel pointers and the path of a unix socket, the largest tuple. */
+#define SOCKTUPLE_MAX_SIZE sizeof(uint8_t) + sizeof(uint64_t) * 2 + 108 + 1
+#define ACCEPT_X_MAX_SIZE HEADER_LEN + sizeof(int64_t) + SOCKTUPLE_MAX_SIZE + sizeof(uint8_t) + sizeof(uint32_t) * 2 + PARAM_LEN * 5
+#define ACCEPT4_X_MAX_SIZE HEADER_LEN + sizeof(int64_t) + SOCKTUPLE_MAX_SIZE + sizeof(uint8_t) + sizeof(uint32_t) * 2 + PARAM_LEN * 5
+
 /* Special internal events */
 #define DROP_E_SIZE HEADER_LEN + sizeof(uint32_t) + PARAM_LEN
 #define DROP_X_SIZE HEADER_LEN + sizeof(uint32_t) + PARAM_LEN
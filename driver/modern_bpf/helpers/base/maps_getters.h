@@ -61,6 +61,122 @@ static __always_inline uint16_t maps__get_statsd_port()
 	return g_settings.statsd_port;
 }
 
+static __always_inline uint32_t maps__get_wakeup_watermark()
+{
+	return g_settings.wakeup_watermark;
+}
+
+static __always_inline bool maps__get_has_fd_type_snaplen()
+{
+	return g_settings.has_fd_type_snaplen;
+}
+
+static __always_inline uint32_t maps__get_fd_type_snaplen(u32 fd_type)
+{
+	if(fd_type >= SNAPLEN_FD_TYPES)
+	{
+		return SNAPLEN_FD_TYPE_DEFAULT;
+	}
+	return g_settings.fd_type_snaplen[fd_type];
+}
+
+static __always_inline bool maps__get_has_syscall_limits()
+{
+	return g_settings.has_syscall_limits;
+}
+
+static __always_inline bool maps__get_io_aggregation()
+{
+	return g_settings.io_aggregation;
+}
+
+static __always_inline bool maps__get_task_aggregation()
+{
+	return g_settings.task_aggregation;
+}
+
+static __always_inline bool maps__get_string_interning()
+{
+	return g_settings.string_interning;
+}
+
+static __always_inline uint32_t maps__get_n_suppressed_comms()
+{
+	return g_settings.n_suppressed_comms;
+}
+
+static __always_inline bool maps__is_suppressed_tid(u32 tid)
+{
+	return bpf_map_lookup_elem(&suppressed_tids, &tid) != NULL;
+}
+
+static __always_inline uint8_t maps__get_cgroup_filter_mode()
+{
+	return g_settings.cgroup_filter_mode;
+}
+
+static __always_inline bool maps__is_filtered_cgroup(u64 cgroup_id)
+{
+	return bpf_map_lookup_elem(&cgroup_filter, &cgroup_id) != NULL;
+}
+
+/* Tells if `comm`, zero padded to `SUPPRESSED_COMM_LEN`, is one of the suppressed comms. */
+static __always_inline bool maps__is_suppressed_comm(const char *comm)
+{
+	uint32_t n_comms = maps__get_n_suppressed_comms();
+
+	for(int j = 0; j < MAX_SUPPRESSED_COMMS; j++)
+	{
+		if(j >= n_comms)
+		{
+			return false;
+		}
+
+		bool match = true;
+		for(int k = 0; k < SUPPRESSED_COMM_LEN; k++)
+		{
+			if(comm[k] != g_settings.suppressed_comms[j][k])
+			{
+				match = false;
+				break;
+			}
+		}
+
+		if(match)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Flags to use when we push an event of `event_size` bytes into the ringbuf `rb`.
+ * `reserved` tells if the event space was already reserved in the ringbuf
+ * (and so it is already counted in its unconsumed data).
+ * We notify userspace only when the unconsumed data crosses the wakeup watermark,
+ * so a consumer waiting on the ringbuf is woken up once per batch and not once per event.
+ * With a `0` watermark we never notify, userspace polls the buffers on its own.
+ */
+static __always_inline u64 maps__get_ringbuf_wakeup_flags(void *rb, u64 event_size, bool reserved)
+{
+	u32 watermark = maps__get_wakeup_watermark();
+	if(watermark == 0 || rb == NULL)
+	{
+		return BPF_RB_NO_WAKEUP;
+	}
+
+	u64 avail = bpf_ringbuf_query(rb, BPF_RB_AVAIL_DATA);
+	if(!reserved)
+	{
+		avail += event_size;
+	}
+	if(avail >= watermark && avail < watermark + event_size)
+	{
+		return BPF_RB_FORCE_WAKEUP;
+	}
+	return BPF_RB_NO_WAKEUP;
+}
+
 /*=============================== SETTINGS ===========================*/
 
 /*=============================== KERNEL CONFIGS ===========================*/
@@ -100,6 +216,33 @@ static __always_inline bool maps__64bit_interesting_syscall(u32 syscall_id)
 
 /*=============================== SYSCALL-64 INTERESTING TABLE ===========================*/
 
+/*=============================== SYSCALL-64 LIMITS TABLE ===========================*/
+
+static __always_inline struct syscall_limit *maps__64bit_syscall_limit(u32 syscall_id)
+{
+	return &g_64bit_syscall_limits[syscall_id & (SYSCALL_TABLE_SIZE - 1)];
+}
+
+/*=============================== SYSCALL-64 LIMITS TABLE ===========================*/
+
+/*=============================== SYSCALL-64 IO AGGREGATE TABLE ===========================*/
+
+static __always_inline uint8_t maps__64bit_io_aggregate_syscall(u32 syscall_id)
+{
+	return g_64bit_io_aggregate_syscalls[syscall_id & (SYSCALL_TABLE_SIZE - 1)];
+}
+
+/*=============================== SYSCALL-64 IO AGGREGATE TABLE ===========================*/
+
+/*=============================== TRACEPOINT LIMITS TABLE ===========================*/
+
+static __always_inline struct syscall_limit *maps__tracepoint_limit(u32 tp)
+{
+	return &g_tracepoint_limits[tp < LIMITED_TP_MAX ? tp : LIMITED_TP_MAX - 1];
+}
+
+/*=============================== TRACEPOINT LIMITS TABLE ===========================*/
+
 /*=============================== EVENT NUM PARAMS TABLE ===========================*/
 
 static __always_inline u8 maps__get_event_num_params(u32 event_id)
@@ -142,6 +285,133 @@ static __always_inline struct counter_map *maps__get_counter_map()
 
 /*=============================== COUNTER MAPS ===========================*/
 
+/*=============================== LIMIT MAPS ===========================*/
+
+static __always_inline struct limit_map *maps__get_limit_map()
+{
+	u32 cpu_id = (u32)bpf_get_smp_processor_id();
+	return (struct limit_map *)bpf_map_lookup_elem(&limit_maps, &cpu_id);
+}
+
+/*=============================== LIMIT MAPS ===========================*/
+
+/*=============================== SNAPLEN LIMITS ===========================*/
+
+static __always_inline uint32_t maps__get_snaplen_limit()
+{
+	if(!g_settings.has_snaplen_limits)
+	{
+		return SNAPLEN_NO_LIMIT;
+	}
+	u32 cpu_id = (u32)bpf_get_smp_processor_id();
+	u32 *limit = (u32 *)bpf_map_lookup_elem(&snaplen_limits, &cpu_id);
+	if(!limit)
+	{
+		return SNAPLEN_NO_LIMIT;
+	}
+	return *limit;
+}
+
+/*=============================== SNAPLEN LIMITS ===========================*/
+
+/*=============================== IO AGGREGATES ===========================*/
+
+/* Returns the aggregate of `key`, creating it if it doesn't exist yet.
+ * Returns NULL only if the map is full.
+ */
+static __always_inline struct io_aggregate *maps__get_io_aggregate(struct io_aggregate_key *key)
+{
+	struct io_aggregate *aggregate = bpf_map_lookup_elem(&io_aggregates, key);
+	if(aggregate != NULL)
+	{
+		return aggregate;
+	}
+
+	/* If another CPU created it in the meantime the update fails, but the lookup doesn't */
+	struct io_aggregate zero = {0};
+	bpf_map_update_elem(&io_aggregates, key, &zero, BPF_NOEXIST);
+	return bpf_map_lookup_elem(&io_aggregates, key);
+}
+
+/*=============================== IO AGGREGATES ===========================*/
+
+/*=============================== TASK AGGREGATES ===========================*/
+
+/* Returns the aggregate of `tid` on the current CPU, creating it if it
+ * doesn't exist yet. Returns NULL only if the map is full.
+ */
+static __always_inline struct task_aggregate *maps__get_task_aggregate(u32 tid)
+{
+	struct task_aggregate *aggregate = bpf_map_lookup_elem(&task_aggregates, &tid);
+	if(aggregate != NULL)
+	{
+		return aggregate;
+	}
+
+	/* The other CPUs get their own zeroed value */
+	struct task_aggregate zero = {0};
+	bpf_map_update_elem(&task_aggregates, &tid, &zero, BPF_NOEXIST);
+	return bpf_map_lookup_elem(&task_aggregates, &tid);
+}
+
+/*=============================== TASK AGGREGATES ===========================*/
+
+/*=============================== INTERNED STRINGS ===========================*/
+
+/* String interning mode: the exit events of clone, clone3, fork, vfork
+ * (caller side) and of the successful execve and execveat send the exe,
+ * comm and cgroups of the thread only if they changed since its last such
+ * event (see `auxmap__store_interned_charbuf_param`). The `interned_strings`
+ * map keeps, per tid, what was last sent:
+ *
+ * - an event gets the entry of its thread with `maps__get_interned_strings`
+ *   and flags itself with `PPM_CL_STRINGS_INTERNED` / `PPM_EXE_STRINGS_INTERNED`;
+ * - the entry is forgotten with `maps__forget_interned_strings` when the
+ *   event can't be submitted, since userspace would resolve the next strings
+ *   against ones it never got, and when a new thread starts (child side of
+ *   the clones and `sched_process_fork`), since its tid could have been
+ *   used by a thread that is gone.
+ *
+ * Events lost later, in userspace, are handled by the parser, which doesn't
+ * resolve the strings of a thread after a drop.
+ */
+
+/* Returns the strings last sent for the current thread, creating the entry
+ * if it doesn't exist yet. Returns NULL if the string interning is disabled.
+ */
+static __always_inline struct interned_strings *maps__get_interned_strings()
+{
+	if(!maps__get_string_interning())
+	{
+		return NULL;
+	}
+
+	u32 tid = (u32)bpf_get_current_pid_tgid();
+	struct interned_strings *interned = bpf_map_lookup_elem(&interned_strings, &tid);
+	if(interned != NULL)
+	{
+		return interned;
+	}
+
+	struct interned_strings zero = {0};
+	bpf_map_update_elem(&interned_strings, &tid, &zero, BPF_NOEXIST);
+	return bpf_map_lookup_elem(&interned_strings, &tid);
+}
+
+/* The next strings of `tid` are sent in full, see above for when.
+ */
+static __always_inline void maps__forget_interned_strings(u32 tid)
+{
+	if(!maps__get_string_interning())
+	{
+		return;
+	}
+
+	bpf_map_delete_elem(&interned_strings, &tid);
+}
+
+/*=============================== INTERNED STRINGS ===========================*/
+
 /*=============================== RINGBUF MAPS ===========================*/
 
 static __always_inline struct ringbuf_map *maps__get_ringbuf_map()
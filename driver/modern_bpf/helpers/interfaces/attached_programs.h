@@ -83,3 +83,73 @@ static __always_inline bool sampling_logic(void* ctx, u32 id, enum intrumentatio
 
 	return false;
 }
+
+/* Returns true if the event of a sampled or aggregated tracepoint
+ * (`LIMITED_TP_*`) must not be sent. In task aggregation mode the context
+ * switches and the page faults are counted per tid in `task_aggregates`,
+ * which userspace drains periodically, and they are sent as usual only
+ * when the map is full. Otherwise the event is dropped by the sampling or
+ * the rate limit userspace set for the tracepoint, which are enforced on
+ * every CPU as for the syscalls.
+ */
+static __always_inline bool tracepoint_limited(u32 tp)
+{
+	if(maps__get_task_aggregation())
+	{
+		struct task_aggregate *aggregate = maps__get_task_aggregate((u32)bpf_get_current_pid_tgid());
+		if(aggregate != NULL)
+		{
+			/* Per-CPU values, no atomics needed */
+			if(tp == LIMITED_TP_SCHED_SWITCH)
+			{
+				aggregate->n_switches++;
+			}
+			else
+			{
+				aggregate->n_page_faults++;
+			}
+			return true;
+		}
+	}
+
+	struct syscall_limit *limit = maps__tracepoint_limit(tp);
+	if(limit->sample_every <= 1 && limit->max_per_sec == 0)
+	{
+		return false;
+	}
+
+	struct limit_map *limit_map = maps__get_limit_map();
+	if(limit_map == NULL)
+	{
+		return false;
+	}
+
+	struct syscall_limit_state *state = &limit_map->tracepoint[tp < LIMITED_TP_MAX ? tp : LIMITED_TP_MAX - 1];
+
+	if(limit->sample_every > 1)
+	{
+		if(++state->sample_count < limit->sample_every)
+		{
+			state->n_drops++;
+			return true;
+		}
+		state->sample_count = 0;
+	}
+
+	if(limit->max_per_sec != 0)
+	{
+		u64 now = bpf_ktime_get_ns();
+		if(now - state->window_start >= SECOND_TO_NS)
+		{
+			state->window_start = now;
+			state->window_evts = 0;
+		}
+		if(state->window_evts >= limit->max_per_sec)
+		{
+			state->n_drops++;
+			return true;
+		}
+		state->window_evts++;
+	}
+	return false;
+}
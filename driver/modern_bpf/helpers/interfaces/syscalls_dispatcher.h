@@ -36,6 +36,183 @@ static __always_inline bool syscalls_dispatcher__64bit_interesting_syscall(u32 s
 	return maps__64bit_interesting_syscall(syscall_id);
 }
 
+/* Returns true if the syscall events of the current task must be dropped
+ * because its comm or its tid is suppressed. The syscalls that create or exec
+ * a task are always kept, userspace needs them to track the suppressed threads.
+ * Userspace suppresses tids only because of a comm, so without comms there is
+ * nothing to look up.
+ */
+static __always_inline bool syscalls_dispatcher__suppressed(u32 syscall_id)
+{
+	if(maps__get_n_suppressed_comms() == 0)
+	{
+		return false;
+	}
+
+	switch(maps__get_ppm_sc(syscall_id))
+	{
+	case PPM_SC_CLONE:
+	case PPM_SC_CLONE3:
+	case PPM_SC_FORK:
+	case PPM_SC_VFORK:
+	case PPM_SC_EXECVE:
+	case PPM_SC_EXECVEAT:
+		return false;
+	default:
+		break;
+	}
+
+	if(maps__is_suppressed_tid((u32)bpf_get_current_pid_tgid()))
+	{
+		return true;
+	}
+
+	char comm[SUPPRESSED_COMM_LEN] = {0};
+	if(bpf_get_current_comm(comm, sizeof(comm)) != 0)
+	{
+		return false;
+	}
+
+	return maps__is_suppressed_comm(comm);
+}
+
+/* Returns true if the syscall events of the current task must be dropped
+ * because of the cgroup it runs in. The syscalls that build up the process
+ * tree are always kept, userspace needs them to track the filtered tasks.
+ */
+static __always_inline bool syscalls_dispatcher__cgroup_filtered(u32 syscall_id)
+{
+	uint8_t mode = maps__get_cgroup_filter_mode();
+	if(mode == PPM_CGROUP_FILTER_NONE)
+	{
+		return false;
+	}
+
+	switch(maps__get_ppm_sc(syscall_id))
+	{
+	case PPM_SC_CLONE:
+	case PPM_SC_CLONE3:
+	case PPM_SC_FORK:
+	case PPM_SC_VFORK:
+	case PPM_SC_EXECVE:
+	case PPM_SC_EXECVEAT:
+	case PPM_SC_CHDIR:
+	case PPM_SC_FCHDIR:
+	case PPM_SC_CHROOT:
+	case PPM_SC_SETPGID:
+	case PPM_SC_SETSID:
+	case PPM_SC_PRCTL:
+	case PPM_SC_CAPSET:
+	case PPM_SC_SETUID:
+	case PPM_SC_SETGID:
+	case PPM_SC_SETRESUID:
+	case PPM_SC_SETRESGID:
+		return false;
+	default:
+		break;
+	}
+
+	bool listed = maps__is_filtered_cgroup(bpf_get_current_cgroup_id());
+	return mode == PPM_CGROUP_FILTER_ALLOW ? !listed : listed;
+}
+
+/* In I/O aggregation mode the aggregated read and write syscalls are summed
+ * in `io_aggregates` by (tgid, fd, direction) instead of being sent, and
+ * userspace drains the aggregates periodically. Returns true if the event is
+ * aggregated: the enter event is dropped once the aggregate of its fd exists,
+ * the exit event adds the syscall to it. When the map is full both are sent
+ * as usual.
+ */
+static __always_inline bool syscalls_dispatcher__io_aggregated(struct pt_regs *regs, u32 syscall_id, bool is_exit, long ret)
+{
+	if(!maps__get_io_aggregation())
+	{
+		return false;
+	}
+
+	uint8_t direction = maps__64bit_io_aggregate_syscall(syscall_id);
+	if(direction == 0)
+	{
+		return false;
+	}
+
+	struct io_aggregate_key key = {0};
+	key.tgid = bpf_get_current_pid_tgid() >> 32;
+	key.fd = (s32)extract__syscall_argument(regs, 0);
+	key.direction = direction;
+
+	struct io_aggregate *aggregate = maps__get_io_aggregate(&key);
+	if(aggregate == NULL)
+	{
+		return false;
+	}
+
+	if(is_exit)
+	{
+		__sync_fetch_and_add(&aggregate->count, 1);
+		if(ret > 0)
+		{
+			__sync_fetch_and_add(&aggregate->bytes, ret);
+		}
+	}
+	return true;
+}
+
+/* Returns true if the event must be dropped by the sampling or the rate limit
+ * userspace set for the syscall. Enter and exit events are limited on their
+ * own, and the rate limit is enforced on every CPU: with `max_per_sec` set to
+ * N a syscall can send up to N events per second from each CPU.
+ */
+static __always_inline bool syscalls_dispatcher__limited(u32 syscall_id, bool is_exit)
+{
+	if(!maps__get_has_syscall_limits())
+	{
+		return false;
+	}
+
+	struct syscall_limit *limit = maps__64bit_syscall_limit(syscall_id);
+	if(limit->sample_every <= 1 && limit->max_per_sec == 0)
+	{
+		return false;
+	}
+
+	struct limit_map *limit_map = maps__get_limit_map();
+	if(limit_map == NULL)
+	{
+		return false;
+	}
+
+	u32 idx = syscall_id & (SYSCALL_LIMITS_TABLE_SIZE - 1);
+	struct syscall_limit_state *state = is_exit ? &limit_map->exit[idx] : &limit_map->enter[idx];
+
+	if(limit->sample_every > 1)
+	{
+		if(++state->sample_count < limit->sample_every)
+		{
+			state->n_drops++;
+			return true;
+		}
+		state->sample_count = 0;
+	}
+
+	if(limit->max_per_sec != 0)
+	{
+		u64 now = bpf_ktime_get_ns();
+		if(now - state->window_start >= SECOND_TO_NS)
+		{
+			state->window_start = now;
+			state->window_evts = 0;
+		}
+		if(state->window_evts >= limit->max_per_sec)
+		{
+			state->n_drops++;
+			return true;
+		}
+		state->window_evts++;
+	}
+	return false;
+}
+
 #ifdef CAPTURE_SOCKETCALL
 static __always_inline long convert_network_syscalls(struct pt_regs *regs)
 {
@@ -118,21 +118,22 @@ static __always_inline void auxmap__finalize_event_header(struct auxiliary_map *
  *
  * @param auxmap pointer to the auxmap in which we have already written the entire event.
  * @param ctx BPF prog context
+ * @return true if the event is in the ringbuf.
  */
-static __always_inline void auxmap__submit_event(struct auxiliary_map *auxmap, void* ctx)
+static __always_inline bool auxmap__submit_event(struct auxiliary_map *auxmap, void* ctx)
 {
 	struct ringbuf_map *rb = maps__get_ringbuf_map();
 	if(!rb)
 	{
 		bpf_tail_call(ctx, &extra_event_prog_tail_table, T1_HOTPLUG_E);
 		bpf_printk("failed to tail call into the 'hotplug' prog");
-		return;
+		return false;
 	}
 
 	struct counter_map *counter = maps__get_counter_map();
 	if(!counter)
 	{
-		return;
+		return false;
 	}
 
 	/* This counts the event seen by the drivers even if they are dropped because the buffer is full. */
@@ -141,18 +142,21 @@ static __always_inline void auxmap__submit_event(struct auxiliary_map *auxmap, v
 	if(auxmap->payload_pos > MAX_EVENT_SIZE)
 	{
 		counter->n_drops_max_event_size++;
-		return;
+		return false;
 	}
 
-	/* `BPF_RB_NO_WAKEUP` means that we don't send to userspace a notification
-	 *  when a new event is in the buffer.
+	/* Unless userspace asked for a wakeup watermark, `BPF_RB_NO_WAKEUP` means that
+	 * we don't send to userspace a notification when a new event is in the buffer.
 	 */
-	int err = bpf_ringbuf_output(rb, auxmap->data, auxmap->payload_pos, BPF_RB_NO_WAKEUP);
+	u64 flags = maps__get_ringbuf_wakeup_flags(rb, auxmap->payload_pos, false);
+	int err = bpf_ringbuf_output(rb, auxmap->data, auxmap->payload_pos, flags);
 	if(err)
 	{
 		counter->n_drops_buffer++;
 		compute_event_types_stats(auxmap->event_type, counter);
+		return false;
 	}
+	return true;
 }
 
 /////////////////////////////////
@@ -337,6 +341,96 @@ static __always_inline u16 auxmap__store_bytebuf_param(struct auxiliary_map *aux
 	return bytebuf_len;
 }
 
+/**
+ * @brief Hash of the first `len` bytes of a param already stored at
+ * `param_pos` in the auxmap, for the string interning. Only params up
+ * to `INTERNED_CHARBUF_MAX_LEN` bytes are hashed.
+ *
+ * @param auxmap pointer to the auxmap in which the param is stored.
+ * @param param_pos position of the param in the auxmap.
+ * @param len length of the param.
+ * @return FNV-1a hash of the param, never `0`.
+ */
+static __always_inline u64 auxmap__hash_param(struct auxiliary_map *auxmap, u64 param_pos, u16 len)
+{
+	u64 hash = 14695981039346656037ULL;
+
+	for(int i = 0; i < INTERNED_CHARBUF_MAX_LEN / sizeof(u64); i++)
+	{
+		u16 offset = i * sizeof(u64);
+		if(offset >= len)
+		{
+			break;
+		}
+
+		/* The bytes after the param are leftovers of the previous events */
+		u64 word = *((u64 *)&auxmap->data[SAFE_ACCESS(param_pos + offset)]);
+		u16 left = len - offset;
+		if(left < sizeof(u64))
+		{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+			word &= ((u64)1 << (left * 8)) - 1;
+#else
+			word &= ~(((u64)1 << ((sizeof(u64) - left) * 8)) - 1);
+#endif
+		}
+		hash = (hash ^ word) * 1099511628211ULL;
+	}
+
+	hash ^= len;
+	return hash != 0 ? hash : 1;
+}
+
+/**
+ * @brief Same as `auxmap__store_charbuf_param` but in string interning
+ * mode, if the charbuf is the same as the last one sent for the thread
+ * (whose hash is in `last_hash`), it is replaced with an empty param that
+ * userspace resolves against the thread state. `last_hash` is updated with
+ * the charbuf stored.
+ *
+ * The events using it carry a `*_STRINGS_INTERNED` flag, so that userspace
+ * tells an interned param from an empty one, and the parser then takes
+ * the value the thread already has; the values actually sent become the
+ * new ones of the thread. The lifetime of `last_hash` (the
+ * `interned_strings` map) is described next to `maps__get_interned_strings`.
+ *
+ * @param auxmap pointer to the auxmap in which we are storing the param.
+ * @param charbuf_pointer pointer to the charbuf to store.
+ * @param len_to_read upper bound limit.
+ * @param mem from which memory we need to read: user-space or kernel-space.
+ * @param last_hash hash of the last charbuf sent, NULL to always send it.
+ * @return number of bytes read, even if they are not sent.
+ */
+static __always_inline u16 auxmap__store_interned_charbuf_param(struct auxiliary_map *auxmap, unsigned long charbuf_pointer, u16 len_to_read, enum read_memory mem, u64 *last_hash)
+{
+	u64 param_pos = auxmap->payload_pos;
+	u16 charbuf_len = auxmap__store_charbuf_param(auxmap, charbuf_pointer, len_to_read, mem);
+	if(!last_hash)
+	{
+		return charbuf_len;
+	}
+
+	/* Empty and long charbufs are sent as they are, and so is the next one. */
+	if(charbuf_len == 0 || charbuf_len > INTERNED_CHARBUF_MAX_LEN)
+	{
+		*last_hash = 0;
+		return charbuf_len;
+	}
+
+	u64 hash = auxmap__hash_param(auxmap, param_pos, charbuf_len);
+	if(hash != *last_hash)
+	{
+		*last_hash = hash;
+		return charbuf_len;
+	}
+
+	/* Drop the bytes just pushed and overwrite the param length. */
+	auxmap->payload_pos = param_pos;
+	auxmap->lengths_pos -= sizeof(u16);
+	push__param_len(auxmap->data, &auxmap->lengths_pos, 0);
+	return charbuf_len;
+}
+
 /**
  * @brief Use `auxmap__store_execve_exe` when you have to store the
  * `exe` name from an execve-family syscall.
@@ -1334,6 +1428,32 @@ static __always_inline void auxmap__store_cgroups_param(struct auxiliary_map *au
 	push__param_len(auxmap->data, &auxmap->lengths_pos, total_croups_len);
 }
 
+/**
+ * @brief Same as `auxmap__store_cgroups_param` but in string interning mode,
+ * if the task is still in the cgroups of the last event sent for the thread
+ * (the same `struct css_set`), it stores an empty param without walking the
+ * cgroup paths. `last_cgroups` is updated with the cgroups of the task.
+ *
+ * @param auxmap pointer to the auxmap in which we are storing the param.
+ * @param task pointer to the current task struct.
+ * @param last_cgroups `struct css_set` of the last cgroups sent, NULL to always send them.
+ */
+static __always_inline void auxmap__store_interned_cgroups_param(struct auxiliary_map *auxmap, struct task_struct *task, u64 *last_cgroups)
+{
+	if(last_cgroups)
+	{
+		struct css_set *cgroups = NULL;
+		BPF_CORE_READ_INTO(&cgroups, task, cgroups);
+		if(cgroups && (u64)cgroups == *last_cgroups)
+		{
+			auxmap__store_empty_param(auxmap);
+			return;
+		}
+		*last_cgroups = (u64)cgroups;
+	}
+	auxmap__store_cgroups_param(auxmap, task);
+}
+
 static __always_inline void auxmap__store_fdlist_param(struct auxiliary_map *auxmap, unsigned long fds_pointer, u32 nfds, enum poll_events_direction dir)
 {
 	/* In this helper we push data in this format:
@@ -1390,8 +1510,52 @@ static __always_inline void auxmap__store_fdlist_param(struct auxiliary_map *aux
 	push__param_len(auxmap->data, &auxmap->lengths_pos, sizeof(u16) + (num_pairs * (sizeof(s64) + sizeof(s16))));
 }
 
-static __always_inline void apply_dynamic_snaplen(struct pt_regs *regs, u16 *snaplen, bool only_port_range)
+/* Replace the snaplen with the one set for the kind of fd (socket, pipe or
+ * anything else) the syscall works on. Like in `apply_dynamic_snaplen` the
+ * `fd` is the first syscall argument.
+ */
+static __always_inline void apply_fd_type_snaplen(struct pt_regs *regs, u16 *snaplen)
 {
+	unsigned long args[1];
+	extract__network_args(args, 1, regs);
+
+	s32 fd = (s32)args[0];
+	if(fd < 0)
+	{
+		return;
+	}
+
+	struct file *file = extract__file_struct_from_fd(fd);
+	if(!file)
+	{
+		return;
+	}
+
+	u32 fd_type = PPM_SNAPLEN_FD_FILE;
+	umode_t i_mode = BPF_CORE_READ(file, f_inode, i_mode);
+	if(S_ISSOCK(i_mode))
+	{
+		fd_type = PPM_SNAPLEN_FD_SOCKET;
+	}
+	else if(S_ISFIFO(i_mode))
+	{
+		fd_type = PPM_SNAPLEN_FD_PIPE;
+	}
+
+	u32 fd_snaplen = maps__get_fd_type_snaplen(fd_type);
+	if(fd_snaplen != SNAPLEN_FD_TYPE_DEFAULT)
+	{
+		*snaplen = fd_snaplen;
+	}
+}
+
+static __always_inline void compute_dynamic_snaplen(struct pt_regs *regs, u16 *snaplen, bool only_port_range)
+{
+	if(maps__get_has_fd_type_snaplen())
+	{
+		apply_fd_type_snaplen(regs, snaplen);
+	}
+
 	if(!maps__get_do_dynamic_snaplen())
 	{
 		return;
@@ -1560,3 +1724,18 @@ static __always_inline void apply_dynamic_snaplen(struct pt_regs *regs, u16 *sna
 		return;
 	}
 }
+
+/* The snaplen of an I/O buffer: the global snaplen, replaced by the one of
+ * the kind of fd and by the dynamic snaplen, then capped by the snaplen limit
+ * userspace sets for the CPU while its ringbuffer is under pressure.
+ */
+static __always_inline void apply_dynamic_snaplen(struct pt_regs *regs, u16 *snaplen, bool only_port_range)
+{
+	compute_dynamic_snaplen(regs, snaplen, only_port_range);
+
+	u32 limit = maps__get_snaplen_limit();
+	if(*snaplen > limit)
+	{
+		*snaplen = limit;
+	}
+}
@@ -17,12 +17,20 @@
  */
 #define CHECK_RINGBUF_SPACE(pos, reserved_size) pos >= reserved_size ? reserved_size - sizeof(u64) : pos
 
+/* Same as `CHECK_RINGBUF_SPACE` for writes of up to `len` bytes. */
+#define CHECK_RINGBUF_SPACE_FOR(pos, reserved_size, len) pos > reserved_size - (len) ? reserved_size - (len) : pos
+
 #define PUSH_FIXED_SIZE_TO_RINGBUF(ringbuf, param, size)                                                                         \
 	__builtin_memcpy(&ringbuf->data[CHECK_RINGBUF_SPACE(ringbuf->payload_pos, ringbuf->reserved_event_size)], &param, size); \
 	ringbuf->payload_pos += size;                                                                                            \
 	*((u16 *)&ringbuf->data[CHECK_RINGBUF_SPACE(ringbuf->lengths_pos, ringbuf->reserved_event_size)]) = size;                \
 	ringbuf->lengths_pos += sizeof(u16);
 
+/* Push the bytes of a param without its length, see `ringbuf__store_socktuple_param`. */
+#define PUSH_TO_RINGBUF(ringbuf, param, size)                                                                                    \
+	__builtin_memcpy(&ringbuf->data[CHECK_RINGBUF_SPACE(ringbuf->payload_pos, ringbuf->reserved_event_size)], &param, size); \
+	ringbuf->payload_pos += size;
+
 /* Concept of ringbuf(ring buffer):
  *
  * For fixed size events we directly reserve space into the ringbuf. We have
@@ -147,6 +155,20 @@ static __always_inline void ringbuf__store_event_header(struct ringbuf_struct *r
 	ringbuf->lengths_pos = sizeof(struct ppm_evt_hdr);
 }
 
+/**
+ * @brief For the bounded size events, which reserve their max size,
+ * store the actual size of the event in the header. Userspace moves to
+ * the next event with the size of the reserved space, so the remaining
+ * bytes are skipped.
+ *
+ * @param ringbuf pointer to the `ringbuf_struct`.
+ */
+static __always_inline void ringbuf__finalize_event_header(struct ringbuf_struct *ringbuf)
+{
+	struct ppm_evt_hdr *hdr = (struct ppm_evt_hdr *)ringbuf->data;
+	hdr->len = ringbuf->payload_pos < ringbuf->reserved_event_size ? ringbuf->payload_pos : ringbuf->reserved_event_size;
+}
+
 /////////////////////////////////
 // SUBMIT EVENT IN THE RINGBUF
 ////////////////////////////////
@@ -156,13 +178,19 @@ static __always_inline void ringbuf__store_event_header(struct ringbuf_struct *r
  * terminated.
  *
  * `BPF_RB_NO_WAKEUP` option allow to not notify the userspace
- * when a new event is submitted.
+ * when a new event is submitted. The userspace is notified only
+ * if it asked for a wakeup watermark and we have just crossed it.
  *
  * @param ringbuf pointer to the `ringbuf_struct`.
  */
 static __always_inline void ringbuf__submit_event(struct ringbuf_struct *ringbuf)
 {
-	bpf_ringbuf_submit(ringbuf->data, BPF_RB_NO_WAKEUP);
+	u64 flags = BPF_RB_NO_WAKEUP;
+	if(maps__get_wakeup_watermark() != 0)
+	{
+		flags = maps__get_ringbuf_wakeup_flags(maps__get_ringbuf_map(), ringbuf->reserved_event_size, true);
+	}
+	bpf_ringbuf_submit(ringbuf->data, flags);
 }
 
 /////////////////////////////////
@@ -178,6 +206,18 @@ static __always_inline void ringbuf__submit_event(struct ringbuf_struct *ringbuf
  * `helpers/base/push_data.h` file.
  */
 
+/**
+ * @brief This helper should be used to store an empty param, it only
+ * writes a zero length into the `lengths_array`.
+ *
+ * @param ringbuf pointer to the `ringbuf_struct`.
+ */
+static __always_inline void ringbuf__store_empty_param(struct ringbuf_struct *ringbuf)
+{
+	*((u16 *)&ringbuf->data[CHECK_RINGBUF_SPACE(ringbuf->lengths_pos, ringbuf->reserved_event_size)]) = 0;
+	ringbuf->lengths_pos += sizeof(u16);
+}
+
 /**
  * @brief This helper should be used to store signed 16 bit params.
  * The following types are compatible with this helper:
@@ -284,6 +324,154 @@ static __always_inline void ringbuf__store_u64(struct ringbuf_struct *ringbuf, u
 	PUSH_FIXED_SIZE_TO_RINGBUF(ringbuf, param, sizeof(u64));
 }
 
+/**
+ * @brief Store a socktuple param, like `auxmap__store_socktuple_param`.
+ * The space for the largest tuple (`SOCKTUPLE_MAX_SIZE`) must have been
+ * reserved.
+ *
+ * @param ringbuf pointer to the `ringbuf_struct`.
+ * @param socket_fd socket from which we extract information about the tuple.
+ * @param direction specifies the connection direction.
+ */
+static __always_inline void ringbuf__store_socktuple_param(struct ringbuf_struct *ringbuf, u32 socket_fd, int direction)
+{
+	u16 final_param_len = 0;
+	u64 start_pos = ringbuf->payload_pos;
+
+	/* Get the socket family directly from the socket */
+	u16 socket_family = 0;
+	struct file *file = extract__file_struct_from_fd(socket_fd);
+	struct socket *socket = BPF_CORE_READ(file, private_data);
+	struct sock *sk = BPF_CORE_READ(socket, sk);
+	BPF_CORE_READ_INTO(&socket_family, sk, __sk_common.skc_family);
+
+	u8 family = socket_family_to_scap(socket_family);
+
+	switch(socket_family)
+	{
+	case AF_INET:
+	{
+		struct inet_sock *inet = (struct inet_sock *)sk;
+
+		u32 ipv4_local = 0;
+		u16 port_local = 0;
+		u32 ipv4_remote = 0;
+		u16 port_remote = 0;
+		BPF_CORE_READ_INTO(&ipv4_local, inet, inet_saddr);
+		BPF_CORE_READ_INTO(&port_local, inet, inet_sport);
+		BPF_CORE_READ_INTO(&ipv4_remote, sk, __sk_common.skc_daddr);
+		BPF_CORE_READ_INTO(&port_remote, sk, __sk_common.skc_dport);
+		port_local = ntohs(port_local);
+		port_remote = ntohs(port_remote);
+
+		PUSH_TO_RINGBUF(ringbuf, family, FAMILY_SIZE);
+		if(direction == OUTBOUND)
+		{
+			PUSH_TO_RINGBUF(ringbuf, ipv4_local, IPV4_SIZE);
+			PUSH_TO_RINGBUF(ringbuf, port_local, PORT_SIZE);
+			PUSH_TO_RINGBUF(ringbuf, ipv4_remote, IPV4_SIZE);
+			PUSH_TO_RINGBUF(ringbuf, port_remote, PORT_SIZE);
+		}
+		else
+		{
+			PUSH_TO_RINGBUF(ringbuf, ipv4_remote, IPV4_SIZE);
+			PUSH_TO_RINGBUF(ringbuf, port_remote, PORT_SIZE);
+			PUSH_TO_RINGBUF(ringbuf, ipv4_local, IPV4_SIZE);
+			PUSH_TO_RINGBUF(ringbuf, port_local, PORT_SIZE);
+		}
+		break;
+	}
+
+	case AF_INET6:
+	{
+		struct inet_sock *inet = (struct inet_sock *)sk;
+
+		u32 ipv6_local[4] = {0, 0, 0, 0};
+		u16 port_local = 0;
+		u32 ipv6_remote[4] = {0, 0, 0, 0};
+		u16 port_remote = 0;
+		BPF_CORE_READ_INTO(&ipv6_local, inet, pinet6, saddr);
+		BPF_CORE_READ_INTO(&port_local, inet, inet_sport);
+		BPF_CORE_READ_INTO(&ipv6_remote, sk, __sk_common.skc_v6_daddr);
+		BPF_CORE_READ_INTO(&port_remote, sk, __sk_common.skc_dport);
+		port_local = ntohs(port_local);
+		port_remote = ntohs(port_remote);
+
+		PUSH_TO_RINGBUF(ringbuf, family, FAMILY_SIZE);
+		if(direction == OUTBOUND)
+		{
+			PUSH_TO_RINGBUF(ringbuf, ipv6_local, IPV6_SIZE);
+			PUSH_TO_RINGBUF(ringbuf, port_local, PORT_SIZE);
+			PUSH_TO_RINGBUF(ringbuf, ipv6_remote, IPV6_SIZE);
+			PUSH_TO_RINGBUF(ringbuf, port_remote, PORT_SIZE);
+		}
+		else
+		{
+			PUSH_TO_RINGBUF(ringbuf, ipv6_remote, IPV6_SIZE);
+			PUSH_TO_RINGBUF(ringbuf, port_remote, PORT_SIZE);
+			PUSH_TO_RINGBUF(ringbuf, ipv6_local, IPV6_SIZE);
+			PUSH_TO_RINGBUF(ringbuf, port_local, PORT_SIZE);
+		}
+		break;
+	}
+
+	case AF_UNIX:
+	{
+		struct unix_sock *socket_local = (struct unix_sock *)sk;
+		struct unix_sock *socket_remote = (struct unix_sock *)BPF_CORE_READ(socket_local, peer);
+		char *path = NULL;
+		u64 first = 0;
+		u64 second = 0;
+
+		if(direction == OUTBOUND)
+		{
+			first = (u64)socket_remote;
+			second = (u64)socket_local;
+			path = BPF_CORE_READ(socket_remote, addr, name[0].sun_path);
+		}
+		else
+		{
+			first = (u64)socket_local;
+			second = (u64)socket_remote;
+			path = BPF_CORE_READ(socket_local, addr, name[0].sun_path);
+		}
+
+		PUSH_TO_RINGBUF(ringbuf, family, FAMILY_SIZE);
+		PUSH_TO_RINGBUF(ringbuf, first, KERNEL_POINTER);
+		PUSH_TO_RINGBUF(ringbuf, second, KERNEL_POINTER);
+
+		unsigned long start_reading_point;
+		char first_path_byte = *(char *)path;
+		if(first_path_byte == '\0')
+		{
+			/* This is an abstract socket address, we need to skip the initial `\0`. */
+			start_reading_point = (unsigned long)path + 1;
+		}
+		else
+		{
+			start_reading_point = (unsigned long)path;
+		}
+
+		int written_bytes = bpf_probe_read_kernel_str(&ringbuf->data[CHECK_RINGBUF_SPACE_FOR(ringbuf->payload_pos, ringbuf->reserved_event_size, MAX_UNIX_SOCKET_PATH)],
+							      MAX_UNIX_SOCKET_PATH,
+							      (char *)start_reading_point);
+		if(written_bytes > 0)
+		{
+			ringbuf->payload_pos += written_bytes;
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	// if we are not able to catch correct programs we push an empty param.
+	final_param_len = ringbuf->payload_pos - start_pos;
+	*((u16 *)&ringbuf->data[CHECK_RINGBUF_SPACE(ringbuf->lengths_pos, ringbuf->reserved_event_size)]) = final_param_len;
+	ringbuf->lengths_pos += sizeof(u16);
+}
+
 /**
  * @brief Store the size of a message extracted from an `iovec` struct array.
  *
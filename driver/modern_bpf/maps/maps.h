@@ -73,6 +73,25 @@ __weak uint8_t g_64bit_sampling_syscall_table[SYSCALL_TABLE_SIZE];
 /// TOOD: we need to change the dimension! we need to create a dedicated enum for tracepoints!
 __weak uint8_t g_64bit_sampling_tracepoint_table[PPM_EVENT_MAX];
 
+/**
+ * @brief Given the syscall id on 64-bit-architectures returns its sampling
+ * and rate limit, all zeros if the syscall is not limited.
+ */
+__weak struct syscall_limit g_64bit_syscall_limits[SYSCALL_TABLE_SIZE];
+
+/**
+ * @brief Given the syscall id on 64-bit-architectures returns the
+ * direction (`PPM_IO_AGGREGATE_READ` or `PPM_IO_AGGREGATE_WRITE`)
+ * of the syscall in I/O aggregation mode, `0` if it is not aggregated.
+ */
+__weak uint8_t g_64bit_io_aggregate_syscalls[SYSCALL_TABLE_SIZE];
+
+/**
+ * @brief Given the `LIMITED_TP_*` index returns the sampling and
+ * rate limit of the tracepoint, all zeros if it is not limited.
+ */
+__weak struct syscall_limit g_tracepoint_limits[LIMITED_TP_MAX];
+
 /**
  * @brief Global capture settings shared between userspace and
  * bpf programs.
@@ -172,8 +191,106 @@ struct
 	__type(value, struct counter_map);
 } counter_maps __weak SEC(".maps");
 
+/**
+ * @brief For every CPU on the system we have a limit
+ * map with the state of the per-syscall sampling and rate
+ * limits, and the number of events they dropped.
+ */
+struct
+{
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__type(key, u32);
+	__type(value, struct limit_map);
+} limit_maps __weak SEC(".maps");
+
+/**
+ * @brief For every CPU on the system the cap of the snaplen
+ * of the events it sends, lowered by userspace while the
+ * ringbuffer of the CPU is filling up. Only read when
+ * `g_settings.has_snaplen_limits` is set.
+ */
+struct
+{
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__type(key, u32);
+	__type(value, u32);
+} snaplen_limits __weak SEC(".maps");
+
 /*=============================== BPF_MAP_TYPE_ARRAY ===============================*/
 
+/*=============================== BPF_MAP_TYPE_HASH ===============================*/
+
+/**
+ * @brief Threads whose syscall events are dropped, kept in sync by userspace
+ * with the threads it suppresses. The key is the tid, the value is unused.
+ */
+struct
+{
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, PPM_MAX_SUPPRESSED_TIDS);
+	__type(key, u32);
+	__type(value, u8);
+} suppressed_tids __weak SEC(".maps");
+
+/**
+ * @brief I/O aggregation mode: bytes and syscalls of every
+ * (tgid, fd, direction), drained periodically by userspace.
+ */
+struct
+{
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, IO_AGGREGATES_MAX);
+	__type(key, struct io_aggregate_key);
+	__type(value, struct io_aggregate);
+} io_aggregates __weak SEC(".maps");
+
+/**
+ * @brief Cgroups listed in the cgroup filter, see `g_settings.cgroup_filter_mode`.
+ * The key is the cgroup id, the value is unused.
+ */
+struct
+{
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, PPM_MAX_CGROUP_FILTER_IDS);
+	__type(key, u64);
+	__type(value, u8);
+} cgroup_filter __weak SEC(".maps");
+
+/*=============================== BPF_MAP_TYPE_HASH ===============================*/
+
+/*=============================== BPF_MAP_TYPE_LRU_HASH ===============================*/
+
+/**
+ * @brief String interning mode: the strings last sent for every tid,
+ * see `struct interned_strings`. The key is the tid.
+ */
+struct
+{
+	__uint(type, BPF_MAP_TYPE_LRU_HASH);
+	__uint(max_entries, INTERNED_STRINGS_MAX);
+	__type(key, u32);
+	__type(value, struct interned_strings);
+} interned_strings __weak SEC(".maps");
+
+/*=============================== BPF_MAP_TYPE_LRU_HASH ===============================*/
+
+/*=============================== BPF_MAP_TYPE_PERCPU_HASH ===============================*/
+
+/**
+ * @brief Task aggregation mode: context switches and page faults
+ * of every tid, drained periodically by userspace, which sums the
+ * values of the CPUs. The key is the tid.
+ */
+struct
+{
+	__uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+	__uint(max_entries, TASK_AGGREGATES_MAX);
+	__type(key, u32);
+	__type(value, struct task_aggregate);
+} task_aggregates __weak SEC(".maps");
+
+/*=============================== BPF_MAP_TYPE_PERCPU_HASH ===============================*/
+
 /*=============================== RINGBUF MAP ===============================*/
 
 /**
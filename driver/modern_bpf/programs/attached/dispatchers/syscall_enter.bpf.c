@@ -47,6 +47,26 @@ int BPF_PROG(sys_enter,
 		return 0;
 	}
 
+	if(syscalls_dispatcher__suppressed(syscall_id))
+	{
+		return 0;
+	}
+
+	if(syscalls_dispatcher__cgroup_filtered(syscall_id))
+	{
+		return 0;
+	}
+
+	if(syscalls_dispatcher__io_aggregated(regs, syscall_id, false, 0))
+	{
+		return 0;
+	}
+
+	if(syscalls_dispatcher__limited(syscall_id, false))
+	{
+		return 0;
+	}
+
 	bpf_tail_call(ctx, &syscall_enter_tail_table, syscall_id);
 	return 0;
 }
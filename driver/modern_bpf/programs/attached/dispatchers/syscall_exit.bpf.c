@@ -52,6 +52,26 @@ int BPF_PROG(sys_exit,
 		return 0;
 	}
 
+	if(syscalls_dispatcher__suppressed(syscall_id))
+	{
+		return 0;
+	}
+
+	if(syscalls_dispatcher__cgroup_filtered(syscall_id))
+	{
+		return 0;
+	}
+
+	if(syscalls_dispatcher__io_aggregated(regs, syscall_id, true, ret))
+	{
+		return 0;
+	}
+
+	if(syscalls_dispatcher__limited(syscall_id, true))
+	{
+		return 0;
+	}
+
 	bpf_tail_call(ctx, &syscall_exit_tail_table, syscall_id);
 
 	return 0;
@@ -23,6 +23,11 @@ int BPF_PROG(pf_user,
 		return 0;
 	}
 
+	if(tracepoint_limited(LIMITED_TP_PAGE_FAULT_USER))
+	{
+		return 0;
+	}
+
 	struct ringbuf_struct ringbuf;
 	if(!ringbuf__reserve_space(&ringbuf, ctx, PAGE_FAULT_SIZE, PPME_PAGE_FAULT_E))
 	{
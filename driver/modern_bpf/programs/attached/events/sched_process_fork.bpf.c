@@ -47,6 +47,9 @@ int BPF_PROG(sched_p_fork,
 	struct ppm_evt_hdr *hdr = (struct ppm_evt_hdr *)auxmap->data;
 	hdr->tid = (u64)child_pid;
 
+	/* In string interning mode a new thread starts sending all its strings */
+	maps__forget_interned_strings((u32)child_pid);
+
 	/* Parameter 1: res (type: PT_ERRNO) */
 	/* Please note: here we are in the clone child exit
 	 * event, so the return value will be always 0.
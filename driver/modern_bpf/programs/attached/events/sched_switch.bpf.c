@@ -14,6 +14,11 @@ int BPF_PROG(sched_switch,
 	{
 		return 0;
 	}
+
+	if(tracepoint_limited(LIMITED_TP_SCHED_SWITCH))
+	{
+		return 0;
+	}
 	
 	/// TODO: we could avoid switches from kernel threads to kernel threads (?).
 
@@ -47,18 +47,19 @@ int BPF_PROG(accept4_x,
 	     struct pt_regs *regs,
 	     long ret)
 {
-	struct auxiliary_map *auxmap = auxmap__get();
-	if(!auxmap)
+	/* The tuple is the only variable size param, and it is bounded. */
+	struct ringbuf_struct ringbuf;
+	if(!ringbuf__reserve_space(&ringbuf, ctx, ACCEPT4_X_MAX_SIZE, PPME_SOCKET_ACCEPT4_6_X))
 	{
 		return 0;
 	}
 
-	auxmap__preload_event_header(auxmap, PPME_SOCKET_ACCEPT4_6_X);
+	ringbuf__store_event_header(&ringbuf);
 
 	/*=============================== COLLECT PARAMETERS  ===========================*/
 
 	/* Parameter 1: fd (type: PT_FD) */
-	auxmap__store_s64_param(auxmap, ret);
+	ringbuf__store_s64(&ringbuf, ret);
 
 	/* If the syscall `connect` succeeds, it creates a new connected socket
 	 * with file descriptor `ret` and we can get some parameters, otherwise we return
@@ -77,7 +78,7 @@ int BPF_PROG(accept4_x,
 	/* Parameter 2: tuple (type: PT_SOCKTUPLE) */
 	if(ret >= 0)
 	{
-		auxmap__store_socktuple_param(auxmap, (s32)ret, INBOUND);
+		ringbuf__store_socktuple_param(&ringbuf, (s32)ret, INBOUND);
 
 		/* Collect parameters at the beginning to  manage socketcalls */
 		unsigned long args[1];
@@ -102,23 +103,23 @@ int BPF_PROG(accept4_x,
 	}
 	else
 	{
-		auxmap__store_empty_param(auxmap);
+		ringbuf__store_empty_param(&ringbuf);
 	}
 
 	/* Parameter 3: queuepct (type: PT_UINT8) */
-	auxmap__store_u8_param(auxmap, queuepct);
+	ringbuf__store_u8(&ringbuf, queuepct);
 
 	/* Parameter 4: queuelen (type: PT_UINT32) */
-	auxmap__store_u32_param(auxmap, queuelen);
+	ringbuf__store_u32(&ringbuf, queuelen);
 
 	/* Parameter 5: queuemax (type: PT_UINT32) */
-	auxmap__store_u32_param(auxmap, queuemax);
+	ringbuf__store_u32(&ringbuf, queuemax);
 
 	/*=============================== COLLECT PARAMETERS  ===========================*/
 
-	auxmap__finalize_event_header(auxmap);
+	ringbuf__finalize_event_header(&ringbuf);
 
-	auxmap__submit_event(auxmap, ctx);
+	ringbuf__submit_event(&ringbuf);
 
 	return 0;
 }
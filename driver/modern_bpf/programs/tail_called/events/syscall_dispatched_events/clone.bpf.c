@@ -70,6 +70,17 @@ int BPF_PROG(clone_x,
 
 	struct task_struct *task = get_current_task();
 
+	/* String interning, see `maps__get_interned_strings`. */
+	struct interned_strings *interned = NULL;
+	if(ret > 0)
+	{
+		interned = maps__get_interned_strings();
+	}
+	else if(ret == 0)
+	{
+		maps__forget_interned_strings((u32)bpf_get_current_pid_tgid());
+	}
+
 	/* We can extract `exe` (Parameter 2) and `args`(Parameter 3) only if the
 	 * syscall doesn't fail. Otherwise, they will send empty parameters.
 	 */
@@ -91,7 +102,7 @@ int BPF_PROG(clone_x,
 		/* We need to extract the len of `exe` arg so we can understand
 		 * the overall length of the remaining args.
 		 */
-		u16 exe_arg_len = auxmap__store_charbuf_param(auxmap, arg_start_pointer, MAX_PROC_EXE, USER);
+		u16 exe_arg_len = auxmap__store_interned_charbuf_param(auxmap, arg_start_pointer, MAX_PROC_EXE, USER, interned ? &interned->exe : NULL);
 
 		/* Parameter 3: args (type: PT_CHARBUFARRAY) */
 		/* Here we read all the array starting from the pointer to the first
@@ -160,7 +171,7 @@ int BPF_PROG(clone_x,
 	auxmap__store_u32_param(auxmap, vm_swap);
 
 	/* Parameter 14: comm (type: PT_CHARBUF) */
-	auxmap__store_charbuf_param(auxmap, (unsigned long)task->comm, TASK_COMM_LEN, KERNEL);
+	auxmap__store_interned_charbuf_param(auxmap, (unsigned long)task->comm, TASK_COMM_LEN, KERNEL, interned ? &interned->comm : NULL);
 
 	/*=============================== COLLECT PARAMETERS  ===========================*/
 
@@ -186,8 +197,14 @@ int BPF_PROG(t1_clone_x,
 
 	struct task_struct *task = get_current_task();
 
+	struct interned_strings *interned = NULL;
+	if(ret > 0)
+	{
+		interned = maps__get_interned_strings();
+	}
+
 	/* Parameter 15: cgroups (type: PT_CHARBUFARRAY) */
-	auxmap__store_cgroups_param(auxmap, task);
+	auxmap__store_interned_cgroups_param(auxmap, task, interned ? &interned->cgroups : NULL);
 
 	/* Parameter 16: flags (type: PT_FLAGS32) */
 	/* Different architectures have different signatures of the clone syscall:
@@ -202,7 +219,12 @@ int BPF_PROG(t1_clone_x,
 #else
 	unsigned long flags = extract__syscall_argument(regs, 0);
 #endif
-	auxmap__store_u32_param(auxmap, (u32)extract__clone_flags(task, flags));
+	u32 ppm_flags = (u32)extract__clone_flags(task, flags);
+	if(interned)
+	{
+		ppm_flags |= PPM_CL_STRINGS_INTERNED;
+	}
+	auxmap__store_u32_param(auxmap, ppm_flags);
 
 	/* Parameter 17: uid (type: PT_UINT32) */
 	u32 euid = 0;
@@ -253,7 +275,11 @@ int BPF_PROG(t2_clone_x,
 
 	auxmap__finalize_event_header(auxmap);
 
-	auxmap__submit_event(auxmap, ctx);
+	/* Userspace can't resolve the next strings against ones it never got */
+	if(!auxmap__submit_event(auxmap, ctx) && ret > 0)
+	{
+		maps__forget_interned_strings((u32)bpf_get_current_pid_tgid());
+	}
 	return 0;
 }
 
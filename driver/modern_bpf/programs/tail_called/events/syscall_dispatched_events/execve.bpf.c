@@ -71,6 +71,13 @@ int BPF_PROG(execve_x,
 
 	struct task_struct *task = get_current_task();
 
+	/* String interning, see `maps__get_interned_strings`. */
+	struct interned_strings *interned = NULL;
+	if(ret == 0)
+	{
+		interned = maps__get_interned_strings();
+	}
+
 	/* In case of success we take `exe` and `args` directly from the kernel
 	 * otherwise we get them from the syscall arguments.
 	 */
@@ -92,7 +99,7 @@ int BPF_PROG(execve_x,
 		/* We need to extract the len of `exe` arg so we can undestand
 		 * the overall length of the remaining args.
 		 */
-		u16 exe_arg_len = auxmap__store_charbuf_param(auxmap, arg_start_pointer, MAX_PROC_EXE, USER);
+		u16 exe_arg_len = auxmap__store_interned_charbuf_param(auxmap, arg_start_pointer, MAX_PROC_EXE, USER, interned ? &interned->exe : NULL);
 
 		/* Parameter 3: args (type: PT_CHARBUFARRAY) */
 		/* Here we read the whole array starting from the pointer to the first
@@ -168,7 +175,7 @@ int BPF_PROG(execve_x,
 	auxmap__store_u32_param(auxmap, vm_swap);
 
 	/* Parameter 14: comm (type: PT_CHARBUF) */
-	auxmap__store_charbuf_param(auxmap, (unsigned long)task->comm, TASK_COMM_LEN, KERNEL);
+	auxmap__store_interned_charbuf_param(auxmap, (unsigned long)task->comm, TASK_COMM_LEN, KERNEL, interned ? &interned->comm : NULL);
 
 	/*=============================== COLLECT PARAMETERS  ===========================*/
 
@@ -194,8 +201,14 @@ int BPF_PROG(t1_execve_x,
 
 	struct task_struct *task = get_current_task();
 
+	struct interned_strings *interned = NULL;
+	if(ret == 0)
+	{
+		interned = maps__get_interned_strings();
+	}
+
 	/* Parameter 15: cgroups (type: PT_CHARBUFARRAY) */
-	auxmap__store_cgroups_param(auxmap, task);
+	auxmap__store_interned_cgroups_param(auxmap, task, interned ? &interned->cgroups : NULL);
 
 	/* In case of success we take `env` directly from the kernel
 	 * otherwise we get them from the syscall arguments.
@@ -249,6 +262,10 @@ int BPF_PROG(t1_execve_x,
 	{
 		flags |= PPM_EXE_UPPER_LAYER;
 	}
+	if(interned)
+	{
+		flags |= PPM_EXE_STRINGS_INTERNED;
+	}
 	auxmap__store_u32_param(auxmap, flags);
 
 	/* Parameter 21: cap_inheritable (type: PT_UINT64) */
@@ -286,7 +303,11 @@ int BPF_PROG(t1_execve_x,
 
 	auxmap__finalize_event_header(auxmap);
 
-	auxmap__submit_event(auxmap, ctx);
+	/* Userspace can't resolve the next strings against ones it never got */
+	if(!auxmap__submit_event(auxmap, ctx) && ret == 0)
+	{
+		maps__forget_interned_strings((u32)bpf_get_current_pid_tgid());
+	}
 	return 0;
 }
 
@@ -77,6 +77,10 @@ int BPF_PROG(write_x,
 	unsigned long data_pointer = extract__syscall_argument(regs, 1);
 	auxmap__store_bytebuf_param(auxmap, data_pointer, snaplen, USER);
 
+	/* Parameter 3: fd (type: PT_FD) */
+	s32 fd = (s32)extract__syscall_argument(regs, 0);
+	auxmap__store_s64_param(auxmap, (s64)fd);
+
 	/*=============================== COLLECT PARAMETERS  ===========================*/
 
 	auxmap__finalize_event_header(auxmap);
@@ -17,6 +17,53 @@
  */
 #define AUXILIARY_MAP_SIZE 128 * 1024
 
+/* Size of the suppressed comms in the settings, they must match the ones of
+ * `struct ppm_suppressed_comms`.
+ */
+#define MAX_SUPPRESSED_COMMS 8
+#define SUPPRESSED_COMM_LEN 16
+
+/* Number of kinds of fds with their own snaplen and value that means "use
+ * the global snaplen", they must match `enum ppm_snaplen_fd_type` and
+ * `PPM_SNAPLEN_FD_TYPE_DEFAULT`.
+ */
+#define SNAPLEN_FD_TYPES 3
+#define SNAPLEN_FD_TYPE_DEFAULT 0xffffffff
+
+/* Value of `snaplen_limits` that leaves the snaplen alone, it must match
+ * `PPM_SNAPLEN_NO_LIMIT`.
+ */
+#define SNAPLEN_NO_LIMIT 0xffffffff
+
+/* Number of syscalls that can be limited, it must match `SYSCALL_TABLE_SIZE`. */
+#define SYSCALL_LIMITS_TABLE_SIZE 512
+
+/* Maximum number of I/O aggregates, when they are all in use the
+ * aggregated syscalls are sent as usual.
+ */
+#define IO_AGGREGATES_MAX 16384
+
+/* Tracepoints that can be sampled and rate limited like the syscalls,
+ * indexes of `g_tracepoint_limits`.
+ */
+#define LIMITED_TP_SCHED_SWITCH 0
+#define LIMITED_TP_PAGE_FAULT_USER 1
+#define LIMITED_TP_PAGE_FAULT_KERNEL 2
+#define LIMITED_TP_MAX 3
+
+/* Maximum number of task aggregates, when they are all in use the
+ * aggregated tracepoints are sent as usual.
+ */
+#define TASK_AGGREGATES_MAX 16384
+
+/* Maximum number of threads whose last strings are remembered by the
+ * string interning, the least recently used ones are forgotten.
+ */
+#define INTERNED_STRINGS_MAX 65536
+
+/* Longer `exe` and `comm` params are always sent, even in string interning mode. */
+#define INTERNED_CHARBUF_MAX_LEN 256
+
 /**
  * @brief General settings shared among all the CPUs.
  *
@@ -32,6 +79,37 @@ struct capture_settings
 	uint16_t fullcapture_port_range_start; /* first interesting port */
 	uint16_t fullcapture_port_range_end;   /* last interesting port */
 	uint16_t statsd_port;		       /* port for statsd metrics */
+	uint32_t wakeup_watermark;	       /* notify userspace when the unconsumed data in a ringbuf crosses this size, 0 to never notify */
+	uint32_t n_suppressed_comms;	       /* number of valid entries in `suppressed_comms` */
+	char suppressed_comms[MAX_SUPPRESSED_COMMS][SUPPRESSED_COMM_LEN]; /* drop the syscall events of these comms, zero padded */
+	uint32_t fd_type_snaplen[SNAPLEN_FD_TYPES]; /* replace `snaplen` for some kinds of fds, `SNAPLEN_FD_TYPE_DEFAULT` to keep it */
+	bool has_fd_type_snaplen;	       /* true if at least one `fd_type_snaplen` is not `SNAPLEN_FD_TYPE_DEFAULT` */
+	bool has_syscall_limits;	       /* true if at least one syscall is sampled or rate limited */
+	bool io_aggregation;		       /* sum the aggregated I/O syscalls in `io_aggregates` instead of sending them */
+	bool has_snaplen_limits;	       /* true if `snaplen_limits` is initialized and caps the snaplen of some CPUs */
+	uint8_t cgroup_filter_mode;	       /* `enum ppm_cgroup_filter_mode` of the cgroups listed in `cgroup_filter` */
+	bool task_aggregation;		       /* count the context switches and page faults per tid in `task_aggregates` instead of sending them */
+	bool string_interning;		       /* send empty the clone/execve strings that didn't change since the last event of the thread */
+};
+
+/**
+ * @brief String interning mode: the strings of the last clone/execve exit
+ * event sent for a thread. `0` means that the next value is always sent.
+ */
+struct interned_strings
+{
+	uint64_t exe;	  /* hash of the last `exe` param */
+	uint64_t comm;	  /* hash of the last `comm` param */
+	uint64_t cgroups; /* `struct css_set` of the last `cgroups` param */
+};
+
+/**
+ * @brief Sampling and rate limit of a syscall, set by userspace.
+ */
+struct syscall_limit
+{
+	uint32_t sample_every; /* keep one event every `sample_every`, `0` or `1` to keep them all. */
+	uint32_t max_per_sec;  /* keep at most `max_per_sec` events per second on every CPU, `0` for no limit. */
 };
 
 /**
@@ -76,3 +154,57 @@ struct counter_map
 	uint64_t n_drops_buffer_other_interest_exit;	 /* Category of other system calls of interest, not all other system calls that did not match a category from above. */
 	uint64_t n_drops_max_event_size; /* Number of drops due to an excessive event size (>64KB). */
 };
+
+/**
+ * @brief State of the limit of a syscall, in one direction, on one CPU.
+ */
+struct syscall_limit_state
+{
+	uint64_t window_start; /* start of the current one-second window in ns. */
+	uint32_t window_evts;  /* events kept in the current window. */
+	uint32_t sample_count; /* events seen since the last one kept by the sampling. */
+	uint64_t n_drops;      /* events dropped by the sampling or by the rate limit. */
+};
+
+/**
+ * @brief These per-cpu maps carry the state of the syscall limits,
+ * enter and exit events are limited on their own, and of the
+ * tracepoint limits.
+ */
+struct limit_map
+{
+	struct syscall_limit_state enter[SYSCALL_LIMITS_TABLE_SIZE];
+	struct syscall_limit_state exit[SYSCALL_LIMITS_TABLE_SIZE];
+	struct syscall_limit_state tracepoint[LIMITED_TP_MAX];
+};
+
+/**
+ * @brief Key of the I/O aggregates, the direction is
+ * `PPM_IO_AGGREGATE_READ` or `PPM_IO_AGGREGATE_WRITE`.
+ */
+struct io_aggregate_key
+{
+	uint32_t tgid;
+	int32_t fd;
+	uint8_t direction;
+	uint8_t pad[3];
+};
+
+/**
+ * @brief I/O syscalls summed since userspace last drained the aggregate.
+ */
+struct io_aggregate
+{
+	uint64_t count; /* number of syscalls. */
+	uint64_t bytes; /* bytes read or written. */
+};
+
+/**
+ * @brief Context switches and page faults of a thread since userspace
+ * last drained the aggregate, counted on each CPU on its own.
+ */
+struct task_aggregate
+{
+	uint64_t n_switches;	/* times the thread was switched out. */
+	uint64_t n_page_faults; /* user and kernel page faults. */
+};
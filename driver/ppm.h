@@ -54,6 +54,7 @@ struct ppm_ring_buffer_context {
 	atomic_t preempt_count;
 #endif	
 	char *str_storage;	/* String storage. Size is one page. */
+	u32 snaplen_limit;	/* Cap of the I/O buffers written to this ring, see PPM_IOCTL_SET_RING_SNAPLEN */
 };
 
 #define STR_STORAGE_SIZE PAGE_SIZE
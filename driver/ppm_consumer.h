@@ -11,6 +11,13 @@ or GPL2.txt for full copies of the license.
 #define CONSUMER_H_
 
 #include <linux/types.h>
+#include <linux/list.h>
+#include <linux/wait.h>
+#include <linux/irq_work.h>
+
+#include "ppm_events_public.h"
+
+#define PPM_SUPPRESSED_TIDS_BUCKETS 256
 
 struct ppm_consumer_t {
 	unsigned int id; // numeric id for the consumer (ie: registration index)
@@ -21,12 +28,19 @@ struct ppm_consumer_t {
 	struct ppm_ring_buffer_context *ring_buffers;
 #endif
 	u32 snaplen;
+	/* Replace snaplen for some kinds of fds, indexed by enum ppm_snaplen_fd_type */
+	u32 fd_type_snaplen[PPM_SNAPLEN_FD_MAX];
 	u32 sampling_ratio;
 	bool do_dynamic_snaplen;
 	u32 sampling_interval;
 	int is_dropping;
 	int dropping_mode;
 	bool drop_failed;
+	struct ppm_suppressed_comms suppressed_comms;
+	/* Suppressed threads hashed by tid: the tracepoints walk them under rcu,
+	 * the ioctls change them holding g_consumer_mutex */
+	struct list_head suppressed_tids[PPM_SUPPRESSED_TIDS_BUCKETS];
+	u32 n_suppressed_tids;
 	volatile int need_to_insert_drop_e;
 	volatile int need_to_insert_drop_x;
 	struct list_head node;
@@ -36,6 +50,13 @@ struct ppm_consumer_t {
 	unsigned long buffer_bytes_dim; /* Every consumer will have its per-CPU buffer dim in bytes. */
 	DECLARE_BITMAP(syscalls_mask, SYSCALL_TABLE_SIZE);
 	u32 tracepoints_attached;
+	/* PPM_IOCTL_WAIT_READY_CPUS: the consumer sleeps on ready_wq while ready_waiting is set.
+	 * The tracepoints can run with the scheduler locks held, so they wake it up through
+	 * ready_work instead of calling wake_up() */
+	wait_queue_head_t ready_wq;
+	struct irq_work ready_work;
+	atomic_t ready_waiting;
+	u32 ready_watermark;
 };
 
 typedef struct ppm_consumer_t ppm_consumer_t;
@@ -340,6 +340,55 @@ inline int sock_getname(struct socket* sock, struct sockaddr* sock_address, int
 #endif
 }
 
+/*
+ * Return the snaplen the consumer set for the kind of args->fd (socket, pipe
+ * or anything else), or its global snaplen if there is none. The fd is only
+ * looked up when at least one kind has its own snaplen.
+ */
+static u32 fd_type_snaplen(struct event_filler_arguments *args)
+{
+	const u32 *snaplens = args->consumer->fd_type_snaplen;
+	u32 res = args->consumer->snaplen;
+	struct file *file;
+	struct inode *inode;
+	int fd_type;
+
+	if (likely(snaplens[PPM_SNAPLEN_FD_FILE] == PPM_SNAPLEN_FD_TYPE_DEFAULT &&
+		   snaplens[PPM_SNAPLEN_FD_SOCKET] == PPM_SNAPLEN_FD_TYPE_DEFAULT &&
+		   snaplens[PPM_SNAPLEN_FD_PIPE] == PPM_SNAPLEN_FD_TYPE_DEFAULT))
+		return res;
+
+	if (args->fd < 0)
+		return res;
+
+	file = fget(args->fd);
+	if (!file)
+		return res;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 9, 0)
+	inode = file->f_inode;
+#elif LINUX_VERSION_CODE <= KERNEL_VERSION(2,6,20)
+	inode = file->f_dentry ? file->f_dentry->d_inode : NULL;
+#else
+	inode = file->f_path.dentry ? file->f_path.dentry->d_inode : NULL;
+#endif
+
+	if (inode) {
+		if (S_ISSOCK(inode->i_mode))
+			fd_type = PPM_SNAPLEN_FD_SOCKET;
+		else if (S_ISFIFO(inode->i_mode))
+			fd_type = PPM_SNAPLEN_FD_PIPE;
+		else
+			fd_type = PPM_SNAPLEN_FD_FILE;
+
+		if (snaplens[fd_type] != PPM_SNAPLEN_FD_TYPE_DEFAULT)
+			res = snaplens[fd_type];
+	}
+
+	fput(file);
+	return res;
+}
+
 /**
  * Compute the snaplen for the arguments.
  *
@@ -347,7 +396,8 @@ inline int sock_getname(struct socket* sock, struct sockaddr* sock_address, int
  * Normally, the driver performs a dynamic calculation to figure out snaplen
  * per-event. However, if this calculation is disabled
  * (i.e. args->consumer->do_dynamic_snaplen == false), the snaplen will always
- * be args->consumer->snaplen.
+ * be args->consumer->snaplen, or the snaplen set for the kind of fd (see
+ * fd_type_snaplen()), which also replaces it in the steps below.
  *
  * If dynamic snaplen is enabled, here's how the calculation works:
  *
@@ -364,7 +414,7 @@ inline int sock_getname(struct socket* sock, struct sockaddr* sock_address, int
  */
 inline u32 compute_snaplen(struct event_filler_arguments *args, char *buf, u32 lookahead_size)
 {
-	u32 res = args->consumer->snaplen;
+	u32 res = fd_type_snaplen(args);
 	int err;
 	struct socket *sock;
 	sa_family_t family;
@@ -374,12 +424,12 @@ inline u32 compute_snaplen(struct event_filler_arguments *args, char *buf, u32 l
 	u16 min_port = 0, max_port = 0;
 	u32 dynamic_snaplen = SNAPLEN_EXTENDED;
 
-	if (args->consumer->snaplen > dynamic_snaplen) {
+	if (res > dynamic_snaplen) {
 		/*
 		 * If the user requested a default snaplen greater than the custom
 		 * snaplen given to certain applications, just use the greater value.
 		 */
-		dynamic_snaplen = args->consumer->snaplen;
+		dynamic_snaplen = res;
 	}
 
 	/* Increase snaplen on writes to /dev/null */
@@ -814,6 +864,8 @@ int val_to_ring(struct event_filler_arguments *args, uint64_t val, u32 val_len,
 
 #ifndef UDIG
 						sl = compute_snaplen(args, args->buffer + args->arg_data_offset, dpi_lookahead_size);
+						if (unlikely(sl > args->snaplen_limit))
+							sl = args->snaplen_limit;
 #endif
 						if (val_len > sl)
 							val_len = sl;
@@ -843,6 +895,8 @@ int val_to_ring(struct event_filler_arguments *args, uint64_t val, u32 val_len,
 					u32 sl = args->consumer->snaplen;
 #else
 					u32 sl = compute_snaplen(args, (char *)(syscall_arg_t)val, val_len);
+					if (unlikely(sl > args->snaplen_limit))
+						sl = args->snaplen_limit;
 #endif
 					if (val_len > sl)
 						val_len = sl;
@@ -1015,6 +1069,130 @@ send_empty_sock_param:
 	return PPM_SUCCESS;
 }
 
+/*
+ * Size of the parameters of fixed size types, 0 for the others
+ */
+static inline u32 fixed_param_size(enum ppm_param_type type)
+{
+	switch (type) {
+	case PT_FLAGS8:
+	case PT_ENUMFLAGS8:
+	case PT_UINT8:
+	case PT_SIGTYPE:
+	case PT_INT8:
+		return sizeof(u8);
+	case PT_FLAGS16:
+	case PT_ENUMFLAGS16:
+	case PT_UINT16:
+	case PT_SYSCALLID:
+	case PT_INT16:
+		return sizeof(u16);
+	case PT_FLAGS32:
+	case PT_UINT32:
+	case PT_MODE:
+	case PT_UID:
+	case PT_GID:
+	case PT_SIGSET:
+	case PT_ENUMFLAGS32:
+	case PT_INT32:
+		return sizeof(u32);
+	case PT_RELTIME:
+	case PT_ABSTIME:
+	case PT_UINT64:
+	case PT_INT64:
+	case PT_ERRNO:
+	case PT_FD:
+	case PT_PID:
+		return sizeof(u64);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Push the next n parameters. When their types in g_event_info all have a
+ * fixed size, which is the case of most of the high volume events, they
+ * are checked against the buffer and written with their lengths in one
+ * pass, instead of going through val_to_ring for each of them. Otherwise
+ * this falls back to val_to_ring, with fromuser for every parameter.
+ */
+int32_t vals_to_ring(struct event_filler_arguments *args, const u64 *vals, u32 n, bool fromuser)
+{
+	const struct ppm_param_info *params;
+	u16 *psize;
+	char *data;
+	u32 total = 0;
+	u32 size;
+	u32 j;
+	int32_t res;
+
+	if (unlikely(args->curarg + n > args->nargs))
+		goto slow;
+
+	params = &g_event_info[args->event_type].params[args->curarg];
+	for (j = 0; j < n; j++) {
+		size = fixed_param_size(params[j].type);
+		if (unlikely(size == 0))
+			goto slow;
+		total += size;
+	}
+
+	/* Let val_to_ring find the parameter that doesn't fit */
+	if (unlikely(total > args->arg_data_size))
+		goto slow;
+
+	psize = (u16 *)(args->buffer + args->curarg * sizeof(u16));
+	data = args->buffer + args->arg_data_offset;
+	for (j = 0; j < n; j++) {
+		size = fixed_param_size(params[j].type);
+
+		/* Same conversions as val_to_ring */
+		switch (params[j].type) {
+		case PT_INT8:
+			*(s8 *)data = (s8)(long)vals[j];
+			break;
+		case PT_INT16:
+			*(s16 *)data = (s16)(long)vals[j];
+			break;
+		case PT_INT32:
+			*(s32 *)data = (s32)(long)vals[j];
+			break;
+		case PT_INT64:
+		case PT_ERRNO:
+		case PT_FD:
+		case PT_PID:
+			*(s64 *)data = (s64)(long)vals[j];
+			break;
+		default:
+			if (size == sizeof(u8))
+				*(u8 *)data = (u8)vals[j];
+			else if (size == sizeof(u16))
+				*(u16 *)data = (u16)vals[j];
+			else if (size == sizeof(u32))
+				*(u32 *)data = (u32)vals[j];
+			else
+				*(u64 *)data = (u64)vals[j];
+			break;
+		}
+
+		psize[j] = (u16)size;
+		data += size;
+	}
+
+	args->curarg += n;
+	args->arg_data_offset += total;
+	args->arg_data_size -= total;
+	return PPM_SUCCESS;
+
+slow:
+	for (j = 0; j < n; j++) {
+		res = val_to_ring(args, vals[j], 0, fromuser, 0);
+		if (unlikely(res != PPM_SUCCESS))
+			return res;
+	}
+	return PPM_SUCCESS;
+}
+
 /*
 static struct socket *ppm_sockfd_lookup_light(int fd, int *err, int *fput_needed)
 {
@@ -1481,6 +1659,14 @@ int32_t parse_readv_writev_bufs(struct event_filler_arguments *args, const struc
 
 	targetbuf += copylen;
 	targetbuflen -= copylen;
+#ifndef UDIG
+	/*
+	 * Don't copy from userspace what the snaplen limit of the ring would
+	 * throw away anyway.
+	 */
+	if (unlikely(args->snaplen_limit < targetbuflen - 1))
+		targetbuflen = args->snaplen_limit + 1;
+#endif
 
 	/*
 	 * Size
@@ -1622,6 +1808,8 @@ int32_t compat_parse_readv_writev_bufs(struct event_filler_arguments *args, cons
 
 	targetbuf += copylen;
 	targetbuflen -= copylen;
+	if (unlikely(args->snaplen_limit < targetbuflen - 1))
+		targetbuflen = args->snaplen_limit + 1;
 
 	/*
 	 * Size
@@ -1735,46 +1923,50 @@ int32_t compat_parse_readv_writev_bufs(struct event_filler_arguments *args, cons
 int f_sys_autofill(struct event_filler_arguments *args)
 {
 	int res;
-	syscall_arg_t val;
+	u64 vals[PPM_MAX_AUTOFILL_ARGS];
 	u32 j;
-	int64_t retval;
+#ifdef UDIG
+	syscall_arg_t syscall_args[6] = {0};
+#endif
 
 	const struct ppm_event_entry *evinfo = &g_ppm_events[args->event_type];
 	ASSERT(evinfo->n_autofill_args <= PPM_MAX_AUTOFILL_ARGS);
 
+#ifdef UDIG
+	ppm_syscall_get_arguments(current, args->regs, syscall_args);
+#endif
+
+	/*
+	 * Gather the values first, so that the usual fixed size parameters
+	 * are pushed in one go. The return value and the default values are
+	 * never user pointers, so fromuser can be set for all of them.
+	 */
 	for (j = 0; j < evinfo->n_autofill_args; j++) {
 		if (evinfo->autofill_args[j].id >= 0) {
 #ifdef UDIG
-		{
-			syscall_arg_t syscall_args[6] = {0};
-			ppm_syscall_get_arguments(current, args->regs, syscall_args);
-			val = syscall_args[evinfo->autofill_args[j].id];
-		}
+			vals[j] = syscall_args[evinfo->autofill_args[j].id];
 #else
-			val = args->args[evinfo->autofill_args[j].id];
+			vals[j] = args->args[evinfo->autofill_args[j].id];
 #endif
-			res = val_to_ring(args, val, 0, true, 0);
-			if (unlikely(res != PPM_SUCCESS))
-				return res;
 		} else if (evinfo->autofill_args[j].id == AF_ID_RETVAL) {
 			/*
 			 * Return value
 			 */
-			retval = (int64_t)(long)syscall_get_return_value(current, args->regs);
-			res = val_to_ring(args, retval, 0, false, 0);
-			if (unlikely(res != PPM_SUCCESS))
-				return res;
+			vals[j] = (int64_t)(long)syscall_get_return_value(current, args->regs);
 		} else if (evinfo->autofill_args[j].id == AF_ID_USEDEFAULT) {
 			/*
 			 * Default Value
 			 */
-			res = val_to_ring(args, evinfo->autofill_args[j].default_val, 0, false, 0);
-			if (unlikely(res != PPM_SUCCESS))
-				return res;
+			vals[j] = evinfo->autofill_args[j].default_val;
 		} else {
 			ASSERT(false);
+			vals[j] = 0;
 		}
 	}
 
+	res = vals_to_ring(args, vals, evinfo->n_autofill_args, true);
+	if (unlikely(res != PPM_SUCCESS))
+		return res;
+
 	return add_sentinel(args);
 }
@@ -72,6 +72,9 @@ struct event_filler_arguments {
 #endif
 	int fd; /* Passed by some of the fillers to val_to_ring to compute the snaplen dynamically */
 	bool enforce_snaplen;
+#ifndef UDIG
+	u32 snaplen_limit; /* Snaplen limit of the ring the event goes to */
+#endif
 #ifndef UDIG
 	int signo; /* Signal number */
 	__kernel_pid_t spid; /* PID of source process */
@@ -101,6 +104,7 @@ extern const struct ppm_event_entry g_ppm_events[];
 int32_t dpi_lookahead_init(void);
 int32_t push_empty_param(struct event_filler_arguments *args);
 int32_t val_to_ring(struct event_filler_arguments *args, u64 val, u32 val_len, bool fromuser, u8 dyn_idx);
+int32_t vals_to_ring(struct event_filler_arguments *args, const u64 *vals, u32 n, bool fromuser);
 u16 pack_addr(struct sockaddr *usrsockaddr, int ulen, char *targetbuf, u16 targetbufsize);
 u16 fd_to_socktuple(int fd, struct sockaddr *usrsockaddr, int ulen, bool use_userdata, bool is_inbound, char *targetbuf, u16 targetbufsize);
 int addr_to_kernel(void __user *uaddr, int ulen, struct sockaddr *kaddr);
@@ -172,6 +172,8 @@ or GPL2.txt for full copies of the license.
 									in the init pid namespace */
 #define PPM_CL_IS_MAIN_THREAD (1 << 30)	/* libsinsp-specific flag. Set if this is the main thread */
 										/* in envs where main thread tid != pid.*/
+#define PPM_CL_STRINGS_INTERNED (1U << 31)	/* empty exe, comm and cgroups params are the ones */
+										/* of the previous event of the caller (modern BPF string interning) */
 
 /*
  * Futex Operations
@@ -614,6 +616,7 @@ or GPL2.txt for full copies of the license.
  */
 #define PPM_EXE_WRITABLE		(1 << 0)
 #define PPM_EXE_UPPER_LAYER 	(1 << 1)
+#define PPM_EXE_STRINGS_INTERNED	(1 << 2)	/* empty exe, comm and cgroups params are the ones of the previous event of the thread */
   
 /*
  * Execveat flags
@@ -872,6 +875,12 @@ or GPL2.txt for full copies of the license.
 
 #define PPM_PR_SET_VMA		0x53564d41
 
+/*
+ * Direction of the I/O summed in an ioaggregate event
+ */
+#define PPM_IO_AGGREGATE_READ	1
+#define PPM_IO_AGGREGATE_WRITE	2
+
 
 /*
  * SuS says limits have to be unsigned.
@@ -1366,7 +1375,11 @@ typedef enum {
 	PPME_SYSCALL_SIGNALFD4_X = 399,
 	PPME_SYSCALL_PRCTL_E = 400,
 	PPME_SYSCALL_PRCTL_X = 401,
-	PPM_EVENT_MAX = 402
+	PPME_IO_AGGREGATE_E = 402,
+	PPME_IO_AGGREGATE_X = 403,
+	PPME_TASK_AGGREGATE_E = 404,
+	PPME_TASK_AGGREGATE_X = 405,
+	PPM_EVENT_MAX = 406
 } ppm_event_code;
 /*@}*/
 
@@ -2035,6 +2048,12 @@ struct ppm_evt_hdr {
 #define PPM_IOCTL_DISABLE_TP _IO(PPM_IOCTL_MAGIC, 32)
 #define PPM_IOCTL_ENABLE_DROPFAILED _IO(PPM_IOCTL_MAGIC, 33)
 #define PPM_IOCTL_DISABLE_DROPFAILED _IO(PPM_IOCTL_MAGIC, 34)
+#define PPM_IOCTL_SET_SUPPRESSED_COMMS _IO(PPM_IOCTL_MAGIC, 35)
+#define PPM_IOCTL_SUPPRESS_TID _IO(PPM_IOCTL_MAGIC, 36)
+#define PPM_IOCTL_UNSUPPRESS_TID _IO(PPM_IOCTL_MAGIC, 37)
+#define PPM_IOCTL_SET_FD_TYPE_SNAPLEN _IO(PPM_IOCTL_MAGIC, 38)
+#define PPM_IOCTL_WAIT_READY_CPUS _IO(PPM_IOCTL_MAGIC, 39)
+#define PPM_IOCTL_SET_RING_SNAPLEN _IO(PPM_IOCTL_MAGIC, 40)
 #endif // CYGWING_AGENT
 
 extern const struct ppm_name_value socket_families[];
@@ -2081,6 +2100,7 @@ extern const struct ppm_name_value fsconfig_cmds[];
 extern const struct ppm_name_value epoll_create1_flags[];
 extern const struct ppm_name_value fchownat_flags[];
 extern const struct ppm_name_value prctl_options[];
+extern const struct ppm_name_value io_aggregate_directions[];
 
 extern const struct ppm_param_info sockopt_dynamic_param[];
 extern const struct ppm_param_info ptrace_dynamic_param[];
@@ -2101,6 +2121,98 @@ struct ppm_proclist_info {
 	struct ppm_proc_info entries[0];
 };
 
+/*!
+  \brief Processes whose syscall events are dropped by the drivers, as passed
+  to the PPM_IOCTL_SET_SUPPRESSED_COMMS IOCTL. Each comm is NUL terminated and
+  zero padded to PPM_COMM_LEN bytes, so that it can be compared to the
+  current task comm one word at a time.
+*/
+#define PPM_MAX_SUPPRESSED_COMMS 8
+#define PPM_COMM_LEN 16
+
+struct ppm_suppressed_comms {
+	uint32_t n_comms;
+	char comms[PPM_MAX_SUPPRESSED_COMMS][PPM_COMM_LEN];
+};
+
+/*!
+  \brief Maximum number of threads whose syscall events are dropped by the
+  drivers, set one by one with the PPM_IOCTL_SUPPRESS_TID and
+  PPM_IOCTL_UNSUPPRESS_TID IOCTLs.
+*/
+#define PPM_MAX_SUPPRESSED_TIDS 16384
+
+/*!
+  \brief Kinds of file descriptors that can have their own snaplen, replacing
+  the global one for the I/O buffers read from or written to them. Sockets
+  can still get a bigger snaplen from the dynamic snaplen and the fullcapture
+  port range. PPM_SNAPLEN_FD_FILE covers everything that is neither a socket
+  nor a pipe.
+*/
+enum ppm_snaplen_fd_type {
+	PPM_SNAPLEN_FD_FILE = 0,
+	PPM_SNAPLEN_FD_SOCKET = 1,
+	PPM_SNAPLEN_FD_PIPE = 2,
+	PPM_SNAPLEN_FD_MAX = 3,
+};
+
+/*!
+  \brief Snaplen value that makes a kind of fd go back to the global snaplen.
+*/
+#define PPM_SNAPLEN_FD_TYPE_DEFAULT 0xffffffff
+
+/*!
+  \brief Argument of the PPM_IOCTL_SET_FD_TYPE_SNAPLEN IOCTL.
+*/
+struct ppm_fd_type_snaplen {
+	uint32_t fd_type; ///< One of enum ppm_snaplen_fd_type
+	uint32_t snaplen; ///< Up to SNAPLEN_MAX, or PPM_SNAPLEN_FD_TYPE_DEFAULT
+};
+
+/*!
+  \brief Snaplen limit that leaves the snaplen of a ring buffer alone.
+
+  The PPM_IOCTL_SET_RING_SNAPLEN IOCTL, issued on the device of a ring buffer,
+  caps the I/O buffers of the events written to that ring to the given number
+  of bytes, whatever snaplen they get from the global, the per-fd-type or the
+  dynamic snaplen. Userspace lowers it while the ring is filling up, so that
+  the driver copies less data when it has the least time to do it.
+*/
+#define PPM_SNAPLEN_NO_LIMIT 0xffffffff
+
+/*!
+  \brief Argument of the PPM_IOCTL_WAIT_READY_CPUS IOCTL.
+
+  The caller sleeps until the buffer of at least one CPU holds `watermark`
+  bytes, or for `timeout_ms` at most, then gets the bitmap of the CPUs whose
+  buffer is not empty, so that it only has to visit those.
+*/
+struct ppm_ready_cpus {
+	uint32_t watermark; ///< Bytes a buffer must hold to wake up the caller, 0 means any event
+	uint32_t timeout_ms; ///< Maximum time to sleep, 0 doesn't sleep at all
+	uint32_t n_words; ///< Size of `mask` in 64-bit words
+	uint32_t n_ready; ///< Out: number of CPUs with a non-empty buffer
+	uint64_t mask; ///< User pointer to the bitmap, bit N is set if the buffer of CPU N is not empty
+};
+
+/*!
+  \brief Modes of the cgroup filter of the BPF drivers, which drops the syscall
+  events of the tasks by the id of their cgroup (the inode number of the
+  cgroup v2 directory) before they are serialized. The syscalls that build up
+  the process tree (clone, execve, setuid, ...) are always kept, so that
+  userspace still tracks the filtered tasks.
+*/
+enum ppm_cgroup_filter_mode {
+	PPM_CGROUP_FILTER_NONE = 0, ///< No filtering
+	PPM_CGROUP_FILTER_ALLOW = 1, ///< Keep only the tasks of the listed cgroups
+	PPM_CGROUP_FILTER_DENY = 2, ///< Drop the tasks of the listed cgroups
+};
+
+/*!
+  \brief Maximum number of cgroups listed in the cgroup filter.
+*/
+#define PPM_MAX_CGROUP_FILTER_IDS 4096
+
 enum syscall_flags {
 	UF_NONE = 0,
 	UF_USED = (1 << 0),
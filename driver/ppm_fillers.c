@@ -391,16 +391,18 @@ int f_sys_read_e(struct event_filler_arguments *args)
 	unsigned long val = 0;
 	int res = 0;
 	s32 fd = 0;
+	u64 vals[2];
 
 	/* Parameter 1: fd (type: PT_FD) */
 	syscall_get_arguments_deprecated(args, 0, 1, &val);
 	fd = (s32)val;
-	res = val_to_ring(args, (s64)fd, 0, false, 0);
-	CHECK_RES(res);
+	vals[0] = (s64)fd;
 
 	/* Parameter 2: size (type: PT_UINT32) */
 	syscall_get_arguments_deprecated(args, 2, 1, &val);
-	res = val_to_ring(args, val, 0, false, 0);
+	vals[1] = val;
+
+	res = vals_to_ring(args, vals, 2, false);
 	CHECK_RES(res);
 
 	return add_sentinel(args);
@@ -454,6 +456,10 @@ int f_sys_read_x(struct event_filler_arguments *args)
 	if (unlikely(res != PPM_SUCCESS))
 		return res;
 
+	/* Parameter 3: fd (type: PT_FD) */
+	res = val_to_ring(args, (s64)args->fd, 0, false, 0);
+	CHECK_RES(res);
+
 	return add_sentinel(args);
 }
 
@@ -462,16 +468,18 @@ int f_sys_write_e(struct event_filler_arguments *args)
 	unsigned long val = 0;
 	int res = 0;
 	s32 fd = 0;
+	u64 vals[2];
 
 	/* Parameter 1: fd (type: PT_FD) */
 	syscall_get_arguments_deprecated(args, 0, 1, &val);
 	fd = (s32)val;
-	res = val_to_ring(args, (s64)fd, 0, false, 0);
-	CHECK_RES(res);
+	vals[0] = (s64)fd;
 
 	/* Parameter 2: size (type: PT_UINT32) */
 	syscall_get_arguments_deprecated(args, 2, 1, &val);
-	res = val_to_ring(args, val, 0, false, 0);
+	vals[1] = val;
+
+	res = vals_to_ring(args, vals, 2, false);
 	CHECK_RES(res);
 
 	return add_sentinel(args);
@@ -505,6 +513,10 @@ int f_sys_write_x(struct event_filler_arguments *args)
 	res = val_to_ring(args, val, bufsize, true, 0);
 	CHECK_RES(res);
 
+	/* Parameter 3: fd (type: PT_FD) */
+	res = val_to_ring(args, (s64)args->fd, 0, false, 0);
+	CHECK_RES(res);
+
 	return add_sentinel(args);
 }
 
@@ -3205,28 +3217,27 @@ int f_sys_futex_e(struct event_filler_arguments *args)
 {
 	int res;
 	unsigned long val;
+	u64 vals[3];
 
 	/*
 	 * addr
 	 */
 	syscall_get_arguments_deprecated(args, 0, 1, &val);
-	res = val_to_ring(args, val, 0, false, 0);
-	if (unlikely(res != PPM_SUCCESS))
-		return res;
+	vals[0] = val;
 
 	/*
 	 * op
 	 */
 	syscall_get_arguments_deprecated(args, 1, 1, &val);
-	res = val_to_ring(args, (unsigned long)futex_op_to_scap(val), 0, false, 0);
-	if (unlikely(res != PPM_SUCCESS))
-		return res;
+	vals[1] = (unsigned long)futex_op_to_scap(val);
 
 	/*
 	 * val
 	 */
 	syscall_get_arguments_deprecated(args, 2, 1, &val);
-	res = val_to_ring(args, val, 0, false, 0);
+	vals[2] = val;
+
+	res = vals_to_ring(args, vals, 3, false);
 	if (unlikely(res != PPM_SUCCESS))
 		return res;
 
@@ -6698,11 +6709,19 @@ int f_sys_close_e(struct event_filler_arguments *args)
 int f_sys_close_x(struct event_filler_arguments *args)
 {
 	int64_t res = 0;
+	unsigned long val = 0;
+	s32 fd = 0;
 
 	/* Parameter 1: res (type: PT_ERRNO)*/
 	res = (int64_t)syscall_get_return_value(current, args->regs);
 	res = val_to_ring(args, res, 0, false, 0);
 	CHECK_RES(res);
+
+	/* Parameter 2: fd (type: PT_FD)*/
+	syscall_get_arguments_deprecated(args, 0, 1, &val);
+	fd = (s32)val;
+	res = val_to_ring(args, (s64)fd, 0, false, 0);
+	CHECK_RES(res);
 	return add_sentinel(args);
 }
 
@@ -0,0 +1,82 @@
+#include "../../event_class/event_class.h"
+
+#include <chrono>
+
+#if defined(__NR_close) && defined(__NR_fchdir)
+
+/* Syscalls generated between two drains of the buffers, so that we never
+ * measure the cost of a full buffer.
+ */
+#define OVERHEAD_BATCH 1000
+#define OVERHEAD_ITERATIONS 100
+
+/* Returns the mean time of `syscall(syscall_id, -1)` in ns. Buffers are
+ * drained between two batches, outside the measured time.
+ */
+static double measure_ns_per_syscall(event_test* evt_test, int syscall_id)
+{
+	std::chrono::nanoseconds elapsed(0);
+
+	for(int i = 0; i < OVERHEAD_ITERATIONS; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for(int j = 0; j < OVERHEAD_BATCH; j++)
+		{
+			syscall(syscall_id, -1);
+		}
+		elapsed += std::chrono::steady_clock::now() - start;
+		evt_test->clear_ring_buffers();
+	}
+
+	return (double)elapsed.count() / (OVERHEAD_BATCH * OVERHEAD_ITERATIONS);
+}
+
+TEST(Actions, syscall_overhead_fixed_size_events)
+{
+	/* Not a strict assertion: this prints the ns/syscall of two syscalls
+	 * with the same fixed-size events. In the bpf probe `close` is filled
+	 * directly by the syscall program while `fchdir` still goes through the
+	 * filler tail calls, so comparing them (or running this test against two
+	 * versions of a driver) shows the cost of the event collection.
+	 */
+	auto close_test = get_syscall_event_test(__NR_close, ENTER_EVENT);
+	double close_baseline = measure_ns_per_syscall(close_test.get(), __NR_close);
+	close_test->enable_capture();
+	double close_captured = measure_ns_per_syscall(close_test.get(), __NR_close);
+	assert_syscall_state(SYSCALL_FAILURE, "close", syscall(__NR_close, -1));
+	close_test->disable_capture();
+	close_test->assert_event_presence();
+	close_test.reset();
+
+	auto fchdir_test = get_syscall_event_test(__NR_fchdir, ENTER_EVENT);
+	double fchdir_baseline = measure_ns_per_syscall(fchdir_test.get(), __NR_fchdir);
+	fchdir_test->enable_capture();
+	double fchdir_captured = measure_ns_per_syscall(fchdir_test.get(), __NR_fchdir);
+	assert_syscall_state(SYSCALL_FAILURE, "fchdir", syscall(__NR_fchdir, -1));
+	fchdir_test->disable_capture();
+	fchdir_test->assert_event_presence();
+
+	std::cout << "close:  " << close_baseline << " ns/syscall without capture, " << close_captured << " ns/syscall with capture" << std::endl;
+	std::cout << "fchdir: " << fchdir_baseline << " ns/syscall without capture, " << fchdir_captured << " ns/syscall with capture" << std::endl;
+}
+#endif
+
+#if defined(__NR_accept4)
+TEST(Actions, syscall_overhead_bounded_size_events)
+{
+	/* Not a strict assertion: `accept4` exit events have a bounded size, so
+	 * the modern probe writes them straight into the ring buffer instead of
+	 * copying them from the auxiliary map. Running this test against two
+	 * versions of a driver shows the cost of the event collection.
+	 */
+	auto evt_test = get_syscall_event_test(__NR_accept4, EXIT_EVENT);
+	double baseline = measure_ns_per_syscall(evt_test.get(), __NR_accept4);
+	evt_test->enable_capture();
+	double captured = measure_ns_per_syscall(evt_test.get(), __NR_accept4);
+	assert_syscall_state(SYSCALL_FAILURE, "accept4", syscall(__NR_accept4, -1, NULL, NULL, 0));
+	evt_test->disable_capture();
+	evt_test->assert_event_presence();
+
+	std::cout << "accept4: " << baseline << " ns/syscall without capture, " << captured << " ns/syscall with capture" << std::endl;
+}
+#endif
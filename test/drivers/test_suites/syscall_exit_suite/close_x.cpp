@@ -33,8 +33,11 @@ TEST(SyscallExit, closeX)
 	/* Parameter 1: ret (type: PT_ERRNO)*/
 	evt_test->assert_numeric_param(1, errno_value);
 
+	/* Parameter 2: fd (type: PT_FD) */
+	evt_test->assert_numeric_param(2, (int64_t)invalid_fd);
+
 	/*=============================== ASSERT PARAMETERS  ===========================*/
 
-	evt_test->assert_num_params_pushed(1);
+	evt_test->assert_num_params_pushed(2);
 }
 #endif
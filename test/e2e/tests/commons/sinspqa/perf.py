@@ -0,0 +1,201 @@
+import json
+import os
+import signal
+from datetime import datetime
+from time import sleep
+from subprocess import Popen, PIPE
+
+import docker
+
+from sinspqa import is_containerized, BTF_IS_AVAILABLE
+from sinspqa import sinsp
+
+# Arguments of sinsp-example for a benchmark run: no output per event, a JSON
+# report when it gets interrupted
+BENCH_ARGS = ['-B', '-J', '-I', '0']
+
+
+def load_ruleset(path: str) -> str:
+    """
+    Reads a ruleset, one filter condition per line, and returns the filter
+    matching any of them, as the filter of the agent.
+
+    Parameters:
+        path (str): The path to the ruleset, '#' starts a comment.
+    Returns:
+        The disjunction of the conditions of the ruleset.
+    """
+    conditions = []
+    with open(path, 'r') as f:
+        for line in f:
+            line = line.split('#', 1)[0].strip()
+            if line:
+                conditions.append(f'({line})')
+
+    return ' or '.join(conditions)
+
+
+def generate_specs(filter: str) -> list:
+    """
+    Generates the specs of sinsp-example in benchmark mode with the given
+    filter, one for each driver available, like sinsp.generate_specs.
+    """
+    args = BENCH_ARGS + ['-f', filter]
+    bpf_args = args + ['-b', os.environ.get('BPF_PROBE')]
+    modern_bpf_args = args + ['-m']
+
+    kernel_module_env = {'KERNEL_MODULE': os.environ.get('KERNEL_MODULE', '')}
+    bpf_env = {'BPF_PROBE': os.environ.get('BPF_PROBE', '')}
+
+    specs = []
+    if is_containerized():
+        specs.append(sinsp.container_spec(args=args, env=kernel_module_env))
+        specs.append(sinsp.container_spec(args=bpf_args, env=bpf_env))
+        if BTF_IS_AVAILABLE:
+            specs.append(sinsp.container_spec(args=modern_bpf_args))
+    else:
+        path = os.environ.get('SINSP_EXAMPLE_PATH', '')
+        specs.append(sinsp.process_spec(path, args, kernel_module_env))
+        specs.append(sinsp.process_spec(path, bpf_args, bpf_env))
+        if BTF_IS_AVAILABLE:
+            specs.append(sinsp.process_spec(path, modern_bpf_args, {}))
+
+    return specs
+
+
+def parse_report(output: str) -> dict:
+    """
+    Returns the JSON report printed by sinsp-example in benchmark mode, the
+    last line of its output starting with '{'.
+    """
+    for line in reversed(output.splitlines()):
+        line = line.strip()
+        if line.startswith('{'):
+            return json.loads(line)
+
+    raise AssertionError(f'no benchmark report in the output of sinsp-example:\n{output}')
+
+
+class Agent:
+    """
+    sinsp-example in benchmark mode, either in a container or as a regular
+    process.
+    """
+
+    def __init__(self, docker_client: docker.client.DockerClient, spec: dict):
+        self.spec = spec
+        self.container = None
+        self.process = None
+
+        if is_containerized():
+            self.container = docker_client.containers.run(
+                spec['image'],
+                spec['args'],
+                name='sinsp',
+                detach=True,
+                privileged=spec['privileged'],
+                mounts=spec['mounts'],
+                environment=spec['env'],
+                pid_mode=spec['pid_mode'],
+                network_mode=spec['network_mode'],
+            )
+        else:
+            env = os.environ.copy()
+            env.update(spec['env'])
+            self.process = Popen([spec['path']] + spec['args'], env=env,
+                                 stdout=PIPE, universal_newlines=True)
+
+        # Let the agent open the driver and scan /proc before the workload starts
+        sleep(spec.get('init_wait', 0))
+
+    def stop(self, timeout: int = 60) -> dict:
+        """
+        Interrupts the agent and returns its report.
+        """
+        if self.container is not None:
+            self.container.kill('SIGINT')
+            self.container.wait(timeout=timeout)
+            output = self.container.logs().decode('utf-8')
+            self.container.remove()
+        else:
+            self.process.send_signal(signal.SIGINT)
+            output, _ = self.process.communicate(timeout=timeout)
+            assert self.process.returncode == 0, f'sinsp-example terminated with code {self.process.returncode}'
+
+        return parse_report(output)
+
+
+def run_workload(docker_client: docker.client.DockerClient, workload: dict, timeout: int = 300) -> float:
+    """
+    Runs a workload to completion and returns its duration in seconds.
+
+    A workload is a dictionary holding the 'client' container to run, and
+    optionally a 'server' container started before it. The client 'args' can
+    use '{server}' for the address of the server.
+    """
+    server = None
+    if 'server' in workload:
+        server = docker_client.containers.run(workload['server']['image'],
+                                              workload['server'].get('args', ''),
+                                              name='perf-server', detach=True)
+        server.reload()
+        address = server.attrs['NetworkSettings']['IPAddress']
+
+    client = workload['client']
+    args = [arg.format(server=address) if server else arg for arg in client['args']]
+
+    start = datetime.now()
+    container = docker_client.containers.run(client['image'], args,
+                                             name='perf-client', detach=True)
+    try:
+        result = container.wait(timeout=timeout)
+        duration = (datetime.now() - start).total_seconds()
+        assert result['StatusCode'] == 0, f'workload exited with code {result["StatusCode"]}'
+    finally:
+        container.remove(force=True)
+        if server:
+            server.remove(force=True)
+
+    return duration
+
+
+def compare(report: dict, baseline: dict, tolerances: dict) -> list:
+    """
+    Compares the metrics of a report against the ones of its baseline.
+
+    Parameters:
+        report (dict): The metrics measured.
+        baseline (dict): The reference metrics for the same workload and driver.
+        tolerances (dict): For each metric checked, the allowed change:
+            'max_increase_pct'/'max_decrease_pct' relative to the baseline,
+            or 'max_increase' in the unit of the metric.
+    Returns:
+        A list of messages describing the regressions, empty if there are none.
+    """
+    regressions = []
+    for metric, tolerance in tolerances.items():
+        if metric not in baseline or metric not in report:
+            continue
+
+        reference = baseline[metric]
+        value = report[metric]
+        # The latency is -1 when it can't be measured
+        if reference < 0 or value < 0:
+            continue
+
+        if 'max_increase' in tolerance:
+            limit = reference + tolerance['max_increase']
+            failed = value > limit
+        elif 'max_increase_pct' in tolerance:
+            limit = reference * (1 + tolerance['max_increase_pct'] / 100)
+            failed = value > limit
+        elif 'max_decrease_pct' in tolerance:
+            limit = reference * (1 - tolerance['max_decrease_pct'] / 100)
+            failed = value < limit
+        else:
+            continue
+
+        if failed:
+            regressions.append(f'{metric}: {value} (baseline {reference}, limit {limit:.2f})')
+
+    return regressions
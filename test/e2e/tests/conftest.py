@@ -15,6 +15,15 @@ def pytest_addoption(parser):
                      default=False, help='Skip tests with eBPF')
     parser.addoption('--no-modern', action='store_true',
                      default=False, help='Skip tests with modern eBPF')
+    parser.addoption('--perf', action='store_true',
+                     default=False, help='Run the performance tests')
+    parser.addoption('--perf-update-baseline', action='store_true',
+                     default=False, help='Store the results of the performance tests as their baseline')
+
+
+def pytest_configure(config):
+    config.addinivalue_line(
+        'markers', 'perf: performance test, only run with --perf')
 
 
 def pytest_collection_modifyitems(config, items):
@@ -22,6 +31,13 @@ def pytest_collection_modifyitems(config, items):
     no_ebpf = config.getoption('--no-ebpf')
     no_modern = config.getoption('--no-modern')
 
+    # The performance tests take long and need a quiet host, run them on demand
+    if not config.getoption('--perf') and not config.getoption('--perf-update-baseline'):
+        skip_perf = pytest.mark.skip(reason='Performance tests need --perf')
+        for item in items:
+            if 'perf' in item.keywords:
+                item.add_marker(skip_perf)
+
     if not no_kmod and not no_ebpf and not no_modern:
         # We are not skipping any tests
         return
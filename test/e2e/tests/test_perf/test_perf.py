@@ -0,0 +1,77 @@
+import json
+import os
+import pytest
+from sinspqa import sinsp, perf, LOGS_PATH
+
+TEST_DIR = os.path.dirname(os.path.abspath(__file__))
+BASELINE_PATH = os.environ.get('PERF_BASELINE', os.path.join(TEST_DIR, 'baseline.json'))
+
+# Fixed workloads, so that their results can be compared between runs
+workloads = {
+    # 2 syscalls for each byte, as fast as possible
+    'syscall_stress': {
+        'client': {
+            'image': 'alpine:3.18',
+            'args': ['dd', 'if=/dev/zero', 'of=/dev/null', 'bs=1', 'count=2000000'],
+        },
+    },
+    # 20k requests from 16 connections at a time
+    'nginx_bench': {
+        'server': {
+            'image': 'nginx:1.14-alpine',
+        },
+        'client': {
+            'image': 'jordi/ab',
+            'args': ['-n', '20000', '-c', '16', 'http://{server}/'],
+        },
+    },
+    # 5000 processes, at most 500 a second
+    'fork_bomb': {
+        'client': {
+            'image': 'alpine:3.18',
+            'args': ['sh', '-c', 'i=0; while [ $i -lt 5000 ]; do /bin/true; i=$((i+1)); '
+                     'if [ $((i % 500)) -eq 0 ]; then sleep 1; fi; done'],
+        },
+    },
+}
+
+ruleset = perf.load_ruleset(os.path.join(TEST_DIR, 'reference_ruleset.txt'))
+sinsp_examples = perf.generate_specs(ruleset)
+ids = [sinsp.generate_id(sinsp_example) for sinsp_example in sinsp_examples]
+
+
+def load_baseline() -> dict:
+    with open(BASELINE_PATH, 'r') as f:
+        return json.load(f)
+
+
+@pytest.mark.perf
+@pytest.mark.parametrize('spec', sinsp_examples, ids=ids)
+@pytest.mark.parametrize('workload', workloads.keys())
+def test_perf(request, docker_client, spec: dict, workload: str):
+    agent = perf.Agent(docker_client, spec)
+    try:
+        workload_s = perf.run_workload(docker_client, workloads[workload])
+    finally:
+        report = agent.stop()
+    report['workload_s'] = workload_s
+
+    key = f'{workload}/{sinsp.generate_id(spec)}'
+
+    # Attached to the html report, to update the baseline from a CI run
+    with open(os.path.join(LOGS_PATH, f'perf-{workload}-{sinsp.generate_id(spec)}.json'), 'w') as f:
+        json.dump({key: report}, f, indent=4)
+
+    baseline = load_baseline()
+    if request.config.getoption('--perf-update-baseline'):
+        baseline['results'][key] = report
+        with open(BASELINE_PATH, 'w') as f:
+            json.dump(baseline, f, indent=4, sort_keys=True)
+            f.write('\n')
+        return
+
+    if key not in baseline['results']:
+        pytest.skip(f'no baseline for {key}, record one with --perf-update-baseline')
+
+    regressions = perf.compare(report, baseline['results'][key], baseline['tolerances'])
+    assert not regressions, f'{key} regressed:\n' + '\n'.join(regressions)
@@ -215,3 +215,34 @@ TEST(kmod, scap_stats_v2_check_empty)
 	ASSERT_EQ(rc, SCAP_SUCCESS);
 	scap_close(h);
 }
+
+TEST(kmod, scap_stats_v2_buffers)
+{
+	char error_buffer[SCAP_LASTERR_SIZE] = {0};
+	int ret = 0;
+	scap_t* h = open_kmod_engine(error_buffer, &ret, 4 * 4096, LIBSCAP_TEST_KERNEL_MODULE_PATH);
+	ASSERT_FALSE(!h || ret != SCAP_SUCCESS) << "unable to open kmod engine: " << error_buffer << std::endl;
+
+	uint32_t nstats;
+	int32_t rc;
+	const scap_stats_v2* stats_v2 = scap_get_stats_v2(h, PPM_SCAP_STATS_BUFFERS, &nstats, &rc);
+	ASSERT_EQ(rc, SCAP_SUCCESS);
+	ASSERT_GT(nstats, 0);
+
+	/* The sampling time comes first, then the stats of the buffers */
+	ASSERT_STREQ(stats_v2[0].name, "buffers.sample_ts_ns");
+	ASSERT_GT(stats_v2[0].value.u64, 0);
+
+	std::unordered_set<std::string> minimal_stats_name = {"buffer_0.used_bytes", "buffer_0.size_bytes", "buffer_0.n_evts", "buffer_0.n_drops_buffer"};
+	for(uint32_t i = 0; i < nstats; i++)
+	{
+		ASSERT_EQ(stats_v2[i].flags, PPM_SCAP_STATS_BUFFERS);
+		if(std::string(stats_v2[i].name) == "buffer_0.size_bytes")
+		{
+			ASSERT_EQ(stats_v2[i].value.u64, 4 * 4096);
+		}
+		minimal_stats_name.erase(stats_v2[i].name);
+	}
+	ASSERT_TRUE(minimal_stats_name.empty()) << "unable to find stat '" << *minimal_stats_name.begin() << "' into the array";
+	scap_close(h);
+}
@@ -262,3 +262,72 @@ TEST(modern_bpf, scap_stats_v2_check_empty)
 	ASSERT_EQ(rc, SCAP_SUCCESS);
 	scap_close(h);
 }
+
+TEST(modern_bpf, scap_stats_v2_buffers)
+{
+	char error_buffer[FILENAME_MAX] = {0};
+	int ret = 0;
+	scap_t* h = open_modern_bpf_engine(error_buffer, &ret, 1 * 1024 * 1024, 0, false);
+	ASSERT_EQ(!h || ret != SCAP_SUCCESS, false) << "unable to open modern bpf engine with one single shared ring buffer: " << error_buffer << std::endl;
+
+	uint32_t nstats;
+	int32_t rc;
+	const scap_stats_v2* stats_v2 = scap_get_stats_v2(h, PPM_SCAP_STATS_BUFFERS, &nstats, &rc);
+	ASSERT_EQ(rc, SCAP_SUCCESS);
+	ASSERT_GT(nstats, 0);
+
+	/* The sampling time comes first, then the stats of the buffers */
+	ASSERT_STREQ(stats_v2[0].name, "buffers.sample_ts_ns");
+	ASSERT_GT(stats_v2[0].value.u64, 0);
+
+	std::unordered_set<std::string> minimal_stats_name = {"ringbuf_0.used_bytes", "ringbuf_0.size_bytes", "cpu_0.n_evts", "cpu_0.n_drops_buffer"};
+	for(uint32_t i = 0; i < nstats; i++)
+	{
+		ASSERT_EQ(stats_v2[i].flags, PPM_SCAP_STATS_BUFFERS);
+		if(std::string(stats_v2[i].name) == "ringbuf_0.size_bytes")
+		{
+			ASSERT_EQ(stats_v2[i].value.u64, 1 * 1024 * 1024);
+		}
+		minimal_stats_name.erase(stats_v2[i].name);
+	}
+	ASSERT_TRUE(minimal_stats_name.empty()) << "unable to find stat '" << *minimal_stats_name.begin() << "' into the array";
+	scap_close(h);
+}
+
+TEST(modern_bpf, scap_stats_v2_prog_budget)
+{
+	char error_buffer[FILENAME_MAX] = {0};
+	int ret = 0;
+	struct scap_open_args oargs = {
+		.engine_name = MODERN_BPF_ENGINE,
+		.mode = SCAP_MODE_LIVE,
+	};
+	for(int i = 0; i < PPM_SC_MAX; i++)
+	{
+		oargs.ppm_sc_of_interest.ppm_sc[i] = 1;
+	}
+	struct scap_modern_bpf_engine_params modern_bpf_params = {
+		.cpus_for_each_buffer = 0,
+		.allocate_online_only = false,
+		.buffer_bytes_dim = 1 * 1024 * 1024,
+		.verbose = false,
+		.prog_budget_ns = 1000000,
+	};
+	oargs.engine_params = &modern_bpf_params;
+	scap_t* h = scap_open(&oargs, error_buffer, &ret);
+	ASSERT_EQ(!h || ret != SCAP_SUCCESS, false) << "unable to open modern bpf engine with a run time budget: " << error_buffer << std::endl;
+
+	uint32_t nstats;
+	int32_t rc;
+	const scap_stats_v2* stats_v2 = scap_get_stats_v2(h, PPM_SCAP_STATS_LIBBPF_STATS, &nstats, &rc);
+	ASSERT_EQ(rc, SCAP_SUCCESS);
+
+	/* With a budget every program also has its percentiles and the actions taken */
+	std::unordered_set<std::string> minimal_stats_name = {"sys_enter.p50_time_ns", "sys_enter.p99_time_ns", "sys_enter.n_budget_exceeded", "signal_deliver.budget_sample_every", "signal_deliver.budget_detached"};
+	for(uint32_t i = 0; i < nstats; i++)
+	{
+		minimal_stats_name.erase(stats_v2[i].name);
+	}
+	ASSERT_TRUE(minimal_stats_name.empty()) << "unable to find stat '" << *minimal_stats_name.begin() << "' into the array";
+	scap_close(h);
+}
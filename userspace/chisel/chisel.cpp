@@ -33,6 +33,7 @@ limitations under the License.
 #include "chisel_api.h"
 #include "chisel_table.h"
 #include "chisel_capture_interrupt_exception.h"
+#include "strlcpy.h"
 
 #define HAS_LUA_CHISELS
 
@@ -132,6 +133,7 @@ const static struct luaL_Reg ll_tool [] =
 const static struct luaL_Reg ll_chisel [] =
 {
 	{"request_field", &lua_cbacks::request_field},
+	{"request_fields", &lua_cbacks::request_fields},
 	{"set_filter", &lua_cbacks::set_filter},
 	{"set_event_formatter", &lua_cbacks::set_event_formatter},
 	{"set_interval_ns", &lua_cbacks::set_interval_ns},
@@ -144,6 +146,7 @@ const static struct luaL_Reg ll_chisel [] =
 const static struct luaL_Reg ll_evt [] =
 {
 	{"field", &lua_cbacks::field},
+	{"fields", &lua_cbacks::fields},
 	{"get_num", &lua_cbacks::get_num},
 	{"get_ts", &lua_cbacks::get_ts},
 	{"get_type", &lua_cbacks::get_type},
@@ -276,6 +279,7 @@ void sinsp_chisel::free_lua_chisel()
 		delete m_allocated_fltchecks[j];
 	}
 	m_allocated_fltchecks.clear();
+	m_field_sets.clear();
 
 	if(m_lua_cinfo != NULL)
 	{
@@ -405,6 +409,14 @@ chisel_field_aggregation sinsp_chisel::string_to_aggregation(string ag)
 	{
 		res = A_MAX;
 	}
+	else if(ag == "DISTINCT")
+	{
+		res = A_DISTINCT;
+	}
+	else if(ag == "TOP")
+	{
+		res = A_TOP;
+	}
 	else
 	{
 		throw sinsp_exception("unknown view column aggregation " + ag);
@@ -1217,6 +1229,8 @@ void sinsp_chisel::load(string cmdstr, bool is_file)
 	//
 	luaL_openlib(m_ls, CHISEL_TOOL_LIBRARY_NAME, ll_tool, 0);
 	luaL_openlib(m_ls, "chisel", ll_chisel, 0);
+	lua_pushstring(m_ls, CHISEL_FIELD_VALUE_CDEF);
+	lua_setfield(m_ls, -2, "field_value_cdef");
 	luaL_openlib(m_ls, "evt", ll_evt, 0);
 
 	//
@@ -1591,6 +1605,11 @@ bool sinsp_chisel::run(sinsp_evt* evt)
 	//
 	if(m_lua_has_handle_evt)
 	{
+		if(!m_field_sets.empty())
+		{
+			fetch_field_sets(evt);
+		}
+
 		lua_getglobal(m_ls, "on_event");
 
 		if(lua_pcall(m_ls, 0, 1, 0) != 0)
@@ -1627,6 +1646,123 @@ bool sinsp_chisel::run(sinsp_evt* evt)
 #endif
 }
 
+//
+// Converts an extracted value like lua_cbacks::rawval_to_lua_stack() does
+//
+static void rawval_to_field_value(uint8_t* rawval, ppm_param_type ptype, uint32_t len, chisel_field_value* val, string* storage)
+{
+	val->type = ptype;
+	val->num = 0;
+	val->str = NULL;
+	val->len = 0;
+
+	switch(ptype)
+	{
+		case PT_INT8:
+			val->num = *(int8_t*)rawval;
+			return;
+		case PT_INT16:
+			val->num = *(int16_t*)rawval;
+			return;
+		case PT_INT32:
+			val->num = *(int32_t*)rawval;
+			return;
+		case PT_INT64:
+		case PT_ERRNO:
+		case PT_PID:
+		case PT_FD:
+			val->num = (double)*(int64_t*)rawval;
+			return;
+		case PT_L4PROTO:
+		case PT_FLAGS8:
+		case PT_UINT8:
+		case PT_ENUMFLAGS8:
+			val->num = *(uint8_t*)rawval;
+			return;
+		case PT_PORT:
+		case PT_FLAGS16:
+		case PT_UINT16:
+		case PT_ENUMFLAGS16:
+			val->num = *(uint16_t*)rawval;
+			return;
+		case PT_FLAGS32:
+		case PT_UINT32:
+		case PT_MODE:
+		case PT_UID:
+		case PT_GID:
+		case PT_ENUMFLAGS32:
+			val->num = *(uint32_t*)rawval;
+			return;
+		case PT_UINT64:
+		case PT_RELTIME:
+		case PT_ABSTIME:
+			val->num = (double)*(uint64_t*)rawval;
+			return;
+		case PT_DOUBLE:
+			val->num = *(double*)rawval;
+			return;
+		case PT_BOOL:
+			val->num = (*(uint32_t*)rawval != 0);
+			return;
+		case PT_CHARBUF:
+		case PT_FSPATH:
+		case PT_FSRELPATH:
+		case PT_BYTEBUF:
+			storage->assign((char*)rawval, len);
+			break;
+		case PT_IPV4ADDR:
+		case PT_IPV6ADDR:
+		case PT_IPADDR:
+			{
+				char address[100];
+				int af = (ptype == PT_IPV4ADDR || (ptype == PT_IPADDR && len == sizeof(struct in_addr))) ?
+					AF_INET : AF_INET6;
+				if(NULL == inet_ntop(af, rawval, address, sizeof(address)))
+				{
+					strlcpy(address, "<NA>", sizeof(address));
+				}
+				val->type = af == AF_INET ? PT_IPV4ADDR : PT_IPV6ADDR;
+				storage->assign(address);
+			}
+			break;
+		default:
+			val->type = PT_NONE;
+			return;
+	}
+
+	val->str = storage->c_str();
+	val->len = storage->size();
+}
+
+void sinsp_chisel::fetch_field_sets(sinsp_evt* evt)
+{
+	for(auto& set : m_field_sets)
+	{
+		for(size_t j = 0; j < set->m_checks.size(); j++)
+		{
+			sinsp_filter_check* chk = set->m_checks[j];
+			chisel_field_value* val = &set->m_values[j];
+
+			chk->m_extracted_values.clear();
+			if(!chk->extract(evt, chk->m_extracted_values))
+			{
+				val->type = PT_NONE;
+				val->num = 0;
+				val->str = NULL;
+				val->len = 0;
+				continue;
+			}
+
+			// like field(), only the first value of the list fields
+			rawval_to_field_value(chk->m_extracted_values[0].ptr,
+					      chk->get_field_info()->m_type,
+					      chk->m_extracted_values[0].len,
+					      val,
+					      &set->m_storage[j]);
+		}
+	}
+}
+
 void sinsp_chisel::do_timeout(sinsp_evt* evt)
 {
 	if(m_lua_is_first_evt)
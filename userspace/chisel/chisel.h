@@ -34,6 +34,24 @@ void chisel_add_dir(std::string dirname, bool front_add);
 
 typedef struct lua_State lua_State;
 
+/*!
+  \brief Value of a field requested with chisel.request_fields(). The values
+  of every requested set are filled before on_event() is called, so the
+  scripts running on LuaJIT can read them through the FFI, without calling
+  back into C. CHISEL_FIELD_VALUE_CDEF is the declaration to pass to
+  ffi.cdef(), exported to the scripts as chisel.field_value_cdef.
+*/
+typedef struct chisel_field_value
+{
+	uint32_t type;   ///< ppm_param_type of the value, PT_NONE if the event has no value for the field.
+	uint32_t len;    ///< Length of str.
+	double num;      ///< Value of the numeric and boolean fields.
+	const char* str; ///< Value of the other fields, NUL terminated. Addresses are formatted.
+} chisel_field_value;
+
+#define CHISEL_FIELD_VALUE_CDEF \
+	"typedef struct chisel_field_value { uint32_t type; uint32_t len; double num; const char* str; } chisel_field_value;"
+
 /** @defgroup filter Filtering events
  * Filtering infrastructure.
  *  @{
@@ -148,6 +166,7 @@ private:
 	static bool parse_view_info(lua_State *ls, OUT chisel_desc* cd);
 	static bool init_lua_chisel(chisel_desc &cd, std::string const &path);
 	void first_event_inits(sinsp_evt* evt);
+	void fetch_field_sets(sinsp_evt* evt);
 
 	sinsp* m_inspector;
 	std::string m_description;
@@ -160,6 +179,14 @@ private:
 	uint64_t m_lua_last_interval_sample_time;
 	uint64_t m_lua_last_interval_ts;
 	std::vector<sinsp_filter_check*> m_allocated_fltchecks;
+	// fields requested together with chisel.request_fields()
+	struct field_set
+	{
+		std::vector<sinsp_filter_check*> m_checks;
+		std::vector<chisel_field_value> m_values;
+		std::vector<std::string> m_storage;
+	};
+	std::vector<std::unique_ptr<field_set>> m_field_sets;
 	char m_lua_fld_storage[PPM_MAX_ARG_SIZE];
 	chiselinfo* m_lua_cinfo;
 	std::string m_new_chisel_to_exec;
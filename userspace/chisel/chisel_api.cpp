@@ -376,6 +376,88 @@ int lua_cbacks::field(lua_State *ls)
 	}
 }
 
+//
+// Requests all the fields passed as arguments at once. Returns a handle for
+// evt.fields() and a pointer to the array of their chisel_field_value, which
+// is filled before every on_event() call
+//
+int lua_cbacks::request_fields(lua_State *ls)
+{
+	lua_getglobal(ls, "sichisel");
+
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, -1);
+	lua_pop(ls, 1);
+
+	int nargs = lua_gettop(ls);
+	if(nargs == 0)
+	{
+		string err = "chisel requesting no fields";
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	unique_ptr<sinsp_chisel::field_set> set(new sinsp_chisel::field_set());
+	for(int j = 1; j <= nargs; j++)
+	{
+		// request_field() checks the name and keeps the filter check
+		lua_pushcfunction(ls, &lua_cbacks::request_field);
+		lua_pushvalue(ls, j);
+		lua_call(ls, 1, 1);
+		set->m_checks.push_back((sinsp_filter_check*)lua_touserdata(ls, -1));
+		lua_pop(ls, 1);
+	}
+
+	chisel_field_value empty = {PT_NONE, 0, 0, NULL};
+	set->m_values.resize(set->m_checks.size(), empty);
+	set->m_storage.resize(set->m_checks.size());
+
+	lua_pushlightuserdata(ls, set.get());
+	lua_pushlightuserdata(ls, set->m_values.data());
+	ch->m_field_sets.push_back(std::move(set));
+
+	return 2;
+}
+
+//
+// Returns the values of all the fields of a set requested with
+// chisel.request_fields(), in order, nil for the ones without a value
+//
+int lua_cbacks::fields(lua_State *ls)
+{
+	sinsp_chisel::field_set* set = (sinsp_chisel::field_set*)lua_touserdata(ls, 1);
+	if(set == NULL)
+	{
+		lua_pushnil(ls);
+		return 1;
+	}
+
+	lua_checkstack(ls, set->m_values.size());
+	for(const auto& val : set->m_values)
+	{
+		switch(val.type)
+		{
+			case PT_NONE:
+				lua_pushnil(ls);
+				break;
+			case PT_BOOL:
+				lua_pushboolean(ls, val.num != 0);
+				break;
+			default:
+				if(val.str != NULL)
+				{
+					lua_pushlstring(ls, val.str, val.len);
+				}
+				else
+				{
+					lua_pushnumber(ls, val.num);
+				}
+				break;
+		}
+	}
+
+	return set->m_values.size();
+}
+
 int lua_cbacks::set_global_filter(lua_State *ls)
 {
 	lua_getglobal(ls, "sichisel");
@@ -709,7 +791,6 @@ int lua_cbacks::get_machine_info(lua_State *ls)
 
 int lua_cbacks::get_thread_table_int(lua_State *ls, bool include_fds, bool barebone)
 {
-	unordered_map<int64_t, sinsp_fdinfo_t>::iterator fdit;
 	uint32_t j;
 	sinsp_filter_compiler* compiler = NULL;
 	sinsp_filter* filter = NULL;
@@ -786,22 +867,23 @@ int lua_cbacks::get_thread_table_int(lua_State *ls, bool include_fds, bool bareb
 		{
 			bool match = false;
 
-			for(fdit = fdtable->m_table.begin(); fdit != fdtable->m_table.end(); ++fdit)
+			fdtable->loop([&](int64_t fd, sinsp_fdinfo_t& fdinfo)
 			{
 				tevt.m_tinfo = &tinfo;
-				tevt.m_fdinfo = &(fdit->second);
+				tevt.m_fdinfo = &fdinfo;
 				tscapevt.tid = tinfo.m_tid;
 				int64_t tlefd = tevt.m_tinfo->m_lastevent_fd;
-				tevt.m_tinfo->m_lastevent_fd = fdit->first;
+				tevt.m_tinfo->m_lastevent_fd = fd;
 
 				if(filter->run(&tevt))
 				{
 					match = true;
-					break;
+					return false;
 				}
 
 				tevt.m_tinfo->m_lastevent_fd = tlefd;
-			}
+				return true;
+			});
 
 			if(!match)
 			{
@@ -837,10 +919,10 @@ int lua_cbacks::get_thread_table_int(lua_State *ls, bool include_fds, bool bareb
 			lua_pushnumber(ls, (uint32_t)tinfo.m_fdlimit);
 			lua_settable(ls, -3);
 			lua_pushliteral(ls, "uid");
-			lua_pushnumber(ls, (uint32_t)tinfo.m_user.uid);
+			lua_pushnumber(ls, (uint32_t)tinfo.get_user()->uid);
 			lua_settable(ls, -3);
 			lua_pushliteral(ls, "gid");
-			lua_pushnumber(ls, (uint32_t)tinfo.m_group.gid);
+			lua_pushnumber(ls, (uint32_t)tinfo.get_group()->gid);
 			lua_settable(ls, -3);
 			lua_pushliteral(ls, "nchilds");
 			lua_pushnumber(ls, (uint32_t)tinfo.m_nchilds);
@@ -868,7 +950,7 @@ int lua_cbacks::get_thread_table_int(lua_State *ls, bool include_fds, bool bareb
 			// Extract the user name
 			//
 			lua_pushliteral(ls, "username");
-			lua_pushstring(ls, tinfo.m_user.name);
+			lua_pushstring(ls, tinfo.get_user()->name);
 			lua_settable(ls, -3);
 
 			//
@@ -876,7 +958,7 @@ int lua_cbacks::get_thread_table_int(lua_State *ls, bool include_fds, bool bareb
 			//
 			lua_pushstring(ls, "args");
 
-			vector<string>* args = &tinfo.m_args;
+			const vector<string>* args = &tinfo.m_args.get();
 			lua_newtable(ls);
 			for(j = 0; j < args->size(); j++)
 			{
@@ -910,19 +992,19 @@ int lua_cbacks::get_thread_table_int(lua_State *ls, bool include_fds, bool bareb
 
 		if(include_fds)
 		{
-			for(fdit = fdtable->m_table.begin(); fdit != fdtable->m_table.end(); ++fdit)
+			fdtable->loop([&](int64_t fd, sinsp_fdinfo_t& fdinfo)
 			{
 				tevt.m_tinfo = &tinfo;
-				tevt.m_fdinfo = &(fdit->second);
+				tevt.m_fdinfo = &fdinfo;
 				tscapevt.tid = tinfo.m_tid;
 				int64_t tlefd = tevt.m_tinfo->m_lastevent_fd;
-				tevt.m_tinfo->m_lastevent_fd = fdit->first;
+				tevt.m_tinfo->m_lastevent_fd = fd;
 
 				if(filter != NULL)
 				{
 					if(filter->run(&tevt) == false)
 					{
-						continue;
+						return true;
 					}
 				}
 
@@ -932,14 +1014,14 @@ int lua_cbacks::get_thread_table_int(lua_State *ls, bool include_fds, bool bareb
 				if(!barebone)
 				{
 					lua_pushliteral(ls, "name");
-					lua_pushstring(ls, fdit->second.tostring_clean().c_str());
+					lua_pushstring(ls, fdinfo.tostring_clean().c_str());
 					lua_settable(ls, -3);
 					lua_pushliteral(ls, "type");
-					lua_pushstring(ls, fdit->second.get_typestring());
+					lua_pushstring(ls, fdinfo.get_typestring());
 					lua_settable(ls, -3);
 				}
 
-				scap_fd_type evt_type = fdit->second.m_type;
+				scap_fd_type evt_type = fdinfo.m_type;
 				if(evt_type == SCAP_FD_IPV4_SOCK || evt_type == SCAP_FD_IPV4_SERVSOCK ||
 				   evt_type == SCAP_FD_IPV6_SOCK || evt_type == SCAP_FD_IPV6_SERVSOCK)
 				{
@@ -954,38 +1036,38 @@ int lua_cbacks::get_thread_table_int(lua_State *ls, bool include_fds, bool bareb
 					{
 						include_client = true;
 						af = AF_INET;
-						cip = (uint8_t*)&(fdit->second.m_sockinfo.m_ipv4info.m_fields.m_sip);
-						sip = (uint8_t*)&(fdit->second.m_sockinfo.m_ipv4info.m_fields.m_dip);
-						cport = fdit->second.m_sockinfo.m_ipv4info.m_fields.m_sport;
-						sport = fdit->second.m_sockinfo.m_ipv4info.m_fields.m_dport;
-						is_server = fdit->second.is_role_server();
+						cip = (uint8_t*)&(fdinfo.m_sockinfo.m_ipv4info.m_fields.m_sip);
+						sip = (uint8_t*)&(fdinfo.m_sockinfo.m_ipv4info.m_fields.m_dip);
+						cport = fdinfo.m_sockinfo.m_ipv4info.m_fields.m_sport;
+						sport = fdinfo.m_sockinfo.m_ipv4info.m_fields.m_dport;
+						is_server = fdinfo.is_role_server();
 					}
 					else if (evt_type == SCAP_FD_IPV4_SERVSOCK)
 					{
 						include_client = false;
 						af = AF_INET;
 						cip = NULL;
-						sip = (uint8_t*)&(fdit->second.m_sockinfo.m_ipv4serverinfo.m_ip);
-						sport = fdit->second.m_sockinfo.m_ipv4serverinfo.m_port;
+						sip = (uint8_t*)&(fdinfo.m_sockinfo.m_ipv4serverinfo.m_ip);
+						sport = fdinfo.m_sockinfo.m_ipv4serverinfo.m_port;
 						is_server = true;
 					}
 					else if (evt_type == SCAP_FD_IPV6_SOCK)
 					{
 						include_client = true;
 						af = AF_INET6;
-						cip = (uint8_t*)&(fdit->second.m_sockinfo.m_ipv6info.m_fields.m_sip);
-						sip = (uint8_t*)&(fdit->second.m_sockinfo.m_ipv6info.m_fields.m_dip);
-						cport = fdit->second.m_sockinfo.m_ipv6info.m_fields.m_sport;
-						sport = fdit->second.m_sockinfo.m_ipv6info.m_fields.m_dport;
-						is_server = fdit->second.is_role_server();
+						cip = (uint8_t*)&(fdinfo.m_sockinfo.m_ipv6info.m_fields.m_sip);
+						sip = (uint8_t*)&(fdinfo.m_sockinfo.m_ipv6info.m_fields.m_dip);
+						cport = fdinfo.m_sockinfo.m_ipv6info.m_fields.m_sport;
+						sport = fdinfo.m_sockinfo.m_ipv6info.m_fields.m_dport;
+						is_server = fdinfo.is_role_server();
 					}
 					else
 					{
 						include_client = false;
 						af = AF_INET6;
 						cip = NULL;
-						sip = (uint8_t*)&(fdit->second.m_sockinfo.m_ipv6serverinfo.m_ip);
-						sport = fdit->second.m_sockinfo.m_ipv6serverinfo.m_port;
+						sip = (uint8_t*)&(fdinfo.m_sockinfo.m_ipv6serverinfo.m_ip);
+						sport = fdinfo.m_sockinfo.m_ipv6serverinfo.m_port;
 						is_server = true;
 					}
 
@@ -1036,7 +1118,7 @@ int lua_cbacks::get_thread_table_int(lua_State *ls, bool include_fds, bool bareb
 
 					// l4proto
 					const char* l4ps;
-					scap_l4_proto l4p = fdit->second.get_l4proto();
+					scap_l4_proto l4p = fdinfo.get_l4proto();
 
 					switch(l4p)
 					{
@@ -1066,8 +1148,9 @@ int lua_cbacks::get_thread_table_int(lua_State *ls, bool include_fds, bool bareb
 				// is_server
 				string l4proto;
 
-				lua_rawseti(ls,-2, (uint32_t)fdit->first);
-			}
+				lua_rawseti(ls,-2, (uint32_t)fd);
+				return true;
+			});
 		}
 
 
@@ -28,6 +28,8 @@ public:
 	static int get_cpuid(lua_State *ls);
 	static int request_field(lua_State *ls);
 	static int field(lua_State *ls);
+	static int request_fields(lua_State *ls);
+	static int fields(lua_State *ls);
 	static int set_global_filter(lua_State *ls);
 	static int set_filter(lua_State *ls);
 	static int set_snaplen(lua_State *ls);
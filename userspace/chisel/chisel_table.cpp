@@ -16,6 +16,7 @@ limitations under the License.
 */
 
 #include <algorithm>
+#include <cmath>
 
 #include <sinsp.h>
 #include "chisel_table.h"
@@ -68,6 +69,124 @@ typedef struct table_row_cmp
 	bool m_ascending;
 }table_row_cmp;
 
+//
+// Sketches used by the DISTINCT and TOP aggregations. A sketch is the value
+// of its column in a row: it lives in the table buffers like the other
+// values, has a fixed size, and is turned into a regular value when the
+// sample is created.
+//
+#define CHISEL_HLL_BITS 10
+#define CHISEL_HLL_REGISTERS (1 << CHISEL_HLL_BITS)
+#define CHISEL_TOPK_SLOTS 16
+
+typedef struct chisel_topk_slot
+{
+	uint8_t* m_val;
+	uint32_t m_len;
+	uint64_t m_count;
+}chisel_topk_slot;
+
+static uint64_t hash_value(const uint8_t* val, uint32_t len)
+{
+	uint64_t h = 14695981039346656037ULL;
+
+	for(uint32_t j = 0; j < len; j++)
+	{
+		h = (h ^ val[j]) * 1099511628211ULL;
+	}
+
+	// FNV-1a doesn't mix the high bits well enough to pick the register
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static void hll_add(uint8_t* regs, uint64_t h)
+{
+	uint32_t idx = (uint32_t)(h >> (64 - CHISEL_HLL_BITS));
+	uint64_t w = (h << CHISEL_HLL_BITS) | (1ULL << (CHISEL_HLL_BITS - 1));
+	uint8_t rank = 1;
+
+	while((w & (1ULL << 63)) == 0)
+	{
+		w <<= 1;
+		rank++;
+	}
+
+	if(rank > regs[idx])
+	{
+		regs[idx] = rank;
+	}
+}
+
+static uint64_t hll_estimate(const uint8_t* regs)
+{
+	double m = CHISEL_HLL_REGISTERS;
+	double sum = 0;
+	uint32_t zeros = 0;
+
+	for(uint32_t j = 0; j < CHISEL_HLL_REGISTERS; j++)
+	{
+		sum += ldexp(1.0, -regs[j]);
+		if(regs[j] == 0)
+		{
+			zeros++;
+		}
+	}
+
+	double est = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+
+	//
+	// Small range correction
+	//
+	if(est <= 2.5 * m && zeros != 0)
+	{
+		est = m * log(m / zeros);
+	}
+
+	return (uint64_t)(est + 0.5);
+}
+
+//
+// Space-Saving update: a value that is not tracked replaces the least
+// frequent one and inherits its count
+//
+static void topk_add(chisel_topk_slot* slots, uint8_t* val, uint32_t len, uint64_t count)
+{
+	chisel_topk_slot* min = &slots[0];
+
+	for(uint32_t j = 0; j < CHISEL_TOPK_SLOTS; j++)
+	{
+		chisel_topk_slot* slot = &slots[j];
+
+		if(slot->m_val == NULL)
+		{
+			slot->m_val = val;
+			slot->m_len = len;
+			slot->m_count = count;
+			return;
+		}
+
+		if(slot->m_len == len && memcmp(slot->m_val, val, len) == 0)
+		{
+			slot->m_count += count;
+			return;
+		}
+
+		if(slot->m_count < min->m_count)
+		{
+			min = slot;
+		}
+	}
+
+	min->m_val = val;
+	min->m_len = len;
+	min->m_count += count;
+}
+
 chisel_table::chisel_table(sinsp* inspector, tabletype type, uint64_t refresh_interval_ns, 
 	chisel_table::output_type output_type, uint32_t json_first_row, uint32_t json_last_row)
 {
@@ -91,6 +210,7 @@ chisel_table::chisel_table(sinsp* inspector, tabletype type, uint64_t refresh_in
 	m_sorting_col = -1;
 	m_just_sorted = true;
 	m_do_merging = true;
+	m_has_sketches = false;
 	m_types = &m_premerge_types;
 	m_table = &m_premerge_table;
 	m_extractors = &m_premerge_extractors;
@@ -238,8 +358,34 @@ void chisel_table::configure(vector<chisel_view_column_info>* entries, const str
 
 	for(auto it = m_premerge_extractors.begin(); it != m_premerge_extractors.end(); ++it)
 	{
-		m_premerge_types.push_back((*it)->m_check->get_field_info()->m_type);
-		m_premerge_legend.push_back(*(*it)->m_check->get_field_info());
+		filtercheck_field_info info = *(*it)->m_check->get_field_info();
+
+		if(is_sketch_aggregation((*it)->m_aggregation))
+		{
+			if(it == m_premerge_extractors.begin())
+			{
+				throw sinsp_exception("invalid table configuration: the key can't use the DISTINCT or TOP aggregations");
+			}
+
+			if(m_type != chisel_table::TT_TABLE)
+			{
+				throw sinsp_exception("the DISTINCT and TOP aggregations are not supported for list tables");
+			}
+
+			m_has_sketches = true;
+		}
+
+		//
+		// Distinct counts are displayed as numbers, whatever the field type
+		//
+		if((*it)->m_aggregation == A_DISTINCT)
+		{
+			info.m_type = PT_UINT64;
+			info.m_print_format = PF_DEC;
+		}
+
+		m_premerge_types.push_back(info.m_type);
+		m_premerge_legend.push_back(info);
 	}
 
 	m_premerge_vals_array_sz = (m_n_fields - 1) * sizeof(chisel_table_field);
@@ -298,8 +444,22 @@ void chisel_table::configure(vector<chisel_view_column_info>* entries, const str
 
 		chk_wrap->m_merge_aggregation = (chisel_field_aggregation)vit.m_groupby_aggregation;
 
+		//
+		// Sketches can only be merged with sketches of the same kind
+		//
+		if((is_sketch_aggregation(chk_wrap->m_aggregation) || is_sketch_aggregation(chk_wrap->m_merge_aggregation)) &&
+			chk_wrap->m_aggregation != chk_wrap->m_merge_aggregation)
+		{
+			throw sinsp_exception("invalid table configuration: DISTINCT and TOP columns must use the same groupby_aggregation");
+		}
+
 		if((vit.m_flags & TEF_IS_GROUPBY_KEY) != 0)
 		{
+			if(is_sketch_aggregation(chk_wrap->m_aggregation))
+			{
+				throw sinsp_exception("invalid table configuration: the groupby key can't use the DISTINCT or TOP aggregations");
+			}
+
 			if(m_is_groupby_key_present)
 			{
 				throw sinsp_exception("invalid table configuration: more than one groupby key specified");
@@ -331,8 +491,16 @@ void chisel_table::configure(vector<chisel_view_column_info>* entries, const str
 
 	for(auto it = m_postmerge_extractors.begin(); it != m_postmerge_extractors.end(); ++it)
 	{
-		m_postmerge_types.push_back((*it)->m_check->get_field_info()->m_type);
-		m_postmerge_legend.push_back(*(*it)->m_check->get_field_info());
+		filtercheck_field_info info = *(*it)->m_check->get_field_info();
+
+		if((*it)->m_aggregation == A_DISTINCT)
+		{
+			info.m_type = PT_UINT64;
+			info.m_print_format = PF_DEC;
+		}
+
+		m_postmerge_types.push_back(info.m_type);
+		m_postmerge_legend.push_back(info);
 	}
 
 	m_postmerge_vals_array_sz = (m_n_postmerge_fields - 1) * sizeof(chisel_table_field);
@@ -351,37 +519,50 @@ void chisel_table::add_row(bool merging)
 		//
 		// This is a table. Do a proper key lookup and update the entry
 		//
-		auto it = m_table->find(key);
+		bool inserted;
+		key.m_cnt = 1;
+		chisel_table_map::entry* e = m_table->insert(key, &inserted);
 
-		if(it == m_table->end())
+		if(inserted)
 		{
 			//
 			// New entry
 			//
-			key.m_val = key.m_val;
-			key.m_cnt = 1;
 			m_vals = (chisel_table_field*)m_buffer->reserve(m_vals_array_sz);
 
 			for(j = 1; j < m_n_fields; j++)
 			{
+				uint32_t aggr = (*m_extractors)[j]->m_aggregation;
+				if(is_sketch_aggregation(aggr))
+				{
+					new_sketch(aggr, &m_vals[j - 1]);
+					add_to_sketch(aggr, &m_vals[j - 1], &m_fld_pointers[j], merging);
+					continue;
+				}
+
 				uint32_t vlen = get_field_len(j);
 				m_vals[j - 1].m_val = m_fld_pointers[j].m_val;
 				m_vals[j - 1].m_len = vlen;
 				m_vals[j - 1].m_cnt = m_fld_pointers[j].m_cnt;
 			}
 
-			(*m_table)[key] = m_vals;
+			e->m_vals = m_vals;
 		}
 		else
 		{
 			//
 			// Existing entry
 			//
-			m_vals = it->second;
+			m_vals = e->m_vals;
 
 			for(j = 1; j < m_n_fields; j++)
 			{
-				if(merging)
+				uint32_t aggr = (*m_extractors)[j]->m_aggregation;
+				if(is_sketch_aggregation(aggr))
+				{
+					add_to_sketch(aggr, &m_vals[j - 1], &m_fld_pointers[j], merging);
+				}
+				else if(merging)
 				{
 					add_fields(j, &m_fld_pointers[j], m_postmerge_extractors[j]->m_merge_aggregation);
 				}
@@ -475,6 +656,19 @@ void chisel_table::process_event(sinsp_evt* evt)
 		}
 		else
 		{
+			if(m_premerge_extractors[j]->m_aggregation == A_DISTINCT)
+			{
+				//
+				// Distinct counts only need the hash of the value
+				//
+				extract_value_t* ev = &m_premerge_extractors[j]->m_check->m_extracted_values[0];
+				uint64_t h = hash_value(ev->ptr, ev->len);
+				pfld->m_val = m_buffer->copy((uint8_t*)&h, sizeof(h));
+				pfld->m_len = sizeof(h);
+				pfld->m_cnt = 1;
+				continue;
+			}
+
 			// todo: Do something better here. For now, only support single-value extracted fields
 			// Set the val in the m_premerge_fld_pointers; note: at this stage,
 			// m_fld_pointers points to m_premerge_fld_pointers.
@@ -836,9 +1030,25 @@ void chisel_table::sort_sample()
 		uint32_t tyid = m_do_merging? m_sorting_col + 2 : m_sorting_col + 1;
 		cc.m_type = m_premerge_types[tyid];
 
-		sort(m_sample_data->begin(),
-			m_sample_data->end(),
-			cc);
+		//
+		// When only the first rows are printed as json, there's no need to
+		// sort the whole sample
+		//
+		if(m_output_type == chisel_table::OT_JSON &&
+			m_json_last_row != 0 &&
+			m_json_last_row + 1 < m_sample_data->size())
+		{
+			partial_sort(m_sample_data->begin(),
+				m_sample_data->begin() + m_json_last_row + 1,
+				m_sample_data->end(),
+				cc);
+		}
+		else
+		{
+			sort(m_sample_data->begin(),
+				m_sample_data->end(),
+				cc);
+		}
 	}
 }
 
@@ -980,8 +1190,6 @@ void chisel_table::create_sample()
 	if(m_type == chisel_table::TT_TABLE)
 	{
 		uint32_t j;
-		m_full_sample_data.clear();
-		chisel_sample_row row;
 
 		//
 		// If merging is on, perform the merge and switch to the merged table 
@@ -1000,15 +1208,15 @@ void chisel_table::create_sample()
 					uint32_t col = m_groupby_columns[j];
 					if(col == 0)
 					{
-						pfld->m_val = it->first.m_val;
-						pfld->m_len = it->first.m_len;
-						pfld->m_cnt = it->first.m_cnt;
+						pfld->m_val = it->m_key.m_val;
+						pfld->m_len = it->m_key.m_len;
+						pfld->m_cnt = it->m_key.m_cnt;
 					}
 					else
 					{
-						pfld->m_val = it->second[col - 1].m_val;
-						pfld->m_len = it->second[col - 1].m_len;
-						pfld->m_cnt = it->second[col - 1].m_cnt;
+						pfld->m_val = it->m_vals[col - 1].m_val;
+						pfld->m_len = it->m_vals[col - 1].m_len;
+						pfld->m_cnt = it->m_vals[col - 1].m_cnt;
 					}
 				}
 
@@ -1021,21 +1229,27 @@ void chisel_table::create_sample()
 		}
 
 		//
-		// Emit the table
+		// Emit the table. The rows of the previous sample are reused, so that
+		// their value vectors don't need to be allocated again.
 		//
-		for(auto it = m_table->begin(); it != m_table->end(); ++it)
+		m_full_sample_data.resize(m_table->size());
+		auto rit = m_full_sample_data.begin();
+		for(auto it = m_table->begin(); it != m_table->end(); ++it, ++rit)
 		{
-			row.m_key = it->first;
+			rit->m_key = it->m_key;
+			rit->m_values.assign(it->m_vals, it->m_vals + m_n_fields - 1);
 
-			row.m_values.clear();
-
-			chisel_table_field* fields = it->second;
-			for(j = 0; j < m_n_fields - 1; j++)
+			if(m_has_sketches)
 			{
-				row.m_values.push_back(fields[j]);
+				for(j = 0; j < m_n_fields - 1; j++)
+				{
+					uint32_t aggr = (*m_extractors)[j + 1]->m_aggregation;
+					if(is_sketch_aggregation(aggr))
+					{
+						sketch_to_value(aggr, &rit->m_values[j]);
+					}
+				}
 			}
-
-			m_full_sample_data.push_back(row);
 		}
 	}
 	else
@@ -1393,6 +1607,98 @@ void chisel_table::add_fields(uint32_t dst_id, chisel_table_field* src, uint32_t
 	}
 }
 
+void chisel_table::new_sketch(uint32_t aggr, chisel_table_field* dst)
+{
+	uint32_t len = (aggr == A_DISTINCT)?
+		CHISEL_HLL_REGISTERS :
+		CHISEL_TOPK_SLOTS * sizeof(chisel_topk_slot);
+
+	dst->m_val = m_buffer->reserve(len);
+	memset(dst->m_val, 0, len);
+	dst->m_len = len;
+	dst->m_cnt = 1;
+}
+
+//
+// src is a raw value (the hash of the value for DISTINCT) when processing
+// events, and a sketch of the same kind when merging
+//
+void chisel_table::add_to_sketch(uint32_t aggr, chisel_table_field* dst, chisel_table_field* src, bool merging)
+{
+	if(aggr == A_DISTINCT)
+	{
+		if(merging)
+		{
+			for(uint32_t j = 0; j < CHISEL_HLL_REGISTERS; j++)
+			{
+				if(src->m_val[j] > dst->m_val[j])
+				{
+					dst->m_val[j] = src->m_val[j];
+				}
+			}
+		}
+		else if(src->m_cnt != 0)
+		{
+			uint64_t h;
+			memcpy(&h, src->m_val, sizeof(h));
+			hll_add(dst->m_val, h);
+		}
+	}
+	else
+	{
+		chisel_topk_slot* slots = (chisel_topk_slot*)dst->m_val;
+
+		if(merging)
+		{
+			chisel_topk_slot* src_slots = (chisel_topk_slot*)src->m_val;
+			for(uint32_t j = 0; j < CHISEL_TOPK_SLOTS && src_slots[j].m_val != NULL; j++)
+			{
+				topk_add(slots, src_slots[j].m_val, src_slots[j].m_len, src_slots[j].m_count);
+			}
+		}
+		else if(src->m_cnt != 0)
+		{
+			topk_add(slots, src->m_val, src->m_len, 1);
+		}
+	}
+}
+
+void chisel_table::sketch_to_value(uint32_t aggr, chisel_table_field* fld)
+{
+	if(aggr == A_DISTINCT)
+	{
+		uint64_t est = hll_estimate(fld->m_val);
+		fld->m_val = m_buffer->copy((uint8_t*)&est, sizeof(est));
+		fld->m_len = sizeof(est);
+	}
+	else
+	{
+		chisel_topk_slot* slots = (chisel_topk_slot*)fld->m_val;
+		chisel_topk_slot* top = &slots[0];
+
+		for(uint32_t j = 1; j < CHISEL_TOPK_SLOTS && slots[j].m_val != NULL; j++)
+		{
+			if(slots[j].m_count > top->m_count)
+			{
+				top = &slots[j];
+			}
+		}
+
+		if(top->m_val == NULL)
+		{
+			fld->m_val = (uint8_t*)&m_zero_u64;
+			fld->m_len = 0;
+		}
+		else
+		{
+			fld->m_val = top->m_val;
+			fld->m_len = top->m_len;
+		}
+	}
+
+	fld->m_cnt = 1;
+}
+
 uint32_t chisel_table::get_field_len(uint32_t id)
 {
 	ppm_param_type type;
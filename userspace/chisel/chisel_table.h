@@ -128,19 +128,143 @@ struct chisel_table_field_hasher
 {
   size_t operator()(const chisel_table_field& k) const
   {
-	  size_t h = 0;
-	  uint8_t* s = k.m_val;
-	  uint32_t len = k.m_len;
+	  // FNV-1a over the whole value
+	  size_t h = 14695981039346656037ULL;
+	  const uint8_t* s = k.m_val;
 
-	  while(--len)
+	  for(uint32_t j = 0; j < k.m_len; j++)
 	  {
-		  h = h * 101 + (unsigned) *s++;
+		  h = (h ^ s[j]) * 1099511628211ULL;
 	  }
 
-	  return h;  
+	  return h;
   }
 };
 
+//
+// Flat hash map from the key of a table row to its array of values.
+// Entries are stored contiguously in insertion order and indexed by an open
+// addressing array of slots, so a lookup is a single probe sequence and
+// clearing the map between samples keeps all its memory. Keys and values
+// point into the table buffers, the map never copies them.
+//
+class chisel_table_map
+{
+public:
+	struct entry
+	{
+		chisel_table_field m_key;
+		chisel_table_field* m_vals;
+		size_t m_hash;
+	};
+
+	chisel_table_map():
+		m_mask(0)
+	{
+	}
+
+	//
+	// Returns the entry of key, or NULL if it's not in the map
+	//
+	entry* find(const chisel_table_field& key)
+	{
+		if(m_entries.empty())
+		{
+			return NULL;
+		}
+
+		size_t h = m_hasher(key);
+		for(size_t j = h & m_mask; m_slots[j] != 0; j = (j + 1) & m_mask)
+		{
+			entry* e = &m_entries[m_slots[j] - 1];
+			if(e->m_hash == h && e->m_key == key)
+			{
+				return e;
+			}
+		}
+
+		return NULL;
+	}
+
+	//
+	// Returns the entry of key, adding it with NULL values if it's not in the
+	// map. inserted tells which one happened. The returned pointer is valid
+	// until the next insertion.
+	//
+	entry* insert(const chisel_table_field& key, bool* inserted)
+	{
+		if((m_entries.size() + 1) * 2 > m_slots.size())
+		{
+			grow();
+		}
+
+		size_t h = m_hasher(key);
+		size_t j = h & m_mask;
+		for(; m_slots[j] != 0; j = (j + 1) & m_mask)
+		{
+			entry* e = &m_entries[m_slots[j] - 1];
+			if(e->m_hash == h && e->m_key == key)
+			{
+				*inserted = false;
+				return e;
+			}
+		}
+
+		m_entries.push_back({key, NULL, h});
+		m_slots[j] = (uint32_t)m_entries.size();
+		*inserted = true;
+		return &m_entries.back();
+	}
+
+	std::vector<entry>::iterator begin()
+	{
+		return m_entries.begin();
+	}
+
+	std::vector<entry>::iterator end()
+	{
+		return m_entries.end();
+	}
+
+	size_t size() const
+	{
+		return m_entries.size();
+	}
+
+	void clear()
+	{
+		if(!m_entries.empty())
+		{
+			m_entries.clear();
+			std::fill(m_slots.begin(), m_slots.end(), 0);
+		}
+	}
+
+private:
+	void grow()
+	{
+		size_t nslots = m_slots.empty()? 64 : m_slots.size() * 2;
+		m_slots.assign(nslots, 0);
+		m_mask = nslots - 1;
+
+		for(uint32_t k = 0; k < m_entries.size(); k++)
+		{
+			size_t j = m_entries[k].m_hash & m_mask;
+			while(m_slots[j] != 0)
+			{
+				j = (j + 1) & m_mask;
+			}
+			m_slots[j] = k + 1;
+		}
+	}
+
+	chisel_table_field_hasher m_hasher;
+	std::vector<entry> m_entries;
+	// index + 1 of the entry in m_entries, 0 for empty slots
+	std::vector<uint32_t> m_slots;
+	size_t m_mask;
+};
+
 class chisel_table_buffer
 {
 public:
@@ -328,6 +452,13 @@ private:
 	inline void add_fields_max(ppm_param_type type, chisel_table_field* dst, chisel_table_field* src);
 	inline void add_fields_min(ppm_param_type type, chisel_table_field* dst, chisel_table_field* src);
 	inline void add_fields(uint32_t dst_id, chisel_table_field* src, uint32_t aggr);
+	inline bool is_sketch_aggregation(uint32_t aggr)
+	{
+		return aggr == A_DISTINCT || aggr == A_TOP;
+	}
+	void new_sketch(uint32_t aggr, chisel_table_field* dst);
+	void add_to_sketch(uint32_t aggr, chisel_table_field* dst, chisel_table_field* src, bool merging);
+	void sketch_to_value(uint32_t aggr, chisel_table_field* fld);
 	void process_proctable(sinsp_evt* evt);
 	inline uint32_t get_field_len(uint32_t id);
 	inline uint8_t* get_default_val(filtercheck_field_info* fld);
@@ -337,9 +468,9 @@ private:
 	void print_json(std::vector<chisel_sample_row>* sample_data, uint64_t time_delta);
 
 	sinsp* m_inspector;
-	std::unordered_map<chisel_table_field, chisel_table_field*, chisel_table_field_hasher>* m_table;
-	std::unordered_map<chisel_table_field, chisel_table_field*, chisel_table_field_hasher> m_premerge_table;
-	std::unordered_map<chisel_table_field, chisel_table_field*, chisel_table_field_hasher> m_merge_table;
+	chisel_table_map* m_table;
+	chisel_table_map m_premerge_table;
+	chisel_table_map m_merge_table;
 	std::vector<filtercheck_field_info> m_premerge_legend;
 	std::vector<check_wrapper*> m_premerge_extractors;
 	std::vector<check_wrapper*> m_postmerge_extractors;
@@ -372,6 +503,7 @@ private:
 	bool m_just_sorted;
 	bool m_is_sorting_ascending;
 	bool m_do_merging;
+	bool m_has_sketches;
 	sinsp_filter* m_filter;
 	bool m_use_defaults;
 	uint64_t m_zero_u64;
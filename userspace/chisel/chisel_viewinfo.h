@@ -32,6 +32,8 @@ typedef enum chisel_field_aggregation
 	A_TIME_AVG,
 	A_MIN,
 	A_MAX,		
+	A_DISTINCT,	// approximate number of distinct values (HyperLogLog)
+	A_TOP,		// approximate most frequent value (Space-Saving)
 } chisel_field_aggregation;
 
 //
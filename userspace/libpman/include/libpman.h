@@ -29,6 +29,24 @@ extern "C"
 	struct scap_stats_v2;
 	struct scap_stats;
 
+	/* Reads and writes of a thread group on one fd, see `pman_set_io_aggregation`. */
+	struct pman_io_aggregate
+	{
+		uint32_t tgid;
+		int32_t fd;
+		uint8_t direction; /* `PPM_IO_AGGREGATE_READ` or `PPM_IO_AGGREGATE_WRITE` */
+		uint64_t count;	   /* number of syscalls */
+		uint64_t bytes;	   /* bytes read or written */
+	};
+
+	/* Context switches and page faults of a thread, see `pman_set_task_aggregation`. */
+	struct pman_task_aggregate
+	{
+		uint32_t tid;
+		uint64_t n_switches;	/* times the thread was switched out */
+		uint64_t n_page_faults; /* user and kernel page faults */
+	};
+
 	/* `libpman` return values convention:
 	 * In case of success `0` is returned otherwise `errno`. If `errno` is not
 	 * available `-1` is returned.
@@ -53,9 +71,11 @@ extern "C"
 	 * @param buf_bytes_dim dimension of a single per-CPU buffer in bytes.
 	 * @param cpus_for_each_buffer number of CPUs to which we want to associate a ring buffer.
 	 * @param allocate_online_only if true, allocate ring buffers taking only into account online CPUs.
+	 * @param numa_aware if true, group the CPUs of each NUMA node separately, so that no ring
+	 * buffer is shared between nodes, and allocate every ring buffer on the node of its CPUs.
 	 * @return `0` on success, `-1` in case of error.
 	 */
-	int pman_init_state(bool verbosity, unsigned long buf_bytes_dim, uint16_t cpus_for_each_buffer, bool allocate_online_only);
+	int pman_init_state(bool verbosity, unsigned long buf_bytes_dim, uint16_t cpus_for_each_buffer, bool allocate_online_only, bool numa_aware);
 
 	/**
 	 * @brief Clear the `libpman` global state before it is used.
@@ -70,6 +90,28 @@ extern "C"
 	 */
 	int pman_get_required_buffers(void);
 
+	/**
+	 * @brief Keep the first events of the ring buffers in a min-heap
+	 * ordered by timestamp, so that every consumed event costs
+	 * O(log(n_buffers)) instead of a scan of all the buffers. The events
+	 * are merged a snapshot of the buffers at a time: new events are
+	 * looked at once all the events of the previous snapshot are
+	 * consumed. Must be called after `pman_init_state` and
+	 * before `pman_prepare_ringbuf_array_before_loading`.
+	 *
+	 * @param heap_merge whether to enable the heap.
+	 */
+	void pman_set_ringbuf_heap_merge(bool heap_merge);
+
+	/**
+	 * @brief Return the NUMA node of a ring buffer, and so of its CPUs,
+	 * e.g. to run the consumer on the same node.
+	 *
+	 * @param ring ring buffer index, as the `buffer_id` returned with the events.
+	 * @return the NUMA node, `-1` if the ring buffers are not NUMA-aware.
+	 */
+	int pman_get_ringbuf_numa_node(int16_t ring);
+
 	/**
 	 * @brief Return whether modern bpf is supported by running kernel.
 	 *
@@ -272,6 +314,31 @@ extern "C"
 	 */
 	void pman_consume_first_event(void** event_ptr, int16_t* buffer_id);
 
+	/**
+	 * @brief Consume up to `max_events` events in timestamp order. The
+	 * events stay valid until the next call to this function or to
+	 * `pman_consume_first_event`. Without `pman_set_ringbuf_heap_merge`
+	 * at most one event is returned per call.
+	 *
+	 * @param event_ptrs filled with the pointers to the events.
+	 * @param buffer_ids filled with the ids of the ring buffers from which
+	 * the events were retrieved.
+	 * @param max_events size of `event_ptrs` and `buffer_ids`.
+	 * @return the number of events returned, `0` if there are none.
+	 */
+	uint32_t pman_consume_events(void** event_ptrs, int16_t* buffer_ids, uint32_t max_events);
+
+	/**
+	 * @brief Wait until the bpf side notifies us that some ring buffers
+	 * crossed the wakeup watermark (see `pman_set_wakeup_watermark`)
+	 * or until the timeout expires.
+	 *
+	 * @param timeout_ms maximum time to wait in milliseconds.
+	 * @return the number of notified ring buffers (`0` on timeout),
+	 * `errno` in case of error (negative value).
+	 */
+	int pman_wait_for_events(int timeout_ms);
+
 	/////////////////////////////
 	// CAPTURE (EXCHANGE VALUES WITH BPF SIDE)
 	/////////////////////////////
@@ -306,6 +373,30 @@ extern "C"
 	 */
 	struct scap_stats_v2* pman_get_scap_stats_v2(uint32_t flags, uint32_t* nstats, int32_t* rc);
 
+	/**
+	 * @brief Set the budget of the run time of the attached programs,
+	 * checked by `pman_check_prog_budgets`. While it's set the run time
+	 * stats of the kernel are enabled, and the libbpf stats also report
+	 * the percentiles of every program and the actions taken on it.
+	 *
+	 * @param budget_ns budget of the median run time of a program,
+	 * `0` to disable it.
+	 * @return `0` on success, `errno` in case of error.
+	 */
+	int pman_set_prog_budget(uint64_t budget_ns);
+
+	/**
+	 * @brief Sample the average run time of every attached program since
+	 * the last call. When the median of the last samples is over the
+	 * budget, `sched_switch` and the page fault programs are sampled,
+	 * twice as much at every call, and `signal_deliver` is detached. The
+	 * other programs are needed to keep the state of the processes, so
+	 * they are only counted as over budget.
+	 *
+	 * @return the number of programs sampled or detached by this call.
+	 */
+	uint32_t pman_check_prog_budgets(void);
+
 	/**
 	 * @brief Receive an array with `nCPUs` elements. For every CPU
 	 * we set the number of events caught.
@@ -347,6 +438,30 @@ extern "C"
 	 */
 	void pman_set_drop_failed(bool drop_failed);
 
+	/**
+	 * @brief Set the maximum length we read from the I/O buffers of
+	 * a kind of fd, instead of the global `snaplen`.
+	 *
+	 * @param fd_type one of `enum ppm_snaplen_fd_type`.
+	 * @param snaplen maximum length we accept, `SNAPLEN_FD_TYPE_DEFAULT`
+	 * to use the global `snaplen`.
+	 */
+	void pman_set_fd_type_snaplen(uint32_t fd_type, uint32_t snaplen);
+
+	/**
+	 * @brief Cap the length we read from the I/O buffers of the
+	 * events sent to a ring buffer, whatever the `snaplen`, the
+	 * fd type snaplen or the dynamic snaplen would give them. This
+	 * applies to all the CPUs sharing that ring buffer.
+	 *
+	 * @param ring index of the ring buffer.
+	 * @param snaplen maximum length we accept, `SNAPLEN_NO_LIMIT`
+	 * to remove the cap.
+	 * @return `0` on success, `EINVAL` if the ring buffer doesn't
+	 * exist, an errno if the map can't be updated.
+	 */
+	int pman_set_ring_snaplen(int16_t ring, uint32_t snaplen);
+
 	/**
 	 * @brief Ask driver to enable/disable dynamic_snaplen.
 	 *
@@ -369,6 +484,143 @@ extern "C"
 	 */
 	void pman_set_statsd_port(uint16_t statsd_port);
 
+	/**
+	 * @brief Ask driver to notify userspace every time the unconsumed
+	 * data of a ring buffer crosses `watermark` bytes.
+	 *
+	 * @param watermark size in bytes, `0` to never notify userspace.
+	 */
+	void pman_set_wakeup_watermark(uint32_t watermark);
+
+	/**
+	 * @brief Ask driver to sample and/or rate limit the events of a
+	 * syscall. Enter and exit events are limited on their own, the
+	 * rate limit is enforced on every CPU. The dropped events are
+	 * counted in the `n_drops_syscall_limit.<syscall>` stats.
+	 *
+	 * @param syscall_id syscall id.
+	 * @param sample_every keep one event every `sample_every`, `0`
+	 * or `1` to keep them all.
+	 * @param max_per_sec keep at most `max_per_sec` events per second
+	 * on every CPU, `0` for no limit.
+	 * @return `0` on success, `EINVAL` if the syscall id is not valid.
+	 */
+	int pman_set_syscall_limit(int syscall_id, uint32_t sample_every, uint32_t max_per_sec);
+
+	/**
+	 * @brief Ask driver to sample and/or rate limit the events of a
+	 * tracepoint, like `pman_set_syscall_limit` does for the syscalls.
+	 * Only `sched_switch`, `page_fault_user` and `page_fault_kernel`
+	 * can be limited.
+	 *
+	 * @param ppm_sc ppm_sc of the tracepoint.
+	 * @param sample_every keep one event every `sample_every`, `0`
+	 * or `1` to keep them all.
+	 * @param max_per_sec keep at most `max_per_sec` events per second
+	 * on every CPU, `0` for no limit.
+	 * @return `0` on success, `EINVAL` if the tracepoint can't be limited.
+	 */
+	int pman_set_tracepoint_limit(int ppm_sc, uint32_t sample_every, uint32_t max_per_sec);
+
+	/**
+	 * @brief Tell if a syscall is sampled or rate limited
+	 * (see `pman_set_syscall_limit`).
+	 *
+	 * @param syscall_id syscall id.
+	 * @return `true` if the syscall is limited.
+	 */
+	bool pman_is_syscall_limited(int syscall_id);
+
+	/**
+	 * @brief Ask driver to drop the syscall events of the tasks
+	 * with one of these comms. The syscalls that create or exec a
+	 * task are never dropped.
+	 *
+	 * @param comms comms to suppress, longer ones are truncated
+	 * as the kernel does.
+	 * @param n_comms number of comms, `0` to disable the filter.
+	 * @return `0` on success, `EINVAL` if there are too many comms.
+	 */
+	int pman_set_suppressed_comms(const char** comms, uint32_t n_comms);
+
+	/**
+	 * @brief Ask driver to (stop) drop(ping) the syscall events of
+	 * a thread, see `pman_set_suppressed_comms`.
+	 *
+	 * @param tid thread id.
+	 * @param suppressed whether the thread is suppressed.
+	 * @return `0` on success, `errno` otherwise.
+	 */
+	int pman_set_suppressed_tid(uint64_t tid, bool suppressed);
+
+	/**
+	 * @brief Ask driver to filter the syscall events by the cgroup
+	 * of the task, see `enum ppm_cgroup_filter_mode`.
+	 *
+	 * @param mode how the cgroups listed with
+	 * `pman_set_cgroup_filter` are filtered.
+	 */
+	void pman_set_cgroup_filter_mode(uint8_t mode);
+
+	/**
+	 * @brief Add or remove a cgroup from the cgroup filter.
+	 *
+	 * @param cgroup_id the cgroup id.
+	 * @param listed whether the cgroup is listed.
+	 * @return `0` on success, `errno` otherwise.
+	 */
+	int pman_set_cgroup_filter(uint64_t cgroup_id, bool listed);
+
+	/**
+	 * @brief Ask driver to (stop) sum(ming) the read and write syscalls
+	 * by (tgid, fd, direction) instead of sending their events. The sums
+	 * are taken with `pman_drain_io_aggregates`.
+	 *
+	 * @param enable whether to enable the I/O aggregation.
+	 */
+	void pman_set_io_aggregation(bool enable);
+
+	/**
+	 * @brief Take the I/O aggregates summed by the driver since the last
+	 * call, and reset them.
+	 *
+	 * @param aggregates filled with the aggregates.
+	 * @param max_aggregates size of `aggregates`, the remaining ones are
+	 * returned by the next call.
+	 * @return the number of aggregates returned.
+	 */
+	uint32_t pman_drain_io_aggregates(struct pman_io_aggregate* aggregates, uint32_t max_aggregates);
+
+	/**
+	 * @brief Ask driver to (stop) count(ing) the context switches and the
+	 * page faults per tid instead of sending their events. The counts
+	 * are taken with `pman_drain_task_aggregates`.
+	 *
+	 * @param enable whether to enable the task aggregation.
+	 */
+	void pman_set_task_aggregation(bool enable);
+
+	/**
+	 * @brief Take the task aggregates counted by the driver since the last
+	 * call, summing the counts of all the CPUs, and reset them.
+	 *
+	 * @param aggregates filled with the aggregates.
+	 * @param max_aggregates size of `aggregates`, the remaining ones are
+	 * returned by the next call.
+	 * @return the number of aggregates returned.
+	 */
+	uint32_t pman_drain_task_aggregates(struct pman_task_aggregate* aggregates, uint32_t max_aggregates);
+
+	/**
+	 * @brief Ask driver to (stop) send(ing) empty `exe`, `comm` and `cgroups`
+	 * params in the clone/execve exit events when they didn't change since
+	 * the last event of the thread. These events carry the
+	 * `PPM_CL_STRINGS_INTERNED`/`PPM_EXE_STRINGS_INTERNED` flag.
+	 *
+	 * @param enable whether to enable the string interning.
+	 */
+	void pman_set_string_interning(bool enable);
+
 	/**
 	 * @brief Get API version to check it a runtime.
 	 *
@@ -16,6 +16,7 @@ limitations under the License.
 */
 
 #include "state.h"
+#include <string.h>
 
 static int setup_libbpf_print_verbose(enum libbpf_print_level level, const char* format, va_list args)
 {
@@ -53,6 +54,16 @@ void pman_clear_state()
 	g_state.allocate_online_only = false;
 	g_state.n_required_buffers = 0;
 	g_state.cpus_for_each_buffer = 0;
+	g_state.numa_aware = false;
+	g_state.cpu_ringbufs = NULL;
+	g_state.ringbuf_numa_nodes = NULL;
+	g_state.n_numa_nodes = 0;
+	g_state.heap_merge = false;
+	g_state.heap = NULL;
+	g_state.heap_len = 0;
+	g_state.consumed_rings = NULL;
+	g_state.n_consumed_rings = 0;
+	g_state.ring_consumed = NULL;
 	g_state.ringbuf_pos = 0;
 	g_state.cons_pos = NULL;
 	g_state.prod_pos = NULL;
@@ -62,9 +73,13 @@ void pman_clear_state()
 	g_state.last_event_size = 0;
 	g_state.n_attached_progs = 0;
 	g_state.stats = NULL;
+	g_state.n_stats_allocated = 0;
+	g_state.prog_budget_ns = 0;
+	g_state.prog_run_stats_fd = -1;
+	memset(g_state.prog_budgets, 0, sizeof(g_state.prog_budgets));
 }
 
-int pman_init_state(bool verbosity, unsigned long buf_bytes_dim, uint16_t cpus_for_each_buffer, bool allocate_online_only)
+int pman_init_state(bool verbosity, unsigned long buf_bytes_dim, uint16_t cpus_for_each_buffer, bool allocate_online_only, bool numa_aware)
 {
 	char error_message[MAX_ERROR_MESSAGE_LEN];
 
@@ -86,6 +101,7 @@ int pman_init_state(bool verbosity, unsigned long buf_bytes_dim, uint16_t cpus_f
 	}
 
 	g_state.allocate_online_only = allocate_online_only;
+	g_state.numa_aware = numa_aware;
 
 	if(g_state.allocate_online_only)
 	{
@@ -144,11 +160,25 @@ int pman_init_state(bool verbosity, unsigned long buf_bytes_dim, uint16_t cpus_f
 	return 0;
 }
 
+void pman_set_ringbuf_heap_merge(bool heap_merge)
+{
+	g_state.heap_merge = heap_merge;
+}
+
 int pman_get_required_buffers()
 {
 	return g_state.n_required_buffers;
 }
 
+int pman_get_ringbuf_numa_node(int16_t ring)
+{
+	if(!g_state.numa_aware || g_state.ringbuf_numa_nodes == NULL || ring < 0 || ring >= g_state.n_required_buffers)
+	{
+		return -1;
+	}
+	return g_state.ringbuf_numa_nodes[ring];
+}
+
 /*
  * Probe the kernel for required dependencies, ring buffer maps and tracing
  * progs needs to be supported.
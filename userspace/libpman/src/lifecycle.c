@@ -89,6 +89,37 @@ void pman_close_probe()
 		free(g_state.prod_pos);
 	}
 
+	if(g_state.cpu_ringbufs)
+	{
+		free(g_state.cpu_ringbufs);
+	}
+
+	if(g_state.ringbuf_numa_nodes)
+	{
+		free(g_state.ringbuf_numa_nodes);
+	}
+
+	if(g_state.heap)
+	{
+		free(g_state.heap);
+	}
+
+	if(g_state.consumed_rings)
+	{
+		free(g_state.consumed_rings);
+	}
+
+	if(g_state.ring_consumed)
+	{
+		free(g_state.ring_consumed);
+	}
+
+	if(g_state.prog_run_stats_fd >= 0)
+	{
+		close(g_state.prog_run_stats_fd);
+		g_state.prog_run_stats_fd = -1;
+	}
+
 	if(g_state.skel)
 	{
 		bpf_probe__detach(g_state.skel);
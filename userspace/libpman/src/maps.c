@@ -18,8 +18,11 @@ limitations under the License.
 #include "state.h"
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include "events_prog_names.h"
 #include <scap.h>
+#include <libpman.h>
 
 extern const struct ppm_event_info g_event_info[PPM_EVENT_MAX];
 extern const struct syscall_evt_pair g_syscall_table[SYSCALL_TABLE_SIZE];
@@ -87,6 +90,117 @@ void pman_set_drop_failed(bool drop_failed)
 	g_state.skel->bss->g_settings.drop_failed = drop_failed;
 }
 
+void pman_set_fd_type_snaplen(uint32_t fd_type, uint32_t snaplen)
+{
+	if(fd_type >= SNAPLEN_FD_TYPES)
+	{
+		return;
+	}
+
+	g_state.skel->bss->g_settings.fd_type_snaplen[fd_type] = snaplen;
+
+	bool has_fd_type_snaplen = false;
+	for(int i = 0; i < SNAPLEN_FD_TYPES; i++)
+	{
+		if(g_state.skel->bss->g_settings.fd_type_snaplen[i] != SNAPLEN_FD_TYPE_DEFAULT)
+		{
+			has_fd_type_snaplen = true;
+		}
+	}
+	g_state.skel->bss->g_settings.has_fd_type_snaplen = has_fd_type_snaplen;
+}
+
+int pman_set_ring_snaplen(int16_t ring, uint32_t snaplen)
+{
+	if(g_state.cpu_ringbufs == NULL || ring < 0 || ring >= g_state.n_required_buffers)
+	{
+		return EINVAL;
+	}
+
+	int fd = bpf_map__fd(g_state.skel->maps.snaplen_limits);
+	bool has_snaplen_limits = false;
+	for(uint32_t cpu = 0; cpu < g_state.n_possible_cpus; cpu++)
+	{
+		uint32_t limit = SNAPLEN_NO_LIMIT;
+		if(g_state.cpu_ringbufs[cpu] == ring)
+		{
+			if(bpf_map_update_elem(fd, &cpu, &snaplen, BPF_ANY))
+			{
+				return errno;
+			}
+			limit = snaplen;
+		}
+		else if(bpf_map_lookup_elem(fd, &cpu, &limit))
+		{
+			return errno;
+		}
+
+		if(limit != SNAPLEN_NO_LIMIT)
+		{
+			has_snaplen_limits = true;
+		}
+	}
+	g_state.skel->bss->g_settings.has_snaplen_limits = has_snaplen_limits;
+	return 0;
+}
+
+bool pman_is_syscall_limited(int syscall_id)
+{
+	if(syscall_id < 0 || syscall_id >= SYSCALL_TABLE_SIZE)
+	{
+		return false;
+	}
+
+	struct syscall_limit *limit = &g_state.skel->bss->g_64bit_syscall_limits[syscall_id];
+	return limit->sample_every > 1 || limit->max_per_sec != 0;
+}
+
+int pman_set_syscall_limit(int syscall_id, uint32_t sample_every, uint32_t max_per_sec)
+{
+	if(syscall_id < 0 || syscall_id >= SYSCALL_TABLE_SIZE)
+	{
+		return EINVAL;
+	}
+
+	g_state.skel->bss->g_64bit_syscall_limits[syscall_id].sample_every = sample_every;
+	g_state.skel->bss->g_64bit_syscall_limits[syscall_id].max_per_sec = max_per_sec;
+
+	bool has_syscall_limits = false;
+	for(int i = 0; i < SYSCALL_TABLE_SIZE; i++)
+	{
+		if(pman_is_syscall_limited(i))
+		{
+			has_syscall_limits = true;
+			break;
+		}
+	}
+	g_state.skel->bss->g_settings.has_syscall_limits = has_syscall_limits;
+	return 0;
+}
+
+int pman_set_tracepoint_limit(int ppm_sc, uint32_t sample_every, uint32_t max_per_sec)
+{
+	int tp;
+	switch(ppm_sc)
+	{
+	case PPM_SC_SCHED_SWITCH:
+		tp = LIMITED_TP_SCHED_SWITCH;
+		break;
+	case PPM_SC_PAGE_FAULT_USER:
+		tp = LIMITED_TP_PAGE_FAULT_USER;
+		break;
+	case PPM_SC_PAGE_FAULT_KERNEL:
+		tp = LIMITED_TP_PAGE_FAULT_KERNEL;
+		break;
+	default:
+		return EINVAL;
+	}
+
+	g_state.skel->bss->g_tracepoint_limits[tp].sample_every = sample_every;
+	g_state.skel->bss->g_tracepoint_limits[tp].max_per_sec = max_per_sec;
+	return 0;
+}
+
 void pman_set_do_dynamic_snaplen(bool do_dynamic_snaplen)
 {
 	g_state.skel->bss->g_settings.do_dynamic_snaplen = do_dynamic_snaplen;
@@ -103,6 +217,216 @@ void pman_set_statsd_port(uint16_t statsd_port)
 	g_state.skel->bss->g_settings.statsd_port = statsd_port;
 }
 
+void pman_set_wakeup_watermark(uint32_t watermark)
+{
+	g_state.skel->bss->g_settings.wakeup_watermark = watermark;
+}
+
+int pman_set_suppressed_comms(const char** comms, uint32_t n_comms)
+{
+	char error_message[MAX_ERROR_MESSAGE_LEN];
+
+	if(n_comms > MAX_SUPPRESSED_COMMS)
+	{
+		snprintf(error_message, MAX_ERROR_MESSAGE_LEN, "too many suppressed comms %u, the maximum is %d", n_comms, MAX_SUPPRESSED_COMMS);
+		pman_print_error((const char*)error_message);
+		return EINVAL;
+	}
+
+	/* The programs keep reading the settings: disable the filter while
+	 * the comms are written, so that they never see a partial entry.
+	 */
+	g_state.skel->bss->g_settings.n_suppressed_comms = 0;
+	__sync_synchronize();
+	memset(g_state.skel->bss->g_settings.suppressed_comms, 0, sizeof(g_state.skel->bss->g_settings.suppressed_comms));
+	for(uint32_t i = 0; i < n_comms; i++)
+	{
+		strncpy(g_state.skel->bss->g_settings.suppressed_comms[i], comms[i], SUPPRESSED_COMM_LEN - 1);
+	}
+	__sync_synchronize();
+	g_state.skel->bss->g_settings.n_suppressed_comms = n_comms;
+	return 0;
+}
+
+int pman_set_suppressed_tid(uint64_t tid, bool suppressed)
+{
+	uint32_t key = (uint32_t)tid;
+	uint8_t value = 1;
+	int fd = bpf_map__fd(g_state.skel->maps.suppressed_tids);
+
+	if(suppressed)
+	{
+		if(bpf_map_update_elem(fd, &key, &value, BPF_ANY))
+		{
+			return errno;
+		}
+	}
+	else if(bpf_map_delete_elem(fd, &key) && errno != ENOENT)
+	{
+		return errno;
+	}
+	return 0;
+}
+
+void pman_set_cgroup_filter_mode(uint8_t mode)
+{
+	g_state.skel->bss->g_settings.cgroup_filter_mode = mode;
+}
+
+int pman_set_cgroup_filter(uint64_t cgroup_id, bool listed)
+{
+	uint8_t value = 1;
+	int fd = bpf_map__fd(g_state.skel->maps.cgroup_filter);
+
+	if(listed)
+	{
+		if(bpf_map_update_elem(fd, &cgroup_id, &value, BPF_ANY))
+		{
+			return errno;
+		}
+	}
+	else if(bpf_map_delete_elem(fd, &cgroup_id) && errno != ENOENT)
+	{
+		return errno;
+	}
+	return 0;
+}
+
+void pman_set_io_aggregation(bool enable)
+{
+	static const ppm_sc_code read_sc[] = {PPM_SC_READ, PPM_SC_PREAD64, PPM_SC_READV, PPM_SC_PREADV, PPM_SC_RECV, PPM_SC_RECVFROM, PPM_SC_RECVMSG};
+	static const ppm_sc_code write_sc[] = {PPM_SC_WRITE, PPM_SC_PWRITE64, PPM_SC_WRITEV, PPM_SC_PWRITEV, PPM_SC_SEND, PPM_SC_SENDTO, PPM_SC_SENDMSG};
+
+	memset(g_state.skel->bss->g_64bit_io_aggregate_syscalls, 0, sizeof(g_state.skel->bss->g_64bit_io_aggregate_syscalls));
+	if(enable)
+	{
+		for(int i = 0; i < sizeof(read_sc) / sizeof(*read_sc); i++)
+		{
+			int syscall_id = scap_ppm_sc_to_native_id(read_sc[i]);
+			/* if `syscall_id` is -1 this is not a syscall */
+			if(syscall_id != -1)
+			{
+				g_state.skel->bss->g_64bit_io_aggregate_syscalls[syscall_id] = PPM_IO_AGGREGATE_READ;
+			}
+		}
+		for(int i = 0; i < sizeof(write_sc) / sizeof(*write_sc); i++)
+		{
+			int syscall_id = scap_ppm_sc_to_native_id(write_sc[i]);
+			if(syscall_id != -1)
+			{
+				g_state.skel->bss->g_64bit_io_aggregate_syscalls[syscall_id] = PPM_IO_AGGREGATE_WRITE;
+			}
+		}
+	}
+	g_state.skel->bss->g_settings.io_aggregation = enable;
+}
+
+uint32_t pman_drain_io_aggregates(struct pman_io_aggregate* aggregates, uint32_t max_aggregates)
+{
+	int fd = bpf_map__fd(g_state.skel->maps.io_aggregates);
+	struct io_aggregate_key key;
+	struct io_aggregate_key next_key;
+	struct io_aggregate value;
+	uint32_t n = 0;
+
+	/* We take the next key before deleting the current one, otherwise
+	 * the iteration would start again from the first key.
+	 */
+	bool has_key = bpf_map_get_next_key(fd, NULL, &key) == 0;
+	while(has_key && n < max_aggregates)
+	{
+		has_key = bpf_map_get_next_key(fd, &key, &next_key) == 0;
+
+		/* Without `lookup_and_delete` (kernels < 5.14) the syscalls summed
+		 * between the two calls are lost.
+		 */
+		if(bpf_map_lookup_and_delete_elem(fd, &key, &value) != 0)
+		{
+			if(bpf_map_lookup_elem(fd, &key, &value) != 0)
+			{
+				key = next_key;
+				continue;
+			}
+			bpf_map_delete_elem(fd, &key);
+		}
+
+		/* Enter events only create the aggregate, there is nothing to report */
+		if(value.count > 0)
+		{
+			aggregates[n].tgid = key.tgid;
+			aggregates[n].fd = key.fd;
+			aggregates[n].direction = key.direction;
+			aggregates[n].count = value.count;
+			aggregates[n].bytes = value.bytes;
+			n++;
+		}
+		key = next_key;
+	}
+	return n;
+}
+
+void pman_set_task_aggregation(bool enable)
+{
+	g_state.skel->bss->g_settings.task_aggregation = enable;
+}
+
+uint32_t pman_drain_task_aggregates(struct pman_task_aggregate* aggregates, uint32_t max_aggregates)
+{
+	int fd = bpf_map__fd(g_state.skel->maps.task_aggregates);
+	uint32_t key;
+	uint32_t next_key;
+	uint32_t n = 0;
+
+	/* The values of a per-CPU map are read all together, one for each
+	 * possible CPU.
+	 */
+	struct task_aggregate* values = (struct task_aggregate*)calloc(g_state.n_possible_cpus, sizeof(struct task_aggregate));
+	if(values == NULL)
+	{
+		pman_print_error("unable to allocate memory for the task aggregates");
+		return 0;
+	}
+
+	/* As for the I/O aggregates, we take the next key before deleting the current one */
+	bool has_key = bpf_map_get_next_key(fd, NULL, &key) == 0;
+	while(has_key && n < max_aggregates)
+	{
+		has_key = bpf_map_get_next_key(fd, &key, &next_key) == 0;
+
+		if(bpf_map_lookup_and_delete_elem(fd, &key, values) != 0)
+		{
+			if(bpf_map_lookup_elem(fd, &key, values) != 0)
+			{
+				key = next_key;
+				continue;
+			}
+			bpf_map_delete_elem(fd, &key);
+		}
+
+		aggregates[n].tid = key;
+		aggregates[n].n_switches = 0;
+		aggregates[n].n_page_faults = 0;
+		for(int cpu = 0; cpu < g_state.n_possible_cpus; cpu++)
+		{
+			aggregates[n].n_switches += values[cpu].n_switches;
+			aggregates[n].n_page_faults += values[cpu].n_page_faults;
+		}
+		if(aggregates[n].n_switches > 0 || aggregates[n].n_page_faults > 0)
+		{
+			n++;
+		}
+		key = next_key;
+	}
+
+	free(values);
+	return n;
+}
+
+void pman_set_string_interning(bool enable)
+{
+	g_state.skel->bss->g_settings.string_interning = enable;
+}
+
 void pman_mark_single_64bit_syscall(int intersting_syscall_id, bool interesting)
 {
 	g_state.skel->bss->g_64bit_interesting_syscalls_table[intersting_syscall_id] = interesting;
@@ -320,6 +644,44 @@ static int size_counter_maps()
 	return 0;
 }
 
+static int size_limit_maps()
+{
+	/* We always allocate limit maps from all the CPUs, even if some of them are not online. */
+	if(bpf_map__set_max_entries(g_state.skel->maps.limit_maps, g_state.n_possible_cpus))
+	{
+		pman_print_error("unable to set max entries for 'limit_maps'");
+		return errno;
+	}
+	return 0;
+}
+
+static int size_snaplen_limits()
+{
+	if(bpf_map__set_max_entries(g_state.skel->maps.snaplen_limits, g_state.n_possible_cpus))
+	{
+		pman_print_error("unable to set max entries for 'snaplen_limits'");
+		return errno;
+	}
+	return 0;
+}
+
+/* A zeroed entry would mean an empty snaplen, so every CPU starts without limit. */
+static int fill_snaplen_limits()
+{
+	int fd = bpf_map__fd(g_state.skel->maps.snaplen_limits);
+	uint32_t limit = SNAPLEN_NO_LIMIT;
+	for(uint32_t cpu = 0; cpu < g_state.n_possible_cpus; cpu++)
+	{
+		if(bpf_map_update_elem(fd, &cpu, &limit, BPF_ANY))
+		{
+			pman_print_error("unable to initialize 'snaplen_limits'");
+			return errno;
+		}
+	}
+	g_state.skel->bss->g_settings.has_snaplen_limits = false;
+	return 0;
+}
+
 /*=============================== BPF_MAP_TYPE_ARRAY ===============================*/
 
 /* Here we split maps operations, before and after the loading phase.
@@ -338,6 +700,8 @@ int pman_prepare_maps_before_loading()
 	 */
 	err = size_auxiliary_maps();
 	err = err ?: size_counter_maps();
+	err = err ?: size_limit_maps();
+	err = err ?: size_snaplen_limits();
 	return err;
 }
 
@@ -353,11 +717,26 @@ int pman_finalize_maps_after_loading()
 	pman_set_do_dynamic_snaplen(false);
 	pman_set_fullcapture_port_range(0, 0);
 	pman_set_statsd_port(PPM_PORT_STATSD);
+	pman_set_wakeup_watermark(0);
+	pman_set_suppressed_comms(NULL, 0);
+	pman_set_io_aggregation(false);
+	pman_set_task_aggregation(false);
+	pman_set_string_interning(false);
+	for(int i = 0; i < LIMITED_TP_MAX; i++)
+	{
+		g_state.skel->bss->g_tracepoint_limits[i].sample_every = 0;
+		g_state.skel->bss->g_tracepoint_limits[i].max_per_sec = 0;
+	}
+	for(int i = 0; i < SNAPLEN_FD_TYPES; i++)
+	{
+		pman_set_fd_type_snaplen(i, SNAPLEN_FD_TYPE_DEFAULT);
+	}
 
 	/* We have to fill all ours tail tables. */
 	pman_fill_syscall_sampling_table();
 	pman_fill_syscall_tracepoint_table();
 	err = pman_fill_syscalls_tail_table();
 	err = err ?: pman_fill_extra_event_prog_tail_table();
+	err = err ?: fill_snaplen_limits();
 	return err;
 }
@@ -21,19 +21,160 @@ limitations under the License.
 #include <stdint.h>
 #include <stdbool.h>
 #include <sys/mman.h>
+#include <sys/epoll.h>
+#include <errno.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <string.h>
 #include <ppm_events_public.h>
 
 #include "ringbuffer_definitions.h"
 
 /* Utility functions object loading */
 
+static bool is_cpu_online(uint16_t cpu_id)
+{
+	/* CPU 0 is always online */
+	if(cpu_id == 0)
+	{
+		return true;
+	}
+
+	char filename[FILENAME_MAX];
+	int online = 0;
+	snprintf(filename, sizeof(filename), "/sys/devices/system/cpu/cpu%d/online", cpu_id);
+	FILE *fp = fopen(filename, "r");
+	if(fp == NULL)
+	{
+		/* When missing NUMA properties, CPUs do not expose online information.
+		 * Fallback at considering them online if we can at least reach their folder.
+		 * This is useful for example for raspPi devices.
+		 * See: https://github.com/kubernetes/kubernetes/issues/95039
+		 */
+		snprintf(filename, sizeof(filename), "/sys/devices/system/cpu/cpu%d/", cpu_id);
+		if(access(filename, F_OK) == 0)
+		{
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	fscanf(fp, "%d", &online);
+	fclose(fp);
+	return online == 1;
+}
+
+/* Return the NUMA node of a CPU, `0` if the system doesn't expose it. */
+static int get_cpu_numa_node(uint16_t cpu_id)
+{
+	char dirname[FILENAME_MAX];
+	int node = 0;
+	snprintf(dirname, sizeof(dirname), "/sys/devices/system/cpu/cpu%d", cpu_id);
+	DIR *dir = opendir(dirname);
+	if(dir == NULL)
+	{
+		return 0;
+	}
+
+	/* The CPU folder contains a `node<N>` link to its node. */
+	struct dirent *entry;
+	while((entry = readdir(dir)) != NULL)
+	{
+		if(strncmp(entry->d_name, "node", 4) == 0 && isdigit((unsigned char)entry->d_name[4]))
+		{
+			node = atoi(entry->d_name + 4);
+			break;
+		}
+	}
+	closedir(dir);
+	return node;
+}
+
+/* In NUMA-aware mode the CPUs are grouped node by node, so the number of ring
+ * buffers may be greater than the one computed in `pman_init_state`.
+ */
+static int ringbuf_array_set_numa_layout()
+{
+	int *cpu_nodes = (int *)calloc(g_state.n_possible_cpus, sizeof(int));
+	g_state.cpu_ringbufs = (int16_t *)calloc(g_state.n_possible_cpus, sizeof(int16_t));
+	/* There can't be more ring buffers than CPUs. */
+	g_state.ringbuf_numa_nodes = (int *)calloc(g_state.n_possible_cpus, sizeof(int));
+	if(cpu_nodes == NULL || g_state.cpu_ringbufs == NULL || g_state.ringbuf_numa_nodes == NULL)
+	{
+		free(cpu_nodes);
+		pman_print_error("failed to alloc memory for the NUMA layout");
+		return errno;
+	}
+
+	int max_node = 0;
+	for(int i = 0; i < g_state.n_possible_cpus; i++)
+	{
+		g_state.cpu_ringbufs[i] = -1;
+		if(g_state.allocate_online_only && !is_cpu_online(i))
+		{
+			cpu_nodes[i] = -1;
+			continue;
+		}
+		cpu_nodes[i] = get_cpu_numa_node(i);
+		if(cpu_nodes[i] > max_node)
+		{
+			max_node = cpu_nodes[i];
+		}
+	}
+
+	int n_buffers = 0;
+	g_state.n_numa_nodes = 0;
+	for(int node = 0; node <= max_node; node++)
+	{
+		int reached = 0;
+		for(int i = 0; i < g_state.n_possible_cpus; i++)
+		{
+			if(cpu_nodes[i] != node)
+			{
+				continue;
+			}
+
+			if(reached == 0)
+			{
+				/* First CPU of a new ring buffer */
+				if(n_buffers == 0 || g_state.ringbuf_numa_nodes[n_buffers - 1] != node)
+				{
+					g_state.n_numa_nodes++;
+				}
+				g_state.ringbuf_numa_nodes[n_buffers++] = node;
+			}
+			g_state.cpu_ringbufs[i] = n_buffers - 1;
+
+			if(++reached == g_state.cpus_for_each_buffer)
+			{
+				reached = 0;
+			}
+		}
+	}
+	free(cpu_nodes);
+
+	g_state.n_required_buffers = n_buffers;
+	return 0;
+}
+
+/* Ring buffers are only bound to a node when there is more than one. */
+static uint32_t ringbuf_map_flags()
+{
+	return (g_state.numa_aware && g_state.n_numa_nodes > 1) ? BPF_F_NUMA_NODE : 0;
+}
+
 /* This must be done to please the verifier! At load-time, the verifier must know the
  * size of a map inside the array.
  */
 static int ringbuf_array_set_inner_map()
 {
 	int err = 0;
-	int inner_map_fd = bpf_map_create(BPF_MAP_TYPE_RINGBUF, NULL, 0, 0, g_state.buffer_bytes_dim, NULL);
+	/* The flags of the inner maps must match the ones of this map, the node doesn't matter. */
+	LIBBPF_OPTS(bpf_map_create_opts, opts, .map_flags = ringbuf_map_flags());
+	int inner_map_fd = bpf_map_create(BPF_MAP_TYPE_RINGBUF, NULL, 0, 0, g_state.buffer_bytes_dim, &opts);
 	if(inner_map_fd < 0)
 	{
 		pman_print_error("failed to create the dummy inner map");
@@ -81,50 +222,47 @@ static int allocate_consumer_producer_positions()
 	return 0;
 }
 
-/* Before loading */
-int pman_prepare_ringbuf_array_before_loading()
+/* The first event of a ring buffer, as kept in the heap. */
+struct ringbuf_heap_entry
 {
-	int err;
-	err = ringbuf_array_set_inner_map();
-	err = err ?: ringbuf_array_set_max_entries();
-	/* Allocate consumer positions and producer positions for the ringbuffer. */
-	err = err ?: allocate_consumer_producer_positions();
-	return err;
-}
+	uint64_t ts;
+	struct ppm_evt_hdr *evt;
+	unsigned long size;
+	int16_t ring;
+};
 
-static bool is_cpu_online(uint16_t cpu_id)
+static int allocate_ringbuf_heap()
 {
-	/* CPU 0 is always online */
-	if(cpu_id == 0)
+	g_state.heap = (struct ringbuf_heap_entry *)calloc(g_state.n_required_buffers, sizeof(struct ringbuf_heap_entry));
+	g_state.consumed_rings = (int16_t *)calloc(g_state.n_required_buffers, sizeof(int16_t));
+	g_state.ring_consumed = (bool *)calloc(g_state.n_required_buffers, sizeof(bool));
+	if(g_state.heap == NULL || g_state.consumed_rings == NULL || g_state.ring_consumed == NULL)
 	{
-		return true;
+		pman_print_error("failed to allocate the ring buffer heap");
+		return errno;
 	}
+	g_state.heap_len = 0;
+	g_state.n_consumed_rings = 0;
+	return 0;
+}
 
-	char filename[FILENAME_MAX];
-	int online = 0;
-	snprintf(filename, sizeof(filename), "/sys/devices/system/cpu/cpu%d/online", cpu_id);
-	FILE *fp = fopen(filename, "r");
-	if(fp == NULL)
+/* Before loading */
+int pman_prepare_ringbuf_array_before_loading()
+{
+	int err = 0;
+	if(g_state.numa_aware)
 	{
-		/* When missing NUMA properties, CPUs do not expose online information.
-		 * Fallback at considering them online if we can at least reach their folder.
-		 * This is useful for example for raspPi devices.
-		 * See: https://github.com/kubernetes/kubernetes/issues/95039
-		 */
-		snprintf(filename, sizeof(filename), "/sys/devices/system/cpu/cpu%d/", cpu_id);
-		if(access(filename, F_OK) == 0)
-		{
-			return true;
-		}
-		else
-		{
-			return false;
-		}
+		err = ringbuf_array_set_numa_layout();
 	}
-
-	fscanf(fp, "%d", &online);
-	fclose(fp);
-	return online == 1;
+	err = err ?: ringbuf_array_set_inner_map();
+	err = err ?: ringbuf_array_set_max_entries();
+	/* Allocate consumer positions and producer positions for the ringbuffer. */
+	err = err ?: allocate_consumer_producer_positions();
+	if(g_state.heap_merge)
+	{
+		err = err ?: allocate_ringbuf_heap();
+	}
+	return err;
 }
 
 /* After loading */
@@ -146,7 +284,12 @@ int pman_finalize_ringbuf_array_after_loading()
 	/* Create ring buffer maps. */
 	for(int i = 0; i < g_state.n_required_buffers; i++)
 	{
-		ringbufs_fds[i] = bpf_map_create(BPF_MAP_TYPE_RINGBUF, NULL, 0, 0, g_state.buffer_bytes_dim, NULL);
+		LIBBPF_OPTS(bpf_map_create_opts, opts, .map_flags = ringbuf_map_flags());
+		if(g_state.numa_aware)
+		{
+			opts.numa_node = g_state.ringbuf_numa_nodes[i];
+		}
+		ringbufs_fds[i] = bpf_map_create(BPF_MAP_TYPE_RINGBUF, NULL, 0, 0, g_state.buffer_bytes_dim, &opts);
 		if(ringbufs_fds[i] <= 0)
 		{
 			snprintf(error_message, MAX_ERROR_MESSAGE_LEN, "failed to create the ringbuf map for CPU '%d'. (If you get memory allocation errors try to reduce the buffer dimension)", i);
@@ -185,15 +328,41 @@ int pman_finalize_ringbuf_array_after_loading()
 		return errno;
 	}
 
+	/* Outside of NUMA-aware mode the association is recorded while it is
+	 * computed, see `pman_set_ring_snaplen`.
+	 */
+	if(!g_state.numa_aware)
+	{
+		g_state.cpu_ringbufs = (int16_t *)calloc(g_state.n_possible_cpus, sizeof(int16_t));
+		if(g_state.cpu_ringbufs == NULL)
+		{
+			pman_print_error("failed to alloc memory for the ring buffer of every CPU");
+			goto clean_percpu_ring_buffers;
+		}
+		for(int i = 0; i < g_state.n_possible_cpus; i++)
+		{
+			g_state.cpu_ringbufs[i] = -1;
+		}
+	}
+
 	/* We need to associate every CPU to the right ring buffer */
 	int ringbuf_id = 0;
 	int reached = 0;
 	for(int i = 0; i < g_state.n_possible_cpus; i++)
 	{
+		/* In NUMA-aware mode the association is already computed. */
+		if(g_state.numa_aware)
+		{
+			if(g_state.cpu_ringbufs[i] < 0)
+			{
+				continue;
+			}
+			ringbuf_id = g_state.cpu_ringbufs[i];
+		}
 		/* If we want to allocate only buffers for online CPUs and the CPU is online, fill its
 		 * ring buffer array entry, otherwise we can go on with the next online CPU
 		 */
-		if(g_state.allocate_online_only && !is_cpu_online(i))
+		else if(g_state.allocate_online_only && !is_cpu_online(i))
 		{
 			continue;
 		}
@@ -204,8 +373,9 @@ int pman_finalize_ringbuf_array_after_loading()
 			pman_print_error((const char *)error_message);
 			goto clean_percpu_ring_buffers;
 		}
+		g_state.cpu_ringbufs[i] = ringbuf_id;
 
-		if(++reached == g_state.cpus_for_each_buffer)
+		if(!g_state.numa_aware && ++reached == g_state.cpus_for_each_buffer)
 		{
 			/* we need to switch to the next buffer */
 			reached = 0;
@@ -313,8 +483,200 @@ static void ringbuf__consume_first_event(struct ring_buffer *rb, struct ppm_evt_
 	g_state.last_event_size = tmp_cons_increment;
 }
 
+/* Heap merge: the rings with a ready event are kept in a min-heap on the
+ * timestamp of their first event, ties going to the lower ring. The heap is
+ * built from a snapshot of the producer positions, popping an event only
+ * re-reads the ring it came from, and a new snapshot is taken when all the
+ * events of the previous one are consumed.
+ */
+static inline bool ringbuf_heap__entry_lt(const struct ringbuf_heap_entry *a, const struct ringbuf_heap_entry *b)
+{
+	return a->ts < b->ts || (a->ts == b->ts && a->ring < b->ring);
+}
+
+static void ringbuf_heap__sift_down(uint32_t i)
+{
+	struct ringbuf_heap_entry *heap = g_state.heap;
+	uint32_t len = g_state.heap_len;
+	struct ringbuf_heap_entry tmp;
+
+	while(true)
+	{
+		uint32_t min = i;
+		uint32_t l = 2 * i + 1;
+		uint32_t r = l + 1;
+		if(l < len && ringbuf_heap__entry_lt(&heap[l], &heap[min]))
+		{
+			min = l;
+		}
+		if(r < len && ringbuf_heap__entry_lt(&heap[r], &heap[min]))
+		{
+			min = r;
+		}
+		if(min == i)
+		{
+			return;
+		}
+		tmp = heap[i];
+		heap[i] = heap[min];
+		heap[min] = tmp;
+		i = min;
+	}
+}
+
+/* Fill `entry` with the first event of the ring, returns false if there is none
+ * before the producer position read by the last rebuild.
+ */
+static bool ringbuf_heap__peek(struct ring_buffer *rb, int16_t ring, struct ringbuf_heap_entry *entry)
+{
+	struct ppm_evt_hdr *evt = ringbuf__get_first_ring_event(&rb->rings[ring], ring);
+	if(evt == NULL)
+	{
+		return false;
+	}
+
+	entry->ts = evt->ts;
+	entry->evt = evt;
+	entry->size = g_state.last_event_size;
+	entry->ring = ring;
+	return true;
+}
+
+static void ringbuf_heap__rebuild(struct ring_buffer *rb)
+{
+	/* Take a snapshot of all the producer positions, so that the events of
+	 * a ring are not merged with newer events of the other rings.
+	 */
+	for(int16_t ring = 0; ring < rb->ring_cnt; ring++)
+	{
+		g_state.prod_pos[ring] = smp_load_acquire(rb->rings[ring].producer_pos);
+	}
+
+	g_state.heap_len = 0;
+	for(int16_t ring = 0; ring < rb->ring_cnt; ring++)
+	{
+		if(ringbuf_heap__peek(rb, ring, &g_state.heap[g_state.heap_len]))
+		{
+			g_state.heap_len++;
+		}
+	}
+
+	for(uint32_t i = g_state.heap_len / 2; i > 0; i--)
+	{
+		ringbuf_heap__sift_down(i - 1);
+	}
+}
+
+/* Pop the oldest event. Its space is given back to the producer only by
+ * `ringbuf_heap__release_consumed`, so the event stays valid until then.
+ */
+static struct ppm_evt_hdr *ringbuf_heap__pop_event(struct ring_buffer *rb, int16_t *buffer_id)
+{
+	struct ringbuf_heap_entry *top = &g_state.heap[0];
+	struct ppm_evt_hdr *evt = NULL;
+	int16_t ring = 0;
+
+	if(g_state.heap_len == 0)
+	{
+		ringbuf_heap__rebuild(rb);
+		if(g_state.heap_len == 0)
+		{
+			return NULL;
+		}
+	}
+
+	evt = top->evt;
+	ring = top->ring;
+	g_state.cons_pos[ring] += top->size;
+	if(!g_state.ring_consumed[ring])
+	{
+		g_state.ring_consumed[ring] = true;
+		g_state.consumed_rings[g_state.n_consumed_rings++] = ring;
+	}
+
+	if(!ringbuf_heap__peek(rb, ring, top))
+	{
+		*top = g_state.heap[--g_state.heap_len];
+	}
+	ringbuf_heap__sift_down(0);
+
+	*buffer_id = ring;
+	return evt;
+}
+
+static void ringbuf_heap__release_consumed(struct ring_buffer *rb)
+{
+	for(uint32_t i = 0; i < g_state.n_consumed_rings; i++)
+	{
+		int16_t ring = g_state.consumed_rings[i];
+		smp_store_release(rb->rings[ring].consumer_pos, g_state.cons_pos[ring]);
+		g_state.ring_consumed[ring] = false;
+	}
+	g_state.n_consumed_rings = 0;
+}
+
 /* Consume */
+uint32_t pman_consume_events(void **event_ptrs, int16_t *buffer_ids, uint32_t max_events)
+{
+	struct ring_buffer *rb = g_state.rb_manager;
+	uint32_t n = 0;
+
+	if(max_events == 0)
+	{
+		return 0;
+	}
+
+	if(!g_state.heap_merge)
+	{
+		ringbuf__consume_first_event(rb, (struct ppm_evt_hdr **)&event_ptrs[0], &buffer_ids[0]);
+		return event_ptrs[0] != NULL ? 1 : 0;
+	}
+
+	ringbuf_heap__release_consumed(rb);
+	while(n < max_events)
+	{
+		event_ptrs[n] = ringbuf_heap__pop_event(rb, &buffer_ids[n]);
+		if(event_ptrs[n] == NULL)
+		{
+			break;
+		}
+		n++;
+	}
+	return n;
+}
+
 void pman_consume_first_event(void **event_ptr, int16_t *buffer_id)
 {
+	if(g_state.heap_merge)
+	{
+		if(pman_consume_events(event_ptr, buffer_id, 1) == 0)
+		{
+			*event_ptr = NULL;
+			*buffer_id = -1;
+		}
+		return;
+	}
 	ringbuf__consume_first_event(g_state.rb_manager, (struct ppm_evt_hdr **)event_ptr, buffer_id);
 }
+
+/* Wait */
+int pman_wait_for_events(int timeout_ms)
+{
+	struct epoll_event events[1];
+
+	/* We don't care about which ring buffers are ready here,
+	 * `pman_consume_first_event` will scan all of them.
+	 */
+	int res = epoll_wait(ring_buffer__epoll_fd(g_state.rb_manager), events, 1, timeout_ms);
+	if(res < 0)
+	{
+		if(errno == EINTR)
+		{
+			return 0;
+		}
+		int err = errno;
+		pman_print_error("failed to wait for ring buffer notifications");
+		return -err;
+	}
+	return res;
+}
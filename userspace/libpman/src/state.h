@@ -29,7 +29,24 @@ limitations under the License.
 /* Pay attention this need to be bumped every time we add a new bpf program that is directly attached into the kernel */
 #define MODERN_BPF_PROG_ATTACHED_MAX 9
 
+/* Number of periodic samples of the run time of every attached program kept to compute its percentiles */
+#define PROG_BUDGET_SAMPLES 32
+
 struct scap_stats_v2;
+struct ringbuf_heap_entry;
+
+/* Run time of an attached program sampled by `pman_check_prog_budgets` */
+struct prog_budget
+{
+	uint64_t last_run_cnt;			  /* `bpf_prog_info` run_cnt at the last check. */
+	uint64_t last_run_time_ns;		  /* `bpf_prog_info` run_time_ns at the last check. */
+	uint64_t samples[PROG_BUDGET_SAMPLES];	  /* average run time of the program between two checks, a circular buffer. */
+	uint32_t n_samples;			  /* number of valid entries in `samples`. */
+	uint32_t next_sample;			  /* next entry of `samples` to write. */
+	uint64_t n_exceeded;			  /* number of checks in which the program was over budget. */
+	uint32_t sample_every;			  /* sampling applied because of the budget, `0` if none. */
+	bool detached;				  /* true if the program was detached because of the budget. */
+};
 
 struct internal_state
 {
@@ -40,6 +57,10 @@ struct internal_state
 	bool allocate_online_only;	/* If true we allocate ring buffers only for online CPUs */
 	uint32_t n_required_buffers;	/* number of ring buffers we need to allocate */
 	uint16_t cpus_for_each_buffer;	/* Users want a ring buffer every `cpus_for_each_buffer` CPUs */
+	bool numa_aware;		/* If true a ring buffer never spans CPUs of different NUMA nodes and is allocated on their node. */
+	int16_t* cpu_ringbufs;		/* ring buffer of every possible CPU, `-1` if the CPU has none. Computed before loading in NUMA-aware mode, after it otherwise. */
+	int* ringbuf_numa_nodes;	/* NUMA-aware mode: NUMA node of every ring buffer. */
+	int n_numa_nodes;		/* NUMA-aware mode: number of NUMA nodes with at least one ring buffer. */
 	int ringbuf_pos;		/* actual ringbuf we are considering. */
 	unsigned long* cons_pos;	/* every ringbuf has a consumer position. */
 	unsigned long* prod_pos;	/* every ringbuf has a producer position. */
@@ -47,11 +68,23 @@ struct internal_state
 	unsigned long buffer_bytes_dim; /* dimension of a single per-CPU ringbuffer in bytes. */
 	int last_ring_read;		/* Last ring from which we have correctly read an event. Could be `-1` if there were no successful reads. */
 	unsigned long last_event_size;	/* Last event correctly read. Could be `0` if there were no successful reads. */
+	bool heap_merge;		/* If true the first events of the rings are kept in a min-heap ordered by timestamp. */
+	struct ringbuf_heap_entry* heap; /* Heap mode: rings with a ready event, the one with the oldest event on top. */
+	uint32_t heap_len;		/* Heap mode: number of rings in the heap. */
+	int16_t* consumed_rings;	/* Heap mode: rings with consumed events not yet given back to the producer. */
+	uint32_t n_consumed_rings;	/* Heap mode: number of entries in `consumed_rings`. */
+	bool* ring_consumed;		/* Heap mode: true if the ring is in `consumed_rings`. */
 
 	/* Stats v2 utilities */
 	int32_t attached_progs_fds[MODERN_BPF_PROG_ATTACHED_MAX]; /* file descriptors of attached programs, used to collect stats */
 	uint16_t n_attached_progs;				  /* number of attached progs */
 	struct scap_stats_v2* stats;				  /* array of stats collected by libpman */
+	uint32_t n_stats_allocated;				  /* number of entries allocated in `stats` */
+
+	/* Run time budget of the attached programs */
+	uint64_t prog_budget_ns;					  /* budget of the median run time of every attached program, `0` if disabled. */
+	int prog_run_stats_fd;						  /* keeps the run time stats of the kernel enabled while the budget is set, `-1` otherwise. */
+	struct prog_budget prog_budgets[MODERN_BPF_PROG_ATTACHED_MAX]; /* run time samples of every attached program. */
 };
 
 extern struct internal_state g_state;
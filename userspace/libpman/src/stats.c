@@ -16,7 +16,10 @@ limitations under the License.
 */
 
 #include "state.h"
+#include "ringbuffer_definitions.h"
+#include <time.h>
 #include <scap.h>
+#include <libpman.h>
 #include "strlcpy.h"
 
 typedef enum modern_bpf_kernel_counters_stats
@@ -67,12 +70,139 @@ const char *const modern_bpf_kernel_counters_stats_names[] = {
 	[MODERN_BPF_N_DROPS] = "n_drops",
 };
 
+/* NUMA-aware mode: counters collected for each ring buffer. */
+typedef enum modern_bpf_ringbuf_stats
+{
+	RINGBUF_N_EVTS = 0,
+	RINGBUF_N_DROPS_BUFFER,
+	MODERN_BPF_MAX_RINGBUF_STATS,
+} modern_bpf_ringbuf_stats;
+
+const char *const modern_bpf_ringbuf_stats_names[] = {
+	[RINGBUF_N_EVTS] = ".n_evts",
+	[RINGBUF_N_DROPS_BUFFER] = ".n_drops_buffer",
+};
+
+/* Occupancy of every ring buffer, e.g. `ringbuf_3.used_bytes`. */
+typedef enum modern_bpf_ringbuf_usage_stats
+{
+	RINGBUF_USED_BYTES = 0,
+	RINGBUF_SIZE_BYTES,
+	MODERN_BPF_MAX_RINGBUF_USAGE_STATS,
+} modern_bpf_ringbuf_usage_stats;
+
+const char *const modern_bpf_ringbuf_usage_stats_names[] = {
+	[RINGBUF_USED_BYTES] = "used_bytes",
+	[RINGBUF_SIZE_BYTES] = "size_bytes",
+};
+
+/* Counters of every CPU, e.g. `cpu_3.n_drops_buffer`. */
+typedef enum modern_bpf_cpu_stats
+{
+	CPU_N_EVTS = 0,
+	CPU_N_DROPS_BUFFER,
+	CPU_N_DROPS_SCRATCH_MAP,
+	MODERN_BPF_MAX_CPU_STATS,
+} modern_bpf_cpu_stats;
+
+const char *const modern_bpf_cpu_stats_names[] = {
+	[CPU_N_EVTS] = "n_evts",
+	[CPU_N_DROPS_BUFFER] = "n_drops_buffer",
+	[CPU_N_DROPS_SCRATCH_MAP] = "n_drops_scratch_map",
+};
+
+static void set_buffer_stat(struct scap_stats_v2 *stat, const char *prefix, uint32_t index, const char *name, uint64_t value)
+{
+	stat->type = STATS_VALUE_TYPE_U64;
+	stat->flags = PPM_SCAP_STATS_BUFFERS;
+	stat->value.u64 = value;
+	snprintf(stat->name, STATS_NAME_MAX, "%s_%u.%s", prefix, index, name);
+}
+
+/* Prefix of the counters of the events dropped by the per-syscall limits,
+ * e.g. `n_drops_syscall_limit.open`.
+ */
+#define SYSCALL_LIMIT_STATS_PREFIX "n_drops_syscall_limit."
+
 const char *const modern_bpf_libbpf_stats_names[] = {
 	[RUN_CNT] = ".run_cnt",		///< `bpf_prog_info` run_cnt.
 	[RUN_TIME_NS] = ".run_time_ns", ///<`bpf_prog_info` run_time_ns.
 	[AVG_TIME_NS] = ".avg_time_ns", ///< Average time spent in bpg program, calculation: run_time_ns / run_cnt.
 };
 
+/* With a run time budget, every attached program also has these stats. */
+typedef enum modern_bpf_prog_budget_stats
+{
+	P50_TIME_NS = 0,
+	P99_TIME_NS,
+	N_BUDGET_EXCEEDED,
+	BUDGET_SAMPLE_EVERY,
+	BUDGET_DETACHED,
+	MODERN_BPF_MAX_PROG_BUDGET_STATS,
+} modern_bpf_prog_budget_stats;
+
+const char *const modern_bpf_prog_budget_stats_names[] = {
+	[P50_TIME_NS] = ".p50_time_ns",			///< Median of the average run times sampled by `pman_check_prog_budgets`.
+	[P99_TIME_NS] = ".p99_time_ns",			///< 99th percentile of the average run times sampled by `pman_check_prog_budgets`.
+	[N_BUDGET_EXCEEDED] = ".n_budget_exceeded",	///< Number of checks in which the median was over budget.
+	[BUDGET_SAMPLE_EVERY] = ".budget_sample_every", ///< Sampling applied to the program because of the budget, `0` if none.
+	[BUDGET_DETACHED] = ".budget_detached",		///< `1` if the program was detached because of the budget.
+};
+
+/* Checks needed before acting on a program, so that a single slow period doesn't trigger anything */
+#define PROG_BUDGET_MIN_SAMPLES 3
+
+/* The sampling applied to an over budget program doubles at every check up to this value */
+#define PROG_BUDGET_MAX_SAMPLE_EVERY 1024
+
+/* What is done when an attached program is over budget. The syscall
+ * dispatchers and the process lifecycle programs are needed to keep the
+ * state of the processes right, so they are only reported.
+ */
+typedef enum prog_budget_action
+{
+	PROG_BUDGET_REPORT = 0,
+	PROG_BUDGET_SAMPLE,
+	PROG_BUDGET_DETACH,
+} prog_budget_action;
+
+/* Indexed like `g_state.attached_progs_fds`, see `pman_save_attached_progs` */
+static const struct
+{
+	prog_budget_action action;
+	int limited_tp; /* the tracepoint limit to use with `PROG_BUDGET_SAMPLE` */
+} prog_budget_actions[MODERN_BPF_PROG_ATTACHED_MAX] = {
+	[3] = {PROG_BUDGET_SAMPLE, LIMITED_TP_SCHED_SWITCH},
+	[6] = {PROG_BUDGET_SAMPLE, LIMITED_TP_PAGE_FAULT_USER},
+	[7] = {PROG_BUDGET_SAMPLE, LIMITED_TP_PAGE_FAULT_KERNEL},
+	[8] = {PROG_BUDGET_DETACH, 0},
+};
+
+/* Returns the `percentile` of the samples of a program, `0` without samples. */
+static uint64_t prog_budget_percentile(const struct prog_budget *budget, uint32_t percentile)
+{
+	uint64_t sorted[PROG_BUDGET_SAMPLES];
+	uint32_t n = budget->n_samples;
+	if(n == 0)
+	{
+		return 0;
+	}
+
+	/* A handful of samples, an insertion sort is enough */
+	for(uint32_t i = 0; i < n; i++)
+	{
+		uint64_t sample = budget->samples[i];
+		uint32_t j = i;
+		while(j > 0 && sorted[j - 1] > sample)
+		{
+			sorted[j] = sorted[j - 1];
+			j--;
+		}
+		sorted[j] = sample;
+	}
+	return sorted[(n - 1) * percentile / 100];
+}
+
 int pman_get_scap_stats(struct scap_stats *stats)
 {
 	char error_message[MAX_ERROR_MESSAGE_LEN];
@@ -132,23 +262,104 @@ clean_print_stats:
 	return errno;
 }
 
+/* Fills `stats` with the drops of every limited syscall, summing the enter
+ * and exit events of all the CPUs.
+ */
+static int get_syscall_limit_stats(scap_stats_v2 *stats, uint32_t n_limit_stats)
+{
+	char error_message[MAX_ERROR_MESSAGE_LEN];
+	int limit_maps_fd = bpf_map__fd(g_state.skel->maps.limit_maps);
+	if(limit_maps_fd <= 0)
+	{
+		pman_print_error("unable to get 'limit_maps' fd during kernel stats processing");
+		return errno;
+	}
+
+	struct limit_map *limit_map = (struct limit_map *)malloc(sizeof(struct limit_map));
+	if(limit_map == NULL)
+	{
+		pman_print_error("unable to allocate memory for the limit map");
+		return ENOMEM;
+	}
+
+	uint32_t stat = 0;
+	for(int syscall_id = 0; syscall_id < SYSCALL_TABLE_SIZE && stat < n_limit_stats; syscall_id++)
+	{
+		if(!pman_is_syscall_limited(syscall_id))
+		{
+			continue;
+		}
+		stats[stat].type = STATS_VALUE_TYPE_U64;
+		stats[stat].flags = PPM_SCAP_STATS_KERNEL_COUNTERS;
+		stats[stat].value.u64 = 0;
+		snprintf(stats[stat].name, STATS_NAME_MAX, SYSCALL_LIMIT_STATS_PREFIX "%s",
+			 scap_get_ppm_sc_name((ppm_sc_code)g_state.skel->rodata->g_ppm_sc_table[syscall_id]));
+		stat++;
+	}
+
+	for(uint32_t index = 0; index < g_state.n_possible_cpus; index++)
+	{
+		if(bpf_map_lookup_elem(limit_maps_fd, &index, limit_map) < 0)
+		{
+			snprintf(error_message, MAX_ERROR_MESSAGE_LEN, "unable to get the limit map for CPU %d", index);
+			pman_print_error((const char *)error_message);
+			free(limit_map);
+			return errno;
+		}
+
+		stat = 0;
+		for(int syscall_id = 0; syscall_id < SYSCALL_TABLE_SIZE && stat < n_limit_stats; syscall_id++)
+		{
+			if(!pman_is_syscall_limited(syscall_id))
+			{
+				continue;
+			}
+			stats[stat].value.u64 += limit_map->enter[syscall_id].n_drops + limit_map->exit[syscall_id].n_drops;
+			stat++;
+		}
+	}
+	free(limit_map);
+	return 0;
+}
+
 struct scap_stats_v2 *pman_get_scap_stats_v2(uint32_t flags, uint32_t *nstats, int32_t *rc)
 {
 	*rc = SCAP_FAILURE;
+	/* In NUMA-aware mode we also have the counters of every ring buffer */
+	uint32_t n_ringbuf_stats = g_state.numa_aware ? (g_state.n_required_buffers * MODERN_BPF_MAX_RINGBUF_STATS) : 0;
+	/* Every sampled or rate limited syscall has the counter of its dropped events */
+	uint32_t n_limit_stats = 0;
+	for(int syscall_id = 0; syscall_id < SYSCALL_TABLE_SIZE; syscall_id++)
+	{
+		if(pman_is_syscall_limited(syscall_id))
+		{
+			n_limit_stats++;
+		}
+	}
+	/* The sampling time, the occupancy of every ring buffer and the counters of every CPU */
+	uint32_t n_rings = g_state.rb_manager != NULL ? g_state.rb_manager->ring_cnt : 0;
+	uint32_t n_buffer_stats = 1 + n_rings * MODERN_BPF_MAX_RINGBUF_USAGE_STATS + g_state.n_possible_cpus * MODERN_BPF_MAX_CPU_STATS;
+	/* With a run time budget every attached program has its percentiles and the actions taken */
+	uint32_t n_libbpf_stats = MODERN_BPF_MAX_LIBBPF_STATS + (g_state.prog_budget_ns != 0 ? MODERN_BPF_MAX_PROG_BUDGET_STATS : 0);
 	/* This is the expected number of stats */
-	*nstats = (MODERN_BPF_MAX_KERNEL_COUNTERS_STATS + (g_state.n_attached_progs * MODERN_BPF_MAX_LIBBPF_STATS));
+	*nstats = (MODERN_BPF_MAX_KERNEL_COUNTERS_STATS + n_ringbuf_stats + n_limit_stats + n_buffer_stats + (g_state.n_attached_progs * n_libbpf_stats));
 	/* offset in stats buffer */
 	int offset = 0;
 
-	/* If it is the first time we call this function we populate the stats */
-	if(g_state.stats == NULL)
+	/* If it is the first time we call this function we populate the stats,
+	 * the limits can change so we grow the buffer when they need more room.
+	 */
+	if(g_state.stats == NULL || *nstats > g_state.n_stats_allocated)
 	{
-		g_state.stats = (scap_stats_v2 *)calloc(*nstats, sizeof(scap_stats_v2));
-		if(g_state.stats == NULL)
+		scap_stats_v2 *stats = (scap_stats_v2 *)realloc(g_state.stats, *nstats * sizeof(scap_stats_v2));
+		if(stats == NULL)
 		{
 			pman_print_error("unable to allocate memory for 'scap_stats_v2' array");
 			return NULL;
 		}
+		memset(stats, 0, *nstats * sizeof(scap_stats_v2));
+		g_state.stats = stats;
+		g_state.n_stats_allocated = *nstats;
 	}
 
 	/* KERNEL COUNTER STATS */
@@ -171,6 +382,22 @@ struct scap_stats_v2 *pman_get_scap_stats_v2(uint32_t flags, uint32_t *nstats, i
 			strlcpy(g_state.stats[stat].name, modern_bpf_kernel_counters_stats_names[stat], STATS_NAME_MAX);
 		}
 
+		/* Ring buffer stats follow the global ones, their names carry the buffer and its node,
+		 * e.g. `ringbuf_3.node_1.n_evts`.
+		 */
+		scap_stats_v2 *ringbuf_stats = &g_state.stats[MODERN_BPF_MAX_KERNEL_COUNTERS_STATS];
+		for(uint32_t ring = 0; ring < n_ringbuf_stats / MODERN_BPF_MAX_RINGBUF_STATS; ring++)
+		{
+			for(uint32_t stat = 0; stat < MODERN_BPF_MAX_RINGBUF_STATS; stat++)
+			{
+				scap_stats_v2 *s = &ringbuf_stats[ring * MODERN_BPF_MAX_RINGBUF_STATS + stat];
+				s->type = STATS_VALUE_TYPE_U64;
+				s->flags = PPM_SCAP_STATS_KERNEL_COUNTERS;
+				s->value.u64 = 0;
+				snprintf(s->name, STATS_NAME_MAX, "ringbuf_%u.node_%d%s", ring, g_state.ringbuf_numa_nodes[ring], modern_bpf_ringbuf_stats_names[stat]);
+			}
+		}
+
 		/* We always take statistics from all the CPUs, even if some of them are not online.
 		 * If the CPU is not online the counter map will be empty.
 		 */
@@ -181,7 +408,6 @@ struct scap_stats_v2 *pman_get_scap_stats_v2(uint32_t flags, uint32_t *nstats, i
 			{
 				snprintf(error_message, MAX_ERROR_MESSAGE_LEN, "unable to get the counter map for CPU %d", index);
 				pman_print_error((const char *)error_message);
-				close(counter_maps_fd);
 				return NULL;
 			}
 			g_state.stats[MODERN_BPF_N_EVTS].value.u64 += cnt_map.n_evts;
@@ -200,9 +426,70 @@ struct scap_stats_v2 *pman_get_scap_stats_v2(uint32_t flags, uint32_t *nstats, i
 			g_state.stats[MODERN_BPF_N_DROPS_BUFFER_OTHER_INTEREST_EXIT].value.u64 += cnt_map.n_drops_buffer_other_interest_exit;
 			g_state.stats[MODERN_BPF_N_DROPS_SCRATCH_MAP].value.u64 += cnt_map.n_drops_max_event_size;
 			g_state.stats[MODERN_BPF_N_DROPS].value.u64 += (cnt_map.n_drops_buffer + cnt_map.n_drops_max_event_size);
+
+			if(n_ringbuf_stats > 0 && g_state.cpu_ringbufs[index] >= 0)
+			{
+				int ring = g_state.cpu_ringbufs[index];
+				ringbuf_stats[ring * MODERN_BPF_MAX_RINGBUF_STATS + RINGBUF_N_EVTS].value.u64 += cnt_map.n_evts;
+				ringbuf_stats[ring * MODERN_BPF_MAX_RINGBUF_STATS + RINGBUF_N_DROPS_BUFFER].value.u64 += cnt_map.n_drops_buffer;
+			}
+		}
+		offset = MODERN_BPF_MAX_KERNEL_COUNTERS_STATS + n_ringbuf_stats;
+
+		if(n_limit_stats > 0 && get_syscall_limit_stats(&g_state.stats[offset], n_limit_stats) != 0)
+		{
+			return NULL;
+		}
+		offset += n_limit_stats;
+	}
+
+	/* BUFFER STATS */
+
+	if(flags & PPM_SCAP_STATS_BUFFERS)
+	{
+		char error_message[MAX_ERROR_MESSAGE_LEN];
+		int counter_maps_fd = bpf_map__fd(g_state.skel->maps.counter_maps);
+		if(counter_maps_fd <= 0)
+		{
+			pman_print_error("unable to get 'counter_maps' fd during buffer stats processing");
+			return NULL;
+		}
+
+		struct timespec ts = {0};
+		clock_gettime(CLOCK_REALTIME, &ts);
+		g_state.stats[offset].type = STATS_VALUE_TYPE_U64;
+		g_state.stats[offset].flags = PPM_SCAP_STATS_BUFFERS;
+		g_state.stats[offset].value.u64 = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+		strlcpy(g_state.stats[offset].name, "buffers.sample_ts_ns", STATS_NAME_MAX);
+		offset++;
+
+		/* The consumer position seen by the kernel, the events read but not yet
+		 * given back still take room in the buffer.
+		 */
+		for(uint32_t ring = 0; ring < n_rings; ring++)
+		{
+			struct ring *r = &g_state.rb_manager->rings[ring];
+			unsigned long prod_pos = smp_load_acquire(r->producer_pos);
+			unsigned long cons_pos = smp_load_acquire(r->consumer_pos);
+			set_buffer_stat(&g_state.stats[offset + RINGBUF_USED_BYTES], "ringbuf", ring, modern_bpf_ringbuf_usage_stats_names[RINGBUF_USED_BYTES], prod_pos - cons_pos);
+			set_buffer_stat(&g_state.stats[offset + RINGBUF_SIZE_BYTES], "ringbuf", ring, modern_bpf_ringbuf_usage_stats_names[RINGBUF_SIZE_BYTES], g_state.buffer_bytes_dim);
+			offset += MODERN_BPF_MAX_RINGBUF_USAGE_STATS;
+		}
+
+		struct counter_map cnt_map;
+		for(uint32_t index = 0; index < g_state.n_possible_cpus; index++)
+		{
+			if(bpf_map_lookup_elem(counter_maps_fd, &index, &cnt_map) < 0)
+			{
+				snprintf(error_message, MAX_ERROR_MESSAGE_LEN, "unable to get the counter map for CPU %d", index);
+				pman_print_error((const char *)error_message);
+				return NULL;
+			}
+			set_buffer_stat(&g_state.stats[offset + CPU_N_EVTS], "cpu", index, modern_bpf_cpu_stats_names[CPU_N_EVTS], cnt_map.n_evts);
+			set_buffer_stat(&g_state.stats[offset + CPU_N_DROPS_BUFFER], "cpu", index, modern_bpf_cpu_stats_names[CPU_N_DROPS_BUFFER], cnt_map.n_drops_buffer);
+			set_buffer_stat(&g_state.stats[offset + CPU_N_DROPS_SCRATCH_MAP], "cpu", index, modern_bpf_cpu_stats_names[CPU_N_DROPS_SCRATCH_MAP], cnt_map.n_drops_max_event_size);
+			offset += MODERN_BPF_MAX_CPU_STATS;
 		}
-		close(counter_maps_fd);
-		offset = MODERN_BPF_MAX_KERNEL_COUNTERS_STATS;
 	}
 
 	/* LIBBPF STATS */
@@ -266,6 +553,45 @@ struct scap_stats_v2 *pman_get_scap_stats_v2(uint32_t flags, uint32_t *nstats, i
 				}
 				offset++;
 			}
+
+			if(g_state.prog_budget_ns == 0)
+			{
+				continue;
+			}
+
+			const struct prog_budget *budget = &g_state.prog_budgets[bpf_prog];
+			for(int stat = 0; stat < MODERN_BPF_MAX_PROG_BUDGET_STATS; stat++)
+			{
+				if(offset >= *nstats)
+				{
+					pman_print_error("no enough space for all the stats");
+					return NULL;
+				}
+				g_state.stats[offset].type = STATS_VALUE_TYPE_U64;
+				g_state.stats[offset].flags = PPM_SCAP_STATS_LIBBPF_STATS;
+				snprintf(g_state.stats[offset].name, STATS_NAME_MAX, "%s%s", info.name, modern_bpf_prog_budget_stats_names[stat]);
+				switch(stat)
+				{
+				case P50_TIME_NS:
+					g_state.stats[offset].value.u64 = prog_budget_percentile(budget, 50);
+					break;
+				case P99_TIME_NS:
+					g_state.stats[offset].value.u64 = prog_budget_percentile(budget, 99);
+					break;
+				case N_BUDGET_EXCEEDED:
+					g_state.stats[offset].value.u64 = budget->n_exceeded;
+					break;
+				case BUDGET_SAMPLE_EVERY:
+					g_state.stats[offset].value.u64 = budget->sample_every;
+					break;
+				case BUDGET_DETACHED:
+					g_state.stats[offset].value.u64 = budget->detached ? 1 : 0;
+					break;
+				default:
+					break;
+				}
+				offset++;
+			}
 		}
 	}
 
@@ -275,6 +601,121 @@ struct scap_stats_v2 *pman_get_scap_stats_v2(uint32_t flags, uint32_t *nstats, i
 	return g_state.stats;
 }
 
+int pman_set_prog_budget(uint64_t budget_ns)
+{
+	if(budget_ns != 0 && g_state.prog_run_stats_fd < 0)
+	{
+		/* `run_time_ns` is only counted while the stats are enabled, either
+		 * by us or through the `kernel.bpf_stats_enabled` sysctl.
+		 */
+		int fd = bpf_enable_stats(BPF_STATS_RUN_TIME);
+		if(fd < 0)
+		{
+			pman_print_error("unable to enable the run time stats of the bpf programs");
+			return errno;
+		}
+		g_state.prog_run_stats_fd = fd;
+	}
+	else if(budget_ns == 0 && g_state.prog_run_stats_fd >= 0)
+	{
+		close(g_state.prog_run_stats_fd);
+		g_state.prog_run_stats_fd = -1;
+	}
+
+	g_state.prog_budget_ns = budget_ns;
+	memset(g_state.prog_budgets, 0, sizeof(g_state.prog_budgets));
+	return 0;
+}
+
+static int prog_budget_act(int bpf_prog, struct prog_budget *budget)
+{
+	switch(prog_budget_actions[bpf_prog].action)
+	{
+	case PROG_BUDGET_SAMPLE:
+	{
+		/* Starts from the sampling asked by the user, if any, and keeps its rate limit */
+		struct syscall_limit *limit = &g_state.skel->bss->g_tracepoint_limits[prog_budget_actions[bpf_prog].limited_tp];
+		uint32_t sample_every = limit->sample_every > 1 ? limit->sample_every : 1;
+		if(sample_every >= PROG_BUDGET_MAX_SAMPLE_EVERY)
+		{
+			return 0;
+		}
+		limit->sample_every = sample_every * 2;
+		budget->sample_every = limit->sample_every;
+		break;
+	}
+
+	case PROG_BUDGET_DETACH:
+		/* Only `signal_deliver` for now */
+		if(budget->detached || pman_detach_signal_deliver() != 0)
+		{
+			return 0;
+		}
+		budget->detached = true;
+		break;
+
+	default:
+		return 0;
+	}
+
+	/* The samples taken before the action don't tell anything anymore */
+	budget->n_samples = 0;
+	budget->next_sample = 0;
+	return 1;
+}
+
+uint32_t pman_check_prog_budgets(void)
+{
+	uint32_t n_actions = 0;
+	if(g_state.prog_budget_ns == 0)
+	{
+		return 0;
+	}
+
+	for(int bpf_prog = 0; bpf_prog < MODERN_BPF_PROG_ATTACHED_MAX; bpf_prog++)
+	{
+		int fd = g_state.attached_progs_fds[bpf_prog];
+		if(fd < 0)
+		{
+			continue;
+		}
+		struct bpf_prog_info info = {};
+		__u32 len = sizeof(info);
+		if(bpf_obj_get_info_by_fd(fd, &info, &len))
+		{
+			continue;
+		}
+
+		struct prog_budget *budget = &g_state.prog_budgets[bpf_prog];
+		uint64_t delta_cnt = info.run_cnt - budget->last_run_cnt;
+		uint64_t delta_time_ns = info.run_time_ns - budget->last_run_time_ns;
+		bool first_check = budget->last_run_cnt == 0 && budget->last_run_time_ns == 0;
+		budget->last_run_cnt = info.run_cnt;
+		budget->last_run_time_ns = info.run_time_ns;
+		/* Nothing ran, or the counters were read for the first time */
+		if(first_check || delta_cnt == 0)
+		{
+			continue;
+		}
+
+		budget->samples[budget->next_sample] = delta_time_ns / delta_cnt;
+		budget->next_sample = (budget->next_sample + 1) % PROG_BUDGET_SAMPLES;
+		if(budget->n_samples < PROG_BUDGET_SAMPLES)
+		{
+			budget->n_samples++;
+		}
+
+		if(budget->n_samples < PROG_BUDGET_MIN_SAMPLES ||
+		   prog_budget_percentile(budget, 50) <= g_state.prog_budget_ns)
+		{
+			continue;
+		}
+		budget->n_exceeded++;
+		n_actions += prog_budget_act(bpf_prog, budget);
+	}
+	return n_actions;
+}
+
 int pman_get_n_tracepoint_hit(long *n_events_per_cpu)
 {
 	char error_message[MAX_ERROR_MESSAGE_LEN];
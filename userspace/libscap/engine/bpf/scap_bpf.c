@@ -27,6 +27,7 @@ limitations under the License.
 #include <gelf.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <ctype.h>
 #include <time.h>
 #include <dirent.h>
@@ -70,6 +71,14 @@ static const char * const bpf_kernel_counters_stats_names[] = {
 	[BPF_N_DROPS] = "n_drops",
 };
 
+static const char * const bpf_cpu_stats_names[] = {
+	[BPF_CPU_N_EVTS] = "n_evts",
+	[BPF_CPU_N_DROPS_BUFFER] = "n_drops_buffer",
+	[BPF_CPU_N_DROPS_SCRATCH_MAP] = "n_drops_scratch_map",
+	[BPF_CPU_N_DROPS_PAGE_FAULTS] = "n_drops_page_faults",
+	[BPF_CPU_N_DROPS_BUG] = "n_drops_bug",
+};
+
 static const char * const bpf_libbpf_stats_names[] = {
 	[RUN_CNT] = ".run_cnt", ///< `bpf_prog_info` run_cnt.
 	[RUN_TIME_NS] = ".run_time_ns", ///<`bpf_prog_info` run_time_ns.
@@ -89,11 +98,24 @@ static inline void scap_bpf_advance_to_next_evt(scap_device* dev, scap_evt *even
 				&dev->m_sn_len);
 }
 
+static inline scap_evt* scap_bpf_peek_event(char* pos)
+{
+	return scap_bpf_evt_from_perf_sample(pos);
+}
+
+static inline void scap_bpf_peek_advance(scap_device* dev, char** pos, uint32_t* len)
+{
+	scap_bpf_advance_to_evt(dev, true, *pos, pos, len);
+}
+
 #define GET_BUF_POINTERS scap_bpf_get_buf_pointers
 #define ADVANCE_TAIL scap_bpf_advance_tail
+#define ADVANCE_TAIL_BY scap_bpf_advance_tail_by
 #define ADVANCE_TO_EVT scap_bpf_advance_to_next_evt
 #define READBUF scap_bpf_readbuf
 #define NEXT_EVENT scap_bpf_next_event
+#define PEEK_EVENT scap_bpf_peek_event
+#define PEEK_ADVANCE scap_bpf_peek_advance
 
 #include "ringbuffer/ringbuffer.h"
 
@@ -217,6 +239,18 @@ static int bpf_map_lookup_elem(int fd, const void *key, void *value)
 	return sys_bpf(BPF_MAP_LOOKUP_ELEM, &attr, sizeof(attr));
 }
 
+static int bpf_map_delete_elem(int fd, const void *key)
+{
+	union bpf_attr attr;
+
+	bzero(&attr, sizeof(attr));
+
+	attr.map_fd = fd;
+	attr.key = (unsigned long) key;
+
+	return sys_bpf(BPF_MAP_DELETE_ELEM, &attr, sizeof(attr));
+}
+
 static int bpf_map_create(enum bpf_map_type map_type,
 			  int key_size, int value_size, int max_entries,
 			  uint32_t map_flags)
@@ -857,6 +891,8 @@ static int allocate_scap_stats_v2(struct bpf_engine *handle)
 		}
 	}
 	handle->m_nstats = (BPF_MAX_KERNEL_COUNTERS_STATS + (nprogs_attached * BPF_MAX_LIBBPF_STATS));
+	/* The sampling time, the occupancy of every buffer and the counters of every CPU */
+	handle->m_nstats += 1 + handle->m_dev_set.m_ndevs * RINGBUFFER_MAX_BUFFER_STATS + handle->m_ncpus * BPF_MAX_CPU_STATS;
 	handle->m_stats = (scap_stats_v2 *)malloc(handle->m_nstats * sizeof(scap_stats_v2));
 
 	if(!handle->m_stats)
@@ -1163,6 +1199,37 @@ int32_t scap_bpf_set_snaplen(struct scap_engine_handle engine, uint32_t snaplen)
 	return SCAP_SUCCESS;
 }
 
+int32_t scap_bpf_set_fd_type_snaplen(struct scap_engine_handle engine, uint32_t fd_type, uint32_t snaplen)
+{
+	struct scap_bpf_settings settings;
+	struct bpf_engine *handle = engine.m_handle;
+	int k = 0;
+	int ret;
+
+	if(fd_type >= PPM_SNAPLEN_FD_MAX)
+	{
+		return scap_errprintf(handle->m_lasterr, 0, "invalid fd type %u\n", fd_type);
+	}
+
+	if(snaplen > SNAPLEN_MAX && snaplen != PPM_SNAPLEN_FD_TYPE_DEFAULT)
+	{
+		return scap_errprintf(handle->m_lasterr, 0, "snaplen can't exceed %d\n", SNAPLEN_MAX);
+	}
+
+	if((ret = bpf_map_lookup_elem(handle->m_bpf_map_fds[SCAP_SETTINGS_MAP], &k, &settings)) != 0)
+	{
+		return scap_errprintf(handle->m_lasterr, -ret, "SCAP_SETTINGS_MAP bpf_map_lookup_elem");
+	}
+
+	settings.fd_type_snaplen[fd_type] = snaplen;
+	if((ret = bpf_map_update_elem(handle->m_bpf_map_fds[SCAP_SETTINGS_MAP], &k, &settings, BPF_ANY)) != 0)
+	{
+		return scap_errprintf(handle->m_lasterr, -ret, "SCAP_SETTINGS_MAP bpf_map_update_elem");
+	}
+
+	return SCAP_SUCCESS;
+}
+
 int32_t scap_bpf_set_fullcapture_port_range(struct scap_engine_handle engine, uint16_t range_start, uint16_t range_end)
 {
 	struct scap_bpf_settings settings;
@@ -1444,6 +1511,12 @@ static int32_t set_default_settings(struct bpf_engine *handle)
 	settings.fullcapture_port_range_start = 0;
 	settings.fullcapture_port_range_end = 0;
 	settings.statsd_port = PPM_PORT_STATSD;
+	memset(&settings.suppressed_comms, 0, sizeof(settings.suppressed_comms));
+	for(int j = 0; j < PPM_SNAPLEN_FD_MAX; j++)
+	{
+		settings.fd_type_snaplen[j] = PPM_SNAPLEN_FD_TYPE_DEFAULT;
+	}
+	settings.cgroup_filter_mode = PPM_CGROUP_FILTER_NONE;
 
 	int k = 0;
 	int ret;
@@ -1529,6 +1602,15 @@ int32_t scap_bpf_load(
 		int ret;
 		struct scap_device *dev;
 
+		/* In wakeup mode the perf buffer wakes up its pollers every time
+		 * `m_wakeup_watermark_b` new bytes are written.
+		 */
+		if(handle->m_dev_set.m_wakeup)
+		{
+			attr.watermark = 1;
+			attr.wakeup_watermark = handle->m_dev_set.m_wakeup_watermark_b;
+		}
+
 		if(j > 0)
 		{
 			char filename[SCAP_MAX_PATH_SIZE];
@@ -1615,6 +1697,11 @@ int32_t scap_bpf_load(
 		return scap_errprintf(handle->m_lasterr, 0, "processors online: %d, expected: %d", online_cpu, handle->m_dev_set.m_ndevs);
 	}
 
+	if(devset_watch_devices(&handle->m_dev_set) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
 	if(set_default_settings(handle) != SCAP_SUCCESS)
 	{
 		return SCAP_FAILURE;
@@ -1722,6 +1809,32 @@ const struct scap_stats_v2* scap_bpf_get_stats_v2(struct scap_engine_handle engi
 		offset = BPF_MAX_KERNEL_COUNTERS_STATS;
 	}
 
+	/* BUFFER STATS */
+
+	if((flags & PPM_SCAP_STATS_BUFFERS) &&
+	   (offset + 1 + handle->m_dev_set.m_ndevs * RINGBUFFER_MAX_BUFFER_STATS + handle->m_ncpus * BPF_MAX_CPU_STATS <= nstats_allocated))
+	{
+		/* Occupancy of the buffers of the online CPUs, then the counters of all the CPUs */
+		offset += ringbuffer_get_buffer_stats(&handle->m_dev_set, &stats[offset]);
+		for(int cpu = 0; cpu < handle->m_ncpus; cpu++)
+		{
+			struct scap_bpf_per_cpu_state v;
+			if((ret = bpf_map_lookup_elem(handle->m_bpf_map_fds[SCAP_LOCAL_STATE_MAP], &cpu, &v)))
+			{
+				*nstats = offset;
+				*rc = scap_errprintf(handle->m_lasterr, -ret, "Error looking up local state %d", cpu);
+				return stats;
+			}
+			scap_stats_v2 *cpu_stats = &stats[offset];
+			ringbuffer_set_buffer_stat(&cpu_stats[BPF_CPU_N_EVTS], "cpu", cpu, bpf_cpu_stats_names[BPF_CPU_N_EVTS], v.n_evts);
+			ringbuffer_set_buffer_stat(&cpu_stats[BPF_CPU_N_DROPS_BUFFER], "cpu", cpu, bpf_cpu_stats_names[BPF_CPU_N_DROPS_BUFFER], v.n_drops_buffer);
+			ringbuffer_set_buffer_stat(&cpu_stats[BPF_CPU_N_DROPS_SCRATCH_MAP], "cpu", cpu, bpf_cpu_stats_names[BPF_CPU_N_DROPS_SCRATCH_MAP], v.n_drops_scratch_map);
+			ringbuffer_set_buffer_stat(&cpu_stats[BPF_CPU_N_DROPS_PAGE_FAULTS], "cpu", cpu, bpf_cpu_stats_names[BPF_CPU_N_DROPS_PAGE_FAULTS], v.n_drops_pf);
+			ringbuffer_set_buffer_stat(&cpu_stats[BPF_CPU_N_DROPS_BUG], "cpu", cpu, bpf_cpu_stats_names[BPF_CPU_N_DROPS_BUG], v.n_drops_bug);
+			offset += BPF_MAX_CPU_STATS;
+		}
+	}
+
 	/* LIBBPF STATS */
 
 	/* At the time of writing (Apr 2, 2023) libbpf stats are only available on a per program granularity.
@@ -1828,6 +1941,11 @@ static int32_t next(struct scap_engine_handle engine, OUT scap_evt** pevent, OUT
 	return ringbuffer_next(&engine.m_handle->m_dev_set, pevent, pcpuid);
 }
 
+static scap_evt* peek(struct scap_engine_handle engine, uint16_t cpuid, uint32_t distance)
+{
+	return ringbuffer_peek(&engine.m_handle->m_dev_set, cpuid, distance);
+}
+
 static int32_t unsupported_config(struct scap_engine_handle engine, const char* msg)
 {
 	struct bpf_engine* handle = engine.m_handle;
@@ -1857,6 +1975,68 @@ static int32_t scap_bpf_handle_dropfailed(struct scap_engine_handle engine, bool
 	return SCAP_SUCCESS;
 }
 
+static int32_t scap_bpf_set_suppressed_comms(struct scap_engine_handle engine, const struct ppm_suppressed_comms* comms)
+{
+	struct bpf_engine *handle = engine.m_handle;
+	struct scap_bpf_settings settings;
+	int k = 0;
+	int ret;
+
+	if((ret = bpf_map_lookup_elem(handle->m_bpf_map_fds[SCAP_SETTINGS_MAP], &k, &settings)) != 0)
+	{
+		return scap_errprintf(handle->m_lasterr, -ret, "SCAP_SETTINGS_MAP bpf_map_lookup_elem");
+	}
+
+	settings.suppressed_comms = *comms;
+	if((ret = bpf_map_update_elem(handle->m_bpf_map_fds[SCAP_SETTINGS_MAP], &k, &settings, BPF_ANY)) != 0)
+	{
+		return scap_errprintf(handle->m_lasterr, -ret, "SCAP_SETTINGS_MAP bpf_map_update_elem");
+	}
+
+	return SCAP_SUCCESS;
+}
+
+static int32_t scap_bpf_set_cgroup_filter_mode(struct scap_engine_handle engine, uint32_t mode)
+{
+	struct bpf_engine *handle = engine.m_handle;
+	struct scap_bpf_settings settings;
+	int k = 0;
+	int ret;
+
+	if((ret = bpf_map_lookup_elem(handle->m_bpf_map_fds[SCAP_SETTINGS_MAP], &k, &settings)) != 0)
+	{
+		return scap_errprintf(handle->m_lasterr, -ret, "SCAP_SETTINGS_MAP bpf_map_lookup_elem");
+	}
+
+	settings.cgroup_filter_mode = mode;
+	if((ret = bpf_map_update_elem(handle->m_bpf_map_fds[SCAP_SETTINGS_MAP], &k, &settings, BPF_ANY)) != 0)
+	{
+		return scap_errprintf(handle->m_lasterr, -ret, "SCAP_SETTINGS_MAP bpf_map_update_elem");
+	}
+
+	return SCAP_SUCCESS;
+}
+
+static int32_t scap_bpf_set_cgroup_filter(struct scap_engine_handle engine, uint64_t cgroup_id, bool listed)
+{
+	struct bpf_engine *handle = engine.m_handle;
+	uint8_t value = 1;
+
+	if(listed)
+	{
+		if(bpf_map_update_elem(handle->m_bpf_map_fds[SCAP_CGROUP_FILTER_MAP], &cgroup_id, &value, BPF_ANY) != 0)
+		{
+			return scap_errprintf(handle->m_lasterr, errno, "unable to add cgroup %" PRIu64 " to the cgroup filter", cgroup_id);
+		}
+	}
+	else if(bpf_map_delete_elem(handle->m_bpf_map_fds[SCAP_CGROUP_FILTER_MAP], &cgroup_id) != 0 && errno != ENOENT)
+	{
+		return scap_errprintf(handle->m_lasterr, errno, "unable to remove cgroup %" PRIu64 " from the cgroup filter", cgroup_id);
+	}
+
+	return SCAP_SUCCESS;
+}
+
 static int32_t scap_bpf_handle_sc(struct scap_engine_handle engine, uint32_t op, uint32_t sc)
 {
 	struct bpf_engine* handle = engine.m_handle;
@@ -1909,6 +2089,23 @@ static int32_t configure(struct scap_engine_handle engine, enum scap_setting set
 		return scap_bpf_set_fullcapture_port_range(engine, arg1, arg2);
 	case SCAP_STATSD_PORT:
 		return scap_bpf_set_statsd_port(engine, arg1);
+	case SCAP_SUPPRESSED_COMMS:
+		return scap_bpf_set_suppressed_comms(engine, (const struct ppm_suppressed_comms*)arg1);
+	case SCAP_SUPPRESSED_TID:
+		// the comms are checked in the probe, the threads only in userspace
+		return SCAP_NOT_SUPPORTED;
+	case SCAP_FD_TYPE_SNAPLEN:
+		return scap_bpf_set_fd_type_snaplen(engine, arg1, arg2);
+	case SCAP_SYSCALL_LIMIT:
+		// only the modern probe samples and rate limits single syscalls
+		return SCAP_NOT_SUPPORTED;
+	case SCAP_BUFFER_SNAPLEN:
+		// the snaplen is global to the probe, there is no per-buffer limit
+		return SCAP_NOT_SUPPORTED;
+	case SCAP_CGROUP_FILTER_MODE:
+		return scap_bpf_set_cgroup_filter_mode(engine, arg1);
+	case SCAP_CGROUP_FILTER:
+		return scap_bpf_set_cgroup_filter(engine, arg1, arg2);
 	default:
 	{
 		char msg[SCAP_LASTERR_SIZE];
@@ -1948,7 +2145,7 @@ static int32_t init(scap_t* handle, scap_open_args *oargs)
 		return scap_errprintf(engine.m_handle->m_lasterr, errno, "_SC_NPROCESSORS_ONLN");
 	}
 
-	rc = devset_init(&engine.m_handle->m_dev_set, num_devs, engine.m_handle->m_lasterr);
+	rc = devset_init(&engine.m_handle->m_dev_set, num_devs, oargs, engine.m_handle->m_lasterr);
 	if(rc != SCAP_SUCCESS)
 	{
 		return rc;
@@ -2027,6 +2224,7 @@ const struct scap_vtable scap_bpf_engine = {
 	.free_handle = free_handle,
 	.close = scap_bpf_close,
 	.next = next,
+	.peek = peek,
 	.start_capture = scap_bpf_start_capture,
 	.stop_capture = scap_bpf_stop_capture,
 	.configure = configure,
@@ -155,6 +155,22 @@ static inline void scap_bpf_advance_tail(struct scap_device *dev)
 	dev->m_lastreadsize = 0;
 }
 
+/* This helper increments the consumer position only of `len` bytes of the last block */
+static inline void scap_bpf_advance_tail_by(struct scap_device *dev, uint32_t len)
+{
+	struct perf_event_mmap_page *header;
+
+	header = (struct perf_event_mmap_page *)dev->m_buffer;
+
+	// clang-format off
+	asm volatile("" ::: "memory");
+	// clang-format on
+
+	ASSERT(dev->m_lastreadsize >= len);
+	header->data_tail += len;
+	dev->m_lastreadsize -= len;
+}
+
 static inline int32_t scap_bpf_readbuf(struct scap_device *dev, char **buf, uint32_t *len)
 {
 	struct perf_event_mmap_page *header;
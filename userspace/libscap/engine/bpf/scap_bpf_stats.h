@@ -39,6 +39,16 @@ typedef enum bpf_kernel_counters_stats {
 	BPF_MAX_KERNEL_COUNTERS_STATS
 }bpf_kernel_counters_stats;
 
+/* Counters of every CPU, flagged as PPM_SCAP_STATS_BUFFERS */
+typedef enum bpf_cpu_stats {
+	BPF_CPU_N_EVTS = 0,
+	BPF_CPU_N_DROPS_BUFFER,
+	BPF_CPU_N_DROPS_SCRATCH_MAP,
+	BPF_CPU_N_DROPS_PAGE_FAULTS,
+	BPF_CPU_N_DROPS_BUG,
+	BPF_MAX_CPU_STATS
+}bpf_cpu_stats;
+
 enum bpf_libbpf_stats {
 	RUN_CNT = 0,
 	RUN_TIME_NS,
@@ -51,7 +51,7 @@ static int32_t gvisor_init(scap_t* main_handle, scap_open_args* oargs)
 {
 	scap_gvisor::engine *gv = main_handle->m_engine.m_handle;
 	struct scap_gvisor_engine_params *params = (struct scap_gvisor_engine_params *)oargs->engine_params;
-	return gv->init(params->gvisor_config_path, params->gvisor_root_path, params->no_events);
+	return gv->init(params->gvisor_config_path, params->gvisor_root_path, params->no_events, params->parse_threads, params->thread_start_fn);
 }
 
 static void gvisor_free_handle(struct scap_engine_handle engine)
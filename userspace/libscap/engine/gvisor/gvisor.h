@@ -21,7 +21,9 @@ limitations under the License.
 #include <string>
 #include <thread> 
 #include <atomic>
-#include <deque>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <unordered_map>
 #include <stdint.h>
@@ -94,6 +96,12 @@ struct config_result {
 */
 parse_result parse_gvisor_proto(scap_const_sized_buffer gvisor_buf, scap_sized_buffer scap_buf);
 
+/*!
+    \brief Returns a size of the scap buffer passed to parse_gvisor_proto that fits the events translated
+    from most of the gVisor messages of the given size, so that they don't need to be parsed again
+*/
+size_t scap_buffer_size_hint(size_t gvisor_msg_size);
+
 procfs_result parse_procfs_json(const std::string &input, const std::string &sandbox);
 
 uint64_t get_vxid(uint64_t vxid);
@@ -118,24 +126,55 @@ namespace runsc
 
 } // namespace runsc
 
+// a gVisor message translated into scap events
+class parsed_message {
+public:
+	parsed_message();
+	~parsed_message();
+	parsed_message(const parsed_message&) = delete;
+	parsed_message& operator=(const parsed_message&) = delete;
+
+	int32_t expand_buffer(size_t size);
+
+	scap_sized_buffer m_buf;
+	// pointers to each encoded event within m_buf
+	std::vector<scap_evt*> m_events;
+};
+
 // contains entries to store per-sandbox data and buffers to use to write events in
 class sandbox_entry {
 public:
-	sandbox_entry();
-    ~sandbox_entry();
-
-    int32_t expand_buffer(size_t size);
+	sandbox_entry(size_t ring_size);
+
+	// the parsed messages form a single-producer single-consumer ring: the
+	// thread reading the sandbox fills the slot at m_tail, next() consumes
+	// the ones from m_head. The indexes grow indefinitely and wrap around
+	// the ring size.
+	std::vector<parsed_message> m_ring;
+	std::atomic<uint32_t> m_head;
+	std::atomic<uint32_t> m_tail;
+
+	uint64_t m_last_dropped_count;
+	// set by the thread reading the sandbox once it's disconnected, the
+	// sandbox is removed after all its events are consumed
+	std::atomic<bool> m_closing;
+};
 
-    scap_sized_buffer m_buf;
-    uint64_t m_last_dropped_count;
-	bool m_closing;
+// reads and parses the messages of the sandboxes assigned to it, on its own
+// thread or, without parsing threads, on the capture thread within next()
+struct parse_worker {
+	int m_epollfd = -1;
+	std::thread m_thread;
+	// the sandboxes read by this worker, by fd
+	std::unordered_map<int, sandbox_entry*> m_sandboxes;
+	char m_lasterr[SCAP_LASTERR_SIZE];
 };
 
 class engine {
 public:
     engine(char *lasterr);
     ~engine();
-    int32_t init(std::string config_path, std::string root_path, bool no_events);
+    int32_t init(std::string config_path, std::string root_path, bool no_events, uint32_t parse_threads, void (*thread_start_fn)(enum scap_gvisor_thread));
     int32_t close();
 
     int32_t start_capture();
@@ -149,23 +188,53 @@ public:
     int32_t get_stats(scap_stats *stats);
     const struct scap_stats_v2* get_stats_v2(uint32_t flags, uint32_t* nstats, int32_t* rc);
 private:
-    int32_t process_message_from_fd(int fd);
+    int32_t process_message_from_fd(parse_worker &worker, int fd, sandbox_entry &sandbox);
+    int32_t poll_sandboxes(parse_worker &worker, int timeout_ms);
+    void close_sandbox(parse_worker &worker, int fd, sandbox_entry &sandbox);
+    void worker_loop(parse_worker &worker);
+    void stop_workers();
+    int32_t next_round();
+    bool collect_round();
+    void release_round();
     void free_sandbox_buffers();
 
     char *m_lasterr;
     int m_listenfd = 0;
-    int m_epollfd = 0;
     bool m_capture_started = false;
     bool m_no_events = false;
 
     std::string m_socket_path;
     std::thread m_accept_thread;
 
-    // contains pointers to parsed events to process
-    std::deque<scap_evt *> m_event_queue{};
+    // number of threads parsing the sandbox messages, 0 to parse them
+    // on the capture thread
+    uint32_t m_parse_threads = 0;
+
+    // called at the start of the accept and parsing threads, if set
+    void (*m_thread_start_fn)(enum scap_gvisor_thread) = nullptr;
+
+    // the sandboxes are spread across the workers by fd. Without parsing
+    // threads, the only worker is polled by next()
+    std::vector<std::unique_ptr<parse_worker>> m_workers;
+    std::atomic<bool> m_workers_stop{false};
+    // the workers bump m_ready_seq after each poll to wake up next(), and
+    // fill m_workers_error when they stop because of a fatal error
+    std::mutex m_ready_mutex;
+    std::condition_variable m_ready_cond;
+    uint64_t m_ready_seq = 0;
+    std::string m_workers_error;
 
     // stores per-sandbox data. All buffers used to contain parsed event data are owned by this map
-    std::unordered_map<int, sandbox_entry> m_sandbox_data;
+    std::mutex m_sandbox_mutex;
+    std::unordered_map<int, std::unique_ptr<sandbox_entry>> m_sandbox_data;
+
+    // the events collected from the sandbox rings, merged by timestamp, and
+    // the next one to return. The ring slots they point to are released
+    // when the next round is collected.
+    std::vector<scap_evt*> m_round;
+    size_t m_round_pos = 0;
+    std::vector<std::vector<scap_evt*>> m_round_parts;
+    std::vector<std::pair<sandbox_entry*, uint32_t>> m_round_release;
 
     // the following two maps store and manage memory for thread information requested
     // when get_threadinfos() is called. They are only updated upon get_threadinfos()
@@ -180,11 +249,14 @@ private:
     struct gvisor_stats
     {
         // total number of events received from gVisor
-        uint64_t n_evts;
+        std::atomic<uint64_t> n_evts;
         // total number of drops due to parsig errors
-        uint64_t n_drops_parsing;
+        std::atomic<uint64_t> n_drops_parsing;
         // total number of drops on gVisor side
-        uint64_t n_drops_gvisor;
+        std::atomic<uint64_t> n_drops_gvisor;
+        // total number of times a sandbox wasn't read because its ring
+        // of parsed messages was full
+        std::atomic<uint64_t> n_parse_deferred;
     } m_gvisor_stats;
 
     // Stats v2.
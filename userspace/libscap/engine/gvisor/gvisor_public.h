@@ -20,12 +20,20 @@ extern "C"
 {
 #endif
 
+	enum scap_gvisor_thread
+	{
+		SCAP_GVISOR_ACCEPT_THREAD = 0, ///< accepts the connections of the sandboxes
+		SCAP_GVISOR_PARSE_THREAD = 1,  ///< reads and parses the messages of the sandboxes
+	};
+
 	struct scap_gvisor_engine_params
 	{
 		const char* gvisor_root_path;	///< When using gvisor, the root path used by runsc commands
 		const char* gvisor_config_path; ///< When using gvisor, the path to the configuration file
 
 		bool no_events; //< Pinky swear we don't want any event from it (i.e. next will always fail, just have proc scan)
+		uint32_t parse_threads; ///< Number of threads parsing the sandbox messages, 0 to parse them on the capture thread
+		void (*thread_start_fn)(enum scap_gvisor_thread thread); ///< If not NULL, called at the start of each thread of the engine, e.g. to name it or set its affinity
 	};
 
 #ifdef __cplusplus
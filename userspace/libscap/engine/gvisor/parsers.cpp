@@ -33,6 +33,7 @@ limitations under the License.
 #include <string>
 
 #include <json/json.h>
+#include <google/protobuf/arena.h>
 
 #include "gvisor.h"
 #include "parsers.h"
@@ -50,6 +51,8 @@ namespace scap_gvisor {
 namespace parsers {
 
 constexpr size_t socktuple_buffer_size = 1024;
+constexpr size_t arena_initial_block_size = 16 * 1024;
+constexpr size_t fixed_events_size_hint = 1024;
 
 // In gVisor there's no concept of tid and tgid but only vtid and vtgid.
 // However, to fit into sinsp we do need values for tid and tgid.
@@ -68,6 +71,36 @@ uint64_t get_vxid(uint64_t xid)
 	return xid & 0xffffffff;
 }
 
+// The events translated from a message mostly carry its strings, some of them
+// twice (e.g. the arguments of a new container are in both its clone and
+// execve events), plus their fixed size parameters.
+size_t scap_buffer_size_hint(size_t gvisor_msg_size)
+{
+	return 2 * gvisor_msg_size + fixed_events_size_hint;
+}
+
+// Each thread parsing messages allocates them in its own arena, which is reset
+// before parsing a new message: the fields of most messages fit in its initial
+// block, so that they don't need any heap allocation.
+static google::protobuf::Arena& message_arena()
+{
+	alignas(8) thread_local char initial_block[arena_initial_block_size];
+	thread_local google::protobuf::Arena arena([]
+	{
+		google::protobuf::ArenaOptions options;
+		options.initial_block = initial_block;
+		options.initial_block_size = arena_initial_block_size;
+		return options;
+	}());
+	return arena;
+}
+
+template<class T>
+static T& arena_message()
+{
+	return *google::protobuf::Arena::CreateMessage<T>(&message_arena());
+}
+
 template<class T>
 static void fill_context_data(scap_evt *evt, T& gvisor_evt)
 {
@@ -87,7 +120,7 @@ static parse_result parse_container_start(const char *proto, size_t proto_size,
 	scap_sized_buffer event_buf = scap_buf;
 	size_t event_size;
 
-	gvisor::container::Start gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::container::Start>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -262,7 +295,7 @@ static parse_result parse_execve(const char *proto, size_t proto_size, scap_size
 	char scap_err[SCAP_LASTERR_SIZE];
 	scap_err[0] = '\0';
 
-	gvisor::syscall::Execve gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Execve>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -392,7 +425,7 @@ static parse_result parse_sentry_clone(const char *proto, size_t proto_size, sca
 	char scap_err[SCAP_LASTERR_SIZE];
 	scap_err[0] = '\0';
 
-	gvisor::sentry::CloneInfo gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::sentry::CloneInfo>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -447,7 +480,7 @@ static parse_result parse_read(const char *proto, size_t proto_size, scap_sized_
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Read gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Read>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -463,9 +496,10 @@ static parse_result parse_read(const char *proto, size_t proto_size, scap_sized_
 	}
 	else
 	{
-		ret.status = scap_event_encode_params(scap_buf, &ret.size, scap_err, PPME_SYSCALL_READ_X, 2,
+		ret.status = scap_event_encode_params(scap_buf, &ret.size, scap_err, PPME_SYSCALL_READ_X, 3,
 								gvisor_evt.exit().result(),
-								scap_const_sized_buffer{NULL, 0});
+								scap_const_sized_buffer{NULL, 0},
+								gvisor_evt.fd());
 	}
 
 	if (ret.status != SCAP_SUCCESS) {
@@ -614,7 +648,7 @@ static parse_result parse_connect(const char *proto, size_t proto_size, scap_siz
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Connect gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Connect>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -670,7 +704,7 @@ static parse_result parse_socket(const char *proto, size_t proto_size, scap_size
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Socket gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Socket>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -703,7 +737,7 @@ static parse_result parse_socket(const char *proto, size_t proto_size, scap_size
 static parse_result parse_generic_syscall(const char *proto, size_t proto_size, scap_sized_buffer scap_buf)
 {
 	parse_result ret = {0};
-	gvisor::syscall::Syscall gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Syscall>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -731,7 +765,7 @@ static parse_result parse_accept(const char *proto, size_t proto_size, scap_size
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Accept gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Accept>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -790,7 +824,7 @@ static parse_result parse_fcntl(const char *proto, size_t proto_size, scap_sized
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Fcntl gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Fcntl>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -826,7 +860,7 @@ static parse_result parse_bind(const char *proto, size_t proto_size, scap_sized_
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Bind gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Bind>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -880,7 +914,7 @@ static parse_result parse_pipe(const char *proto, size_t proto_size, scap_sized_
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Pipe gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Pipe>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -917,7 +951,7 @@ static parse_result parse_open(const char *proto, size_t proto_size, scap_sized_
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Open gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Open>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -957,7 +991,7 @@ static parse_result parse_chdir(const char *proto, size_t proto_size, scap_sized
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Chdir gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Chdir>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -992,7 +1026,7 @@ static parse_result parse_setresid(const char *proto, size_t proto_size, scap_si
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Setresid gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Setresid>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -1035,7 +1069,7 @@ static parse_result parse_setid(const char *proto, size_t proto_size, scap_sized
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Setid gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Setid>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -1076,7 +1110,7 @@ static parse_result parse_chroot(const char *proto, size_t proto_size, scap_size
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Chroot gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Chroot>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -1111,7 +1145,7 @@ static parse_result parse_dup(const char *proto, size_t proto_size, scap_sized_b
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Dup gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Dup>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -1184,7 +1218,7 @@ static parse_result parse_task_exit(const char *proto, size_t proto_size, scap_s
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::sentry::TaskExit gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::sentry::TaskExit>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -1212,7 +1246,7 @@ static parse_result parse_prlimit64(const char *proto, size_t proto_size, scap_s
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Prlimit gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Prlimit>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -1253,7 +1287,7 @@ static parse_result parse_signalfd(const char *proto, size_t proto_size, scap_si
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Signalfd gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Signalfd>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -1291,7 +1325,7 @@ parse_result parse_eventfd(const char *proto, size_t proto_size, scap_sized_buff
 {
 	parse_result ret = {0};
 	char scap_err[SCAP_LASTERR_SIZE];
-	gvisor::syscall::Eventfd gvisor_evt;
+	auto& gvisor_evt = arena_message<gvisor::syscall::Eventfd>();
 	if(!gvisor_evt.ParseFromArray(proto, proto_size))
 	{
 		ret.status = SCAP_FAILURE;
@@ -1329,6 +1363,9 @@ parse_result parse_gvisor_proto(scap_const_sized_buffer gvisor_buf, scap_sized_b
 	parse_result ret = {0};
 	const char *buf = static_cast<const char*>(gvisor_buf.buf);
 
+	// the messages of the previous call are not used anymore
+	message_arena().Reset();
+
 	const header *hdr = reinterpret_cast<const header *>(buf);
 	if(hdr->header_size > gvisor_buf.size)
 	{
@@ -24,6 +24,10 @@ limitations under the License.
 #include <sys/epoll.h>
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <chrono>
+#include <queue>
+#include <tuple>
 #include <vector>
 #include <fstream>
 #include <sstream>
@@ -41,6 +45,10 @@ constexpr uint32_t current_version = 1;
 constexpr uint32_t max_ready_sandboxes = 32;
 constexpr size_t max_message_size = 300 * 1024;
 constexpr size_t initial_event_buffer_size = 32;
+constexpr size_t sandbox_ring_size = 16;
+constexpr size_t max_presized_buffer_size = 64 * 1024;
+constexpr int worker_wait_ms = 100;
+constexpr int ready_wait_ms = 10;
 constexpr int listen_backlog_size = 128;
 const std::string default_root_path = "/var/run/docker/runtime-runc/moby";
 
@@ -49,17 +57,16 @@ static const char * const gvisor_counters_stats_names[] = {
 	[scap_gvisor::stats::GVISOR_N_DROPS_BUG] = "n_drops_bug",
 	[scap_gvisor::stats::GVISOR_N_DROPS_BUFFER_TOTAL] ="n_drops_buffer_total",
 	[scap_gvisor::stats::GVISOR_N_DROPS] = "n_drops",
+	[scap_gvisor::stats::GVISOR_N_PARSE_DEFERRED] = "n_parse_deferred",
 };
 
-sandbox_entry::sandbox_entry()
+parsed_message::parsed_message()
 {
 	m_buf.buf = nullptr;
 	m_buf.size = 0;
-	m_last_dropped_count = 0;
-	m_closing = false;
 }
 
-sandbox_entry::~sandbox_entry()
+parsed_message::~parsed_message()
 {
 	if (m_buf.buf != nullptr)
 	{
@@ -67,7 +74,7 @@ sandbox_entry::~sandbox_entry()
 	}
 }
 
-int32_t sandbox_entry::expand_buffer(size_t size)
+int32_t parsed_message::expand_buffer(size_t size)
 {
 	void* new_buf;
 
@@ -92,20 +99,30 @@ int32_t sandbox_entry::expand_buffer(size_t size)
 	return SCAP_SUCCESS;
 }
 
+sandbox_entry::sandbox_entry(size_t ring_size):
+	m_ring(ring_size),
+	m_head(0),
+	m_tail(0),
+	m_last_dropped_count(0),
+	m_closing(false)
+{
+}
+
 engine::engine(char *lasterr)
 {
     m_lasterr = lasterr;
 	m_gvisor_stats.n_evts = 0;
 	m_gvisor_stats.n_drops_parsing = 0;
 	m_gvisor_stats.n_drops_gvisor = 0;
+	m_gvisor_stats.n_parse_deferred = 0;
 }
 
 engine::~engine()
 {
-
+	stop_workers();
 }
 
-int32_t engine::init(std::string config_path, std::string root_path, bool no_events)
+int32_t engine::init(std::string config_path, std::string root_path, bool no_events, uint32_t parse_threads, void (*thread_start_fn)(enum scap_gvisor_thread))
 {
 	if(root_path.empty())
 	{
@@ -190,12 +207,18 @@ int32_t engine::init(std::string config_path, std::string root_path, bool no_eve
 	umask(old_umask);
 	m_listenfd = sock;
 
-	// Initialize the epoll fd
-	m_epollfd = epoll_create(1);
-	if(m_epollfd == -1)
+	// Initialize the epoll fd of each worker
+	m_parse_threads = parse_threads;
+	m_thread_start_fn = thread_start_fn;
+	for(uint32_t i = 0; i < std::max(parse_threads, 1U); i++)
 	{
-		snprintf(m_lasterr, SCAP_LASTERR_SIZE, "Cannot create epollfd socket: %s", strerror(errno));
-		return SCAP_FAILURE;
+		m_workers.emplace_back(new parse_worker);
+		m_workers.back()->m_epollfd = epoll_create(1);
+		if(m_workers.back()->m_epollfd == -1)
+		{
+			snprintf(m_lasterr, SCAP_LASTERR_SIZE, "Cannot create epollfd socket: %s", strerror(errno));
+			return SCAP_FAILURE;
+		}
 	}
 
     return SCAP_SUCCESS;
@@ -215,9 +238,28 @@ int32_t engine::close()
 
 void engine::free_sandbox_buffers()
 {
+	m_round.clear();
+	m_round_pos = 0;
+	m_round_release.clear();
+	for(auto &worker : m_workers)
+	{
+		worker->m_sandboxes.clear();
+	}
 	m_sandbox_data.clear();
 }
 
+void engine::stop_workers()
+{
+	m_workers_stop = true;
+	for(auto &worker : m_workers)
+	{
+		if(worker->m_thread.joinable())
+		{
+			worker->m_thread.join();
+		}
+	}
+}
+
 static bool handshake(int client)
 {
 	std::vector<char> buf(max_message_size);
@@ -252,8 +294,13 @@ static bool handshake(int client)
 	return true;
 }
 
-static void accept_thread(int listenfd, int epollfd)
+static void accept_thread(int listenfd, std::vector<int> epollfds, void (*thread_start_fn)(enum scap_gvisor_thread))
 {
+	if(thread_start_fn != nullptr)
+	{
+		thread_start_fn(SCAP_GVISOR_ACCEPT_THREAD);
+	}
+
 	while(true)
 	{
 		int client = accept(listenfd, NULL, NULL);
@@ -273,10 +320,11 @@ static void accept_thread(int listenfd, int epollfd)
 			continue;
 		}
 
+		// each sandbox is always read by the same worker
 		epoll_event evt;
 		evt.data.fd = client;
 		evt.events = EPOLLIN;
-		if(epoll_ctl(epollfd, EPOLL_CTL_ADD, client, &evt) < 0)
+		if(epoll_ctl(epollfds[client % epollfds.size()], EPOLL_CTL_ADD, client, &evt) < 0)
 		{
 			return;
 		}
@@ -301,8 +349,17 @@ int32_t engine::start_capture()
 	}
 	std::vector<std::string> &existing_sandboxes = exisiting_sandboxes_res.output;
 
-	// Start accepting connections
-	m_accept_thread = std::thread(accept_thread, m_listenfd, m_epollfd);
+	// Start parsing and accepting connections
+	std::vector<int> epollfds;
+	for(auto &worker : m_workers)
+	{
+		epollfds.push_back(worker->m_epollfd);
+		if(m_parse_threads > 0)
+		{
+			worker->m_thread = std::thread(&engine::worker_loop, this, std::ref(*worker));
+		}
+	}
+	m_accept_thread = std::thread(accept_thread, m_listenfd, epollfds, m_thread_start_fn);
 	m_accept_thread.detach();
 
 	m_capture_started = true;
@@ -361,7 +418,11 @@ int32_t engine::stop_capture()
 	}
 
 	shutdown(m_listenfd, 2);
-	::close(m_epollfd);
+	stop_workers();
+	for(auto &worker : m_workers)
+	{
+		::close(worker->m_epollfd);
+	}
 	free_sandbox_buffers();
 
 	runsc::result sandboxes_res = runsc::list(m_root_path);
@@ -479,26 +540,28 @@ const struct scap_stats_v2* engine::get_stats_v2(uint32_t flags, uint32_t* nstat
 	stats[scap_gvisor::stats::GVISOR_N_DROPS_BUG].value.u64 = m_gvisor_stats.n_drops_parsing;
 	stats[scap_gvisor::stats::GVISOR_N_DROPS_BUFFER_TOTAL].value.u64 = m_gvisor_stats.n_drops_parsing + m_gvisor_stats.n_drops_gvisor;
 	stats[scap_gvisor::stats::GVISOR_N_DROPS].value.u64 = m_gvisor_stats.n_drops_gvisor;
+	stats[scap_gvisor::stats::GVISOR_N_PARSE_DEFERRED].value.u64 = m_gvisor_stats.n_parse_deferred;
 
 	*rc = SCAP_SUCCESS;
 	return stats;
 }
 
-// Reads one gvisor message from the specified fd, stores the resulting events overwriting m_buffers and adds pointers to m_event_queue.
+// Reads one gvisor message from the specified fd and stores the resulting events in the slot at the tail of the
+// sandbox ring, which gets published to next(). The ring must not be full.
 // Returns:
 // * SCAP_SUCCESS in case of success
-// * SCAP_FAILURE in case of a fatal error while reading from the fd or allocating memory (m_lasterr is filled)
+// * SCAP_FAILURE in case of a fatal error while reading from the fd or allocating memory (worker.m_lasterr is filled)
 // * SCAP_NOT_SUPPORTED if the message type is not currently supported
 // * SCAP_ILLEGAL_INPUT in case of parsing errors (invalid message or parsing issue)
 // * SCAP_EOF if there is no more data to process from this fd
-int32_t engine::process_message_from_fd(int fd)
+int32_t engine::process_message_from_fd(parse_worker &worker, int fd, sandbox_entry &sandbox)
 {
 	char message[max_message_size];
 
 	ssize_t nbytes = read(fd, message, max_message_size);
 	if(nbytes == -1)
 	{
-		snprintf(m_lasterr, SCAP_LASTERR_SIZE, "Error reading from gvisor client: %s", strerror(errno));
+		snprintf(worker.m_lasterr, SCAP_LASTERR_SIZE, "Error reading from gvisor client: %s", strerror(errno));
 		return SCAP_FAILURE;
 	}
 	else if(nbytes == 0)
@@ -506,94 +569,77 @@ int32_t engine::process_message_from_fd(int fd)
 		return SCAP_EOF;
 	}
 
-	// check if we need to allocate a new buffer for this sandbox
-	if(m_sandbox_data.count(fd) != 1)
-	{
-		m_sandbox_data.emplace(fd, sandbox_entry{});
-		if (m_sandbox_data[fd].expand_buffer(initial_event_buffer_size) == SCAP_FAILURE) {
-			snprintf(m_lasterr, SCAP_LASTERR_SIZE, "could not initialize %zu bytes for gvisor sandbox on fd %d", initial_event_buffer_size, fd);
-			return SCAP_FAILURE;
-		}
-	}
+	uint32_t tail = sandbox.m_tail.load(std::memory_order_relaxed);
+	parsed_message &slot = sandbox.m_ring[tail % sandbox.m_ring.size()];
 
 	scap_const_sized_buffer gvisor_msg = {.buf = static_cast<void*>(message), .size = static_cast<size_t>(nbytes)};
 
-	parsers::parse_result parse_result = parsers::parse_gvisor_proto(gvisor_msg, m_sandbox_data[fd].m_buf);
+	// make room for the events of the message beforehand, so that it rarely
+	// needs to be parsed twice. The buffers of big messages grow on demand.
+	size_t size_hint = std::min(parsers::scap_buffer_size_hint(nbytes), max_presized_buffer_size);
+	if(slot.m_buf.size < size_hint && slot.expand_buffer(size_hint) == SCAP_FAILURE)
+	{
+		snprintf(worker.m_lasterr, SCAP_LASTERR_SIZE,"Cannot realloc gvisor buffer to %zu", size_hint);
+		return SCAP_FAILURE;
+	}
+
+	parsers::parse_result parse_result = parsers::parse_gvisor_proto(gvisor_msg, slot.m_buf);
 	if(parse_result.status == SCAP_INPUT_TOO_SMALL)
 	{
-		if (m_sandbox_data[fd].expand_buffer(parse_result.size) == SCAP_FAILURE)
+		// grow geometrically, so that the next bigger messages fit as well
+		size_t new_size = std::max(parse_result.size, 2 * slot.m_buf.size);
+		if (slot.expand_buffer(new_size) == SCAP_FAILURE)
 		{
-			snprintf(m_lasterr, SCAP_LASTERR_SIZE,"Cannot realloc gvisor buffer to %zu", parse_result.size);
+			snprintf(worker.m_lasterr, SCAP_LASTERR_SIZE,"Cannot realloc gvisor buffer to %zu", new_size);
 			return SCAP_FAILURE;
 		};
-		parse_result = parsers::parse_gvisor_proto(gvisor_msg, m_sandbox_data[fd].m_buf);
+		parse_result = parsers::parse_gvisor_proto(gvisor_msg, slot.m_buf);
 	} 
 
 	if(parse_result.status == SCAP_NOT_SUPPORTED)
 	{
-		strlcpy(m_lasterr, parse_result.error.c_str(), SCAP_LASTERR_SIZE);
+		strlcpy(worker.m_lasterr, parse_result.error.c_str(), SCAP_LASTERR_SIZE);
 		return SCAP_NOT_SUPPORTED;
 	}
 
 	if(parse_result.status == SCAP_FAILURE)
 	{
-		strlcpy(m_lasterr, parse_result.error.c_str(), SCAP_LASTERR_SIZE);
+		strlcpy(worker.m_lasterr, parse_result.error.c_str(), SCAP_LASTERR_SIZE);
 		return SCAP_ILLEGAL_INPUT;
 	}
 
-	uint64_t delta = parse_result.dropped_count - m_sandbox_data[fd].m_last_dropped_count;
-	m_sandbox_data[fd].m_last_dropped_count = parse_result.dropped_count;
+	uint64_t delta = parse_result.dropped_count - sandbox.m_last_dropped_count;
+	sandbox.m_last_dropped_count = parse_result.dropped_count;
 	m_gvisor_stats.n_drops_gvisor += delta;
 
-	for(scap_evt *evt : parse_result.scap_events)
-	{
-		m_event_queue.push_back(evt);
-	}
+	slot.m_events = std::move(parse_result.scap_events);
+	sandbox.m_tail.store(tail + 1, std::memory_order_release);
 
 	return parse_result.status;
 }
 
-int32_t engine::next(scap_evt **pevent, uint16_t *pcpuid)
+// Stops reading a sandbox that is no longer connected. Its fd is closed by next() once all its events are consumed.
+void engine::close_sandbox(parse_worker &worker, int fd, sandbox_entry &sandbox)
 {
-	if(m_no_events)
-	{
-		return SCAP_FAILURE;
-	}
+	epoll_ctl(worker.m_epollfd, EPOLL_CTL_DEL, fd, NULL);
+	worker.m_sandboxes.erase(fd);
+	sandbox.m_closing.store(true, std::memory_order_release);
+}
 
+// Waits up to timeout_ms for the messages of the sandboxes read by the worker, and parses them in the sandbox rings.
+// Returns:
+// * SCAP_SUCCESS if the ready messages were parsed, or there were none
+// * SCAP_TIMEOUT if some sandboxes were not read because their ring was full
+// * SCAP_EOF if the wait was interrupted (worker.m_lasterr is filled)
+// * SCAP_FAILURE in case of a fatal error (worker.m_lasterr is filled)
+int32_t engine::poll_sandboxes(parse_worker &worker, int timeout_ms)
+{
 	epoll_event evts[max_ready_sandboxes];
-	*pcpuid = 0;
 
-	// if there are still events to process do it before getting more
-	if(!m_event_queue.empty())
-	{
-		*pevent = m_event_queue.front();
-		m_event_queue.pop_front();
-		m_gvisor_stats.n_evts++;
-		return SCAP_SUCCESS;
-	}
-
-	// at this moment, there are no events in any of the buffers we allocated
-	// for each sandbox: this is the right place to close fds and deallocate
-	// buffers safely for all the sandboxes that are no longer connected. 
-
-	for(auto it = m_sandbox_data.begin(); it != m_sandbox_data.end(); )
-	{
-		sandbox_entry &sandbox = it->second;
-		if(sandbox.m_closing)
-		{
-			::close(it->first);
-			it = m_sandbox_data.erase(it);
-		}
-		else
-		{
-			it++;
-		}
-	}
-
-	int nfds = epoll_wait(m_epollfd, evts, max_ready_sandboxes, -1);
+	int nfds = epoll_wait(worker.m_epollfd, evts, max_ready_sandboxes, timeout_ms);
 	if (nfds < 0)
 	{
-		snprintf(m_lasterr, SCAP_LASTERR_SIZE, "epoll_wait error: %s", strerror(errno));
+		snprintf(worker.m_lasterr, SCAP_LASTERR_SIZE, "epoll_wait error: %s", strerror(errno));
 		if (errno == EINTR) {
 			// Syscall interrupted. Nothing else to read.
 			return SCAP_EOF;
@@ -602,16 +648,45 @@ int32_t engine::next(scap_evt **pevent, uint16_t *pcpuid)
 		return SCAP_FAILURE;
 	}
 
+	int32_t res = SCAP_SUCCESS;
 	for (int i = 0; i < nfds; ++i) {
 		int fd = evts[i].data.fd;
+
+		// check if we need to allocate the buffers for this sandbox
+		auto it = worker.m_sandboxes.find(fd);
+		if(it == worker.m_sandboxes.end())
+		{
+			std::unique_ptr<sandbox_entry> entry(new sandbox_entry(sandbox_ring_size));
+			for(auto &slot : entry->m_ring)
+			{
+				if (slot.expand_buffer(initial_event_buffer_size) == SCAP_FAILURE) {
+					snprintf(worker.m_lasterr, SCAP_LASTERR_SIZE, "could not initialize %zu bytes for gvisor sandbox on fd %d", initial_event_buffer_size, fd);
+					return SCAP_FAILURE;
+				}
+			}
+			it = worker.m_sandboxes.emplace(fd, entry.get()).first;
+			std::lock_guard<std::mutex> lock(m_sandbox_mutex);
+			m_sandbox_data[fd] = std::move(entry);
+		}
+		sandbox_entry &sandbox = *it->second;
+		bool closing = false;
+
 		if (evts[i].events & EPOLLIN) {
-			uint32_t status = process_message_from_fd(fd);
+			// leave the message in the socket until next() frees a slot
+			if (sandbox.m_tail.load(std::memory_order_relaxed) - sandbox.m_head.load(std::memory_order_acquire) == sandbox.m_ring.size())
+			{
+				m_gvisor_stats.n_parse_deferred++;
+				res = SCAP_TIMEOUT;
+				continue;
+			}
+
+			int32_t status = process_message_from_fd(worker, fd, sandbox);
 			if (status == SCAP_FAILURE) {
 				return SCAP_FAILURE;
 			}
 			else if (status == SCAP_EOF)
 			{
-				m_sandbox_data[fd].m_closing = true;
+				closing = true;
 			}
 
 			// ignore unsupported messages, we will simply discard them
@@ -628,7 +703,7 @@ int32_t engine::next(scap_evt **pevent, uint16_t *pcpuid)
 
 		if ((evts[i].events & (EPOLLRDHUP | EPOLLHUP)) != 0)
 		{
-			m_sandbox_data[fd].m_closing = true;
+			closing = true;
 		}
 
 		if (evts[i].events & EPOLLERR)
@@ -637,23 +712,219 @@ int32_t engine::next(scap_evt **pevent, uint16_t *pcpuid)
 			socklen_t len = sizeof(socket_error);
 			if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &socket_error, &len))
 			{
-				snprintf(m_lasterr, SCAP_LASTERR_SIZE, "epoll error: %s", strerror(socket_error));
+				snprintf(worker.m_lasterr, SCAP_LASTERR_SIZE, "epoll error: %s", strerror(socket_error));
 				return SCAP_FAILURE;
 			}
 		}
+
+		if (closing)
+		{
+			close_sandbox(worker, fd, sandbox);
+		}
+	}
+
+	return res;
+}
+
+void engine::worker_loop(parse_worker &worker)
+{
+	if(m_thread_start_fn != nullptr)
+	{
+		m_thread_start_fn(SCAP_GVISOR_PARSE_THREAD);
+	}
+
+	while(!m_workers_stop)
+	{
+		int32_t res = poll_sandboxes(worker, worker_wait_ms);
+
+		std::unique_lock<std::mutex> lock(m_ready_mutex);
+		if(res == SCAP_FAILURE)
+		{
+			m_workers_error = worker.m_lasterr;
+		}
+		m_ready_seq++;
+		lock.unlock();
+		m_ready_cond.notify_one();
+
+		if(res == SCAP_FAILURE)
+		{
+			return;
+		}
+		else if(res == SCAP_TIMEOUT)
+		{
+			// some rings are full, give next() the time to consume them
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+// Marks as consumed the ring slots of the events collected by the last round.
+void engine::release_round()
+{
+	for(const auto &it : m_round_release)
+	{
+		it.first->m_head.store(it.second, std::memory_order_release);
+	}
+	m_round_release.clear();
+}
+
+// Collects the messages parsed in all the sandbox rings, and merges their events by timestamp keeping the order
+// of the events of each sandbox. Returns false if there are no events.
+bool engine::collect_round()
+{
+	typedef std::tuple<uint64_t, size_t, size_t> merge_cursor;
+
+	release_round();
+	m_round.clear();
+	m_round_pos = 0;
+
+	size_t nparts = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_sandbox_mutex);
+		for(auto &it : m_sandbox_data)
+		{
+			sandbox_entry &sandbox = *it.second;
+			uint32_t head = sandbox.m_head.load(std::memory_order_relaxed);
+			uint32_t tail = sandbox.m_tail.load(std::memory_order_acquire);
+			if(head == tail)
+			{
+				continue;
+			}
+
+			if(nparts == m_round_parts.size())
+			{
+				m_round_parts.emplace_back();
+			}
+			std::vector<scap_evt*> &part = m_round_parts[nparts++];
+			part.clear();
+			for(uint32_t i = head; i != tail; i++)
+			{
+				const parsed_message &slot = sandbox.m_ring[i % sandbox.m_ring.size()];
+				part.insert(part.end(), slot.m_events.begin(), slot.m_events.end());
+			}
+			m_round_release.emplace_back(&sandbox, tail);
+		}
 	}
 
-	// check if any message has been processed and return the first
-	if(!m_event_queue.empty())
+	if(nparts == 1)
+	{
+		m_round.swap(m_round_parts[0]);
+		return !m_round.empty();
+	}
+
+	std::priority_queue<merge_cursor, std::vector<merge_cursor>, std::greater<merge_cursor>> heads;
+	for(size_t i = 0; i < nparts; i++)
+	{
+		if(!m_round_parts[i].empty())
+		{
+			heads.emplace(m_round_parts[i][0]->ts, i, 0);
+		}
+	}
+
+	while(!heads.empty())
+	{
+		size_t part = std::get<1>(heads.top());
+		size_t pos = std::get<2>(heads.top());
+		heads.pop();
+
+		m_round.push_back(m_round_parts[part][pos]);
+		if(++pos < m_round_parts[part].size())
+		{
+			heads.emplace(m_round_parts[part][pos]->ts, part, pos);
+		}
+	}
+
+	return !m_round.empty();
+}
+
+// Releases the events returned so far and collects the next ones. Returns:
+// * SCAP_SUCCESS if there are events to return
+// * SCAP_TIMEOUT if there are none
+// * SCAP_EOF or SCAP_FAILURE in case of errors (m_lasterr is filled)
+int32_t engine::next_round()
+{
+	release_round();
+
+	// at this moment, all the events returned so far were consumed: this is
+	// the right place to close fds and deallocate buffers safely for all the
+	// sandboxes that are no longer connected and have no events left.
+	{
+		std::lock_guard<std::mutex> lock(m_sandbox_mutex);
+		for(auto it = m_sandbox_data.begin(); it != m_sandbox_data.end(); )
+		{
+			sandbox_entry &sandbox = *it->second;
+			if(sandbox.m_closing.load(std::memory_order_acquire) &&
+			   sandbox.m_head.load(std::memory_order_relaxed) == sandbox.m_tail.load(std::memory_order_acquire))
+			{
+				::close(it->first);
+				it = m_sandbox_data.erase(it);
+			}
+			else
+			{
+				it++;
+			}
+		}
+	}
+
+	if(m_parse_threads == 0)
+	{
+		parse_worker &worker = *m_workers[0];
+		int32_t res = poll_sandboxes(worker, -1);
+		if(res == SCAP_FAILURE || res == SCAP_EOF)
+		{
+			strlcpy(m_lasterr, worker.m_lasterr, SCAP_LASTERR_SIZE);
+			return res;
+		}
+		return collect_round() ? SCAP_SUCCESS : SCAP_TIMEOUT;
+	}
+
+	uint64_t seq;
+	{
+		std::lock_guard<std::mutex> lock(m_ready_mutex);
+		seq = m_ready_seq;
+	}
+
+	if(collect_round())
 	{
-		*pevent = m_event_queue.front();
-		m_event_queue.pop_front();
-		m_gvisor_stats.n_evts++;
 		return SCAP_SUCCESS;
 	}
 
-	// nothing to do
-    return SCAP_TIMEOUT;
+	{
+		std::unique_lock<std::mutex> lock(m_ready_mutex);
+		if(!m_workers_error.empty())
+		{
+			strlcpy(m_lasterr, m_workers_error.c_str(), SCAP_LASTERR_SIZE);
+			return SCAP_FAILURE;
+		}
+		m_ready_cond.wait_for(lock, std::chrono::milliseconds(ready_wait_ms),
+			[this, seq] { return m_ready_seq != seq; });
+	}
+
+	return collect_round() ? SCAP_SUCCESS : SCAP_TIMEOUT;
+}
+
+int32_t engine::next(scap_evt **pevent, uint16_t *pcpuid)
+{
+	if(m_no_events)
+	{
+		return SCAP_FAILURE;
+	}
+
+	*pcpuid = 0;
+
+	// if there are still events to process do it before getting more
+	if(m_round_pos == m_round.size())
+	{
+		int32_t res = next_round();
+		if(res != SCAP_SUCCESS)
+		{
+			return res;
+		}
+	}
+
+	*pevent = m_round[m_round_pos++];
+	m_gvisor_stats.n_evts++;
+	return SCAP_SUCCESS;
 }
 
 } // namespace scap_gvisor
@@ -24,6 +24,7 @@ namespace stats {
         GVISOR_N_DROPS_BUG,
         GVISOR_N_DROPS_BUFFER_TOTAL,
         GVISOR_N_DROPS,
+        GVISOR_N_PARSE_DEFERRED,
         MAX_GVISOR_COUNTERS_STATS
     };
 
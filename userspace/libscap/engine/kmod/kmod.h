@@ -31,5 +31,10 @@ struct kmod_engine
 	uint64_t m_api_version;
 	uint64_t m_schema_version;
 	bool capturing;
-	scap_stats_v2 m_stats[KMOD_MAX_KERNEL_COUNTERS_STATS];
+	scap_stats_v2* m_stats;
+	uint32_t m_nstats;
+	// Wakeup mode only, for PPM_IOCTL_WAIT_READY_CPUS
+	uint32_t* m_dev_cpus; // CPU of each device
+	uint64_t* m_ready_cpus; // bitmap filled by the driver
+	uint32_t m_ready_cpus_words;
 };
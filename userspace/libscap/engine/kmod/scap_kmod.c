@@ -20,6 +20,7 @@ limitations under the License.
 #include <sys/ioctl.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <stddef.h>
 #include <sys/mman.h>
 
 #define SCAP_HANDLE_T struct kmod_engine
@@ -58,6 +59,13 @@ static const char * const kmod_kernel_counters_stats_names[] = {
 	[KMOD_N_PREEMPTIONS] = "n_preemptions",
 };
 
+static const char * const kmod_buffer_stats_names[] = {
+	[KMOD_BUFFER_N_EVTS] = "n_evts",
+	[KMOD_BUFFER_N_DROPS_BUFFER] = "n_drops_buffer",
+	[KMOD_BUFFER_N_DROPS_PAGE_FAULTS] = "n_drops_page_faults",
+	[KMOD_BUFFER_N_PREEMPTIONS] = "n_preemptions",
+};
+
 static struct kmod_engine* alloc_handle(scap_t* main_handle, char* lasterr_ptr)
 {
 	struct kmod_engine *engine = calloc(1, sizeof(struct kmod_engine));
@@ -289,6 +297,52 @@ static int32_t scap_kmod_handle_sc(struct scap_engine_handle engine, uint32_t op
 	return SCAP_SUCCESS;
 }
 
+/* Wakeup mode: sleep in the driver until a buffer holds at least `m_wakeup_watermark_b`
+ * bytes, then refill only the devices of the CPUs it reported. On errors (e.g. an older
+ * driver) we just refill all the devices.
+ */
+static bool kmod_wait_ready_cpus(struct scap_device_set *devset, int timeout_ms)
+{
+	struct kmod_engine *handle = (struct kmod_engine *)((char *)devset - offsetof(struct kmod_engine, m_dev_set));
+	struct ppm_ready_cpus req = {
+		.watermark = devset->m_wakeup_watermark_b,
+		.timeout_ms = timeout_ms,
+		.n_words = handle->m_ready_cpus_words,
+		.mask = (uint64_t)(unsigned long)handle->m_ready_cpus,
+	};
+	uint32_t j;
+
+	if(ioctl(devset->m_devs[0].m_fd, PPM_IOCTL_WAIT_READY_CPUS, &req) < 0)
+	{
+		return false;
+	}
+
+	memset(devset->m_ready_devs, 0, sizeof(uint64_t) * ((devset->m_ndevs + 63) / 64));
+	for(j = 0; j < devset->m_ndevs; j++)
+	{
+		uint32_t cpu = handle->m_dev_cpus[j];
+		if(handle->m_ready_cpus[cpu / 64] & (1ULL << (cpu % 64)))
+		{
+			devset->m_ready_devs[j / 64] |= 1ULL << (j % 64);
+		}
+	}
+
+	return true;
+}
+
+static int32_t kmod_alloc_ready_cpus(struct kmod_engine *handle, uint32_t ndevs, uint32_t ncpus)
+{
+	handle->m_ready_cpus_words = (ncpus + 63) / 64;
+	handle->m_dev_cpus = (uint32_t *)calloc(ndevs, sizeof(uint32_t));
+	handle->m_ready_cpus = (uint64_t *)calloc(handle->m_ready_cpus_words, sizeof(uint64_t));
+	handle->m_dev_set.m_ready_devs = (uint64_t *)calloc((ndevs + 63) / 64, sizeof(uint64_t));
+	if(handle->m_dev_cpus == NULL || handle->m_ready_cpus == NULL || handle->m_dev_set.m_ready_devs == NULL)
+	{
+		return scap_errprintf(handle->m_lasterr, 0, "error allocating the ready CPUs bitmap");
+	}
+	return SCAP_SUCCESS;
+}
+
 int32_t scap_kmod_init(scap_t *handle, scap_open_args *oargs)
 {
 	struct scap_engine_handle engine = handle->m_engine;
@@ -331,12 +385,36 @@ int32_t scap_kmod_init(scap_t *handle, scap_open_args *oargs)
 		return scap_errprintf(handle->m_lasterr, errno, "_SC_NPROCESSORS_ONLN");
 	}
 
-	rc = devset_init(&engine.m_handle->m_dev_set, ndevs, handle->m_lasterr);
+	rc = devset_init(&engine.m_handle->m_dev_set, ndevs, oargs, handle->m_lasterr);
 	if(rc != SCAP_SUCCESS)
 	{
 		return rc;
 	}
 
+	//
+	// Room for the global counters, then the sampling time and the stats of every device
+	//
+	engine.m_handle->m_nstats = KMOD_MAX_KERNEL_COUNTERS_STATS + 1 + ndevs * (RINGBUFFER_MAX_BUFFER_STATS + KMOD_MAX_BUFFER_STATS);
+	engine.m_handle->m_stats = (scap_stats_v2 *)calloc(engine.m_handle->m_nstats, sizeof(scap_stats_v2));
+	if(engine.m_handle->m_stats == NULL)
+	{
+		engine.m_handle->m_nstats = 0;
+		return scap_errprintf(handle->m_lasterr, 0, "error allocating the stats buffer");
+	}
+
+	//
+	// In wakeup mode we let the driver tell us which CPUs have events,
+	// instead of reading the pointers of all the buffers
+	//
+	if(engine.m_handle->m_dev_set.m_wakeup)
+	{
+		rc = kmod_alloc_ready_cpus(engine.m_handle, ndevs, ncpus);
+		if(rc != SCAP_SUCCESS)
+		{
+			return rc;
+		}
+	}
+
 	//
 	// Allocate the device descriptors.
 	//
@@ -472,9 +550,19 @@ int32_t scap_kmod_init(scap_t *handle, scap_open_args *oargs)
 		}
 		dev->m_bufinfo_size = sizeof(struct ppm_ring_buffer_info);
 
+		if(engine.m_handle->m_dev_cpus != NULL)
+		{
+			engine.m_handle->m_dev_cpus[j] = all_scanned_devs;
+		}
+
 		++j;
 	}
 
+	if(engine.m_handle->m_dev_cpus != NULL && engine.m_handle->m_api_version >= (PPM_API_VERSION(4, 3, 0)))
+	{
+		devset->m_wait_fn = kmod_wait_ready_cpus;
+	}
+
 	/* Here we are covering the case in which some syscalls don't have an associated ppm_sc
 	 * and so we cannot set them as (un)interesting. For this reason, we default them to 0.
 	 * Please note this is an extra check since our ppm_sc should already cover all possible syscalls.
@@ -499,6 +587,11 @@ int32_t scap_kmod_close(struct scap_engine_handle engine)
 	struct scap_device_set *devset = &engine.m_handle->m_dev_set;
 
 	devset_free(devset);
+	free(engine.m_handle->m_dev_cpus);
+	free(engine.m_handle->m_ready_cpus);
+	free(engine.m_handle->m_stats);
+	engine.m_handle->m_stats = NULL;
+	engine.m_handle->m_nstats = 0;
 
 	return SCAP_SUCCESS;
 }
@@ -508,6 +601,11 @@ int32_t scap_kmod_next(struct scap_engine_handle engine, OUT scap_evt** pevent,
 	return ringbuffer_next(&engine.m_handle->m_dev_set, pevent, pcpuid);
 }
 
+scap_evt* scap_kmod_peek(struct scap_engine_handle engine, uint16_t cpuid, uint32_t distance)
+{
+	return ringbuffer_peek(&engine.m_handle->m_dev_set, cpuid, distance);
+}
+
 uint32_t scap_kmod_get_n_devs(struct scap_engine_handle engine)
 {
 	return engine.m_handle->m_dev_set.m_ndevs;
@@ -602,6 +700,22 @@ const struct scap_stats_v2* scap_kmod_get_stats_v2(struct scap_engine_handle eng
 		*nstats = KMOD_MAX_KERNEL_COUNTERS_STATS;
 	}
 
+	if((flags & PPM_SCAP_STATS_BUFFERS))
+	{
+		/* Occupancy and counters of every device, one per online CPU */
+		*nstats += ringbuffer_get_buffer_stats(devset, &stats[*nstats]);
+		for(j = 0; j < devset->m_ndevs; j++)
+		{
+			struct ppm_ring_buffer_info *bufinfo = devset->m_devs[j].m_bufinfo;
+			scap_stats_v2 *dev_stats = &stats[*nstats];
+			ringbuffer_set_buffer_stat(&dev_stats[KMOD_BUFFER_N_EVTS], "buffer", j, kmod_buffer_stats_names[KMOD_BUFFER_N_EVTS], bufinfo->n_evts);
+			ringbuffer_set_buffer_stat(&dev_stats[KMOD_BUFFER_N_DROPS_BUFFER], "buffer", j, kmod_buffer_stats_names[KMOD_BUFFER_N_DROPS_BUFFER], bufinfo->n_drops_buffer);
+			ringbuffer_set_buffer_stat(&dev_stats[KMOD_BUFFER_N_DROPS_PAGE_FAULTS], "buffer", j, kmod_buffer_stats_names[KMOD_BUFFER_N_DROPS_PAGE_FAULTS], bufinfo->n_drops_pf);
+			ringbuffer_set_buffer_stat(&dev_stats[KMOD_BUFFER_N_PREEMPTIONS], "buffer", j, kmod_buffer_stats_names[KMOD_BUFFER_N_PREEMPTIONS], bufinfo->n_preemptions);
+			*nstats += KMOD_MAX_BUFFER_STATS;
+		}
+	}
+
 	*rc = SCAP_SUCCESS;
 	return stats;
 }
@@ -724,6 +838,64 @@ int32_t scap_kmod_handle_dropfailed(struct scap_engine_handle engine, bool enabl
 	return SCAP_SUCCESS;
 }
 
+int32_t scap_kmod_set_suppressed_comms(struct scap_engine_handle engine, const struct ppm_suppressed_comms* comms)
+{
+	if(ioctl(engine.m_handle->m_dev_set.m_devs[0].m_fd, PPM_IOCTL_SET_SUPPRESSED_COMMS, comms))
+	{
+		return scap_errprintf(engine.m_handle->m_lasterr, errno, "scap_set_suppressed_comms failed");
+	}
+	return SCAP_SUCCESS;
+}
+
+int32_t scap_kmod_set_suppressed_tid(struct scap_engine_handle engine, uint64_t tid, bool suppressed)
+{
+	int req = suppressed ? PPM_IOCTL_SUPPRESS_TID : PPM_IOCTL_UNSUPPRESS_TID;
+	if(ioctl(engine.m_handle->m_dev_set.m_devs[0].m_fd, req, (unsigned long)tid))
+	{
+		if(errno == ENOTTY)
+		{
+			return SCAP_NOT_SUPPORTED;
+		}
+		return scap_errprintf(engine.m_handle->m_lasterr, errno, "scap_set_suppressed_tid failed");
+	}
+	return SCAP_SUCCESS;
+}
+
+int32_t scap_kmod_set_fd_type_snaplen(struct scap_engine_handle engine, uint32_t fd_type, uint32_t snaplen)
+{
+	struct ppm_fd_type_snaplen fd_snaplen = {
+		.fd_type = fd_type,
+		.snaplen = snaplen,
+	};
+
+	if(ioctl(engine.m_handle->m_dev_set.m_devs[0].m_fd, PPM_IOCTL_SET_FD_TYPE_SNAPLEN, &fd_snaplen))
+	{
+		return scap_errprintf(engine.m_handle->m_lasterr, errno, "scap_set_fd_type_snaplen failed");
+	}
+	return SCAP_SUCCESS;
+}
+
+int32_t scap_kmod_set_buffer_snaplen(struct scap_engine_handle engine, uint32_t buffer, uint32_t snaplen)
+{
+	struct scap_device_set *devset = &engine.m_handle->m_dev_set;
+
+	if(buffer >= devset->m_ndevs)
+	{
+		return scap_errprintf(engine.m_handle->m_lasterr, 0, "invalid buffer %u", buffer);
+	}
+
+	// the ioctl applies to the ring of the device it is issued on
+	if(ioctl(devset->m_devs[buffer].m_fd, PPM_IOCTL_SET_RING_SNAPLEN, snaplen))
+	{
+		if(errno == ENOTTY)
+		{
+			return SCAP_NOT_SUPPORTED;
+		}
+		return scap_errprintf(engine.m_handle->m_lasterr, errno, "scap_set_buffer_snaplen failed");
+	}
+	return SCAP_SUCCESS;
+}
+
 int32_t scap_kmod_handle_dynamic_snaplen(struct scap_engine_handle engine, bool enable)
 {
 	//
@@ -853,6 +1025,21 @@ static int32_t configure(struct scap_engine_handle engine, enum scap_setting set
 		return scap_kmod_set_fullcapture_port_range(engine, arg1, arg2);
 	case SCAP_STATSD_PORT:
 		return scap_kmod_set_statsd_port(engine, arg1);
+	case SCAP_SUPPRESSED_COMMS:
+		return scap_kmod_set_suppressed_comms(engine, (const struct ppm_suppressed_comms*)arg1);
+	case SCAP_SUPPRESSED_TID:
+		return scap_kmod_set_suppressed_tid(engine, arg1, arg2);
+	case SCAP_FD_TYPE_SNAPLEN:
+		return scap_kmod_set_fd_type_snaplen(engine, arg1, arg2);
+	case SCAP_SYSCALL_LIMIT:
+		// only the modern probe samples and rate limits single syscalls
+		return SCAP_NOT_SUPPORTED;
+	case SCAP_BUFFER_SNAPLEN:
+		return scap_kmod_set_buffer_snaplen(engine, arg1, arg2);
+	case SCAP_CGROUP_FILTER_MODE:
+	case SCAP_CGROUP_FILTER:
+		// only the BPF probes filter by cgroup
+		return SCAP_NOT_SUPPORTED;
 	default:
 	{
 		char msg[256];
@@ -958,6 +1145,7 @@ struct scap_vtable scap_kmod_engine = {
 	.free_handle = free_handle,
 	.close = scap_kmod_close,
 	.next = scap_kmod_next,
+	.peek = scap_kmod_peek,
 	.start_capture = scap_kmod_start_capture,
 	.stop_capture = scap_kmod_stop_capture,
 	.configure = configure,
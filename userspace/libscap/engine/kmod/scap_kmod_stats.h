@@ -38,3 +38,12 @@ typedef enum kmod_kernel_counters_stats {
 	KMOD_N_PREEMPTIONS,
 	KMOD_MAX_KERNEL_COUNTERS_STATS
 }kmod_kernel_counters_stats;
+
+/* Counters of every device, flagged as PPM_SCAP_STATS_BUFFERS */
+typedef enum kmod_buffer_stats {
+	KMOD_BUFFER_N_EVTS = 0,
+	KMOD_BUFFER_N_DROPS_BUFFER,
+	KMOD_BUFFER_N_DROPS_PAGE_FAULTS,
+	KMOD_BUFFER_N_PREEMPTIONS,
+	KMOD_MAX_BUFFER_STATS
+}kmod_buffer_stats;
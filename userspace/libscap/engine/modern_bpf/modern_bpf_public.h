@@ -29,6 +29,11 @@ extern "C"
 		bool allocate_online_only; ///< [EXPERIMENTAL] Allocate ring buffers only for online CPUs. The number of ring buffers allocated changes according to the `cpus_for_each_buffer` param. Please note: this buffer will be mapped twice both kernel and userspace-side, so pay attention to its size.
 		unsigned long buffer_bytes_dim; ///< Dimension of a ring buffer in bytes. The number of ring buffers allocated changes according to the `cpus_for_each_buffer` param. Please note: this buffer will be mapped twice both kernel and userspace-side, so pay attention to its size.
 		bool verbose; ///< [EXPERIMENTAL] Use libbpf in verbose mode.
+		bool numa_aware; ///< [EXPERIMENTAL] Group the CPUs of each NUMA node separately, so that a ring buffer is never shared between nodes, and allocate every ring buffer on the node of its CPUs. The number of ring buffers allocated can grow, since `cpus_for_each_buffer` is applied to each node.
+		uint32_t io_aggregation_period_ms; ///< [EXPERIMENTAL] Sum the bytes and the number of the read and write syscalls by (tgid, fd, direction) in the driver, instead of sending their events, and return the sums as `ioaggregate` events every `io_aggregation_period_ms`. `0` disables the aggregation.
+		uint32_t task_aggregation_period_ms; ///< [EXPERIMENTAL] Count the context switches and the page faults of every thread in the driver, instead of sending their events, and return the counts as `taskaggregate` events every `task_aggregation_period_ms`. `0` disables the aggregation.
+		uint64_t prog_budget_ns; ///< [EXPERIMENTAL] Budget of the median run time of every attached program, checked every second: over budget, `sched_switch` and the page fault programs are sampled and `signal_deliver` is detached. The percentiles and the actions are reported in the libbpf stats. `0` disables the budget.
+		bool string_interning; ///< [EXPERIMENTAL] Send empty `exe`, `comm` and `cgroups` params in the clone/execve exit events when they didn't change since the last event of the thread, libsinsp takes them from the thread state. The events carry the `PPM_CL_STRINGS_INTERNED`/`PPM_EXE_STRINGS_INTERNED` flag.
 	};
 
 #ifdef __cplusplus
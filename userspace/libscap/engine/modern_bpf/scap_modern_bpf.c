@@ -16,6 +16,7 @@ limitations under the License.
 
 #include <errno.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdio.h>
 
 #define SCAP_HANDLE_T struct modern_bpf_engine
@@ -28,6 +29,7 @@ limitations under the License.
 #include "strlcpy.h"
 #include <sys/utsname.h>
 #include "ringbuffer/ringbuffer.h"
+#include "gettimeofday.h"
 
 static struct modern_bpf_engine* scap_modern_bpf__alloc_engine(scap_t* main_handle, char* lasterr_ptr)
 {
@@ -47,21 +49,155 @@ static void scap_modern_bpf__free_engine(struct scap_engine_handle engine)
 /* The third parameter is not the CPU number from which we extract the event but the ring buffer number.
  * For the old BPF probe and the kernel module the number of CPUs is equal to the number of buffers since we always use a per-CPU approach.
  */
+/* Returns the next I/O aggregate as an `ioaggregate` event, draining the
+ * aggregates from the driver once per period. The events are returned
+ * between two batches, so they are never older than the events before them.
+ */
+static bool scap_modern_bpf_next_io_aggregate(struct modern_bpf_engine* handle, OUT scap_evt** pevent, OUT uint16_t* buffer_id)
+{
+	uint64_t now = get_timestamp_ns();
+
+	if(handle->m_io_aggregates_pos == handle->m_io_aggregates_len)
+	{
+		if(now < handle->m_io_aggregation_next_ns)
+		{
+			return false;
+		}
+		handle->m_io_aggregates_len = pman_drain_io_aggregates(handle->m_io_aggregates, MODERN_BPF_IO_AGGREGATES_BATCH);
+		handle->m_io_aggregates_pos = 0;
+		/* With a full batch we drain again right away */
+		if(handle->m_io_aggregates_len < MODERN_BPF_IO_AGGREGATES_BATCH)
+		{
+			handle->m_io_aggregation_next_ns = now + handle->m_io_aggregation_period_ns;
+		}
+		if(handle->m_io_aggregates_len == 0)
+		{
+			return false;
+		}
+	}
+
+	struct pman_io_aggregate* aggregate = &handle->m_io_aggregates[handle->m_io_aggregates_pos++];
+	struct scap_sized_buffer event_buf = {handle->m_io_aggregate_evt, sizeof(handle->m_io_aggregate_evt)};
+	size_t event_size;
+	char error[SCAP_LASTERR_SIZE];
+	if(scap_event_encode_params(event_buf, &event_size, error, PPME_IO_AGGREGATE_E, 4,
+				    (int64_t)aggregate->fd, aggregate->direction, aggregate->count, aggregate->bytes) != SCAP_SUCCESS)
+	{
+		return false;
+	}
+
+	scap_evt* evt = (scap_evt*)handle->m_io_aggregate_evt;
+	evt->ts = now;
+	evt->tid = aggregate->tgid;
+	*pevent = evt;
+	*buffer_id = 0;
+	return true;
+}
+
+/* Same as `scap_modern_bpf_next_io_aggregate`, for the context switches
+ * and page faults counted per tid, returned as `taskaggregate` events.
+ */
+static bool scap_modern_bpf_next_task_aggregate(struct modern_bpf_engine* handle, OUT scap_evt** pevent, OUT uint16_t* buffer_id)
+{
+	uint64_t now = get_timestamp_ns();
+
+	if(handle->m_task_aggregates_pos == handle->m_task_aggregates_len)
+	{
+		if(now < handle->m_task_aggregation_next_ns)
+		{
+			return false;
+		}
+		handle->m_task_aggregates_len = pman_drain_task_aggregates(handle->m_task_aggregates, MODERN_BPF_TASK_AGGREGATES_BATCH);
+		handle->m_task_aggregates_pos = 0;
+		if(handle->m_task_aggregates_len < MODERN_BPF_TASK_AGGREGATES_BATCH)
+		{
+			handle->m_task_aggregation_next_ns = now + handle->m_task_aggregation_period_ns;
+		}
+		if(handle->m_task_aggregates_len == 0)
+		{
+			return false;
+		}
+	}
+
+	struct pman_task_aggregate* aggregate = &handle->m_task_aggregates[handle->m_task_aggregates_pos++];
+	struct scap_sized_buffer event_buf = {handle->m_task_aggregate_evt, sizeof(handle->m_task_aggregate_evt)};
+	size_t event_size;
+	char error[SCAP_LASTERR_SIZE];
+	if(scap_event_encode_params(event_buf, &event_size, error, PPME_TASK_AGGREGATE_E, 2,
+				    aggregate->n_switches, aggregate->n_page_faults) != SCAP_SUCCESS)
+	{
+		return false;
+	}
+
+	scap_evt* evt = (scap_evt*)handle->m_task_aggregate_evt;
+	evt->ts = now;
+	evt->tid = aggregate->tid;
+	*pevent = evt;
+	*buffer_id = 0;
+	return true;
+}
+
 static int32_t scap_modern_bpf__next(struct scap_engine_handle engine, OUT scap_evt** pevent, OUT uint16_t* buffer_id)
 {
-	pman_consume_first_event((void**)pevent, buffer_id);
+	struct modern_bpf_engine* handle = engine.m_handle;
+
+	/* Between two batches, so that the checks don't delay the events of a batch */
+	if(handle->m_batch_pos == handle->m_batch_len && handle->m_prog_budget_next_ns != 0)
+	{
+		uint64_t now = get_timestamp_ns();
+		if(now >= handle->m_prog_budget_next_ns)
+		{
+			pman_check_prog_budgets();
+			handle->m_prog_budget_next_ns = now + MODERN_BPF_PROG_BUDGET_PERIOD_NS;
+		}
+	}
+
+	if(handle->m_batch_pos == handle->m_batch_len &&
+	   handle->m_io_aggregation_period_ns != 0 &&
+	   scap_modern_bpf_next_io_aggregate(handle, pevent, buffer_id))
+	{
+		return SCAP_SUCCESS;
+	}
+
+	if(handle->m_batch_pos == handle->m_batch_len &&
+	   handle->m_task_aggregation_period_ns != 0 &&
+	   scap_modern_bpf_next_task_aggregate(handle, pevent, buffer_id))
+	{
+		return SCAP_SUCCESS;
+	}
+
+	/* The events of a batch stay valid until the next batch is consumed,
+	 * which happens only after all of them are returned.
+	 */
+	if(handle->m_batch_pos == handle->m_batch_len)
+	{
+		handle->m_batch_len = pman_consume_events(handle->m_batch, handle->m_batch_ids, MODERN_BPF_CONSUME_BATCH);
+		handle->m_batch_pos = 0;
+	}
 
-	if((*pevent) == NULL)
+	if(handle->m_batch_pos == handle->m_batch_len)
 	{
+		*pevent = NULL;
+		if(engine.m_handle->m_wakeup)
+		{
+			/* Wait for a ring buffer to cross the wakeup watermark, at most `m_retry_max_us`. */
+			pman_wait_for_events((engine.m_handle->m_retry_max_us + 999) / 1000);
+			return SCAP_TIMEOUT;
+		}
+
 		/* The first time we sleep 500 us, if we have consecutive timeouts we can reach also 30 ms. */
 		usleep(engine.m_handle->m_retry_us);
-		engine.m_handle->m_retry_us = MIN(engine.m_handle->m_retry_us * 2, BUFFER_EMPTY_WAIT_TIME_US_MAX);
+		engine.m_handle->m_retry_us = MIN(engine.m_handle->m_retry_us * 2, engine.m_handle->m_retry_max_us);
 		return SCAP_TIMEOUT;
 	}
 	else
 	{
-		engine.m_handle->m_retry_us = BUFFER_EMPTY_WAIT_TIME_US_START;
+		engine.m_handle->m_retry_us = MIN(BUFFER_EMPTY_WAIT_TIME_US_START, engine.m_handle->m_retry_max_us);
 	}
+
+	*pevent = handle->m_batch[handle->m_batch_pos];
+	*buffer_id = handle->m_batch_ids[handle->m_batch_pos];
+	handle->m_batch_pos++;
 	return SCAP_SUCCESS;
 }
 
@@ -91,6 +227,71 @@ static int32_t scap_modern_bpf_handle_sc(struct scap_engine_handle engine, uint3
 	return SCAP_SUCCESS;
 }
 
+static int32_t scap_modern_bpf_set_suppressed_comms(struct scap_engine_handle engine, const struct ppm_suppressed_comms* comms)
+{
+	const char* names[PPM_MAX_SUPPRESSED_COMMS];
+	uint32_t j;
+
+	for(j = 0; j < comms->n_comms && j < PPM_MAX_SUPPRESSED_COMMS; j++)
+	{
+		names[j] = comms->comms[j];
+	}
+
+	if(pman_set_suppressed_comms(names, j) != 0)
+	{
+		struct modern_bpf_engine* handle = engine.m_handle;
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "unable to set the suppressed comms");
+		return SCAP_FAILURE;
+	}
+	return SCAP_SUCCESS;
+}
+
+static int32_t scap_modern_bpf_set_syscall_limit(struct scap_engine_handle engine, ppm_sc_code ppm_sc, const struct scap_syscall_limit* limit)
+{
+	struct modern_bpf_engine* handle = engine.m_handle;
+	int syscall_id = scap_ppm_sc_to_native_id(ppm_sc);
+	/* if `syscall_id` is -1 this is not a syscall, but it can be one of the limited tracepoints */
+	if(syscall_id == -1)
+	{
+		if(pman_set_tracepoint_limit(ppm_sc, limit->sample_every, limit->max_per_sec) != 0)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "%s is not a syscall of this architecture nor a tracepoint that can be limited", scap_get_ppm_sc_name(ppm_sc));
+			return SCAP_FAILURE;
+		}
+		return SCAP_SUCCESS;
+	}
+
+	if(pman_set_syscall_limit(syscall_id, limit->sample_every, limit->max_per_sec) != 0)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "unable to set the limit of syscall %s", scap_get_ppm_sc_name(ppm_sc));
+		return SCAP_FAILURE;
+	}
+	return SCAP_SUCCESS;
+}
+
+static int32_t scap_modern_bpf_set_buffer_snaplen(struct scap_engine_handle engine, uint32_t buffer, uint32_t snaplen)
+{
+	struct modern_bpf_engine* handle = engine.m_handle;
+	/* Every CPU sharing the ring buffer gets the limit */
+	int err = pman_set_ring_snaplen((int16_t)buffer, snaplen);
+	if(err != 0)
+	{
+		return scap_errprintf(handle->m_lasterr, err, "unable to set the snaplen limit of buffer %u", buffer);
+	}
+	return SCAP_SUCCESS;
+}
+
+static int32_t scap_modern_bpf_set_cgroup_filter(struct scap_engine_handle engine, uint64_t cgroup_id, bool listed)
+{
+	struct modern_bpf_engine* handle = engine.m_handle;
+	int err = pman_set_cgroup_filter(cgroup_id, listed);
+	if(err != 0)
+	{
+		return scap_errprintf(handle->m_lasterr, err, "unable to %s cgroup %" PRIu64 " in the cgroup filter", listed ? "add" : "remove", cgroup_id);
+	}
+	return SCAP_SUCCESS;
+}
+
 static int32_t scap_modern_bpf__configure(struct scap_engine_handle engine, enum scap_setting setting, unsigned long arg1, unsigned long arg2)
 {
 	switch(setting)
@@ -124,6 +325,24 @@ static int32_t scap_modern_bpf__configure(struct scap_engine_handle engine, enum
 	case SCAP_STATSD_PORT:
 		pman_set_statsd_port(arg1);
 		break;
+	case SCAP_SUPPRESSED_COMMS:
+		return scap_modern_bpf_set_suppressed_comms(engine, (const struct ppm_suppressed_comms*)arg1);
+	case SCAP_SUPPRESSED_TID:
+		/* A full map only means that userspace filters the remaining threads */
+		pman_set_suppressed_tid(arg1, arg2);
+		break;
+	case SCAP_FD_TYPE_SNAPLEN:
+		pman_set_fd_type_snaplen(arg1, arg2);
+		break;
+	case SCAP_SYSCALL_LIMIT:
+		return scap_modern_bpf_set_syscall_limit(engine, arg1, (const struct scap_syscall_limit*)arg2);
+	case SCAP_BUFFER_SNAPLEN:
+		return scap_modern_bpf_set_buffer_snaplen(engine, arg1, arg2);
+	case SCAP_CGROUP_FILTER_MODE:
+		pman_set_cgroup_filter_mode(arg1);
+		break;
+	case SCAP_CGROUP_FILTER:
+		return scap_modern_bpf_set_cgroup_filter(engine, arg1, arg2);
 	default:
 	{
 		char msg[SCAP_LASTERR_SIZE];
@@ -178,14 +397,19 @@ int32_t scap_modern_bpf__init(scap_t* handle, scap_open_args* oargs)
 	 * Validation of `cpus_for_each_buffer` is made inside libpman
 	 * since this is the unique place where we have the number of CPUs
 	 */
-	if(pman_init_state(params->verbose, params->buffer_bytes_dim, params->cpus_for_each_buffer, params->allocate_online_only))
+	if(pman_init_state(params->verbose, params->buffer_bytes_dim, params->cpus_for_each_buffer, params->allocate_online_only, params->numa_aware))
 	{
 		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "unable to configure the libpman state.");
 		return SCAP_FAILURE;
 	}
 
+	/* Merge the ring buffers through a heap of their first events. */
+	pman_set_ringbuf_heap_merge(oargs->ringbuffer_merge_mode == SCAP_RINGBUFFER_MERGE_HEAP);
+
 	/* Set an initial sleep time in case of timeouts. */
-	engine.m_handle->m_retry_us = BUFFER_EMPTY_WAIT_TIME_US_START;
+	engine.m_handle->m_retry_max_us = oargs->ringbuffer_empty_wait_max_us != 0 ? oargs->ringbuffer_empty_wait_max_us : BUFFER_EMPTY_WAIT_TIME_US_MAX;
+	engine.m_handle->m_retry_us = MIN(BUFFER_EMPTY_WAIT_TIME_US_START, engine.m_handle->m_retry_max_us);
+	engine.m_handle->m_wakeup = oargs->ringbuffer_wakeup;
 
 	/* Load and attach */
 	ret = pman_open_probe();
@@ -219,6 +443,51 @@ int32_t scap_modern_bpf__init(scap_t* handle, scap_open_args* oargs)
 	}
 	pman_set_boot_time(boot_time);
 
+	/* In wakeup mode the ring buffers notify us when they cross the wakeup watermark,
+	 * which is the empty threshold unless asked otherwise.
+	 */
+	if(engine.m_handle->m_wakeup)
+	{
+		uint32_t watermark = oargs->ringbuffer_wakeup_watermark_b;
+		if(watermark == 0)
+		{
+			watermark = oargs->ringbuffer_empty_threshold_b != 0 ? oargs->ringbuffer_empty_threshold_b : BUFFER_EMPTY_THRESHOLD_B;
+		}
+		pman_set_wakeup_watermark(watermark);
+	}
+
+	/* The driver sums the I/O syscalls, we drain them once per period. */
+	if(params->io_aggregation_period_ms != 0)
+	{
+		engine.m_handle->m_io_aggregation_period_ns = (uint64_t)params->io_aggregation_period_ms * 1000000;
+		engine.m_handle->m_io_aggregation_next_ns = get_timestamp_ns() + engine.m_handle->m_io_aggregation_period_ns;
+		pman_set_io_aggregation(true);
+	}
+
+	/* The driver counts the context switches and page faults, we drain them once per period. */
+	if(params->task_aggregation_period_ms != 0)
+	{
+		engine.m_handle->m_task_aggregation_period_ns = (uint64_t)params->task_aggregation_period_ms * 1000000;
+		engine.m_handle->m_task_aggregation_next_ns = get_timestamp_ns() + engine.m_handle->m_task_aggregation_period_ns;
+		pman_set_task_aggregation(true);
+	}
+
+	if(params->string_interning)
+	{
+		pman_set_string_interning(true);
+	}
+
+	/* The run time of the programs is checked against the budget once per period. */
+	if(params->prog_budget_ns != 0)
+	{
+		int err = pman_set_prog_budget(params->prog_budget_ns);
+		if(err != 0)
+		{
+			return scap_errprintf(handle->m_lasterr, err, "unable to set the run time budget of the bpf programs");
+		}
+		engine.m_handle->m_prog_budget_next_ns = get_timestamp_ns() + MODERN_BPF_PROG_BUDGET_PERIOD_NS;
+	}
+
 	engine.m_handle->m_api_version = pman_get_probe_api_ver();
 	engine.m_handle->m_schema_version = pman_get_probe_schema_ver();
 
@@ -22,15 +22,53 @@ limitations under the License.
 #include "../../../../driver/ppm_events_public.h"
 #include "scap_open.h"
 #include "../libscap/engine/modern_bpf/modern_bpf_public.h"
+#include <libpman.h>
 
 struct scap;
 
+/* Maximum number of events taken from the ring buffers at once. */
+#define MODERN_BPF_CONSUME_BATCH 32
+
+/* Maximum number of I/O aggregates drained at once. */
+#define MODERN_BPF_IO_AGGREGATES_BATCH 256
+
+/* Room for an `ioaggregate` event. */
+#define MODERN_BPF_IO_AGGREGATE_EVT_SIZE 128
+
+/* Maximum number of task aggregates drained at once. */
+#define MODERN_BPF_TASK_AGGREGATES_BATCH 256
+
+/* Room for a `taskaggregate` event. */
+#define MODERN_BPF_TASK_AGGREGATE_EVT_SIZE 64
+
+/* Period of the checks of the run time budget of the programs. */
+#define MODERN_BPF_PROG_BUDGET_PERIOD_NS 1000000000ULL
+
 struct modern_bpf_engine
 {
 	unsigned long m_retry_us; /* Microseconds to wait if all ring buffers are empty */
+	unsigned long m_retry_max_us; /* Maximum microseconds to wait if all ring buffers are empty */
+	bool m_wakeup; /* Wait for the ring buffers notifications instead of sleeping */
 	char* m_lasterr; /* Last error caught by the engine */
 	interesting_ppm_sc_set curr_sc_set; /* current ppm_sc */
 	uint64_t m_api_version;
 	uint64_t m_schema_version;
 	bool capturing;
+	void* m_batch[MODERN_BPF_CONSUME_BATCH]; /* Events consumed from the ring buffers, in timestamp order */
+	int16_t m_batch_ids[MODERN_BPF_CONSUME_BATCH]; /* Ring buffers of the events in `m_batch` */
+	uint32_t m_batch_len; /* Number of events in `m_batch` */
+	uint32_t m_batch_pos; /* Next event of `m_batch` to return */
+	uint64_t m_io_aggregation_period_ns; /* Drain the I/O aggregates every period, `0` if the aggregation is disabled */
+	uint64_t m_io_aggregation_next_ns; /* Time of the next drain of the I/O aggregates */
+	struct pman_io_aggregate m_io_aggregates[MODERN_BPF_IO_AGGREGATES_BATCH]; /* I/O aggregates drained and not returned yet */
+	uint32_t m_io_aggregates_len; /* Number of aggregates in `m_io_aggregates` */
+	uint32_t m_io_aggregates_pos; /* Next aggregate of `m_io_aggregates` to return */
+	uint8_t m_io_aggregate_evt[MODERN_BPF_IO_AGGREGATE_EVT_SIZE]; /* Last `ioaggregate` event returned */
+	uint64_t m_task_aggregation_period_ns; /* Drain the task aggregates every period, `0` if the aggregation is disabled */
+	uint64_t m_task_aggregation_next_ns; /* Time of the next drain of the task aggregates */
+	struct pman_task_aggregate m_task_aggregates[MODERN_BPF_TASK_AGGREGATES_BATCH]; /* Task aggregates drained and not returned yet */
+	uint32_t m_task_aggregates_len; /* Number of aggregates in `m_task_aggregates` */
+	uint32_t m_task_aggregates_pos; /* Next aggregate of `m_task_aggregates` to return */
+	uint8_t m_task_aggregate_evt[MODERN_BPF_TASK_AGGREGATE_EVT_SIZE]; /* Last `taskaggregate` event returned */
+	uint64_t m_prog_budget_next_ns; /* Time of the next check of the run time budget of the programs, `0` if there is no budget */
 };
@@ -15,53 +15,481 @@ limitations under the License.
 
 */
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define SCAP_HANDLE_T struct nodriver_engine
-
 #include "nodriver.h"
+#include "nodriver_public.h"
 #include "noop.h"
 
 #include "scap.h"
+#include "scap-int.h"
+#include "strerror.h"
 #include "strlcpy.h"
 #include "gettimeofday.h"
 #include "sleep.h"
 
+#ifdef __linux__
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#endif
+
+#define NODRIVER_POLL_INTERVAL_MS 100
+
+#ifdef __linux__
+// Room for a few proc connector messages per recv()
+#define PROC_CONNECTOR_RECV_SIZE 4096
+// Messages read per call to next() before returning the first event
+#define PROC_CONNECTOR_MAX_BATCH 64
+#define NODRIVER_EVT_BUF_INITIAL_SIZE (64 * 1024)
+#endif
+
 static struct nodriver_engine* alloc_handle(scap_t* main_handle, char* lasterr_ptr)
 {
 	struct nodriver_engine *engine = calloc(1, sizeof(struct nodriver_engine));
 	if(engine)
 	{
 		engine->m_lasterr = lasterr_ptr;
+		engine->m_main_handle = main_handle;
+		engine->m_proc_connector_fd = -1;
 	}
 	return engine;
 }
 
+#ifdef __linux__
+static int32_t proc_connector_open(struct nodriver_engine* engine)
+{
+	int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+	if(fd < 0)
+	{
+		return scap_errprintf(engine->m_lasterr, errno, "can't create the proc connector socket");
+	}
+
+	struct sockaddr_nl addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = CN_IDX_PROC;
+	// nl_pid is left to 0, so that the kernel assigns a unique one
+	if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+	{
+		int err = errno;
+		close(fd);
+		return scap_errprintf(engine->m_lasterr, err, "can't bind the proc connector socket");
+	}
+
+	struct
+	{
+		struct nlmsghdr hdr;
+		struct cn_msg msg;
+		enum proc_cn_mcast_op op;
+	} __attribute__((packed)) req;
+
+	memset(&req, 0, sizeof(req));
+	req.hdr.nlmsg_len = sizeof(req);
+	req.hdr.nlmsg_type = NLMSG_DONE;
+	req.hdr.nlmsg_pid = 0;
+	req.msg.id.idx = CN_IDX_PROC;
+	req.msg.id.val = CN_VAL_PROC;
+	req.msg.len = sizeof(enum proc_cn_mcast_op);
+	req.op = PROC_CN_MCAST_LISTEN;
+
+	if(send(fd, &req, sizeof(req), 0) < 0)
+	{
+		int err = errno;
+		close(fd);
+		return scap_errprintf(engine->m_lasterr, err, "can't subscribe to the proc connector");
+	}
+
+	engine->m_evt_buf = malloc(NODRIVER_EVT_BUF_INITIAL_SIZE);
+	if(engine->m_evt_buf == NULL)
+	{
+		close(fd);
+		return scap_errprintf(engine->m_lasterr, 0, "can't allocate the event buffer");
+	}
+	engine->m_evt_buf_size = NODRIVER_EVT_BUF_INITIAL_SIZE;
+	engine->m_evt_buf_len = 0;
+	engine->m_evt_buf_pos = 0;
+
+	engine->m_proc_connector_fd = fd;
+	return SCAP_SUCCESS;
+}
+
+//
+// Append an event to the pending ones, growing the buffer if needed
+//
+static int32_t push_event(struct nodriver_engine* engine, uint64_t ts, int64_t tid, ppm_event_code type, uint32_t n, ...)
+{
+	char error[SCAP_LASTERR_SIZE];
+	size_t event_size = 0;
+	va_list args;
+	int32_t res;
+
+	while(true)
+	{
+		struct scap_sized_buffer buf = {
+			engine->m_evt_buf + engine->m_evt_buf_len,
+			engine->m_evt_buf_size - engine->m_evt_buf_len};
+
+		va_start(args, n);
+		res = scap_event_encode_params_v(buf, &event_size, error, type, n, args);
+		va_end(args);
+
+		if(res != SCAP_INPUT_TOO_SMALL)
+		{
+			break;
+		}
+
+		size_t new_size = engine->m_evt_buf_size * 2;
+		while(new_size < engine->m_evt_buf_len + event_size)
+		{
+			new_size *= 2;
+		}
+		uint8_t* new_buf = realloc(engine->m_evt_buf, new_size);
+		if(new_buf == NULL)
+		{
+			return scap_errprintf(engine->m_lasterr, 0, "can't grow the event buffer to %zu bytes", new_size);
+		}
+		engine->m_evt_buf = new_buf;
+		engine->m_evt_buf_size = new_size;
+	}
+
+	if(res != SCAP_SUCCESS)
+	{
+		return scap_errprintf(engine->m_lasterr, 0, "can't encode the event: %s", error);
+	}
+
+	scap_evt* evt = (scap_evt*)(engine->m_evt_buf + engine->m_evt_buf_len);
+	evt->ts = ts;
+	evt->tid = tid;
+	engine->m_evt_buf_len += event_size;
+	return SCAP_SUCCESS;
+}
+
+//
+// The child of a fork, as the child side of a clone. Its info is read from
+// /proc, since the message only has the pids.
+//
+static int32_t on_proc_fork(struct nodriver_engine* engine, uint64_t ts, const struct proc_event* ev)
+{
+	int64_t tid = ev->event_data.fork.child_pid;
+	if(tid != ev->event_data.fork.child_tgid && !engine->m_track_threads)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	// NULL if the child is already gone, or is a kernel thread
+	struct scap_threadinfo* tinfo = scap_proc_get(engine->m_main_handle, tid, false);
+	if(tinfo == NULL)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	int32_t res = push_event(engine, ts, tid, PPME_SYSCALL_CLONE_20_X, 21,
+		(int64_t)0, // res (0 in the child)
+		tinfo->exe,
+		(struct scap_const_sized_buffer){tinfo->args, tinfo->args_len},
+		(int64_t)tinfo->tid,
+		(int64_t)tinfo->pid,
+		(int64_t)ev->event_data.fork.parent_pid, // ptid
+		tinfo->cwd,
+		tinfo->fdlimit,
+		tinfo->pfmajor,
+		tinfo->pfminor,
+		tinfo->vmsize_kb,
+		tinfo->vmrss_kb,
+		tinfo->vmswap_kb,
+		tinfo->comm,
+		(struct scap_const_sized_buffer){tinfo->cgroups, tinfo->cgroups_len},
+		tinfo->flags,
+		tinfo->uid,
+		tinfo->gid,
+		tinfo->vtid,
+		tinfo->vpid,
+		tinfo->pidns_init_start_ts);
+
+	scap_proc_free(engine->m_main_handle, tinfo);
+	return res;
+}
+
+//
+// An execve, with the enter event too, since the parser takes the full
+// path of the executable from it
+//
+static int32_t on_proc_exec(struct nodriver_engine* engine, uint64_t ts, const struct proc_event* ev)
+{
+	int64_t tid = ev->event_data.exec.process_pid;
+
+	struct scap_threadinfo* tinfo = scap_proc_get(engine->m_main_handle, tid, false);
+	if(tinfo == NULL)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	uint32_t flags = 0;
+	if(tinfo->exe_writable)
+	{
+		flags |= PPM_EXE_WRITABLE;
+	}
+	if(tinfo->exe_upper_layer)
+	{
+		flags |= PPM_EXE_UPPER_LAYER;
+	}
+
+	int32_t res = push_event(engine, ts, tid, PPME_SYSCALL_EXECVE_19_E, 1, tinfo->exepath);
+	if(res == SCAP_SUCCESS)
+	{
+		res = push_event(engine, ts, tid, PPME_SYSCALL_EXECVE_19_X, 27,
+			(int64_t)0, // res
+			tinfo->exe,
+			(struct scap_const_sized_buffer){tinfo->args, tinfo->args_len},
+			(int64_t)tinfo->tid,
+			(int64_t)tinfo->pid,
+			(int64_t)tinfo->ptid,
+			tinfo->cwd,
+			(uint64_t)tinfo->fdlimit,
+			tinfo->pfmajor,
+			tinfo->pfminor,
+			tinfo->vmsize_kb,
+			tinfo->vmrss_kb,
+			tinfo->vmswap_kb,
+			tinfo->comm,
+			(struct scap_const_sized_buffer){tinfo->cgroups, tinfo->cgroups_len},
+			(struct scap_const_sized_buffer){tinfo->env, tinfo->env_len},
+			tinfo->tty,
+			(int64_t)tinfo->vpgid,
+			tinfo->loginuid,
+			flags,
+			tinfo->cap_inheritable,
+			tinfo->cap_permitted,
+			tinfo->cap_effective,
+			tinfo->exe_ino,
+			tinfo->exe_ino_ctime,
+			tinfo->exe_ino_mtime,
+			tinfo->uid);
+	}
+
+	scap_proc_free(engine->m_main_handle, tinfo);
+	return res;
+}
+
+static int32_t on_proc_exit(struct nodriver_engine* engine, uint64_t ts, const struct proc_event* ev)
+{
+	int64_t tid = ev->event_data.exit.process_pid;
+	if(tid != ev->event_data.exit.process_tgid && !engine->m_track_threads)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	// Decoded the same way as the drivers do
+	uint32_t status = ev->event_data.exit.exit_code;
+	return push_event(engine, ts, tid, PPME_PROCEXIT_1_E, 4,
+		(int64_t)status,
+		(int64_t)WEXITSTATUS(status),
+		WIFSIGNALED(status) ? WTERMSIG(status) : 0,
+		WCOREDUMP(status) != 0);
+}
+
+static int32_t proc_connector_parse(struct nodriver_engine* engine, const char* buf, ssize_t len)
+{
+	uint64_t ts = get_timestamp_ns();
+	const struct nlmsghdr* hdr;
+	int32_t res = SCAP_SUCCESS;
+
+	for(hdr = (const struct nlmsghdr*)buf; NLMSG_OK(hdr, len) && res == SCAP_SUCCESS; hdr = NLMSG_NEXT(hdr, len))
+	{
+		if(hdr->nlmsg_type == NLMSG_ERROR || hdr->nlmsg_type == NLMSG_NOOP)
+		{
+			continue;
+		}
+
+		const struct cn_msg* msg = NLMSG_DATA(hdr);
+		if(msg->id.idx != CN_IDX_PROC || msg->id.val != CN_VAL_PROC ||
+		   msg->len < sizeof(struct proc_event))
+		{
+			continue;
+		}
+
+		const struct proc_event* ev = (const struct proc_event*)msg->data;
+		switch(ev->what)
+		{
+		case PROC_EVENT_FORK:
+			res = on_proc_fork(engine, ts, ev);
+			break;
+		case PROC_EVENT_EXEC:
+			res = on_proc_exec(engine, ts, ev);
+			break;
+		case PROC_EVENT_EXIT:
+			res = on_proc_exit(engine, ts, ev);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return res;
+}
+
+//
+// Return the next event built from the proc connector messages, waiting
+// for them at most NODRIVER_POLL_INTERVAL_MS, or SCAP_TIMEOUT
+//
+static int32_t proc_connector_next(struct nodriver_engine* engine, scap_evt** pevent)
+{
+	if(engine->m_evt_buf_pos >= engine->m_evt_buf_len)
+	{
+		engine->m_evt_buf_pos = 0;
+		engine->m_evt_buf_len = 0;
+
+		struct pollfd pfd = {engine->m_proc_connector_fd, POLLIN, 0};
+		int ret = poll(&pfd, 1, NODRIVER_POLL_INTERVAL_MS);
+		if(ret < 0 && errno != EINTR)
+		{
+			return scap_errprintf(engine->m_lasterr, errno, "can't poll the proc connector socket");
+		}
+		if(ret <= 0)
+		{
+			return SCAP_TIMEOUT;
+		}
+
+		char buf[PROC_CONNECTOR_RECV_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+		for(uint32_t j = 0; j < PROC_CONNECTOR_MAX_BATCH; j++)
+		{
+			struct sockaddr_nl from;
+			socklen_t from_len = sizeof(from);
+			ssize_t len = recvfrom(engine->m_proc_connector_fd, buf, sizeof(buf), 0,
+					       (struct sockaddr*)&from, &from_len);
+			if(len < 0)
+			{
+				if(errno == EAGAIN || errno == EWOULDBLOCK)
+				{
+					break;
+				}
+				else if(errno == EINTR)
+				{
+					continue;
+				}
+				else if(errno == ENOBUFS)
+				{
+					// The socket overran and some messages were lost:
+					// pick up the new processes with a rescan
+					scap_refresh_proc_table(engine->m_main_handle);
+					continue;
+				}
+				return scap_errprintf(engine->m_lasterr, errno, "can't read from the proc connector socket");
+			}
+
+			// Only the kernel is trusted
+			if(from.nl_pid != 0)
+			{
+				continue;
+			}
+
+			int32_t res = proc_connector_parse(engine, buf, len);
+			if(res != SCAP_SUCCESS)
+			{
+				return res;
+			}
+		}
+
+		if(engine->m_evt_buf_len == 0)
+		{
+			return SCAP_TIMEOUT;
+		}
+	}
+
+	scap_evt* evt = (scap_evt*)(engine->m_evt_buf + engine->m_evt_buf_pos);
+	engine->m_evt_buf_pos += evt->len;
+	*pevent = evt;
+	return SCAP_SUCCESS;
+}
+#endif // __linux__
+
+static int32_t init(scap_t* main_handle, scap_open_args* oargs)
+{
+	struct nodriver_engine* engine = main_handle->m_engine.m_handle;
+	struct scap_nodriver_engine_params* params = oargs->engine_params;
+
+	if(params == NULL || !params->proc_connector)
+	{
+		return SCAP_SUCCESS;
+	}
+
+#ifdef __linux__
+	engine->m_track_threads = params->full_proc_scan;
+	return proc_connector_open(engine);
+#else
+	return scap_errprintf(engine->m_lasterr, 0, "the proc connector is only available on Linux");
+#endif
+}
+
 static int32_t next(struct scap_engine_handle handle, scap_evt** pevent, uint16_t* pcpuid)
 {
+	struct nodriver_engine* engine = handle.m_handle;
 	static scap_evt evt;
+
+#ifdef __linux__
+	if(engine->m_proc_connector_fd >= 0)
+	{
+		int32_t res = proc_connector_next(engine, pevent);
+		if(res != SCAP_TIMEOUT)
+		{
+			return res;
+		}
+	}
+	else
+#endif
+	{
+		sleep_ms(NODRIVER_POLL_INTERVAL_MS);
+	}
+
 	evt.len = 0;
 	evt.tid = -1;
 	evt.type = PPME_SCAPEVENT_X;
 	evt.nparams = 0;
 
-	sleep_ms(100);
-
 	evt.ts = get_timestamp_ns();
 	*pevent = &evt;
 	return SCAP_SUCCESS;
 }
 
+static int close_engine(struct scap_engine_handle handle)
+{
+#ifdef __linux__
+	struct nodriver_engine* engine = handle.m_handle;
+	if(engine->m_proc_connector_fd >= 0)
+	{
+		close(engine->m_proc_connector_fd);
+		engine->m_proc_connector_fd = -1;
+	}
+#endif
+	return SCAP_SUCCESS;
+}
+
+static void free_handle(struct scap_engine_handle handle)
+{
+	struct nodriver_engine* engine = handle.m_handle;
+	free(engine->m_evt_buf);
+	free(engine);
+}
+
 const struct scap_vtable scap_nodriver_engine = {
 	.name = NODRIVER_ENGINE,
 	.mode = SCAP_MODE_NODRIVER,
 	.savefile_ops = NULL,
 
 	.alloc_handle = alloc_handle,
-	.init = NULL,
-	.free_handle = noop_free_handle,
-	.close = noop_close_engine,
+	.init = init,
+	.free_handle = free_handle,
+	.close = close_engine,
 	.next = next,
 	.start_capture = noop_start_capture,
 	.stop_capture = noop_stop_capture,
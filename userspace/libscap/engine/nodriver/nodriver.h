@@ -16,6 +16,8 @@ limitations under the License.
 */
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 struct scap;
@@ -23,4 +25,17 @@ struct scap;
 struct nodriver_engine
 {
 	char* m_lasterr;
+	struct scap* m_main_handle;
+
+	// The netlink proc connector socket, -1 if not in use
+	int m_proc_connector_fd;
+	// Also report the threads, not only the processes
+	bool m_track_threads;
+
+	// The events built from the last proc connector messages, returned
+	// one after the other by next()
+	uint8_t* m_evt_buf;
+	size_t m_evt_buf_size;
+	size_t m_evt_buf_len;
+	size_t m_evt_buf_pos;
 };
\ No newline at end of file
@@ -23,6 +23,7 @@ extern "C"
 	struct scap_nodriver_engine_params
 	{
 		bool full_proc_scan; //< run a full /proc scan instead of the normal reduced one (no threads, no sockets)
+		bool proc_connector; //< track the processes through the netlink proc connector, emitting clone, execve and procexit events (Linux only, needs CAP_NET_ADMIN)
 	};
 
 #ifdef __cplusplus
@@ -22,6 +22,7 @@ limitations under the License.
 #include "scap_limits.h"
 #include "scap_reader.h"
 #include "scap_savefile.h"
+#include "../../../../driver/ppm_events_public.h"
 
 #define READER_BUF_SIZE (1 << 16) // UINT16_MAX + 1, ie: 65536
 
@@ -106,8 +107,31 @@ struct savefile_engine
 	scap_reader_t* m_reader;
 	block_header m_last_block_header;
 	bool m_use_last_block_header;
+	// next() read the section header block of an appended capture
+	bool m_section_header_read;
 	char* m_reader_evt_buf;
 	size_t m_reader_evt_buf_size;
 	uint32_t m_last_evt_dump_flags;
+	// Event and checkpoint indexes of the capture, loaded on the first seek
+	// to a timestamp
+	bool m_index_loaded;
+	evt_index_entry* m_index;
+	uint64_t m_index_len;
+	evt_index_entry* m_ckpts;
+	uint64_t m_ckpts_len;
+	// Events skipped by next() without being read, see set_read_filter
+	bool m_read_filter;
+	uint8_t m_read_evt_types[PPM_EVENT_MAX];
+	uint64_t m_read_ts_min;
+	uint64_t m_read_ts_max;
+	// String dictionary of the capture, see STRDICT_BLOCK_TYPE, and the
+	// buffer the events referencing it are expanded into
+	uint32_t m_strdict_len;
+	uint32_t* m_strdict_offsets;
+	uint16_t* m_strdict_lens;
+	char* m_strdict_data;
+	uint32_t m_strdict_data_len;
+	uint32_t m_strdict_data_size;
+	char* m_strdict_evt_buf;
 };
 
@@ -28,6 +28,7 @@ extern "C"
 		const char* fname;     ///< The name of the file to open.
 		uint64_t start_offset; ///< Used to start reading a capture file from an arbitrary offset. This is leveraged when opening merged files.
 		uint32_t fbuffer_size; ///< If non-zero, offline captures will read from file using a buffer of this size.
+		uint32_t decompression_threads; ///< Threads inflating block compressed captures, 0 for a default based on the CPUs.
 	};
 
 #ifdef __cplusplus
@@ -47,6 +47,14 @@ typedef struct scap_reader
      */
     int (*read)(struct scap_reader *r, void* buf, uint32_t len);
 
+    /**
+     * @brief Optional, NULL if not supported. Returns a pointer to the
+     * next len bytes and moves past them, without copying them. The
+     * data is read-only, and the pointer stays valid until the next call
+     * to the reader. Returns NULL if less than len bytes are left.
+     */
+    void* (*map)(struct scap_reader *r, uint32_t len);
+
     /**
      * @brief Returns the current offset in the data being read.
      * On error, returns a negative value and error() can be used to
@@ -98,6 +106,43 @@ scap_reader_t *scap_reader_open_gzfile(gzFile file);
  */
 scap_reader_t *scap_reader_open_buffered(scap_reader_t* reader, uint32_t bufsize, bool own_reader);
 
+#ifndef _WIN32
+/**
+ * @brief Opens a reader that maps in memory, read-only, the uncompressed
+ * file referred by fd, starting from its current position. Returns NULL
+ * if the file can't be mapped or is compressed. On success, the reader
+ * owns the fd. Only a window of the file is mapped at once, and it
+ * follows the reading position. The data appended to the file while it's
+ * read (e.g. a capture still being written) becomes readable as it comes:
+ * a read at the end of the file returns 0 until there is more data.
+ */
+scap_reader_t *scap_reader_open_mmap(int fd);
+
+/**
+ * @brief Same as scap_reader_open_mmap(), mapping window bytes at once
+ * instead of the default 64MB (0 for the default). Mostly useful for testing.
+ */
+scap_reader_t *scap_reader_open_mmap_window(int fd, uint32_t window);
+
+/**
+ * @brief Opens a reader for the block compressed file referred by fd (see
+ * GZBLOCK_DATA_SIZE), starting from its current position. The blocks are
+ * inflated ahead of the reads by nthreads threads, or by a default number
+ * of threads if 0. Returns NULL if the file isn't block compressed. On
+ * success, the reader owns the fd.
+ */
+scap_reader_t *scap_reader_open_gzblocks(int fd, uint32_t nthreads);
+
+/**
+ * @brief Open readers for the zstd or lz4 compressed file referred by fd,
+ * starting from its current position. Return NULL if the file isn't in
+ * that format, or if libscap is built without support for it. Seeking
+ * backwards decompresses the file again from the start. On success, the
+ * reader owns the fd.
+ */
+scap_reader_t *scap_reader_open_zstd(int fd);
+scap_reader_t *scap_reader_open_lz4(int fd);
+#endif
 
 #ifdef __cplusplus
 }
@@ -92,6 +92,8 @@ static int64_t buffered_seek(scap_reader_t *r, int64_t offset, int whence)
             h->m_buffer_off += (uint32_t) offset;
             return r->tell(r);
         }
+        // The wrapped reader is past the buffered data
+        offset -= h->m_buffer_len - h->m_buffer_off;
     }
     h->m_buffer_off = 0;
     h->m_buffer_len = 0;
@@ -137,6 +139,7 @@ scap_reader_t *scap_reader_open_buffered(scap_reader_t* reader, uint32_t bufsize
     scap_reader_t* r = (scap_reader_t *) malloc (sizeof (scap_reader_t));
     r->handle = h;
     r->read = &buffered_read;
+    r->map = NULL;
     r->offset = &buffered_offset;
     r->tell = &buffered_tell;
     r->seek = &buffered_seek;
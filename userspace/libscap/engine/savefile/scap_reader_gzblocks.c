@@ -0,0 +1,573 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "scap_reader.h"
+#include "scap_savefile.h"
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(USE_ZLIB) && !defined(UDIG)
+
+// Decompressed blocks that can be ready ahead of the reader, per thread
+#define GZBLOCKS_SLOTS_PER_THREAD 2
+// Max number of threads used when the caller doesn't choose
+#define GZBLOCKS_DEFAULT_MAX_THREADS 4
+
+typedef enum slot_state
+{
+    SLOT_FREE = 0, ///< Not assigned to any block
+    SLOT_BUSY = 1, ///< A worker is inflating its block
+    SLOT_READY = 2, ///< The block is inflated, or failed
+} slot_state;
+
+typedef struct slot
+{
+    slot_state m_state;
+    uint64_t m_seq; ///< Sequence number of the block
+    uint32_t m_block_len; ///< Compressed size of the block
+    uint8_t* m_data; ///< Inflated data
+    uint32_t m_len; ///< Number of bytes of inflated data
+    uint32_t m_cap; ///< Capacity of m_data
+    bool m_eof; ///< There's no block with this sequence number
+    int m_err; ///< errno of the failure, EINVAL for corrupted blocks
+} slot_t;
+
+typedef struct worker
+{
+    pthread_t m_thread;
+    struct reader_handle* m_handle;
+    uint8_t* m_in; ///< Compressed block
+    uint32_t m_in_cap;
+    uint8_t* m_out; ///< Inflated block, swapped with the slot's when done
+    uint32_t m_out_cap;
+    z_stream m_zs;
+} worker_t;
+
+typedef struct reader_handle
+{
+    int m_fd; ///< The file to read, owned by the reader
+    int64_t m_start; ///< File offset of the first block
+
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_work_cond; ///< Signaled when a slot gets free
+    pthread_cond_t m_ready_cond; ///< Signaled when a slot gets ready
+    worker_t* m_workers;
+    uint32_t m_nworkers;
+    slot_t* m_slots;
+    uint32_t m_nslots;
+    bool m_stop;
+
+    // Protected by m_lock
+    uint64_t m_gen; ///< Bumped when the reader seeks back, to drop the blocks in flight
+    uint64_t m_next_seq; ///< Next block to assign to a worker
+    int64_t m_next_off; ///< File offset of that block, -1 past the end
+
+    // Only used by the reading thread
+    uint64_t m_cur_seq; ///< Block being read
+    uint32_t m_cur_pos; ///< Position in that block
+    uint64_t m_tell; ///< Position in the uncompressed data
+    int64_t m_offset; ///< File offset of the block being read
+    int m_errno; ///< The error of the last failed operation, or 0
+} reader_handle_t;
+
+static inline uint32_t get_le32(const uint8_t* p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+//
+// Parses a block header, returns the size of the block or 0 if it's not valid
+//
+static uint32_t parse_block_header(const uint8_t* h)
+{
+    if (h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || h[3] != 4 ||
+        h[10] != 8 || h[11] != 0 || h[12] != GZBLOCK_SI1 || h[13] != GZBLOCK_SI2 ||
+        h[14] != 4 || h[15] != 0)
+    {
+        return 0;
+    }
+
+    uint32_t len = get_le32(h + 16);
+    if (len < GZBLOCK_HEADER_LEN + GZBLOCK_TRAILER_LEN)
+    {
+        return 0;
+    }
+    return len;
+}
+
+static bool pread_all(int fd, void* buf, size_t len, int64_t off, int* err)
+{
+    uint8_t* p = (uint8_t*) buf;
+    while (len > 0)
+    {
+        ssize_t n = pread(fd, p, len, off);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            *err = n < 0 ? errno : EINVAL;
+            return false;
+        }
+        p += n;
+        off += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool ensure_cap(uint8_t** buf, uint32_t* cap, uint32_t len)
+{
+    if (*cap >= len)
+    {
+        return true;
+    }
+    uint8_t* tmp = (uint8_t*) realloc(*buf, len);
+    if (tmp == NULL)
+    {
+        return false;
+    }
+    *buf = tmp;
+    *cap = len;
+    return true;
+}
+
+//
+// Reads and inflates a block into the worker's output buffer.
+// Returns the inflated length, or -1 setting err.
+//
+static int64_t inflate_block(worker_t* w, int64_t off, uint32_t block_len, int* err)
+{
+    reader_handle_t* h = w->m_handle;
+    if (!ensure_cap(&w->m_in, &w->m_in_cap, block_len))
+    {
+        *err = ENOMEM;
+        return -1;
+    }
+    if (!pread_all(h->m_fd, w->m_in, block_len, off, err))
+    {
+        return -1;
+    }
+
+    uint8_t* trailer = w->m_in + block_len - GZBLOCK_TRAILER_LEN;
+    uint32_t crc = get_le32(trailer);
+    uint32_t len = get_le32(trailer + 4);
+    if (len > GZBLOCK_MAX_DATA_SIZE)
+    {
+        *err = EINVAL;
+        return -1;
+    }
+    // Room for one more byte, to detect blocks longer than declared
+    if (!ensure_cap(&w->m_out, &w->m_out_cap, len + 1))
+    {
+        *err = ENOMEM;
+        return -1;
+    }
+
+    inflateReset(&w->m_zs);
+    w->m_zs.next_in = w->m_in + GZBLOCK_HEADER_LEN;
+    w->m_zs.avail_in = block_len - GZBLOCK_HEADER_LEN - GZBLOCK_TRAILER_LEN;
+    w->m_zs.next_out = w->m_out;
+    w->m_zs.avail_out = len + 1;
+    if (inflate(&w->m_zs, Z_FINISH) != Z_STREAM_END ||
+        w->m_zs.total_out != len ||
+        crc32(crc32(0L, Z_NULL, 0), w->m_out, len) != crc)
+    {
+        *err = EINVAL;
+        return -1;
+    }
+    return len;
+}
+
+static void* worker_run(void* arg)
+{
+    worker_t* w = (worker_t*) arg;
+    reader_handle_t* h = w->m_handle;
+    uint8_t header[GZBLOCK_HEADER_LEN];
+
+    pthread_mutex_lock(&h->m_lock);
+    while (!h->m_stop)
+    {
+        slot_t* s = &h->m_slots[h->m_next_seq % h->m_nslots];
+        if (h->m_next_off < 0 || h->m_next_seq >= h->m_cur_seq + h->m_nslots || s->m_state != SLOT_FREE)
+        {
+            pthread_cond_wait(&h->m_work_cond, &h->m_lock);
+            continue;
+        }
+
+        //
+        // Find the block boundaries, then inflate it without the lock
+        //
+        uint64_t gen = h->m_gen;
+        int64_t off = h->m_next_off;
+        int err = 0;
+        ssize_t n;
+        do
+        {
+            n = pread(h->m_fd, header, sizeof(header), off);
+        } while (n < 0 && errno == EINTR);
+
+        s->m_seq = h->m_next_seq++;
+        s->m_eof = false;
+        s->m_err = 0;
+        s->m_len = 0;
+        s->m_block_len = 0;
+        if (n == 0)
+        {
+            s->m_eof = true;
+            s->m_state = SLOT_READY;
+            h->m_next_off = -1;
+            pthread_cond_broadcast(&h->m_ready_cond);
+            continue;
+        }
+
+        uint32_t block_len = n == sizeof(header) ? parse_block_header(header) : 0;
+        if (block_len == 0)
+        {
+            s->m_err = n < 0 ? errno : EINVAL;
+            s->m_state = SLOT_READY;
+            h->m_next_off = -1;
+            pthread_cond_broadcast(&h->m_ready_cond);
+            continue;
+        }
+
+        s->m_state = SLOT_BUSY;
+        s->m_block_len = block_len;
+        h->m_next_off = off + block_len;
+        pthread_cond_broadcast(&h->m_work_cond);
+        pthread_mutex_unlock(&h->m_lock);
+
+        int64_t len = inflate_block(w, off, block_len, &err);
+
+        pthread_mutex_lock(&h->m_lock);
+        if (gen != h->m_gen)
+        {
+            // The reader moved elsewhere, the slot isn't ours anymore
+            continue;
+        }
+
+        if (len < 0)
+        {
+            s->m_err = err;
+        }
+        else
+        {
+            uint8_t* tmp = s->m_data;
+            uint32_t cap = s->m_cap;
+            s->m_data = w->m_out;
+            s->m_cap = w->m_out_cap;
+            s->m_len = (uint32_t) len;
+            w->m_out = tmp;
+            w->m_out_cap = cap;
+        }
+        s->m_state = SLOT_READY;
+        pthread_cond_broadcast(&h->m_ready_cond);
+    }
+    pthread_mutex_unlock(&h->m_lock);
+    return NULL;
+}
+
+//
+// Returns the block being read, waiting for it if needed
+//
+static slot_t* current_slot(reader_handle_t* h)
+{
+    slot_t* s = &h->m_slots[h->m_cur_seq % h->m_nslots];
+    pthread_mutex_lock(&h->m_lock);
+    while (s->m_state != SLOT_READY || s->m_seq != h->m_cur_seq)
+    {
+        pthread_cond_wait(&h->m_ready_cond, &h->m_lock);
+    }
+    pthread_mutex_unlock(&h->m_lock);
+    return s;
+}
+
+//
+// Moves past len bytes, copying them to buf if not NULL
+//
+static int64_t consume(reader_handle_t* h, uint8_t* buf, uint64_t len)
+{
+    uint64_t done = 0;
+    while (done < len)
+    {
+        slot_t* s = current_slot(h);
+        if (s->m_err != 0)
+        {
+            h->m_errno = s->m_err;
+            break;
+        }
+        if (s->m_eof)
+        {
+            break;
+        }
+
+        uint64_t n = s->m_len - h->m_cur_pos;
+        if (n > len - done)
+        {
+            n = len - done;
+        }
+        if (buf != NULL)
+        {
+            memcpy(buf + done, s->m_data + h->m_cur_pos, n);
+        }
+        h->m_cur_pos += n;
+        h->m_tell += n;
+        done += n;
+
+        if (h->m_cur_pos == s->m_len)
+        {
+            pthread_mutex_lock(&h->m_lock);
+            h->m_offset += s->m_block_len;
+            s->m_state = SLOT_FREE;
+            h->m_cur_seq++;
+            h->m_cur_pos = 0;
+            pthread_cond_broadcast(&h->m_work_cond);
+            pthread_mutex_unlock(&h->m_lock);
+        }
+    }
+    return (int64_t) done;
+}
+
+static int gzblocks_read(scap_reader_t *r, void* buf, uint32_t len)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    int64_t n = consume(h, (uint8_t*) buf, len);
+    return n == 0 && h->m_errno != 0 ? -1 : (int) n;
+}
+
+static int64_t gzblocks_offset(scap_reader_t *r)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    return h->m_offset;
+}
+
+static int64_t gzblocks_tell(scap_reader_t *r)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    return (int64_t) h->m_tell;
+}
+
+static int64_t gzblocks_seek(scap_reader_t *r, int64_t offset, int whence)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    int64_t target;
+    switch (whence)
+    {
+    case SEEK_SET:
+        target = offset;
+        break;
+    case SEEK_CUR:
+        target = (int64_t) h->m_tell + offset;
+        break;
+    default:
+        h->m_errno = EINVAL;
+        return -1;
+    }
+
+    if (target < 0)
+    {
+        h->m_errno = EINVAL;
+        return -1;
+    }
+
+    //
+    // Going back means starting over from the first block,
+    // the blocks in flight are dropped
+    //
+    if ((uint64_t) target < h->m_tell)
+    {
+        pthread_mutex_lock(&h->m_lock);
+        h->m_gen++;
+        for (uint32_t i = 0; i < h->m_nslots; i++)
+        {
+            h->m_slots[i].m_state = SLOT_FREE;
+        }
+        h->m_next_seq = h->m_cur_seq;
+        h->m_next_off = h->m_start;
+        h->m_cur_pos = 0;
+        h->m_tell = 0;
+        h->m_offset = h->m_start;
+        pthread_cond_broadcast(&h->m_work_cond);
+        pthread_mutex_unlock(&h->m_lock);
+    }
+
+    h->m_errno = 0;
+    consume(h, NULL, (uint64_t) target - h->m_tell);
+    if ((uint64_t) target != h->m_tell)
+    {
+        if (h->m_errno == 0)
+        {
+            h->m_errno = EINVAL;
+        }
+        return -1;
+    }
+    return target;
+}
+
+static const char* gzblocks_error(scap_reader_t *r, int *errnum)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    *errnum = h->m_errno;
+    if (h->m_errno == EINVAL)
+    {
+        return "corrupted compressed block";
+    }
+    return h->m_errno ? strerror(h->m_errno) : "";
+}
+
+static void free_handle(reader_handle_t* h, uint32_t nstarted)
+{
+    pthread_mutex_lock(&h->m_lock);
+    h->m_stop = true;
+    pthread_cond_broadcast(&h->m_work_cond);
+    pthread_mutex_unlock(&h->m_lock);
+
+    for (uint32_t i = 0; i < nstarted; i++)
+    {
+        pthread_join(h->m_workers[i].m_thread, NULL);
+    }
+    for (uint32_t i = 0; i < h->m_nworkers; i++)
+    {
+        inflateEnd(&h->m_workers[i].m_zs);
+        free(h->m_workers[i].m_in);
+        free(h->m_workers[i].m_out);
+    }
+    for (uint32_t i = 0; i < h->m_nslots; i++)
+    {
+        free(h->m_slots[i].m_data);
+    }
+
+    pthread_cond_destroy(&h->m_ready_cond);
+    pthread_cond_destroy(&h->m_work_cond);
+    pthread_mutex_destroy(&h->m_lock);
+    free(h->m_workers);
+    free(h->m_slots);
+    free(h);
+}
+
+static int gzblocks_close(scap_reader_t *r)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    int fd = h->m_fd;
+    // Stop the workers first, they might still be reading from the fd
+    free_handle(h, h->m_nworkers);
+    int res = close(fd);
+    free(r);
+    return res;
+}
+
+scap_reader_t *scap_reader_open_gzblocks(int fd, uint32_t nthreads)
+{
+    struct stat st;
+    uint8_t header[GZBLOCK_HEADER_LEN];
+    int err;
+
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return NULL;
+    }
+
+    // Start from the current position, like gzdopen does
+    off_t start = lseek(fd, 0, SEEK_CUR);
+    if (start < 0 || !pread_all(fd, header, sizeof(header), start, &err) || parse_block_header(header) == 0)
+    {
+        return NULL;
+    }
+
+    if (nthreads == 0)
+    {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = ncpus > 1 ? (uint32_t) ncpus - 1 : 1;
+        if (nthreads > GZBLOCKS_DEFAULT_MAX_THREADS)
+        {
+            nthreads = GZBLOCKS_DEFAULT_MAX_THREADS;
+        }
+    }
+
+    reader_handle_t* h = (reader_handle_t*) calloc(1, sizeof(reader_handle_t));
+    scap_reader_t* r = (scap_reader_t*) calloc(1, sizeof(scap_reader_t));
+    if (h == NULL || r == NULL)
+    {
+        free(h);
+        free(r);
+        return NULL;
+    }
+
+    h->m_start = start;
+    h->m_next_off = start;
+    h->m_offset = start;
+    h->m_nworkers = nthreads;
+    h->m_nslots = nthreads * GZBLOCKS_SLOTS_PER_THREAD;
+    h->m_workers = (worker_t*) calloc(h->m_nworkers, sizeof(worker_t));
+    h->m_slots = (slot_t*) calloc(h->m_nslots, sizeof(slot_t));
+    pthread_mutex_init(&h->m_lock, NULL);
+    pthread_cond_init(&h->m_work_cond, NULL);
+    pthread_cond_init(&h->m_ready_cond, NULL);
+    if (h->m_workers == NULL || h->m_slots == NULL)
+    {
+        h->m_nworkers = 0;
+        free_handle(h, 0);
+        free(r);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < h->m_nworkers; i++)
+    {
+        h->m_workers[i].m_handle = h;
+        if (inflateInit2(&h->m_workers[i].m_zs, -15) != Z_OK)
+        {
+            // inflateEnd is harmless on the streams not initialized
+            free_handle(h, 0);
+            free(r);
+            return NULL;
+        }
+    }
+
+    // The fd is ours only once nothing can fail anymore, free_handle leaves it open
+    h->m_fd = fd;
+    for (uint32_t i = 0; i < h->m_nworkers; i++)
+    {
+        if (pthread_create(&h->m_workers[i].m_thread, NULL, worker_run, &h->m_workers[i]) != 0)
+        {
+            free_handle(h, i);
+            free(r);
+            return NULL;
+        }
+    }
+
+    r->handle = h;
+    r->read = &gzblocks_read;
+    r->map = NULL;
+    r->offset = &gzblocks_offset;
+    r->tell = &gzblocks_tell;
+    r->seek = &gzblocks_seek;
+    r->error = &gzblocks_error;
+    r->close = &gzblocks_close;
+    return r;
+}
+
+#endif // defined(USE_ZLIB) && !defined(UDIG)
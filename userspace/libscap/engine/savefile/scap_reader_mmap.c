@@ -0,0 +1,284 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "scap_reader.h"
+#include "scap_savefile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The bytes of the file mapped at once, unless an event needs more
+#define MMAP_DEFAULT_WINDOW (64 * 1024 * 1024)
+
+typedef struct reader_handle
+{
+    int m_fd; ///< The file, owned by the reader
+    uint64_t m_start; ///< The file offset of the start of the data
+    uint64_t m_size; ///< The file size, as last seen
+    uint64_t m_off; ///< The cursor position in the data
+    uint8_t* m_win; ///< The mapped window of the file, or NULL
+    uint64_t m_win_off; ///< The file offset of the window, page aligned
+    size_t m_win_len; ///< The length of the window
+    size_t m_window; ///< The length of the windows, if nothing needs more
+    size_t m_page_size; ///< The size of the pages of the mapping
+    int m_errno; ///< The error of the last failed operation, or 0
+} reader_handle_t;
+
+//
+// Look at the file size again: a capture can still be written while
+// it's read, and the data appended since the last look becomes readable
+//
+static void mmap_refresh_size(reader_handle_t* h)
+{
+    struct stat st;
+    if (fstat(h->m_fd, &st) == 0 && (uint64_t) st.st_size > h->m_size)
+    {
+        h->m_size = (uint64_t) st.st_size;
+    }
+}
+
+//
+// Make sure the len bytes at the file offset pos are mapped, and return
+// a pointer to them. Only a window of the file is mapped at once, it
+// moves forward with the cursor, so that replaying a big capture needs
+// a small, constant amount of address space and memory. The window
+// never extends past the known end of the file, to avoid SIGBUS if the
+// file gets truncated.
+//
+static uint8_t* mmap_window(reader_handle_t* h, uint64_t pos, size_t len)
+{
+    if (h->m_win != NULL && pos >= h->m_win_off && pos + len <= h->m_win_off + h->m_win_len)
+    {
+        return h->m_win + (pos - h->m_win_off);
+    }
+
+    if (pos + len > h->m_size)
+    {
+        mmap_refresh_size(h);
+        if (pos + len > h->m_size)
+        {
+            return NULL;
+        }
+    }
+
+    if (h->m_win != NULL)
+    {
+        munmap(h->m_win, h->m_win_len);
+        h->m_win = NULL;
+    }
+
+    uint64_t win_off = pos & ~((uint64_t) h->m_page_size - 1);
+    uint64_t win_len = pos + len - win_off;
+    if (win_len < h->m_window)
+    {
+        win_len = h->m_window;
+    }
+    if (win_off + win_len > h->m_size)
+    {
+        win_len = h->m_size - win_off;
+    }
+
+    uint8_t* win = (uint8_t*) mmap(NULL, (size_t) win_len, PROT_READ, MAP_PRIVATE, h->m_fd, (off_t) win_off);
+    if (win == MAP_FAILED)
+    {
+        h->m_errno = errno;
+        return NULL;
+    }
+    madvise(win, (size_t) win_len, MADV_SEQUENTIAL);
+    madvise(win, (size_t) win_len, MADV_WILLNEED);
+
+    h->m_win = win;
+    h->m_win_off = win_off;
+    h->m_win_len = (size_t) win_len;
+    return h->m_win + (pos - h->m_win_off);
+}
+
+static int mmap_read(scap_reader_t *r, void* buf, uint32_t len)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    uint64_t pos = h->m_start + h->m_off;
+    if (pos + len > h->m_size)
+    {
+        mmap_refresh_size(h);
+    }
+
+    size_t size = pos + len <= h->m_size ? len : (size_t) (h->m_size - pos);
+    size_t done = 0;
+    while (done < size)
+    {
+        size_t chunk = size - done < h->m_window ? size - done : h->m_window;
+        uint8_t* data = mmap_window(h, pos + done, chunk);
+        if (data == NULL)
+        {
+            break;
+        }
+        memcpy((uint8_t*) buf + done, data, chunk);
+        done += chunk;
+    }
+
+    h->m_off += done;
+    if (done == 0 && size > 0)
+    {
+        return -1;
+    }
+    return (int) done;
+}
+
+static void* mmap_map(scap_reader_t *r, uint32_t len)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    uint8_t* res = mmap_window(h, h->m_start + h->m_off, len);
+    if (res != NULL)
+    {
+        h->m_off += len;
+    }
+    return res;
+}
+
+static int64_t mmap_tell(scap_reader_t *r)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    return (int64_t) h->m_off;
+}
+
+static int64_t mmap_seek(scap_reader_t *r, int64_t offset, int whence)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    int64_t base;
+    switch (whence)
+    {
+    case SEEK_SET:
+        base = 0;
+        break;
+    case SEEK_CUR:
+        base = (int64_t) h->m_off;
+        break;
+    case SEEK_END:
+        mmap_refresh_size(h);
+        base = (int64_t) (h->m_size - h->m_start);
+        break;
+    default:
+        h->m_errno = EINVAL;
+        return -1;
+    }
+
+    if (base + offset > (int64_t) (h->m_size - h->m_start))
+    {
+        mmap_refresh_size(h);
+    }
+    if (offset < -base || base + offset > (int64_t) (h->m_size - h->m_start))
+    {
+        h->m_errno = EINVAL;
+        return -1;
+    }
+    h->m_off = (uint64_t) (base + offset);
+    return (int64_t) h->m_off;
+}
+
+static const char* mmap_error(scap_reader_t *r, int *errnum)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    *errnum = h->m_errno;
+    return h->m_errno ? strerror(h->m_errno) : "";
+}
+
+static int mmap_close(scap_reader_t *r)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    int res = 0;
+    if (h->m_win != NULL)
+    {
+        res = munmap(h->m_win, h->m_win_len);
+    }
+    if (close(h->m_fd) != 0)
+    {
+        res = -1;
+    }
+    free(h);
+    free(r);
+    return res;
+}
+
+scap_reader_t *scap_reader_open_mmap_window(int fd, uint32_t window)
+{
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return NULL;
+    }
+
+    // Start from the current position, like gzdopen does
+    off_t start = lseek(fd, 0, SEEK_CUR);
+    if (start < 0 || st.st_size - start < 4)
+    {
+        return NULL;
+    }
+
+    // Compressed files are left to the other readers
+    uint8_t data[4];
+    if (pread(fd, data, sizeof(data), start) != sizeof(data))
+    {
+        return NULL;
+    }
+    uint32_t magic = (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+    if ((data[0] == 0x1f && data[1] == 0x8b) || magic == ZSTD_FRAME_MAGIC || magic == LZ4_FRAME_MAGIC)
+    {
+        return NULL;
+    }
+
+    reader_handle_t* h = (reader_handle_t *) calloc (1, sizeof (reader_handle_t));
+    scap_reader_t* r = (scap_reader_t *) calloc (1, sizeof (scap_reader_t));
+    if (h == NULL || r == NULL)
+    {
+        free(h);
+        free(r);
+        return NULL;
+    }
+
+    // Let the page cache read ahead more aggressively
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    h->m_fd = fd;
+    h->m_start = (uint64_t) start;
+    h->m_size = (uint64_t) st.st_size;
+    h->m_page_size = (size_t) sysconf(_SC_PAGESIZE);
+    h->m_window = window > 0 ? window : MMAP_DEFAULT_WINDOW;
+
+    r->handle = h;
+    r->read = &mmap_read;
+    r->map = &mmap_map;
+    r->offset = &mmap_tell;
+    r->tell = &mmap_tell;
+    r->seek = &mmap_seek;
+    r->error = &mmap_error;
+    r->close = &mmap_close;
+    return r;
+}
+
+scap_reader_t *scap_reader_open_mmap(int fd)
+{
+    return scap_reader_open_mmap_window(fd, 0);
+}
@@ -0,0 +1,436 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "scap_reader.h"
+#include "scap_savefile.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAS_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAS_LZ4
+#include <lz4frame.h>
+#endif
+
+#if defined(HAS_ZSTD) || defined(HAS_LZ4)
+
+#define STREAM_IN_SIZE (256 * 1024)
+#define STREAM_OUT_SIZE (1024 * 1024)
+
+//
+// A streaming decompressor. decompress() consumes up to *src_len bytes of
+// src and produces up to *dst_len bytes in dst, updating both with the
+// amounts actually used. Returns NULL on success, or the error message.
+//
+typedef struct decoder
+{
+    void* (*create)(void);
+    void (*reset)(void* ctx);
+    const char* (*decompress)(void* ctx, void* dst, size_t* dst_len, const void* src, size_t* src_len);
+    void (*destroy)(void* ctx);
+} decoder_t;
+
+typedef struct reader_handle
+{
+    int m_fd; ///< The file to read, owned by the reader
+    int64_t m_start; ///< File offset of the stream
+    const decoder_t* m_decoder;
+    void* m_ctx;
+
+    uint8_t* m_in; ///< Compressed data read from the file
+    size_t m_in_pos;
+    size_t m_in_len;
+    int64_t m_file_off; ///< File offset of the end of m_in
+    bool m_file_eof;
+
+    uint8_t* m_out; ///< Decompressed data not returned yet
+    size_t m_out_pos;
+    size_t m_out_len;
+    uint64_t m_tell; ///< Position in the uncompressed data
+
+    int m_errno; ///< The error of the last failed operation, or 0
+    const char* m_error;
+} reader_handle_t;
+
+#ifdef HAS_ZSTD
+static void* zstd_create(void)
+{
+    return ZSTD_createDCtx();
+}
+
+static void zstd_reset(void* ctx)
+{
+    ZSTD_DCtx_reset((ZSTD_DCtx*) ctx, ZSTD_reset_session_only);
+}
+
+static const char* zstd_decompress(void* ctx, void* dst, size_t* dst_len, const void* src, size_t* src_len)
+{
+    ZSTD_outBuffer out = {dst, *dst_len, 0};
+    ZSTD_inBuffer in = {src, *src_len, 0};
+    size_t res = ZSTD_decompressStream((ZSTD_DCtx*) ctx, &out, &in);
+    *dst_len = out.pos;
+    *src_len = in.pos;
+    return ZSTD_isError(res) ? ZSTD_getErrorName(res) : NULL;
+}
+
+static void zstd_destroy(void* ctx)
+{
+    ZSTD_freeDCtx((ZSTD_DCtx*) ctx);
+}
+
+static const decoder_t s_zstd_decoder = {zstd_create, zstd_reset, zstd_decompress, zstd_destroy};
+#endif
+
+#ifdef HAS_LZ4
+static void* lz4_create(void)
+{
+    LZ4F_dctx* ctx = NULL;
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION)))
+    {
+        return NULL;
+    }
+    return ctx;
+}
+
+static void lz4_reset(void* ctx)
+{
+    LZ4F_resetDecompressionContext((LZ4F_dctx*) ctx);
+}
+
+static const char* lz4_decompress(void* ctx, void* dst, size_t* dst_len, const void* src, size_t* src_len)
+{
+    size_t res = LZ4F_decompress((LZ4F_dctx*) ctx, dst, dst_len, src, src_len, NULL);
+    return LZ4F_isError(res) ? LZ4F_getErrorName(res) : NULL;
+}
+
+static void lz4_destroy(void* ctx)
+{
+    LZ4F_freeDecompressionContext((LZ4F_dctx*) ctx);
+}
+
+static const decoder_t s_lz4_decoder = {lz4_create, lz4_reset, lz4_decompress, lz4_destroy};
+#endif
+
+static inline uint32_t get_le32(const uint8_t* p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static bool fill_input(reader_handle_t* h)
+{
+    ssize_t n;
+    do
+    {
+        n = pread(h->m_fd, h->m_in, STREAM_IN_SIZE, h->m_file_off);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0)
+    {
+        h->m_errno = errno;
+        h->m_error = strerror(errno);
+        return false;
+    }
+
+    h->m_in_pos = 0;
+    h->m_in_len = (size_t) n;
+    h->m_file_off += n;
+    h->m_file_eof = (n == 0);
+    return true;
+}
+
+//
+// Decompresses into dst, returns the number of bytes produced, 0 at the
+// end of the stream, or -1 on error
+//
+static int64_t decompress_into(reader_handle_t* h, uint8_t* dst, size_t len)
+{
+    while (true)
+    {
+        // The decoder might have output pending even without new input
+        size_t dst_len = len;
+        size_t src_len = h->m_in_len - h->m_in_pos;
+        const char* err = h->m_decoder->decompress(h->m_ctx, dst, &dst_len, h->m_in + h->m_in_pos, &src_len);
+        if (err != NULL)
+        {
+            h->m_errno = EINVAL;
+            h->m_error = err;
+            return -1;
+        }
+
+        h->m_in_pos += src_len;
+        if (dst_len > 0)
+        {
+            return (int64_t) dst_len;
+        }
+
+        if (h->m_in_pos == h->m_in_len)
+        {
+            // A truncated stream ends like a complete one, as with gzread
+            if (h->m_file_eof)
+            {
+                return 0;
+            }
+            if (!fill_input(h))
+            {
+                return -1;
+            }
+        }
+    }
+}
+
+static int stream_read(scap_reader_t *r, void* buf, uint32_t len)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    uint8_t* dst = (uint8_t*) buf;
+    uint32_t done = 0;
+
+    h->m_errno = 0;
+    while (done < len)
+    {
+        if (h->m_out_pos == h->m_out_len)
+        {
+            // Big reads skip the output buffer
+            bool direct = (len - done) >= STREAM_OUT_SIZE;
+            int64_t n = decompress_into(h, direct ? dst + done : h->m_out, direct ? len - done : STREAM_OUT_SIZE);
+            if (n <= 0)
+            {
+                if (n < 0 && done == 0)
+                {
+                    return -1;
+                }
+                break;
+            }
+
+            if (direct)
+            {
+                h->m_out_pos = 0;
+                h->m_out_len = 0;
+                done += (uint32_t) n;
+                h->m_tell += (uint64_t) n;
+                continue;
+            }
+            h->m_out_pos = 0;
+            h->m_out_len = (size_t) n;
+        }
+
+        size_t n = h->m_out_len - h->m_out_pos;
+        if (n > len - done)
+        {
+            n = len - done;
+        }
+        memcpy(dst + done, h->m_out + h->m_out_pos, n);
+        h->m_out_pos += n;
+        h->m_tell += n;
+        done += (uint32_t) n;
+    }
+
+    return (int) done;
+}
+
+static int64_t stream_offset(scap_reader_t *r)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    return h->m_file_off - (int64_t) (h->m_in_len - h->m_in_pos);
+}
+
+static int64_t stream_tell(scap_reader_t *r)
+{
+    ASSERT(r != NULL);
+    return (int64_t) ((reader_handle_t*) r->handle)->m_tell;
+}
+
+static void rewind_stream(reader_handle_t* h)
+{
+    h->m_decoder->reset(h->m_ctx);
+    h->m_in_pos = 0;
+    h->m_in_len = 0;
+    h->m_file_off = h->m_start;
+    h->m_file_eof = false;
+    h->m_out_pos = 0;
+    h->m_out_len = 0;
+    h->m_tell = 0;
+}
+
+static int64_t stream_seek(scap_reader_t *r, int64_t offset, int whence)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    int64_t target;
+
+    h->m_errno = 0;
+    switch (whence)
+    {
+    case SEEK_SET:
+        target = offset;
+        break;
+    case SEEK_CUR:
+        target = (int64_t) h->m_tell + offset;
+        break;
+    default:
+        h->m_errno = EINVAL;
+        h->m_error = "seek mode not supported";
+        return -1;
+    }
+    if (target < 0)
+    {
+        h->m_errno = EINVAL;
+        h->m_error = "invalid seek offset";
+        return -1;
+    }
+
+    // Moving inside the data already decompressed is free, going back
+    // any further means decompressing again from the start
+    uint64_t out_start = h->m_tell - h->m_out_pos;
+    if ((uint64_t) target < out_start)
+    {
+        rewind_stream(h);
+        out_start = 0;
+    }
+    if ((uint64_t) target <= out_start + h->m_out_len)
+    {
+        h->m_out_pos = (size_t) ((uint64_t) target - out_start);
+        h->m_tell = (uint64_t) target;
+        return target;
+    }
+
+    h->m_tell = out_start + h->m_out_len;
+    h->m_out_pos = h->m_out_len;
+    while (h->m_tell < (uint64_t) target)
+    {
+        int64_t n = decompress_into(h, h->m_out, STREAM_OUT_SIZE);
+        if (n <= 0)
+        {
+            h->m_out_pos = 0;
+            h->m_out_len = 0;
+            if (n == 0)
+            {
+                h->m_errno = EINVAL;
+                h->m_error = "seek past the end of the stream";
+            }
+            return -1;
+        }
+
+        h->m_out_len = (size_t) n;
+        if (h->m_tell + (uint64_t) n >= (uint64_t) target)
+        {
+            h->m_out_pos = (size_t) ((uint64_t) target - h->m_tell);
+            h->m_tell = (uint64_t) target;
+            break;
+        }
+        h->m_out_pos = h->m_out_len;
+        h->m_tell += (uint64_t) n;
+    }
+
+    return (int64_t) h->m_tell;
+}
+
+static const char* stream_error(scap_reader_t *r, int *errnum)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    *errnum = h->m_errno;
+    return h->m_errno ? h->m_error : "";
+}
+
+static int stream_close(scap_reader_t *r)
+{
+    ASSERT(r != NULL);
+    reader_handle_t* h = (reader_handle_t*) r->handle;
+    int res = close(h->m_fd);
+    h->m_decoder->destroy(h->m_ctx);
+    free(h->m_in);
+    free(h->m_out);
+    free(h);
+    free(r);
+    return res;
+}
+
+static scap_reader_t *open_stream(int fd, uint32_t magic, const decoder_t* decoder)
+{
+    uint8_t header[4];
+
+    // Start from the current position, like gzdopen does
+    off_t start = lseek(fd, 0, SEEK_CUR);
+    if (fd < 0 || start < 0 || pread(fd, header, sizeof(header), start) != sizeof(header) ||
+        get_le32(header) != magic)
+    {
+        return NULL;
+    }
+
+    reader_handle_t* h = (reader_handle_t*) calloc(1, sizeof(reader_handle_t));
+    scap_reader_t* r = (scap_reader_t*) calloc(1, sizeof(scap_reader_t));
+    if (h == NULL || r == NULL)
+    {
+        free(h);
+        free(r);
+        return NULL;
+    }
+
+    h->m_fd = fd;
+    h->m_start = start;
+    h->m_file_off = start;
+    h->m_decoder = decoder;
+    h->m_ctx = decoder->create();
+    h->m_in = (uint8_t*) malloc(STREAM_IN_SIZE);
+    h->m_out = (uint8_t*) malloc(STREAM_OUT_SIZE);
+    if (h->m_ctx == NULL || h->m_in == NULL || h->m_out == NULL)
+    {
+        if (h->m_ctx != NULL)
+        {
+            decoder->destroy(h->m_ctx);
+        }
+        free(h->m_in);
+        free(h->m_out);
+        free(h);
+        free(r);
+        return NULL;
+    }
+
+    r->handle = h;
+    r->read = &stream_read;
+    r->map = NULL;
+    r->offset = &stream_offset;
+    r->tell = &stream_tell;
+    r->seek = &stream_seek;
+    r->error = &stream_error;
+    r->close = &stream_close;
+    return r;
+}
+
+#endif
+
+scap_reader_t *scap_reader_open_zstd(int fd)
+{
+#ifdef HAS_ZSTD
+    return open_stream(fd, ZSTD_FRAME_MAGIC, &s_zstd_decoder);
+#else
+    return NULL;
+#endif
+}
+
+scap_reader_t *scap_reader_open_lz4(int fd)
+{
+#ifdef HAS_LZ4
+    return open_stream(fd, LZ4_FRAME_MAGIC, &s_lz4_decoder);
+#else
+    return NULL;
+#endif
+}
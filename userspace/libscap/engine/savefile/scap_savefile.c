@@ -20,6 +20,7 @@ limitations under the License.
 #include <stdlib.h>
 
 #ifndef _WIN32
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/uio.h>
 #else
@@ -1747,25 +1748,37 @@ static int32_t scap_read_init(struct savefile_engine *handle, scap_reader_t* r,
 	int fseekres;
 	int32_t rc;
 	int8_t found_ev = 0;
+	int8_t found_state = 0;
+
+	// The capture starts a new dictionary, if any
+	handle->m_strdict_len = 0;
+	handle->m_strdict_data_len = 0;
 
 	//
-	// Read the section header block
+	// Read the section header block, unless next() already did
 	//
-	if(read_block_header(handle, r, &bh) != sizeof(bh))
+	if(handle->m_section_header_read)
 	{
-		snprintf(error, SCAP_LASTERR_SIZE, "error reading from file (1)");
-		return SCAP_FAILURE;
+		handle->m_section_header_read = false;
 	}
-
-	if(bh.block_type != SHB_BLOCK_TYPE)
+	else
 	{
-		snprintf(error, SCAP_LASTERR_SIZE, "invalid block type");
-		return SCAP_FAILURE;
-	}
+		if(read_block_header(handle, r, &bh) != sizeof(bh))
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "error reading from file (1)");
+			return SCAP_FAILURE;
+		}
 
-	if((rc = scap_read_section_header(r, error)) != SCAP_SUCCESS)
-	{
-		return rc;
+		if(bh.block_type != SHB_BLOCK_TYPE)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "invalid block type");
+			return SCAP_FAILURE;
+		}
+
+		if((rc = scap_read_section_header(r, error)) != SCAP_SUCCESS)
+		{
+			return rc;
+		}
 	}
 
 	//
@@ -1778,9 +1791,16 @@ static int32_t scap_read_init(struct savefile_engine *handle, scap_reader_t* r,
 		//
 		// If we don't find the event block header,
 		// it means there is no event in the file.
+		// That's fine for a capture with just the state, like the
+		// state snapshots of sinsp: next() hits the end of the file.
 		//
 		if (readsize == 0 && !found_ev)
 		{
+			if(found_state)
+			{
+				break;
+			}
+
 			snprintf(error, SCAP_LASTERR_SIZE, "no events in file");
 			return SCAP_FAILURE;
 		}
@@ -1835,6 +1855,8 @@ static int32_t scap_read_init(struct savefile_engine *handle, scap_reader_t* r,
 		case EVF_BLOCK_TYPE_V2:
 		case EV_BLOCK_TYPE_V2_LARGE:
 		case EVF_BLOCK_TYPE_V2_LARGE:
+		case STRDICT_BLOCK_TYPE:
+		case EVD_BLOCK_TYPE:
 			//
 			// We're done with the metadata headers.
 			//
@@ -1880,6 +1902,8 @@ static int32_t scap_read_init(struct savefile_engine *handle, scap_reader_t* r,
 			break;
 		}
 
+		found_state = 1;
+
 		//
 		// Read and validate the trailer
 		//
@@ -1904,6 +1928,268 @@ static int32_t scap_read_init(struct savefile_engine *handle, scap_reader_t* r,
 	return SCAP_SUCCESS;
 }
 
+//
+// Whether the read filter (see set_read_filter) rejects an event, given
+// the beginning of its block and the offset of the event header in it
+// (after the cpuid, the flags of the EVF blocks and the reference mask of
+// the EVD ones). The ts and type are at the same place in v1 events.
+//
+static inline bool read_filter_skips(struct savefile_engine* handle, const char* evt_buf, uint32_t evt_offset)
+{
+	const struct ppm_evt_hdr* hdr = (const struct ppm_evt_hdr*)(evt_buf + evt_offset);
+
+	return hdr->ts < handle->m_read_ts_min ||
+	       hdr->ts > handle->m_read_ts_max ||
+	       (hdr->type < PPM_EVENT_MAX && !handle->m_read_evt_types[hdr->type]);
+}
+
+//
+// Called by next() after the header of a section header block. If the
+// section is a checkpoint, skip it up to the next event. Otherwise it's
+// another capture appended to this one, make the caller restart the
+// capture at the block after the section header.
+//
+static int32_t skip_checkpoint(struct savefile_engine* handle, scap_reader_t* r)
+{
+	block_header bh;
+	ckpt_header ch;
+	uint32_t bt;
+	int32_t res;
+
+	if((res = scap_read_section_header(r, handle->m_lasterr)) != SCAP_SUCCESS)
+	{
+		return res;
+	}
+	handle->m_section_header_read = true;
+
+	if(r->read(r, &bh, sizeof(bh)) != sizeof(bh))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error reading from file (section)");
+		return SCAP_FAILURE;
+	}
+
+	if(bh.block_type != CKPT_BLOCK_TYPE)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "unexpected section");
+		handle->m_last_block_header = bh;
+		handle->m_use_last_block_header = true;
+		return SCAP_UNEXPECTED_BLOCK;
+	}
+
+	if(bh.block_total_length != sizeof(bh) + sizeof(ch) + sizeof(bt) ||
+	   r->read(r, &ch, sizeof(ch)) != sizeof(ch) ||
+	   r->read(r, &bt, sizeof(bt)) != sizeof(bt) ||
+	   r->seek(r, ch.length, SEEK_CUR) < 0)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't skip checkpoint.");
+		return SCAP_FAILURE;
+	}
+
+	handle->m_section_header_read = false;
+	return SCAP_SUCCESS;
+}
+
+static void free_strdict(struct savefile_engine* handle)
+{
+	free(handle->m_strdict_offsets);
+	handle->m_strdict_offsets = NULL;
+	free(handle->m_strdict_lens);
+	handle->m_strdict_lens = NULL;
+	free(handle->m_strdict_data);
+	handle->m_strdict_data = NULL;
+	free(handle->m_strdict_evt_buf);
+	handle->m_strdict_evt_buf = NULL;
+	handle->m_strdict_len = 0;
+	handle->m_strdict_data_len = 0;
+	handle->m_strdict_data_size = 0;
+}
+
+//
+// Called by next() after the header of a string dictionary block, add its
+// strings to the dictionary
+//
+static int32_t read_strdict(struct savefile_engine* handle, scap_reader_t* r, const block_header* bh)
+{
+	strdict_header sh;
+	uint32_t readlen = sizeof(sh);
+	uint32_t i;
+
+	if(bh->block_total_length < sizeof(*bh) + sizeof(sh) + sizeof(uint32_t) ||
+	   r->read(r, &sh, sizeof(sh)) != sizeof(sh))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't read string dictionary.");
+		return SCAP_FAILURE;
+	}
+
+	//
+	// A block starting from 0 starts a new dictionary. One starting before
+	// the end was read already, before a seek back.
+	//
+	if(sh.first_id < handle->m_strdict_len)
+	{
+		handle->m_strdict_data_len = handle->m_strdict_offsets[sh.first_id];
+		handle->m_strdict_len = sh.first_id;
+	}
+	else if(sh.first_id == 0)
+	{
+		handle->m_strdict_data_len = 0;
+	}
+
+	if(sh.first_id != handle->m_strdict_len ||
+	   sh.n_strings > STRDICT_MAX_STRINGS - handle->m_strdict_len)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Unexpected strings %u-%u in a dictionary of %u.",
+			 sh.first_id, sh.first_id + sh.n_strings, handle->m_strdict_len);
+		return SCAP_FAILURE;
+	}
+
+	if(handle->m_strdict_offsets == NULL)
+	{
+		handle->m_strdict_offsets = (uint32_t*)malloc(STRDICT_MAX_STRINGS * sizeof(uint32_t));
+		handle->m_strdict_lens = (uint16_t*)malloc(STRDICT_MAX_STRINGS * sizeof(uint16_t));
+		handle->m_strdict_evt_buf = (char*)malloc(READER_BUF_SIZE);
+		if(handle->m_strdict_offsets == NULL || handle->m_strdict_lens == NULL || handle->m_strdict_evt_buf == NULL)
+		{
+			free_strdict(handle);
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the string dictionary");
+			return SCAP_FAILURE;
+		}
+	}
+
+	for(i = 0; i < sh.n_strings; i++)
+	{
+		uint16_t len;
+
+		readlen += sizeof(len);
+		if(readlen > bh->block_total_length - sizeof(*bh) - sizeof(uint32_t) ||
+		   r->read(r, &len, sizeof(len)) != sizeof(len) ||
+		   len > STRDICT_MAX_STRING_LEN ||
+		   handle->m_strdict_data_len + len > STRDICT_MAX_BYTES)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't read string dictionary (2).");
+			return SCAP_FAILURE;
+		}
+
+		if(handle->m_strdict_data_len + len > handle->m_strdict_data_size)
+		{
+			uint32_t size = handle->m_strdict_data_size == 0 ? READER_BUF_SIZE : handle->m_strdict_data_size * 2;
+			char* data;
+
+			while(size < handle->m_strdict_data_len + len)
+			{
+				size *= 2;
+			}
+
+			data = (char*)realloc(handle->m_strdict_data, size);
+			if(data == NULL)
+			{
+				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the string dictionary (2)");
+				return SCAP_FAILURE;
+			}
+			handle->m_strdict_data = data;
+			handle->m_strdict_data_size = size;
+		}
+
+		readlen += len;
+		if(readlen > bh->block_total_length - sizeof(*bh) - sizeof(uint32_t) ||
+		   r->read(r, handle->m_strdict_data + handle->m_strdict_data_len, len) != len)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't read string dictionary (3).");
+			return SCAP_FAILURE;
+		}
+
+		handle->m_strdict_offsets[handle->m_strdict_len] = handle->m_strdict_data_len;
+		handle->m_strdict_lens[handle->m_strdict_len] = len;
+		handle->m_strdict_len++;
+		handle->m_strdict_data_len += len;
+	}
+
+	//
+	// Skip the padding and the trailer
+	//
+	if(r->seek(r, bh->block_total_length - sizeof(*bh) - readlen, SEEK_CUR) < 0)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't skip string dictionary.");
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Replace the references of the params in mask with the strings they
+// point to in the dictionary
+//
+static int32_t expand_strdict_refs(struct savefile_engine* handle, scap_evt** pevent, uint32_t mask)
+{
+	const scap_evt* e = *pevent;
+	const uint16_t* lens = (const uint16_t*)((const char*)e + sizeof(struct ppm_evt_hdr));
+	const char* val = (const char*)(lens + e->nparams);
+	const char* end = (const char*)e + e->len;
+	char* buf = handle->m_strdict_evt_buf;
+	char* out;
+	uint16_t* out_lens;
+	uint32_t i;
+
+	if(buf == NULL || val > end || val - (const char*)e > READER_BUF_SIZE)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Unexpected string references.");
+		return SCAP_FAILURE;
+	}
+
+	memcpy(buf, e, val - (const char*)e);
+	out_lens = (uint16_t*)(buf + sizeof(struct ppm_evt_hdr));
+	out = buf + (val - (const char*)e);
+
+	for(i = 0; i < e->nparams; i++)
+	{
+		const char* src = val;
+		uint16_t len = lens[i];
+
+		if(val + len > end)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Wrong length of param %u.", i);
+			return SCAP_FAILURE;
+		}
+		val += len;
+
+		if(i < 32 && (mask & (1U << i)))
+		{
+			uint32_t id;
+
+			if(len != sizeof(id))
+			{
+				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Wrong string reference.");
+				return SCAP_FAILURE;
+			}
+
+			memcpy(&id, src, sizeof(id));
+			if(id >= handle->m_strdict_len)
+			{
+				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Unknown string %u.", id);
+				return SCAP_FAILURE;
+			}
+
+			src = handle->m_strdict_data + handle->m_strdict_offsets[id];
+			len = handle->m_strdict_lens[id];
+			out_lens[i] = len;
+		}
+
+		if(out + len > buf + READER_BUF_SIZE)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "expanded event greater than read buffer size %u", READER_BUF_SIZE);
+			return SCAP_FAILURE;
+		}
+
+		memcpy(out, src, len);
+		out += len;
+	}
+
+	((scap_evt*)buf)->len = out - buf;
+	*pevent = (scap_evt*)buf;
+	return SCAP_SUCCESS;
+}
+
 //
 // Read an event from disk
 //
@@ -1914,6 +2200,11 @@ static int32_t next(struct scap_engine_handle engine, scap_evt **pevent, uint16_
 	size_t readsize;
 	uint32_t readlen;
 	size_t hdr_len;
+	bool is_v2;
+	bool has_flags;
+	bool has_refs;
+	uint32_t evt_offset;
+	char* evt_buf;
 	scap_reader_t* r = handle->m_reader;
 
 	ASSERT(r != NULL);
@@ -1956,29 +2247,73 @@ static int32_t next(struct scap_engine_handle engine, scap_evt **pevent, uint16_
 			}
 		}
 
+		if(bh.block_type == EVIDX_BLOCK_TYPE || bh.block_type == CKIDX_BLOCK_TYPE)
+		{
+			//
+			// The indexes are only used to seek, skip them
+			//
+			if(r->seek(r, bh.block_total_length - sizeof(bh), SEEK_CUR) < 0)
+			{
+				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't skip index of size %u.",
+					 (uint32_t)bh.block_total_length);
+				return SCAP_FAILURE;
+			}
+			continue;
+		}
+
+		if(bh.block_type == SHB_BLOCK_TYPE)
+		{
+			int32_t res = skip_checkpoint(handle, r);
+			if(res == SCAP_SUCCESS)
+			{
+				continue;
+			}
+			return res;
+		}
+
+		if(bh.block_type == STRDICT_BLOCK_TYPE)
+		{
+			int32_t res = read_strdict(handle, r, &bh);
+			if(res == SCAP_SUCCESS)
+			{
+				continue;
+			}
+			return res;
+		}
+
 		if(bh.block_type != EV_BLOCK_TYPE &&
 		   bh.block_type != EV_BLOCK_TYPE_V2 &&
 		   bh.block_type != EV_BLOCK_TYPE_V2_LARGE &&
 		   bh.block_type != EV_BLOCK_TYPE_INT &&
 		   bh.block_type != EVF_BLOCK_TYPE &&
 		   bh.block_type != EVF_BLOCK_TYPE_V2 &&
-		   bh.block_type != EVF_BLOCK_TYPE_V2_LARGE)
+		   bh.block_type != EVF_BLOCK_TYPE_V2_LARGE &&
+		   bh.block_type != EVD_BLOCK_TYPE)
 		{
 			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "unexpected block type %u", (uint32_t)bh.block_type);
 			handle->m_use_last_block_header = true;
 			return SCAP_UNEXPECTED_BLOCK;
 		}
 
+		is_v2 = bh.block_type == EV_BLOCK_TYPE_V2 ||
+			bh.block_type == EV_BLOCK_TYPE_V2_LARGE ||
+			bh.block_type == EVF_BLOCK_TYPE_V2 ||
+			bh.block_type == EVF_BLOCK_TYPE_V2_LARGE ||
+			bh.block_type == EVD_BLOCK_TYPE;
+		has_flags = bh.block_type == EVF_BLOCK_TYPE ||
+			bh.block_type == EVF_BLOCK_TYPE_V2 ||
+			bh.block_type == EVF_BLOCK_TYPE_V2_LARGE ||
+			bh.block_type == EVD_BLOCK_TYPE;
+		has_refs = bh.block_type == EVD_BLOCK_TYPE;
+		evt_offset = sizeof(uint16_t) + (has_flags ? sizeof(uint32_t) : 0) + (has_refs ? sizeof(uint32_t) : 0);
+
 		hdr_len = sizeof(struct ppm_evt_hdr);
-		if(bh.block_type != EV_BLOCK_TYPE_V2 &&
-		   bh.block_type != EV_BLOCK_TYPE_V2_LARGE &&
-		   bh.block_type != EVF_BLOCK_TYPE_V2 &&
-		   bh.block_type != EVF_BLOCK_TYPE_V2_LARGE)
+		if(!is_v2)
 		{
 			hdr_len -= 4;
 		}
 
-		if(bh.block_total_length < sizeof(bh) + hdr_len + 4)
+		if(bh.block_total_length < sizeof(bh) + evt_offset + hdr_len + 4)
 		{
 			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "block length too short %u", (uint32_t)bh.block_total_length);
 			return SCAP_FAILURE;
@@ -1988,8 +2323,29 @@ static int32_t next(struct scap_engine_handle engine, scap_evt **pevent, uint16_
 		// Read the event
 		//
 		readlen = bh.block_total_length - sizeof(bh);
+		evt_buf = NULL;
+		if(is_v2 && r->map != NULL)
+		{
+			//
+			// The reader has the whole event in memory already, use it
+			// in place. Old events are converted below, so they still
+			// need to be copied.
+			//
+			evt_buf = r->map(r, readlen);
+			if(evt_buf == NULL)
+			{
+				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "expecting %u bytes for the event block. Is the file truncated?",
+					 readlen);
+				return SCAP_FAILURE;
+			}
+
+			if(handle->m_read_filter && read_filter_skips(handle, evt_buf, evt_offset))
+			{
+				continue;
+			}
+		}
 		// Non-large block types have an uint16_max maximum size
-		if (bh.block_type != EV_BLOCK_TYPE_V2_LARGE && bh.block_type != EVF_BLOCK_TYPE_V2_LARGE) {
+		else if (bh.block_type != EV_BLOCK_TYPE_V2_LARGE && bh.block_type != EVF_BLOCK_TYPE_V2_LARGE) {
 			if(readlen > READER_BUF_SIZE) {
 				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "event block length %u greater than NON-LARGE read buffer size %u",
 					 readlen,
@@ -2011,24 +2367,62 @@ static int32_t next(struct scap_engine_handle engine, scap_evt **pevent, uint16_
 			handle->m_reader_evt_buf_size = readlen;
 		}
 
-		readsize = r->read(r, handle->m_reader_evt_buf, readlen);
-		CHECK_READ_SIZE(readsize, readlen);
+		if(evt_buf == NULL)
+		{
+			char* dst = handle->m_reader_evt_buf;
+			uint32_t toread = readlen;
+
+			if(handle->m_read_filter)
+			{
+				//
+				// Read up to the event header first, and skip the
+				// rest of the block if the event is filtered out
+				//
+				uint32_t prefix_len = evt_offset + hdr_len;
+				if(readlen < prefix_len)
+				{
+					snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "block length too short %u", (uint32_t)bh.block_total_length);
+					return SCAP_FAILURE;
+				}
+
+				readsize = r->read(r, dst, prefix_len);
+				CHECK_READ_SIZE(readsize, prefix_len);
+
+				if(read_filter_skips(handle, dst, evt_offset))
+				{
+					if(r->seek(r, readlen - prefix_len, SEEK_CUR) < 0)
+					{
+						snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't skip event block of size %u.",
+							 (uint32_t)bh.block_total_length);
+						return SCAP_FAILURE;
+					}
+					continue;
+				}
+
+				dst += prefix_len;
+				toread -= prefix_len;
+			}
+
+			readsize = r->read(r, dst, toread);
+			CHECK_READ_SIZE(readsize, toread);
+			evt_buf = handle->m_reader_evt_buf;
+		}
 
 		//
-		// EVF_BLOCK_TYPE has 32 bits of flags
+		// EVF_BLOCK_TYPE has 32 bits of flags, EVD_BLOCK_TYPE has them
+		// followed by the mask of the params referencing the dictionary
 		//
-		*pcpuid = *(uint16_t *)handle->m_reader_evt_buf;
+		*pcpuid = *(uint16_t *)evt_buf;
 
-		if(bh.block_type == EVF_BLOCK_TYPE || bh.block_type == EVF_BLOCK_TYPE_V2 || bh.block_type == EVF_BLOCK_TYPE_V2_LARGE)
+		if(has_flags)
 		{
-			handle->m_last_evt_dump_flags = *(uint32_t*)(handle->m_reader_evt_buf + sizeof(uint16_t));
-			*pevent = (struct ppm_evt_hdr *)(handle->m_reader_evt_buf + sizeof(uint16_t) + sizeof(uint32_t));
+			handle->m_last_evt_dump_flags = *(uint32_t*)(evt_buf + sizeof(uint16_t));
 		}
 		else
 		{
 			handle->m_last_evt_dump_flags = 0;
-			*pevent = (struct ppm_evt_hdr *)(handle->m_reader_evt_buf + sizeof(uint16_t));
 		}
+		*pevent = (struct ppm_evt_hdr *)(evt_buf + evt_offset);
 
 		if((*pevent)->type >= PPM_EVENT_MAX)
 		{
@@ -2039,10 +2433,16 @@ static int32_t next(struct scap_engine_handle engine, scap_evt **pevent, uint16_
 			continue;
 		}
 
-		if(bh.block_type != EV_BLOCK_TYPE_V2 &&
-		   bh.block_type != EV_BLOCK_TYPE_V2_LARGE &&
-		   bh.block_type != EVF_BLOCK_TYPE_V2 &&
-		   bh.block_type != EVF_BLOCK_TYPE_V2_LARGE)
+		if(has_refs)
+		{
+			uint32_t mask = *(uint32_t*)(evt_buf + sizeof(uint16_t) + sizeof(uint32_t));
+			if(mask != 0 && expand_strdict_refs(handle, pevent, mask) != SCAP_SUCCESS)
+			{
+				return SCAP_FAILURE;
+			}
+		}
+
+		if(!is_v2)
 		{
 			//
 			// We're reading an old capture whose events don't have nparams in the header.
@@ -2058,7 +2458,7 @@ static int32_t next(struct scap_engine_handle engine, scap_evt **pevent, uint16_
 
 			memmove((char *)*pevent + sizeof(struct ppm_evt_hdr),
 				(char *)*pevent + sizeof(struct ppm_evt_hdr) - sizeof(uint32_t),
-				readlen - ((char *)*pevent - handle->m_reader_evt_buf) - (sizeof(struct ppm_evt_hdr) - sizeof(uint32_t)));
+				readlen - ((char *)*pevent - evt_buf) - (sizeof(struct ppm_evt_hdr) - sizeof(uint32_t)));
 			(*pevent)->len += sizeof(uint32_t);
 
 			// In old captures, the length of PPME_NOTIFICATION_E and PPME_INFRASTRUCTURE_EVENT_E
@@ -2125,6 +2525,248 @@ void scap_savefile_fseek(struct scap_engine_handle engine, uint64_t off)
 {
 	scap_reader_t* reader = engine.m_handle->m_reader;
 	reader->seek(reader, off, SEEK_SET);
+	// The block header read last is not the next one anymore
+	engine.m_handle->m_use_last_block_header = false;
+	engine.m_handle->m_section_header_read = false;
+}
+
+//
+// Load the index block of type block_type ending at end, if there is one.
+// Sets start to the beginning of the block.
+//
+static int32_t load_index_block(struct savefile_engine* handle, uint32_t block_type, int64_t end, int64_t* start, evt_index_entry** entries, uint64_t* n_entries)
+{
+	scap_reader_t* r = handle->m_reader;
+	block_header bh;
+	evt_index_header ih;
+	uint32_t bt;
+	evt_index_entry* e;
+
+	//
+	// Find the block from its trailer
+	//
+	if(end < (int64_t)(sizeof(bh) + sizeof(ih) + sizeof(bt)) ||
+	   r->seek(r, end - sizeof(bt), SEEK_SET) < 0 ||
+	   r->read(r, &bt, sizeof(bt)) != sizeof(bt) ||
+	   bt < sizeof(bh) + sizeof(ih) + sizeof(bt) ||
+	   bt > end)
+	{
+		return SCAP_NOT_SUPPORTED;
+	}
+
+	*start = end - bt;
+	if(r->seek(r, *start, SEEK_SET) < 0 ||
+	   r->read(r, &bh, sizeof(bh)) != sizeof(bh) ||
+	   bh.block_type != block_type ||
+	   bh.block_total_length != bt ||
+	   r->read(r, &ih, sizeof(ih)) != sizeof(ih) ||
+	   ih.n_entries == 0 ||
+	   (bt - sizeof(bh) - sizeof(ih) - sizeof(bt)) % sizeof(evt_index_entry) != 0 ||
+	   ih.n_entries != (bt - sizeof(bh) - sizeof(ih) - sizeof(bt)) / sizeof(evt_index_entry))
+	{
+		return SCAP_NOT_SUPPORTED;
+	}
+
+	e = (evt_index_entry*)malloc(ih.n_entries * sizeof(evt_index_entry));
+	if(e == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the index");
+		return SCAP_FAILURE;
+	}
+
+	if(r->read(r, e, ih.n_entries * sizeof(evt_index_entry)) != (int)(ih.n_entries * sizeof(evt_index_entry)) ||
+	   e[ih.n_entries - 1].offset >= (uint64_t)*start)
+	{
+		free(e);
+		return SCAP_NOT_SUPPORTED;
+	}
+
+	*entries = e;
+	*n_entries = ih.n_entries;
+	return SCAP_SUCCESS;
+}
+
+//
+// Load the event index and the checkpoint index at the end of the capture,
+// if there are. The event index is the last block, the checkpoint index
+// comes before it. The read position is left unchanged.
+//
+static int32_t load_event_index(struct savefile_engine* handle)
+{
+	scap_reader_t* r = handle->m_reader;
+	int64_t end;
+	int64_t pos = r->tell(r);
+	int32_t res;
+
+	handle->m_index_loaded = true;
+
+	end = r->seek(r, 0, SEEK_END);
+	res = load_index_block(handle, EVIDX_BLOCK_TYPE, end, &end, &handle->m_index, &handle->m_index_len);
+	if(res == SCAP_NOT_SUPPORTED)
+	{
+		end = r->seek(r, 0, SEEK_END);
+	}
+
+	if(res != SCAP_FAILURE)
+	{
+		res = load_index_block(handle, CKIDX_BLOCK_TYPE, end, &end, &handle->m_ckpts, &handle->m_ckpts_len);
+	}
+
+	r->seek(r, pos, SEEK_SET);
+	return res;
+}
+
+//
+// Move to the first event with a timestamp not lower than ts
+//
+static int32_t scap_savefile_fseek_ts(struct scap_engine_handle engine, uint64_t ts)
+{
+	struct savefile_engine* handle = engine.m_handle;
+	scap_reader_t* r = handle->m_reader;
+	scap_evt* evt;
+	uint16_t cpuid;
+	uint64_t lo = 0;
+	uint64_t hi;
+	int64_t pos;
+	int32_t res;
+
+	if(!handle->m_index_loaded && (res = load_event_index(handle)) == SCAP_FAILURE)
+	{
+		return res;
+	}
+
+	if(handle->m_index_len == 0)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "the capture has no event index or can't be seeked");
+		return SCAP_NOT_SUPPORTED;
+	}
+
+	//
+	// Start from the last indexed event before ts
+	//
+	hi = handle->m_index_len;
+	while(lo < hi)
+	{
+		uint64_t mid = lo + (hi - lo) / 2;
+		if(handle->m_index[mid].ts < ts)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	if(r->seek(r, handle->m_index[lo > 0 ? lo - 1 : 0].offset, SEEK_SET) < 0)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't seek to the indexed event");
+		return SCAP_FAILURE;
+	}
+	handle->m_use_last_block_header = false;
+
+	//
+	// And skip the events in between
+	//
+	while(true)
+	{
+		pos = r->tell(r);
+		res = next(engine, &evt, &cpuid);
+		if(res == SCAP_EOF)
+		{
+			return SCAP_SUCCESS;
+		}
+		else if(res != SCAP_SUCCESS)
+		{
+			return res;
+		}
+
+		if(evt->ts >= ts)
+		{
+			r->seek(r, pos, SEEK_SET);
+			return SCAP_SUCCESS;
+		}
+	}
+}
+
+//
+// Move to the last checkpoint older than ts, the state it holds is read
+// by restarting the capture
+//
+static int32_t scap_savefile_fseek_checkpoint(struct scap_engine_handle engine, uint64_t ts)
+{
+	struct savefile_engine* handle = engine.m_handle;
+	scap_reader_t* r = handle->m_reader;
+	uint64_t lo = 0;
+	uint64_t hi;
+	int32_t res;
+
+	if(!handle->m_index_loaded && (res = load_event_index(handle)) == SCAP_FAILURE)
+	{
+		return res;
+	}
+
+	hi = handle->m_ckpts_len;
+	while(lo < hi)
+	{
+		uint64_t mid = lo + (hi - lo) / 2;
+		if(handle->m_ckpts[mid].ts < ts)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	if(lo == 0)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "the capture has no checkpoint before the timestamp or can't be seeked");
+		return SCAP_NOT_SUPPORTED;
+	}
+
+	if(r->seek(r, handle->m_ckpts[lo - 1].offset, SEEK_SET) < 0)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't seek to the checkpoint");
+		return SCAP_FAILURE;
+	}
+	handle->m_use_last_block_header = false;
+	handle->m_section_header_read = false;
+	return SCAP_SUCCESS;
+}
+
+static int32_t get_event_index(struct scap_engine_handle engine, const evt_index_entry** entries, uint64_t* n_entries)
+{
+	struct savefile_engine* handle = engine.m_handle;
+	int32_t res;
+
+	if(!handle->m_index_loaded && (res = load_event_index(handle)) == SCAP_FAILURE)
+	{
+		return res;
+	}
+
+	*entries = handle->m_index;
+	*n_entries = handle->m_index_len;
+	return SCAP_SUCCESS;
+}
+
+static int32_t set_read_filter(struct scap_engine_handle engine, const uint8_t* event_types, uint64_t ts_min, uint64_t ts_max)
+{
+	struct savefile_engine* handle = engine.m_handle;
+
+	if(event_types != NULL)
+	{
+		memcpy(handle->m_read_evt_types, event_types, sizeof(handle->m_read_evt_types));
+	}
+	else
+	{
+		memset(handle->m_read_evt_types, 1, sizeof(handle->m_read_evt_types));
+	}
+	handle->m_read_ts_min = ts_min;
+	handle->m_read_ts_max = ts_max;
+	handle->m_read_filter = event_types != NULL || ts_min != 0 || ts_max != UINT64_MAX;
+	return SCAP_SUCCESS;
 }
 
 static struct savefile_engine* alloc_handle(struct scap* main_handle, char* lasterr_ptr)
@@ -2138,6 +2780,65 @@ static struct savefile_engine* alloc_handle(struct scap* main_handle, char* last
 
 }
 
+//
+// Open a reader that maps the capture in memory if it's uncompressed, that
+// inflates it in parallel if it's block compressed, or that decompresses it
+// if it's in zstd or lz4 format. Returns NULL if the capture must be read
+// with gzread instead.
+//
+static scap_reader_t* open_fd_reader(int fd, const char* fname, uint32_t decompression_threads)
+{
+#ifndef _WIN32
+	scap_reader_t* reader;
+	bool opened = false;
+
+	if(fd == 0)
+	{
+		fd = open(fname, O_RDONLY);
+		if(fd < 0)
+		{
+			return NULL;
+		}
+		opened = true;
+	}
+
+	// In both cases we own the fd once the reader is open, as with gzdopen
+	reader = scap_reader_open_mmap(fd);
+	if(reader != NULL)
+	{
+		return reader;
+	}
+
+#if defined(USE_ZLIB) && !defined(UDIG)
+	reader = scap_reader_open_gzblocks(fd, decompression_threads);
+	if(reader != NULL)
+	{
+		return reader;
+	}
+#endif
+
+	reader = scap_reader_open_zstd(fd);
+	if(reader != NULL)
+	{
+		return reader;
+	}
+
+	reader = scap_reader_open_lz4(fd);
+	if(reader != NULL)
+	{
+		return reader;
+	}
+
+	if(opened)
+	{
+		close(fd);
+	}
+	return NULL;
+#else
+	return NULL;
+#endif
+}
+
 static int32_t init(struct scap* main_handle, struct scap_open_args* oargs)
 {
 	gzFile gzfile;
@@ -2149,44 +2850,54 @@ static int32_t init(struct scap* main_handle, struct scap_open_args* oargs)
 	uint64_t start_offset = params->start_offset;
 	uint32_t fbuffer_size = params->fbuffer_size;
 
-	if(fd != 0)
-	{
-		gzfile = gzdopen(fd, "rb");
-	}
-	else
-	{
-		gzfile = gzopen(fname, "rb");
-	}
-
-	if(gzfile == NULL)
+	//
+	// Uncompressed captures are mapped in memory, so that the events
+	// are read in place and seeking anywhere is cheap, block compressed
+	// ones are inflated on multiple threads, and zstd and lz4 ones are
+	// recognized from their magic number
+	//
+	scap_reader_t* reader = open_fd_reader(fd, fname, params->decompression_threads);
+	if(reader == NULL)
 	{
 		if(fd != 0)
 		{
-			snprintf(main_handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open fd %d", fd);
+			gzfile = gzdopen(fd, "rb");
 		}
 		else
 		{
-			snprintf(main_handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open file %s", fname);
+			gzfile = gzopen(fname, "rb");
 		}
-		return SCAP_FAILURE;
-	}
 
-	scap_reader_t* reader = scap_reader_open_gzfile(gzfile);
-	if(!reader)
-	{
-		gzclose(gzfile);
-		return SCAP_FAILURE;
-	}
+		if(gzfile == NULL)
+		{
+			if(fd != 0)
+			{
+				snprintf(main_handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open fd %d", fd);
+			}
+			else
+			{
+				snprintf(main_handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open file %s", fname);
+			}
+			return SCAP_FAILURE;
+		}
 
-	if (fbuffer_size > 0)
-	{
-		scap_reader_t* buffered_reader = scap_reader_open_buffered(reader, fbuffer_size, true);
-		if(!buffered_reader)
+		reader = scap_reader_open_gzfile(gzfile);
+		if(!reader)
 		{
-			reader->close(reader);
+			gzclose(gzfile);
 			return SCAP_FAILURE;
 		}
-		reader = buffered_reader;
+
+		if (fbuffer_size > 0)
+		{
+			scap_reader_t* buffered_reader = scap_reader_open_buffered(reader, fbuffer_size, true);
+			if(!buffered_reader)
+			{
+				reader->close(reader);
+				return SCAP_FAILURE;
+			}
+			reader = buffered_reader;
+		}
 	}
 
 	//
@@ -2194,7 +2905,8 @@ static int32_t init(struct scap* main_handle, struct scap_open_args* oargs)
 	//
 	if(start_offset != 0)
 	{
-		scap_fseek(main_handle, start_offset);
+		// The handle has no reader yet, scap_fseek() can't be used
+		reader->seek(reader, start_offset, SEEK_SET);
 	}
 
 	handle->m_use_last_block_header = false;
@@ -2256,6 +2968,15 @@ static int32_t scap_savefile_close(struct scap_engine_handle engine)
 		handle->m_reader_evt_buf = NULL;
 	}
 
+	free_strdict(handle);
+	free(handle->m_index);
+	handle->m_index = NULL;
+	handle->m_index_len = 0;
+	free(handle->m_ckpts);
+	handle->m_ckpts = NULL;
+	handle->m_ckpts_len = 0;
+	handle->m_index_loaded = false;
+
 	return SCAP_SUCCESS;
 }
 
@@ -2293,6 +3014,10 @@ static uint32_t get_event_dump_flags(struct scap_engine_handle engine)
 static struct scap_savefile_vtable savefile_ops = {
 	.ftell_capture = scap_savefile_ftell,
 	.fseek_capture = scap_savefile_fseek,
+	.fseek_ts_capture = scap_savefile_fseek_ts,
+	.fseek_checkpoint = scap_savefile_fseek_checkpoint,
+	.set_read_filter = set_read_filter,
+	.get_event_index = get_event_index,
 
 	.restart_capture = scap_savefile_restart_capture,
 	.get_readfile_offset = get_readfile_offset,
@@ -20,6 +20,10 @@ limitations under the License.
 #include <stdlib.h>
 #include <stdio.h>
 #include <stddef.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 #include "source_plugin.h"
 #include "noop.h"
@@ -31,6 +35,9 @@ limitations under the License.
 
 static const char * const source_plugin_counters_stats_names[] = {
 	[N_EVTS] = "n_evts",
+	[N_PREFETCH_QUEUE_DEPTH] = "n_prefetch_queue_depth",
+	[N_PREFETCH_CONSUMER_WAIT_NS] = "n_prefetch_consumer_wait_ns",
+	[N_PREFETCH_PRODUCER_WAIT_NS] = "n_prefetch_producer_wait_ns",
 };
 
 // We need to check that ppm_evt_hdr and ss_plugin_event are the same struct
@@ -86,6 +93,255 @@ static int32_t plugin_rc_to_scap_rc(ss_plugin_rc plugin_rc)
 	return SCAP_FAILURE;
 }
 
+//
+// Prefetching of the batches, see input_plugin_prefetch. A thread calls
+// next_batch ahead of time and copies the events, since they belong to the
+// plugin only until its next call. One batch is consumed while the other
+// one is filled, and the thread waits when both are in use.
+//
+#define SOURCE_PLUGIN_PREFETCH_BATCHES 2
+
+#ifndef _WIN32
+struct source_plugin_prefetch_batch
+{
+	int32_t m_res;
+	uint32_t m_nevts;
+	ss_plugin_event** m_evts;
+	uint32_t m_evts_size;
+	uint8_t* m_buf;
+	size_t m_buf_size;
+};
+
+struct source_plugin_prefetch
+{
+	pthread_t m_thread;
+	pthread_mutex_t m_lock;
+	pthread_cond_t m_ready_cond; // Signaled when a batch is ready
+	pthread_cond_t m_free_cond; // Signaled when a batch is released, or on stop
+	struct source_plugin_prefetch_batch m_batches[SOURCE_PLUGIN_PREFETCH_BATCHES];
+	uint32_t m_head; // Oldest batch, the one being consumed if m_consuming
+	uint32_t m_count; // Batches filled, including the one being consumed
+	bool m_consuming;
+	bool m_done; // The thread returned after an error or the end of the events
+	bool m_stop;
+	int32_t m_done_res;
+	char m_lasterr[SCAP_LASTERR_SIZE];
+	uint64_t m_consumer_wait_ns;
+	uint64_t m_producer_wait_ns;
+};
+
+static int32_t prefetch_copy_batch(struct source_plugin_prefetch_batch* b, uint32_t nevts, ss_plugin_event** evts)
+{
+	size_t size = 0;
+	for(uint32_t i = 0; i < nevts; i++)
+	{
+		// keeping the events 8-bytes aligned
+		size += (evts[i]->len + 7) & ~((size_t)7);
+	}
+
+	if(size > b->m_buf_size)
+	{
+		uint8_t* buf = realloc(b->m_buf, size);
+		if(buf == NULL)
+		{
+			return SCAP_FAILURE;
+		}
+		b->m_buf = buf;
+		b->m_buf_size = size;
+	}
+
+	if(nevts > b->m_evts_size)
+	{
+		ss_plugin_event** ptrs = realloc(b->m_evts, nevts * sizeof(ss_plugin_event*));
+		if(ptrs == NULL)
+		{
+			return SCAP_FAILURE;
+		}
+		b->m_evts = ptrs;
+		b->m_evts_size = nevts;
+	}
+
+	size_t off = 0;
+	for(uint32_t i = 0; i < nevts; i++)
+	{
+		memcpy(b->m_buf + off, evts[i], evts[i]->len);
+		b->m_evts[i] = (ss_plugin_event*)(b->m_buf + off);
+		off += (evts[i]->len + 7) & ~((size_t)7);
+	}
+	b->m_nevts = nevts;
+	return SCAP_SUCCESS;
+}
+
+static void* prefetch_run(void* arg)
+{
+	struct source_plugin_engine* handle = arg;
+	struct source_plugin_prefetch* p = handle->m_prefetch;
+	scap_source_plugin* plugin = handle->m_input_plugin;
+
+	while(true)
+	{
+		pthread_mutex_lock(&p->m_lock);
+		if(p->m_count == SOURCE_PLUGIN_PREFETCH_BATCHES && !p->m_stop)
+		{
+			uint64_t start = get_timestamp_ns();
+			while(p->m_count == SOURCE_PLUGIN_PREFETCH_BATCHES && !p->m_stop)
+			{
+				pthread_cond_wait(&p->m_free_cond, &p->m_lock);
+			}
+			p->m_producer_wait_ns += get_timestamp_ns() - start;
+		}
+		if(p->m_stop)
+		{
+			pthread_mutex_unlock(&p->m_lock);
+			break;
+		}
+		// the free batch is not seen by the consumer until it's counted
+		struct source_plugin_prefetch_batch* b = &p->m_batches[(p->m_head + p->m_count) % SOURCE_PLUGIN_PREFETCH_BATCHES];
+		pthread_mutex_unlock(&p->m_lock);
+
+		uint32_t nevts = 0;
+		ss_plugin_event** evts = NULL;
+		b->m_res = plugin_rc_to_scap_rc(plugin->next_batch(plugin->state, plugin->handle, &nevts, &evts));
+		if(prefetch_copy_batch(b, nevts, evts) != SCAP_SUCCESS)
+		{
+			b->m_res = SCAP_FAILURE;
+			b->m_nevts = 0;
+			snprintf(p->m_lasterr, SCAP_LASTERR_SIZE, "can't allocate the prefetched events of plugin %s", plugin->name);
+		}
+		else if(b->m_res != SCAP_SUCCESS && b->m_res != SCAP_TIMEOUT && b->m_res != SCAP_EOF)
+		{
+			strlcpy(p->m_lasterr, plugin->get_last_error(plugin->state), SCAP_LASTERR_SIZE);
+		}
+
+		pthread_mutex_lock(&p->m_lock);
+		p->m_count++;
+		// timeouts are not final, the plugin can still produce events
+		bool done = b->m_res != SCAP_SUCCESS && b->m_res != SCAP_TIMEOUT;
+		if(done)
+		{
+			p->m_done = true;
+			p->m_done_res = b->m_res;
+		}
+		pthread_cond_signal(&p->m_ready_cond);
+		pthread_mutex_unlock(&p->m_lock);
+
+		if(done)
+		{
+			break;
+		}
+	}
+	return NULL;
+}
+
+static int32_t prefetch_start(struct source_plugin_engine* handle)
+{
+	struct source_plugin_prefetch* p = calloc(1, sizeof(struct source_plugin_prefetch));
+	if(p == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't allocate the prefetching state");
+		return SCAP_FAILURE;
+	}
+
+	pthread_mutex_init(&p->m_lock, NULL);
+	pthread_cond_init(&p->m_ready_cond, NULL);
+	pthread_cond_init(&p->m_free_cond, NULL);
+	handle->m_prefetch = p;
+	if(pthread_create(&p->m_thread, NULL, prefetch_run, handle) != 0)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't start the prefetching thread");
+		pthread_cond_destroy(&p->m_free_cond);
+		pthread_cond_destroy(&p->m_ready_cond);
+		pthread_mutex_destroy(&p->m_lock);
+		free(p);
+		handle->m_prefetch = NULL;
+		return SCAP_FAILURE;
+	}
+	return SCAP_SUCCESS;
+}
+
+static void prefetch_stop(struct source_plugin_engine* handle)
+{
+	struct source_plugin_prefetch* p = handle->m_prefetch;
+	if(p == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&p->m_lock);
+	p->m_stop = true;
+	pthread_cond_signal(&p->m_free_cond);
+	pthread_mutex_unlock(&p->m_lock);
+	pthread_join(p->m_thread, NULL);
+
+	for(uint32_t i = 0; i < SOURCE_PLUGIN_PREFETCH_BATCHES; i++)
+	{
+		free(p->m_batches[i].m_evts);
+		free(p->m_batches[i].m_buf);
+	}
+	pthread_cond_destroy(&p->m_free_cond);
+	pthread_cond_destroy(&p->m_ready_cond);
+	pthread_mutex_destroy(&p->m_lock);
+	free(p);
+	handle->m_prefetch = NULL;
+	handle->m_input_plugin_batch_evts = NULL;
+	handle->m_input_plugin_batch_nevts = 0;
+}
+
+// Releases the batch consumed so far and takes the next one, waiting for it
+// if needed. Once the thread is done, its final result is returned.
+static int32_t prefetch_next_batch(struct source_plugin_engine* handle)
+{
+	struct source_plugin_prefetch* p = handle->m_prefetch;
+
+	pthread_mutex_lock(&p->m_lock);
+	if(p->m_consuming)
+	{
+		p->m_head = (p->m_head + 1) % SOURCE_PLUGIN_PREFETCH_BATCHES;
+		p->m_count--;
+		p->m_consuming = false;
+		pthread_cond_signal(&p->m_free_cond);
+	}
+
+	if(p->m_count == 0)
+	{
+		if(p->m_done)
+		{
+			int32_t res = p->m_done_res;
+			pthread_mutex_unlock(&p->m_lock);
+			handle->m_input_plugin_batch_nevts = 0;
+			return res;
+		}
+
+		uint64_t start = get_timestamp_ns();
+		while(p->m_count == 0)
+		{
+			pthread_cond_wait(&p->m_ready_cond, &p->m_lock);
+		}
+		p->m_consumer_wait_ns += get_timestamp_ns() - start;
+	}
+
+	struct source_plugin_prefetch_batch* b = &p->m_batches[p->m_head];
+	p->m_consuming = true;
+	pthread_mutex_unlock(&p->m_lock);
+
+	handle->m_input_plugin_batch_nevts = b->m_nevts;
+	handle->m_input_plugin_batch_evts = b->m_evts;
+	return b->m_res;
+}
+#endif
+
+// The errors of the prefetched batches are read by the prefetching thread
+static const char* plugin_last_error(struct source_plugin_engine* handle)
+{
+#ifndef _WIN32
+	if(handle->m_prefetch != NULL)
+	{
+		return handle->m_prefetch->m_lasterr;
+	}
+#endif
+	return handle->m_input_plugin->get_last_error(handle->m_input_plugin->state);
+}
+
 static struct source_plugin_engine* alloc_handle(scap_t* main_handle, char* lasterr_ptr)
 {
 	struct source_plugin_engine *engine = calloc(1, sizeof(struct source_plugin_engine));
@@ -118,11 +374,30 @@ static int32_t init(scap_t* main_handle, scap_open_args* oargs)
 	handle->m_input_plugin_batch_evts = NULL;
 	handle->m_input_plugin_batch_idx = 0;
 	handle->m_input_plugin_last_batch_res = SCAP_SUCCESS;
+	handle->m_prefetch = NULL;
 
 	if(rc != SCAP_SUCCESS)
 	{
 		const char *errstr = handle->m_input_plugin->get_last_error(handle->m_input_plugin->state);
 		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "%s", errstr);
+		return rc;
+	}
+
+	if(params->input_plugin_prefetch)
+	{
+#ifndef _WIN32
+		rc = prefetch_start(handle);
+		if(rc != SCAP_SUCCESS)
+		{
+			handle->m_input_plugin->close(handle->m_input_plugin->state, handle->m_input_plugin->handle);
+			handle->m_input_plugin->handle = NULL;
+		}
+#else
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "prefetching of the plugin batches is not supported on this platform");
+		rc = SCAP_NOT_SUPPORTED;
+		handle->m_input_plugin->close(handle->m_input_plugin->state, handle->m_input_plugin->handle);
+		handle->m_input_plugin->handle = NULL;
+#endif
 	}
 
 	return rc;
@@ -132,6 +407,10 @@ static int close_engine(struct scap_engine_handle engine)
 {
 	struct source_plugin_engine *handle = engine.m_handle;
 
+#ifndef _WIN32
+	// the thread may be inside next_batch
+	prefetch_stop(handle);
+#endif
 	handle->m_input_plugin->close(handle->m_input_plugin->state, handle->m_input_plugin->handle);
 	handle->m_input_plugin->handle = NULL;
 	return SCAP_SUCCESS;
@@ -148,7 +427,7 @@ static int32_t next(struct scap_engine_handle engine, OUT scap_evt** pevent, OUT
 		{
 			if(handle->m_input_plugin_last_batch_res != SCAP_TIMEOUT && handle->m_input_plugin_last_batch_res != SCAP_EOF)
 			{
-				const char *errstr = handle->m_input_plugin->get_last_error(handle->m_input_plugin->state);
+				const char *errstr = plugin_last_error(handle);
 				strlcpy(lasterr, errstr, SCAP_LASTERR_SIZE);
 			}
 			int32_t tres = handle->m_input_plugin_last_batch_res;
@@ -156,11 +435,20 @@ static int32_t next(struct scap_engine_handle engine, OUT scap_evt** pevent, OUT
 			return tres;
 		}
 
-		int32_t plugin_res = handle->m_input_plugin->next_batch(handle->m_input_plugin->state,
-									handle->m_input_plugin->handle,
-									&(handle->m_input_plugin_batch_nevts),
-									&(handle->m_input_plugin_batch_evts));
-		handle->m_input_plugin_last_batch_res = plugin_rc_to_scap_rc(plugin_res);
+#ifndef _WIN32
+		if(handle->m_prefetch != NULL)
+		{
+			handle->m_input_plugin_last_batch_res = prefetch_next_batch(handle);
+		}
+		else
+#endif
+		{
+			int32_t plugin_res = handle->m_input_plugin->next_batch(handle->m_input_plugin->state,
+										handle->m_input_plugin->handle,
+										&(handle->m_input_plugin_batch_nevts),
+										&(handle->m_input_plugin_batch_evts));
+			handle->m_input_plugin_last_batch_res = plugin_rc_to_scap_rc(plugin_res);
+		}
 
 		if(handle->m_input_plugin_batch_nevts == 0)
 		{
@@ -174,7 +462,7 @@ static int32_t next(struct scap_engine_handle engine, OUT scap_evt** pevent, OUT
 			{
 				if(handle->m_input_plugin_last_batch_res != SCAP_TIMEOUT && handle->m_input_plugin_last_batch_res != SCAP_EOF)
 				{
-					const char *errstr = handle->m_input_plugin->get_last_error(handle->m_input_plugin->state);
+					const char *errstr = plugin_last_error(handle);
 					snprintf(lasterr, SCAP_LASTERR_SIZE, "%s", errstr);
 				}
 				return handle->m_input_plugin_last_batch_res;
@@ -257,6 +545,17 @@ const struct scap_stats_v2* get_source_plugin_stats_v2(struct scap_engine_handle
 		strlcpy(stats[stat].name, source_plugin_counters_stats_names[stat], STATS_NAME_MAX);
 	}
 	stats[N_EVTS].value.u64 = handle->m_nevts;
+#ifndef _WIN32
+	struct source_plugin_prefetch* p = handle->m_prefetch;
+	if(p != NULL)
+	{
+		pthread_mutex_lock(&p->m_lock);
+		stats[N_PREFETCH_QUEUE_DEPTH].value.u64 = p->m_count - (p->m_consuming ? 1 : 0);
+		stats[N_PREFETCH_CONSUMER_WAIT_NS].value.u64 = p->m_consumer_wait_ns;
+		stats[N_PREFETCH_PRODUCER_WAIT_NS].value.u64 = p->m_producer_wait_ns;
+		pthread_mutex_unlock(&p->m_lock);
+	}
+#endif
 
 	*rc = SCAP_SUCCESS;
 	return stats;
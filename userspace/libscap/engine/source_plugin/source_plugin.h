@@ -22,6 +22,7 @@ limitations under the License.
 #include "scap_stats_v2.h"
 
 struct scap;
+struct source_plugin_prefetch;
 
 struct source_plugin_engine
 {
@@ -47,6 +48,10 @@ struct source_plugin_engine
 	// The return value from the last call to next_batch().
 	ss_plugin_rc m_input_plugin_last_batch_res;
 
+	// The state of the thread calling next_batch ahead of time, or NULL
+	// if the batches are read synchronously.
+	struct source_plugin_prefetch* m_prefetch;
+
 	// Stats v2.
 	scap_stats_v2 m_stats[MAX_SOURCE_PLUGIN_COUNTERS_STATS];
 
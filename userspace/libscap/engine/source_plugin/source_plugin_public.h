@@ -13,6 +13,7 @@ limitations under the License.
 
 #pragma once
 
+#include <stdbool.h>
 #include "plugin_info.h"
 
 #define SOURCE_PLUGIN_ENGINE "source_plugin"
@@ -26,6 +27,7 @@ extern "C"
 	{
 		scap_source_plugin* input_plugin; ///< use this to configure a source plugin that will produce the events for this capture
 		char* input_plugin_params;	  ///< optional parameters string for the source plugin pointed by src_plugin
+		bool input_plugin_prefetch;	  ///< if true, next_batch is called ahead of time on a separate thread, so that the plugin's latency doesn't stall the capture. The plugin must tolerate next_batch running concurrently with its other functions.
 	};
 
 #ifdef __cplusplus
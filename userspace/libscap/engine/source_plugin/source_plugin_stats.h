@@ -19,5 +19,8 @@ limitations under the License.
 
 typedef enum source_plugin_counters_stats {
 	N_EVTS = 0,
+	N_PREFETCH_QUEUE_DEPTH,
+	N_PREFETCH_CONSUMER_WAIT_NS,
+	N_PREFETCH_PRODUCER_WAIT_NS,
 	MAX_SOURCE_PLUGIN_COUNTERS_STATS,
 }source_plugin_counters_stats;
@@ -0,0 +1,667 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "synthetic_public.h"
+
+struct scap;
+struct scap_threadinfo;
+
+#define SYNTHETIC_DEFAULT_N_PROCESSES 64
+#define SYNTHETIC_DEFAULT_FDS_PER_PROCESS 16
+#define SYNTHETIC_DEFAULT_FILE_WEIGHT 60
+#define SYNTHETIC_DEFAULT_NET_WEIGHT 25
+#define SYNTHETIC_DEFAULT_CLONE_WEIGHT 10
+#define SYNTHETIC_DEFAULT_EXEC_WEIGHT 5
+
+// An action generates at most 6 events (close, socket, connect)
+#define SYNTHETIC_MAX_BURST 8
+#define SYNTHETIC_BUF_SIZE (SYNTHETIC_MAX_BURST * 2048)
+
+// The generated timestamps start on 2020-09-13, like a real capture would
+#define SYNTHETIC_BASE_TS 1600000000000000000ULL
+// Step between two events when they are generated as fast as possible
+#define SYNTHETIC_DEFAULT_TS_STEP 1000
+
+#define SYNTHETIC_INIT_TID 1
+#define SYNTHETIC_FIRST_TID 100
+
+struct synthetic_proc
+{
+	int64_t tid;
+	int64_t ptid;
+	uint32_t cmd; ///< Index in g_commands
+	uint32_t first_fd; ///< Position of the oldest fd in the ring
+	uint32_t n_fds;
+	int64_t next_fd;
+	int64_t* fds; ///< Ring of the open fds, fds_per_process long
+};
+
+struct synthetic_engine
+{
+	char* m_lasterr;
+	struct scap_synthetic_engine_params m_params;
+	uint32_t m_total_weight;
+	uint64_t m_rng;
+
+	struct synthetic_proc* m_procs;
+	uint32_t m_n_procs;
+	uint32_t m_max_procs;
+	int64_t* m_fds;
+	int64_t m_next_tid;
+
+	// The processes running at open
+	struct scap_threadinfo* m_tinfos;
+	uint64_t m_n_tinfos;
+
+	// The events of the last action, returned one at a time
+	char* m_buf;
+	size_t m_buf_used;
+	size_t m_burst[SYNTHETIC_MAX_BURST];
+	uint32_t m_burst_len;
+	uint32_t m_burst_next;
+
+	uint64_t m_ts;
+	uint64_t m_ts_step;
+	uint64_t m_n_evts;
+
+	// Pacing, the clock is only read once the allowed events are consumed
+	uint64_t m_start_ns;
+	uint64_t m_allowed_evts;
+};
+
+typedef struct synthetic_engine synthetic_engine;
+
+#define SCAP_HANDLE_T struct synthetic_engine
+
+#include "noop.h"
+
+#include "scap.h"
+#include "scap-int.h"
+#include "strlcpy.h"
+
+static const struct
+{
+	const char* comm;
+	const char* exepath;
+	const char* args;
+} g_commands[] = {
+	{"nginx", "/usr/sbin/nginx", "-g\0daemon off;"},
+	{"bash", "/bin/bash", "-c\0true"},
+	{"python3", "/usr/bin/python3", "app.py"},
+	{"curl", "/usr/bin/curl", "-s\0http://10.1.0.1/"},
+	{"java", "/usr/bin/java", "-jar\0server.jar"},
+	{"sshd", "/usr/sbin/sshd", "-D"},
+	{"cat", "/bin/cat", "/etc/hosts"},
+	{"node", "/usr/bin/node", "index.js"},
+};
+
+#define N_COMMANDS (sizeof(g_commands) / sizeof(g_commands[0]))
+
+static const char* g_files[] = {
+	"/etc/passwd",
+	"/etc/hosts",
+	"/etc/ld.so.cache",
+	"/usr/lib/x86_64-linux-gnu/libc.so.6",
+	"/var/log/syslog",
+	"/proc/self/status",
+};
+
+#define N_FILES (sizeof(g_files) / sizeof(g_files[0]))
+
+static const uint16_t g_ports[] = {80, 443, 5432, 6379, 8080};
+
+#define N_PORTS (sizeof(g_ports) / sizeof(g_ports[0]))
+
+static const char g_data[] = "GET / HTTP/1.1\r\nHost: synthetic\r\n\r\n";
+static const char g_cgroups[] = "cpuset=/\0cpu=/\0memory=/";
+static const char g_env[] = "PATH=/usr/bin:/bin\0HOME=/root";
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//
+// xorshift64*, so that a seed gives the same events on every platform
+//
+static inline uint64_t rand64(synthetic_engine* engine)
+{
+	uint64_t x = engine->m_rng;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	engine->m_rng = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline uint32_t rand_below(synthetic_engine* engine, uint32_t n)
+{
+	return (uint32_t)(((rand64(engine) >> 32) * n) >> 32);
+}
+
+static struct synthetic_engine* alloc_handle(scap_t* main_handle, char* lasterr_ptr)
+{
+	struct synthetic_engine *engine = calloc(1, sizeof(struct synthetic_engine));
+	if(engine == NULL)
+	{
+		return NULL;
+	}
+
+	engine->m_lasterr = lasterr_ptr;
+
+	return engine;
+}
+
+static void free_handle(struct scap_engine_handle handle)
+{
+	synthetic_engine *engine = handle.m_handle;
+
+	free(engine->m_procs);
+	free(engine->m_fds);
+	free(engine->m_tinfos);
+	free(engine->m_buf);
+	free(engine);
+}
+
+static int32_t add_event(synthetic_engine* engine, int64_t tid, ppm_event_code type, uint32_t n, ...)
+{
+	struct scap_sized_buffer buf = {
+		.buf = engine->m_buf + engine->m_buf_used,
+		.size = SYNTHETIC_BUF_SIZE - engine->m_buf_used,
+	};
+	size_t size;
+	va_list args;
+
+	va_start(args, n);
+	int32_t res = scap_event_encode_params_v(buf, &size, engine->m_lasterr, type, n, args);
+	va_end(args);
+	if(res != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	scap_evt* evt = buf.buf;
+	evt->tid = tid;
+	engine->m_burst[engine->m_burst_len++] = engine->m_buf_used;
+	engine->m_buf_used += size;
+	return SCAP_SUCCESS;
+}
+
+static struct synthetic_proc* random_proc(synthetic_engine* engine, bool skip_init)
+{
+	if(skip_init && engine->m_n_procs > 1)
+	{
+		return &engine->m_procs[1 + rand_below(engine, engine->m_n_procs - 1)];
+	}
+	return &engine->m_procs[rand_below(engine, engine->m_n_procs)];
+}
+
+static inline int64_t proc_fd(synthetic_engine* engine, struct synthetic_proc* proc, uint32_t j)
+{
+	return proc->fds[(proc->first_fd + j) % engine->m_params.fds_per_process];
+}
+
+static int32_t new_fd(synthetic_engine* engine, struct synthetic_proc* proc, int64_t* fd)
+{
+	uint32_t max_fds = engine->m_params.fds_per_process;
+
+	if(proc->n_fds == max_fds)
+	{
+		int64_t oldest = proc->fds[proc->first_fd];
+		proc->first_fd = (proc->first_fd + 1) % max_fds;
+		proc->n_fds--;
+
+		if(add_event(engine, proc->tid, PPME_SYSCALL_CLOSE_E, 1, oldest) != SCAP_SUCCESS ||
+		   add_event(engine, proc->tid, PPME_SYSCALL_CLOSE_X, 2, (int64_t)0, oldest) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+	}
+
+	*fd = proc->next_fd++;
+	proc->fds[(proc->first_fd + proc->n_fds) % max_fds] = *fd;
+	proc->n_fds++;
+	return SCAP_SUCCESS;
+}
+
+static int32_t file_action(synthetic_engine* engine)
+{
+	struct synthetic_proc* proc = random_proc(engine, false);
+	int32_t res;
+
+	// A quarter of the actions open a file, the others read or write one
+	if(proc->n_fds == 0 || rand_below(engine, 4) == 0)
+	{
+		char path[64];
+		const char* name;
+		uint32_t file = rand_below(engine, N_FILES + 1);
+		if(file < N_FILES)
+		{
+			name = g_files[file];
+		}
+		else
+		{
+			snprintf(path, sizeof(path), "/var/lib/synthetic/%u.db", rand_below(engine, 1024));
+			name = path;
+		}
+
+		int64_t fd;
+		if(new_fd(engine, proc, &fd) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+
+		res = add_event(engine, proc->tid, PPME_SYSCALL_OPEN_E, 3, name, PPM_O_RDWR, (uint32_t)0);
+		if(res == SCAP_SUCCESS)
+		{
+			res = add_event(engine, proc->tid, PPME_SYSCALL_OPEN_X, 6, fd, name, PPM_O_RDWR, (uint32_t)0,
+					(uint32_t)0x803, (uint64_t)(1000 + file));
+		}
+		return res;
+	}
+
+	int64_t fd = proc_fd(engine, proc, rand_below(engine, proc->n_fds));
+	uint32_t size = 64u << rand_below(engine, 8);
+	struct scap_const_sized_buffer data = {
+		.buf = g_data,
+		.size = sizeof(g_data) - 1,
+	};
+	bool is_read = rand_below(engine, 2) == 0;
+
+	res = add_event(engine, proc->tid, is_read ? PPME_SYSCALL_READ_E : PPME_SYSCALL_WRITE_E, 2, fd, size);
+	if(res == SCAP_SUCCESS)
+	{
+		res = add_event(engine, proc->tid, is_read ? PPME_SYSCALL_READ_X : PPME_SYSCALL_WRITE_X, 3,
+				(int64_t)size, data, fd);
+	}
+	return res;
+}
+
+static int32_t net_action(synthetic_engine* engine)
+{
+	struct synthetic_proc* proc = random_proc(engine, true);
+	int64_t fd;
+	if(new_fd(engine, proc, &fd) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	// Addresses in network order, ports in host order, as the drivers send them
+	uint8_t dip[4] = {10, 1, (uint8_t)rand_below(engine, 4), (uint8_t)(1 + rand_below(engine, 254))};
+	uint8_t sip[4] = {10, 0, 0, 1};
+	uint16_t dport = g_ports[rand_below(engine, N_PORTS)];
+	uint16_t sport = 32768 + rand_below(engine, 28232);
+
+	uint8_t addr[7];
+	addr[0] = PPM_AF_INET;
+	memcpy(&addr[1], dip, 4);
+	memcpy(&addr[5], &dport, 2);
+
+	uint8_t tuple[13];
+	tuple[0] = PPM_AF_INET;
+	memcpy(&tuple[1], sip, 4);
+	memcpy(&tuple[5], &sport, 2);
+	memcpy(&tuple[7], dip, 4);
+	memcpy(&tuple[11], &dport, 2);
+
+	struct scap_const_sized_buffer addr_buf = {.buf = addr, .size = sizeof(addr)};
+	struct scap_const_sized_buffer tuple_buf = {.buf = tuple, .size = sizeof(tuple)};
+
+	if(add_event(engine, proc->tid, PPME_SOCKET_SOCKET_E, 3, (uint32_t)PPM_AF_INET, (uint32_t)1, (uint32_t)0) != SCAP_SUCCESS ||
+	   add_event(engine, proc->tid, PPME_SOCKET_SOCKET_X, 1, fd) != SCAP_SUCCESS ||
+	   add_event(engine, proc->tid, PPME_SOCKET_CONNECT_E, 2, fd, addr_buf) != SCAP_SUCCESS ||
+	   add_event(engine, proc->tid, PPME_SOCKET_CONNECT_X, 3, (int64_t)0, tuple_buf, fd) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+	return SCAP_SUCCESS;
+}
+
+static int32_t add_clone_exit(synthetic_engine* engine, int64_t evt_tid, int64_t res, const struct synthetic_proc* proc)
+{
+	struct scap_const_sized_buffer args = {
+		.buf = g_commands[proc->cmd].args,
+		.size = strlen(g_commands[proc->cmd].args) + 1,
+	};
+	struct scap_const_sized_buffer cgroups = {.buf = g_cgroups, .size = sizeof(g_cgroups)};
+
+	return add_event(engine, evt_tid, PPME_SYSCALL_CLONE_20_X, 21, res, g_commands[proc->cmd].exepath, args,
+			 proc->tid, proc->tid, proc->ptid, "/", (int64_t)1024, (uint64_t)0, (uint64_t)0,
+			 (uint32_t)0, (uint32_t)0, (uint32_t)0, g_commands[proc->cmd].comm, cgroups,
+			 (uint32_t)0, (uint32_t)0, (uint32_t)0, proc->tid, proc->tid, (uint64_t)0);
+}
+
+static int32_t clone_action(synthetic_engine* engine)
+{
+	uint32_t max_fds = engine->m_params.fds_per_process;
+
+	// Once the table is full, a process exits instead
+	if(engine->m_n_procs == engine->m_max_procs)
+	{
+		struct synthetic_proc* proc = random_proc(engine, true);
+		if(add_event(engine, proc->tid, PPME_PROCEXIT_1_E, 4, (int64_t)0, (int64_t)0, 0, 0) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+
+		// Move the last process in its slot, each slot keeps its own fd ring
+		struct synthetic_proc* last = &engine->m_procs[engine->m_n_procs - 1];
+		if(proc != last)
+		{
+			int64_t* fds = proc->fds;
+			memcpy(fds, last->fds, max_fds * sizeof(int64_t));
+			*proc = *last;
+			proc->fds = fds;
+		}
+		engine->m_n_procs--;
+		return SCAP_SUCCESS;
+	}
+
+	struct synthetic_proc* parent = random_proc(engine, false);
+	struct synthetic_proc* child = &engine->m_procs[engine->m_n_procs];
+
+	// The child inherits the fds and the command of its parent
+	int64_t* fds = child->fds;
+	memcpy(fds, parent->fds, max_fds * sizeof(int64_t));
+	*child = *parent;
+	child->fds = fds;
+	child->tid = engine->m_next_tid++;
+	child->ptid = parent->tid;
+	engine->m_n_procs++;
+
+	if(add_event(engine, parent->tid, PPME_SYSCALL_CLONE_20_E, 0) != SCAP_SUCCESS ||
+	   add_clone_exit(engine, parent->tid, child->tid, parent) != SCAP_SUCCESS ||
+	   add_clone_exit(engine, child->tid, 0, child) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+	return SCAP_SUCCESS;
+}
+
+static int32_t exec_action(synthetic_engine* engine)
+{
+	struct synthetic_proc* proc = random_proc(engine, true);
+	proc->cmd = rand_below(engine, N_COMMANDS);
+
+	struct scap_const_sized_buffer args = {
+		.buf = g_commands[proc->cmd].args,
+		.size = strlen(g_commands[proc->cmd].args) + 1,
+	};
+	struct scap_const_sized_buffer cgroups = {.buf = g_cgroups, .size = sizeof(g_cgroups)};
+	struct scap_const_sized_buffer env = {.buf = g_env, .size = sizeof(g_env)};
+
+	if(add_event(engine, proc->tid, PPME_SYSCALL_EXECVE_19_E, 1, g_commands[proc->cmd].exepath) != SCAP_SUCCESS ||
+	   add_event(engine, proc->tid, PPME_SYSCALL_EXECVE_19_X, 27, (int64_t)0, g_commands[proc->cmd].comm, args,
+		     proc->tid, proc->tid, proc->ptid, "/", (uint64_t)1024, (uint64_t)0, (uint64_t)0,
+		     (uint32_t)0, (uint32_t)0, (uint32_t)0, g_commands[proc->cmd].comm, cgroups, env,
+		     (uint32_t)0, proc->tid, (uint32_t)-1, (uint32_t)0, (uint64_t)0, (uint64_t)0, (uint64_t)0,
+		     (uint64_t)(2000 + proc->cmd), SYNTHETIC_BASE_TS, SYNTHETIC_BASE_TS, (uint32_t)0) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+	return SCAP_SUCCESS;
+}
+
+static int32_t generate_burst(synthetic_engine* engine)
+{
+	const struct scap_synthetic_engine_params* params = &engine->m_params;
+	uint32_t r = rand_below(engine, engine->m_total_weight);
+
+	engine->m_buf_used = 0;
+	engine->m_burst_len = 0;
+	engine->m_burst_next = 0;
+
+	if(r < params->file_weight)
+	{
+		return file_action(engine);
+	}
+	r -= params->file_weight;
+	if(r < params->net_weight)
+	{
+		return net_action(engine);
+	}
+	r -= params->net_weight;
+	if(r < params->clone_weight)
+	{
+		return clone_action(engine);
+	}
+	return exec_action(engine);
+}
+
+static int32_t next(struct scap_engine_handle handle, scap_evt** pevent, uint16_t* pcpuid)
+{
+	synthetic_engine *engine = handle.m_handle;
+	uint64_t max_events = engine->m_params.max_events;
+	uint64_t events_per_sec = engine->m_params.events_per_sec;
+
+	if(max_events != 0 && engine->m_n_evts >= max_events)
+	{
+		return SCAP_EOF;
+	}
+
+	if(events_per_sec != 0 && engine->m_n_evts >= engine->m_allowed_evts)
+	{
+		uint64_t now = monotonic_ns();
+		if(engine->m_start_ns == 0)
+		{
+			engine->m_start_ns = now;
+		}
+		engine->m_allowed_evts = (uint64_t)((double)(now - engine->m_start_ns) * events_per_sec / 1000000000.0) + 1;
+		if(engine->m_n_evts >= engine->m_allowed_evts)
+		{
+			return SCAP_TIMEOUT;
+		}
+	}
+
+	if(engine->m_burst_next == engine->m_burst_len)
+	{
+		int32_t res = generate_burst(engine);
+		if(res != SCAP_SUCCESS)
+		{
+			return res;
+		}
+	}
+
+	scap_evt* evt = (scap_evt*)(engine->m_buf + engine->m_burst[engine->m_burst_next++]);
+	evt->ts = engine->m_ts;
+	engine->m_ts += engine->m_ts_step;
+	engine->m_n_evts++;
+
+	*pevent = evt;
+	/* All the events are sent by CPU 1 */
+	*pcpuid = 1;
+	return SCAP_SUCCESS;
+}
+
+static int32_t get_stats(struct scap_engine_handle handle, scap_stats* stats)
+{
+	synthetic_engine *engine = handle.m_handle;
+	stats->n_evts = engine->m_n_evts;
+	return SCAP_SUCCESS;
+}
+
+static int32_t get_threadinfos(struct scap_engine_handle handle, uint64_t *n, const scap_threadinfo **tinfos)
+{
+	synthetic_engine *engine = handle.m_handle;
+
+	*tinfos = engine->m_tinfos;
+	*n = engine->m_n_tinfos;
+
+	return SCAP_SUCCESS;
+}
+
+static int32_t get_fdinfos(struct scap_engine_handle handle, const scap_threadinfo *tinfo, uint64_t *n, const scap_fdinfo **fdinfos)
+{
+	// The processes start without fds, they are all created by the events
+	*fdinfos = NULL;
+	*n = 0;
+	return SCAP_SUCCESS;
+}
+
+static void init_threadinfo(scap_threadinfo* tinfo, const struct synthetic_proc* proc, const char* comm, const char* exepath, const char* args)
+{
+	size_t args_len = strlen(args) + 1;
+
+	tinfo->tid = proc->tid;
+	tinfo->pid = proc->tid;
+	tinfo->ptid = proc->ptid;
+	tinfo->sid = proc->tid;
+	tinfo->vpgid = proc->tid;
+	tinfo->vtid = proc->tid;
+	tinfo->vpid = proc->tid;
+	strlcpy(tinfo->comm, comm, sizeof(tinfo->comm));
+	strlcpy(tinfo->exe, comm, sizeof(tinfo->exe));
+	strlcpy(tinfo->exepath, exepath, sizeof(tinfo->exepath));
+	memcpy(tinfo->args, args, args_len);
+	tinfo->args_len = args_len;
+	strlcpy(tinfo->cwd, "/", sizeof(tinfo->cwd));
+	strlcpy(tinfo->root, "/", sizeof(tinfo->root));
+	memcpy(tinfo->cgroups, g_cgroups, sizeof(g_cgroups));
+	tinfo->cgroups_len = sizeof(g_cgroups);
+	tinfo->fdlimit = 1024;
+	tinfo->loginuid = -1;
+	tinfo->clone_ts = SYNTHETIC_BASE_TS;
+}
+
+static int32_t init(scap_t* main_handle, scap_open_args* oargs)
+{
+	synthetic_engine *engine = main_handle->m_engine.m_handle;
+	struct scap_synthetic_engine_params *params = oargs->engine_params;
+
+	if(params == NULL)
+	{
+		strlcpy(engine->m_lasterr, "No synthetic engine params provided", SCAP_LASTERR_SIZE);
+		return SCAP_FAILURE;
+	}
+
+	engine->m_params = *params;
+	params = &engine->m_params;
+	if(params->n_processes == 0)
+	{
+		params->n_processes = SYNTHETIC_DEFAULT_N_PROCESSES;
+	}
+	if(params->fds_per_process == 0)
+	{
+		params->fds_per_process = SYNTHETIC_DEFAULT_FDS_PER_PROCESS;
+	}
+	if(params->file_weight == 0 && params->net_weight == 0 && params->clone_weight == 0 && params->exec_weight == 0)
+	{
+		params->file_weight = SYNTHETIC_DEFAULT_FILE_WEIGHT;
+		params->net_weight = SYNTHETIC_DEFAULT_NET_WEIGHT;
+		params->clone_weight = SYNTHETIC_DEFAULT_CLONE_WEIGHT;
+		params->exec_weight = SYNTHETIC_DEFAULT_EXEC_WEIGHT;
+	}
+	engine->m_total_weight = params->file_weight + params->net_weight + params->clone_weight + params->exec_weight;
+
+	// Scramble the seed, xorshift never leaves 0
+	engine->m_rng = (params->seed + 1) * 0x9E3779B97F4A7C15ULL;
+	if(engine->m_rng == 0)
+	{
+		engine->m_rng = 0x9E3779B97F4A7C15ULL;
+	}
+
+	// init, the initial processes, and as many clones
+	engine->m_n_procs = params->n_processes + 1;
+	engine->m_max_procs = 2 * params->n_processes + 1;
+	engine->m_next_tid = SYNTHETIC_FIRST_TID + params->n_processes;
+
+	engine->m_procs = calloc(engine->m_max_procs, sizeof(struct synthetic_proc));
+	engine->m_fds = calloc((size_t)engine->m_max_procs * params->fds_per_process, sizeof(int64_t));
+	engine->m_tinfos = calloc(engine->m_n_procs, sizeof(scap_threadinfo));
+	engine->m_buf = malloc(SYNTHETIC_BUF_SIZE);
+	if(engine->m_procs == NULL || engine->m_fds == NULL || engine->m_tinfos == NULL || engine->m_buf == NULL)
+	{
+		strlcpy(engine->m_lasterr, "error allocating the synthetic processes", SCAP_LASTERR_SIZE);
+		return SCAP_FAILURE;
+	}
+	engine->m_n_tinfos = engine->m_n_procs;
+
+	for(uint32_t j = 0; j < engine->m_max_procs; j++)
+	{
+		struct synthetic_proc* proc = &engine->m_procs[j];
+		proc->fds = &engine->m_fds[(size_t)j * params->fds_per_process];
+		if(j >= engine->m_n_procs)
+		{
+			continue;
+		}
+
+		proc->next_fd = 3;
+		if(j == 0)
+		{
+			proc->tid = SYNTHETIC_INIT_TID;
+			proc->ptid = 0;
+			init_threadinfo(&engine->m_tinfos[j], proc, "init", "/sbin/init", "");
+		}
+		else
+		{
+			proc->tid = SYNTHETIC_FIRST_TID + j - 1;
+			proc->ptid = SYNTHETIC_INIT_TID;
+			proc->cmd = (j - 1) % N_COMMANDS;
+			init_threadinfo(&engine->m_tinfos[j], proc, g_commands[proc->cmd].comm,
+					g_commands[proc->cmd].exepath, g_commands[proc->cmd].args);
+		}
+	}
+
+	engine->m_ts = SYNTHETIC_BASE_TS;
+	engine->m_ts_step = SYNTHETIC_DEFAULT_TS_STEP;
+	if(params->events_per_sec != 0)
+	{
+		engine->m_ts_step = 1000000000ULL / params->events_per_sec;
+		if(engine->m_ts_step == 0)
+		{
+			engine->m_ts_step = 1;
+		}
+	}
+
+	return SCAP_SUCCESS;
+}
+
+const struct scap_vtable scap_synthetic_engine = {
+	.name = SYNTHETIC_ENGINE,
+	.mode = SCAP_MODE_TEST,
+	.savefile_ops = NULL,
+
+	.alloc_handle = alloc_handle,
+	.init = init,
+	.free_handle = free_handle,
+	.close = noop_close_engine,
+	.next = next,
+	.start_capture = noop_start_capture,
+	.stop_capture = noop_stop_capture,
+	.configure = noop_configure,
+	.get_stats = get_stats,
+	.get_stats_v2 = noop_get_stats_v2,
+	.get_n_tracepoint_hit = noop_get_n_tracepoint_hit,
+	.get_n_devs = noop_get_n_devs,
+	.get_max_buf_used = noop_get_max_buf_used,
+	.get_threadlist = noop_get_threadlist,
+	.get_threadinfos = get_threadinfos,
+	.get_fdinfos = get_fdinfos,
+	.get_vpid = noop_get_vxid,
+	.get_vtid = noop_get_vxid,
+	.getpid_global = noop_getpid_global,
+	.get_api_version = NULL,
+	.get_schema_version = NULL,
+};
@@ -0,0 +1,46 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#define SYNTHETIC_ENGINE "synthetic"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/*!
+	  \brief Parameters of the synthetic engine, generating a mix of events
+	  without a driver, e.g. to load test the consumers. The zero values pick
+	  the defaults.
+	*/
+	struct scap_synthetic_engine_params
+	{
+		uint64_t seed; ///< The same seed and parameters always generate the same events.
+		uint64_t max_events; ///< Events generated before returning SCAP_EOF, 0 to never stop.
+		uint64_t events_per_sec; ///< SCAP_TIMEOUT is returned when ahead of this rate, 0 to generate as fast as possible.
+		uint32_t n_processes; ///< Processes running at open, the clones can double them. Default 64.
+		uint32_t fds_per_process; ///< Open fds of a process before it closes the oldest one. Default 16.
+		// Relative weights of the workloads, all 0 for the default mix
+		uint32_t file_weight; ///< Fd churn: open, read, write, close.
+		uint32_t net_weight; ///< Connections: socket, connect, write, close.
+		uint32_t clone_weight; ///< Process trees: clone, or exit of a process once the table is full.
+		uint32_t exec_weight; ///< Exec storms: execve of a random command.
+	};
+
+#ifdef __cplusplus
+};
+#endif
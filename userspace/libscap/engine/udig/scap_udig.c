@@ -8,6 +8,10 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #define SCAP_HANDLE_T struct udig_engine
 
@@ -26,22 +30,44 @@
 int ud_shm_open(const char *name, int flag, mode_t mode);
 #endif
 
+static void udig_shm_name(char* name, size_t size, const char* base, uint32_t ring_idx)
+{
+	if(ring_idx == 0)
+	{
+		strlcpy(name, base, size);
+	}
+	else
+	{
+		snprintf(name, size, "%s_%u", base, ring_idx);
+	}
+}
+
+static long udig_futex(volatile uint32_t* uaddr, int op, uint32_t val, const struct timespec* timeout)
+{
+	// Not FUTEX_PRIVATE_FLAG: the word is shared between processes
+	return syscall(SYS_futex, uaddr, op, val, timeout, NULL, 0);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // The following 2 function map the ring buffer and the ring buffer 
 // descriptors into the address space of this process.
 // This is the buffer that will be consumed by scap.
 ///////////////////////////////////////////////////////////////////////////////
-int32_t udig_alloc_ring(void* ring_id, 
+int32_t udig_alloc_ring_idx(uint32_t ring_idx,
+	void* ring_id, 
 	uint8_t** ring, 
 	unsigned long *ringsize,
 	char *error)
 {
 	int* ring_fd = (int*)ring_id;
+	char name[NAME_MAX];
+
+	udig_shm_name(name, sizeof(name), UDIG_RING_SM_FNAME, ring_idx);
 
 	//
 	// First, try to open an existing ring
 	//
-	*ring_fd = ud_shm_open(UDIG_RING_SM_FNAME, O_RDWR, 0);
+	*ring_fd = ud_shm_open(name, O_RDWR, 0);
 	if(*ring_fd >= 0)
 	{
 		//
@@ -65,7 +91,7 @@ int32_t udig_alloc_ring(void* ring_id,
 		//
 		*ringsize = UDIG_RING_SIZE;
 
-		*ring_fd = ud_shm_open(UDIG_RING_SM_FNAME, O_CREAT | O_RDWR, 
+		*ring_fd = ud_shm_open(name, O_CREAT | O_RDWR, 
 			S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
 		if(*ring_fd >= 0)
 		{
@@ -138,26 +164,65 @@ int32_t udig_alloc_ring(void* ring_id,
 	return SCAP_SUCCESS;
 }
 
-int32_t udig_alloc_ring_descriptors(void* ring_descs_id, 
+int32_t udig_alloc_ring(void* ring_id, 
+	uint8_t** ring, 
+	unsigned long *ringsize,
+	char *error)
+{
+	return udig_alloc_ring_idx(0, ring_id, ring, ringsize, error);
+}
+
+int32_t udig_alloc_ring_descriptors_idx(uint32_t ring_idx,
+	void* ring_descs_id, 
 	struct ppm_ring_buffer_info** ring_info, 
 	struct udig_ring_buffer_status** ring_status,
 	char *error)
 {
 	int* ring_descs_fd = (int*)ring_descs_id;
 	uint32_t mem_size = sizeof(struct ppm_ring_buffer_info) + sizeof(struct udig_ring_buffer_status);
+	char name[NAME_MAX];
+
+	udig_shm_name(name, sizeof(name), UDIG_RING_DESCS_SM_FNAME, ring_idx);
 
 	//
 	// First, try to open an existing ring
 	//
-	*ring_descs_fd = ud_shm_open(UDIG_RING_DESCS_SM_FNAME, O_RDWR, 0);
-	if(*ring_descs_fd < 0)
+	*ring_descs_fd = ud_shm_open(name, O_RDWR, 0);
+	if(*ring_descs_fd >= 0)
+	{
+		//
+		// Descriptors created by an older producer are shorter than ours,
+		// extend them (the new fields are zeroed).
+		//
+		struct stat rstat;
+		if(fstat(*ring_descs_fd, &rstat) == 0 && rstat.st_size < mem_size &&
+			ftruncate(*ring_descs_fd, mem_size) < 0)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "udig_alloc_ring_descriptors ftruncate error: %s\n", strerror(errno));
+			close(*ring_descs_fd);
+			return SCAP_FAILURE;
+		}
+	}
+	else
 	{
 		//
 		// No existing ring file found in /dev/shm, create a new one.
 		//
-		*ring_descs_fd = ud_shm_open(UDIG_RING_DESCS_SM_FNAME, O_CREAT | O_RDWR | O_EXCL, 
+		*ring_descs_fd = ud_shm_open(name, O_CREAT | O_RDWR | O_EXCL, 
 				S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
-		if(*ring_descs_fd >= 0)
+		if(*ring_descs_fd < 0 && errno == EEXIST)
+		{
+			//
+			// Another process created it in the meantime
+			//
+			*ring_descs_fd = ud_shm_open(name, O_RDWR, 0);
+			if(*ring_descs_fd < 0)
+			{
+				snprintf(error, SCAP_LASTERR_SIZE, "udig_alloc_ring_descriptors shm_open error: %s\n", strerror(errno));
+				return SCAP_FAILURE;
+			}
+		}
+		else if(*ring_descs_fd >= 0)
 		{
 			//
 			// For some reason, shm_open doesn't always set the write flag for
@@ -172,14 +237,14 @@ int32_t udig_alloc_ring_descriptors(void* ring_descs_id,
 			{
 				snprintf(error, SCAP_LASTERR_SIZE, "udig_alloc_ring_descriptors ftruncate error: %s\n", strerror(errno));
 				close(*ring_descs_fd);
-				shm_unlink(UDIG_RING_DESCS_SM_FNAME);
+				shm_unlink(name);
 				return SCAP_FAILURE;
 			}
 		}
 		else
 		{
 			snprintf(error, SCAP_LASTERR_SIZE, "udig_alloc_ring_descriptors shm_open error: %s\n", strerror(errno));
-			shm_unlink(UDIG_RING_DESCS_SM_FNAME);
+			shm_unlink(name);
 			return SCAP_FAILURE;
 		}
 	}
@@ -222,6 +287,14 @@ int32_t udig_alloc_ring_descriptors(void* ring_descs_id,
 	return SCAP_SUCCESS;
 }
 
+int32_t udig_alloc_ring_descriptors(void* ring_descs_id, 
+	struct ppm_ring_buffer_info** ring_info, 
+	struct udig_ring_buffer_status** ring_status,
+	char *error)
+{
+	return udig_alloc_ring_descriptors_idx(0, ring_descs_id, ring_info, ring_status, error);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // These 2 function free the ring buffer and the ring buffer descriptors.
 ///////////////////////////////////////////////////////////////////////////////
@@ -237,6 +310,147 @@ void udig_free_ring_descriptors(uint8_t* addr)
 	munmap(addr, mem_size);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Producer helpers.
+// Any number of processes and threads can write to the same ring without
+// locks: each event first reserves its space moving m_reserve_head with a CAS,
+// then it's published moving the ring head, in the same order of the
+// reservations, so that the consumer only ever sees complete events.
+///////////////////////////////////////////////////////////////////////////////
+static uint32_t udig_get_n_rings(struct udig_ring_buffer_status* first_status)
+{
+	uint32_t n = __atomic_load_n(&first_status->m_n_rings, __ATOMIC_ACQUIRE);
+	return n == 0 ? 1 : n;
+}
+
+/*
+ * Picks the ring of a process attaching to the capture, adding a new one
+ * every UDIG_PROCS_PER_RING processes, up to UDIG_MAX_RINGS.
+ */
+int32_t udig_attach_ring(struct udig_ring_buffer_status* first_status, uint32_t* ring_idx, char *error)
+{
+	uint32_t nattached = __atomic_add_fetch(&first_status->m_n_attached, 1, __ATOMIC_RELAXED);
+	uint32_t wanted = (nattached + UDIG_PROCS_PER_RING - 1) / UDIG_PROCS_PER_RING;
+	uint32_t nrings = udig_get_n_rings(first_status);
+
+	if(wanted > UDIG_MAX_RINGS)
+	{
+		wanted = UDIG_MAX_RINGS;
+	}
+
+	while(nrings < wanted)
+	{
+		//
+		// Create the next ring, unless another producer is doing the same,
+		// and make it visible to the others only when it's complete.
+		//
+		int fd;
+		int descs_fd;
+		uint8_t* ring;
+		unsigned long ringsize;
+		struct ppm_ring_buffer_info* rbi;
+		struct udig_ring_buffer_status* rbs;
+
+		if(udig_alloc_ring_idx(nrings, &fd, &ring, &ringsize, error) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+		udig_free_ring(ring, ringsize * 2);
+		close(fd);
+
+		if(udig_alloc_ring_descriptors_idx(nrings, &descs_fd, &rbi, &rbs, error) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+		udig_free_ring_descriptors((uint8_t*)rbi);
+		close(descs_fd);
+
+		uint32_t cur = __atomic_load_n(&first_status->m_n_rings, __ATOMIC_RELAXED);
+		if(cur == 0 || cur == nrings)
+		{
+			__sync_bool_compare_and_swap(&first_status->m_n_rings, cur, nrings + 1);
+		}
+		nrings = udig_get_n_rings(first_status);
+	}
+
+	*ring_idx = (nattached - 1) % nrings;
+	return SCAP_SUCCESS;
+}
+
+/*
+ * Reserves len bytes for an event. Returns the offset where the event must be
+ * written, or -1 if the ring is full, in which case the drop is counted.
+ * Since the ring is mapped twice, the event can be written past its end.
+ */
+int64_t udig_ring_reserve(struct ppm_ring_buffer_info* ring_info, struct udig_ring_buffer_status* ring_status, uint32_t ringsize, uint32_t len)
+{
+	uint32_t head = __atomic_load_n(&ring_status->m_reserve_head, __ATOMIC_RELAXED);
+
+	while(true)
+	{
+		uint32_t tail = __atomic_load_n(&ring_info->tail, __ATOMIC_ACQUIRE);
+		uint32_t used = head >= tail ? head - tail : ringsize - tail + head;
+		uint32_t next;
+
+		//
+		// Keep one byte free, otherwise a full ring would look empty
+		//
+		if(used + len >= ringsize)
+		{
+			__atomic_add_fetch(&ring_info->n_drops_buffer, 1, __ATOMIC_RELAXED);
+			return -1;
+		}
+
+		next = head + len;
+		if(next >= ringsize)
+		{
+			next -= ringsize;
+		}
+
+		if(__atomic_compare_exchange_n(&ring_status->m_reserve_head, &head, next, true,
+			__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		{
+			return head;
+		}
+	}
+}
+
+/*
+ * Publishes an event written at the offset returned by udig_ring_reserve(),
+ * waking up the consumer if it's waiting for events.
+ */
+void udig_ring_commit(struct ppm_ring_buffer_info* ring_info, struct udig_ring_buffer_status* first_status, uint32_t ringsize, uint32_t pos, uint32_t len)
+{
+	uint32_t next = pos + len;
+	if(next >= ringsize)
+	{
+		next -= ringsize;
+	}
+
+	//
+	// Wait for the events reserved before this one to be published.
+	// They are being written right now, so this is short.
+	//
+	while(__atomic_load_n(&ring_info->head, __ATOMIC_ACQUIRE) != pos)
+	{
+		sched_yield();
+	}
+
+	__atomic_add_fetch(&ring_info->n_evts, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&ring_info->head, next, __ATOMIC_SEQ_CST);
+
+	//
+	// Only the first producer that sees the consumer waiting wakes it up,
+	// the others don't pay for the syscall.
+	//
+	if(__atomic_load_n(&first_status->m_consumer_waiting, __ATOMIC_SEQ_CST) &&
+		__atomic_exchange_n(&first_status->m_consumer_waiting, 0, __ATOMIC_SEQ_CST))
+	{
+		__atomic_add_fetch(&first_status->m_wakeup_seq, 1, __ATOMIC_SEQ_CST);
+		udig_futex(&first_status->m_wakeup_seq, FUTEX_WAKE, 1, NULL);
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Capture control helpers.
 ///////////////////////////////////////////////////////////////////////////////
@@ -303,11 +517,17 @@ int32_t udig_begin_capture(struct scap_engine_handle engine, char *error)
 		}
 	}
 
-	struct ppm_ring_buffer_info* rbi = dev->m_bufinfo;
-	rbi->head = 0;
-	rbi->tail = 0;
-	rbi->n_evts = 0;
-	rbi->n_drops_buffer = 0;
+	uint32_t j;
+	for(j = 0; j < engine.m_handle->m_dev_set.m_ndevs; j++)
+	{
+		struct scap_device *ring = &engine.m_handle->m_dev_set.m_devs[j];
+		struct ppm_ring_buffer_info* rbi = ring->m_bufinfo;
+		rbi->head = 0;
+		rbi->tail = 0;
+		rbi->n_evts = 0;
+		rbi->n_drops_buffer = 0;
+		ring->m_bufstatus->m_reserve_head = 0;
+	}
 
 	if(acquire_and_init_ring_status_buffer(dev))
 	{
@@ -374,10 +594,16 @@ int32_t udig_start_dropping_mode(struct scap_engine_handle engine, uint32_t samp
 void scap_close_udig(struct scap_engine_handle engine)
 {
 	struct udig_engine *handle = engine.m_handle;
+	uint32_t j;
 
-	devset_close_device(&handle->m_dev_set.m_devs[0]);
+	for(j = 0; j < handle->m_dev_set.m_ndevs; j++)
+	{
+		devset_close_device(&handle->m_dev_set.m_devs[j]);
+	}
 	free(handle->m_dev_set.m_devs);
 	handle->m_dev_set.m_devs = NULL;
+	free(handle->m_dev_set.m_heap);
+	handle->m_dev_set.m_heap = NULL;
 }
 
 static int close_engine(struct scap_engine_handle engine)
@@ -388,9 +614,81 @@ static int close_engine(struct scap_engine_handle engine)
 	return SCAP_SUCCESS;
 }
 
+static int32_t scap_udig_alloc_dev(struct scap_device* dev, uint32_t ring_idx, char* error);
+
+//
+// Map the rings added by the producers since the last check
+//
+static int32_t udig_add_rings(struct udig_engine* handle)
+{
+	struct scap_device_set *devset = &handle->m_dev_set;
+	uint32_t nrings = udig_get_n_rings(devset->m_devs[0].m_bufstatus);
+
+	while(devset->m_ndevs < nrings)
+	{
+		uint32_t idx = devset->m_ndevs;
+		int32_t res = devset_grow(devset, idx + 1);
+		if(res != SCAP_SUCCESS)
+		{
+			return res;
+		}
+
+		res = scap_udig_alloc_dev(&devset->m_devs[idx], idx, handle->m_lasterr);
+		if(res != SCAP_SUCCESS)
+		{
+			devset_close_device(&devset->m_devs[idx]);
+			devset->m_ndevs = idx;
+			return res;
+		}
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Wakeup mode: sleep on the futex of the first ring until a producer publishes
+// an event. The flag is set before checking the rings once more, so that an
+// event published in the meantime either is seen here or wakes us up.
+//
+static bool udig_wait_for_events(struct scap_device_set *devset, int timeout_ms)
+{
+	struct udig_ring_buffer_status* rbs = devset->m_devs[0].m_bufstatus;
+	uint32_t seq = __atomic_load_n(&rbs->m_wakeup_seq, __ATOMIC_SEQ_CST);
+	struct timespec ts;
+
+	__atomic_store_n(&rbs->m_consumer_waiting, 1, __ATOMIC_SEQ_CST);
+	if(are_buffers_empty(devset))
+	{
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+		udig_futex(&rbs->m_wakeup_seq, FUTEX_WAIT, seq, &ts);
+	}
+	__atomic_store_n(&rbs->m_consumer_waiting, 0, __ATOMIC_SEQ_CST);
+	return false;
+}
+
 static int32_t next(struct scap_engine_handle engine, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
 {
-	return ringbuffer_next(&engine.m_handle->m_dev_set, pevent, pcpuid);
+	int32_t res = ringbuffer_next(&engine.m_handle->m_dev_set, pevent, pcpuid);
+
+	//
+	// The rings are refilled before a timeout, a good time to look for new ones
+	//
+	if(res == SCAP_TIMEOUT)
+	{
+		int32_t rc = udig_add_rings(engine.m_handle);
+		if(rc != SCAP_SUCCESS)
+		{
+			return rc;
+		}
+	}
+
+	return res;
+}
+
+static scap_evt* peek(struct scap_engine_handle engine, uint16_t cpuid, uint32_t distance)
+{
+	return ringbuffer_peek(&engine.m_handle->m_dev_set, cpuid, distance);
 }
 
 //
@@ -472,6 +770,13 @@ static int32_t configure(struct scap_engine_handle engine, enum scap_setting set
 	case SCAP_DYNAMIC_SNAPLEN:
 	case SCAP_STATSD_PORT:
 	case SCAP_FULLCAPTURE_PORT_RANGE:
+	case SCAP_SUPPRESSED_COMMS:
+	case SCAP_SUPPRESSED_TID:
+	case SCAP_FD_TYPE_SNAPLEN:
+	case SCAP_SYSCALL_LIMIT:
+	case SCAP_BUFFER_SNAPLEN:
+	case SCAP_CGROUP_FILTER_MODE:
+	case SCAP_CGROUP_FILTER:
 		// the original code blindly tries a kmod-only ioctl
 		// which can only fail. Let's return a better error code instead
 		return SCAP_NOT_SUPPORTED;
@@ -499,12 +804,12 @@ static void free_handle(struct scap_engine_handle engine)
 	free(engine.m_handle);
 }
 
-static int32_t scap_udig_alloc_dev(struct scap_device* dev, char* error)
+static int32_t scap_udig_alloc_dev(struct scap_device* dev, uint32_t ring_idx, char* error)
 {
 	//
 	// Map the ring buffer.
 	//
-	if(udig_alloc_ring(
+	if(udig_alloc_ring_idx(ring_idx,
 		&dev->m_fd,
 		(uint8_t**)&dev->m_buffer,
 		&dev->m_buffer_size,
@@ -523,7 +828,7 @@ static int32_t scap_udig_alloc_dev(struct scap_device* dev, char* error)
 	//
 	// Map the ppm_ring_buffer_info that contains the buffer pointers
 	//
-	if(udig_alloc_ring_descriptors(
+	if(udig_alloc_ring_descriptors_idx(ring_idx,
 		&dev->m_bufinfo_fd,
 		&dev->m_bufinfo,
 		&dev->m_bufstatus,
@@ -531,23 +836,38 @@ static int32_t scap_udig_alloc_dev(struct scap_device* dev, char* error)
 	{
 		return SCAP_FAILURE;
 	}
+	dev->m_bufinfo_size = sizeof(struct ppm_ring_buffer_info) + sizeof(struct udig_ring_buffer_status);
 
 	return SCAP_SUCCESS;
 }
 
-/* `oargs` is not used here but we need to keep it to fit v-table interface. */
+/* `oargs` is only used to configure the device set. */
 static int32_t init(scap_t* main_handle, scap_open_args* oargs)
 {
 	struct udig_engine *handle = main_handle->m_engine.m_handle;
 	int rc;
 
-	rc = devset_init(&handle->m_dev_set, 1, handle->m_lasterr);
+	rc = devset_init(&handle->m_dev_set, 1, oargs, handle->m_lasterr);
 	if(rc != SCAP_SUCCESS)
 	{
 		return rc;
 	}
 
-	return scap_udig_alloc_dev(&handle->m_dev_set.m_devs[0], handle->m_lasterr);
+	rc = scap_udig_alloc_dev(&handle->m_dev_set.m_devs[0], 0, handle->m_lasterr);
+	if(rc != SCAP_SUCCESS)
+	{
+		return rc;
+	}
+
+	if(handle->m_dev_set.m_wakeup)
+	{
+		handle->m_dev_set.m_wait_fn = udig_wait_for_events;
+	}
+
+	//
+	// Map the rings the producers already added
+	//
+	return udig_add_rings(handle);
 }
 
 static uint32_t get_n_devs(struct scap_engine_handle engine)
@@ -582,6 +902,7 @@ const struct scap_vtable scap_udig_engine = {
 	.free_handle = free_handle,
 	.close = close_engine,
 	.next = next,
+	.peek = peek,
 	.start_capture = start_capture,
 	.stop_capture = stop_capture,
 	.configure = configure,
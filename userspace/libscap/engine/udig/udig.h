@@ -24,6 +24,10 @@ limitations under the License.
 #define UDIG_RING_SM_FNAME "udig_buf"
 #define UDIG_RING_DESCS_SM_FNAME "udig_descs"
 #define UDIG_RING_SIZE (8 * 1024 * 1024)
+// The rings after the first one are named after their index, e.g. udig_buf_1
+#define UDIG_MAX_RINGS 64
+// A new ring is added every time this many processes attached to the existing ones
+#define UDIG_PROCS_PER_RING 16
 
 struct scap;
 
@@ -50,8 +54,38 @@ struct udig_ring_buffer_status
 	volatile int m_stopped;
 	volatile struct timespec m_last_print_time;
 	struct udig_consumer_t m_consumer;
+	//
+	// The fields below come after the ones used by the older producers,
+	// which must keep their layout.
+	//
+	// Producers reserve the space of their events moving m_reserve_head,
+	// then publish them moving the ring head in the same order
+	// (see udig_ring_reserve() and udig_ring_commit()).
+	volatile uint32_t m_reserve_head;
+	// The following ones are only used in the status of the first ring:
+	// - number of rings the producers can write to, 0 means 1
+	volatile uint32_t m_n_rings;
+	// - number of processes that attached to the rings
+	volatile uint32_t m_n_attached;
+	// - futex word bumped by the producers to wake up the consumer
+	//   while m_consumer_waiting is set
+	volatile uint32_t m_wakeup_seq;
+	volatile uint32_t m_consumer_waiting;
 };
 
+//
+// Producer side of the rings, used by the instrumenters.
+// A process attaching to the capture gets its ring from udig_attach_ring()
+// and maps it with udig_alloc_ring_idx() and udig_alloc_ring_descriptors_idx().
+// Each event is written at the offset returned by udig_ring_reserve(), which
+// never blocks, and then published with udig_ring_commit().
+//
+int32_t udig_alloc_ring_idx(uint32_t ring_idx, void* ring_id, uint8_t** ring, unsigned long *ringsize, char *error);
+int32_t udig_alloc_ring_descriptors_idx(uint32_t ring_idx, void* ring_descs_id, struct ppm_ring_buffer_info** ring_info, struct udig_ring_buffer_status** ring_status, char *error);
+int32_t udig_attach_ring(struct udig_ring_buffer_status* first_status, uint32_t* ring_idx, char *error);
+int64_t udig_ring_reserve(struct ppm_ring_buffer_info* ring_info, struct udig_ring_buffer_status* ring_status, uint32_t ringsize, uint32_t len);
+void udig_ring_commit(struct ppm_ring_buffer_info* ring_info, struct udig_ring_buffer_status* first_status, uint32_t ringsize, uint32_t pos, uint32_t len);
+
 struct udig_engine
 {
 	struct scap_device_set m_dev_set;
@@ -21,6 +21,8 @@ limitations under the License.
 #include <scap.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 #include "strlcpy.h"
 
 #define SYSCALL_NAME_MAX_LEN 40
@@ -40,7 +42,26 @@ limitations under the License.
 #define SIMPLE_SET_OPTION "--simple_set"
 #define CPUS_FOR_EACH_BUFFER_MODE "--cpus_for_buf"
 #define ALL_AVAILABLE_CPUS_MODE "--available_cpus"
+#define NUMA_AWARE_MODE "--numa_aware"
 #define DROP_FAILED "--drop-failed"
+#define HEAP_MERGE_OPTION "--heap_merge"
+#define CONSUME_CHUNK_OPTION "--consume_chunk"
+#define WAKEUP_OPTION "--wakeup"
+#define EMPTY_THRESHOLD_OPTION "--empty_threshold"
+#define EMPTY_WAIT_MAX_OPTION "--empty_wait_max"
+#define WAKEUP_WATERMARK_OPTION "--wakeup_watermark"
+
+/* PROFILING */
+#define PROFILE_OPTION "--profile"
+#define EVENT_COST_OPTION "--event_cost"
+#define SINSP_EVENT_COST "sinsp"
+/* Rough CPU time sinsp spends on an event with state and a default ruleset.
+ * `sinsp-example -J` reports it as `cpu_ns_per_event` for a given node.
+ */
+#define SINSP_EVENT_COST_NS 1500
+#define PROFILE_TOP_EVENT_TYPES 5
+#define PROFILE_BUFFERS_PER_LINE 16
+#define NS_PER_SEC ((uint64_t)1000000000)
 
 /* PRINT */
 #define PRINT_SYSCALLS_OPTION "--print_syscalls"
@@ -61,6 +82,8 @@ static int evt_type = -1;		  /* event type to print. */
 static bool ppm_sc_is_set = 0;
 static unsigned long buffer_bytes_dim = DEFAULT_DRIVER_BUFFER_BYTES_DIM;
 static bool drop_failed = false;
+static bool profile = false;
+static uint64_t event_cost_ns = 0; /* time spent on every event, 0 means consume as fast as possible. */
 
 static int simple_set[] = {
 	PPM_SC_ACCEPT,
@@ -156,6 +179,24 @@ static struct timeval tval_start, tval_end, tval_result;
 static unsigned long number_of_timeouts; /* Times in which there were no events in the buffer. */
 static unsigned long number_of_scap_next; /* Times in which the 'scap-next' method is called. */
 
+/* Profiling counters, the interval ones are reset at every report. */
+struct profile_counters
+{
+	uint64_t nevts;
+	uint64_t bytes;
+	uint64_t nevts_per_type[PPM_EVENT_MAX];
+};
+static struct profile_counters prof_interval;
+static struct profile_counters prof_total;
+static uint64_t* prof_nevts_per_cpu = NULL;
+static long prof_ncpus = 0;
+static uint64_t prof_start_ns;
+static uint64_t prof_last_report_ns;
+static scap_stats prof_last_stats;
+static uint64_t prof_peak_evts_per_sec;
+static uint64_t prof_peak_bytes_per_sec;
+static double prof_peak_fill;
+
 /*=============================== PRINT SUPPORTED SYSCALLS ===========================*/
 
 void print_sorted_syscalls(char string_vector[SYSCALL_TABLE_SIZE][SYSCALL_NAME_MAX_LEN], int dim)
@@ -520,6 +561,223 @@ void print_event(scap_evt* ev)
 
 /*=============================== PRINT EVENT PARAMS ===========================*/
 
+/*=============================== PROFILING ===========================*/
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+/* Keep the CPU busy for `event_cost_ns`, like a consumer doing real work on
+ * the event would.
+ */
+static void consume_event_cost()
+{
+	uint64_t deadline = monotonic_ns() + event_cost_ns;
+	while(monotonic_ns() < deadline)
+	{
+	}
+}
+
+void profile_init()
+{
+	prof_ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	if(prof_ncpus <= 0)
+	{
+		prof_ncpus = 1;
+	}
+	prof_nevts_per_cpu = calloc(prof_ncpus, sizeof(uint64_t));
+	if(prof_nevts_per_cpu == NULL)
+	{
+		fprintf(stderr, "Cannot allocate the profiling counters.\n");
+		exit(EXIT_FAILURE);
+	}
+	scap_get_stats(g_h, &prof_last_stats);
+	prof_start_ns = monotonic_ns();
+	prof_last_report_ns = prof_start_ns;
+}
+
+static inline void profile_event(scap_evt* ev, uint16_t cpuid)
+{
+	prof_interval.nevts++;
+	prof_interval.bytes += ev->len;
+	if(ev->type < PPM_EVENT_MAX)
+	{
+		prof_interval.nevts_per_type[ev->type]++;
+	}
+	if(cpuid < prof_ncpus)
+	{
+		prof_nevts_per_cpu[cpuid]++;
+	}
+}
+
+static const char* event_type_name(uint16_t type)
+{
+	return g_event_info[type].name;
+}
+
+static char event_type_dir(uint16_t type)
+{
+	return PPME_IS_ENTER(type) ? '>' : '<';
+}
+
+/* Print the rate of the `n` most frequent event types, in decreasing order. */
+static void print_top_event_types(const uint64_t* counters, uint32_t n, double secs)
+{
+	bool printed[PPM_EVENT_MAX] = {false};
+	for(uint32_t k = 0; k < n; k++)
+	{
+		int top = -1;
+		for(int type = 0; type < PPM_EVENT_MAX; type++)
+		{
+			if(!printed[type] && counters[type] != 0 && (top == -1 || counters[type] > counters[top]))
+			{
+				top = type;
+			}
+		}
+		if(top == -1)
+		{
+			break;
+		}
+		printed[top] = true;
+		printf(" %c%s(%d): %.0f/s", event_type_dir(top), event_type_name(top), top, counters[top] / secs);
+	}
+	printf("\n");
+}
+
+static void print_buffer_fill()
+{
+	uint32_t nstats;
+	int32_t rc;
+	const scap_stats_v2* stats_v2 = scap_get_stats_v2(g_h, PPM_SCAP_STATS_BUFFERS, &nstats, &rc);
+	if(stats_v2 == NULL || rc != SCAP_SUCCESS)
+	{
+		return;
+	}
+
+	/* Every `<prefix>_<n>.used_bytes` is followed by its `<prefix>_<n>.size_bytes` */
+	uint32_t nbufs = 0;
+	double sum = 0;
+	double max = 0;
+	for(uint32_t stat = 0; stat + 1 < nstats; stat++)
+	{
+		const char* used = strstr(stats_v2[stat].name, ".used_bytes");
+		if(used == NULL || strstr(stats_v2[stat + 1].name, ".size_bytes") == NULL || stats_v2[stat + 1].value.u64 == 0)
+		{
+			continue;
+		}
+		double fill = 100.0 * stats_v2[stat].value.u64 / stats_v2[stat + 1].value.u64;
+		if(nbufs % PROFILE_BUFFERS_PER_LINE == 0)
+		{
+			printf("%s  fill:", nbufs == 0 ? "" : "\n");
+		}
+		printf(" %.*s %.0f%%", (int)(used - stats_v2[stat].name), stats_v2[stat].name, fill);
+		sum += fill;
+		max = fill > max ? fill : max;
+		nbufs++;
+	}
+	if(nbufs == 0)
+	{
+		return;
+	}
+	printf("\n  fill avg: %.1f%%, max: %.1f%%\n", sum / nbufs, max);
+	prof_peak_fill = max > prof_peak_fill ? max : prof_peak_fill;
+}
+
+#define DROP_DELTA(field) (stats.field - prof_last_stats.field)
+
+static void print_drops()
+{
+	scap_stats stats = {0};
+	if(scap_get_stats(g_h, &stats) != SCAP_SUCCESS)
+	{
+		return;
+	}
+
+	printf("  drops: %lu (buffer: %lu, scratch_map: %lu, page faults: %lu, bug: %lu), preemptions: %lu\n",
+	       DROP_DELTA(n_drops), DROP_DELTA(n_drops_buffer), DROP_DELTA(n_drops_scratch_map),
+	       DROP_DELTA(n_drops_pf), DROP_DELTA(n_drops_bug), DROP_DELTA(n_preemptions));
+	if(DROP_DELTA(n_drops_buffer) != 0)
+	{
+		printf("  buffer drops (enter/exit): clone/fork %lu/%lu, execve %lu/%lu, connect %lu/%lu, open %lu/%lu, dir/file %lu/%lu, other %lu/%lu\n",
+		       DROP_DELTA(n_drops_buffer_clone_fork_enter), DROP_DELTA(n_drops_buffer_clone_fork_exit),
+		       DROP_DELTA(n_drops_buffer_execve_enter), DROP_DELTA(n_drops_buffer_execve_exit),
+		       DROP_DELTA(n_drops_buffer_connect_enter), DROP_DELTA(n_drops_buffer_connect_exit),
+		       DROP_DELTA(n_drops_buffer_open_enter), DROP_DELTA(n_drops_buffer_open_exit),
+		       DROP_DELTA(n_drops_buffer_dir_file_enter), DROP_DELTA(n_drops_buffer_dir_file_exit),
+		       DROP_DELTA(n_drops_buffer_other_interest_enter), DROP_DELTA(n_drops_buffer_other_interest_exit));
+	}
+	prof_last_stats = stats;
+}
+
+#undef DROP_DELTA
+
+void profile_report(uint64_t now)
+{
+	double secs = (double)(now - prof_last_report_ns) / NS_PER_SEC;
+	uint64_t evts_per_sec = prof_interval.nevts / secs;
+	uint64_t bytes_per_sec = prof_interval.bytes / secs;
+
+	printf("\n[PROFILE] %lus: %lu evts/s, %.2f MB/s\n", (now - prof_start_ns) / NS_PER_SEC,
+	       evts_per_sec, bytes_per_sec / (1024.0 * 1024.0));
+
+	printf("  evts/s per CPU:");
+	for(long cpu = 0; cpu < prof_ncpus; cpu++)
+	{
+		if(prof_nevts_per_cpu[cpu] != 0)
+		{
+			printf(" [%ld] %.0f", cpu, prof_nevts_per_cpu[cpu] / secs);
+		}
+	}
+	printf("\n");
+
+	print_buffer_fill();
+	print_drops();
+
+	printf("  top types:");
+	print_top_event_types(prof_interval.nevts_per_type, PROFILE_TOP_EVENT_TYPES, secs);
+
+	prof_peak_evts_per_sec = evts_per_sec > prof_peak_evts_per_sec ? evts_per_sec : prof_peak_evts_per_sec;
+	prof_peak_bytes_per_sec = bytes_per_sec > prof_peak_bytes_per_sec ? bytes_per_sec : prof_peak_bytes_per_sec;
+	prof_total.nevts += prof_interval.nevts;
+	prof_total.bytes += prof_interval.bytes;
+	for(int type = 0; type < PPM_EVENT_MAX; type++)
+	{
+		prof_total.nevts_per_type[type] += prof_interval.nevts_per_type[type];
+	}
+	memset(&prof_interval, 0, sizeof(prof_interval));
+	memset(prof_nevts_per_cpu, 0, prof_ncpus * sizeof(uint64_t));
+	prof_last_report_ns = now;
+}
+
+void print_profile_summary()
+{
+	/* Account for the events of the last, partial, interval too */
+	prof_total.nevts += prof_interval.nevts;
+	prof_total.bytes += prof_interval.bytes;
+	for(int type = 0; type < PPM_EVENT_MAX; type++)
+	{
+		prof_total.nevts_per_type[type] += prof_interval.nevts_per_type[type];
+	}
+
+	double secs = (double)(monotonic_ns() - prof_start_ns) / NS_PER_SEC;
+	printf("\n[SCAP-OPEN]: Profile\n");
+	printf("\nCost of every event: %lu ns\n", event_cost_ns);
+	printf("Bytes captured: %lu (average event size: %lu bytes)\n", prof_total.bytes,
+	       prof_total.nevts ? prof_total.bytes / prof_total.nevts : 0);
+	printf("Peak rate: %lu evts/s, %.2f MB/s\n", prof_peak_evts_per_sec, prof_peak_bytes_per_sec / (1024.0 * 1024.0));
+	printf("Peak buffer fill: %.1f%%\n", prof_peak_fill);
+	if(secs > 0)
+	{
+		printf("Rate of every event type:");
+		print_top_event_types(prof_total.nevts_per_type, PPM_EVENT_MAX, secs);
+	}
+}
+
+/*=============================== PROFILING ===========================*/
+
 /*=============================== PRINT CAPTURE INFO ===========================*/
 
 void print_help()
@@ -538,7 +796,17 @@ void print_help()
 	printf("[MODERN PROBE ONLY, EXPERIMENTAL]\n");
 	printf("'%s <cpus_for_each_buffer>': allocate a ring buffer for every `cpus_for_each_buffer` CPUs.\n", CPUS_FOR_EACH_BUFFER_MODE);
 	printf("'%s': allocate ring buffers for all available CPUs. Default: allocate ring buffers for online CPUs only.\n", ALL_AVAILABLE_CPUS_MODE);
+	printf("'%s': never share a ring buffer between NUMA nodes and allocate it on the node of its CPUs.\n", NUMA_AWARE_MODE);
 	printf("'%s': instrument drivers to drop failed syscalls (exit) events.\n", DROP_FAILED);
+	printf("'%s': merge the per-CPU buffers with a min-heap instead of a linear scan (kmod and BPF probe only).\n", HEAP_MERGE_OPTION);
+	printf("'%s <bytes>': give back consumed data to the drivers every <bytes> and refill drained buffers on their own (kmod and BPF probe only).\n", CONSUME_CHUNK_OPTION);
+	printf("'%s': wait for the drivers to notify new data instead of sleeping when the buffers are almost empty.\n", WAKEUP_OPTION);
+	printf("'%s <bytes>': buffers holding less than <bytes> are considered empty. (default: 20000)\n", EMPTY_THRESHOLD_OPTION);
+	printf("'%s <us>': maximum time waited on empty buffers in microseconds. (default: 30000)\n", EMPTY_WAIT_MAX_OPTION);
+	printf("'%s <bytes>': in wakeup mode, the drivers notify new data once a buffer holds <bytes>. (default: the empty threshold)\n", WAKEUP_WATERMARK_OPTION);
+	printf("\n------> PROFILING OPTIONS\n");
+	printf("'%s': every second, print the events and bytes per second, the events per second of every CPU, the fill of every buffer, the drops by category and the most frequent event types.\n", PROFILE_OPTION);
+	printf("'%s <ns|%s>': spend <ns> nanoseconds of CPU on every event, or the rough cost of sinsp (%d ns) with '%s'. (default: 0, consume as fast as possible)\n", EVENT_COST_OPTION, SINSP_EVENT_COST, SINSP_EVENT_COST_NS, SINSP_EVENT_COST);
 	printf("\n------> PRINT OPTIONS\n");
 	printf("'%s': print all supported syscalls with different sources and configurations.\n", PRINT_SYSCALLS_OPTION);
 	printf("'%s': print this menu.\n", PRINT_HELP_OPTION);
@@ -581,6 +849,7 @@ void print_configurations()
 	printf("\n------------------------- CONFIGURATIONS -------------------------\n");
 	printf("* Print single event type: %d (`-1` means no event to print).\n", evt_type);
 	printf("* Run until '%lu' events are catched.\n", num_events);
+	printf("* Profiling: %s, cost of every event: %lu ns.\n", profile ? "enabled" : "disabled", event_cost_ns);
 	printf("------------------------------------------------------------------\n\n");
 }
 
@@ -724,15 +993,97 @@ void parse_CLI_options(int argc, char** argv)
 		{
 			modern_bpf_params.allocate_online_only = false;
 		}
+		/* This should be used only with the modern probe */
+		if(!strcmp(argv[i], NUMA_AWARE_MODE))
+		{
+			modern_bpf_params.numa_aware = true;
+		}
 
 		if(!strcmp(argv[i], DROP_FAILED))
 		{
 			drop_failed = true;
 		}
 
+		if(!strcmp(argv[i], HEAP_MERGE_OPTION))
+		{
+			oargs.ringbuffer_merge_mode = SCAP_RINGBUFFER_MERGE_HEAP;
+		}
+
+		if(!strcmp(argv[i], CONSUME_CHUNK_OPTION))
+		{
+			if(!(i + 1 < argc))
+			{
+				printf("\nYou need to specify also the chunk dimension in bytes! Bye!\n");
+				exit(EXIT_FAILURE);
+			}
+			oargs.ringbuffer_consume_chunk_b = strtoul(argv[++i], NULL, 10);
+		}
+
+		if(!strcmp(argv[i], WAKEUP_OPTION))
+		{
+			oargs.ringbuffer_wakeup = true;
+		}
+
+		if(!strcmp(argv[i], EMPTY_THRESHOLD_OPTION))
+		{
+			if(!(i + 1 < argc))
+			{
+				printf("\nYou need to specify also the threshold in bytes! Bye!\n");
+				exit(EXIT_FAILURE);
+			}
+			oargs.ringbuffer_empty_threshold_b = strtoul(argv[++i], NULL, 10);
+		}
+
+		if(!strcmp(argv[i], EMPTY_WAIT_MAX_OPTION))
+		{
+			if(!(i + 1 < argc))
+			{
+				printf("\nYou need to specify also the time in microseconds! Bye!\n");
+				exit(EXIT_FAILURE);
+			}
+			oargs.ringbuffer_empty_wait_max_us = strtoul(argv[++i], NULL, 10);
+		}
+
+		if(!strcmp(argv[i], WAKEUP_WATERMARK_OPTION))
+		{
+			if(!(i + 1 < argc))
+			{
+				printf("\nYou need to specify also the watermark in bytes! Bye!\n");
+				exit(EXIT_FAILURE);
+			}
+			oargs.ringbuffer_wakeup_watermark_b = strtoul(argv[++i], NULL, 10);
+		}
+
 
 		/*=============================== CONFIGURATIONS ===========================*/
 
+		/*=============================== PROFILING ===========================*/
+
+		if(!strcmp(argv[i], PROFILE_OPTION))
+		{
+			profile = true;
+		}
+
+		if(!strcmp(argv[i], EVENT_COST_OPTION))
+		{
+			if(!(i + 1 < argc))
+			{
+				printf("\nYou need to specify also the cost of every event in nanoseconds or '%s'! Bye!\n", SINSP_EVENT_COST);
+				exit(EXIT_FAILURE);
+			}
+			i++;
+			if(!strcmp(argv[i], SINSP_EVENT_COST))
+			{
+				event_cost_ns = SINSP_EVENT_COST_NS;
+			}
+			else
+			{
+				event_cost_ns = strtoul(argv[i], NULL, 10);
+			}
+		}
+
+		/*=============================== PROFILING ===========================*/
+
 		/*=============================== PRINT ===========================*/
 
 		if(!strcmp(argv[i], PRINT_SYSCALLS_OPTION))
@@ -792,6 +1143,10 @@ void print_stats()
 	}
 	printf("Number of timeouts: %ld\n", number_of_timeouts);
 	printf("Number of 'next' calls: %ld\n", number_of_scap_next);
+	if(profile)
+	{
+		print_profile_summary();
+	}
 
 	printf("\n[SCAP-OPEN]: Stats v2.\n");
 	printf("\n[SCAP-OPEN]: %u metrics in total\n", nstats);
@@ -863,6 +1218,11 @@ int main(int argc, char** argv)
 
 	gettimeofday(&tval_start, NULL);
 
+	if(profile)
+	{
+		profile_init();
+	}
+
 	scap_start_capture(g_h);
 
 	if (drop_failed)
@@ -874,6 +1234,14 @@ int main(int argc, char** argv)
 	{
 		res = scap_next(g_h, &ev, &cpuid);
 		number_of_scap_next++;
+		if(profile)
+		{
+			uint64_t now = monotonic_ns();
+			if(now - prof_last_report_ns >= NS_PER_SEC)
+			{
+				profile_report(now);
+			}
+		}
 		if(res == SCAP_UNEXPECTED_BLOCK)
 		{
 			res = scap_restart_capture(g_h);
@@ -903,6 +1271,14 @@ int main(int argc, char** argv)
 			print_event(ev);
 		}
 		g_nevts++;
+		if(profile)
+		{
+			profile_event(ev, cpuid);
+		}
+		if(event_cost_ns != 0)
+		{
+			consume_event_cost();
+		}
 	}
 
 	scap_stop_capture(g_h);
@@ -0,0 +1,319 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+/* This benchmark measures the consumer side of the ring buffers (`ringbuffer_next`)
+ * without any driver: every device is backed by a plain memory buffer that we fill
+ * with synthetic events, so we can compare the merge strategies with an arbitrary
+ * number of CPUs.
+ *
+ * Next to the merge strategies it measures a baseline that walks the same blocks
+ * one device after the other, without ordering the events: the difference is the
+ * cost per event of ordering the buffers, reported in ns.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <scap.h>
+#include "scap-int.h"
+#include "ringbuffer/ringbuffer.h"
+
+#define NUM_CPUS_OPTION "--cpus"
+#define NUM_EVENTS_OPTION "--events_per_cpu"
+#define ROUNDS_OPTION "--rounds"
+#define CONSUME_CHUNK_OPTION "--consume_chunk"
+#define EVENT_SIZE_OPTION "--event_size"
+#define TS_SKEW_OPTION "--ts_skew"
+#define PRINT_HELP_OPTION "--help"
+
+#define DEFAULT_EVENTS_PER_CPU 2048
+/* By default every configuration consumes roughly the same amount of events. */
+#define DEFAULT_EVENTS_BUDGET (4 * 1024 * 1024)
+
+/* Header + 2 params of 8 bytes, roughly the size of a small syscall event. */
+#define DEFAULT_EVT_LEN (sizeof(struct ppm_evt_hdr) + 2 * sizeof(uint16_t) + 2 * sizeof(uint64_t))
+#define MIN_EVT_LEN (sizeof(struct ppm_evt_hdr) + 2 * sizeof(uint16_t))
+
+static const uint32_t default_cpus[] = {1, 2, 4, 8, 16, 32, 64, 128, 192, 256};
+
+static uint32_t events_per_cpu = DEFAULT_EVENTS_PER_CPU;
+static uint32_t rounds = 0;
+static uint32_t single_num_cpus = 0;
+static uint32_t consume_chunk_b = 0;
+static uint32_t evt_len = DEFAULT_EVT_LEN;
+static uint32_t ts_skew = 1;
+
+static uint64_t get_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * (uint64_t)1000000000 + ts.tv_nsec;
+}
+
+static int32_t setup_devset(struct scap_device_set* devset, uint32_t ndevs, scap_ringbuffer_merge_mode mode, char* error)
+{
+	scap_open_args oargs = {0};
+	oargs.ringbuffer_merge_mode = mode;
+	oargs.ringbuffer_consume_chunk_b = consume_chunk_b;
+
+	if(devset_init(devset, ndevs, &oargs, error) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	for(uint32_t j = 0; j < ndevs; j++)
+	{
+		struct scap_device* dev = &devset->m_devs[j];
+		/* The producer position must never reach the end of the buffer, as in a real ring buffer. */
+		dev->m_buffer_size = (unsigned long)(events_per_cpu + 1) * evt_len;
+		dev->m_buffer = calloc(1, dev->m_buffer_size);
+		dev->m_bufinfo = calloc(1, sizeof(struct ppm_ring_buffer_info));
+		if(dev->m_buffer == NULL || dev->m_bufinfo == NULL)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "cannot allocate the synthetic buffers");
+			return SCAP_FAILURE;
+		}
+	}
+	return SCAP_SUCCESS;
+}
+
+static void teardown_devset(struct scap_device_set* devset)
+{
+	for(uint32_t j = 0; j < devset->m_ndevs; j++)
+	{
+		free(devset->m_devs[j].m_buffer);
+		free(devset->m_devs[j].m_bufinfo);
+		/* Avoid `devset_free` unmapping our heap memory. */
+		devset->m_devs[j].m_buffer = INVALID_MAPPING;
+		devset->m_devs[j].m_bufinfo = INVALID_MAPPING;
+	}
+	devset_free(devset);
+}
+
+/* Fill every buffer with `events_per_cpu` events. Timestamps are interleaved
+ * across CPUs so that the consumer has to really merge the buffers: every
+ * buffer gets runs of `ts_skew` consecutive timestamps, so with a skew of 1
+ * consecutive events always come from different buffers, while with a large
+ * skew one buffer at a time is ahead of the others, as with bursty CPUs.
+ */
+static void produce(struct scap_device_set* devset, uint64_t* ts)
+{
+	uint32_t ndevs = devset->m_ndevs;
+
+	for(uint32_t j = 0; j < ndevs; j++)
+	{
+		devset->m_devs[j].m_bufinfo->head = 0;
+		devset->m_devs[j].m_bufinfo->tail = 0;
+	}
+
+	for(uint32_t i = 0; i < events_per_cpu; i += ts_skew)
+	{
+		for(uint32_t k = 0; k < ndevs; k++)
+		{
+			/* Stride over the CPUs so that consecutive runs land on distant buffers. */
+			struct scap_device* dev = &devset->m_devs[(k * 7 + i / ts_skew) % ndevs];
+			for(uint32_t r = 0; r < ts_skew && i + r < events_per_cpu; r++)
+			{
+				struct ppm_evt_hdr* hdr = (struct ppm_evt_hdr*)(dev->m_buffer + dev->m_bufinfo->head);
+				hdr->ts = (*ts)++;
+				hdr->tid = k;
+				hdr->len = evt_len;
+				hdr->type = PPME_SYSCALL_READ_X;
+				hdr->nparams = 2;
+				dev->m_bufinfo->head += evt_len;
+			}
+		}
+	}
+}
+
+/* Baseline: walk the blocks of all the buffers one after the other, as the
+ * merge loops do, but without ordering the events.
+ * Returns the number of consumed events.
+ */
+static int64_t consume_unordered(struct scap_device_set* devset)
+{
+	uint64_t consumed = 0;
+	uint64_t sum = 0;
+
+	for(uint32_t j = 0; j < devset->m_ndevs; j++)
+	{
+		struct scap_device* dev = &devset->m_devs[j];
+		READBUF(dev, &dev->m_sn_next_event, &dev->m_sn_len);
+		while(dev->m_sn_len > 0)
+		{
+			scap_evt* evt = NEXT_EVENT(dev);
+			sum += evt->ts;
+			ADVANCE_TO_EVT(dev, evt);
+			consumed++;
+		}
+		ADVANCE_TAIL(dev);
+	}
+
+	/* Keep the compiler from dropping the loads. */
+	if(sum == 0)
+	{
+		return -1;
+	}
+	return consumed;
+}
+
+/* Returns the number of consumed events or -1 on failure. */
+static int64_t consume(struct scap_device_set* devset, uint64_t expected)
+{
+	uint64_t consumed = 0;
+	uint64_t last_ts = 0;
+	scap_evt* evt = NULL;
+	uint16_t cpuid = 0;
+
+	while(consumed < expected)
+	{
+		int32_t res = ringbuffer_next(devset, &evt, &cpuid);
+		if(res == SCAP_SUCCESS)
+		{
+			if(evt->ts < last_ts)
+			{
+				fprintf(stderr, "events out of order: %lu after %lu\n", evt->ts, last_ts);
+				return -1;
+			}
+			last_ts = evt->ts;
+			consumed++;
+		}
+		else if(res != SCAP_TIMEOUT)
+		{
+			fprintf(stderr, "ringbuffer_next failed: %s\n", devset->m_lasterr);
+			return -1;
+		}
+	}
+
+	/* Give back the last blocks so that the next round starts from empty buffers. */
+	ringbuffer_next(devset, &evt, &cpuid);
+	return consumed;
+}
+
+/* `mode` -1 runs the unordered baseline. Returns the events per second. */
+static double run(uint32_t ndevs, int mode)
+{
+	char error[SCAP_LASTERR_SIZE] = {0};
+	struct scap_device_set devset = {0};
+	uint64_t ts = 1;
+	uint64_t elapsed = 0;
+	uint64_t total = 0;
+	uint32_t num_rounds = rounds;
+
+	if(num_rounds == 0)
+	{
+		num_rounds = MAX(1, DEFAULT_EVENTS_BUDGET / ((uint64_t)events_per_cpu * ndevs));
+	}
+
+	if(setup_devset(&devset, ndevs, mode < 0 ? SCAP_RINGBUFFER_MERGE_LINEAR : (scap_ringbuffer_merge_mode)mode, error) != SCAP_SUCCESS)
+	{
+		fprintf(stderr, "%s\n", error);
+		exit(EXIT_FAILURE);
+	}
+
+	for(uint32_t r = 0; r < num_rounds; r++)
+	{
+		produce(&devset, &ts);
+		uint64_t start = get_ns();
+		int64_t n = mode < 0 ? consume_unordered(&devset) : consume(&devset, (uint64_t)events_per_cpu * ndevs);
+		elapsed += get_ns() - start;
+		if(n < 0)
+		{
+			teardown_devset(&devset);
+			exit(EXIT_FAILURE);
+		}
+		total += n;
+	}
+
+	teardown_devset(&devset);
+	return elapsed == 0 ? 0 : (double)total * 1000000000 / elapsed;
+}
+
+static void print_help(void)
+{
+	printf("\n------------------------------ MENU ------------------------------\n");
+	printf("'%s <num_cpus>': run only with this number of synthetic CPUs. (default: 1 to 256)\n", NUM_CPUS_OPTION);
+	printf("'%s <num_events>': events written in every buffer at each round. (default: %d)\n", NUM_EVENTS_OPTION, DEFAULT_EVENTS_PER_CPU);
+	printf("'%s <num_rounds>': number of produce/consume rounds. (default: about %d events for every configuration)\n", ROUNDS_OPTION, DEFAULT_EVENTS_BUDGET);
+	printf("'%s <bytes>': consume the buffers incrementally, giving back data every <bytes>. (default: 0, whole blocks)\n", CONSUME_CHUNK_OPTION);
+	printf("'%s <bytes>': size of every event, at least %zu. (default: %zu)\n", EVENT_SIZE_OPTION, MIN_EVT_LEN, DEFAULT_EVT_LEN);
+	printf("'%s <num_events>': every buffer holds runs of <num_events> consecutive timestamps. (default: 1, fully interleaved)\n", TS_SKEW_OPTION);
+	printf("'%s': print this menu.\n", PRINT_HELP_OPTION);
+	printf("------------------------------------------------------------------\n\n");
+}
+
+static void parse_CLI_options(int argc, char** argv)
+{
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], NUM_CPUS_OPTION) && i + 1 < argc)
+		{
+			single_num_cpus = strtoul(argv[++i], NULL, 10);
+		}
+		else if(!strcmp(argv[i], NUM_EVENTS_OPTION) && i + 1 < argc)
+		{
+			events_per_cpu = strtoul(argv[++i], NULL, 10);
+		}
+		else if(!strcmp(argv[i], ROUNDS_OPTION) && i + 1 < argc)
+		{
+			rounds = strtoul(argv[++i], NULL, 10);
+		}
+		else if(!strcmp(argv[i], CONSUME_CHUNK_OPTION) && i + 1 < argc)
+		{
+			consume_chunk_b = strtoul(argv[++i], NULL, 10);
+		}
+		else if(!strcmp(argv[i], EVENT_SIZE_OPTION) && i + 1 < argc)
+		{
+			evt_len = strtoul(argv[++i], NULL, 10);
+			evt_len = MAX(evt_len, MIN_EVT_LEN);
+		}
+		else if(!strcmp(argv[i], TS_SKEW_OPTION) && i + 1 < argc)
+		{
+			ts_skew = strtoul(argv[++i], NULL, 10);
+			ts_skew = MAX(ts_skew, 1);
+		}
+		else
+		{
+			print_help();
+			exit(!strcmp(argv[i], PRINT_HELP_OPTION) ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	parse_CLI_options(argc, argv);
+
+	printf("%8s %18s %18s %18s %8s %14s %14s\n", "cpus", "unordered (evt/s)", "linear (evt/s)", "heap (evt/s)", "speedup",
+	       "linear ord ns", "heap ord ns");
+	for(uint32_t i = 0; i < sizeof(default_cpus) / sizeof(default_cpus[0]); i++)
+	{
+		uint32_t ncpus = single_num_cpus ? single_num_cpus : default_cpus[i];
+		double unordered = run(ncpus, -1);
+		double linear = run(ncpus, SCAP_RINGBUFFER_MERGE_LINEAR);
+		double heap = run(ncpus, SCAP_RINGBUFFER_MERGE_HEAP);
+		printf("%8u %18.0f %18.0f %18.0f %7.2fx %14.1f %14.1f\n", ncpus, unordered, linear, heap, linear > 0 ? heap / linear : 0,
+		       linear > 0 && unordered > 0 ? 1e9 / linear - 1e9 / unordered : 0,
+		       heap > 0 && unordered > 0 ? 1e9 / heap - 1e9 / unordered : 0);
+		if(single_num_cpus)
+		{
+			break;
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,301 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+/* This benchmark measures the translation of gVisor messages into scap events
+ * (`parse_gvisor_proto`) over a stream of messages, comparing the sizing
+ * policies of the scap buffer: growing it only to the size of the events that
+ * didn't fit, which parses the message again, or sizing it beforehand as the
+ * engine does.
+ *
+ * The stream is read from a file holding, for each message, its size as a
+ * 32 bit integer in host byte order followed by the message as sent by
+ * gVisor on the socket (header and protobuf). Without a file, a synthetic
+ * stream is used, and it can be saved with --dump as an example of the format.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include <scap.h>
+#include "gvisor.h"
+#include "pkg/sentry/seccheck/points/common.pb.h"
+#include "pkg/sentry/seccheck/points/syscall.pb.h"
+#include "pkg/sentry/seccheck/points/container.pb.h"
+
+#define FILE_OPTION "--file"
+#define DUMP_OPTION "--dump"
+#define ROUNDS_OPTION "--rounds"
+#define PRINT_HELP_OPTION "--help"
+
+#define DEFAULT_ROUNDS 100
+#define SYNTHETIC_MESSAGES 1000
+#define INITIAL_BUFFER_SIZE 32
+
+typedef std::vector<std::string> message_stream;
+
+static uint64_t get_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * (uint64_t)1000000000 + ts.tv_nsec;
+}
+
+template<class T>
+static void add_message(message_stream& stream, uint16_t message_type, T& gvisor_evt)
+{
+	scap_gvisor::header hdr;
+	hdr.header_size = sizeof(hdr);
+	hdr.message_type = message_type;
+	hdr.dropped_count = 0;
+
+	std::string msg((const char*)&hdr, sizeof(hdr));
+	msg += gvisor_evt.SerializeAsString();
+	stream.push_back(msg);
+}
+
+template<class T>
+static void fill_context_data(T& gvisor_evt, uint64_t ts)
+{
+	auto* context_data = gvisor_evt.mutable_context_data();
+	context_data->set_time_ns(ts);
+	context_data->set_thread_id(1234);
+	context_data->set_thread_group_id(1234);
+	context_data->set_container_id("1a2b3c4d5e6f7a8b9c0d");
+	context_data->set_cwd("/home/user/workdir");
+	context_data->set_process_name("bench");
+}
+
+/* A mix of small syscall messages with an occasional process start. */
+static message_stream synthetic_stream()
+{
+	message_stream stream;
+	uint64_t ts = 1;
+
+	for(uint32_t i = 0; i < SYNTHETIC_MESSAGES; i++)
+	{
+		switch(i % 10)
+		{
+		case 0:
+		{
+			gvisor::syscall::Execve evt;
+			fill_context_data(evt, ts++);
+			evt.set_pathname("/usr/bin/python3");
+			for(int j = 0; j < 8; j++)
+			{
+				evt.add_argv("--argument-" + std::to_string(j));
+				evt.add_envv("VARIABLE_" + std::to_string(j) + "=" + std::string(32, 'x'));
+			}
+			evt.mutable_exit()->set_result(0);
+			add_message(stream, gvisor::common::MessageType::MESSAGE_SYSCALL_EXECVE, evt);
+			break;
+		}
+		case 1:
+		case 2:
+		case 3:
+		{
+			gvisor::syscall::Open evt;
+			fill_context_data(evt, ts++);
+			evt.set_fd(-100);
+			evt.set_pathname("/etc/some/configuration/file.conf");
+			evt.set_flags(0);
+			evt.set_mode(0);
+			evt.mutable_exit()->set_result(3);
+			add_message(stream, gvisor::common::MessageType::MESSAGE_SYSCALL_OPEN, evt);
+			break;
+		}
+		default:
+		{
+			gvisor::syscall::Read evt;
+			fill_context_data(evt, ts++);
+			evt.set_fd(3);
+			evt.set_count(4096);
+			evt.mutable_exit()->set_result(4096);
+			add_message(stream, gvisor::common::MessageType::MESSAGE_SYSCALL_READ, evt);
+			break;
+		}
+		}
+	}
+
+	return stream;
+}
+
+static bool read_stream(const char* filename, message_stream& stream)
+{
+	FILE* f = fopen(filename, "rb");
+	if(f == NULL)
+	{
+		fprintf(stderr, "cannot open %s\n", filename);
+		return false;
+	}
+
+	uint32_t size;
+	while(fread(&size, sizeof(size), 1, f) == 1)
+	{
+		std::string msg(size, '\0');
+		if(fread(&msg[0], 1, size, f) != size)
+		{
+			fprintf(stderr, "truncated message in %s\n", filename);
+			fclose(f);
+			return false;
+		}
+		stream.push_back(msg);
+	}
+
+	fclose(f);
+	return true;
+}
+
+static bool dump_stream(const char* filename, const message_stream& stream)
+{
+	FILE* f = fopen(filename, "wb");
+	if(f == NULL)
+	{
+		fprintf(stderr, "cannot open %s\n", filename);
+		return false;
+	}
+
+	for(const auto& msg : stream)
+	{
+		uint32_t size = msg.size();
+		fwrite(&size, sizeof(size), 1, f);
+		fwrite(msg.data(), 1, size, f);
+	}
+
+	fclose(f);
+	return true;
+}
+
+static void run(const message_stream& stream, uint32_t rounds, bool presize)
+{
+	scap_sized_buffer scap_buf;
+	scap_buf.size = INITIAL_BUFFER_SIZE;
+	scap_buf.buf = malloc(scap_buf.size);
+
+	uint64_t nevts = 0;
+	uint64_t nreparses = 0;
+	uint64_t nerrors = 0;
+	uint64_t start = get_ns();
+
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		for(const auto& msg : stream)
+		{
+			scap_const_sized_buffer gvisor_msg = {.buf = msg.data(), .size = msg.size()};
+
+			if(presize)
+			{
+				size_t hint = scap_gvisor::parsers::scap_buffer_size_hint(msg.size());
+				if(scap_buf.size < hint)
+				{
+					scap_buf.size = hint;
+					scap_buf.buf = realloc(scap_buf.buf, scap_buf.size);
+				}
+			}
+
+			scap_gvisor::parsers::parse_result res = scap_gvisor::parsers::parse_gvisor_proto(gvisor_msg, scap_buf);
+			if(res.status == SCAP_INPUT_TOO_SMALL)
+			{
+				scap_buf.size = res.size;
+				scap_buf.buf = realloc(scap_buf.buf, scap_buf.size);
+				res = scap_gvisor::parsers::parse_gvisor_proto(gvisor_msg, scap_buf);
+				nreparses++;
+			}
+
+			if(res.status != SCAP_SUCCESS)
+			{
+				nerrors++;
+				continue;
+			}
+			nevts += res.scap_events.size();
+		}
+	}
+
+	uint64_t elapsed = get_ns() - start;
+	uint64_t nmsgs = (uint64_t)stream.size() * rounds;
+	printf("%-10s msgs: %-10lu evts: %-10lu reparses: %-8lu errors: %-8lu ns/msg: %.1f\n",
+	       presize ? "presized" : "on demand",
+	       nmsgs, nevts, nreparses, nerrors,
+	       nmsgs ? (double)elapsed / nmsgs : 0);
+
+	free(scap_buf.buf);
+}
+
+static void print_help()
+{
+	printf("\n----------------------- MENU -----------------------\n");
+	printf("'%s <path>': read the messages from a recorded stream.\n", FILE_OPTION);
+	printf("'%s <path>': save the synthetic stream in a file and exit.\n", DUMP_OPTION);
+	printf("'%s <num>': number of times the stream is parsed. (default: %d)\n", ROUNDS_OPTION, DEFAULT_ROUNDS);
+	printf("'%s': print this menu.\n", PRINT_HELP_OPTION);
+	printf("-----------------------------------------------------\n");
+}
+
+int main(int argc, char** argv)
+{
+	const char* filename = NULL;
+	const char* dump_filename = NULL;
+	uint32_t rounds = DEFAULT_ROUNDS;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], FILE_OPTION) && i + 1 < argc)
+		{
+			filename = argv[++i];
+		}
+		else if(!strcmp(argv[i], DUMP_OPTION) && i + 1 < argc)
+		{
+			dump_filename = argv[++i];
+		}
+		else if(!strcmp(argv[i], ROUNDS_OPTION) && i + 1 < argc)
+		{
+			rounds = strtoul(argv[++i], NULL, 10);
+		}
+		else
+		{
+			print_help();
+			return strcmp(argv[i], PRINT_HELP_OPTION) ? EXIT_FAILURE : EXIT_SUCCESS;
+		}
+	}
+
+	message_stream stream;
+	if(filename != NULL)
+	{
+		if(!read_stream(filename, stream))
+		{
+			return EXIT_FAILURE;
+		}
+	}
+	else
+	{
+		stream = synthetic_stream();
+	}
+
+	if(dump_filename != NULL)
+	{
+		return dump_stream(dump_filename, stream) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	printf("%zu messages, %u rounds\n", stream.size(), rounds);
+	run(stream, rounds, false);
+	run(stream, rounds, true);
+	return EXIT_SUCCESS;
+}
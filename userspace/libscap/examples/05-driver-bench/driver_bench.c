@@ -0,0 +1,474 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+/* This benchmark measures the overhead that a driver adds to the syscalls.
+ * Every workload runs a tight loop of a representative syscall, first with no
+ * driver attached and then with the chosen engine attached, once for every
+ * buffer dimension. While the workload runs, a second thread consumes the
+ * events as a real consumer would. For every run we report:
+ * - the time of an operation and the overhead over the detached run.
+ * - the mean size of the consumed events, i.e. the ring buffer bytes per event.
+ * - the rate of the events dropped by the driver.
+ *
+ * Only the syscalls issued by the workload are enabled, but the events of
+ * the other processes calling them are captured and consumed as well: run
+ * the benchmark on an idle machine.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <scap.h>
+
+#define UNKNOWN_ENGINE "unknown"
+
+#define KMOD_OPTION "--kmod"
+#define BPF_OPTION "--bpf"
+#define MODERN_BPF_OPTION "--modern_bpf"
+#define BUFFER_OPTION "--buffer_dim"
+#define ITERATIONS_OPTION "--iterations"
+#define WORKLOAD_OPTION "--workload"
+#define PRINT_HELP_OPTION "--help"
+
+#define DEFAULT_ITERATIONS 100000
+#define MAX_BUFFER_DIMS 16
+#define MAX_WORKLOAD_SC 8
+
+static const unsigned long default_buffer_dims[] = {1 * 1024 * 1024, 8 * 1024 * 1024, 64 * 1024 * 1024};
+
+static scap_open_args oargs = {.engine_name = UNKNOWN_ENGINE};
+static struct scap_bpf_engine_params bpf_params;
+static struct scap_kmod_engine_params kmod_params;
+static struct scap_modern_bpf_engine_params modern_bpf_params;
+
+static unsigned long buffer_dims[MAX_BUFFER_DIMS];
+static uint32_t n_buffer_dims = 0;
+static uint64_t iterations = DEFAULT_ITERATIONS;
+static const char* selected_workload = NULL;
+
+static int dev_zero_fd = -1;
+static int dev_null_fd = -1;
+static struct sockaddr_in closed_port_addr;
+
+struct workload
+{
+	const char* name;
+	void (*run)(uint64_t n);
+	/* Expensive workloads run `iterations / divisor` operations. */
+	uint32_t divisor;
+	/* Syscalls and tracepoints issued by an operation, ended by -1. */
+	int ppm_sc[MAX_WORKLOAD_SC];
+};
+
+struct consumer
+{
+	scap_t* h;
+	volatile bool stop;
+	uint64_t n_evts;
+	uint64_t n_bytes;
+};
+
+static uint64_t get_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * (uint64_t)1000000000 + ts.tv_nsec;
+}
+
+/*=============================== WORKLOADS ===========================*/
+
+static void run_open(uint64_t n)
+{
+	for(uint64_t i = 0; i < n; i++)
+	{
+		int fd = open("/dev/null", O_RDONLY);
+		if(fd >= 0)
+		{
+			close(fd);
+		}
+	}
+}
+
+static void run_read(uint64_t n)
+{
+	char c;
+	for(uint64_t i = 0; i < n; i++)
+	{
+		if(read(dev_zero_fd, &c, 1) < 0)
+		{
+			return;
+		}
+	}
+}
+
+static void run_write(uint64_t n)
+{
+	char c = 0;
+	for(uint64_t i = 0; i < n; i++)
+	{
+		if(write(dev_null_fd, &c, 1) < 0)
+		{
+			return;
+		}
+	}
+}
+
+/* Nobody listens on the port, so the connection is refused right away. */
+static void run_connect(uint64_t n)
+{
+	for(uint64_t i = 0; i < n; i++)
+	{
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		if(fd < 0)
+		{
+			return;
+		}
+		connect(fd, (struct sockaddr*)&closed_port_addr, sizeof(closed_port_addr));
+		close(fd);
+	}
+}
+
+static void run_clone(uint64_t n)
+{
+	for(uint64_t i = 0; i < n; i++)
+	{
+		pid_t pid = fork();
+		if(pid == 0)
+		{
+			_exit(0);
+		}
+		if(pid > 0)
+		{
+			waitpid(pid, NULL, 0);
+		}
+	}
+}
+
+static void run_execve(uint64_t n)
+{
+	char* const argv[] = {"true", NULL};
+	char* const envp[] = {NULL};
+
+	for(uint64_t i = 0; i < n; i++)
+	{
+		pid_t pid = fork();
+		if(pid == 0)
+		{
+			execve("/bin/true", argv, envp);
+			_exit(1);
+		}
+		if(pid > 0)
+		{
+			waitpid(pid, NULL, 0);
+		}
+	}
+}
+
+static const struct workload workloads[] = {
+	{"open", run_open, 1, {PPM_SC_OPEN, PPM_SC_OPENAT, PPM_SC_CLOSE, -1}},
+	{"read", run_read, 1, {PPM_SC_READ, -1}},
+	{"write", run_write, 1, {PPM_SC_WRITE, -1}},
+	{"connect", run_connect, 1, {PPM_SC_SOCKET, PPM_SC_CONNECT, PPM_SC_CLOSE, -1}},
+	{"clone", run_clone, 100, {PPM_SC_CLONE, PPM_SC_CLONE3, PPM_SC_FORK, PPM_SC_WAIT4, PPM_SC_SCHED_PROCESS_EXIT, -1}},
+	{"execve", run_execve, 100, {PPM_SC_CLONE, PPM_SC_CLONE3, PPM_SC_FORK, PPM_SC_EXECVE, PPM_SC_WAIT4, PPM_SC_SCHED_PROCESS_EXIT, -1}},
+};
+
+static int setup_workloads(void)
+{
+	dev_zero_fd = open("/dev/zero", O_RDONLY);
+	dev_null_fd = open("/dev/null", O_WRONLY);
+	if(dev_zero_fd < 0 || dev_null_fd < 0)
+	{
+		fprintf(stderr, "cannot open /dev/zero and /dev/null\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Bind a socket to get a free port, then close it to leave nobody listening. */
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	socklen_t len = sizeof(closed_port_addr);
+	memset(&closed_port_addr, 0, sizeof(closed_port_addr));
+	closed_port_addr.sin_family = AF_INET;
+	closed_port_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(fd < 0 || bind(fd, (struct sockaddr*)&closed_port_addr, len) != 0 ||
+	   getsockname(fd, (struct sockaddr*)&closed_port_addr, &len) != 0)
+	{
+		fprintf(stderr, "cannot find a free port on the loopback\n");
+		return EXIT_FAILURE;
+	}
+	close(fd);
+	return EXIT_SUCCESS;
+}
+
+/*=============================== WORKLOADS ===========================*/
+
+/*=============================== BENCHMARK ===========================*/
+
+static void* consume(void* arg)
+{
+	struct consumer* c = (struct consumer*)arg;
+	scap_evt* evt = NULL;
+	uint16_t cpuid = 0;
+
+	/* Once the workload is done, keep going until the buffers look empty. */
+	while(true)
+	{
+		int32_t res = scap_next(c->h, &evt, &cpuid);
+		if(res == SCAP_SUCCESS)
+		{
+			c->n_evts++;
+			c->n_bytes += evt->len;
+		}
+		else if(res == SCAP_TIMEOUT || res == SCAP_FILTERED_EVENT)
+		{
+			if(c->stop)
+			{
+				break;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "scap_next failed: %s (%d)\n", scap_getlasterr(c->h), res);
+			break;
+		}
+	}
+	return NULL;
+}
+
+static void set_buffer_dim(unsigned long dim)
+{
+	kmod_params.buffer_bytes_dim = dim;
+	bpf_params.buffer_bytes_dim = dim;
+	modern_bpf_params.buffer_bytes_dim = dim;
+}
+
+static int run_attached(const struct workload* w, uint64_t n, double detached_ns, unsigned long buffer_dim)
+{
+	char error[SCAP_LASTERR_SIZE] = {0};
+	int32_t res = SCAP_SUCCESS;
+	struct consumer c = {0};
+	scap_stats before = {0};
+	scap_stats after = {0};
+	pthread_t thread;
+
+	set_buffer_dim(buffer_dim);
+	memset(&oargs.ppm_sc_of_interest, 0, sizeof(oargs.ppm_sc_of_interest));
+	for(int i = 0; i < MAX_WORKLOAD_SC && w->ppm_sc[i] != -1; i++)
+	{
+		oargs.ppm_sc_of_interest.ppm_sc[w->ppm_sc[i]] = true;
+	}
+
+	c.h = scap_open(&oargs, error, &res);
+	if(c.h == NULL || res != SCAP_SUCCESS)
+	{
+		fprintf(stderr, "%s (%d)\n", error, res);
+		return EXIT_FAILURE;
+	}
+
+	scap_start_capture(c.h);
+	if(pthread_create(&thread, NULL, consume, &c) != 0)
+	{
+		fprintf(stderr, "cannot start the consumer thread\n");
+		scap_close(c.h);
+		return EXIT_FAILURE;
+	}
+
+	scap_get_stats(c.h, &before);
+	uint64_t start = get_ns();
+	w->run(n);
+	double attached_ns = (double)(get_ns() - start) / n;
+	scap_get_stats(c.h, &after);
+
+	c.stop = true;
+	pthread_join(thread, NULL);
+	scap_stop_capture(c.h);
+	scap_close(c.h);
+
+	uint64_t n_evts = after.n_evts - before.n_evts;
+	uint64_t n_drops = after.n_drops - before.n_drops;
+	printf("  %-10s %12lu %12.1f %12.1f %14.1f %11.3f%%\n",
+	       "attached",
+	       buffer_dim,
+	       attached_ns,
+	       attached_ns - detached_ns,
+	       c.n_evts ? (double)c.n_bytes / c.n_evts : 0.0,
+	       n_evts ? 100.0 * n_drops / n_evts : 0.0);
+	return EXIT_SUCCESS;
+}
+
+static int run_workload(const struct workload* w)
+{
+	uint64_t n = iterations / w->divisor;
+	if(n == 0)
+	{
+		n = 1;
+	}
+
+	/* Warm up the caches and the page tables before the detached run. */
+	w->run(n / 10 + 1);
+	uint64_t start = get_ns();
+	w->run(n);
+	double detached_ns = (double)(get_ns() - start) / n;
+
+	printf("\n[%s] %lu operations\n", w->name, n);
+	printf("  %-10s %12s %12s %12s %14s %12s\n", "driver", "buffer_dim", "ns/op", "overhead", "bytes/event", "drops");
+	printf("  %-10s %12s %12.1f %12s %14s %12s\n", "detached", "-", detached_ns, "-", "-", "-");
+
+	for(uint32_t i = 0; i < n_buffer_dims; i++)
+	{
+		if(run_attached(w, n, detached_ns, buffer_dims[i]) != EXIT_SUCCESS)
+		{
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/*=============================== BENCHMARK ===========================*/
+
+static void print_help(void)
+{
+	printf("\n----------------------- MENU -----------------------\n");
+	printf("------> SCAP SOURCES\n");
+	printf("'%s': enable the kernel module.\n", KMOD_OPTION);
+	printf("'%s <probe_path>': enable the BPF probe.\n", BPF_OPTION);
+	printf("'%s': enable modern BPF probe.\n", MODERN_BPF_OPTION);
+	printf("\n------> CONFIGURATIONS OPTIONS\n");
+	printf("'%s <dim>': dimension in bytes of a single per CPU buffer. Can be passed multiple times. (default: 1 MB, 8 MB and 64 MB)\n", BUFFER_OPTION);
+	printf("'%s <num>': operations of the cheap workloads, the clone and execve ones run 100 times less. (default: %d)\n", ITERATIONS_OPTION, DEFAULT_ITERATIONS);
+	printf("'%s <name>': run only this workload (open, read, write, connect, clone, execve).\n", WORKLOAD_OPTION);
+	printf("'%s': print this menu.\n", PRINT_HELP_OPTION);
+	printf("-----------------------------------------------------\n");
+}
+
+static void parse_CLI_options(int argc, char** argv)
+{
+	for(int i = 0; i < argc; i++)
+	{
+		if(!strcmp(argv[i], KMOD_OPTION))
+		{
+			oargs.engine_name = KMOD_ENGINE;
+			oargs.engine_params = &kmod_params;
+		}
+		if(!strcmp(argv[i], BPF_OPTION))
+		{
+			if(!(i + 1 < argc))
+			{
+				printf("\nYou need to specify also the BPF probe path! Bye!\n");
+				exit(EXIT_FAILURE);
+			}
+			oargs.engine_name = BPF_ENGINE;
+			bpf_params.bpf_probe = argv[++i];
+			oargs.engine_params = &bpf_params;
+		}
+		if(!strcmp(argv[i], MODERN_BPF_OPTION))
+		{
+			oargs.engine_name = MODERN_BPF_ENGINE;
+			modern_bpf_params.cpus_for_each_buffer = DEFAULT_CPU_FOR_EACH_BUFFER;
+			modern_bpf_params.allocate_online_only = true;
+			oargs.engine_params = &modern_bpf_params;
+		}
+		if(!strcmp(argv[i], BUFFER_OPTION))
+		{
+			if(!(i + 1 < argc) || n_buffer_dims == MAX_BUFFER_DIMS)
+			{
+				printf("\nYou need to specify also the dimension of buffer in bytes (at most %d times)! Bye!\n", MAX_BUFFER_DIMS);
+				exit(EXIT_FAILURE);
+			}
+			buffer_dims[n_buffer_dims++] = strtoul(argv[++i], NULL, 10);
+		}
+		if(!strcmp(argv[i], ITERATIONS_OPTION))
+		{
+			if(!(i + 1 < argc))
+			{
+				printf("\nYou need to specify also the number of iterations! Bye!\n");
+				exit(EXIT_FAILURE);
+			}
+			iterations = strtoull(argv[++i], NULL, 10);
+		}
+		if(!strcmp(argv[i], WORKLOAD_OPTION))
+		{
+			if(!(i + 1 < argc))
+			{
+				printf("\nYou need to specify also the workload name! Bye!\n");
+				exit(EXIT_FAILURE);
+			}
+			selected_workload = argv[++i];
+		}
+		if(!strcmp(argv[i], PRINT_HELP_OPTION))
+		{
+			print_help();
+			exit(EXIT_SUCCESS);
+		}
+	}
+
+	if(strcmp(oargs.engine_name, UNKNOWN_ENGINE) == 0)
+	{
+		printf("\nYou need to choose a driver! Bye!\n");
+		print_help();
+		exit(EXIT_FAILURE);
+	}
+	oargs.mode = SCAP_MODE_LIVE;
+
+	if(n_buffer_dims == 0)
+	{
+		for(uint32_t i = 0; i < sizeof(default_buffer_dims) / sizeof(*default_buffer_dims); i++)
+		{
+			buffer_dims[n_buffer_dims++] = default_buffer_dims[i];
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool found = false;
+
+	parse_CLI_options(argc, argv);
+
+	if(setup_workloads() != EXIT_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
+
+	printf("[DRIVER-BENCH]: engine '%s'\n", oargs.engine_name);
+
+	for(uint32_t i = 0; i < sizeof(workloads) / sizeof(*workloads); i++)
+	{
+		if(selected_workload != NULL && strcmp(selected_workload, workloads[i].name) != 0)
+		{
+			continue;
+		}
+		found = true;
+		if(run_workload(&workloads[i]) != EXIT_SUCCESS)
+		{
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(!found)
+	{
+		fprintf(stderr, "unknown workload '%s'\n", selected_workload);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,551 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+/* This benchmark measures the initial /proc scan of libscap, on a synthetic
+ * procfs tree generated in a temporary directory and used as the host root:
+ * the number of processes, of threads and of fds is chosen freely and the
+ * results don't depend on what runs on the machine. Every process has the
+ * files read by the scan (status, stat, cmdline, environ, cgroup, the exe,
+ * cwd and root links...) with realistic contents, and its fds point to
+ * files, directories, character devices, pipes and anonymous inodes. There
+ * are no sockets, since the tree has no network tables.
+ *
+ * The scan runs with the nodriver engine and a full scan, once to warm up
+ * the caches and then for every round, and we report the time per thread
+ * and per fd. The real /proc can be scanned instead with `--host`.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <scap.h>
+#include "uthash.h"
+
+#define PROCS_OPTION "--procs"
+#define THREADS_OPTION "--threads"
+#define FDS_OPTION "--fds"
+#define ROUNDS_OPTION "--rounds"
+#define SCAN_THREADS_OPTION "--scan_threads"
+#define HOST_OPTION "--host"
+#define KEEP_OPTION "--keep"
+#define PRINT_HELP_OPTION "--help"
+
+#define DEFAULT_PROCS 1000
+#define DEFAULT_THREADS 1
+#define DEFAULT_FDS 32
+#define DEFAULT_ROUNDS 5
+
+/* The pids of the synthetic tree start here, far from the pids of the
+ * machine (over PID_MAX_LIMIT), so that prlimit() doesn't find them.
+ */
+#define FIRST_PID 5000000
+
+static uint32_t n_procs = DEFAULT_PROCS;
+static uint32_t n_threads = DEFAULT_THREADS;
+static uint32_t n_fds = DEFAULT_FDS;
+static uint32_t rounds = DEFAULT_ROUNDS;
+static uint32_t scan_threads = 0;
+static bool host = false;
+static bool keep = false;
+
+static char root[] = "/tmp/scap-proc-scan-bench-XXXXXX";
+
+static uint64_t get_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * (uint64_t)1000000000 + ts.tv_nsec;
+}
+
+/*=============================== TREE ===========================*/
+
+/* The tree is not created with a path that doesn't fit, a truncated one
+ * could clash with another entry.
+ */
+static int join_path(char* path, const char* dir, const char* name)
+{
+	int len = snprintf(path, PATH_MAX, "%s/%s", dir, name);
+	if(len < 0 || len >= PATH_MAX)
+	{
+		fprintf(stderr, "path too long: %s/%s\n", dir, name);
+		return -1;
+	}
+	return 0;
+}
+
+static int write_file(const char* dir, const char* name, const char* content, size_t len)
+{
+	char path[PATH_MAX];
+	if(join_path(path, dir, name) != 0)
+	{
+		return -1;
+	}
+	FILE* f = fopen(path, "w");
+	if(f == NULL)
+	{
+		fprintf(stderr, "cannot create %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if(fwrite(content, 1, len, f) != len)
+	{
+		fprintf(stderr, "cannot write %s\n", path);
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	return 0;
+}
+
+static int make_link(const char* dir, const char* name, const char* target)
+{
+	char path[PATH_MAX];
+	if(join_path(path, dir, name) != 0)
+	{
+		return -1;
+	}
+	if(symlink(target, path) != 0)
+	{
+		fprintf(stderr, "cannot create %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static int make_dir(const char* path)
+{
+	if(mkdir(path, 0755) != 0)
+	{
+		fprintf(stderr, "cannot create %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/* A thread directory, as /proc/<pid>/task/<tid> or /proc/<pid> itself for
+ * the main thread.
+ */
+static int write_thread_dir(const char* dir, uint32_t pid, uint32_t tid)
+{
+	char buf[4096];
+	int len;
+
+	if(make_dir(dir) != 0)
+	{
+		return -1;
+	}
+
+	len = snprintf(buf, sizeof(buf),
+		       "Name:\tbench-%u\n"
+		       "Umask:\t0022\n"
+		       "State:\tS (sleeping)\n"
+		       "Tgid:\t%u\n"
+		       "Ngid:\t0\n"
+		       "Pid:\t%u\n"
+		       "PPid:\t%u\n"
+		       "TracerPid:\t0\n"
+		       "Uid:\t0\t0\t0\t0\n"
+		       "Gid:\t0\t0\t0\t0\n"
+		       "FDSize:\t64\n"
+		       "Groups:\t0 4 24 27 30 46 100 118\n"
+		       "NStgid:\t%u\t%u\n"
+		       "NSpid:\t%u\t%u\n"
+		       "NSpgid:\t%u\t%u\n"
+		       "NSsid:\t%u\t%u\n"
+		       "VmPeak:\t  171412 kB\n"
+		       "VmSize:\t  171412 kB\n"
+		       "VmLck:\t       0 kB\n"
+		       "VmPin:\t       0 kB\n"
+		       "VmHWM:\t   13516 kB\n"
+		       "VmRSS:\t   13516 kB\n"
+		       "RssAnon:\t    4448 kB\n"
+		       "RssFile:\t    9068 kB\n"
+		       "RssShmem:\t       0 kB\n"
+		       "VmData:\t   18460 kB\n"
+		       "VmStk:\t     132 kB\n"
+		       "VmExe:\t     804 kB\n"
+		       "VmLib:\t   10980 kB\n"
+		       "VmPTE:\t      84 kB\n"
+		       "VmSwap:\t       0 kB\n"
+		       "HugetlbPages:\t       0 kB\n"
+		       "CoreDumping:\t0\n"
+		       "THP_enabled:\t1\n"
+		       "Threads:\t%u\n"
+		       "SigQ:\t0/63438\n"
+		       "SigPnd:\t0000000000000000\n"
+		       "ShdPnd:\t0000000000000000\n"
+		       "SigBlk:\t7be3c0fe28014a03\n"
+		       "SigIgn:\t0000000000001000\n"
+		       "SigCgt:\t00000001800004ec\n"
+		       "CapInh:\t0000000000000000\n"
+		       "CapPrm:\t000001ffffffffff\n"
+		       "CapEff:\t000001ffffffffff\n"
+		       "CapBnd:\t000001ffffffffff\n"
+		       "CapAmb:\t0000000000000000\n"
+		       "NoNewPrivs:\t0\n"
+		       "Seccomp:\t0\n"
+		       "Seccomp_filters:\t0\n"
+		       "Speculation_Store_Bypass:\tthread vulnerable\n"
+		       "SpeculationIndirectBranch:\tconditional enabled\n"
+		       "Cpus_allowed:\tff\n"
+		       "Cpus_allowed_list:\t0-7\n"
+		       "Mems_allowed:\t00000000,00000001\n"
+		       "Mems_allowed_list:\t0\n"
+		       "voluntary_ctxt_switches:\t3214\n"
+		       "nonvoluntary_ctxt_switches:\t52\n",
+		       pid, pid, tid, pid == FIRST_PID ? 1 : FIRST_PID,
+		       pid, pid - FIRST_PID + 1, tid, tid - FIRST_PID + 1, pid, pid - FIRST_PID + 1,
+		       pid, pid - FIRST_PID + 1, n_threads + 1);
+	if(write_file(dir, "status", buf, len) != 0)
+	{
+		return -1;
+	}
+
+	len = snprintf(buf, sizeof(buf),
+		       "%u (bench-%u) S %u %u %u 0 -1 4194560 12872 391845 12 57 17 24 1041 278 20 0 %u 0 "
+		       "1337 175525888 3379 18446744073709551615 1 1 0 0 0 0 671173123 4096 1260 0 0 0 17 3 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+		       tid, pid, pid == FIRST_PID ? 1 : FIRST_PID, pid, pid, n_threads + 1);
+	if(write_file(dir, "stat", buf, len) != 0)
+	{
+		return -1;
+	}
+
+	len = snprintf(buf, sizeof(buf), "/usr/bin/bench-%u%c--config%c/etc/bench/bench.yaml%c--verbose%c", pid, 0, 0, 0, 0);
+	if(write_file(dir, "cmdline", buf, len) != 0)
+	{
+		return -1;
+	}
+
+	len = snprintf(buf, sizeof(buf), "PATH=/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin%cHOME=/root%cLANG=C.UTF-8%cHOSTNAME=bench%c",
+		       0, 0, 0, 0);
+	if(write_file(dir, "environ", buf, len) != 0)
+	{
+		return -1;
+	}
+
+	len = snprintf(buf, sizeof(buf), "0::/system.slice/bench-%u.service\n", pid);
+	if(write_file(dir, "cgroup", buf, len) != 0 ||
+	   write_file(dir, "loginuid", "4294967295", 10) != 0)
+	{
+		return -1;
+	}
+
+	/* The root links to the real one, where the scan finds the
+	 * executable and the init of the pid namespace.
+	 */
+	if(make_link(dir, "exe", "/bin/sh") != 0 ||
+	   make_link(dir, "cwd", "/") != 0 ||
+	   make_link(dir, "root", "/") != 0)
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+static int write_fds(const char* dir)
+{
+	char fd_dir[PATH_MAX];
+	char fdinfo_dir[PATH_MAX];
+	char name[32];
+	char target[64];
+	static const char fdinfo[] = "pos:\t0\nflags:\t0100002\nmnt_id:\t25\nino:\t1234\n";
+
+	if(join_path(fd_dir, dir, "fd") != 0 || join_path(fdinfo_dir, dir, "fdinfo") != 0 ||
+	   make_dir(fd_dir) != 0 || make_dir(fdinfo_dir) != 0)
+	{
+		return -1;
+	}
+
+	for(uint32_t fd = 0; fd < n_fds; fd++)
+	{
+		const char* t;
+		switch(fd % 8)
+		{
+		case 0:
+		case 1:
+			t = "/dev/null";
+			break;
+		case 2:
+		case 3:
+			t = "/etc/hostname";
+			break;
+		case 4:
+			t = "/";
+			break;
+		case 5:
+		case 6:
+			snprintf(target, sizeof(target), "pipe:[%u]", 100000 + fd);
+			t = target;
+			break;
+		default:
+			t = "anon_inode:[eventfd]";
+			break;
+		}
+
+		snprintf(name, sizeof(name), "%u", fd);
+		if(make_link(fd_dir, name, t) != 0 ||
+		   write_file(fdinfo_dir, name, fdinfo, sizeof(fdinfo) - 1) != 0)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int create_tree(void)
+{
+	char path[PATH_MAX];
+	char dir[PATH_MAX];
+	char proc[PATH_MAX];
+	char task[PATH_MAX];
+	char name[32];
+	int len;
+
+	if(mkdtemp(root) == NULL)
+	{
+		fprintf(stderr, "cannot create the temporary directory: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if(join_path(proc, root, "proc") != 0 || make_dir(proc) != 0)
+	{
+		return -1;
+	}
+
+	char buf[256];
+	len = snprintf(buf, sizeof(buf), "cpu  1 2 3 4 5 6 7 0 0 0\nbtime %lu\n", (unsigned long)time(NULL) - 3600);
+	if(write_file(proc, "stat", buf, len) != 0 ||
+	   write_file(proc, "filesystems", "nodev\tcgroup2\n", 14) != 0)
+	{
+		return -1;
+	}
+
+	for(uint32_t p = 0; p < n_procs; p++)
+	{
+		uint32_t pid = FIRST_PID + p * (n_threads + 1);
+
+		snprintf(name, sizeof(name), "%u", pid);
+		if(join_path(dir, proc, name) != 0 ||
+		   write_thread_dir(dir, pid, pid) != 0 || write_fds(dir) != 0)
+		{
+			return -1;
+		}
+
+		if(join_path(task, dir, "task") != 0 || make_dir(task) != 0)
+		{
+			return -1;
+		}
+
+		for(uint32_t t = 0; t <= n_threads; t++)
+		{
+			snprintf(name, sizeof(name), "%u", pid + t);
+			if(join_path(path, task, name) != 0 ||
+			   write_thread_dir(path, pid, pid + t) != 0)
+			{
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int remove_entry(const char* path, const struct stat* sb, int flag, struct FTW* ftwbuf)
+{
+	return remove(path);
+}
+
+static void remove_tree(void)
+{
+	nftw(root, remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+}
+
+/*=============================== BENCHMARK ===========================*/
+
+static void count_table(scap_t* h, uint64_t* threads, uint64_t* fds)
+{
+	scap_threadinfo* tinfo;
+	scap_threadinfo* ttmp;
+
+	*threads = 0;
+	*fds = 0;
+	HASH_ITER(hh, scap_get_proc_table(h), tinfo, ttmp)
+	{
+		(*threads)++;
+		*fds += HASH_COUNT(tinfo->fdlist);
+	}
+}
+
+static int run(void)
+{
+	char error[SCAP_LASTERR_SIZE] = {0};
+	int32_t res = SCAP_SUCCESS;
+	struct scap_nodriver_engine_params nodriver_params = {.full_proc_scan = true};
+	scap_open_args oargs = {.engine_name = NODRIVER_ENGINE, .mode = SCAP_MODE_NODRIVER};
+	uint64_t threads;
+	uint64_t fds;
+	uint64_t min_ns = UINT64_MAX;
+	uint64_t total_ns = 0;
+
+	oargs.engine_params = &nodriver_params;
+	oargs.proc_scan_threads = scan_threads;
+
+	/* The first scan, done by the open, warms up the caches. */
+	scap_t* h = scap_open(&oargs, error, &res);
+	if(h == NULL || res != SCAP_SUCCESS)
+	{
+		fprintf(stderr, "%s (%d)\n", error, res);
+		return EXIT_FAILURE;
+	}
+
+	count_table(h, &threads, &fds);
+	printf("[PROC-SCAN-BENCH]: %lu threads, %lu fds, %u scan threads\n", threads, fds, scan_threads);
+	printf("  %-6s %12s %14s %12s\n", "round", "ms", "us/thread", "ns/fd");
+
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		uint64_t start = get_ns();
+		if(scap_refresh_proc_table(h) != SCAP_SUCCESS)
+		{
+			fprintf(stderr, "%s\n", scap_getlasterr(h));
+			scap_close(h);
+			return EXIT_FAILURE;
+		}
+		uint64_t ns = get_ns() - start;
+
+		count_table(h, &threads, &fds);
+		printf("  %-6u %12.2f %14.2f %12.1f\n", r, ns / 1e6,
+		       threads ? (double)ns / threads / 1e3 : 0.0,
+		       fds ? (double)ns / fds : 0.0);
+		total_ns += ns;
+		if(ns < min_ns)
+		{
+			min_ns = ns;
+		}
+	}
+
+	if(rounds > 0)
+	{
+		printf("  %-6s %12.2f %14.2f\n", "mean", total_ns / 1e6 / rounds,
+		       threads ? (double)total_ns / rounds / threads / 1e3 : 0.0);
+		printf("  %-6s %12.2f %14.2f\n", "min", min_ns / 1e6,
+		       threads ? (double)min_ns / threads / 1e3 : 0.0);
+	}
+
+	scap_close(h);
+	return EXIT_SUCCESS;
+}
+
+static void print_help(void)
+{
+	printf("\n----------------------- MENU -----------------------\n");
+	printf("------> SYNTHETIC TREE\n");
+	printf("'%s <num>': number of processes. (default: %d)\n", PROCS_OPTION, DEFAULT_PROCS);
+	printf("'%s <num>': threads of every process, besides the main one. (default: %d)\n", THREADS_OPTION, DEFAULT_THREADS);
+	printf("'%s <num>': fds of every process. (default: %d)\n", FDS_OPTION, DEFAULT_FDS);
+	printf("'%s': keep the tree instead of removing it at the end.\n", KEEP_OPTION);
+	printf("\n------> CONFIGURATIONS OPTIONS\n");
+	printf("'%s': scan the /proc of the machine instead of a synthetic tree.\n", HOST_OPTION);
+	printf("'%s <num>': number of timed scans. (default: %d)\n", ROUNDS_OPTION, DEFAULT_ROUNDS);
+	printf("'%s <num>': threads scanning /proc in parallel, 0 to choose from the CPUs. (default: 0)\n", SCAN_THREADS_OPTION);
+	printf("'%s': print this menu.\n", PRINT_HELP_OPTION);
+	printf("-----------------------------------------------------\n");
+}
+
+static uint32_t parse_num(int argc, char** argv, int i, const char* what)
+{
+	if(!(i + 1 < argc))
+	{
+		printf("\nYou need to specify also the number of %s! Bye!\n", what);
+		exit(EXIT_FAILURE);
+	}
+	return strtoul(argv[i + 1], NULL, 10);
+}
+
+static void parse_CLI_options(int argc, char** argv)
+{
+	for(int i = 0; i < argc; i++)
+	{
+		if(!strcmp(argv[i], PROCS_OPTION))
+		{
+			n_procs = parse_num(argc, argv, i++, "processes");
+		}
+		if(!strcmp(argv[i], THREADS_OPTION))
+		{
+			n_threads = parse_num(argc, argv, i++, "threads");
+		}
+		if(!strcmp(argv[i], FDS_OPTION))
+		{
+			n_fds = parse_num(argc, argv, i++, "fds");
+		}
+		if(!strcmp(argv[i], ROUNDS_OPTION))
+		{
+			rounds = parse_num(argc, argv, i++, "rounds");
+		}
+		if(!strcmp(argv[i], SCAN_THREADS_OPTION))
+		{
+			scan_threads = parse_num(argc, argv, i++, "scan threads");
+		}
+		if(!strcmp(argv[i], HOST_OPTION))
+		{
+			host = true;
+		}
+		if(!strcmp(argv[i], KEEP_OPTION))
+		{
+			keep = true;
+		}
+		if(!strcmp(argv[i], PRINT_HELP_OPTION))
+		{
+			print_help();
+			exit(EXIT_SUCCESS);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int ret;
+
+	parse_CLI_options(argc, argv);
+
+	if(!host)
+	{
+		uint64_t start = get_ns();
+		if(create_tree() != 0)
+		{
+			remove_tree();
+			return EXIT_FAILURE;
+		}
+		printf("[PROC-SCAN-BENCH]: tree of %u processes created in %s in %.1f s\n", n_procs, root, (get_ns() - start) / 1e9);
+		setenv(SCAP_HOST_ROOT_ENV_VAR_NAME, root, 1);
+	}
+
+	ret = run();
+
+	if(!host && !keep)
+	{
+		remove_tree();
+	}
+	return ret;
+}
@@ -22,6 +22,7 @@ limitations under the License.
 #include "scap_linux_int.h"
 #include "strlcpy.h"
 #include "strerror.h"
+#include "clock_helpers.h"
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <fcntl.h>
@@ -30,11 +31,13 @@ limitations under the License.
 #include <inttypes.h>
 #include <unistd.h>
 #include <sys/param.h>
+#include <sys/syscall.h>
 #include <dirent.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <string.h>
+#include <pthread.h>
 
 #include <errno.h>
 #include <netinet/tcp.h>
@@ -46,10 +49,13 @@ limitations under the License.
 #endif
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
-//#include <linux/sock_diag.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
 //#include <linux/unix_diag.h>
 
 #define SOCKET_SCAN_BUFFER_SIZE 1024 * 1024
+// Size of the batches of entries of /proc/<pid>/fd read at once
+#define SCAP_FD_DIR_BUFFER_SIZE 16384
 
 void scap_fd_free_ns_sockets_list(struct scap_ns_socket_list **sockets)
 {
@@ -68,29 +74,64 @@ void scap_fd_free_ns_sockets_list(struct scap_ns_socket_list **sockets)
 	}
 }
 
-int32_t scap_fd_handle_pipe(struct scap_proclist* proclist, char *fname, scap_threadinfo *tinfo, scap_fdinfo *fdi, char *error)
+// Protects the allocation of the socket cache of the handles
+static pthread_mutex_t s_socket_cache_alloc_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct scap_socket_cache* scap_socket_cache_begin_scan(scap_t* handle)
 {
-	char link_name[SCAP_MAX_PATH_SIZE];
-	ssize_t r;
-	uint64_t ino;
-	struct stat sb;
+	struct scap_socket_cache* cache;
+	struct scap_ns_socket_list* sockets;
+	struct scap_ns_socket_list* tsockets;
 
-	r = readlink(fname, link_name, SCAP_MAX_PATH_SIZE - 1);
-	if (r <= 0)
+	pthread_mutex_lock(&s_socket_cache_alloc_lock);
+	if(handle->m_socket_cache == NULL)
 	{
-		return scap_errprintf(error, errno, "Could not read link %s", fname);
+		cache = calloc(1, sizeof(struct scap_socket_cache));
+		if(cache != NULL)
+		{
+			pthread_mutex_init(&cache->lock, NULL);
+			cache->monotonic_ts_context = SCAP_GET_CUR_TS_MS_CONTEXT_INIT;
+		}
+		handle->m_socket_cache = cache;
 	}
-	link_name[r] = '\0';
-	if(1 != sscanf(link_name, "pipe:[%"PRIi64"]", &ino))
+	cache = handle->m_socket_cache;
+	pthread_mutex_unlock(&s_socket_cache_alloc_lock);
+
+	if(cache == NULL)
 	{
-		// in this case we've got a named pipe
-		// and we've got to call stat on the link name
-		if(-1 == stat(link_name, &sb))
+		return NULL;
+	}
+
+	//
+	// Drop the namespaces read too long ago: they may be gone, and
+	// their sockets may have changed state in the meanwhile
+	//
+	pthread_mutex_lock(&cache->lock);
+	cache->scan_id++;
+	uint64_t now = scap_get_monotonic_ts_ms(&cache->monotonic_ts_context);
+	HASH_ITER(hh, cache->sockets_by_ns, sockets, tsockets)
+	{
+		if(now - sockets->read_ts_ms >= SCAP_SOCKET_CACHE_MAX_AGE_MS)
 		{
-			return SCAP_SUCCESS;
+			HASH_DEL(cache->sockets_by_ns, sockets);
+			scap_fd_free_table(&sockets->sockets);
+			free(sockets);
 		}
-		ino = sb.st_ino;
 	}
+	pthread_mutex_unlock(&cache->lock);
+
+	return cache;
+}
+
+void scap_socket_cache_free(struct scap_socket_cache* cache)
+{
+	scap_fd_free_ns_sockets_list(&cache->sockets_by_ns);
+	pthread_mutex_destroy(&cache->lock);
+	free(cache);
+}
+
+int32_t scap_fd_handle_pipe(struct scap_proclist* proclist, const char *link_name, uint64_t ino, scap_threadinfo *tinfo, scap_fdinfo *fdi, char *error)
+{
 	strlcpy(fdi->info.fname, link_name, sizeof(fdi->info.fname));
 
 	fdi->ino = ino;
@@ -213,23 +254,38 @@ uint32_t scap_get_device_by_mount_id(scap_t *handle, const char *procdir, unsign
 	return 0;
 }
 
-void scap_fd_flags_file(scap_fdinfo *fdi, const char *procdir)
+void scap_fd_flags_file(scap_fdinfo *fdi, int fdinfo_dirfd, const char *fd_name)
 {
-	char fd_dir_name[SCAP_MAX_PATH_SIZE];
-	char line[SCAP_MAX_PATH_SIZE];
-	FILE *finfo;
-
-	snprintf(fd_dir_name, SCAP_MAX_PATH_SIZE, "%sfdinfo/%" PRId64, procdir, fdi->fd);
-	finfo = fopen(fd_dir_name, "r");
-	if(finfo == NULL)
+	char buf[SCAP_MAX_PATH_SIZE];
+	char *line;
+	char *next;
+	ssize_t len;
+	int fd;
+
+	fd = openat(fdinfo_dirfd, fd_name, O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
 	{
 		return;
 	}
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if(len <= 0)
+	{
+		return;
+	}
+	buf[len] = '\0';
+
 	fdi->info.regularinfo.mount_id = 0;
 	fdi->info.regularinfo.dev = 0;
 
-	while(fgets(line, sizeof(line), finfo) != NULL)
+	for(line = buf; line != NULL && *line != '\0'; line = next)
 	{
+		next = strchr(line, '\n');
+		if(next != NULL)
+		{
+			*next++ = '\0';
+		}
+
 		// We are interested in the flags and the mnt_id.
 		//
 		// The format of the file is:
@@ -265,23 +321,10 @@ void scap_fd_flags_file(scap_fdinfo *fdi, const char *procdir)
 			}
 		}
 	}
-
-	fclose(finfo);
 }
 
-int32_t scap_fd_handle_regular_file(struct scap_proclist *proclist, char *fname, scap_threadinfo *tinfo, scap_fdinfo *fdi, const char *procdir, char *error)
+int32_t scap_fd_handle_regular_file(struct scap_proclist *proclist, const char *link_name, scap_threadinfo *tinfo, scap_fdinfo *fdi, int fdinfo_dirfd, const char *fd_name, char *error)
 {
-	char link_name[SCAP_MAX_PATH_SIZE];
-	ssize_t r;
-
-	r = readlink(fname, link_name, SCAP_MAX_PATH_SIZE - 1);
-	if (r <= 0)
-	{
-		return SCAP_SUCCESS;
-	}
-
-	link_name[r] = '\0';
-
 	if(SCAP_FD_UNSUPPORTED == fdi->type)
 	{
 		// try to classify by link name
@@ -331,7 +374,10 @@ int32_t scap_fd_handle_regular_file(struct scap_proclist *proclist, char *fname,
 	}
 	else if(fdi->type == SCAP_FD_FILE_V2)
 	{
-		scap_fd_flags_file(fdi, procdir);
+		if(fdinfo_dirfd >= 0)
+		{
+			scap_fd_flags_file(fdi, fdinfo_dirfd, fd_name);
+		}
 		strlcpy(fdi->info.regularinfo.fname, link_name, sizeof(fdi->info.regularinfo.fname));
 	}
 	else
@@ -342,58 +388,88 @@ int32_t scap_fd_handle_regular_file(struct scap_proclist *proclist, char *fname,
 	return scap_add_fd_to_proc_table(proclist, tinfo, fdi, error);
 }
 
-int32_t scap_fd_handle_socket(struct scap_proclist *proclist, char *fname, scap_threadinfo *tinfo, scap_fdinfo *fdi, char* procdir, uint64_t net_ns, struct scap_ns_socket_list **sockets_by_ns, char *error)
+//
+// (Re)read the sockets of a network namespace
+//
+static int32_t scap_fd_refresh_ns_sockets(struct scap_socket_cache* cache, char* procdir, struct scap_ns_socket_list* sockets, char *error)
 {
-	char link_name[SCAP_MAX_PATH_SIZE];
-	ssize_t r;
-	scap_fdinfo *tfdi;
-	uint64_t ino;
-	struct scap_ns_socket_list* sockets = NULL;
-	int32_t uth_status = SCAP_SUCCESS;
+	char fd_error[SCAP_LASTERR_SIZE];
 
-	if(*sockets_by_ns == (void*)-1)
+	scap_fd_free_table(&sockets->sockets);
+	sockets->read_ts_ms = scap_get_monotonic_ts_ms(&cache->monotonic_ts_context);
+	sockets->read_scan_id = cache->scan_id;
+	if(scap_fd_read_sockets(procdir, sockets, fd_error) == SCAP_FAILURE)
 	{
-		return SCAP_SUCCESS;
+		snprintf(error, SCAP_LASTERR_SIZE, "Cannot read sockets (%s)", fd_error);
+		sockets->sockets = NULL;
+		return SCAP_FAILURE;
 	}
-	else
+	return SCAP_SUCCESS;
+}
+
+//
+// Find a socket of a network namespace, reading the namespace the first
+// time it's seen. Must be called with the cache lock held.
+//
+static int32_t scap_fd_find_socket(struct scap_socket_cache* cache, char* procdir, uint64_t net_ns, uint64_t ino, scap_fdinfo **sock, char *error)
+{
+	struct scap_ns_socket_list* sockets = NULL;
+	int32_t uth_status = SCAP_SUCCESS;
+
+	*sock = NULL;
+	HASH_FIND_INT64(cache->sockets_by_ns, &net_ns, sockets);
+	if(sockets == NULL)
 	{
-		HASH_FIND_INT64(*sockets_by_ns, &net_ns, sockets);
+		sockets = malloc(sizeof(struct scap_ns_socket_list));
 		if(sockets == NULL)
 		{
-			sockets = malloc(sizeof(struct scap_ns_socket_list));
-			if(sockets == NULL)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "sockets allocation error");
-				return SCAP_FAILURE;
-			}
-			sockets->net_ns = net_ns;
-			sockets->sockets = NULL;
-			char fd_error[SCAP_LASTERR_SIZE];
+			snprintf(error, SCAP_LASTERR_SIZE, "sockets allocation error");
+			return SCAP_FAILURE;
+		}
+		sockets->net_ns = net_ns;
+		sockets->sockets = NULL;
 
-			HASH_ADD_INT64(*sockets_by_ns, net_ns, sockets);
-			if(uth_status != SCAP_SUCCESS)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "socket list allocation error");
-				free(sockets);
-				return SCAP_FAILURE;
-			}
+		HASH_ADD_INT64(cache->sockets_by_ns, net_ns, sockets);
+		if(uth_status != SCAP_SUCCESS)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "socket list allocation error");
+			free(sockets);
+			return SCAP_FAILURE;
+		}
 
-			if(scap_fd_read_sockets(procdir, sockets, fd_error) == SCAP_FAILURE)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "Cannot read sockets (%s)", fd_error);
-				sockets->sockets = NULL;
-				return SCAP_FAILURE;
-			}
+		if(scap_fd_refresh_ns_sockets(cache, procdir, sockets, error) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
 		}
 	}
 
-	r = readlink(fname, link_name, SCAP_MAX_PATH_SIZE - 1);
-	if(r <= 0)
+	HASH_FIND_INT64(sockets->sockets, &ino, *sock);
+	if(*sock == NULL && sockets->read_scan_id != cache->scan_id &&
+	   scap_get_monotonic_ts_ms(&cache->monotonic_ts_context) - sockets->read_ts_ms >= SCAP_SOCKET_CACHE_MIN_REFRESH_MS)
 	{
-		return SCAP_SUCCESS;
+		//
+		// The socket may have been created after the namespace was read
+		//
+		if(scap_fd_refresh_ns_sockets(cache, procdir, sockets, error) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+		HASH_FIND_INT64(sockets->sockets, &ino, *sock);
 	}
 
-	link_name[r] = '\0';
+	return SCAP_SUCCESS;
+}
+
+int32_t scap_fd_handle_socket(struct scap_proclist *proclist, const char *link_name, scap_threadinfo *tinfo, scap_fdinfo *fdi, char* procdir, uint64_t net_ns, struct scap_socket_cache *socket_cache, char *error)
+{
+	scap_fdinfo *tfdi;
+	uint64_t ino;
+	int32_t res;
+
+	if(socket_cache == NULL)
+	{
+		return SCAP_SUCCESS;
+	}
 
 	strlcpy(fdi->info.fname, link_name, sizeof(fdi->info.fname));
 
@@ -406,20 +482,24 @@ int32_t scap_fd_handle_socket(struct scap_proclist *proclist, char *fname, scap_
 	}
 
 	//
-	// Lookup ino in the list of sockets
+	// Lookup ino in the sockets of the namespace. The cache may be
+	// refreshed by other threads, so copy the socket under the lock
 	//
-	HASH_FIND_INT64(sockets->sockets, &ino, tfdi);
-	if(tfdi != NULL)
+	pthread_mutex_lock(&socket_cache->lock);
+	res = scap_fd_find_socket(socket_cache, procdir, net_ns, ino, &tfdi, error);
+	if(res == SCAP_SUCCESS && tfdi != NULL)
 	{
 		memcpy(&(fdi->info), &(tfdi->info), sizeof(fdi->info));
 		fdi->ino = ino;
 		fdi->type = tfdi->type;
-		return scap_add_fd_to_proc_table(proclist, tinfo, fdi, error);
 	}
-	else
+	pthread_mutex_unlock(&socket_cache->lock);
+
+	if(res != SCAP_SUCCESS || tfdi == NULL)
 	{
-		return SCAP_SUCCESS;
+		return res;
 	}
+	return scap_add_fd_to_proc_table(proclist, tinfo, fdi, error);
 }
 
 int32_t scap_fd_read_unix_sockets_from_proc_fs(const char* filename, scap_fdinfo **sockets, char *error)
@@ -1104,11 +1184,228 @@ int32_t scap_fd_read_ipv6_sockets_from_proc_fs(char *dir, int l4proto, scap_fdin
 	return uth_status;
 }
 
+//
+// Read the inet sockets of a protocol through NETLINK_SOCK_DIAG. On hosts
+// with many connections this is much cheaper than parsing /proc/net/tcp*,
+// but it only sees the network namespace we live in. Returns
+// SCAP_NOT_SUPPORTED if the caller should fall back to /proc.
+//
+static int32_t scap_fd_read_inet_sockets_from_diag(int family, int l4proto, scap_fdinfo **sockets, char *error)
+{
+	struct
+	{
+		struct nlmsghdr nlh;
+		struct inet_diag_req_v2 req;
+	} request;
+	struct sockaddr_nl nladdr = {.nl_family = AF_NETLINK};
+	scap_fdinfo* diag_sockets = NULL;
+	scap_fdinfo* fdinfo;
+	scap_fdinfo* tfdinfo;
+	int32_t uth_status = SCAP_SUCCESS;
+	int32_t res = SCAP_NOT_SUPPORTED;
+	bool done = false;
+	char* buf;
+	int fd;
+
+	fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+	if(fd < 0)
+	{
+		return SCAP_NOT_SUPPORTED;
+	}
+
+	buf = malloc(SOCKET_SCAN_BUFFER_SIZE);
+	if(buf == NULL)
+	{
+		close(fd);
+		return SCAP_NOT_SUPPORTED;
+	}
+
+	memset(&request, 0, sizeof(request));
+	request.nlh.nlmsg_len = sizeof(request);
+	request.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+	request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	request.req.sdiag_family = family;
+	request.req.sdiag_protocol = (l4proto == SCAP_L4_TCP) ? IPPROTO_TCP : IPPROTO_UDP;
+	request.req.idiag_states = ~0U;
+
+	if(sendto(fd, &request, sizeof(request), 0, (struct sockaddr*)&nladdr, sizeof(nladdr)) < 0)
+	{
+		goto out;
+	}
+
+	while(!done)
+	{
+		ssize_t len = recv(fd, buf, SOCKET_SCAN_BUFFER_SIZE, 0);
+		if(len < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(len <= 0)
+		{
+			goto out;
+		}
+
+		struct nlmsghdr* nlh = (struct nlmsghdr*)buf;
+		for(; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len))
+		{
+			if(nlh->nlmsg_type == NLMSG_DONE)
+			{
+				done = true;
+				break;
+			}
+
+			// Usually a missing *_diag kernel module
+			if(nlh->nlmsg_type == NLMSG_ERROR ||
+			   nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct inet_diag_msg)))
+			{
+				goto out;
+			}
+
+			struct inet_diag_msg* msg = NLMSG_DATA(nlh);
+
+			// Time-wait and request sockets have no inode and no fd
+			if(msg->idiag_inode == 0)
+			{
+				continue;
+			}
+
+			fdinfo = malloc(sizeof(scap_fdinfo));
+			if(fdinfo == NULL)
+			{
+				goto out;
+			}
+			fdinfo->ino = msg->idiag_inode;
+
+			//
+			// Same representation as the /proc/net readers: addresses
+			// in network order, ports in host order
+			//
+			if(family == AF_INET)
+			{
+				fdinfo->info.ipv4info.sip = msg->id.idiag_src[0];
+				fdinfo->info.ipv4info.dip = msg->id.idiag_dst[0];
+				fdinfo->info.ipv4info.sport = ntohs(msg->id.idiag_sport);
+				fdinfo->info.ipv4info.dport = ntohs(msg->id.idiag_dport);
+				if(fdinfo->info.ipv4info.dip == 0)
+				{
+					fdinfo->type = SCAP_FD_IPV4_SERVSOCK;
+					fdinfo->info.ipv4serverinfo.l4proto = l4proto;
+					fdinfo->info.ipv4serverinfo.port = fdinfo->info.ipv4info.sport;
+					fdinfo->info.ipv4serverinfo.ip = fdinfo->info.ipv4info.sip;
+				}
+				else
+				{
+					fdinfo->type = SCAP_FD_IPV4_SOCK;
+					fdinfo->info.ipv4info.l4proto = l4proto;
+				}
+			}
+			else
+			{
+				memcpy(fdinfo->info.ipv6info.sip, msg->id.idiag_src, sizeof(fdinfo->info.ipv6info.sip));
+				memcpy(fdinfo->info.ipv6info.dip, msg->id.idiag_dst, sizeof(fdinfo->info.ipv6info.dip));
+				fdinfo->info.ipv6info.sport = ntohs(msg->id.idiag_sport);
+				fdinfo->info.ipv6info.dport = ntohs(msg->id.idiag_dport);
+				if(scap_fd_is_ipv6_server_socket(fdinfo->info.ipv6info.dip))
+				{
+					fdinfo->type = SCAP_FD_IPV6_SERVSOCK;
+					fdinfo->info.ipv6serverinfo.l4proto = l4proto;
+					fdinfo->info.ipv6serverinfo.port = fdinfo->info.ipv6info.sport;
+					fdinfo->info.ipv6serverinfo.ip[0] = fdinfo->info.ipv6info.sip[0];
+					fdinfo->info.ipv6serverinfo.ip[1] = fdinfo->info.ipv6info.sip[1];
+					fdinfo->info.ipv6serverinfo.ip[2] = fdinfo->info.ipv6info.sip[2];
+					fdinfo->info.ipv6serverinfo.ip[3] = fdinfo->info.ipv6info.sip[3];
+				}
+				else
+				{
+					fdinfo->type = SCAP_FD_IPV6_SOCK;
+					fdinfo->info.ipv6info.l4proto = l4proto;
+				}
+			}
+
+			HASH_ADD_INT64(diag_sockets, ino, fdinfo);
+			if(uth_status != SCAP_SUCCESS)
+			{
+				free(fdinfo);
+				goto out;
+			}
+		}
+	}
+
+	//
+	// Only publish complete dumps, so that a failure can fall back to /proc
+	//
+	HASH_ITER(hh, diag_sockets, fdinfo, tfdinfo)
+	{
+		HASH_DEL(diag_sockets, fdinfo);
+		HASH_ADD_INT64((*sockets), ino, fdinfo);
+		if(uth_status != SCAP_SUCCESS)
+		{
+			free(fdinfo);
+			snprintf(error, SCAP_LASTERR_SIZE, "inet socket allocation error");
+			res = SCAP_FAILURE;
+			goto out;
+		}
+	}
+	res = SCAP_SUCCESS;
+
+out:
+	scap_fd_free_table(&diag_sockets);
+	free(buf);
+	close(fd);
+	return res;
+}
+
+//
+// Read the inet sockets of a protocol, through sock_diag when possible
+//
+static int32_t scap_fd_read_inet_sockets(char* filename, int family, int l4proto, bool use_diag, scap_fdinfo **sockets, char *error)
+{
+	if(use_diag)
+	{
+		int32_t res = scap_fd_read_inet_sockets_from_diag(family, l4proto, sockets, error);
+		if(res != SCAP_NOT_SUPPORTED)
+		{
+			return res;
+		}
+	}
+
+	if(family == AF_INET)
+	{
+		return scap_fd_read_ipv4_sockets_from_proc_fs(filename, l4proto, sockets, error);
+	}
+	return scap_fd_read_ipv6_sockets_from_proc_fs(filename, l4proto, sockets, error);
+}
+
+//
+// sock_diag only sees the network namespace of the calling process
+//
+static bool scap_fd_is_own_net_ns(uint64_t net_ns)
+{
+	char link_name[SCAP_MAX_PATH_SIZE];
+	uint64_t own_net_ns;
+	ssize_t r;
+
+	if(net_ns == 0)
+	{
+		return false;
+	}
+
+	r = readlink("/proc/self/ns/net", link_name, sizeof(link_name) - 1);
+	if(r <= 0)
+	{
+		return false;
+	}
+	link_name[r] = '\0';
+
+	return sscanf(link_name, "net:[%"PRIu64"]", &own_net_ns) == 1 && own_net_ns == net_ns;
+}
+
 int32_t scap_fd_read_sockets(char* procdir, struct scap_ns_socket_list *sockets, char *error)
 {
 	char filename[SCAP_MAX_PATH_SIZE];
 	char netroot[SCAP_MAX_PATH_SIZE];
 	char err_buf[SCAP_LASTERR_SIZE];
+	bool use_diag = scap_fd_is_own_net_ns(sockets->net_ns);
 
 	if(sockets->net_ns)
 	{
@@ -1126,7 +1423,7 @@ int32_t scap_fd_read_sockets(char* procdir, struct scap_ns_socket_list *sockets,
 	}
 
 	snprintf(filename, sizeof(filename), "%stcp", netroot);
-	if(scap_fd_read_ipv4_sockets_from_proc_fs(filename, SCAP_L4_TCP, &sockets->sockets, err_buf) == SCAP_FAILURE)
+	if(scap_fd_read_inet_sockets(filename, AF_INET, SCAP_L4_TCP, use_diag, &sockets->sockets, err_buf) == SCAP_FAILURE)
 	{
 		scap_fd_free_table(&sockets->sockets);
 		snprintf(error, SCAP_LASTERR_SIZE, "Could not read ipv4 tcp sockets (%s)", err_buf);
@@ -1134,7 +1431,7 @@ int32_t scap_fd_read_sockets(char* procdir, struct scap_ns_socket_list *sockets,
 	}
 
 	snprintf(filename, sizeof(filename), "%sudp", netroot);
-	if(scap_fd_read_ipv4_sockets_from_proc_fs(filename, SCAP_L4_UDP, &sockets->sockets, err_buf) == SCAP_FAILURE)
+	if(scap_fd_read_inet_sockets(filename, AF_INET, SCAP_L4_UDP, use_diag, &sockets->sockets, err_buf) == SCAP_FAILURE)
 	{
 		scap_fd_free_table(&sockets->sockets);
 		snprintf(error, SCAP_LASTERR_SIZE, "Could not read ipv4 udp sockets (%s)", err_buf);
@@ -1169,7 +1466,7 @@ int32_t scap_fd_read_sockets(char* procdir, struct scap_ns_socket_list *sockets,
     /* We assume if there is /proc/net/tcp6 that ipv6 is available */
     if(access(filename, R_OK) == 0)
     {
-		if(scap_fd_read_ipv6_sockets_from_proc_fs(filename, SCAP_L4_TCP, &sockets->sockets, err_buf) == SCAP_FAILURE)
+		if(scap_fd_read_inet_sockets(filename, AF_INET6, SCAP_L4_TCP, use_diag, &sockets->sockets, err_buf) == SCAP_FAILURE)
 		{
 			scap_fd_free_table(&sockets->sockets);
 			snprintf(error, SCAP_LASTERR_SIZE, "Could not read ipv6 tcp sockets (%s)", err_buf);
@@ -1177,7 +1474,7 @@ int32_t scap_fd_read_sockets(char* procdir, struct scap_ns_socket_list *sockets,
 		}
 
 		snprintf(filename, sizeof(filename), "%sudp6", netroot);
-		if(scap_fd_read_ipv6_sockets_from_proc_fs(filename, SCAP_L4_UDP, &sockets->sockets, err_buf) == SCAP_FAILURE)
+		if(scap_fd_read_inet_sockets(filename, AF_INET6, SCAP_L4_UDP, use_diag, &sockets->sockets, err_buf) == SCAP_FAILURE)
 		{
 			scap_fd_free_table(&sockets->sockets);
 			snprintf(error, SCAP_LASTERR_SIZE, "Could not read ipv6 udp sockets (%s)", err_buf);
@@ -1229,29 +1526,191 @@ char * decode_st_mode(struct stat* sb)
 //
 // Scan the directory containing the fd's of a proc /proc/x/fd
 //
-int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinfo, struct scap_ns_socket_list **sockets_by_ns, uint64_t* num_fds_ret, char *error)
+struct scap_linux_dirent64
+{
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+//
+// Classify an fd by the target of its link in /proc/<pid>/fd, which
+// identifies the sockets, the pipes and the anonymous inodes without a
+// stat(). Only the fds pointing to a path need one, relative to the
+// directory, to tell the files from the named pipes and the devices.
+//
+static int scap_fd_classify(int dirfd, const char *fd_name, const char *link_name, uint64_t *ino)
+{
+	struct stat sb;
+
+	*ino = 0;
+	if(strncmp(link_name, "socket:[", sizeof("socket:[") - 1) == 0)
+	{
+		return S_IFSOCK;
+	}
+	else if(sscanf(link_name, "pipe:[%"PRIu64"]", ino) == 1)
+	{
+		return S_IFIFO;
+	}
+	else if(strncmp(link_name, "anon_inode:", sizeof("anon_inode:") - 1) == 0)
+	{
+		return 0;
+	}
+
+	if(fstatat(dirfd, fd_name, &sb, 0) == -1)
+	{
+		return -1;
+	}
+	*ino = sb.st_ino;
+	return sb.st_mode & S_IFMT;
+}
+
+static int32_t scap_fd_add_from_dir(scap_t *handle, struct scap_proclist *proclist, char *procdir, scap_threadinfo *tinfo, struct scap_socket_cache *socket_cache,
+				    int dirfd, int* fdinfo_dirfd, const char* fd_name, uint64_t net_ns, bool* added, char *error)
+{
+	char link_name[SCAP_MAX_PATH_SIZE];
+	scap_fdinfo *fdi = NULL;
+	int32_t res = SCAP_SUCCESS;
+	uint64_t fd;
+	uint64_t ino;
+	ssize_t r;
+	int mode;
+
+	*added = false;
+	if(1 != sscanf(fd_name, "%"PRIu64, &fd))
+	{
+		return SCAP_SUCCESS;
+	}
+
+	// In no driver mode to limit cpu usage we just parse sockets
+	// because we are interested only on them
+	r = readlinkat(dirfd, fd_name, link_name, sizeof(link_name) - 1);
+	if(r <= 0)
+	{
+		return SCAP_SUCCESS;
+	}
+	link_name[r] = '\0';
+
+	mode = scap_fd_classify(dirfd, fd_name, link_name, &ino);
+	if(mode == -1 || (handle->m_minimal_scan && mode != S_IFSOCK))
+	{
+		return SCAP_SUCCESS;
+	}
+
+	switch(mode)
+	{
+	case S_IFIFO:
+		res = scap_fd_allocate_fdinfo(&fdi, fd, SCAP_FD_FIFO);
+		if(SCAP_FAILURE == res)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for fifo fd %" PRIu64, fd);
+			break;
+		}
+		res = scap_fd_handle_pipe(proclist, link_name, ino, tinfo, fdi, error);
+		break;
+	case S_IFREG:
+	case S_IFBLK:
+	case S_IFCHR:
+	case S_IFLNK:
+		res = scap_fd_allocate_fdinfo(&fdi, fd, SCAP_FD_FILE_V2);
+		if(SCAP_FAILURE == res)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for file fd %" PRIu64, fd);
+			break;
+		}
+		fdi->ino = ino;
+		if(*fdinfo_dirfd == -1)
+		{
+			char fdinfo_dir_name[SCAP_MAX_PATH_SIZE];
+			snprintf(fdinfo_dir_name, sizeof(fdinfo_dir_name), "%sfdinfo", procdir);
+			*fdinfo_dirfd = open(fdinfo_dir_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if(*fdinfo_dirfd == -1)
+			{
+				// Don't try again for every file
+				*fdinfo_dirfd = -2;
+			}
+		}
+		res = scap_fd_handle_regular_file(proclist, link_name, tinfo, fdi, *fdinfo_dirfd, fd_name, error);
+		break;
+	case S_IFDIR:
+		res = scap_fd_allocate_fdinfo(&fdi, fd, SCAP_FD_DIRECTORY);
+		if(SCAP_FAILURE == res)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for dir fd %" PRIu64, fd);
+			break;
+		}
+		fdi->ino = ino;
+		res = scap_fd_handle_regular_file(proclist, link_name, tinfo, fdi, -1, fd_name, error);
+		break;
+	case S_IFSOCK:
+		res = scap_fd_allocate_fdinfo(&fdi, fd, SCAP_FD_UNKNOWN);
+		if(SCAP_FAILURE == res)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for sock fd %" PRIu64, fd);
+			break;
+		}
+		res = scap_fd_handle_socket(proclist, link_name, tinfo, fdi, procdir, net_ns, socket_cache, error);
+		if(proclist->m_proc_callback == NULL)
+		{
+			// we can land here if we've got a netlink socket
+			if(fdi->type == SCAP_FD_UNKNOWN)
+			{
+				scap_fd_free_fdinfo(&fdi);
+			}
+		}
+		break;
+	default:
+		res = scap_fd_allocate_fdinfo(&fdi, fd, SCAP_FD_UNSUPPORTED);
+		if(SCAP_FAILURE == res)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for unsupported fd %" PRIu64, fd);
+			break;
+		}
+		fdi->ino = ino;
+		res = scap_fd_handle_regular_file(proclist, link_name, tinfo, fdi, -1, fd_name, error);
+		break;
+	}
+
+	if(proclist->m_proc_callback != NULL)
+	{
+		if(fdi)
+		{
+			scap_fd_free_fdinfo(&fdi);
+		}
+	}
+
+	*added = res == SCAP_SUCCESS;
+	return res;
+}
+
+int32_t scap_fd_scan_fd_dir(scap_t *handle, struct scap_proclist *proclist, char *procdir, scap_threadinfo *tinfo, struct scap_socket_cache *socket_cache, uint64_t* num_fds_ret, char *error)
 {
-	DIR *dir_p;
-	struct dirent *dir_entry_p;
 	int32_t res = SCAP_SUCCESS;
 	char fd_dir_name[SCAP_MAX_PATH_SIZE];
 	char f_name[SCAP_MAX_PATH_SIZE];
 	char link_name[SCAP_MAX_PATH_SIZE];
-	struct stat sb;
-	uint64_t fd;
-	scap_fdinfo *fdi = NULL;
+	char dirents[SCAP_FD_DIR_BUFFER_SIZE];
+	int dirfd;
+	int fdinfo_dirfd = -1;
 	uint64_t net_ns;
 	ssize_t r;
 	uint32_t fd_added = 0;
+	bool done = false;
 
 	if (num_fds_ret != NULL)
 	{
 		*num_fds_ret = 0;
 	}
 
+	//
+	// The fds are read relative to the directory and its entries are
+	// listed in batches, which saves most of the path lookups
+	//
 	snprintf(fd_dir_name, SCAP_MAX_PATH_SIZE, "%sfd", procdir);
-	dir_p = opendir(fd_dir_name);
-	if(dir_p == NULL)
+	dirfd = open(fd_dir_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(dirfd == -1)
 	{
 		snprintf(error, SCAP_LASTERR_SIZE, "error opening the directory %s", fd_dir_name);
 		return SCAP_NOTFOUND;
@@ -1275,103 +1734,45 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 		sscanf(link_name, "net:[%"PRIi64"]", &net_ns);
 	}
 
-	while((dir_entry_p = readdir(dir_p)) != NULL &&
-		(handle->m_fd_lookup_limit == 0 || fd_added < handle->m_fd_lookup_limit))
+	while(!done)
 	{
-		fdi = NULL;
-		snprintf(f_name, SCAP_MAX_PATH_SIZE, "%s/%s", fd_dir_name, dir_entry_p->d_name);
-
-		if(-1 == stat(f_name, &sb) || 1 != sscanf(dir_entry_p->d_name, "%"PRIu64, &fd))
+		long len = syscall(SYS_getdents64, dirfd, dirents, sizeof(dirents));
+		if(len <= 0)
 		{
-			continue;
+			break;
 		}
 
-		// In no driver mode to limit cpu usage we just parse sockets
-		// because we are interested only on them
-		if(handle->m_minimal_scan && !S_ISSOCK(sb.st_mode))
+		for(long pos = 0; pos < len;)
 		{
-			continue;
-		}
+			struct scap_linux_dirent64 *entry = (struct scap_linux_dirent64 *)(dirents + pos);
+			bool added;
 
-		switch(sb.st_mode & S_IFMT)
-		{
-		case S_IFIFO:
-			res = scap_fd_allocate_fdinfo(&fdi, fd, SCAP_FD_FIFO);
-			if(SCAP_FAILURE == res)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for fifo fd %" PRIu64, fd);
-				break;
-			}
-			res = scap_fd_handle_pipe(&handle->m_proclist, f_name, tinfo, fdi, error);
-			break;
-		case S_IFREG:
-		case S_IFBLK:
-		case S_IFCHR:
-		case S_IFLNK:
-			res = scap_fd_allocate_fdinfo(&fdi, fd, SCAP_FD_FILE_V2);
-			if(SCAP_FAILURE == res)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for file fd %" PRIu64, fd);
-				break;
-			}
-			fdi->ino = sb.st_ino;
-			res = scap_fd_handle_regular_file(&handle->m_proclist, f_name, tinfo, fdi, procdir, error);
-			break;
-		case S_IFDIR:
-			res = scap_fd_allocate_fdinfo(&fdi, fd, SCAP_FD_DIRECTORY);
-			if(SCAP_FAILURE == res)
+			pos += entry->d_reclen;
+			if(handle->m_fd_lookup_limit != 0 && fd_added >= handle->m_fd_lookup_limit)
 			{
-				snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for dir fd %" PRIu64, fd);
+				done = true;
 				break;
 			}
-			fdi->ino = sb.st_ino;
-			res = scap_fd_handle_regular_file(&handle->m_proclist, f_name, tinfo, fdi, procdir, error);
-			break;
-		case S_IFSOCK:
-			res = scap_fd_allocate_fdinfo(&fdi, fd, SCAP_FD_UNKNOWN);
-			if(SCAP_FAILURE == res)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for sock fd %" PRIu64, fd);
-				break;
-			}
-			res = scap_fd_handle_socket(&handle->m_proclist, f_name, tinfo, fdi, procdir, net_ns, sockets_by_ns, error);
-			if(handle->m_proclist.m_proc_callback == NULL)
-			{
-				// we can land here if we've got a netlink socket
-				if(fdi->type == SCAP_FD_UNKNOWN)
-				{
-					scap_fd_free_fdinfo(&fdi);
-				}
-			}
-			break;
-		default:
-			res = scap_fd_allocate_fdinfo(&fdi, fd, SCAP_FD_UNSUPPORTED);
-			if(SCAP_FAILURE == res)
+
+			res = scap_fd_add_from_dir(handle, proclist, procdir, tinfo, socket_cache,
+						   dirfd, &fdinfo_dirfd, entry->d_name, net_ns, &added, error);
+			if(SCAP_SUCCESS != res)
 			{
-				snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for unsupported fd %" PRIu64, fd);
+				done = true;
 				break;
 			}
-			fdi->ino = sb.st_ino;
-			res = scap_fd_handle_regular_file(&handle->m_proclist, f_name, tinfo, fdi, procdir, error);
-			break;
-		}
-
-		if(handle->m_proclist.m_proc_callback != NULL)
-		{
-			if(fdi)
+			else if(added)
 			{
-				scap_fd_free_fdinfo(&fdi);
+				++fd_added;
 			}
 		}
+	}
 
-		if(SCAP_SUCCESS != res)
-		{
-			break;
-		} else {
-			++fd_added;
-		}
+	if(fdinfo_dirfd >= 0)
+	{
+		close(fdinfo_dirfd);
 	}
-	closedir(dir_p);
+	close(dirfd);
 
 	if (num_fds_ret != NULL)
 	{
@@ -17,6 +17,7 @@ limitations under the License.
 
 #pragma once
 
+#include <pthread.h>
 #include <stdint.h>
 
 #include "uthash.h"
@@ -27,12 +28,33 @@ struct scap_ns_socket_list
 {
 	int64_t net_ns;
 	scap_fdinfo* sockets;
+	// When and in which scan the sockets were read
+	uint64_t read_ts_ms;
+	uint64_t read_scan_id;
 	UT_hash_handle hh;
 };
 
+//
+// The sockets of the network namespaces, kept across /proc scans so that
+// each lookup doesn't read the whole /proc/net tables again. A namespace is
+// read again when a socket isn't found in it, at most once per scan, and is
+// dropped once older than SCAP_SOCKET_CACHE_MAX_AGE_MS.
+//
+struct scap_socket_cache
+{
+	// Protects the whole cache, which is shared by all the scans
+	pthread_mutex_t lock;
+	struct scap_ns_socket_list* sockets_by_ns;
+	uint64_t scan_id;
+	uint64_t monotonic_ts_context;
+};
 
 // read all sockets and add them to the socket table hashed by their ino
 int32_t scap_fd_read_sockets(char* procdir, struct scap_ns_socket_list* sockets, char *error);
 void scap_fd_free_ns_sockets_list(struct scap_ns_socket_list** sockets);
-// read the file descriptors for a given process directory
-int32_t scap_fd_scan_fd_dir(scap_t* handle, char * procdir, scap_threadinfo* pi, struct scap_ns_socket_list** sockets_by_ns, uint64_t* num_fds_ret, char *error);
+// start a scan using the socket cache of the handle, allocating it if needed.
+// Returns NULL on allocation failure
+struct scap_socket_cache* scap_socket_cache_begin_scan(scap_t* handle);
+// read the file descriptors for a given process directory, and add them to proclist.
+// Sockets are looked up in socket_cache, or skipped if it's NULL
+int32_t scap_fd_scan_fd_dir(scap_t* handle, struct scap_proclist* proclist, char * procdir, scap_threadinfo* pi, struct scap_socket_cache* socket_cache, uint64_t* num_fds_ret, char *error);
@@ -28,12 +28,14 @@ limitations under the License.
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include "unixid.h"
 
 #include "scap.h"
 #include "scap-int.h"
 #include "scap_linux_int.h"
 #include "strerror.h"
+#include "strlcpy.h"
 #include "clock_helpers.h"
 #include "debug_log_helpers.h"
 
@@ -54,33 +56,120 @@ int32_t scap_proc_fill_cwd(char* error, char* procdirname, struct scap_threadinf
 	return SCAP_SUCCESS;
 }
 
-int32_t scap_proc_fill_info_from_stats(char* error, char* procdirname, struct scap_threadinfo* tinfo)
+//
+// Read a whole file of /proc into buf with a single pread(): procfs
+// fills the buffer in one go, so there's no need for the stdio buffering
+// of fopen() and another copy. buf is NUL-terminated. Returns the number
+// of bytes read, or -1 with errno set.
+//
+static ssize_t scap_proc_read_file(const char* filename, char* buf, size_t size)
+{
+	ssize_t len;
+	int err;
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+	{
+		return -1;
+	}
+
+	len = pread(fd, buf, size - 1, 0);
+	err = errno;
+	close(fd);
+	if(len < 0)
+	{
+		errno = err;
+		return -1;
+	}
+
+	buf[len] = 0;
+	return len;
+}
+
+//
+// Parse an unsigned number in the given base (10 or 16), after optional
+// blanks. Returns the first character after it, or NULL if there's none.
+//
+static const char* scap_proc_parse_u64(const char* p, int base, uint64_t* val)
+{
+	const char* start;
+	uint64_t v = 0;
+
+	while(*p == ' ' || *p == '\t')
+	{
+		p++;
+	}
+
+	for(start = p; ; p++)
+	{
+		uint32_t digit;
+		if(*p >= '0' && *p <= '9')
+		{
+			digit = *p - '0';
+		}
+		else if(base == 16 && (*p | 0x20) >= 'a' && (*p | 0x20) <= 'f')
+		{
+			digit = (*p | 0x20) - 'a' + 10;
+		}
+		else
+		{
+			break;
+		}
+		v = v * base + digit;
+	}
+
+	if(p == start)
+	{
+		return NULL;
+	}
+
+	*val = v;
+	return p;
+}
+
+static const char* scap_proc_parse_i64(const char* p, int64_t* val)
+{
+	uint64_t v;
+	bool neg = false;
+
+	while(*p == ' ' || *p == '\t')
+	{
+		p++;
+	}
+
+	if(*p == '-')
+	{
+		neg = true;
+		p++;
+	}
+
+	p = scap_proc_parse_u64(p, 10, &v);
+	if(p != NULL)
+	{
+		*val = neg ? -(int64_t)v : (int64_t)v;
+	}
+	return p;
+}
+
+//
+// Match the key at the beginning of a line of /proc/<tid>/status, and
+// return the value after it
+//
+#define STATUS_KEY(line, key) (strncmp(line, key, sizeof(key) - 1) == 0 ? line + sizeof(key) - 1 : NULL)
+
+//
+// Fill the thread info from the content of /proc/<tid>/status, read with a
+// single scap_proc_read_file(): the command name, the ids, the
+// capabilities and the memory usage
+//
+static void scap_proc_parse_status(const char* status, struct scap_threadinfo* tinfo)
 {
-	char filename[SCAP_MAX_PATH_SIZE];
 	uint32_t pidinfo_nfound = 0;
 	uint32_t caps_nfound = 0;
 	uint32_t vm_nfound = 0;
-	int64_t tmp;
-	uint32_t uid;
-	uint64_t tgid;
-	uint64_t cap_permitted;
-	uint64_t cap_effective;
-	uint64_t cap_inheritable;
-	uint64_t ppid;
-	uint64_t vpid;
-	uint64_t vtid;
-	int64_t sid;
-	int64_t pgid;
-	int64_t vpgid;
-	uint32_t vmsize_kb;
-	uint32_t vmrss_kb;
-	uint32_t vmswap_kb;
-	uint64_t pfmajor;
-	uint64_t pfminor;
-	int32_t tty;
-	char line[512];
-	char tmpc;
-	char* s;
+	const char* line;
+	const char* v;
+	uint64_t val;
+	uint64_t val2;
 
 	tinfo->uid = (uint32_t)-1;
 	tinfo->ptid = (uint32_t)-1LL;
@@ -94,184 +183,205 @@ int32_t scap_proc_fill_info_from_stats(char* error, char* procdirname, struct sc
 	tinfo->filtered_out = 0;
 	tinfo->tty = 0;
 
-	snprintf(filename, sizeof(filename), "%sstatus", procdirname);
-
-	FILE* f = fopen(filename, "r");
-	if(f == NULL)
-	{
-		ASSERT(false);
-		return scap_errprintf(error, errno, "open status file %s failed", filename);
-	}
-
-	while(fgets(line, sizeof(line), f) != NULL)
+	for(line = status; *line != 0; )
 	{
-		if(strstr(line, "Tgid") == line)
-		{
-			pidinfo_nfound++;
+		const char* eol = strchr(line, '\n');
 
-			if(sscanf(line, "Tgid: %" PRIu64, &tgid) == 1)
-			{
-				tinfo->pid = tgid;
-			}
-			else
-			{
-				ASSERT(false);
-			}
-		}
-		if(strstr(line, "Uid") == line)
+		switch(line[0])
 		{
-			pidinfo_nfound++;
-
-			if(sscanf(line, "Uid: %" PRIu64 " %" PRIu32, &tmp, &uid) == 2)
-			{
-				tinfo->uid = uid;
-			}
-			else
+		case 'N':
+			if((v = STATUS_KEY(line, "Name:")) != NULL)
 			{
-				ASSERT(false);
-			}
-		}
-		else if(strstr(line, "Gid") == line)
-		{
-			pidinfo_nfound++;
+				size_t len;
 
-			if(sscanf(line, "Gid: %" PRIu64 " %" PRIu32, &tmp, &uid) == 2)
-			{
-				tinfo->gid = uid;
-			}
-			else
-			{
-				ASSERT(false);
+				// Like the %s of sscanf, stop at the first blank
+				v += strspn(v, " \t");
+				len = strcspn(v, " \t\n");
+				if(len > sizeof(tinfo->comm) - 1)
+				{
+					len = sizeof(tinfo->comm) - 1;
+				}
+				memcpy(tinfo->comm, v, len);
+				tinfo->comm[len] = 0;
 			}
-		}
-		if(strstr(line, "CapInh") == line)
-		{
-			caps_nfound++;
-
-			if(sscanf(line, "CapInh: %" PRIx64, &cap_inheritable) == 1)
+			else if((v = STATUS_KEY(line, "NSpid:")) != NULL)
 			{
-				tinfo->cap_inheritable = cap_inheritable;
+				pidinfo_nfound++;
+				if((v = scap_proc_parse_u64(v, 10, &val)) != NULL &&
+				   scap_proc_parse_u64(v, 10, &val2) != NULL)
+				{
+					tinfo->vtid = val2;
+				}
+				else
+				{
+					tinfo->vtid = tinfo->tid;
+				}
 			}
-			else
+			else if((v = STATUS_KEY(line, "NSpgid:")) != NULL)
 			{
-				ASSERT(false);
+				pidinfo_nfound++;
+				if((v = scap_proc_parse_u64(v, 10, &val)) != NULL &&
+				   scap_proc_parse_u64(v, 10, &val2) != NULL)
+				{
+					tinfo->vpgid = val2;
+				}
 			}
-		}
-		if(strstr(line, "CapPrm") == line)
-		{
-			caps_nfound++;
-
-			if(sscanf(line, "CapPrm: %" PRIx64, &cap_permitted) == 1)
+			else if((v = STATUS_KEY(line, "NStgid:")) != NULL)
 			{
-				tinfo->cap_permitted = cap_permitted;
+				pidinfo_nfound++;
+				if((v = scap_proc_parse_u64(v, 10, &val)) != NULL &&
+				   scap_proc_parse_u64(v, 10, &val2) != NULL)
+				{
+					tinfo->vpid = val2;
+				}
+				else
+				{
+					tinfo->vpid = tinfo->pid;
+				}
 			}
-			else
+			break;
+		case 'T':
+			if((v = STATUS_KEY(line, "Tgid:")) != NULL)
 			{
-				ASSERT(false);
+				pidinfo_nfound++;
+				if(scap_proc_parse_u64(v, 10, &val) != NULL)
+				{
+					tinfo->pid = val;
+				}
+				else
+				{
+					ASSERT(false);
+				}
 			}
-		}
-		if(strstr(line, "CapEff") == line)
-		{
-			caps_nfound++;
-
-			if(sscanf(line, "CapEff: %" PRIx64, &cap_effective) == 1)
+			break;
+		case 'P':
+			if((v = STATUS_KEY(line, "PPid:")) != NULL)
 			{
-				tinfo->cap_effective = cap_effective;
+				pidinfo_nfound++;
+				if(scap_proc_parse_u64(v, 10, &val) != NULL)
+				{
+					tinfo->ptid = val;
+				}
+				else
+				{
+					ASSERT(false);
+				}
 			}
-			else
+			break;
+		case 'U':
+		case 'G':
+			// The effective id is the second one
+			if((v = STATUS_KEY(line, "Uid:")) != NULL || (v = STATUS_KEY(line, "Gid:")) != NULL)
 			{
-				ASSERT(false);
+				pidinfo_nfound++;
+				if((v = scap_proc_parse_u64(v, 10, &val)) != NULL &&
+				   scap_proc_parse_u64(v, 10, &val2) != NULL)
+				{
+					if(line[0] == 'U')
+					{
+						tinfo->uid = (uint32_t)val2;
+					}
+					else
+					{
+						tinfo->gid = (uint32_t)val2;
+					}
+				}
+				else
+				{
+					ASSERT(false);
+				}
 			}
-		}
-		else if(strstr(line, "PPid") == line)
-		{
-			pidinfo_nfound++;
-
-			if(sscanf(line, "PPid: %" PRIu64, &ppid) == 1)
+			break;
+		case 'C':
+			if((v = STATUS_KEY(line, "CapInh:")) != NULL)
 			{
-				tinfo->ptid = ppid;
+				caps_nfound++;
+				if(scap_proc_parse_u64(v, 16, &val) != NULL)
+				{
+					tinfo->cap_inheritable = val;
+				}
+				else
+				{
+					ASSERT(false);
+				}
 			}
-			else
+			else if((v = STATUS_KEY(line, "CapPrm:")) != NULL)
 			{
-				ASSERT(false);
+				caps_nfound++;
+				if(scap_proc_parse_u64(v, 16, &val) != NULL)
+				{
+					tinfo->cap_permitted = val;
+				}
+				else
+				{
+					ASSERT(false);
+				}
 			}
-		}
-		else if(strstr(line, "VmSize:") == line)
-		{
-			vm_nfound++;
-
-			if(sscanf(line, "VmSize: %" PRIu32, &vmsize_kb) == 1)
+			else if((v = STATUS_KEY(line, "CapEff:")) != NULL)
 			{
-				tinfo->vmsize_kb = vmsize_kb;
+				caps_nfound++;
+				if(scap_proc_parse_u64(v, 16, &val) != NULL)
+				{
+					tinfo->cap_effective = val;
+				}
+				else
+				{
+					ASSERT(false);
+				}
 			}
-			else
+			break;
+		case 'V':
+			if((v = STATUS_KEY(line, "VmSize:")) != NULL)
 			{
-				ASSERT(false);
+				vm_nfound++;
+				if(scap_proc_parse_u64(v, 10, &val) != NULL)
+				{
+					tinfo->vmsize_kb = (uint32_t)val;
+				}
+				else
+				{
+					ASSERT(false);
+				}
 			}
-		}
-		else if(strstr(line, "VmRSS:") == line)
-		{
-			vm_nfound++;
-
-			if(sscanf(line, "VmRSS: %" PRIu32, &vmrss_kb) == 1)
+			else if((v = STATUS_KEY(line, "VmRSS:")) != NULL)
 			{
-				tinfo->vmrss_kb = vmrss_kb;
+				vm_nfound++;
+				if(scap_proc_parse_u64(v, 10, &val) != NULL)
+				{
+					tinfo->vmrss_kb = (uint32_t)val;
+				}
+				else
+				{
+					ASSERT(false);
+				}
 			}
-			else
+			else if((v = STATUS_KEY(line, "VmSwap:")) != NULL)
 			{
-				ASSERT(false);
+				vm_nfound++;
+				if(scap_proc_parse_u64(v, 10, &val) != NULL)
+				{
+					tinfo->vmswap_kb = (uint32_t)val;
+				}
+				else
+				{
+					ASSERT(false);
+				}
 			}
+			break;
+		default:
+			break;
 		}
-		else if(strstr(line, "VmSwap:") == line)
-		{
-			vm_nfound++;
 
-			if(sscanf(line, "VmSwap: %" PRIu32, &vmswap_kb) == 1)
-			{
-				tinfo->vmswap_kb = vmswap_kb;
-			}
-			else
-			{
-				ASSERT(false);
-			}
-		}
-		else if(strstr(line, "NSpid:") == line)
-		{
-			pidinfo_nfound++;
-			if(sscanf(line, "NSpid: %*u %" PRIu64, &vtid) == 1)
-			{
-				tinfo->vtid = vtid;
-			}
-			else
-			{
-				tinfo->vtid = tinfo->tid;
-			}
-		}
-		else if(strstr(line, "NSpgid:") == line)
-		{
-			pidinfo_nfound++;
-			if(sscanf(line, "NSpgid: %*u %" PRIu64, &vpgid) == 1)
-			{
-				tinfo->vpgid = vpgid;
-			}
-		}
-		else if(strstr(line, "NStgid:") == line)
+		if(pidinfo_nfound == 7 && caps_nfound == 3 && vm_nfound == 3)
 		{
-			pidinfo_nfound++;
-			if(sscanf(line, "NStgid: %*u %" PRIu64, &vpid) == 1)
-			{
-				tinfo->vpid = vpid;
-			}
-			else
-			{
-				tinfo->vpid = tinfo->pid;
-			}
+			break;
 		}
 
-		if(pidinfo_nfound == 7 && caps_nfound == 3 && vm_nfound == 3)
+		if(eol == NULL)
 		{
 			break;
 		}
+		line = eol + 1;
 	}
 
 	// We must fetch all pidinfo information
@@ -282,69 +392,77 @@ int32_t scap_proc_fill_info_from_stats(char* error, char* procdirname, struct sc
 
 	// VM info may not be found, but it's all or nothing
 	ASSERT(vm_nfound == 0 || vm_nfound == 3);
+}
 
-	fclose(f);
+#undef STATUS_KEY
+
+//
+// Fill the thread info from /proc/<tid>/stat, read into buf: the session,
+// the tty, the page faults and the process group, unless its virtual id
+// was found in the status already
+//
+static int32_t scap_proc_fill_info_from_stat(char* error, char* procdirname, struct scap_threadinfo* tinfo, char* buf, size_t size)
+{
+	char filename[SCAP_MAX_PATH_SIZE];
+	// ppid, pgrp, session, tty_nr, tpgid, flags, minflt, cminflt, majflt
+	int64_t fields[9];
+	const char* s;
 
 	snprintf(filename, sizeof(filename), "%sstat", procdirname);
 
-	f = fopen(filename, "r");
-	if(f == NULL)
+	ssize_t ssres = scap_proc_read_file(filename, buf, size);
+	if(ssres < 0)
 	{
 		ASSERT(false);
 		return scap_errprintf(error, errno, "read stat file %s failed", filename);
 	}
-
-	size_t ssres = fread(line, 1, sizeof(line) - 1, f);
 	if(ssres == 0)
 	{
 		ASSERT(false);
-		fclose(f);
-		return scap_errprintf(error, errno, "Could not read from stat file %s", filename);
+		return scap_errprintf(error, 0, "Could not read from stat file %s", filename);
 	}
-	line[ssres] = 0;
 
-	s = strrchr(line, ')');
+	s = strrchr(buf, ')');
 	if(s == NULL)
 	{
 		ASSERT(false);
-		fclose(f);
 		return scap_errprintf(error, 0, "Could not find closing bracket in stat file %s", filename);
 	}
 
 	//
-	// Extract the line content
+	// Extract the line content, after the state
 	//
-	if(sscanf(s + 2, "%c %" PRId64 " %" PRId64 " %" PRId64 " %" PRId32 " %" PRId64 " %" PRId64 " %" PRId64 " %" PRId64 " %" PRId64,
-		&tmpc,
-		&tmp,
-		&pgid,
-		&sid,
-		&tty,
-		&tmp,
-		&tmp,
-		&pfminor,
-		&tmp,
-		&pfmajor) != 10)
+	s += 2;
+	if(*s == 0)
 	{
 		ASSERT(false);
-		fclose(f);
 		return scap_errprintf(error, 0, "Could not read expected fields from stat file %s", filename);
 	}
+	s++;
+
+	for(uint32_t j = 0; j < sizeof(fields) / sizeof(fields[0]); j++)
+	{
+		s = scap_proc_parse_i64(s, &fields[j]);
+		if(s == NULL)
+		{
+			ASSERT(false);
+			return scap_errprintf(error, 0, "Could not read expected fields from stat file %s", filename);
+		}
+	}
 
-	tinfo->pfmajor = pfmajor;
-	tinfo->pfminor = pfminor;
-	tinfo->sid = (uint64_t) sid;
+	tinfo->pfmajor = fields[8];
+	tinfo->pfminor = fields[6];
+	tinfo->sid = (uint64_t)fields[2];
 
 	// If we did not find vpgid above, set it to pgid from the
 	// global namespace.
 	if(tinfo->vpgid == 0)
 	{
-		tinfo->vpgid = pgid;
+		tinfo->vpgid = fields[1];
 	}
 
-	tinfo->tty = tty;
+	tinfo->tty = (int32_t)fields[3];
 
-	fclose(f);
 	return SCAP_SUCCESS;
 }
 
@@ -699,24 +817,33 @@ static int scap_get_cgroup_version(const char* procdirname)
 }
 
 //
-// Add a process to the list by parsing its entry under /proc
+// Add a process to the list by parsing its entry under /proc.
+// lock, if not NULL, protects the suppressed tids when several threads
+// scan /proc in parallel. Sockets are skipped if socket_cache is NULL.
 //
-static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procdirname, struct scap_ns_socket_list** sockets_by_ns, scap_threadinfo** procinfo, uint64_t* num_fds_ret, char *error)
+static int32_t scap_proc_add_from_proc(scap_t* handle, struct scap_proclist* proclist, pthread_mutex_t* lock, uint32_t tid, char* procdirname, struct scap_socket_cache* socket_cache, scap_threadinfo** procinfo, uint64_t* num_fds_ret, char *error)
 {
 	char dir_name[256];
 	char target_name[SCAP_MAX_PATH_SIZE];
 	int target_res;
 	char filename[252];
-	char line[SCAP_MAX_ENV_SIZE];
+	// Reused for the content of every file read, a byte bigger than the
+	// environment so that its whole size is read
+	char line[SCAP_MAX_ENV_SIZE + 1];
 	struct scap_threadinfo* tinfo;
 	int32_t uth_status = SCAP_SUCCESS;
-	FILE* f;
-	size_t filesize;
+	ssize_t filesize;
 	size_t exe_len;
 	bool free_tinfo = false;
 	int32_t res = SCAP_SUCCESS;
 	struct stat dirstat;
+	char fill_error[SCAP_LASTERR_SIZE];
 
+	fill_error[0] = 0;
+	if(num_fds_ret != NULL)
+	{
+		*num_fds_ret = 0;
+	}
 
 	if (handle->m_cgroup_version == 0)
 	{
@@ -745,23 +872,10 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 		//    we accept it.
 		//
 		snprintf(filename, sizeof(filename), "%scmdline", dir_name);
-		f = fopen(filename, "r");
-		if(f == NULL)
-		{
-			return SCAP_SUCCESS;
-		}
-
-		ASSERT(sizeof(line) >= SCAP_MAX_PATH_SIZE);
-
-		if(fgets(line, SCAP_MAX_PATH_SIZE, f) == NULL)
+		if(scap_proc_read_file(filename, line, SCAP_MAX_PATH_SIZE) <= 0)
 		{
-			fclose(f);
 			return SCAP_SUCCESS;
 		}
-		else
-		{
-			fclose(f);
-		}
 
 		target_name[0] = 0;
 	}
@@ -774,10 +888,9 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 	//
 	// This is a real user level process. Allocate the procinfo structure.
 	//
-	if((tinfo = scap_proc_alloc(handle)) == NULL)
+	if((tinfo = (struct scap_threadinfo*) calloc(1, sizeof(scap_threadinfo))) == NULL)
 	{
-		// Error message saved in handle->m_lasterr
-		return scap_errprintf(error, 0, "can't allocate procinfo struct: %s", handle->m_lasterr);
+		return scap_errprintf(error, 0, "can't allocate procinfo struct: process table allocation error (1)");
 	}
 
 	tinfo->tid = tid;
@@ -790,34 +903,36 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 	snprintf(tinfo->exepath, sizeof(tinfo->exepath), "%s", target_name);
 
 	//
-	// Gather the command name
+	// Gather the command name, the user id, the ppid and the rest of
+	// /proc/pid/status
 	//
 	snprintf(filename, sizeof(filename), "%sstatus", dir_name);
 
-	f = fopen(filename, "r");
-	if(f == NULL)
+	filesize = scap_proc_read_file(filename, line, sizeof(line));
+	if(filesize < 0)
 	{
 		free(tinfo);
 		return scap_errprintf(error, errno, "can't open %s", filename);
 	}
-	else
+	else if(filesize == 0)
 	{
-		ASSERT(sizeof(line) >= SCAP_MAX_PATH_SIZE);
-
-		if(fgets(line, SCAP_MAX_PATH_SIZE, f) == NULL)
-		{
-			fclose(f);
-			free(tinfo);
-			return scap_errprintf(error, errno, "can't read from %s", filename);
-		}
-
-		line[SCAP_MAX_PATH_SIZE - 1] = 0;
-		sscanf(line, "Name:%1024s", tinfo->comm);
-		fclose(f);
+		free(tinfo);
+		return scap_errprintf(error, 0, "can't read from %s", filename);
 	}
 
+	scap_proc_parse_status(line, tinfo);
+
 	bool suppressed;
-	if ((res = scap_update_suppressed(&handle->m_suppress, tinfo->comm, tid, 0, &suppressed)) != SCAP_SUCCESS)
+	if(lock != NULL)
+	{
+		pthread_mutex_lock(lock);
+	}
+	res = scap_update_suppressed(&handle->m_suppress, tinfo->comm, tid, 0, &suppressed);
+	if(lock != NULL)
+	{
+		pthread_mutex_unlock(lock);
+	}
+	if (res != SCAP_SUCCESS)
 	{
 		free(tinfo);
 		return scap_errprintf(error, 0, "can't update set of suppressed tids");
@@ -834,41 +949,33 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 	//
 	snprintf(filename, sizeof(filename), "%scmdline", dir_name);
 
-	f = fopen(filename, "r");
-	if(f == NULL)
+	ASSERT(sizeof(line) >= SCAP_MAX_ARGS_SIZE);
+
+	filesize = scap_proc_read_file(filename, line, SCAP_MAX_ARGS_SIZE);
+	if(filesize < 0)
 	{
 		free(tinfo);
 		return scap_errprintf(error, errno, "can't open cmdline file %s", filename);
 	}
-	else
+	else if(filesize > 0)
 	{
-		ASSERT(sizeof(line) >= SCAP_MAX_ARGS_SIZE);
-
-		filesize = fread(line, 1, SCAP_MAX_ARGS_SIZE - 1, f);
-		if(filesize > 0)
+		exe_len = strlen(line);
+		if(exe_len < (size_t)filesize)
 		{
-			line[filesize] = 0;
-
-			exe_len = strlen(line);
-			if(exe_len < filesize)
-			{
-				++exe_len;
-			}
-
-			snprintf(tinfo->exe, SCAP_MAX_PATH_SIZE, "%s", line);
+			++exe_len;
+		}
 
-			tinfo->args_len = filesize - exe_len;
+		snprintf(tinfo->exe, SCAP_MAX_PATH_SIZE, "%s", line);
 
-			memcpy(tinfo->args, line + exe_len, tinfo->args_len);
-			tinfo->args[SCAP_MAX_ARGS_SIZE - 1] = 0;
-		}
-		else
-		{
-			tinfo->args[0] = 0;
-			tinfo->exe[0] = 0;
-		}
+		tinfo->args_len = filesize - exe_len;
 
-		fclose(f);
+		memcpy(tinfo->args, line + exe_len, tinfo->args_len);
+		tinfo->args[SCAP_MAX_ARGS_SIZE - 1] = 0;
+	}
+	else
+	{
+		tinfo->args[0] = 0;
+		tinfo->exe[0] = 0;
 	}
 
 	//
@@ -876,53 +983,46 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 	//
 	snprintf(filename, sizeof(filename), "%senviron", dir_name);
 
-	f = fopen(filename, "r");
-	if(f == NULL)
+	ASSERT(sizeof(line) > SCAP_MAX_ENV_SIZE);
+
+	filesize = scap_proc_read_file(filename, line, SCAP_MAX_ENV_SIZE + 1);
+	if(filesize < 0)
 	{
 		free(tinfo);
 		return scap_errprintf(error, errno, "can't open environ file %s", filename);
 	}
-	else
+	else if(filesize > 0)
 	{
-		ASSERT(sizeof(line) >= SCAP_MAX_ENV_SIZE);
+		line[filesize - 1] = 0;
 
-		filesize = fread(line, 1, SCAP_MAX_ENV_SIZE, f);
-
-		if(filesize > 0)
-		{
-			line[filesize - 1] = 0;
+		tinfo->env_len = filesize;
 
-			tinfo->env_len = filesize;
-
-			memcpy(tinfo->env, line, tinfo->env_len);
-			tinfo->env[SCAP_MAX_ENV_SIZE - 1] = 0;
-		}
-		else
-		{
-			tinfo->env[0] = 0;
-		}
-
-		fclose(f);
-	}
+		memcpy(tinfo->env, line, tinfo->env_len);
+		tinfo->env[SCAP_MAX_ENV_SIZE - 1] = 0;
+	}
+	else
+	{
+		tinfo->env[0] = 0;
+	}
 
 	//
 	// set the current working directory of the process
 	//
-	if(SCAP_FAILURE == scap_proc_fill_cwd(handle->m_lasterr, dir_name, tinfo))
+	if(SCAP_FAILURE == scap_proc_fill_cwd(fill_error, dir_name, tinfo))
 	{
 		free(tinfo);
 		return scap_errprintf(error, 0, "can't fill cwd for %s (%s)",
-			 dir_name, handle->m_lasterr);
+			 dir_name, fill_error);
 	}
 
 	//
-	// extract the user id and ppid from /proc/pid/status
+	// extract the session, the tty and the page faults from /proc/pid/stat
 	//
-	if(SCAP_FAILURE == scap_proc_fill_info_from_stats(handle->m_lasterr, dir_name, tinfo))
+	if(SCAP_FAILURE == scap_proc_fill_info_from_stat(fill_error, dir_name, tinfo, line, sizeof(line)))
 	{
 		free(tinfo);
 		return scap_errprintf(error, 0, "can't fill uid and pid for %s (%s)",
-			 dir_name, handle->m_lasterr);
+			 dir_name, fill_error);
 	}
 
 	//
@@ -932,17 +1032,17 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 	{
 		free(tinfo);
 		return scap_errprintf(error, 0, "can't fill flimit for %s (%s)",
-			 dir_name, handle->m_lasterr);
+			 dir_name, fill_error);
 	}
 
-	if(scap_proc_fill_cgroups(handle->m_lasterr, handle->m_cgroup_version, tinfo, dir_name) == SCAP_FAILURE)
+	if(scap_proc_fill_cgroups(fill_error, handle->m_cgroup_version, tinfo, dir_name) == SCAP_FAILURE)
 	{
 		free(tinfo);
 		return scap_errprintf(error, 0, "can't fill cgroups for %s (%s)",
-			 dir_name, handle->m_lasterr);
+			 dir_name, fill_error);
 	}
 
-	if(scap_proc_fill_pidns_start_ts(handle->m_lasterr, tinfo, dir_name) == SCAP_FAILURE)
+	if(scap_proc_fill_pidns_start_ts(fill_error, tinfo, dir_name) == SCAP_FAILURE)
 	{
 		// ignore errors
 		// the thread may not have /proc visible so we shouldn't kill the scan if this fails
@@ -963,21 +1063,21 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 	//
 	// set the current root of the process
 	//
-	if(SCAP_FAILURE == scap_proc_fill_root(handle->m_lasterr, tinfo, dir_name))
+	if(SCAP_FAILURE == scap_proc_fill_root(fill_error, tinfo, dir_name))
 	{
 		free(tinfo);
 		return scap_errprintf(error, 0, "can't fill root for %s (%s)",
-			 dir_name, handle->m_lasterr);
+			 dir_name, fill_error);
 	}
 
 	//
 	// set the loginuid
 	//
-	if(SCAP_FAILURE == scap_proc_fill_loginuid(handle->m_lasterr, tinfo, dir_name))
+	if(SCAP_FAILURE == scap_proc_fill_loginuid(fill_error, tinfo, dir_name))
 	{
 		free(tinfo);
 		return scap_errprintf(error, 0, "can't fill loginuid for %s (%s)",
-			 dir_name, handle->m_lasterr);
+			 dir_name, fill_error);
 	}
 
 	// Container start time for host processes will be equal to when the
@@ -1007,18 +1107,18 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 		tinfo->flags = PPM_CL_CLONE_THREAD | PPM_CL_CLONE_FILES;
 	}
 
-	if(SCAP_FAILURE == scap_proc_fill_exe_ino_ctime_mtime(handle->m_lasterr, tinfo, dir_name, target_name))
+	if(SCAP_FAILURE == scap_proc_fill_exe_ino_ctime_mtime(fill_error, tinfo, dir_name, target_name))
 	{
 		free(tinfo);
 		return scap_errprintf(error, 0, "can't fill exe writable access for %s (%s)",
-			 dir_name, handle->m_lasterr);
+			 dir_name, fill_error);
 	}
 
-	if(SCAP_FAILURE == scap_proc_fill_exe_writable(handle->m_lasterr, tinfo, tinfo->uid, tinfo->gid, dir_name, target_name))
+	if(SCAP_FAILURE == scap_proc_fill_exe_writable(fill_error, tinfo, tinfo->uid, tinfo->gid, dir_name, target_name))
 	{
 		free(tinfo);
 		return scap_errprintf(error, 0, "can't fill exe writable access for %s (%s)",
-			 dir_name, handle->m_lasterr);
+			 dir_name, fill_error);
 	}
 
 	//
@@ -1030,9 +1130,9 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 		//
 		// Done. Add the entry to the process table, or fire the notification callback
 		//
-		if(handle->m_proclist.m_proc_callback == NULL)
+		if(proclist->m_proc_callback == NULL)
 		{
-			HASH_ADD_INT64(handle->m_proclist.m_proclist, tid, tinfo);
+			HASH_ADD_INT64(proclist->m_proclist, tid, tinfo);
 			if(uth_status != SCAP_SUCCESS)
 			{
 				free(tinfo);
@@ -1041,8 +1141,8 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 		}
 		else
 		{
-			handle->m_proclist.m_proc_callback(
-				handle->m_proclist.m_proc_callback_context, tinfo->tid, tinfo, NULL);
+			proclist->m_proc_callback(
+				proclist->m_proc_callback_context, tinfo->tid, tinfo, NULL);
 			free_tinfo = true;
 		}
 	}
@@ -1052,11 +1152,12 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 	}
 
 	//
-	// Only add fds for processes, not threads
+	// Only add fds for processes, not threads. In lazy mode, the full scan
+	// leaves them to scap_proc_get_fds()
 	//
-	if(tinfo->pid == tinfo->tid)
+	if(tinfo->pid == tinfo->tid && (procinfo != NULL || !handle->m_proc_scan_lazy_fds))
 	{
-		res = scap_fd_scan_fd_dir(handle, dir_name, tinfo, sockets_by_ns, num_fds_ret, error);
+		res = scap_fd_scan_fd_dir(handle, proclist, dir_name, tinfo, socket_cache, num_fds_ret, error);
 	}
 
 	if(free_tinfo)
@@ -1072,34 +1173,170 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 //
 int32_t scap_proc_read_thread(scap_t* handle, char* procdirname, uint64_t tid, struct scap_threadinfo** pi, char *error, bool scan_sockets)
 {
-	struct scap_ns_socket_list* sockets_by_ns = NULL;
+	struct scap_socket_cache* socket_cache = NULL;
 
 	int32_t res;
 	char add_error[SCAP_LASTERR_SIZE];
 
-	if(!scan_sockets)
+	if(scan_sockets)
 	{
-		sockets_by_ns = (void*)-1;
+		socket_cache = scap_socket_cache_begin_scan(handle);
+		if(socket_cache == NULL)
+		{
+			return scap_errprintf(error, 0, "socket cache allocation error");
+		}
 	}
 
-	res = scap_proc_add_from_proc(handle, tid, procdirname, &sockets_by_ns, pi, NULL, add_error);
+	res = scap_proc_add_from_proc(handle, &handle->m_proclist, NULL, tid, procdirname, socket_cache, pi, NULL, add_error);
 	if(res != SCAP_SUCCESS)
 	{
 		scap_errprintf(error, 0, "cannot add proc tid = %"PRIu64", dirname = %s, error=%s", tid, procdirname, add_error);
 	}
 
-	if(sockets_by_ns != NULL && sockets_by_ns != (void*)-1)
+	return res;
+}
+
+//
+// Progress tracking of the top-level /proc scan, for the timeout and the logs
+//
+struct scap_proc_scan_timing
+{
+	bool enabled;
+	uint64_t monotonic_ts_context;
+	uint64_t start_ts_ms;
+	uint64_t last_log_ts_ms;
+	uint64_t last_proc_ts_ms;
+	uint64_t min_proc_time_ms;
+	uint64_t max_proc_time_ms;
+	uint64_t num_procs_processed;
+	uint64_t total_num_fds;
+	uint64_t last_tid_processed;
+};
+
+static void scap_proc_scan_timing_init(scap_t* handle, struct scap_proc_scan_timing* timing, bool top_level)
+{
+	memset(timing, 0, sizeof(*timing));
+	timing->monotonic_ts_context = SCAP_GET_CUR_TS_MS_CONTEXT_INIT;
+	timing->min_proc_time_ms = UINT64_MAX;
+
+	// Do timing tracking only if:
+	// - this is the top-level call
+	// - one or both of the timing parameters is configured to non-zero
+	timing->enabled = top_level &&
+	                  ((handle->m_proc_scan_timeout_ms != SCAP_PROC_SCAN_TIMEOUT_NONE) ||
+	                   (handle->m_proc_scan_log_interval_ms != SCAP_PROC_SCAN_LOG_NONE));
+
+	if (timing->enabled)
 	{
-		scap_fd_free_ns_sockets_list(&sockets_by_ns);
+		timing->start_ts_ms = scap_get_monotonic_ts_ms(&timing->monotonic_ts_context);
+		timing->last_log_ts_ms = timing->start_ts_ms;
+		timing->last_proc_ts_ms = timing->start_ts_ms;
 	}
+}
 
-	return res;
+//
+// Account for a successfully processed process.
+// Returns true if the scan timeout expired.
+//
+static bool scap_proc_scan_timing_update(scap_t* handle, struct scap_proc_scan_timing* timing, uint64_t tid, uint64_t num_fds)
+{
+	timing->last_tid_processed = tid;
+	timing->num_procs_processed++;
+	timing->total_num_fds += num_fds;
+
+	if (!timing->enabled)
+	{
+		return false;
+	}
+
+	uint64_t cur_ts_ms = scap_get_monotonic_ts_ms(&timing->monotonic_ts_context);
+	uint64_t total_elapsed_time_ms = cur_ts_ms - timing->start_ts_ms;
+
+	uint64_t this_proc_elapsed_time_ms = cur_ts_ms - timing->last_proc_ts_ms;
+	timing->last_proc_ts_ms = cur_ts_ms;
+
+	if (this_proc_elapsed_time_ms < timing->min_proc_time_ms)
+	{
+		timing->min_proc_time_ms = this_proc_elapsed_time_ms;
+	}
+	if (this_proc_elapsed_time_ms > timing->max_proc_time_ms)
+	{
+		timing->max_proc_time_ms = this_proc_elapsed_time_ms;
+	}
+
+	if (handle->m_proc_scan_log_interval_ms != SCAP_PROC_SCAN_LOG_NONE)
+	{
+		uint64_t log_elapsed_time_ms = cur_ts_ms - timing->last_log_ts_ms;
+		if (log_elapsed_time_ms >= handle->m_proc_scan_log_interval_ms)
+		{
+			scap_debug_log(handle,
+				"scap_proc_scan: %ld proc in %ld ms, avg=%ld/min=%ld/max=%ld, last pid %ld, num_fds %ld",
+				timing->num_procs_processed,
+				total_elapsed_time_ms,
+				(total_elapsed_time_ms / (uint64_t)timing->num_procs_processed),
+				timing->min_proc_time_ms,
+				timing->max_proc_time_ms,
+				timing->last_tid_processed,
+				timing->total_num_fds);
+			timing->last_log_ts_ms = cur_ts_ms;
+		}
+	}
+
+	if (handle->m_proc_scan_timeout_ms != SCAP_PROC_SCAN_TIMEOUT_NONE)
+	{
+		if (total_elapsed_time_ms >= handle->m_proc_scan_timeout_ms)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void scap_proc_scan_timing_done(scap_t* handle, struct scap_proc_scan_timing* timing, bool timeout_expired)
+{
+	if (!timing->enabled)
+	{
+		return;
+	}
+
+	uint64_t cur_ts_ms = scap_get_monotonic_ts_ms(&timing->monotonic_ts_context);
+	uint64_t total_elapsed_time_ms = cur_ts_ms - timing->start_ts_ms;
+	uint64_t avg_proc_time_ms = (timing->num_procs_processed != 0) ?
+		(total_elapsed_time_ms / timing->num_procs_processed) : 0;
+
+	if (timeout_expired)
+	{
+		scap_debug_log(handle,
+			"scap_proc_scan TIMEOUT (%ld ms): %ld proc in %ld ms, avg=%ld/min=%ld/max=%ld, last pid %ld, num_fds %ld",
+			handle->m_proc_scan_timeout_ms,
+			timing->num_procs_processed,
+			total_elapsed_time_ms,
+			avg_proc_time_ms,
+			timing->min_proc_time_ms,
+			timing->max_proc_time_ms,
+			timing->last_tid_processed,
+			timing->total_num_fds);
+	}
+	else if ((handle->m_proc_scan_log_interval_ms != SCAP_PROC_SCAN_LOG_NONE) &&
+		(timing->num_procs_processed != 0))
+	{
+		scap_debug_log(handle,
+			"scap_proc_scan DONE: %ld proc in %ld ms, avg=%ld/min=%ld/max=%ld, last pid %ld, num_fds %ld",
+			timing->num_procs_processed,
+			total_elapsed_time_ms,
+			avg_proc_time_ms,
+			timing->min_proc_time_ms,
+			timing->max_proc_time_ms,
+			timing->last_tid_processed,
+			timing->total_num_fds);
+	}
 }
 
 //
 // Scan a directory containing multiple processes under /proc
 //
-static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, char* procdirname, int parenttid, char *error)
+static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, struct scap_proclist* proclist, pthread_mutex_t* lock, struct scap_socket_cache* socket_cache, char* procdirname, int parenttid, char *error)
 {
 	DIR *dir_p;
 	struct dirent *dir_entry_p;
@@ -1107,11 +1344,7 @@ static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, char* procdirname,
 	uint64_t tid;
 	int32_t res = SCAP_SUCCESS;
 	char childdir[SCAP_MAX_PATH_SIZE];
-
-	uint64_t num_procs_processed = 0;
-	uint64_t total_num_fds = 0;
-	uint64_t last_tid_processed = 0;
-	struct scap_ns_socket_list* sockets_by_ns = NULL;
+	struct scap_proc_scan_timing timing;
 
 	dir_p = opendir(procdirname);
 
@@ -1121,26 +1354,7 @@ static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, char* procdirname,
 		return SCAP_NOTFOUND;
 	}
 
-	// Do timing tracking only if:
-	// - this is the top-level call (parenttid == -1)
-	// - one or both of the timing parameters is configured to non-zero
-	bool do_timing = (parenttid == -1) &&
-	                 ((handle->m_proc_scan_timeout_ms != SCAP_PROC_SCAN_TIMEOUT_NONE) ||
-	                  (handle->m_proc_scan_log_interval_ms != SCAP_PROC_SCAN_LOG_NONE));
-	uint64_t monotonic_ts_context = SCAP_GET_CUR_TS_MS_CONTEXT_INIT;
-	uint64_t start_ts_ms = 0;
-	uint64_t last_log_ts_ms = 0;
-	uint64_t last_proc_ts_ms = 0;
-	uint64_t cur_ts_ms = 0;
-	uint64_t min_proc_time_ms = UINT64_MAX;
-	uint64_t max_proc_time_ms = 0;
-
-	if (do_timing)
-	{
-		start_ts_ms = scap_get_monotonic_ts_ms(&monotonic_ts_context);
-		last_log_ts_ms = start_ts_ms;
-		last_proc_ts_ms = start_ts_ms;
-	}
+	scap_proc_scan_timing_init(handle, &timing, parenttid == -1);
 
 	bool timeout_expired = false;
 	while (!timeout_expired)
@@ -1175,7 +1389,7 @@ static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, char* procdirname,
 		// are an error, or at least unexpected. Check the process
 		// list to see if we've encountered this tid already
 		//
-		HASH_FIND_INT64(handle->m_proclist.m_proclist, &tid, tinfo);
+		HASH_FIND_INT64(proclist->m_proclist, &tid, tinfo);
 		if(tinfo != NULL)
 		{
 			ASSERT(false);
@@ -1189,7 +1403,7 @@ static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, char* procdirname,
 		// We have a process that needs to be explored
 		//
 		uint64_t num_fds_this_proc;
-		res = scap_proc_add_from_proc(handle, tid, procdirname, &sockets_by_ns, NULL, &num_fds_this_proc, add_error);
+		res = scap_proc_add_from_proc(handle, proclist, lock, tid, procdirname, socket_cache, NULL, &num_fds_this_proc, add_error);
 		if(res != SCAP_SUCCESS)
 		{
 			//
@@ -1215,7 +1429,7 @@ static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, char* procdirname,
 		if(parenttid == -1 && !handle->m_minimal_scan)
 		{
 			snprintf(childdir, sizeof(childdir), "%s/%u/task", procdirname, (int)tid);
-			if(_scap_proc_scan_proc_dir_impl(handle, childdir, tid, error) == SCAP_FAILURE)
+			if(_scap_proc_scan_proc_dir_impl(handle, proclist, lock, socket_cache, childdir, tid, error) == SCAP_FAILURE)
 			{
 				res = SCAP_FAILURE;
 				break;
@@ -1223,97 +1437,360 @@ static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, char* procdirname,
 		}
 
 		// TID successfully processed.
-		last_tid_processed = tid;
-		num_procs_processed++;
-		total_num_fds += num_fds_this_proc;
-
 		// After successful processing of a process at the top level,
 		// perform timing processing if configured.
-		if (do_timing)
-		{
-			cur_ts_ms = scap_get_monotonic_ts_ms(&monotonic_ts_context);
-			uint64_t total_elapsed_time_ms = cur_ts_ms - start_ts_ms;
+		timeout_expired = scap_proc_scan_timing_update(handle, &timing, tid, num_fds_this_proc);
+	}
 
-			uint64_t this_proc_elapsed_time_ms = cur_ts_ms - last_proc_ts_ms;
-			last_proc_ts_ms = cur_ts_ms;
+	scap_proc_scan_timing_done(handle, &timing, timeout_expired);
 
-			if (this_proc_elapsed_time_ms < min_proc_time_ms)
+	closedir(dir_p);
+	return res;
+}
+
+//
+// Parallel scan of /proc.
+//
+// The main thread lists the processes, the workers read them (along with
+// their tasks and fds) into per-process lists, and the main thread then adds
+// the lists to the process table, or passes them to the callback, in the
+// same order as the serial scan would. The workers only run up to
+// SCAP_PROC_SCAN_WINDOW processes ahead of the main thread, to bound the
+// memory used by the lists waiting to be consumed.
+//
+#define SCAP_PROC_SCAN_WINDOW 1024
+
+struct scap_proc_scan_entry
+{
+	uint64_t tid;
+	bool done;
+	// false if the process couldn't be read completely, in which case
+	// its tasks are skipped, as in the serial scan
+	bool complete;
+	uint64_t num_fds;
+	// The process and its tasks, in /proc order, with their fds
+	scap_threadinfo* threads;
+};
+
+struct scap_proc_scan_state
+{
+	scap_t* handle;
+	char* procdirname;
+
+	// Protects the suppressed tids, which are shared by all the workers
+	pthread_mutex_t lock;
+	struct scap_socket_cache* socket_cache;
+
+	// Protects the fields below
+	pthread_mutex_t queue_lock;
+	pthread_cond_t queue_cond;
+	struct scap_proc_scan_entry* entries;
+	uint64_t n_entries;
+	uint64_t next_entry;
+	uint64_t n_consumed;
+	bool stop;
+	int32_t res;
+	char error[SCAP_LASTERR_SIZE];
+};
+
+static void scap_proc_scan_free_threads(scap_t* handle, scap_threadinfo** threads)
+{
+	scap_threadinfo* tinfo;
+	scap_threadinfo* ttinfo;
+
+	HASH_ITER(hh, *threads, tinfo, ttinfo)
+	{
+		HASH_DEL(*threads, tinfo);
+		scap_proc_free(handle, tinfo);
+	}
+}
+
+static void scap_proc_scan_read_entry(struct scap_proc_scan_state* state, struct scap_proc_scan_entry* entry)
+{
+	scap_t* handle = state->handle;
+	char add_error[SCAP_LASTERR_SIZE];
+	char childdir[SCAP_MAX_PATH_SIZE];
+
+	//
+	// Read everything in a private list, without invoking the callback
+	//
+	struct scap_proclist proclist = {0};
+
+	if(scap_proc_add_from_proc(handle, &proclist, &state->lock, entry->tid, state->procdirname,
+				   state->socket_cache, NULL, &entry->num_fds, add_error) != SCAP_SUCCESS)
+	{
+		// Keep whatever was read, see _scap_proc_scan_proc_dir_impl
+		entry->threads = proclist.m_proclist;
+		return;
+	}
+
+	if(!handle->m_minimal_scan)
+	{
+		snprintf(childdir, sizeof(childdir), "%s/%u/task", state->procdirname, (int)entry->tid);
+		if(_scap_proc_scan_proc_dir_impl(handle, &proclist, &state->lock, state->socket_cache, childdir, entry->tid, add_error) == SCAP_FAILURE)
+		{
+			scap_proc_scan_free_threads(handle, &proclist.m_proclist);
+
+			pthread_mutex_lock(&state->queue_lock);
+			if(state->res == SCAP_SUCCESS)
 			{
-				min_proc_time_ms = this_proc_elapsed_time_ms;
+				state->res = SCAP_FAILURE;
+				strlcpy(state->error, add_error, sizeof(state->error));
 			}
-			if (this_proc_elapsed_time_ms > max_proc_time_ms)
+			pthread_mutex_unlock(&state->queue_lock);
+			return;
+		}
+	}
+
+	entry->complete = true;
+	entry->threads = proclist.m_proclist;
+}
+
+static void* scap_proc_scan_worker(void* arg)
+{
+	struct scap_proc_scan_state* state = (struct scap_proc_scan_state*)arg;
+
+	while(true)
+	{
+		pthread_mutex_lock(&state->queue_lock);
+		while(!state->stop &&
+		      state->next_entry < state->n_entries &&
+		      state->next_entry >= state->n_consumed + SCAP_PROC_SCAN_WINDOW)
+		{
+			pthread_cond_wait(&state->queue_cond, &state->queue_lock);
+		}
+
+		if(state->stop || state->next_entry >= state->n_entries)
+		{
+			pthread_mutex_unlock(&state->queue_lock);
+			break;
+		}
+
+		struct scap_proc_scan_entry* entry = &state->entries[state->next_entry++];
+		pthread_mutex_unlock(&state->queue_lock);
+
+		scap_proc_scan_read_entry(state, entry);
+
+		pthread_mutex_lock(&state->queue_lock);
+		entry->done = true;
+		pthread_cond_broadcast(&state->queue_cond);
+		pthread_mutex_unlock(&state->queue_lock);
+	}
+
+	return NULL;
+}
+
+//
+// Add the threads read by a worker to the process table, or fire the
+// notification callback for them and their fds
+//
+static int32_t scap_proc_scan_add_entry(scap_t* handle, struct scap_proc_scan_entry* entry, char* error)
+{
+	struct scap_proclist* proclist = &handle->m_proclist;
+	scap_threadinfo* tinfo;
+	scap_threadinfo* ttinfo;
+	scap_threadinfo* dup;
+	scap_fdinfo* fdi;
+	scap_fdinfo* tfdi;
+	int32_t uth_status = SCAP_SUCCESS;
+
+	HASH_ITER(hh, entry->threads, tinfo, ttinfo)
+	{
+		HASH_DEL(entry->threads, tinfo);
+
+		if(proclist->m_proc_callback == NULL)
+		{
+			HASH_FIND_INT64(proclist->m_proclist, &tinfo->tid, dup);
+			if(dup != NULL)
 			{
-				max_proc_time_ms = this_proc_elapsed_time_ms;
+				ASSERT(false);
+				scap_proc_free(handle, tinfo);
+				return scap_errprintf(error, 0, "duplicate process %"PRIu64, tinfo->tid);
 			}
 
-			if (handle->m_proc_scan_log_interval_ms != SCAP_PROC_SCAN_LOG_NONE)
+			HASH_ADD_INT64(proclist->m_proclist, tid, tinfo);
+			if(uth_status != SCAP_SUCCESS)
 			{
-				uint64_t log_elapsed_time_ms = cur_ts_ms - last_log_ts_ms;
-				if (log_elapsed_time_ms >= handle->m_proc_scan_log_interval_ms)
-				{
-					scap_debug_log(handle,
-						"scap_proc_scan: %ld proc in %ld ms, avg=%ld/min=%ld/max=%ld, last pid %ld, num_fds %ld",
-						num_procs_processed,
-						total_elapsed_time_ms,
-						(total_elapsed_time_ms / (uint64_t)num_procs_processed),
-						min_proc_time_ms,
-						max_proc_time_ms,
-						last_tid_processed,
-						total_num_fds);
-					last_log_ts_ms = cur_ts_ms;
-				}
+				scap_proc_free(handle, tinfo);
+				return scap_errprintf(error, 0, "process table allocation error (2)");
 			}
+		}
+		else
+		{
+			proclist->m_proc_callback(proclist->m_proc_callback_context, tinfo->tid, tinfo, NULL);
+			HASH_ITER(hh, tinfo->fdlist, fdi, tfdi)
+			{
+				proclist->m_proc_callback(proclist->m_proc_callback_context, tinfo->tid, tinfo, fdi);
+			}
+			scap_proc_free(handle, tinfo);
+		}
+	}
+
+	return SCAP_SUCCESS;
+}
+
+static uint32_t scap_proc_scan_num_threads(scap_t* handle)
+{
+	uint32_t n_threads = handle->m_proc_scan_threads;
+	if(n_threads == SCAP_PROC_SCAN_THREADS_AUTO)
+	{
+		long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		n_threads = n_cpus > 0 ? (uint32_t)n_cpus : 1;
+	}
+	return MIN(n_threads, SCAP_PROC_SCAN_MAX_THREADS);
+}
+
+static int32_t scap_proc_scan_proc_dir_parallel(scap_t* handle, struct scap_socket_cache* socket_cache, char* procdirname, uint32_t n_threads, char *error)
+{
+	DIR *dir_p;
+	struct dirent *dir_entry_p;
+	struct scap_proc_scan_state state = {0};
+	struct scap_proc_scan_timing timing;
+	pthread_t workers[SCAP_PROC_SCAN_MAX_THREADS];
+	uint32_t n_workers = 0;
+	uint64_t entries_size = 0;
+	int32_t res = SCAP_SUCCESS;
+	bool timeout_expired = false;
+	uint64_t j;
+
+	dir_p = opendir(procdirname);
+	if(dir_p == NULL)
+	{
+		scap_errprintf(error, errno, "error opening the %s directory", procdirname);
+		return SCAP_NOTFOUND;
+	}
+
+	//
+	// List the processes
+	//
+	while((dir_entry_p = readdir(dir_p)) != NULL)
+	{
+		if(strspn(dir_entry_p->d_name, "0123456789") != strlen(dir_entry_p->d_name))
+		{
+			continue;
+		}
 
-			if (handle->m_proc_scan_timeout_ms != SCAP_PROC_SCAN_TIMEOUT_NONE)
+		if(state.n_entries == entries_size)
+		{
+			entries_size = entries_size ? entries_size * 2 : 1024;
+			struct scap_proc_scan_entry* entries = realloc(state.entries, entries_size * sizeof(*entries));
+			if(entries == NULL)
 			{
-				if (total_elapsed_time_ms >= handle->m_proc_scan_timeout_ms)
-				{
-					timeout_expired = true;
-				}
+				closedir(dir_p);
+				free(state.entries);
+				return scap_errprintf(error, 0, "process list allocation error");
 			}
+			state.entries = entries;
 		}
+
+		memset(&state.entries[state.n_entries], 0, sizeof(*state.entries));
+		state.entries[state.n_entries++].tid = atoi(dir_entry_p->d_name);
 	}
+	closedir(dir_p);
 
-	if (do_timing)
+	//
+	// Detect the cgroup version upfront, so that the workers only read it
+	//
+	if(handle->m_cgroup_version == 0)
 	{
-		cur_ts_ms = scap_get_monotonic_ts_ms(&monotonic_ts_context);
-		uint64_t total_elapsed_time_ms = cur_ts_ms - start_ts_ms;
-		uint64_t avg_proc_time_ms = (num_procs_processed != 0) ?
-			(total_elapsed_time_ms / num_procs_processed) : 0;
+		handle->m_cgroup_version = scap_get_cgroup_version(procdirname);
+		if(handle->m_cgroup_version < 1)
+		{
+			ASSERT(false);
+			free(state.entries);
+			return scap_errprintf(error, errno, "failed to fetch cgroup version information");
+		}
+	}
+
+	state.handle = handle;
+	state.procdirname = procdirname;
+	state.socket_cache = socket_cache;
+	state.res = SCAP_SUCCESS;
+	pthread_mutex_init(&state.lock, NULL);
+	pthread_mutex_init(&state.queue_lock, NULL);
+	pthread_cond_init(&state.queue_cond, NULL);
 
-		if (timeout_expired)
+	scap_proc_scan_timing_init(handle, &timing, true);
+
+	for(n_workers = 0; n_workers < n_threads && n_workers < state.n_entries; n_workers++)
+	{
+		if(pthread_create(&workers[n_workers], NULL, scap_proc_scan_worker, &state) != 0)
 		{
-			scap_debug_log(handle,
-				"scap_proc_scan TIMEOUT (%ld ms): %ld proc in %ld ms, avg=%ld/min=%ld/max=%ld, last pid %ld, num_fds %ld",
-				handle->m_proc_scan_timeout_ms,
-				num_procs_processed,
-				total_elapsed_time_ms,
-				avg_proc_time_ms,
-				min_proc_time_ms,
-				max_proc_time_ms,
-				last_tid_processed,
-				total_num_fds);
+			break;
 		}
-		else if ((handle->m_proc_scan_log_interval_ms != SCAP_PROC_SCAN_LOG_NONE) &&
-			(num_procs_processed != 0))
+	}
+
+	if(n_workers == 0 && state.n_entries != 0)
+	{
+		res = scap_errprintf(error, errno, "can't start the /proc scan threads");
+	}
+
+	//
+	// Consume the processes in order, as the workers complete them
+	//
+	for(j = 0; res == SCAP_SUCCESS && j < state.n_entries && !timeout_expired; j++)
+	{
+		struct scap_proc_scan_entry* entry = &state.entries[j];
+
+		pthread_mutex_lock(&state.queue_lock);
+		while(!entry->done && state.res == SCAP_SUCCESS)
 		{
-			scap_debug_log(handle,
-				"scap_proc_scan DONE: %ld proc in %ld ms, avg=%ld/min=%ld/max=%ld, last pid %ld, num_fds %ld",
-				num_procs_processed,
-				total_elapsed_time_ms,
-				avg_proc_time_ms,
-				min_proc_time_ms,
-				max_proc_time_ms,
-				last_tid_processed,
-				total_num_fds);
+			pthread_cond_wait(&state.queue_cond, &state.queue_lock);
 		}
+		if(state.res != SCAP_SUCCESS)
+		{
+			res = state.res;
+			strlcpy(error, state.error, SCAP_LASTERR_SIZE);
+		}
+		pthread_mutex_unlock(&state.queue_lock);
+
+		if(res != SCAP_SUCCESS)
+		{
+			break;
+		}
+
+		res = scap_proc_scan_add_entry(handle, entry, error);
+		if(res != SCAP_SUCCESS)
+		{
+			break;
+		}
+
+		if(entry->complete)
+		{
+			timeout_expired = scap_proc_scan_timing_update(handle, &timing, entry->tid, entry->num_fds);
+		}
+
+		pthread_mutex_lock(&state.queue_lock);
+		state.n_consumed = j + 1;
+		pthread_cond_broadcast(&state.queue_cond);
+		pthread_mutex_unlock(&state.queue_lock);
 	}
 
-	closedir(dir_p);
-	if(sockets_by_ns != NULL && sockets_by_ns != (void*)-1)
+	pthread_mutex_lock(&state.queue_lock);
+	state.stop = true;
+	pthread_cond_broadcast(&state.queue_cond);
+	pthread_mutex_unlock(&state.queue_lock);
+
+	for(uint32_t k = 0; k < n_workers; k++)
+	{
+		pthread_join(workers[k], NULL);
+	}
+
+	scap_proc_scan_timing_done(handle, &timing, timeout_expired);
+
+	//
+	// Drop whatever was read but not consumed
+	//
+	for(j = 0; j < state.n_entries; j++)
 	{
-		scap_fd_free_ns_sockets_list(&sockets_by_ns);
+		scap_proc_scan_free_threads(handle, &state.entries[j].threads);
 	}
+
+	pthread_cond_destroy(&state.queue_cond);
+	pthread_mutex_destroy(&state.queue_lock);
+	pthread_mutex_destroy(&state.lock);
+	free(state.entries);
+
 	return res;
 }
 
@@ -1322,9 +1799,20 @@ int32_t scap_proc_scan_proc_dir(scap_t* handle, char *error)
 	char procdirname[SCAP_MAX_PATH_SIZE];
 	snprintf(procdirname, sizeof(procdirname), "%s/proc", scap_get_host_root());
 
-	return _scap_proc_scan_proc_dir_impl(handle, procdirname, -1, error);
-}
+	struct scap_socket_cache* socket_cache = scap_socket_cache_begin_scan(handle);
+	if(socket_cache == NULL)
+	{
+		return scap_errprintf(error, 0, "socket cache allocation error");
+	}
 
+	uint32_t n_threads = scap_proc_scan_num_threads(handle);
+	if(n_threads > 1)
+	{
+		return scap_proc_scan_proc_dir_parallel(handle, socket_cache, procdirname, n_threads, error);
+	}
+
+	return _scap_proc_scan_proc_dir_impl(handle, &handle->m_proclist, NULL, socket_cache, procdirname, -1, error);
+}
 
 int32_t scap_os_getpid_global(struct scap_engine_handle engine, int64_t *pid, char* error)
 {
@@ -1376,6 +1864,51 @@ struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_soc
 	return tinfo;
 }
 
+struct scap_threadinfo* scap_proc_get_fds(scap_t* handle, int64_t pid)
+{
+	//
+	// No /proc parsing for offline captures
+	//
+	if(handle->m_mode == SCAP_MODE_CAPTURE || handle->m_mode == SCAP_MODE_TEST)
+	{
+		return NULL;
+	}
+
+	char dir_name[SCAP_MAX_PATH_SIZE];
+	char error[SCAP_LASTERR_SIZE];
+	snprintf(dir_name, sizeof(dir_name), "%s/proc/%" PRId64 "/", scap_get_host_root(), pid);
+
+	struct scap_threadinfo* tinfo = (struct scap_threadinfo*) calloc(1, sizeof(scap_threadinfo));
+	if(tinfo == NULL)
+	{
+		return NULL;
+	}
+	tinfo->tid = pid;
+	tinfo->pid = pid;
+
+	//
+	// Read the fds in the threadinfo, without invoking the callback and
+	// without touching the state of the handle but the socket cache, which
+	// has its own lock, so that this is safe to call from any thread
+	//
+	struct scap_proclist proclist = {0};
+	struct scap_socket_cache* socket_cache = scap_socket_cache_begin_scan(handle);
+	if(socket_cache == NULL)
+	{
+		scap_proc_free(handle, tinfo);
+		return NULL;
+	}
+
+	int32_t res = scap_fd_scan_fd_dir(handle, &proclist, dir_name, tinfo, socket_cache, NULL, error);
+	if(res != SCAP_SUCCESS)
+	{
+		scap_proc_free(handle, tinfo);
+		return NULL;
+	}
+
+	return tinfo;
+}
+
 bool scap_is_thread_alive(scap_t* handle, int64_t pid, int64_t tid, const char* comm)
 {
 	char charbuf[SCAP_MAX_PATH_SIZE];
@@ -21,6 +21,7 @@ limitations under the License.
 
 typedef struct scap scap_t;
 struct ppm_proclist_info;
+struct scap_socket_cache;
 
 #define SCAP_HANDLE_T void
 #include "engine_handle.h"
@@ -42,11 +43,20 @@ struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_soc
 	return NULL;
 }
 
+struct scap_threadinfo* scap_proc_get_fds(scap_t* handle, int64_t pid)
+{
+	return NULL;
+}
+
 bool scap_is_thread_alive(scap_t* handle, int64_t pid, int64_t tid, const char* comm)
 {
 	return false;
 }
 
+void scap_socket_cache_free(struct scap_socket_cache* cache)
+{
+}
+
 int32_t scap_refresh_proc_table(scap_t* handle)
 {
 	return SCAP_SUCCESS;
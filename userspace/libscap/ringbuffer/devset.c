@@ -3,12 +3,16 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/epoll.h>
 
 #include "strlcpy.h"
 #include "../scap.h"
 #include "scap_assert.h"
+#include "strerror.h"
 
-int32_t devset_init(struct scap_device_set *devset, size_t num_devs, char *lasterr)
+int32_t devset_init(struct scap_device_set *devset, size_t num_devs, scap_open_args *oargs, char *lasterr)
 {
 	devset->m_ndevs = num_devs;
 
@@ -29,9 +33,139 @@ int32_t devset_init(struct scap_device_set *devset, size_t num_devs, char *laste
 		devset->m_devs[j].m_lastreadsize = 0;
 		devset->m_devs[j].m_sn_len = 0;
 	}
-	devset->m_buffer_empty_wait_time_us = BUFFER_EMPTY_WAIT_TIME_US_START;
 	devset->m_lasterr = lasterr;
 
+	devset->m_empty_threshold_b = BUFFER_EMPTY_THRESHOLD_B;
+	devset->m_empty_wait_max_us = BUFFER_EMPTY_WAIT_TIME_US_MAX;
+	devset->m_wakeup = false;
+	devset->m_wakeup_fd = INVALID_FD;
+	devset->m_wait_fn = NULL;
+	devset->m_ready_devs = NULL;
+	if(oargs != NULL)
+	{
+		if(oargs->ringbuffer_empty_threshold_b != 0)
+		{
+			devset->m_empty_threshold_b = oargs->ringbuffer_empty_threshold_b;
+		}
+		if(oargs->ringbuffer_empty_wait_max_us != 0)
+		{
+			devset->m_empty_wait_max_us = oargs->ringbuffer_empty_wait_max_us;
+		}
+		devset->m_wakeup = oargs->ringbuffer_wakeup;
+	}
+	devset->m_wakeup_watermark_b = (oargs != NULL && oargs->ringbuffer_wakeup_watermark_b != 0) ?
+		oargs->ringbuffer_wakeup_watermark_b : devset->m_empty_threshold_b;
+	devset->m_buffer_empty_wait_time_us = BUFFER_EMPTY_WAIT_TIME_US_START;
+	if(devset->m_buffer_empty_wait_time_us > devset->m_empty_wait_max_us)
+	{
+		devset->m_buffer_empty_wait_time_us = devset->m_empty_wait_max_us;
+	}
+
+	devset->m_merge_mode = oargs != NULL ? oargs->ringbuffer_merge_mode : SCAP_RINGBUFFER_MERGE_LINEAR;
+	devset->m_consume_chunk_b = oargs != NULL ? oargs->ringbuffer_consume_chunk_b : 0;
+	devset->m_last_dev = devset->m_ndevs;
+	devset->m_heap = NULL;
+	devset->m_heap_len = 0;
+	devset->m_heap_top_served = false;
+	if(devset->m_merge_mode == SCAP_RINGBUFFER_MERGE_HEAP)
+	{
+		devset->m_heap = (struct scap_device_heap_entry*) calloc(sizeof(struct scap_device_heap_entry), devset->m_ndevs);
+		if(!devset->m_heap)
+		{
+			free(devset->m_devs);
+			devset->m_devs = NULL;
+			strlcpy(lasterr, "error allocating the device merge heap", SCAP_LASTERR_SIZE);
+			return SCAP_FAILURE;
+		}
+	}
+
+	return SCAP_SUCCESS;
+}
+
+/* Engines whose devices fds notify new data call this once all the devices are open.
+ * It does nothing if the wakeup mode was not requested.
+ */
+int32_t devset_watch_devices(struct scap_device_set *devset)
+{
+	uint32_t j;
+
+	if(!devset->m_wakeup)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	devset->m_wakeup_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(devset->m_wakeup_fd < 0)
+	{
+		devset->m_wakeup_fd = INVALID_FD;
+		return scap_errprintf(devset->m_lasterr, errno, "unable to create the devices epoll fd");
+	}
+
+	for(j = 0; j < devset->m_ndevs; j++)
+	{
+		struct epoll_event evt = {0};
+		evt.events = EPOLLIN;
+		evt.data.u32 = j;
+
+		if(devset->m_devs[j].m_fd == INVALID_FD)
+		{
+			continue;
+		}
+
+		if(epoll_ctl(devset->m_wakeup_fd, EPOLL_CTL_ADD, devset->m_devs[j].m_fd, &evt) < 0)
+		{
+			return scap_errprintf(devset->m_lasterr, errno, "unable to watch the fd of device '%d'", j);
+		}
+	}
+
+	return SCAP_SUCCESS;
+}
+
+/* For the engines whose devices appear while capturing: extends the set to
+ * `num_devs` devices. The new devices are not open, it's up to the caller.
+ */
+int32_t devset_grow(struct scap_device_set *devset, uint32_t num_devs)
+{
+	uint32_t j;
+
+	if(num_devs <= devset->m_ndevs)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	scap_device* devs = (scap_device*) realloc(devset->m_devs, sizeof(scap_device) * num_devs);
+	if(!devs)
+	{
+		return scap_errprintf(devset->m_lasterr, 0, "error allocating the device handles");
+	}
+	devset->m_devs = devs;
+
+	if(devset->m_merge_mode == SCAP_RINGBUFFER_MERGE_HEAP)
+	{
+		struct scap_device_heap_entry* heap = (struct scap_device_heap_entry*) realloc(devset->m_heap, sizeof(struct scap_device_heap_entry) * num_devs);
+		if(!heap)
+		{
+			return scap_errprintf(devset->m_lasterr, 0, "error allocating the device merge heap");
+		}
+		devset->m_heap = heap;
+	}
+
+	for(j = devset->m_ndevs; j < num_devs; j++)
+	{
+		memset(&devs[j], 0, sizeof(scap_device));
+		devs[j].m_buffer = INVALID_MAPPING;
+		devs[j].m_bufinfo = INVALID_MAPPING;
+		devs[j].m_bufstatus = INVALID_MAPPING;
+		devs[j].m_fd = INVALID_FD;
+		devs[j].m_bufinfo_fd = INVALID_FD;
+	}
+
+	if(devset->m_last_dev == devset->m_ndevs)
+	{
+		devset->m_last_dev = num_devs;
+	}
+	devset->m_ndevs = num_devs;
+
 	return SCAP_SUCCESS;
 }
 
@@ -57,4 +191,7 @@ void devset_free(struct scap_device_set *devset)
 		devset_close_device(dev);
 	}
 	free(devset->m_devs);
+	free(devset->m_heap);
+	free(devset->m_ready_devs);
+	devset_close(devset->m_wakeup_fd);
 }
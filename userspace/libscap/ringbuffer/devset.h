@@ -26,6 +26,7 @@ limitations under the License.
 #define INVALID_MAPPING MAP_FAILED
 
 #include "scap_assert.h"
+#include "scap_open.h"
 
 //
 // Read buffer timeout constants
@@ -62,15 +63,39 @@ typedef struct scap_device
 	};
 } scap_device;
 
+//
+// Entry of the min-heap used by `SCAP_RINGBUFFER_MERGE_HEAP`
+//
+struct scap_device_heap_entry
+{
+	uint64_t m_ts; // timestamp of the next event available in the device block
+	uint32_t m_dev; // index of the device inside `m_devs`
+};
+
 struct scap_device_set
 {
 	scap_device* m_devs;
 	uint32_t m_ndevs;
 	uint64_t m_buffer_empty_wait_time_us;
+	uint32_t m_empty_threshold_b; // buffers holding less than this are considered empty
+	uint32_t m_empty_wait_max_us; // maximum time we wait on empty buffers
+	bool m_wakeup; // wait for the producers notifications instead of sleeping, if the engine supports them
+	uint32_t m_wakeup_watermark_b; // wakeup mode only: unconsumed bytes that make the producers notify us
+	int m_wakeup_fd; // epoll fd watching the devices fds, `INVALID_FD` if the engine didn't call `devset_watch_devices`
+	bool (*m_wait_fn)(struct scap_device_set *devset, int timeout_ms); // wakeup mode only, for the engines notified by other means than the devices fds; returns true if it filled `m_ready_devs`
+	uint64_t* m_ready_devs; // bitmap of the devices with pending data after a `m_wait_fn`, only those are refilled
 	char* m_lasterr;
+	scap_ringbuffer_merge_mode m_merge_mode;
+	uint32_t m_consume_chunk_b; // 0 for whole-block consumption, otherwise the tail is advanced in chunks of at least this size
+	uint32_t m_last_dev; // device that served the previous event (linear mode only), `m_ndevs` if none
+	struct scap_device_heap_entry* m_heap; // devices with pending events, ordered by `m_ts` (heap mode only)
+	uint32_t m_heap_len;
+	bool m_heap_top_served; // true if the event of the device on top of the heap was returned by the previous call
 };
 
-int32_t devset_init(struct scap_device_set *devset, size_t num_devs, char *lasterr);
+int32_t devset_init(struct scap_device_set *devset, size_t num_devs, scap_open_args *oargs, char *lasterr);
+int32_t devset_watch_devices(struct scap_device_set *devset);
+int32_t devset_grow(struct scap_device_set *devset, uint32_t num_devs);
 void devset_close_device(struct scap_device *dev);
 void devset_free(struct scap_device_set *devset);
 
@@ -17,8 +17,11 @@ limitations under the License.
 
 #include <stdio.h>
 #include <stdint.h>
+#include <sys/epoll.h>
+#include <time.h>
 
 #include "devset.h"
+#include "../scap_stats_v2.h"
 #include "../../../driver/ppm_ringbuffer.h"
 #include "barrier.h"
 #include "sleep.h"
@@ -83,6 +86,33 @@ static inline void ringbuffer_advance_tail(struct scap_device* dev)
 }
 #endif
 
+#ifndef ADVANCE_TAIL_BY
+#define ADVANCE_TAIL_BY ringbuffer_advance_tail_by
+/* Like `ringbuffer_advance_tail` but give back to the producer only the first `len`
+ * bytes of the block read in the last `READBUF`.
+ */
+static inline void ringbuffer_advance_tail_by(struct scap_device* dev, uint32_t len)
+{
+	uint32_t ttail;
+
+	ASSERT(dev->m_lastreadsize >= len);
+	ttail = dev->m_bufinfo->tail + len;
+
+	mem_barrier();
+
+	if(ttail < dev->m_buffer_size)
+	{
+		dev->m_bufinfo->tail = ttail;
+	}
+	else
+	{
+		dev->m_bufinfo->tail = ttail - dev->m_buffer_size;
+	}
+
+	dev->m_lastreadsize -= len;
+}
+#endif
+
 #ifndef READBUF
 #define READBUF ringbuffer_readbuf
 static inline int32_t ringbuffer_readbuf(struct scap_device *dev, OUT char** buf, OUT uint32_t* len)
@@ -134,7 +164,7 @@ static inline bool are_buffers_empty(struct scap_device_set *devset)
 
 	for(j = 0; j < devset->m_ndevs; j++)
 	{
-		if(buf_size_used(&devset->m_devs[j]) > BUFFER_EMPTY_THRESHOLD_B)
+		if(buf_size_used(&devset->m_devs[j]) > devset->m_empty_threshold_b)
 		{
 			return false;
 		}
@@ -143,20 +173,48 @@ static inline bool are_buffers_empty(struct scap_device_set *devset)
 	return true;
 }
 
+/* Wakeup mode only: wait for a producer to notify that its buffer crossed
+ * the wakeup watermark, at most `m_empty_wait_max_us`. Errors are not fatal,
+ * we refill the buffers right after in any case.
+ * Returns true if only the devices in `m_ready_devs` need a refill.
+ */
+static inline bool wait_for_wakeup(struct scap_device_set *devset)
+{
+	struct epoll_event evt;
+	int timeout_ms = (devset->m_empty_wait_max_us + 999) / 1000;
+
+	if(devset->m_wait_fn != NULL)
+	{
+		return devset->m_wait_fn(devset, timeout_ms);
+	}
+
+	epoll_wait(devset->m_wakeup_fd, &evt, 1, timeout_ms);
+	return false;
+}
+
 static inline int32_t refill_read_buffers(struct scap_device_set *devset)
 {
 	uint32_t j;
 	uint32_t ndevs = devset->m_ndevs;
+	bool only_ready = false;
 
 	if(are_buffers_empty(devset))
 	{
-		sleep_ms(devset->m_buffer_empty_wait_time_us / 1000);
-		devset->m_buffer_empty_wait_time_us = MIN(devset->m_buffer_empty_wait_time_us * 2,
-							  BUFFER_EMPTY_WAIT_TIME_US_MAX);
+		if(devset->m_wakeup_fd != INVALID_FD || devset->m_wait_fn != NULL)
+		{
+			only_ready = wait_for_wakeup(devset);
+		}
+		else
+		{
+			sleep_ms(devset->m_buffer_empty_wait_time_us / 1000);
+			devset->m_buffer_empty_wait_time_us = MIN(devset->m_buffer_empty_wait_time_us * 2,
+								  devset->m_empty_wait_max_us);
+		}
 	}
 	else
 	{
-		devset->m_buffer_empty_wait_time_us = BUFFER_EMPTY_WAIT_TIME_US_START;
+		devset->m_buffer_empty_wait_time_us = MIN(BUFFER_EMPTY_WAIT_TIME_US_START,
+							  devset->m_empty_wait_max_us);
 	}
 
 	/* In any case (potentially also after a `sleep`) we refill our buffers */
@@ -164,6 +222,12 @@ static inline int32_t refill_read_buffers(struct scap_device_set *devset)
 	{
 		struct scap_device *dev = &(devset->m_devs[j]);
 
+		/* The devices are all drained here, skipping one leaves it empty. */
+		if(only_ready && !(devset->m_ready_devs[j / 64] & (1ULL << (j % 64))))
+		{
+			continue;
+		}
+
 		int32_t res = READBUF(dev,
 				      &dev->m_sn_next_event,
 				      &dev->m_sn_len);
@@ -178,6 +242,77 @@ static inline int32_t refill_read_buffers(struct scap_device_set *devset)
 	return SCAP_TIMEOUT;
 }
 
+static inline void ringbuffer_heap_rebuild(struct scap_device_set *devset);
+
+/* Incremental consumption only: refill every drained device on its own,
+ * giving back to the producer what is left of its previous block.
+ * We don't sleep here even if the buffers are almost empty, the other devices
+ * could still have events to serve.
+ */
+static inline int32_t refill_drained_buffers(struct scap_device_set *devset)
+{
+	uint32_t j;
+
+	for(j = 0; j < devset->m_ndevs; j++)
+	{
+		struct scap_device *dev = &(devset->m_devs[j]);
+
+		if(dev->m_sn_len != 0)
+		{
+			continue;
+		}
+
+		if(dev->m_lastreadsize > 0)
+		{
+			ADVANCE_TAIL(dev);
+		}
+
+		int32_t res = READBUF(dev,
+				      &dev->m_sn_next_event,
+				      &dev->m_sn_len);
+
+		if(res != SCAP_SUCCESS)
+		{
+			return res;
+		}
+	}
+
+	if(devset->m_merge_mode == SCAP_RINGBUFFER_MERGE_HEAP)
+	{
+		ringbuffer_heap_rebuild(devset);
+	}
+
+	return SCAP_SUCCESS;
+}
+
+/* Incremental consumption only: called for the device that served the previous
+ * event, since the caller is done with it now.
+ * Every time the block is drained or we have consumed at least `m_consume_chunk_b`
+ * bytes from it, we give them back to the producer and we refill all the drained
+ * devices, without waiting for the other blocks to be consumed. In this way an idle
+ * buffer that becomes busy is read again at most after `m_consume_chunk_b` bytes.
+ * `*refilled` is set to true if the drained devices have been refilled.
+ */
+static inline int32_t release_consumed(struct scap_device_set *devset, struct scap_device *dev, bool *refilled)
+{
+	uint32_t consumed = dev->m_lastreadsize - dev->m_sn_len;
+
+	*refilled = false;
+	if(dev->m_sn_len != 0 && consumed < devset->m_consume_chunk_b)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	/* If the block is drained `refill_drained_buffers` gives it back entirely. */
+	if(dev->m_sn_len != 0)
+	{
+		ADVANCE_TAIL_BY(dev, consumed);
+	}
+
+	*refilled = true;
+	return refill_drained_buffers(devset);
+}
+
 #ifndef NEXT_EVENT
 #define NEXT_EVENT ringbuffer_next_event
 static inline scap_evt* ringbuffer_next_event(scap_device* dev)
@@ -209,8 +344,11 @@ static inline void ringbuffer_advance_to_evt(scap_device* dev, scap_evt *event)
  *   is huge we could cause several drops.
  * - before refilling a buffer we have to consume all the others!
  * - we perform a lot of cycles but we have to be super fast here!
+ *
+ * The second and the third points are addressed by the incremental consumption
+ * (`m_consume_chunk_b` != 0), see `release_consumed`.
  */
-static inline int32_t ringbuffer_next(struct scap_device_set *devset, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
+static inline int32_t ringbuffer_next_linear(struct scap_device_set *devset, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
 {
 	uint32_t j;
 	uint64_t min_ts = 0xffffffffffffffffLL;
@@ -219,6 +357,17 @@ static inline int32_t ringbuffer_next(struct scap_device_set *devset, OUT scap_e
 
 	*pcpuid = 65535;
 
+	if(devset->m_consume_chunk_b > 0 && devset->m_last_dev < ndevs)
+	{
+		bool refilled;
+		int32_t res = release_consumed(devset, &devset->m_devs[devset->m_last_dev], &refilled);
+		devset->m_last_dev = ndevs;
+		if(res != SCAP_SUCCESS)
+		{
+			return res;
+		}
+	}
+
 	for(j = 0; j < ndevs; j++)
 	{
 		scap_device* dev = &(devset->m_devs[j]);
@@ -288,6 +437,7 @@ static inline int32_t ringbuffer_next(struct scap_device_set *devset, OUT scap_e
 	 	 */
 		struct scap_device *dev = &devset->m_devs[*pcpuid];
 		ADVANCE_TO_EVT(dev, (*pevent));
+		devset->m_last_dev = *pcpuid;
 		return SCAP_SUCCESS;
 	}
 	else
@@ -299,6 +449,242 @@ static inline int32_t ringbuffer_next(struct scap_device_set *devset, OUT scap_e
 	}
 }
 
+static inline bool ringbuffer_heap_entry_lt(const struct scap_device_heap_entry* a, const struct scap_device_heap_entry* b)
+{
+	/* On equal timestamps prefer the lowest device index, as the linear scan does. */
+	return a->m_ts < b->m_ts || (a->m_ts == b->m_ts && a->m_dev < b->m_dev);
+}
+
+static inline void ringbuffer_heap_sift_down(struct scap_device_set *devset, uint32_t pos)
+{
+	struct scap_device_heap_entry* heap = devset->m_heap;
+	uint32_t len = devset->m_heap_len;
+	struct scap_device_heap_entry entry = heap[pos];
+
+	while(true)
+	{
+		uint32_t child = 2 * pos + 1;
+		if(child >= len)
+		{
+			break;
+		}
+
+		if(child + 1 < len && ringbuffer_heap_entry_lt(&heap[child + 1], &heap[child]))
+		{
+			child++;
+		}
+
+		if(!ringbuffer_heap_entry_lt(&heap[child], &entry))
+		{
+			break;
+		}
+
+		heap[pos] = heap[child];
+		pos = child;
+	}
+
+	heap[pos] = entry;
+}
+
+/* Remove the device on top of the heap, giving back its block to the producer. */
+static inline void ringbuffer_heap_pop(struct scap_device_set *devset)
+{
+	scap_device* dev = &devset->m_devs[devset->m_heap[0].m_dev];
+
+	if(dev->m_lastreadsize > 0)
+	{
+		ADVANCE_TAIL(dev);
+	}
+
+	devset->m_heap_len--;
+	if(devset->m_heap_len > 0)
+	{
+		devset->m_heap[0] = devset->m_heap[devset->m_heap_len];
+		ringbuffer_heap_sift_down(devset, 0);
+	}
+}
+
+/* Collect all the devices with a non-empty block after a refill and heapify them. */
+static inline void ringbuffer_heap_rebuild(struct scap_device_set *devset)
+{
+	uint32_t j;
+	uint32_t len = 0;
+
+	for(j = 0; j < devset->m_ndevs; j++)
+	{
+		scap_device* dev = &devset->m_devs[j];
+		if(dev->m_sn_len == 0)
+		{
+			continue;
+		}
+
+		devset->m_heap[len].m_ts = NEXT_EVENT(dev)->ts;
+		devset->m_heap[len].m_dev = j;
+		len++;
+	}
+
+	devset->m_heap_len = len;
+	for(j = len / 2; j > 0; j--)
+	{
+		ringbuffer_heap_sift_down(devset, j - 1);
+	}
+}
+
+/* Same contract as `ringbuffer_next_linear` but the device heads are kept in
+ * a min-heap ordered by timestamp, so every event costs O(log(ndevs)) instead
+ * of a full scan of the device set.
+ *
+ * The device on top of the heap is the one that served the previous event:
+ * we can refresh its key and re-sift it only at the next call, since the caller
+ * is still using that event until it calls us again. For the same reason a drained
+ * device gives back its block to the producer only at the next call.
+ */
+static inline int32_t ringbuffer_next_heap(struct scap_device_set *devset, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
+{
+	uint32_t j;
+	scap_device* dev;
+	scap_evt* pe;
+
+	*pcpuid = 65535;
+
+	if(devset->m_heap_top_served)
+	{
+		bool refilled = false;
+
+		devset->m_heap_top_served = false;
+		dev = &devset->m_devs[devset->m_heap[0].m_dev];
+		if(devset->m_consume_chunk_b > 0)
+		{
+			int32_t res = release_consumed(devset, dev, &refilled);
+			if(res != SCAP_SUCCESS)
+			{
+				return res;
+			}
+		}
+
+		/* If the drained devices have been refilled the heap is already up to date. */
+		if(!refilled && dev->m_sn_len > 0)
+		{
+			devset->m_heap[0].m_ts = NEXT_EVENT(dev)->ts;
+			ringbuffer_heap_sift_down(devset, 0);
+		}
+	}
+
+	/* Blocks can be emptied behind our back (e.g. flushed by a snaplen change),
+	 * so we check the device length instead of trusting the heap.
+	 */
+	while(devset->m_heap_len > 0 && devset->m_devs[devset->m_heap[0].m_dev].m_sn_len == 0)
+	{
+		ringbuffer_heap_pop(devset);
+	}
+
+	if(devset->m_heap_len == 0)
+	{
+		int32_t res;
+
+		for(j = 0; j < devset->m_ndevs; j++)
+		{
+			dev = &devset->m_devs[j];
+			if(dev->m_sn_len == 0 && dev->m_lastreadsize > 0)
+			{
+				ADVANCE_TAIL(dev);
+			}
+		}
+
+		res = refill_read_buffers(devset);
+		if(res == SCAP_TIMEOUT)
+		{
+			ringbuffer_heap_rebuild(devset);
+		}
+		return res;
+	}
+
+	j = devset->m_heap[0].m_dev;
+	dev = &devset->m_devs[j];
+	pe = NEXT_EVENT(dev);
+
+	/* if the event length is greater than the remaining size in our block there is something wrong! */
+	if(pe->len > dev->m_sn_len)
+	{
+		snprintf(devset->m_lasterr, SCAP_LASTERR_SIZE, "scap_next buffer corruption");
+
+		/* if you get the following assertion, first recompile the driver and `libscap` */
+		ASSERT(false);
+		return SCAP_FAILURE;
+	}
+
+	*pevent = pe;
+	*pcpuid = j;
+	ADVANCE_TO_EVT(dev, pe);
+	devset->m_heap_top_served = true;
+	return SCAP_SUCCESS;
+}
+
+static inline int32_t ringbuffer_next(struct scap_device_set *devset, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
+{
+	if(devset->m_merge_mode == SCAP_RINGBUFFER_MERGE_HEAP)
+	{
+		return ringbuffer_next_heap(devset, pevent, pcpuid);
+	}
+	return ringbuffer_next_linear(devset, pevent, pcpuid);
+}
+
+#ifndef PEEK_EVENT
+#define PEEK_EVENT ringbuffer_peek_event
+static inline scap_evt* ringbuffer_peek_event(char* pos)
+{
+	return (scap_evt*)pos;
+}
+#endif
+
+#ifndef PEEK_ADVANCE
+#define PEEK_ADVANCE ringbuffer_peek_advance
+static inline void ringbuffer_peek_advance(scap_device* dev, char** pos, uint32_t* len)
+{
+	scap_evt* event = (scap_evt*)*pos;
+	*pos += event->len;
+	*len -= event->len;
+}
+#endif
+
+/* Return the event that comes `distance` positions after the last one read from
+ * the device `devid`, if it's already in the block we are consuming, without
+ * moving the position inside the block. Used to prefetch what parsing the
+ * upcoming events of the device will need.
+ */
+static inline scap_evt* ringbuffer_peek(struct scap_device_set *devset, uint16_t devid, uint32_t distance)
+{
+	scap_device* dev;
+	char* pos;
+	uint32_t len;
+
+	if(devid >= devset->m_ndevs || distance == 0)
+	{
+		return NULL;
+	}
+
+	dev = &devset->m_devs[devid];
+	pos = dev->m_sn_next_event;
+	len = dev->m_sn_len;
+	while(len > 0)
+	{
+		scap_evt* pe = PEEK_EVENT(pos);
+		if(pe->len > len)
+		{
+			return NULL;
+		}
+
+		if(--distance == 0)
+		{
+			return pe;
+		}
+
+		PEEK_ADVANCE(dev, &pos, &len);
+	}
+
+	return NULL;
+}
+
 static inline uint64_t ringbuffer_get_max_buf_used(struct scap_device_set *devset)
 {
 	uint64_t i;
@@ -312,3 +698,42 @@ static inline uint64_t ringbuffer_get_max_buf_used(struct scap_device_set *devse
 
 	return max;
 }
+
+/* Number of stats filled by `ringbuffer_get_buffer_stats` for each device */
+#define RINGBUFFER_MAX_BUFFER_STATS 2
+
+static inline void ringbuffer_set_buffer_stat(scap_stats_v2 *stat, const char *prefix, uint32_t index, const char *name, uint64_t value)
+{
+	stat->type = STATS_VALUE_TYPE_U64;
+	stat->flags = PPM_SCAP_STATS_BUFFERS;
+	stat->value.u64 = value;
+	snprintf(stat->name, STATS_NAME_MAX, "%s_%u.%s", prefix, index, name);
+}
+
+/* Fill `stats` with the wall clock time of the sampling, as
+ * `buffers.sample_ts_ns`, followed by the occupancy of every buffer of the
+ * device set, as `buffer_<dev>.used_bytes` and `buffer_<dev>.size_bytes`.
+ * `stats` must have room for `1 + m_ndevs * RINGBUFFER_MAX_BUFFER_STATS`
+ * entries. Return the number of entries filled.
+ */
+static inline uint32_t ringbuffer_get_buffer_stats(struct scap_device_set *devset, scap_stats_v2 *stats)
+{
+	struct timespec ts = {0};
+	uint32_t j;
+	uint32_t n = 0;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	stats[n].type = STATS_VALUE_TYPE_U64;
+	stats[n].flags = PPM_SCAP_STATS_BUFFERS;
+	stats[n].value.u64 = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	snprintf(stats[n].name, STATS_NAME_MAX, "buffers.sample_ts_ns");
+	n++;
+
+	for(j = 0; j < devset->m_ndevs; j++)
+	{
+		ringbuffer_set_buffer_stat(&stats[n++], "buffer", j, "used_bytes", buf_size_used(&devset->m_devs[j]));
+		ringbuffer_set_buffer_stat(&stats[n++], "buffer", j, "size_bytes", devset->m_devs[j].m_buffer_size);
+	}
+
+	return n;
+}
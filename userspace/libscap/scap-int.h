@@ -31,6 +31,7 @@ limitations under the License.
 #include "settings.h"
 #include "scap_assert.h"
 #include "scap_suppress.h"
+#include "scap_spill.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -63,6 +64,14 @@ struct scap
 	// /proc scan parameters
 	uint64_t m_proc_scan_timeout_ms;
 	uint64_t m_proc_scan_log_interval_ms;
+	uint32_t m_proc_scan_threads;
+	bool m_proc_scan_lazy_fds;
+
+	// Sockets read from /proc, reused across scans
+	struct scap_socket_cache* m_socket_cache;
+
+	// Events read while the initial /proc scan runs
+	struct scap_spill m_spill;
 
 	// Function which may be called to log a debug event
 	void(*m_debug_log_fn)(const char* msg);
@@ -80,6 +89,8 @@ int32_t scap_proc_scan_proc_dir(scap_t* handle, char *error);
 int32_t scap_proc_scan_vtable(char *error, scap_t *handle);
 // Free the process table
 void scap_proc_free_table(struct scap_proclist* proclist);
+// Free the sockets read from /proc
+void scap_socket_cache_free(struct scap_socket_cache* cache);
 // Return the process info entry given a tid
 // Free an fd table and set it to NULL when done
 void scap_fd_free_table(scap_fdinfo** fds);
@@ -42,6 +42,47 @@ const char* scap_getlasterr(scap_t* handle)
 	return handle ? handle->m_lasterr : "null scap handle";
 }
 
+//
+// Pass the suppressed comms to the driver, so that it drops their syscall
+// events before they reach the buffers. This is only an optimization, the
+// events are still suppressed by scap_check_suppressed(), so it's fine if
+// the driver doesn't support it or if there are more comms than it can take.
+//
+static void scap_push_suppressed_comms(scap_t* handle)
+{
+	struct ppm_suppressed_comms comms;
+	uint32_t j;
+
+	if(handle->m_mode != SCAP_MODE_LIVE || handle->m_vtable == NULL)
+	{
+		return;
+	}
+
+	memset(&comms, 0, sizeof(comms));
+	for(j = 0; j < handle->m_suppress.m_num_suppressed_comms && j < PPM_MAX_SUPPRESSED_COMMS; j++)
+	{
+		strlcpy(comms.comms[j], handle->m_suppress.m_suppressed_comms[j], PPM_COMM_LEN);
+	}
+	comms.n_comms = j;
+
+	handle->m_vtable->configure(handle->m_engine, SCAP_SUPPRESSED_COMMS, (unsigned long)&comms, 0);
+}
+
+//
+// Keep the driver in sync with the suppressed threads. As above, errors
+// are not fatal, and the driver is not told anymore if it can't do it.
+//
+static void scap_push_suppressed_tid(void* ctx, uint64_t tid, bool suppressed)
+{
+	scap_t* handle = (scap_t*)ctx;
+
+	int32_t res = handle->m_vtable->configure(handle->m_engine, SCAP_SUPPRESSED_TID, tid, suppressed);
+	if(res == SCAP_NOT_SUPPORTED)
+	{
+		handle->m_suppress.m_tid_cb = NULL;
+	}
+}
+
 #if defined(HAS_ENGINE_KMOD) || defined(HAS_ENGINE_BPF) || defined(HAS_ENGINE_MODERN_BPF)
 int32_t scap_init_live_int(scap_t* handle, scap_open_args* oargs, const struct scap_vtable* vtable)
 {
@@ -75,6 +116,8 @@ int32_t scap_init_live_int(scap_t* handle, scap_open_args* oargs, const struct s
 
 	handle->m_proc_scan_timeout_ms = oargs->proc_scan_timeout_ms;
 	handle->m_proc_scan_log_interval_ms = oargs->proc_scan_log_interval_ms;
+	handle->m_proc_scan_threads = oargs->proc_scan_threads;
+	handle->m_proc_scan_lazy_fds = oargs->proc_scan_lazy_fds;
 	handle->m_debug_log_fn = oargs->debug_log_fn;
 
 	//
@@ -136,15 +179,37 @@ int32_t scap_init_live_int(scap_t* handle, scap_open_args* oargs, const struct s
 
 	scap_stop_dropping_mode(handle);
 
+	if(handle->m_suppress.m_num_suppressed_comms > 0)
+	{
+		scap_push_suppressed_comms(handle);
+	}
+	handle->m_suppress.m_tid_cb = scap_push_suppressed_tid;
+	handle->m_suppress.m_tid_cb_ctx = handle;
+
 	//
 	// Create the process list
 	//
 	handle->m_lasterr[0] = '\0';
 	char proc_scan_err[SCAP_LASTERR_SIZE];
-	if((rc = scap_proc_scan_proc_dir(handle, proc_scan_err)) != SCAP_SUCCESS)
+	if(!oargs->proc_scan_skip)
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scap_init_live_int() error creating the process list: %s. Make sure you have root credentials.", proc_scan_err);
-		return rc;
+		//
+		// The capture is already running: read the events produced
+		// during the scan, instead of leaving them to the kernel
+		// buffers. They are returned once the scan is done.
+		//
+		if(oargs->proc_scan_spill_bytes != 0)
+		{
+			scap_spill_start(handle, oargs->proc_scan_spill_bytes);
+		}
+
+		rc = scap_proc_scan_proc_dir(handle, proc_scan_err);
+		scap_spill_stop(handle);
+		if(rc != SCAP_SUCCESS)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scap_init_live_int() error creating the process list: %s. Make sure you have root credentials.", proc_scan_err);
+			return rc;
+		}
 	}
 
 	return SCAP_SUCCESS;
@@ -190,6 +255,8 @@ int32_t scap_init_udig_int(scap_t* handle, scap_open_args* oargs)
 
 	handle->m_proc_scan_timeout_ms = oargs->proc_scan_timeout_ms;
 	handle->m_proc_scan_log_interval_ms = oargs->proc_scan_log_interval_ms;
+	handle->m_proc_scan_threads = oargs->proc_scan_threads;
+	handle->m_proc_scan_lazy_fds = oargs->proc_scan_lazy_fds;
 	handle->m_debug_log_fn = oargs->debug_log_fn;
 
 	//
@@ -245,7 +312,8 @@ int32_t scap_init_udig_int(scap_t* handle, scap_open_args* oargs)
 	//
 	handle->m_lasterr[0] = '\0';
 	char procerr[SCAP_LASTERR_SIZE];
-	if((rc = scap_proc_scan_proc_dir(handle, procerr)) != SCAP_SUCCESS)
+	if(!oargs->proc_scan_skip &&
+	   (rc = scap_proc_scan_proc_dir(handle, procerr)) != SCAP_SUCCESS)
 	{
 		strlcpy(handle->m_lasterr, procerr, SCAP_LASTERR_SIZE);
 		return rc;
@@ -308,6 +376,51 @@ int32_t scap_init_test_input_int(scap_t* handle, scap_open_args* oargs)
 }
 #endif
 
+#ifdef HAS_ENGINE_SYNTHETIC
+int32_t scap_init_synthetic_int(scap_t* handle, scap_open_args* oargs)
+{
+	int32_t rc;
+
+	handle->m_vtable = &scap_synthetic_engine;
+	handle->m_engine.m_handle = handle->m_vtable->alloc_handle(handle, handle->m_lasterr);
+	if(!handle->m_engine.m_handle)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the engine structure");
+		return SCAP_FAILURE;
+	}
+
+	rc = handle->m_vtable->init(handle, oargs);
+	if(rc != SCAP_SUCCESS)
+	{
+		return rc;
+	}
+
+	//
+	// Preliminary initializations
+	//
+	handle->m_mode = oargs->mode;
+
+	handle->m_proclist.m_proc_callback = oargs->proc_callback;
+	handle->m_proclist.m_proc_callback_context = oargs->proc_callback_context;
+	handle->m_proclist.m_proclist = NULL;
+
+	handle->m_debug_log_fn = oargs->debug_log_fn;
+
+	if ((rc = scap_suppress_init(&handle->m_suppress, oargs->suppressed_comms)) != SCAP_SUCCESS)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error copying suppressed comms");
+		return rc;
+	}
+
+	if ((rc = scap_proc_scan_vtable(handle->m_lasterr, handle)) != SCAP_SUCCESS)
+	{
+		return rc;
+	}
+
+	return SCAP_SUCCESS;
+}
+#endif
+
 #ifdef HAS_ENGINE_GVISOR
 int32_t scap_init_gvisor_int(scap_t* handle, scap_open_args* oargs)
 {
@@ -434,6 +547,8 @@ int32_t scap_init_nodriver_int(scap_t* handle, scap_open_args* oargs)
 
 	handle->m_proc_scan_timeout_ms = oargs->proc_scan_timeout_ms;
 	handle->m_proc_scan_log_interval_ms = oargs->proc_scan_log_interval_ms;
+	handle->m_proc_scan_threads = oargs->proc_scan_threads;
+	handle->m_proc_scan_lazy_fds = oargs->proc_scan_lazy_fds;
 	handle->m_debug_log_fn = oargs->debug_log_fn;
 
 	//
@@ -478,6 +593,15 @@ int32_t scap_init_nodriver_int(scap_t* handle, scap_open_args* oargs)
 		handle->m_userlist = NULL;
 	}
 
+	//
+	// Subscribe to the process events before the scan, so that the
+	// processes started meanwhile are not missed
+	//
+	if((rc = handle->m_vtable->init(handle, oargs)) != SCAP_SUCCESS)
+	{
+		return rc;
+	}
+
 	//
 	// Create the process list
 	//
@@ -576,6 +700,12 @@ int32_t scap_init(scap_t* handle, scap_open_args* oargs)
 		return scap_init_test_input_int(handle, oargs);
 	}
 #endif
+#ifdef HAS_ENGINE_SYNTHETIC
+	if(strcmp(engine_name, SYNTHETIC_ENGINE) == 0)
+	{
+		return scap_init_synthetic_int(handle, oargs);
+	}
+#endif
 #ifdef HAS_ENGINE_KMOD
 	if(strcmp(engine_name, KMOD_ENGINE) == 0)
 	{
@@ -640,6 +770,13 @@ static inline void scap_deinit_state(scap_t* handle)
 		handle->m_proclist.m_proclist = NULL;
 	}
 
+	// Free the sockets read from /proc
+	if(handle->m_socket_cache != NULL)
+	{
+		scap_socket_cache_free(handle->m_socket_cache);
+		handle->m_socket_cache = NULL;
+	}
+
 	// Free the device table
 	if(handle->m_dev_list != NULL)
 	{
@@ -666,6 +803,9 @@ static inline void scap_deinit_state(scap_t* handle)
 		free(handle->m_driver_procinfo);
 		handle->m_driver_procinfo = NULL;
 	}
+
+	// Free the events buffered during the /proc scan, if not all returned
+	scap_spill_free(&handle->m_spill);
 }
 
 uint32_t scap_restart_capture(scap_t* handle)
@@ -765,8 +905,17 @@ uint64_t scap_max_buf_used(scap_t* handle)
 int32_t scap_next(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
 {
 	int32_t res = SCAP_FAILURE;
-	if(handle->m_vtable)
+	if(scap_spill_pending(&handle->m_spill))
 	{
+		scap_spill_next(&handle->m_spill, pevent, pcpuid);
+		res = SCAP_SUCCESS;
+	}
+	else if(handle->m_vtable)
+	{
+		if(handle->m_spill.m_buf != NULL)
+		{
+			scap_spill_free(&handle->m_spill);
+		}
 		res = handle->m_vtable->next(handle->m_engine, pevent, pcpuid);
 	}
 	else
@@ -800,6 +949,22 @@ int32_t scap_next(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
 	return res;
 }
 
+scap_evt* scap_peek(scap_t* handle, uint16_t cpuid, uint32_t distance)
+{
+	// The engine is behind the buffered events
+	if(scap_spill_pending(&handle->m_spill))
+	{
+		return NULL;
+	}
+
+	if(handle->m_vtable && handle->m_vtable->peek)
+	{
+		return handle->m_vtable->peek(handle->m_engine, cpuid, distance);
+	}
+
+	return NULL;
+}
+
 //
 // Return the process list for the given handle
 //
@@ -1162,6 +1327,55 @@ void scap_fseek(scap_t *handle, uint64_t off)
 	}
 }
 
+int32_t scap_fseek_ts(scap_t *handle, uint64_t ts)
+{
+	if(handle->m_vtable->savefile_ops && handle->m_vtable->savefile_ops->fseek_ts_capture)
+	{
+		return handle->m_vtable->savefile_ops->fseek_ts_capture(handle->m_engine, ts);
+	}
+
+	snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "operation not supported");
+	return SCAP_NOT_SUPPORTED;
+}
+
+int32_t scap_fseek_checkpoint(scap_t *handle, uint64_t ts)
+{
+	if(handle->m_vtable->savefile_ops && handle->m_vtable->savefile_ops->fseek_checkpoint)
+	{
+		int32_t res = handle->m_vtable->savefile_ops->fseek_checkpoint(handle->m_engine, ts);
+		if(res != SCAP_SUCCESS)
+		{
+			return res;
+		}
+		return scap_restart_capture(handle);
+	}
+
+	snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "operation not supported");
+	return SCAP_NOT_SUPPORTED;
+}
+
+int32_t scap_set_read_filter(scap_t *handle, const uint8_t* event_types, uint64_t ts_min, uint64_t ts_max)
+{
+	if(handle->m_vtable->savefile_ops && handle->m_vtable->savefile_ops->set_read_filter)
+	{
+		return handle->m_vtable->savefile_ops->set_read_filter(handle->m_engine, event_types, ts_min, ts_max);
+	}
+
+	snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "operation not supported");
+	return SCAP_NOT_SUPPORTED;
+}
+
+int32_t scap_get_event_index(scap_t *handle, const struct _evt_index_entry** entries, uint64_t* n_entries)
+{
+	if(handle->m_vtable->savefile_ops && handle->m_vtable->savefile_ops->get_event_index)
+	{
+		return handle->m_vtable->savefile_ops->get_event_index(handle->m_engine, entries, n_entries);
+	}
+
+	snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "operation not supported");
+	return SCAP_NOT_SUPPORTED;
+}
+
 int32_t scap_get_n_tracepoint_hit(scap_t* handle, long* ret)
 {
 	if(handle->m_vtable)
@@ -1184,7 +1398,12 @@ bool scap_check_current_engine(scap_t *handle, const char* engine_name)
 
 int32_t scap_suppress_events_comm(scap_t *handle, const char *comm)
 {
-	return scap_suppress_events_comm_impl(&handle->m_suppress, comm);
+	int32_t res = scap_suppress_events_comm_impl(&handle->m_suppress, comm);
+	if(res == SCAP_SUCCESS)
+	{
+		scap_push_suppressed_comms(handle);
+	}
+	return res;
 }
 
 bool scap_check_suppressed_tid(scap_t *handle, int64_t tid)
@@ -1214,6 +1433,92 @@ int32_t scap_set_statsd_port(scap_t* const handle, const uint16_t port)
 	return SCAP_FAILURE;
 }
 
+int32_t scap_set_fd_type_snaplen(scap_t* handle, uint32_t fd_type, uint32_t snaplen)
+{
+	if(fd_type >= PPM_SNAPLEN_FD_MAX)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid fd type %u", fd_type);
+		return SCAP_FAILURE;
+	}
+
+	if(snaplen > SNAPLEN_MAX && snaplen != PPM_SNAPLEN_FD_TYPE_DEFAULT)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "snaplen can't exceed %d", SNAPLEN_MAX);
+		return SCAP_FAILURE;
+	}
+
+	if(handle->m_vtable)
+	{
+		return handle->m_vtable->configure(handle->m_engine, SCAP_FD_TYPE_SNAPLEN, fd_type, snaplen);
+	}
+
+	snprintf(handle->m_lasterr,	SCAP_LASTERR_SIZE, "operation not supported");
+	return SCAP_FAILURE;
+}
+
+int32_t scap_set_buffer_snaplen(scap_t* handle, uint32_t buffer, uint32_t snaplen)
+{
+	if(snaplen > SNAPLEN_MAX && snaplen != PPM_SNAPLEN_NO_LIMIT)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "snaplen can't exceed %d", SNAPLEN_MAX);
+		return SCAP_FAILURE;
+	}
+
+	if(handle->m_vtable)
+	{
+		return handle->m_vtable->configure(handle->m_engine, SCAP_BUFFER_SNAPLEN, buffer, snaplen);
+	}
+
+	snprintf(handle->m_lasterr,	SCAP_LASTERR_SIZE, "operation not supported");
+	return SCAP_FAILURE;
+}
+
+int32_t scap_set_cgroup_filter_mode(scap_t* handle, enum ppm_cgroup_filter_mode mode)
+{
+	if(mode != PPM_CGROUP_FILTER_NONE && mode != PPM_CGROUP_FILTER_ALLOW && mode != PPM_CGROUP_FILTER_DENY)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid cgroup filter mode %d", mode);
+		return SCAP_FAILURE;
+	}
+
+	if(handle->m_vtable)
+	{
+		return handle->m_vtable->configure(handle->m_engine, SCAP_CGROUP_FILTER_MODE, mode, 0);
+	}
+
+	snprintf(handle->m_lasterr,	SCAP_LASTERR_SIZE, "operation not supported");
+	return SCAP_FAILURE;
+}
+
+int32_t scap_set_cgroup_filter(scap_t* handle, uint64_t cgroup_id, bool listed)
+{
+	if(handle->m_vtable)
+	{
+		return handle->m_vtable->configure(handle->m_engine, SCAP_CGROUP_FILTER, cgroup_id, listed);
+	}
+
+	snprintf(handle->m_lasterr,	SCAP_LASTERR_SIZE, "operation not supported");
+	return SCAP_FAILURE;
+}
+
+int32_t scap_set_syscall_limit(scap_t* handle, ppm_sc_code ppm_sc, uint32_t sample_every, uint32_t max_per_sec)
+{
+	if(ppm_sc >= PPM_SC_MAX)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid ppm_sc %d", ppm_sc);
+		return SCAP_FAILURE;
+	}
+
+	if(handle->m_vtable)
+	{
+		struct scap_syscall_limit limit = {sample_every, max_per_sec};
+		return handle->m_vtable->configure(handle->m_engine, SCAP_SYSCALL_LIMIT, ppm_sc, (unsigned long)&limit);
+	}
+
+	snprintf(handle->m_lasterr,	SCAP_LASTERR_SIZE, "operation not supported");
+	return SCAP_FAILURE;
+}
+
 uint64_t scap_get_driver_api_version(scap_t* handle)
 {
 	if(handle->m_vtable && handle->m_vtable->get_api_version)
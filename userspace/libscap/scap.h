@@ -80,6 +80,7 @@ typedef struct ppm_evt_hdr scap_evt;
 #include <engine/nodriver/nodriver_public.h>
 #include <engine/savefile/savefile_public.h>
 #include <engine/source_plugin/source_plugin_public.h>
+#include <engine/synthetic/synthetic_public.h>
 #include <engine/test_input/test_input_public.h>
 #include <engine/udig/udig_public.h>
 
@@ -117,6 +118,14 @@ typedef struct ppm_evt_hdr scap_evt;
 //
 #define SCAP_PROC_SCAN_LOG_NONE 0
 
+//
+// Value for proc_scan_threads field in scap_open_args, to specify
+// that the /proc scan should use one thread per online CPU, up to
+// SCAP_PROC_SCAN_MAX_THREADS
+//
+#define SCAP_PROC_SCAN_THREADS_AUTO 0
+#define SCAP_PROC_SCAN_MAX_THREADS 16
+
 /*!
   \brief Statistics about an in progress capture
 */
@@ -625,6 +634,21 @@ uint64_t scap_max_buf_used(scap_t* handle);
 */
 int32_t scap_next(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid);
 
+/*!
+  \brief Look at an event that \ref scap_next will return later, without
+  consuming it, so that the caller can prefetch what it needs to process it.
+  Only the events already read from the driver buffers are visible.
+
+  \param handle Handle to the capture instance.
+  \param cpuid The CPU ID of an event returned by \ref scap_next.
+  \param distance 1 for the event that follows it on the same CPU, 2 for the
+    one after, and so on.
+
+  \return The event, valid until the next call to \ref scap_next, or NULL if
+   it isn't available yet or the engine doesn't support peeking.
+*/
+scap_evt* scap_peek(scap_t* handle, uint16_t cpuid, uint32_t distance);
+
 /*!
   \brief Get the length of an event
 
@@ -935,6 +959,15 @@ bool scap_check_current_engine(scap_t *handle, const char* engine_name);
 
   returns SCAP_FAILURE if there are already MAX_SUPPRESSED_COMMS comm
   values, SCAP_SUCCESS otherwise.
+
+  \note On live captures, the first PPM_MAX_SUPPRESSED_COMMS comms are
+  also passed to the driver, which drops the syscall events of the
+  threads whose current comm matches one of them, except the ones that
+  create or exec a process. This means that a thread renaming itself
+  (e.g. with prctl(PR_SET_NAME)) to a suppressed comm loses its syscall
+  events too. The kmod and modern_bpf drivers are also told about the
+  suppressed threads, so that the children that exec to a different comm
+  are dropped in the kernel as well.
 */
 
 int32_t scap_suppress_events_comm(scap_t* handle, const char *comm);
@@ -979,6 +1012,18 @@ uint32_t scap_event_decode_params(const scap_evt *e, struct scap_sized_buffer *p
 int32_t scap_event_encode_params(struct scap_sized_buffer event_buf, size_t *event_size, char *error, ppm_event_code event_type, uint32_t n, ...);
 int32_t scap_event_encode_params_v(struct scap_sized_buffer event_buf, size_t *event_size, char *error, ppm_event_code event_type, uint32_t n, va_list args);
 
+/*!
+  \brief Create an event from an array of parameters, without variadic arguments.
+
+  Same as scap_event_encode_params, but every parameter is passed as a struct scap_const_sized_buffer
+  holding its raw value: integers point to a value of the exact size of their type, strings include
+  their null terminator. Parameters of a fixed size type must be either empty or of that size, otherwise
+  SCAP_FAILURE is returned.
+
+  \param params An array of n parameters.
+ */
+int32_t scap_event_encode_params_array(struct scap_sized_buffer event_buf, size_t *event_size, char *error, ppm_event_code event_type, uint32_t n, const struct scap_const_sized_buffer *params);
+
 /*@}*/
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1003,6 +1048,13 @@ uint32_t scap_event_get_sentinel_begin(scap_evt* e);
 // The returned pointer must be freed via scap_proc_free by the caller.
 struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_sockets);
 
+// Read the fds of a process from /proc, typically for the processes whose
+// fds were skipped by the initial scan (see proc_scan_lazy_fds).
+// Returns a threadinfo with only tid, pid and fdlist set, that must be
+// freed via scap_proc_free by the caller, or NULL on failure.
+// Unlike the other functions of the handle, this can be called from any thread.
+struct scap_threadinfo* scap_proc_get_fds(scap_t* handle, int64_t pid);
+
 // Check if the given thread exists in ;proc
 bool scap_is_thread_alive(scap_t* handle, int64_t pid, int64_t tid, const char* comm);
 
@@ -1021,6 +1073,21 @@ void scap_refresh_iflist(scap_t* handle);
 int32_t scap_refresh_proc_table(scap_t* handle);
 uint64_t scap_ftell(scap_t *handle);
 void scap_fseek(scap_t *handle, uint64_t off);
+// Move a capture to its first event not older than ts. Needs an uncompressed
+// capture written with an event index (see scap_dump_enable_index)
+int32_t scap_fseek_ts(scap_t *handle, uint64_t ts);
+// Move a capture to its last state checkpoint older than ts (see
+// scap_dump_checkpoint), and load the state it holds as if the capture was
+// restarted. The events between the checkpoint and ts are still to be read
+int32_t scap_fseek_checkpoint(scap_t *handle, uint64_t ts);
+// Skip the events of a capture whose type isn't set in event_types
+// (PPM_EVENT_MAX flags, NULL for all the types) or whose timestamp is out
+// of [ts_min, ts_max], reading only their header
+int32_t scap_set_read_filter(scap_t *handle, const uint8_t* event_types, uint64_t ts_min, uint64_t ts_max);
+// Get the event index of a capture (see evt_index_entry in scap_savefile.h),
+// with no entries if the capture has none. The entries are owned by the handle
+struct _evt_index_entry;
+int32_t scap_get_event_index(scap_t *handle, const struct _evt_index_entry** entries, uint64_t* n_entries);
 int32_t scap_enable_tracers_capture(scap_t* handle);
 int32_t scap_proc_add(scap_t* handle, uint64_t tid, scap_threadinfo* tinfo);
 int32_t scap_fd_add(scap_t *handle, scap_threadinfo* tinfo, uint64_t fd, scap_fdinfo* fdinfo);
@@ -1035,6 +1102,62 @@ int32_t scap_set_fullcapture_port_range(scap_t* handle, uint16_t range_start, ui
  */
 int32_t scap_set_statsd_port(scap_t* handle, uint16_t port);
 
+/**
+ * Replace the snaplen for the buffers read from or written to one kind of fd
+ * (an enum ppm_snaplen_fd_type), e.g. to keep some payload for the sockets
+ * and none for the files. PPM_SNAPLEN_FD_TYPE_DEFAULT goes back to the
+ * snaplen set with scap_set_snaplen(). The dynamic snaplen and the
+ * fullcapture port range still apply on top of it.
+ */
+int32_t scap_set_fd_type_snaplen(scap_t* handle, uint32_t fd_type, uint32_t snaplen);
+
+/**
+ * Cap the snaplen of the events written to one buffer (the cpuid the events
+ * of scap_next() come with), whatever snaplen they would get otherwise.
+ * PPM_SNAPLEN_NO_LIMIT removes the cap. Meant to copy less data when a
+ * buffer is filling up. Returns SCAP_NOT_SUPPORTED if the engine only has a
+ * global snaplen.
+ */
+int32_t scap_set_buffer_snaplen(scap_t* handle, uint32_t buffer, uint32_t snaplen);
+
+/**
+ * Filter the syscall events in the driver by the cgroup of the task, before
+ * they are serialized: with PPM_CGROUP_FILTER_ALLOW only the tasks of the
+ * cgroups added with scap_set_cgroup_filter() are kept, with
+ * PPM_CGROUP_FILTER_DENY they are dropped. The syscalls building up the
+ * process tree are always kept. Only the BPF engines support it.
+ */
+int32_t scap_set_cgroup_filter_mode(scap_t* handle, enum ppm_cgroup_filter_mode mode);
+
+/**
+ * Add (listed = true) or remove a cgroup from the cgroup filter. The cgroup
+ * id is the inode number of the cgroup v2 directory, as reported by stat(2).
+ * At most PPM_MAX_CGROUP_FILTER_IDS cgroups can be listed.
+ */
+int32_t scap_set_cgroup_filter(scap_t* handle, uint64_t cgroup_id, bool listed);
+
+/**
+ * Sampling and rate limit of the events of a syscall, see
+ * scap_set_syscall_limit().
+ */
+struct scap_syscall_limit
+{
+	uint32_t sample_every; ///< Keep one event every sample_every, 0 or 1 to keep them all.
+	uint32_t max_per_sec; ///< Keep at most max_per_sec events per second on every CPU, 0 for no limit.
+};
+
+/**
+ * Sample and/or rate limit the events of a syscall in the driver, e.g. to
+ * keep one read every 100 or at most 1000 futex per second. Enter and exit
+ * events are limited on their own, and the rate limit is enforced on every
+ * CPU. Passing 0 for both values removes the limit. The dropped events are
+ * counted in the n_drops_syscall_limit.<syscall> stats.
+ * The sched_switch, page_fault_user and page_fault_kernel tracepoints can be
+ * limited the same way.
+ * Only the modern BPF engine supports it.
+ */
+int32_t scap_set_syscall_limit(scap_t* handle, ppm_sc_code ppm_sc, uint32_t sample_every, uint32_t max_per_sec);
+
 /**
  * Get API version supported by the driver
  * If the API version is unavailable for whatever reason,
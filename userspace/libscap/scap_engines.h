@@ -54,3 +54,7 @@ extern const struct scap_vtable scap_modern_bpf_engine;
 #ifdef HAS_ENGINE_TEST_INPUT
 extern const struct scap_vtable scap_test_input_engine;
 #endif
+
+#ifdef HAS_ENGINE_SYNTHETIC
+extern const struct scap_vtable scap_synthetic_engine;
+#endif
@@ -151,42 +151,65 @@ int32_t scap_event_encode_params(struct scap_sized_buffer event_buf, size_t *eve
 	return ret;
 }
 
-int32_t scap_event_encode_params_v(const struct scap_sized_buffer event_buf, size_t *event_size, char *error, ppm_event_code event_type, uint32_t n, va_list args)
+// Size of the parameters of a fixed size type, 0 for the variable size ones
+static size_t scap_event_param_fixed_size(enum ppm_param_type type)
 {
-	scap_evt *event = NULL;
-
-	const struct ppm_event_info *event_info = &g_event_info[event_type];
-
-	// len_size is the size in bytes of an entry of the parameter length array
-	size_t len_size = sizeof(uint16_t);
-	if((event_info->flags & EF_LARGE_PAYLOAD) != 0)
+	switch(type)
 	{
-		len_size = sizeof(uint32_t);
+	case PT_INT8:
+	case PT_UINT8:
+	case PT_FLAGS8:
+	case PT_SIGTYPE:
+	case PT_L4PROTO:
+	case PT_SOCKFAMILY:
+	case PT_ENUMFLAGS8:
+		return sizeof(uint8_t);
+	case PT_INT16:
+	case PT_UINT16:
+	case PT_SYSCALLID:
+	case PT_PORT:
+	case PT_FLAGS16:
+	case PT_ENUMFLAGS16:
+		return sizeof(uint16_t);
+	case PT_INT32:
+	case PT_UINT32:
+	case PT_BOOL:
+	case PT_IPV4ADDR:
+	case PT_UID:
+	case PT_GID:
+	case PT_FLAGS32:
+	case PT_SIGSET:
+	case PT_MODE:
+	case PT_ENUMFLAGS32:
+		return sizeof(uint32_t);
+	case PT_INT64:
+	case PT_UINT64:
+	case PT_ERRNO:
+	case PT_FD:
+	case PT_PID:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+	case PT_DOUBLE:
+		return sizeof(uint64_t);
+	default:
+		return 0;
 	}
+}
 
-	n = event_info->nparams < n ? event_info->nparams : n;
-
-	size_t len = sizeof(struct ppm_evt_hdr) + len_size * n;
+int32_t scap_event_encode_params_v(const struct scap_sized_buffer event_buf, size_t *event_size, char *error, ppm_event_code event_type, uint32_t n, va_list args)
+{
+	const struct ppm_event_info *event_info = &g_event_info[event_type];
+	struct scap_const_sized_buffer params[PPM_MAX_EVENT_PARAMS];
+	// backing storage of the integer parameters
+	uint64_t values[PPM_MAX_EVENT_PARAMS];
 
-	// every buffer write access needs to be guarded by a scap_buffer_can_fit call to check if it's large enough
-	if (scap_buffer_can_fit(event_buf, len))
-	{
-		event = event_buf.buf;
-		event->type = event_type;
-		event->nparams = n;
-		event->len = len;
-	}
+	n = event_info->nparams < n ? event_info->nparams : n;
 
 	for(int i = 0; i < n; i++)
 	{
 		const struct ppm_param_info *pi = &event_info->params[i];
 		struct scap_const_sized_buffer param = {0};
 
-        uint8_t u8_arg;
-        uint16_t u16_arg;
-        uint32_t u32_arg;
-        uint64_t u64_arg;
-
 		switch(pi->type)
 		{
 		case PT_INT8:
@@ -196,10 +219,13 @@ int32_t scap_event_encode_params_v(const struct scap_sized_buffer event_buf, siz
 		case PT_L4PROTO:
 		case PT_SOCKFAMILY:
 		case PT_ENUMFLAGS8:
-			u8_arg = (uint8_t) (va_arg(args, int) & 0xff);
-			param.buf = &u8_arg;
+		{
+			uint8_t u8_arg = (uint8_t) (va_arg(args, int) & 0xff);
+			memcpy(&values[i], &u8_arg, sizeof(uint8_t));
+			param.buf = &values[i];
 			param.size = sizeof(uint8_t);
 			break;
+		}
 
 		case PT_INT16:
 		case PT_UINT16:
@@ -207,10 +233,13 @@ int32_t scap_event_encode_params_v(const struct scap_sized_buffer event_buf, siz
 		case PT_PORT:
 		case PT_FLAGS16:
 		case PT_ENUMFLAGS16:
-			u16_arg = (uint16_t) (va_arg(args, int) & 0xffff);
-			param.buf = &u16_arg;
+		{
+			uint16_t u16_arg = (uint16_t) (va_arg(args, int) & 0xffff);
+			memcpy(&values[i], &u16_arg, sizeof(uint16_t));
+			param.buf = &values[i];
 			param.size = sizeof(uint16_t);
 			break;
+		}
 
 		case PT_INT32:
 		case PT_UINT32:
@@ -222,10 +251,13 @@ int32_t scap_event_encode_params_v(const struct scap_sized_buffer event_buf, siz
 		case PT_SIGSET:
 		case PT_MODE:
 		case PT_ENUMFLAGS32:
-            u32_arg = va_arg(args, uint32_t);
-            param.buf = &u32_arg;
-            param.size = sizeof(uint32_t);
+		{
+			uint32_t u32_arg = va_arg(args, uint32_t);
+			memcpy(&values[i], &u32_arg, sizeof(uint32_t));
+			param.buf = &values[i];
+			param.size = sizeof(uint32_t);
 			break;
+		}
 
 		case PT_INT64:
 		case PT_UINT64:
@@ -235,15 +267,15 @@ int32_t scap_event_encode_params_v(const struct scap_sized_buffer event_buf, siz
 		case PT_RELTIME:
 		case PT_ABSTIME:
 		case PT_DOUBLE:
-            u64_arg = va_arg(args, uint64_t);
-            param.buf = &u64_arg;
-            param.size = sizeof(uint64_t);
+			values[i] = va_arg(args, uint64_t);
+			param.buf = &values[i];
+			param.size = sizeof(uint64_t);
 			break;
 
 		case PT_CHARBUF:
 		case PT_FSPATH:
 		case PT_FSRELPATH:
-            param.buf = va_arg(args, char*);
+			param.buf = va_arg(args, char*);
 			if(param.buf == NULL)
 			{
 				param.size = 0;
@@ -266,17 +298,62 @@ int32_t scap_event_encode_params_v(const struct scap_sized_buffer event_buf, siz
 		case PT_IPADDR:		    /* Either an IPv4 or IPv6 address. The length indicates which one it is. */
 		case PT_IPNET:		    /* Either an IPv4 or IPv6 network. The length indicates which one it is. */
 		case PT_SOCKADDR:
-            param = va_arg(args, struct scap_const_sized_buffer);
+			param = va_arg(args, struct scap_const_sized_buffer);
 			break;
-			
+
 		case PT_NONE:
-        case PT_MAX:
-			break; // Nothing to do 
+		case PT_MAX:
+			break; // Nothing to do
 		default: // Unsupported event
 			snprintf(error, SCAP_LASTERR_SIZE, "event param %d (param type %d) is unsupported", i, pi->type);
 			return SCAP_FAILURE;
 		}
 
+		params[i] = param;
+	}
+
+	return scap_event_encode_params_array(event_buf, event_size, error, event_type, n, params);
+}
+
+int32_t scap_event_encode_params_array(const struct scap_sized_buffer event_buf, size_t *event_size, char *error, ppm_event_code event_type, uint32_t n, const struct scap_const_sized_buffer *params)
+{
+	scap_evt *event = NULL;
+
+	const struct ppm_event_info *event_info = &g_event_info[event_type];
+
+	// len_size is the size in bytes of an entry of the parameter length array
+	size_t len_size = sizeof(uint16_t);
+	if((event_info->flags & EF_LARGE_PAYLOAD) != 0)
+	{
+		len_size = sizeof(uint32_t);
+	}
+
+	n = event_info->nparams < n ? event_info->nparams : n;
+
+	size_t len = sizeof(struct ppm_evt_hdr) + len_size * n;
+
+	// every buffer write access needs to be guarded by a scap_buffer_can_fit call to check if it's large enough
+	if (scap_buffer_can_fit(event_buf, len))
+	{
+		event = event_buf.buf;
+		event->type = event_type;
+		event->nparams = n;
+		event->len = len;
+	}
+
+	for(int i = 0; i < n; i++)
+	{
+		struct scap_const_sized_buffer param = params[i];
+
+		// the fixed size parameters are either empty or of their exact size
+		size_t fixed_size = scap_event_param_fixed_size(event_info->params[i].type);
+		if(fixed_size != 0 && param.size != 0 && param.size != fixed_size)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "event param %d of event type %d has size %zu instead of %zu",
+				 i, event_type, param.size, fixed_size);
+			return SCAP_FAILURE;
+		}
+
 		uint16_t param_size_16;
 		uint32_t param_size_32;
 
@@ -287,7 +364,7 @@ int32_t scap_event_encode_params_v(const struct scap_sized_buffer event_buf, siz
 				if (param_size_16 != param.size)
 				{
 					snprintf(error, SCAP_LASTERR_SIZE, "could not fit event param %d size %zu for event with type %d in %zu bytes",
-							i, param.size, event->type, len_size);
+							i, param.size, event_type, len_size);
 					return SCAP_FAILURE;
 				}
 				if (scap_buffer_can_fit(event_buf, len))
@@ -300,7 +377,7 @@ int32_t scap_event_encode_params_v(const struct scap_sized_buffer event_buf, siz
 				if (param_size_32 != param.size)
 				{
 					snprintf(error, SCAP_LASTERR_SIZE, "could not fit event param %d size %zu for event with type %d in %zu bytes",
-							i, param.size, event->type, len_size);
+							i, param.size, event_type, len_size);
 					return SCAP_FAILURE;
 				}
 				if (scap_buffer_can_fit(event_buf, len))
@@ -310,15 +387,15 @@ int32_t scap_event_encode_params_v(const struct scap_sized_buffer event_buf, siz
 				break;
 			default:
 				snprintf(error, SCAP_LASTERR_SIZE, "unexpected param %d length %zu for event with type %d",
-						i, len_size, event->type);
+						i, len_size, event_type);
 				return SCAP_FAILURE;
 		}
 
 		if (scap_buffer_can_fit(event_buf, len + param.size) && param.size != 0)
 		{
-        	memcpy(((char*)event_buf.buf + len), param.buf, param.size);
+			memcpy(((char*)event_buf.buf + len), param.buf, param.size);
 		}
-        len = len + param.size;
+		len = len + param.size;
 	}
 
 #ifdef PPM_ENABLE_SENTINEL
@@ -67,6 +67,23 @@ extern "C"
 		SCAP_MODE_TEST,
 	} scap_mode_t;
 
+	/*!
+	  \brief Strategies used to merge the per-CPU buffers in timestamp order.
+	  Only meaningful for the engines sharing the `ringbuffer` consumer (kmod, bpf, udig).
+	*/
+	typedef enum
+	{
+		/*!
+		 * For every event scan all the buffers looking for the lowest timestamp (O(n_buffers) per event).
+		 */
+		SCAP_RINGBUFFER_MERGE_LINEAR = 0,
+		/*!
+		 * Keep the buffer heads in a min-heap and only re-sift the buffer that produced
+		 * the last event (O(log(n_buffers)) per event). Useful on machines with many CPUs.
+		 */
+		SCAP_RINGBUFFER_MERGE_HEAP,
+	} scap_ringbuffer_merge_mode;
+
 	/*!
 	 * \brief Argument for scap_open
 	 * Set any PPM_SC syscall idx to true to enable its tracing at driver level,
@@ -92,6 +109,25 @@ extern "C"
 		void(*debug_log_fn)(const char* msg); //< Function which SCAP may use to log a debug message
 		uint64_t proc_scan_timeout_ms; //< Timeout in msec, after which so-far-successful scan of /proc should be cut short with success return
 		uint64_t proc_scan_log_interval_ms; //< Interval for logging progress messages from /proc scan
+		uint32_t proc_scan_threads; //< Number of threads scanning /proc in parallel, 1 scans it serially
+		bool proc_scan_lazy_fds; //< Don't read the fds of the processes while scanning /proc, they are read later with scap_proc_get_fds()
+		bool proc_scan_skip; //< Don't scan /proc at all when opening a live capture, the caller restores the processes on its own and the missing ones are read with scap_proc_get()
+		uint64_t proc_scan_spill_bytes; //< If not 0, the events produced while scanning /proc (kmod, bpf, modern_bpf) are read into a buffer of this size, rather than
+						// left in the kernel buffers where they could be dropped, and scap_next() returns them first. Once the buffer
+						// is full, the following events are left in the kernel buffers.
+		scap_ringbuffer_merge_mode ringbuffer_merge_mode; ///< strategy used to merge the per-CPU buffers (kmod, bpf, udig, modern_bpf).
+		uint32_t ringbuffer_consume_chunk_b; ///< if not 0, give back consumed data to the producer every `ringbuffer_consume_chunk_b` bytes and
+						     // refill drained buffers on their own, instead of waiting for all the read blocks
+						     // to be consumed (kmod, bpf, udig). 0 (default) means whole-block consumption.
+		bool ringbuffer_wakeup; ///< when the buffers are almost empty, wait for the producers to notify new data instead of sleeping
+					// with an exponential backoff (kmod, bpf, modern_bpf, udig).
+		uint32_t ringbuffer_empty_threshold_b; ///< buffers holding less than this are considered empty and we wait before reading them again
+						       // (kmod, bpf, udig). 0 means the default (20000 bytes).
+		uint32_t ringbuffer_wakeup_watermark_b; ///< wakeup mode only: the drivers notify the consumer once a buffer holds this many
+							// unconsumed bytes, so that it wakes up once per batch of events (kmod, bpf, modern_bpf).
+							// 0 means the empty threshold.
+		uint32_t ringbuffer_empty_wait_max_us; ///< maximum time we wait on empty buffers: the cap of the sleep backoff or the timeout of
+						       // the wakeup wait. 0 means the default (30 ms).
 		void* engine_params;			   ///< engine-specific params.
 	} scap_open_args;
 
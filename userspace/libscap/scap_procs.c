@@ -188,24 +188,14 @@ int32_t scap_check_suppressed(struct scap_suppress* suppress, scap_evt *pevent,
 
 	default:
 
-		HASH_FIND_INT64(suppress->m_suppressed_tids, &(pevent->tid), stid);
-
 		// When threads exit they are always removed and no longer suppressed.
 		if(pevent->type == PPME_PROCEXIT_1_E)
 		{
-			if(stid != NULL)
-			{
-				HASH_DEL(suppress->m_suppressed_tids, stid);
-				free(stid);
-				*suppressed = true;
-			}
-			else
-			{
-				*suppressed = false;
-			}
+			*suppressed = scap_remove_suppressed_tid(suppress, pevent->tid);
 		}
 		else
 		{
+			HASH_FIND_INT64(suppress->m_suppressed_tids, &(pevent->tid), stid);
 			*suppressed = (stid != NULL);
 		}
 
@@ -20,6 +20,7 @@ limitations under the License.
 #include <stdlib.h>
 
 #ifndef _WIN32
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/uio.h>
 #else
@@ -33,6 +34,14 @@ struct iovec {
 #include "scap-int.h"
 #include "scap_savefile_api.h"
 #include "scap_savefile.h"
+#include "strlcpy.h"
+
+#ifdef HAS_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAS_LZ4
+#include <lz4frame.h>
+#endif
 
 const char* scap_dump_getlasterr(scap_dumper_t* d)
 {
@@ -46,457 +55,1823 @@ const char* scap_dump_getlasterr(scap_dumper_t* d)
 ///////////////////////////////////////////////////////////////////////////////
 
 //
-// Write data into a dump file
+// Compressed output for the modes that gzFile doesn't handle. The data is
+// collected in chunks, that write_chunk() compresses and writes to the file.
+// Each writer embeds this as its first member.
 //
-static int scap_dump_write(scap_dumper_t *d, void* buf, unsigned len)
+struct scap_dump_stream
 {
-	if(d->m_type == DT_FILE)
+	// Compress the pending data and write it
+	int (*write_chunk)(struct scap_dump_stream* s);
+	// Write the end of the stream and free the compressor
+	int (*finish)(struct scap_dump_stream* s);
+	FILE* m_file;
+	uint8_t* m_in; // Data of the chunk being filled
+	uint32_t m_in_len;
+	uint32_t m_in_size;
+	uint64_t m_in_total; // Bytes written, including the ones not compressed yet
+	uint64_t m_out_total; // Bytes written to the file
+};
+
+// The helpers of the writers, which all need an optional library
+#if (defined(USE_ZLIB) && !defined(UDIG)) || defined(HAS_ZSTD) || defined(HAS_LZ4)
+static int scap_dump_stream_init(struct scap_dump_stream* s, FILE* file, uint32_t chunk_size)
+{
+	s->m_file = file;
+	s->m_in_size = chunk_size;
+	s->m_in = (uint8_t*)malloc(chunk_size);
+	return s->m_in != NULL ? 0 : -1;
+}
+
+static int scap_dump_stream_fwrite(struct scap_dump_stream* s, const void* buf, size_t len)
+{
+	if(len > 0 && fwrite(buf, 1, len, s->m_file) != len)
 	{
-		return gzwrite(d->m_f, buf, len);
+		return -1;
 	}
-	else
+	s->m_out_total += len;
+	return 0;
+}
+#endif
+
+static int scap_dump_stream_write(struct scap_dump_stream* s, void* buf, unsigned len)
+{
+	const uint8_t* src = (const uint8_t*)buf;
+	unsigned left = len;
+
+	while(left > 0)
 	{
-		if(d->m_targetbufcurpos + len >= d->m_targetbufend)
+		uint32_t n = s->m_in_size - s->m_in_len;
+		if(n > left)
 		{
-			if(d->m_type == DT_MEM)
+			n = left;
+		}
+		memcpy(s->m_in + s->m_in_len, src, n);
+		s->m_in_len += n;
+		src += n;
+		left -= n;
+
+		if(s->m_in_len == s->m_in_size)
+		{
+			if(s->write_chunk(s) != 0)
 			{
 				return -1;
 			}
+			s->m_in_len = 0;
+		}
+	}
 
-			// DT_MANAGED_BUF, try to increase the size
-			size_t targetbufsize = PPM_DUMPER_MANAGED_BUF_RESIZE_FACTOR * (d->m_targetbufend - d->m_targetbuf);
+	s->m_in_total += len;
+	return len;
+}
 
-			uint8_t *targetbuf = (uint8_t *)realloc(
-				d->m_targetbuf,
-				targetbufsize);
-			if(targetbuf == NULL)
-			{
-				free(d->m_targetbuf);
-				return -1;
-			}
+static void scap_dump_stream_flush(struct scap_dump_stream* s)
+{
+	if(s->m_in_len > 0 && s->write_chunk(s) == 0)
+	{
+		s->m_in_len = 0;
+	}
+	fflush(s->m_file);
+}
 
-			size_t offset = (d->m_targetbufcurpos - d->m_targetbuf);
-			d->m_targetbuf = targetbuf;
-			d->m_targetbufcurpos = targetbuf + offset;
-			d->m_targetbufend = targetbuf + targetbufsize;
-		}
+static int scap_dump_stream_close(struct scap_dump_stream* s)
+{
+	int res = 0;
+	if(s->m_in_len > 0)
+	{
+		res = s->write_chunk(s);
+	}
+	if(s->finish(s) != 0)
+	{
+		res = -1;
+	}
+	if(fclose(s->m_file) != 0)
+	{
+		res = -1;
+	}
+	free(s->m_in);
+	free(s);
+	return res;
+}
 
-		memcpy(d->m_targetbufcurpos, buf, len);
+static inline int64_t scap_dump_stream_tell(struct scap_dump_stream* s)
+{
+	return (int64_t)s->m_in_total;
+}
 
-		d->m_targetbufcurpos += len;
-		return len;
+static inline int64_t scap_dump_stream_offset(struct scap_dump_stream* s)
+{
+	return (int64_t)s->m_out_total;
+}
+
+#if defined(USE_ZLIB) && !defined(UDIG)
+//
+// Writer of block compressed captures, see GZBLOCK_DATA_SIZE
+//
+struct scap_gzblock_writer
+{
+	struct scap_dump_stream m_stream;
+	z_stream m_zs;
+	uint8_t* m_out; // Compressed block
+	uint32_t m_out_size;
+};
+
+static inline void scap_gzblock_put_le32(uint8_t* p, uint32_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+}
+
+//
+// Compress the pending data into a gzip member and write it
+//
+static int scap_gzblock_write_chunk(struct scap_dump_stream* s)
+{
+	struct scap_gzblock_writer* w = (struct scap_gzblock_writer*)s;
+	uint32_t len;
+	uint8_t* p = w->m_out;
+
+	deflateReset(&w->m_zs);
+	w->m_zs.next_in = s->m_in;
+	w->m_zs.avail_in = s->m_in_len;
+	w->m_zs.next_out = w->m_out + GZBLOCK_HEADER_LEN;
+	w->m_zs.avail_out = w->m_out_size - GZBLOCK_HEADER_LEN - GZBLOCK_TRAILER_LEN;
+	if(deflate(&w->m_zs, Z_FINISH) != Z_STREAM_END)
+	{
+		return -1;
+	}
+	len = GZBLOCK_HEADER_LEN + w->m_zs.total_out + GZBLOCK_TRAILER_LEN;
+
+	// ID1, ID2, CM = deflate, FLG = FEXTRA, MTIME = 0, XFL = 0, OS = unknown
+	p[0] = 0x1f;
+	p[1] = 0x8b;
+	p[2] = 8;
+	p[3] = 4;
+	scap_gzblock_put_le32(p + 4, 0);
+	p[8] = 0;
+	p[9] = 0xff;
+	// XLEN, then our subfield with the member size
+	p[10] = 8;
+	p[11] = 0;
+	p[12] = GZBLOCK_SI1;
+	p[13] = GZBLOCK_SI2;
+	p[14] = 4;
+	p[15] = 0;
+	scap_gzblock_put_le32(p + 16, len);
+
+	p = w->m_out + len - GZBLOCK_TRAILER_LEN;
+	scap_gzblock_put_le32(p, crc32(crc32(0L, Z_NULL, 0), s->m_in, s->m_in_len));
+	scap_gzblock_put_le32(p + 4, s->m_in_len);
+
+	return scap_dump_stream_fwrite(s, w->m_out, len);
+}
+
+static int scap_gzblock_finish(struct scap_dump_stream* s)
+{
+	struct scap_gzblock_writer* w = (struct scap_gzblock_writer*)s;
+	deflateEnd(&w->m_zs);
+	free(w->m_out);
+	return 0;
+}
+
+static struct scap_dump_stream* scap_gzblock_writer_open(FILE* file)
+{
+	struct scap_gzblock_writer* w = (struct scap_gzblock_writer*)calloc(1, sizeof(struct scap_gzblock_writer));
+	if(w == NULL)
+	{
+		return NULL;
+	}
+
+	// Raw deflate, the gzip framing is written by hand to fit the block size in it
+	if(deflateInit2(&w->m_zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		free(w);
+		return NULL;
+	}
+
+	w->m_stream.write_chunk = scap_gzblock_write_chunk;
+	w->m_stream.finish = scap_gzblock_finish;
+	w->m_out_size = deflateBound(&w->m_zs, GZBLOCK_DATA_SIZE) + GZBLOCK_HEADER_LEN + GZBLOCK_TRAILER_LEN;
+	w->m_out = (uint8_t*)malloc(w->m_out_size);
+	if(w->m_out == NULL || scap_dump_stream_init(&w->m_stream, file, GZBLOCK_DATA_SIZE) != 0)
+	{
+		deflateEnd(&w->m_zs);
+		free(w->m_out);
+		free(w);
+		return NULL;
 	}
+
+	return &w->m_stream;
 }
+#endif
 
-static int scap_dump_writev(scap_dumper_t *d, const struct iovec *iov, int iovcnt)
+#ifdef HAS_ZSTD
+//
+// Writer of zstd compressed captures
+//
+struct scap_zstd_writer
 {
-	unsigned totlen = 0;
-	int i;
+	struct scap_dump_stream m_stream;
+	ZSTD_CCtx* m_ctx;
+	uint8_t* m_out;
+	size_t m_out_size;
+};
 
-	for (i = 0; i < iovcnt; i++)
+static int scap_zstd_compress(struct scap_zstd_writer* w, ZSTD_EndDirective mode)
+{
+	ZSTD_inBuffer in = {w->m_stream.m_in, mode == ZSTD_e_end ? 0 : w->m_stream.m_in_len, 0};
+	size_t remaining;
+
+	do
 	{
-		if(scap_dump_write(d, iov[i].iov_base, iov[i].iov_len) < 0)
+		ZSTD_outBuffer out = {w->m_out, w->m_out_size, 0};
+		remaining = ZSTD_compressStream2(w->m_ctx, &out, &in, mode);
+		if(ZSTD_isError(remaining) || scap_dump_stream_fwrite(&w->m_stream, w->m_out, out.pos) != 0)
 		{
 			return -1;
 		}
+	} while(remaining != 0);
 
-		totlen += iov[i].iov_len;
-	}
+	return 0;
+}
 
-	return totlen;
+static int scap_zstd_write_chunk(struct scap_dump_stream* s)
+{
+	return scap_zstd_compress((struct scap_zstd_writer*)s, ZSTD_e_flush);
 }
 
-uint8_t* scap_get_memorydumper_curpos(scap_dumper_t *d)
+static int scap_zstd_finish(struct scap_dump_stream* s)
 {
-	return d->m_targetbufcurpos;
+	struct scap_zstd_writer* w = (struct scap_zstd_writer*)s;
+	int res = scap_zstd_compress(w, ZSTD_e_end);
+	ZSTD_freeCCtx(w->m_ctx);
+	free(w->m_out);
+	return res;
 }
 
-#ifndef _WIN32
-static inline uint32_t scap_normalize_block_len(uint32_t blocklen)
-#else
-static uint32_t scap_normalize_block_len(uint32_t blocklen)
+static struct scap_dump_stream* scap_zstd_writer_open(FILE* file)
+{
+	struct scap_zstd_writer* w = (struct scap_zstd_writer*)calloc(1, sizeof(struct scap_zstd_writer));
+	if(w == NULL)
+	{
+		return NULL;
+	}
+
+	w->m_stream.write_chunk = scap_zstd_write_chunk;
+	w->m_stream.finish = scap_zstd_finish;
+	w->m_ctx = ZSTD_createCCtx();
+	w->m_out_size = ZSTD_CStreamOutSize();
+	w->m_out = (uint8_t*)malloc(w->m_out_size);
+	if(w->m_ctx == NULL || w->m_out == NULL ||
+	   ZSTD_isError(ZSTD_CCtx_setParameter(w->m_ctx, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT)) ||
+	   scap_dump_stream_init(&w->m_stream, file, STREAM_CHUNK_SIZE) != 0)
+	{
+		ZSTD_freeCCtx(w->m_ctx);
+		free(w->m_out);
+		free(w);
+		return NULL;
+	}
+
+	return &w->m_stream;
+}
 #endif
+
+#ifdef HAS_LZ4
+//
+// Writer of lz4 compressed captures
+//
+struct scap_lz4_writer
 {
-	return ((blocklen + 3) >> 2) << 2;
+	struct scap_dump_stream m_stream;
+	LZ4F_cctx* m_ctx;
+	LZ4F_preferences_t m_prefs;
+	uint8_t* m_out;
+	size_t m_out_size;
+	bool m_started;
+};
+
+static int scap_lz4_write_chunk(struct scap_dump_stream* s)
+{
+	struct scap_lz4_writer* w = (struct scap_lz4_writer*)s;
+	size_t len;
+
+	if(!w->m_started)
+	{
+		len = LZ4F_compressBegin(w->m_ctx, w->m_out, w->m_out_size, &w->m_prefs);
+		if(LZ4F_isError(len) || scap_dump_stream_fwrite(s, w->m_out, len) != 0)
+		{
+			return -1;
+		}
+		w->m_started = true;
+	}
+
+	len = LZ4F_compressUpdate(w->m_ctx, w->m_out, w->m_out_size, s->m_in, s->m_in_len, NULL);
+	if(LZ4F_isError(len) || scap_dump_stream_fwrite(s, w->m_out, len) != 0)
+	{
+		return -1;
+	}
+
+	len = LZ4F_flush(w->m_ctx, w->m_out, w->m_out_size, NULL);
+	if(LZ4F_isError(len) || scap_dump_stream_fwrite(s, w->m_out, len) != 0)
+	{
+		return -1;
+	}
+
+	return 0;
 }
 
-static int32_t scap_write_padding(scap_dumper_t *d, uint32_t blocklen)
+static int scap_lz4_finish(struct scap_dump_stream* s)
 {
-	int32_t val = 0;
-	uint32_t bytestowrite = scap_normalize_block_len(blocklen) - blocklen;
+	struct scap_lz4_writer* w = (struct scap_lz4_writer*)s;
+	int res = 0;
 
-	if(scap_dump_write(d, &val, bytestowrite) == bytestowrite)
+	// An empty capture still needs a valid frame
+	if(!w->m_started)
 	{
-		return SCAP_SUCCESS;
+		res = scap_lz4_write_chunk(s);
 	}
-	else
+	if(res == 0)
 	{
-		return SCAP_FAILURE;
+		size_t len = LZ4F_compressEnd(w->m_ctx, w->m_out, w->m_out_size, NULL);
+		if(LZ4F_isError(len) || scap_dump_stream_fwrite(s, w->m_out, len) != 0)
+		{
+			res = -1;
+		}
+	}
+
+	LZ4F_freeCompressionContext(w->m_ctx);
+	free(w->m_out);
+	return res;
+}
+
+static struct scap_dump_stream* scap_lz4_writer_open(FILE* file)
+{
+	struct scap_lz4_writer* w = (struct scap_lz4_writer*)calloc(1, sizeof(struct scap_lz4_writer));
+	if(w == NULL)
+	{
+		return NULL;
+	}
+
+	w->m_stream.write_chunk = scap_lz4_write_chunk;
+	w->m_stream.finish = scap_lz4_finish;
+	w->m_prefs.frameInfo.blockSizeID = LZ4F_max4MB;
+	w->m_prefs.frameInfo.blockMode = LZ4F_blockLinked;
+	w->m_prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+	w->m_out_size = LZ4F_compressBound(STREAM_CHUNK_SIZE, &w->m_prefs) + LZ4F_HEADER_SIZE_MAX;
+	w->m_out = (uint8_t*)malloc(w->m_out_size);
+	if(LZ4F_isError(LZ4F_createCompressionContext(&w->m_ctx, LZ4F_VERSION)) || w->m_out == NULL ||
+	   scap_dump_stream_init(&w->m_stream, file, STREAM_CHUNK_SIZE) != 0)
+	{
+		LZ4F_freeCompressionContext(w->m_ctx);
+		free(w->m_out);
+		free(w);
+		return NULL;
 	}
+
+	return &w->m_stream;
 }
+#endif
 
 //
-// Calculate the length on disk of an fd entry's info
+// Open the writer for one of the compression modes that gzFile doesn't
+// handle. Takes ownership of the file, which is closed on failure.
 //
-static uint32_t scap_fd_info_len(scap_fdinfo *fdi)
+static struct scap_dump_stream* scap_dump_stream_open(FILE* file, compression_mode compress, char* error)
 {
-	//
-	// NB: new fields must be appended
-	//
+	struct scap_dump_stream* s = NULL;
 
-	uint32_t res = sizeof(uint32_t) + sizeof(fdi->ino) + 1 + sizeof(fdi->fd);
+	if(file == NULL)
+	{
+		return NULL;
+	}
 
-	switch(fdi->type)
+	switch(compress)
 	{
-	case SCAP_FD_IPV4_SOCK:
-		res +=  4 +     // sip
-		        4 +     // dip
-		        2 +     // sport
-		        2 +     // dport
-		        1;      // l4proto
-		break;
-	case SCAP_FD_IPV4_SERVSOCK:
-		res +=  4 +     // ip
-		        2 +     // port
-		        1;      // l4proto
-		break;
-	case SCAP_FD_IPV6_SOCK:
-		res += 	sizeof(uint32_t) * 4 + // sip
-				sizeof(uint32_t) * 4 + // dip
-				sizeof(uint16_t) + // sport
-				sizeof(uint16_t) + // dport
-				sizeof(uint8_t); // l4proto
-		break;
-	case SCAP_FD_IPV6_SERVSOCK:
-		res += 	sizeof(uint32_t) * 4 + // ip
-				sizeof(uint16_t) + // port
-				sizeof(uint8_t); // l4proto
-		break;
-	case SCAP_FD_UNIX_SOCK:
-		res +=
-			sizeof(uint64_t) + // unix source
-			sizeof(uint64_t) +  // unix destination
-			(uint32_t)strnlen(fdi->info.unix_socket_info.fname, SCAP_MAX_PATH_SIZE) + 2;
+#if defined(USE_ZLIB) && !defined(UDIG)
+	case SCAP_COMPRESSION_GZIP_BLOCKS:
+		s = scap_gzblock_writer_open(file);
 		break;
-	case SCAP_FD_FILE_V2:
-		res += sizeof(uint32_t) + // open_flags
-			(uint32_t)strnlen(fdi->info.regularinfo.fname, SCAP_MAX_PATH_SIZE) + 2 +
-			sizeof(uint32_t); // dev
+#endif
+#ifdef HAS_ZSTD
+	case SCAP_COMPRESSION_ZSTD:
+		s = scap_zstd_writer_open(file);
 		break;
-	case SCAP_FD_FIFO:
-	case SCAP_FD_FILE:
-	case SCAP_FD_DIRECTORY:
-	case SCAP_FD_UNSUPPORTED:
-	case SCAP_FD_EVENT:
-	case SCAP_FD_SIGNALFD:
-	case SCAP_FD_EVENTPOLL:
-	case SCAP_FD_INOTIFY:
-	case SCAP_FD_TIMERFD:
-	case SCAP_FD_NETLINK:
-	case SCAP_FD_BPF:
-	case SCAP_FD_USERFAULTFD:
-	case SCAP_FD_IOURING:
-		res += (uint32_t)strnlen(fdi->info.fname, SCAP_MAX_PATH_SIZE) + 2;    // 2 is the length field before the string
+#endif
+#ifdef HAS_LZ4
+	case SCAP_COMPRESSION_LZ4:
+		s = scap_lz4_writer_open(file);
 		break;
+#endif
 	default:
-		ASSERT(false);
-		break;
+		snprintf(error, SCAP_LASTERR_SIZE, "compression mode %d not supported by this build", (int)compress);
+		fclose(file);
+		return NULL;
 	}
 
-	return res;
+	if(s == NULL)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't initialize the compressor");
+		fclose(file);
+	}
+	return s;
 }
 
 //
-// Write the given fd info to disk
+// Write data to the file of a file dumper
 //
-static int32_t scap_fd_write_to_disk(scap_dumper_t *d, scap_fdinfo *fdi, uint32_t len)
+static int scap_dump_write_file(scap_dumper_t *d, void* buf, unsigned len)
 {
+	if(d->m_stream != NULL)
+	{
+		return scap_dump_stream_write(d->m_stream, buf, len);
+	}
+	return gzwrite(d->m_f, buf, len);
+}
 
-	uint8_t type = (uint8_t)fdi->type;
-	uint16_t stlen;
-	if(scap_dump_write(d, &(len), sizeof(uint32_t)) != sizeof(uint32_t) ||
-	        scap_dump_write(d, &(fdi->fd), sizeof(uint64_t)) != sizeof(uint64_t) ||
-	        scap_dump_write(d, &(fdi->ino), sizeof(uint64_t)) != sizeof(uint64_t) ||
-	        scap_dump_write(d, &(type), sizeof(uint8_t)) != sizeof(uint8_t))
+static int64_t scap_dump_file_offset(scap_dumper_t *d)
+{
+	if(d->m_stream != NULL)
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi1)");
-		return SCAP_FAILURE;
+		return scap_dump_stream_offset(d->m_stream);
 	}
+	return gzoffset(d->m_f);
+}
 
-	switch(fdi->type)
+static int64_t scap_dump_file_tell(scap_dumper_t *d)
+{
+	if(d->m_stream != NULL)
 	{
-	case SCAP_FD_IPV4_SOCK:
-		if(scap_dump_write(d, &(fdi->info.ipv4info.sip), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        scap_dump_write(d, &(fdi->info.ipv4info.dip), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        scap_dump_write(d, &(fdi->info.ipv4info.sport), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        scap_dump_write(d, &(fdi->info.ipv4info.dport), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        scap_dump_write(d, &(fdi->info.ipv4info.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
-		{
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi2)");
-			return SCAP_FAILURE;
-		}
-		break;
-	case SCAP_FD_IPV4_SERVSOCK:
-		if(scap_dump_write(d, &(fdi->info.ipv4serverinfo.ip), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        scap_dump_write(d, &(fdi->info.ipv4serverinfo.port), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        scap_dump_write(d, &(fdi->info.ipv4serverinfo.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
-		{
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi3)");
-			return SCAP_FAILURE;
-		}
-		break;
-	case SCAP_FD_IPV6_SOCK:
-		if(scap_dump_write(d, (char*)fdi->info.ipv6info.sip, sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
-		        scap_dump_write(d, (char*)fdi->info.ipv6info.dip, sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
-		        scap_dump_write(d, &(fdi->info.ipv6info.sport), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        scap_dump_write(d, &(fdi->info.ipv6info.dport), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        scap_dump_write(d, &(fdi->info.ipv6info.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
-		{
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi7)");
-		}
-		break;
-	case SCAP_FD_IPV6_SERVSOCK:
-		if(scap_dump_write(d, &(fdi->info.ipv6serverinfo.ip), sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
-		        scap_dump_write(d, &(fdi->info.ipv6serverinfo.port), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        scap_dump_write(d, &(fdi->info.ipv6serverinfo.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
-		{
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi8)");
-		}
-		break;
-	case SCAP_FD_UNIX_SOCK:
-		if(scap_dump_write(d, &(fdi->info.unix_socket_info.source), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		        scap_dump_write(d, &(fdi->info.unix_socket_info.destination), sizeof(uint64_t)) != sizeof(uint64_t))
-		{
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi4)");
-			return SCAP_FAILURE;
-		}
-		stlen = (uint16_t)strnlen(fdi->info.unix_socket_info.fname, SCAP_MAX_PATH_SIZE);
-		if(scap_dump_write(d, &stlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        (stlen > 0 && scap_dump_write(d, fdi->info.unix_socket_info.fname, stlen) != stlen))
+		return scap_dump_stream_tell(d->m_stream);
+	}
+	return gztell(d->m_f);
+}
+
+#ifndef _WIN32
+//
+// Asynchronous writes, see scap_dump_enable_async(). The buffers form a
+// ring: the writer thread writes them in order starting from m_tail, and
+// the one after the m_nqueued full ones is being filled by the dumper.
+//
+struct scap_dump_async
+{
+	scap_dumper_t* m_dumper;
+	pthread_t m_thread;
+	pthread_mutex_t m_lock;
+	pthread_cond_t m_full_cond; // Signaled when a buffer is queued
+	pthread_cond_t m_free_cond; // Signaled when a buffer is written
+	uint8_t** m_bufs;
+	uint32_t* m_lens;
+	uint32_t m_nbufs;
+	uint32_t m_bufsize;
+	bool m_stop;
+
+	// Protected by m_lock
+	uint32_t m_tail;
+	uint32_t m_nqueued;
+	bool m_failed;
+	int64_t m_offset; // File offset after the last written buffer
+
+	// Only used by the dumping thread
+	bool m_no_drop; // Wait for a free buffer rather than dropping events
+	uint32_t m_cur; // Buffer being filled
+	bool m_failed_seen; // m_failed, as of the last buffer switch
+	uint64_t m_base_tell; // Position in the file when the writes became async
+	uint64_t m_accepted; // Bytes accepted since then
+};
+
+static void* scap_dump_async_run(void* arg)
+{
+	struct scap_dump_async* a = (struct scap_dump_async*)arg;
+
+	pthread_mutex_lock(&a->m_lock);
+	while(true)
+	{
+		while(a->m_nqueued == 0 && !a->m_stop)
 		{
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi5)");
-			return SCAP_FAILURE;
+			pthread_cond_wait(&a->m_full_cond, &a->m_lock);
 		}
-		break;
-	case SCAP_FD_FILE_V2:
-		if(scap_dump_write(d, &(fdi->info.regularinfo.open_flags), sizeof(uint32_t)) != sizeof(uint32_t))
+		if(a->m_nqueued == 0)
 		{
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi1)");
-			return SCAP_FAILURE;
+			// Stopped, with everything written
+			break;
 		}
-		stlen = (uint16_t)strnlen(fdi->info.regularinfo.fname, SCAP_MAX_PATH_SIZE);
-		if(scap_dump_write(d, &stlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-			(stlen > 0 && scap_dump_write(d, fdi->info.regularinfo.fname, stlen) != stlen))
+
+		uint32_t idx = a->m_tail;
+		bool failed = a->m_failed;
+		pthread_mutex_unlock(&a->m_lock);
+
+		// After a failure, the rest of the data is discarded
+		int64_t offset = -1;
+		if(!failed && scap_dump_write_file(a->m_dumper, a->m_bufs[idx], a->m_lens[idx]) == (int)a->m_lens[idx])
 		{
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi1)");
-			return SCAP_FAILURE;
+			offset = scap_dump_file_offset(a->m_dumper);
 		}
-		if(scap_dump_write(d, &(fdi->info.regularinfo.dev), sizeof(uint32_t)) != sizeof(uint32_t))
+
+		pthread_mutex_lock(&a->m_lock);
+		if(offset < 0)
 		{
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (dev)");
-			return SCAP_FAILURE;
+			a->m_failed = true;
 		}
-		break;
-	case SCAP_FD_FIFO:
-	case SCAP_FD_FILE:
-	case SCAP_FD_DIRECTORY:
-	case SCAP_FD_UNSUPPORTED:
-	case SCAP_FD_EVENT:
-	case SCAP_FD_SIGNALFD:
-	case SCAP_FD_EVENTPOLL:
-	case SCAP_FD_INOTIFY:
-	case SCAP_FD_TIMERFD:
-	case SCAP_FD_NETLINK:
-	case SCAP_FD_BPF:
-	case SCAP_FD_USERFAULTFD:
-	case SCAP_FD_IOURING:
-		stlen = (uint16_t)strnlen(fdi->info.fname, SCAP_MAX_PATH_SIZE);
-		if(scap_dump_write(d, &stlen,  sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        (stlen > 0 && scap_dump_write(d, fdi->info.fname, stlen) != stlen))
+		else
 		{
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi6)");
-			return SCAP_FAILURE;
+			a->m_offset = offset;
 		}
-		break;
-	case SCAP_FD_UNKNOWN:
-		// Ignore UNKNOWN fds without failing
-		ASSERT(false);
-		break;
-	default:
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "Unknown fdi type %d", fdi->type);
-		ASSERT(false);
-		return SCAP_FAILURE;
+		a->m_lens[idx] = 0;
+		a->m_tail = (a->m_tail + 1) % a->m_nbufs;
+		a->m_nqueued--;
+		pthread_cond_broadcast(&a->m_free_cond);
 	}
-
-	return SCAP_SUCCESS;
+	pthread_mutex_unlock(&a->m_lock);
+	return NULL;
 }
 
-int32_t scap_write_proc_fds(scap_dumper_t *d, struct scap_threadinfo *tinfo)
+//
+// Queue the buffer being filled. If wait is false and no buffer would
+// be left to fill, nothing is queued and false is returned.
+//
+static bool scap_dump_async_submit(struct scap_dump_async* a, bool wait)
 {
-	block_header bh;
-	uint32_t bt;
-	uint32_t totlen = sizeof(tinfo->tid);  // This includes the tid
-	uint32_t idx = 0;
-	struct scap_fdinfo *fdi;
-	struct scap_fdinfo *tfdi;
-
-	uint32_t* lengths = calloc(HASH_COUNT(tinfo->fdlist), sizeof(uint32_t));
-	if(lengths == NULL)
+	pthread_mutex_lock(&a->m_lock);
+	if(!wait && a->m_nqueued + 1 >= a->m_nbufs)
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "scap_write_proc_fds memory allocation failure");
-		return SCAP_FAILURE;
+		pthread_mutex_unlock(&a->m_lock);
+		return false;
 	}
 
-	//
-	// First pass of the table to calculate the lengths
-	//
-	HASH_ITER(hh, tinfo->fdlist, fdi, tfdi)
+	a->m_nqueued++;
+	pthread_cond_signal(&a->m_full_cond);
+	while(a->m_nqueued == a->m_nbufs)
 	{
-		if(fdi->type != SCAP_FD_UNINITIALIZED &&
-		   fdi->type != SCAP_FD_UNKNOWN)
-		{
-			uint32_t fl = scap_fd_info_len(fdi);
-			lengths[idx++] = fl;
-			totlen += fl;
-		}
+		pthread_cond_wait(&a->m_free_cond, &a->m_lock);
 	}
-	idx = 0;
+	a->m_failed_seen = a->m_failed;
+	pthread_mutex_unlock(&a->m_lock);
 
-	//
-	// Create the block
-	//
-	bh.block_type = FDL_BLOCK_TYPE_V2;
-	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + totlen + 4);
+	a->m_cur = (a->m_cur + 1) % a->m_nbufs;
+	return true;
+}
 
-	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh))
-	{
-		free(lengths);
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fd1)");
-		return SCAP_FAILURE;
-	}
+static int scap_dump_async_write(struct scap_dump_async* a, void* buf, unsigned len)
+{
+	const uint8_t* src = (const uint8_t*)buf;
+	unsigned left = len;
 
-	//
-	// Write the tid
-	//
-	if(scap_dump_write(d, &tinfo->tid, sizeof(tinfo->tid)) != sizeof(tinfo->tid))
+	if(a->m_failed_seen)
 	{
-		free(lengths);
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fd2)");
-		return SCAP_FAILURE;
+		return -1;
 	}
 
-	//
-	// Second pass of the table to dump it
-	//
-	HASH_ITER(hh, tinfo->fdlist, fdi, tfdi)
+	while(left > 0)
 	{
-		if(fdi->type != SCAP_FD_UNINITIALIZED && fdi->type != SCAP_FD_UNKNOWN)
+		uint32_t n = a->m_bufsize - a->m_lens[a->m_cur];
+		if(n == 0)
 		{
-			if(scap_fd_write_to_disk(d, fdi, lengths[idx++]) != SCAP_SUCCESS)
-			{
-				free(lengths);
-				return SCAP_FAILURE;
-			}
+			scap_dump_async_submit(a, true);
+			continue;
+		}
+		if(n > left)
+		{
+			n = left;
 		}
+		memcpy(a->m_bufs[a->m_cur] + a->m_lens[a->m_cur], src, n);
+		a->m_lens[a->m_cur] += n;
+		src += n;
+		left -= n;
 	}
 
-	free(lengths);
+	a->m_accepted += len;
+	return len;
+}
 
-	//
-	// Add the padding
-	//
-	if(scap_write_padding(d, totlen) != SCAP_SUCCESS)
+//
+// Make room for len bytes in the buffer being filled, without waiting
+// for the writer thread. Returns false if there's no room.
+//
+static bool scap_dump_async_reserve(struct scap_dump_async* a, uint32_t len)
+{
+	if(a->m_bufsize - a->m_lens[a->m_cur] >= len || len > a->m_bufsize)
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fd3)");
-		return SCAP_FAILURE;
+		// Events bigger than a buffer are written waiting
+		return true;
 	}
+	return scap_dump_async_submit(a, false);
+}
 
-	//
-	// Create the trailer
-	//
-	bt = bh.block_total_length;
-	if(scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+//
+// Wait until all the queued data is written. The writer thread is idle
+// when this returns, so the file can be used directly.
+//
+static bool scap_dump_async_drain(struct scap_dump_async* a)
+{
+	if(a->m_lens[a->m_cur] > 0)
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fd4)");
-		return SCAP_FAILURE;
+		scap_dump_async_submit(a, true);
 	}
 
-	return SCAP_SUCCESS;
+	pthread_mutex_lock(&a->m_lock);
+	while(a->m_nqueued > 0)
+	{
+		pthread_cond_wait(&a->m_free_cond, &a->m_lock);
+	}
+	a->m_failed_seen = a->m_failed;
+	pthread_mutex_unlock(&a->m_lock);
+	return !a->m_failed_seen;
 }
 
-//
-// Write the fd list blocks
-//
-static int32_t scap_write_fdlist(scap_dumper_t *d, struct scap_proclist *proclist)
+static void scap_dump_async_free(struct scap_dump_async* a, bool started)
 {
-	struct scap_threadinfo *tinfo;
-	struct scap_threadinfo *ttinfo;
-	int32_t res;
-
-	HASH_ITER(hh, proclist->m_proclist, tinfo, ttinfo)
+	if(started)
 	{
-		if(!tinfo->filtered_out)
-		{
-			res = scap_write_proc_fds(d, tinfo);
-			if(res != SCAP_SUCCESS)
-			{
-				return res;
-			}
-		}
+		pthread_mutex_lock(&a->m_lock);
+		a->m_stop = true;
+		pthread_cond_signal(&a->m_full_cond);
+		pthread_mutex_unlock(&a->m_lock);
+		pthread_join(a->m_thread, NULL);
 	}
 
-	return SCAP_SUCCESS;
+	for(uint32_t i = 0; i < a->m_nbufs; i++)
+	{
+		free(a->m_bufs[i]);
+	}
+	free(a->m_bufs);
+	free(a->m_lens);
+	pthread_cond_destroy(&a->m_free_cond);
+	pthread_cond_destroy(&a->m_full_cond);
+	pthread_mutex_destroy(&a->m_lock);
+	free(a);
 }
 
 //
-// Since the process list isn't thread-safe, we at least reduce the
-// time window and write everything at once with a secondary dumper.
-// By doing so, the likelihood of having a wrong total length is lower.
+// Write everything and go back to synchronous writes
 //
-scap_dumper_t *scap_write_proclist_begin()
+static bool scap_dump_async_stop(scap_dumper_t *d)
 {
-	return scap_managedbuf_dump_create();
+	bool res = scap_dump_async_drain(d->m_async);
+	scap_dump_async_free(d->m_async, true);
+	d->m_async = NULL;
+	return res;
 }
+#endif
 
 //
-// Write the process list block
+// Write data into a dump file
 //
-static int32_t scap_write_proclist_header(scap_dumper_t *d, uint32_t totlen)
+static int scap_dump_write(scap_dumper_t *d, void* buf, unsigned len)
 {
-	block_header bh;
-
-	//
-	// Create the block header
-	//
-	bh.block_type = PL_BLOCK_TYPE_V9;
-	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + totlen + 4);
-
-	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh))
+	if(d->m_type == DT_FILE)
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (1)");
-		return SCAP_FAILURE;
+#ifndef _WIN32
+		if(d->m_async != NULL)
+		{
+			return scap_dump_async_write(d->m_async, buf, len);
+		}
+#endif
+		return scap_dump_write_file(d, buf, len);
 	}
+	else
+	{
+		if(d->m_targetbufcurpos + len >= d->m_targetbufend)
+		{
+			if(d->m_type == DT_MEM)
+			{
+				return -1;
+			}
 
-	return SCAP_SUCCESS;
-}
-
-//
-// Write the process list block
-//
-static int32_t scap_write_proclist_trailer(scap_dumper_t *d, uint32_t totlen)
-{
-	block_header bh;
-	uint32_t bt;
+			// DT_MANAGED_BUF, try to increase the size
+			size_t offset = (d->m_targetbufcurpos - d->m_targetbuf);
+			size_t targetbufsize = PPM_DUMPER_MANAGED_BUF_RESIZE_FACTOR * (d->m_targetbufend - d->m_targetbuf);
+			if(targetbufsize <= offset + len)
+			{
+				targetbufsize = offset + len + 1;
+			}
 
-	bh.block_type = PL_BLOCK_TYPE_V9;
+			// On failure the buffer is left as is, scap_dump_close() frees it
+			uint8_t *targetbuf = (uint8_t *)realloc(
+				d->m_targetbuf,
+				targetbufsize);
+			if(targetbuf == NULL)
+			{
+				return -1;
+			}
+
+			d->m_targetbuf = targetbuf;
+			d->m_targetbufcurpos = targetbuf + offset;
+			d->m_targetbufend = targetbuf + targetbufsize;
+		}
+
+		memcpy(d->m_targetbufcurpos, buf, len);
+
+		d->m_targetbufcurpos += len;
+		return len;
+	}
+}
+
+static int scap_dump_writev(scap_dumper_t *d, const struct iovec *iov, int iovcnt)
+{
+	unsigned totlen = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+	{
+		if(scap_dump_write(d, iov[i].iov_base, iov[i].iov_len) < 0)
+		{
+			return -1;
+		}
+
+		totlen += iov[i].iov_len;
+	}
+
+	return totlen;
+}
+
+static void scap_dump_reset_index(scap_dumper_t *d)
+{
+	d->m_index_interval = 0;
+	d->m_index_next_offset = 0;
+	d->m_index = NULL;
+	d->m_index_len = 0;
+	d->m_index_size = 0;
+}
+
+static void scap_dump_reset_checkpoints(scap_dumper_t *d)
+{
+	d->m_ckpts = NULL;
+	d->m_ckpts_len = 0;
+	d->m_ckpts_size = 0;
+}
+
+uint8_t* scap_get_memorydumper_curpos(scap_dumper_t *d)
+{
+	return d->m_targetbufcurpos;
+}
+
+#ifndef _WIN32
+static inline uint32_t scap_normalize_block_len(uint32_t blocklen)
+#else
+static uint32_t scap_normalize_block_len(uint32_t blocklen)
+#endif
+{
+	return ((blocklen + 3) >> 2) << 2;
+}
+
+static int32_t scap_write_padding(scap_dumper_t *d, uint32_t blocklen)
+{
+	int32_t val = 0;
+	uint32_t bytestowrite = scap_normalize_block_len(blocklen) - blocklen;
+
+	if(scap_dump_write(d, &val, bytestowrite) == bytestowrite)
+	{
+		return SCAP_SUCCESS;
+	}
+	else
+	{
+		return SCAP_FAILURE;
+	}
+}
+
+//
+// Calculate the length on disk of an fd entry's info
+//
+static uint32_t scap_fd_info_len(scap_fdinfo *fdi)
+{
+	//
+	// NB: new fields must be appended
+	//
+
+	uint32_t res = sizeof(uint32_t) + sizeof(fdi->ino) + 1 + sizeof(fdi->fd);
+
+	switch(fdi->type)
+	{
+	case SCAP_FD_IPV4_SOCK:
+		res +=  4 +     // sip
+		        4 +     // dip
+		        2 +     // sport
+		        2 +     // dport
+		        1;      // l4proto
+		break;
+	case SCAP_FD_IPV4_SERVSOCK:
+		res +=  4 +     // ip
+		        2 +     // port
+		        1;      // l4proto
+		break;
+	case SCAP_FD_IPV6_SOCK:
+		res += 	sizeof(uint32_t) * 4 + // sip
+				sizeof(uint32_t) * 4 + // dip
+				sizeof(uint16_t) + // sport
+				sizeof(uint16_t) + // dport
+				sizeof(uint8_t); // l4proto
+		break;
+	case SCAP_FD_IPV6_SERVSOCK:
+		res += 	sizeof(uint32_t) * 4 + // ip
+				sizeof(uint16_t) + // port
+				sizeof(uint8_t); // l4proto
+		break;
+	case SCAP_FD_UNIX_SOCK:
+		res +=
+			sizeof(uint64_t) + // unix source
+			sizeof(uint64_t) +  // unix destination
+			(uint32_t)strnlen(fdi->info.unix_socket_info.fname, SCAP_MAX_PATH_SIZE) + 2;
+		break;
+	case SCAP_FD_FILE_V2:
+		res += sizeof(uint32_t) + // open_flags
+			(uint32_t)strnlen(fdi->info.regularinfo.fname, SCAP_MAX_PATH_SIZE) + 2 +
+			sizeof(uint32_t); // dev
+		break;
+	case SCAP_FD_FIFO:
+	case SCAP_FD_FILE:
+	case SCAP_FD_DIRECTORY:
+	case SCAP_FD_UNSUPPORTED:
+	case SCAP_FD_EVENT:
+	case SCAP_FD_SIGNALFD:
+	case SCAP_FD_EVENTPOLL:
+	case SCAP_FD_INOTIFY:
+	case SCAP_FD_TIMERFD:
+	case SCAP_FD_NETLINK:
+	case SCAP_FD_BPF:
+	case SCAP_FD_USERFAULTFD:
+	case SCAP_FD_IOURING:
+		res += (uint32_t)strnlen(fdi->info.fname, SCAP_MAX_PATH_SIZE) + 2;    // 2 is the length field before the string
+		break;
+	default:
+		ASSERT(false);
+		break;
+	}
+
+	return res;
+}
+
+//
+// Write the given fd info to disk
+//
+static int32_t scap_fd_write_to_disk(scap_dumper_t *d, scap_fdinfo *fdi, uint32_t len)
+{
+
+	uint8_t type = (uint8_t)fdi->type;
+	uint16_t stlen;
+	if(scap_dump_write(d, &(len), sizeof(uint32_t)) != sizeof(uint32_t) ||
+	        scap_dump_write(d, &(fdi->fd), sizeof(uint64_t)) != sizeof(uint64_t) ||
+	        scap_dump_write(d, &(fdi->ino), sizeof(uint64_t)) != sizeof(uint64_t) ||
+	        scap_dump_write(d, &(type), sizeof(uint8_t)) != sizeof(uint8_t))
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi1)");
+		return SCAP_FAILURE;
+	}
+
+	switch(fdi->type)
+	{
+	case SCAP_FD_IPV4_SOCK:
+		if(scap_dump_write(d, &(fdi->info.ipv4info.sip), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		        scap_dump_write(d, &(fdi->info.ipv4info.dip), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		        scap_dump_write(d, &(fdi->info.ipv4info.sport), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        scap_dump_write(d, &(fdi->info.ipv4info.dport), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        scap_dump_write(d, &(fdi->info.ipv4info.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi2)");
+			return SCAP_FAILURE;
+		}
+		break;
+	case SCAP_FD_IPV4_SERVSOCK:
+		if(scap_dump_write(d, &(fdi->info.ipv4serverinfo.ip), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		        scap_dump_write(d, &(fdi->info.ipv4serverinfo.port), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        scap_dump_write(d, &(fdi->info.ipv4serverinfo.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi3)");
+			return SCAP_FAILURE;
+		}
+		break;
+	case SCAP_FD_IPV6_SOCK:
+		if(scap_dump_write(d, (char*)fdi->info.ipv6info.sip, sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
+		        scap_dump_write(d, (char*)fdi->info.ipv6info.dip, sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
+		        scap_dump_write(d, &(fdi->info.ipv6info.sport), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        scap_dump_write(d, &(fdi->info.ipv6info.dport), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        scap_dump_write(d, &(fdi->info.ipv6info.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi7)");
+		}
+		break;
+	case SCAP_FD_IPV6_SERVSOCK:
+		if(scap_dump_write(d, &(fdi->info.ipv6serverinfo.ip), sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
+		        scap_dump_write(d, &(fdi->info.ipv6serverinfo.port), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        scap_dump_write(d, &(fdi->info.ipv6serverinfo.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi8)");
+		}
+		break;
+	case SCAP_FD_UNIX_SOCK:
+		if(scap_dump_write(d, &(fdi->info.unix_socket_info.source), sizeof(uint64_t)) != sizeof(uint64_t) ||
+		        scap_dump_write(d, &(fdi->info.unix_socket_info.destination), sizeof(uint64_t)) != sizeof(uint64_t))
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi4)");
+			return SCAP_FAILURE;
+		}
+		stlen = (uint16_t)strnlen(fdi->info.unix_socket_info.fname, SCAP_MAX_PATH_SIZE);
+		if(scap_dump_write(d, &stlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        (stlen > 0 && scap_dump_write(d, fdi->info.unix_socket_info.fname, stlen) != stlen))
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi5)");
+			return SCAP_FAILURE;
+		}
+		break;
+	case SCAP_FD_FILE_V2:
+		if(scap_dump_write(d, &(fdi->info.regularinfo.open_flags), sizeof(uint32_t)) != sizeof(uint32_t))
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi1)");
+			return SCAP_FAILURE;
+		}
+		stlen = (uint16_t)strnlen(fdi->info.regularinfo.fname, SCAP_MAX_PATH_SIZE);
+		if(scap_dump_write(d, &stlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+			(stlen > 0 && scap_dump_write(d, fdi->info.regularinfo.fname, stlen) != stlen))
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi1)");
+			return SCAP_FAILURE;
+		}
+		if(scap_dump_write(d, &(fdi->info.regularinfo.dev), sizeof(uint32_t)) != sizeof(uint32_t))
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (dev)");
+			return SCAP_FAILURE;
+		}
+		break;
+	case SCAP_FD_FIFO:
+	case SCAP_FD_FILE:
+	case SCAP_FD_DIRECTORY:
+	case SCAP_FD_UNSUPPORTED:
+	case SCAP_FD_EVENT:
+	case SCAP_FD_SIGNALFD:
+	case SCAP_FD_EVENTPOLL:
+	case SCAP_FD_INOTIFY:
+	case SCAP_FD_TIMERFD:
+	case SCAP_FD_NETLINK:
+	case SCAP_FD_BPF:
+	case SCAP_FD_USERFAULTFD:
+	case SCAP_FD_IOURING:
+		stlen = (uint16_t)strnlen(fdi->info.fname, SCAP_MAX_PATH_SIZE);
+		if(scap_dump_write(d, &stlen,  sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        (stlen > 0 && scap_dump_write(d, fdi->info.fname, stlen) != stlen))
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi6)");
+			return SCAP_FAILURE;
+		}
+		break;
+	case SCAP_FD_UNKNOWN:
+		// Ignore UNKNOWN fds without failing
+		ASSERT(false);
+		break;
+	default:
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "Unknown fdi type %d", fdi->type);
+		ASSERT(false);
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+int32_t scap_write_proc_fds(scap_dumper_t *d, struct scap_threadinfo *tinfo)
+{
+	block_header bh;
+	uint32_t bt;
+	uint32_t totlen = sizeof(tinfo->tid);  // This includes the tid
+	uint32_t idx = 0;
+	struct scap_fdinfo *fdi;
+	struct scap_fdinfo *tfdi;
+
+	uint32_t* lengths = calloc(HASH_COUNT(tinfo->fdlist), sizeof(uint32_t));
+	if(lengths == NULL)
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "scap_write_proc_fds memory allocation failure");
+		return SCAP_FAILURE;
+	}
+
+	//
+	// First pass of the table to calculate the lengths
+	//
+	HASH_ITER(hh, tinfo->fdlist, fdi, tfdi)
+	{
+		if(fdi->type != SCAP_FD_UNINITIALIZED &&
+		   fdi->type != SCAP_FD_UNKNOWN)
+		{
+			uint32_t fl = scap_fd_info_len(fdi);
+			lengths[idx++] = fl;
+			totlen += fl;
+		}
+	}
+	idx = 0;
+
+	//
+	// Create the block
+	//
+	bh.block_type = FDL_BLOCK_TYPE_V2;
+	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + totlen + 4);
+
+	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh))
+	{
+		free(lengths);
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fd1)");
+		return SCAP_FAILURE;
+	}
+
+	//
+	// Write the tid
+	//
+	if(scap_dump_write(d, &tinfo->tid, sizeof(tinfo->tid)) != sizeof(tinfo->tid))
+	{
+		free(lengths);
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fd2)");
+		return SCAP_FAILURE;
+	}
+
+	//
+	// Second pass of the table to dump it
+	//
+	HASH_ITER(hh, tinfo->fdlist, fdi, tfdi)
+	{
+		if(fdi->type != SCAP_FD_UNINITIALIZED && fdi->type != SCAP_FD_UNKNOWN)
+		{
+			if(scap_fd_write_to_disk(d, fdi, lengths[idx++]) != SCAP_SUCCESS)
+			{
+				free(lengths);
+				return SCAP_FAILURE;
+			}
+		}
+	}
+
+	free(lengths);
+
+	//
+	// Add the padding
+	//
+	if(scap_write_padding(d, totlen) != SCAP_SUCCESS)
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fd3)");
+		return SCAP_FAILURE;
+	}
+
+	//
+	// Create the trailer
+	//
+	bt = bh.block_total_length;
+	if(scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fd4)");
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Since the process list isn't thread-safe, we at least reduce the
+// time window and write everything at once with a secondary dumper.
+// By doing so, the likelihood of having a wrong total length is lower.
+//
+scap_dumper_t *scap_write_proclist_begin()
+{
+	return scap_managedbuf_dump_create();
+}
+
+//
+// Write the process list block
+//
+static int32_t scap_write_proclist_header(scap_dumper_t *d, uint32_t totlen)
+{
+	block_header bh;
+
+	//
+	// Create the block header
+	//
+	bh.block_type = PL_BLOCK_TYPE_V9;
+	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + totlen + 4);
+
+	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh))
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (1)");
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Write the process list block
+//
+static int32_t scap_write_proclist_trailer(scap_dumper_t *d, uint32_t totlen)
+{
+	block_header bh;
+	uint32_t bt;
+
+	bh.block_type = PL_BLOCK_TYPE_V9;
+	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + totlen + 4);
+
+	//
+	// Blocks need to be 4-byte padded
+	//
+	if(scap_write_padding(d, totlen) != SCAP_SUCCESS)
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (3)");
+		return SCAP_FAILURE;
+	}
+
+	//
+	// Create the trailer
+	//
+	bt = bh.block_total_length;
+	if(scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (4)");
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+int scap_write_proclist_end(scap_dumper_t *d, scap_dumper_t *proclist_dumper, uint32_t totlen)
+{
+	ASSERT(proclist_dumper != NULL);
+	ASSERT(proclist_dumper->m_type == DT_MANAGED_BUF);
+
+	int res = SCAP_SUCCESS;
+
+	do
+	{
+		scap_dump_flush(proclist_dumper);
+
+		if(scap_write_proclist_header(d, totlen) != SCAP_SUCCESS)
+		{
+			res = SCAP_FAILURE;
+			break;
+		}
+		if(scap_dump_write(d, proclist_dumper->m_targetbuf, totlen) <= 0)
+		{
+			res = SCAP_FAILURE;
+			break;
+		}
+		if(scap_write_proclist_trailer(d, totlen) != SCAP_SUCCESS)
+		{
+			res = SCAP_FAILURE;
+			break;
+		}
+	} while(false);
+
+	scap_dump_close(proclist_dumper);
+
+	return res;
+}
+
+//
+// Write the process list block
+//
+static int32_t scap_write_proclist_entry(scap_dumper_t *d, struct scap_threadinfo *tinfo, uint32_t *len)
+{
+	struct iovec args = {tinfo->args, tinfo->args_len};
+	struct iovec env = {tinfo->env, tinfo->env_len};
+	struct iovec cgroups = {tinfo->cgroups, tinfo->cgroups_len};
+
+	return scap_write_proclist_entry_bufs(d, tinfo, len,
+					      tinfo->comm,
+					      tinfo->exe,
+					      tinfo->exepath,
+					      &args, 1,
+					      &env, 1,
+					      tinfo->cwd,
+					      &cgroups, 1,
+					      tinfo->root);
+}
+
+static uint16_t iov_size(const struct iovec *iov, uint32_t iovcnt)
+{
+	uint16_t len = 0;
+	uint32_t i;
+
+	for (i = 0; i < iovcnt; i++)
+	{
+		len += iov[i].iov_len;
+	}
+
+	return len;
+}
+
+int32_t scap_write_proclist_entry_bufs(scap_dumper_t *d, struct scap_threadinfo *tinfo, uint32_t *len,
+				       const char *comm,
+				       const char *exe,
+				       const char *exepath,
+				       const struct iovec *args, int argscnt,
+				       const struct iovec *envs, int envscnt,
+				       const char *cwd,
+				       const struct iovec *cgroups, int cgroupscnt,
+				       const char *root)
+{
+	uint16_t commlen;
+	uint16_t exelen;
+	uint16_t exepathlen;
+	uint16_t cwdlen;
+	uint16_t rootlen;
+	uint16_t argslen;
+	uint16_t envlen;
+	uint16_t cgroupslen;
+
+	commlen = (uint16_t)strnlen(comm, SCAP_MAX_PATH_SIZE);
+	exelen = (uint16_t)strnlen(exe, SCAP_MAX_PATH_SIZE);
+	exepathlen = (uint16_t)strnlen(exepath, SCAP_MAX_PATH_SIZE);
+	cwdlen = (uint16_t)strnlen(cwd, SCAP_MAX_PATH_SIZE);
+	rootlen = (uint16_t)strnlen(root, SCAP_MAX_PATH_SIZE);
+
+	argslen = iov_size(args, argscnt);
+	envlen = iov_size(envs, envscnt);
+	cgroupslen = iov_size(cgroups, cgroupscnt);
+
+	//
+	// NB: new fields must be appended
+	//
+	*len = (uint32_t)(sizeof(uint32_t) + // len
+			  sizeof(uint64_t) + // tid
+			  sizeof(uint64_t) + // pid
+			  sizeof(uint64_t) + // ptid
+			  sizeof(uint64_t) + // sid
+			  sizeof(uint64_t) + // vpgid
+			  2 + commlen +
+			  2 + exelen +
+			  2 + exepathlen +
+			  2 + argslen +
+			  2 + cwdlen +
+			  sizeof(uint64_t) + // fdlimit
+			  sizeof(uint32_t) + // flags
+			  sizeof(uint32_t) + // uid
+			  sizeof(uint32_t) + // gid
+			  sizeof(uint32_t) + // vmsize_kb
+			  sizeof(uint32_t) + // vmrss_kb
+			  sizeof(uint32_t) + // vmswap_kb
+			  sizeof(uint64_t) + // pfmajor
+			  sizeof(uint64_t) + // pfminor
+			  2 + envlen +
+			  sizeof(int64_t) + // vtid
+			  sizeof(int64_t) + // vpid
+			  2 + cgroupslen +
+			  2 + rootlen +
+			  sizeof(uint64_t) + // pidns_init_start_ts
+			  sizeof(int32_t) +  // tty
+			  sizeof(int32_t) +  // loginuid
+			  sizeof(uint8_t) +  // exe_writable
+			  sizeof(uint64_t) + // cap_inheritable
+			  sizeof(uint64_t) + // cap_permitted
+			  sizeof(uint64_t) + // cap_effective
+			  sizeof(uint8_t) + // exe_upper_layer
+			  sizeof(uint64_t) + // exe_ino
+			  sizeof(uint64_t) + // exe_ino_ctime
+			  sizeof(uint64_t)); // exe_ino_mtime
+
+	if(scap_dump_write(d, len, sizeof(uint32_t)) != sizeof(uint32_t) ||
+		    scap_dump_write(d, &(tinfo->tid), sizeof(uint64_t)) != sizeof(uint64_t) ||
+		    scap_dump_write(d, &(tinfo->pid), sizeof(uint64_t)) != sizeof(uint64_t) ||
+		    scap_dump_write(d, &(tinfo->ptid), sizeof(uint64_t)) != sizeof(uint64_t) ||
+		    scap_dump_write(d, &(tinfo->sid), sizeof(uint64_t)) != sizeof(uint64_t) ||
+		    scap_dump_write(d, &(tinfo->vpgid), sizeof(uint64_t)) != sizeof(uint64_t) ||
+		    scap_dump_write(d, &commlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+                    scap_dump_write(d, (char *) comm, commlen) != commlen ||
+		    scap_dump_write(d, &exelen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+                    scap_dump_write(d, (char *) exe, exelen) != exelen ||
+                    scap_dump_write(d, &exepathlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+                    scap_dump_write(d, (char *) exepath, exepathlen) != exepathlen ||
+		    scap_dump_write(d, &argslen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+                    scap_dump_writev(d, args, argscnt) != argslen ||
+		    scap_dump_write(d, &cwdlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+                    scap_dump_write(d, (char *) cwd, cwdlen) != cwdlen ||
+		    scap_dump_write(d, &(tinfo->fdlimit), sizeof(uint64_t)) != sizeof(uint64_t) ||
+		    scap_dump_write(d, &(tinfo->flags), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		    scap_dump_write(d, &(tinfo->uid), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		    scap_dump_write(d, &(tinfo->gid), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		    scap_dump_write(d, &(tinfo->vmsize_kb), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		    scap_dump_write(d, &(tinfo->vmrss_kb), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		    scap_dump_write(d, &(tinfo->vmswap_kb), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		    scap_dump_write(d, &(tinfo->pfmajor), sizeof(uint64_t)) != sizeof(uint64_t) ||
+		    scap_dump_write(d, &(tinfo->pfminor), sizeof(uint64_t)) != sizeof(uint64_t) ||
+		    scap_dump_write(d, &envlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+                    scap_dump_writev(d, envs, envscnt) != envlen ||
+		    scap_dump_write(d, &(tinfo->vtid), sizeof(int64_t)) != sizeof(int64_t) ||
+		    scap_dump_write(d, &(tinfo->vpid), sizeof(int64_t)) != sizeof(int64_t) ||
+		    scap_dump_write(d, &(cgroupslen), sizeof(uint16_t)) != sizeof(uint16_t) ||
+                    scap_dump_writev(d, cgroups, cgroupscnt) != cgroupslen ||
+		    scap_dump_write(d, &rootlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+                    scap_dump_write(d, (char *) root, rootlen) != rootlen ||
+			scap_dump_write(d, &(tinfo->pidns_init_start_ts), sizeof(uint64_t)) != sizeof(uint64_t) ||
+			scap_dump_write(d, &(tinfo->tty), sizeof(int32_t)) != sizeof(int32_t) ||
+            scap_dump_write(d, &(tinfo->loginuid), sizeof(uint32_t)) != sizeof(uint32_t) ||
+			scap_dump_write(d, &(tinfo->exe_writable), sizeof(uint8_t)) != sizeof(uint8_t) ||
+			scap_dump_write(d, &(tinfo->cap_inheritable), sizeof(uint64_t)) != sizeof(uint64_t) ||
+			scap_dump_write(d, &(tinfo->cap_permitted), sizeof(uint64_t)) != sizeof(uint64_t) ||
+			scap_dump_write(d, &(tinfo->cap_effective), sizeof(uint64_t)) != sizeof(uint64_t) || 
+			scap_dump_write(d, &(tinfo->exe_upper_layer), sizeof(uint8_t)) != sizeof(uint8_t) ||
+			scap_dump_write(d, &(tinfo->exe_ino), sizeof(uint64_t)) != sizeof(uint64_t) ||
+			scap_dump_write(d, &(tinfo->exe_ino_ctime), sizeof(uint64_t)) != sizeof(uint64_t) ||
+			scap_dump_write(d, &(tinfo->exe_ino_mtime), sizeof(uint64_t)) != sizeof(uint64_t))
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (2)");
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// The process list and the fd lists are serialized in memory, by up to
+// SCAP_DUMP_STATE_MAX_WORKERS threads that take each a contiguous range
+// of the processes, and the buffers are then written in order with a
+// single write each. The output is the same as with a serial dump.
+//
+#define SCAP_DUMP_STATE_MAX_WORKERS 8
+// Below this many processes per worker, threads are not worth starting
+#define SCAP_DUMP_STATE_MIN_PER_WORKER 256
+
+struct scap_dump_state_worker
+{
+	struct scap_threadinfo** m_tinfos;
+	uint32_t m_ntinfos;
+	bool m_fds; // Fd list blocks rather than process list entries
+	scap_dumper_t* m_buf;
+	uint32_t m_len; // Total length of the process list entries
+	int32_t m_res;
+#ifndef _WIN32
+	pthread_t m_thread;
+	bool m_started;
+#endif
+};
+
+static void* scap_dump_state_worker_run(void* arg)
+{
+	struct scap_dump_state_worker* w = (struct scap_dump_state_worker*)arg;
+
+	for(uint32_t i = 0; i < w->m_ntinfos && w->m_res == SCAP_SUCCESS; i++)
+	{
+		if(w->m_fds)
+		{
+			w->m_res = scap_write_proc_fds(w->m_buf, w->m_tinfos[i]);
+		}
+		else
+		{
+			uint32_t len = 0;
+			w->m_res = scap_write_proclist_entry(w->m_buf, w->m_tinfos[i], &len);
+			w->m_len += len;
+		}
+	}
+
+	return NULL;
+}
+
+static uint32_t scap_dump_state_nworkers(uint32_t ntinfos)
+{
+	uint32_t nworkers = 1;
+#ifndef _WIN32
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	nworkers = ntinfos / SCAP_DUMP_STATE_MIN_PER_WORKER;
+	if(ncpus > 0 && nworkers > (uint32_t)ncpus)
+	{
+		nworkers = (uint32_t)ncpus;
+	}
+	if(nworkers > SCAP_DUMP_STATE_MAX_WORKERS)
+	{
+		nworkers = SCAP_DUMP_STATE_MAX_WORKERS;
+	}
+	if(nworkers == 0)
+	{
+		nworkers = 1;
+	}
+#endif
+	return nworkers;
+}
+
+//
+// Write the process list block (fds == false) or the fd list blocks
+//
+static int32_t scap_write_proc_state(scap_dumper_t *d, struct scap_proclist *proclist, bool fds)
+{
+	struct scap_threadinfo *tinfo;
+	struct scap_threadinfo *ttinfo;
+	struct scap_threadinfo **tinfos;
+	struct scap_dump_state_worker *workers;
+	uint32_t ntinfos = 0;
+	uint32_t nworkers;
+	uint32_t totlen = 0;
+	uint32_t j;
+	int32_t res = SCAP_SUCCESS;
+
+	//
+	// Exit immediately if the process list is empty
+	//
+	if(HASH_COUNT(proclist->m_proclist) == 0)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	tinfos = (struct scap_threadinfo **)malloc(HASH_COUNT(proclist->m_proclist) * sizeof(struct scap_threadinfo *));
+	if(tinfos == NULL)
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the process list");
+		return SCAP_FAILURE;
+	}
+
+	HASH_ITER(hh, proclist->m_proclist, tinfo, ttinfo)
+	{
+		if(!tinfo->filtered_out)
+		{
+			tinfos[ntinfos++] = tinfo;
+		}
+	}
+
+	if(ntinfos == 0)
+	{
+		free(tinfos);
+		return SCAP_SUCCESS;
+	}
+
+	nworkers = scap_dump_state_nworkers(ntinfos);
+	workers = (struct scap_dump_state_worker *)calloc(nworkers, sizeof(struct scap_dump_state_worker));
+	if(workers == NULL)
+	{
+		free(tinfos);
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the process list workers");
+		return SCAP_FAILURE;
+	}
+
+	for(j = 0; j < nworkers; j++)
+	{
+		struct scap_dump_state_worker *w = &workers[j];
+		uint32_t first = (uint32_t)((uint64_t)ntinfos * j / nworkers);
+
+		w->m_tinfos = tinfos + first;
+		w->m_ntinfos = (uint32_t)((uint64_t)ntinfos * (j + 1) / nworkers) - first;
+		w->m_fds = fds;
+		w->m_res = SCAP_SUCCESS;
+		w->m_buf = scap_managedbuf_dump_create();
+		if(w->m_buf == NULL || w->m_buf->m_targetbuf == NULL)
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the process list buffers");
+			res = SCAP_FAILURE;
+		}
+	}
+
+	//
+	// The calling thread takes the first range, or all of them if the
+	// threads can't be started
+	//
+	if(res == SCAP_SUCCESS)
+	{
+#ifndef _WIN32
+		for(j = 1; j < nworkers; j++)
+		{
+			workers[j].m_started = pthread_create(&workers[j].m_thread, NULL, scap_dump_state_worker_run, &workers[j]) == 0;
+		}
+#endif
+		for(j = 0; j < nworkers; j++)
+		{
+#ifndef _WIN32
+			if(workers[j].m_started)
+			{
+				continue;
+			}
+#endif
+			scap_dump_state_worker_run(&workers[j]);
+		}
+#ifndef _WIN32
+		for(j = 1; j < nworkers; j++)
+		{
+			if(workers[j].m_started)
+			{
+				pthread_join(workers[j].m_thread, NULL);
+			}
+		}
+#endif
+
+		for(j = 0; j < nworkers; j++)
+		{
+			if(workers[j].m_res != SCAP_SUCCESS)
+			{
+				strlcpy(d->m_lasterr, workers[j].m_buf->m_lasterr, SCAP_LASTERR_SIZE);
+				res = SCAP_FAILURE;
+				break;
+			}
+			totlen += workers[j].m_len;
+		}
+	}
+
+	if(res == SCAP_SUCCESS && !fds && scap_write_proclist_header(d, totlen) != SCAP_SUCCESS)
+	{
+		res = SCAP_FAILURE;
+	}
+
+	for(j = 0; j < nworkers && res == SCAP_SUCCESS; j++)
+	{
+		scap_dumper_t *buf = workers[j].m_buf;
+		unsigned len = (unsigned)(buf->m_targetbufcurpos - buf->m_targetbuf);
+
+		if(len > 0 && scap_dump_write(d, buf->m_targetbuf, len) != (int)len)
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (%s)", fds ? "fd5" : "2");
+			res = SCAP_FAILURE;
+		}
+	}
+
+	if(res == SCAP_SUCCESS && !fds && scap_write_proclist_trailer(d, totlen) != SCAP_SUCCESS)
+	{
+		res = SCAP_FAILURE;
+	}
+
+	for(j = 0; j < nworkers; j++)
+	{
+		if(workers[j].m_buf != NULL)
+		{
+			scap_dump_close(workers[j].m_buf);
+		}
+	}
+	free(workers);
+	free(tinfos);
+
+	return res;
+}
+
+//
+// Write the process list block
+//
+static int32_t scap_write_proclist(scap_dumper_t *d, struct scap_proclist *proclist)
+{
+	return scap_write_proc_state(d, proclist, false);
+}
+
+//
+// Write the fd list blocks
+//
+static int32_t scap_write_fdlist(scap_dumper_t *d, struct scap_proclist *proclist)
+{
+	return scap_write_proc_state(d, proclist, true);
+}
+
+//
+// Write the machine info block
+//
+static int32_t scap_write_machine_info(scap_dumper_t *d, scap_machine_info *machine_info)
+{
+	block_header bh;
+	uint32_t bt;
+
+	//
+	// Write the section header
+	//
+	bh.block_type = MI_BLOCK_TYPE;
+	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + sizeof(scap_machine_info) + 4);
+
+	bt = bh.block_total_length;
+
+	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh) ||
+	        scap_dump_write(d, machine_info, sizeof(*machine_info)) != sizeof(*machine_info) ||
+	        scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (MI1)");
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Write the interface list block
+//
+static int32_t scap_write_iflist(scap_dumper_t* d, scap_addrlist* addrlist)
+{
+	block_header bh;
+	uint32_t bt;
+	uint32_t entrylen;
+	uint32_t totlen = 0;
+	uint32_t j;
+
+	//
+	// Get the interface list
+	//
+	if(addrlist == NULL)
+	{
+		//
+		// This can happen when the event source is a capture that was generated by a plugin, no big deal
+		//
+		return SCAP_SUCCESS;
+	}
+
+	//
+	// Create the block
+	//
+	bh.block_type = IL_BLOCK_TYPE_V2;
+	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + (addrlist->n_v4_addrs + addrlist->n_v6_addrs)*sizeof(uint32_t) +
+							 addrlist->totlen + 4);
+
+	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh))
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF1)");
+		return SCAP_FAILURE;
+	}
+
+	//
+	// Dump the ipv4 list
+	//
+	for(j = 0; j < addrlist->n_v4_addrs; j++)
+	{
+		scap_ifinfo_ipv4 *entry = &(addrlist->v4list[j]);
+
+		entrylen = sizeof(scap_ifinfo_ipv4) + entry->ifnamelen - SCAP_MAX_PATH_SIZE;
+
+		if(scap_dump_write(d, &entrylen, sizeof(uint32_t)) != sizeof(uint32_t) ||
+		   scap_dump_write(d, &(entry->type), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		   scap_dump_write(d, &(entry->ifnamelen), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		   scap_dump_write(d, &(entry->addr), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		   scap_dump_write(d, &(entry->netmask), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		   scap_dump_write(d, &(entry->bcast), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		   scap_dump_write(d, &(entry->linkspeed), sizeof(uint64_t)) != sizeof(uint64_t) ||
+		   scap_dump_write(d, &(entry->ifname), entry->ifnamelen) != entry->ifnamelen)
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF2)");
+			return SCAP_FAILURE;
+		}
+
+		totlen += sizeof(uint32_t) + entrylen;
+	}
+
+	//
+	// Dump the ipv6 list
+	//
+	for(j = 0; j < addrlist->n_v6_addrs; j++)
+	{
+		scap_ifinfo_ipv6 *entry = &(addrlist->v6list[j]);
+
+		entrylen = sizeof(scap_ifinfo_ipv6) + entry->ifnamelen - SCAP_MAX_PATH_SIZE;
+
+		if(scap_dump_write(d, &entrylen, sizeof(uint32_t)) != sizeof(uint32_t) ||
+		   scap_dump_write(d, &(entry->type), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		   scap_dump_write(d, &(entry->ifnamelen), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		   scap_dump_write(d, &(entry->addr), SCAP_IPV6_ADDR_LEN) != SCAP_IPV6_ADDR_LEN ||
+		   scap_dump_write(d, &(entry->netmask), SCAP_IPV6_ADDR_LEN) != SCAP_IPV6_ADDR_LEN ||
+		   scap_dump_write(d, &(entry->bcast), SCAP_IPV6_ADDR_LEN) != SCAP_IPV6_ADDR_LEN ||
+		   scap_dump_write(d, &(entry->linkspeed), sizeof(uint64_t)) != sizeof(uint64_t) ||
+		   scap_dump_write(d, &(entry->ifname), entry->ifnamelen) != entry->ifnamelen)
+		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF2)");
+			return SCAP_FAILURE;
+		}
+
+		totlen += sizeof(uint32_t) + entrylen;
+	}
+
+	//
+	// Blocks need to be 4-byte padded
+	//
+	if(scap_write_padding(d, totlen) != SCAP_SUCCESS)
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF3)");
+		return SCAP_FAILURE;
+	}
+
+	//
+	// Create the trailer
+	//
+	bt = bh.block_total_length;
+	if(scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF4)");
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Write the user list block
+//
+static int32_t scap_write_userlist(scap_dumper_t* d, struct scap_userlist *userlist)
+{
+	block_header bh;
+	uint32_t bt;
+	uint32_t j;
+	uint16_t namelen;
+	uint16_t homedirlen;
+	uint16_t shelllen;
+	uint8_t type;
+	uint32_t totlen = 0;
+
+	//
+	// Make sure we have a user list interface list
+	//
+	if(userlist == NULL)
+	{
+		//
+		// This can happen when the event source is a capture that was generated by a plugin, no big deal
+		//
+		return SCAP_SUCCESS;
+	}
+
+	uint32_t* lengths = calloc(userlist->nusers + userlist->ngroups, sizeof(uint32_t));
+	if(lengths == NULL)
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "scap_write_userlist memory allocation failure (1)");
+		return SCAP_FAILURE;
+	}
+
+	//
+	// Calculate the lengths
+	//
+	for(j = 0; j < userlist->nusers; j++)
+	{
+		scap_userinfo* info = &userlist->users[j];
+
+		namelen = (uint16_t)strnlen(info->name, MAX_CREDENTIALS_STR_LEN);
+		homedirlen = (uint16_t)strnlen(info->homedir, SCAP_MAX_PATH_SIZE);
+		shelllen = (uint16_t)strnlen(info->shell, SCAP_MAX_PATH_SIZE);
+
+		// NB: new fields must be appended
+		size_t ul = sizeof(uint32_t) + sizeof(type) + sizeof(info->uid) + sizeof(info->gid) + sizeof(uint16_t) +
+			namelen + sizeof(uint16_t) + homedirlen + sizeof(uint16_t) + shelllen;
+		totlen += ul;
+		lengths[j] = ul;
+	}
+
+	for(j = 0; j < userlist->ngroups; j++)
+	{
+		scap_groupinfo* info = &userlist->groups[j];
+
+		namelen = (uint16_t)strnlen(info->name, MAX_CREDENTIALS_STR_LEN);
+
+		// NB: new fields must be appended
+		uint32_t gl = sizeof(uint32_t) + sizeof(type) + sizeof(info->gid) + sizeof(uint16_t) + namelen;
+		totlen += gl;
+		lengths[userlist->nusers + j] = gl;
+	}
+
+	//
+	// Create the block
+	//
+	bh.block_type = UL_BLOCK_TYPE_V2;
 	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + totlen + 4);
 
+	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh))
+	{
+		free(lengths);
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF1)");
+		return SCAP_FAILURE;
+	}
+
+	//
+	// Dump the users
+	//
+	type = USERBLOCK_TYPE_USER;
+	for(j = 0; j < userlist->nusers; j++)
+	{
+		scap_userinfo* info = &userlist->users[j];
+
+		namelen = (uint16_t)strnlen(info->name, MAX_CREDENTIALS_STR_LEN);
+		homedirlen = (uint16_t)strnlen(info->homedir, SCAP_MAX_PATH_SIZE);
+		shelllen = (uint16_t)strnlen(info->shell, SCAP_MAX_PATH_SIZE);
+
+		if(scap_dump_write(d, &(lengths[j]), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		    scap_dump_write(d, &(type), sizeof(type)) != sizeof(type) ||
+			scap_dump_write(d, &(info->uid), sizeof(info->uid)) != sizeof(info->uid) ||
+		    scap_dump_write(d, &(info->gid), sizeof(info->gid)) != sizeof(info->gid) ||
+		    scap_dump_write(d, &namelen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+		    scap_dump_write(d, info->name, namelen) != namelen ||
+		    scap_dump_write(d, &homedirlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+		    scap_dump_write(d, info->homedir, homedirlen) != homedirlen ||
+		    scap_dump_write(d, &shelllen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+		    scap_dump_write(d, info->shell, shelllen) != shelllen)
+		{
+			free(lengths);
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (U1)");
+			return SCAP_FAILURE;
+		}
+	}
+
+	//
+	// Dump the groups
+	//
+	type = USERBLOCK_TYPE_GROUP;
+	for(j = 0; j < userlist->ngroups; j++)
+	{
+		scap_groupinfo* info = &userlist->groups[j];
+
+		namelen = (uint16_t)strnlen(info->name, MAX_CREDENTIALS_STR_LEN);
+
+		if(scap_dump_write(d, &(lengths[userlist->nusers + j]), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		    scap_dump_write(d, &(type), sizeof(type)) != sizeof(type) ||
+			scap_dump_write(d, &(info->gid), sizeof(info->gid)) != sizeof(info->gid) ||
+		    scap_dump_write(d, &namelen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+		    scap_dump_write(d, info->name, namelen) != namelen)
+		{
+			free(lengths);
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (U2)");
+			return SCAP_FAILURE;
+		}
+	}
+
+	free(lengths);
+
 	//
 	// Blocks need to be 4-byte padded
 	//
 	if(scap_write_padding(d, totlen) != SCAP_SUCCESS)
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (3)");
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF3)");
 		return SCAP_FAILURE;
 	}
 
@@ -506,815 +1881,948 @@ static int32_t scap_write_proclist_trailer(scap_dumper_t *d, uint32_t totlen)
 	bt = bh.block_total_length;
 	if(scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (4)");
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF4)");
 		return SCAP_FAILURE;
 	}
 
 	return SCAP_SUCCESS;
 }
 
-int scap_write_proclist_end(scap_dumper_t *d, scap_dumper_t *proclist_dumper, uint32_t totlen)
+//
+// Create the dump file headers and add the tables
+//
+static bool scap_write_section_header(scap_dumper_t* d)
 {
-	ASSERT(proclist_dumper != NULL);
-	ASSERT(proclist_dumper->m_type == DT_MANAGED_BUF);
-
-	int res = SCAP_SUCCESS;
+	block_header bh;
+	section_header_block sh;
+	uint32_t bt;
 
-	do
-	{
-		scap_dump_flush(proclist_dumper);
+	bh.block_type = SHB_BLOCK_TYPE;
+	bh.block_total_length = sizeof(block_header) + sizeof(section_header_block) + 4;
 
-		if(scap_write_proclist_header(d, totlen) != SCAP_SUCCESS)
-		{
-			res = SCAP_FAILURE;
-			break;
-		}
-		if(scap_dump_write(d, proclist_dumper->m_targetbuf, totlen) <= 0)
-		{
-			res = SCAP_FAILURE;
-			break;
-		}
-		if(scap_write_proclist_trailer(d, totlen) != SCAP_SUCCESS)
-		{
-			res = SCAP_FAILURE;
-			break;
-		}
-	} while(false);
+	sh.byte_order_magic = SHB_MAGIC;
+	sh.major_version = CURRENT_MAJOR_VERSION;
+	sh.minor_version = CURRENT_MINOR_VERSION;
+	sh.section_length = 0xffffffffffffffffLL;
 
-	scap_dump_close(proclist_dumper);
+	bt = bh.block_total_length;
 
-	return res;
+	return scap_dump_write(d, &bh, sizeof(bh)) == sizeof(bh) &&
+	       scap_dump_write(d, &sh, sizeof(sh)) == sizeof(sh) &&
+	       scap_dump_write(d, &bt, sizeof(bt)) == sizeof(bt);
 }
 
 //
-// Write the process list block
+// Write the machine info, the interface list and the user list of the handle
 //
-static int32_t scap_write_proclist_entry(scap_dumper_t *d, struct scap_threadinfo *tinfo, uint32_t *len)
-{
-	struct iovec args = {tinfo->args, tinfo->args_len};
-	struct iovec env = {tinfo->env, tinfo->env_len};
-	struct iovec cgroups = {tinfo->cgroups, tinfo->cgroups_len};
-
-	return scap_write_proclist_entry_bufs(d, tinfo, len,
-					      tinfo->comm,
-					      tinfo->exe,
-					      tinfo->exepath,
-					      &args, 1,
-					      &env, 1,
-					      tinfo->cwd,
-					      &cgroups, 1,
-					      tinfo->root);
-}
-
-static uint16_t iov_size(const struct iovec *iov, uint32_t iovcnt)
+static int32_t scap_write_host_info(scap_t *handle, scap_dumper_t* d)
 {
-	uint16_t len = 0;
-	uint32_t i;
+	//
+	// Write the machine info
+	//
+	if(scap_write_machine_info(d, &handle->m_machine_info) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
 
-	for (i = 0; i < iovcnt; i++)
+	//
+	// Write the interface list
+	//
+	if(scap_write_iflist(d, handle->m_addrlist) != SCAP_SUCCESS)
 	{
-		len += iov[i].iov_len;
+		return SCAP_FAILURE;
 	}
 
-	return len;
+	//
+	// Write the user list
+	//
+	return scap_write_userlist(d, handle->m_userlist);
 }
 
-int32_t scap_write_proclist_entry_bufs(scap_dumper_t *d, struct scap_threadinfo *tinfo, uint32_t *len,
-				       const char *comm,
-				       const char *exe,
-				       const char *exepath,
-				       const struct iovec *args, int argscnt,
-				       const struct iovec *envs, int envscnt,
-				       const char *cwd,
-				       const struct iovec *cgroups, int cgroupscnt,
-				       const char *root)
+static int32_t scap_setup_dump(scap_t *handle, scap_dumper_t* d, const char *fname)
 {
-	uint16_t commlen;
-	uint16_t exelen;
-	uint16_t exepathlen;
-	uint16_t cwdlen;
-	uint16_t rootlen;
-	uint16_t argslen;
-	uint16_t envlen;
-	uint16_t cgroupslen;
+	//
+	// Write the section header
+	//
+	if(!scap_write_section_header(d))
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file %s  (5)", fname);
+		return SCAP_FAILURE;
+	}
 
-	commlen = (uint16_t)strnlen(comm, SCAP_MAX_PATH_SIZE);
-	exelen = (uint16_t)strnlen(exe, SCAP_MAX_PATH_SIZE);
-	exepathlen = (uint16_t)strnlen(exepath, SCAP_MAX_PATH_SIZE);
-	cwdlen = (uint16_t)strnlen(cwd, SCAP_MAX_PATH_SIZE);
-	rootlen = (uint16_t)strnlen(root, SCAP_MAX_PATH_SIZE);
+	if(handle->m_mode != SCAP_MODE_PLUGIN)
+	{
+		if(scap_write_host_info(handle, d) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
 
-	argslen = iov_size(args, argscnt);
-	envlen = iov_size(envs, envscnt);
-	cgroupslen = iov_size(cgroups, cgroupscnt);
+		//
+		// Write the process list
+		//
+		if(scap_write_proclist(d, &handle->m_proclist) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+
+		//
+		// Write the fd lists
+		//
+		if(scap_write_fdlist(d, &handle->m_proclist) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+	}
 
 	//
-	// NB: new fields must be appended
+	// Done, return the file
 	//
-	*len = (uint32_t)(sizeof(uint32_t) + // len
-			  sizeof(uint64_t) + // tid
-			  sizeof(uint64_t) + // pid
-			  sizeof(uint64_t) + // ptid
-			  sizeof(uint64_t) + // sid
-			  sizeof(uint64_t) + // vpgid
-			  2 + commlen +
-			  2 + exelen +
-			  2 + exepathlen +
-			  2 + argslen +
-			  2 + cwdlen +
-			  sizeof(uint64_t) + // fdlimit
-			  sizeof(uint32_t) + // flags
-			  sizeof(uint32_t) + // uid
-			  sizeof(uint32_t) + // gid
-			  sizeof(uint32_t) + // vmsize_kb
-			  sizeof(uint32_t) + // vmrss_kb
-			  sizeof(uint32_t) + // vmswap_kb
-			  sizeof(uint64_t) + // pfmajor
-			  sizeof(uint64_t) + // pfminor
-			  2 + envlen +
-			  sizeof(int64_t) + // vtid
-			  sizeof(int64_t) + // vpid
-			  2 + cgroupslen +
-			  2 + rootlen +
-			  sizeof(uint64_t) + // pidns_init_start_ts
-			  sizeof(int32_t) +  // tty
-			  sizeof(int32_t) +  // loginuid
-			  sizeof(uint8_t) +  // exe_writable
-			  sizeof(uint64_t) + // cap_inheritable
-			  sizeof(uint64_t) + // cap_permitted
-			  sizeof(uint64_t) + // cap_effective
-			  sizeof(uint8_t) + // exe_upper_layer
-			  sizeof(uint64_t) + // exe_ino
-			  sizeof(uint64_t) + // exe_ino_ctime
-			  sizeof(uint64_t)); // exe_ino_mtime
+	return SCAP_SUCCESS;
+}
 
-	if(scap_dump_write(d, len, sizeof(uint32_t)) != sizeof(uint32_t) ||
-		    scap_dump_write(d, &(tinfo->tid), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		    scap_dump_write(d, &(tinfo->pid), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		    scap_dump_write(d, &(tinfo->ptid), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		    scap_dump_write(d, &(tinfo->sid), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		    scap_dump_write(d, &(tinfo->vpgid), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		    scap_dump_write(d, &commlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-                    scap_dump_write(d, (char *) comm, commlen) != commlen ||
-		    scap_dump_write(d, &exelen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-                    scap_dump_write(d, (char *) exe, exelen) != exelen ||
-                    scap_dump_write(d, &exepathlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-                    scap_dump_write(d, (char *) exepath, exepathlen) != exepathlen ||
-		    scap_dump_write(d, &argslen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-                    scap_dump_writev(d, args, argscnt) != argslen ||
-		    scap_dump_write(d, &cwdlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-                    scap_dump_write(d, (char *) cwd, cwdlen) != cwdlen ||
-		    scap_dump_write(d, &(tinfo->fdlimit), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		    scap_dump_write(d, &(tinfo->flags), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		    scap_dump_write(d, &(tinfo->uid), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		    scap_dump_write(d, &(tinfo->gid), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		    scap_dump_write(d, &(tinfo->vmsize_kb), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		    scap_dump_write(d, &(tinfo->vmrss_kb), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		    scap_dump_write(d, &(tinfo->vmswap_kb), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		    scap_dump_write(d, &(tinfo->pfmajor), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		    scap_dump_write(d, &(tinfo->pfminor), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		    scap_dump_write(d, &envlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-                    scap_dump_writev(d, envs, envscnt) != envlen ||
-		    scap_dump_write(d, &(tinfo->vtid), sizeof(int64_t)) != sizeof(int64_t) ||
-		    scap_dump_write(d, &(tinfo->vpid), sizeof(int64_t)) != sizeof(int64_t) ||
-		    scap_dump_write(d, &(cgroupslen), sizeof(uint16_t)) != sizeof(uint16_t) ||
-                    scap_dump_writev(d, cgroups, cgroupscnt) != cgroupslen ||
-		    scap_dump_write(d, &rootlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-                    scap_dump_write(d, (char *) root, rootlen) != rootlen ||
-			scap_dump_write(d, &(tinfo->pidns_init_start_ts), sizeof(uint64_t)) != sizeof(uint64_t) ||
-			scap_dump_write(d, &(tinfo->tty), sizeof(int32_t)) != sizeof(int32_t) ||
-            scap_dump_write(d, &(tinfo->loginuid), sizeof(uint32_t)) != sizeof(uint32_t) ||
-			scap_dump_write(d, &(tinfo->exe_writable), sizeof(uint8_t)) != sizeof(uint8_t) ||
-			scap_dump_write(d, &(tinfo->cap_inheritable), sizeof(uint64_t)) != sizeof(uint64_t) ||
-			scap_dump_write(d, &(tinfo->cap_permitted), sizeof(uint64_t)) != sizeof(uint64_t) ||
-			scap_dump_write(d, &(tinfo->cap_effective), sizeof(uint64_t)) != sizeof(uint64_t) || 
-			scap_dump_write(d, &(tinfo->exe_upper_layer), sizeof(uint8_t)) != sizeof(uint8_t) ||
-			scap_dump_write(d, &(tinfo->exe_ino), sizeof(uint64_t)) != sizeof(uint64_t) ||
-			scap_dump_write(d, &(tinfo->exe_ino_ctime), sizeof(uint64_t)) != sizeof(uint64_t) ||
-			scap_dump_write(d, &(tinfo->exe_ino_mtime), sizeof(uint64_t)) != sizeof(uint64_t))
+static inline int32_t scap_dump_rescan_proc(scap_t *handle)
+{
+	int32_t ret = SCAP_SUCCESS;
+#ifdef __linux__
+	proc_entry_callback tcb = handle->m_proclist.m_proc_callback;
+	handle->m_proclist.m_proc_callback = NULL;
+	ret = scap_refresh_proc_table(handle);
+	handle->m_proclist.m_proc_callback = tcb;
+#endif
+	return ret;
+}
+
+// fname is only used for log messages in scap_setup_dump
+static scap_dumper_t *scap_dump_open_gzfile(scap_t *handle, gzFile gzfile, struct scap_dump_stream* stream, const char *fname, bool skip_proc_scan)
+{
+	scap_dumper_t* res = (scap_dumper_t*)malloc(sizeof(scap_dumper_t));
+	res->m_f = gzfile;
+	res->m_stream = stream;
+	res->m_async = NULL;
+	res->m_dropped = 0;
+	res->m_type = DT_FILE;
+	res->m_targetbuf = NULL;
+	res->m_targetbufcurpos = NULL;
+	res->m_targetbufend = NULL;
+	scap_dump_reset_index(res);
+	scap_dump_reset_checkpoints(res);
+	res->m_strdict = NULL;
+
+	if(scap_setup_dump(handle, res, fname) != SCAP_SUCCESS)
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (2)");
-		return SCAP_FAILURE;
+		strcpy(handle->m_lasterr, res->m_lasterr);
+		free(res);
+		res = NULL;
 	}
 
-	return SCAP_SUCCESS;
+	return res;
 }
 
 //
-// Write the process list block
+// Open a "savefile" for writing.
 //
-static int32_t scap_write_proclist(scap_dumper_t *d, struct scap_proclist *proclist)
+scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mode compress, bool skip_proc_scan)
 {
-	//
-	// Exit immediately if the process list is empty
-	//
-	if(HASH_COUNT(proclist->m_proclist) == 0)
+	gzFile f = NULL;
+	struct scap_dump_stream* stream = NULL;
+	bool use_stream = false;
+	int fd = -1;
+	const char* mode;
+	scap_dumper_t* res;
+
+	switch(compress)
 	{
-		return SCAP_SUCCESS;
+	case SCAP_COMPRESSION_GZIP_BLOCKS:
+	case SCAP_COMPRESSION_ZSTD:
+	case SCAP_COMPRESSION_LZ4:
+		use_stream = true;
+		mode = "wb";
+		break;
+	case SCAP_COMPRESSION_GZIP:
+		mode = "wb";
+		break;
+	case SCAP_COMPRESSION_NONE:
+		mode = "wbT";
+		break;
+	default:
+		ASSERT(false);
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid compression mode");
+		return NULL;
 	}
 
-	scap_dumper_t *proclist_dumper = scap_write_proclist_begin();
-	if(proclist_dumper == NULL)
+	if(fname[0] == '-' && fname[1] == '\0')
 	{
-		return SCAP_FAILURE;
+#ifndef	_WIN32
+		fd = dup(STDOUT_FILENO);
+#else
+		fd = 1;
+#endif
+		if(fd != -1)
+		{
+			if(use_stream)
+			{
+				FILE* file = fdopen(fd, mode);
+				if(file != NULL)
+				{
+					// Owned by the writer now
+					fd = -1;
+					stream = scap_dump_stream_open(file, compress, handle->m_lasterr);
+					if(stream == NULL)
+					{
+						return NULL;
+					}
+				}
+			}
+			else
+			{
+				f = gzdopen(fd, mode);
+			}
+			fname = "standard output";
+		}
+	}
+	else if(use_stream)
+	{
+		FILE* file = fopen(fname, mode);
+		if(file == NULL)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open %s", fname);
+			return NULL;
+		}
+		stream = scap_dump_stream_open(file, compress, handle->m_lasterr);
+		if(stream == NULL)
+		{
+			return NULL;
+		}
+	}
+	else
+	{
+		f = gzopen(fname, mode);
 	}
-	
 
-	uint32_t totlen = 0;
-	struct scap_threadinfo *tinfo;
-	struct scap_threadinfo *ttinfo;
-	HASH_ITER(hh, proclist->m_proclist, tinfo, ttinfo)
+	if(f == NULL && stream == NULL)
 	{
-		if(tinfo->filtered_out)
+#ifndef	_WIN32
+		if(fd != -1)
 		{
-			continue;
+			close(fd);
 		}
+#endif
+
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open %s", fname);
+		return NULL;
+	}
 
-		uint32_t len = 0;
-		if(scap_write_proclist_entry(proclist_dumper, tinfo, &len) != SCAP_SUCCESS)
+	//
+	// If we're dumping in live mode, refresh the process tables list
+	// so we don't lose information about processes created in the interval
+	// between opening the handle and starting the dump
+	//
+	if(handle->m_mode != SCAP_MODE_CAPTURE && !skip_proc_scan)
+	{
+		if(scap_dump_rescan_proc(handle) != SCAP_SUCCESS)
 		{
-			scap_dump_close(proclist_dumper);
-			return SCAP_FAILURE;
+			return NULL;
 		}
+	}
 
-		totlen += len;
+	res = scap_dump_open_gzfile(handle, f, stream, fname, skip_proc_scan);
+	//
+	// If the user doesn't need the thread table, free it
+	//
+	if(handle->m_proclist.m_proc_callback != NULL)
+	{
+		scap_proc_free_table(&handle->m_proclist);
 	}
 
-	return scap_write_proclist_end(d, proclist_dumper, totlen);
+	return res;
 }
 
 //
-// Write the machine info block
-//
-static int32_t scap_write_machine_info(scap_dumper_t *d, scap_machine_info *machine_info)
+// Open a savefile for writing, using the provided fd
+scap_dumper_t* scap_dump_open_fd(scap_t *handle, int fd, compression_mode compress, bool skip_proc_scan)
 {
-	block_header bh;
-	uint32_t bt;
+	gzFile f = NULL;
+	struct scap_dump_stream* stream = NULL;
+	scap_dumper_t* res;
+
+	switch(compress)
+	{
+	case SCAP_COMPRESSION_GZIP:
+		f = gzdopen(fd, "wb");
+		break;
+	case SCAP_COMPRESSION_NONE:
+		f = gzdopen(fd, "wbT");
+		break;
+	case SCAP_COMPRESSION_GZIP_BLOCKS:
+	case SCAP_COMPRESSION_ZSTD:
+	case SCAP_COMPRESSION_LZ4:
+	{
+		FILE* file = fdopen(fd, "wb");
+		if(file != NULL)
+		{
+			stream = scap_dump_stream_open(file, compress, handle->m_lasterr);
+			if(stream == NULL)
+			{
+				return NULL;
+			}
+		}
+		break;
+	}
+	default:
+		ASSERT(false);
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid compression mode");
+		return NULL;
+	}
+	
+	if(f == NULL && stream == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open fd %d", fd);
+		return NULL;
+	}
 
 	//
-	// Write the section header
+	// If we're dumping in live mode, refresh the process tables list
+	// so we don't lose information about processes created in the interval
+	// between opening the handle and starting the dump
 	//
-	bh.block_type = MI_BLOCK_TYPE;
-	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + sizeof(scap_machine_info) + 4);
+	if(handle->m_mode != SCAP_MODE_CAPTURE && !skip_proc_scan)
+	{
+		if(scap_dump_rescan_proc(handle) != SCAP_SUCCESS)
+		{
+			return NULL;
+		}
+	}
 
-	bt = bh.block_total_length;
+	res = scap_dump_open_gzfile(handle, f, stream, "", skip_proc_scan);
 
-	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh) ||
-	        scap_dump_write(d, machine_info, sizeof(*machine_info)) != sizeof(*machine_info) ||
-	        scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	//
+	// If the user doesn't need the thread table, free it
+	//
+	if(handle->m_proclist.m_proc_callback != NULL)
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (MI1)");
-		return SCAP_FAILURE;
+		scap_proc_free_table(&handle->m_proclist);
 	}
-
-	return SCAP_SUCCESS;
+	return res;
 }
 
 //
-// Write the interface list block
+// Open a memory "savefile"
 //
-static int32_t scap_write_iflist(scap_dumper_t* d, scap_addrlist* addrlist)
+scap_dumper_t *scap_memory_dump_open(scap_t *handle, uint8_t* targetbuf, uint64_t targetbufsize)
 {
-	block_header bh;
-	uint32_t bt;
-	uint32_t entrylen;
-	uint32_t totlen = 0;
-	uint32_t j;
+	scap_dumper_t* res = (scap_dumper_t*)malloc(sizeof(scap_dumper_t));
+	if(res == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scap_dump_memory_open memory allocation failure (1)");
+		return NULL;
+	}
 
-	//
-	// Get the interface list
-	//
-	if(addrlist == NULL)
+	res->m_f = NULL;
+	res->m_stream = NULL;
+	res->m_async = NULL;
+	res->m_dropped = 0;
+	res->m_type = DT_MEM;
+	res->m_targetbuf = targetbuf;
+	res->m_targetbufcurpos = targetbuf;
+	res->m_targetbufend = targetbuf + targetbufsize;
+	scap_dump_reset_index(res);
+	scap_dump_reset_checkpoints(res);
+	res->m_strdict = NULL;
+
+	if(scap_setup_dump(handle, res, "") != SCAP_SUCCESS)
 	{
-		//
-		// This can happen when the event source is a capture that was generated by a plugin, no big deal
-		//
-		return SCAP_SUCCESS;
+		strcpy(handle->m_lasterr, res->m_lasterr);
+		free(res);
+		res = NULL;
 	}
 
-	//
-	// Create the block
-	//
-	bh.block_type = IL_BLOCK_TYPE_V2;
-	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + (addrlist->n_v4_addrs + addrlist->n_v6_addrs)*sizeof(uint32_t) +
-							 addrlist->totlen + 4);
+	return res;
+}
 
-	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh))
+//
+// Create a dumper with an internally managed buffer
+//
+scap_dumper_t *scap_managedbuf_dump_create()
+{
+	scap_dumper_t *res = (scap_dumper_t *)malloc(sizeof(scap_dumper_t));
+	if(res == NULL)
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF1)");
-		return SCAP_FAILURE;
+		return NULL;
 	}
 
-	//
-	// Dump the ipv4 list
-	//
-	for(j = 0; j < addrlist->n_v4_addrs; j++)
+	res->m_f = NULL;
+	res->m_stream = NULL;
+	res->m_async = NULL;
+	res->m_dropped = 0;
+	res->m_type = DT_MANAGED_BUF;
+	res->m_targetbuf = (uint8_t *)malloc(PPM_DUMPER_MANAGED_BUF_SIZE);
+	res->m_targetbufcurpos = res->m_targetbuf;
+	res->m_targetbufend = res->m_targetbuf + PPM_DUMPER_MANAGED_BUF_SIZE;
+	scap_dump_reset_index(res);
+	scap_dump_reset_checkpoints(res);
+	res->m_strdict = NULL;
+
+	return res;
+}
+
+int32_t scap_dump_enable_index(scap_dumper_t *d, uint64_t interval)
+{
+	if(d->m_type != DT_FILE)
 	{
-		scap_ifinfo_ipv4 *entry = &(addrlist->v4list[j]);
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "the event index is only supported by file dumpers");
+		return SCAP_NOT_SUPPORTED;
+	}
 
-		entrylen = sizeof(scap_ifinfo_ipv4) + entry->ifnamelen - SCAP_MAX_PATH_SIZE;
+	d->m_index_interval = interval;
+	d->m_index_next_offset = 0;
+	return SCAP_SUCCESS;
+}
 
-		if(scap_dump_write(d, &entrylen, sizeof(uint32_t)) != sizeof(uint32_t) ||
-		   scap_dump_write(d, &(entry->type), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		   scap_dump_write(d, &(entry->ifnamelen), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		   scap_dump_write(d, &(entry->addr), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		   scap_dump_write(d, &(entry->netmask), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		   scap_dump_write(d, &(entry->bcast), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		   scap_dump_write(d, &(entry->linkspeed), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		   scap_dump_write(d, &(entry->ifname), entry->ifnamelen) != entry->ifnamelen)
-		{
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF2)");
-			return SCAP_FAILURE;
-		}
+struct scap_dump_strdict_entry
+{
+	uint32_t id;
+	uint16_t len;
+	UT_hash_handle hh;
+	char data[];
+};
 
-		totlen += sizeof(uint32_t) + entrylen;
+struct scap_dump_strdict
+{
+	struct scap_dump_strdict_entry* m_entries;
+	uint32_t m_next_id;
+	uint64_t m_bytes;
+	// The strings added by the event being written, for the dictionary
+	// block before it
+	uint32_t m_n_new;
+	struct scap_dump_strdict_entry* m_new[32];
+	// The event being written, with the references
+	uint8_t m_evt[UINT16_MAX + 1];
+};
+
+static void scap_dump_strdict_clear(struct scap_dump_strdict* sd)
+{
+	struct scap_dump_strdict_entry *entry, *tentry;
+
+	HASH_ITER(hh, sd->m_entries, entry, tentry)
+	{
+		HASH_DEL(sd->m_entries, entry);
+		free(entry);
+	}
+	sd->m_next_id = 0;
+	sd->m_bytes = 0;
+	sd->m_n_new = 0;
+}
+
+static void scap_dump_strdict_free(scap_dumper_t *d)
+{
+	if(d->m_strdict != NULL)
+	{
+		scap_dump_strdict_clear(d->m_strdict);
+		free(d->m_strdict);
+		d->m_strdict = NULL;
 	}
+}
 
-	//
-	// Dump the ipv6 list
-	//
-	for(j = 0; j < addrlist->n_v6_addrs; j++)
+int32_t scap_dump_enable_strdict(scap_dumper_t *d, bool enable)
+{
+	if(d->m_type != DT_FILE)
 	{
-		scap_ifinfo_ipv6 *entry = &(addrlist->v6list[j]);
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "the string dictionary is only supported by file dumpers");
+		return SCAP_NOT_SUPPORTED;
+	}
 
-		entrylen = sizeof(scap_ifinfo_ipv6) + entry->ifnamelen - SCAP_MAX_PATH_SIZE;
+	if(!enable)
+	{
+		scap_dump_strdict_free(d);
+		return SCAP_SUCCESS;
+	}
 
-		if(scap_dump_write(d, &entrylen, sizeof(uint32_t)) != sizeof(uint32_t) ||
-		   scap_dump_write(d, &(entry->type), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		   scap_dump_write(d, &(entry->ifnamelen), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		   scap_dump_write(d, &(entry->addr), SCAP_IPV6_ADDR_LEN) != SCAP_IPV6_ADDR_LEN ||
-		   scap_dump_write(d, &(entry->netmask), SCAP_IPV6_ADDR_LEN) != SCAP_IPV6_ADDR_LEN ||
-		   scap_dump_write(d, &(entry->bcast), SCAP_IPV6_ADDR_LEN) != SCAP_IPV6_ADDR_LEN ||
-		   scap_dump_write(d, &(entry->linkspeed), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		   scap_dump_write(d, &(entry->ifname), entry->ifnamelen) != entry->ifnamelen)
+	if(d->m_strdict == NULL)
+	{
+		d->m_strdict = (struct scap_dump_strdict*)calloc(1, sizeof(struct scap_dump_strdict));
+		if(d->m_strdict == NULL)
 		{
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF2)");
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the string dictionary");
 			return SCAP_FAILURE;
 		}
-
-		totlen += sizeof(uint32_t) + entrylen;
 	}
 
-	//
-	// Blocks need to be 4-byte padded
-	//
-	if(scap_write_padding(d, totlen) != SCAP_SUCCESS)
+	return SCAP_SUCCESS;
+}
+
+//
+// The params worth a reference: the strings, and the buffers of the process
+// events (arguments, environment, cgroups), rather than the I/O data
+//
+static inline bool scap_dump_strdict_wants(const struct ppm_event_info* info, uint32_t param, uint16_t len)
+{
+	if(len < STRDICT_MIN_STRING_LEN || len > STRDICT_MAX_STRING_LEN || param >= info->nparams)
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF3)");
-		return SCAP_FAILURE;
+		return false;
 	}
 
-	//
-	// Create the trailer
-	//
-	bt = bh.block_total_length;
-	if(scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	switch(info->params[param].type)
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF4)");
-		return SCAP_FAILURE;
+	case PT_CHARBUF:
+	case PT_FSPATH:
+	case PT_FSRELPATH:
+		return true;
+	case PT_BYTEBUF:
+		return (info->category & EC_PROCESS) != 0;
+	default:
+		return false;
 	}
-
-	return SCAP_SUCCESS;
 }
 
 //
-// Write the user list block
+// Find the number of a string, adding it to the dictionary if needed
 //
-static int32_t scap_write_userlist(scap_dumper_t* d, struct scap_userlist *userlist)
+static bool scap_dump_strdict_ref(struct scap_dump_strdict* sd, const uint8_t* val, uint16_t len, uint32_t* id)
 {
-	block_header bh;
-	uint32_t bt;
-	uint32_t j;
-	uint16_t namelen;
-	uint16_t homedirlen;
-	uint16_t shelllen;
-	uint8_t type;
-	uint32_t totlen = 0;
+	struct scap_dump_strdict_entry* entry;
+	int32_t uth_status = SCAP_SUCCESS;
 
-	//
-	// Make sure we have a user list interface list
-	//
-	if(userlist == NULL)
+	HASH_FIND(hh, sd->m_entries, val, len, entry);
+	if(entry != NULL)
 	{
-		//
-		// This can happen when the event source is a capture that was generated by a plugin, no big deal
-		//
-		return SCAP_SUCCESS;
+		*id = entry->id;
+		return true;
 	}
 
-	uint32_t* lengths = calloc(userlist->nusers + userlist->ngroups, sizeof(uint32_t));
-	if(lengths == NULL)
+	if(sd->m_n_new == sizeof(sd->m_new) / sizeof(sd->m_new[0]))
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "scap_write_userlist memory allocation failure (1)");
-		return SCAP_FAILURE;
+		return false;
 	}
 
-	//
-	// Calculate the lengths
-	//
-	for(j = 0; j < userlist->nusers; j++)
+	entry = (struct scap_dump_strdict_entry*)malloc(sizeof(struct scap_dump_strdict_entry) + len);
+	if(entry == NULL)
 	{
-		scap_userinfo* info = &userlist->users[j];
-
-		namelen = (uint16_t)strnlen(info->name, MAX_CREDENTIALS_STR_LEN);
-		homedirlen = (uint16_t)strnlen(info->homedir, SCAP_MAX_PATH_SIZE);
-		shelllen = (uint16_t)strnlen(info->shell, SCAP_MAX_PATH_SIZE);
-
-		// NB: new fields must be appended
-		size_t ul = sizeof(uint32_t) + sizeof(type) + sizeof(info->uid) + sizeof(info->gid) + sizeof(uint16_t) +
-			namelen + sizeof(uint16_t) + homedirlen + sizeof(uint16_t) + shelllen;
-		totlen += ul;
-		lengths[j] = ul;
+		return false;
 	}
 
-	for(j = 0; j < userlist->ngroups; j++)
+	entry->id = sd->m_next_id++;
+	entry->len = len;
+	memcpy(entry->data, val, len);
+	HASH_ADD_KEYPTR(hh, sd->m_entries, entry->data, entry->len, entry);
+	if(uth_status != SCAP_SUCCESS)
 	{
-		scap_groupinfo* info = &userlist->groups[j];
+		sd->m_next_id--;
+		free(entry);
+		return false;
+	}
+	sd->m_bytes += len;
+	sd->m_new[sd->m_n_new++] = entry;
+	*id = entry->id;
+	return true;
+}
 
-		namelen = (uint16_t)strnlen(info->name, MAX_CREDENTIALS_STR_LEN);
+//
+// Forget the strings added for an event that wasn't written
+//
+static void scap_dump_strdict_rollback(struct scap_dump_strdict* sd)
+{
+	uint32_t i;
 
-		// NB: new fields must be appended
-		uint32_t gl = sizeof(uint32_t) + sizeof(type) + sizeof(info->gid) + sizeof(uint16_t) + namelen;
-		totlen += gl;
-		lengths[userlist->nusers + j] = gl;
+	for(i = 0; i < sd->m_n_new; i++)
+	{
+		HASH_DEL(sd->m_entries, sd->m_new[i]);
+		sd->m_bytes -= sd->m_new[i]->len;
+		free(sd->m_new[i]);
 	}
+	sd->m_next_id -= sd->m_n_new;
+	sd->m_n_new = 0;
+}
 
-	//
-	// Create the block
-	//
-	bh.block_type = UL_BLOCK_TYPE_V2;
-	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + totlen + 4);
+//
+// Copy the event to sd->m_evt, replacing the params in the dictionary with
+// their number. Returns the mask of the replaced params, 0 to write the event
+// as is.
+//
+static uint32_t scap_dump_strdict_encode(struct scap_dump_strdict* sd, scap_evt* e)
+{
+	const struct ppm_event_info* info;
+	const uint16_t* lens;
+	const uint8_t* val;
+	const uint8_t* end = (const uint8_t*)e + e->len;
+	uint16_t* out_lens;
+	uint8_t* out;
+	uint32_t mask = 0;
+	uint32_t i;
 
-	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh))
+	sd->m_n_new = 0;
+
+	// Start a new dictionary when it's full, with room for one more event
+	if(sd->m_next_id + 32 > STRDICT_MAX_STRINGS ||
+	   sd->m_bytes + 32 * STRDICT_MAX_STRING_LEN > STRDICT_MAX_BYTES)
 	{
-		free(lengths);
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF1)");
-		return SCAP_FAILURE;
+		scap_dump_strdict_clear(sd);
 	}
 
-	//
-	// Dump the users
-	//
-	type = USERBLOCK_TYPE_USER;
-	for(j = 0; j < userlist->nusers; j++)
+	if(e->type >= PPM_EVENT_MAX ||
+	   e->len > sizeof(sd->m_evt) ||
+	   sizeof(struct ppm_evt_hdr) + e->nparams * sizeof(uint16_t) > e->len)
 	{
-		scap_userinfo* info = &userlist->users[j];
-
-		namelen = (uint16_t)strnlen(info->name, MAX_CREDENTIALS_STR_LEN);
-		homedirlen = (uint16_t)strnlen(info->homedir, SCAP_MAX_PATH_SIZE);
-		shelllen = (uint16_t)strnlen(info->shell, SCAP_MAX_PATH_SIZE);
-
-		if(scap_dump_write(d, &(lengths[j]), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		    scap_dump_write(d, &(type), sizeof(type)) != sizeof(type) ||
-			scap_dump_write(d, &(info->uid), sizeof(info->uid)) != sizeof(info->uid) ||
-		    scap_dump_write(d, &(info->gid), sizeof(info->gid)) != sizeof(info->gid) ||
-		    scap_dump_write(d, &namelen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		    scap_dump_write(d, info->name, namelen) != namelen ||
-		    scap_dump_write(d, &homedirlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		    scap_dump_write(d, info->homedir, homedirlen) != homedirlen ||
-		    scap_dump_write(d, &shelllen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		    scap_dump_write(d, info->shell, shelllen) != shelllen)
-		{
-			free(lengths);
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (U1)");
-			return SCAP_FAILURE;
-		}
+		return 0;
 	}
 
-	//
-	// Dump the groups
-	//
-	type = USERBLOCK_TYPE_GROUP;
-	for(j = 0; j < userlist->ngroups; j++)
+	info = &g_event_info[e->type];
+	lens = (const uint16_t*)((const uint8_t*)e + sizeof(struct ppm_evt_hdr));
+	val = (const uint8_t*)(lens + e->nparams);
+	memcpy(sd->m_evt, e, val - (const uint8_t*)e);
+	out_lens = (uint16_t*)(sd->m_evt + sizeof(struct ppm_evt_hdr));
+	out = sd->m_evt + (val - (const uint8_t*)e);
+
+	for(i = 0; i < e->nparams; i++)
 	{
-		scap_groupinfo* info = &userlist->groups[j];
+		uint16_t len = lens[i];
+		uint32_t id;
 
-		namelen = (uint16_t)strnlen(info->name, MAX_CREDENTIALS_STR_LEN);
+		if(val + len > end)
+		{
+			scap_dump_strdict_rollback(sd);
+			return 0;
+		}
 
-		if(scap_dump_write(d, &(lengths[userlist->nusers + j]), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		    scap_dump_write(d, &(type), sizeof(type)) != sizeof(type) ||
-			scap_dump_write(d, &(info->gid), sizeof(info->gid)) != sizeof(info->gid) ||
-		    scap_dump_write(d, &namelen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		    scap_dump_write(d, info->name, namelen) != namelen)
+		if(i < 32 && scap_dump_strdict_wants(info, i, len) &&
+		   scap_dump_strdict_ref(sd, val, len, &id))
 		{
-			free(lengths);
-			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (U2)");
-			return SCAP_FAILURE;
+			memcpy(out, &id, sizeof(id));
+			out_lens[i] = sizeof(id);
+			out += sizeof(id);
+			mask |= 1U << i;
 		}
+		else
+		{
+			memcpy(out, val, len);
+			out += len;
+		}
+		val += len;
 	}
 
-	free(lengths);
+	((scap_evt*)sd->m_evt)->len = out - sd->m_evt;
+	return mask;
+}
 
-	//
-	// Blocks need to be 4-byte padded
-	//
-	if(scap_write_padding(d, totlen) != SCAP_SUCCESS)
-	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF3)");
-		return SCAP_FAILURE;
-	}
+static uint32_t scap_strdict_block_len(struct scap_dump_strdict* sd)
+{
+	uint32_t len = sizeof(block_header) + sizeof(strdict_header) + sizeof(uint32_t);
+	uint32_t i;
 
-	//
-	// Create the trailer
-	//
-	bt = bh.block_total_length;
-	if(scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	for(i = 0; i < sd->m_n_new; i++)
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF4)");
-		return SCAP_FAILURE;
+		len += sizeof(uint16_t) + sd->m_new[i]->len;
 	}
 
-	return SCAP_SUCCESS;
+	return scap_normalize_block_len(len);
 }
 
 //
-// Create the dump file headers and add the tables
+// Write the strings added by the event about to be written
 //
-static int32_t scap_setup_dump(scap_t *handle, scap_dumper_t* d, const char *fname)
+static int32_t scap_write_strdict_block(scap_dumper_t *d, struct scap_dump_strdict* sd)
 {
 	block_header bh;
-	section_header_block sh;
+	strdict_header sh;
 	uint32_t bt;
+	uint32_t len;
+	uint32_t i;
 
-	//
-	// Write the section header
-	//
-	bh.block_type = SHB_BLOCK_TYPE;
-	bh.block_total_length = sizeof(block_header) + sizeof(section_header_block) + 4;
-
-	sh.byte_order_magic = SHB_MAGIC;
-	sh.major_version = CURRENT_MAJOR_VERSION;
-	sh.minor_version = CURRENT_MINOR_VERSION;
-	sh.section_length = 0xffffffffffffffffLL;
-
+	bh.block_type = STRDICT_BLOCK_TYPE;
+	bh.block_total_length = scap_strdict_block_len(sd);
 	bt = bh.block_total_length;
+	sh.first_id = sd->m_new[0]->id;
+	sh.n_strings = sd->m_n_new;
+	len = sizeof(sh);
 
 	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh) ||
-	        scap_dump_write(d, &sh, sizeof(sh)) != sizeof(sh) ||
-	        scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	   scap_dump_write(d, &sh, sizeof(sh)) != sizeof(sh))
 	{
-		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file %s  (5)", fname);
 		return SCAP_FAILURE;
 	}
 
-	if(handle->m_mode != SCAP_MODE_PLUGIN)
+	for(i = 0; i < sd->m_n_new; i++)
 	{
-		//
-		// Write the machine info
-		//
-		if(scap_write_machine_info(d, &handle->m_machine_info) != SCAP_SUCCESS)
+		uint16_t slen = sd->m_new[i]->len;
+		if(scap_dump_write(d, &slen, sizeof(slen)) != sizeof(slen) ||
+		   scap_dump_write(d, sd->m_new[i]->data, slen) != slen)
 		{
 			return SCAP_FAILURE;
 		}
+		len += sizeof(slen) + slen;
+	}
 
-		//
-		// Write the interface list
-		//
-		if(scap_write_iflist(d, handle->m_addrlist) != SCAP_SUCCESS)
-		{
-			return SCAP_FAILURE;
-		}
+	if(scap_write_padding(d, len) != SCAP_SUCCESS ||
+	   scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		return SCAP_FAILURE;
+	}
 
-		//
-		// Write the user list
-		//
-		if(scap_write_userlist(d, handle->m_userlist) != SCAP_SUCCESS)
-		{
-			return SCAP_FAILURE;
-		}
+	return SCAP_SUCCESS;
+}
 
-		//
-		// Write the process list
-		//
-		if(scap_write_proclist(d, &handle->m_proclist) != SCAP_SUCCESS)
-		{
-			return SCAP_FAILURE;
-		}
+int32_t scap_dump_enable_async(scap_dumper_t *d, uint32_t bufsize, uint32_t nbufs)
+{
+#ifndef _WIN32
+	struct scap_dump_async* a;
+	int64_t tell;
 
-		//
-		// Write the fd lists
-		//
-		if(scap_write_fdlist(d, &handle->m_proclist) != SCAP_SUCCESS)
+	if(d->m_type != DT_FILE)
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "asynchronous writes are only supported by file dumpers");
+		return SCAP_NOT_SUPPORTED;
+	}
+
+	if(d->m_async != NULL)
+	{
+		if(!scap_dump_async_stop(d))
 		{
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (async)");
 			return SCAP_FAILURE;
 		}
 	}
 
-	//
-	// Done, return the file
-	//
+	if(bufsize == 0)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	tell = scap_dump_file_tell(d);
+	if(tell < 0)
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error getting the file position");
+		return SCAP_FAILURE;
+	}
+
+	a = (struct scap_dump_async*)calloc(1, sizeof(struct scap_dump_async));
+	if(a == NULL)
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the async dumper");
+		return SCAP_FAILURE;
+	}
+
+	a->m_dumper = d;
+	a->m_bufsize = bufsize;
+	a->m_nbufs = nbufs < 2 ? 2 : nbufs;
+	a->m_base_tell = (uint64_t)tell;
+	a->m_offset = scap_dump_file_offset(d);
+	pthread_mutex_init(&a->m_lock, NULL);
+	pthread_cond_init(&a->m_full_cond, NULL);
+	pthread_cond_init(&a->m_free_cond, NULL);
+	a->m_bufs = (uint8_t**)calloc(a->m_nbufs, sizeof(uint8_t*));
+	a->m_lens = (uint32_t*)calloc(a->m_nbufs, sizeof(uint32_t));
+	bool ok = a->m_bufs != NULL && a->m_lens != NULL;
+	for(uint32_t i = 0; ok && i < a->m_nbufs; i++)
+	{
+		a->m_bufs[i] = (uint8_t*)malloc(bufsize);
+		ok = a->m_bufs[i] != NULL;
+	}
+	if(!ok)
+	{
+		scap_dump_async_free(a, false);
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the async dumper buffers");
+		return SCAP_FAILURE;
+	}
+
+	if(pthread_create(&a->m_thread, NULL, scap_dump_async_run, a) != 0)
+	{
+		scap_dump_async_free(a, false);
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error starting the async dumper thread");
+		return SCAP_FAILURE;
+	}
+
+	d->m_async = a;
 	return SCAP_SUCCESS;
+#else
+	snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "asynchronous writes are not supported on this platform");
+	return SCAP_NOT_SUPPORTED;
+#endif
 }
 
-static inline int32_t scap_dump_rescan_proc(scap_t *handle)
+uint64_t scap_dump_get_dropped_events(scap_dumper_t *d)
 {
-	int32_t ret = SCAP_SUCCESS;
-#ifdef __linux__
-	proc_entry_callback tcb = handle->m_proclist.m_proc_callback;
-	handle->m_proclist.m_proc_callback = NULL;
-	ret = scap_refresh_proc_table(handle);
-	handle->m_proclist.m_proc_callback = tcb;
-#endif
-	return ret;
+	return d->m_dropped;
 }
 
-// fname is only used for log messages in scap_setup_dump
-static scap_dumper_t *scap_dump_open_gzfile(scap_t *handle, gzFile gzfile, const char *fname, bool skip_proc_scan)
+void scap_dump_set_async_drop(scap_dumper_t *d, bool drop)
 {
-	scap_dumper_t* res = (scap_dumper_t*)malloc(sizeof(scap_dumper_t));
-	res->m_f = gzfile;
-	res->m_type = DT_FILE;
-	res->m_targetbuf = NULL;
-	res->m_targetbufcurpos = NULL;
-	res->m_targetbufend = NULL;
-
-	if(scap_setup_dump(handle, res, fname) != SCAP_SUCCESS)
+#ifndef _WIN32
+	if(d->m_async != NULL)
 	{
-		strcpy(handle->m_lasterr, res->m_lasterr);
-		free(res);
-		res = NULL;
+		d->m_async->m_no_drop = !drop;
 	}
-
-	return res;
+#endif
 }
 
 //
-// Open a "savefile" for writing.
+// Add an event to the index, if it's far enough from the last indexed one.
+// The index is best effort: if it can't grow, it's dropped. Returns true
+// if the event was indexed.
 //
-scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mode compress, bool skip_proc_scan)
+static bool scap_dump_index_event(scap_dumper_t *d, uint64_t ts)
 {
-	gzFile f = NULL;
-	int fd = -1;
-	const char* mode;
-	scap_dumper_t* res;
-
-	switch(compress)
+	int64_t offset = scap_dump_ftell(d);
+	if(offset < 0 || (uint64_t)offset < d->m_index_next_offset)
 	{
-	case SCAP_COMPRESSION_GZIP:
-		mode = "wb";
-		break;
-	case SCAP_COMPRESSION_NONE:
-		mode = "wbT";
-		break;
-	default:
-		ASSERT(false);
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid compression mode");
-		return NULL;
+		return false;
 	}
 
-	if(fname[0] == '-' && fname[1] == '\0')
-	{
-#ifndef	_WIN32
-		fd = dup(STDOUT_FILENO);
-#else
-		fd = 1;
-#endif
-		if(fd != -1)
-		{
-			f = gzdopen(fd, mode);
-			fname = "standard output";
-		}
-	}
-	else
+	// Keep the index sorted, events that went back in time are not indexed
+	if(d->m_index_len > 0 && ts < d->m_index[d->m_index_len - 1].ts)
 	{
-		f = gzopen(fname, mode);
+		return false;
 	}
 
-	if(f == NULL)
+	if(d->m_index_len == d->m_index_size)
 	{
-#ifndef	_WIN32
-		if(fd != -1)
+		uint64_t size = d->m_index_size == 0 ? 1024 : 2 * d->m_index_size;
+		evt_index_entry* index = (evt_index_entry*)realloc(d->m_index, size * sizeof(evt_index_entry));
+		if(index == NULL)
 		{
-			close(fd);
+			free(d->m_index);
+			scap_dump_reset_index(d);
+			return false;
 		}
-#endif
-
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open %s", fname);
-		return NULL;
+		d->m_index = index;
+		d->m_index_size = size;
 	}
 
-	//
-	// If we're dumping in live mode, refresh the process tables list
-	// so we don't lose information about processes created in the interval
-	// between opening the handle and starting the dump
-	//
-	if(handle->m_mode != SCAP_MODE_CAPTURE && !skip_proc_scan)
-	{
-		if(scap_dump_rescan_proc(handle) != SCAP_SUCCESS)
-		{
-			return NULL;
-		}
-	}
+	d->m_index[d->m_index_len].ts = ts;
+	d->m_index[d->m_index_len].offset = (uint64_t)offset;
+	d->m_index_len++;
+	d->m_index_next_offset = (uint64_t)offset + d->m_index_interval;
+	return true;
+}
 
-	res = scap_dump_open_gzfile(handle, f, fname, skip_proc_scan);
-	//
-	// If the user doesn't need the thread table, free it
-	//
-	if(handle->m_proclist.m_proc_callback != NULL)
+//
+// Write an index block (event index or checkpoints), after the last event
+//
+static int32_t scap_write_index_block(scap_dumper_t *d, uint32_t block_type, const evt_index_entry* entries, uint64_t n_entries, uint64_t interval)
+{
+	block_header bh;
+	evt_index_header ih;
+	uint32_t bt;
+	uint64_t max_entries = (UINT32_MAX - sizeof(bh) - sizeof(ih) - sizeof(bt)) / sizeof(evt_index_entry);
+	uint64_t entries_len;
+
+	ih.n_entries = n_entries < max_entries ? n_entries : max_entries;
+	ih.interval = interval;
+	entries_len = ih.n_entries * sizeof(evt_index_entry);
+
+	// All the fields are multiple of 4 bytes, no padding needed
+	bh.block_type = block_type;
+	bh.block_total_length = sizeof(bh) + sizeof(ih) + entries_len + sizeof(bt);
+	bt = bh.block_total_length;
+
+	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh) ||
+	   scap_dump_write(d, &ih, sizeof(ih)) != sizeof(ih) ||
+	   scap_dump_write(d, (void*)entries, entries_len) != entries_len ||
+	   scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
 	{
-		scap_proc_free_table(&handle->m_proclist);
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (%s index)",
+			 block_type == CKIDX_BLOCK_TYPE ? "checkpoint" : "event");
+		return SCAP_FAILURE;
 	}
 
-	return res;
+	return SCAP_SUCCESS;
 }
 
-//
-// Open a savefile for writing, using the provided fd
-scap_dumper_t* scap_dump_open_fd(scap_t *handle, int fd, compression_mode compress, bool skip_proc_scan)
+int32_t scap_dump_checkpoint(scap_t *handle, scap_dumper_t *d, scap_dumper_t *state, uint64_t ts)
 {
-	gzFile f = NULL;
-	scap_dumper_t* res;
+	block_header bh;
+	ckpt_header ch;
+	uint32_t bt;
+	scap_dumper_t* hdr;
+	uint8_t* ckpt;
+	int64_t offset;
+	uint64_t state_len = state->m_targetbufcurpos - state->m_targetbuf;
+	uint64_t hdr_len;
+	int32_t res = SCAP_FAILURE;
 
-	switch(compress)
+	if(d->m_type != DT_FILE)
 	{
-	case SCAP_COMPRESSION_GZIP:
-		f = gzdopen(fd, "wb");
-		break;
-	case SCAP_COMPRESSION_NONE:
-		f = gzdopen(fd, "wbT");
-		break;
-	default:
-		ASSERT(false);
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid compression mode");
-		return NULL;
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "checkpoints are only supported by file dumpers");
+		return SCAP_NOT_SUPPORTED;
 	}
-	
-	if(f == NULL)
+
+	if(d->m_ckpts_len > 0 && ts < d->m_ckpts[d->m_ckpts_len - 1].ts)
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open fd %d", fd);
-		return NULL;
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "checkpoint older than the previous one");
+		return SCAP_FAILURE;
 	}
 
-	//
-	// If we're dumping in live mode, refresh the process tables list
-	// so we don't lose information about processes created in the interval
-	// between opening the handle and starting the dump
-	//
-	if(handle->m_mode != SCAP_MODE_CAPTURE && !skip_proc_scan)
+	if(d->m_ckpts_len == d->m_ckpts_size)
 	{
-		if(scap_dump_rescan_proc(handle) != SCAP_SUCCESS)
+		uint64_t size = d->m_ckpts_size == 0 ? 64 : 2 * d->m_ckpts_size;
+		evt_index_entry* ckpts = (evt_index_entry*)realloc(d->m_ckpts, size * sizeof(evt_index_entry));
+		if(ckpts == NULL)
 		{
-			return NULL;
+			snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the checkpoint index");
+			return SCAP_FAILURE;
 		}
+		d->m_ckpts = ckpts;
+		d->m_ckpts_size = size;
 	}
 
-	res = scap_dump_open_gzfile(handle, f, "", skip_proc_scan);
-
 	//
-	// If the user doesn't need the thread table, free it
+	// Build the beginning of the section, the length in the checkpoint
+	// block is known once the host info is written
 	//
-	if(handle->m_proclist.m_proc_callback != NULL)
+	hdr = scap_managedbuf_dump_create();
+	if(hdr == NULL)
 	{
-		scap_proc_free_table(&handle->m_proclist);
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the checkpoint buffer");
+		return SCAP_FAILURE;
 	}
-	return res;
-}
 
-//
-// Open a memory "savefile"
-//
-scap_dumper_t *scap_memory_dump_open(scap_t *handle, uint8_t* targetbuf, uint64_t targetbufsize)
-{
-	scap_dumper_t* res = (scap_dumper_t*)malloc(sizeof(scap_dumper_t));
-	if(res == NULL)
+	bh.block_type = CKPT_BLOCK_TYPE;
+	bh.block_total_length = sizeof(bh) + sizeof(ch) + sizeof(bt);
+	bt = bh.block_total_length;
+	ch.ts = ts;
+	ch.length = 0;
+
+	if(!scap_write_section_header(hdr) ||
+	   scap_dump_write(hdr, &bh, sizeof(bh)) != sizeof(bh) ||
+	   scap_dump_write(hdr, &ch, sizeof(ch)) != sizeof(ch) ||
+	   scap_dump_write(hdr, &bt, sizeof(bt)) != sizeof(bt) ||
+	   (handle->m_mode != SCAP_MODE_PLUGIN && scap_write_host_info(handle, hdr) != SCAP_SUCCESS))
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scap_dump_memory_open memory allocation failure (1)");
-		return NULL;
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing the checkpoint: %.200s", hdr->m_lasterr);
+		goto out;
 	}
 
-	res->m_f = NULL;
-	res->m_type = DT_MEM;
-	res->m_targetbuf = targetbuf;
-	res->m_targetbufcurpos = targetbuf;
-	res->m_targetbufend = targetbuf + targetbufsize;
+	hdr_len = hdr->m_targetbufcurpos - hdr->m_targetbuf;
+	ckpt = hdr->m_targetbuf + sizeof(block_header) + sizeof(section_header_block) + sizeof(bt) + sizeof(bh);
+	ch.length = hdr_len - (ckpt + sizeof(ch) + sizeof(bt) - hdr->m_targetbuf) + state_len;
+	memcpy(ckpt, &ch, sizeof(ch));
 
-	if(scap_setup_dump(handle, res, "") != SCAP_SUCCESS)
+	offset = scap_dump_ftell(d);
+	if(offset < 0)
 	{
-		strcpy(handle->m_lasterr, res->m_lasterr);
-		free(res);
-		res = NULL;
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error getting the checkpoint offset");
+		goto out;
 	}
 
-	return res;
-}
-
-//
-// Create a dumper with an internally managed buffer
-//
-scap_dumper_t *scap_managedbuf_dump_create()
-{
-	scap_dumper_t *res = (scap_dumper_t *)malloc(sizeof(scap_dumper_t));
-	if(res == NULL)
+	if(scap_dump_write(d, hdr->m_targetbuf, hdr_len) != hdr_len ||
+	   scap_dump_write(d, state->m_targetbuf, state_len) != state_len)
 	{
-		return NULL;
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (checkpoint)");
+		goto out;
 	}
 
-	res->m_f = NULL;
-	res->m_type = DT_MANAGED_BUF;
-	res->m_targetbuf = (uint8_t *)malloc(PPM_DUMPER_MANAGED_BUF_SIZE);
-	res->m_targetbufcurpos = res->m_targetbuf;
-	res->m_targetbufend = res->m_targetbuf + PPM_DUMPER_MANAGED_BUF_SIZE;
+	d->m_ckpts[d->m_ckpts_len].ts = ts;
+	d->m_ckpts[d->m_ckpts_len].offset = (uint64_t)offset;
+	d->m_ckpts_len++;
+	res = SCAP_SUCCESS;
 
+	// The readers seeking to the checkpoint don't know the strings
+	// written before
+	if(d->m_strdict != NULL)
+	{
+		scap_dump_strdict_clear(d->m_strdict);
+	}
+
+out:
+	scap_dump_close(hdr);
 	return res;
 }
 
@@ -1325,13 +2833,41 @@ void scap_dump_close(scap_dumper_t *d)
 {
 	if(d->m_type == DT_FILE)
 	{
-		gzclose(d->m_f);
+		// The event index stays the last block, see load_event_index()
+		if(d->m_ckpts_len > 0)
+		{
+			scap_write_index_block(d, CKIDX_BLOCK_TYPE, d->m_ckpts, d->m_ckpts_len, 0);
+		}
+
+		if(d->m_index_len > 0)
+		{
+			scap_write_index_block(d, EVIDX_BLOCK_TYPE, d->m_index, d->m_index_len, d->m_index_interval);
+		}
+
+#ifndef _WIN32
+		if(d->m_async != NULL)
+		{
+			scap_dump_async_stop(d);
+		}
+#endif
+
+		if(d->m_stream != NULL)
+		{
+			scap_dump_stream_close(d->m_stream);
+		}
+		else
+		{
+			gzclose(d->m_f);
+		}
 	}
 	else if (d->m_type == DT_MANAGED_BUF)
 	{
 		free(d->m_targetbuf);
 	}
 
+	scap_dump_strdict_free(d);
+	free(d->m_index);
+	free(d->m_ckpts);
 	free(d);
 }
 
@@ -1342,7 +2878,17 @@ int64_t scap_dump_get_offset(scap_dumper_t *d)
 {
 	if(d->m_type == DT_FILE)
 	{
-		return gzoffset(d->m_f);
+#ifndef _WIN32
+		if(d->m_async != NULL)
+		{
+			// The file belongs to the writer thread, use what it last saw
+			pthread_mutex_lock(&d->m_async->m_lock);
+			int64_t offset = d->m_async->m_offset;
+			pthread_mutex_unlock(&d->m_async->m_lock);
+			return offset;
+		}
+#endif
+		return scap_dump_file_offset(d);
 	}
 	else
 	{
@@ -1354,7 +2900,13 @@ int64_t scap_dump_ftell(scap_dumper_t *d)
 {
 	if(d->m_type == DT_FILE)
 	{
-		return gztell(d->m_f);
+#ifndef _WIN32
+		if(d->m_async != NULL)
+		{
+			return (int64_t)(d->m_async->m_base_tell + d->m_async->m_accepted);
+		}
+#endif
+		return scap_dump_file_tell(d);
 	}
 	else
 	{
@@ -1366,8 +2918,91 @@ void scap_dump_flush(scap_dumper_t *d)
 {
 	if(d->m_type == DT_FILE)
 	{
-		gzflush(d->m_f, Z_FULL_FLUSH);
+#ifndef _WIN32
+		// The writer thread is idle once everything is written
+		if(d->m_async != NULL && !scap_dump_async_drain(d->m_async))
+		{
+			return;
+		}
+#endif
+		if(d->m_stream != NULL)
+		{
+			scap_dump_stream_flush(d->m_stream);
+		}
+		else
+		{
+			gzflush(d->m_f, Z_FULL_FLUSH);
+		}
+#ifndef _WIN32
+		if(d->m_async != NULL)
+		{
+			pthread_mutex_lock(&d->m_async->m_lock);
+			d->m_async->m_offset = scap_dump_file_offset(d);
+			pthread_mutex_unlock(&d->m_async->m_lock);
+		}
+#endif
+	}
+}
+
+//
+// Write an event with its strings replaced by references, preceded by the
+// strings new to the dictionary
+//
+static int32_t scap_dump_strdict_event(scap_dumper_t *d, scap_evt *e, uint16_t cpuid, uint32_t flags)
+{
+	struct scap_dump_strdict* sd = d->m_strdict;
+	block_header bh;
+	uint32_t bt;
+	uint32_t mask;
+	scap_evt* ev;
+
+	//
+	// An indexed event starts a new dictionary, so that the readers can
+	// start from it
+	//
+	if(d->m_index_interval != 0 && scap_dump_index_event(d, e->ts))
+	{
+		scap_dump_strdict_clear(sd);
+	}
+
+	mask = scap_dump_strdict_encode(sd, e);
+	ev = mask != 0 ? (scap_evt*)sd->m_evt : e;
+
+	bh.block_type = EVD_BLOCK_TYPE;
+	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + sizeof(cpuid) + sizeof(flags) +
+							 sizeof(mask) + ev->len + 4);
+	bt = bh.block_total_length;
+
+#ifndef _WIN32
+	if(d->m_async != NULL && !d->m_async->m_no_drop &&
+	   !scap_dump_async_reserve(d->m_async, bh.block_total_length +
+	                                        (sd->m_n_new != 0 ? scap_strdict_block_len(sd) : 0)))
+	{
+		scap_dump_strdict_rollback(sd);
+		d->m_dropped++;
+		return SCAP_SUCCESS;
+	}
+#endif
+
+	if(sd->m_n_new != 0 && scap_write_strdict_block(d, sd) != SCAP_SUCCESS)
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (strdict)");
+		return SCAP_FAILURE;
+	}
+
+	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh) ||
+	   scap_dump_write(d, &cpuid, sizeof(cpuid)) != sizeof(cpuid) ||
+	   scap_dump_write(d, &flags, sizeof(flags)) != sizeof(flags) ||
+	   scap_dump_write(d, &mask, sizeof(mask)) != sizeof(mask) ||
+	   scap_dump_write(d, ev, ev->len) != ev->len ||
+	   scap_write_padding(d, sizeof(cpuid) + ev->len) != SCAP_SUCCESS ||
+	   scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		snprintf(d->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (evd)");
+		return SCAP_FAILURE;
 	}
+
+	return SCAP_SUCCESS;
 }
 
 //
@@ -1380,6 +3015,31 @@ int32_t scap_dump(scap_dumper_t *d, scap_evt *e, uint16_t cpuid, uint32_t flags)
 	bool large_payload = flags & SCAP_DF_LARGE;
 
 	flags &= ~SCAP_DF_LARGE;
+
+	if(d->m_strdict != NULL && !large_payload)
+	{
+		return scap_dump_strdict_event(d, e, cpuid, flags);
+	}
+
+#ifndef _WIN32
+	//
+	// In async mode, drop the event rather than waiting for the writer
+	// thread if all the buffers are full
+	//
+	if(d->m_async != NULL && !d->m_async->m_no_drop &&
+	   !scap_dump_async_reserve(d->m_async, sizeof(block_header) + (flags ? sizeof(flags) : 0) +
+	                                        scap_normalize_block_len(sizeof(cpuid) + e->len) + sizeof(bt)))
+	{
+		d->m_dropped++;
+		return SCAP_SUCCESS;
+	}
+#endif
+
+	if(d->m_index_interval != 0)
+	{
+		scap_dump_index_event(d, e->ts);
+	}
+
 	if(flags == 0)
 	{
 		//
@@ -154,6 +154,113 @@ typedef struct _section_header_block
 
 #define EVF_BLOCK_TYPE_V2_LARGE		0x222
 
+///////////////////////////////////////////////////////////////////////////////
+// EVENT INDEX BLOCK
+///////////////////////////////////////////////////////////////////////////////
+// Optional, written after the last event of a capture. Maps timestamps to the
+// offsets of the event blocks, so that a reader can seek to a point in time
+// without reading all the events before it. Readers that don't know it just
+// stop at it, as it comes after all the events.
+#define EVIDX_BLOCK_TYPE		0x223
+
+typedef struct _evt_index_header
+{
+	uint64_t n_entries;
+	uint64_t interval; // Minimum distance in bytes between two indexed events
+}evt_index_header;
+
+typedef struct _evt_index_entry
+{
+	uint64_t ts;
+	uint64_t offset; // Offset of the event block, in uncompressed bytes
+}evt_index_entry;
+
+///////////////////////////////////////////////////////////////////////////////
+// STATE CHECKPOINTS
+///////////////////////////////////////////////////////////////////////////////
+// A checkpoint saves the state of the capture (processes, fds, containers,
+// users...) between two events, so that a reader can start from it instead
+// of parsing all the events before. It's a new section: a section header
+// block, then a checkpoint block, then the same blocks as at the beginning
+// of the capture, including the state events. The checkpoint block tells
+// the readers reading the events in order to skip the rest of the section.
+// Readers that don't know it restart the capture at the section header and
+// skip the checkpoint block, so they just reset their state to the saved one.
+#define CKPT_BLOCK_TYPE		0x224
+
+typedef struct _ckpt_header
+{
+	uint64_t ts; // Timestamp of the last event before the checkpoint
+	uint64_t length; // Bytes after this block up to the first event after the checkpoint
+}ckpt_header;
+
+// Optional, the offsets of the section headers of the checkpoints as
+// evt_index_entry, with the timestamps of the checkpoints. Written after
+// the last event, before the event index if there is one.
+#define CKIDX_BLOCK_TYPE		0x225
+
+///////////////////////////////////////////////////////////////////////////////
+// STRING DICTIONARY
+///////////////////////////////////////////////////////////////////////////////
+// Optional, see scap_dump_enable_strdict(). The string params repeating
+// across the events (paths, comms, command lines...) are written once in a
+// dictionary block, and the events refer to them by number. A dictionary
+// block adds its strings to the dictionary from first_id on, each one as a
+// 16 bits length followed by its bytes. A block with first_id 0 starts a
+// new dictionary: the writer starts one at every indexed event and after
+// every checkpoint, so that the readers seeking there don't need the
+// strings written before.
+#define STRDICT_BLOCK_TYPE		0x226
+
+typedef struct _strdict_header
+{
+	uint32_t first_id;
+	uint32_t n_strings;
+}strdict_header;
+
+// Limits of a dictionary, once reached a new one is started
+#define STRDICT_MAX_STRINGS		65536
+#define STRDICT_MAX_BYTES		(16 * 1024 * 1024)
+// Shorter strings are not worth a reference, longer ones rarely repeat
+#define STRDICT_MIN_STRING_LEN	8
+#define STRDICT_MAX_STRING_LEN	4096
+
+// An event block with flags whose string params may be references to the
+// dictionary: after the cpuid and the flags, a 32 bits mask tells which of
+// the first 32 params hold the 32 bits number of a string instead of their
+// value. Only used for the events of the non large block types.
+#define EVD_BLOCK_TYPE			0x227
+
+///////////////////////////////////////////////////////////////////////////////
+// BLOCK COMPRESSED CAPTURES
+///////////////////////////////////////////////////////////////////////////////
+// Captures written with SCAP_COMPRESSION_GZIP_BLOCKS are a sequence of
+// independent gzip members, each compressing up to GZBLOCK_DATA_SIZE bytes
+// of the capture. That's still a valid gzip file, but the header of each
+// member carries the member size in an extra subfield, so that the readers
+// can find the members without inflating them, and inflate them in parallel.
+#define GZBLOCK_DATA_SIZE		(1024 * 1024)
+// Members inflating to more than this are considered corrupted
+#define GZBLOCK_MAX_DATA_SIZE	(64 * 1024 * 1024)
+#define GZBLOCK_SI1				'S'
+#define GZBLOCK_SI2				'C'
+// gzip header (10), XLEN (2), subfield header (4), member size (4)
+#define GZBLOCK_HEADER_LEN		20
+// CRC32 (4), ISIZE (4)
+#define GZBLOCK_TRAILER_LEN		8
+
+///////////////////////////////////////////////////////////////////////////////
+// ZSTD AND LZ4 CAPTURES
+///////////////////////////////////////////////////////////////////////////////
+// Captures written with SCAP_COMPRESSION_ZSTD and SCAP_COMPRESSION_LZ4 are
+// plain zstd or lz4 frame streams, that the readers recognize from the
+// magic number at the start of the file (little endian)
+#define ZSTD_FRAME_MAGIC		0xFD2FB528
+#define LZ4_FRAME_MAGIC			0x184D2204
+// The writers compress the capture in chunks of this size, each ending
+// with a flush so that the chunks written so far can be read back
+#define STREAM_CHUNK_SIZE		(1024 * 1024)
+
 #if defined __sun
 #pragma pack()
 #else
@@ -34,17 +34,38 @@ typedef enum ppm_dumper_type
 	DT_MANAGED_BUF = 2,
 } ppm_dumper_type;
 
+struct scap_dump_stream;
+struct scap_dump_async;
+struct scap_dump_strdict;
+
 #define PPM_DUMPER_MANAGED_BUF_SIZE (3 * 1024 * 1024)
 #define PPM_DUMPER_MANAGED_BUF_RESIZE_FACTOR (1.25)
 
 typedef struct scap_dumper
 {
 	gzFile m_f;
+	// Used instead of m_f for the compression modes gzFile doesn't handle
+	struct scap_dump_stream* m_stream;
+	// Writer thread, see scap_dump_enable_async()
+	struct scap_dump_async* m_async;
+	uint64_t m_dropped;
 	ppm_dumper_type m_type;
 	uint8_t* m_targetbuf;
 	uint8_t* m_targetbufcurpos;
 	uint8_t* m_targetbufend;
 	char m_lasterr[SCAP_LASTERR_SIZE];
+	// Index of the event blocks, see scap_dump_enable_index()
+	uint64_t m_index_interval;
+	uint64_t m_index_next_offset;
+	struct _evt_index_entry* m_index;
+	uint64_t m_index_len;
+	uint64_t m_index_size;
+	// State checkpoints written so far, see scap_dump_checkpoint()
+	struct _evt_index_entry* m_ckpts;
+	uint64_t m_ckpts_len;
+	uint64_t m_ckpts_size;
+	// String dictionary, see scap_dump_enable_strdict()
+	struct scap_dump_strdict* m_strdict;
 } scap_dumper_t;
 
 typedef struct scap scap_t;
@@ -58,7 +79,15 @@ struct iovec;
 typedef enum compression_mode
 {
 	SCAP_COMPRESSION_NONE = 0,
-	SCAP_COMPRESSION_GZIP = 1
+	SCAP_COMPRESSION_GZIP = 1,
+	// gzip, in independent blocks that the readers can inflate in parallel
+	SCAP_COMPRESSION_GZIP_BLOCKS = 2,
+	// Streaming zstd frames, much cheaper than gzip at a similar ratio.
+	// Only available if libscap is built with zstd support
+	SCAP_COMPRESSION_ZSTD = 3,
+	// Streaming lz4 frames, the cheapest to write but the biggest files.
+	// Only available if libscap is built with lz4 support
+	SCAP_COMPRESSION_LZ4 = 4
 } compression_mode;
 
 uint8_t* scap_get_memorydumper_curpos(scap_dumper_t *d);
@@ -146,6 +175,79 @@ void scap_dump_flush(scap_dumper_t *d);
 */
 int32_t scap_dump(scap_dumper_t *d, scap_evt* e, uint16_t cpuid, uint32_t flags);
 
+/*!
+  \brief Make the dumper append an index of the events to the trace file,
+  which allows the readers to seek to a timestamp (see \ref scap_fseek_ts).
+  Only supported by the file dumpers, must be called before dumping the first event.
+
+  \param d The dump handle, returned by \ref scap_dump_open
+  \param interval Minimum distance, in bytes, between two indexed events. 0 disables the index.
+
+  \return SCAP_SUCCESS if the call is successful.
+*/
+int32_t scap_dump_enable_index(scap_dumper_t *d, uint64_t interval);
+
+/*!
+  \brief Make the dumper write the string params repeating across the events,
+  like paths, comms and command lines, once in a dictionary, and refer to them
+  from the events. The savefile readers expand them back transparently, but
+  the readers predating the dictionary can't read the file. Only supported by
+  the file dumpers.
+
+  \param d The dump handle, returned by \ref scap_dump_open
+  \param enable true to enable the dictionary.
+
+  \return SCAP_SUCCESS if the call is successful.
+*/
+int32_t scap_dump_enable_strdict(scap_dumper_t *d, bool enable);
+
+/*!
+  \brief Move the writes of a file dumper, compression included, to a background
+  thread, so that a slow disk doesn't stall the thread that dumps the events.
+  The events are copied into nbufs preallocated buffers of bufsize bytes each, and
+  the thread writes the full ones in order. When no buffer is available, \ref scap_dump
+  drops the event instead of waiting, see \ref scap_dump_get_dropped_events.
+  Only supported by the file dumpers. \ref scap_dump_get_offset lags behind the data
+  still queued, \ref scap_dump_flush and \ref scap_dump_close wait for it to be written.
+
+  \param d The dump handle, returned by \ref scap_dump_open
+  \param bufsize Size of each buffer. 0 writes the queued data and goes back to synchronous writes.
+  \param nbufs Number of buffers, at least 2.
+
+  \return SCAP_SUCCESS if the call is successful.
+*/
+int32_t scap_dump_enable_async(scap_dumper_t *d, uint32_t bufsize, uint32_t nbufs);
+
+/*!
+  \brief Return the number of events that \ref scap_dump dropped because the
+  asynchronous writes couldn't keep up.
+*/
+uint64_t scap_dump_get_dropped_events(scap_dumper_t *d);
+
+/*!
+  \brief Choose whether, with asynchronous writes, \ref scap_dump drops the events
+  when no buffer is available (the default) or waits for the writer thread. Waiting
+  is meant for the events that the readers can't do without, like those of the
+  state written at the beginning of a file. No effect on synchronous dumpers.
+*/
+void scap_dump_set_async_drop(scap_dumper_t *d, bool drop);
+
+/*!
+  \brief Write a state checkpoint to a trace file, so that the readers can start
+  from it (see \ref scap_fseek_checkpoint). The machine info, interface list and
+  user list are taken from the handle, the rest of the state, usually the process
+  list with the fds and the state events, must have been written to a managed
+  buffer dumper. Only supported by the file dumpers.
+
+  \param handle Handle to the capture instance.
+  \param d The dump handle, returned by \ref scap_dump_open
+  \param state Dumper created by \ref scap_managedbuf_dump_create holding the state.
+  \param ts Timestamp of the last event written before the checkpoint.
+
+  \return SCAP_SUCCESS if the call is successful.
+*/
+int32_t scap_dump_checkpoint(scap_t *handle, scap_dumper_t *d, scap_dumper_t *state, uint64_t ts);
+
 /*!
   \brief Return a string with the last error that happened on the given dumper.
 */
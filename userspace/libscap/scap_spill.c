@@ -0,0 +1,188 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "scap.h"
+#include "scap-int.h"
+#include "scap_spill.h"
+#ifndef _WIN32
+#include "debug_log_helpers.h"
+#endif
+
+struct scap_spill_hdr
+{
+	uint32_t len;
+	uint16_t cpuid;
+	uint16_t reserved;
+};
+
+#define SPILL_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+//
+// Returns false once the buffer is full
+//
+static bool scap_spill_add(struct scap_spill* spill, scap_evt* pevent, uint16_t cpuid)
+{
+	uint64_t needed = sizeof(struct scap_spill_hdr) + SPILL_ALIGN(pevent->len);
+	bool fits = spill->m_len + needed <= spill->m_size;
+
+	if(!fits)
+	{
+		//
+		// The engine has already moved past this event, so it's kept
+		// beyond the size rather than lost, and the draining stops
+		//
+		uint8_t* buf = realloc(spill->m_buf, spill->m_len + needed);
+		spill->m_full = true;
+		if(buf == NULL)
+		{
+			return false;
+		}
+		spill->m_buf = buf;
+	}
+
+	struct scap_spill_hdr* hdr = (struct scap_spill_hdr*)(spill->m_buf + spill->m_len);
+	hdr->len = pevent->len;
+	hdr->cpuid = cpuid;
+	hdr->reserved = 0;
+	memcpy(hdr + 1, pevent, pevent->len);
+	spill->m_len += needed;
+	spill->m_n_evts++;
+	return fits;
+}
+
+#ifndef _WIN32
+struct scap_spill_drainer
+{
+	scap_t* handle;
+	pthread_t thread;
+	bool stop;
+};
+
+static void* scap_spill_drain(void* arg)
+{
+	struct scap_spill_drainer* drainer = arg;
+	scap_t* handle = drainer->handle;
+	scap_evt* pevent;
+	uint16_t cpuid;
+
+	while(!__atomic_load_n(&drainer->stop, __ATOMIC_ACQUIRE))
+	{
+		int32_t res = handle->m_vtable->next(handle->m_engine, &pevent, &cpuid);
+		if(res == SCAP_TIMEOUT)
+		{
+			continue;
+		}
+
+		//
+		// On errors, stop here: scap_next() gets them again once the
+		// buffered events have been returned
+		//
+		if(res != SCAP_SUCCESS || !scap_spill_add(&handle->m_spill, pevent, cpuid))
+		{
+			break;
+		}
+	}
+
+	return NULL;
+}
+#endif
+
+int32_t scap_spill_start(scap_t* handle, uint64_t size)
+{
+#ifndef _WIN32
+	struct scap_spill* spill = &handle->m_spill;
+	struct scap_spill_drainer* drainer;
+
+	spill->m_buf = malloc(size);
+	drainer = calloc(1, sizeof(*drainer));
+	if(spill->m_buf == NULL || drainer == NULL)
+	{
+		scap_debug_log(handle, "Not buffering the events during the /proc scan: can't allocate %" PRIu64 " bytes", size);
+		free(drainer);
+		scap_spill_free(spill);
+		return SCAP_FAILURE;
+	}
+	spill->m_size = size;
+	spill->m_len = 0;
+	spill->m_pos = 0;
+	spill->m_n_evts = 0;
+	spill->m_full = false;
+	drainer->handle = handle;
+
+	int err = pthread_create(&drainer->thread, NULL, scap_spill_drain, drainer);
+	if(err != 0)
+	{
+		scap_debug_log(handle, "Not buffering the events during the /proc scan: can't start the thread (%s)", strerror(err));
+		free(drainer);
+		scap_spill_free(spill);
+		return SCAP_FAILURE;
+	}
+
+	spill->m_drainer = drainer;
+	return SCAP_SUCCESS;
+#else
+	return SCAP_NOT_SUPPORTED;
+#endif
+}
+
+void scap_spill_stop(scap_t* handle)
+{
+#ifndef _WIN32
+	struct scap_spill* spill = &handle->m_spill;
+	struct scap_spill_drainer* drainer = spill->m_drainer;
+
+	if(drainer == NULL)
+	{
+		return;
+	}
+
+	__atomic_store_n(&drainer->stop, true, __ATOMIC_RELEASE);
+	pthread_join(drainer->thread, NULL);
+	free(drainer);
+	spill->m_drainer = NULL;
+
+	scap_debug_log(handle, "Buffered %" PRIu64 " events (%" PRIu64 " bytes) during the /proc scan%s",
+		       spill->m_n_evts, spill->m_len,
+		       spill->m_full ? ", the buffer filled up" : "");
+#endif
+}
+
+void scap_spill_next(struct scap_spill* spill, scap_evt** pevent, uint16_t* pcpuid)
+{
+	struct scap_spill_hdr* hdr = (struct scap_spill_hdr*)(spill->m_buf + spill->m_pos);
+
+	*pevent = (scap_evt*)(hdr + 1);
+	*pcpuid = hdr->cpuid;
+	spill->m_pos += sizeof(*hdr) + SPILL_ALIGN(hdr->len);
+}
+
+void scap_spill_free(struct scap_spill* spill)
+{
+	free(spill->m_buf);
+	spill->m_buf = NULL;
+	spill->m_size = 0;
+	spill->m_len = 0;
+	spill->m_pos = 0;
+}
@@ -0,0 +1,83 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ppm_evt_hdr;
+struct scap;
+
+//
+// The events read from the engine while the initial /proc scan runs, so
+// that they don't pile up in the kernel buffers and get dropped (see
+// proc_scan_spill_bytes). scap_next() returns them before reading the
+// engine again, once the scan has built the state they apply to.
+//
+struct scap_spill
+{
+	// Each event is preceded by a scap_spill_hdr and padded to 8 bytes
+	uint8_t* m_buf;
+	uint64_t m_size;
+	uint64_t m_len;
+	// Offset of the next event returned by scap_spill_next()
+	uint64_t m_pos;
+	uint64_t m_n_evts;
+
+	// Set when the buffer filled up: the following events were left
+	// in the engine
+	bool m_full;
+
+	// The thread draining the engine during the scan, NULL once stopped
+	void* m_drainer;
+};
+
+//
+// Start draining the engine into a buffer of the given size from another
+// thread. The engine must not be read by anyone else until
+// scap_spill_stop() is called. On failure, the events are simply left in
+// the engine.
+//
+int32_t scap_spill_start(struct scap* handle, uint64_t size);
+
+//
+// Stop draining the engine, keeping the events read so far for
+// scap_spill_next()
+//
+void scap_spill_stop(struct scap* handle);
+
+static inline bool scap_spill_pending(const struct scap_spill* spill)
+{
+	return spill->m_pos < spill->m_len;
+}
+
+//
+// Return the next buffered event, if scap_spill_pending(). The events stay
+// valid until scap_spill_free().
+//
+void scap_spill_next(struct scap_spill* spill, struct ppm_evt_hdr** pevent, uint16_t* pcpuid);
+
+void scap_spill_free(struct scap_spill* spill);
+
+#ifdef __cplusplus
+}
+#endif
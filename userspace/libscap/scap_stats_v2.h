@@ -41,6 +41,12 @@ extern "C" {
 #define PPM_SCAP_STATS_KERNEL_COUNTERS (1 << 0)
 #define PPM_SCAP_STATS_LIBBPF_STATS (1 << 1)
 #define PPM_SCAP_STATS_RESOURCE_UTILIZATION (1 << 2)
+#define PPM_SCAP_STATS_RULES_PROFILE (1 << 3)
+#define PPM_SCAP_STATS_LATENCY (1 << 4)
+#define PPM_SCAP_STATS_PARSE_COUNTERS (1 << 5)
+#define PPM_SCAP_STATS_WORKLOAD_COUNTERS (1 << 6)
+#define PPM_SCAP_STATS_BUFFERS (1 << 7)
+#define PPM_SCAP_STATS_MEMORY (1 << 8)
 
 typedef union scap_stats_v2_value {
 	uint32_t u32;
@@ -64,6 +64,8 @@ int32_t scap_suppress_init(struct scap_suppress* suppress, const char** suppress
 	suppress->m_num_suppressed_comms = 0;
 	suppress->m_suppressed_tids = NULL;
 	suppress->m_num_suppressed_evts = 0;
+	suppress->m_tid_cb = NULL;
+	suppress->m_tid_cb_ctx = NULL;
 
 	if(suppressed_comms)
 	{
@@ -117,6 +119,25 @@ void scap_suppress_close(struct scap_suppress* suppress)
 	}
 }
 
+bool scap_remove_suppressed_tid(struct scap_suppress *suppress, uint64_t tid)
+{
+	scap_tid *stid;
+	HASH_FIND_INT64(suppress->m_suppressed_tids, &tid, stid);
+	if(stid == NULL)
+	{
+		return false;
+	}
+
+	HASH_DEL(suppress->m_suppressed_tids, stid);
+	free(stid);
+
+	if(suppress->m_tid_cb)
+	{
+		suppress->m_tid_cb(suppress->m_tid_cb_ctx, tid, false);
+	}
+	return true;
+}
+
 int32_t scap_update_suppressed(struct scap_suppress *suppress,
 			       const char *comm,
 			       uint64_t tid, uint64_t ptid,
@@ -169,11 +190,15 @@ int32_t scap_update_suppressed(struct scap_suppress *suppress,
 			return SCAP_FAILURE;
 		}
 		*suppressed = true;
+
+		if(suppress->m_tid_cb)
+		{
+			suppress->m_tid_cb(suppress->m_tid_cb_ctx, tid, true);
+		}
 	}
 	else if (!*suppressed && stid != NULL)
 	{
-		HASH_DEL(suppress->m_suppressed_tids, stid);
-		free(stid);
+		scap_remove_suppressed_tid(suppress, tid);
 		*suppressed = false;
 	}
 
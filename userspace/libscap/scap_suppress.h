@@ -46,6 +46,12 @@ struct scap_suppress
 	// The number of events that were skipped due to the comm
 	// matching an entry in m_suppressed_comms.
 	uint64_t m_num_suppressed_evts;
+
+	// If set, called every time a tid is added to or removed from
+	// m_suppressed_tids, so that the driver can drop the events
+	// of the suppressed threads too.
+	void (*m_tid_cb)(void *ctx, uint64_t tid, bool suppressed);
+	void *m_tid_cb_ctx;
 };
 
 int32_t scap_suppress_init(struct scap_suppress* suppress, const char** suppressed_comms);
@@ -67,6 +73,10 @@ int32_t scap_update_suppressed(struct scap_suppress *suppress,
 			       uint64_t tid, uint64_t ptid,
 			       bool *suppressed);
 
+// Removes tid from the set of suppressed tids, if present.
+// Returns whether it was suppressed.
+bool scap_remove_suppressed_tid(struct scap_suppress *suppress, uint64_t tid);
+
 void scap_suppress_close(struct scap_suppress* suppress);
 
 #ifdef __cplusplus
@@ -84,8 +84,50 @@ enum scap_setting {
 	 * arg1: whether to enabled or disable the feature
 	 */
 	SCAP_DROP_FAILED,
+	/**
+	 * @brief tell drivers to drop the syscall events of some comms
+	 * arg1: pointer to a `struct ppm_suppressed_comms`
+	 */
+	SCAP_SUPPRESSED_COMMS,
+	/**
+	 * @brief tell drivers to (stop) drop(ping) the syscall events of a thread
+	 * arg1: tid
+	 * arg2: whether the thread is suppressed
+	 */
+	SCAP_SUPPRESSED_TID,
+	/**
+	 * @brief set the snaplen of a kind of fd
+	 * arg1: the `enum ppm_snaplen_fd_type`
+	 * arg2: the snaplen, or `PPM_SNAPLEN_FD_TYPE_DEFAULT` to use the global one
+	 */
+	SCAP_FD_TYPE_SNAPLEN,
+	/**
+	 * @brief sample and/or rate limit the events of a syscall
+	 * arg1: the ppm_sc of the syscall
+	 * arg2: pointer to a `struct scap_syscall_limit`
+	 */
+	SCAP_SYSCALL_LIMIT,
+	/**
+	 * @brief cap the snaplen of the events written to a buffer
+	 * arg1: the buffer index, as returned in the cpuid of the events
+	 * arg2: the snaplen limit, or `PPM_SNAPLEN_NO_LIMIT` to remove it
+	 */
+	SCAP_BUFFER_SNAPLEN,
+	/**
+	 * @brief set how the cgroups listed in the cgroup filter are filtered
+	 * arg1: the `enum ppm_cgroup_filter_mode`
+	 */
+	SCAP_CGROUP_FILTER_MODE,
+	/**
+	 * @brief add or remove a cgroup from the cgroup filter
+	 * arg1: the cgroup id
+	 * arg2: whether the cgroup is listed
+	 */
+	SCAP_CGROUP_FILTER,
 };
 
+struct _evt_index_entry;
+
 struct scap_savefile_vtable {
 	/**
 	 * @brief return the current read position in the capture
@@ -101,6 +143,45 @@ struct scap_savefile_vtable {
 	 */
 	void (*fseek_capture)(struct scap_engine_handle engine, uint64_t off);
 
+	/**
+	 * @brief seek to the first event with a timestamp not lower than ts
+	 * @param engine the handle to the engine
+	 * @param ts the timestamp to seek to
+	 * @return SCAP_SUCCESS, or SCAP_NOT_SUPPORTED if the capture
+	 *         can't be seeked by time
+	 */
+	int32_t (*fseek_ts_capture)(struct scap_engine_handle engine, uint64_t ts);
+
+	/**
+	 * @brief move to the last state checkpoint older than ts, so that
+	 *        restarting the capture reads its state
+	 * @param engine wraps the pointer to the engine-specific handle
+	 * @param ts the timestamp to seek to
+	 * @return SCAP_SUCCESS, or SCAP_NOT_SUPPORTED if there is no such
+	 *         checkpoint
+	 */
+	int32_t (*fseek_checkpoint)(struct scap_engine_handle engine, uint64_t ts);
+
+	/**
+	 * @brief skip, without reading them, the events whose type or
+	 *        timestamp don't match
+	 * @param engine the handle to the engine
+	 * @param event_types PPM_EVENT_MAX flags, 1 for the events to read,
+	 *        or NULL for all of them
+	 * @param ts_min ts_max the timestamps of the events to read
+	 * @return SCAP_SUCCESS or a failure code
+	 */
+	int32_t (*set_read_filter)(struct scap_engine_handle engine, const uint8_t* event_types, uint64_t ts_min, uint64_t ts_max);
+
+	/**
+	 * @brief get the event index of the capture
+	 * @param engine the handle to the engine
+	 * @param entries set to the index entries, owned by the engine
+	 * @param n_entries set to the number of entries, 0 if there is no index
+	 * @return SCAP_SUCCESS or a failure code
+	 */
+	int32_t (*get_event_index)(struct scap_engine_handle engine, const struct _evt_index_entry** entries, uint64_t* n_entries);
+
 	/**
 	 * @brief restart a capture from the current offset
 	 * @param handle the full scap_t handle
@@ -186,6 +267,18 @@ struct scap_vtable {
 	 */
 	int32_t (*next)(struct scap_engine_handle engine, scap_evt **pevent, uint16_t *pcpuid);
 
+	/**
+	 * @brief look at an event that next() will return later, without consuming it
+	 * @param engine wraps the pointer to the engine-specific handle
+	 * @param cpuid the CPU of an event returned by next()
+	 * @param distance 1 for the event that follows it on the same CPU, 2 for the
+	 *                 one after, and so on
+	 * @return the event, or NULL if it isn't available yet
+	 *
+	 * Optional, meant for prefetching. The event is valid until the next call to next()
+	 */
+	scap_evt* (*peek)(struct scap_engine_handle engine, uint16_t cpuid, uint32_t distance);
+
 	/**
 	 * @brief start a capture
 	 * @param engine
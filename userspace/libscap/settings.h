@@ -25,3 +25,10 @@ limitations under the License.
 #endif // MINIMAL_BUILD
 
 #define SCAP_NODRIVER_MAX_FD_LOOKUP 20
+
+//
+// Max age of the sockets of a network namespace read from /proc, and min
+// interval between two reads of a namespace due to a socket not found in it
+//
+#define SCAP_SOCKET_CACHE_MAX_AGE_MS 5000
+#define SCAP_SOCKET_CACHE_MIN_REFRESH_MS 100
@@ -0,0 +1,353 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+#include <vector>
+#include <utility>
+#include <tuple>
+#include <chrono>
+#include <sys/eventfd.h>
+
+extern "C"
+{
+#include "scap.h"
+#include "scap-int.h"
+#include "ringbuffer/ringbuffer.h"
+}
+
+#define EVT_LEN (sizeof(struct ppm_evt_hdr))
+
+// Every device is backed by a plain memory buffer that we fill with synthetic events.
+class ringbuffer_merge : public testing::TestWithParam<std::tuple<scap_ringbuffer_merge_mode, uint32_t>>
+{
+protected:
+	void init(uint32_t ndevs, uint32_t evts_per_dev)
+	{
+		scap_open_args oargs = {};
+		oargs.ringbuffer_merge_mode = std::get<0>(GetParam());
+		oargs.ringbuffer_consume_chunk_b = std::get<1>(GetParam());
+		ASSERT_EQ(devset_init(&m_devset, ndevs, &oargs, m_error), SCAP_SUCCESS);
+		for(uint32_t j = 0; j < ndevs; j++)
+		{
+			scap_device* dev = &m_devset.m_devs[j];
+			// The producer position must never reach `m_buffer_size`, as in a real ring buffer.
+			dev->m_buffer_size = (evts_per_dev + 1) * EVT_LEN;
+			dev->m_buffer = (char*)calloc(1, dev->m_buffer_size);
+			dev->m_bufinfo = (struct ppm_ring_buffer_info*)calloc(1, sizeof(struct ppm_ring_buffer_info));
+		}
+	}
+
+	void TearDown() override
+	{
+		for(uint32_t j = 0; j < m_devset.m_ndevs; j++)
+		{
+			free(m_devset.m_devs[j].m_buffer);
+			free(m_devset.m_devs[j].m_bufinfo);
+			m_devset.m_devs[j].m_buffer = (char*)INVALID_MAPPING;
+			m_devset.m_devs[j].m_bufinfo = (struct ppm_ring_buffer_info*)INVALID_MAPPING;
+		}
+		devset_free(&m_devset);
+	}
+
+	void push(uint32_t dev_idx, uint64_t ts)
+	{
+		scap_device* dev = &m_devset.m_devs[dev_idx];
+		ASSERT_LT(dev->m_bufinfo->head + EVT_LEN, dev->m_buffer_size);
+		auto hdr = (struct ppm_evt_hdr*)(dev->m_buffer + dev->m_bufinfo->head);
+		hdr->ts = ts;
+		hdr->tid = dev_idx;
+		hdr->len = EVT_LEN;
+		hdr->type = PPME_SYSCALL_READ_X;
+		hdr->nparams = 0;
+		dev->m_bufinfo->head += EVT_LEN;
+	}
+
+	// Returns the (ts, cpuid) pairs of the first `max` events.
+	std::vector<std::pair<uint64_t, uint16_t>> consume(size_t max)
+	{
+		std::vector<std::pair<uint64_t, uint16_t>> res;
+		scap_evt* evt = nullptr;
+		uint16_t cpuid = 0;
+		// After two consecutive timeouts all the buffers are drained.
+		int timeouts = 0;
+		while(res.size() < max && timeouts < 2)
+		{
+			int32_t rc = ringbuffer_next(&m_devset, &evt, &cpuid);
+			if(rc == SCAP_TIMEOUT)
+			{
+				timeouts++;
+				continue;
+			}
+			EXPECT_EQ(rc, SCAP_SUCCESS);
+			if(rc != SCAP_SUCCESS)
+			{
+				break;
+			}
+			timeouts = 0;
+			res.emplace_back(evt->ts, cpuid);
+		}
+		return res;
+	}
+
+	struct scap_device_set m_devset = {};
+	char m_error[SCAP_LASTERR_SIZE] = {};
+};
+
+TEST_P(ringbuffer_merge, events_ordered_by_ts)
+{
+	const uint32_t ndevs = 13;
+	const uint32_t evts_per_dev = 64;
+	init(ndevs, evts_per_dev);
+
+	uint64_t ts = 1;
+	for(uint32_t i = 0; i < evts_per_dev; i++)
+	{
+		for(uint32_t k = 0; k < ndevs; k++)
+		{
+			push((k * 5 + i) % ndevs, ts++);
+		}
+	}
+
+	auto evts = consume(SIZE_MAX);
+	ASSERT_EQ(evts.size(), ndevs * evts_per_dev);
+	for(size_t i = 0; i < evts.size(); i++)
+	{
+		ASSERT_EQ(evts[i].first, i + 1);
+	}
+
+	// Everything is given back to the producers.
+	for(uint32_t j = 0; j < ndevs; j++)
+	{
+		ASSERT_EQ(m_devset.m_devs[j].m_bufinfo->tail, m_devset.m_devs[j].m_bufinfo->head);
+	}
+}
+
+TEST_P(ringbuffer_merge, equal_ts_prefers_lowest_cpu)
+{
+	init(4, 4);
+
+	push(3, 10);
+	push(1, 10);
+	push(2, 5);
+	push(0, 10);
+
+	auto evts = consume(SIZE_MAX);
+	ASSERT_EQ(evts.size(), 4);
+	ASSERT_EQ(evts[0], std::make_pair((uint64_t)5, (uint16_t)2));
+	ASSERT_EQ(evts[1], std::make_pair((uint64_t)10, (uint16_t)0));
+	ASSERT_EQ(evts[2], std::make_pair((uint64_t)10, (uint16_t)1));
+	ASSERT_EQ(evts[3], std::make_pair((uint64_t)10, (uint16_t)3));
+}
+
+TEST_P(ringbuffer_merge, blocks_flushed_while_consuming)
+{
+	const uint32_t ndevs = 4;
+	init(ndevs, 8);
+
+	uint64_t ts = 1;
+	for(uint32_t i = 0; i < 8; i++)
+	{
+		for(uint32_t k = 0; k < ndevs; k++)
+		{
+			push(k, ts++);
+		}
+	}
+
+	ASSERT_EQ(consume(3).size(), 3);
+
+	// This is what the engines do when they flush the buffers (e.g. on a snaplen change).
+	for(uint32_t j = 0; j < ndevs; j++)
+	{
+		m_devset.m_devs[j].m_sn_len = 0;
+	}
+
+	ASSERT_TRUE(consume(SIZE_MAX).empty());
+	for(uint32_t j = 0; j < ndevs; j++)
+	{
+		ASSERT_EQ(m_devset.m_devs[j].m_bufinfo->tail, m_devset.m_devs[j].m_bufinfo->head);
+	}
+}
+
+TEST_P(ringbuffer_merge, incremental_consumption)
+{
+	if(std::get<1>(GetParam()) == 0)
+	{
+		GTEST_SKIP() << "only meaningful with incremental consumption";
+	}
+
+	const uint32_t ndevs = 2;
+	init(ndevs, 16);
+
+	// the device 0 has a long block, the device 1 a short one.
+	for(uint64_t ts = 1; ts <= 8; ts++)
+	{
+		push(0, ts * 10);
+	}
+	push(1, 1);
+
+	auto evts = consume(4);
+	ASSERT_EQ(evts.size(), 4);
+	ASSERT_EQ(evts[0].second, 1);
+
+	// the first consumed events of device 0 are given back before the end of its block
+	scap_evt* evt = nullptr;
+	uint16_t cpuid = 0;
+	ASSERT_EQ(ringbuffer_next(&m_devset, &evt, &cpuid), SCAP_SUCCESS);
+	ASSERT_GT(m_devset.m_devs[0].m_bufinfo->tail, 0);
+	ASSERT_LT(m_devset.m_devs[0].m_bufinfo->tail, m_devset.m_devs[0].m_bufinfo->head);
+
+	// the device 1 is drained: new events are served without waiting for the device 0 block
+	push(1, 45);
+	evts = consume(SIZE_MAX);
+	ASSERT_EQ(evts.size(), 5);
+	ASSERT_EQ(evts[0], std::make_pair((uint64_t)45, (uint16_t)1));
+	for(uint32_t j = 0; j < ndevs; j++)
+	{
+		ASSERT_EQ(m_devset.m_devs[j].m_bufinfo->tail, m_devset.m_devs[j].m_bufinfo->head);
+	}
+}
+
+TEST_P(ringbuffer_merge, peek_upcoming_events)
+{
+	const uint32_t ndevs = 2;
+	init(ndevs, 8);
+
+	for(uint64_t ts = 1; ts <= 4; ts++)
+	{
+		push(0, ts * 10);
+		push(1, ts * 10 + 5);
+	}
+
+	auto evts = consume(1);
+	ASSERT_EQ(evts.size(), 1);
+	ASSERT_EQ(evts[0], std::make_pair((uint64_t)10, (uint16_t)0));
+
+	// the events that follow on the same device, until the end of its block
+	scap_evt* evt = ringbuffer_peek(&m_devset, 0, 1);
+	ASSERT_NE(evt, nullptr);
+	ASSERT_EQ(evt->ts, 20);
+	evt = ringbuffer_peek(&m_devset, 0, 3);
+	ASSERT_NE(evt, nullptr);
+	ASSERT_EQ(evt->ts, 40);
+	ASSERT_EQ(ringbuffer_peek(&m_devset, 0, 4), nullptr);
+	ASSERT_EQ(ringbuffer_peek(&m_devset, 0, 0), nullptr);
+	ASSERT_EQ(ringbuffer_peek(&m_devset, ndevs, 1), nullptr);
+
+	// peeking doesn't consume anything
+	evts = consume(SIZE_MAX);
+	ASSERT_EQ(evts.size(), 7);
+	ASSERT_EQ(evts[0].first, 15);
+	ASSERT_EQ(evts[1].first, 20);
+}
+
+INSTANTIATE_TEST_CASE_P(ringbuffer,
+			ringbuffer_merge,
+			testing::Combine(testing::Values(SCAP_RINGBUFFER_MERGE_LINEAR, SCAP_RINGBUFFER_MERGE_HEAP),
+					 testing::Values(0, EVT_LEN)));
+
+// The device fd is an eventfd so that we can notify the consumer by hand.
+TEST(ringbuffer, wakeup_on_notification)
+{
+	struct scap_device_set devset = {};
+	char error[SCAP_LASTERR_SIZE] = {};
+	scap_open_args oargs = {};
+	oargs.ringbuffer_wakeup = true;
+	oargs.ringbuffer_empty_wait_max_us = 20 * 1000;
+	ASSERT_EQ(devset_init(&devset, 1, &oargs, error), SCAP_SUCCESS);
+
+	scap_device* dev = &devset.m_devs[0];
+	dev->m_buffer_size = 2 * EVT_LEN;
+	dev->m_buffer = (char*)calloc(1, dev->m_buffer_size);
+	dev->m_bufinfo = (struct ppm_ring_buffer_info*)calloc(1, sizeof(struct ppm_ring_buffer_info));
+	dev->m_fd = eventfd(0, EFD_CLOEXEC);
+	ASSERT_NE(dev->m_fd, INVALID_FD);
+	ASSERT_EQ(devset_watch_devices(&devset), SCAP_SUCCESS);
+	ASSERT_NE(devset.m_wakeup_fd, INVALID_FD);
+
+	scap_evt* evt = nullptr;
+	uint16_t cpuid = 0;
+
+	// Without notifications we wait at most `ringbuffer_empty_wait_max_us`.
+	auto start = std::chrono::steady_clock::now();
+	ASSERT_EQ(ringbuffer_next(&devset, &evt, &cpuid), SCAP_TIMEOUT);
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	ASSERT_GE(elapsed, std::chrono::milliseconds(20));
+	ASSERT_LT(elapsed, std::chrono::seconds(5));
+
+	// A notification wakes the consumer up immediately.
+	devset.m_empty_wait_max_us = 60 * 1000 * 1000;
+	uint64_t val = 1;
+	ASSERT_EQ(write(dev->m_fd, &val, sizeof(val)), sizeof(val));
+	start = std::chrono::steady_clock::now();
+	ASSERT_EQ(ringbuffer_next(&devset, &evt, &cpuid), SCAP_TIMEOUT);
+	ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+
+	free(dev->m_buffer);
+	free(dev->m_bufinfo);
+	dev->m_buffer = (char*)INVALID_MAPPING;
+	dev->m_bufinfo = (struct ppm_ring_buffer_info*)INVALID_MAPPING;
+	devset_free(&devset);
+}
+
+// An engine wait function that reports only the second device as ready.
+static bool wait_second_dev_ready(struct scap_device_set* devset, int timeout_ms)
+{
+	devset->m_ready_devs[0] = 1ULL << 1;
+	return true;
+}
+
+TEST(ringbuffer, refill_only_ready_devices)
+{
+	struct scap_device_set devset = {};
+	char error[SCAP_LASTERR_SIZE] = {};
+	scap_open_args oargs = {};
+	oargs.ringbuffer_wakeup = true;
+	ASSERT_EQ(devset_init(&devset, 2, &oargs, error), SCAP_SUCCESS);
+	devset.m_wait_fn = wait_second_dev_ready;
+	devset.m_ready_devs = (uint64_t*)calloc(1, sizeof(uint64_t));
+
+	for(uint32_t j = 0; j < 2; j++)
+	{
+		scap_device* dev = &devset.m_devs[j];
+		dev->m_buffer_size = 2 * EVT_LEN;
+		dev->m_buffer = (char*)calloc(1, dev->m_buffer_size);
+		dev->m_bufinfo = (struct ppm_ring_buffer_info*)calloc(1, sizeof(struct ppm_ring_buffer_info));
+		auto hdr = (struct ppm_evt_hdr*)dev->m_buffer;
+		hdr->ts = j + 1;
+		hdr->len = EVT_LEN;
+		hdr->type = PPME_SYSCALL_READ_X;
+		dev->m_bufinfo->head = EVT_LEN;
+	}
+
+	// Both devices hold less than the empty threshold, so the consumer waits
+	// and then refills the device reported by the engine only.
+	scap_evt* evt = nullptr;
+	uint16_t cpuid = 0;
+	ASSERT_EQ(ringbuffer_next(&devset, &evt, &cpuid), SCAP_TIMEOUT);
+	ASSERT_EQ(ringbuffer_next(&devset, &evt, &cpuid), SCAP_SUCCESS);
+	ASSERT_EQ(cpuid, 1);
+	ASSERT_EQ(devset.m_devs[0].m_bufinfo->tail, 0);
+
+	for(uint32_t j = 0; j < 2; j++)
+	{
+		free(devset.m_devs[j].m_buffer);
+		free(devset.m_devs[j].m_bufinfo);
+		devset.m_devs[j].m_buffer = (char*)INVALID_MAPPING;
+		devset.m_devs[j].m_bufinfo = (struct ppm_ring_buffer_info*)INVALID_MAPPING;
+	}
+	devset_free(&devset);
+}
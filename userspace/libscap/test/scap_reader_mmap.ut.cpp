@@ -0,0 +1,179 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+#include <string>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "scap_reader.h"
+
+class scap_reader_mmap_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		char path[] = "/tmp/scap_reader_mmap_XXXXXX";
+		m_fd = mkstemp(path);
+		ASSERT_GE(m_fd, 0);
+		m_path = path;
+	}
+
+	void TearDown() override
+	{
+		close(m_fd);
+		unlink(m_path.c_str());
+	}
+
+	void append(const std::string& data)
+	{
+		ASSERT_EQ(pwrite(m_fd, data.data(), data.size(), lseek(m_fd, 0, SEEK_END)), (ssize_t)data.size());
+	}
+
+	scap_reader_t* open_reader(uint32_t window)
+	{
+		int fd = open(m_path.c_str(), O_RDONLY);
+		if(fd < 0)
+		{
+			return NULL;
+		}
+		scap_reader_t* r = scap_reader_open_mmap_window(fd, window);
+		if(r == NULL)
+		{
+			close(fd);
+		}
+		return r;
+	}
+
+	int m_fd = -1;
+	std::string m_path;
+};
+
+static std::string pattern(size_t len, size_t from)
+{
+	std::string res;
+	for(size_t j = from; j < from + len; j++)
+	{
+		res.push_back((char)('a' + j % 26));
+	}
+	return res;
+}
+
+TEST_F(scap_reader_mmap_test, read_and_map_across_windows)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	std::string data = pattern(page * 5 + 100, 0);
+	append(data);
+
+	// A window of a single page, so that most operations need a new one
+	scap_reader_t* r = open_reader((uint32_t)page);
+	ASSERT_NE(r, nullptr);
+
+	std::string buf(page * 2 + 10, '\0');
+	ASSERT_EQ(r->read(r, &buf[0], (uint32_t)buf.size()), (int)buf.size());
+	ASSERT_EQ(buf, data.substr(0, buf.size()));
+
+	// A mapping bigger than the window, straddling pages
+	size_t off = buf.size();
+	char* p = (char*)r->map(r, (uint32_t)(page + 50));
+	ASSERT_NE(p, nullptr);
+	ASSERT_EQ(std::string(p, page + 50), data.substr(off, page + 50));
+	off += page + 50;
+	ASSERT_EQ(r->tell(r), (int64_t)off);
+
+	// Backwards, then to the end
+	ASSERT_EQ(r->seek(r, 10, SEEK_SET), 10);
+	p = (char*)r->map(r, 20);
+	ASSERT_NE(p, nullptr);
+	ASSERT_EQ(std::string(p, 20), data.substr(10, 20));
+	ASSERT_EQ(r->seek(r, -5, SEEK_END), (int64_t)data.size() - 5);
+	ASSERT_EQ(r->map(r, 6), nullptr);
+	ASSERT_EQ(r->read(r, &buf[0], 100), 5);
+	ASSERT_EQ(buf.substr(0, 5), data.substr(data.size() - 5));
+	ASSERT_EQ(r->read(r, &buf[0], 100), 0);
+	ASSERT_EQ(r->seek(r, 1, SEEK_END), -1);
+
+	ASSERT_EQ(r->close(r), 0);
+}
+
+TEST_F(scap_reader_mmap_test, growing_file)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	std::string data = pattern(page + 10, 0);
+	append(data);
+
+	scap_reader_t* r = open_reader((uint32_t)page);
+	ASSERT_NE(r, nullptr);
+
+	std::string buf(page * 4, '\0');
+	ASSERT_EQ(r->read(r, &buf[0], (uint32_t)buf.size()), (int)data.size());
+	ASSERT_EQ(r->read(r, &buf[0], 1), 0);
+	ASSERT_EQ(r->map(r, 1), nullptr);
+
+	// The capture keeps being written, the reader picks up from where
+	// it stopped, both with read() and with map()
+	std::string more = pattern(page * 2, data.size());
+	append(more);
+	ASSERT_EQ(r->read(r, &buf[0], 100), 100);
+	ASSERT_EQ(buf.substr(0, 100), more.substr(0, 100));
+	char* p = (char*)r->map(r, (uint32_t)(more.size() - 100));
+	ASSERT_NE(p, nullptr);
+	ASSERT_EQ(std::string(p, more.size() - 100), more.substr(100));
+	ASSERT_EQ(r->map(r, 1), nullptr);
+
+	// And seeking relative to the end follows the file size
+	append("xyz");
+	ASSERT_EQ(r->seek(r, -3, SEEK_END), (int64_t)(data.size() + more.size()));
+	ASSERT_EQ(r->read(r, &buf[0], 10), 3);
+	ASSERT_EQ(buf.substr(0, 3), "xyz");
+
+	ASSERT_EQ(r->close(r), 0);
+}
+
+TEST_F(scap_reader_mmap_test, starts_at_fd_position)
+{
+	append("skipme" + pattern(100, 0));
+
+	int fd = open(m_path.c_str(), O_RDONLY);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(lseek(fd, 6, SEEK_SET), 6);
+	scap_reader_t* r = scap_reader_open_mmap(fd);
+	ASSERT_NE(r, nullptr);
+
+	char buf[10];
+	ASSERT_EQ(r->read(r, buf, sizeof(buf)), (int)sizeof(buf));
+	ASSERT_EQ(std::string(buf, sizeof(buf)), pattern(10, 0));
+	ASSERT_EQ(r->seek(r, 0, SEEK_END), 100);
+
+	// The reader owns the fd
+	ASSERT_EQ(r->close(r), 0);
+	ASSERT_EQ(fcntl(fd, F_GETFD), -1);
+}
+
+TEST_F(scap_reader_mmap_test, compressed_files)
+{
+	append(std::string("\x1f\x8b\x08\x00", 4) + pattern(100, 0));
+
+	int fd = open(m_path.c_str(), O_RDONLY);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(scap_reader_open_mmap(fd), nullptr);
+	// Left open, and where it was, for the other readers
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+	close(fd);
+}
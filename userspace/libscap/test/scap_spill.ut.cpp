@@ -0,0 +1,134 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+#include "scap.h"
+#include "scap-int.h"
+}
+
+#define EVT_LEN (sizeof(struct ppm_evt_hdr))
+
+// An engine returning a fixed list of events, one per cpu in turn, then
+// timing out
+static std::vector<struct ppm_evt_hdr> s_evts;
+static std::atomic<size_t> s_served;
+
+static int32_t fake_next(struct scap_engine_handle engine, scap_evt** pevent, uint16_t* pcpuid)
+{
+	size_t j = s_served.load();
+	if(j == s_evts.size())
+	{
+		return SCAP_TIMEOUT;
+	}
+	*pevent = &s_evts[j];
+	*pcpuid = j % 2;
+	s_served = j + 1;
+	return SCAP_SUCCESS;
+}
+
+class scap_spill_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		m_vtable = {};
+		m_vtable.next = fake_next;
+		m_handle = {};
+		m_handle.m_vtable = &m_vtable;
+
+		s_evts.clear();
+		s_served = 0;
+		for(uint64_t ts = 1; ts <= 10; ts++)
+		{
+			struct ppm_evt_hdr evt = {};
+			evt.ts = ts;
+			evt.len = EVT_LEN;
+			evt.type = PPME_SYSCALL_READ_X;
+			s_evts.push_back(evt);
+		}
+	}
+
+	void TearDown() override
+	{
+		scap_spill_free(&m_handle.m_spill);
+	}
+
+	void wait_served(size_t n)
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while(s_served.load() < n && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		ASSERT_EQ(s_served.load(), n);
+	}
+
+	scap_vtable m_vtable;
+	scap_t m_handle;
+};
+
+TEST_F(scap_spill_test, replay_in_order)
+{
+	ASSERT_EQ(scap_spill_start(&m_handle, 4096), SCAP_SUCCESS);
+	wait_served(s_evts.size());
+	scap_spill_stop(&m_handle);
+	ASSERT_FALSE(m_handle.m_spill.m_full);
+	ASSERT_EQ(m_handle.m_spill.m_n_evts, s_evts.size());
+
+	uint64_t ts = 1;
+	scap_evt* pevent;
+	uint16_t cpuid;
+	while(scap_spill_pending(&m_handle.m_spill))
+	{
+		scap_spill_next(&m_handle.m_spill, &pevent, &cpuid);
+		ASSERT_EQ(pevent->ts, ts);
+		ASSERT_EQ(pevent->len, EVT_LEN);
+		ASSERT_EQ(cpuid, (ts - 1) % 2);
+		ts++;
+	}
+	ASSERT_EQ(ts, s_evts.size() + 1);
+}
+
+TEST_F(scap_spill_test, full_buffer)
+{
+	// Room for two events, the third one is kept beyond the size since the
+	// engine is already past it, and the others are left to the engine
+	ASSERT_EQ(scap_spill_start(&m_handle, 100), SCAP_SUCCESS);
+	wait_served(3);
+	scap_spill_stop(&m_handle);
+	ASSERT_TRUE(m_handle.m_spill.m_full);
+	ASSERT_EQ(m_handle.m_spill.m_n_evts, 3u);
+	ASSERT_EQ(s_served.load(), 3u);
+
+	// scap_next() returns the buffered events, then reads the engine again
+	scap_evt* pevent;
+	uint16_t cpuid;
+	for(uint64_t ts = 1; ts <= s_evts.size(); ts++)
+	{
+		ASSERT_EQ(scap_next(&m_handle, &pevent, &cpuid), SCAP_SUCCESS);
+		ASSERT_EQ(pevent->ts, ts);
+	}
+	ASSERT_EQ(m_handle.m_spill.m_buf, nullptr);
+	ASSERT_EQ(scap_next(&m_handle, &pevent, &cpuid), SCAP_TIMEOUT);
+}
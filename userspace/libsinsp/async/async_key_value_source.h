@@ -16,6 +16,7 @@ limitations under the License.
 */
 #pragma once
 
+#include <array>
 #include <chrono>
 #include <condition_variable>
 #include <functional>
@@ -24,7 +25,9 @@ limitations under the License.
 #include <queue>
 #include <set>
 #include <thread>
+#include <tuple>
 #include <unordered_map>
+#include <vector>
 #include <stdint.h>
 
 namespace libsinsp
@@ -63,6 +66,12 @@ namespace libsinsp
  *     specified ttl time, then this component will prune the stored value.</li>
  * </ol>
  *
+ * Lookups are served by a single async thread unless set_num_workers() asks
+ * for more, in which case run_impl() is called from all of them and must be
+ * thread-safe.  A key is queued only once no matter how many times it is
+ * looked up while pending, so a key is never served by two workers at the
+ * same time, and prioritize() moves a pending key ahead of the others.
+ *
  * @tparam key_type   The type of the keys for which concrete subclasses will
  *                    query.  This type must have a valid operator==().
  * @tparam value_type The type of value that concrete subclasses will
@@ -92,6 +101,28 @@ public:
 	 */
 	typedef std::function<void(const key_type& key)> ttl_expired_handler;
 
+	/**
+	 * Number of buckets of the histograms in stats: bucket 0 counts the
+	 * zeroes and bucket i counts the values in [2^(i-1), 2^i), the last
+	 * bucket also counting anything larger.
+	 */
+	const static size_t STATS_BUCKETS = 16;
+
+	struct stats
+	{
+		/** Lookups that queued a new request. */
+		uint64_t m_n_requests = 0;
+
+		/** Lookups of a key that already had a pending request. */
+		uint64_t m_n_coalesced = 0;
+
+		/** Number of queued keys, sampled when a request is queued. */
+		std::array<uint64_t, STATS_BUCKETS> m_queue_depth = {};
+
+		/** Milliseconds from the first lookup to the value being stored. */
+		std::array<uint64_t, STATS_BUCKETS> m_latency_ms = {};
+	};
+
 	/**
 	 * Initialize this new async_key_value_source, which will block
 	 * synchronously for the given max_wait_ms for value collection.
@@ -112,6 +143,12 @@ public:
 
 	virtual ~async_key_value_source();
 
+	/**
+	 * Sets the number of async threads serving the lookups, 1 by default.
+	 * Must be called before the first lookup.
+	 */
+	void set_num_workers(uint32_t num_workers);
+
 	/**
 	 * Returns the maximum amount of time, in milliseconds, that a call to
 	 * lookup() will block synchronously before returning.
@@ -228,6 +265,18 @@ public:
 			    const callback_handler& handler = callback_handler(),
 			    const ttl_expired_handler& ttl_expired = ttl_expired_handler());
 
+	/**
+	 * Serve the request for the given key before the other queued ones,
+	 * e.g. because an event needs its value right now.  Does nothing if
+	 * the key isn't queued or is waiting for a deferred retry.
+	 */
+	void prioritize(const key_type& key);
+
+	/**
+	 * Returns the counters and histograms of the requests so far.
+	 */
+	stats get_stats() const;
+
 	/**
 	 * Determines if the async thread associated with this
 	 * async_key_value_source is running.
@@ -248,8 +297,8 @@ public:
 	void set_running(bool running);
 
 	/**
-	 * Stops the thread associated with this async_key_value_source, if
-	 * it is running; otherwise, does nothing.  The only use for this is
+	 * Stops the threads associated with this async_key_value_source, if
+	 * they are running; otherwise, does nothing.  The only use for this is
 	 * in a destructor to ensure that the async thread stops when the
 	 * object is destroyed.
 	 */
@@ -406,9 +455,18 @@ private:
 	 */
 	void prune_stale_requests();
 
+	/**
+	 * Queue a request for the given key, to be dequeued at start_time.
+	 * This method expects that the caller is holding m_mutex.
+	 */
+	void enqueue(const key_type& key, std::chrono::steady_clock::time_point start_time);
+
+	static size_t stats_bucket(uint64_t value);
+
 	uint64_t m_max_wait_ms;
 	uint64_t m_ttl_ms;
-	std::thread m_thread;
+	uint32_t m_num_workers;
+	std::vector<std::thread> m_threads;
 	bool m_running;
 	bool m_terminate;
 
@@ -425,10 +483,23 @@ private:
 	 */
 	std::condition_variable m_queue_not_empty_condition;
 
-	using queue_item_t = std::pair<std::chrono::time_point<std::chrono::steady_clock>, key_type>;
+	/**
+	 * A queued key can have stale entries in m_request_queue (left behind
+	 * by prioritize()), only the one with the sequence number stored in
+	 * m_request_set is served.
+	 */
+	struct queued_request
+	{
+		uint64_t m_seq;
+		std::chrono::steady_clock::time_point m_start_time;
+	};
+
+	using queue_item_t = std::tuple<std::chrono::time_point<std::chrono::steady_clock>, uint64_t, key_type>;
 	std::priority_queue<queue_item_t, std::vector<queue_item_t>, std::greater<queue_item_t>> m_request_queue;
-	std::set<key_type> m_request_set;
+	std::map<key_type, queued_request> m_request_set;
+	uint64_t m_next_seq;
 	value_map m_value_map;
+	stats m_stats;
 };
 
 
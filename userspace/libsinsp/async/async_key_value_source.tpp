@@ -15,6 +15,7 @@ limitations under the License.
 
 */
 #include "logger.h"
+#include "thread_placement.h"
 
 #include <assert.h>
 #include <algorithm>
@@ -35,12 +36,15 @@ async_key_value_source<key_type, value_type>::async_key_value_source(
 		const uint64_t ttl_ms) noexcept:
 	m_max_wait_ms(max_wait_ms),
 	m_ttl_ms(ttl_ms),
-	m_thread(),
+	m_num_workers(1),
+	m_threads(),
 	m_running(false),
 	m_terminate(false),
 	m_mutex(),
 	m_queue_not_empty_condition(),
-	m_value_map()
+	m_next_seq(0),
+	m_value_map(),
+	m_stats()
 { }
 
 template<typename key_type, typename value_type>
@@ -58,6 +62,14 @@ async_key_value_source<key_type, value_type>::~async_key_value_source()
 	}
 }
 
+template<typename key_type, typename value_type>
+void async_key_value_source<key_type, value_type>::set_num_workers(uint32_t num_workers)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+
+	m_num_workers = std::max(num_workers, 1u);
+}
+
 template<typename key_type, typename value_type>
 uint64_t async_key_value_source<key_type, value_type>::get_max_wait() const
 {
@@ -83,19 +95,22 @@ void async_key_value_source<key_type, value_type>::stop()
 			m_terminate = true;
 			join_needed = true;
 
-			// The async thread might be waiting for new events
-			// so wake it up
-			m_queue_not_empty_condition.notify_one();
+			// The async threads might be waiting for new events
+			// so wake them up
+			m_queue_not_empty_condition.notify_all();
 		}
 	} // Drop the mutex before join()
 
 	if (join_needed)
 	{
-		m_thread.join();
+		for(auto& thread : m_threads)
+		{
+			thread.join();
+		}
 
-		// Remove any pointers from the thread to this object
+		// Remove any pointers from the threads to this object
 		// (just to be safe)
-		m_thread = std::thread();
+		m_threads.clear();
 
 		m_running = false;
 	}
@@ -113,6 +128,8 @@ bool async_key_value_source<key_type, value_type>::is_running() const
 template<typename key_type, typename value_type>
 void async_key_value_source<key_type, value_type>::run()
 {
+	libsinsp::thread_placement::apply(libsinsp::thread_placement::thread_class::ASYNC_LOOKUP);
+
 	bool terminate = false;
 
 	while(!terminate)
@@ -162,10 +179,13 @@ bool async_key_value_source<key_type, value_type>::lookup_delayed(
 {
 	std::unique_lock<std::mutex> guard(m_mutex);
 
-	if(!m_running && !m_thread.joinable())
+	if(!m_running && m_threads.empty())
 	{
 		m_running = true;
-		m_thread = std::thread(&async_key_value_source::run, this);
+		for(uint32_t i = 0; i < m_num_workers; i++)
+		{
+			m_threads.emplace_back(&async_key_value_source::run, this);
+		}
 	}
 
 	auto itr = m_value_map.find(key);
@@ -188,20 +208,21 @@ bool async_key_value_source<key_type, value_type>::lookup_delayed(
 		itr->second.m_value = value;
 
 		// Make request to API and let the async thread know about it
-		if (std::find(m_request_set.begin(),
-		              m_request_set.end(),
-		              key) == m_request_set.end())
+		if (m_request_set.find(key) == m_request_set.end())
 		{
-			auto start_time = std::chrono::steady_clock::now() + delay;
-			m_request_queue.push(std::make_pair(start_time, key));
-			m_request_set.insert(key);
-			m_queue_not_empty_condition.notify_one();
+			enqueue(key, std::chrono::steady_clock::now() + delay);
+			m_stats.m_n_requests++;
+			m_stats.m_queue_depth[stats_bucket(m_request_set.size())]++;
 		}
 		request_complete = false;
 	}
 	else
 	{
 		request_complete = itr->second.m_available;
+		if(!request_complete)
+		{
+			m_stats.m_n_coalesced++;
+		}
 	}
 
 	if(!request_complete && m_max_wait_ms > 0)
@@ -274,13 +295,25 @@ bool async_key_value_source<key_type, value_type>::dequeue_next_key(key_type& ke
 	std::lock_guard<std::mutex> guard(m_mutex);
 	bool key_found = false;
 
+	// Drop the entries left behind by prioritize()
+	while(!m_request_queue.empty())
+	{
+		const auto& top_element = m_request_queue.top();
+		auto queued = m_request_set.find(std::get<2>(top_element));
+		if(queued != m_request_set.end() && queued->second.m_seq == std::get<1>(top_element))
+		{
+			break;
+		}
+		m_request_queue.pop();
+	}
+
 	if(!m_request_queue.empty())
 	{
 		auto top_element = m_request_queue.top();
 		auto now = std::chrono::steady_clock::now();
-		if(top_element.first < now)
+		if(std::get<0>(top_element) < now)
 		{
-			key = std::move(top_element.second);
+			key = std::move(std::get<2>(top_element));
 			m_request_queue.pop();
 			m_request_set.erase(key);
 
@@ -304,7 +337,7 @@ bool async_key_value_source<key_type, value_type>::dequeue_next_key(key_type& ke
 		}
 		else
 		{
-			std::chrono::duration<double> dur = top_element.first - now;
+			std::chrono::duration<double> dur = std::get<0>(top_element) - now;
 			g_logger.log("async_key_value_source: Waiting " +
 				     std::to_string(dur.count()) +
 				     " before dequeuing top job",
@@ -339,6 +372,11 @@ void async_key_value_source<key_type, value_type>::store_value(
 		return;
 	}
 
+	const uint64_t latency_ms =
+		std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - itr->second.m_start_time).count();
+	m_stats.m_latency_ms[stats_bucket(latency_ms)]++;
+
 	if (itr->second.m_callback)
 	{
 		itr->second.m_callback(key, value);
@@ -366,15 +404,61 @@ void async_key_value_source<key_type, value_type>::defer_lookup(
 		     std::to_string(delay.count()),
 		     sinsp_logger::SEV_DEBUG);
 
-	m_request_queue.push(std::make_pair(start_time, key));
-	m_request_set.insert(key);
+	enqueue(key, start_time);
 	if(value_ptr)
 	{
 		m_value_map[key].m_value = *value_ptr;
 	}
+}
+
+template<typename key_type, typename value_type>
+void async_key_value_source<key_type, value_type>::enqueue(
+		const key_type& key,
+		std::chrono::steady_clock::time_point start_time)
+{
+	const uint64_t seq = m_next_seq++;
+
+	m_request_queue.push(std::make_tuple(start_time, seq, key));
+	m_request_set[key] = queued_request{seq, start_time};
 	m_queue_not_empty_condition.notify_one();
 }
 
+template<typename key_type, typename value_type>
+void async_key_value_source<key_type, value_type>::prioritize(const key_type& key)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+
+	auto queued = m_request_set.find(key);
+	if(queued == m_request_set.end() ||
+	   queued->second.m_start_time > std::chrono::steady_clock::now())
+	{
+		return;
+	}
+
+	// The old entry stays in the queue and is dropped when it reaches the top
+	enqueue(key, std::chrono::steady_clock::time_point::min());
+}
+
+template<typename key_type, typename value_type>
+typename async_key_value_source<key_type, value_type>::stats async_key_value_source<key_type, value_type>::get_stats() const
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+
+	return m_stats;
+}
+
+template<typename key_type, typename value_type>
+size_t async_key_value_source<key_type, value_type>::stats_bucket(uint64_t value)
+{
+	size_t bucket = 0;
+	while(value != 0 && bucket < STATS_BUCKETS - 1)
+	{
+		value >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
 /**
  * Prune any "old" outstanding requests.  This method expects that the caller
  * is holding m_mutex.
@@ -448,13 +532,13 @@ std::chrono::steady_clock::time_point async_key_value_source<key_type, value_typ
 		return std::chrono::steady_clock::time_point::max();
 	}
 
-	auto next_request = m_request_queue.top();
-	if (next_request.first <= std::chrono::steady_clock::now())
+	auto start_time = std::get<0>(m_request_queue.top());
+	if (start_time <= std::chrono::steady_clock::now())
 	{
 		return std::chrono::steady_clock::time_point::min();
 	}
 
-	return next_request.first;
+	return start_time;
 }
 
 } // end namespace libsinsp
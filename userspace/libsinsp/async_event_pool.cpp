@@ -0,0 +1,135 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "async_event_pool.h"
+#include "event.h"
+
+struct async_event_pool::entry
+{
+	sinsp_evt m_evt;
+	// Holds the scap event, m_evt doesn't own it
+	std::vector<uint8_t> m_storage;
+};
+
+struct async_event_pool::free_list
+{
+	std::mutex m_mutex;
+	std::vector<entry*> m_entries;
+	size_t m_max_cached;
+	uint64_t m_num_allocated = 0;
+
+	~free_list()
+	{
+		for(entry* e : m_entries)
+		{
+			delete e;
+		}
+	}
+
+	entry* get()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if(!m_entries.empty())
+			{
+				entry* e = m_entries.back();
+				m_entries.pop_back();
+				return e;
+			}
+			m_num_allocated++;
+		}
+		return new entry();
+	}
+
+	void put(entry* e)
+	{
+		// Drop what the event refers to before caching it
+		e->m_evt.m_tinfo_ref.reset();
+		e->m_evt.m_tinfo = NULL;
+		if(e->m_storage.size() > MAX_CACHED_STORAGE)
+		{
+			std::vector<uint8_t>().swap(e->m_storage);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if(m_entries.size() < m_max_cached)
+			{
+				m_entries.push_back(e);
+				return;
+			}
+		}
+		delete e;
+	}
+};
+
+async_event_pool::async_event_pool(size_t max_cached):
+	m_free(std::make_shared<free_list>())
+{
+	m_free->m_max_cached = max_cached;
+}
+
+async_event_pool::~async_event_pool() = default;
+
+std::shared_ptr<sinsp_evt> async_event_pool::encode_params(std::string& error, ppm_event_code type, uint64_t ts, int64_t tid, uint32_t n, const scap_const_sized_buffer* params)
+{
+	entry* e = m_free->get();
+	char scap_error[SCAP_LASTERR_SIZE];
+	size_t event_size = 0;
+
+	// The storage is grown at most once, to the size of the event
+	scap_sized_buffer buf = {e->m_storage.data(), e->m_storage.size()};
+	int32_t res = scap_event_encode_params_array(buf, &event_size, scap_error, type, n, params);
+	if(res == SCAP_INPUT_TOO_SMALL)
+	{
+		e->m_storage.resize(event_size);
+		buf = {e->m_storage.data(), e->m_storage.size()};
+		res = scap_event_encode_params_array(buf, &event_size, scap_error, type, n, params);
+	}
+
+	if(res != SCAP_SUCCESS)
+	{
+		error = scap_error;
+		m_free->put(e);
+		return nullptr;
+	}
+
+	sinsp_evt& evt = e->m_evt;
+	evt.m_pevt = (scap_evt*)e->m_storage.data();
+	evt.m_pevt->ts = ts;
+	evt.m_pevt->tid = tid;
+	evt.m_cpuid = 0;
+	evt.m_evtnum = 0;
+	evt.m_filtered_out = false;
+	evt.m_repeat_count = 0;
+	evt.init();
+
+	std::shared_ptr<free_list> free = m_free;
+	return std::shared_ptr<sinsp_evt>(&evt, [free, e](sinsp_evt*) { free->put(e); });
+}
+
+size_t async_event_pool::get_num_cached() const
+{
+	std::lock_guard<std::mutex> lock(m_free->m_mutex);
+	return m_free->m_entries.size();
+}
+
+uint64_t async_event_pool::get_num_allocated() const
+{
+	std::lock_guard<std::mutex> lock(m_free->m_mutex);
+	return m_free->m_num_allocated;
+}
@@ -0,0 +1,106 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "scap.h"
+
+class sinsp_evt;
+
+// Events built by the inspector itself and queued to sinsp::next() (see
+// sinsp::m_pending_state_evts), e.g. the container, user and group events.
+// On nodes with many short lived containers they are created by the
+// thousands, so instead of allocating a sinsp_evt and its storage for each
+// of them, the released events are kept in a free list, together with
+// their storage, to be reused by the next ones.
+//
+// The events are encoded with typed parameters: integers and enums are
+// copied with the size of their type, strings include their terminator
+// and scap_const_sized_buffer is copied as is. The size of the integer
+// parameters is checked against the event table.
+//
+// Events can be encoded from any thread. An event goes back to the pool
+// when its last reference is dropped, even if the pool is gone by then.
+class async_event_pool
+{
+public:
+	// Events larger than this don't keep their storage when released
+	static const size_t MAX_CACHED_STORAGE = 64 * 1024;
+
+	explicit async_event_pool(size_t max_cached = 64);
+	~async_event_pool();
+
+	//
+	// Encode an event with the given parameters into a pooled sinsp_evt.
+	// Returns NULL and sets error if the event can't be encoded.
+	//
+	template<typename... Args>
+	std::shared_ptr<sinsp_evt> encode(std::string& error, ppm_event_code type, uint64_t ts, int64_t tid, const Args&... args)
+	{
+		const scap_const_sized_buffer params[] = {to_param(args)..., {nullptr, 0}};
+		return encode_params(error, type, ts, tid, sizeof...(Args), params);
+	}
+
+	std::shared_ptr<sinsp_evt> encode_params(std::string& error, ppm_event_code type, uint64_t ts, int64_t tid, uint32_t n, const scap_const_sized_buffer* params);
+
+	size_t get_num_cached() const;
+
+	//
+	// Number of events allocated because the free list was empty
+	//
+	uint64_t get_num_allocated() const;
+
+private:
+	template<typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type>
+	static inline scap_const_sized_buffer to_param(const T& val)
+	{
+		return {&val, sizeof(T)};
+	}
+
+	static inline scap_const_sized_buffer to_param(const std::string& val)
+	{
+		return {val.c_str(), val.size() + 1};
+	}
+
+	static inline scap_const_sized_buffer to_param(const char* val)
+	{
+		if(val == nullptr)
+		{
+			return {nullptr, 0};
+		}
+		return {val, strlen(val) + 1};
+	}
+
+	static inline scap_const_sized_buffer to_param(const scap_const_sized_buffer& val)
+	{
+		return val;
+	}
+
+	struct entry;
+	struct free_list;
+
+	// Shared with the deleters of the events handed out
+	std::shared_ptr<free_list> m_free;
+};
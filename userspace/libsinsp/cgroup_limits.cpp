@@ -1,6 +1,11 @@
 #include "cgroup_limits.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <fstream>
+#include <sys/inotify.h>
+#include <unistd.h>
 #include "cgroup_list_counter.h"
 #include "sinsp.h"
 
@@ -11,6 +16,24 @@ namespace {
 // and so should never exceed CGROUP_VAL_MAX either
 constexpr const int64_t CGROUP_VAL_MAX = (1ULL << 42u) - 1;
 
+constexpr const char* MEMORY_LIMIT_FILE = "memory.limit_in_bytes";
+constexpr const char* CPU_SHARES_FILE = "cpu.shares";
+constexpr const char* CPU_QUOTA_FILE = "cpu.cfs_quota_us";
+constexpr const char* CPU_PERIOD_FILE = "cpu.cfs_period_us";
+constexpr const char* CPUSET_CPUS_FILE = "cpuset.cpus";
+
+bool is_limit_file(const char* filename)
+{
+	for(const char* limit_file : {MEMORY_LIMIT_FILE, CPU_SHARES_FILE, CPU_QUOTA_FILE, CPU_PERIOD_FILE, CPUSET_CPUS_FILE})
+	{
+		if(strcmp(filename, limit_file) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 /**
  * \brief Read a single int64_t value from cgroupfs
  * @param subsys path to the specific cgroup subsystem, e.g. /sys/fs/cgroup/cpu
@@ -95,7 +118,7 @@ bool get_cgroup_resource_limits(const cgroup_limits_key& key, cgroup_limits_valu
 	{
 		g_logger.format(sinsp_logger::SEV_DEBUG, "(cgroup-limits) mem cgroup for container [%s]: %s/%s",
 			key.m_container_id.c_str(), memcg_root->c_str(), key.m_mem_cgroup.c_str());
-		found_all = read_cgroup_val(memcg_root, key.m_mem_cgroup, "memory.limit_in_bytes", value.m_memory_limit) && found_all;
+		found_all = read_cgroup_val(memcg_root, key.m_mem_cgroup, MEMORY_LIMIT_FILE, value.m_memory_limit) && found_all;
 	}
 
 	std::shared_ptr<std::string> cpucg_root = sinsp::lookup_cgroup_dir("cpu");
@@ -108,9 +131,9 @@ bool get_cgroup_resource_limits(const cgroup_limits_key& key, cgroup_limits_valu
 	{
 		g_logger.format(sinsp_logger::SEV_DEBUG, "(cgroup-limits) cpu cgroup for container [%s]: %s/%s",
 				key.m_container_id.c_str(), cpucg_root->c_str(), key.m_cpu_cgroup.c_str());
-		found_all = read_cgroup_val(cpucg_root, key.m_cpu_cgroup, "cpu.shares", value.m_cpu_shares) && found_all;
-		found_all = read_cgroup_val(cpucg_root, key.m_cpu_cgroup, "cpu.cfs_quota_us", value.m_cpu_quota) && found_all;
-		found_all = read_cgroup_val(cpucg_root, key.m_cpu_cgroup, "cpu.cfs_period_us", value.m_cpu_period) && found_all;
+		found_all = read_cgroup_val(cpucg_root, key.m_cpu_cgroup, CPU_SHARES_FILE, value.m_cpu_shares) && found_all;
+		found_all = read_cgroup_val(cpucg_root, key.m_cpu_cgroup, CPU_QUOTA_FILE, value.m_cpu_quota) && found_all;
+		found_all = read_cgroup_val(cpucg_root, key.m_cpu_cgroup, CPU_PERIOD_FILE, value.m_cpu_period) && found_all;
 	}
 
 	std::shared_ptr<std::string> cpuset_root = sinsp::lookup_cgroup_dir("cpuset");
@@ -125,7 +148,7 @@ bool get_cgroup_resource_limits(const cgroup_limits_key& key, cgroup_limits_valu
 				key.m_container_id.c_str(), cpuset_root->c_str(), key.m_cpuset_cgroup.c_str());
 		found_all = read_cgroup_list_count(*cpuset_root,
 						   key.m_cpuset_cgroup,
-						   "cpuset.cpus",
+						   CPUSET_CPUS_FILE,
 						   value.m_cpuset_cpu_count) && found_all;
 	}
 
@@ -137,5 +160,185 @@ bool get_cgroup_resource_limits(const cgroup_limits_key& key, cgroup_limits_valu
 
 	return found_all;
 }
+
+cgroup_limits_cache::cgroup_limits_cache() :
+	cgroup_limits_cache(get_cgroup_resource_limits, sinsp::lookup_cgroup_dir)
+{
+}
+
+cgroup_limits_cache::cgroup_limits_cache(reader_t reader, root_lookup_t root_lookup) :
+	m_reader(std::move(reader)),
+	m_root_lookup(std::move(root_lookup))
+{
+	m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(m_inotify_fd < 0)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"(cgroup-limits) cannot watch cgroupfs (%s), limits will be read on every lookup",
+				strerror(errno));
+	}
+}
+
+cgroup_limits_cache::~cgroup_limits_cache()
+{
+	if(m_inotify_fd >= 0)
+	{
+		close(m_inotify_fd);
+	}
+}
+
+bool cgroup_limits_cache::get(const cgroup_limits_key& key, cgroup_limits_value& value, bool name_check)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(m_inotify_fd < 0)
+	{
+		return m_reader(key, value, name_check);
+	}
+
+	process_events();
+
+	auto it = m_entries.find(key);
+	if(it != m_entries.end())
+	{
+		if(it->second.m_name_check == name_check)
+		{
+			value = it->second.m_value;
+			return it->second.m_found_all;
+		}
+		invalidate(key);
+	}
+
+	// Watch the directories before reading the limits: a write racing
+	// with the read invalidates the entry right away
+	entry e;
+	e.m_name_check = name_check;
+	if(!add_watch("memory", key.m_mem_cgroup, key, e) ||
+	   !add_watch("cpu", key.m_cpu_cgroup, key, e) ||
+	   !add_watch("cpuset", key.m_cpuset_cgroup, key, e))
+	{
+		release_watches(key, e.m_watches);
+		return m_reader(key, value, name_check);
+	}
+
+	bool found_all = m_reader(key, value, name_check);
+	e.m_found_all = found_all;
+	e.m_value = value;
+	m_entries.emplace(key, std::move(e));
+	return found_all;
+}
+
+size_t cgroup_limits_cache::size()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	process_events();
+	return m_entries.size();
+}
+
+bool cgroup_limits_cache::add_watch(const std::string& subsys, const std::string& cgroup, const cgroup_limits_key& key, entry& e)
+{
+	std::shared_ptr<std::string> root = m_root_lookup(subsys);
+	if(!root || root->empty())
+	{
+		return false;
+	}
+
+	std::string path = *root + "/" + cgroup;
+	int wd = inotify_add_watch(m_inotify_fd, path.c_str(), IN_MODIFY | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+	if(wd < 0)
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG, "(cgroup-limits) cannot watch %s (%s), limits of container [%s] won't be cached",
+				path.c_str(), strerror(errno), key.m_container_id.c_str());
+		return false;
+	}
+
+	// The cgroups of different subsystems can share a directory
+	if(std::find(e.m_watches.begin(), e.m_watches.end(), wd) == e.m_watches.end())
+	{
+		e.m_watches.push_back(wd);
+		m_watched_keys[wd].push_back(key);
+	}
+	return true;
+}
+
+void cgroup_limits_cache::release_watches(const cgroup_limits_key& key, const std::vector<int>& watches)
+{
+	for(int wd : watches)
+	{
+		auto it = m_watched_keys.find(wd);
+		if(it == m_watched_keys.end())
+		{
+			continue;
+		}
+
+		auto& keys = it->second;
+		keys.erase(std::remove(keys.begin(), keys.end(), key), keys.end());
+		if(keys.empty())
+		{
+			inotify_rm_watch(m_inotify_fd, wd);
+			m_watched_keys.erase(it);
+		}
+	}
+}
+
+void cgroup_limits_cache::invalidate(const cgroup_limits_key& key)
+{
+	auto it = m_entries.find(key);
+	if(it == m_entries.end())
+	{
+		return;
+	}
+
+	release_watches(key, it->second.m_watches);
+	m_entries.erase(it);
+}
+
+void cgroup_limits_cache::process_events()
+{
+	alignas(struct inotify_event) char buf[4096];
+	ssize_t len;
+	while((len = read(m_inotify_fd, buf, sizeof(buf))) > 0)
+	{
+		const struct inotify_event* event;
+		for(char* ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + event->len)
+		{
+			event = reinterpret_cast<const struct inotify_event*>(ptr);
+
+			if(event->mask & IN_Q_OVERFLOW)
+			{
+				// Some events were lost, any limit could have changed
+				g_logger.format(sinsp_logger::SEV_DEBUG, "(cgroup-limits) inotify queue overflow, dropping %zu cached limits",
+						m_entries.size());
+				for(const auto& it : m_watched_keys)
+				{
+					inotify_rm_watch(m_inotify_fd, it.first);
+				}
+				m_watched_keys.clear();
+				m_entries.clear();
+				continue;
+			}
+
+			// Events without a name are about the directory itself
+			if(event->len > 0 && !is_limit_file(event->name))
+			{
+				continue;
+			}
+
+			auto it = m_watched_keys.find(event->wd);
+			if(it == m_watched_keys.end())
+			{
+				continue;
+			}
+
+			// Invalidating the keys releases their watches, including this one
+			std::vector<cgroup_limits_key> keys = it->second;
+			for(const auto& key : keys)
+			{
+				g_logger.format(sinsp_logger::SEV_DEBUG, "(cgroup-limits) limits of container [%s] changed",
+						key.m_container_id.c_str());
+				invalidate(key);
+			}
+		}
+	}
+}
 }
 }
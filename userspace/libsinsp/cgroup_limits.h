@@ -1,7 +1,12 @@
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 #include "async/async_key_value_source.h"
 
 namespace {
@@ -128,4 +133,90 @@ template<> struct hash<libsinsp::cgroup_limits::cgroup_limits_key> {
 		return h1 ^ (h2 << 1u) ^ (h3 << 2u) ^ (h4 << 3u);
 	}
 };
-}
\ No newline at end of file
+}
+
+namespace libsinsp {
+namespace cgroup_limits {
+
+/**
+ * \brief Cache of the resource limits read from cgroupfs
+ *
+ * The limits of a key are read on its first lookup, then served from the
+ * cache until inotify reports a write to one of the limit files in its
+ * cgroup directories, or their removal. This keeps the limits fresh
+ * without re-reading cgroupfs every time the container is looked up again.
+ *
+ * When inotify is not available (or a watch can't be added, e.g. past
+ * fs.inotify.max_user_watches), the limits are read on every lookup.
+ *
+ * The cache is thread-safe, the async lookups can use it from their
+ * worker threads.
+ */
+class cgroup_limits_cache {
+public:
+	/**
+	 * \brief Read the limits of a key, see get_cgroup_resource_limits()
+	 */
+	using reader_t = std::function<bool(const cgroup_limits_key& key, cgroup_limits_value& value, bool name_check)>;
+
+	/**
+	 * \brief Return the mountpoint of a cgroup subsystem, see sinsp::lookup_cgroup_dir()
+	 */
+	using root_lookup_t = std::function<std::shared_ptr<std::string>(const std::string& subsys)>;
+
+	cgroup_limits_cache();
+	cgroup_limits_cache(reader_t reader, root_lookup_t root_lookup);
+	~cgroup_limits_cache();
+
+	cgroup_limits_cache(const cgroup_limits_cache&) = delete;
+	cgroup_limits_cache& operator=(const cgroup_limits_cache&) = delete;
+
+	/**
+	 * \brief Same as get_cgroup_resource_limits(), served from the cache
+	 * when the limits of the key didn't change since they were read
+	 */
+	bool get(const cgroup_limits_key& key, cgroup_limits_value& value, bool name_check = true);
+
+	/**
+	 * \brief Number of keys whose limits are cached
+	 */
+	size_t size();
+
+private:
+	struct entry {
+		cgroup_limits_value m_value;
+		bool m_found_all;
+		bool m_name_check;
+		std::vector<int> m_watches;
+	};
+
+	/**
+	 * \brief Watch the cgroup directory of a subsystem for a new entry
+	 * @return false if the directory can't be watched
+	 */
+	bool add_watch(const std::string& subsys, const std::string& cgroup, const cgroup_limits_key& key, entry& e);
+
+	/**
+	 * \brief Forget the key in the watches of its entry, and remove the
+	 * watches no other key uses
+	 */
+	void release_watches(const cgroup_limits_key& key, const std::vector<int>& watches);
+
+	void invalidate(const cgroup_limits_key& key);
+
+	/**
+	 * \brief Drop the entries whose limits changed, according to the
+	 * pending inotify events
+	 */
+	void process_events();
+
+	reader_t m_reader;
+	root_lookup_t m_root_lookup;
+	int m_inotify_fd;
+	std::mutex m_mutex;
+	std::unordered_map<cgroup_limits_key, entry> m_entries;
+	std::unordered_map<int, std::vector<cgroup_limits_key>> m_watched_keys;
+};
+
+}
+}
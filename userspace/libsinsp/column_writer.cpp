@@ -0,0 +1,253 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <cstring>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "filterchecks.h"
+#include "column_writer.h"
+
+sinsp_evt_column_writer::sinsp_evt_column_writer(sinsp* inspector,
+	const std::vector<std::string>& fields,
+	std::ostream& out,
+	uint32_t batch_size,
+	filter_check_list& available_checks):
+	m_out(out),
+	m_batch_size(batch_size),
+	m_batch_rows(0),
+	m_n_rows(0),
+	m_closed(false)
+{
+	if(fields.empty())
+	{
+		throw sinsp_exception("column writer: no fields");
+	}
+
+	if(m_batch_size == 0)
+	{
+		throw sinsp_exception("column writer: invalid batch size");
+	}
+
+	m_columns.resize(fields.size());
+	for(uint32_t j = 0; j < fields.size(); j++)
+	{
+		column& col = m_columns[j];
+		col.m_name = fields[j];
+		col.m_chk = available_checks.new_filter_check_from_fldname(fields[j], inspector, false);
+		if(col.m_chk == NULL)
+		{
+			throw sinsp_exception("column writer: invalid field " + fields[j]);
+		}
+
+		if(col.m_chk->parse_field_name(fields[j].c_str(), true, false) != (int32_t)fields[j].size())
+		{
+			throw sinsp_exception("column writer: invalid field " + fields[j]);
+		}
+
+		col.m_type = col.m_chk->get_field_info()->m_type;
+		col.m_width = get_column_width(col.m_type);
+		col.m_offsets.push_back(0);
+	}
+
+	write_bytes(COLUMN_WRITER_MAGIC, 4);
+	write_u32(COLUMN_WRITER_VERSION);
+	write_u32((uint32_t)m_columns.size());
+	for(const auto& col : m_columns)
+	{
+		write_u32((uint32_t)col.m_type);
+		write_u32((uint32_t)col.m_name.size());
+		write_bytes(col.m_name.data(), col.m_name.size());
+	}
+}
+
+sinsp_evt_column_writer::~sinsp_evt_column_writer()
+{
+	if(!m_closed)
+	{
+		try
+		{
+			close();
+		}
+		catch(const sinsp_exception&)
+		{
+			// destructors can't throw, call close() to see the error
+		}
+	}
+
+	for(auto& col : m_columns)
+	{
+		delete col.m_chk;
+	}
+}
+
+uint32_t sinsp_evt_column_writer::get_column_width(ppm_param_type type)
+{
+	switch(type)
+	{
+	case PT_INT8:
+	case PT_UINT8:
+	case PT_FLAGS8:
+	case PT_ENUMFLAGS8:
+	case PT_SIGTYPE:
+	case PT_L4PROTO:
+	case PT_SOCKFAMILY:
+		return 1;
+	case PT_INT16:
+	case PT_UINT16:
+	case PT_FLAGS16:
+	case PT_ENUMFLAGS16:
+	case PT_PORT:
+	case PT_SYSCALLID:
+		return 2;
+	case PT_INT32:
+	case PT_UINT32:
+	case PT_FLAGS32:
+	case PT_ENUMFLAGS32:
+	case PT_UID:
+	case PT_GID:
+	case PT_MODE:
+	case PT_BOOL:
+	case PT_IPV4ADDR:
+	case PT_SIGSET:
+		return 4;
+	case PT_INT64:
+	case PT_UINT64:
+	case PT_ERRNO:
+	case PT_FD:
+	case PT_PID:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+	case PT_DOUBLE:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+void sinsp_evt_column_writer::write(sinsp_evt* evt)
+{
+	if(m_closed)
+	{
+		throw sinsp_exception("column writer: write after close");
+	}
+
+	uint32_t row = m_batch_rows;
+	for(auto& col : m_columns)
+	{
+		if(row % 8 == 0)
+		{
+			col.m_validity.push_back(0);
+		}
+
+		m_values.clear();
+		bool has_value = col.m_chk->extract(evt, m_values, false) && !m_values.empty();
+		uint8_t* val = has_value? m_values[0].ptr : NULL;
+		uint32_t len = has_value? m_values[0].len : 0;
+
+		if(has_value)
+		{
+			col.m_validity.back() |= (uint8_t)(1 << (row % 8));
+		}
+
+		if(col.m_width != 0)
+		{
+			//
+			// Fixed-size values are padded or truncated to the width of the
+			// column type, so that rows stay aligned
+			//
+			size_t pos = col.m_data.size();
+			col.m_data.resize(pos + col.m_width, 0);
+			if(has_value)
+			{
+				memcpy(&col.m_data[pos], val, std::min(len, col.m_width));
+			}
+		}
+		else
+		{
+			if(has_value && len > 0 &&
+				(col.m_type == PT_CHARBUF || col.m_type == PT_FSPATH || col.m_type == PT_FSRELPATH) &&
+				val[len - 1] == 0)
+			{
+				len--;
+			}
+
+			col.m_data.insert(col.m_data.end(), val, val + len);
+			col.m_offsets.push_back((uint32_t)col.m_data.size());
+		}
+	}
+
+	m_batch_rows++;
+	m_n_rows++;
+
+	if(m_batch_rows == m_batch_size)
+	{
+		flush();
+	}
+}
+
+void sinsp_evt_column_writer::flush()
+{
+	if(m_batch_rows == 0)
+	{
+		return;
+	}
+
+	write_u32(m_batch_rows);
+	for(auto& col : m_columns)
+	{
+		write_bytes(col.m_validity.data(), col.m_validity.size());
+		if(col.m_width == 0)
+		{
+			write_bytes(col.m_offsets.data(), col.m_offsets.size() * sizeof(uint32_t));
+		}
+		write_bytes(col.m_data.data(), col.m_data.size());
+
+		col.m_validity.clear();
+		col.m_offsets.resize(1);
+		col.m_data.clear();
+	}
+
+	m_batch_rows = 0;
+}
+
+void sinsp_evt_column_writer::close()
+{
+	if(m_closed)
+	{
+		return;
+	}
+
+	flush();
+	write_u32(0);
+	m_out.flush();
+	m_closed = true;
+}
+
+void sinsp_evt_column_writer::write_u32(uint32_t v)
+{
+	write_bytes(&v, sizeof(v));
+}
+
+void sinsp_evt_column_writer::write_bytes(const void* data, size_t len)
+{
+	m_out.write((const char*)data, len);
+	if(!m_out)
+	{
+		throw sinsp_exception("column writer: error writing the output stream");
+	}
+}
@@ -0,0 +1,135 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "filter_check_list.h"
+#include "gen_filter.h"
+
+class sinsp_filter_check;
+
+#define COLUMN_WRITER_MAGIC "SCOL"
+#define COLUMN_WRITER_VERSION 1
+#define DEFAULT_COLUMN_BATCH_SIZE 4096
+
+/** @defgroup event Event manipulation
+ *  @{
+ */
+
+/*!
+  \brief Writes the values of a list of fields, extracted from each event,
+  as typed columns in a binary stream.
+
+  This is meant for offline processing of captures: the values are copied
+  as they are extracted, without being rendered as strings, and rows are
+  written in batches of columns. All the integers are in host byte order.
+
+  The stream starts with a header:
+   - the magic "SCOL" and a uint32 version (1)
+   - a uint32 number of columns, then for each column a uint32
+     ppm_param_type, a uint32 name length and the field name
+
+  It is followed by batches, each with a uint32 number of rows and then,
+  for each column:
+   - a validity bitmap of (nrows + 7) / 8 bytes, where bit i (LSB first)
+     is set if the field had a value in row i
+   - for fixed-size types (see get_column_width()), nrows values of that
+     size; rows without a value are zeroed
+   - for the other types, (nrows + 1) uint32 offsets followed by the data;
+     the value of row i goes from offsets[i] to offsets[i + 1]. Strings
+     are written without their terminator
+
+  A batch with 0 rows ends the stream. This is the layout of the Arrow
+  columnar format, so the buffers of a batch can be handed to Arrow as they
+  are.
+*/
+class SINSP_PUBLIC sinsp_evt_column_writer
+{
+public:
+	/*!
+	  \brief Constructs a writer and writes the stream header.
+
+	  \param inspector Pointer to the inspector instance that will generate the
+	   events.
+	  \param fields The names of the fields to extract, one per column.
+	  \param out The stream to write to.
+	  \param batch_size The number of rows buffered before a batch is
+	   written.
+	*/
+	sinsp_evt_column_writer(sinsp* inspector,
+		const std::vector<std::string>& fields,
+		std::ostream& out,
+		uint32_t batch_size = DEFAULT_COLUMN_BATCH_SIZE,
+		filter_check_list& available_checks = g_filterlist);
+
+	~sinsp_evt_column_writer();
+
+	/*!
+	  \brief Extracts the fields of evt and appends them as a row.
+	*/
+	void write(sinsp_evt* evt);
+
+	/*!
+	  \brief Writes the rows buffered so far as a batch.
+	*/
+	void flush();
+
+	/*!
+	  \brief Flushes the buffered rows and writes the end of the stream.
+	  No row can be written afterwards. Called by the destructor if needed.
+	*/
+	void close();
+
+	uint64_t get_n_rows() const
+	{
+		return m_n_rows;
+	}
+
+	/*!
+	  \brief Returns the size of the values of a fixed-size column type,
+	  or 0 if the values of the type are variable-size.
+	*/
+	static uint32_t get_column_width(ppm_param_type type);
+
+private:
+	struct column
+	{
+		std::string m_name;
+		sinsp_filter_check* m_chk;
+		ppm_param_type m_type;
+		uint32_t m_width;
+		std::vector<uint8_t> m_validity;
+		std::vector<uint32_t> m_offsets;
+		std::vector<uint8_t> m_data;
+	};
+
+	void write_u32(uint32_t v);
+	void write_bytes(const void* data, size_t len);
+
+	std::vector<column> m_columns;
+	std::vector<extract_value_t> m_values;
+	std::ostream& m_out;
+	uint32_t m_batch_size;
+	uint32_t m_batch_rows;
+	uint64_t m_n_rows;
+	bool m_closed;
+};
+/*@}*/
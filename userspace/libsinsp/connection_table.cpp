@@ -0,0 +1,278 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <string.h>
+
+#include "connection_table.h"
+
+#define CONNECTION_TABLE_MIN_SLOTS 64
+
+sinsp_connection_table::sinsp_connection_table(uint32_t max_size):
+	m_size(0),
+	m_max_size(max_size),
+	m_n_drops(0)
+{
+}
+
+void sinsp_connection_table::key(sinsp_connection& conn, const ipv4tuple& tuple)
+{
+	memset(&conn, 0, sizeof(conn));
+	conn.m_sip.m_b[0] = tuple.m_fields.m_sip;
+	conn.m_dip.m_b[0] = tuple.m_fields.m_dip;
+	conn.m_sport = tuple.m_fields.m_sport;
+	conn.m_dport = tuple.m_fields.m_dport;
+	conn.m_l4proto = tuple.m_fields.m_l4proto;
+	conn.m_family = 4;
+}
+
+void sinsp_connection_table::key(sinsp_connection& conn, const ipv6tuple& tuple)
+{
+	memset(&conn, 0, sizeof(conn));
+	conn.m_sip = tuple.m_fields.m_sip;
+	conn.m_dip = tuple.m_fields.m_dip;
+	conn.m_sport = tuple.m_fields.m_sport;
+	conn.m_dport = tuple.m_fields.m_dport;
+	conn.m_l4proto = tuple.m_fields.m_l4proto;
+	conn.m_family = 6;
+}
+
+uint64_t sinsp_connection_table::hash(const sinsp_connection& conn)
+{
+	// mix the 64-bit words of the key, then finalize as murmur3 does
+	const uint32_t* a = conn.m_sip.m_b;
+	const uint32_t* b = conn.m_dip.m_b;
+	uint64_t h = ((uint64_t)conn.m_sport << 32) | ((uint64_t)conn.m_dport << 16) |
+		((uint64_t)conn.m_l4proto << 8) | conn.m_family;
+	for(int i = 0; i < 4; i++)
+	{
+		h ^= ((uint64_t)a[i] << 32 | b[i]) * 0x9e3779b97f4a7c15ULL;
+		h = (h << 27) | (h >> 37);
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+bool sinsp_connection_table::same_key(const sinsp_connection& a, const sinsp_connection& b)
+{
+	return a.m_family == b.m_family &&
+		a.m_sport == b.m_sport &&
+		a.m_dport == b.m_dport &&
+		a.m_l4proto == b.m_l4proto &&
+		a.m_sip == b.m_sip &&
+		a.m_dip == b.m_dip;
+}
+
+size_t sinsp_connection_table::find_slot(const sinsp_connection& conn) const
+{
+	size_t mask = m_slots.size() - 1;
+	size_t i = hash(conn) & mask;
+	while(m_slots[i].m_family != 0 && !same_key(m_slots[i], conn))
+	{
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+void sinsp_connection_table::grow()
+{
+	std::vector<sinsp_connection> old;
+	old.swap(m_slots);
+	m_slots.resize(old.empty() ? CONNECTION_TABLE_MIN_SLOTS : old.size() * 2);
+	for(auto& slot : m_slots)
+	{
+		memset(&slot, 0, sizeof(slot));
+	}
+
+	for(const auto& conn : old)
+	{
+		if(conn.m_family != 0)
+		{
+			m_slots[find_slot(conn)] = conn;
+		}
+	}
+}
+
+static inline void set_end(sinsp_connection& slot, bool server, int64_t pid, int64_t fd)
+{
+	if(server)
+	{
+		slot.m_server_pid = pid;
+		slot.m_server_fd = fd;
+	}
+	else
+	{
+		slot.m_client_pid = pid;
+		slot.m_client_fd = fd;
+	}
+}
+
+void sinsp_connection_table::add(const sinsp_connection& conn, bool server, int64_t pid, int64_t fd)
+{
+	if(m_size != 0)
+	{
+		sinsp_connection& slot = m_slots[find_slot(conn)];
+		if(slot.m_family != 0)
+		{
+			set_end(slot, server, pid, fd);
+			return;
+		}
+	}
+
+	if(m_size >= m_max_size)
+	{
+		m_n_drops++;
+		return;
+	}
+
+	// keep the load factor under 1/2
+	if((m_size + 1) * 2 > m_slots.size())
+	{
+		grow();
+	}
+
+	sinsp_connection& slot = m_slots[find_slot(conn)];
+	slot = conn;
+	slot.m_client_pid = -1;
+	slot.m_client_fd = -1;
+	slot.m_server_pid = -1;
+	slot.m_server_fd = -1;
+	set_end(slot, server, pid, fd);
+	m_size++;
+}
+
+void sinsp_connection_table::erase_slot(size_t i)
+{
+	// Backward shift deletion: move back the following entries of the
+	// cluster that would not be found anymore, so that no tombstones are
+	// needed
+	size_t mask = m_slots.size() - 1;
+	size_t j = i;
+	while(true)
+	{
+		j = (j + 1) & mask;
+		if(m_slots[j].m_family == 0)
+		{
+			break;
+		}
+
+		size_t home = hash(m_slots[j]) & mask;
+		bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+		if(movable)
+		{
+			m_slots[i] = m_slots[j];
+			i = j;
+		}
+	}
+
+	memset(&m_slots[i], 0, sizeof(m_slots[i]));
+	m_size--;
+}
+
+void sinsp_connection_table::remove(const sinsp_connection& conn, int64_t pid, int64_t fd)
+{
+	if(m_size == 0)
+	{
+		return;
+	}
+
+	size_t i = find_slot(conn);
+	sinsp_connection& slot = m_slots[i];
+	if(slot.m_family == 0)
+	{
+		return;
+	}
+
+	if(slot.m_client_pid == pid && slot.m_client_fd == fd)
+	{
+		slot.m_client_pid = -1;
+		slot.m_client_fd = -1;
+	}
+	if(slot.m_server_pid == pid && slot.m_server_fd == fd)
+	{
+		slot.m_server_pid = -1;
+		slot.m_server_fd = -1;
+	}
+
+	if(slot.m_client_fd == -1 && slot.m_server_fd == -1)
+	{
+		erase_slot(i);
+	}
+}
+
+void sinsp_connection_table::add(const ipv4tuple& tuple, bool server, int64_t pid, int64_t fd)
+{
+	sinsp_connection conn;
+	key(conn, tuple);
+	add(conn, server, pid, fd);
+}
+
+void sinsp_connection_table::add(const ipv6tuple& tuple, bool server, int64_t pid, int64_t fd)
+{
+	sinsp_connection conn;
+	key(conn, tuple);
+	add(conn, server, pid, fd);
+}
+
+void sinsp_connection_table::remove(const ipv4tuple& tuple, int64_t pid, int64_t fd)
+{
+	sinsp_connection conn;
+	key(conn, tuple);
+	remove(conn, pid, fd);
+}
+
+void sinsp_connection_table::remove(const ipv6tuple& tuple, int64_t pid, int64_t fd)
+{
+	sinsp_connection conn;
+	key(conn, tuple);
+	remove(conn, pid, fd);
+}
+
+const sinsp_connection* sinsp_connection_table::find(const ipv4tuple& tuple) const
+{
+	if(m_size == 0)
+	{
+		return NULL;
+	}
+
+	sinsp_connection conn;
+	key(conn, tuple);
+	const sinsp_connection& slot = m_slots[find_slot(conn)];
+	return slot.m_family == 0 ? NULL : &slot;
+}
+
+const sinsp_connection* sinsp_connection_table::find(const ipv6tuple& tuple) const
+{
+	if(m_size == 0)
+	{
+		return NULL;
+	}
+
+	sinsp_connection conn;
+	key(conn, tuple);
+	const sinsp_connection& slot = m_slots[find_slot(conn)];
+	return slot.m_family == 0 ? NULL : &slot;
+}
+
+void sinsp_connection_table::clear()
+{
+	m_slots.clear();
+	m_size = 0;
+}
@@ -0,0 +1,109 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "tuples.h"
+
+#define DEFAULT_MAX_CONNECTIONS 262144
+
+/*!
+	\brief A connection of the connection table: its 5-tuple, and the
+	process and fd of its client and server ends that are known, if any.
+	The unknown ends have a -1 pid and fd.
+*/
+struct sinsp_connection
+{
+	// IPv4 addresses are in the first word of the ipv6addr, the others are 0
+	ipv6addr m_sip;
+	ipv6addr m_dip;
+	uint16_t m_sport;
+	uint16_t m_dport;
+	uint8_t m_l4proto;
+	// 4 or 6, 0 for the empty slots of the table
+	uint8_t m_family;
+
+	int64_t m_client_pid;
+	int64_t m_client_fd;
+	int64_t m_server_pid;
+	int64_t m_server_fd;
+};
+
+/*!
+	\brief A global index of the IPv4 and IPv6 connections by 5-tuple, kept
+	up to date by the parser on connect, accept and fd removal.
+
+	Since the client and the server end of a connection have the same tuple,
+	a lookup also tells which local process owns the peer end, if any.
+	The table uses open addressing with linear probing, and doesn't grow
+	beyond its maximum size: the connections that don't fit are dropped
+	and counted.
+*/
+class sinsp_connection_table
+{
+public:
+	sinsp_connection_table(uint32_t max_size = DEFAULT_MAX_CONNECTIONS);
+
+	// Record the fd of process pid as the client or server end of a connection
+	void add(const ipv4tuple& tuple, bool server, int64_t pid, int64_t fd);
+	void add(const ipv6tuple& tuple, bool server, int64_t pid, int64_t fd);
+
+	// Forget the end of a connection, if it's the fd of process pid. The
+	// connection is removed when both its ends are gone.
+	void remove(const ipv4tuple& tuple, int64_t pid, int64_t fd);
+	void remove(const ipv6tuple& tuple, int64_t pid, int64_t fd);
+
+	// NULL if the connection is not in the table. The pointer is valid
+	// until the next change of the table.
+	const sinsp_connection* find(const ipv4tuple& tuple) const;
+	const sinsp_connection* find(const ipv6tuple& tuple) const;
+
+	inline size_t size() const
+	{
+		return m_size;
+	}
+
+	inline uint64_t get_n_drops() const
+	{
+		return m_n_drops;
+	}
+
+	void clear();
+
+private:
+	static void key(sinsp_connection& conn, const ipv4tuple& tuple);
+	static void key(sinsp_connection& conn, const ipv6tuple& tuple);
+	static uint64_t hash(const sinsp_connection& conn);
+	static bool same_key(const sinsp_connection& a, const sinsp_connection& b);
+
+	// Index of the slot of the connection, or of the empty slot where it
+	// would go
+	size_t find_slot(const sinsp_connection& conn) const;
+	void add(const sinsp_connection& conn, bool server, int64_t pid, int64_t fd);
+	void remove(const sinsp_connection& conn, int64_t pid, int64_t fd);
+	void erase_slot(size_t i);
+	void grow();
+
+	std::vector<sinsp_connection> m_slots;
+	size_t m_size;
+	uint32_t m_max_size;
+	uint64_t m_n_drops;
+};
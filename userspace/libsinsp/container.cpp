@@ -16,6 +16,7 @@ limitations under the License.
 */
 
 #include <algorithm>
+#include <fstream>
 
 #ifndef MINIMAL_BUILD
 #ifdef HAS_CAPTURE
@@ -32,14 +33,478 @@ limitations under the License.
 #include "container_engine/bpm.h"
 #endif // MINIMAL_BUILD
 #include "container_engine/static_container.h"
+#if !defined(MINIMAL_BUILD) && !defined(_WIN32)
+#include "container_engine/docker/async_source.h"
+#endif
 
 #include "sinsp.h"
 #include "sinsp_int.h"
 #include "container.h"
 #include "utils.h"
+#include "json_stream.h"
 
 using namespace libsinsp;
 
+namespace
+{
+	void log_unconvertible(const char* field, bool log_message)
+	{
+		if(log_message)
+		{
+			SINSP_WARNING("Unable to convert json value for the field: '%s'", field);
+		}
+		else
+		{
+			SINSP_DEBUG("Unable to convert json value for the field: '%s'", field);
+		}
+	}
+
+	//
+	// Read the value of a member of a container JSON: null values are
+	// ignored, values of another type are skipped and logged
+	//
+	bool read_json_string(json::reader& r, const char* field, std::string& val)
+	{
+		if(r.peek() == json::reader::T_NULL)
+		{
+			r.skip();
+			return false;
+		}
+
+		if(!r.read_string(val))
+		{
+			log_unconvertible(field, false);
+			return false;
+		}
+		return true;
+	}
+
+	bool read_json_bool(json::reader& r, const char* field, bool& val)
+	{
+		if(r.peek() == json::reader::T_NULL)
+		{
+			r.skip();
+			return false;
+		}
+
+		if(!r.read_bool(val))
+		{
+			log_unconvertible(field, false);
+			return false;
+		}
+		return true;
+	}
+
+	bool read_json_int64(json::reader& r, const char* field, int64_t& val,
+			     int64_t min = INT64_MIN, int64_t max = INT64_MAX, bool log_message = false)
+	{
+		if(r.peek() == json::reader::T_NULL)
+		{
+			r.skip();
+			return false;
+		}
+
+		int64_t v;
+		if(!r.read_int64(v) || v < min || v > max)
+		{
+			log_unconvertible(field, log_message);
+			return false;
+		}
+		val = v;
+		return true;
+	}
+
+	bool read_json_uint64(json::reader& r, const char* field, uint64_t& val, uint64_t max = UINT64_MAX)
+	{
+		if(r.peek() == json::reader::T_NULL)
+		{
+			r.skip();
+			return false;
+		}
+
+		uint64_t v;
+		if(!r.read_uint64(v) || v > max)
+		{
+			log_unconvertible(field, false);
+			return false;
+		}
+		val = v;
+		return true;
+	}
+
+	void read_json_port_mapping(json::reader& r, sinsp_container_info::container_port_mapping& map)
+	{
+		std::string key;
+		int64_t val;
+		while(r.next_member(key))
+		{
+			// We log the conversion failures at Warning level
+			if(key == "HostIp")
+			{
+				if(read_json_int64(r, "HostIp", val, INT32_MIN, UINT32_MAX, true))
+				{
+					map.m_host_ip = (uint32_t)val;
+				}
+			}
+			else if(key == "HostPort")
+			{
+				if(read_json_int64(r, "HostPort", val, INT32_MIN, INT32_MAX, true))
+				{
+					map.m_host_port = (uint16_t)val;
+				}
+			}
+			else if(key == "ContainerPort")
+			{
+				if(read_json_int64(r, "ContainerPort", val, INT32_MIN, INT32_MAX, true))
+				{
+					map.m_container_port = (uint16_t)val;
+				}
+			}
+			else
+			{
+				r.skip();
+			}
+		}
+	}
+
+#if !defined(MINIMAL_BUILD) && !defined(_WIN32)
+	void read_json_mount(json::reader& r, sinsp_container_info::container_mount_info& mount)
+	{
+		std::string key;
+		while(r.next_member(key))
+		{
+			if(key == "Source")
+			{
+				read_json_string(r, "Source", mount.m_source);
+			}
+			else if(key == "Destination")
+			{
+				read_json_string(r, "Destination", mount.m_dest);
+			}
+			else if(key == "Mode")
+			{
+				read_json_string(r, "Mode", mount.m_mode);
+			}
+			else if(key == "RW")
+			{
+				read_json_bool(r, "RW", mount.m_rdwr);
+			}
+			else if(key == "Propagation")
+			{
+				read_json_string(r, "Propagation", mount.m_propagation);
+			}
+			else
+			{
+				r.skip();
+			}
+		}
+	}
+#endif
+
+	// Returns false if the probe has no exe
+	bool read_json_health_probe(json::reader& r, std::string& exe, std::vector<std::string>& args)
+	{
+		bool has_exe = false;
+		std::string key;
+		while(r.next_member(key))
+		{
+			if(key == "exe")
+			{
+				has_exe = read_json_string(r, "exe", exe);
+			}
+			else if(key == "args" && r.peek() == json::reader::T_ARRAY)
+			{
+				r.begin_array();
+				args.clear();
+				std::string arg;
+				while(r.next_element())
+				{
+					if(r.read_string(arg))
+					{
+						args.push_back(arg);
+					}
+				}
+			}
+			else
+			{
+				r.skip();
+			}
+		}
+		return has_exe;
+	}
+
+	void read_json_container(json::reader& r, sinsp_container_info& container_info)
+	{
+		using probe = sinsp_container_info::container_health_probe;
+
+		// The probes are added in the order of their types, whatever
+		// their order in the JSON
+		std::string probe_exes[probe::PT_END];
+		std::vector<std::string> probe_args[probe::PT_END];
+		bool has_probe[probe::PT_END] = {};
+
+		std::string key;
+		std::string str;
+		int64_t i64;
+		uint64_t u64;
+		while(r.next_member(key))
+		{
+			if(key == "id")
+			{
+				read_json_string(r, "id", container_info.m_id);
+			}
+			else if(key == "full_id")
+			{
+				read_json_string(r, "full_id", container_info.m_full_id);
+			}
+			else if(key == "type")
+			{
+				if(read_json_uint64(r, "type", u64, UINT32_MAX))
+				{
+					container_info.m_type = static_cast<sinsp_container_type>(u64);
+				}
+			}
+			else if(key == "name")
+			{
+				read_json_string(r, "name", container_info.m_name);
+			}
+			else if(key == "is_pod_sandbox")
+			{
+				read_json_bool(r, "is_pod_sandbox", container_info.m_is_pod_sandbox);
+			}
+			else if(key == "image")
+			{
+				read_json_string(r, "image", container_info.m_image);
+			}
+			else if(key == "imageid")
+			{
+				read_json_string(r, "imageid", container_info.m_imageid);
+			}
+			else if(key == "imagerepo")
+			{
+				read_json_string(r, "imagerepo", container_info.m_imagerepo);
+			}
+			else if(key == "imagetag")
+			{
+				read_json_string(r, "imagetag", container_info.m_imagetag);
+			}
+			else if(key == "imagedigest")
+			{
+				read_json_string(r, "imagedigest", container_info.m_imagedigest);
+			}
+			else if(key == "privileged")
+			{
+				read_json_bool(r, "privileged", container_info.m_privileged);
+			}
+			else if(key == "lookup_state")
+			{
+				if(read_json_uint64(r, "lookup_state", u64, UINT32_MAX))
+				{
+					container_info.set_lookup_status(static_cast<sinsp_container_lookup::state>(u64));
+					switch(container_info.get_lookup_status())
+					{
+					case sinsp_container_lookup::state::STARTED:
+					case sinsp_container_lookup::state::SUCCESSFUL:
+					case sinsp_container_lookup::state::FAILED:
+						break;
+					default:
+						container_info.set_lookup_status(sinsp_container_lookup::state::SUCCESSFUL);
+					}
+				}
+			}
+			else if(key == "created_time")
+			{
+				read_json_int64(r, "created_time", container_info.m_created_time);
+			}
+#if !defined(MINIMAL_BUILD) && !defined(_WIN32)
+			else if(key == "Mounts" && r.peek() == json::reader::T_ARRAY)
+			{
+				r.begin_array();
+				while(r.next_element())
+				{
+					if(r.begin_object())
+					{
+						container_info.m_mounts.emplace_back();
+						read_json_mount(r, container_info.m_mounts.back());
+					}
+				}
+			}
+#endif
+			else if(key == "User")
+			{
+				read_json_string(r, "User", container_info.m_container_user);
+			}
+			else if(key == "ip")
+			{
+				if(read_json_string(r, "ip", str))
+				{
+					uint32_t ip;
+
+					if(inet_pton(AF_INET, str.c_str(), &ip) == -1)
+					{
+						throw sinsp_exception("Invalid 'ip' field while parsing container info: " + str);
+					}
+
+					container_info.m_container_ip = ntohl(ip);
+				}
+			}
+			else if(key == "cni_json")
+			{
+				read_json_string(r, "cni_json", container_info.m_pod_cniresult);
+			}
+			else if(key == "port_mappings" && r.peek() == json::reader::T_ARRAY)
+			{
+				r.begin_array();
+				while(r.next_element())
+				{
+					if(r.begin_object())
+					{
+						sinsp_container_info::container_port_mapping map;
+						read_json_port_mapping(r, map);
+						container_info.m_port_mappings.push_back(map);
+					}
+				}
+			}
+			else if(key == "labels" && r.peek() == json::reader::T_OBJECT)
+			{
+				r.begin_object();
+				std::string label;
+				while(r.next_member(label))
+				{
+					// null labels are empty, the other values are
+					// skipped
+					str.clear();
+					if(r.peek() == json::reader::T_NULL)
+					{
+						r.skip();
+					}
+					else if(!r.read_string(str))
+					{
+						continue;
+					}
+					container_info.m_labels[label] = str;
+				}
+			}
+			else if(key == "env" && r.peek() == json::reader::T_ARRAY)
+			{
+				r.begin_array();
+				while(r.next_element())
+				{
+					if(r.read_string(str))
+					{
+						container_info.m_env.emplace_back(str);
+					}
+				}
+			}
+			else if(key == "memory_limit")
+			{
+				read_json_int64(r, "memory_limit", container_info.m_memory_limit);
+			}
+			else if(key == "swap_limit")
+			{
+				read_json_int64(r, "swap_limit", container_info.m_swap_limit);
+			}
+			else if(key == "cpu_shares")
+			{
+				read_json_int64(r, "cpu_shares", container_info.m_cpu_shares);
+			}
+			else if(key == "cpu_quota")
+			{
+				read_json_int64(r, "cpu_quota", container_info.m_cpu_quota);
+			}
+			else if(key == "cpu_period")
+			{
+				read_json_int64(r, "cpu_period", container_info.m_cpu_period);
+			}
+			else if(key == "cpuset_cpu_count")
+			{
+				if(read_json_int64(r, "cpuset_cpu_count", i64, INT32_MIN, INT32_MAX))
+				{
+					container_info.m_cpuset_cpu_count = (int32_t)i64;
+				}
+			}
+			else if(key == "mesos_task_id")
+			{
+				read_json_string(r, "mesos_task_id", container_info.m_mesos_task_id);
+			}
+			else if(key == "metadata_deadline")
+			{
+				read_json_uint64(r, "metadata_deadline", container_info.m_metadata_deadline);
+			}
+			else
+			{
+				bool is_probe = false;
+				for(int i = probe::PT_NONE; i != probe::PT_END; i++)
+				{
+					if(key == probe::probe_type_names[i])
+					{
+						is_probe = true;
+						if(r.begin_object())
+						{
+							has_probe[i] = read_json_health_probe(r, probe_exes[i], probe_args[i]);
+						}
+						break;
+					}
+				}
+
+				if(!is_probe)
+				{
+					r.skip();
+				}
+			}
+		}
+
+		for(int i = probe::PT_NONE; i != probe::PT_END; i++)
+		{
+			if(has_probe[i])
+			{
+				container_info.m_health_probes.emplace_back(static_cast<probe::probe_type>(i),
+									    std::move(probe_exes[i]),
+									    std::move(probe_args[i]));
+			}
+		}
+	}
+
+	// Bumped when the snapshot layout changes, older files are ignored
+	const uint32_t SNAPSHOT_VERSION = 1;
+
+	// Distinct cgroup sets remembered by resolve_container()
+	const size_t MAX_CGROUP_CACHE_SIZE = 8192;
+
+	// Shortest run of hex digits taken for a container id in a cgroup path
+	const size_t MIN_CGROUP_ID_LEN = 12;
+
+	//
+	// The layout of the cgroups of a container: the path of the first
+	// cgroup holding a container id in its last component, with the id
+	// masked, e.g. "/docker/*" or "/system.slice/cri-containerd-*.scope".
+	// Empty when no cgroup holds an id.
+	//
+	std::string cgroup_layout(const sinsp_threadinfo::cgroups_t& cgroups)
+	{
+		for(const auto& cgroup : cgroups)
+		{
+			const std::string& path = cgroup.second;
+			std::string::size_type pos = path.rfind('/');
+			size_t run = 0;
+			for(size_t i = (pos == std::string::npos ? 0 : pos + 1); i <= path.size(); i++)
+			{
+				if(i < path.size() && isxdigit(static_cast<unsigned char>(path[i])))
+				{
+					run++;
+					continue;
+				}
+				if(run >= MIN_CGROUP_ID_LEN)
+				{
+					return path.substr(0, i - run) + '*' + path.substr(i);
+				}
+				run = 0;
+			}
+		}
+		return "";
+	}
+}
+
 sinsp_container_manager::sinsp_container_manager(sinsp* inspector, bool static_container, const std::string static_id, const std::string static_name, const std::string static_image) :
 	m_inspector(inspector),
 	m_last_flush_time_ns(0),
@@ -95,6 +560,8 @@ bool sinsp_container_manager::remove_inactive_containers()
 				{
 					remove_cb(*container);
 				}
+				m_memory.remove(estimate_memory(*container));
+				remove_slot(it->first);
 				containers->erase(it++);
 			}
 			else
@@ -119,6 +586,89 @@ sinsp_container_info::ptr_t sinsp_container_manager::get_container(const std::st
 	return nullptr;
 }
 
+sinsp_container_info::ptr_t sinsp_container_manager::get_container(sinsp_threadinfo* tinfo) const
+{
+	if(tinfo->m_container_id.empty())
+	{
+		return nullptr;
+	}
+
+	auto containers = m_containers.lock();
+	uint32_t index = (uint32_t)tinfo->m_container_handle;
+	if(index < m_slots.size())
+	{
+		//
+		// The engines and the plugins set the container id of the
+		// threads directly, so the handle is checked against it too
+		//
+		const container_slot& slot = m_slots[index];
+		if(slot.m_generation == (uint32_t)(tinfo->m_container_handle >> 32) &&
+		   slot.m_info != nullptr &&
+		   slot.m_info->m_id == tinfo->m_container_id)
+		{
+			return slot.m_info;
+		}
+	}
+
+	auto it = m_slot_by_id.find(tinfo->m_container_id);
+	if(it == m_slot_by_id.end())
+	{
+		tinfo->m_container_handle = 0;
+		return nullptr;
+	}
+
+	const container_slot& slot = m_slots[it->second];
+	tinfo->m_container_handle = ((uint64_t)slot.m_generation << 32) | it->second;
+	return slot.m_info;
+}
+
+// Called with m_containers locked
+void sinsp_container_manager::add_slot(const sinsp_container_info::ptr_t& container_info)
+{
+	auto it = m_slot_by_id.find(container_info->m_id);
+	if(it != m_slot_by_id.end())
+	{
+		m_slots[it->second].m_info = container_info;
+		return;
+	}
+
+	uint32_t index;
+	if(!m_free_slots.empty())
+	{
+		index = m_free_slots.back();
+		m_free_slots.pop_back();
+	}
+	else
+	{
+		// Generation 0 is never used, so that a zeroed handle
+		// doesn't match the first slot
+		index = m_slots.size();
+		m_slots.push_back({nullptr, 1});
+	}
+
+	m_slots[index].m_info = container_info;
+	m_slot_by_id[container_info->m_id] = index;
+}
+
+// Called with m_containers locked
+void sinsp_container_manager::remove_slot(const std::string& container_id)
+{
+	auto it = m_slot_by_id.find(container_id);
+	if(it == m_slot_by_id.end())
+	{
+		return;
+	}
+
+	container_slot& slot = m_slots[it->second];
+	slot.m_info = nullptr;
+	if(++slot.m_generation == 0)
+	{
+		slot.m_generation = 1;
+	}
+	m_free_slots.push_back(it->second);
+	m_slot_by_id.erase(it);
+}
+
 bool sinsp_container_manager::resolve_container(sinsp_threadinfo* tinfo, bool query_os_for_missing_info)
 {
 	ASSERT(tinfo);
@@ -137,90 +687,231 @@ bool sinsp_container_manager::resolve_container(sinsp_threadinfo* tinfo, bool qu
 		create_engines();
 	}
 
-	for(auto &eng : m_container_engines)
+	//
+	// The threads with the same cgroups belong to the same container, so
+	// once one of them has been resolved the others don't need to go
+	// through the matching of every engine again. The cgroups parameter
+	// is used as the key, so that they don't even need to be parsed.
+	//
+	const std::string& key = tinfo->get_cgroups_param();
+	if(!matches && !key.empty())
 	{
-		matches = matches || eng->resolve(tinfo, query_os_for_missing_info);
-		if(matches)
+		auto cached = m_cgroup_cache.find(key);
+		if(cached != m_cgroup_cache.end())
 		{
-			break;
+			sinsp_container_info::ptr_t container = get_container(cached->second.m_container_id);
+			if(container != nullptr && container->m_type == cached->second.m_type && container->is_successful())
+			{
+				tinfo->m_container_id = container->m_id;
+				identify_category(tinfo);
+				return true;
+			}
+			m_cgroup_cache.erase(cached);
+		}
+	}
+
+	//
+	// A cgroup layout is handled by a single engine, so the new containers
+	// go straight to the engine that resolved the previous ones with the
+	// same layout, and only go through the others if it doesn't match.
+	//
+	std::string layout;
+	container_engine::container_engine_base* routed = nullptr;
+	if(!matches && m_container_engines.size() > 1)
+	{
+		layout = cgroup_layout(tinfo->cgroups());
+		if(!layout.empty())
+		{
+			auto route = m_engine_routes.find(layout);
+			if(route != m_engine_routes.end())
+			{
+				routed = route->second;
+				matches = routed->resolve(tinfo, query_os_for_missing_info);
+			}
+		}
+	}
+
+	if(!matches)
+	{
+		for(auto &eng : m_container_engines)
+		{
+			if(eng.get() != routed && eng->resolve(tinfo, query_os_for_missing_info))
+			{
+				matches = true;
+				if(!layout.empty() && !tinfo->m_container_id.empty())
+				{
+					add_engine_route(layout, tinfo->m_container_id, eng.get());
+				}
+				break;
+			}
 		}
 	}
 
+	if(matches && !key.empty() && !tinfo->m_container_id.empty())
+	{
+		cache_cgroups(key, tinfo->m_container_id);
+	}
+
 	// Also possibly set the category for the threadinfo
 	identify_category(tinfo);
 
 	return matches;
 }
 
-std::string sinsp_container_manager::container_to_json(const sinsp_container_info& container_info)
+void sinsp_container_manager::cache_cgroups(const std::string& key, const std::string& container_id)
 {
-	Json::Value obj;
-	Json::Value& container = obj["container"];
-	container["id"] = container_info.m_id;
-	container["full_id"] = container_info.m_full_id;
-	container["type"] = container_info.m_type;
-	container["name"] = container_info.m_name;
-	container["image"] = container_info.m_image;
-	container["imageid"] = container_info.m_imageid;
-	container["imagerepo"] = container_info.m_imagerepo;
-	container["imagetag"] = container_info.m_imagetag;
-	container["imagedigest"] = container_info.m_imagedigest;
-	container["privileged"] = container_info.m_privileged;
-	container["is_pod_sandbox"] = container_info.m_is_pod_sandbox;
-	container["lookup_state"] = static_cast<int>(container_info.get_lookup_status());
-	container["created_time"] = static_cast<Json::Value::Int64>(container_info.m_created_time);
+	sinsp_container_info::ptr_t container = get_container(container_id);
 
-	Json::Value mounts = Json::arrayValue;
+	// Only complete lookups are cached, pending ones still need the
+	// engine. Mesos and rkt containers also depend on the environment
+	// and on the parents of the thread, not only on its cgroups.
+	if(container == nullptr || !container->is_successful() ||
+	   container->m_type == CT_MESOS || container->m_type == CT_RKT)
+	{
+		return;
+	}
 
-	for (auto &mntinfo : container_info.m_mounts)
+	if(m_cgroup_cache.size() >= MAX_CGROUP_CACHE_SIZE)
 	{
-		Json::Value mount;
+		m_cgroup_cache.clear();
+	}
+
+	m_cgroup_cache[key] = {container->m_id, container->m_type};
+}
 
-		mount["Source"] = mntinfo.m_source;
-		mount["Destination"] = mntinfo.m_dest;
-		mount["Mode"] = mntinfo.m_mode;
-		mount["RW"] = mntinfo.m_rdwr;
-		mount["Propagation"] = mntinfo.m_propagation;
+void sinsp_container_manager::add_engine_route(const std::string& layout, const std::string& container_id,
+					       container_engine::container_engine_base* engine)
+{
+	// Mesos and rkt containers are not found from the cgroups alone
+	sinsp_container_info::ptr_t container = get_container(container_id);
+	if(container == nullptr || container->m_type == CT_MESOS || container->m_type == CT_RKT)
+	{
+		return;
+	}
 
-		mounts.append(mount);
+	if(m_engine_routes.size() >= MAX_CGROUP_CACHE_SIZE)
+	{
+		m_engine_routes.clear();
 	}
 
-	container["Mounts"] = mounts;
+	m_engine_routes[layout] = engine;
+}
 
-	container["User"] = container_info.m_container_user;
+std::string sinsp_container_manager::container_to_json(const sinsp_container_info& container_info)
+{
+	std::string json;
+	container_to_json(container_info, json);
+	return json;
+}
 
-	sinsp_container_info::container_health_probe::add_health_probes(container_info.m_health_probes, container);
+void sinsp_container_manager::container_to_json(const sinsp_container_info& container_info, std::string& json)
+{
+	json::writer w(json);
+
+	w.begin_object();
+	w.key("container");
+	w.begin_object();
+
+	w.key("id");
+	w.value(container_info.m_id);
+	w.key("full_id");
+	w.value(container_info.m_full_id);
+	w.key("type");
+	w.value((int64_t)container_info.m_type);
+	w.key("name");
+	w.value(container_info.m_name);
+	w.key("image");
+	w.value(container_info.m_image);
+	w.key("imageid");
+	w.value(container_info.m_imageid);
+	w.key("imagerepo");
+	w.value(container_info.m_imagerepo);
+	w.key("imagetag");
+	w.value(container_info.m_imagetag);
+	w.key("imagedigest");
+	w.value(container_info.m_imagedigest);
+	w.key("privileged");
+	w.value(container_info.m_privileged);
+	w.key("is_pod_sandbox");
+	w.value(container_info.m_is_pod_sandbox);
+	w.key("lookup_state");
+	w.value((int64_t)container_info.get_lookup_status());
+	w.key("created_time");
+	w.value((int64_t)container_info.m_created_time);
+
+	w.key("Mounts");
+	w.begin_array();
+	for(auto &mntinfo : container_info.m_mounts)
+	{
+		w.begin_object();
+		w.key("Source");
+		w.value(mntinfo.m_source);
+		w.key("Destination");
+		w.value(mntinfo.m_dest);
+		w.key("Mode");
+		w.value(mntinfo.m_mode);
+		w.key("RW");
+		w.value(mntinfo.m_rdwr);
+		w.key("Propagation");
+		w.value(mntinfo.m_propagation);
+		w.end_object();
+	}
+	w.end_array();
 
-	char addrbuff[100];
-	uint32_t iph = htonl(container_info.m_container_ip);
-	inet_ntop(AF_INET, &iph, addrbuff, sizeof(addrbuff));
-	container["ip"] = addrbuff;
+	w.key("User");
+	w.value(container_info.m_container_user);
+
+	for(auto &probe : container_info.m_health_probes)
+	{
+		w.key(sinsp_container_info::container_health_probe::probe_type_names[probe.m_probe_type].c_str());
+		w.begin_object();
+		w.key("exe");
+		w.value(probe.m_health_probe_exe);
+		w.key("args");
+		w.begin_array();
+		for(auto &arg : probe.m_health_probe_args)
+		{
+			w.value(arg);
+		}
+		w.end_array();
+		w.end_object();
+	}
 
-	container["cni_json"] = container_info.m_pod_cniresult;
+	char addrbuff[16];
+	uint32_t iph = htonl(container_info.m_container_ip);
+	char* end = sinsp_utils::ipv4_to_chars(addrbuff, (const uint8_t*)&iph);
+	w.key("ip");
+	w.value(addrbuff, end - addrbuff);
 
-	Json::Value port_mappings = Json::arrayValue;
+	w.key("cni_json");
+	w.value(container_info.m_pod_cniresult);
 
+	w.key("port_mappings");
+	w.begin_array();
 	for(auto &mapping : container_info.m_port_mappings)
 	{
-		Json::Value jmap;
-		jmap["HostIp"] = mapping.m_host_ip;
-		jmap["HostPort"] = mapping.m_host_port;
-		jmap["ContainerPort"] = mapping.m_container_port;
-
-		port_mappings.append(jmap);
+		w.begin_object();
+		w.key("HostIp");
+		w.value((uint64_t)mapping.m_host_ip);
+		w.key("HostPort");
+		w.value((uint64_t)mapping.m_host_port);
+		w.key("ContainerPort");
+		w.value((uint64_t)mapping.m_container_port);
+		w.end_object();
 	}
+	w.end_array();
 
-	container["port_mappings"] = port_mappings;
-
-	Json::Value labels;
+	w.key("labels");
+	w.begin_object();
 	for (auto &pair : container_info.m_labels)
 	{
-		labels[pair.first] = pair.second;
+		w.key(pair.first.c_str());
+		w.value(pair.second);
 	}
-	container["labels"] = labels;
-
-	Json::Value env_vars = Json::arrayValue;
+	w.end_object();
 
+	w.key("env");
+	w.begin_array();
 	for (auto &var : container_info.m_env)
 	{
 		// Only append a limited set of mesos/marathon-related
@@ -229,68 +920,114 @@ std::string sinsp_container_manager::container_to_json(const sinsp_container_inf
 		   var.find("MARATHON") != std::string::npos ||
 		   var.find("mesos") != std::string::npos)
 		{
-			env_vars.append(var);
+			w.value(var);
 		}
 	}
-	container["env"] = env_vars;
-
-	container["memory_limit"] = (Json::Value::Int64) container_info.m_memory_limit;
-	container["swap_limit"] = (Json::Value::Int64) container_info.m_swap_limit;
-	container["cpu_shares"] = (Json::Value::Int64) container_info.m_cpu_shares;
-	container["cpu_quota"] = (Json::Value::Int64) container_info.m_cpu_quota;
-	container["cpu_period"] = (Json::Value::Int64) container_info.m_cpu_period;
-	container["cpuset_cpu_count"] = (Json::Value::Int) container_info.m_cpuset_cpu_count;
+	w.end_array();
+
+	w.key("memory_limit");
+	w.value((int64_t)container_info.m_memory_limit);
+	w.key("swap_limit");
+	w.value((int64_t)container_info.m_swap_limit);
+	w.key("cpu_shares");
+	w.value((int64_t)container_info.m_cpu_shares);
+	w.key("cpu_quota");
+	w.value((int64_t)container_info.m_cpu_quota);
+	w.key("cpu_period");
+	w.value((int64_t)container_info.m_cpu_period);
+	w.key("cpuset_cpu_count");
+	w.value((int64_t)container_info.m_cpuset_cpu_count);
 
 	if(!container_info.m_mesos_task_id.empty())
 	{
-		container["mesos_task_id"] = container_info.m_mesos_task_id;
+		w.key("mesos_task_id");
+		w.value(container_info.m_mesos_task_id);
 	}
 
-	container["metadata_deadline"] = (Json::Value::UInt64) container_info.m_metadata_deadline;
-	return Json::FastWriter().write(obj);
+	w.key("metadata_deadline");
+	w.value((uint64_t)container_info.m_metadata_deadline);
+
+	w.end_object();
+	w.end_object();
 }
 
-bool sinsp_container_manager::container_to_sinsp_event(const std::string& json, sinsp_evt* evt, std::shared_ptr<sinsp_threadinfo> tinfo)
+void sinsp_container_manager::container_to_json(const sinsp_container_info& container_info, Json::Value& container)
 {
-	size_t totlen = sizeof(scap_evt) + sizeof(uint32_t) + json.length() + 1;
+	Json::Value root;
+	std::string json = container_to_json(container_info);
+	Json::Reader().parse(json, root);
+	container = root["container"];
+}
 
-	ASSERT(evt->m_pevt_storage == nullptr);
-	evt->m_pevt_storage = new char[totlen];
-	evt->m_pevt = (scap_evt *) evt->m_pevt_storage;
+bool sinsp_container_manager::container_from_json(const char* json, size_t len, sinsp_container_info& container_info, std::string& error)
+{
+	json::reader r(json, len);
+	std::string key;
 
-	evt->m_cpuid = 0;
-	evt->m_evtnum = 0;
-	evt->m_inspector = m_inspector;
+	if(r.begin_object())
+	{
+		while(r.next_member(key))
+		{
+			if(key == "container")
+			{
+				if(r.begin_object())
+				{
+					read_json_container(r, container_info);
+				}
+			}
+			else
+			{
+				r.skip();
+			}
+		}
+	}
+	else if(!r.error())
+	{
+		error = "expected an object";
+		return false;
+	}
 
-	scap_evt* scapevt = evt->m_pevt;
+	if(!r.at_end())
+	{
+		error = r.error() ? r.get_error() : "unexpected data after the object";
+		return false;
+	}
+	return true;
+}
 
-	if(m_inspector->m_lastevent_ts == 0)
+void sinsp_container_manager::container_from_json(const Json::Value& container, sinsp_container_info& container_info)
+{
+	Json::Value root;
+	root["container"] = container;
+	std::string json = Json::FastWriter().write(root);
+	std::string error;
+	container_from_json(json.c_str(), json.length(), container_info, error);
+}
+
+std::shared_ptr<sinsp_evt> sinsp_container_manager::container_to_sinsp_event(const std::string& json, std::shared_ptr<sinsp_threadinfo> tinfo)
+{
+	uint64_t ts = m_inspector->m_lastevent_ts;
+	if(ts == 0)
 	{
 		// This can happen at startup when containers are
 		// being created as a part of the initial process
 		// scan.
-		scapevt->ts = sinsp_utils::get_current_time_ns();
+		ts = sinsp_utils::get_current_time_ns();
 	}
-	else
+
+	std::string error;
+	std::shared_ptr<sinsp_evt> evt = m_inspector->m_async_evt_pool.encode(error, PPME_CONTAINER_JSON_2_E, ts, -1, json);
+	if(evt == nullptr)
 	{
-		scapevt->ts = m_inspector->m_lastevent_ts;
+		g_logger.format(sinsp_logger::SEV_DEBUG, "Could not encode container event: %s", error.c_str());
+		return nullptr;
 	}
-	scapevt->tid = -1;
-	scapevt->len = (uint32_t)totlen;
-	scapevt->type = PPME_CONTAINER_JSON_2_E;
-	scapevt->nparams = 1;
-
-	uint32_t* lens = (uint32_t*)((char *)scapevt + sizeof(struct ppm_evt_hdr));
-	char* valptr = (char*)lens + sizeof(uint32_t);
-
-	*lens = (uint32_t)json.length() + 1;
-	memcpy(valptr, json.c_str(), *lens);
 
-	evt->init();
+	evt->m_inspector = m_inspector;
 	evt->m_tinfo_ref = tinfo;
 	evt->m_tinfo = tinfo.get();
 
-	return true;
+	return evt;
 }
 
 sinsp_container_manager::map_ptr_t sinsp_container_manager::get_containers() const
@@ -304,7 +1041,28 @@ void sinsp_container_manager::add_container(const sinsp_container_info::ptr_t& c
 
 	{
 		auto containers = m_containers.lock();
-		(*containers)[container_info->m_id] = container_info;
+		auto it = containers->find(container_info->m_id);
+		if(it == containers->end())
+		{
+			if(m_memory.over_budget())
+			{
+				// The lookup status is kept, so that the container
+				// isn't looked up again for every event
+				m_memory.add_budget_drop();
+				g_logger.format(sinsp_logger::SEV_DEBUG,
+						"Container table over its memory budget, dropping container %s",
+						container_info->m_id.c_str());
+				return;
+			}
+			(*containers)[container_info->m_id] = container_info;
+		}
+		else
+		{
+			m_memory.remove(estimate_memory(*it->second));
+			it->second = container_info;
+		}
+		add_slot(container_info);
+		m_memory.add(estimate_memory(*container_info));
 	}
 
 	for(const auto& new_cb : m_new_callbacks)
@@ -316,8 +1074,70 @@ void sinsp_container_manager::add_container(const sinsp_container_info::ptr_t& c
 void sinsp_container_manager::replace_container(const sinsp_container_info::ptr_t& container_info)
 {
 	auto containers = m_containers.lock();
-	ASSERT(containers->find(container_info->m_id) != containers->end());
+	auto it = containers->find(container_info->m_id);
+	ASSERT(it != containers->end());
+	if(it != containers->end())
+	{
+		m_memory.remove(estimate_memory(*it->second));
+	}
 	(*containers)[container_info->m_id] = container_info;
+	add_slot(container_info);
+	m_memory.add(estimate_memory(*container_info));
+}
+
+uint64_t sinsp_container_manager::estimate_memory(const sinsp_container_info& container_info)
+{
+	uint64_t res = sizeof(sinsp_container_info) + sinsp_table_memory::HASH_NODE_BYTES +
+		sizeof(std::string) + sinsp_table_memory::string_bytes(container_info.m_id);
+
+	const std::string* strings[] = {
+		&container_info.m_id,
+		&container_info.m_full_id,
+		&container_info.m_name,
+		&container_info.m_image,
+		&container_info.m_imageid,
+		&container_info.m_imagerepo,
+		&container_info.m_imagetag,
+		&container_info.m_imagedigest,
+		&container_info.m_mesos_task_id,
+		&container_info.m_pod_cniresult,
+		&container_info.m_container_user,
+	};
+	for(const std::string* str : strings)
+	{
+		res += sinsp_table_memory::string_bytes(*str);
+	}
+
+	for(const auto& mount : container_info.m_mounts)
+	{
+		res += sizeof(mount) +
+			sinsp_table_memory::string_bytes(mount.m_source) +
+			sinsp_table_memory::string_bytes(mount.m_dest) +
+			sinsp_table_memory::string_bytes(mount.m_mode) +
+			sinsp_table_memory::string_bytes(mount.m_propagation);
+	}
+	res += container_info.m_port_mappings.size() * sizeof(sinsp_container_info::container_port_mapping);
+	for(const auto& label : container_info.m_labels)
+	{
+		res += sinsp_table_memory::TREE_NODE_BYTES + sizeof(label) +
+			sinsp_table_memory::string_bytes(label.first) +
+			sinsp_table_memory::string_bytes(label.second);
+	}
+	for(const auto& env : container_info.m_env)
+	{
+		res += sizeof(env) + sinsp_table_memory::string_bytes(env);
+	}
+	for(const auto& probe : container_info.m_health_probes)
+	{
+		res += 2 * sizeof(void*) + sizeof(probe) +
+			sinsp_table_memory::string_bytes(probe.m_health_probe_exe);
+		for(const auto& arg : probe.m_health_probe_args)
+		{
+			res += sizeof(arg) + sinsp_table_memory::string_bytes(arg);
+		}
+	}
+
+	return res;
 }
 
 void sinsp_container_manager::notify_new_container(const sinsp_container_info& container_info, sinsp_threadinfo *tinfo)
@@ -362,19 +1182,16 @@ void sinsp_container_manager::notify_new_container(const sinsp_container_info& c
 	// In all other cases, containers will be stored after the proper
 	// PPME_CONTAINER_JSON_2_E event is received by the engine and processed.
 
-	sinsp_evt *evt = new sinsp_evt();
-
-	if(container_to_sinsp_event(container_to_json(container_info), evt, container_info.get_tinfo(m_inspector)))
+	std::shared_ptr<sinsp_evt> cevt = container_to_sinsp_event(container_to_json(container_info), container_info.get_tinfo(m_inspector));
+	if(cevt != nullptr)
 	{
 		g_logger.format(sinsp_logger::SEV_DEBUG,
 				"notify_new_container (%s): created CONTAINER_JSON event, queuing to inspector",
 				container_info.m_id.c_str());
 
-		std::shared_ptr<sinsp_evt> cevt(evt);
-
 		// Enqueue it onto the queue of pending container events for the inspector
 #ifndef _WIN32
-		m_inspector->m_pending_state_evts.push(cevt);
+		m_inspector->m_pending_state_evts.push(std::move(cevt));
 #endif
 	}
 	else
@@ -382,7 +1199,6 @@ void sinsp_container_manager::notify_new_container(const sinsp_container_info& c
 		g_logger.format(sinsp_logger::SEV_ERROR,
 				"notify_new_container (%s): could not create CONTAINER_JSON event, dropping",
 				container_info.m_id.c_str());
-		delete evt;
 	}
 }
 
@@ -396,10 +1212,10 @@ void sinsp_container_manager::dump_containers(sinsp_dumper& dumper)
 {
 	for(const auto& it : (*m_containers.lock()))
 	{
-		sinsp_evt evt;
-		if(container_to_sinsp_event(container_to_json(*it.second), &evt, it.second->get_tinfo(m_inspector)))
+		std::shared_ptr<sinsp_evt> evt = container_to_sinsp_event(container_to_json(*it.second), it.second->get_tinfo(m_inspector));
+		if(evt != nullptr)
 		{
-			dumper.dump(&evt);
+			dumper.dump(evt.get());
 		}
 	}
 }
@@ -414,7 +1230,7 @@ std::string sinsp_container_manager::get_container_name(sinsp_threadinfo* tinfo)
 	}
 	else
 	{
-		const sinsp_container_info::ptr_t container_info = get_container(tinfo->m_container_id);
+		const sinsp_container_info::ptr_t container_info = get_container(tinfo);
 
 		if(!container_info)
 		{
@@ -469,7 +1285,7 @@ void sinsp_container_manager::identify_category(sinsp_threadinfo *tinfo)
 		return;
 	}
 
-	sinsp_container_info::ptr_t cinfo = get_container(tinfo->m_container_id);
+	sinsp_container_info::ptr_t cinfo = get_container(tinfo);
 	if(!cinfo)
 	{
 		return;
@@ -708,8 +1524,223 @@ void sinsp_container_manager::set_cri_async(bool async)
 #endif
 }
 
+void sinsp_container_manager::set_cri_warmup(bool warmup)
+{
+#if !defined(MINIMAL_BUILD) && defined(HAS_CAPTURE)
+	libsinsp::container_engine::cri::set_warmup(warmup);
+#endif
+}
+
+void sinsp_container_manager::set_cri_async_workers(uint32_t workers)
+{
+#if !defined(MINIMAL_BUILD) && defined(HAS_CAPTURE)
+	libsinsp::container_engine::cri::set_async_workers(workers);
+#endif
+}
+
 void sinsp_container_manager::set_container_labels_max_len(uint32_t max_label_len)
 {
 	sinsp_container_info::m_container_label_max_length = max_label_len;
 }
 
+uint32_t sinsp_container_manager::load_snapshot()
+{
+	if(m_snapshot_path.empty())
+	{
+		return 0;
+	}
+
+	std::ifstream in(m_snapshot_path);
+	if(!in)
+	{
+		// First run, or the file was removed: nothing to restore
+		return 0;
+	}
+
+	Json::Value root;
+	Json::Reader reader;
+	if(!reader.parse(in, root))
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"Ignoring invalid container snapshot %s: %s",
+				m_snapshot_path.c_str(), reader.getFormattedErrorMessages().c_str());
+		return 0;
+	}
+
+	if(!root.isObject() || !root["version"].isUInt() ||
+	   root["version"].asUInt() != SNAPSHOT_VERSION)
+	{
+		g_logger.format(sinsp_logger::SEV_INFO,
+				"Ignoring container snapshot %s from another version",
+				m_snapshot_path.c_str());
+		return 0;
+	}
+
+	uint32_t n = 0;
+	for(const auto& entry : root["containers"])
+	{
+		sinsp_container_info container_info;
+		container_from_json(entry["container"], container_info);
+		if(container_info.m_id.empty() || !container_info.is_successful() ||
+		   get_container(container_info.m_id) != nullptr)
+		{
+			continue;
+		}
+
+		for(const auto& user : entry["users"])
+		{
+			m_inspector->m_usergroup_manager.restore_user(container_info.m_id,
+				user["uid"].asUInt(),
+				user["gid"].asUInt(),
+				user["name"].asString().c_str(),
+				user["home"].asString().c_str(),
+				user["shell"].asString().c_str());
+		}
+
+		for(const auto& group : entry["groups"])
+		{
+			m_inspector->m_usergroup_manager.restore_group(container_info.m_id,
+				group["gid"].asUInt(),
+				group["name"].asString().c_str());
+		}
+
+		// Before the inspector is started this only stores the
+		// container, which then becomes part of the initial state
+		notify_new_container(container_info);
+		m_restored.insert(container_info.m_id);
+		n++;
+	}
+
+	g_logger.format(sinsp_logger::SEV_INFO,
+			"Restored %u containers from %s",
+			n, m_snapshot_path.c_str());
+	return n;
+}
+
+void sinsp_container_manager::prune_snapshot()
+{
+	if(m_restored.empty())
+	{
+		return;
+	}
+
+	//
+	// The threads of the /proc scan were matched to their containers
+	// through their cgroups, so a restored container that no thread
+	// belongs to isn't running anymore
+	//
+	m_inspector->m_thread_manager->get_threads()->loop([&] (const sinsp_threadinfo& tinfo) {
+		if(!tinfo.m_container_id.empty())
+		{
+			m_restored.erase(tinfo.m_container_id);
+		}
+		return true;
+	});
+
+	for(const auto& id : m_restored)
+	{
+		sinsp_container_info::ptr_t container = get_container(id);
+		if(container == nullptr)
+		{
+			continue;
+		}
+
+		for(const auto &remove_cb : m_remove_callbacks)
+		{
+			remove_cb(*container);
+		}
+		{
+			auto containers = m_containers.lock();
+			if(containers->erase(id) != 0)
+			{
+				m_memory.remove(estimate_memory(*container));
+				remove_slot(id);
+			}
+		}
+		m_lookups.erase(id);
+	}
+
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"Dropped %zu restored containers that are not running",
+			m_restored.size());
+	m_restored.clear();
+}
+
+void sinsp_container_manager::save_snapshot()
+{
+	if(m_snapshot_path.empty())
+	{
+		return;
+	}
+
+	Json::Value root;
+	root["version"] = SNAPSHOT_VERSION;
+	Json::Value& entries = root["containers"] = Json::arrayValue;
+
+	for(const auto& it : (*m_containers.lock()))
+	{
+		const sinsp_container_info& container_info = *it.second;
+		if(!container_info.is_successful())
+		{
+			continue;
+		}
+
+		Json::Value entry;
+		container_to_json(container_info, entry["container"]);
+
+		Json::Value& users = entry["users"] = Json::arrayValue;
+		auto userlist = m_inspector->m_usergroup_manager.get_userlist(container_info.m_id);
+		if(userlist != nullptr)
+		{
+			for(const auto& u : *userlist)
+			{
+				Json::Value user;
+				user["uid"] = u.second.uid;
+				user["gid"] = u.second.gid;
+				user["name"] = u.second.name;
+				user["home"] = u.second.homedir;
+				user["shell"] = u.second.shell;
+				users.append(user);
+			}
+		}
+
+		Json::Value& groups = entry["groups"] = Json::arrayValue;
+		auto grouplist = m_inspector->m_usergroup_manager.get_grouplist(container_info.m_id);
+		if(grouplist != nullptr)
+		{
+			for(const auto& g : *grouplist)
+			{
+				Json::Value group;
+				group["gid"] = g.second.gid;
+				group["name"] = g.second.name;
+				groups.append(group);
+			}
+		}
+
+		entries.append(entry);
+	}
+
+	//
+	// Write a temporary file and rename it, so that a crash while
+	// saving doesn't leave a truncated snapshot behind
+	//
+	std::string tmp_path = m_snapshot_path + ".tmp";
+	{
+		std::ofstream out(tmp_path, std::ios::trunc);
+		out << Json::FastWriter().write(root);
+		if(!out.flush())
+		{
+			g_logger.format(sinsp_logger::SEV_WARNING,
+					"Unable to write the container snapshot %s",
+					tmp_path.c_str());
+			return;
+		}
+	}
+
+	if(rename(tmp_path.c_str(), m_snapshot_path.c_str()) != 0)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"Unable to save the container snapshot %s: %s",
+				m_snapshot_path.c_str(), strerror(errno));
+	}
+}
@@ -20,6 +20,8 @@ limitations under the License.
 #include <functional>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "scap.h"
 
@@ -36,6 +38,7 @@ limitations under the License.
 #include "container_engine/container_engine_base.h"
 #include "container_engine/sinsp_container_type.h"
 #include "mutex.h"
+#include "table_memory.h"
 
 class sinsp_dumper;
 
@@ -67,6 +70,14 @@ public:
 	map_ptr_t get_containers() const;
 	bool remove_inactive_containers();
 
+	/**
+	 * @brief Get the approximate memory used by the container map
+	 */
+	inline sinsp_table_memory& get_memory()
+	{
+		return m_memory;
+	}
+
 	/**
 	 * @brief Add/update a container in the manager map, executing on_new_container callbacks
 	 *
@@ -95,6 +106,19 @@ public:
 	 */
 	sinsp_container_info::ptr_t get_container(const std::string &id) const override;
 
+	/**
+	 * @brief Get the container_info of a thread
+	 * @param tinfo the thread whose container to look up
+	 * @return a const pointer to the container_info, nullptr for the host
+	 * or if the container is unknown
+	 *
+	 * The container is found through the handle cached in the thread,
+	 * which indexes the container table directly rather than hashing the
+	 * container id. The handle is refreshed when it's stale, e.g. after
+	 * the container was removed or the thread moved to another one.
+	 */
+	sinsp_container_info::ptr_t get_container(sinsp_threadinfo* tinfo) const;
+
 	/**
 	 * @brief Generate container JSON event from a new container
 	 * @param container_info reference to the new sinsp_container_info
@@ -174,9 +198,63 @@ public:
 	void add_cri_socket_path(const std::string &path);
 	void set_cri_timeout(int64_t timeout_ms);
 	void set_cri_async(bool async);
+	void set_cri_warmup(bool warmup);
+	void set_cri_async_workers(uint32_t workers);
 	void set_container_labels_max_len(uint32_t max_label_len);
 	sinsp* get_inspector() { return m_inspector; }
 
+	/**
+	 * @brief Set the file where the container metadata is kept across
+	 * restarts, empty (the default) to disable it
+	 */
+	inline void set_snapshot_path(const std::string& path)
+	{
+		m_snapshot_path = path;
+	}
+
+	inline const std::string& get_snapshot_path() const
+	{
+		return m_snapshot_path;
+	}
+
+	/**
+	 * @brief Restore the containers, with their users and groups, saved
+	 * by save_snapshot(), so that the threads found by the /proc scan don't
+	 * need a new lookup. Must be called before the scan.
+	 * @return the number of containers restored
+	 */
+	uint32_t load_snapshot();
+
+	/**
+	 * @brief Drop the restored containers that no thread belongs to, i.e.
+	 * whose cgroups are gone. Must be called after the /proc scan.
+	 */
+	void prune_snapshot();
+
+	/**
+	 * @brief Save the successfully looked up containers, with their users
+	 * and groups, for load_snapshot()
+	 */
+	void save_snapshot();
+
+	/**
+	 * @brief Fill a container_info from the "container" object of a
+	 * container JSON event
+	 */
+	static void container_from_json(const Json::Value& container, sinsp_container_info& container_info);
+
+	/**
+	 * @brief Fill a container_info from the JSON of a container event,
+	 * reading it in place rather than building a Json::Value first.
+	 * Returns false and sets error if the JSON is invalid.
+	 */
+	static bool container_from_json(const char* json, size_t len, sinsp_container_info& container_info, std::string& error);
+
+	/**
+	 * @brief Append the JSON of a container event to json
+	 */
+	static void container_to_json(const sinsp_container_info& container_info, std::string& json);
+
 	/**
 	 * \brief set the status of an async container metadata lookup
 	 * @param container_id the container id we're looking up
@@ -214,15 +292,38 @@ public:
 		return engine_lookup == container_lookups->second.end();
 	}
 private:
-	std::string container_to_json(const sinsp_container_info& container_info);
-	bool container_to_sinsp_event(const std::string& json, sinsp_evt* evt, std::shared_ptr<sinsp_threadinfo> tinfo);
+	static std::string container_to_json(const sinsp_container_info& container_info);
+	static void container_to_json(const sinsp_container_info& container_info, Json::Value& container);
+	static uint64_t estimate_memory(const sinsp_container_info& container_info);
+	void add_slot(const sinsp_container_info::ptr_t& container_info);
+	void remove_slot(const std::string& container_id);
+	void cache_cgroups(const std::string& key, const std::string& container_id);
+	void add_engine_route(const std::string& layout, const std::string& container_id,
+			      libsinsp::container_engine::container_engine_base* engine);
+	std::shared_ptr<sinsp_evt> container_to_sinsp_event(const std::string& json, std::shared_ptr<sinsp_threadinfo> tinfo);
 	std::string get_docker_env(const Json::Value &env_vars, const std::string &mti);
 
-	std::list<std::shared_ptr<libsinsp::container_engine::container_engine_base>> m_container_engines;
+	// Only the enabled engines, see set_container_engine_mask()
+	std::vector<std::shared_ptr<libsinsp::container_engine::container_engine_base>> m_container_engines;
 	std::map<sinsp_container_type, std::shared_ptr<libsinsp::container_engine::container_engine_base>> m_container_engine_by_type;
 
 	sinsp* m_inspector;
 	libsinsp::Mutex<std::unordered_map<std::string, std::shared_ptr<const sinsp_container_info>>> m_containers;
+	// Updated with m_containers locked
+	sinsp_table_memory m_memory;
+
+	// Dense table of the containers, indexed by the handles cached in the
+	// threads: the low 32 bits of a handle are the index of the slot, the
+	// high ones its generation, bumped when the slot is freed so that the
+	// stale handles miss. Updated with m_containers locked
+	struct container_slot
+	{
+		sinsp_container_info::ptr_t m_info;
+		uint32_t m_generation;
+	};
+	std::vector<container_slot> m_slots;
+	std::vector<uint32_t> m_free_slots;
+	std::unordered_map<std::string, uint32_t> m_slot_by_id;
 	std::unordered_map<std::string, std::unordered_map<sinsp_container_type, sinsp_container_lookup::state>> m_lookups;
 	uint64_t m_last_flush_time_ns;
 	std::list<new_container_cb> m_new_callbacks;
@@ -237,6 +338,24 @@ private:
 	std::string m_static_image;
 	uint64_t m_container_engine_mask;
 
+	// Container of the threads with a given set of cgroups, keyed by
+	// their cgroups parameter (see sinsp_threadinfo::get_cgroups_param())
+	struct cgroup_match
+	{
+		std::string m_container_id;
+		sinsp_container_type m_type;
+	};
+	std::unordered_map<std::string, cgroup_match> m_cgroup_cache;
+
+	// Engine that resolved the containers of a cgroup layout (the path of
+	// the cgroups with the container id masked, see resolve_container()),
+	// tried first for the new containers with the same layout
+	std::unordered_map<std::string, libsinsp::container_engine::container_engine_base*> m_engine_routes;
+
+	std::string m_snapshot_path;
+	// Containers restored by load_snapshot() and not yet validated
+	std::unordered_set<std::string> m_restored;
+
 	friend class test_helper;
 };
 
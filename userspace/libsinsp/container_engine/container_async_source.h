@@ -62,10 +62,13 @@ protected:
 	virtual sinsp_container_type container_type(const key_type& key) const = 0;
 	virtual std::string container_id(const key_type& key) const = 0;
 
-	container_cache_interface* m_cache;
+	// Look up a dequeued key, then either store the result or
+	// defer a new attempt
+	void lookup_dequeued(const key_type& key, sinsp_container_info& res);
 
-private:
 	void run_impl() override;
+
+	container_cache_interface* m_cache;
 };
 
 } // namespace container_engine
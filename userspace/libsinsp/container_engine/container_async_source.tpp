@@ -94,47 +94,53 @@ void container_async_source<key_type>::run_impl()
 
 	while(this->dequeue_next_key(key, &res))
 	{
-		g_logger.format(sinsp_logger::SEV_DEBUG,
-				"%s_async (%s): Source dequeued key attempt=%u",
-				name(),
-				container_id(key).c_str(),
-				res.m_lookup.retry_no());
+		lookup_dequeued(key, res);
 
-		lookup_sync(key, res);
+		// Reset res
+		res.clear();
+	}
+}
 
-		if(!res.m_lookup.should_retry())
-		{
-			// Either the fetch was successful or the
-			// maximum number of retries have occurred.
-			if(!res.m_lookup.is_successful())
-			{
-				g_logger.format(sinsp_logger::SEV_DEBUG,
-						"%s_async (%s): Could not look up container info after %u retries",
-						name(),
-						container_id(key).c_str(),
-						res.m_lookup.retry_no());
-			}
-
-			this->store_value(key, res);
-		}
-		else
-		{
-			// Make a new attempt
-			res.m_lookup.attempt_increment();
+template<typename key_type>
+void container_async_source<key_type>::lookup_dequeued(const key_type& key, sinsp_container_info& res)
+{
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"%s_async (%s): Source dequeued key attempt=%u",
+			name(),
+			container_id(key).c_str(),
+			res.m_lookup.retry_no());
+
+	lookup_sync(key, res);
 
+	if(!res.m_lookup.should_retry())
+	{
+		// Either the fetch was successful or the
+		// maximum number of retries have occurred.
+		if(!res.m_lookup.is_successful())
+		{
 			g_logger.format(sinsp_logger::SEV_DEBUG,
-					"%s_async (%s): lookup retry no. %d",
+					"%s_async (%s): Could not look up container info after %u retries",
 					name(),
 					container_id(key).c_str(),
 					res.m_lookup.retry_no());
-
-			this->defer_lookup(key,
-					   &res,
-					   std::chrono::milliseconds(res.m_lookup.delay()));
 		}
 
-		// Reset res
-		res.clear();
+		this->store_value(key, res);
+	}
+	else
+	{
+		// Make a new attempt
+		res.m_lookup.attempt_increment();
+
+		g_logger.format(sinsp_logger::SEV_DEBUG,
+				"%s_async (%s): lookup retry no. %d",
+				name(),
+				container_id(key).c_str(),
+				res.m_lookup.retry_no());
+
+		this->defer_lookup(key,
+				   &res,
+				   std::chrono::milliseconds(res.m_lookup.delay()));
 	}
 }
 
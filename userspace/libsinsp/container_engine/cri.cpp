@@ -43,6 +43,15 @@ namespace
 // do the CRI communication asynchronously
 bool s_async = true;
 
+// list the existing containers when the engine is created
+bool s_warmup = true;
+
+// number of threads doing the asynchronous lookups
+uint32_t s_async_workers = 1;
+
+// the container ids reported by sinsp are truncated to 12 characters (see runc.h)
+constexpr size_t REPORTED_CONTAINER_ID_LENGTH = 12;
+
 constexpr const cgroup_layout CRI_CGROUP_LAYOUT[] = {
 	{"/", ""}, // non-systemd containerd
 	{"/crio-", ""}, // non-systemd cri-o
@@ -149,7 +158,7 @@ bool cri_async_source::parse(const key_type& key, sinsp_container_info& containe
 	if(!parse_containerd(resp, container))
 	{
 		libsinsp::cgroup_limits::cgroup_limits_value limits;
-		libsinsp::cgroup_limits::get_cgroup_resource_limits(key, limits);
+		m_cgroup_limits.get(key, limits);
 
 		container.m_memory_limit = limits.m_memory_limit;
 		container.m_cpu_shares = limits.m_cpu_shares;
@@ -239,6 +248,156 @@ cri::cri(container_cache_interface &cache) : container_engine_base(cache)
 			break;
 		}
 	}
+
+	if(m_cri && s_warmup)
+	{
+		warmup();
+	}
+}
+
+void cri::warmup()
+{
+	container_cache_interface &cache = container_cache();
+	const sinsp_container_type type = m_cri->get_cri_runtime_type();
+
+	runtime::v1alpha2::ListPodSandboxResponse pods;
+	grpc::Status status = m_cri->list_pod_sandboxes(pods);
+	if(!status.ok())
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG,
+				"cri: warmup: ListPodSandbox failed: %s",
+				status.error_message().c_str());
+		return;
+	}
+
+	for(const auto &pod : pods.items())
+	{
+		sinsp_container_info container;
+		container.m_id = pod.id().substr(0, REPORTED_CONTAINER_ID_LENGTH);
+		container.m_type = type;
+		container.m_is_pod_sandbox = true;
+		if(cache.should_lookup(container.m_id, type))
+		{
+			cache.set_lookup_status(container.m_id, type, sinsp_container_lookup::state::SUCCESSFUL);
+			cache.notify_new_container(container);
+		}
+	}
+
+	runtime::v1alpha2::ListContainersResponse containers;
+	status = m_cri->list_containers(containers);
+	if(!status.ok())
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG,
+				"cri: warmup: ListContainers failed: %s",
+				status.error_message().c_str());
+		return;
+	}
+
+	const google::protobuf::Map<std::string, std::string> no_info;
+	for(const auto &resp_container : containers.containers())
+	{
+		sinsp_container_info container;
+		container.m_id = resp_container.id().substr(0, REPORTED_CONTAINER_ID_LENGTH);
+		if(!cache.should_lookup(container.m_id, type))
+		{
+			continue;
+		}
+
+		container.m_type = type;
+		container.m_full_id = resp_container.id();
+		container.m_name = resp_container.metadata().name();
+		container.m_created_time = static_cast<int64_t>(resp_container.created_at() / ONE_SECOND_IN_NS);
+
+		for(const auto &pair : resp_container.labels())
+		{
+			if(pair.second.length() <= sinsp_container_info::m_container_label_max_length)
+			{
+				container.m_labels[pair.first] = pair.second;
+			}
+		}
+
+		runtime::v1alpha2::ContainerStatus image_status;
+		*image_status.mutable_image() = resp_container.image();
+		image_status.set_image_ref(resp_container.image_ref());
+		m_cri->parse_cri_image(image_status, no_info, container);
+
+		cache.set_lookup_status(container.m_id, type, sinsp_container_lookup::state::SUCCESSFUL);
+		cache.notify_new_container(container);
+		m_warmed_up.insert(container.m_id);
+	}
+
+	g_logger.format(sinsp_logger::SEV_INFO,
+			"cri: warmup: found %d pod sandboxes and %d containers",
+			pods.items_size(),
+			containers.containers_size());
+}
+
+cri_async_source& cri::async_source()
+{
+	if(!m_async_source)
+	{
+		// Each lookup attempt involves two CRI API calls (see
+		// `cri_async_source::parse`), each one having a default timeout
+		// of 1000ms (`cri::set_cri_timeout`).
+		// On top of that, there's an exponential backoff with 125ms start
+		// time (`sinsp_container_lookup::delay`) with a maximum of 5
+		// retries.
+		// The maximum time to complete all attempts can be then evaluated
+		// with the following formula:
+		//
+		// max_wait_ms = (2 * s_cri_timeout) * n + (125 * (2^n - 1))
+		//
+		// Note that this excludes the time for the last 2 CRI API calls
+		// that will be performed anyway, even if the TTL expires.
+		//
+		// With n=5 the result is 13875ms, we keep some margin as we are
+		// taking into account elapsed time.
+		uint64_t max_wait_ms = 20000;
+		m_async_source = std::unique_ptr<cri_async_source>(new cri_async_source(&container_cache(), m_cri.get(), max_wait_ms));
+		m_async_source->set_num_workers(s_async_workers);
+	}
+	return *m_async_source;
+}
+
+void cri::complete_warmed_up(sinsp_threadinfo *tinfo, const std::string& container_id)
+{
+	// Only in async mode, the warmed up metadata is good enough
+	// until then and the point of the warmup is not to block
+	if(!s_async || !container_cache().async_allowed())
+	{
+		return;
+	}
+
+	if(m_warmed_up.erase(container_id) == 0)
+	{
+		return;
+	}
+
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"cri_async (%s): Completing warmed up container",
+			container_id.c_str());
+
+	libsinsp::cgroup_limits::cgroup_limits_key key(
+		container_id,
+		tinfo->get_cgroup("cpu"),
+		tinfo->get_cgroup("memory"),
+		tinfo->get_cgroup("cpuset"));
+
+	// The cache ignores new containers for ids that were already looked
+	// up successfully, so replace the warmed up entry instead
+	auto replace = [this](const libsinsp::cgroup_limits::cgroup_limits_key& key, const sinsp_container_info& res)
+	{
+		if(res.is_successful())
+		{
+			container_cache().replace_container(std::make_shared<sinsp_container_info>(res));
+		}
+	};
+
+	sinsp_container_info result(sinsp_container_lookup(5, 2000));
+	if(async_source().lookup(key, result, replace))
+	{
+		replace(key, result);
+	}
 }
 
 void cri::cleanup()
@@ -275,6 +434,16 @@ void cri::set_async(bool async)
 	s_async = async;
 }
 
+void cri::set_warmup(bool warmup)
+{
+	s_warmup = warmup;
+}
+
+void cri::set_async_workers(uint32_t workers)
+{
+	s_async_workers = workers;
+}
+
 bool cri::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
 {
 	container_cache_interface *cache = &container_cache();
@@ -300,6 +469,21 @@ bool cri::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
 
 	if(!cache->should_lookup(container_id, m_cri->get_cri_runtime_type()))
 	{
+		if(query_os_for_missing_info && !m_warmed_up.empty())
+		{
+			complete_warmed_up(tinfo, container_id);
+		}
+		else if(m_async_source && !cache->container_exists(container_id))
+		{
+			// The lookup is still pending and a thread of the
+			// container is doing something, serve it first
+			libsinsp::cgroup_limits::cgroup_limits_key key(
+				container_id,
+				tinfo->get_cgroup("cpu"),
+				tinfo->get_cgroup("memory"),
+				tinfo->get_cgroup("cpuset"));
+			m_async_source->prioritize(key);
+		}
 		return true;
 	}
 
@@ -326,28 +510,7 @@ bool cri::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
 			tinfo->get_cgroup("memory"),
 			tinfo->get_cgroup("cpuset"));
 
-		if(!m_async_source)
-		{
-			// Each lookup attempt involves two CRI API calls (see
-			// `cri_async_source::parse`), each one having a default timeout
-			// of 1000ms (`cri::set_cri_timeout`).
-			// On top of that, there's an exponential backoff with 125ms start
-			// time (`sinsp_container_lookup::delay`) with a maximum of 5
-			// retries.
-			// The maximum time to complete all attempts can be then evaluated
-			// with the following formula:
-			//
-			// max_wait_ms = (2 * s_cri_timeout) * n + (125 * (2^n - 1))
-			//
-			// Note that this excludes the time for the last 2 CRI API calls
-			// that will be performed anyway, even if the TTL expires.
-			//
-			// With n=5 the result is 13875ms, we keep some margin as we are
-			// taking into account elapsed time.
-			uint64_t max_wait_ms = 20000;
-			auto async_source = new cri_async_source(cache, m_cri.get(), max_wait_ms);
-			m_async_source = std::unique_ptr<cri_async_source>(async_source);
-		}
+		cri_async_source &source = async_source();
 
 		cache->set_lookup_status(container_id, m_cri->get_cri_runtime_type(), sinsp_container_lookup::state::STARTED);
 
@@ -362,20 +525,20 @@ bool cri::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
 			g_logger.format(sinsp_logger::SEV_DEBUG,
 					"cri_async (%s): Starting asynchronous lookup",
 					container_id.c_str());
-			done = m_async_source->lookup(key, result);
+			done = source.lookup(key, result);
 		}
 		else
 		{
 			g_logger.format(sinsp_logger::SEV_DEBUG,
 					"cri_async (%s): Starting synchronous lookup",
 					container_id.c_str());
-			done = m_async_source->lookup_sync(key, result);
+			done = source.lookup_sync(key, result);
 		}
 
 		if (done)
 		{
 			// if a previous lookup call already found the metadata, process it now
-			m_async_source->source_callback(key, result);
+			source.source_callback(key, result);
 
 			if(async)
 			{
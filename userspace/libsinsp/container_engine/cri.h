@@ -18,6 +18,7 @@ limitations under the License.
 #pragma once
 
 #include <string>
+#include <unordered_set>
 #include <stdint.h>
 
 class sinsp_threadinfo;
@@ -77,6 +78,7 @@ private:
 	}
 
 	::libsinsp::cri::cri_interface *m_cri;
+	libsinsp::cgroup_limits::cgroup_limits_cache m_cgroup_limits;
 };
 
 class cri : public container_engine_base
@@ -91,10 +93,29 @@ public:
 	static void set_cri_timeout(int64_t timeout_ms);
 	static void set_extra_queries(bool extra_queries);
 	static void set_async(bool async_limits);
+	static void set_warmup(bool warmup);
+	static void set_async_workers(uint32_t workers);
 
 private:
+	/**
+	 * Add all the running containers and ready pod sandboxes to the cache
+	 * with two CRI calls (ListPodSandbox and ListContainers), instead of
+	 * looking them up one by one as their threads show up.
+	 */
+	void warmup();
+
+	/**
+	 * The warmup only gets what ListContainers returns (name, image, labels),
+	 * so the first time a thread of a warmed up container is resolved
+	 * the rest of the metadata is looked up in the background.
+	 */
+	void complete_warmed_up(sinsp_threadinfo *tinfo, const std::string& container_id);
+
+	cri_async_source& async_source();
+
 	std::unique_ptr<cri_async_source> m_async_source;
 	std::unique_ptr<::libsinsp::cri::cri_interface> m_cri;
+	std::unordered_set<std::string> m_warmed_up;
 };
 }
 }
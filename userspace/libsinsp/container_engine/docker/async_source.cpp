@@ -40,6 +40,86 @@ docker_async_source::~docker_async_source()
 			"docker_async: Source destructor");
 }
 
+void docker_async_source::run_impl()
+{
+	std::vector<std::pair<docker_lookup_request, sinsp_container_info>> batch;
+	docker_lookup_request request;
+	sinsp_container_info res;
+
+	while(true)
+	{
+		while(batch.size() < MAX_BATCH_SIZE && dequeue_next_key(request, &res))
+		{
+			batch.emplace_back(request, res);
+			res.clear();
+		}
+
+		if(batch.empty())
+		{
+			break;
+		}
+
+		if(batch.size() > 1)
+		{
+			prefetch_containers(batch);
+		}
+
+		for(auto& item : batch)
+		{
+			lookup_dequeued(item.first, item.second);
+		}
+		batch.clear();
+	}
+}
+
+std::string docker_async_source::container_url(const docker_lookup_request& request)
+{
+	std::string api_request = "/containers/" + request.container_id + "/json";
+	if(request.request_rw_size)
+	{
+		api_request += "?size=true";
+	}
+	return api_request;
+}
+
+void docker_async_source::prefetch_containers(const std::vector<std::pair<docker_lookup_request, sinsp_container_info>>& batch)
+{
+	std::vector<docker_connection::docker_fetch> fetches;
+	fetches.reserve(batch.size());
+	for(const auto& item : batch)
+	{
+		fetches.emplace_back(item.first, container_url(item.first));
+	}
+
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"docker_async: Fetching %zu containers at once",
+			fetches.size());
+
+	m_connection.get_docker(fetches);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for(auto& fetch : fetches)
+	{
+		m_prefetched[*fetch.m_request] = std::make_pair(fetch.m_response, std::move(fetch.m_json));
+	}
+}
+
+bool docker_async_source::take_prefetched(const docker_lookup_request& request, docker_connection::docker_response& resp, std::string& json)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_prefetched.find(request);
+	if(it == m_prefetched.end())
+	{
+		return false;
+	}
+
+	resp = it->second.first;
+	json = std::move(it->second.second);
+	m_prefetched.erase(it);
+	return true;
+}
+
 bool docker_async_source::get_k8s_pod_spec(const Json::Value &config_obj,
 					   Json::Value &spec)
 {
@@ -338,6 +418,25 @@ void docker_async_source::fetch_image_info(const docker_lookup_request& request,
 {
 	Json::Reader reader;
 
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_image_cache.find(container.m_imageid);
+		if(it != m_image_cache.end())
+		{
+			auto age = std::chrono::steady_clock::now() - it->second.m_time;
+			if(age < std::chrono::milliseconds(CACHED_IMAGE_TTL_MS))
+			{
+				g_logger.format(sinsp_logger::SEV_DEBUG,
+						"docker_async (%s) image (%s): Using cached image info",
+						request.container_id.c_str(),
+						container.m_imageid.c_str());
+				parse_image_info(container, it->second.m_info);
+				return;
+			}
+			m_image_cache.erase(it);
+		}
+	}
+
 	g_logger.format(sinsp_logger::SEV_DEBUG,
 			"docker_async (%s) image (%s): Fetching image info",
 			request.container_id.c_str(),
@@ -377,6 +476,15 @@ void docker_async_source::fetch_image_info(const docker_lookup_request& request,
 	}
 
 	parse_image_info(container, img_root);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(m_image_cache.size() >= MAX_CACHED_IMAGES)
+	{
+		// The images are immutable, only their tags change, so it's
+		// fine to just start over
+		m_image_cache.clear();
+	}
+	m_image_cache[container.m_imageid] = cached_image{std::chrono::steady_clock::now(), std::move(img_root)};
 }
 
 void docker_async_source::fetch_image_info_from_list(const docker_lookup_request& request, sinsp_container_info& container)
@@ -649,14 +757,12 @@ bool docker_async_source::parse(const docker_lookup_request& request, sinsp_cont
 			"docker_async (%s): Looking up info for container via socket %s",
 			request.container_id.c_str(), request.docker_socket.c_str());
 
-	std::string api_request = "/containers/" + request.container_id + "/json";
-	if(request.request_rw_size)
+	docker_connection::docker_response resp;
+	if(!take_prefetched(request, resp, json))
 	{
-		api_request += "?size=true";
+		resp = m_connection.get_docker(request, container_url(request), json);
 	}
 
-	docker_connection::docker_response resp = m_connection.get_docker(request, api_request, json);
-
 	switch(resp) {
 	case docker_connection::docker_response::RESP_BAD_REQUEST:
 		g_logger.format(sinsp_logger::SEV_DEBUG,
@@ -1,5 +1,12 @@
 #pragma once
 
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "container_info.h"
 
 #include "container_engine/container_async_source.h"
@@ -23,6 +30,31 @@ public:
 	static void set_query_image_info(bool query_image_info);
 
 private:
+	// Max number of containers whose inspect requests run at the same time
+	static const size_t MAX_BATCH_SIZE = 16;
+
+	// Max number of images in m_image_cache, and how long they stay there
+	static const size_t MAX_CACHED_IMAGES = 1024;
+	static const uint64_t CACHED_IMAGE_TTL_MS = 5 * 60 * 1000;
+
+	struct cached_image
+	{
+		std::chrono::steady_clock::time_point m_time;
+		Json::Value m_info;
+	};
+
+	using prefetched_container = std::pair<docker_connection::docker_response, std::string>;
+
+	// Dequeue the ready keys in batches, so that their inspect
+	// requests are sent at the same time
+	void run_impl() override;
+
+	void prefetch_containers(const std::vector<std::pair<docker_lookup_request, sinsp_container_info>>& batch);
+
+	bool take_prefetched(const docker_lookup_request& request, docker_connection::docker_response& resp, std::string& json);
+
+	static std::string container_url(const docker_lookup_request& request);
+
 	bool parse(const docker_lookup_request& key, sinsp_container_info& container) override;
 
 	const char* name() const override { return "docker"; };
@@ -91,6 +123,13 @@ private:
 
 	docker_connection m_connection;
 	static bool m_query_image_info;
+
+	// Protects m_prefetched and m_image_cache, parse() can also run in
+	// synchronous lookups
+	std::mutex m_mutex;
+	std::map<docker_lookup_request, prefetched_container> m_prefetched;
+	// Image info by image id, which is the digest of the image config
+	std::unordered_map<std::string, cached_image> m_image_cache;
 };
 
 
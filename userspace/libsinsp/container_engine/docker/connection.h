@@ -7,6 +7,7 @@
 #endif
 
 #include <string>
+#include <vector>
 
 #include "container_engine/docker/lookup_request.h"
 
@@ -21,12 +22,31 @@ public:
 		RESP_ERROR = 2
 	};
 
+	// One of the requests of a concurrent get_docker()
+	struct docker_fetch {
+		docker_fetch(const docker_lookup_request& request, const std::string& req_url):
+			m_request(&request),
+			m_url(req_url),
+			m_response(RESP_ERROR)
+		{}
+
+		const docker_lookup_request* m_request;
+		std::string m_url;
+		std::string m_json;
+		docker_response m_response;
+	};
+
 	docker_connection();
 	~docker_connection();
 
 	docker_response
 	get_docker(const docker_lookup_request& request, const std::string& req_url, std::string& json);
 
+	// Run all the fetches at the same time, each one getting its own
+	// response and json. The connections to the sockets are kept open
+	// between calls and reused.
+	void get_docker(std::vector<docker_fetch>& fetches);
+
 	void set_api_version(const std::string& api_version)
 	{
 		m_api_version = api_version;
@@ -36,7 +56,15 @@ private:
 	std::string m_api_version;
 
 #ifndef _WIN32
+	// Max number of easy handles kept around for the next requests
+	static const size_t MAX_IDLE_HANDLES = 16;
+
+	CURL* start_fetch(docker_fetch& fetch);
+	docker_response finish_fetch(CURL* curl, const std::string& url);
+	void release_handle(CURL* curl);
+
 	CURLM *m_curlm;
+	std::vector<CURL*> m_idle_handles;
 #endif
 };
 
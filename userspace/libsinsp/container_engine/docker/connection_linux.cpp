@@ -46,6 +46,12 @@ docker_connection::docker_connection():
 
 docker_connection::~docker_connection()
 {
+	for(CURL* curl : m_idle_handles)
+	{
+		curl_easy_cleanup(curl);
+	}
+	m_idle_handles.clear();
+
 	if(m_curlm)
 	{
 		curl_multi_cleanup(m_curlm);
@@ -53,24 +59,46 @@ docker_connection::~docker_connection()
 	}
 }
 
-docker_connection::docker_response docker_connection::get_docker(const docker_lookup_request& request, const std::string& req_url, std::string &json)
+void docker_connection::release_handle(CURL* curl)
+{
+	if(m_idle_handles.size() >= MAX_IDLE_HANDLES)
+	{
+		curl_easy_cleanup(curl);
+		return;
+	}
+
+	curl_easy_reset(curl);
+	m_idle_handles.push_back(curl);
+}
+
+CURL* docker_connection::start_fetch(docker_fetch& fetch)
 {
-	CURL* curl = curl_easy_init();
+	CURL* curl = nullptr;
+	if(!m_idle_handles.empty())
+	{
+		curl = m_idle_handles.back();
+		m_idle_handles.pop_back();
+	}
+	else
+	{
+		curl = curl_easy_init();
+	}
+
 	if(!curl)
 	{
 		g_logger.format(sinsp_logger::SEV_WARNING,
 				"docker_async (%s): Failed to initialize curl handle",
-				req_url.c_str());
-		return docker_response::RESP_ERROR;
+				fetch.m_url.c_str());
+		return nullptr;
 	}
 
-	auto docker_path = scap_get_host_root() + request.docker_socket;
+	auto docker_path = scap_get_host_root() + fetch.m_request->docker_socket;
 	curl_easy_setopt(curl, CURLOPT_HTTPGET, 1);
 	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, docker_curl_write_callback);
 	curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, docker_path.c_str());
 
-	std::string url = "http://localhost" + m_api_version + req_url;
+	std::string url = "http://localhost" + m_api_version + fetch.m_url;
 
 	g_logger.format(sinsp_logger::SEV_DEBUG,
 			"docker_async (%s): Fetching url",
@@ -82,18 +110,18 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 				"docker_async (%s): curl_easy_setopt(CURLOPT_URL) failed",
 				url.c_str());
 
-		curl_easy_cleanup(curl);
+		release_handle(curl);
 		ASSERT(false);
-		return docker_response::RESP_ERROR;
+		return nullptr;
 	}
-	if(curl_easy_setopt(curl, CURLOPT_WRITEDATA, &json) != CURLE_OK)
+	if(curl_easy_setopt(curl, CURLOPT_WRITEDATA, &fetch.m_json) != CURLE_OK)
 	{
 		g_logger.format(sinsp_logger::SEV_DEBUG,
 				"docker_async (%s): curl_easy_setopt(CURLOPT_WRITEDATA) failed",
 				url.c_str());
-		curl_easy_cleanup(curl);
+		release_handle(curl);
 		ASSERT(false);
-		return docker_response::RESP_ERROR;
+		return nullptr;
 	}
 
 	if(curl_multi_add_handle(m_curlm, curl) != CURLM_OK)
@@ -101,47 +129,16 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 		g_logger.format(sinsp_logger::SEV_DEBUG,
 				"docker_async (%s): curl_multi_add_handle() failed",
 				url.c_str());
-		curl_easy_cleanup(curl);
+		release_handle(curl);
 		ASSERT(false);
-		return docker_response::RESP_ERROR;
+		return nullptr;
 	}
 
-	while(true)
-	{
-		int still_running;
-		CURLMcode res = curl_multi_perform(m_curlm, &still_running);
-		if(res != CURLM_OK)
-		{
-			g_logger.format(sinsp_logger::SEV_DEBUG,
-					"docker_async (%s): curl_multi_perform() failed",
-					url.c_str());
-
-			curl_multi_remove_handle(m_curlm, curl);
-			curl_easy_cleanup(curl);
-			ASSERT(false);
-			return docker_response::RESP_ERROR;
-		}
-
-		if(still_running == 0)
-		{
-			break;
-		}
-
-		int numfds;
-		res = curl_multi_wait(m_curlm, NULL, 0, 1000, &numfds);
-		if(res != CURLM_OK)
-		{
-			g_logger.format(sinsp_logger::SEV_DEBUG,
-					"docker_async (%s): curl_multi_wait() failed",
-					url.c_str());
-
-			curl_multi_remove_handle(m_curlm, curl);
-			curl_easy_cleanup(curl);
-			ASSERT(false);
-			return docker_response::RESP_ERROR;
-		}
-	}
+	return curl;
+}
 
+docker_connection::docker_response docker_connection::finish_fetch(CURL* curl, const std::string& url)
+{
 	if(curl_multi_remove_handle(m_curlm, curl) != CURLM_OK)
 	{
 		g_logger.format(sinsp_logger::SEV_DEBUG,
@@ -160,12 +157,12 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 				"docker_async (%s): curl_easy_getinfo(CURLINFO_RESPONSE_CODE) failed",
 				url.c_str());
 
-		curl_easy_cleanup(curl);
+		release_handle(curl);
 		ASSERT(false);
 		return docker_response::RESP_ERROR;
 	}
 
-	curl_easy_cleanup(curl);
+	release_handle(curl);
 	g_logger.format(sinsp_logger::SEV_DEBUG,
 			"docker_async (%s): http_code=%ld",
 			url.c_str(), http_code);
@@ -188,11 +185,70 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 				url.c_str());
 		return docker_response::RESP_BAD_REQUEST;
 	}
+}
 
-	g_logger.format(sinsp_logger::SEV_DEBUG,
-			"docker_async (%s): fallthrough, returning RESP_OK",
-			url.c_str());
+void docker_connection::get_docker(std::vector<docker_fetch>& fetches)
+{
+	std::vector<CURL*> handles(fetches.size(), nullptr);
+	size_t started = 0;
+
+	for(size_t i = 0; i < fetches.size(); i++)
+	{
+		fetches[i].m_json.clear();
+		fetches[i].m_response = docker_response::RESP_ERROR;
+		handles[i] = start_fetch(fetches[i]);
+		if(handles[i])
+		{
+			started++;
+		}
+	}
+
+	while(started > 0)
+	{
+		int still_running;
+		CURLMcode res = curl_multi_perform(m_curlm, &still_running);
+		if(res != CURLM_OK)
+		{
+			g_logger.format(sinsp_logger::SEV_DEBUG,
+					"docker_async: curl_multi_perform() failed");
+			ASSERT(false);
+			break;
+		}
 
-	return docker_response::RESP_OK;
+		if(still_running == 0)
+		{
+			break;
+		}
+
+		int numfds;
+		res = curl_multi_wait(m_curlm, NULL, 0, 1000, &numfds);
+		if(res != CURLM_OK)
+		{
+			g_logger.format(sinsp_logger::SEV_DEBUG,
+					"docker_async: curl_multi_wait() failed");
+			ASSERT(false);
+			break;
+		}
+	}
+
+	// A transfer that didn't complete has no response code and
+	// is reported as an error
+	for(size_t i = 0; i < fetches.size(); i++)
+	{
+		if(handles[i])
+		{
+			fetches[i].m_response = finish_fetch(handles[i], fetches[i].m_url);
+		}
+	}
 }
 
+docker_connection::docker_response docker_connection::get_docker(const docker_lookup_request& request, const std::string& req_url, std::string &json)
+{
+	std::vector<docker_fetch> fetches;
+	fetches.emplace_back(request, req_url);
+
+	get_docker(fetches);
+
+	json.append(fetches[0].m_json);
+	return fetches[0].m_response;
+}
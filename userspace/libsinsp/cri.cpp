@@ -110,6 +110,26 @@ grpc::Status cri_interface::get_container_stats(const std::string& container_id,
 	return m_cri->ContainerStats(&context, req, &resp);
 }
 
+grpc::Status cri_interface::list_containers(runtime::v1alpha2::ListContainersResponse& resp)
+{
+	runtime::v1alpha2::ListContainersRequest req;
+	req.mutable_filter()->mutable_state()->set_state(runtime::v1alpha2::CONTAINER_RUNNING);
+	grpc::ClientContext context;
+	auto deadline = std::chrono::system_clock::now() + std::chrono::milliseconds(s_cri_timeout);
+	context.set_deadline(deadline);
+	return m_cri->ListContainers(&context, req, &resp);
+}
+
+grpc::Status cri_interface::list_pod_sandboxes(runtime::v1alpha2::ListPodSandboxResponse& resp)
+{
+	runtime::v1alpha2::ListPodSandboxRequest req;
+	req.mutable_filter()->mutable_state()->set_state(runtime::v1alpha2::SANDBOX_READY);
+	grpc::ClientContext context;
+	auto deadline = std::chrono::system_clock::now() + std::chrono::milliseconds(s_cri_timeout);
+	context.set_deadline(deadline);
+	return m_cri->ListPodSandbox(&context, req, &resp);
+}
+
 bool cri_interface::parse_cri_image(const runtime::v1alpha2::ContainerStatus &status, const google::protobuf::Map<std::string, std::string> &info, sinsp_container_info &container)
 {
 	// image_ref may be one of two forms:
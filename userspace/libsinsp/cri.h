@@ -81,6 +81,20 @@ public:
 	 */
 	grpc::Status get_container_stats(const std::string& container_id, runtime::v1alpha2::ContainerStatsResponse& resp);
 
+	/**
+	 * @brief thin wrapper around CRI gRPC ListContainers call, listing the running containers
+	 * @param resp reference to the response (if the RPC is successful, it will be filled out)
+	 * @return status of the gRPC call
+	 */
+	grpc::Status list_containers(runtime::v1alpha2::ListContainersResponse& resp);
+
+	/**
+	 * @brief thin wrapper around CRI gRPC ListPodSandbox call, listing the ready pod sandboxes
+	 * @param resp reference to the response (if the RPC is successful, it will be filled out)
+	 * @return status of the gRPC call
+	 */
+	grpc::Status list_pod_sandboxes(runtime::v1alpha2::ListPodSandboxResponse& resp);
+
 	/**
 	 * @brief fill out container image information based on CRI response
 	 * @param status `status` field of the ContainerStatusResponse
@@ -16,62 +16,116 @@ limitations under the License.
 */
 
 #include "dns_manager.h"
+#include "thread_placement.h"
+
+#if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32) && !defined(MINIMAL_BUILD)
+#include <ares.h>
+#include <poll.h>
+#endif
+
+//
+// Timeout of a single DNS query, each one is tried twice
+//
+#define DNS_QUERY_TIMEOUT_MS 2000
+
+#if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
+namespace
+{
+	// Time until a name is resolved again: the TTL of its records, when
+	// the resolver reports it, otherwise the backoff in timeout
+	uint64_t next_resolve_in(uint64_t ttl, uint64_t timeout, uint64_t max_refresh_timeout)
+	{
+		if(ttl == 0)
+		{
+			return timeout;
+		}
+		return std::min(std::max(ttl, (uint64_t)ONE_SECOND_IN_NS), max_refresh_timeout);
+	}
+}
+#endif
 
 void sinsp_dns_resolver::refresh(uint64_t erase_timeout, uint64_t base_refresh_timeout, uint64_t max_refresh_timeout, std::future<void> f_exit)
 {
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
+	libsinsp::thread_placement::apply(libsinsp::thread_placement::thread_class::DNS_RESOLVER);
+
 	sinsp_dns_manager &manager = sinsp_dns_manager::get();
 	while(true)
 	{
-		if(!manager.m_cache.empty())
-		{
-			std::list<std::string> to_delete;
-
-			uint64_t ts = sinsp_utils::get_current_time_ns();
+		uint64_t ts = sinsp_utils::get_current_time_ns();
+		uint64_t wait = base_refresh_timeout;
+		std::vector<std::string> names;
 
-			for(auto &it: manager.m_cache)
+		//
+		// Collect the names that are due, from the schedule instead of
+		// walking the whole cache
+		//
+		{
+			std::lock_guard<std::mutex> lock(manager.m_mutex);
+			while(!manager.m_schedule.empty())
 			{
-				const std::string &name = it.first;
-				sinsp_dns_manager::dns_info &info = it.second;
-
-				if((ts > info.m_last_used_ts) &&
-				   (ts - info.m_last_used_ts) > erase_timeout)
+				const sinsp_dns_manager::schedule_entry &next = manager.m_schedule.top();
+				if(next.first > ts)
 				{
-					// remove the entry if it's hasn't been used for a whole hour
-					to_delete.push_back(name);
+					wait = std::min(wait, next.first - ts);
+					break;
 				}
-				else if(ts > (info.m_last_resolve_ts + info.m_timeout))
+
+				auto it = manager.m_cache.find(next.second);
+				if(it != manager.m_cache.end() && it->second.m_next_resolve_ts == next.first)
 				{
-					sinsp_dns_manager::dns_info refreshed_info = manager.resolve(name, ts);
-					refreshed_info.m_timeout = base_refresh_timeout;
-					refreshed_info.m_last_resolve_ts = info.m_last_resolve_ts = ts;
-
-					// dns_info::operator!= will check if some
-					// v4 or v6 addresses are changed from the
-					// last resolution
-					if(refreshed_info != info)
+					if((ts > it->second.m_last_used_ts) &&
+					   (ts - it->second.m_last_used_ts) > erase_timeout)
 					{
-						info = refreshed_info;
+						// remove the entry if it's hasn't been used for a whole hour
+						manager.erase(next.second);
 					}
-					else if(info.m_timeout < max_refresh_timeout)
+					else
 					{
-						// double the timeout until 320 secs
-						info.m_timeout <<= 1;
+						names.push_back(next.second);
 					}
 				}
+				manager.m_schedule.pop();
 			}
-			if(!to_delete.empty())
+		}
+
+		if(!names.empty())
+		{
+			std::vector<sinsp_dns_manager::dns_info> infos;
+			sinsp_dns_manager::resolve(names, infos);
+
+			ts = sinsp_utils::get_current_time_ns();
+			std::lock_guard<std::mutex> lock(manager.m_mutex);
+			for(size_t j = 0; j < names.size(); j++)
 			{
-				manager.m_erase_mutex.lock();
-				for(const auto &name : to_delete)
+				auto it = manager.m_cache.find(names[j]);
+				if(it == manager.m_cache.end())
 				{
-					manager.m_cache.unsafe_erase(name);
+					continue;
 				}
-				manager.m_erase_mutex.unlock();
+
+				sinsp_dns_manager::dns_info &info = it->second;
+				sinsp_dns_manager::dns_info &refreshed_info = infos[j];
+
+				// dns_info::operator!= will check if some
+				// v4 or v6 addresses are changed from the
+				// last resolution
+				refreshed_info.m_timeout = base_refresh_timeout;
+				if(refreshed_info == info && info.m_timeout < max_refresh_timeout)
+				{
+					// double the timeout until 320 secs
+					refreshed_info.m_timeout = info.m_timeout << 1;
+				}
+				refreshed_info.m_last_used_ts = info.m_last_used_ts;
+				refreshed_info.m_next_resolve_ts = ts + next_resolve_in(refreshed_info.m_ttl, refreshed_info.m_timeout, max_refresh_timeout);
+				manager.update(names[j], std::move(refreshed_info));
 			}
+
+			// Other names may have become due in the meantime
+			wait = 0;
 		}
 
-		if(f_exit.wait_for(std::chrono::nanoseconds(base_refresh_timeout)) == std::future_status::ready)
+		if(f_exit.wait_for(std::chrono::nanoseconds(wait)) == std::future_status::ready)
 		{
 			break;
 		}
@@ -80,41 +134,233 @@ void sinsp_dns_resolver::refresh(uint64_t erase_timeout, uint64_t base_refresh_t
 }
 
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
-inline sinsp_dns_manager::dns_info sinsp_dns_manager::resolve(const std::string &name, uint64_t ts)
+void sinsp_dns_manager::resolve(const std::vector<std::string> &names, std::vector<dns_info> &infos)
 {
-	dns_info dinfo;
+	infos.assign(names.size(), dns_info());
 
-	struct addrinfo hints, *result, *rp;
-	memset(&hints, 0, sizeof(struct addrinfo));
+#ifndef MINIMAL_BUILD
+	//
+	// c-ares sends all the queries at once and waits for the answers
+	// together, and unlike getaddrinfo() reports the TTL of the records
+	//
+	ares_channel channel;
+	struct ares_options options;
+	options.timeout = DNS_QUERY_TIMEOUT_MS;
+	options.tries = 2;
+	if(ares_init_options(&channel, &options, ARES_OPT_TIMEOUTMS | ARES_OPT_TRIES) == ARES_SUCCESS)
+	{
+		auto on_addrinfo = [](void *arg, int status, int timeouts, struct ares_addrinfo *result)
+		{
+			dns_info *dinfo = (dns_info *)arg;
+			if(status != ARES_SUCCESS || result == NULL)
+			{
+				return;
+			}
 
-	// Allow IPv4 or IPv6, all socket types, all protocols
-	hints.ai_family = AF_UNSPEC;
+			for(struct ares_addrinfo_node *rp = result->nodes; rp != NULL; rp = rp->ai_next)
+			{
+				if(rp->ai_family == AF_INET)
+				{
+					dinfo->m_v4_addrs.insert(((struct sockaddr_in*)rp->ai_addr)->sin_addr.s_addr);
+				}
+				else if(rp->ai_family == AF_INET6)
+				{
+					ipv6addr v6;
+					memcpy(v6.m_b, ((struct sockaddr_in6*)rp->ai_addr)->sin6_addr.s6_addr, sizeof(ipv6addr));
+					dinfo->m_v6_addrs.insert(v6);
+				}
+				else
+				{
+					continue;
+				}
 
-	int s = getaddrinfo(name.c_str(), NULL, &hints, &result);
-	if (!s && result)
-	{
-		for (rp = result; rp != NULL; rp = rp->ai_next)
+				// The name is resolved again when the first record expires
+				uint64_t ttl = (uint64_t)std::max(rp->ai_ttl, 0) * ONE_SECOND_IN_NS;
+				if(dinfo->m_ttl == 0 || ttl < dinfo->m_ttl)
+				{
+					dinfo->m_ttl = ttl;
+				}
+			}
+			ares_freeaddrinfo(result);
+		};
+
+		struct ares_addrinfo_hints hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		for(size_t j = 0; j < names.size(); j++)
+		{
+			ares_getaddrinfo(channel, names[j].c_str(), NULL, &hints, on_addrinfo, &infos[j]);
+		}
+
+		while(true)
 		{
-			if(rp->ai_family == AF_INET)
+			ares_socket_t socks[ARES_GETSOCK_MAXNUM];
+			struct pollfd fds[ARES_GETSOCK_MAXNUM];
+			nfds_t nfds = 0;
+
+			int bitmask = ares_getsock(channel, socks, ARES_GETSOCK_MAXNUM);
+			for(int i = 0; i < ARES_GETSOCK_MAXNUM; i++)
+			{
+				short events = 0;
+				if(ARES_GETSOCK_READABLE(bitmask, i))
+				{
+					events |= POLLIN;
+				}
+				if(ARES_GETSOCK_WRITABLE(bitmask, i))
+				{
+					events |= POLLOUT;
+				}
+				if(events != 0)
+				{
+					fds[nfds].fd = socks[i];
+					fds[nfds].events = events;
+					fds[nfds].revents = 0;
+					nfds++;
+				}
+			}
+
+			// No socket left means that all the queries are done
+			if(nfds == 0)
+			{
+				break;
+			}
+
+			struct timeval tv;
+			struct timeval *tvp = ares_timeout(channel, NULL, &tv);
+			int timeout_ms = tvp ? (int)(tvp->tv_sec * 1000 + tvp->tv_usec / 1000) : DNS_QUERY_TIMEOUT_MS;
+
+			int res = poll(fds, nfds, timeout_ms);
+			if(res < 0 && errno != EINTR)
+			{
+				break;
+			}
+
+			if(res <= 0)
 			{
-				dinfo.m_v4_addrs.insert(((struct sockaddr_in*)rp->ai_addr)->sin_addr.s_addr);
+				// Let c-ares retry or fail the queries that timed out
+				ares_process_fd(channel, ARES_SOCKET_BAD, ARES_SOCKET_BAD);
+				continue;
 			}
-			else // AF_INET6
+
+			for(nfds_t i = 0; i < nfds; i++)
 			{
-				ipv6addr v6;
-				memcpy(v6.m_b, ((struct sockaddr_in6*)rp->ai_addr)->sin6_addr.s6_addr, sizeof(ipv6addr));
-				dinfo.m_v6_addrs.insert(v6);
+				ares_process_fd(channel,
+						(fds[i].revents & (POLLIN | POLLERR | POLLHUP)) ? fds[i].fd : ARES_SOCKET_BAD,
+						(fds[i].revents & POLLOUT) ? fds[i].fd : ARES_SOCKET_BAD);
 			}
 		}
-		freeaddrinfo(result);
+
+		ares_destroy(channel);
+		return;
+	}
+#endif
+
+	for(size_t j = 0; j < names.size(); j++)
+	{
+		dns_info &dinfo = infos[j];
+
+		struct addrinfo hints, *result, *rp;
+		memset(&hints, 0, sizeof(struct addrinfo));
+
+		// Allow IPv4 or IPv6, all socket types, all protocols
+		hints.ai_family = AF_UNSPEC;
+
+		int s = getaddrinfo(names[j].c_str(), NULL, &hints, &result);
+		if (!s && result)
+		{
+			for (rp = result; rp != NULL; rp = rp->ai_next)
+			{
+				if(rp->ai_family == AF_INET)
+				{
+					dinfo.m_v4_addrs.insert(((struct sockaddr_in*)rp->ai_addr)->sin_addr.s_addr);
+				}
+				else // AF_INET6
+				{
+					ipv6addr v6;
+					memcpy(v6.m_b, ((struct sockaddr_in6*)rp->ai_addr)->sin6_addr.s6_addr, sizeof(ipv6addr));
+					dinfo.m_v6_addrs.insert(v6);
+				}
+			}
+			freeaddrinfo(result);
+		}
+	}
+}
+
+void sinsp_dns_manager::unindex(const std::string &name, const dns_info &info)
+{
+	for(uint32_t addr : info.m_v4_addrs)
+	{
+		auto names = m_v4_names.find(addr);
+		names->second.erase(name);
+		if(names->second.empty())
+		{
+			m_v4_names.erase(names);
+		}
+	}
+	for(const ipv6addr &addr : info.m_v6_addrs)
+	{
+		auto names = m_v6_names.find(addr);
+		names->second.erase(name);
+		if(names->second.empty())
+		{
+			m_v6_names.erase(names);
+		}
+	}
+}
+
+uint64_t sinsp_dns_manager::estimate_memory(const std::string &name, const dns_info &info)
+{
+	// The name is stored as the key of the cache, in the schedule and
+	// in the reverse index of each address
+	uint64_t name_bytes = sizeof(std::string) + sinsp_table_memory::string_bytes(name);
+	uint64_t naddrs = info.m_v4_addrs.size() + info.m_v6_addrs.size();
+
+	return sinsp_table_memory::HASH_NODE_BYTES + sizeof(dns_info) + 2 * name_bytes + sizeof(uint64_t) +
+		info.m_v4_addrs.size() * (sinsp_table_memory::TREE_NODE_BYTES + sizeof(uint32_t)) +
+		info.m_v6_addrs.size() * (sinsp_table_memory::TREE_NODE_BYTES + sizeof(ipv6addr)) +
+		naddrs * (sinsp_table_memory::TREE_NODE_BYTES + name_bytes);
+}
+
+void sinsp_dns_manager::update(const std::string &name, dns_info &&info)
+{
+	auto it = m_cache.find(name);
+	if(it != m_cache.end())
+	{
+		unindex(name, it->second);
+		m_memory.remove(estimate_memory(name, it->second));
+	}
+	m_memory.add(estimate_memory(name, info));
+
+	for(uint32_t addr : info.m_v4_addrs)
+	{
+		m_v4_names[addr].insert(name);
+	}
+	for(const ipv6addr &addr : info.m_v6_addrs)
+	{
+		m_v6_names[addr].insert(name);
+	}
+
+	m_schedule.emplace(info.m_next_resolve_ts, name);
+	m_cache[name] = std::move(info);
+}
+
+void sinsp_dns_manager::erase(const std::string &name)
+{
+	auto it = m_cache.find(name);
+	if(it != m_cache.end())
+	{
+		unindex(name, it->second);
+		m_memory.remove(estimate_memory(name, it->second));
+		m_cache.erase(it);
 	}
-	return dinfo;
 }
 #endif
 
 bool sinsp_dns_manager::match(const char *name, int af, void *addr, uint64_t ts)
 {
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
+	std::unique_lock<std::mutex> lock(m_mutex);
+
 	if(!m_resolver)
 	{
 		m_resolver = new std::thread(sinsp_dns_resolver::refresh, m_erase_timeout, m_base_refresh_timeout, m_max_refresh_timeout, m_exit_signal.get_future());
@@ -122,30 +368,54 @@ bool sinsp_dns_manager::match(const char *name, int af, void *addr, uint64_t ts)
 
 	std::string sname = std::string(name);
 
-	m_erase_mutex.lock();
-
-	if(m_cache.find(sname) == m_cache.end())
+	auto it = m_cache.find(sname);
+	if(it == m_cache.end())
 	{
-		dns_info dinfo = resolve(sname, ts);
-		dinfo.m_timeout = m_base_refresh_timeout;
-		dinfo.m_last_resolve_ts = ts;
-		m_cache[sname] = dinfo;
-	}
+		// The first resolution of a name is synchronous, so that the
+		// event is matched against the right addresses
+		lock.unlock();
+		std::vector<dns_info> infos;
+		resolve({sname}, infos);
+		lock.lock();
 
-	m_cache[sname].m_last_used_ts = ts;
-	dns_info &dinfo = m_cache[sname];
+		it = m_cache.find(sname);
+		if(it == m_cache.end())
+		{
+			dns_info &dinfo = infos[0];
+			if(m_memory.over_budget())
+			{
+				// Matched without caching the name, which is
+				// resolved again the next time
+				m_memory.add_budget_drop();
+				if(af == AF_INET6)
+				{
+					ipv6addr v6;
+					memcpy(v6.m_b, addr, sizeof(ipv6addr));
+					return dinfo.m_v6_addrs.count(v6) != 0;
+				}
+				return af == AF_INET && dinfo.m_v4_addrs.count(*(uint32_t *)addr) != 0;
+			}
+			dinfo.m_timeout = m_base_refresh_timeout;
+			dinfo.m_next_resolve_ts = sinsp_utils::get_current_time_ns() +
+				next_resolve_in(dinfo.m_ttl, dinfo.m_timeout, m_max_refresh_timeout);
+			update(sname, std::move(dinfo));
+			it = m_cache.find(sname);
+		}
+	}
 
-	m_erase_mutex.unlock();
+	it->second.m_last_used_ts = ts;
 
 	if(af == AF_INET6)
 	{
 		ipv6addr v6;
 		memcpy(v6.m_b, addr, sizeof(ipv6addr));
-		return dinfo.m_v6_addrs.find(v6) != dinfo.m_v6_addrs.end();
+		auto names = m_v6_names.find(v6);
+		return names != m_v6_names.end() && names->second.count(sname) != 0;
 	}
 	else if(af == AF_INET)
 	{
-		return dinfo.m_v4_addrs.find(*(uint32_t *)addr) != dinfo.m_v4_addrs.end();
+		auto names = m_v4_names.find(*(uint32_t *)addr);
+		return names != m_v4_names.end() && names->second.count(sname) != 0;
 	}
 #endif
 	return false;
@@ -156,33 +426,32 @@ std::string sinsp_dns_manager::name_of(int af, void *addr, uint64_t ts)
 	std::string ret;
 
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
-	if(!m_cache.empty())
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const std::set<std::string> *names = nullptr;
+	if(af == AF_INET6)
+	{
+		ipv6addr v6;
+		memcpy(v6.m_b, addr, sizeof(ipv6addr));
+		auto it = m_v6_names.find(v6);
+		if(it != m_v6_names.end())
+		{
+			names = &it->second;
+		}
+	}
+	else if(af == AF_INET)
 	{
-		m_erase_mutex.lock();
-		for(auto &it: m_cache)
+		auto it = m_v4_names.find(*(uint32_t *)addr);
+		if(it != m_v4_names.end())
 		{
-			const std::string &name = it.first;
-			sinsp_dns_manager::dns_info &info = it.second;
-
-			if(af == AF_INET6)
-			{
-				ipv6addr v6;
-				memcpy(v6.m_b, addr, sizeof(ipv6addr));
-				if (info.m_v6_addrs.find(v6) != info.m_v6_addrs.end())
-				{
-					info.m_last_used_ts = ts;
-					ret = name;
-					break;
-				}
-			}
-			else if(af == AF_INET && info.m_v4_addrs.find(*(uint32_t *)addr) != info.m_v4_addrs.end())
-			{
-				info.m_last_used_ts = ts;
-				ret = name;
-				break;
-			}
+			names = &it->second;
 		}
-		m_erase_mutex.unlock();
+	}
+
+	if(names != nullptr)
+	{
+		ret = *names->begin();
+		m_cache[ret].m_last_used_ts = ts;
 	}
 #endif
 	return ret;
@@ -27,10 +27,12 @@ limitations under the License.
 #include <chrono>
 #include <future>
 #include <mutex>
-#if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
-#include "tbb/concurrent_unordered_map.h"
-#endif
+#include <queue>
+#include <set>
+#include <unordered_map>
+#include <vector>
 #include "sinsp.h"
+#include "table_memory.h"
 
 
 struct sinsp_dns_resolver
@@ -69,12 +71,20 @@ public:
 	size_t size()
 	{
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
+		std::lock_guard<std::mutex> lock(m_mutex);
 		return m_cache.size();
 #else
 		return 0;
 #endif
 	};
 
+	// Approximate memory used by the cache, its reverse index and its
+	// schedule. Updated with m_mutex held.
+	sinsp_table_memory& get_memory()
+	{
+		return m_memory;
+	}
+
 private:
 
 	sinsp_dns_manager() :
@@ -97,23 +107,59 @@ private:
 			return !operator==(other);
 		};
 
+		// Current time at which the name is resolved again, from the
+		// TTL of its records or from m_timeout when they aren't known
+		uint64_t m_next_resolve_ts;
 		uint64_t m_timeout;
-		uint64_t m_last_resolve_ts;
 		uint64_t m_last_used_ts;
+		// 0 if the resolver doesn't report the TTL of the records
+		uint64_t m_ttl;
 		std::set<uint32_t> m_v4_addrs;
 		std::set<ipv6addr> m_v6_addrs;
 	};
 
-	static inline dns_info resolve(const std::string &name, uint64_t ts);
+	struct ipv6addr_hash
+	{
+		size_t operator()(const ipv6addr &addr) const
+		{
+			size_t h = 0;
+			for(uint32_t b : addr.m_b)
+			{
+				h = h * 31 + b;
+			}
+			return h;
+		}
+	};
+
+	// Resolves all the names at once, the queries being sent in parallel
+	static void resolve(const std::vector<std::string> &names, std::vector<dns_info> &infos);
+
+	// Replaces the addresses of a name, keeping the reverse index in sync.
+	// Must be called with m_mutex held.
+	void update(const std::string &name, dns_info &&info);
+	void erase(const std::string &name);
+	void unindex(const std::string &name, const dns_info &info);
+	static uint64_t estimate_memory(const std::string &name, const dns_info &info);
 
-	typedef tbb::concurrent_unordered_map<std::string, dns_info> c_dns_table;
-	c_dns_table m_cache;
+	std::unordered_map<std::string, dns_info> m_cache;
+
+	// Reverse index from the addresses to the names resolving to them
+	std::unordered_map<uint32_t, std::set<std::string>> m_v4_names;
+	std::unordered_map<ipv6addr, std::set<std::string>, ipv6addr_hash> m_v6_names;
+
+	// Names by time of their next resolution. The entries of the names
+	// that have been resolved again or erased in the meantime are stale,
+	// and are skipped by comparing the time with m_next_resolve_ts.
+	typedef std::pair<uint64_t, std::string> schedule_entry;
+	std::priority_queue<schedule_entry, std::vector<schedule_entry>, std::greater<schedule_entry>> m_schedule;
 #endif
 
-	// tbb concurrent unordered map is not thread-safe for deletions,
-	// so we still need a mutex, but the chances of waiting are really
-	// low, since we will almost never do an erase.
-	std::mutex m_erase_mutex;
+	// Protects the cache, the reverse index and the schedule, which are
+	// shared with m_resolver. The lookups only need it for a short time
+	// since the names are resolved without holding it.
+	std::mutex m_mutex;
+
+	sinsp_table_memory m_memory;
 
 	// used to let m_resolver know when to terminate
 	std::promise<void> m_exit_signal;
@@ -19,9 +19,13 @@ limitations under the License.
 #include "sinsp_int.h"
 #include "scap.h"
 #include "dumper.h"
+#include "thread_placement.h"
+
+extern sinsp_evttables g_infotables;
 
 sinsp_dumper::sinsp_dumper()
 {
+	m_inspector = NULL;
 	m_dumper = NULL;
 	m_target_memory_buffer = NULL;
 	m_target_memory_buffer_size = 0;
@@ -30,6 +34,7 @@ sinsp_dumper::sinsp_dumper()
 
 sinsp_dumper::sinsp_dumper(uint8_t* target_memory_buffer, uint64_t target_memory_buffer_size)
 {
+	m_inspector = NULL;
 	m_dumper = NULL;
 	m_target_memory_buffer = target_memory_buffer;
 	m_target_memory_buffer_size = target_memory_buffer_size;
@@ -44,6 +49,11 @@ sinsp_dumper::~sinsp_dumper()
 }
 
 void sinsp_dumper::open(sinsp* inspector, const std::string& filename, bool compress, bool threads_from_sinsp)
+{
+	open(inspector, filename, compress ? SCAP_COMPRESSION_GZIP : SCAP_COMPRESSION_NONE, threads_from_sinsp);
+}
+
+void sinsp_dumper::open(sinsp* inspector, const std::string& filename, compression_mode compress, bool threads_from_sinsp)
 {
 	if(inspector->m_h == NULL)
 	{
@@ -56,14 +66,7 @@ void sinsp_dumper::open(sinsp* inspector, const std::string& filename, bool comp
 	}
 	else
 	{
-		if(compress)
-		{
-			m_dumper = scap_dump_open(inspector->m_h, filename.c_str(), SCAP_COMPRESSION_GZIP, threads_from_sinsp);
-		}
-		else
-		{
-			m_dumper = scap_dump_open(inspector->m_h, filename.c_str(), SCAP_COMPRESSION_NONE, threads_from_sinsp);
-		}
+		m_dumper = scap_dump_open(inspector->m_h, filename.c_str(), compress, threads_from_sinsp);
 	}
 
 	if(m_dumper == NULL)
@@ -71,6 +74,24 @@ void sinsp_dumper::open(sinsp* inspector, const std::string& filename, bool comp
 		throw sinsp_exception(scap_getlasterr(inspector->m_h));
 	}
 
+	dump_state(inspector, threads_from_sinsp);
+}
+
+void sinsp_dumper::dump_state(sinsp* inspector, bool threads_from_sinsp)
+{
+	m_inspector = inspector;
+	m_dumping_state = true;
+	m_next_ckpt_ts = 0;
+	m_last_ckpt_ts = 0;
+
+	if(m_async_bufsize != 0)
+	{
+		// The state goes through the background thread too, without
+		// being dropped when the buffers are full
+		enable_async(m_async_bufsize, m_async_nbufs);
+		scap_dump_set_async_drop(m_dumper, false);
+	}
+
 	if(threads_from_sinsp)
 	{
 		inspector->m_thread_manager->dump_threads_to_file(m_dumper);
@@ -80,40 +101,98 @@ void sinsp_dumper::open(sinsp* inspector, const std::string& filename, bool comp
 
 	inspector->m_usergroup_manager.dump_users_groups(*this);
 
+	scap_dump_set_async_drop(m_dumper, true);
 	m_nevts = 0;
+	m_dumping_state = false;
+
+	m_last_ts = 0;
+	m_held_enters.clear();
+	m_pending_fds.clear();
 }
 
-void sinsp_dumper::fdopen(sinsp* inspector, int fd, bool compress, bool threads_from_sinsp)
+void sinsp_dumper::dump_checkpoint(uint64_t ts)
 {
-	if(inspector->m_h == NULL)
+	uint64_t pos = next_write_position();
+
+	if(m_next_ckpt_ts == 0)
 	{
-		throw sinsp_exception("can't start event dump, inspector not opened yet");
+		// The first event only starts counting, the state at the
+		// beginning of the file serves as the first checkpoint
 	}
-
-	if(compress)
+	else if((ts < m_next_ckpt_ts && pos < m_next_ckpt_pos) || ts < m_last_ckpt_ts)
 	{
-		m_dumper = scap_dump_open_fd(inspector->m_h, fd, SCAP_COMPRESSION_GZIP, threads_from_sinsp);
+		// Not due, or the event went back in time and the checkpoints
+		// must stay sorted
+		return;
 	}
 	else
 	{
-		m_dumper = scap_dump_open_fd(inspector->m_h, fd, SCAP_COMPRESSION_NONE, threads_from_sinsp);
-	}
+		//
+		// The state goes to a buffer first, scap writes it after the
+		// beginning of the checkpoint
+		//
+		scap_dumper_t* state = scap_managedbuf_dump_create();
+		if(state == NULL)
+		{
+			throw sinsp_exception("failed to create the checkpoint dumper");
+		}
 
-	if(m_dumper == NULL)
-	{
-		throw sinsp_exception(scap_getlasterr(inspector->m_h));
+		scap_dumper_t* dumper = m_dumper;
+		uint64_t nevts = m_nevts;
+		m_dumper = state;
+		m_dumping_state = true;
+		try
+		{
+			m_inspector->m_thread_manager->dump_threads_to_file(state);
+			m_inspector->m_container_manager.dump_containers(*this);
+			m_inspector->m_usergroup_manager.dump_users_groups(*this);
+		}
+		catch(...)
+		{
+			m_dumper = dumper;
+			m_nevts = nevts;
+			m_dumping_state = false;
+			scap_dump_close(state);
+			throw;
+		}
+		m_dumper = dumper;
+		m_nevts = nevts;
+		m_dumping_state = false;
+
+		int32_t res = scap_dump_checkpoint(m_inspector->m_h, m_dumper, state, ts);
+		scap_dump_close(state);
+		if(res != SCAP_SUCCESS)
+		{
+			throw sinsp_exception(scap_dump_getlasterr(m_dumper));
+		}
+		m_last_ckpt_ts = ts;
+		pos = next_write_position();
 	}
 
-	if(threads_from_sinsp)
+	m_next_ckpt_ts = m_ckpt_interval_ns != 0 && ts <= UINT64_MAX - m_ckpt_interval_ns ? ts + m_ckpt_interval_ns : UINT64_MAX;
+	m_next_ckpt_pos = m_ckpt_interval_bytes != 0 ? pos + m_ckpt_interval_bytes : UINT64_MAX;
+}
+
+void sinsp_dumper::fdopen(sinsp* inspector, int fd, bool compress, bool threads_from_sinsp)
+{
+	fdopen(inspector, fd, compress ? SCAP_COMPRESSION_GZIP : SCAP_COMPRESSION_NONE, threads_from_sinsp);
+}
+
+void sinsp_dumper::fdopen(sinsp* inspector, int fd, compression_mode compress, bool threads_from_sinsp)
+{
+	if(inspector->m_h == NULL)
 	{
-		inspector->m_thread_manager->dump_threads_to_file(m_dumper);
+		throw sinsp_exception("can't start event dump, inspector not opened yet");
 	}
 
-	inspector->m_container_manager.dump_containers(*this);
+	m_dumper = scap_dump_open_fd(inspector->m_h, fd, compress, threads_from_sinsp);
 
-	inspector->m_usergroup_manager.dump_users_groups(*this);
+	if(m_dumper == NULL)
+	{
+		throw sinsp_exception(scap_getlasterr(inspector->m_h));
+	}
 
-	m_nevts = 0;
+	dump_state(inspector, threads_from_sinsp);
 }
 
 void sinsp_dumper::close()
@@ -142,6 +221,12 @@ void sinsp_dumper::dump(sinsp_evt* evt)
 		throw sinsp_exception("dumper not opened yet");
 	}
 
+	if(m_minimal_state && !m_dumping_state)
+	{
+		dump_minimal_state(evt);
+		return;
+	}
+
 	scap_evt* pdevt = (evt->m_poriginal_evt)? evt->m_poriginal_evt : evt->m_pevt;
 	bool do_drop = false;
 	scap_dump_flags dflags;
@@ -152,7 +237,12 @@ void sinsp_dumper::dump(sinsp_evt* evt)
 		return;
 	}
 
-	int32_t res = scap_dump(m_dumper, pdevt, evt->m_cpuid, dflags);
+	write_event(pdevt, evt->m_cpuid, dflags);
+}
+
+void sinsp_dumper::write_event(scap_evt* pdevt, uint16_t cpuid, scap_dump_flags dflags)
+{
+	int32_t res = scap_dump(m_dumper, pdevt, cpuid, dflags);
 
 	if(res != SCAP_SUCCESS)
 	{
@@ -160,6 +250,278 @@ void sinsp_dumper::dump(sinsp_evt* evt)
 	}
 
 	m_nevts++;
+
+	if((m_ckpt_interval_ns != 0 || m_ckpt_interval_bytes != 0) && !m_dumping_state)
+	{
+		dump_checkpoint(pdevt->ts);
+	}
+}
+
+void sinsp_dumper::enable_minimal_state(bool enable)
+{
+	m_minimal_state = enable;
+	m_held_enters.clear();
+	m_pending_fds.clear();
+}
+
+void sinsp_dumper::dump_minimal_state(sinsp_evt* evt)
+{
+	scap_evt* pdevt = (evt->m_poriginal_evt)? evt->m_poriginal_evt : evt->m_pevt;
+	uint16_t type = pdevt->type;
+	int64_t tid = pdevt->tid;
+	sinsp_threadinfo* tinfo = evt->m_tinfo;
+	ppm_event_flags eflags = evt->get_info_flags();
+	bool do_drop = false;
+	scap_dump_flags dflags = evt->get_dump_flags(&do_drop);
+
+	//
+	// The fds created by the event, if it succeeded
+	//
+	int64_t created_fds[2] = {-1, -1};
+	if(PPME_IS_EXIT(type) && (eflags & EF_CREATES_FD))
+	{
+		if(type == PPME_SYSCALL_PIPE_X || type == PPME_SYSCALL_PIPE2_X || type == PPME_SOCKET_SOCKETPAIR_X)
+		{
+			if(evt->get_param(0)->as<int64_t>() >= 0)
+			{
+				created_fds[0] = evt->get_param(1)->as<int64_t>();
+				created_fds[1] = evt->get_param(2)->as<int64_t>();
+			}
+		}
+		else
+		{
+			created_fds[0] = evt->get_param(0)->as<int64_t>();
+		}
+	}
+
+	if(!evt->m_filtered_out || (evt->get_category() & EC_INTERNAL))
+	{
+		if(PPME_IS_EXIT(type))
+		{
+			write_held_enter(tid, type);
+		}
+		else
+		{
+			m_held_enters.erase(tid);
+		}
+
+		if(tinfo != nullptr)
+		{
+			int64_t fd = evt->get_fd_num();
+			if(fd != sinsp_evt::INVALID_FD_NUM)
+			{
+				write_pending_fd(tinfo->m_pid, fd);
+			}
+			if(eflags & EF_USES_FD)
+			{
+				write_pending_fd(tinfo->m_pid, tinfo->m_lastevent_fd);
+			}
+
+			// The fds created by a kept event are in the file
+			// now, whatever was pending for their number is stale
+			auto fds = m_pending_fds.find(tinfo->m_pid);
+			if(fds != m_pending_fds.end())
+			{
+				for(int64_t created : created_fds)
+				{
+					fds->second.erase(created);
+				}
+			}
+		}
+
+		m_last_ts = std::max(m_last_ts, pdevt->ts);
+		write_event(pdevt, evt->m_cpuid, dflags);
+		return;
+	}
+
+	if(!(eflags & EF_MODIFIES_STATE))
+	{
+		m_held_enters.erase(tid);
+		return;
+	}
+
+	dflags = (scap_dump_flags)(dflags | SCAP_DF_STATE_ONLY);
+
+	//
+	// The enter events wait for their exit to know what to do, unless
+	// they have none (e.g. procexit)
+	//
+	if(PPME_IS_ENTER(type) &&
+	   type + 1 < PPM_EVENT_MAX &&
+	   !(g_infotables.m_event_info[type + 1].flags & EF_UNUSED))
+	{
+		held_evt& held = m_held_enters[tid];
+		held.m_data.assign((uint8_t*)pdevt, (uint8_t*)pdevt + pdevt->len);
+		held.m_cpuid = evt->m_cpuid;
+		held.m_flags = dflags;
+		return;
+	}
+
+	if(tinfo != nullptr && (eflags & (EF_CREATES_FD | EF_USES_FD | EF_DESTROYS_FD)))
+	{
+		int64_t pid = tinfo->m_pid;
+
+		if(eflags & EF_CREATES_FD)
+		{
+			if(created_fds[0] < 0)
+			{
+				// Failed, nothing to replay
+				m_held_enters.erase(tid);
+				return;
+			}
+
+			auto pending = std::make_shared<pending_fd>();
+			if(eflags & EF_USES_FD)
+			{
+				pending->m_from_fd = tinfo->m_lastevent_fd;
+			}
+
+			auto enter = m_held_enters.find(tid);
+			if(enter != m_held_enters.end())
+			{
+				if(((scap_evt*)enter->second.m_data.data())->type == type - 1)
+				{
+					pending->m_evts.push_back(std::move(enter->second));
+				}
+				m_held_enters.erase(enter);
+			}
+
+			held_evt held;
+			held.m_data.assign((uint8_t*)pdevt, (uint8_t*)pdevt + pdevt->len);
+			held.m_cpuid = evt->m_cpuid;
+			held.m_flags = dflags;
+			pending->m_evts.push_back(std::move(held));
+
+			auto& fds = m_pending_fds[pid];
+			for(int64_t created : created_fds)
+			{
+				if(created >= 0)
+				{
+					fds[created] = pending;
+				}
+			}
+			return;
+		}
+
+		std::shared_ptr<pending_fd> pending = find_pending_fd(pid, tinfo->m_lastevent_fd);
+		if(pending != nullptr)
+		{
+			if(eflags & EF_DESTROYS_FD)
+			{
+				// Never used by a kept event, as if it never existed
+				m_pending_fds[pid].erase(tinfo->m_lastevent_fd);
+				m_held_enters.erase(tid);
+				return;
+			}
+
+			auto enter = m_held_enters.find(tid);
+			if(enter != m_held_enters.end())
+			{
+				if(((scap_evt*)enter->second.m_data.data())->type == type - 1)
+				{
+					pending->m_evts.push_back(std::move(enter->second));
+				}
+				m_held_enters.erase(enter);
+			}
+
+			held_evt held;
+			held.m_data.assign((uint8_t*)pdevt, (uint8_t*)pdevt + pdevt->len);
+			held.m_cpuid = evt->m_cpuid;
+			held.m_flags = dflags;
+			pending->m_evts.push_back(std::move(held));
+			return;
+		}
+	}
+
+	//
+	// The process events, and the ones on the fds already in the file
+	//
+	if(PPME_IS_EXIT(type))
+	{
+		write_held_enter(tid, type);
+	}
+
+	m_last_ts = std::max(m_last_ts, pdevt->ts);
+	write_event(pdevt, evt->m_cpuid, dflags);
+
+	if(tinfo != nullptr &&
+	   (type == PPME_PROCEXIT_E || type == PPME_PROCEXIT_1_E) &&
+	   tinfo->is_main_thread())
+	{
+		m_pending_fds.erase(tinfo->m_pid);
+	}
+}
+
+void sinsp_dumper::write_held(held_evt& held)
+{
+	scap_evt* pdevt = (scap_evt*)held.m_data.data();
+	if(pdevt->ts < m_last_ts)
+	{
+		pdevt->ts = m_last_ts;
+	}
+	m_last_ts = pdevt->ts;
+	write_event(pdevt, held.m_cpuid, held.m_flags);
+}
+
+void sinsp_dumper::write_held_enter(int64_t tid, uint16_t exit_type)
+{
+	auto it = m_held_enters.find(tid);
+	if(it == m_held_enters.end())
+	{
+		return;
+	}
+
+	if(((scap_evt*)it->second.m_data.data())->type == exit_type - 1)
+	{
+		write_held(it->second);
+	}
+	m_held_enters.erase(it);
+}
+
+std::shared_ptr<sinsp_dumper::pending_fd> sinsp_dumper::find_pending_fd(int64_t pid, int64_t fd)
+{
+	auto fds = m_pending_fds.find(pid);
+	if(fds == m_pending_fds.end())
+	{
+		return nullptr;
+	}
+
+	auto it = fds->second.find(fd);
+	if(it == fds->second.end())
+	{
+		return nullptr;
+	}
+
+	// The other fd of a pipe was used, this one is in the file too
+	if(it->second->m_written)
+	{
+		fds->second.erase(it);
+		return nullptr;
+	}
+
+	return it->second;
+}
+
+void sinsp_dumper::write_pending_fd(int64_t pid, int64_t fd)
+{
+	std::shared_ptr<pending_fd> pending = find_pending_fd(pid, fd);
+	if(pending == nullptr)
+	{
+		return;
+	}
+
+	m_pending_fds[pid].erase(fd);
+	pending->m_written = true;
+	if(pending->m_from_fd >= 0)
+	{
+		write_pending_fd(pid, pending->m_from_fd);
+	}
+
+	for(auto& held : pending->m_evts)
+	{
+		write_held(held);
+	}
+	pending->m_evts.clear();
 }
 
 uint64_t sinsp_dumper::written_bytes() const
@@ -203,3 +565,146 @@ void sinsp_dumper::flush()
 
 	scap_dump_flush(m_dumper);
 }
+
+void sinsp_dumper::enable_index(uint64_t interval)
+{
+	if(m_dumper == NULL)
+	{
+		throw sinsp_exception("dumper not opened yet");
+	}
+
+	if(scap_dump_enable_index(m_dumper, interval) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_dump_getlasterr(m_dumper));
+	}
+}
+
+void sinsp_dumper::enable_string_dictionary(bool enable)
+{
+	if(m_dumper == NULL)
+	{
+		throw sinsp_exception("dumper not opened yet");
+	}
+
+	if(scap_dump_enable_strdict(m_dumper, enable) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_dump_getlasterr(m_dumper));
+	}
+}
+
+void sinsp_dumper::enable_checkpoints(uint64_t interval_ns, uint64_t interval_bytes)
+{
+	if(m_target_memory_buffer)
+	{
+		throw sinsp_exception("checkpoints are only supported by file dumpers");
+	}
+
+	m_ckpt_interval_ns = interval_ns;
+	m_ckpt_interval_bytes = interval_bytes;
+	m_next_ckpt_ts = 0;
+}
+
+void sinsp_dumper::enable_async(uint32_t bufsize, uint32_t nbufs)
+{
+	if(m_dumper == NULL)
+	{
+		// applied by open()
+		m_async_bufsize = bufsize;
+		m_async_nbufs = nbufs;
+		return;
+	}
+
+	if(scap_dump_enable_async(m_dumper, bufsize, nbufs) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_dump_getlasterr(m_dumper));
+	}
+}
+
+uint64_t sinsp_dumper::dropped_events() const
+{
+	if(m_dumper == NULL)
+	{
+		return 0;
+	}
+
+	return scap_dump_get_dropped_events(m_dumper);
+}
+
+sinsp_dumper_closer::sinsp_dumper_closer():
+	m_stop(false)
+{
+}
+
+sinsp_dumper_closer::~sinsp_dumper_closer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cond.notify_one();
+
+	// The queued dumpers are still closed before the thread exits
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void sinsp_dumper_closer::close(std::unique_ptr<sinsp_dumper> dumper, const std::string& filename)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.emplace_back(filename, std::move(dumper));
+	}
+	m_cond.notify_one();
+
+	if(!m_thread.joinable())
+	{
+		m_thread = std::thread(&sinsp_dumper_closer::run, this);
+	}
+}
+
+void sinsp_dumper_closer::wait(const std::string& filename)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done_cond.wait(lock, [this, &filename]() {
+		for(const auto& it : m_queue)
+		{
+			if(it.first == filename)
+			{
+				return false;
+			}
+		}
+		return true;
+	});
+}
+
+void sinsp_dumper_closer::wait_all()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done_cond.wait(lock, [this]() { return m_queue.empty(); });
+}
+
+void sinsp_dumper_closer::run()
+{
+	libsinsp::thread_placement::apply(libsinsp::thread_placement::thread_class::OUTPUT);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(true)
+	{
+		m_cond.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+		if(m_queue.empty())
+		{
+			break;
+		}
+
+		// The entry stays queued until the file is closed, see wait()
+		sinsp_dumper* dumper = m_queue.front().second.get();
+		lock.unlock();
+		dumper->close();
+		lock.lock();
+
+		m_queue.pop_front();
+		m_done_cond.notify_all();
+	}
+}
@@ -20,6 +20,16 @@ limitations under the License.
 class sinsp;
 class sinsp_evt;
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "scap_savefile_api.h"
 
 typedef struct scap_dumper scap_dumper_t;
@@ -72,11 +82,28 @@ public:
 		bool compress,
 		bool threads_from_sinsp=false);
 
+	/*!
+	  \brief Like open(), choosing the compression mode. Files written with
+	   SCAP_COMPRESSION_GZIP_BLOCKS are inflated in parallel when read, while
+	   SCAP_COMPRESSION_ZSTD and SCAP_COMPRESSION_LZ4 cost much less CPU to
+	   write than gzip, if libscap is built with them. The readers detect the
+	   format of the file on their own.
+	*/
+	void open(sinsp* inspector,
+		const std::string& filename,
+		compression_mode compress,
+		bool threads_from_sinsp=false);
+
 	void fdopen(sinsp* inspector,
 		int fd,
 		bool compress,
 		bool threads_from_sinsp=false);
 
+	void fdopen(sinsp* inspector,
+		int fd,
+		compression_mode compress,
+		bool threads_from_sinsp=false);
+
 	/*!
 	  \brief Closes the dump file.
 	*/
@@ -114,6 +141,79 @@ public:
 	*/
 	void flush();
 
+	/*!
+	  \brief Appends to the file an index of the events, so that the
+	  readers can jump to a timestamp (see sinsp::seek_to_timestamp).
+	  Must be called after open() and before dumping the events to index.
+
+	  \param interval Minimum distance, in bytes, between two indexed events.
+	*/
+	void enable_index(uint64_t interval);
+
+	/*!
+	  \brief Writes the string params of the events (paths, names, the
+	  arguments and environment of the processes) once in a dictionary, and
+	  their later occurrences as references to it, which the readers expand
+	  back. The dictionary starts over at the indexed events and at the
+	  checkpoints, so that the readers can seek to them. Must be called
+	  after open(), only supported by file dumpers.
+
+	  \note Readers older than this format can't read the file.
+	*/
+	void enable_string_dictionary(bool enable);
+
+	/*!
+	  \brief Makes the dumper save the state of the inspector (threads, fds,
+	  containers, users) in the file every interval_ns nanoseconds or
+	  interval_bytes bytes of events, whichever comes first, so that the
+	  readers can seek to any point of the file with the right state (see
+	  sinsp::seek_to_timestamp). The threads are always taken from the
+	  inspector's table. Only supported by file dumpers.
+
+	  \param interval_ns Time between two checkpoints, 0 for no limit.
+	  \param interval_bytes Bytes between two checkpoints, 0 for no limit.
+	*/
+	void enable_checkpoints(uint64_t interval_ns, uint64_t interval_bytes);
+
+	/*!
+	  \brief Moves the writes to the file, compression included, to a
+	  background thread, so that a slow disk doesn't stall the capture.
+	  The events are queued in nbufs buffers of bufsize bytes, and are
+	  dropped when all of them are full (see dropped_events()). flush()
+	  and close() wait for the queued events to be written.
+
+	  When called before open(), the writes are asynchronous from the start,
+	  so that the state open() writes at the beginning of the file (threads,
+	  fds, containers, users) is compressed and written by the background
+	  thread as well. The state is never dropped: once the buffers are full,
+	  open() waits for them, so they should be large enough to hold it.
+
+	  \param bufsize Size of each buffer, 0 goes back to synchronous writes.
+	  \param nbufs Number of buffers, at least 2.
+	*/
+	void enable_async(uint32_t bufsize, uint32_t nbufs);
+
+	/*!
+	  \brief Returns the number of events dropped because the asynchronous
+	  writes couldn't keep up.
+	*/
+	uint64_t dropped_events() const;
+
+	/*!
+	  \brief Makes the dumper keep, of the events filtered out, only the
+	  ones needed to replay the kept ones with the right state: the process
+	  events (clone, execve, exit...) and the closing of the fds already in
+	  the file are written, while the events creating and setting up an fd
+	  (open, socket, connect...) are held until a kept event uses the fd,
+	  and written right before it. The fds closed before that are dropped
+	  along with their events. The events written for the state only are
+	  flagged as such, like in fatfile mode, which this mode replaces.
+
+	  \note The held events are written with the timestamp of the last
+	   written event when they're older, so that the file stays sorted.
+	*/
+	void enable_minimal_state(bool enable);
+
 	/*!
 	  \brief Writes an event to the file.
 
@@ -132,11 +232,98 @@ public:
 	}
 
 private:
+	// An event held by the minimal state mode, see enable_minimal_state()
+	struct held_evt
+	{
+		std::vector<uint8_t> m_data;
+		uint16_t m_cpuid;
+		scap_dump_flags m_flags;
+	};
+
+	// The events of an fd no kept event used yet. The two fds of a pipe
+	// share them, so they're written once.
+	struct pending_fd
+	{
+		std::vector<held_evt> m_evts;
+		// The fd this one was created from (e.g. by dup), written first
+		int64_t m_from_fd = -1;
+		bool m_written = false;
+	};
+
+	void dump_state(sinsp* inspector, bool threads_from_sinsp);
+	void dump_checkpoint(uint64_t ts);
+	void write_event(scap_evt* pdevt, uint16_t cpuid, scap_dump_flags dflags);
+	void dump_minimal_state(sinsp_evt* evt);
+	void write_held(held_evt& held);
+	void write_held_enter(int64_t tid, uint16_t exit_type);
+	std::shared_ptr<pending_fd> find_pending_fd(int64_t pid, int64_t fd);
+	void write_pending_fd(int64_t pid, int64_t fd);
+
 	sinsp* m_inspector;
 	scap_dumper_t* m_dumper;
+	// see enable_checkpoints(), the next checkpoint is due once an event
+	// reaches m_next_ckpt_ts or m_next_ckpt_pos
+	uint64_t m_ckpt_interval_ns = 0;
+	uint64_t m_ckpt_interval_bytes = 0;
+	uint64_t m_next_ckpt_ts = 0;
+	uint64_t m_next_ckpt_pos = 0;
+	uint64_t m_last_ckpt_ts = 0;
+	// the state is being dumped, its events don't trigger checkpoints
+	bool m_dumping_state = false;
+	// async buffers requested before open()
+	uint32_t m_async_bufsize = 0;
+	uint32_t m_async_nbufs = 0;
 	uint8_t* m_target_memory_buffer;
 	uint64_t m_target_memory_buffer_size;
 	uint64_t m_nevts;
+
+	// see enable_minimal_state()
+	bool m_minimal_state = false;
+	uint64_t m_last_ts = 0;
+	// the last enter event of each thread, written with its exit
+	std::unordered_map<int64_t, held_evt> m_held_enters;
+	// pid -> fd -> events
+	std::unordered_map<int64_t, std::unordered_map<int64_t, std::shared_ptr<pending_fd>>> m_pending_fds;
+};
+
+/*!
+  \brief Closes dumpers on a background thread. Closing a file waits for
+  its queued data (see sinsp_dumper::enable_async) and for the compressor
+  to finish, which is better kept out of the capture thread when the files
+  are rotated often.
+*/
+class SINSP_PUBLIC sinsp_dumper_closer
+{
+public:
+	sinsp_dumper_closer();
+	~sinsp_dumper_closer();
+
+	/*!
+	  \brief Queues a dumper, writing to filename, to be closed.
+	*/
+	void close(std::unique_ptr<sinsp_dumper> dumper, const std::string& filename);
+
+	/*!
+	  \brief Waits until filename isn't being closed anymore, so that it can
+	  be opened again.
+	*/
+	void wait(const std::string& filename);
+
+	/*!
+	  \brief Waits until all the queued dumpers are closed.
+	*/
+	void wait_all();
+
+private:
+	void run();
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::condition_variable m_done_cond;
+	bool m_stop;
+	// The dumpers to close with their files, the first one is being closed
+	std::deque<std::pair<std::string, std::unique_ptr<sinsp_dumper>>> m_queue;
 };
 
 /*@}*/
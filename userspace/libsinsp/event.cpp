@@ -73,6 +73,9 @@ sinsp_evt::sinsp_evt() :
 		m_flags(EF_NONE),
 		m_params_loaded(false),
 		m_info(NULL),
+		m_nparams(0),
+		m_ndecoded_params(0),
+		m_next_param_offset(0),
 		m_paramstr_storage(256),
 		m_resolved_paramstr_storage(1024),
 		m_tinfo(NULL),
@@ -82,7 +85,9 @@ sinsp_evt::sinsp_evt() :
 		m_errorcode(0),
 		m_rawbuf_str_len(0),
 		m_filtered_out(false),
-		m_event_info_table(g_infotables.m_event_info)
+		m_repeat_count(0),
+		m_event_info_table(g_infotables.m_event_info),
+		m_param_layouts(g_infotables.m_param_layouts)
 {
 
 }
@@ -97,6 +102,9 @@ sinsp_evt::sinsp_evt(sinsp *inspector) :
 		m_flags(EF_NONE),
 		m_params_loaded(false),
 		m_info(NULL),
+		m_nparams(0),
+		m_ndecoded_params(0),
+		m_next_param_offset(0),
 		m_paramstr_storage(1024),
 		m_resolved_paramstr_storage(1024),
 		m_tinfo(NULL),
@@ -106,7 +114,9 @@ sinsp_evt::sinsp_evt(sinsp *inspector) :
 		m_errorcode(0),
 		m_rawbuf_str_len(0),
 		m_filtered_out(false),
-		m_event_info_table(g_infotables.m_event_info)
+		m_repeat_count(0),
+		m_event_info_table(g_infotables.m_event_info),
+		m_param_layouts(g_infotables.m_param_layouts)
 {
 	
 }
@@ -149,6 +159,15 @@ uint32_t sinsp_evt::get_iosize()
 	return m_iosize;
 }
 
+uint32_t sinsp_evt::get_snaplen_limit() const
+{
+	if(m_inspector == NULL)
+	{
+		return PPM_SNAPLEN_NO_LIMIT;
+	}
+	return m_inspector->get_snaplen_limit(m_cpuid, get_ts());
+}
+
 sinsp_threadinfo* sinsp_evt::get_thread_info(bool query_os_if_not_found)
 {
 	if(NULL != m_tinfo)
@@ -162,7 +181,26 @@ sinsp_threadinfo* sinsp_evt::get_thread_info(bool query_os_if_not_found)
 		return m_tinfo;
 	}
 
-	return m_inspector->get_thread_ref(m_pevt->tid, query_os_if_not_found, false).get();
+	return m_inspector->get_thread(m_pevt->tid, query_os_if_not_found, false);
+}
+
+std::shared_ptr<sinsp_threadinfo> sinsp_evt::get_thread_info_ref()
+{
+	if(!m_tinfo_ref)
+	{
+		sinsp_threadinfo* tinfo = get_thread_info();
+		if(tinfo != NULL)
+		{
+			m_tinfo_ref = m_inspector->get_thread_ref(tinfo->m_tid, false, true);
+			if(m_tinfo_ref.get() != tinfo)
+			{
+				// not in the table, e.g. a thread owned by the caller
+				m_tinfo_ref.reset();
+			}
+		}
+	}
+
+	return m_tinfo_ref;
 }
 
 int64_t sinsp_evt::get_fd_num()
@@ -186,7 +224,7 @@ uint32_t sinsp_evt::get_num_params()
 		m_flags |= (uint32_t)sinsp_evt::SINSP_EF_PARAMS_LOADED;
 	}
 
-	return (uint32_t)m_params.size();
+	return m_nparams;
 }
 
 sinsp_evt_param *sinsp_evt::get_param(uint32_t id)
@@ -197,7 +235,17 @@ sinsp_evt_param *sinsp_evt::get_param(uint32_t id)
 		m_flags |= (uint32_t)sinsp_evt::SINSP_EF_PARAMS_LOADED;
 	}
 
-	return &(m_params.at(id));
+	if(id >= m_nparams)
+	{
+		throw std::out_of_range("event parameter " + std::to_string(id) + " out of range");
+	}
+
+	if(id >= m_ndecoded_params)
+	{
+		decode_params(id);
+	}
+
+	return &m_params[id];
 }
 
 const char *sinsp_evt::get_param_name(uint32_t id)
@@ -870,7 +918,7 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 			ASSERT(payload_len == sizeof(int64_t));
 			ret = (Json::Value::UInt64)*(int64_t *)payload;
 
-			sinsp_threadinfo* atinfo = m_inspector->get_thread_ref(*(int64_t *)payload, false, true).get();
+			sinsp_threadinfo* atinfo = m_inspector->get_thread(*(int64_t *)payload, false, true);
 			if(atinfo != NULL)
 			{
 				std::string& tcomm = atinfo->m_comm;
@@ -1623,7 +1671,7 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 					 "%" PRId64, *(int64_t *)payload);
 
 
-			sinsp_threadinfo* atinfo = m_inspector->get_thread_ref(*(int64_t *)payload, false, true).get();
+			sinsp_threadinfo* atinfo = m_inspector->get_thread(*(int64_t *)payload, false, true);
 			if(atinfo != NULL)
 			{
 				std::string& tcomm = atinfo->m_comm;
@@ -2254,7 +2302,7 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 			// from the event.
 			// Eg: for setuid() the requested uid is not
 			// the threadinfo one yet;
-			// therefore we cannot directly use tinfo->m_user here.
+			// therefore we cannot directly use tinfo->get_user() here.
 			snprintf(&m_paramstr_storage[0],
 					 m_paramstr_storage.size(),
 					 "%d", val);
@@ -2296,7 +2344,7 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 			// from the event.
 			// Eg: for setgid() the requested gid is not
 			// the threadinfo one yet;
-			// therefore we cannot directly use tinfo->m_group here.
+			// therefore we cannot directly use tinfo->get_group() here.
 			snprintf(&m_paramstr_storage[0],
 					 m_paramstr_storage.size(),
 					 "%d", val);
@@ -2594,7 +2642,7 @@ const sinsp_evt_param* sinsp_evt::get_param_value_raw(const char* name)
 	{
 		if(strcmp(name, get_param_name(j)) == 0)
 		{
-			return &(m_params[j]);
+			return get_param(j);
 		}
 	}
 
@@ -2805,6 +2853,8 @@ bool sinsp_evt::clone_event(sinsp_evt &dest, const sinsp_evt &src)
 		dest.m_tinfo = nullptr;
 	}
 
+	// dest could be a reused event
+	delete[] dest.m_pevt_storage;
 	if (src.m_pevt != nullptr)
 	{
 		dest.m_pevt_storage = new char[src.m_pevt->len];
@@ -2827,14 +2877,36 @@ bool sinsp_evt::clone_event(sinsp_evt &dest, const sinsp_evt &src)
 	dest.m_errorcode = src.m_errorcode;
 	dest.m_rawbuf_str_len = src.m_rawbuf_str_len;
 	dest.m_filtered_out = src.m_filtered_out;
+	dest.m_repeat_count = src.m_repeat_count;
+	dest.m_source_idx = src.m_source_idx;
+	dest.m_source_name = src.m_source_name;
 
-	// vectors
-	dest.m_params = src.m_params;
+	// decoded params
+	dest.m_nparams = src.m_nparams;
+	dest.m_ndecoded_params = src.m_ndecoded_params;
+	dest.m_next_param_offset = src.m_next_param_offset;
+	std::copy(src.m_params, src.m_params + src.m_ndecoded_params, dest.m_params);
+
+	// loaded params pointing into the source event data must point into our copy
+	if(src.m_pevt != nullptr)
+	{
+		const char* src_begin = (const char*)src.m_pevt;
+		const char* src_end = src_begin + src.m_pevt->len;
+		for(uint32_t j = 0; j < dest.m_ndecoded_params; j++)
+		{
+			sinsp_evt_param& param = dest.m_params[j];
+			if(param.m_val >= src_begin && param.m_val < src_end)
+			{
+				param.m_val = dest.m_pevt_storage + (param.m_val - src_begin);
+			}
+		}
+	}
 	dest.m_paramstr_storage = src.m_paramstr_storage;
 	dest.m_resolved_paramstr_storage = src.m_resolved_paramstr_storage;
 
 	// global table
 	dest.m_event_info_table = src.m_event_info_table;
+	dest.m_param_layouts = src.m_param_layouts;
 	dest.m_info = src.m_info;
 
 	// fd info
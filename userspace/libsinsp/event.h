@@ -56,6 +56,7 @@ typedef enum filtercheck_field_flags
 	EPF_ARG_INDEX         = 1 << 8, ///< this field accepts numeric arguments.
 	EPF_ARG_KEY           = 1 << 9, ///< this field accepts string arguments.
 	EPF_DEPRECATED        = 1 << 10,///< this field is deprecated.
+	EPF_ASYNC             = 1 << 11,///< this field can be extracted ahead of time, off the capture thread.
 }filtercheck_field_flags;
 
 /*!
@@ -76,6 +77,18 @@ typedef struct filtercheck_field_info
  *  @{
  */
 
+/*!
+  \brief What decoding the parameters of an event type needs to know, derived
+  once from its \ref ppm_event_info entry: a few bytes to look at for every
+  event, instead of the descriptions of all the parameters.
+*/
+struct sinsp_evt_param_layout
+{
+	uint32_t m_nparams; ///< Number of parameters in the event table.
+	uint32_t m_lensize; ///< Size of the length of each parameter, 2 or 4 bytes.
+	uint32_t m_str_params; ///< Bitmask of the string parameters, rendered as "<NA>" when empty.
+};
+
 /*!
   \brief Wrapper that exports the libscap event tables.
 */
@@ -83,6 +96,7 @@ class SINSP_PUBLIC sinsp_evttables
 {
 public:
 	const struct ppm_event_info* m_event_info; ///< List of events supported by the capture and analysis subsystems. Each entry fully documents an event and its parameters.
+	const sinsp_evt_param_layout* m_param_layouts; ///< The layout of the parameters of each event in m_event_info.
 };
 
 /*!
@@ -94,6 +108,20 @@ class SINSP_PUBLIC sinsp_evt_param
 public:
 	char* m_val;	///< Pointer to the event parameter data.
 	uint32_t m_len; ///< Length of the parameter pointed by m_val.
+
+	/*!
+	  \brief Returns the value of a fixed-size parameter, which must be
+	  a T, e.g. an int64_t for a PT_FD or a PT_ERRNO.
+	*/
+	template<typename T>
+	inline T as() const
+	{
+		ASSERT(m_len == sizeof(T));
+		T ret;
+		memcpy(&ret, m_val, sizeof(T));
+		return ret;
+	}
+
 private:
 	inline void init(char* valptr, uint32_t len)
 	{
@@ -172,6 +200,14 @@ public:
 		m_inspector = value;
 	}
 
+	/*!
+	  \brief Get the inspector.
+	*/
+	inline sinsp* get_inspector() const
+	{
+		return m_inspector;
+	}
+
 	/*!
 	  \brief Get the incremental number of this event.
 	*/
@@ -188,6 +224,24 @@ public:
 		return m_cpuid;
 	}
 
+	/*!
+	  \brief Get the snaplen limit the driver applied to the I/O buffers of
+	  this event, because its buffer was filling up (see
+	  sinsp::set_adaptive_snaplen), or PPM_SNAPLEN_NO_LIMIT. A buffer
+	  longer than the limit was truncated to it.
+	*/
+	uint32_t get_snaplen_limit() const;
+
+	/*!
+	  \brief Get the number of events identical to this one, from the same
+	  thread, that were suppressed before it since the previous one was
+	  delivered (see sinsp::set_event_coalescing). 0 if none.
+	*/
+	inline uint32_t get_repeat_count() const
+	{
+		return m_repeat_count;
+	}
+
 	/*!
 	  \brief Get the event type.
 
@@ -282,6 +336,16 @@ public:
 	*/
 	sinsp_threadinfo* get_thread_info(bool query_os_if_not_found = false);
 
+	/*!
+	  \brief Return a reference to the thread that generated the event, which
+	   keeps it alive after the event is processed, even if the thread gets
+	   removed from the thread table in the meanwhile. The pointer returned
+	   by get_thread_info() is only valid until then.
+
+	  \return nullptr if the event has no thread.
+	*/
+	std::shared_ptr<sinsp_threadinfo> get_thread_info_ref();
+
 	/*!
 	  \brief Return the information about the FD on which this event operated.
 
@@ -477,20 +541,51 @@ private:
 	}
 	inline void load_params()
 	{
-		uint32_t j;
-		sinsp_evt_param par;
-		struct scap_sized_buffer params[PPM_MAX_EVENT_PARAMS];
+		/* Only the length table is looked at here, the params are
+		 * decoded on demand by decode_params().
+		 *
+		 * If we're reading a capture created with a newer version, it may
+		 * contain new parameters. If instead we're reading an older version,
+		 * the current event table entry may contain new parameters.
+		 * Use the minimum between the two values.
+		 */
+		const sinsp_evt_param_layout& layout = m_param_layouts[m_pevt->type];
 
-		m_params.clear();
+		m_nparams = layout.m_nparams < m_pevt->nparams ? layout.m_nparams : m_pevt->nparams;
+		m_ndecoded_params = 0;
+		m_next_param_offset = sizeof(struct ppm_evt_hdr) + layout.m_lensize * m_pevt->nparams;
+	}
 
-		uint32_t nparams = scap_event_decode_params(m_pevt, params);
+	/* Decodes the params up to id included. Their position is the sum of
+	 * the lengths of the preceding ones, so the ones before id are decoded
+	 * along the way and kept for the next calls.
+	 */
+	inline void decode_params(uint32_t id)
+	{
+		const sinsp_evt_param_layout& layout = m_param_layouts[m_pevt->type];
+		const char* len_buf = (const char*)m_pevt + sizeof(struct ppm_evt_hdr);
+		bool is_large = layout.m_lensize == sizeof(uint32_t);
 
-		/* We need the event info to overwrite some parameters if necessary. */
-		const struct ppm_event_info* event_info = &m_event_info_table[m_pevt->type];
-		int param_type = 0;
-		
-		for(j = 0; j < nparams; j++)
+		for(uint32_t j = m_ndecoded_params; j <= id; j++)
 		{
+			uint32_t len;
+			char* val = (char*)m_pevt + m_next_param_offset;
+
+			if(is_large)
+			{
+				uint32_t len32;
+				memcpy(&len32, len_buf + j * sizeof(uint32_t), sizeof(uint32_t));
+				len = len32;
+			}
+			else
+			{
+				uint16_t len16;
+				memcpy(&len16, len_buf + j * sizeof(uint16_t), sizeof(uint16_t));
+				len = len16;
+			}
+
+			m_next_param_offset += len;
+
 			/* Here we need to manage a particular case:
 			* 
 			*    - PT_CHARBUF
@@ -533,25 +628,22 @@ private:
 			* otherwise it will trigger a segmentation fault at run-time. So as a first
 			* step we would keep them as they are.
 			*/
-			param_type = event_info->params[j].type;
-			
-			if((param_type == PT_CHARBUF ||
-				param_type == PT_FSRELPATH ||
-				param_type == PT_FSPATH)
+			if((layout.m_str_params & (1U << j))
 				&&
-				(params[j].size == 0 ||
-				(params[j].size == 7 && strncmp((char*)params[j].buf, "(NULL)", 7) == 0)))
+				(len == 0 ||
+				(len == 7 && strncmp(val, "(NULL)", 7) == 0)))
 			{
 				/* Overwrite the value and the size of the param.
 				* 5 = strlen("<NA>") + `\0`.
 				*/
-				params[j].buf = (void*)"<NA>";
-				params[j].size = 5;
+				val = (char*)"<NA>";
+				len = 5;
 			}
 
-			par.init((char*)params[j].buf, (int)params[j].size);
-			m_params.push_back(par);
+			m_params[j].init(val, len);
 		}
+
+		m_ndecoded_params = id + 1;
 	}
 	std::string get_param_value_str(uint32_t id, bool resolved);
 	std::string get_param_value_str(const char* name, bool resolved = true);
@@ -577,7 +669,12 @@ VISIBILITY_PRIVATE
 	uint32_t m_flags;
 	bool m_params_loaded;
 	const struct ppm_event_info* m_info;
-	std::vector<sinsp_evt_param> m_params;
+	// Only the first m_ndecoded_params are valid, see decode_params()
+	sinsp_evt_param m_params[PPM_MAX_EVENT_PARAMS];
+	uint32_t m_nparams;
+	uint32_t m_ndecoded_params;
+	// Offset in m_pevt of the first param not decoded yet
+	uint32_t m_next_param_offset;
 
 	std::vector<char> m_paramstr_storage;
 	std::vector<char> m_resolved_paramstr_storage;
@@ -596,7 +693,9 @@ VISIBILITY_PRIVATE
 	int32_t m_errorcode;
 	int32_t m_rawbuf_str_len;
 	bool m_filtered_out;
+	uint32_t m_repeat_count;
 	const struct ppm_event_info* m_event_info_table;
+	const sinsp_evt_param_layout* m_param_layouts;
 
 	std::shared_ptr<sinsp_fdinfo_t> m_fdinfo_ref;
 
@@ -626,6 +725,8 @@ VISIBILITY_PRIVATE
 	friend class test_helpers::event_builder;
 	friend class test_helpers::sinsp_mock;
 	friend class sinsp_usergroup_manager;
+	friend class event_coalescer;
+	friend class async_event_pool;
 };
 
 /*@}*/
@@ -0,0 +1,128 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <cstdlib>
+
+#include "event_buffer_pool.h"
+
+//
+// Each buffer is preceded by a header holding its size class, which is
+// 8 bytes long to keep the event data aligned
+//
+#define EVENT_BUFFER_HEADER_SIZE 8
+
+static_assert((SP_EVT_BUF_SIZE & (SP_EVT_BUF_SIZE - 1)) == 0, "SP_EVT_BUF_SIZE must be a power of 2");
+static_assert(SP_EVT_BUF_SIZE >= EVENT_BUFFER_MIN_SIZE, "SP_EVT_BUF_SIZE must be at least EVENT_BUFFER_MIN_SIZE");
+
+static inline uint32_t class_capacity(uint32_t size_class)
+{
+	return EVENT_BUFFER_MIN_SIZE << size_class;
+}
+
+static inline uint32_t& buffer_size_class(uint8_t* buf)
+{
+	return *(uint32_t*)(buf - EVENT_BUFFER_HEADER_SIZE);
+}
+
+event_buffer_pool::event_buffer_pool():
+	m_free(get_size_class(SP_EVT_BUF_SIZE) + 1),
+	m_num_cached(0)
+{
+}
+
+event_buffer_pool::~event_buffer_pool()
+{
+	for(auto& list : m_free)
+	{
+		for(auto buf : list)
+		{
+			free_buffer(buf);
+		}
+	}
+}
+
+uint32_t event_buffer_pool::get_size_class(uint32_t len)
+{
+	uint32_t size_class = 0;
+	while(class_capacity(size_class) < len)
+	{
+		size_class++;
+	}
+	return size_class;
+}
+
+uint8_t* event_buffer_pool::reserve(uint8_t* buf, uint32_t len)
+{
+	if(len > SP_EVT_BUF_SIZE)
+	{
+		return NULL;
+	}
+
+	if(buf != NULL)
+	{
+		if(get_capacity(buf) >= len)
+		{
+			return buf;
+		}
+		release(buf, SIZE_MAX);
+	}
+
+	uint32_t size_class = get_size_class(len);
+	auto& list = m_free[size_class];
+	if(!list.empty())
+	{
+		buf = list.back();
+		list.pop_back();
+		m_num_cached--;
+		return buf;
+	}
+
+	uint8_t* base = (uint8_t*)malloc(EVENT_BUFFER_HEADER_SIZE + class_capacity(size_class));
+	if(base == NULL)
+	{
+		return NULL;
+	}
+
+	buf = base + EVENT_BUFFER_HEADER_SIZE;
+	buffer_size_class(buf) = size_class;
+	return buf;
+}
+
+void event_buffer_pool::release(uint8_t* buf, size_t max_cached)
+{
+	if(m_num_cached >= max_cached)
+	{
+		free_buffer(buf);
+		return;
+	}
+
+	m_free[buffer_size_class(buf)].push_back(buf);
+	m_num_cached++;
+}
+
+uint32_t event_buffer_pool::get_capacity(const uint8_t* buf)
+{
+	return class_capacity(buffer_size_class((uint8_t*)buf));
+}
+
+void event_buffer_pool::free_buffer(uint8_t* buf)
+{
+	if(buf != NULL)
+	{
+		free(buf - EVENT_BUFFER_HEADER_SIZE);
+	}
+}
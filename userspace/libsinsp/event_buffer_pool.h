@@ -0,0 +1,78 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "settings.h"
+
+// Buffers used by the parser to keep a copy of the enter events of the
+// threads until the matching exit events are parsed (see
+// sinsp_parser::store_event). Most enter events are a few tens of bytes,
+// so instead of reserving SP_EVT_BUF_SIZE bytes for each of them, the
+// buffers come in power of 2 size classes, from EVENT_BUFFER_MIN_SIZE to
+// SP_EVT_BUF_SIZE. The released buffers are kept in a free list per size
+// class, to be reused by the next events.
+//
+// A buffer remembers its size class, so that it can be freed by its owner
+// without going through the pool (e.g. by a thread info removed while an
+// enter event was stored).
+#define EVENT_BUFFER_MIN_SIZE 64
+
+class event_buffer_pool
+{
+public:
+	event_buffer_pool();
+	~event_buffer_pool();
+
+	//
+	// Return a buffer of at least len bytes, NULL if len is larger than
+	// SP_EVT_BUF_SIZE. If buf is not NULL, it's reused if large enough,
+	// and released otherwise.
+	//
+	uint8_t* reserve(uint8_t* buf, uint32_t len);
+
+	//
+	// Give a buffer back, keeping at most max_cached buffers in the
+	// free lists
+	//
+	void release(uint8_t* buf, size_t max_cached);
+
+	//
+	// Return the number of bytes a buffer can hold
+	//
+	static uint32_t get_capacity(const uint8_t* buf);
+
+	//
+	// Free a buffer without going through a pool
+	//
+	static void free_buffer(uint8_t* buf);
+
+	inline size_t get_num_cached() const
+	{
+		return m_num_cached;
+	}
+
+private:
+	static uint32_t get_size_class(uint32_t len);
+
+	std::vector<std::vector<uint8_t*>> m_free;
+	size_t m_num_cached;
+};
@@ -0,0 +1,191 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include <cstring>
+
+#include "event_coalescer.h"
+#include "sinsp.h"
+#include "events/sinsp_events.h"
+
+event_coalescer::event_coalescer():
+	m_window_ns(ONE_SECOND_IN_NS)
+{
+}
+
+event_coalescer::~event_coalescer() = default;
+
+void event_coalescer::set_window(uint64_t window_ns)
+{
+	m_window_ns = window_ns;
+
+	reset();
+}
+
+void event_coalescer::reset()
+{
+	m_threads.clear();
+	m_flushed.reset();
+	m_next_purge_ts = 0;
+}
+
+bool event_coalescer::coalescible(uint16_t type)
+{
+	if(type >= PPM_EVENT_MAX || !libsinsp::events::is_syscall_event((ppm_event_code)type))
+	{
+		return false;
+	}
+
+	uint32_t flags = libsinsp::events::info((ppm_event_code)type)->flags;
+	return !(flags & (EF_MODIFIES_STATE | EF_CREATES_FD | EF_DESTROYS_FD | EF_UNUSED));
+}
+
+event_coalescer::run* event_coalescer::oldest_pending(thread_runs& t)
+{
+	run* oldest = NULL;
+	for(run& r : t.m_runs)
+	{
+		if(r.m_repeats == 0 || r.m_last == nullptr)
+		{
+			continue;
+		}
+
+		if(oldest == NULL || r.m_last->get_ts() < oldest->m_last->get_ts())
+		{
+			oldest = &r;
+		}
+	}
+	return oldest;
+}
+
+void event_coalescer::purge(uint64_t ts)
+{
+	uint64_t idle_ns = m_window_ns * IDLE_WINDOWS;
+	for(auto it = m_threads.begin(); it != m_threads.end();)
+	{
+		if(it->second.m_last_ts + idle_ns < ts)
+		{
+			it = m_threads.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	m_next_purge_ts = ts + idle_ns;
+}
+
+event_coalescer::action event_coalescer::process(const scap_evt* pevt, uint32_t& repeats)
+{
+	repeats = 0;
+	if(!coalescible(pevt->type))
+	{
+		return DELIVER;
+	}
+
+	if(pevt->ts >= m_next_purge_ts)
+	{
+		purge(pevt->ts);
+	}
+
+	thread_runs& t = m_threads[pevt->tid];
+	t.m_last_ts = pevt->ts;
+	run& r = get_run(t, pevt->type);
+
+	const uint8_t* params = (const uint8_t*)pevt + sizeof(scap_evt);
+	size_t len = pevt->len - sizeof(scap_evt);
+	if(r.m_type != pevt->type || r.m_params.size() != len ||
+	   memcmp(r.m_params.data(), params, len) != 0)
+	{
+		//
+		// The run is over: the snapshots of the thread come first
+		//
+		if(oldest_pending(t) != NULL)
+		{
+			return FLUSH;
+		}
+
+		r.m_type = pevt->type;
+		r.m_params.assign(params, params + len);
+		r.m_window_start = pevt->ts;
+		return DELIVER;
+	}
+
+	if(pevt->ts - r.m_window_start < m_window_ns)
+	{
+		return SUPPRESS;
+	}
+
+	//
+	// The window expired, this event counts the suppressed ones
+	//
+	repeats = r.m_repeats;
+	r.m_repeats = 0;
+	r.m_last.reset();
+	r.m_window_start = pevt->ts;
+	return DELIVER;
+}
+
+bool event_coalescer::suppress(const sinsp_evt& evt)
+{
+	auto it = m_threads.find(evt.m_pevt->tid);
+	if(it == m_threads.end())
+	{
+		return false;
+	}
+
+	run& r = get_run(it->second, evt.get_type());
+	if(r.m_last == nullptr)
+	{
+		r.m_last.reset(new sinsp_evt());
+	}
+
+	if(!sinsp_evt::clone_event(*r.m_last, evt))
+	{
+		r.m_last.reset();
+		return false;
+	}
+
+	r.m_repeats++;
+	m_num_suppressed++;
+	return true;
+}
+
+sinsp_evt* event_coalescer::flush(const scap_evt* pevt, uint32_t& repeats)
+{
+	repeats = 0;
+	auto it = m_threads.find(pevt->tid);
+	if(it == m_threads.end())
+	{
+		return NULL;
+	}
+
+	run* r = oldest_pending(it->second);
+	if(r == NULL)
+	{
+		return NULL;
+	}
+
+	//
+	// The snapshot stands for itself and counts the ones before it. The
+	// next identical events are compared to it.
+	//
+	repeats = r->m_repeats - 1;
+	r->m_repeats = 0;
+	r->m_window_start = r->m_last->get_ts();
+	m_num_suppressed--;
+	m_flushed = std::move(r->m_last);
+	return m_flushed.get();
+}
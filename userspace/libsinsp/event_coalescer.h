@@ -0,0 +1,140 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "scap.h"
+
+class sinsp_evt;
+
+// Collapses the runs of identical events of a thread (see
+// sinsp::set_event_coalescing), e.g. a busy-polling loop of epoll_wait
+// calls or of non-blocking reads failing with EAGAIN. Two events are
+// identical when they have the same type and the same parameters; the enter
+// and the exit events of a thread are compared to the previous ones of the
+// same direction.
+//
+// The first event of a run is delivered, then the identical ones are
+// suppressed until the window expires, when the next one is delivered
+// with the number of events it stands for. When the run breaks, the last
+// suppressed events of the thread, kept as snapshots, are flushed before
+// the event that broke it, so that every suppressed event is counted by a
+// delivered one.
+//
+// Only the syscall events that don't change the state are coalesced, and
+// they are still parsed: the suppression only happens on delivery.
+class event_coalescer
+{
+public:
+	enum action
+	{
+		// Deliver the event
+		DELIVER = 0,
+		// Parse the event, then hand it to suppress()
+		SUPPRESS = 1,
+		// Deliver the snapshot returned by flush() first, then process
+		// the event again
+		FLUSH = 2,
+	};
+
+	// Threads without events for this many windows are forgotten
+	static const uint32_t IDLE_WINDOWS = 8;
+
+	event_coalescer();
+	~event_coalescer();
+
+	//
+	// Set the length of the windows, in event time, and forget all the
+	// runs
+	//
+	void set_window(uint64_t window_ns);
+
+	inline uint64_t get_window() const
+	{
+		return m_window_ns;
+	}
+
+	//
+	// Forget all the runs and their snapshots
+	//
+	void reset();
+
+	//
+	// Decide what to do with the next event. With DELIVER, repeats is the
+	// number of identical events suppressed before this one since the
+	// previous one was delivered.
+	//
+	action process(const scap_evt* pevt, uint32_t& repeats);
+
+	//
+	// Suppress a parsed event, after process() returned SUPPRESS.
+	// Returns false if it couldn't be snapshotted, in which case it must
+	// be delivered.
+	//
+	bool suppress(const sinsp_evt& evt);
+
+	//
+	// Return the oldest snapshot of the thread of pevt, after process()
+	// returned FLUSH, and the number of identical events suppressed
+	// before it. The snapshot stays valid until the next call.
+	//
+	sinsp_evt* flush(const scap_evt* pevt, uint32_t& repeats);
+
+	inline uint64_t get_num_suppressed() const
+	{
+		return m_num_suppressed;
+	}
+
+private:
+	struct run
+	{
+		uint16_t m_type = 0;
+		// The parameters of the last event
+		std::vector<uint8_t> m_params;
+		uint64_t m_window_start = 0;
+		// Events suppressed since the last delivered one
+		uint32_t m_repeats = 0;
+		// Snapshot of the last suppressed event
+		std::unique_ptr<sinsp_evt> m_last;
+	};
+
+	struct thread_runs
+	{
+		// Enter and exit events
+		run m_runs[2];
+		uint64_t m_last_ts = 0;
+	};
+
+	static bool coalescible(uint16_t type);
+	static inline run& get_run(thread_runs& t, uint16_t type)
+	{
+		return t.m_runs[PPME_IS_EXIT(type) ? 1 : 0];
+	}
+	static run* oldest_pending(thread_runs& t);
+	void purge(uint64_t ts);
+
+	uint64_t m_window_ns;
+	uint64_t m_next_purge_ts = 0;
+	uint64_t m_num_suppressed = 0;
+	std::unordered_map<int64_t, thread_runs> m_threads;
+	// The last flushed snapshot
+	std::unique_ptr<sinsp_evt> m_flushed;
+};
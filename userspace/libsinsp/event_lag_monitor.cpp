@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <cstring>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "event_lag_monitor.h"
+#include "strlcpy.h"
+
+//
+// Weight of a new sample in the moving average, as a shift:
+// each sample moves it by 1/8 of the difference
+//
+#define LAG_SMOOTHING_SHIFT 3
+
+event_lag_monitor::event_lag_monitor():
+	m_sampling_ratio(0),
+	m_num_events(0),
+	m_threshold_ns(0),
+	m_cb(nullptr)
+{
+	clear();
+}
+
+void event_lag_monitor::init(uint32_t sampling_ratio, uint64_t threshold_ns, backpressure_cb_t cb)
+{
+	m_sampling_ratio = sampling_ratio;
+	m_num_events = 0;
+	m_threshold_ns = threshold_ns;
+	m_cb = cb;
+}
+
+void event_lag_monitor::clear()
+{
+	m_last_lag_ns = 0;
+	m_smoothed_lag_ns = 0;
+	m_backpressure = false;
+	m_num_backpressure_events = 0;
+	memset(&m_histogram, 0, sizeof(m_histogram));
+}
+
+void event_lag_monitor::sample(uint64_t evt_ts, uint64_t now_ns)
+{
+	// the clocks of the event source and of the consumer can drift a bit
+	uint64_t lag = now_ns > evt_ts ? now_ns - evt_ts : 0;
+
+	if(m_histogram.m_count == 0)
+	{
+		m_smoothed_lag_ns = lag;
+	}
+	else if(lag > m_smoothed_lag_ns)
+	{
+		m_smoothed_lag_ns += (lag - m_smoothed_lag_ns) >> LAG_SMOOTHING_SHIFT;
+	}
+	else
+	{
+		m_smoothed_lag_ns -= (m_smoothed_lag_ns - lag) >> LAG_SMOOTHING_SHIFT;
+	}
+
+	m_last_lag_ns = lag;
+	m_histogram.m_count++;
+	m_histogram.m_sum_ns += lag;
+	if(lag > m_histogram.m_max_ns)
+	{
+		m_histogram.m_max_ns = lag;
+	}
+	m_histogram.m_buckets[latency_profiler::get_bucket(lag)]++;
+
+	if(m_threshold_ns == 0)
+	{
+		return;
+	}
+
+	if(!m_backpressure && m_smoothed_lag_ns > m_threshold_ns)
+	{
+		m_backpressure = true;
+		m_num_backpressure_events++;
+		if(m_cb)
+		{
+			m_cb(true, m_smoothed_lag_ns);
+		}
+	}
+	else if(m_backpressure && m_smoothed_lag_ns < m_threshold_ns / 2)
+	{
+		m_backpressure = false;
+		if(m_cb)
+		{
+			m_cb(false, m_smoothed_lag_ns);
+		}
+	}
+}
+
+static void add_stat(std::vector<scap_stats_v2>& stats, const char* name, uint64_t value)
+{
+	scap_stats_v2 stat;
+	strlcpy(stat.name, name, STATS_NAME_MAX);
+	stat.flags = PPM_SCAP_STATS_LATENCY;
+	stat.type = STATS_VALUE_TYPE_U64;
+	stat.value.u64 = value;
+	stats.push_back(stat);
+}
+
+const scap_stats_v2* event_lag_monitor::get_stats(uint32_t* nstats)
+{
+	m_stats.clear();
+	add_stat(m_stats, "lag.count", m_histogram.m_count);
+	add_stat(m_stats, "lag.last_ns", m_last_lag_ns);
+	add_stat(m_stats, "lag.smoothed_ns", m_smoothed_lag_ns);
+	add_stat(m_stats, "lag.max_ns", m_histogram.m_max_ns);
+	add_stat(m_stats, "lag.p50_ns", latency_profiler::get_percentile(m_histogram, 50));
+	add_stat(m_stats, "lag.p90_ns", latency_profiler::get_percentile(m_histogram, 90));
+	add_stat(m_stats, "lag.p99_ns", latency_profiler::get_percentile(m_histogram, 99));
+	add_stat(m_stats, "lag.backpressure", m_backpressure ? 1 : 0);
+	add_stat(m_stats, "lag.backpressure_events", m_num_backpressure_events);
+
+	*nstats = m_stats.size();
+	return m_stats.data();
+}
@@ -0,0 +1,122 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "latency_profiler.h"
+#include "utils.h"
+
+// Tracks how far behind the clock the consumer is, as the difference
+// between the time an event is processed at and its timestamp (see
+// sinsp::set_lag_monitoring). One event out of the sampling ratio is
+// measured, and the samples go to a log2-bucketed histogram with the same
+// layout as the latency_profiler ones.
+//
+// The samples are also smoothed with a moving average, which drives a
+// backpressure signal: it is raised when the smoothed lag goes over the
+// threshold, and cleared once it goes back under half of it, so that it
+// doesn't flap on a single slow event.
+class event_lag_monitor
+{
+public:
+	typedef std::function<void(bool backpressure, uint64_t lag_ns)> backpressure_cb_t;
+
+	event_lag_monitor();
+
+	//
+	// Measure one event out of sampling_ratio, 0 disables the monitor
+	// and keeps the samples collected so far. cb, if set, is called
+	// every time the backpressure signal is raised or cleared.
+	//
+	void init(uint32_t sampling_ratio, uint64_t threshold_ns, backpressure_cb_t cb);
+
+	inline bool is_enabled() const
+	{
+		return m_sampling_ratio != 0;
+	}
+
+	//
+	// Called for every event with its timestamp
+	//
+	inline void on_event(uint64_t evt_ts)
+	{
+		if(m_sampling_ratio == 0 || ++m_num_events < m_sampling_ratio)
+		{
+			return;
+		}
+
+		m_num_events = 0;
+		sample(evt_ts, sinsp_utils::get_current_time_ns());
+	}
+
+	//
+	// Add a sample, taken at now_ns
+	//
+	void sample(uint64_t evt_ts, uint64_t now_ns);
+
+	//
+	// Forget the samples and clear the backpressure signal, keeping
+	// the configuration
+	//
+	void clear();
+
+	inline uint64_t get_last_lag_ns() const
+	{
+		return m_last_lag_ns;
+	}
+
+	inline uint64_t get_smoothed_lag_ns() const
+	{
+		return m_smoothed_lag_ns;
+	}
+
+	inline bool get_backpressure() const
+	{
+		return m_backpressure;
+	}
+
+	inline const latency_profiler::histogram& get_histogram() const
+	{
+		return m_histogram;
+	}
+
+	//
+	// Return the lag as a buffer of scap_stats_v2 metrics, flagged as
+	// PPM_SCAP_STATS_LATENCY: `lag.count`, `.last_ns`, `.smoothed_ns`,
+	// `.max_ns`, `.p50_ns`, `.p90_ns`, `.p99_ns`, `.backpressure` (0 or 1)
+	// and `.backpressure_events`, the number of times it was raised.
+	// The buffer is owned by the monitor and valid until the next call.
+	//
+	const scap_stats_v2* get_stats(uint32_t* nstats);
+
+private:
+	uint32_t m_sampling_ratio;
+	uint32_t m_num_events;
+	uint64_t m_threshold_ns;
+	backpressure_cb_t m_cb;
+
+	uint64_t m_last_lag_ns;
+	uint64_t m_smoothed_lag_ns;
+	bool m_backpressure;
+	uint64_t m_num_backpressure_events;
+	latency_profiler::histogram m_histogram;
+	std::vector<scap_stats_v2> m_stats;
+};
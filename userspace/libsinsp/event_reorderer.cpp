@@ -0,0 +1,102 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <algorithm>
+
+#include "event_reorderer.h"
+
+event_reorderer::event_reorderer():
+	m_window_ns(0)
+{
+}
+
+event_reorderer::~event_reorderer() = default;
+
+void event_reorderer::set_window(uint64_t window_ns)
+{
+	m_window_ns = window_ns;
+
+	reset();
+}
+
+void event_reorderer::reset()
+{
+	m_heap.clear();
+	m_current.clear();
+	m_max_ts = 0;
+	m_last_ts = 0;
+}
+
+bool event_reorderer::push(const scap_evt* pevt, uint16_t cpuid)
+{
+	if(pevt->ts < m_last_ts)
+	{
+		m_num_late++;
+		return false;
+	}
+
+	if(pevt->ts < m_max_ts)
+	{
+		m_num_reordered++;
+	}
+	else
+	{
+		m_max_ts = pevt->ts;
+	}
+
+	entry e;
+	e.m_ts = pevt->ts;
+	e.m_seq = m_seq++;
+	e.m_cpuid = cpuid;
+	if(!m_free.empty())
+	{
+		e.m_data = std::move(m_free.back());
+		m_free.pop_back();
+	}
+	e.m_data.assign((const uint8_t*)pevt, (const uint8_t*)pevt + pevt->len);
+
+	m_heap.push_back(std::move(e));
+	std::push_heap(m_heap.begin(), m_heap.end(), later);
+	return true;
+}
+
+scap_evt* event_reorderer::pop(uint64_t watermark, bool flush, uint16_t& cpuid)
+{
+	if(m_heap.empty())
+	{
+		return NULL;
+	}
+
+	const entry& oldest = m_heap.front();
+	if(!flush && (watermark < m_window_ns || oldest.m_ts > watermark - m_window_ns))
+	{
+		return NULL;
+	}
+
+	std::pop_heap(m_heap.begin(), m_heap.end(), later);
+	entry& e = m_heap.back();
+	if(!m_current.empty())
+	{
+		m_free.push_back(std::move(m_current));
+	}
+	m_current = std::move(e.m_data);
+	m_last_ts = e.m_ts;
+	cpuid = e.m_cpuid;
+	m_heap.pop_back();
+
+	return (scap_evt*)m_current.data();
+}
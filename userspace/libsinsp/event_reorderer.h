@@ -0,0 +1,118 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "scap.h"
+
+// Restores the timestamp order of the events merged from sources that don't
+// guarantee it relative to each other (see sinsp::set_event_reordering),
+// like the plugin sources next to the syscalls of the capture.
+//
+// The events are copied in a min-heap and held until they are older than the
+// watermark minus the window: an event can arrive up to a window late and
+// still be delivered in order. An event older than one already delivered is
+// late: it is counted and dropped, so that the delivered events are always
+// ordered.
+class event_reorderer
+{
+public:
+	event_reorderer();
+	~event_reorderer();
+
+	//
+	// Set the maximum lateness of the events, and drop the buffered ones.
+	// 0 disables the reordering.
+	//
+	void set_window(uint64_t window_ns);
+
+	inline uint64_t get_window() const
+	{
+		return m_window_ns;
+	}
+
+	//
+	// Drop the buffered events and forget the delivered ones
+	//
+	void reset();
+
+	//
+	// Copy an event in the buffer. Returns false if it is late, in which
+	// case it is dropped.
+	//
+	bool push(const scap_evt* pevt, uint16_t cpuid);
+
+	//
+	// Remove and return the oldest buffered event if it's older than the
+	// watermark minus the window, or whatever its age with flush. Returns
+	// NULL if there's none. The event stays valid until the next call.
+	//
+	scap_evt* pop(uint64_t watermark, bool flush, uint16_t& cpuid);
+
+	inline size_t size() const
+	{
+		return m_heap.size();
+	}
+
+	// The newest timestamp pushed
+	inline uint64_t get_max_ts() const
+	{
+		return m_max_ts;
+	}
+
+	inline uint64_t get_num_late() const
+	{
+		return m_num_late;
+	}
+
+	// Events pushed after a newer one, and delivered in order anyway
+	inline uint64_t get_num_reordered() const
+	{
+		return m_num_reordered;
+	}
+
+private:
+	struct entry
+	{
+		uint64_t m_ts;
+		// Insertion order, so that the events with the same timestamp
+		// keep it
+		uint64_t m_seq;
+		uint16_t m_cpuid;
+		std::vector<uint8_t> m_data;
+	};
+
+	// Ordering of std::push_heap, which keeps the largest element first
+	static inline bool later(const entry& a, const entry& b)
+	{
+		return a.m_ts != b.m_ts ? a.m_ts > b.m_ts : a.m_seq > b.m_seq;
+	}
+
+	uint64_t m_window_ns;
+	std::vector<entry> m_heap;
+	// Buffers of the events already delivered, reused to copy new ones
+	std::vector<std::vector<uint8_t>> m_free;
+	// The event returned by the last pop()
+	std::vector<uint8_t> m_current;
+	uint64_t m_seq = 0;
+	uint64_t m_max_ts = 0;
+	uint64_t m_last_ts = 0;
+	uint64_t m_num_late = 0;
+	uint64_t m_num_reordered = 0;
+};
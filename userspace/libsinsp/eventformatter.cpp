@@ -15,12 +15,149 @@ limitations under the License.
 
 */
 
+#include <algorithm>
+#include <charconv>
+
 #include "sinsp.h"
 #include "sinsp_int.h"
 #include "filter.h"
 #include "filterchecks.h"
 #include "eventformatter.h"
 
+///////////////////////////////////////////////////////////////////////////////
+// JSON output helpers
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// These write the same text as Json::FastWriter, without building a
+// document or temporary strings
+//
+template<typename T>
+static inline void json_append_number(std::string& out, T val)
+{
+	char buf[32];
+	auto res = std::to_chars(buf, buf + sizeof(buf), val);
+	out.append(buf, res.ptr - buf);
+}
+
+static void json_append_string(std::string& out, const char* str, const char* end)
+{
+	static const char hex[] = "0123456789ABCDEF";
+
+	out += '"';
+	while(str != end)
+	{
+		//
+		// Copy the characters that don't need escaping in one go
+		//
+		const char* run = str;
+		while(str != end && *str != '"' && *str != '\\' && (*str <= 0 || *str > 0x1f))
+		{
+			str++;
+		}
+		out.append(run, str - run);
+
+		if(str == end)
+		{
+			break;
+		}
+
+		char c = *str++;
+		switch(c)
+		{
+		case '"':
+			out += "\\\"";
+			break;
+		case '\\':
+			out += "\\\\";
+			break;
+		case '\b':
+			out += "\\b";
+			break;
+		case '\f':
+			out += "\\f";
+			break;
+		case '\n':
+			out += "\\n";
+			break;
+		case '\r':
+			out += "\\r";
+			break;
+		case '\t':
+			out += "\\t";
+			break;
+		default:
+			out += "\\u00";
+			out += hex[(c >> 4) & 0xf];
+			out += hex[c & 0xf];
+			break;
+		}
+	}
+	out += '"';
+}
+
+static void json_append_value(std::string& out, const Json::Value& val)
+{
+	switch(val.type())
+	{
+	case Json::nullValue:
+		out += "null";
+		break;
+	case Json::intValue:
+		json_append_number(out, (int64_t)val.asLargestInt());
+		break;
+	case Json::uintValue:
+		json_append_number(out, (uint64_t)val.asLargestUInt());
+		break;
+	case Json::realValue:
+		out += Json::valueToString(val.asDouble());
+		break;
+	case Json::stringValue:
+	{
+		const char* str;
+		const char* end;
+		if(val.getString(&str, &end))
+		{
+			json_append_string(out, str, end);
+		}
+		break;
+	}
+	case Json::booleanValue:
+		out += val.asBool() ? "true" : "false";
+		break;
+	case Json::arrayValue:
+		out += '[';
+		for(Json::ArrayIndex j = 0; j < val.size(); j++)
+		{
+			if(j != 0)
+			{
+				out += ',';
+			}
+			json_append_value(out, val[j]);
+		}
+		out += ']';
+		break;
+	case Json::objectValue:
+	{
+		bool first = true;
+		out += '{';
+		for(const auto& name : val.getMemberNames())
+		{
+			if(!first)
+			{
+				out += ',';
+			}
+			first = false;
+			json_append_string(out, name.data(), name.data() + name.size());
+			out += ':';
+			json_append_value(out, val[name]);
+		}
+		out += '}';
+		break;
+	}
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // rawstring_check implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -178,6 +315,73 @@ void sinsp_evt_formatter::set_format(gen_event_formatter::output_format of, cons
 		m_chks_to_free.push_back(chk);
 		m_tokenlens.push_back(0);
 	}
+
+	m_text_parts.clear();
+	for(j = 0; j < m_tokens.size(); j++)
+	{
+		if(m_tokens[j].second->get_field_info() == NULL)
+		{
+			auto raw = static_cast<rawstring_check*>(m_tokens[j].second);
+			m_text_parts.push_back({raw->m_text, NULL, 0});
+		}
+		else
+		{
+			m_text_parts.push_back({"", m_tokens[j].second, m_tokenlens[j]});
+		}
+	}
+
+	//
+	// Assigning the same key twice kept the last value in the JSON
+	// document, so keep the last token of each name
+	//
+	m_json_tokens.clear();
+	for(j = 0; j < m_tokens.size(); j++)
+	{
+		if(m_tokens[j].second->get_field_info() != NULL)
+		{
+			m_json_tokens.push_back(j);
+		}
+	}
+
+	std::stable_sort(m_json_tokens.begin(), m_json_tokens.end(), [this](uint32_t a, uint32_t b) {
+		return m_tokens[a].first < m_tokens[b].first;
+	});
+
+	auto last = m_json_tokens.end();
+	if(!m_json_tokens.empty())
+	{
+		auto out = m_json_tokens.begin();
+		for(auto it = m_json_tokens.begin() + 1; it != m_json_tokens.end(); ++it)
+		{
+			if(m_tokens[*it].first == m_tokens[*out].first)
+			{
+				*out = *it;
+			}
+			else
+			{
+				*++out = *it;
+			}
+		}
+		last = out + 1;
+	}
+	m_json_tokens.erase(last, m_json_tokens.end());
+
+	// The fields are the only tokens with a value in resolve_tokens()
+	std::vector<uint32_t> value_idx(m_tokens.size(), 0);
+	uint32_t nvalues = 0;
+	for(j = 0; j < m_tokens.size(); j++)
+	{
+		if(m_tokens[j].second->get_field_info() != NULL)
+		{
+			value_idx[j] = nvalues++;
+		}
+	}
+
+	m_json_values.clear();
+	for(uint32_t token : m_json_tokens)
+	{
+		m_json_values.push_back(value_idx[token]);
+	}
 }
 
 bool sinsp_evt_formatter::on_capture_end(OUT std::string* res)
@@ -221,6 +425,46 @@ bool sinsp_evt_formatter::resolve_tokens(sinsp_evt *evt, std::map<std::string,st
 	return retval;
 }
 
+bool sinsp_evt_formatter::resolve_tokens(sinsp_evt *evt, std::vector<std::pair<std::string,std::string>>& values)
+{
+	size_t nvalues = 0;
+
+	ASSERT(m_text_parts.size() == m_tokens.size());
+
+	for(uint32_t j = 0; j < m_text_parts.size(); j++)
+	{
+		const auto& part = m_text_parts[j];
+		if(part.m_chk == NULL)
+		{
+			continue;
+		}
+
+		if(nvalues == values.size())
+		{
+			values.emplace_back();
+		}
+
+		auto& value = values[nvalues];
+		value.second.clear();
+		if(!part.m_chk->tostring(evt, value.second))
+		{
+			if(m_require_all_values)
+			{
+				values.resize(nvalues);
+				return false;
+			}
+
+			value.second = "<NA>";
+		}
+
+		value.first.assign(m_tokens[j].first);
+		nvalues++;
+	}
+
+	values.resize(nvalues);
+	return true;
+}
+
 bool sinsp_evt_formatter::get_field_values(gen_event *gevt, std::map<std::string, std::string> &fields)
 {
 	sinsp_evt *evt = static_cast<sinsp_evt *>(gevt);
@@ -248,84 +492,128 @@ gen_event_formatter::output_format sinsp_evt_formatter::get_output_format()
 
 bool sinsp_evt_formatter::tostring_withformat(gen_event* gevt, std::string &output, gen_event_formatter::output_format of)
 {
-	bool retval = true;
-	const filtercheck_field_info* fi;
-
 	sinsp_evt *evt = static_cast<sinsp_evt *>(gevt);
 
+	latency_profiler& profiler = m_inspector->get_latency_profiler();
+	uint64_t format_start_ns = profiler.start();
+	bool res = format(evt, output, of);
+	profiler.stop(latency_profiler::STAGE_FORMAT, evt->get_type(), format_start_ns);
+	return res;
+}
+
+bool sinsp_evt_formatter::format(sinsp_evt* evt, std::string &output, gen_event_formatter::output_format of)
+{
 	uint32_t j = 0;
 	output.clear();
 
 	ASSERT(m_tokenlens.size() == m_tokens.size());
 
-	for(j = 0; j < m_tokens.size(); j++)
+	if(of == OF_JSON)
 	{
-		if(of == OF_JSON)
+		output += '{';
+		for(j = 0; j < m_json_tokens.size(); j++)
 		{
-			Json::Value json_value = m_tokens[j].second->tojson(evt);
-
-			if(retval == false)
-			{
-				continue;
-			}
+			const auto& token = m_tokens[m_json_tokens[j]];
+			Json::Value json_value = token.second->tojson(evt);
 
 			if(json_value == Json::nullValue && m_require_all_values)
 			{
-				retval = false;
-				continue;
+				return false;
 			}
 
-			fi = m_tokens[j].second->get_field_info();
-
-			if(fi)
+			if(j != 0)
 			{
-				m_root[m_tokens[j].first] = m_tokens[j].second->tojson(evt);
+				output += ',';
 			}
+			json_append_string(output, token.first.data(), token.first.data() + token.first.size());
+			output += ':';
+			json_append_value(output, json_value);
 		}
-		else
+		output += '}';
+
+		return true;
+	}
+
+	for(const auto& part : m_text_parts)
+	{
+		if(part.m_chk == NULL)
 		{
-			char* str = m_tokens[j].second->tostring(evt);
+			output += part.m_text;
+			continue;
+		}
 
-			if(retval == false)
+		size_t start = output.size();
+		if(!part.m_chk->tostring(evt, output))
+		{
+			if(m_require_all_values)
 			{
-				continue;
+				return false;
 			}
 
-			if(str == NULL)
-			{
-				if(m_require_all_values)
-				{
-					retval = false;
-					continue;
-				}
-				else
-				{
-					str = (char*)"<NA>";
-				}
-			}
+			output += "<NA>";
+		}
+
+		if(part.m_width != 0)
+		{
+			output.resize(start + part.m_width, ' ');
+		}
+	}
+
+	return true;
+}
 
-			uint32_t tks = m_tokenlens[j];
+bool sinsp_evt_formatter::format_values(const std::vector<std::pair<std::string,std::string>>& values, std::string &output) const
+{
+	size_t nvalues = 0;
+	output.clear();
 
-			if(tks != 0)
+	if(m_output_format == OF_JSON)
+	{
+		output += '{';
+		for(uint32_t j = 0; j < m_json_tokens.size(); j++)
+		{
+			if(m_json_values[j] >= values.size())
 			{
-				std::string sstr(str);
-				sstr.resize(tks, ' ');
-				output += sstr;
+				return false;
 			}
-			else
+
+			const auto& name = m_tokens[m_json_tokens[j]].first;
+			const auto& value = values[m_json_values[j]].second;
+			if(j != 0)
 			{
-				output += str;
+				output += ',';
 			}
+			json_append_string(output, name.data(), name.data() + name.size());
+			output += ':';
+			json_append_string(output, value.data(), value.data() + value.size());
 		}
+		output += '}';
+
+		return true;
 	}
 
-	if(of == OF_JSON)
+	for(const auto& part : m_text_parts)
 	{
-		output = m_writer.write(m_root);
-		output = output.substr(0, output.size() - 1);
+		if(part.m_chk == NULL)
+		{
+			output += part.m_text;
+			continue;
+		}
+
+		if(nvalues == values.size())
+		{
+			return false;
+		}
+
+		size_t start = output.size();
+		output += values[nvalues++].second;
+		if(part.m_width != 0)
+		{
+			output.resize(start + part.m_width, ' ');
+		}
 	}
 
-	return retval;
+	return true;
 }
 
 bool sinsp_evt_formatter::tostring(gen_event* gevt, std::string &output)
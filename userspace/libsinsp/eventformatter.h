@@ -67,6 +67,14 @@ public:
 	*/
 	bool resolve_tokens(sinsp_evt *evt, std::map<std::string,std::string>& values);
 
+	/*!
+	  \brief Like resolve_tokens(), filling a vector of (field name, value)
+	  pairs in the order of the format. The strings already in the vector
+	  are reused, so that passing the same vector for every event doesn't
+	  allocate memory once it's grown.
+	*/
+	bool resolve_tokens(sinsp_evt *evt, std::vector<std::pair<std::string,std::string>>& values);
+
 	// For compatibility with gen_event_filter_factory
 	// interface. It just calls resolve_tokens().
 	bool get_field_values(gen_event *evt, std::map<std::string, std::string> &fields) override;
@@ -89,8 +97,25 @@ public:
 	// For compatibility with gen_event_formatter
 	bool tostring(gen_event* evt, std::string &output) override;
 
+	// The result is written directly in output, JSON included, so that
+	// reusing the same string for every event doesn't allocate memory once
+	// it's grown.
 	bool tostring_withformat(gen_event* evt, std::string &output, gen_event_formatter::output_format of) override;
 
+	/*!
+	  \brief Renders the values filled by the vector version of
+	  resolve_tokens() like tostring() renders the event they were
+	  extracted from. Only reads the compiled format, so it can run on
+	  another thread than the one extracting the values, while the
+	  formatter isn't reconfigured.
+
+	  \note In the JSON output every value is a string, the types of the
+	   fields are lost with the event.
+
+	  \return false if values doesn't have a value for every field.
+	*/
+	bool format_values(const std::vector<std::pair<std::string,std::string>>& values, std::string &output) const;
+
 	/*!
 	  \brief Fills res with end of capture string rendering of the event.
 	  \param res Pointer to the string that will be filled with the result.
@@ -101,6 +126,8 @@ public:
 	bool on_capture_end(OUT std::string* res);
 
 private:
+	bool format(sinsp_evt* evt, std::string &output, gen_event_formatter::output_format of);
+
 	gen_event_formatter::output_format m_output_format;
 
 	// vector of (full string of the token, filtercheck) pairs
@@ -112,8 +139,23 @@ private:
 	bool m_require_all_values;
 	std::vector<sinsp_filter_check*> m_chks_to_free;
 
-	Json::Value m_root;
-	Json::FastWriter m_writer;
+	// The format compiled for the text output, one part per token: the
+	// literal text between the fields, or a field with its width (0 if
+	// not fixed)
+	struct text_part
+	{
+		std::string m_text;
+		sinsp_filter_check* m_chk;
+		uint32_t m_width;
+	};
+	std::vector<text_part> m_text_parts;
+
+	// Indexes in m_tokens of the fields written in the JSON output, sorted
+	// by name and without duplicates like the keys of a Json::Value object
+	std::vector<uint32_t> m_json_tokens;
+	// The index of the value of each of m_json_tokens in the values filled
+	// by resolve_tokens(), see format_values()
+	std::vector<uint32_t> m_json_values;
 };
 
 /*!
@@ -0,0 +1,171 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "eventpipeline.h"
+
+sinsp_evt_pipeline::sinsp_evt_pipeline(sinsp* inspector,
+				       uint32_t num_workers,
+				       uint32_t batch_size,
+				       const worker_factory& factory,
+				       const match_callback& callback)
+	: m_inspector(inspector),
+	  m_batch_size(batch_size),
+	  m_callback(callback),
+	  m_batch(batch_size),
+	  m_batch_len(0),
+	  m_next_evt(0),
+	  m_batch_gen(0),
+	  m_busy_workers(0),
+	  m_stop(false)
+{
+	if(num_workers == 0 || batch_size == 0)
+	{
+		throw sinsp_exception("the event pipeline needs at least one worker and a non-empty batch");
+	}
+
+	for(uint32_t j = 0; j < num_workers; j++)
+	{
+		m_workers.push_back(factory(j));
+	}
+
+	for(uint32_t j = 0; j < num_workers; j++)
+	{
+		m_threads.emplace_back(&sinsp_evt_pipeline::worker_loop, this, j);
+	}
+}
+
+sinsp_evt_pipeline::~sinsp_evt_pipeline()
+{
+	stop();
+}
+
+void sinsp_evt_pipeline::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_stop = true;
+	}
+	m_batch_ready.notify_all();
+
+	for(auto& t : m_threads)
+	{
+		if(t.joinable())
+		{
+			t.join();
+		}
+	}
+	m_threads.clear();
+}
+
+int32_t sinsp_evt_pipeline::next_batch()
+{
+	//
+	// Parse the events serially, the workers are idle so nobody
+	// reads the state in the meanwhile.
+	//
+	int32_t res = m_inspector->next_batch(m_batch.data(), m_batch_size, &m_batch_len);
+	if(m_batch_len == 0)
+	{
+		return res;
+	}
+
+	//
+	// Hand the batch to the workers and wait for them
+	//
+	std::unique_lock<std::mutex> lock(m_mtx);
+	m_next_evt = 0;
+	m_busy_workers = (uint32_t)m_threads.size();
+	m_batch_gen++;
+	m_batch_ready.notify_all();
+	m_batch_done.wait(lock, [this] { return m_busy_workers == 0; });
+
+	if(m_worker_exception)
+	{
+		std::exception_ptr e = m_worker_exception;
+		m_worker_exception = nullptr;
+		std::rethrow_exception(e);
+	}
+
+	return res;
+}
+
+void sinsp_evt_pipeline::process(uint32_t worker_idx, sinsp_evt* evt, std::string& output)
+{
+	worker& w = m_workers[worker_idx];
+
+	if(w.m_filter != nullptr && !w.m_filter->run(evt))
+	{
+		return;
+	}
+
+	output.clear();
+	if(w.m_formatter != nullptr)
+	{
+		w.m_formatter->tostring(evt, &output);
+	}
+	m_callback(worker_idx, evt, output);
+}
+
+void sinsp_evt_pipeline::worker_loop(uint32_t worker_idx)
+{
+	uint64_t gen = 0;
+	std::string output;
+
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mtx);
+			m_batch_ready.wait(lock, [this, gen] { return m_stop || m_batch_gen != gen; });
+			if(m_stop)
+			{
+				return;
+			}
+			gen = m_batch_gen;
+		}
+
+		//
+		// The workers share the batch: everyone takes the next
+		// event until there are no more.
+		//
+		try
+		{
+			size_t i;
+			while((i = m_next_evt.fetch_add(1)) < m_batch_len)
+			{
+				process(worker_idx, m_batch[i], output);
+			}
+		}
+		catch(...)
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			if(!m_worker_exception)
+			{
+				m_worker_exception = std::current_exception();
+			}
+			// Let the other workers stop early.
+			m_next_evt = m_batch_len;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if(--m_busy_workers == 0)
+		{
+			m_batch_done.notify_one();
+		}
+	}
+}
@@ -0,0 +1,130 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "filter.h"
+#include "eventformatter.h"
+
+class sinsp;
+class sinsp_evt;
+
+/** @defgroup event Event manipulation
+ *  @{
+ */
+
+/*!
+  \brief Opt-in pipelined event processing.
+
+  Events are pulled from the inspector and parsed on the calling thread, exactly
+  like `sinsp::next()` does, then filter evaluation and formatting are fanned out
+  to a pool of worker threads.
+
+  Workers receive the events of a batch (see `sinsp::next_batch`), each one
+  parsed in storage of its own: the event data, a copy of its fd info and a
+  reference that keeps its thread info alive. The inspector state is not
+  modified while the workers evaluate a batch, so the fields that are not
+  copied (e.g. the thread info itself or its parents) reflect the state at the
+  end of the batch and not at the time of the event. Use a small `batch_size`
+  if this matters.
+
+  Filter checks keep per-extraction state, so every worker owns its own filter and
+  formatter, built by the `worker_factory`.
+*/
+class SINSP_PUBLIC sinsp_evt_pipeline
+{
+public:
+	struct worker
+	{
+		std::unique_ptr<sinsp_filter> m_filter; ///< Events not matching it are discarded. Can be null to accept every event.
+		std::unique_ptr<sinsp_evt_formatter> m_formatter; ///< Used to format matching events. Can be null if no output is needed.
+	};
+
+	/*!
+	  \brief Builds the filter and the formatter of the worker `worker_idx`.
+	*/
+	typedef std::function<worker(uint32_t worker_idx)> worker_factory;
+
+	/*!
+	  \brief Called by the worker `worker_idx` for every matching event, with the
+	   formatted output (empty if the worker has no formatter). Calls from different
+	   workers are concurrent and not ordered, use `sinsp_evt::get_num()` to restore
+	   the order if needed.
+	*/
+	typedef std::function<void(uint32_t worker_idx, sinsp_evt* evt, const std::string& output)> match_callback;
+
+	/*!
+	  \brief Constructs the pipeline and starts its workers.
+
+	  \param inspector An opened inspector. The pipeline calls its `next_batch()`.
+	  \param num_workers Number of worker threads.
+	  \param batch_size Maximum number of events parsed before the workers are given them.
+	*/
+	sinsp_evt_pipeline(sinsp* inspector,
+			   uint32_t num_workers,
+			   uint32_t batch_size,
+			   const worker_factory& factory,
+			   const match_callback& callback);
+
+	~sinsp_evt_pipeline();
+
+	/*!
+	  \brief Parses up to `batch_size` events on the calling thread with
+	   `sinsp::next_batch()`, then waits for the workers to evaluate them.
+
+	  \return the result of `sinsp::next_batch()`. Exceptions thrown by
+	   the inspector, the workers or the callback are rethrown here.
+	*/
+	int32_t next_batch();
+
+private:
+	void worker_loop(uint32_t worker_idx);
+	void process(uint32_t worker_idx, sinsp_evt* evt, std::string& output);
+	void stop();
+
+	sinsp* m_inspector;
+	uint32_t m_batch_size;
+	match_callback m_callback;
+	std::vector<worker> m_workers;
+	std::vector<std::thread> m_threads;
+
+	// The current batch, shared by all the workers.
+	std::vector<sinsp_evt*> m_batch;
+	uint32_t m_batch_len;
+	std::atomic<size_t> m_next_evt;
+
+	// Barrier between the parsing thread and the workers.
+	std::mutex m_mtx;
+	std::condition_variable m_batch_ready;
+	std::condition_variable m_batch_done;
+	uint64_t m_batch_gen;
+	uint32_t m_busy_workers;
+	bool m_stop;
+	std::exception_ptr m_worker_exception;
+};
+
+/*@}*/
@@ -147,21 +147,48 @@ libsinsp::events::set<ppm_event_code> libsinsp::events::all_event_set()
 	return ppm_event_set;
 }
 
-libsinsp::events::set<ppm_sc_code> libsinsp::events::event_set_to_sc_set(const set<ppm_event_code>& events_of_interest)
+/* The ppm_sc codes of every event, computed once: converting a set is then
+ * a union of these sets, a few words at a time. */
+static const std::vector<libsinsp::events::set<ppm_sc_code>>& event_to_sc_table()
 {
-	libsinsp::events::set<ppm_sc_code> ppm_sc_set;
-	std::vector<uint8_t> sc_vec(PPM_SC_MAX);
-	if(scap_get_ppm_sc_from_events(events_of_interest.data(), sc_vec.data()) != SCAP_SUCCESS)
+	static const auto table = []()
 	{
-		throw sinsp_exception("`ppm_sc_set` or `events_array` is an unexpected NULL vector!");
-	}
-	for (int i = 0; i < PPM_SC_MAX; i++)
-	{
-		if (sc_vec[i])
+		std::vector<libsinsp::events::set<ppm_sc_code>> ret;
+		std::vector<uint8_t> event_vec(PPM_EVENT_MAX, 0);
+		std::vector<uint8_t> sc_vec(PPM_SC_MAX);
+		for (int ev = 0; ev < PPM_EVENT_MAX; ev++)
 		{
-			ppm_sc_set.insert((ppm_sc_code)i);
+			event_vec[ev] = 1;
+			if(scap_get_ppm_sc_from_events(event_vec.data(), sc_vec.data()) != SCAP_SUCCESS)
+			{
+				throw sinsp_exception("`ppm_sc_set` or `events_array` is an unexpected NULL vector!");
+			}
+			event_vec[ev] = 0;
+
+			libsinsp::events::set<ppm_sc_code> ppm_sc_set;
+			for (int i = 0; i < PPM_SC_MAX; i++)
+			{
+				if (sc_vec[i])
+				{
+					ppm_sc_set.insert((ppm_sc_code)i);
+				}
+			}
+			ret.push_back(std::move(ppm_sc_set));
 		}
-	}
+		return ret;
+	}();
+	return table;
+}
+
+libsinsp::events::set<ppm_sc_code> libsinsp::events::event_set_to_sc_set(const set<ppm_event_code>& events_of_interest)
+{
+	const auto& table = event_to_sc_table();
+	libsinsp::events::set<ppm_sc_code> ppm_sc_set;
+	events_of_interest.for_each([&](ppm_event_code ev)
+	{
+		ppm_sc_set.insert(table[ev]);
+		return true;
+	});
 	return ppm_sc_set;
 }
 
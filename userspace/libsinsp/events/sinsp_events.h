@@ -22,6 +22,9 @@ limitations under the License.
 #include <unordered_set>
 #include <string>
 
+class sinsp_filter;
+class sinsp_evt_formatter;
+
 namespace libsinsp {
 namespace events {
 
@@ -230,6 +233,59 @@ set<ppm_event_code> sc_set_to_event_set(const set<ppm_sc_code> &ppm_sc_of_intere
 */
 set<ppm_sc_code> sinsp_repair_state_sc_set(const set<ppm_sc_code>& ppm_sc_set);
 
+/*!
+  \brief The parts of the `libsinsp` state a consumer relies on, on top of
+  the process tree which is always tracked. Each feature needs its own
+  `ppm_sc` codes to be kept up to date, see `sinsp_state_sc_set(uint32_t)`.
+*/
+enum state_feature : uint32_t
+{
+	STATE_FDS = (1 << 0), ///< fd tables (fd.* fields, fd names in evt.args)
+	STATE_NET = (1 << 1), ///< socket tuples and roles, implies STATE_FDS
+	STATE_USERS = (1 << 2), ///< uid and gid of the threads (user.*, group.*)
+	STATE_CAPS = (1 << 3), ///< capabilities of the threads (thread.cap_*)
+	STATE_CONTAINERS = (1 << 4), ///< container, k8s and mesos metadata
+	STATE_ALL = STATE_FDS | STATE_NET | STATE_USERS | STATE_CAPS | STATE_CONTAINERS,
+};
+
+/*!
+  \brief Provide the `ppm_sc` codes needed to keep up to date the process tree
+  and the state features given as a mask of `state_feature` flags.
+  The result is a subset of `sinsp_state_sc_set()`, with the exception of the
+  namespace syscalls of STATE_CAPS which reset the capabilities.
+
+  \note The container metadata is looked up from the cgroups found by the
+  process syscalls, so STATE_CONTAINERS needs no further `ppm_sc` for now.
+*/
+set<ppm_sc_code> sinsp_state_sc_set(uint32_t features);
+
+/*!
+  \brief Return the mask of `state_feature` flags needed to extract the
+  given filter or formatter fields, with or without their arguments.
+*/
+uint32_t field_names_to_state_features(const std::unordered_set<std::string>& fields);
+
+/*!
+  * \brief Derive the smallest set of `ppm_sc` needed to evaluate a set of
+  * compiled filters and formatters, to open the drivers with the smallest
+  * syscall footprint.
+  *
+  * The result is the union of the `ppm_sc` matched by the filters (see
+  * `sinsp_filter::get_sc_codes`) and of `sinsp_state_sc_set(uint32_t)` for
+  * the state features needed by the fields of the filters and formatters,
+  * plus the ones passed explicitly. A filter built by hand, or with no
+  * condition on the event type, matches every `ppm_sc`.
+  *
+  * @param filters the filters compiled by `sinsp_filter_compiler`
+  * @param formatters the formatters of the outputs of the filters
+  * @param features further `state_feature` flags the consumer relies on
+  * @return minimal set of `ppm_sc` to be enabled in the drivers
+*/
+set<ppm_sc_code> minimal_sc_set(
+	const std::vector<const sinsp_filter*>& filters,
+	const std::vector<sinsp_evt_formatter*>& formatters,
+	uint32_t features = 0);
+
 
 /*=============================== PPM_SC set related (sinsp_events_ppm_sc.cpp) ===============================*/
 
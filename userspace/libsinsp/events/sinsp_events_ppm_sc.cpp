@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "sinsp_events.h"
 #include "../utils.h"
+#include "../filter.h"
+#include "../eventformatter.h"
 
 /*
  * Repair base syscalls flags.
@@ -277,21 +279,48 @@ libsinsp::events::set<ppm_sc_code> libsinsp::events::sc_names_to_sc_set(const st
 	return ppm_sc_set;
 }
 
-libsinsp::events::set<ppm_event_code> libsinsp::events::sc_set_to_event_set(const libsinsp::events::set<ppm_sc_code> &ppm_sc_set)
+/* The events of every ppm_sc code, computed once: converting a set is then
+ * a union of these sets, a few words at a time. */
+static const std::vector<libsinsp::events::set<ppm_event_code>>& sc_to_event_table()
 {
-	libsinsp::events::set<ppm_event_code> events_set;
-	std::vector<uint8_t> event_vec(PPM_EVENT_MAX);
-	if(scap_get_events_from_ppm_sc(ppm_sc_set.data(), event_vec.data()) != SCAP_SUCCESS)
-	{
-		throw sinsp_exception("`ppm_sc_array` or `events_set` is an unexpected NULL vector!");
-	}
-	for (int i = 0; i < PPM_EVENT_MAX; i++)
+	static const auto table = []()
 	{
-		if (event_vec[i])
+		std::vector<libsinsp::events::set<ppm_event_code>> ret;
+		std::vector<uint8_t> sc_vec(PPM_SC_MAX, 0);
+		std::vector<uint8_t> event_vec(PPM_EVENT_MAX);
+		for (int sc = 0; sc < PPM_SC_MAX; sc++)
 		{
-			events_set.insert((ppm_event_code)i);
+			sc_vec[sc] = 1;
+			if(scap_get_events_from_ppm_sc(sc_vec.data(), event_vec.data()) != SCAP_SUCCESS)
+			{
+				throw sinsp_exception("`ppm_sc_array` or `events_set` is an unexpected NULL vector!");
+			}
+			sc_vec[sc] = 0;
+
+			libsinsp::events::set<ppm_event_code> events_set;
+			for (int i = 0; i < PPM_EVENT_MAX; i++)
+			{
+				if (event_vec[i])
+				{
+					events_set.insert((ppm_event_code)i);
+				}
+			}
+			ret.push_back(std::move(events_set));
 		}
-	}
+		return ret;
+	}();
+	return table;
+}
+
+libsinsp::events::set<ppm_event_code> libsinsp::events::sc_set_to_event_set(const libsinsp::events::set<ppm_sc_code> &ppm_sc_set)
+{
+	const auto& table = sc_to_event_table();
+	libsinsp::events::set<ppm_event_code> events_set;
+	ppm_sc_set.for_each([&](ppm_sc_code sc)
+	{
+		events_set.insert(table[sc]);
+		return true;
+	});
 	return events_set;
 }
 
@@ -415,3 +444,160 @@ libsinsp::events::set<ppm_sc_code> libsinsp::events::sinsp_repair_state_sc_set(c
 	/* Merge input sc set with sinsp_state_sc_set and return a complete "repaired" set. */
 	return repaired_sinsp_state_sc_set.merge(ppm_sc_set);
 }
+
+libsinsp::events::set<ppm_sc_code> libsinsp::events::sinsp_state_sc_set(uint32_t features)
+{
+	/* The process tree is always tracked, these build up or modify the tinfo
+	 * of the threads. */
+	libsinsp::events::set<ppm_sc_code> ppm_sc_set = {
+		PPM_SC_CLONE,
+		PPM_SC_CLONE3,
+		PPM_SC_FORK,
+		PPM_SC_VFORK,
+		PPM_SC_EXECVE,
+		PPM_SC_EXECVEAT,
+		PPM_SC_FCHDIR,
+		PPM_SC_CHDIR,
+		PPM_SC_CHROOT,
+		PPM_SC_SETPGID,
+		PPM_SC_SETSID,
+		PPM_SC_PRCTL,
+		PPM_SC_SCHED_PROCESS_EXIT,
+	};
+
+	if((features & STATE_NET))
+	{
+		features |= STATE_FDS;
+	}
+
+	if((features & STATE_FDS))
+	{
+		/* Every syscall adding or removing an fd of the fd tables. */
+		static libsinsp::events::set<ppm_sc_code> fd_sc_set;
+		if(fd_sc_set.empty())
+		{
+			auto fd_events = libsinsp::events::all_event_set().filter([](ppm_event_code e)
+				{
+					uint32_t flags = libsinsp::events::info(e)->flags;
+					return (flags & EF_MODIFIES_STATE) && (flags & (EF_CREATES_FD | EF_DESTROYS_FD));
+				});
+			fd_sc_set = libsinsp::events::event_set_to_sc_set(fd_events).intersect(sinsp_state_sc_set());
+			fd_sc_set.insert(PPM_SC_FCNTL);
+			fd_sc_set.insert(PPM_SC_FCNTL64);
+		}
+		ppm_sc_set.insert(fd_sc_set);
+	}
+
+	if((features & STATE_NET))
+	{
+		/* The syscalls filling the tuple and the role of the sockets. */
+		static auto net_state_sc_set = libsinsp::events::net_sc_set().intersect(sinsp_state_sc_set());
+		ppm_sc_set.insert(net_state_sc_set);
+	}
+
+	if((features & STATE_USERS))
+	{
+		ppm_sc_set.insert(PPM_SC_SETUID);
+		ppm_sc_set.insert(PPM_SC_SETUID32);
+		ppm_sc_set.insert(PPM_SC_SETGID);
+		ppm_sc_set.insert(PPM_SC_SETGID32);
+		ppm_sc_set.insert(PPM_SC_SETRESUID);
+		ppm_sc_set.insert(PPM_SC_SETRESUID32);
+		ppm_sc_set.insert(PPM_SC_SETRESGID);
+		ppm_sc_set.insert(PPM_SC_SETRESGID32);
+	}
+
+	if((features & STATE_CAPS))
+	{
+		/* Entering a new user namespace grants all the capabilities. */
+		ppm_sc_set.insert(PPM_SC_CAPSET);
+		ppm_sc_set.insert(PPM_SC_SETNS);
+		ppm_sc_set.insert(PPM_SC_UNSHARE);
+	}
+
+	return ppm_sc_set;
+}
+
+uint32_t libsinsp::events::field_names_to_state_features(const std::unordered_set<std::string>& fields)
+{
+	/* Fields resolved from the socket tuples, matched along with all their
+	 * sub-fields (e.g. "fd.cip" matches "fd.cip.name"). */
+	static const std::vector<std::string> net_fields = {
+		"fd.ip", "fd.cip", "fd.sip", "fd.lip", "fd.rip",
+		"fd.port", "fd.cport", "fd.sport", "fd.lport", "fd.rport",
+		"fd.l4proto", "fd.sockfamily", "fd.is_server",
+		"fd.proto", "fd.cproto", "fd.sproto", "fd.lproto", "fd.rproto",
+		"fd.net", "fd.cnet", "fd.snet", "fd.lnet", "fd.rnet",
+		"fd.connected", "fdlist.",
+	};
+
+	auto starts_with = [](const std::string& field, const std::string& prefix)
+	{
+		if(field.compare(0, prefix.size(), prefix) != 0)
+		{
+			return false;
+		}
+		/* A prefix that is a field name must match the whole name. */
+		return prefix.back() == '.' || field.size() == prefix.size()
+			|| field[prefix.size()] == '.' || field[prefix.size()] == '[';
+	};
+
+	uint32_t features = 0;
+	for(const auto& field : fields)
+	{
+		if(starts_with(field, "fd.") || starts_with(field, "evt.arg")
+			|| starts_with(field, "evt.args") || starts_with(field, "evt.info"))
+		{
+			/* evt.arg(s) and evt.info resolve the fd arguments to their names */
+			features |= STATE_FDS;
+		}
+		for(const auto& net_field : net_fields)
+		{
+			if(starts_with(field, net_field))
+			{
+				features |= STATE_NET;
+				break;
+			}
+		}
+		if(starts_with(field, "user.") || starts_with(field, "group."))
+		{
+			features |= STATE_USERS;
+		}
+		if(starts_with(field, "thread.cap_permitted") || starts_with(field, "thread.cap_inheritable")
+			|| starts_with(field, "thread.cap_effective"))
+		{
+			features |= STATE_CAPS;
+		}
+		if(starts_with(field, "container.") || starts_with(field, "k8s.") || starts_with(field, "mesos."))
+		{
+			features |= STATE_CONTAINERS;
+		}
+	}
+	return features;
+}
+
+libsinsp::events::set<ppm_sc_code> libsinsp::events::minimal_sc_set(
+	const std::vector<const sinsp_filter*>& filters,
+	const std::vector<sinsp_evt_formatter*>& formatters,
+	uint32_t features)
+{
+	libsinsp::events::set<ppm_sc_code> ppm_sc_set;
+	std::unordered_set<std::string> fields;
+
+	for(const auto& f : filters)
+	{
+		ppm_sc_set.insert(f->get_sc_codes());
+		fields.insert(f->get_fields().begin(), f->get_fields().end());
+	}
+
+	std::vector<std::string> formatter_fields;
+	for(const auto& f : formatters)
+	{
+		f->get_field_names(formatter_fields);
+	}
+	fields.insert(formatter_fields.begin(), formatter_fields.end());
+
+	features |= field_names_to_state_features(fields);
+	ppm_sc_set.insert(sinsp_state_sc_set(features));
+	return ppm_sc_set;
+}
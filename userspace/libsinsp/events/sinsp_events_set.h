@@ -22,6 +22,7 @@ limitations under the License.
 #include "sinsp_public.h"
 
 #include <vector>
+#include <string>
 #include <functional>
 #include <initializer_list>
 #include <iterator>
@@ -49,14 +50,21 @@ struct hash<ppm_event_code> {
 namespace libsinsp {
 namespace events {
 
+//
+// Set of event or syscall codes, stored as a bitmap so that merging,
+// intersecting and diffing sets works one 64-bit word at a time
+//
 template<typename T>
 class set
 {
 private:
-	using vec_t = std::vector<uint8_t>;
-	vec_t m_types{};
+	using word_t = uint64_t;
+	static constexpr size_t word_bits = 64;
+	std::vector<word_t> m_words{};
 	T m_max;
 	size_t m_size;
+	// one byte per code, built by data() for the scap APIs
+	mutable std::vector<uint8_t> m_bytes{};
 
 	inline void check_range(T e) const
 	{
@@ -66,6 +74,51 @@ private:
 		}
 	}
 
+	inline void check_same_max(const set& other, const char* op) const
+	{
+		if (other.m_max != m_max)
+		{
+			throw sinsp_exception(std::string("cannot ") + op + " sets with different max size.");
+		}
+	}
+
+	static inline size_t count_bits(word_t w)
+	{
+#if defined(__GNUC__)
+		return __builtin_popcountll(w);
+#else
+		size_t n = 0;
+		for(; w != 0; w &= w - 1)
+		{
+			n++;
+		}
+		return n;
+#endif
+	}
+
+	static inline size_t lowest_bit(word_t w)
+	{
+#if defined(__GNUC__)
+		return __builtin_ctzll(w);
+#else
+		size_t n = 0;
+		for(; (w & 1) == 0; w >>= 1)
+		{
+			n++;
+		}
+		return n;
+#endif
+	}
+
+	inline void update_size()
+	{
+		m_size = 0;
+		for(auto w : m_words)
+		{
+			m_size += count_bits(w);
+		}
+	}
+
 public:
 	struct iterator 
 	{
@@ -75,8 +128,8 @@ public:
 		using pointer           = T*;
 		using reference         = T&;
 
-		iterator(const uint8_t* data, size_t index, size_t max)
-			: m_data(data), m_index(index), m_max(max)
+		iterator(const word_t* words, size_t index, size_t max)
+			: m_words(words), m_index(index), m_max(max)
 		{
 			set_val();
 		}
@@ -86,20 +139,30 @@ public:
 		iterator operator++(int) { iterator i = *this; ++(*this); return i; }
 		friend bool operator== (const iterator& a, const iterator& b)
 		{
-			return a.m_data == b.m_data && a.m_index == b.m_index;
+			return a.m_words == b.m_words && a.m_index == b.m_index;
 		};
 		friend bool operator!= (const iterator& a, const iterator& b) { return !(a == b); };
 	private:
 		inline void set_val()
 		{
-			while (m_index < m_max && m_data[m_index] == 0)
+			while (m_index < m_max)
 			{
-				m_index++;
+				word_t w = m_words[m_index / word_bits] >> (m_index % word_bits);
+				if (w != 0)
+				{
+					m_index += lowest_bit(w);
+					break;
+				}
+				m_index = (m_index / word_bits + 1) * word_bits;
+			}
+			if (m_index > m_max)
+			{
+				m_index = m_max;
 			}
 			m_val = (value_type) m_index;
 		}
 
-		const uint8_t* m_data;
+		const word_t* m_words;
 		size_t m_index;
 		size_t m_max;
 		value_type m_val;
@@ -137,28 +200,42 @@ public:
 	set(std::initializer_list<T> v): set(v.begin(), v.end()) { }
 
 	inline explicit set(T maxLen):
-		m_types(maxLen + 1, 0),
+		m_words(((size_t)maxLen + word_bits) / word_bits, 0),
 		m_max(maxLen),
 		m_size(0)
 	{
 	}
 
-	const uint8_t* data() const noexcept
+	//
+	// The set as one byte per code, 1 for the codes in the set, as
+	// expected by the scap APIs. Valid until the set is modified.
+	//
+	const uint8_t* data() const
 	{
-		return m_types.data();
+		m_bytes.assign((size_t)m_max + 1, 0);
+		for(size_t i = 0; i < m_words.size(); i++)
+		{
+			for(word_t w = m_words[i]; w != 0; w &= w - 1)
+			{
+				m_bytes[i * word_bits + lowest_bit(w)] = 1;
+			}
+		}
+		return m_bytes.data();
 	}
 
-	iterator begin() const { return iterator(m_types.data(), 0, m_max); }
-	iterator end() const { return iterator(m_types.data(), m_max, m_max); }
+	iterator begin() const { return iterator(m_words.data(), 0, m_max); }
+	iterator end() const { return iterator(m_words.data(), m_max, m_max); }
 
 	inline void insert(T e)
 	{
 		check_range(e);
-		if (m_types[e] == 0)
+		word_t& w = m_words[(size_t)e / word_bits];
+		word_t bit = (word_t)1 << ((size_t)e % word_bits);
+		if ((w & bit) == 0)
 		{
 			m_size++;
 		}
-		m_types[e] = 1;
+		w |= bit;
 	}
 
 	template<typename InputIterator>
@@ -170,27 +247,42 @@ public:
 		}
 	}
 
+	//
+	// Add all the codes of other, in place
+	//
+	inline void insert(const set& other)
+	{
+		check_same_max(other, "merge");
+		for(size_t i = 0; i < m_words.size(); ++i)
+		{
+			m_words[i] |= other.m_words[i];
+		}
+		update_size();
+	}
+
 	inline void remove(T e)
 	{
 		check_range(e);
-		if (m_types[e] == 1)
+		word_t& w = m_words[(size_t)e / word_bits];
+		word_t bit = (word_t)1 << ((size_t)e % word_bits);
+		if ((w & bit) != 0)
 		{
 			m_size--;
 		}
-		m_types[e] = 0;
+		w &= ~bit;
 	}
 
 	inline bool contains(T e) const
 	{
 		check_range(e);
-		return m_types[e] != 0;
+		return (m_words[(size_t)e / word_bits] >> ((size_t)e % word_bits)) & 1;
 	}
 
 	void clear()
 	{
-		for(auto& v : m_types)
+		for(auto& w : m_words)
 		{
-			v = 0;
+			w = 0;
 		}
 		m_size = 0;
 	}
@@ -207,77 +299,56 @@ public:
 
 	bool equals(const set& other) const
 	{
-		return m_types == other.m_types;
+		return m_words == other.m_words;
 	}
 
 	set merge(const set& other) const
 	{
-		if (other.m_max != m_max)
-		{
-			throw sinsp_exception("cannot merge sets with different max size.");
-		}
-		set<T> ret(m_max);
-		for(size_t i = 0; i <= m_max; ++i)
-		{
-			if (m_types[i] | other.m_types[i])
-			{
-				ret.insert((T)i);
-			}
-		}
+		set<T> ret(*this);
+		ret.insert(other);
 		return ret;
 	}
 
 	set diff(const set& other) const
 	{
-		if (other.m_max != m_max)
-		{
-			throw sinsp_exception("cannot diff sets with different max size.");
-		}
+		check_same_max(other, "diff");
 		set<T> ret(m_max);
-		for(size_t i = 0; i <= m_max; ++i)
+		for(size_t i = 0; i < m_words.size(); ++i)
 		{
-			if (m_types[i] == 1 && other.m_types[i] == 0)
-			{
-				ret.insert((T)i);
-			}
+			ret.m_words[i] = m_words[i] & ~other.m_words[i];
 		}
+		ret.update_size();
 		return ret;
 	}
 
 	set intersect(const set& other) const
 	{
-		if (other.m_max != m_max)
-		{
-			throw sinsp_exception("cannot intersect sets with different max size.");
-		}
+		check_same_max(other, "intersect");
 		set<T> ret(m_max);
-		for(size_t i = 0; i <= m_max; ++i)
+		for(size_t i = 0; i < m_words.size(); ++i)
 		{
-			if (m_types[i] & other.m_types[i])
-			{
-				ret.insert((T)i);
-			}
+			ret.m_words[i] = m_words[i] & other.m_words[i];
 		}
+		ret.update_size();
 		return ret;
 	}
 
-	void for_each(const std::function<bool(T)>& consumer) const
+	template<typename Consumer>
+	void for_each(const Consumer& consumer) const
 	{
-		for(size_t i = 0; i < m_max; ++i)
+		for(auto it = begin(); it != end(); ++it)
 		{
-			if(m_types[i] != 0)
+			if(!consumer(*it))
 			{
-				if(!consumer((T) i))
-				{
-					return;
-				}
+				return;
 			}
 		}
 	}
 
-	set filter(const std::function<bool(T)>& predicate) const
+	template<typename Predicate>
+	set filter(const Predicate& predicate) const
 	{
-		set<T> ret;
+		set<T> ret(m_max);
 		for_each([&ret, &predicate](T v){
 			if(predicate(v))
 			{
@@ -0,0 +1,208 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// This benchmark measures sinsp_fdtable against a plain
+// std::unordered_map<int64_t, sinsp_fdinfo_t>, which is how the table used
+// to be stored, under lookup-heavy and churn-heavy (open/close) workloads
+// over small and dense fd numbers, as found in real processes.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <sinsp.h>
+
+typedef std::unordered_map<int64_t, sinsp_fdinfo_t> fdmap_t;
+
+static void report(const char* name, std::chrono::steady_clock::time_point start, uint64_t ops, uint64_t found)
+{
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	printf("  %-24s %8.2f ns/op (%lu found)\n", name, (double)ns / ops, (unsigned long)found);
+}
+
+// Lookups of random fds among the open ones, so that the single-entry
+// cache of the table only helps as often as it would on real event streams
+static std::vector<int64_t> make_lookups(uint32_t nfds, uint32_t n)
+{
+	std::mt19937 rng(1234);
+	std::vector<int64_t> fds;
+	for(uint32_t i = 0; i < n; i++)
+	{
+		// Half of the events hit the same fd as the previous one
+		if(!fds.empty() && (rng() & 1))
+		{
+			fds.push_back(fds.back());
+		}
+		else
+		{
+			fds.push_back(rng() % (nfds + nfds / 8));
+		}
+	}
+	return fds;
+}
+
+static void bench_lookup(sinsp* inspector, uint32_t nfds, uint32_t rounds)
+{
+	printf("lookup (%u fds)\n", nfds);
+
+	sinsp_fdinfo_t fdinfo;
+	sinsp_fdtable table(inspector);
+	fdmap_t map;
+	for(uint32_t fd = 0; fd < nfds; fd++)
+	{
+		table.add(fd, &fdinfo);
+		map.emplace(fd, fdinfo);
+	}
+
+	auto lookups = make_lookups(nfds, 100000);
+	uint64_t ops = (uint64_t)rounds * lookups.size();
+	uint64_t found = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		for(int64_t fd : lookups)
+		{
+			found += map.find(fd) != map.end();
+		}
+	}
+	report("std::unordered_map", start, ops, found);
+
+	found = 0;
+	start = std::chrono::steady_clock::now();
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		for(int64_t fd : lookups)
+		{
+			found += table.find(fd) != NULL;
+		}
+	}
+	report("sinsp_fdtable", start, ops, found);
+	printf("\n");
+}
+
+// Open/close churn: each step closes a random open fd and then opens a
+// new one on the lowest free number, as the kernel does
+static void bench_churn(sinsp* inspector, uint32_t nfds, uint32_t rounds)
+{
+	printf("churn (%u fds)\n", nfds);
+
+	std::mt19937 rng(1234);
+	std::vector<int64_t> closes;
+	for(uint32_t i = 0; i < 100000; i++)
+	{
+		closes.push_back(rng() % nfds);
+	}
+	uint64_t ops = (uint64_t)rounds * closes.size();
+
+	sinsp_fdinfo_t fdinfo;
+	fdmap_t map;
+	for(uint32_t fd = 0; fd < nfds; fd++)
+	{
+		map.emplace(fd, fdinfo);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		for(int64_t fd : closes)
+		{
+			map.erase(fd);
+			map.emplace(fd, fdinfo);
+		}
+	}
+	report("std::unordered_map", start, ops, map.size());
+
+	sinsp_fdtable table(inspector);
+	for(uint32_t fd = 0; fd < nfds; fd++)
+	{
+		table.add(fd, &fdinfo);
+	}
+
+	start = std::chrono::steady_clock::now();
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		for(int64_t fd : closes)
+		{
+			table.erase(fd);
+			table.add(fd, &fdinfo);
+		}
+	}
+	report("sinsp_fdtable", start, ops, table.size());
+	printf("\n");
+}
+
+// Copy of the whole table, as done when a process forks
+static void bench_clone(sinsp* inspector, uint32_t nfds, uint32_t rounds)
+{
+	printf("clone (%u fds)\n", nfds);
+
+	sinsp_fdinfo_t fdinfo;
+	sinsp_fdtable table(inspector);
+	fdmap_t map;
+	for(uint32_t fd = 0; fd < nfds; fd++)
+	{
+		table.add(fd, &fdinfo);
+		map.emplace(fd, fdinfo);
+	}
+
+	uint64_t found = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		fdmap_t copy = map;
+		found += copy.size();
+	}
+	report("std::unordered_map", start, rounds, found);
+
+	found = 0;
+	start = std::chrono::steady_clock::now();
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		sinsp_fdtable copy = table;
+		found += copy.size();
+	}
+	report("sinsp_fdtable", start, rounds, found);
+	printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t rounds = 50;
+	if(argc > 1)
+	{
+		rounds = strtoul(argv[1], NULL, 10);
+		if(rounds == 0)
+		{
+			fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	sinsp inspector;
+	for(uint32_t nfds : {8, 64, 1024})
+	{
+		bench_lookup(&inspector, nfds, rounds);
+		bench_churn(&inspector, nfds, rounds);
+		bench_clone(&inspector, nfds, rounds * 100);
+	}
+	return EXIT_SUCCESS;
+}
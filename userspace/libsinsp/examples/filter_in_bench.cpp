@@ -0,0 +1,116 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// This benchmark measures the membership tests behind the `in` operator on
+// numeric and IPv4 fields: a linear scan of the values, the memory buffer
+// hash set used for strings, and the integer set used for these fields,
+// for lists of 10 to 100k values.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include <filter_value.h>
+
+typedef std::function<bool(uint32_t)> contains_fn;
+
+static void run(const char* name, const std::vector<uint32_t>& queries, uint32_t rounds, const contains_fn& fn)
+{
+	uint64_t matches = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		for(uint32_t q : queries)
+		{
+			matches += fn(q);
+		}
+	}
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	uint64_t ops = (uint64_t)rounds * queries.size();
+	printf("  %-24s %8.2f ns/op (%lu matches)\n", name, (double)ns / ops, (unsigned long)matches);
+}
+
+static void bench_list(size_t size, uint32_t rounds)
+{
+	std::mt19937 rng(1234);
+	std::vector<uint32_t> values;
+	for(size_t i = 0; i < size; i++)
+	{
+		values.push_back(rng());
+	}
+
+	// half of the queries hit the list
+	std::vector<uint32_t> queries;
+	for(size_t i = 0; i < 1000; i++)
+	{
+		queries.push_back((i % 2) ? values[rng() % size] : rng());
+	}
+
+	std::unordered_set<filter_value_t, g_hash_membuf, g_equal_to_membuf> members;
+	filter_int_set ints;
+	for(auto& v : values)
+	{
+		members.insert(filter_value_t((uint8_t*)&v, sizeof(v)));
+		ints.insert(v);
+	}
+
+	printf("%zu values\n", size);
+	// the linear scan gets fewer rounds, it would take forever otherwise
+	uint32_t scan_rounds = rounds * 10 / size + 1;
+	run("linear scan", queries, scan_rounds,
+		[&](uint32_t q) {
+			for(auto& v : values)
+			{
+				if(memcmp(&v, &q, sizeof(q)) == 0)
+				{
+					return true;
+				}
+			}
+			return false;
+		});
+	run("membuf hash set", queries, rounds,
+		[&](uint32_t q) { return members.find(filter_value_t((uint8_t*)&q, sizeof(q))) != members.end(); });
+	run("filter_int_set", queries, rounds,
+		[&](uint32_t q) { return ints.contains(q); });
+	printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t rounds = 1000;
+	if(argc > 1)
+	{
+		rounds = strtoul(argv[1], NULL, 10);
+		if(rounds == 0)
+		{
+			fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for(size_t size : {10, 100, 1000, 10000, 100000})
+	{
+		bench_list(size, rounds);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// This benchmark measures the memory and the lookup time of the search
+// paths behind the pmatch operator: the generic path_prefix_map<bool> and
+// the compact path_prefix_search, for 100 to 100k prefixes.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <prefix_search.h>
+
+// Live heap bytes, to measure the memory of the structures
+static size_t s_live_bytes = 0;
+
+void* operator new(size_t size)
+{
+	size_t* p = (size_t*)malloc(size + sizeof(size_t) * 2);
+	if(p == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	p[0] = size;
+	s_live_bytes += size;
+	return p + 2;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if(ptr != NULL)
+	{
+		size_t* p = (size_t*)ptr - 2;
+		s_live_bytes -= p[0];
+		free(p);
+	}
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+static const char* s_dirs[] = {"usr", "lib", "bin", "sbin", "etc", "var", "opt", "home", "proc", "sys",
+	"run", "tmp", "share", "local", "log", "cache", "docker", "containers", "overlay2", "kubelet"};
+
+static std::string random_path(std::mt19937& rng, uint32_t depth)
+{
+	std::string path;
+	for(uint32_t i = 0; i < depth; i++)
+	{
+		path += "/";
+		path += s_dirs[rng() % (sizeof(s_dirs) / sizeof(s_dirs[0]))];
+		if(rng() % 2)
+		{
+			path += std::to_string(rng() % 100);
+		}
+	}
+	return path;
+}
+
+static void run(const char* name, const std::vector<std::string>& queries, uint32_t rounds,
+		const std::function<bool(const char*)>& fn)
+{
+	uint64_t matches = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		for(const auto& q : queries)
+		{
+			matches += fn(q.c_str());
+		}
+	}
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	uint64_t ops = (uint64_t)rounds * queries.size();
+	printf("  %-24s %8.2f ns/op (%lu matches)\n", name, (double)ns / ops, (unsigned long)matches);
+}
+
+static void bench_prefixes(size_t size, uint32_t rounds)
+{
+	std::mt19937 rng(1234);
+	std::vector<std::string> prefixes;
+	for(size_t i = 0; i < size; i++)
+	{
+		prefixes.push_back(random_path(rng, 2 + rng() % 4));
+	}
+
+	// half of the queries are below one of the prefixes
+	std::vector<std::string> queries;
+	for(size_t i = 0; i < 1000; i++)
+	{
+		queries.push_back((i % 2) ? prefixes[rng() % size] + random_path(rng, 2) : random_path(rng, 6));
+	}
+
+	size_t before = s_live_bytes;
+	auto map = new path_prefix_map<bool>();
+	bool val = true;
+	for(const auto& p : prefixes)
+	{
+		map->add_search_path(p, val);
+	}
+	size_t map_bytes = s_live_bytes - before;
+
+	before = s_live_bytes;
+	auto search = new path_prefix_search();
+	for(const auto& p : prefixes)
+	{
+		search->add_search_path(p);
+	}
+	size_t search_bytes = s_live_bytes - before;
+
+	printf("%zu prefixes\n", size);
+	printf("  %-24s %8zu KiB\n", "path_prefix_map<bool>", map_bytes / 1024);
+	printf("  %-24s %8zu KiB\n", "path_prefix_search", search_bytes / 1024);
+	run("path_prefix_map<bool>", queries, rounds, [&](const char* q) { return map->match(q) != NULL; });
+	run("path_prefix_search", queries, rounds, [&](const char* q) { return search->match(q); });
+	printf("\n");
+
+	delete map;
+	delete search;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t rounds = 100;
+	if(argc > 1)
+	{
+		rounds = strtoul(argv[1], NULL, 10);
+		if(rounds == 0)
+		{
+			fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for(size_t size : {100, 1000, 10000, 100000})
+	{
+		bench_prefixes(size, rounds);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// This benchmark measures the string search kernels used by the filter
+// operators (contains, icontains, bcontains) against the libc functions
+// they replace, over synthetic corpora resembling fd.name and proc.cmdline
+// values, searched with needles taken from typical rules.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <strsearch.h>
+
+using namespace libsinsp::strsearch;
+
+static const char* s_dirs[] = {"/usr/lib/x86_64-linux-gnu", "/proc/self", "/var/lib/docker/overlay2",
+	"/etc", "/home/user/.cache/pip", "/sys/fs/cgroup/memory", "/tmp", "/usr/share/zoneinfo/Europe",
+	"/var/log/journal", "/opt/app/node_modules/lodash"};
+static const char* s_files[] = {"libc.so.6", "stat", "merged", "passwd", "http.cache", "memory.usage_in_bytes",
+	"tmp.XyZ123", "Rome", "system.journal", "package.json"};
+static const char* s_cmds[] = {"/usr/bin/java -Xmx2g -Dspring.profiles.active=prod -jar /opt/app/service.jar --server.port=8080",
+	"python3 -m gunicorn app:app --workers 4 --bind 0.0.0.0:8000",
+	"/bin/bash -c while true; do curl -s http://localhost:9090/metrics; sleep 10; done",
+	"node /opt/app/node_modules/.bin/next start -p 3000",
+	"/usr/sbin/sshd -D -o AuthorizedKeysCommand=/usr/bin/google_authorized_keys",
+	"containerd-shim-runc-v2 -namespace k8s.io -id 3f2a9c1e5d7b -address /run/containerd/containerd.sock"};
+
+static const char* s_fd_needles[] = {"/etc/shadow", "/.ssh/", "id_rsa", "docker.sock", "/dev/shm", "kube"};
+static const char* s_cmd_needles[] = {"nc -l", "bash -i", "--rpc", "base64 -d", "/dev/tcp/", "xmrig"};
+
+static std::vector<std::string> make_corpus(bool cmdline, size_t n)
+{
+	std::mt19937 rng(1234);
+	std::vector<std::string> corpus;
+	for(size_t i = 0; i < n; i++)
+	{
+		if(cmdline)
+		{
+			corpus.push_back(s_cmds[rng() % (sizeof(s_cmds) / sizeof(s_cmds[0]))]);
+			corpus.back() += " --id=" + std::to_string(rng() % 100000);
+		}
+		else
+		{
+			corpus.push_back(std::string(s_dirs[rng() % (sizeof(s_dirs) / sizeof(s_dirs[0]))])
+				+ "/" + s_files[rng() % (sizeof(s_files) / sizeof(s_files[0]))]);
+		}
+	}
+	return corpus;
+}
+
+typedef std::function<bool(const std::string&, const char*)> search_fn;
+
+static void run(const char* name, const std::vector<std::string>& corpus,
+		const char** needles, size_t num_needles, uint32_t rounds, const search_fn& fn)
+{
+	uint64_t matches = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		for(const auto& s : corpus)
+		{
+			for(size_t i = 0; i < num_needles; i++)
+			{
+				matches += fn(s, needles[i]);
+			}
+		}
+	}
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	uint64_t ops = (uint64_t)rounds * corpus.size() * num_needles;
+	printf("  %-24s %8.2f ns/op (%lu matches)\n", name, (double)ns / ops, (unsigned long)matches);
+}
+
+static void bench_corpus(const char* title, const std::vector<std::string>& corpus,
+			 const char** needles, size_t num_needles, uint32_t rounds)
+{
+	printf("%s (%zu values, %zu needles)\n", title, corpus.size(), num_needles);
+
+	run("contains (strstr)", corpus, needles, num_needles, rounds,
+		[](const std::string& s, const char* n) { return strstr(s.c_str(), n) != NULL; });
+#ifndef _WIN32
+	run("icontains (strcasestr)", corpus, needles, num_needles, rounds,
+		[](const std::string& s, const char* n) { return strcasestr(s.c_str(), n) != NULL; });
+	run("bcontains (memmem)", corpus, needles, num_needles, rounds,
+		[](const std::string& s, const char* n) { return memmem(s.data(), s.size(), n, strlen(n)) != NULL; });
+#endif
+
+	kernel prev = get_kernel();
+	for(kernel k : {kernel::SCALAR, kernel::SSE2, kernel::AVX2, kernel::NEON})
+	{
+		if(!set_kernel(k))
+		{
+			continue;
+		}
+		std::string name = std::string("contains (") + to_string(k) + ")";
+		run(name.c_str(), corpus, needles, num_needles, rounds,
+			[](const std::string& s, const char* n) { return find(s.c_str(), strlen(s.c_str()), n, strlen(n)) != NULL; });
+		name = std::string("icontains (") + to_string(k) + ")";
+		run(name.c_str(), corpus, needles, num_needles, rounds,
+			[](const std::string& s, const char* n) { return ifind(s.c_str(), strlen(s.c_str()), n, strlen(n)) != NULL; });
+		name = std::string("bcontains (") + to_string(k) + ")";
+		run(name.c_str(), corpus, needles, num_needles, rounds,
+			[](const std::string& s, const char* n) { return find(s.data(), s.size(), n, strlen(n)) != NULL; });
+	}
+	set_kernel(prev);
+	printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t rounds = 50;
+	if(argc > 1)
+	{
+		rounds = strtoul(argv[1], NULL, 10);
+		if(rounds == 0)
+		{
+			fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("default kernel: %s\n\n", to_string(get_kernel()));
+	bench_corpus("fd.name", make_corpus(false, 10000),
+		s_fd_needles, sizeof(s_fd_needles) / sizeof(s_fd_needles[0]), rounds);
+	bench_corpus("proc.cmdline", make_corpus(true, 10000),
+		s_cmd_needles, sizeof(s_cmd_needles) / sizeof(s_cmd_needles[0]), rounds);
+	return EXIT_SUCCESS;
+}
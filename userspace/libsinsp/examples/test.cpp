@@ -32,10 +32,13 @@ limitations under the License.
 extern "C" {
 #include <sys/syscall.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
 #include <fcntl.h>
 #include <unistd.h>
 }
 #endif // _WIN32
+#include <algorithm>
+#include <vector>
 
 using namespace std;
 
@@ -44,6 +47,9 @@ void plaintext_dump(sinsp& inspector);
 void json_dump(sinsp& inspector);
 void json_dump_init(sinsp& inspector);
 void json_dump_reinit_evt_formatter(sinsp& inspector);
+void bench_dump(sinsp& inspector);
+void bench_report(sinsp& inspector, double duration_s);
+double bench_cpu_s();
 
 libsinsp::events::set<ppm_sc_code> extract_filter_sc_codes(sinsp& inspector);
 std::function<void(sinsp& inspector)> dump;
@@ -61,6 +67,10 @@ string bpf_path = "";
 string output_fields_json = "";
 unsigned long buffer_bytes_dim = DEFAULT_DRIVER_BUFFER_BYTES_DIM;
 static uint64_t max_events = UINT64_MAX;
+static bool g_bench = false;
+static bool g_bench_format = false;
+static uint64_t g_bench_interval = 1000000;
+static bool g_bench_json = false;
 
 sinsp_evt* get_event(sinsp& inspector);
 
@@ -71,6 +81,29 @@ static std::unique_ptr<sinsp_evt_formatter> default_formatter = nullptr;
 static std::unique_ptr<sinsp_evt_formatter> process_formatter = nullptr;
 static std::unique_ptr<sinsp_evt_formatter> net_formatter = nullptr;
 
+// Benchmark mode state: time spent in next() (and in the formatter, if
+// enabled) per event type, including the events discarded by the filter
+struct bench_type_stats
+{
+	uint64_t m_count = 0;
+	uint64_t m_ns = 0;
+	std::string m_name;
+};
+static std::vector<bench_type_stats> g_bench_types(PPM_EVENT_MAX);
+static uint64_t g_bench_nevts = 0;
+static uint64_t g_bench_nfiltered = 0;
+static std::chrono::steady_clock::time_point g_bench_last_report;
+static uint64_t g_bench_last_nevts = 0;
+static std::unique_ptr<sinsp_evt_formatter> bench_formatter = nullptr;
+static double g_bench_cpu_start_s = 0;
+
+// Live captures only: delay between the timestamp of an event and the end of
+// its processing, in a log-linear histogram with 16 buckets per power of 2
+// (6% of resolution)
+#define BENCH_LATENCY_SUB_BUCKETS 16
+static std::vector<uint64_t> g_bench_latency(64 * BENCH_LATENCY_SUB_BUCKETS);
+static uint64_t g_bench_nlatency = 0;
+
 static void sigint_handler(int signum)
 {
 	g_interrupted = true;
@@ -98,6 +131,10 @@ Options:
   -z, --ppm-sc-modifies-state                Select ppm sc codes from filter AST plus enforce sinsp state ppm sc codes via `sinsp_state_sc_set`, requires valid filter expression.
   -x, --ppm-sc-repair-state                  Select ppm sc codes from filter AST plus enforce sinsp state ppm sc codes via `sinsp_repair_state_sc_set`, requires valid filter expression.
   -q, --remove-io-sc-state                   Remove ppm sc codes belonging to `io_sc_set` from `sinsp_state_sc_set` sinsp state enforcement, defaults to false and only applies when choosing `-z` option, used for e2e testing of sinsp state.
+  -B, --bench                                Benchmark mode: process events at full speed without printing them, then report events/sec, the time per event type and the memory high-water mark. Meant to be used with -s.
+  -F, --bench-format                         [Benchmark mode only] Also format the events that pass the filter, with the default output format.
+  -I <n>, --bench-interval <n>               [Benchmark mode only] Print throughput and thread/fd table sizes every <n> events (default: 1000000, 0 to disable).
+  -J, --bench-json                           [Benchmark mode only] Print the report as a single JSON line: events/sec, kernel drops, CPU usage, max RSS and, for live captures, the p50/p99 event latency.
 )";
 	cout << usage << endl;
 }
@@ -122,12 +159,16 @@ void parse_CLI_options(sinsp& inspector, int argc, char** argv)
 		{"ppm-sc-modifies-state", no_argument, 0, 'z'},
 		{"ppm-sc-repair-state", no_argument, 0, 'x'},
 		{"remove-io-sc-state", no_argument, 0, 'q'},
+		{"bench", no_argument, 0, 'B'},
+		{"bench-format", no_argument, 0, 'F'},
+		{"bench-interval", required_argument, 0, 'I'},
+		{"bench-json", no_argument, 0, 'J'},
 		{0, 0, 0, 0}};
 
 	int op;
 	int long_index = 0;
 	while((op = getopt_long(argc, argv,
-				"hf:jab:mks:d:o:En:zxq",
+				"hf:jab:mks:d:o:En:zxqBFI:J",
 				long_options, &long_index)) != -1)
 	{
 		switch(op)
@@ -181,6 +222,19 @@ void parse_CLI_options(sinsp& inspector, int argc, char** argv)
 		case 'q':
 			ppm_sc_state_remove_io_sc = true;
 			break;
+		case 'B':
+			g_bench = true;
+			dump = bench_dump;
+			break;
+		case 'F':
+			g_bench_format = true;
+			break;
+		case 'I':
+			g_bench_interval = strtoull(optarg, NULL, 10);
+			break;
+		case 'J':
+			g_bench_json = true;
+			break;
 		default:
 			break;
 		}
@@ -376,11 +430,18 @@ int main(int argc, char** argv)
 
 	open_engine(inspector, events_sc_codes);
 
+	if(g_bench_format)
+	{
+		bench_formatter.reset(new sinsp_evt_formatter(&inspector, DEFAULT_OUTPUT_STR));
+	}
+
 	std::cout << "-- Start capture" << std::endl;
 
 	inspector.start_capture();
+	g_bench_cpu_start_s = bench_cpu_s();
 
 	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	g_bench_last_report = begin;
 	uint64_t num_events = 0;
 	while(!g_interrupted && num_events < max_events)
 	{
@@ -400,6 +461,11 @@ int main(int argc, char** argv)
 		std::cout << "Events/ms: " << num_events / (long double)duration << std::endl;
 	}
 
+	if(g_bench)
+	{
+		bench_report(inspector, duration / 1000.0);
+	}
+
 	return 0;
 }
 
@@ -577,3 +643,221 @@ void json_dump(sinsp& inspector)
 
 	cout << output << std::endl;
 }
+
+static void bench_tables_size(sinsp& inspector, uint64_t& nthreads, uint64_t& nfds)
+{
+	nthreads = inspector.m_thread_manager->get_thread_count();
+	nfds = 0;
+	inspector.m_thread_manager->get_threads()->loop([&nfds](sinsp_threadinfo& tinfo)
+	{
+		// threads share the fd table of their main thread
+		if(tinfo.is_main_thread())
+		{
+			nfds += tinfo.get_fd_opencount();
+		}
+		return true;
+	});
+}
+
+static long bench_max_rss_kb()
+{
+#ifndef _WIN32
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+		return usage.ru_maxrss;
+	}
+#endif // _WIN32
+	return -1;
+}
+
+// User and system CPU time of the process, in seconds
+double bench_cpu_s()
+{
+#ifndef _WIN32
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+		return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+		       (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+	}
+#endif // _WIN32
+	return 0;
+}
+
+static uint32_t bench_latency_bucket(uint64_t ns)
+{
+	if(ns < BENCH_LATENCY_SUB_BUCKETS)
+	{
+		return ns;
+	}
+
+	uint32_t msb = 0;
+	while((ns >> (msb + 1)) != 0)
+	{
+		msb++;
+	}
+	// msb >= 4: the bucket is given by the 4 bits following the msb
+	return (msb - 3) * BENCH_LATENCY_SUB_BUCKETS + ((ns >> (msb - 4)) & (BENCH_LATENCY_SUB_BUCKETS - 1));
+}
+
+// Lower bound of the latency of the bucket holding the given percentile
+static double bench_latency_percentile_us(double percentile)
+{
+	if(g_bench_nlatency == 0)
+	{
+		return -1;
+	}
+
+	uint64_t rank = (uint64_t)(percentile / 100.0 * g_bench_nlatency);
+	uint64_t seen = 0;
+	for(uint32_t b = 0; b < g_bench_latency.size(); b++)
+	{
+		seen += g_bench_latency[b];
+		if(seen > rank)
+		{
+			if(b < BENCH_LATENCY_SUB_BUCKETS)
+			{
+				return b / 1000.0;
+			}
+			uint32_t msb = b / BENCH_LATENCY_SUB_BUCKETS + 3;
+			uint64_t ns = (uint64_t)(BENCH_LATENCY_SUB_BUCKETS + b % BENCH_LATENCY_SUB_BUCKETS) << (msb - 4);
+			return ns / 1000.0;
+		}
+	}
+	return -1;
+}
+
+void bench_dump(sinsp& inspector)
+{
+	sinsp_evt* ev = nullptr;
+
+	auto start = std::chrono::steady_clock::now();
+	int32_t res = inspector.next(&ev);
+	if(res == SCAP_SUCCESS && bench_formatter != nullptr)
+	{
+		std::string output;
+		bench_formatter->tostring(ev, &output);
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	if(res == SCAP_EOF)
+	{
+		std::cout << "-- EOF" << std::endl;
+		g_interrupted = true;
+		return;
+	}
+
+	if((res != SCAP_SUCCESS && res != SCAP_FILTERED_EVENT) || ev == nullptr)
+	{
+		if(res != SCAP_TIMEOUT)
+		{
+			cout << "[ERROR] " << inspector.getlasterr() << endl;
+			g_interrupted = true;
+		}
+		return;
+	}
+
+	if(inspector.is_live())
+	{
+		uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		if(now >= ev->get_ts())
+		{
+			g_bench_latency[bench_latency_bucket(now - ev->get_ts())]++;
+			g_bench_nlatency++;
+		}
+	}
+
+	bench_type_stats& stats = g_bench_types[ev->get_type()];
+	if(stats.m_count == 0)
+	{
+		stats.m_name = std::string(ev->get_name()) + (ev->get_direction() == SCAP_ED_IN ? " >" : " <");
+	}
+	stats.m_count++;
+	stats.m_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+	g_bench_nevts++;
+	if(res == SCAP_FILTERED_EVENT)
+	{
+		g_bench_nfiltered++;
+	}
+
+	if(g_bench_interval != 0 && g_bench_nevts % g_bench_interval == 0)
+	{
+		const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - g_bench_last_report).count();
+		uint64_t nthreads, nfds;
+		bench_tables_size(inspector, nthreads, nfds);
+		printf("-- %" PRIu64 " evts, %.0f evts/s, %" PRIu64 " threads, %" PRIu64 " fds, max rss %ld KB\n",
+		       g_bench_nevts,
+		       ms > 0 ? (g_bench_nevts - g_bench_last_nevts) * 1000.0 / ms : 0.0,
+		       nthreads, nfds, bench_max_rss_kb());
+		g_bench_last_report = end;
+		g_bench_last_nevts = g_bench_nevts;
+	}
+}
+
+void bench_report(sinsp& inspector, double duration_s)
+{
+	std::vector<const bench_type_stats*> types;
+	uint64_t total_ns = 0;
+	for(const auto& stats : g_bench_types)
+	{
+		if(stats.m_count != 0)
+		{
+			types.push_back(&stats);
+			total_ns += stats.m_ns;
+		}
+	}
+	std::sort(types.begin(), types.end(), [](const bench_type_stats* a, const bench_type_stats* b)
+	{
+		return a->m_ns > b->m_ns;
+	});
+
+	uint64_t nthreads, nfds;
+	bench_tables_size(inspector, nthreads, nfds);
+
+	if(g_bench_json)
+	{
+		scap_stats stats = {};
+		inspector.get_capture_stats(&stats);
+		double cpu_s = bench_cpu_s() - g_bench_cpu_start_s;
+		uint64_t received = stats.n_evts + stats.n_drops;
+
+		printf("{\"engine\":\"%s\",\"events\":%" PRIu64 ",\"filtered\":%" PRIu64 ",\"duration_s\":%.3f,"
+		       "\"events_per_sec\":%.0f,\"next_events_per_sec\":%.0f,"
+		       "\"drops\":%" PRIu64 ",\"drop_pct\":%.4f,"
+		       "\"cpu_s\":%.3f,\"cpu_pct\":%.2f,\"cpu_ns_per_event\":%.1f,"
+		       "\"max_rss_kb\":%ld,\"threads\":%" PRIu64 ",\"fds\":%" PRIu64 ","
+		       "\"latency_p50_us\":%.1f,\"latency_p99_us\":%.1f}\n",
+		       engine_string.c_str(), g_bench_nevts, g_bench_nfiltered, duration_s,
+		       duration_s > 0 ? g_bench_nevts / duration_s : 0.0,
+		       total_ns > 0 ? g_bench_nevts * 1e9 / total_ns : 0.0,
+		       stats.n_drops, received > 0 ? stats.n_drops * 100.0 / received : 0.0,
+		       cpu_s, duration_s > 0 ? cpu_s * 100.0 / duration_s : 0.0,
+		       g_bench_nevts > 0 ? cpu_s * 1e9 / g_bench_nevts : 0.0,
+		       bench_max_rss_kb(), nthreads, nfds,
+		       bench_latency_percentile_us(50), bench_latency_percentile_us(99));
+		fflush(stdout);
+		return;
+	}
+
+	printf("-- Benchmark\n");
+	printf("Processed events: %" PRIu64 " (%" PRIu64 " filtered out)\n", g_bench_nevts, g_bench_nfiltered);
+	if(total_ns > 0)
+	{
+		printf("Events/s: %.0f (time in next()%s only)\n",
+		       g_bench_nevts * 1e9 / total_ns, bench_formatter != nullptr ? " and formatting" : "");
+	}
+	printf("Threads: %" PRIu64 ", fds: %" PRIu64 "\n", nthreads, nfds);
+	printf("Max RSS: %ld KB\n", bench_max_rss_kb());
+	printf("%-24s %12s %10s %8s\n", "event", "count", "ns/evt", "time%");
+	for(const auto* stats : types)
+	{
+		printf("%-24s %12" PRIu64 " %10.1f %7.2f%%\n",
+		       stats->m_name.c_str(),
+		       stats->m_count,
+		       (double)stats->m_ns / stats->m_count,
+		       total_ns > 0 ? stats->m_ns * 100.0 / total_ns : 0.0);
+	}
+}
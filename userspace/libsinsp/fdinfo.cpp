@@ -31,14 +31,19 @@ template<> sinsp_fdinfo_t::sinsp_fdinfo()
 	m_type = SCAP_FD_UNINITIALIZED;
 	m_flags = FLAGS_NONE;
 	m_callbacks = NULL;
+	m_protostate = NULL;
 	m_usrstate = NULL;
 	m_name = "";
-	m_name_raw = "";
 	m_oldname = "";
 	m_dev = 0;
 	m_mount_id = 0;
 	m_ino = 0;
 	m_openflags = 0;
+	m_name_sep = UINT32_MAX;
+	m_name_sep_len = UINT32_MAX;
+	m_l7proto = L7_PROTO_UNCLASSIFIED;
+	m_l7_attempts = 0;
+	m_accounted_bytes = 0;
 }
 
 template<> void sinsp_fdinfo_t::reset()
@@ -47,14 +52,23 @@ template<> void sinsp_fdinfo_t::reset()
 	m_flags = FLAGS_NONE;
 	delete(m_callbacks);
 	m_callbacks = NULL;
+	delete(m_protostate);
+	m_protostate = NULL;
 	m_usrstate = NULL;
 	m_name = "";
-	m_name_raw = "";
+	if(m_name_raw)
+	{
+		m_name_raw->clear();
+	}
 	m_oldname = "";
 	m_dev = 0;
 	m_mount_id = 0;
 	m_ino = 0;
 	m_openflags = 0;
+	m_name_sep = UINT32_MAX;
+	m_name_sep_len = UINT32_MAX;
+	m_l7proto = L7_PROTO_UNCLASSIFIED;
+	m_l7_attempts = 0;
 }
 
 template<> std::string* sinsp_fdinfo_t::tostring()
@@ -163,12 +177,35 @@ template<> std::string sinsp_fdinfo_t::tostring_clean()
 
 template<> void sinsp_fdinfo_t::add_filename_raw(const char* rawpath)
 {
-	m_name_raw = rawpath;
+	if(m_name_raw)
+	{
+		*m_name_raw = rawpath;
+	}
+	else
+	{
+		m_name_raw.reset(new std::string(rawpath));
+	}
 }
 
 template<> void sinsp_fdinfo_t::add_filename(const char* fullpath)
 {
 	m_name = fullpath;
+
+	//
+	// Split the name once here rather than every time a filter asks
+	// for the directory or the file name. The names that need to be
+	// sanitized are left to the filter checks.
+	//
+	m_name_sep_len = UINT32_MAX;
+	if(m_name.size() >= UINT32_MAX ||
+	   std::find_if(m_name.begin(), m_name.end(), g_invalidchar()) != m_name.end())
+	{
+		return;
+	}
+
+	size_t pos = m_name.rfind('/');
+	m_name_sep = pos == std::string::npos ? UINT32_MAX : (uint32_t)pos;
+	m_name_sep_len = (uint32_t)m_name.size();
 }
 
 template<> bool sinsp_fdinfo_t::set_net_role_by_guessing(sinsp* inspector,
@@ -328,49 +365,175 @@ template<> void sinsp_fdinfo_t::unregister_event_callback(sinsp_pd_callback_type
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_fdtable implementation
 ///////////////////////////////////////////////////////////////////////////////
+sinsp_fdtable::page::~page()
+{
+	clear();
+}
+
+void sinsp_fdtable::page::clear()
+{
+	for(uint32_t j = 0; j < FDS_PER_PAGE; j++)
+	{
+		if(m_used & (1u << j))
+		{
+			at(j)->~sinsp_fdinfo_t();
+		}
+	}
+	m_used = 0;
+}
+
 sinsp_fdtable::sinsp_fdtable(sinsp* inspector)
 {
 	m_inspector = inspector;
+	m_tid = 0;
+	m_size = 0;
+	m_bytes = 0;
+	m_lazy_load_pending = false;
+	reset_cache();
+}
+
+sinsp_fdtable::sinsp_fdtable(const sinsp_fdtable& other)
+{
+	m_inspector = other.m_inspector;
+	m_tid = other.m_tid;
+	m_size = 0;
+	m_bytes = 0;
+	m_lazy_load_pending = false;
+	reset_cache();
+	other.const_loop([this](int64_t fd, const sinsp_fdinfo_t& fdinfo)
+	{
+		emplace(fd, fdinfo);
+		return true;
+	});
+}
+
+sinsp_fdtable::~sinsp_fdtable()
+{
+	if(m_bytes != 0 && m_inspector != NULL)
+	{
+		m_inspector->m_fd_memory.remove(m_bytes, m_size);
+	}
+}
+
+sinsp_fdtable& sinsp_fdtable::operator=(const sinsp_fdtable& other)
+{
+	if(this != &other)
+	{
+		clear();
+		m_inspector = other.m_inspector;
+		m_tid = other.m_tid;
+		other.const_loop([this](int64_t fd, const sinsp_fdinfo_t& fdinfo)
+		{
+			emplace(fd, fdinfo);
+			return true;
+		});
+	}
+
+	//
+	// The cached pointer of the other table can't be reused here
+	//
 	reset_cache();
+	return *this;
+}
+
+sinsp_fdinfo_t* sinsp_fdtable::emplace(int64_t fd, const sinsp_fdinfo_t& fdinfo)
+{
+	sinsp_fdinfo_t* res;
+
+	if(fd >= 0 && fd < MAX_DENSE_FD)
+	{
+		uint64_t pg = ((uint64_t) fd) >> FDS_PER_PAGE_BITS;
+		uint32_t slot = fd & (FDS_PER_PAGE - 1);
+		if(pg >= m_pages.size())
+		{
+			m_pages.resize(pg + 1);
+		}
+		if(!m_pages[pg])
+		{
+			m_pages[pg].reset(new page());
+		}
+		ASSERT((m_pages[pg]->m_used & (1u << slot)) == 0);
+		res = new (m_pages[pg]->at(slot)) sinsp_fdinfo_t(fdinfo);
+		m_pages[pg]->m_used |= (1u << slot);
+	}
+	else
+	{
+		res = &(m_sparse.emplace(fd, fdinfo).first->second);
+	}
+
+	m_size++;
+	account(res);
+	return res;
+}
+
+void sinsp_fdtable::account(sinsp_fdinfo_t* fdi)
+{
+	fdi->m_accounted_bytes = sizeof(sinsp_fdinfo_t) +
+		sinsp_table_memory::string_bytes(fdi->m_name) +
+		(fdi->m_name_raw ? sizeof(std::string) + sinsp_table_memory::string_bytes(*fdi->m_name_raw) : 0) +
+		sinsp_table_memory::string_bytes(fdi->m_oldname);
+	m_bytes += fdi->m_accounted_bytes;
+	if(m_inspector != NULL)
+	{
+		m_inspector->m_fd_memory.add(fdi->m_accounted_bytes);
+	}
+}
+
+void sinsp_fdtable::unaccount(const sinsp_fdinfo_t* fdi)
+{
+	m_bytes -= fdi->m_accounted_bytes;
+	if(m_inspector != NULL)
+	{
+		m_inspector->m_fd_memory.remove(fdi->m_accounted_bytes);
+	}
 }
 
 sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 {
+	if(m_lazy_load_pending)
+	{
+		lazy_load();
+	}
+
 	//
 	// Look for the FD in the table
 	//
-	auto it = m_table.find(fd);
+	sinsp_fdinfo_t* existing = find_ref(fd);
 
 	// Three possible exits here:
 	// 1. fd is not on the table
 	//   a. the table size is under the limit so create a new entry
 	//   b. table size is over the limit, discard the fd
 	// 2. fd is already in the table, replace it
-	if(it == m_table.end())
+	if(existing == NULL)
 	{
-		if(m_table.size() < m_inspector->m_max_fdtable_size)
+		if(m_size >= m_inspector->m_max_fdtable_size)
 		{
-			//
-			// No entry in the table, this is the normal case
-			//
-			m_last_accessed_fd = -1;
-#ifdef GATHER_INTERNAL_STATS
-			m_inspector->m_stats.m_n_added_fds++;
-#endif
-			std::pair<std::unordered_map<int64_t, sinsp_fdinfo_t>::iterator, bool> insert_res = m_table.emplace(fd, *fdinfo);
-			return &(insert_res.first->second);
+			return nullptr;
 		}
-		else
+
+		if(m_inspector->m_fd_memory.over_budget() &&
+		   !m_inspector->m_thread_manager->request_fd_eviction())
 		{
+			m_inspector->m_fd_memory.add_budget_drop();
 			return nullptr;
 		}
+
+		//
+		// No entry in the table, this is the normal case
+		//
+		m_last_accessed_fd = -1;
+#ifdef GATHER_INTERNAL_STATS
+		m_inspector->m_stats.m_n_added_fds++;
+#endif
+		return emplace(fd, *fdinfo);
 	}
 	else
 	{
 		//
 		// the fd is already in the table.
 		//
-		if(it->second.m_flags & sinsp_fdinfo_t::FLAGS_CLOSE_IN_PROGRESS)
+		if(existing->m_flags & sinsp_fdinfo_t::FLAGS_CLOSE_IN_PROGRESS)
 		{
 			//
 			// Sometimes an FD-creating syscall can be called on an FD that is being closed (i.e
@@ -381,7 +544,17 @@ sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 			fdinfo->m_flags &= ~sinsp_fdinfo_t::FLAGS_CLOSE_IN_PROGRESS;
 			fdinfo->m_flags |= sinsp_fdinfo_t::FLAGS_CLOSE_CANCELED;
 
-			m_table[CANCELED_FD_NUMBER] = it->second;
+			sinsp_fdinfo_t* canceled = find_ref(CANCELED_FD_NUMBER);
+			if(canceled == NULL)
+			{
+				emplace(CANCELED_FD_NUMBER, *existing);
+			}
+			else
+			{
+				unaccount(canceled);
+				*canceled = *existing;
+				account(canceled);
+			}
 		}
 		else
 		{
@@ -401,21 +574,55 @@ sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 		//
 		// Replace the fd as a struct copy
 		//
-		it->second.copy(*fdinfo, true);
-		return &(it->second);
+		unaccount(existing);
+		existing->copy(*fdinfo, true);
+		account(existing);
+		return existing;
 	}
 }
 
 void sinsp_fdtable::erase(int64_t fd)
 {
-	std::unordered_map<int64_t, sinsp_fdinfo_t>::iterator fdit = m_table.find(fd);
+	bool found = false;
+
+	if(m_lazy_load_pending)
+	{
+		lazy_load();
+	}
 
 	if(fd == m_last_accessed_fd)
 	{
 		m_last_accessed_fd = -1;
 	}
 
-	if(fdit == m_table.end())
+	if(fd >= 0 && fd < MAX_DENSE_FD)
+	{
+		uint64_t pg = ((uint64_t) fd) >> FDS_PER_PAGE_BITS;
+		uint32_t slot = fd & (FDS_PER_PAGE - 1);
+		if(pg < m_pages.size() && m_pages[pg] && (m_pages[pg]->m_used & (1u << slot)))
+		{
+			//
+			// Pages are kept around once allocated, so that open/close
+			// churn on the same fd numbers doesn't hit the allocator
+			//
+			unaccount(m_pages[pg]->at(slot));
+			m_pages[pg]->at(slot)->~sinsp_fdinfo_t();
+			m_pages[pg]->m_used &= ~(1u << slot);
+			found = true;
+		}
+	}
+	else
+	{
+		auto it = m_sparse.find(fd);
+		if(it != m_sparse.end())
+		{
+			unaccount(&it->second);
+			m_sparse.erase(it);
+			found = true;
+		}
+	}
+
+	if(!found)
 	{
 		//
 		// Looks like there's no fd to remove.
@@ -430,7 +637,7 @@ void sinsp_fdtable::erase(int64_t fd)
 	}
 	else
 	{
-		m_table.erase(fdit);
+		m_size--;
 #ifdef GATHER_INTERNAL_STATS
 		m_inspector->m_stats.m_n_noncached_fd_lookups++;
 		m_inspector->m_stats.m_n_removed_fds++;
@@ -440,12 +647,41 @@ void sinsp_fdtable::erase(int64_t fd)
 
 void sinsp_fdtable::clear()
 {
-	m_table.clear();
+	if(m_lazy_load_pending)
+	{
+		m_lazy_load_pending = false;
+		m_inspector->get_lazy_fd_loader()->discard(m_tid);
+	}
+
+	if(m_pages.size() > KEPT_PAGES)
+	{
+		m_pages.resize(KEPT_PAGES);
+	}
+	for(auto& p : m_pages)
+	{
+		if(p)
+		{
+			p->clear();
+		}
+	}
+	m_sparse.clear();
+	if(m_bytes != 0 && m_inspector != NULL)
+	{
+		m_inspector->m_fd_memory.remove(m_bytes, m_size);
+	}
+	m_bytes = 0;
+	m_size = 0;
+	reset_cache();
 }
 
 size_t sinsp_fdtable::size()
 {
-	return m_table.size();
+	if(m_lazy_load_pending)
+	{
+		lazy_load();
+	}
+
+	return m_size;
 }
 
 void sinsp_fdtable::reset_cache()
@@ -453,6 +689,86 @@ void sinsp_fdtable::reset_cache()
 	m_last_accessed_fd = -1;
 }
 
+bool sinsp_fdtable::const_loop(const_visitor_t callback) const
+{
+	if(m_lazy_load_pending)
+	{
+		lazy_load();
+	}
+
+	for(size_t pg = 0; pg < m_pages.size(); pg++)
+	{
+		const page* p = m_pages[pg].get();
+		if(p == NULL || p->m_used == 0)
+		{
+			continue;
+		}
+
+		for(uint32_t slot = 0; slot < FDS_PER_PAGE; slot++)
+		{
+			if((p->m_used & (1u << slot)) &&
+			   !callback((int64_t) ((pg << FDS_PER_PAGE_BITS) + slot), *(p->at(slot))))
+			{
+				return false;
+			}
+		}
+	}
+
+	for(const auto& it : m_sparse)
+	{
+		if(!callback(it.first, it.second))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool sinsp_fdtable::loop(visitor_t callback)
+{
+	if(m_lazy_load_pending)
+	{
+		lazy_load();
+	}
+
+	for(size_t pg = 0; pg < m_pages.size(); pg++)
+	{
+		page* p = m_pages[pg].get();
+		if(p == NULL || p->m_used == 0)
+		{
+			continue;
+		}
+
+		for(uint32_t slot = 0; slot < FDS_PER_PAGE; slot++)
+		{
+			if((p->m_used & (1u << slot)) &&
+			   !callback((int64_t) ((pg << FDS_PER_PAGE_BITS) + slot), *(p->at(slot))))
+			{
+				return false;
+			}
+		}
+	}
+
+	for(auto& it : m_sparse)
+	{
+		if(!callback(it.first, it.second))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//
+// Loading the fds doesn't change the logical contents of the table, which
+// is why this can be called from the const accessors too
+//
+void sinsp_fdtable::lazy_load() const
+{
+	m_lazy_load_pending = false;
+	m_inspector->get_lazy_fd_loader()->load(const_cast<sinsp_fdtable&>(*this));
+}
+
 void sinsp_fdtable::lookup_device(sinsp_fdinfo_t* fdi, uint64_t fd)
 {
 #ifdef HAS_CAPTURE
@@ -17,6 +17,8 @@ limitations under the License.
 
 #pragma once
 #include "sinsp_pd_callback_type.h"
+#include <functional>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -26,6 +28,12 @@ limitations under the License.
 #define CANCELED_FD_NUMBER std::numeric_limits<int64_t>::max()
 #endif
 
+#ifdef _WIN32
+#define SINSP_PREFETCH(addr)
+#else
+#define SINSP_PREFETCH(addr) __builtin_prefetch(addr)
+#endif
+
 class sinsp_protodecoder;
 
 // fd type characters
@@ -70,6 +78,20 @@ public:
 	std::vector<sinsp_protodecoder*> m_read_callbacks;
 };
 
+//
+// State that the decoder of the protocol of a FD (see
+// sinsp_fdinfo::get_l7proto) keeps for it, across its buffers
+//
+class fd_protostate
+{
+public:
+	virtual ~fd_protostate()
+	{
+	}
+
+	virtual fd_protostate* clone() const = 0;
+};
+
 /*!
   \brief File Descriptor information class.
   This class contains the full state for a FD, and a bunch of functions to
@@ -85,6 +107,7 @@ public:
 	sinsp_fdinfo();
 	sinsp_fdinfo (const sinsp_fdinfo &other) 
 	{
+		m_accounted_bytes = 0;
 		copy(other, false);
 	}
 
@@ -99,6 +122,8 @@ public:
 		{
 			delete m_usrstate;
 		}
+
+		delete m_protostate;
 	}
 
 	sinsp_fdinfo& operator=(const sinsp_fdinfo& other)
@@ -116,12 +141,23 @@ public:
 		m_openflags = other.m_openflags;	
 		m_sockinfo = other.m_sockinfo;
 		m_name = other.m_name;
-		m_name_raw = other.m_name_raw;
+		if(other.m_name_raw)
+		{
+			set_name_raw(*other.m_name_raw);
+		}
+		else if(m_name_raw)
+		{
+			m_name_raw->clear();
+		}
 		m_oldname = other.m_oldname;
 		m_flags = other.m_flags;
 		m_dev = other.m_dev;
 		m_mount_id = other.m_mount_id;
 		m_ino = other.m_ino;
+		m_name_sep = other.m_name_sep;
+		m_name_sep_len = other.m_name_sep_len;
+		m_l7proto = other.m_l7proto;
+		m_l7_attempts = other.m_l7_attempts;
 		
 		if(free_state)
 		{
@@ -134,6 +170,8 @@ public:
 			{
 				delete m_usrstate;
 			}
+
+			delete m_protostate;
 		}
 
 		if(other.m_callbacks != NULL)
@@ -154,6 +192,8 @@ public:
 		{
 			m_usrstate = NULL;
 		}
+
+		m_protostate = other.m_protostate != NULL ? other.m_protostate->clone() : NULL;
 	}
 
 	/*!
@@ -239,6 +279,30 @@ public:
 		return m_type == SCAP_FD_DIRECTORY;
 	}
 
+	/*!
+	  \brief Get the position of the last '/' of the file name, or
+	  std::string::npos if it has none, as found when the name was set.
+	  Returns false if it isn't known, or if the name needs to be
+	  sanitized before being split.
+	*/
+	inline bool get_name_separator(size_t& pos) const
+	{
+		if(!has_clean_name())
+		{
+			return false;
+		}
+		pos = m_name_sep == UINT32_MAX ? std::string::npos : m_name_sep;
+		return true;
+	}
+
+	/*!
+	  \brief Returns true if the name is known not to need sanitization.
+	*/
+	inline bool has_clean_name() const
+	{
+		return m_name_sep_len == m_name.size();
+	}
+
 	uint16_t get_serverport()
 	{
 		if(m_type == SCAP_FD_IPV4_SOCK)
@@ -282,6 +346,36 @@ public:
 	*/
 	scap_l4_proto get_l4proto();
 
+	/*!
+	  \brief Returns the application protocol of this FD, as classified from
+	  its first buffers. The sockets are only classified while some protocol
+	  decoder is registered for a protocol (see
+	  sinsp_protodecoder::register_protocol_callback).
+	*/
+	inline sinsp_l7_proto get_l7proto() const
+	{
+		return (sinsp_l7_proto)m_l7proto;
+	}
+
+	/*!
+	  \brief Returns the state that the decoder of the protocol of this FD
+	  keeps for it, NULL if it has none.
+	*/
+	inline fd_protostate* get_protostate() const
+	{
+		return m_protostate;
+	}
+
+	/*!
+	  \brief Used by protocol decoders to attach their state to this FD,
+	  which takes ownership of it.
+	*/
+	inline void set_protostate(fd_protostate* state)
+	{
+		delete m_protostate;
+		m_protostate = state;
+	}
+
 	/*!
 	  \brief Used by protocol decoders to register callbacks related to this FD.
 	*/
@@ -336,9 +430,22 @@ public:
 		return (m_flags & FLAGS_IS_CLONED) == FLAGS_IS_CLONED;
 	}
 
-	scap_fd_type m_type; ///< The fd type, e.g. file, directory, IPv4 socket...
+	//
+	// The state read while parsing almost every event on the FD comes
+	// first, in a single cache line: its type, flags, protocol decoding
+	// state and socket tuple. The names follow in the next one.
+	//
+	alignas(SINSP_CACHE_LINE_SIZE) scap_fd_type m_type; ///< The fd type, e.g. file, directory, IPv4 socket...
 	uint32_t m_openflags; ///< If this FD is a file, the flags that were used when opening it. See the PPM_O_* definitions in driver/ppm_events_public.h.
-	
+VISIBILITY_PRIVATE
+	uint32_t m_flags;
+	// see get_l7proto(), and the number of buffers that matched no
+	// protocol so far
+	uint8_t m_l7proto;
+	uint8_t m_l7_attempts;
+	fd_callbacks_info* m_callbacks;
+public:
+
 	/*!
 	  \brief Socket-specific state.
 	  This is uninitialized (zero) for non-socket FDs.
@@ -346,9 +453,19 @@ public:
 	sinsp_sockinfo m_sockinfo = {};
 
 	std::string m_name; ///< Human readable rendering of this FD. For files, this is the full file name. For sockets, this is the tuple. And so on.
-	std::string m_name_raw; // Human readable rendering of this FD. See m_name, only used if fd is a file path. Path is kept "raw" with limited sanitization and without absolute path derivation.
 	std::string m_oldname; // The name of this fd at the beginning of event parsing. Used to detect name changes that result from parsing an event.
 
+	/*!
+	  \brief Human readable rendering of this FD, see m_name. Only set if
+	  the FD is a file path, which is kept "raw", with limited sanitization
+	  and without absolute path derivation.
+	*/
+	inline const std::string& get_name_raw() const
+	{
+		static const std::string empty;
+		return m_name_raw ? *m_name_raw : empty;
+	}
+
 	inline bool has_decoder_callbacks()
 	{
 		return (m_callbacks != NULL);
@@ -389,6 +506,18 @@ private:
 	void add_filename_raw(const char* rawpath);
 	void add_filename(const char* fullpath);
 
+	inline void set_name_raw(const std::string& name_raw)
+	{
+		if(m_name_raw)
+		{
+			*m_name_raw = name_raw;
+		}
+		else
+		{
+			m_name_raw.reset(new std::string(name_raw));
+		}
+	}
+
 public:
 	inline bool is_transaction() const
 	{
@@ -500,12 +629,22 @@ private:
 	}
 
 	T* m_usrstate;
-	uint32_t m_flags;
+
+	// Position of the last '/' of the names set by add_filename(),
+	// UINT32_MAX if there is none, valid while the name still has
+	// m_name_sep_len characters
+	uint32_t m_name_sep;
+	uint32_t m_name_sep_len;
+
 	uint32_t m_dev;
 	uint32_t m_mount_id;
 	uint64_t m_ino;
 
-	fd_callbacks_info* m_callbacks;
+	// see get_name_raw(), only allocated for the files
+	std::unique_ptr<std::string> m_name_raw;
+	fd_protostate* m_protostate;
+	// What the fd table accounted for this entry, not copied with it
+	uint32_t m_accounted_bytes;
 
 	friend class sinsp;
 	friend class sinsp_parser;
@@ -528,11 +667,20 @@ private:
 class sinsp_fdtable
 {
 public:
+	typedef std::function<bool(int64_t, const sinsp_fdinfo_t&)> const_visitor_t;
+	typedef std::function<bool(int64_t, sinsp_fdinfo_t&)> visitor_t;
+
 	sinsp_fdtable(sinsp* inspector);
+	sinsp_fdtable(const sinsp_fdtable& other);
+	~sinsp_fdtable();
+	sinsp_fdtable& operator=(const sinsp_fdtable& other);
 
 	inline sinsp_fdinfo_t* find(int64_t fd)
 	{
-		std::unordered_map<int64_t, sinsp_fdinfo_t>::iterator fdit;
+		if(m_lazy_load_pending)
+		{
+			lazy_load();
+		}
 
 		//
 		// Try looking up in our simple cache
@@ -548,9 +696,9 @@ public:
 		//
 		// Caching failed, do a real lookup
 		//
-		fdit = m_table.find(fd);
+		sinsp_fdinfo_t* fdinfo = find_ref(fd);
 
-		if(fdit == m_table.end())
+		if(fdinfo == NULL)
 		{
 	#ifdef GATHER_INTERNAL_STATS
 			m_inspector->m_stats.m_n_failed_fd_lookups++;
@@ -563,12 +711,29 @@ public:
 			m_inspector->m_stats.m_n_noncached_fd_lookups++;
 	#endif
 			m_last_accessed_fd = fd;
-			m_last_accessed_fdinfo = &(fdit->second);
-			lookup_device(&(fdit->second), fd);
-			return &(fdit->second);
+			m_last_accessed_fdinfo = fdinfo;
+			lookup_device(fdinfo, fd);
+			return fdinfo;
 		}
 	}
-	
+
+	// Start loading the fd ahead of a lookup (see
+	// sinsp::set_prefetch_distance). Only the densely stored fds are
+	// prefetched, finding the others would cost as much as the lookup
+	inline void prefetch(int64_t fd) const
+	{
+		if(m_lazy_load_pending || fd < 0 || fd >= MAX_DENSE_FD)
+		{
+			return;
+		}
+
+		uint64_t pg = ((uint64_t) fd) >> FDS_PER_PAGE_BITS;
+		if(pg < m_pages.size() && m_pages[pg])
+		{
+			SINSP_PREFETCH(m_pages[pg]->at(fd & (FDS_PER_PAGE - 1)));
+		}
+	}
+
 	// If the key is already present, overwrite the existing value and return false.
 	sinsp_fdinfo_t* add(int64_t fd, sinsp_fdinfo_t* fdinfo);
 	// If the key is present, returns true, otherwise returns false.
@@ -577,8 +742,25 @@ public:
 	size_t size();
 	void reset_cache();
 
+	// Visit all the fds in the table, in ascending order for the densely
+	// stored ones. The visit stops as soon as the callback returns false.
+	// The callback must not add or erase entries of the table.
+	bool const_loop(const_visitor_t callback) const;
+	bool loop(visitor_t callback);
+
+	// The fds of the table haven't been read yet (see sinsp::set_lazy_fd_scan),
+	// they are loaded as soon as the table is accessed
+	inline void set_lazy_load_pending()
+	{
+		m_lazy_load_pending = true;
+	}
+
+	inline bool is_lazy_load_pending() const
+	{
+		return m_lazy_load_pending;
+	}
+
 	sinsp* m_inspector;
-	std::unordered_map<int64_t, sinsp_fdinfo_t> m_table;
 
 	//
 	// Simple fd cache
@@ -588,5 +770,72 @@ public:
 	uint64_t m_tid;
 
 private:
+	//
+	// Fd numbers are mostly small and dense, so the ones below
+	// MAX_DENSE_FD are stored directly indexed by their number in
+	// fixed-size pages that are allocated lazily and never move, which
+	// keeps the returned pointers valid across insertions. Everything
+	// else (negative fds, huge fds, CANCELED_FD_NUMBER) goes in a
+	// regular hash table.
+	//
+	static const uint32_t FDS_PER_PAGE_BITS = 4;
+	static const uint32_t FDS_PER_PAGE = 1 << FDS_PER_PAGE_BITS;
+	static const int64_t MAX_DENSE_FD = 1 << 16;
+	// Pages kept by clear(), as almost every process uses those fds
+	static const uint32_t KEPT_PAGES = 2;
+
+	struct page
+	{
+		page(): m_used(0) {}
+		~page();
+		void clear();
+
+		inline sinsp_fdinfo_t* at(uint32_t slot)
+		{
+			return reinterpret_cast<sinsp_fdinfo_t*>(m_slots[slot]);
+		}
+
+		inline const sinsp_fdinfo_t* at(uint32_t slot) const
+		{
+			return reinterpret_cast<const sinsp_fdinfo_t*>(m_slots[slot]);
+		}
+
+		uint32_t m_used;
+		alignas(sinsp_fdinfo_t) unsigned char m_slots[FDS_PER_PAGE][sizeof(sinsp_fdinfo_t)];
+	};
+
+	inline sinsp_fdinfo_t* find_ref(int64_t fd)
+	{
+		if(fd >= 0 && fd < MAX_DENSE_FD)
+		{
+			uint64_t pg = ((uint64_t) fd) >> FDS_PER_PAGE_BITS;
+			uint32_t slot = fd & (FDS_PER_PAGE - 1);
+			if(pg < m_pages.size() && m_pages[pg] && (m_pages[pg]->m_used & (1u << slot)))
+			{
+				return m_pages[pg]->at(slot);
+			}
+			return NULL;
+		}
+
+		auto it = m_sparse.find(fd);
+		if(it == m_sparse.end())
+		{
+			return NULL;
+		}
+		return &(it->second);
+	}
+
+	sinsp_fdinfo_t* emplace(int64_t fd, const sinsp_fdinfo_t& fdinfo);
+	// Count the memory of an entry in the table and in sinsp::m_fd_memory
+	void account(sinsp_fdinfo_t* fdi);
+	void unaccount(const sinsp_fdinfo_t* fdi);
 	void lookup_device(sinsp_fdinfo_t* fdi, uint64_t fd);
+	void lazy_load() const;
+
+	std::vector<std::unique_ptr<page>> m_pages;
+	std::unordered_map<int64_t, sinsp_fdinfo_t> m_sparse;
+	size_t m_size;
+	// Accounted memory of the entries, see account()
+	uint64_t m_bytes;
+	mutable bool m_lazy_load_pending;
 };
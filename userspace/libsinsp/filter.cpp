@@ -30,6 +30,12 @@ limitations under the License.
 #endif
 
 #include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <type_traits>
 
 #include "sinsp.h"
 #include "sinsp_int.h"
@@ -41,17 +47,12 @@ limitations under the License.
 #include "filterchecks.h"
 #include "value_parser.h"
 #include "filter/parser.h"
+#include "filter/ppm_codes.h"
+#include "strsearch.h"
 #ifndef _WIN32
 #include "arpa/inet.h"
 #endif
 
-#ifndef _GNU_SOURCE
-//
-// Fallback implementation of memmem
-//
-void *memmem(const void *haystack, size_t haystacklen, const void *needle, size_t needlelen);
-#endif
-
 #ifdef _WIN32
 #pragma comment(lib, "Ws2_32.lib")
 #include <WinSock2.h>
@@ -159,18 +160,8 @@ bool flt_compare_string(cmpop op, char* operand1, char* operand2)
 		return (strcmp(operand1, operand2) != 0);
 	case CO_CONTAINS:
 		return (strstr(operand1, operand2) != NULL);
-    case CO_ICONTAINS:
-#ifdef _WIN32
-	{
-		std::string s1(operand1);
-		std::string s2(operand2);
-		std::transform(s1.begin(), s1.end(), s1.begin(), [](unsigned char c){ return std::tolower(c); });
-		std::transform(s2.begin(), s2.end(), s2.begin(), [](unsigned char c){ return std::tolower(c); });
-		return (strstr(s1.c_str(), s2.c_str()) != NULL);
-	}
-#else
-		return (strcasestr(operand1, operand2) != NULL);
-#endif
+	case CO_ICONTAINS:
+		return (libsinsp::strsearch::ifind(operand1, strlen(operand1), operand2, strlen(operand2)) != NULL);
 	case CO_BCONTAINS:
 		throw sinsp_exception("'bcontains' not supported for string filters");
 	case CO_STARTSWITH:
@@ -178,7 +169,7 @@ bool flt_compare_string(cmpop op, char* operand1, char* operand2)
 	case CO_BSTARTSWITH:
 		throw sinsp_exception("'bstartswith' not supported for string filters");
 	case CO_ENDSWITH:
-		return (sinsp_utils::endswith(operand1, operand2));
+		return (sinsp_utils::endswith(operand1, operand2, strlen(operand1), strlen(operand2)));
 	case CO_GLOB:
 		return sinsp_utils::glob_match(operand2, operand1);
 	case CO_LT:
@@ -205,11 +196,11 @@ bool flt_compare_buffer(cmpop op, char* operand1, char* operand2, uint32_t op1_l
 	case CO_NE:
 		return op1_len != op2_len || (memcmp(operand1, operand2, op1_len) != 0);
 	case CO_CONTAINS:
-		return (memmem(operand1, op1_len, operand2, op2_len) != NULL);
+		return (libsinsp::strsearch::find(operand1, op1_len, operand2, op2_len) != NULL);
 	case CO_ICONTAINS:
 		throw sinsp_exception("'icontains' not supported for buffer filters");
 	case CO_BCONTAINS:
-		return (memmem(operand1, op1_len, operand2, op2_len) != NULL);
+		return (libsinsp::strsearch::find(operand1, op1_len, operand2, op2_len) != NULL);
 	case CO_STARTSWITH:
 		return op2_len <= op1_len && (memcmp(operand1, operand2, op2_len) == 0);
 	case CO_BSTARTSWITH:
@@ -603,6 +594,36 @@ void sinsp_filter_check::set_inspector(sinsp* inspector)
 	m_inspector = inspector;
 }
 
+void sinsp_filter_check::rebind(sinsp* inspector)
+{
+	if(inspector == m_inspector)
+	{
+		return;
+	}
+
+	m_inspector = inspector;
+	if(m_extraction_cache_key.empty())
+	{
+		return;
+	}
+
+	// move to the same entry of the cache of the new inspector, if any
+	if(m_shared_extraction_cache != nullptr
+		&& m_cache_metrics == &m_shared_extraction_cache->m_metrics)
+	{
+		m_cache_metrics = NULL;
+	}
+	m_extraction_cache_entry = NULL;
+	m_shared_extraction_cache.reset();
+
+	auto cache = inspector != NULL ? inspector->get_filter_extraction_cache() : nullptr;
+	if(cache != nullptr)
+	{
+		std::string key = m_extraction_cache_key;
+		set_shared_extraction_cache(cache, key);
+	}
+}
+
 Json::Value sinsp_filter_check::rawval_to_json(uint8_t* rawval,
 					       ppm_param_type ptype,
 					       ppm_print_format print_format,
@@ -781,222 +802,162 @@ Json::Value sinsp_filter_check::rawval_to_json(uint8_t* rawval,
 	}
 }
 
+//
+// Integer conversions of rawval_to_string(), writing at buf without the
+// terminating NUL and returning the end. They give the same results as the
+// printf() conversions they replace: in octal and hex the values are
+// written as the unsigned type they are promoted to (P), e.g. an int8_t -1
+// as FFFFFFFF, and the padded decimals are 9 chars wide, sign included.
+//
+template<typename T, typename P = T>
+static inline char* int_to_chars(char* buf, T val, ppm_print_format print_format)
+{
+	typedef typename std::make_unsigned<P>::type U;
+	char tmp[24];
+	char* end;
+
+	switch(print_format)
+	{
+	case PF_OCT:
+		return std::to_chars(buf, buf + sizeof(tmp), (U)(P)val, 8).ptr;
+	case PF_HEX:
+		end = std::to_chars(buf, buf + sizeof(tmp), (U)(P)val, 16).ptr;
+		for(char* c = buf; c < end; c++)
+		{
+			if(*c >= 'a')
+			{
+				*c -= 'a' - 'A';
+			}
+		}
+		return end;
+	case PF_10_PADDED_DEC:
+	{
+		end = std::to_chars(tmp, tmp + sizeof(tmp), val).ptr;
+		char* digits = tmp;
+		int32_t width = 9;
+		if(*digits == '-')
+		{
+			*buf++ = '-';
+			digits++;
+			width--;
+		}
+		for(int32_t pad = width - (int32_t)(end - digits); pad > 0; pad--)
+		{
+			*buf++ = '0';
+		}
+		memcpy(buf, digits, end - digits);
+		return buf + (end - digits);
+	}
+	default:
+		return std::to_chars(buf, buf + sizeof(tmp), val).ptr;
+	}
+}
+
+// The print formats of the integers narrower than 64 bits
+static inline bool is_narrow_int_format(ppm_print_format print_format)
+{
+	return print_format == PF_OCT ||
+		print_format == PF_DEC ||
+		print_format == PF_ID ||
+		print_format == PF_HEX;
+}
+
 char* sinsp_filter_check::rawval_to_string(uint8_t* rawval,
 					   ppm_param_type ptype,
 					   ppm_print_format print_format,
 					   uint32_t len)
 {
-	char* prfmt;
+	char* end;
 
 	ASSERT(rawval != NULL);
 
 	switch(ptype)
 	{
 		case PT_INT8:
-			if(print_format == PF_OCT)
-			{
-				prfmt = (char*)"%" PRIo8;
-			}
-			else if(print_format == PF_DEC ||
-				print_format == PF_ID)
-			{
-				prfmt = (char*)"%" PRId8;
-			}
-			else if(print_format == PF_HEX)
-			{
-				prfmt = (char*)"%" PRIX8;
-			}
-			else
+			if(!is_narrow_int_format(print_format))
 			{
 				ASSERT(false);
 				return NULL;
 			}
 
-			snprintf(m_getpropertystr_storage,
-					 sizeof(m_getpropertystr_storage),
-					 prfmt, *(int8_t *)rawval);
+			end = int_to_chars<int8_t, int>(m_getpropertystr_storage, *(int8_t *)rawval, print_format);
+			*end = 0;
 			return m_getpropertystr_storage;
 		case PT_INT16:
-			if(print_format == PF_OCT)
-			{
-				prfmt = (char*)"%" PRIo16;
-			}
-			else if(print_format == PF_DEC ||
-				print_format == PF_ID)
-			{
-				prfmt = (char*)"%" PRId16;
-			}
-			else if(print_format == PF_HEX)
-			{
-				prfmt = (char*)"%" PRIX16;
-			}
-			else
+			if(!is_narrow_int_format(print_format))
 			{
 				ASSERT(false);
 				return NULL;
 			}
 
-			snprintf(m_getpropertystr_storage,
-					 sizeof(m_getpropertystr_storage),
-					 prfmt, *(int16_t *)rawval);
+			end = int_to_chars<int16_t, int>(m_getpropertystr_storage, *(int16_t *)rawval, print_format);
+			*end = 0;
 			return m_getpropertystr_storage;
 		case PT_INT32:
-			if(print_format == PF_OCT)
-			{
-				prfmt = (char*)"%" PRIo32;
-			}
-			else if(print_format == PF_DEC ||
-				print_format == PF_ID)
-			{
-				prfmt = (char*)"%" PRId32;
-			}
-			else if(print_format == PF_HEX)
-			{
-				prfmt = (char*)"%" PRIX32;
-			}
-			else
+			if(!is_narrow_int_format(print_format))
 			{
 				ASSERT(false);
 				return NULL;
 			}
 
-			snprintf(m_getpropertystr_storage,
-					 sizeof(m_getpropertystr_storage),
-					 prfmt, *(int32_t *)rawval);
+			end = int_to_chars<int32_t>(m_getpropertystr_storage, *(int32_t *)rawval, print_format);
+			*end = 0;
 			return m_getpropertystr_storage;
 		case PT_INT64:
 		case PT_PID:
 		case PT_ERRNO:
 		case PT_FD:
-			if(print_format == PF_OCT)
-			{
-				prfmt = (char*)"%" PRIo64;
-			}
-			else if(print_format == PF_DEC ||
-				print_format == PF_ID)
-			{
-				prfmt = (char*)"%" PRId64;
-			}
-			else if(print_format == PF_10_PADDED_DEC)
-			{
-				prfmt = (char*)"%09" PRId64;
-			}
-			else if(print_format == PF_HEX)
-			{
-				prfmt = (char*)"%" PRIX64;
-			}
-			else
-			{
-				prfmt = (char*)"%" PRId64;
-			}
-
-			snprintf(m_getpropertystr_storage,
-					 sizeof(m_getpropertystr_storage),
-					 prfmt, *(int64_t *)rawval);
+			// the other formats are written in decimal
+			end = int_to_chars<int64_t>(m_getpropertystr_storage, *(int64_t *)rawval, print_format);
+			*end = 0;
 			return m_getpropertystr_storage;
 		case PT_L4PROTO: // This can be resolved in the future
 		case PT_UINT8:
-			if(print_format == PF_OCT)
-			{
-				prfmt = (char*)"%" PRIo8;
-			}
-			else if(print_format == PF_DEC ||
-				print_format == PF_ID)
-			{
-				prfmt = (char*)"%" PRIu8;
-			}
-			else if(print_format == PF_HEX)
-			{
-				prfmt = (char*)"%" PRIu8;
-			}
-			else
+			if(!is_narrow_int_format(print_format))
 			{
 				ASSERT(false);
 				return NULL;
 			}
 
-			snprintf(m_getpropertystr_storage,
-					 sizeof(m_getpropertystr_storage),
-					 prfmt, *(uint8_t *)rawval);
+			// the narrow unsigned integers are written in decimal with PF_HEX
+			end = int_to_chars<uint8_t>(m_getpropertystr_storage, *(uint8_t *)rawval,
+						    print_format == PF_HEX ? PF_DEC : print_format);
+			*end = 0;
 			return m_getpropertystr_storage;
 		case PT_PORT: // This can be resolved in the future
 		case PT_UINT16:
-			if(print_format == PF_OCT)
-			{
-				prfmt = (char*)"%" PRIo16;
-			}
-			else if(print_format == PF_DEC ||
-				print_format == PF_ID)
-			{
-				prfmt = (char*)"%" PRIu16;
-			}
-			else if(print_format == PF_HEX)
-			{
-				prfmt = (char*)"%" PRIu16;
-			}
-			else
+			if(!is_narrow_int_format(print_format))
 			{
 				ASSERT(false);
 				return NULL;
 			}
 
-			snprintf(m_getpropertystr_storage,
-					 sizeof(m_getpropertystr_storage),
-					 prfmt, *(uint16_t *)rawval);
+			end = int_to_chars<uint16_t>(m_getpropertystr_storage, *(uint16_t *)rawval,
+						     print_format == PF_HEX ? PF_DEC : print_format);
+			*end = 0;
 			return m_getpropertystr_storage;
 		case PT_UINT32:
-			if(print_format == PF_OCT)
-			{
-				prfmt = (char*)"%" PRIo32;
-			}
-			else if(print_format == PF_DEC ||
-				print_format == PF_ID)
-			{
-				prfmt = (char*)"%" PRIu32;
-			}
-			else if(print_format == PF_HEX)
-			{
-				prfmt = (char*)"%" PRIu32;
-			}
-			else
+			if(!is_narrow_int_format(print_format))
 			{
 				ASSERT(false);
 				return NULL;
 			}
 
-			snprintf(m_getpropertystr_storage,
-					 sizeof(m_getpropertystr_storage),
-					 prfmt, *(uint32_t *)rawval);
+			end = int_to_chars<uint32_t>(m_getpropertystr_storage, *(uint32_t *)rawval,
+						     print_format == PF_HEX ? PF_DEC : print_format);
+			*end = 0;
 			return m_getpropertystr_storage;
 		case PT_UINT64:
 		case PT_RELTIME:
 		case PT_ABSTIME:
-			if(print_format == PF_OCT)
-			{
-				prfmt = (char*)"%" PRIo64;
-			}
-			else if(print_format == PF_DEC ||
-				print_format == PF_ID)
-			{
-				prfmt = (char*)"%" PRIu64;
-			}
-			else if(print_format == PF_10_PADDED_DEC)
-			{
-				prfmt = (char*)"%09" PRIu64;
-			}
-			else if(print_format == PF_HEX)
-			{
-				prfmt = (char*)"%" PRIX64;
-			}
-			else
+			if(!is_narrow_int_format(print_format) && print_format != PF_10_PADDED_DEC)
 			{
 				ASSERT(false);
 				return NULL;
 			}
 
-			snprintf(m_getpropertystr_storage,
-					 sizeof(m_getpropertystr_storage),
-					 prfmt, *(uint64_t *)rawval);
+			end = int_to_chars<uint64_t>(m_getpropertystr_storage, *(uint64_t *)rawval, print_format);
+			*end = 0;
 			return m_getpropertystr_storage;
 		case PT_CHARBUF:
 		case PT_FSPATH:
@@ -1036,27 +997,13 @@ char* sinsp_filter_check::rawval_to_string(uint8_t* rawval,
 				return (char*)"false";
 			}
 		case PT_IPV4ADDR:
-			snprintf(m_getpropertystr_storage,
-						sizeof(m_getpropertystr_storage),
-						"%" PRIu8 ".%" PRIu8 ".%" PRIu8 ".%" PRIu8,
-						rawval[0],
-						rawval[1],
-						rawval[2],
-						rawval[3]);
+			end = sinsp_utils::ipv4_to_chars(m_getpropertystr_storage, rawval);
+			*end = 0;
 			return m_getpropertystr_storage;
 		case PT_IPV6ADDR:
-		{
-			char address[INET6_ADDRSTRLEN];
-
-			if(NULL == inet_ntop(AF_INET6, rawval, address, INET6_ADDRSTRLEN))
-			{
-				strlcpy(address, "<NA>", INET6_ADDRSTRLEN);
-			}
-
-			strlcpy(m_getpropertystr_storage, address, sizeof(m_getpropertystr_storage));
-
+			end = sinsp_utils::ipv6_to_chars(m_getpropertystr_storage, rawval);
+			*end = 0;
 			return m_getpropertystr_storage;
-		}
 	        case PT_IPADDR:
 			if(len == sizeof(struct in_addr))
 			{
@@ -1113,6 +1060,159 @@ char* sinsp_filter_check::tostring(sinsp_evt* evt)
 	return rawval_to_string(m_extracted_values[0].ptr, m_field->m_type, m_field->m_print_format, m_extracted_values[0].len);
 }
 
+template<typename T>
+static inline void append_number(std::string& out, T val)
+{
+	char buf[32];
+	auto res = std::to_chars(buf, buf + sizeof(buf), val);
+	out.append(buf, res.ptr - buf);
+}
+
+static inline void append_ipv4(std::string& out, const uint8_t* addr)
+{
+	char buf[16];
+	out.append(buf, sinsp_utils::ipv4_to_chars(buf, addr) - buf);
+}
+
+static inline void append_ipv6(std::string& out, const uint8_t* addr)
+{
+	char buf[48];
+	out.append(buf, sinsp_utils::ipv6_to_chars(buf, addr) - buf);
+}
+
+bool sinsp_filter_check::tostring(sinsp_evt* evt, std::string& out)
+{
+	m_extracted_values.clear();
+	if(!extract_cached(evt, m_extracted_values))
+	{
+		return false;
+	}
+
+	if(m_field->m_flags & EPF_IS_LIST)
+	{
+		// Lists are rare in outputs, reuse the string conversion
+		char* str = tostring(evt);
+		if(str == NULL)
+		{
+			return false;
+		}
+
+		out += str;
+		return true;
+	}
+
+	uint8_t* rawval = m_extracted_values[0].ptr;
+	uint32_t len = m_extracted_values[0].len;
+	bool dec = m_field->m_print_format == PF_DEC || m_field->m_print_format == PF_ID;
+
+	switch(m_field->m_type)
+	{
+	case PT_INT8:
+		if(dec)
+		{
+			append_number(out, *(int8_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_INT16:
+		if(dec)
+		{
+			append_number(out, *(int16_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_INT32:
+		if(dec)
+		{
+			append_number(out, *(int32_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_INT64:
+	case PT_PID:
+	case PT_ERRNO:
+	case PT_FD:
+		if(dec)
+		{
+			append_number(out, *(int64_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_L4PROTO:
+	case PT_UINT8:
+		if(dec)
+		{
+			append_number(out, *(uint8_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_PORT:
+	case PT_UINT16:
+		if(dec)
+		{
+			append_number(out, *(uint16_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_UINT32:
+		if(dec)
+		{
+			append_number(out, *(uint32_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		if(dec)
+		{
+			append_number(out, *(uint64_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_CHARBUF:
+	case PT_FSPATH:
+	case PT_FSRELPATH:
+		out += (char*)rawval;
+		return true;
+	case PT_BYTEBUF:
+		out.append((char*)rawval, strnlen((char*)rawval, len));
+		return true;
+	case PT_BOOL:
+		out += (*(uint32_t*)rawval != 0) ? "true" : "false";
+		return true;
+	case PT_IPV4ADDR:
+		append_ipv4(out, rawval);
+		return true;
+	case PT_IPV6ADDR:
+		append_ipv6(out, rawval);
+		return true;
+	case PT_IPADDR:
+		if(len == sizeof(struct in_addr))
+		{
+			append_ipv4(out, rawval);
+			return true;
+		}
+		else if(len == sizeof(struct in6_addr))
+		{
+			append_ipv6(out, rawval);
+			return true;
+		}
+		break;
+	default:
+		break;
+	}
+
+	char* str = rawval_to_string(rawval, m_field->m_type, m_field->m_print_format, len);
+	if(str == NULL)
+	{
+		return false;
+	}
+
+	out += str;
+	return true;
+}
+
 Json::Value sinsp_filter_check::tojson(sinsp_evt* evt)
 {
 	uint32_t len;
@@ -1179,6 +1279,56 @@ int32_t sinsp_filter_check::parse_field_name(const char* str, bool alloc_state,
 	return max_fldlen;
 }
 
+// Reads a value of a type that CO_IN can compare as an integer. A nonzero len
+// must match the size of the type.
+static inline bool filter_value_to_int(ppm_param_type type, const void* val, uint32_t len, uint64_t* res)
+{
+	switch(type)
+	{
+	case PT_INT8:
+		if(len != 0 && len != sizeof(int8_t)) return false;
+		*res = (uint64_t)(int64_t)*(int8_t*)val;
+		return true;
+	case PT_INT16:
+		if(len != 0 && len != sizeof(int16_t)) return false;
+		*res = (uint64_t)(int64_t)*(int16_t*)val;
+		return true;
+	case PT_INT32:
+		if(len != 0 && len != sizeof(int32_t)) return false;
+		*res = (uint64_t)(int64_t)*(int32_t*)val;
+		return true;
+	case PT_INT64:
+		if(len != 0 && len != sizeof(int64_t)) return false;
+		*res = (uint64_t)*(int64_t*)val;
+		return true;
+	case PT_UINT8:
+		if(len != 0 && len != sizeof(uint8_t)) return false;
+		*res = *(uint8_t*)val;
+		return true;
+	case PT_UINT16:
+	case PT_PORT:
+		if(len != 0 && len != sizeof(uint16_t)) return false;
+		*res = *(uint16_t*)val;
+		return true;
+	case PT_UINT32:
+	case PT_IPV4ADDR:
+		if(len != 0 && len != sizeof(uint32_t)) return false;
+		*res = *(uint32_t*)val;
+		return true;
+	case PT_UINT64:
+		if(len != 0 && len != sizeof(uint64_t)) return false;
+		*res = *(uint64_t*)val;
+		return true;
+	case PT_IPADDR:
+		// only IPv4, IPv6 addresses stay in m_val_storages_members
+		if(len != sizeof(struct in_addr)) return false;
+		*res = *(uint32_t*)val;
+		return true;
+	default:
+		return false;
+	}
+}
+
 void sinsp_filter_check::add_filter_value(const char* str, uint32_t len, uint32_t i)
 {
 	size_t parsed_len;
@@ -1211,6 +1361,37 @@ void sinsp_filter_check::add_filter_value(const char* str, uint32_t len, uint32_
 	{
 		m_val_storages_paths.add_search_path(item);
 	}
+
+	// If the operator is CO_IN on a numeric or IPv4 field, also add the
+	// value to the integer set.
+	uint64_t ival;
+	if ((m_cmpop == CO_IN || m_cmpop == CO_INTERSECTS) &&
+		filter_value_to_int(m_field->m_type, filter_value_p(i), parsed_len, &ival))
+	{
+		m_val_storages_ints.insert(ival);
+	}
+
+	// If the operator is CO_IN on a network field, also add the value to
+	// the subnet trie.
+	if (m_cmpop == CO_IN &&
+		(m_field->m_type == PT_IPV4NET || m_field->m_type == PT_IPV6NET || m_field->m_type == PT_IPNET))
+	{
+		if(parsed_len == sizeof(ipv4net))
+		{
+			m_val_storages_nets.add(*(ipv4net*)filter_value_p(i));
+		}
+		else
+		{
+			m_val_storages_nets.add(*(ipv6net*)filter_value_p(i));
+		}
+	}
+
+	// If the operator is CO_GLOB, compile the pattern once
+	if (m_cmpop == CO_GLOB && i == 0 &&
+		(m_field->m_type == PT_CHARBUF || m_field->m_type == PT_FSPATH || m_field->m_type == PT_FSRELPATH))
+	{
+		m_glob_matcher.reset(new glob_matcher((char *) filter_value_p()));
+	}
 }
 
 size_t sinsp_filter_check::parse_filter_value(const char* str, uint32_t len, uint8_t *storage, uint32_t storage_len)
@@ -1315,8 +1496,77 @@ bool sinsp_filter_check::flt_compare(cmpop op, ppm_param_type type, std::vector<
 		op2_len);
 }
 
+bool sinsp_filter_check::can_search_patterns()
+{
+	if(m_field == NULL || (m_field->m_flags & EPF_IS_LIST))
+	{
+		return false;
+	}
+
+	switch(m_field->m_type)
+	{
+	case PT_CHARBUF:
+	case PT_FSPATH:
+	case PT_FSRELPATH:
+		return true;
+	default:
+		return false;
+	}
+}
+
+double sinsp_filter_check::get_extraction_cost()
+{
+	return 2;
+}
+
+double sinsp_filter_check::get_cost()
+{
+	double cost = get_extraction_cost();
+
+	// lists are compared value by value
+	if(m_field != NULL && (m_field->m_flags & EPF_IS_LIST))
+	{
+		cost *= 2;
+	}
+
+	switch(m_cmpop)
+	{
+	case CO_ICONTAINS:
+	case CO_GLOB:
+	case CO_PMATCH:
+		return cost * 2;
+	default:
+		return cost;
+	}
+}
+
+void sinsp_filter_check::set_search_patterns(const std::vector<std::pair<cmpop, std::string>>& patterns)
+{
+	ASSERT(can_search_patterns());
+	bool case_insensitive = !patterns.empty() && patterns[0].first == CO_ICONTAINS;
+	m_search_patterns.reset(new multi_search(case_insensitive));
+	for(const auto& p : patterns)
+	{
+		if((p.first == CO_ICONTAINS) != case_insensitive ||
+		   (p.first != CO_CONTAINS && p.first != CO_ICONTAINS && p.first != CO_STARTSWITH))
+		{
+			ASSERT(false);
+			m_search_patterns.reset();
+			throw sinsp_exception("filter error: can't search for pattern '" + p.second
+				+ "' with operator " + std::to_string(p.first));
+		}
+		m_search_patterns->add_pattern(p.second, p.first == CO_STARTSWITH);
+	}
+	m_search_patterns->build();
+}
+
 bool sinsp_filter_check::flt_compare(cmpop op, ppm_param_type type, void* operand1, uint32_t op1_len, uint32_t op2_len)
 {
+	if (m_search_patterns != nullptr)
+	{
+		return m_search_patterns->match((char *) operand1);
+	}
+
 	if (op == CO_IN || op == CO_PMATCH || op == CO_INTERSECTS)
 	{
 		// Certain filterchecks can't be done as a set
@@ -1327,6 +1577,16 @@ bool sinsp_filter_check::flt_compare(cmpop op, ppm_param_type type, void* operan
 		case PT_IPV4NET:
 		case PT_IPV6NET:
 		case PT_IPNET:
+			// With CO_IN, the networks are all in a subnet trie
+			if(op == CO_IN)
+			{
+				if(type == PT_IPV6NET || (type == PT_IPNET && op1_len == sizeof(struct in6_addr)))
+				{
+					return m_val_storages_nets.match(*(ipv6addr*)operand1);
+				}
+				return m_val_storages_nets.match(*(uint32_t*)operand1);
+			}
+			// fallthrough
 		case PT_SOCKADDR:
 		case PT_SOCKTUPLE:
 		case PT_FDLIST:
@@ -1362,6 +1622,13 @@ bool sinsp_filter_check::flt_compare(cmpop op, ppm_param_type type, void* operan
 				// against the set of rhs values. sinsp_filter_checks only extract a
 				// single value, so CO_INTERSECTS is really the same as CO_IN.
 
+				uint64_t ival;
+				if(!m_val_storages_ints.empty() &&
+				   filter_value_to_int(type, operand1, op1_len, &ival))
+				{
+					return m_val_storages_ints.contains(ival);
+				}
+
 				if(op1_len >= m_val_storages_min_size &&
 				   op1_len <= m_val_storages_max_size &&
 				   m_val_storages_members.find(item) != m_val_storages_members.end())
@@ -1381,6 +1648,11 @@ bool sinsp_filter_check::flt_compare(cmpop op, ppm_param_type type, void* operan
 			break;
 		}
 	}
+	else if (op == CO_GLOB && m_glob_matcher != nullptr &&
+		(type == PT_CHARBUF || type == PT_FSPATH || type == PT_FSRELPATH))
+	{
+		return m_glob_matcher->match((char *) operand1);
+	}
 	else
 	{
 		return (::flt_compare(op,
@@ -1402,7 +1674,7 @@ bool sinsp_filter_check::extract(sinsp_evt *evt, OUT std::vector<extract_value_t
 {
 	values.clear();
 	extract_value_t val;
-	val.ptr = extract(evt, &val.len, sanitize_string);
+	val.ptr = extract(evt, &val.len, sanitize_strings);
 	if (val.ptr != NULL)
 	{
 		values.push_back(val);
@@ -1430,7 +1702,7 @@ bool sinsp_filter_check::extract_cached(sinsp_evt *evt, OUT std::vector<extract_
 		if(en != m_extraction_cache_entry->m_evtnum)
 		{
 			m_extraction_cache_entry->m_evtnum = en;
-			extract(evt, m_extraction_cache_entry->m_res, sanitize_strings);
+			extract_timed(evt, m_extraction_cache_entry->m_res, sanitize_strings);
 		}
 		else
 		{
@@ -1446,12 +1718,94 @@ bool sinsp_filter_check::extract_cached(sinsp_evt *evt, OUT std::vector<extract_
 		return !m_extraction_cache_entry->m_res.empty();
 	}
 	else
+	{
+		return extract_timed(evt, values, sanitize_strings);
+	}
+}
+
+bool sinsp_filter_check::extract_timed(sinsp_evt *evt, OUT std::vector<extract_value_t>& values, bool sanitize_strings)
+{
+	if(m_profile_metrics == NULL || !m_profile_metrics->m_sampling)
 	{
 		return extract(evt, values, sanitize_strings);
 	}
+
+	auto start = std::chrono::steady_clock::now();
+	bool res = extract(evt, values, sanitize_strings);
+	m_profile_metrics->m_extract_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count();
+	return res;
+}
+
+void sinsp_filter_check::set_shared_extraction_cache(const std::shared_ptr<sinsp_filter_extraction_cache>& cache, const std::string& key)
+{
+	m_shared_extraction_cache = cache;
+	m_extraction_cache_key = key;
+	m_extraction_cache_entry = cache->get_entry(key);
+	if(m_cache_metrics == NULL)
+	{
+		m_cache_metrics = &cache->m_metrics;
+	}
+}
+
+check_extraction_cache_entry* sinsp_filter_extraction_cache::get_entry(const std::string& key)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto& entry = m_entries[key];
+	if(entry == nullptr)
+	{
+		entry.reset(new check_extraction_cache_entry());
+	}
+	return entry.get();
+}
+
+check_eval_cache_entry* sinsp_filter_eval_cache::get_entry(const std::string& key)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto& entry = m_entries[key];
+	if(entry == nullptr)
+	{
+		entry.reset(new check_eval_cache_entry());
+	}
+	return entry.get();
 }
 
 bool sinsp_filter_check::compare(gen_event *evt)
+{
+	if(m_profile_metrics != NULL && m_profile_metrics->sample())
+	{
+		return compare_sampled(evt);
+	}
+	return compare_cached(evt);
+}
+
+bool sinsp_filter_check::compare_sampled(gen_event *evt)
+{
+	// extract_cached() accounts the time of the extraction on its own
+	uint64_t extract_ns = m_profile_metrics->m_extract_ns;
+	m_profile_metrics->m_sampling = true;
+	auto start = std::chrono::steady_clock::now();
+	bool res;
+	try
+	{
+		res = compare_cached(evt);
+	}
+	catch(...)
+	{
+		m_profile_metrics->m_sampling = false;
+		throw;
+	}
+	uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count();
+	m_profile_metrics->m_sampling = false;
+
+	m_profile_metrics->m_num_sampled++;
+	extract_ns = m_profile_metrics->m_extract_ns - extract_ns;
+	m_profile_metrics->m_compare_ns += elapsed > extract_ns ? elapsed - extract_ns : 0;
+	return res;
+}
+
+bool sinsp_filter_check::compare_cached(gen_event *evt)
 {
 	m_hits++;
 	if(m_cache_metrics != NULL)
@@ -1513,12 +1867,128 @@ bool sinsp_filter_check::compare(sinsp_evt *evt)
 sinsp_filter::sinsp_filter(sinsp *inspector)
 {
 	m_inspector = inspector;
+	m_event_codes = libsinsp::events::all_event_set();
+	m_sc_codes = libsinsp::events::all_sc_set();
 }
 
 sinsp_filter::~sinsp_filter()
 {
 }
 
+static void set_check_inspector(gen_event_filter_check* chk,
+				sinsp* inspector,
+				const std::shared_ptr<sinsp_filter_eval_cache>& cache)
+{
+	auto expr = dynamic_cast<gen_event_filter_expression*>(chk);
+	if(expr != nullptr)
+	{
+		for(auto c : expr->m_checks)
+		{
+			set_check_inspector(c, inspector, cache);
+		}
+		return;
+	}
+
+	auto shared = dynamic_cast<sinsp_filter_shared_check*>(chk);
+	if(shared != nullptr)
+	{
+		shared->set_cache(cache);
+		set_check_inspector(shared->get_check(), inspector, cache);
+		return;
+	}
+
+	auto sinsp_check = dynamic_cast<sinsp_filter_check*>(chk);
+	if(sinsp_check != nullptr)
+	{
+		sinsp_check->rebind(inspector);
+	}
+}
+
+void sinsp_filter::set_inspector(sinsp* inspector)
+{
+	if(inspector == m_inspector)
+	{
+		return;
+	}
+
+	m_inspector = inspector;
+	set_check_inspector(m_filter,
+			    inspector,
+			    inspector != nullptr ? inspector->get_filter_eval_cache() : nullptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_shared_check implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_filter_shared_check::sinsp_filter_shared_check(
+		gen_event_filter_check* chk,
+		const std::shared_ptr<sinsp_filter_eval_cache>& cache,
+		const std::string& key)
+{
+	m_check = chk;
+	m_cache = cache;
+	m_key = key;
+	m_entry = cache->get_entry(key);
+}
+
+void sinsp_filter_shared_check::set_cache(const std::shared_ptr<sinsp_filter_eval_cache>& cache)
+{
+	if(cache == m_cache)
+	{
+		return;
+	}
+
+	// the entries of a cache refer to the event numbers of its inspector,
+	// so the result is never carried over
+	m_cache = cache != nullptr ? cache : std::make_shared<sinsp_filter_eval_cache>();
+	m_entry = m_cache->get_entry(m_key);
+}
+
+sinsp_filter_shared_check::~sinsp_filter_shared_check()
+{
+	delete m_check;
+}
+
+bool sinsp_filter_shared_check::compare(gen_event *evt)
+{
+	m_hits++;
+	m_cache->m_metrics.m_num_eval++;
+
+	uint64_t en = ((sinsp_evt *)evt)->get_num();
+	if(en != m_entry->m_evtnum)
+	{
+		// the event number is set last, in case compare() throws
+		m_entry->m_res = m_check->compare(evt);
+		m_entry->m_evtnum = en;
+	}
+	else
+	{
+		m_cache->m_metrics.m_num_eval_cache++;
+		m_cached++;
+	}
+
+	if(m_entry->m_res)
+	{
+		m_matched_true++;
+	}
+	return m_entry->m_res;
+}
+
+bool sinsp_filter_shared_check::extract(gen_event *evt, std::vector<extract_value_t>& values, bool sanitize_strings)
+{
+	return m_check->extract(evt, values, sanitize_strings);
+}
+
+void sinsp_filter_shared_check::reorder(bool use_profile, double& cost, double& pass)
+{
+	// the counters of the wrapped check miss the evaluations of the other filters
+	m_check->reorder(use_profile, cost, pass);
+	if(use_profile && m_hits > 0)
+	{
+		pass = (double) m_matched_true / m_hits;
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_compiler implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -1532,6 +2002,8 @@ sinsp_filter_compiler::sinsp_filter_compiler(
 	m_flt_str = fltstr;
 	m_flt_ast = NULL;
 	m_ttable_only = ttable_only;
+	m_flatten = false;
+	m_reorder = false;
 }
 
 sinsp_filter_compiler::sinsp_filter_compiler(
@@ -1544,6 +2016,8 @@ sinsp_filter_compiler::sinsp_filter_compiler(
 	m_flt_str = fltstr;
 	m_flt_ast = NULL;
 	m_ttable_only = ttable_only;
+	m_flatten = false;
+	m_reorder = false;
 }
 
 sinsp_filter_compiler::sinsp_filter_compiler(
@@ -1555,6 +2029,8 @@ sinsp_filter_compiler::sinsp_filter_compiler(
 	m_filter = NULL;
 	m_flt_ast = fltast;
 	m_ttable_only = ttable_only;
+	m_flatten = false;
+	m_reorder = false;
 }
 
 sinsp_filter* sinsp_filter_compiler::compile()
@@ -1589,6 +2065,9 @@ sinsp_filter* sinsp_filter_compiler::compile()
 	m_filter = new_sinsp_filter;
 	m_last_boolop = BO_NONE;
 	m_expect_values = false;
+	m_eval_cache = new_sinsp_filter->m_inspector != nullptr
+		? new_sinsp_filter->m_inspector->get_filter_eval_cache()
+		: nullptr;
 	try
 	{
 		m_flt_ast->accept(this);
@@ -1597,21 +2076,39 @@ sinsp_filter* sinsp_filter_compiler::compile()
 	{
 		delete new_sinsp_filter;
 		m_filter = NULL;
+		m_eval_cache.reset();
 		throw e;
 	}
 
+	// the event types this filter can match, used to dispatch events
+	new_sinsp_filter->m_event_codes = libsinsp::filter::ast::ppm_event_codes(m_flt_ast);
+	new_sinsp_filter->m_sc_codes = libsinsp::filter::ast::ppm_sc_codes(m_flt_ast);
+	new_sinsp_filter->m_fields = libsinsp::filter::ast::field_names(m_flt_ast);
+
+	if(m_reorder)
+	{
+		new_sinsp_filter->reorder();
+	}
+
+	if(m_flatten)
+	{
+		new_sinsp_filter->flatten();
+	}
+
 	// return compiled filter
 	m_filter = NULL;
+	m_eval_cache.reset();
 	return new_sinsp_filter;
 }
 
 void sinsp_filter_compiler::visit(const libsinsp::filter::ast::and_expr* e)
 {
 	m_pos = e->get_pos();
-	bool nested = m_last_boolop != BO_AND;
+	// with a shared evaluation cache, every subexpression gets its own entry
+	bool nested = m_last_boolop != BO_AND || m_eval_cache != nullptr;
 	if (nested)
 	{
-		m_filter->push_expression(m_last_boolop);
+		push_expression(e);
 		m_last_boolop = BO_NONE;
 	}
 	for (auto &c : e->children)
@@ -1625,18 +2122,74 @@ void sinsp_filter_compiler::visit(const libsinsp::filter::ast::and_expr* e)
 	}
 }
 
+// Returns true if e is a "contains", "icontains" or "startswith" check with a
+// single value. Such checks can be merged with their siblings having the same key.
+static bool get_search_pattern_key(const libsinsp::filter::ast::expr* e, std::string& key)
+{
+	auto chk = dynamic_cast<const libsinsp::filter::ast::binary_check_expr*>(e);
+	if (chk == nullptr
+		|| dynamic_cast<const libsinsp::filter::ast::value_expr*>(chk->value.get()) == nullptr)
+	{
+		return false;
+	}
+
+	if (chk->op == "icontains")
+	{
+		key = "i";
+	}
+	else if (chk->op == "contains" || chk->op == "startswith")
+	{
+		key = "s";
+	}
+	else
+	{
+		return false;
+	}
+	key += chk->field + "[" + chk->arg + "]";
+	return true;
+}
+
 void sinsp_filter_compiler::visit(const libsinsp::filter::ast::or_expr* e)
 {
 	m_pos = e->get_pos();
-	bool nested = m_last_boolop != BO_OR;
+	bool nested = m_last_boolop != BO_OR || m_eval_cache != nullptr;
 	if (nested)
 	{
-		m_filter->push_expression(m_last_boolop);
+		push_expression(e);
 		m_last_boolop = BO_NONE;
 	}
-	for (auto &c : e->children)
+
+	// group the children that can be evaluated with a single search
+	std::vector<std::string> keys(e->children.size());
+	std::map<std::string, std::vector<const libsinsp::filter::ast::binary_check_expr*>> patterns;
+	for (size_t i = 0; i < e->children.size(); i++)
 	{
-		c->accept(this);
+		if (get_search_pattern_key(e->children[i].get(), keys[i]))
+		{
+			patterns[keys[i]].push_back(
+				static_cast<const libsinsp::filter::ast::binary_check_expr*>(e->children[i].get()));
+		}
+	}
+
+	for (size_t i = 0; i < e->children.size(); i++)
+	{
+		if (!keys[i].empty() && patterns[keys[i]].size() > 1)
+		{
+			auto& group = patterns[keys[i]];
+			if (group[0] != e->children[i].get())
+			{
+				// already merged with the first check of its group
+				continue;
+			}
+			if (compile_search_patterns(group))
+			{
+				m_last_boolop = BO_OR;
+				continue;
+			}
+			// the field does not support it, evaluate all the checks on their own
+			group.resize(1);
+		}
+		e->children[i]->accept(this);
 		m_last_boolop = BO_OR;
 	}
 	if (nested)
@@ -1645,6 +2198,36 @@ void sinsp_filter_compiler::visit(const libsinsp::filter::ast::or_expr* e)
 	}
 }
 
+bool sinsp_filter_compiler::compile_search_patterns(
+		const std::vector<const libsinsp::filter::ast::binary_check_expr*>& checks)
+{
+	auto first = checks[0];
+	m_pos = first->get_pos();
+	std::string field = create_filtercheck_name(first->field, first->arg);
+	std::unique_ptr<gen_event_filter_check> check(create_filtercheck(field));
+	check->m_cmpop = str_to_cmpop(first->op);
+	check->m_boolop = m_last_boolop;
+	check->parse_field_name(field.c_str(), true, true);
+
+	auto search_check = dynamic_cast<sinsp_filter_check*>(check.get());
+	if (search_check == nullptr || !search_check->can_search_patterns())
+	{
+		return false;
+	}
+	check_ttable_only(field, check.get());
+	use_extraction_cache(field, check.get());
+
+	std::vector<std::pair<cmpop, std::string>> values;
+	for (auto c : checks)
+	{
+		values.push_back({str_to_cmpop(c->op),
+			static_cast<const libsinsp::filter::ast::value_expr*>(c->value.get())->value});
+	}
+	search_check->set_search_patterns(values);
+	m_filter->add_check(check.release());
+	return true;
+}
+
 void sinsp_filter_compiler::visit(const libsinsp::filter::ast::not_expr* e)
 {
 	m_pos = e->get_pos();
@@ -1660,11 +2243,12 @@ void sinsp_filter_compiler::visit(const libsinsp::filter::ast::unary_check_expr*
 	m_pos = e->get_pos();
 	std::string field = create_filtercheck_name(e->field, e->arg);
 	gen_event_filter_check *check = create_filtercheck(field);
-	m_filter->add_check(check);
+	add_check(e, check);
 	check_ttable_only(field, check);
 	check->m_cmpop = str_to_cmpop(e->op);
 	check->m_boolop = m_last_boolop;
 	check->parse_field_name(field.c_str(), true, true);
+	use_extraction_cache(field, check);
 }
 
 static void add_filtercheck_value(gen_event_filter_check *chk, size_t idx, const std::string& value)
@@ -1691,11 +2275,12 @@ void sinsp_filter_compiler::visit(const libsinsp::filter::ast::binary_check_expr
 	m_pos = e->get_pos();
 	std::string field = create_filtercheck_name(e->field, e->arg);
 	gen_event_filter_check *check = create_filtercheck(field);
-	m_filter->add_check(check);
+	add_check(e, check);
 	check_ttable_only(field, check);
 	check->m_cmpop = str_to_cmpop(e->op);
 	check->m_boolop = m_last_boolop;
 	check->parse_field_name(field.c_str(), true, true);
+	use_extraction_cache(field, check);
 
 	// Read the the the right-hand values of the filtercheck.
 	// For list-related operators ('in', 'intersects', 'pmatch'), the vector
@@ -1760,6 +2345,57 @@ gen_event_filter_check* sinsp_filter_compiler::create_filtercheck(std::string& f
 	return chk;
 }
 
+// Adds the check to the current expression. With a shared evaluation cache,
+// the check is wrapped so that its result is shared with the identical
+// subexpressions of the other filters.
+void sinsp_filter_compiler::add_check(const libsinsp::filter::ast::expr* e, gen_event_filter_check *check)
+{
+	if (m_eval_cache == nullptr)
+	{
+		m_filter->add_check(check);
+		return;
+	}
+
+	std::string key = (m_ttable_only ? "ttable:" : "") + libsinsp::filter::ast::as_string(e);
+	auto shared = new sinsp_filter_shared_check(check, m_eval_cache, key);
+	shared->m_boolop = m_last_boolop;
+	m_filter->add_check(shared);
+}
+
+void sinsp_filter_compiler::push_expression(const libsinsp::filter::ast::expr* e)
+{
+	if (m_eval_cache == nullptr)
+	{
+		m_filter->push_expression(m_last_boolop);
+		return;
+	}
+
+	auto expr = new gen_event_filter_expression();
+	expr->m_boolop = BO_NONE;
+	expr->m_parent = m_filter->m_curexpr;
+	add_check(e, expr);
+	m_filter->m_curexpr = expr;
+}
+
+void sinsp_filter_compiler::use_extraction_cache(const std::string& field, gen_event_filter_check *check)
+{
+	sinsp_filter_check* sinsp_check = dynamic_cast<sinsp_filter_check*>(check);
+	if (sinsp_check == nullptr
+		|| sinsp_check->m_inspector == nullptr
+		|| sinsp_check->m_extraction_cache_entry != NULL)
+	{
+		return;
+	}
+
+	auto cache = sinsp_check->m_inspector->get_filter_extraction_cache();
+	if (cache != nullptr)
+	{
+		// the same field name can be exported by more than one check class
+		std::string key = sinsp_check->get_fields()->m_name + ":" + field;
+		sinsp_check->set_shared_extraction_cache(cache, key);
+	}
+}
+
 void sinsp_filter_compiler::check_ttable_only(std::string& field, gen_event_filter_check *check)
 {
 	if(m_ttable_only)
@@ -1857,6 +2493,83 @@ cmpop sinsp_filter_compiler::str_to_cmpop(const std::string& str)
 	throw sinsp_exception("filter error: unrecognized comparison operator '" + std::string(str) + "'");
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_ruleset_compiler implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_filter_ruleset_compiler::sinsp_filter_ruleset_compiler(
+		std::shared_ptr<gen_event_filter_factory> factory,
+		uint32_t num_threads)
+{
+	m_factory = factory;
+	m_num_threads = num_threads;
+	m_flatten = false;
+	m_reorder = false;
+}
+
+std::vector<sinsp_filter_ruleset_compiler::result> sinsp_filter_ruleset_compiler::compile(
+		const std::vector<std::string>& filters)
+{
+	std::vector<result> results(filters.size());
+
+	// the filters are handed out one at a time, as their compilation
+	// costs can be very different
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		size_t i;
+		while((i = next.fetch_add(1)) < filters.size())
+		{
+			result& res = results[i];
+			libsinsp::filter::parser parser(filters[i]);
+			std::unique_ptr<libsinsp::filter::ast::expr> ast;
+			try
+			{
+				ast = parser.parse();
+			}
+			catch(const sinsp_exception& e)
+			{
+				res.m_error = "filter error at "
+					+ parser.get_pos().as_string() + ": " + e.what();
+				res.m_pos = parser.get_pos();
+				continue;
+			}
+
+			sinsp_filter_compiler compiler(m_factory, ast.get());
+			compiler.set_flatten(m_flatten);
+			compiler.set_reorder(m_reorder);
+			try
+			{
+				res.m_filter.reset(compiler.compile());
+			}
+			catch(const sinsp_exception& e)
+			{
+				res.m_error = e.what();
+				res.m_pos = compiler.get_pos();
+			}
+		}
+	};
+
+	size_t n_threads = m_num_threads;
+	if(n_threads == 0)
+	{
+		n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	n_threads = std::min(n_threads, filters.size());
+
+	std::vector<std::thread> threads;
+	for(size_t t = 1; t < n_threads; t++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+
+	return results;
+}
+
 
 sinsp_filter_factory::sinsp_filter_factory(sinsp *inspector,
 					   filter_check_list &available_checks)
@@ -17,6 +17,7 @@ limitations under the License.
 
 #pragma once
 
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -25,6 +26,7 @@ limitations under the License.
 #include "filter_check_list.h"
 #include "gen_filter.h"
 #include "filter/parser.h"
+#include "events/sinsp_events.h"
 
 /** @defgroup filter Filtering events
  * Filtering infrastructure.
@@ -40,13 +42,126 @@ public:
 	sinsp_filter(sinsp* inspector);
 	~sinsp_filter();
 
+	/*!
+	  \brief Returns the event codes for which the filter can be evaluated
+	  as true. This is computed by \ref sinsp_filter_compiler, filters built
+	  by hand can match any event.
+	*/
+	inline const libsinsp::events::set<ppm_event_code>& get_event_codes() const
+	{
+		return m_event_codes;
+	}
+
+	/*!
+	  \brief Returns the ppm_sc codes for which the filter can be evaluated
+	  as true, useful to configure the syscalls of interest of the drivers.
+	  This is computed by \ref sinsp_filter_compiler, filters built by hand
+	  can match any syscall.
+	*/
+	inline const libsinsp::events::set<ppm_sc_code>& get_sc_codes() const
+	{
+		return m_sc_codes;
+	}
+
+	/*!
+	  \brief Returns the names of the fields checked by the filter, used to
+	  know which parts of the state it relies on (see
+	  \ref libsinsp::events::minimal_sc_set). This is computed by
+	  \ref sinsp_filter_compiler and is empty for filters built by hand.
+	*/
+	inline const std::unordered_set<std::string>& get_fields() const
+	{
+		return m_fields;
+	}
+
+	/*!
+	  \brief Binds the filter to another inspector: the fields are extracted
+	  from its state, and the identical subexpressions and extractions are
+	  shared through its caches (see sinsp::set_filter_eval_cache() and
+	  sinsp::set_filter_extraction_cache()). This way a filter compiled once
+	  can be run on the events of several inspectors, binding it to the one
+	  of each event before running it, instead of compiling it for every
+	  inspector. Binding to the current inspector is a no-op.
+
+	  \note The checks keep the scratch state of the evaluations, so a filter
+	  can't be run by several threads at the same time.
+	*/
+	void set_inspector(sinsp* inspector);
+
+	inline sinsp* get_inspector() const
+	{
+		return m_inspector;
+	}
+
 private:
 	sinsp* m_inspector;
+	libsinsp::events::set<ppm_event_code> m_event_codes;
+	libsinsp::events::set<ppm_sc_code> m_sc_codes;
+	std::unordered_set<std::string> m_fields;
+
+	friend class sinsp_filter_compiler;
 
 	friend class sinsp_evt_formatter;
 };
 
 
+class check_eval_cache_entry;
+class sinsp_filter_eval_cache;
+
+/*!
+  \brief A subexpression that the compiler found in more than one filter
+  (see sinsp::set_filter_eval_cache()). Its result is stored in an entry of
+  the shared evaluation cache, so that it's evaluated once per event and
+  then reused by all the filters including it.
+*/
+class SINSP_PUBLIC sinsp_filter_shared_check : public gen_event_filter_check
+{
+public:
+	/*!
+	  \param chk The check or expression to evaluate, owned by this object
+	  \param cache The cache holding the result of chk
+	  \param key Identifies the subexpression in the cache
+	*/
+	sinsp_filter_shared_check(
+		gen_event_filter_check* chk,
+		const std::shared_ptr<sinsp_filter_eval_cache>& cache,
+		const std::string& key);
+	~sinsp_filter_shared_check();
+
+	int32_t parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering) override
+	{
+		return 0;
+	}
+
+	void add_filter_value(const char* str, uint32_t len, uint32_t i = 0) override
+	{
+		return;
+	}
+
+	bool compare(gen_event *evt) override;
+
+	bool extract(gen_event *evt, std::vector<extract_value_t>& values, bool sanitize_strings = true) override;
+
+	void reorder(bool use_profile, double& cost, double& pass) override;
+
+	inline gen_event_filter_check* get_check() const
+	{
+		return m_check;
+	}
+
+	/*!
+	  \brief Moves the result to the entry with the same key of another
+	  cache. Without a cache, the result is kept in a cache of its own.
+	*/
+	void set_cache(const std::shared_ptr<sinsp_filter_eval_cache>& cache);
+
+private:
+	gen_event_filter_check* m_check;
+	check_eval_cache_entry* m_entry;
+	std::shared_ptr<sinsp_filter_eval_cache> m_cache;
+	std::string m_key;
+};
+
 /*!
   \brief This is the class that compiles the filters.
 */
@@ -105,6 +220,22 @@ public:
 	*/
 	sinsp_filter* compile();
 
+	/*!
+		\brief If enabled, the filters built by compile() are flattened
+		into a linear program of checks (see gen_event_filter::flatten),
+		which is cheaper to evaluate than the filtercheck tree. Disabled
+		by default.
+	*/
+	void set_flatten(bool flatten) { m_flatten = flatten; }
+
+	/*!
+		\brief If enabled, compile() reorders the checks of the and/or
+		expressions of the filters by their estimated cost, cheapest first
+		(see gen_event_filter::reorder). The filters can be reordered again
+		later, using the hit counters collected at runtime. Disabled by default.
+	*/
+	void set_reorder(bool reorder) { m_reorder = reorder; }
+
 	std::shared_ptr<libsinsp::filter::ast::expr> get_filter_ast() { return m_internal_flt_ast; }
 
 	const libsinsp::filter::ast::pos_info& get_pos() const { return m_pos; }
@@ -117,13 +248,19 @@ private:
 	void visit(const libsinsp::filter::ast::list_expr*) override;
 	void visit(const libsinsp::filter::ast::unary_check_expr*) override;
 	void visit(const libsinsp::filter::ast::binary_check_expr*) override;
+	bool compile_search_patterns(const std::vector<const libsinsp::filter::ast::binary_check_expr*>& checks);
 	void check_ttable_only(std::string& field, gen_event_filter_check *check);
+	void use_extraction_cache(const std::string& field, gen_event_filter_check *check);
+	void add_check(const libsinsp::filter::ast::expr* e, gen_event_filter_check *check);
+	void push_expression(const libsinsp::filter::ast::expr* e);
 	cmpop str_to_cmpop(const std::string& str);
 	std::string create_filtercheck_name(const std::string& name, const std::string& arg);
 	gen_event_filter_check* create_filtercheck(std::string& field);
 
 	libsinsp::filter::ast::pos_info m_pos;
 	bool m_ttable_only;
+	bool m_flatten;
+	bool m_reorder;
 	bool m_expect_values;
 	boolop m_last_boolop;
 	std::string m_flt_str;
@@ -132,10 +269,70 @@ private:
 	std::shared_ptr<libsinsp::filter::ast::expr> m_internal_flt_ast;
 	const libsinsp::filter::ast::expr* m_flt_ast;
 	std::shared_ptr<gen_event_filter_factory> m_factory;
+	std::shared_ptr<sinsp_filter_eval_cache> m_eval_cache;
 
 	friend class sinsp_evt_formatter;
 };
 
+/*!
+  \brief Compiles a whole ruleset, parsing and compiling its filters on a
+  pool of threads. Each thread uses its own sinsp_filter_compiler, and the
+  results are returned in the order of the filters, so that the errors are
+  reported the same way no matter how the work was split.
+
+  \note The factory is shared by the threads: the sinsp filter factories
+  and their filter check lists can be used concurrently, custom factories
+  must be thread-safe as well.
+*/
+class SINSP_PUBLIC sinsp_filter_ruleset_compiler
+{
+public:
+	struct result
+	{
+		// The compiled filter, NULL if the compilation failed
+		std::unique_ptr<sinsp_filter> m_filter;
+
+		// The error of a failed compilation, as thrown by
+		// sinsp_filter_compiler::compile()
+		std::string m_error;
+
+		// The position of the error in the filter string
+		libsinsp::filter::ast::pos_info m_pos;
+	};
+
+	/*!
+		\param factory The filter factory used to build the filters
+		\param num_threads The number of threads compiling the filters,
+		0 to use one per core
+	*/
+	sinsp_filter_ruleset_compiler(
+		std::shared_ptr<gen_event_filter_factory> factory,
+		uint32_t num_threads = 0);
+
+	/*!
+		\brief See sinsp_filter_compiler::set_flatten()
+	*/
+	void set_flatten(bool flatten) { m_flatten = flatten; }
+
+	/*!
+		\brief See sinsp_filter_compiler::set_reorder()
+	*/
+	void set_reorder(bool reorder) { m_reorder = reorder; }
+
+	/*!
+		\brief Compiles the filters. The filters that fail to compile don't
+		prevent the others from being compiled.
+		\return One result per filter, in the same order
+	*/
+	std::vector<result> compile(const std::vector<std::string>& filters);
+
+private:
+	std::shared_ptr<gen_event_filter_factory> m_factory;
+	uint32_t m_num_threads;
+	bool m_flatten;
+	bool m_reorder;
+};
+
 /*@}*/
 
 class sinsp_filter_factory : public gen_event_filter_factory
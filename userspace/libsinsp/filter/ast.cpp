@@ -285,3 +285,26 @@ std::unique_ptr<expr> libsinsp::filter::ast::clone(const expr* e)
     e->accept(&visitor);
     return std::move(visitor.m_last_node);
 }
+
+std::unordered_set<std::string> libsinsp::filter::ast::field_names(const expr* e)
+{
+    struct field_names_visitor: public const_base_expr_visitor
+    {
+        std::unordered_set<std::string> m_fields;
+
+        using const_base_expr_visitor::visit;
+
+        void visit(const unary_check_expr* e) override
+        {
+            m_fields.insert(e->field);
+        }
+
+        void visit(const binary_check_expr* e) override
+        {
+            m_fields.insert(e->field);
+        }
+    } visitor;
+
+    e->accept(&visitor);
+    return std::move(visitor.m_fields);
+}
@@ -19,6 +19,7 @@ limitations under the License.
 
 #include <vector>
 #include <string>
+#include <unordered_set>
 #include <algorithm>
 #include <memory>
 #include "../sinsp_public.h"
@@ -518,6 +519,12 @@ std::string as_string(const ast::expr *e);
 */
 std::unique_ptr<expr> clone(const expr* e);
 
+/*!
+	\brief Return the names of all the fields checked by a filter AST,
+	without their arguments (e.g. "proc.aname" for "proc.aname[2]")
+*/
+std::unordered_set<std::string> field_names(const expr* e);
+
 }
 }
 }
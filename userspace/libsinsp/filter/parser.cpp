@@ -23,25 +23,159 @@ limitations under the License.
 #include "../utils.h"
 #include "../sinsp_exception.h"
 
-#include <re2/re2.h>
-
-// these follow the POSIX standard
-#define RGX_NOTBLANK            "(not[[:space:]]+)"
-#define RGX_IDENTIFIER          "([a-zA-Z]+[a-zA-Z0-9_]*)"
-#define RGX_FIELDNAME           "([a-zA-Z]+[a-zA-Z0-9_]*(\\.[a-zA-Z]+[a-zA-Z0-9_]*)+)"
-#define RGX_FIELDARGBARESTR     "([^][\"'[:space:]]+)"
-#define RGX_HEXNUM              "(0[xX][0-9a-zA-Z]+)"
-#define RGX_NUMBER              "([+\\-]?[0-9]+[\\.]?[0-9]*([eE][+\\-][0-9]+)?)"
-#define RGX_BARESTR             "([^()\"'[:space:]=,]+)"
-
-// using pre-compiled regex for better performance
-static re2::RE2 s_rgx_not_blank(RGX_NOTBLANK, re2::RE2::POSIX);
-static re2::RE2 s_rgx_identifier(RGX_IDENTIFIER, re2::RE2::POSIX);
-static re2::RE2 s_rgx_field_name(RGX_FIELDNAME, re2::RE2::POSIX);
-static re2::RE2 s_rgx_field_arg_barestr(RGX_FIELDARGBARESTR, re2::RE2::POSIX);
-static re2::RE2 s_rgx_hex_num(RGX_HEXNUM, re2::RE2::POSIX);
-static re2::RE2 s_rgx_num(RGX_NUMBER, re2::RE2::POSIX);
-static re2::RE2 s_rgx_barestr(RGX_BARESTR, re2::RE2::POSIX);
+// The tokens are scanned by hand, following the POSIX leftmost-longest
+// semantics of their regular expressions (see parser.h). Each scanner
+// returns the length of the token at the start of s, of at most n chars,
+// or 0 if there is none.
+
+// [[:space:]]
+static inline bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static inline bool is_alpha(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static inline bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline bool is_alnum(char c)
+{
+	return is_alpha(c) || is_digit(c);
+}
+
+// not[[:space:]]+
+static size_t scan_not_blank(const char* s, size_t n)
+{
+	if(n < 4 || strncmp(s, "not", 3) != 0 || !is_space(s[3]))
+	{
+		return 0;
+	}
+	size_t len = 4;
+	while(len < n && is_space(s[len]))
+	{
+		len++;
+	}
+	return len;
+}
+
+// [a-zA-Z]+[a-zA-Z0-9_]*
+static size_t scan_identifier(const char* s, size_t n)
+{
+	if(n == 0 || !is_alpha(s[0]))
+	{
+		return 0;
+	}
+	size_t len = 1;
+	while(len < n && (is_alnum(s[len]) || s[len] == '_'))
+	{
+		len++;
+	}
+	return len;
+}
+
+// [a-zA-Z]+[a-zA-Z0-9_]*(\.[a-zA-Z]+[a-zA-Z0-9_]*)+
+static size_t scan_field_name(const char* s, size_t n)
+{
+	size_t len = scan_identifier(s, n);
+	if(len == 0)
+	{
+		return 0;
+	}
+
+	bool dotted = false;
+	while(len < n && s[len] == '.')
+	{
+		size_t id = scan_identifier(s + len + 1, n - len - 1);
+		if(id == 0)
+		{
+			break;
+		}
+		len += 1 + id;
+		dotted = true;
+	}
+	return dotted ? len : 0;
+}
+
+// [^][\"'[:space:]]+
+static size_t scan_field_arg_bare_str(const char* s, size_t n)
+{
+	size_t len = 0;
+	while(len < n && s[len] != '[' && s[len] != ']' && s[len] != '"' && s[len] != '\''
+	      && !is_space(s[len]))
+	{
+		len++;
+	}
+	return len;
+}
+
+// 0[xX][0-9a-zA-Z]+
+static size_t scan_hex_num(const char* s, size_t n)
+{
+	if(n < 3 || s[0] != '0' || (s[1] != 'x' && s[1] != 'X') || !is_alnum(s[2]))
+	{
+		return 0;
+	}
+	size_t len = 3;
+	while(len < n && is_alnum(s[len]))
+	{
+		len++;
+	}
+	return len;
+}
+
+// [+\-]?[0-9]+[\.]?[0-9]*([eE][+\-][0-9]+)?
+static size_t scan_num(const char* s, size_t n)
+{
+	size_t len = 0;
+	if(len < n && (s[len] == '+' || s[len] == '-'))
+	{
+		len++;
+	}
+	if(len >= n || !is_digit(s[len]))
+	{
+		return 0;
+	}
+	while(len < n && is_digit(s[len]))
+	{
+		len++;
+	}
+	if(len < n && s[len] == '.')
+	{
+		len++;
+	}
+	while(len < n && is_digit(s[len]))
+	{
+		len++;
+	}
+	if(len + 2 < n && (s[len] == 'e' || s[len] == 'E')
+	   && (s[len + 1] == '+' || s[len + 1] == '-') && is_digit(s[len + 2]))
+	{
+		len += 3;
+		while(len < n && is_digit(s[len]))
+		{
+			len++;
+		}
+	}
+	return len;
+}
+
+// [^()\"'[:space:]=,]+
+static size_t scan_bare_str(const char* s, size_t n)
+{
+	size_t len = 0;
+	while(len < n && s[len] != '(' && s[len] != ')' && s[len] != '"' && s[len] != '\''
+	      && s[len] != '=' && s[len] != ',' && !is_space(s[len]))
+	{
+		len++;
+	}
+	return len;
+}
 
 using namespace std;
 using namespace libsinsp::filter;
@@ -240,7 +374,7 @@ std::unique_ptr<ast::expr> parser::parse_not()
 	bool is_not = false;
 	std::unique_ptr<ast::expr> child;
 	lex_blank();
-	while (lex_helper_rgx(s_rgx_not_blank))
+	while (lex_helper_scan(scan_not_blank))
 	{
 		is_not = !is_not;
 	}
@@ -449,27 +583,27 @@ bool parser::lex_blank()
 
 inline bool parser::lex_identifier()
 {
-	return lex_helper_rgx(s_rgx_identifier);
+	return lex_helper_scan(scan_identifier);
 }
 
 inline bool parser::lex_field_name()
 {
-	return lex_helper_rgx(s_rgx_field_name);
+	return lex_helper_scan(scan_field_name);
 }
 
 inline bool parser::lex_field_arg_bare_str()
 {
-	return lex_helper_rgx(s_rgx_field_arg_barestr);
+	return lex_helper_scan(scan_field_arg_bare_str);
 }
 
 inline bool parser::lex_hex_num()
 {
-	return lex_helper_rgx(s_rgx_hex_num);
+	return lex_helper_scan(scan_hex_num);
 }
 
 inline bool parser::lex_num()
 {
-	return lex_helper_rgx(s_rgx_num);
+	return lex_helper_scan(scan_num);
 }
 
 inline bool parser::lex_quoted_str()
@@ -500,7 +634,7 @@ inline bool parser::lex_quoted_str()
 
 inline bool parser::lex_bare_str()
 {
-	return lex_helper_rgx(s_rgx_barestr);
+	return lex_helper_scan(scan_bare_str);
 }
 
 inline bool parser::lex_unary_op()
@@ -523,12 +657,12 @@ inline bool parser::lex_list_op()
 	return lex_helper_str_list(binary_list_ops);
 }
 
-bool parser::lex_helper_rgx(const re2::RE2& rgx)
+bool parser::lex_helper_scan(size_t (*scan)(const char*, size_t))
 {
-	ASSERT(rgx.ok());
-	re2::StringPiece c(cursor(), m_input.size() - m_pos.idx);
-	if (re2::RE2::Consume(&c, rgx, &m_last_token))
+	size_t len = scan(cursor(), m_input.size() - m_pos.idx);
+	if (len > 0)
 	{
+		m_last_token.assign(cursor(), len);
 		update_pos(m_last_token, m_pos);
 		return true;
 	}
@@ -20,8 +20,6 @@ limitations under the License.
 #include "ast.h"
 #include <cstdint>
 
-namespace re2 { class RE2; };
-
 //
 // Context-free Grammar for Sinsp Filters
 //
@@ -57,7 +55,8 @@ namespace re2 { class RE2; };
 //                             | 'icontains ' | 'startswith ' | 'endswith '
 //     ListOperator        ::= 'intersects' | 'in' | 'pmatch' 
 // 
-// Tokens (Regular Expressions):
+// Tokens (Regular Expressions, matched leftmost-longest by hand-written
+// scanners):
 //     Identifier          ::= [a-zA-Z]+[a-zA-Z0-9_]*
 //     FieldName           ::= [a-zA-Z]+[a-zA-Z0-9_]*(\.[a-zA-Z]+[a-zA-Z0-9_]*)+
 //     FieldArgBareStr     ::= [^ \b\t\n\r\[\]"']+
@@ -146,7 +145,7 @@ private:
 	bool lex_num_op();
 	bool lex_str_op();
 	bool lex_list_op();
-	bool lex_helper_rgx(const re2::RE2& rgx);
+	bool lex_helper_scan(size_t (*scan)(const char*, size_t));
 	bool lex_helper_str(const std::string& str);
 	bool lex_helper_str_list(const std::vector<std::string>& list);
 	void depth_push();
@@ -15,6 +15,7 @@ limitations under the License.
 
 */
 
+#include <algorithm>
 #include <cstdint>
 
 #include "sinsp.h"
@@ -29,7 +30,8 @@ using namespace std;
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check_list implementation
 ///////////////////////////////////////////////////////////////////////////////
-filter_check_list::filter_check_list()
+filter_check_list::filter_check_list():
+	m_name_trie(1)
 {
 }
 
@@ -59,6 +61,42 @@ void filter_check_list::add_filter_check(sinsp_filter_check* filter_check)
 	}
 
 	m_check_list.push_back(filter_check);
+	index_field_names(m_check_list.size() - 1);
+}
+
+void filter_check_list::index_field_names(uint32_t check_idx)
+{
+	const filter_check_info& info = m_check_list[check_idx]->m_info;
+	for(int32_t j = 0; j < info.m_nfields; j++)
+	{
+		uint32_t node = 0;
+		for(const char* c = info.m_fields[j].m_name; *c != '\0'; c++)
+		{
+			uint32_t next = 0;
+			for(const auto& child : m_name_trie[node].m_children)
+			{
+				if(child.first == *c)
+				{
+					next = child.second;
+					break;
+				}
+			}
+
+			if(next == 0)
+			{
+				next = m_name_trie.size();
+				m_name_trie[node].m_children.emplace_back(*c, next);
+				m_name_trie.emplace_back();
+			}
+			node = next;
+		}
+
+		auto& checks = m_name_trie[node].m_checks;
+		if(checks.empty() || checks.back() != check_idx)
+		{
+			checks.push_back(check_idx);
+		}
+	}
 }
 
 void filter_check_list::get_all_fields(vector<const filter_check_info*>& list)
@@ -69,33 +107,91 @@ void filter_check_list::get_all_fields(vector<const filter_check_info*>& list)
 	}
 }
 
+bool filter_check_list::parse_fldname(sinsp_filter_check* chk,
+				      const string& name,
+				      sinsp* inspector,
+				      bool do_exact_check,
+				      sinsp_filter_check** res)
+{
+	chk->m_inspector = inspector;
+
+	int32_t fldnamelen = chk->parse_field_name(name.c_str(), false, true);
+
+	if(fldnamelen == -1)
+	{
+		return false;
+	}
+
+	if(do_exact_check && (int32_t)name.size() != fldnamelen)
+	{
+		*res = NULL;
+		return true;
+	}
+
+	*res = chk->allocate_new();
+	(*res)->set_inspector(inspector);
+	return true;
+}
+
 sinsp_filter_check* filter_check_list::new_filter_check_from_fldname(const string& name,
 								     sinsp* inspector,
 								     bool do_exact_check)
 {
-	for(auto *chk : m_check_list)
-	{
-		chk->m_inspector = inspector;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	sinsp_filter_check* res = NULL;
 
-		int32_t fldnamelen = chk->parse_field_name(name.c_str(), false, true);
+	//
+	// Collect the checks with a field name that is a prefix of name, and
+	// ask them in the order they were added
+	//
+	vector<uint32_t> candidates;
+	uint32_t node = 0;
+	for(size_t j = 0; ; j++)
+	{
+		const name_trie_node& n = m_name_trie[node];
+		candidates.insert(candidates.end(), n.m_checks.begin(), n.m_checks.end());
+		if(j == name.size())
+		{
+			break;
+		}
 
-		if(fldnamelen != -1)
+		node = 0;
+		for(const auto& child : n.m_children)
 		{
-			if(do_exact_check)
+			if(child.first == name[j])
 			{
-				if((int32_t)name.size() != fldnamelen)
-				{
-					goto field_not_found;
-				}
+				node = child.second;
+				break;
 			}
+		}
 
-			sinsp_filter_check* newchk = chk->allocate_new();
-			newchk->set_inspector(inspector);
-			return newchk;
+		if(node == 0)
+		{
+			break;
 		}
 	}
 
-field_not_found:
+	sort(candidates.begin(), candidates.end());
+	candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+	for(uint32_t idx : candidates)
+	{
+		if(parse_fldname(m_check_list[idx], name, inspector, do_exact_check, &res))
+		{
+			return res;
+		}
+	}
+
+	//
+	// Not found: give all the checks a chance, for the ones that
+	// handle some names in a custom way
+	//
+	for(auto *chk : m_check_list)
+	{
+		if(parse_fldname(chk, name, inspector, do_exact_check, &res))
+		{
+			return res;
+		}
+	}
 
 	//
 	// If you are implementing a new filter check and this point is reached,
@@ -132,6 +228,7 @@ sinsp_filter_check_list::sinsp_filter_check_list()
 	add_filter_check(new sinsp_filter_check_container());
 	add_filter_check(new sinsp_filter_check_fd());
 	add_filter_check(new sinsp_filter_check_syslog());
+	add_filter_check(new sinsp_filter_check_http());
 	add_filter_check(new sinsp_filter_check_utils());
 	add_filter_check(new sinsp_filter_check_fdlist());
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
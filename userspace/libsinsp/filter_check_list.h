@@ -17,7 +17,10 @@ limitations under the License.
 
 #pragma once
 
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 class sinsp_filter_check;
@@ -40,6 +43,35 @@ public:
 
 protected:
 	std::vector<sinsp_filter_check*> m_check_list;
+
+private:
+	//
+	// Trie of the field names of all the checks. A check can only parse a
+	// name starting with one of its field names, so walking the name down
+	// the trie gives the few checks worth asking, instead of all of them.
+	//
+	struct name_trie_node
+	{
+		std::vector<std::pair<char, uint32_t>> m_children;
+		// Indexes in m_check_list of the checks with a field whose
+		// name ends at this node
+		std::vector<uint32_t> m_checks;
+	};
+
+	void index_field_names(uint32_t check_idx);
+
+	//
+	// Returns true if chk parses the name, with the new check in *res,
+	// which is NULL if do_exact_check is set and the name doesn't end
+	// with the field
+	//
+	static bool parse_fldname(sinsp_filter_check* chk, const std::string& name, sinsp* inspector, bool do_exact_check, sinsp_filter_check** res);
+
+	std::vector<name_trie_node> m_name_trie;
+
+	// The lookups set up the checks of the list to parse the names, so
+	// the filters compiled on different threads take turns
+	std::mutex m_mutex;
 };
 
 //
@@ -0,0 +1,233 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <chrono>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "filter_ruleset.h"
+#include "strlcpy.h"
+
+sinsp_filter_ruleset::sinsp_filter_ruleset():
+	m_rules_by_type(PPM_EVENT_MAX)
+{
+}
+
+size_t sinsp_filter_ruleset::add(const std::string& name, std::unique_ptr<sinsp_filter> filter)
+{
+	if(filter == nullptr)
+	{
+		throw sinsp_exception("cannot add a null filter to the ruleset: " + name);
+	}
+
+	size_t idx = m_rules.size();
+	filter->get_event_codes().for_each([this, idx](ppm_event_code code)
+	{
+		m_rules_by_type[code].push_back(idx);
+		return true;
+	});
+	m_event_codes = m_event_codes.merge(filter->get_event_codes());
+	m_sc_codes = m_sc_codes.merge(filter->get_sc_codes());
+
+	if(m_rules.empty())
+	{
+		m_inspector = filter->get_inspector();
+	}
+	else if(filter->get_inspector() != m_inspector)
+	{
+		m_inspector = NULL;
+	}
+
+	m_rules.emplace_back();
+	m_rules.back().m_name = name;
+	m_rules.back().m_filter = std::move(filter);
+	set_profiling(m_rules.back());
+	return idx;
+}
+
+void sinsp_filter_ruleset::set_inspector(sinsp* inspector)
+{
+	for(auto& r : m_rules)
+	{
+		r.m_filter->set_inspector(inspector);
+	}
+	m_inspector = inspector;
+}
+
+bool sinsp_filter_ruleset::run(sinsp_evt* evt, std::vector<size_t>& matches)
+{
+	uint16_t type = evt->get_type();
+	bool matched = false;
+
+	if(evt->get_inspector() != m_inspector)
+	{
+		set_inspector(evt->get_inspector());
+	}
+
+	if(type >= m_rules_by_type.size())
+	{
+		return false;
+	}
+
+	for(size_t idx : m_rules_by_type[type])
+	{
+		rule& r = m_rules[idx];
+		if(m_sampling_ratio > 0 ? run_profiled(r, evt) : r.m_filter->run(evt))
+		{
+			matches.push_back(idx);
+			matched = true;
+		}
+	}
+	return matched;
+}
+
+bool sinsp_filter_ruleset::run_profiled(rule& r, sinsp_evt* evt)
+{
+	bool res;
+	r.m_num_eval++;
+	if(r.m_profile.sample())
+	{
+		auto start = std::chrono::steady_clock::now();
+		res = r.m_filter->run(evt);
+		r.m_profile.m_compare_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+		r.m_profile.m_num_sampled++;
+	}
+	else
+	{
+		res = r.m_filter->run(evt);
+	}
+
+	if(res)
+	{
+		r.m_num_match++;
+	}
+	return res;
+}
+
+static void get_leaf_checks(gen_event_filter_check* chk, std::vector<sinsp_filter_check*>& checks)
+{
+	auto expr = dynamic_cast<gen_event_filter_expression*>(chk);
+	if(expr != nullptr)
+	{
+		for(auto c : expr->m_checks)
+		{
+			get_leaf_checks(c, checks);
+		}
+		return;
+	}
+
+	auto shared = dynamic_cast<sinsp_filter_shared_check*>(chk);
+	if(shared != nullptr)
+	{
+		get_leaf_checks(shared->get_check(), checks);
+		return;
+	}
+
+	auto leaf = dynamic_cast<sinsp_filter_check*>(chk);
+	if(leaf != nullptr)
+	{
+		checks.push_back(leaf);
+	}
+}
+
+void sinsp_filter_ruleset::set_profiling(uint32_t sampling_ratio)
+{
+	m_sampling_ratio = sampling_ratio;
+	for(auto& r : m_rules)
+	{
+		set_profiling(r);
+	}
+}
+
+void sinsp_filter_ruleset::set_profiling(rule& r)
+{
+	if(m_sampling_ratio == 0)
+	{
+		for(auto c : r.m_checks)
+		{
+			c->m_profile_metrics = NULL;
+		}
+		return;
+	}
+
+	if(r.m_check_profiles.empty())
+	{
+		get_leaf_checks(r.m_filter->m_filter, r.m_checks);
+		for(size_t i = 0; i < r.m_checks.size(); i++)
+		{
+			r.m_check_profiles.emplace_back(new check_profile_metrics());
+		}
+	}
+
+	r.m_profile.m_sampling_ratio = m_sampling_ratio;
+	for(size_t i = 0; i < r.m_checks.size(); i++)
+	{
+		r.m_check_profiles[i]->m_sampling_ratio = m_sampling_ratio;
+		r.m_checks[i]->m_profile_metrics = r.m_check_profiles[i].get();
+	}
+}
+
+static void add_profile_stat(std::vector<scap_stats_v2>& stats, const std::string& name, uint64_t value)
+{
+	scap_stats_v2 stat;
+	strlcpy(stat.name, name.c_str(), STATS_NAME_MAX);
+	stat.flags = PPM_SCAP_STATS_RULES_PROFILE;
+	stat.type = STATS_VALUE_TYPE_U64;
+	stat.value.u64 = value;
+	stats.push_back(stat);
+}
+
+const scap_stats_v2* sinsp_filter_ruleset::get_profile_stats(uint32_t* nstats)
+{
+	m_profile_stats.clear();
+	for(auto& r : m_rules)
+	{
+		std::string prefix = "rules." + r.m_name;
+		add_profile_stat(m_profile_stats, prefix + ".evaluated", r.m_num_eval);
+		add_profile_stat(m_profile_stats, prefix + ".matched", r.m_num_match);
+		add_profile_stat(m_profile_stats, prefix + ".sampled", r.m_profile.m_num_sampled);
+		add_profile_stat(m_profile_stats, prefix + ".time_ns", r.m_profile.m_compare_ns);
+
+		for(size_t i = 0; i < r.m_checks.size(); i++)
+		{
+			auto chk = r.m_checks[i];
+			auto profile = r.m_check_profiles[i].get();
+			std::string check_prefix = prefix + ".checks." + std::to_string(i) + "." + chk->get_field_info()->m_name;
+			add_profile_stat(m_profile_stats, check_prefix + ".evaluated", chk->m_hits);
+			add_profile_stat(m_profile_stats, check_prefix + ".matched", chk->m_matched_true);
+			add_profile_stat(m_profile_stats, check_prefix + ".sampled", profile->m_num_sampled);
+			add_profile_stat(m_profile_stats, check_prefix + ".extract_ns", profile->m_extract_ns);
+			add_profile_stat(m_profile_stats, check_prefix + ".compare_ns", profile->m_compare_ns);
+		}
+	}
+
+	*nstats = m_profile_stats.size();
+	return m_profile_stats.data();
+}
+
+#ifdef GATHER_INTERNAL_STATS
+void sinsp_filter_ruleset::export_profile(internal_metrics::registry& registry)
+{
+	uint32_t nstats;
+	const scap_stats_v2* stats = get_profile_stats(&nstats);
+	for(uint32_t i = 0; i < nstats; i++)
+	{
+		registry.register_counter(internal_metrics::metric_name(stats[i].name, stats[i].name)).add(stats[i].value.u64);
+	}
+}
+#endif
@@ -0,0 +1,159 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "filter.h"
+#include "filterchecks.h"
+#include "events/sinsp_events.h"
+
+class sinsp_evt;
+
+/** @defgroup filter Filtering events
+ *  @{
+ */
+
+/*!
+  \brief A set of compiled filters indexed by event type.
+  Every event is evaluated only against the filters that can match its
+  type (see \ref sinsp_filter::get_event_codes), so callers don't have to
+  bucket their rules on their own.
+*/
+class SINSP_PUBLIC sinsp_filter_ruleset
+{
+public:
+	sinsp_filter_ruleset();
+
+	/*!
+	  \brief Adds a filter to the ruleset, taking ownership of it.
+	  \return the index of the filter, as reported by \ref run.
+	*/
+	size_t add(const std::string& name, std::unique_ptr<sinsp_filter> filter);
+
+	/*!
+	  \brief Evaluates the event against the filters that can match its type,
+	  in the order in which they were added. The filters are bound to the
+	  inspector of the event first, if it's not the one of the previous
+	  event, so that the same ruleset can be shared by several inspectors
+	  (see \ref sinsp_filter::set_inspector).
+	  \param matches the indexes of the matching filters are appended here.
+	  \return true if at least one filter matches.
+	*/
+	bool run(sinsp_evt* evt, std::vector<size_t>& matches);
+
+	/*!
+	  \brief Binds all the filters of the ruleset to the given inspector.
+	*/
+	void set_inspector(sinsp* inspector);
+
+	/*!
+	  \brief Returns the number of filters in the ruleset.
+	*/
+	inline size_t size() const
+	{
+		return m_rules.size();
+	}
+
+	/*!
+	  \brief Returns the name of the filter at index `idx`.
+	*/
+	inline const std::string& get_name(size_t idx) const
+	{
+		return m_rules[idx].m_name;
+	}
+
+	/*!
+	  \brief Returns the union of the event codes the filters can match.
+	*/
+	inline const libsinsp::events::set<ppm_event_code>& get_event_codes() const
+	{
+		return m_event_codes;
+	}
+
+	/*!
+	  \brief Returns the union of the ppm_sc codes the filters can match,
+	  which can be used as the syscalls of interest of the drivers
+	  (e.g. through `libsinsp::events::enforce_simple_sc_set`).
+	*/
+	inline const libsinsp::events::set<ppm_sc_code>& get_sc_codes() const
+	{
+		return m_sc_codes;
+	}
+
+	/*!
+	  \brief Enables the profiling of the filters of the ruleset, including
+	  the ones added later, and of each of their checks. The number of
+	  evaluations and matches is counted, and one evaluation out of
+	  sampling_ratio is timed. A sampling_ratio of 0 disables the profiling,
+	  and keeps the values collected so far.
+	*/
+	void set_profiling(uint32_t sampling_ratio);
+
+	/*!
+	  \brief Returns the profile of the filters as a buffer of
+	  \ref scap_stats_v2 metrics, flagged as PPM_SCAP_STATS_RULES_PROFILE.
+	  For each filter there are `rules.<name>.evaluated`, `.matched`,
+	  `.sampled` and `.time_ns`, the time spent by the sampled evaluations.
+	  For each check there are the same counters, named
+	  `rules.<name>.checks.<index>.<field>.*`, with the time split into
+	  `.extract_ns` and `.compare_ns`.
+	  \note The buffer is owned by the ruleset and valid until the next call.
+	*/
+	const scap_stats_v2* get_profile_stats(uint32_t* nstats);
+
+#ifdef GATHER_INTERNAL_STATS
+	/*!
+	  \brief Registers the metrics of get_profile_stats() as counters of the
+	  given registry, replacing the ones registered by a previous call.
+	*/
+	void export_profile(internal_metrics::registry& registry);
+#endif
+
+private:
+	struct rule
+	{
+		std::string m_name;
+		std::unique_ptr<sinsp_filter> m_filter;
+
+		// profiling, see set_profiling()
+		uint64_t m_num_eval = 0;
+		uint64_t m_num_match = 0;
+		check_profile_metrics m_profile;
+		std::vector<sinsp_filter_check*> m_checks;
+		std::vector<std::unique_ptr<check_profile_metrics>> m_check_profiles;
+	};
+
+	void set_profiling(rule& r);
+	bool run_profiled(rule& r, sinsp_evt* evt);
+
+	std::vector<rule> m_rules;
+	// indexes of the filters that can match every event type
+	std::vector<std::vector<size_t>> m_rules_by_type;
+	libsinsp::events::set<ppm_event_code> m_event_codes;
+	libsinsp::events::set<ppm_sc_code> m_sc_codes;
+	uint32_t m_sampling_ratio = 0;
+	std::vector<scap_stats_v2> m_profile_stats;
+	// the inspector the filters are bound to, NULL if they are not bound
+	// to the same one
+	sinsp* m_inspector = NULL;
+};
+
+/*@}*/
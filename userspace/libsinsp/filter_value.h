@@ -18,8 +18,11 @@ limitations under the License.
 #pragma once
 
 #include <string.h>
+#include <algorithm>
 #include <cstdint>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 // Used for CO_IN/CO_PMATCH filterchecks using PT_CHARBUFs to allow
 // for quick multi-value comparisons. Should also work for any
@@ -57,3 +60,58 @@ struct g_equal_to_membuf
 	}
 };
 
+// Used for CO_IN filterchecks on numeric, port and IPv4 address fields:
+// the values are compared as integers instead of memory buffers. Small
+// lists are kept sorted and binary searched, which beats hashing for a
+// few values; larger lists are hashed.
+class filter_int_set
+{
+public:
+	static constexpr size_t max_sorted_size = 64;
+
+	inline void insert(uint64_t val)
+	{
+		if(!m_hashed.empty())
+		{
+			m_hashed.insert(val);
+			return;
+		}
+
+		auto it = std::lower_bound(m_sorted.begin(), m_sorted.end(), val);
+		if(it != m_sorted.end() && *it == val)
+		{
+			return;
+		}
+		m_sorted.insert(it, val);
+
+		if(m_sorted.size() > max_sorted_size)
+		{
+			m_hashed.insert(m_sorted.begin(), m_sorted.end());
+			m_sorted.clear();
+			m_sorted.shrink_to_fit();
+		}
+	}
+
+	inline bool contains(uint64_t val) const
+	{
+		if(!m_hashed.empty())
+		{
+			return m_hashed.find(val) != m_hashed.end();
+		}
+		return std::binary_search(m_sorted.begin(), m_sorted.end(), val);
+	}
+
+	inline size_t size() const
+	{
+		return m_hashed.empty() ? m_sorted.size() : m_hashed.size();
+	}
+
+	inline bool empty() const
+	{
+		return size() == 0;
+	}
+
+private:
+	std::vector<uint64_t> m_sorted;
+	std::unordered_set<uint64_t> m_hashed;
+};
@@ -19,6 +19,7 @@ limitations under the License.
 #include <math.h>
 #ifndef _WIN32
 #include <algorithm>
+#include <charconv>
 #endif
 #include "sinsp.h"
 #include "sinsp_int.h"
@@ -494,6 +495,10 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 	//
 	if(m_field_id == TYPE_FDNUM)
 	{
+		if(evt->get_type() == PPME_IO_AGGREGATE_E)
+		{
+			RETURN_EXTRACT_PTR((int64_t*)evt->get_param(0)->m_val);
+		}
 		RETURN_EXTRACT_VAR(m_tinfo->m_lastevent_fd);
 	}
 
@@ -508,11 +513,7 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 
 		if(evt->get_type() == PPME_SOCKET_CONNECT_X)
 		{
-			sinsp_evt_param *parinfo;
-
-			parinfo = evt->get_param(0);
-			ASSERT(parinfo->m_len == sizeof(uint64_t));
-			int64_t retval = *(int64_t*)parinfo->m_val;
+			int64_t retval = evt->get_param(0)->as<int64_t>();
 
 			if(retval < 0)
 			{
@@ -530,7 +531,8 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 			m_tstr = m_fdinfo->m_name;
 		}
 
-		if(sanitize_strings)
+		// the names split by add_filename() are already clean
+		if(sanitize_strings && !m_fdinfo->has_clean_name())
 		{
 			sanitize_string(m_tstr);
 		}
@@ -560,6 +562,34 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 				return NULL;
 			}
 
+			size_t sep;
+			if(m_fdinfo->is_file() && m_fdinfo->get_name_separator(sep))
+			{
+				const std::string& name = m_fdinfo->m_name;
+				if(sep != string::npos && sep != 0)
+				{
+					if(sep < name.size() - 1)
+					{
+						m_tstr.assign(name, 0, sep);
+					}
+					else
+					{
+						m_tstr = name;
+					}
+				}
+				else
+				{
+					m_tstr = "/";
+				}
+
+				if(m_field_id == TYPE_CONTAINERDIRECTORY)
+				{
+					m_tstr = m_tinfo->m_container_id + ':' + m_tstr;
+				}
+
+				RETURN_EXTRACT_STRING(m_tstr);
+			}
+
 			m_tstr = m_fdinfo->m_name;
 			if(sanitize_strings)
 			{
@@ -602,6 +632,29 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 				return NULL;
 			}
 
+			size_t sep;
+			if(m_fdinfo->get_name_separator(sep))
+			{
+				const std::string& name = m_fdinfo->m_name;
+				if(sep != string::npos)
+				{
+					if(sep < name.size() - 1)
+					{
+						m_tstr.assign(name, sep + 1, string::npos);
+					}
+					else
+					{
+						m_tstr = name;
+					}
+				}
+				else
+				{
+					m_tstr = "/";
+				}
+
+				RETURN_EXTRACT_STRING(m_tstr);
+			}
+
 			m_tstr = m_fdinfo->m_name;
 			if(sanitize_strings)
 			{
@@ -1401,7 +1454,7 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 			return extract_from_null_fd(evt, len, sanitize_strings);
 		}
 
-		m_tstr = m_fdinfo->m_name_raw;
+		m_tstr = m_fdinfo->get_name_raw();
 		remove_duplicate_path_separators(m_tstr);
 		RETURN_EXTRACT_STRING(m_tstr);
 		}
@@ -1428,16 +1481,16 @@ bool sinsp_filter_check_fd::compare_ip(sinsp_evt *evt)
 		{
 			if(m_cmpop == CO_EQ || m_cmpop == CO_IN)
 			{
-				if(flt_compare(m_cmpop, PT_IPV4ADDR, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip) ||
-					flt_compare(m_cmpop, PT_IPV4ADDR, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip))
+				if(flt_compare(m_cmpop, PT_IPV4ADDR, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip, sizeof(uint32_t)) ||
+					flt_compare(m_cmpop, PT_IPV4ADDR, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip, sizeof(uint32_t)))
 				{
 					return true;
 				}
 			}
 			else if(m_cmpop == CO_NE)
 			{
-				if(flt_compare(m_cmpop, PT_IPV4ADDR, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip) &&
-					flt_compare(m_cmpop, PT_IPV4ADDR, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip))
+				if(flt_compare(m_cmpop, PT_IPV4ADDR, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip, sizeof(uint32_t)) &&
+					flt_compare(m_cmpop, PT_IPV4ADDR, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip, sizeof(uint32_t)))
 				{
 					return true;
 				}
@@ -1451,7 +1504,7 @@ bool sinsp_filter_check_fd::compare_ip(sinsp_evt *evt)
 		{
 			if(m_cmpop == CO_EQ || m_cmpop == CO_NE || m_cmpop == CO_IN)
 			{
-				return flt_compare(m_cmpop, PT_IPV4ADDR, &m_fdinfo->m_sockinfo.m_ipv4serverinfo.m_ip);
+				return flt_compare(m_cmpop, PT_IPV4ADDR, &m_fdinfo->m_sockinfo.m_ipv4serverinfo.m_ip, sizeof(uint32_t));
 			}
 			else
 			{
@@ -1462,16 +1515,16 @@ bool sinsp_filter_check_fd::compare_ip(sinsp_evt *evt)
 		{
 			if(m_cmpop == CO_EQ || m_cmpop == CO_IN)
 			{
-				if(flt_compare(m_cmpop, PT_IPV6ADDR, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip) ||
-					flt_compare(m_cmpop, PT_IPV6ADDR, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip))
+				if(flt_compare(m_cmpop, PT_IPV6ADDR, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip, sizeof(ipv6addr)) ||
+					flt_compare(m_cmpop, PT_IPV6ADDR, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip, sizeof(ipv6addr)))
 				{
 					return true;
 				}
 			}
 			else if(m_cmpop == CO_NE)
 			{
-				if(flt_compare(m_cmpop, PT_IPV6ADDR, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip) &&
-					flt_compare(m_cmpop, PT_IPV6ADDR, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip))
+				if(flt_compare(m_cmpop, PT_IPV6ADDR, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip, sizeof(ipv6addr)) &&
+					flt_compare(m_cmpop, PT_IPV6ADDR, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip, sizeof(ipv6addr)))
 				{
 					return true;
 				}
@@ -1485,7 +1538,7 @@ bool sinsp_filter_check_fd::compare_ip(sinsp_evt *evt)
 		{
 			if(m_cmpop == CO_EQ || m_cmpop == CO_NE || m_cmpop == CO_IN)
 			{
-				return flt_compare(m_cmpop, PT_IPV6ADDR, &m_fdinfo->m_sockinfo.m_ipv6serverinfo.m_ip);
+				return flt_compare(m_cmpop, PT_IPV6ADDR, &m_fdinfo->m_sockinfo.m_ipv6serverinfo.m_ip, sizeof(ipv6addr));
 			}
 			else
 			{
@@ -1507,6 +1560,25 @@ bool sinsp_filter_check_fd::compare_net(sinsp_evt *evt)
 	bool sip_cmp = false;
 	bool dip_cmp = false;
 
+	if(m_cmpop == CO_IN)
+	{
+		switch (m_fdinfo->m_type)
+		{
+		case SCAP_FD_IPV4_SERVSOCK:
+			return m_val_storages_nets.match(m_fdinfo->m_sockinfo.m_ipv4serverinfo.m_ip);
+		case SCAP_FD_IPV6_SERVSOCK:
+			return m_val_storages_nets.match(m_fdinfo->m_sockinfo.m_ipv6serverinfo.m_ip);
+		case SCAP_FD_IPV4_SOCK:
+			return m_val_storages_nets.match(m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip) ||
+				m_val_storages_nets.match(m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip);
+		case SCAP_FD_IPV6_SOCK:
+			return m_val_storages_nets.match(m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip) ||
+				m_val_storages_nets.match(m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip);
+		default:
+			return false;
+		}
+	}
+
 	switch (m_fdinfo->m_type)
 	{
 	case SCAP_FD_IPV4_SERVSOCK:
@@ -1811,6 +1883,20 @@ bool sinsp_filter_check_fd::extract_fd(sinsp_evt *evt)
 
 		// We'll check if fd is null below
 	}
+	else if(evt->get_type() == PPME_IO_AGGREGATE_E)
+	{
+		//
+		// The aggregates carry their fd, which is not the one of the
+		// last event of the thread (see sinsp_parser::reset())
+		//
+		m_tinfo = evt->get_thread_info();
+		if(m_tinfo == NULL)
+		{
+			return false;
+		}
+
+		m_fdinfo = evt->get_fd_info();
+	}
 	else
 	{
 		return false;
@@ -1840,13 +1926,10 @@ bool sinsp_filter_check_fd::compare(sinsp_evt *evt)
 	//
 	// Standard extract-based fields
 	//
-	uint32_t len = 0;
-	bool sanitize_strings = false;
-	// note: this uses the single-value extract because this filtercheck
-	// class does not support multi-valued extraction
-	uint8_t* extracted_val = extract(evt, &len, sanitize_strings);
-
-	if(extracted_val == NULL)
+	// note: this filtercheck class does not support multi-valued extraction,
+	// but extract_cached() lets the filters share the extracted value
+	m_extracted_values.clear();
+	if(!extract_cached(evt, m_extracted_values, false))
 	{
 		// optimization for *_NAME fields
 		// the first time we will call compare_domain, the next ones
@@ -1864,8 +1947,44 @@ bool sinsp_filter_check_fd::compare(sinsp_evt *evt)
 
 	return flt_compare(m_cmpop,
 			   m_info.m_fields[m_field_id].m_type,
-			   extracted_val,
-			   len);
+			   m_extracted_values[0].ptr,
+			   m_extracted_values[0].len);
+}
+
+bool sinsp_filter_check_fd::can_search_patterns()
+{
+	// the *_NAME fields may be compared with compare_domain()
+	switch(m_field_id)
+	{
+	case TYPE_CLIENTIP_NAME:
+	case TYPE_SERVERIP_NAME:
+	case TYPE_LIP_NAME:
+	case TYPE_RIP_NAME:
+		return false;
+	default:
+		return sinsp_filter_check::can_search_patterns();
+	}
+}
+
+double sinsp_filter_check_fd::get_extraction_cost()
+{
+	switch(m_field_id)
+	{
+	case TYPE_DIRECTORY:
+	case TYPE_FILENAME:
+	case TYPE_CONTAINERNAME:
+	case TYPE_CONTAINERDIRECTORY:
+		// built out of the fd name
+		return 4;
+	case TYPE_CLIENTIP_NAME:
+	case TYPE_SERVERIP_NAME:
+	case TYPE_LIP_NAME:
+	case TYPE_RIP_NAME:
+		// may be compared with resolved domain names
+		return 8;
+	default:
+		return sinsp_filter_check::get_extraction_cost();
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -2141,7 +2260,8 @@ int32_t sinsp_filter_check_thread::parse_field_name(const char* str, bool alloc_
 		//
 		if(alloc_state)
 		{
-			auto acc = m_inspector->m_thread_manager->dynamic_fields()->add_field<uint64_t>("_tmp_sinsp_filter_thread_totexectime");
+			m_thread_dyn_field_name = "_tmp_sinsp_filter_thread_totexectime";
+			auto acc = m_inspector->m_thread_manager->dynamic_fields()->add_field<uint64_t>(m_thread_dyn_field_name);
 			m_thread_dyn_field_accessor.reset(new libsinsp::state::dynamic_struct::field_accessor<uint64_t>(acc.new_accessor<uint64_t>()));
 		}
 
@@ -2159,7 +2279,8 @@ int32_t sinsp_filter_check_thread::parse_field_name(const char* str, bool alloc_
 	{
 		if(alloc_state)
 		{
-			auto acc = m_inspector->m_thread_manager->dynamic_fields()->add_field<uint64_t>("_tmp_sinsp_filter_thread_cpu");
+			m_thread_dyn_field_name = "_tmp_sinsp_filter_thread_cpu";
+			auto acc = m_inspector->m_thread_manager->dynamic_fields()->add_field<uint64_t>(m_thread_dyn_field_name);
 			m_thread_dyn_field_accessor.reset(new libsinsp::state::dynamic_struct::field_accessor<uint64_t>(acc.new_accessor<uint64_t>()));
 		}
 
@@ -2171,6 +2292,19 @@ int32_t sinsp_filter_check_thread::parse_field_name(const char* str, bool alloc_
 	}
 }
 
+void sinsp_filter_check_thread::rebind(sinsp* inspector)
+{
+	bool changed = inspector != m_inspector;
+	sinsp_filter_check::rebind(inspector);
+
+	// the thread storage of the value belongs to the thread table
+	if(changed && inspector != NULL && m_thread_dyn_field_accessor != nullptr)
+	{
+		auto acc = inspector->m_thread_manager->dynamic_fields()->add_field<uint64_t>(m_thread_dyn_field_name);
+		m_thread_dyn_field_accessor.reset(new libsinsp::state::dynamic_struct::field_accessor<uint64_t>(acc.new_accessor<uint64_t>()));
+	}
+}
+
 uint64_t sinsp_filter_check_thread::extract_exectime(sinsp_evt *evt)
 {
 	uint64_t res = 0;
@@ -2260,6 +2394,28 @@ inline bool should_extract_xid(int64_t xid)
 	return xid >= -1 && xid <= UINT32_MAX;
 }
 
+//
+// Returns the n-th ancestor of the process of tinfo, 0 being the process
+// itself, or NULL if it's not in the thread table
+//
+static sinsp_threadinfo* get_ancestor(sinsp_threadinfo* tinfo, int32_t n)
+{
+	sinsp_threadinfo* mt = tinfo->is_main_thread() ? tinfo : tinfo->get_main_thread();
+
+	if(mt == NULL || n <= 0)
+	{
+		return mt;
+	}
+
+	const std::vector<sinsp_threadinfo*>& ancestors = mt->get_ancestors();
+	if((size_t)n > ancestors.size())
+	{
+		return NULL;
+	}
+
+	return ancestors[n - 1];
+}
+
 uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings)
 {
 	*len = 0;
@@ -2298,7 +2454,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 			// Relying on the convention that a session id is the process id of the session leader
 			//
 			sinsp_threadinfo* sinfo =
-				m_inspector->get_thread_ref(tinfo->m_sid, false, true).get();
+				m_inspector->get_thread(tinfo->m_sid, false, true);
 
 			if(sinfo != NULL)
 			{
@@ -2342,7 +2498,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 			// Relying on the convention that a session id is the process id of the session leader
 			//
 			sinsp_threadinfo* sinfo =
-				m_inspector->get_thread_ref(tinfo->m_sid, false, true).get();
+				m_inspector->get_thread(tinfo->m_sid, false, true);
 
 			if(sinfo != NULL)
 			{
@@ -2386,7 +2542,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 			// Relying on the convention that a session id is the process id of the session leader
 			//
 			sinsp_threadinfo* sinfo =
-				m_inspector->get_thread_ref(tinfo->m_sid, false, true).get();
+				m_inspector->get_thread(tinfo->m_sid, false, true);
 
 			if(sinfo != NULL)
 			{
@@ -2438,38 +2594,13 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	case TYPE_ARGS:
 		{
 			m_tstr.clear();
-
-			uint32_t j;
-			uint32_t nargs = (uint32_t)tinfo->m_args.size();
-
-			for(j = 0; j < nargs; j++)
-			{
-				m_tstr += tinfo->m_args[j];
-				if(j < nargs -1)
-				{
-					m_tstr += ' ';
-				}
-			}
-
+			tinfo->m_args.join(m_tstr, ' ');
 			RETURN_EXTRACT_STRING(m_tstr);
 		}
 	case TYPE_ENV:
 		{
 			m_tstr.clear();
-
-			uint32_t j;
-			const auto& env = tinfo->get_env();
-			uint32_t nargs = (uint32_t)env.size();
-
-			for(j = 0; j < nargs; j++)
-			{
-				m_tstr += env[j];
-				if(j < nargs -1)
-				{
-					m_tstr += ' ';
-				}
-			}
-
+			tinfo->get_env_strvec().join(m_tstr, ' ');
 			RETURN_EXTRACT_STRING(m_tstr);
 		}
 	case TYPE_CMDLINE:
@@ -2480,18 +2611,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	case TYPE_EXELINE:
 		{
 			m_tstr = tinfo->get_exe() + " ";
-
-			uint32_t j;
-			uint32_t nargs = (uint32_t)tinfo->m_args.size();
-
-			for(j = 0; j < nargs; j++)
-			{
-				m_tstr += tinfo->m_args[j];
-				if(j < nargs -1)
-				{
-					m_tstr += ' ';
-				}
-			}
+			tinfo->m_args.join(m_tstr, ' ');
 
 			RETURN_EXTRACT_STRING(m_tstr);
 		}
@@ -2582,7 +2702,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	case TYPE_PNAME:
 		{
 			sinsp_threadinfo* ptinfo =
-				m_inspector->get_thread_ref(tinfo->m_ptid, false, true).get();
+				m_inspector->get_thread(tinfo->m_ptid, false, true);
 
 			if(ptinfo != NULL)
 			{
@@ -2597,7 +2717,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	case TYPE_PCMDLINE:
 		{
 			sinsp_threadinfo* ptinfo =
-				m_inspector->get_thread_ref(tinfo->m_ptid, false, true).get();
+				m_inspector->get_thread(tinfo->m_ptid, false, true);
 
 			if(ptinfo != NULL)
 			{
@@ -2611,63 +2731,22 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 		}
 		case TYPE_ACMDLINE:
 		{
-			sinsp_threadinfo* mt = NULL;
-
-			if(tinfo->is_main_thread())
-			{
-				mt = tinfo;
-			}
-			else
-			{
-				mt = tinfo->get_main_thread();
-
-				if(mt == NULL)
-				{
-					return NULL;
-				}
-			}
+			sinsp_threadinfo* mt = get_ancestor(tinfo, m_argid);
 
-			for(int32_t j = 0; j < m_argid; j++)
+			if(mt == NULL)
 			{
-				mt = mt->get_parent_thread();
-
-				if(mt == NULL)
-				{
-					return NULL;
-				}
+				return NULL;
 			}
 			sinsp_threadinfo::populate_cmdline(m_tstr, mt);
 			RETURN_EXTRACT_STRING(m_tstr);
 		}
 	case TYPE_APID:
 		{
-			sinsp_threadinfo* mt = NULL;
+			sinsp_threadinfo* mt = get_ancestor(tinfo, m_argid);
 
-			if(tinfo->is_main_thread())
-			{
-				mt = tinfo;
-			}
-			else
+			if(mt == NULL)
 			{
-				mt = tinfo->get_main_thread();
-
-				if(mt == NULL)
-				{
-					return NULL;
-				}
-			}
-
-			//
-			// Search for a specific ancestors
-			//
-			for(int32_t j = 0; j < m_argid; j++)
-			{
-				mt = mt->get_parent_thread();
-
-				if(mt == NULL)
-				{
-					return NULL;
-				}
+				return NULL;
 			}
 			
 			if (!should_extract_xid(mt->m_pid))
@@ -2678,30 +2757,11 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 		}
 	case TYPE_ANAME:
 		{
-			sinsp_threadinfo* mt = NULL;
-
-			if(tinfo->is_main_thread())
-			{
-				mt = tinfo;
-			}
-			else
-			{
-				mt = tinfo->get_main_thread();
-
-				if(mt == NULL)
-				{
-					return NULL;
-				}
-			}
+			sinsp_threadinfo* mt = get_ancestor(tinfo, m_argid);
 
-			for(int32_t j = 0; j < m_argid; j++)
+			if(mt == NULL)
 			{
-				mt = mt->get_parent_thread();
-
-				if(mt == NULL)
-				{
-					return NULL;
-				}
+				return NULL;
 			}
 
 			m_tstr = mt->get_comm();
@@ -2710,7 +2770,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	case TYPE_PEXE:
 		{
 			sinsp_threadinfo* ptinfo =
-				m_inspector->get_thread_ref(tinfo->m_ptid, false, true).get();
+				m_inspector->get_thread(tinfo->m_ptid, false, true);
 
 			if(ptinfo != NULL)
 			{
@@ -2724,30 +2784,11 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 		}
 	case TYPE_AEXE:
 		{
-			sinsp_threadinfo* mt = NULL;
-
-			if(tinfo->is_main_thread())
-			{
-				mt = tinfo;
-			}
-			else
-			{
-				mt = tinfo->get_main_thread();
-
-				if(mt == NULL)
-				{
-					return NULL;
-				}
-			}
+			sinsp_threadinfo* mt = get_ancestor(tinfo, m_argid);
 
-			for(int32_t j = 0; j < m_argid; j++)
+			if(mt == NULL)
 			{
-				mt = mt->get_parent_thread();
-
-				if(mt == NULL)
-				{
-					return NULL;
-				}
+				return NULL;
 			}
 
 			m_tstr = mt->get_exe();
@@ -2756,7 +2797,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	case TYPE_PEXEPATH:
 		{
 			sinsp_threadinfo* ptinfo =
-				m_inspector->get_thread_ref(tinfo->m_ptid, false, true).get();
+				m_inspector->get_thread(tinfo->m_ptid, false, true);
 
 			if(ptinfo != NULL)
 			{
@@ -2770,30 +2811,11 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 		}
 	case TYPE_AEXEPATH:
 		{
-			sinsp_threadinfo* mt = NULL;
+			sinsp_threadinfo* mt = get_ancestor(tinfo, m_argid);
 
-			if(tinfo->is_main_thread())
-			{
-				mt = tinfo;
-			}
-			else
+			if(mt == NULL)
 			{
-				mt = tinfo->get_main_thread();
-
-				if(mt == NULL)
-				{
-					return NULL;
-				}
-			}
-
-			for(int32_t j = 0; j < m_argid; j++)
-			{
-				mt = mt->get_parent_thread();
-
-				if(mt == NULL)
-				{
-					return NULL;
-				}
+				return NULL;
 			}
 
 			m_tstr = mt->get_exepath();
@@ -2852,7 +2874,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	case TYPE_PPID_DURATION:
 		{
 			sinsp_threadinfo* ptinfo =
-				m_inspector->get_thread_ref(tinfo->m_ptid, false, true).get();
+				m_inspector->get_thread(tinfo->m_ptid, false, true);
 
 			if(ptinfo != NULL)
 			{
@@ -2939,7 +2961,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	case TYPE_CGROUPS:
 		{
 			m_tstr.clear();
-			auto cgroups = tinfo->cgroups();
+			const auto& cgroups = tinfo->cgroups();
 
 			uint32_t j;
 			uint32_t nargs = (uint32_t)cgroups.size();
@@ -2964,7 +2986,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 		}
 	case TYPE_CGROUP:
 		{
-			auto cgroups = tinfo->cgroups();
+			const auto& cgroups = tinfo->cgroups();
 			uint32_t nargs = (uint32_t)cgroups.size();
 
 			if(nargs == 0)
@@ -3109,7 +3131,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	case TYPE_PVPID:
 		{
 			sinsp_threadinfo* ptinfo =
-				m_inspector->get_thread_ref(tinfo->m_ptid, false, true).get();
+				m_inspector->get_thread(tinfo->m_ptid, false, true);
 
 			if(ptinfo != NULL)
 			{
@@ -3166,7 +3188,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	case TYPE_PPID_CLONE_TS:
 		{
 			sinsp_threadinfo* ptinfo =
-				m_inspector->get_thread_ref(tinfo->m_ptid, false, true).get();
+				m_inspector->get_thread(tinfo->m_ptid, false, true);
 
 			if(ptinfo != NULL)
 			{
@@ -3211,29 +3233,17 @@ bool sinsp_filter_check_thread::compare_full_apid(sinsp_evt *evt)
 	//
 	// No id specified, search in all of the ancestors
 	//
-	bool found = false;
-	sinsp_threadinfo::visitor_func_t visitor = [this, &found] (sinsp_threadinfo *pt)
+	for(sinsp_threadinfo* pt : mt->get_ancestors())
 	{
-		bool res;
-
-		res = flt_compare(m_cmpop,
-				  PT_PID,
-				  &pt->m_pid);
-
-		if(res == true)
+		if(flt_compare(m_cmpop,
+			       PT_PID,
+			       &pt->m_pid))
 		{
-			found = true;
-
-			// Can stop traversing parent state
-			return false;
+			return true;
 		}
+	}
 
-		return true;
-	};
-
-	mt->traverse_parent_state(visitor);
-
-	return found;
+	return false;
 }
 
 bool sinsp_filter_check_thread::compare_full_aname(sinsp_evt *evt)
@@ -3264,29 +3274,17 @@ bool sinsp_filter_check_thread::compare_full_aname(sinsp_evt *evt)
 	//
 	// No id specified, search in all of the ancestors
 	//
-	bool found = false;
-	sinsp_threadinfo::visitor_func_t visitor = [this, &found] (sinsp_threadinfo *pt)
+	for(sinsp_threadinfo* pt : mt->get_ancestors())
 	{
-		bool res;
-
-		res = flt_compare(m_cmpop,
-				  PT_CHARBUF,
-				  (void*)pt->m_comm.c_str());
-
-		if(res == true)
+		if(flt_compare(m_cmpop,
+			       PT_CHARBUF,
+			       (void*)pt->m_comm.c_str()))
 		{
-			found = true;
-
-			// Can stop traversing parent state
-			return false;
+			return true;
 		}
+	}
 
-		return true;
-	};
-
-	mt->traverse_parent_state(visitor);
-
-	return found;
+	return false;
 }
 
 bool sinsp_filter_check_thread::compare_full_aexe(sinsp_evt *evt)
@@ -3317,29 +3315,17 @@ bool sinsp_filter_check_thread::compare_full_aexe(sinsp_evt *evt)
 	//
 	// No id specified, search in all of the ancestors
 	//
-	bool found = false;
-	sinsp_threadinfo::visitor_func_t visitor = [this, &found] (sinsp_threadinfo *pt)
+	for(sinsp_threadinfo* pt : mt->get_ancestors())
 	{
-		bool res;
-
-		res = flt_compare(m_cmpop,
-				  PT_CHARBUF,
-				  (void*)pt->m_exe.c_str());
-
-		if(res == true)
+		if(flt_compare(m_cmpop,
+			       PT_CHARBUF,
+			       (void*)pt->m_exe.c_str()))
 		{
-			found = true;
-
-			// Can stop traversing parent state
-			return false;
+			return true;
 		}
+	}
 
-		return true;
-	};
-
-	mt->traverse_parent_state(visitor);
-
-	return found;
+	return false;
 }
 
 bool sinsp_filter_check_thread::compare_full_aexepath(sinsp_evt *evt)
@@ -3370,29 +3356,17 @@ bool sinsp_filter_check_thread::compare_full_aexepath(sinsp_evt *evt)
 	//
 	// No id specified, search in all of the ancestors
 	//
-	bool found = false;
-	sinsp_threadinfo::visitor_func_t visitor = [this, &found] (sinsp_threadinfo *pt)
+	for(sinsp_threadinfo* pt : mt->get_ancestors())
 	{
-		bool res;
-
-		res = flt_compare(m_cmpop,
-				  PT_CHARBUF,
-				  (void*)pt->m_exepath.c_str());
-
-		if(res == true)
+		if(flt_compare(m_cmpop,
+			       PT_CHARBUF,
+			       (void*)pt->m_exepath.c_str()))
 		{
-			found = true;
-
-			// Can stop traversing parent state
-			return false;
+			return true;
 		}
+	}
 
-		return true;
-	};
-
-	mt->traverse_parent_state(visitor);
-
-	return found;
+	return false;
 }
 
 bool sinsp_filter_check_thread::compare_full_acmdline(sinsp_evt *evt)
@@ -3423,31 +3397,20 @@ bool sinsp_filter_check_thread::compare_full_acmdline(sinsp_evt *evt)
 	//
 	// No id specified, search in all of the ancestors
 	//
-	bool found = false;
-	sinsp_threadinfo::visitor_func_t visitor = [this, &found] (sinsp_threadinfo *pt)
+	for(sinsp_threadinfo* pt : mt->get_ancestors())
 	{
-		bool res;
 		std::string cmdline;
 		sinsp_threadinfo::populate_cmdline(cmdline, pt);
 
-		res = flt_compare(m_cmpop,
-				  PT_CHARBUF,
-				  (void*)cmdline.c_str());
-
-		if(res == true)
+		if(flt_compare(m_cmpop,
+			       PT_CHARBUF,
+			       (void*)cmdline.c_str()))
 		{
-			found = true;
-
-			// Can stop traversing parent state
-			return false;
+			return true;
 		}
+	}
 
-		return true;
-	};
-
-	mt->traverse_parent_state(visitor);
-
-	return found;
+	return false;
 }
 
 bool sinsp_filter_check_thread::compare(sinsp_evt *evt)
@@ -3491,6 +3454,33 @@ bool sinsp_filter_check_thread::compare(sinsp_evt *evt)
 	return sinsp_filter_check::compare(evt);
 }
 
+double sinsp_filter_check_thread::get_extraction_cost()
+{
+	switch(m_field_id)
+	{
+	case TYPE_APID:
+	case TYPE_ANAME:
+	case TYPE_AEXE:
+	case TYPE_AEXEPATH:
+	case TYPE_ACMDLINE:
+		// without an argument, these walk all the ancestors
+		return (m_argid == -1) ? 16 : 2 + m_argid;
+	case TYPE_PEXE:
+	case TYPE_PEXEPATH:
+	case TYPE_PNAME:
+	case TYPE_PCMDLINE:
+		return 3;
+	case TYPE_CMDLINE:
+	case TYPE_EXELINE:
+	case TYPE_ENV:
+	case TYPE_CGROUPS:
+		// built by concatenating strings
+		return 4;
+	default:
+		return sinsp_filter_check::get_extraction_cost();
+	}
+}
+
 int32_t sinsp_filter_check_thread::get_argid()
 {
 	return m_argid;
@@ -3562,6 +3552,30 @@ Json::Value sinsp_filter_check_gen_event::extract_as_js(sinsp_evt *evt, OUT uint
 	return Json::nullValue;
 }
 
+//
+// The times of the events of the same second only differ by the
+// nanoseconds, which are the last 9 chars: they are replaced in place
+// instead of formatting the whole time again
+//
+void sinsp_filter_check_gen_event::time_to_string(uint64_t ts, bool date)
+{
+	uint64_t sec = ts / ONE_SECOND_IN_NS;
+	if(sec != m_strstorage_sec || m_strstorage.size() < 10)
+	{
+		sinsp_utils::ts_to_string(ts, &m_strstorage, date, true);
+		m_strstorage_sec = sec;
+		return;
+	}
+
+	uint32_t nsec = ts % ONE_SECOND_IN_NS;
+	char* digit = &m_strstorage[m_strstorage.size() - 1];
+	for(uint32_t j = 0; j < 9; j++)
+	{
+		*digit-- = '0' + nsec % 10;
+		nsec /= 10;
+	}
+}
+
 uint8_t* sinsp_filter_check_gen_event::extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings)
 {
 
@@ -3571,14 +3585,7 @@ uint8_t* sinsp_filter_check_gen_event::extract(sinsp_evt *evt, OUT uint32_t* len
 	switch(m_field_id)
 	{
 	case TYPE_TIME:
-		if(false)
-		{
-			m_strstorage = to_string(evt->get_ts());
-		}
-		else
-		{
-			sinsp_utils::ts_to_string(evt->get_ts(), &m_strstorage, false, true);
-		}
+		time_to_string(evt->get_ts(), false);
 		RETURN_EXTRACT_STRING(m_strstorage);
 	case TYPE_TIME_S:
 		sinsp_utils::ts_to_string(evt->get_ts(), &m_strstorage, false, false);
@@ -3587,7 +3594,7 @@ uint8_t* sinsp_filter_check_gen_event::extract(sinsp_evt *evt, OUT uint32_t* len
 		sinsp_utils::ts_to_iso_8601(evt->get_ts(), &m_strstorage);
 		RETURN_EXTRACT_STRING(m_strstorage);
 	case TYPE_DATETIME:
-		sinsp_utils::ts_to_string(evt->get_ts(), &m_strstorage, true, true);
+		time_to_string(evt->get_ts(), true);
 		RETURN_EXTRACT_STRING(m_strstorage);
 	case TYPE_DATETIME_S:
 		sinsp_utils::ts_to_string(evt->get_ts(), &m_strstorage, true, false);
@@ -3705,6 +3712,8 @@ const filtercheck_field_info sinsp_filter_check_event_fields[] =
 	{PT_CHARBUF, EPF_TABLE_ONLY, PF_NA, "evt.infra.docker.container.name", "Container Name", "for docker infrastructure events, the name of the impacted container."},
 	{PT_CHARBUF, EPF_TABLE_ONLY, PF_NA, "evt.infra.docker.container.image", "Container Image", "for docker infrastructure events, the image name of the impacted container."},
 	{PT_BOOL, EPF_NONE, PF_NA, "evt.is_open_exec", "Is Created With Execute Permissions", "'true' for open/openat/openat2 or creat events where a file is created with execute permissions"},
+	{PT_UINT32, EPF_NONE, PF_DEC, "evt.snaplen_limit", "Snaplen Limit", "for I/O events captured while the adaptive snaplen was limiting the driver buffer they went through, the snaplen limit that was applied: evt.buffer can be truncated to this length. Unset otherwise."},
+	{PT_UINT32, EPF_NONE, PF_DEC, "evt.repeat_count", "Repeat Count", "when the event coalescing is enabled, the number of events identical to this one, from the same thread, that were suppressed before it since the previous one was delivered."},
 };
 
 sinsp_filter_check_event::sinsp_filter_check_event()
@@ -4004,6 +4013,121 @@ uint8_t* extract_argraw(sinsp_evt *evt, OUT uint32_t* len, const char *argname)
 	}
 }
 
+int32_t sinsp_filter_check_event::get_argid(sinsp_evt *evt)
+{
+	if(m_argid != -1)
+	{
+		return m_argid;
+	}
+
+	//
+	// The names of the parameters only depend on the event type, so
+	// look them up once per type rather than for every event
+	//
+	uint16_t etype = evt->get_type();
+	if(etype >= m_argids.size())
+	{
+		m_argids.resize(etype + 1, -2);
+	}
+
+	if(m_argids[etype] == -2)
+	{
+		const ppm_event_info* info = &g_infotables.m_event_info[etype];
+		m_argids[etype] = -1;
+		for(uint32_t j = 0; j < info->nparams; j++)
+		{
+			if(m_argname == info->params[j].name)
+			{
+				m_argids[etype] = (int16_t)j;
+				break;
+			}
+		}
+	}
+
+	return m_argids[etype];
+}
+
+uint8_t* sinsp_filter_check_event::extract_argstr(sinsp_evt *evt, OUT uint32_t* len)
+{
+	const char* resolved_argstr;
+	const char* argstr;
+
+	ASSERT(m_inspector != NULL);
+
+	int32_t argid = get_argid(evt);
+	if(argid < 0 || argid >= (int32_t)evt->get_num_params())
+	{
+		return NULL;
+	}
+
+	//
+	// Plain numbers are rendered in decimal with no resolved string, so
+	// skip the generic rendering for them
+	//
+	const ppm_param_info* pinfo = evt->get_param_info(argid);
+	const sinsp_evt_param* param = evt->get_param(argid);
+	if(param->m_len != 0 &&
+	   pinfo->fmt != PF_OCT && pinfo->fmt != PF_HEX && pinfo->fmt != PF_10_PADDED_DEC)
+	{
+		int64_t val;
+		bool is_raw = true;
+
+		switch(pinfo->type)
+		{
+		case PT_INT8:
+			val = *(int8_t*)param->m_val;
+			break;
+		case PT_INT16:
+			val = *(int16_t*)param->m_val;
+			break;
+		case PT_INT32:
+			val = *(int32_t*)param->m_val;
+			break;
+		case PT_UINT8:
+			val = *(uint8_t*)param->m_val;
+			break;
+		case PT_UINT16:
+			val = *(uint16_t*)param->m_val;
+			break;
+		case PT_INT64:
+		case PT_UINT32:
+		case PT_UINT64:
+			// The unsigned 32 and 64 bit types are rendered as signed
+			val = pinfo->type == PT_UINT32 ? *(int32_t*)param->m_val : *(int64_t*)param->m_val;
+			break;
+		case PT_ERRNO:
+			// The negative ones resolve to the error name
+			val = *(int64_t*)param->m_val;
+			is_raw = val >= 0;
+			break;
+		default:
+			is_raw = false;
+			break;
+		}
+
+		if(is_raw)
+		{
+			char buf[32];
+			auto res = std::to_chars(buf, buf + sizeof(buf), val);
+			m_strstorage.assign(buf, res.ptr - buf);
+			m_num_argstr_raw++;
+			RETURN_EXTRACT_STRING(m_strstorage);
+		}
+	}
+
+	m_num_argstr_formatted++;
+	argstr = evt->get_param_as_str(argid, &resolved_argstr, m_inspector->get_buffer_format());
+
+	if(resolved_argstr != NULL && resolved_argstr[0] != 0)
+	{
+		RETURN_EXTRACT_CSTR(resolved_argstr);
+	}
+	else
+	{
+		RETURN_EXTRACT_CSTR(argstr);
+	}
+}
+
 uint8_t *sinsp_filter_check_event::extract_abspath(sinsp_evt *evt, OUT uint32_t *len)
 {
 	sinsp_evt_param *parinfo;
@@ -4050,9 +4174,7 @@ uint8_t *sinsp_filter_check_event::extract_abspath(sinsp_evt *evt, OUT uint32_t
 		//
 		// We can extract the file path only in case of a successful file opening (fd>0).
 		//
-		parinfo = evt->get_param(0);
-		ASSERT(parinfo->m_len == sizeof(int64_t));
-		fd = *(int64_t *)parinfo->m_val;
+		fd = evt->get_param(0)->as<int64_t>();
 
 		if(fd>0)
 		{
@@ -4192,9 +4314,7 @@ inline uint8_t* sinsp_filter_check_event::extract_buflen(sinsp_evt *evt, OUT uin
 		//
 		// Extract the return value
 		//
-		parinfo = evt->get_param(0);
-		ASSERT(parinfo->m_len == sizeof(int64_t));
-		retval = *(int64_t *)parinfo->m_val;
+		retval = evt->get_param(0)->as<int64_t>();
 
 		if(retval >= 0)
 		{
@@ -4646,40 +4766,25 @@ uint8_t* sinsp_filter_check_event::extract(sinsp_evt *evt, OUT uint32_t* len, bo
 		RETURN_EXTRACT_STRING(m_strstorage);
 	case TYPE_CPU:
 		RETURN_EXTRACT_VAR(evt->m_cpuid);
+	case TYPE_SNAPLEN_LIMIT:
+		if((evt->get_info_flags() & (EF_READS_FROM_FD | EF_WRITES_TO_FD)) == 0)
+		{
+			return NULL;
+		}
+		m_u32val = evt->get_snaplen_limit();
+		if(m_u32val == PPM_SNAPLEN_NO_LIMIT)
+		{
+			return NULL;
+		}
+		RETURN_EXTRACT_VAR(m_u32val);
+	case TYPE_REPEAT_COUNT:
+		m_u32val = evt->get_repeat_count();
+		RETURN_EXTRACT_VAR(m_u32val);
 	case TYPE_ARGRAW:
 		return extract_argraw(evt, len, m_arginfo->name);
 		break;
 	case TYPE_ARGSTR:
-		{
-			const char* resolved_argstr;
-			const char* argstr;
-
-			ASSERT(m_inspector != NULL);
-
-			if(m_argid != -1)
-			{
-				if(m_argid >= (int32_t)evt->get_num_params())
-				{
-					return NULL;
-				}
-
-				argstr = evt->get_param_as_str(m_argid, &resolved_argstr, m_inspector->get_buffer_format());
-			}
-			else
-			{
-				argstr = evt->get_param_value_str(m_argname.c_str(), &resolved_argstr, m_inspector->get_buffer_format());
-			}
-
-			if(resolved_argstr != NULL && resolved_argstr[0] != 0)
-			{
-				RETURN_EXTRACT_CSTR(resolved_argstr);
-			}
-			else
-			{
-				RETURN_EXTRACT_CSTR(argstr);
-			}
-		}
-		break;
+		return extract_argstr(evt, len);
 	case TYPE_INFO:
 		{
 			sinsp_fdinfo_t* fdinfo = evt->m_fdinfo;
@@ -5434,6 +5539,27 @@ bool sinsp_filter_check_event::compare(sinsp_evt *evt)
 	return res;
 }
 
+double sinsp_filter_check_event::get_extraction_cost()
+{
+	switch(m_field_id)
+	{
+	case TYPE_DIR:
+	case TYPE_TYPE:
+	case TYPE_TYPE_IS:
+	case TYPE_SYSCALL_TYPE:
+	case TYPE_CATEGORY:
+	case TYPE_CPU:
+		// read from the event header or the event table
+		return 1;
+	case TYPE_ARGS:
+	case TYPE_INFO:
+		// all the parameters are rendered
+		return 8;
+	default:
+		return sinsp_filter_check::get_extraction_cost();
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check_user implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -5476,7 +5602,7 @@ uint8_t* sinsp_filter_check_user::extract(sinsp_evt *evt, OUT uint32_t* len, boo
 	   (evt->get_type() == PPME_CONTAINER_JSON_E || evt->get_type() == PPME_CONTAINER_JSON_2_E))
 	{
 		const sinsp_container_info::ptr_t container_info =
-			m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+			m_inspector->m_container_manager.get_container(tinfo);
 
 		if(!container_info)
 		{
@@ -5489,17 +5615,17 @@ uint8_t* sinsp_filter_check_user::extract(sinsp_evt *evt, OUT uint32_t* len, boo
 	switch(m_field_id)
 	{
 	case TYPE_UID:
-		RETURN_EXTRACT_VAR(tinfo->m_user.uid);
+		RETURN_EXTRACT_VAR(tinfo->get_user()->uid);
 	case TYPE_NAME:
-		RETURN_EXTRACT_CSTR(tinfo->m_user.name);
+		RETURN_EXTRACT_CSTR(tinfo->get_user()->name);
 	case TYPE_HOMEDIR:
-		RETURN_EXTRACT_CSTR(tinfo->m_user.homedir);
+		RETURN_EXTRACT_CSTR(tinfo->get_user()->homedir);
 	case TYPE_SHELL:
-		RETURN_EXTRACT_CSTR(tinfo->m_user.shell);
+		RETURN_EXTRACT_CSTR(tinfo->get_user()->shell);
 	case TYPE_LOGINUID:
-		RETURN_EXTRACT_VAR(tinfo->m_loginuser.uid);
+		RETURN_EXTRACT_VAR(tinfo->get_loginuser()->uid);
 	case TYPE_LOGINNAME:
-		RETURN_EXTRACT_CSTR(tinfo->m_loginuser.name);
+		RETURN_EXTRACT_CSTR(tinfo->get_loginuser()->name);
 	default:
 		ASSERT(false);
 		break;
@@ -5544,9 +5670,9 @@ uint8_t* sinsp_filter_check_group::extract(sinsp_evt *evt, OUT uint32_t* len, bo
 	switch(m_field_id)
 	{
 	case TYPE_GID:
-		RETURN_EXTRACT_VAR(tinfo->m_group.gid);
+		RETURN_EXTRACT_VAR(tinfo->get_group()->gid);
 	case TYPE_NAME:
-		RETURN_EXTRACT_CSTR(tinfo->m_group.name);
+		RETURN_EXTRACT_CSTR(tinfo->get_group()->name);
 	default:
 		ASSERT(false);
 		break;
@@ -5748,6 +5874,16 @@ int32_t sinsp_filter_check_tracer::parse_field_name(const char* str, bool alloc_
 	return res;
 }
 
+void sinsp_filter_check_tracer::rebind(sinsp* inspector)
+{
+	bool changed = inspector != m_inspector;
+	sinsp_filter_check::rebind(inspector);
+	if(changed && inspector != NULL && m_needs_state_tracking)
+	{
+		inspector->request_tracer_state_tracking();
+	}
+}
+
 uint8_t* sinsp_filter_check_tracer::extract_duration(uint16_t etype, sinsp_tracerparser* eparser, OUT uint32_t* len)
 {
 	if(etype == PPME_TRACER_X)
@@ -6270,6 +6406,16 @@ int32_t sinsp_filter_check_evtin::extract_arg(string fldname, string val)
 	return parsed_len;
 }
 
+void sinsp_filter_check_evtin::rebind(sinsp* inspector)
+{
+	bool changed = inspector != m_inspector;
+	sinsp_filter_check::rebind(inspector);
+	if(changed && inspector != NULL)
+	{
+		inspector->request_tracer_state_tracking();
+	}
+}
+
 int32_t sinsp_filter_check_evtin::parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering)
 {
 	int32_t res;
@@ -6380,7 +6526,7 @@ inline uint8_t* sinsp_filter_check_evtin::extract_tracer(sinsp_evt *evt, sinsp_p
 		//
 		// If this is a *.p.* field, reject anything that doesn't come from the same process
 		//
-		sinsp_threadinfo* tinfo = m_inspector->get_thread_ref(pae->m_tid).get();
+		sinsp_threadinfo* tinfo = m_inspector->get_thread(pae->m_tid);
 
 		if(tinfo)
 		{
@@ -6401,7 +6547,7 @@ inline uint8_t* sinsp_filter_check_evtin::extract_tracer(sinsp_evt *evt, sinsp_p
 		//
 		// If this is a *.p.* field, reject anything that doesn't share the same parent
 		//
-		sinsp_threadinfo* tinfo = m_inspector->get_thread_ref(pae->m_tid).get();
+		sinsp_threadinfo* tinfo = m_inspector->get_thread(pae->m_tid);
 
 		if(tinfo)
 		{
@@ -6808,6 +6954,16 @@ int32_t sinsp_filter_check_syslog::parse_field_name(const char* str, bool alloc_
 	return res;
 }
 
+void sinsp_filter_check_syslog::rebind(sinsp* inspector)
+{
+	bool changed = inspector != m_inspector;
+	sinsp_filter_check::rebind(inspector);
+	if(changed && inspector != NULL)
+	{
+		m_decoder = (sinsp_decoder_syslog*)inspector->require_protodecoder("syslog");
+	}
+}
+
 uint8_t* sinsp_filter_check_syslog::extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings)
 {
 	*len = 0;
@@ -6838,6 +6994,89 @@ uint8_t* sinsp_filter_check_syslog::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_check_http implementation
+///////////////////////////////////////////////////////////////////////////////
+const filtercheck_field_info sinsp_filter_check_http_fields[] =
+{
+	{PT_CHARBUF, EPF_NONE, PF_NA, "http.method", "Method", "method of the last HTTP request on the socket, e.g. GET."},
+	{PT_CHARBUF, EPF_NONE, PF_NA, "http.path", "Path", "request target of the last HTTP request on the socket, with the query string, as it was sent."},
+	{PT_UINT32, EPF_NONE, PF_DEC, "http.status", "Status", "status code of the last HTTP response on the socket."},
+	{PT_BOOL, EPF_NONE, PF_NA, "http.is_msg_start", "Message Start", "'true' if the buffer of the event starts an HTTP request or response. The other http fields keep their value on the following buffers of the socket, use this one to match each message once."},
+};
+
+sinsp_filter_check_http::sinsp_filter_check_http()
+{
+	m_info.m_name = "http";
+	m_info.m_desc = "Request and status lines of the HTTP/1.x messages exchanged on the sockets classified as HTTP, parsed once per message.";
+	m_info.m_fields = sinsp_filter_check_http_fields;
+	m_info.m_nfields = sizeof(sinsp_filter_check_http_fields) / sizeof(sinsp_filter_check_http_fields[0]);
+}
+
+sinsp_filter_check* sinsp_filter_check_http::allocate_new()
+{
+	return (sinsp_filter_check*) new sinsp_filter_check_http();
+}
+
+int32_t sinsp_filter_check_http::parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering)
+{
+	int32_t res = sinsp_filter_check::parse_field_name(str, alloc_state, needed_for_filtering);
+	if(res != -1)
+	{
+		m_inspector->require_protodecoder("http");
+	}
+
+	return res;
+}
+
+void sinsp_filter_check_http::rebind(sinsp* inspector)
+{
+	bool changed = inspector != m_inspector;
+	sinsp_filter_check::rebind(inspector);
+	if(changed && inspector != NULL)
+	{
+		inspector->require_protodecoder("http");
+	}
+}
+
+uint8_t* sinsp_filter_check_http::extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings)
+{
+	*len = 0;
+	const sinsp_http_state* state = sinsp_decoder_http::get_state(evt);
+	if(state == NULL)
+	{
+		return NULL;
+	}
+
+	switch(m_field_id)
+	{
+	case TYPE_METHOD:
+		if(state->m_method.empty())
+		{
+			return NULL;
+		}
+		RETURN_EXTRACT_STRING(state->m_method);
+	case TYPE_PATH:
+		if(state->m_method.empty())
+		{
+			return NULL;
+		}
+		RETURN_EXTRACT_STRING(state->m_path);
+	case TYPE_STATUS:
+		if(state->m_status == 0)
+		{
+			return NULL;
+		}
+		RETURN_EXTRACT_VAR(state->m_status);
+	case TYPE_IS_MSG_START:
+		m_u32val = (state->m_msg_evtnum == evt->get_num());
+		RETURN_EXTRACT_VAR(m_u32val);
+	default:
+		ASSERT(false);
+		return NULL;
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check_container implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -6992,7 +7231,7 @@ uint8_t* sinsp_filter_check_container::extract(sinsp_evt *evt, OUT uint32_t* len
 	if(!tinfo->m_container_id.empty())
 	{
 		is_host = false;
-		container_info = m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+		container_info = m_inspector->m_container_manager.get_container(tinfo);
 	}
 
 	switch(m_field_id)
@@ -8360,7 +8599,7 @@ uint8_t* sinsp_filter_check_k8s::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 	m_tstr.clear();
 	// there is metadata we can pull from the container directly instead of the k8s apiserver
 	const sinsp_container_info::ptr_t container_info =
-		m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+		m_inspector->m_container_manager.get_container(tinfo);
 	if(!tinfo->m_container_id.empty() && container_info && !container_info->m_labels.empty())
 	{
 		switch(m_field_id)
@@ -8816,7 +9055,7 @@ mesos_task::ptr_t sinsp_filter_check_mesos::find_task_for_thread(const sinsp_thr
 		if(m_inspector && m_inspector->m_mesos_client)
 		{
 			const sinsp_container_info::ptr_t container_info =
-				m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+				m_inspector->m_container_manager.get_container(tinfo);
 			if(!container_info || container_info->m_mesos_task_id.empty())
 			{
 				return NULL;
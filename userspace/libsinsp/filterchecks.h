@@ -16,10 +16,15 @@ limitations under the License.
 */
 
 #pragma once
+#include <mutex>
 #include <unordered_set>
+#include <unordered_map>
 #include <json/json.h>
 #include "filter_value.h"
 #include "prefix_search.h"
+#include "subnet_search.h"
+#include "multi_search.h"
+#include "glob_matcher.h"
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
 #include "k8s.h"
 #include "mesos.h"
@@ -65,16 +70,114 @@ class check_cache_metrics
 {
 public:
 	// The number of times extract_cached() was called
-	uint64_t m_num_extract;
+	uint64_t m_num_extract = 0;
 
 	// The number of times extract_cached() could use a cached value
-	uint64_t m_num_extract_cache;
+	uint64_t m_num_extract_cache = 0;
 
 	// The number of times compare() was called
-	uint64_t m_num_eval;
+	uint64_t m_num_eval = 0;
 
 	// The number of times compare() could use a cached value
-	uint64_t m_num_eval_cache;
+	uint64_t m_num_eval_cache = 0;
+
+	// The fraction of extract_cached() calls that could use a cached value
+	inline double extract_hit_rate() const
+	{
+		return m_num_extract == 0 ? 0.0 : (double)m_num_extract_cache / m_num_extract;
+	}
+
+	// The fraction of compare() calls that could use a cached value
+	inline double eval_hit_rate() const
+	{
+		return m_num_eval == 0 ? 0.0 : (double)m_num_eval_cache / m_num_eval;
+	}
+};
+
+//
+// The sampled timing of the evaluations of a check. The number of calls and
+// matches is already counted by gen_event_filter_check::m_hits and
+// m_matched_true. Set by sinsp_filter_ruleset::set_profiling().
+//
+class check_profile_metrics
+{
+public:
+	// One evaluation out of m_sampling_ratio is timed
+	uint32_t m_sampling_ratio = 1;
+
+	// The number of timed evaluations
+	uint64_t m_num_sampled = 0;
+
+	// The time spent by the timed evaluations in extract_cached(), in ns
+	uint64_t m_extract_ns = 0;
+
+	// The time spent by the timed evaluations in the rest of compare(), in ns
+	uint64_t m_compare_ns = 0;
+
+	// True while an evaluation is being timed
+	bool m_sampling = false;
+
+	inline bool sample()
+	{
+		if(++m_countdown < m_sampling_ratio)
+		{
+			return false;
+		}
+		m_countdown = 0;
+		return true;
+	}
+
+private:
+	uint32_t m_countdown = 0;
+};
+
+//
+// An extraction cache shared by all the filters compiled for the same
+// inspector (see sinsp::set_filter_extraction_cache()). The checks of the
+// same field, with the same argument, get the same entry, so that the field
+// is extracted only once per event no matter how many rules use it.
+// The metrics are shared as well, and report the hit rate across the rules.
+//
+class sinsp_filter_extraction_cache
+{
+public:
+	check_extraction_cache_entry* get_entry(const std::string& key);
+
+	inline size_t size() const
+	{
+		return m_entries.size();
+	}
+
+	check_cache_metrics m_metrics;
+
+private:
+	// The filters can be compiled on several threads
+	std::mutex m_mutex;
+	std::unordered_map<std::string, std::unique_ptr<check_extraction_cache_entry>> m_entries;
+};
+
+//
+// An evaluation cache shared by all the filters compiled for the same
+// inspector (see sinsp::set_filter_eval_cache()). The compiler gives the
+// same entry to identical subexpressions of different filters, so each of
+// them is evaluated at most once per event (see sinsp_filter_shared_check).
+//
+class sinsp_filter_eval_cache
+{
+public:
+	check_eval_cache_entry* get_entry(const std::string& key);
+
+	inline size_t size() const
+	{
+		return m_entries.size();
+	}
+
+	check_cache_metrics m_metrics;
+
+private:
+	// The filters can be compiled on several threads
+	std::mutex m_mutex;
+	std::unordered_map<std::string, std::unique_ptr<check_eval_cache_entry>> m_entries;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -90,6 +193,11 @@ public:
 
 	virtual ~sinsp_filter_check()
 	{
+		// the values of a shared entry may point into our own storage
+		if(m_shared_extraction_cache != nullptr && m_extraction_cache_entry != NULL)
+		{
+			m_extraction_cache_entry->m_evtnum = UINT64_MAX;
+		}
 	}
 
 	//
@@ -125,6 +233,32 @@ public:
 	//
 	void validate_filter_value(const char* str, uint32_t len) {}
 
+	//
+	// Returns true if this check can be evaluated against many patterns at once
+	// with set_search_patterns(), i.e. if it extracts a single string
+	//
+	virtual bool can_search_patterns();
+
+	//
+	// Makes this check true if any of the given patterns matches, instead of
+	// comparing the field with the value obtained from parse_filter_value().
+	// This is used by the compiler to merge "contains" and "startswith" checks,
+	// or "icontains" ones, on the same field into a single pass over the value.
+	//
+	void set_search_patterns(const std::vector<std::pair<cmpop, std::string>>& patterns);
+
+	//
+	// Returns an estimate of the cost of extracting the field, relative to
+	// reading a field of the event header. By default, the fields are
+	// assumed to be looked up in the thread or fd tables.
+	//
+	virtual double get_extraction_cost();
+
+	//
+	// The cost of the extraction, scaled by the cost of the comparison
+	//
+	double get_cost() override;
+
 	//
 	// Return the info about the field that this instance contains
 	//
@@ -149,6 +283,19 @@ public:
 	//
 	bool extract_cached(sinsp_evt *evt, OUT std::vector<extract_value_t>& values, bool sanitize_strings = true);
 
+	//
+	// Makes extract_cached() use the entry of the given shared cache, and
+	// report to its metrics unless other metrics have been set already
+	//
+	void set_shared_extraction_cache(const std::shared_ptr<sinsp_filter_extraction_cache>& cache, const std::string& key);
+
+	//
+	// Moves the check to another inspector (see sinsp_filter::set_inspector),
+	// along with the entry of its shared extraction cache. Checks setting
+	// up the inspector in parse_field_name() do it again here.
+	//
+	virtual void rebind(sinsp* inspector);
+
 	//
 	// Extract the field as json from the event (by default, fall
 	// back to the regular extract functionality)
@@ -169,6 +316,14 @@ public:
 	//
 	virtual char* tostring(sinsp_evt* evt);
 
+	//
+	// Like tostring(), appending the value to out. Numbers and addresses are
+	// written directly instead of going through a temporary string.
+	// Returns false, leaving out untouched, if the field can't be extracted.
+	// Subclasses overriding tostring() must override this too.
+	//
+	virtual bool tostring(sinsp_evt* evt, std::string& out);
+
 	//
 	// Extract the value from the event and convert it into a Json value
 	// or object
@@ -181,8 +336,13 @@ public:
 	check_extraction_cache_entry* m_extraction_cache_entry = NULL;
 	std::vector<extract_value_t> m_extracted_values;
 	check_cache_metrics *m_cache_metrics = NULL;
+	check_profile_metrics *m_profile_metrics = NULL;
 
 protected:
+	// keeps the entry and the metrics alive when set by set_shared_extraction_cache()
+	std::shared_ptr<sinsp_filter_extraction_cache> m_shared_extraction_cache;
+	std::string m_extraction_cache_key;
+
 	// This is a single-value version of extract for subclasses non supporting extracting
 	// multiple values. By default, this returns NULL.
 	// Subclasses are meant to either override this, or the multi-valued extract method.
@@ -211,6 +371,17 @@ protected:
 
 	path_prefix_search m_val_storages_paths;
 
+	// the values of CO_IN on network fields
+	subnet_search m_val_storages_nets;
+
+	// the values of CO_IN on numeric, port and IPv4 address fields
+	filter_int_set m_val_storages_ints;
+
+	std::unique_ptr<multi_search> m_search_patterns;
+
+	// compiled pattern of CO_GLOB, for string fields
+	std::unique_ptr<glob_matcher> m_glob_matcher;
+
 	uint32_t m_val_storages_min_size;
 	uint32_t m_val_storages_max_size;
 
@@ -221,6 +392,9 @@ protected:
 
 private:
 	void set_inspector(sinsp* inspector);
+	bool compare_cached(gen_event *evt);
+	bool compare_sampled(gen_event *evt);
+	bool extract_timed(sinsp_evt *evt, OUT std::vector<extract_value_t>& values, bool sanitize_strings);
 
 friend class filter_check_list;
 friend class sinsp_filter_optimizer;
@@ -308,6 +482,8 @@ public:
 	bool compare_port(sinsp_evt *evt);
 	bool compare_domain(sinsp_evt *evt);
 	bool compare(sinsp_evt *evt);
+	bool can_search_patterns();
+	double get_extraction_cost();
 
 	sinsp_threadinfo* m_tinfo;
 	sinsp_fdinfo_t* m_fdinfo;
@@ -411,8 +587,10 @@ public:
 	sinsp_filter_check_thread();
 	sinsp_filter_check* allocate_new();
 	int32_t parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering);
+	void rebind(sinsp* inspector) override;
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings = true);
 	bool compare(sinsp_evt *evt);
+	double get_extraction_cost();
 
 	int32_t get_argid();
 
@@ -436,6 +614,7 @@ private:
 	std::vector<uint64_t> m_last_proc_switch_times;
 	uint64_t m_cursec_ts;
 	std::unique_ptr<libsinsp::state::dynamic_struct::field_accessor<uint64_t>> m_thread_dyn_field_accessor;
+	std::string m_thread_dyn_field_name;
 };
 
 //
@@ -471,6 +650,12 @@ public:
 
 	uint64_t m_u64val;
 	std::string m_strstorage;
+
+private:
+	void time_to_string(uint64_t ts, bool date);
+
+	// The second of the time in m_strstorage, if it holds one
+	uint64_t m_strstorage_sec = UINT64_MAX;
 };
 
 //
@@ -538,6 +723,8 @@ public:
 		TYPE_INFRA_DOCKER_CONTAINER_NAME = 54,
 		TYPE_INFRA_DOCKER_CONTAINER_IMAGE = 55,
 		TYPE_ISOPEN_EXEC = 56,
+		TYPE_SNAPLEN_LIMIT = 57,
+		TYPE_REPEAT_COUNT = 58,
 	};
 
 	sinsp_filter_check_event();
@@ -550,6 +737,7 @@ public:
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings = true);
 	Json::Value extract_as_js(sinsp_evt *evt, OUT uint32_t* len);
 	bool compare(sinsp_evt *evt);
+	double get_extraction_cost();
 
 	uint64_t m_u64val;
 	uint64_t m_tsdelta;
@@ -567,7 +755,16 @@ public:
 	//
 	filtercheck_field_info m_customfield;
 
+	//
+	// The number of evt.arg extractions that rendered a numeric parameter
+	// directly, and the ones that went through sinsp_evt::get_param_as_str()
+	//
+	uint64_t m_num_argstr_raw = 0;
+	uint64_t m_num_argstr_formatted = 0;
+
 private:
+	int32_t get_argid(sinsp_evt *evt);
+	uint8_t* extract_argstr(sinsp_evt *evt, OUT uint32_t* len);
 	int32_t extract_arg(std::string fldname, std::string val, OUT const struct ppm_param_info** parinfo);
 	int32_t extract_type(std::string fldname, std::string val, OUT const struct ppm_param_info** parinfo);
 	uint8_t* extract_error_count(sinsp_evt *evt, OUT uint32_t* len);
@@ -575,6 +772,9 @@ private:
 	inline uint8_t* extract_buflen(sinsp_evt *evt, OUT uint32_t* len);
 
 	bool m_is_compare;
+	// Index of the parameter named m_argname for each event type,
+	// -1 if the event doesn't have it, -2 if not looked up yet
+	std::vector<int16_t> m_argids;
 	char* m_storage;
 	uint32_t m_storage_size;
 	const char* m_cargname;
@@ -661,6 +861,7 @@ public:
 	~sinsp_filter_check_tracer();
 	sinsp_filter_check* allocate_new();
 	int32_t parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering);
+	void rebind(sinsp* inspector) override;
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings = true);
 
 private:
@@ -721,6 +922,7 @@ public:
 	sinsp_filter_check_evtin();
 	~sinsp_filter_check_evtin();
 	int32_t parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering);
+	void rebind(sinsp* inspector) override;
 	sinsp_filter_check* allocate_new();
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings = true);
 	bool compare(sinsp_evt *evt);
@@ -793,6 +995,7 @@ public:
 	sinsp_filter_check_syslog();
 	sinsp_filter_check* allocate_new();
 	int32_t parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering);
+	void rebind(sinsp* inspector) override;
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings = true);
 
 	sinsp_decoder_syslog* m_decoder;
@@ -800,6 +1003,30 @@ public:
 	std::string m_name;
 };
 
+//
+// http checks
+//
+class sinsp_filter_check_http : public sinsp_filter_check
+{
+public:
+	enum check_type
+	{
+		TYPE_METHOD = 0,
+		TYPE_PATH,
+		TYPE_STATUS,
+		TYPE_IS_MSG_START,
+	};
+
+	sinsp_filter_check_http();
+	sinsp_filter_check* allocate_new();
+	int32_t parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering);
+	void rebind(sinsp* inspector) override;
+	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings = true);
+
+private:
+	uint32_t m_u32val;
+};
+
 class sinsp_filter_check_container : public sinsp_filter_check
 {
 public:
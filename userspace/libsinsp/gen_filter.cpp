@@ -18,6 +18,7 @@ limitations under the License.
 #include <cstddef>
 #include <iomanip>
 #include <algorithm>
+#include <limits>
 #include <sstream>
 #include "stdint.h"
 #include "gen_filter.h"
@@ -40,6 +41,12 @@ gen_event_filter_check::~gen_event_filter_check()
 {
 }
 
+void gen_event_filter_check::reorder(bool use_profile, double& cost, double& pass)
+{
+	cost = get_cost();
+	pass = (use_profile && m_hits > 0) ? (double) m_matched_true / m_hits : 0.5;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // gen_event_filter_expression implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -117,7 +124,8 @@ bool gen_event_filter_expression::compare(gen_event *evt)
 	++m_hits;
 
 	auto size = m_checks.size();
-	for(size_t j = 0; j < size; j++)
+	size_t j;
+	for(j = 0; j < size; j++)
 	{
 		chk = m_checks[j];
 		ASSERT(chk != NULL);
@@ -176,6 +184,7 @@ bool gen_event_filter_expression::compare(gen_event *evt)
 		}
 	}
  done:
+	m_evaluated_checks += j;
 	if (res)
 	{
 		m_matched_true++;
@@ -216,6 +225,161 @@ int32_t gen_event_filter_expression::get_expr_boolop()
 	return b0;
 }
 
+void gen_event_filter_expression::reorder(bool use_profile, double& cost, double& pass)
+{
+	struct ranked_check
+	{
+		gen_event_filter_check* m_check;
+		double m_cost;
+		double m_pass;
+		double m_rank;
+	};
+
+	std::vector<ranked_check> ranked(m_checks.size());
+	for(size_t j = 0; j < m_checks.size(); j++)
+	{
+		ranked[j].m_check = m_checks[j];
+		m_checks[j]->reorder(use_profile, ranked[j].m_cost, ranked[j].m_pass);
+		if(m_checks[j]->m_boolop & BO_NOT)
+		{
+			ranked[j].m_pass = 1 - ranked[j].m_pass;
+		}
+	}
+
+	// "and" stops at the first false check, "or" at the first true one
+	int32_t op = (m_checks.size() > 1) ? get_expr_boolop() : BO_AND;
+	if(op == BO_AND || op == BO_OR)
+	{
+		for(auto& r : ranked)
+		{
+			double stop = (op == BO_AND) ? 1 - r.m_pass : r.m_pass;
+			r.m_rank = (stop > 0) ? r.m_cost / stop : std::numeric_limits<double>::infinity();
+		}
+		std::stable_sort(ranked.begin(), ranked.end(),
+			[](const ranked_check& a, const ranked_check& b) { return a.m_rank < b.m_rank; });
+
+		for(size_t j = 0; j < ranked.size(); j++)
+		{
+			uint32_t negated = ranked[j].m_check->m_boolop & BO_NOT;
+			ranked[j].m_check->m_boolop = (boolop)((j == 0 ? BO_NONE : op) | negated);
+			m_checks[j] = ranked[j].m_check;
+		}
+	}
+
+	// the expected cost assumes the checks are independent
+	double reach = 1;
+	cost = 0;
+	for(auto& r : ranked)
+	{
+		cost += reach * r.m_cost;
+		reach *= (op == BO_OR) ? 1 - r.m_pass : r.m_pass;
+	}
+	pass = (op == BO_OR) ? 1 - reach : reach;
+
+	if(use_profile && m_hits > 0)
+	{
+		pass = (double) m_matched_true / m_hits;
+	}
+}
+
+double gen_event_filter_expression::get_short_circuit_rate() const
+{
+	double total = (double) m_hits * m_checks.size();
+	return (total == 0) ? 0 : 1 - m_evaluated_checks / total;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// gen_event_filter_program implementation
+///////////////////////////////////////////////////////////////////////////////
+void gen_event_filter_program::build(gen_event_filter_expression* expr)
+{
+	m_ops.clear();
+	m_ops.resize(size_of(expr));
+	emit(expr, 0, ACCEPT, REJECT);
+}
+
+bool gen_event_filter_program::run(gen_event *evt) const
+{
+	const op* ops = m_ops.data();
+	uint32_t pc = 0;
+
+	// jumps only go forward, so this always terminates
+	do
+	{
+		const op& o = ops[pc];
+		pc = (o.m_check == nullptr || o.m_check->compare(evt)) ? o.m_on_true : o.m_on_false;
+	} while(pc < REJECT);
+
+	return pc == ACCEPT;
+}
+
+uint32_t gen_event_filter_program::size_of(gen_event_filter_check* chk)
+{
+	auto expr = dynamic_cast<gen_event_filter_expression*>(chk);
+	if(expr == nullptr || expr->m_checks.empty())
+	{
+		return 1;
+	}
+
+	uint32_t size = 0;
+	for(auto c : expr->m_checks)
+	{
+		size += size_of(c);
+	}
+	return size;
+}
+
+//
+// Emits the ops of chk starting at pc, jumping to on_true or on_false
+// depending on its result. This matches gen_event_filter_expression::compare:
+// the evaluation of an expression stops at the first child which is followed
+// by an "or" and is true, or by an "and" and is false.
+//
+void gen_event_filter_program::emit(gen_event_filter_check* chk, uint32_t pc, uint32_t on_true, uint32_t on_false)
+{
+	auto expr = dynamic_cast<gen_event_filter_expression*>(chk);
+	if(expr == nullptr)
+	{
+		m_ops[pc] = {chk, on_true, on_false};
+		return;
+	}
+
+	if(expr->m_checks.empty())
+	{
+		m_ops[pc] = {nullptr, on_true, on_false};
+		return;
+	}
+
+	auto size = expr->m_checks.size();
+	for(size_t j = 0; j < size; j++)
+	{
+		gen_event_filter_check* child = expr->m_checks[j];
+		uint32_t next = pc + size_of(child);
+		uint32_t t = on_true;
+		uint32_t f = on_false;
+
+		if(j + 1 < size)
+		{
+			if((expr->m_checks[j + 1]->m_boolop & ~BO_NOT) == BO_OR)
+			{
+				f = next;
+			}
+			else
+			{
+				t = next;
+			}
+		}
+
+		if(child->m_boolop & BO_NOT)
+		{
+			std::swap(t, f);
+		}
+
+		emit(child, pc, t, f);
+		pc = next;
+	}
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter implementation
@@ -259,14 +423,34 @@ void gen_event_filter::pop_expression()
 
 bool gen_event_filter::run(gen_event *evt)
 {
+	if(!m_program.empty())
+	{
+		return m_program.run(evt);
+	}
 	return m_filter->compare(evt);
 }
 
 void gen_event_filter::add_check(gen_event_filter_check* chk)
 {
+	m_program.clear();
 	m_curexpr->add_check((gen_event_filter_check *) chk);
 }
 
+void gen_event_filter::flatten()
+{
+	m_program.build(m_filter);
+}
+
+void gen_event_filter::reorder(bool use_profile)
+{
+	double cost, pass;
+	m_filter->reorder(use_profile, cost, pass);
+	if(!m_program.empty())
+	{
+		m_program.build(m_filter);
+	}
+}
+
 bool gen_event_filter_factory::filter_field_info::is_skippable()
 {
 	// Skip fields with the EPF_TABLE_ONLY flag.
@@ -17,6 +17,7 @@ limitations under the License.
 
 #pragma once
 
+#include <cstdint>
 #include <set>
 #include <list>
 #include <map>
@@ -117,6 +118,24 @@ public:
 	virtual void add_filter_value(const char* str, uint32_t len, uint32_t i = 0 ) = 0;
 	virtual bool compare(gen_event *evt) = 0;
 	virtual bool extract(gen_event *evt, std::vector<extract_value_t>& values, bool sanitize_strings = true) = 0;
+
+	//
+	// Returns an estimate of the cost of evaluating the check, relative to
+	// reading a field of the event header. Used to reorder the checks of
+	// the expressions (see gen_event_filter::reorder).
+	//
+	virtual double get_cost()
+	{
+		return 1;
+	}
+
+	//
+	// Reorders the nested checks, if any, and returns the estimated cost of
+	// evaluating the check and the probability of it being true. If
+	// use_profile is true and the check has been evaluated already, the
+	// probability comes from the hit counters, otherwise it's assumed to be 1/2.
+	//
+	virtual void reorder(bool use_profile, double& cost, double& pass);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -159,8 +178,76 @@ public:
 	//
 	int32_t get_expr_boolop();
 
+	//
+	// Reorders the checks of a consistent expression, and of its nested
+	// expressions, so that the ones more likely to end the evaluation at
+	// a lower cost come first. Without a profile, this orders the checks by
+	// cost. Checks with the same rank keep their order.
+	//
+	void reorder(bool use_profile, double& cost, double& pass) override;
+
+	//
+	// The fraction of checks skipped by short-circuiting in the evaluations
+	// of this expression. Only updated by compare().
+	//
+	double get_short_circuit_rate() const;
+
 	gen_event_filter_expression* m_parent;
 	std::vector<gen_event_filter_check*> m_checks;
+
+	// The number of checks evaluated by compare()
+	size_t m_evaluated_checks = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Flattened filter program
+// The leaves of an expression tree laid out in a linear array, in evaluation
+// order. Every op evaluates its check and jumps forward to another op depending
+// on the result, so the boolean operators and their short-circuiting are
+// encoded in the jump targets and no recursion is needed to run the filter.
+///////////////////////////////////////////////////////////////////////////////
+class gen_event_filter_program
+{
+public:
+	// Jump targets terminating the program
+	static constexpr uint32_t ACCEPT = UINT32_MAX;
+	static constexpr uint32_t REJECT = UINT32_MAX - 1;
+
+	struct op
+	{
+		gen_event_filter_check* m_check; // null for ops that are always true (e.g. empty expressions)
+		uint32_t m_on_true;
+		uint32_t m_on_false;
+	};
+
+	//
+	// Builds the program out of the given expression tree, which keeps
+	// the ownership of the checks and must outlive the program.
+	//
+	void build(gen_event_filter_expression* expr);
+
+	bool run(gen_event *evt) const;
+
+	inline void clear()
+	{
+		m_ops.clear();
+	}
+
+	inline bool empty() const
+	{
+		return m_ops.empty();
+	}
+
+	inline const std::vector<op>& ops() const
+	{
+		return m_ops;
+	}
+
+private:
+	static uint32_t size_of(gen_event_filter_check* chk);
+	void emit(gen_event_filter_check* chk, uint32_t pc, uint32_t on_true, uint32_t on_false);
+
+	std::vector<op> m_ops;
 };
 
 
@@ -183,10 +270,39 @@ public:
 	void pop_expression();
 	void add_check(gen_event_filter_check* chk);
 
+	/*!
+	  \brief Compiles the filtercheck tree into a flat program, that is
+	  used by run() from now on. The result of the evaluation is the same,
+	  but the per-expression hit counters are no longer updated.
+
+	  \note The program must be rebuilt if the tree is modified afterwards.
+	*/
+	void flatten();
+
+	/*!
+	  \brief Reorders the checks of the and/or expressions of the filter by
+	  their estimated cost and, if use_profile is true, by how often they
+	  have been true so far (see gen_event_filter_expression::reorder).
+	  The result of the evaluation is the same. A flattened filter is
+	  flattened again.
+	*/
+	void reorder(bool use_profile = false);
+
+	inline bool is_flattened() const
+	{
+		return !m_program.empty();
+	}
+
+	inline const gen_event_filter_program& get_program() const
+	{
+		return m_program;
+	}
+
 	gen_event_filter_expression* m_filter;
 
 protected:
 	gen_event_filter_expression* m_curexpr;
+	gen_event_filter_program m_program;
 
 	friend class sinsp_filter_compiler;
 	friend class sinsp_filter_optimizer;
@@ -0,0 +1,105 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <string.h>
+
+#include "glob_matcher.h"
+#include "strsearch.h"
+#include "utils.h"
+
+glob_matcher::glob_matcher(const std::string& pattern):
+	m_pattern(pattern)
+{
+	m_compiled = compile();
+}
+
+bool glob_matcher::compile()
+{
+#ifdef _WIN32
+	// PathMatchSpec has its own semantics, always use it
+	return false;
+#else
+	m_segments.assign(1, "");
+	for(size_t i = 0; i < m_pattern.size(); i++)
+	{
+		char c = m_pattern[i];
+		switch(c)
+		{
+		case '*':
+			// consecutive wildcards are the same as one
+			if(!m_segments.back().empty() || m_segments.size() == 1)
+			{
+				m_segments.push_back("");
+			}
+			break;
+		case '\\':
+			// a trailing backslash is left to fnmatch
+			if(i + 1 == m_pattern.size())
+			{
+				return false;
+			}
+			m_segments.back() += m_pattern[++i];
+			break;
+		case '?':
+		case '[':
+			return false;
+		default:
+			m_segments.back() += c;
+			break;
+		}
+	}
+	return true;
+#endif
+}
+
+bool glob_matcher::match(const char *str) const
+{
+	if(!m_compiled)
+	{
+		return sinsp_utils::glob_match(m_pattern.c_str(), str);
+	}
+
+	size_t len = strlen(str);
+	const std::string& first = m_segments.front();
+	if(m_segments.size() == 1)
+	{
+		return len == first.size() && memcmp(str, first.data(), len) == 0;
+	}
+
+	const std::string& last = m_segments.back();
+	if(len < first.size() + last.size() ||
+	   memcmp(str, first.data(), first.size()) != 0 ||
+	   memcmp(str + len - last.size(), last.data(), last.size()) != 0)
+	{
+		return false;
+	}
+
+	// the leftmost match of every segment leaves the most room to the next ones
+	const char* p = str + first.size();
+	const char* end = str + len - last.size();
+	for(size_t i = 1; i + 1 < m_segments.size(); i++)
+	{
+		const std::string& seg = m_segments[i];
+		const char* found = libsinsp::strsearch::find(p, end - p, seg.data(), seg.size());
+		if(found == NULL)
+		{
+			return false;
+		}
+		p = found + seg.size();
+	}
+	return true;
+}
@@ -0,0 +1,54 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+//
+// A glob pattern compiled once, to be matched against many strings with
+// the same result as sinsp_utils::glob_match().
+//
+// Patterns made only of literals and '*' wildcards (e.g. /proc/*/mem) are
+// split into the literal segments between the wildcards: the first and the
+// last segments are compared with the beginning and the end of the string,
+// the others are searched in between, in order. The other patterns (e.g.
+// with '?' or bracket expressions) fall back to sinsp_utils::glob_match().
+//
+class glob_matcher
+{
+public:
+	glob_matcher(const std::string& pattern);
+
+	bool match(const char *str) const;
+
+	// Returns true if the pattern doesn't need the glob_match() fallback
+	inline bool is_compiled() const
+	{
+		return m_compiled;
+	}
+
+private:
+	bool compile();
+
+	std::string m_pattern;
+	bool m_compiled;
+	// the literals between the wildcards, there is always
+	// one more segment than wildcards
+	std::vector<std::string> m_segments;
+};
@@ -19,7 +19,8 @@ limitations under the License.
 #include "sinsp_int.h"
 
 sinsp_network_interfaces::sinsp_network_interfaces(sinsp* inspector)
-	: m_inspector(inspector)
+	: m_lookup_tables_stale(true),
+	  m_inspector(inspector)
 {
 	if(inet_pton(AF_INET6, "::1", m_ipv6_loopback_addr.m_b) != 1)
 	{
@@ -68,26 +69,51 @@ std::string sinsp_ipv4_ifinfo::to_string() const
 	return std::string(s);
 }
 
+void sinsp_network_interfaces::refresh_lookup_tables()
+{
+	if(!m_lookup_tables_stale)
+	{
+		return;
+	}
+
+	m_ipv4_subnets.clear();
+	m_ipv4_addresses.clear();
+	for(uint32_t j = 0; j < m_ipv4_interfaces.size(); j++)
+	{
+		const sinsp_ipv4_ifinfo& info = m_ipv4_interfaces[j];
+		m_ipv4_subnets.add(ipv4net{info.m_addr, info.m_netmask}, j);
+		m_ipv4_addresses.add(ipv4net{info.m_addr, 0xffffffff}, j);
+	}
+
+	m_ipv6_subnets.clear();
+	m_ipv6_addresses.clear();
+	for(uint32_t j = 0; j < m_ipv6_interfaces.size(); j++)
+	{
+		// Same subnet convention as ipv6addr::in_subnet()
+		m_ipv6_subnets.add(m_ipv6_interfaces[j].m_net, 64, j);
+		m_ipv6_addresses.add(m_ipv6_interfaces[j].m_net, 128, j);
+	}
+
+	m_lookup_tables_stale = false;
+}
+
 uint32_t sinsp_network_interfaces::infer_ipv4_address(uint32_t destination_address)
 {
 	std::vector<sinsp_ipv4_ifinfo>::iterator it;
+	int64_t idx;
+
+	refresh_lookup_tables();
 
 	// first try to find exact match
-	for(it = m_ipv4_interfaces.begin(); it != m_ipv4_interfaces.end(); it++)
+	if(m_ipv4_addresses.match(destination_address))
 	{
-		if(it->m_addr == destination_address)
-		{
-			return it->m_addr;
-		}
+		return destination_address;
 	}
 
 	// try to find an interface for the same subnet
-	for(it = m_ipv4_interfaces.begin(); it != m_ipv4_interfaces.end(); it++)
+	if((idx = m_ipv4_subnets.find(destination_address)) >= 0)
 	{
-		if((it->m_addr & it->m_netmask) == (destination_address & it->m_netmask))
-		{
-			return it->m_addr;
-		}
+		return m_ipv4_interfaces[idx].m_addr;
 	}
 
 	// otherwise take the first non loopback interface
@@ -196,8 +222,6 @@ void sinsp_network_interfaces::update_fd(sinsp_fdinfo_t *fd)
 
 bool sinsp_network_interfaces::is_ipv4addr_in_subnet(uint32_t addr)
 {
-	std::vector<sinsp_ipv4_ifinfo>::iterator it;
-
 	//
 	// Accept everything that comes from 192.168.0.0/16 or 10.0.0.0/8
 	//
@@ -209,15 +233,8 @@ bool sinsp_network_interfaces::is_ipv4addr_in_subnet(uint32_t addr)
 	}
 
 	// try to find an interface for the same subnet
-	for(it = m_ipv4_interfaces.begin(); it != m_ipv4_interfaces.end(); it++)
-	{
-		if((it->m_addr & it->m_netmask) == (addr & it->m_netmask))
-		{
-			return true;
-		}
-	}
-
-	return false;
+	refresh_lookup_tables();
+	return m_ipv4_subnets.match(addr);
 }
 
 bool sinsp_network_interfaces::is_ipv4addr_in_local_machine(uint32_t addr, sinsp_threadinfo* tinfo)
@@ -225,7 +242,7 @@ bool sinsp_network_interfaces::is_ipv4addr_in_local_machine(uint32_t addr, sinsp
 	if(!tinfo->m_container_id.empty())
 	{
 		const sinsp_container_info::ptr_t container_info =
-			m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+			m_inspector->m_container_manager.get_container(tinfo);
 
 		//
 		// Note: if we don't have container info, any pick we make is arbitrary.
@@ -280,18 +297,9 @@ bool sinsp_network_interfaces::is_ipv4addr_in_local_machine(uint32_t addr, sinsp
 		}
 	}
 
-	std::vector<sinsp_ipv4_ifinfo>::iterator it;
-
 	// try to find an interface that has the given IP as address
-	for(it = m_ipv4_interfaces.begin(); it != m_ipv4_interfaces.end(); it++)
-	{
-		if(it->m_addr == addr)
-		{
-			return true;
-		}
-	}
-
-	return false;
+	refresh_lookup_tables();
+	return m_ipv4_addresses.match(addr);
 }
 
 void sinsp_network_interfaces::import_ipv4_ifaddr_list(uint32_t count, scap_ifinfo_ipv4* plist)
@@ -310,28 +318,26 @@ void sinsp_network_interfaces::import_ipv4_ifaddr_list(uint32_t count, scap_ifin
 		m_ipv4_interfaces.push_back(info);
 		plist++;
 	}
+	m_lookup_tables_stale = true;
 }
 
 ipv6addr sinsp_network_interfaces::infer_ipv6_address(ipv6addr &destination_address)
 {
 	std::vector<sinsp_ipv6_ifinfo>::iterator it;
+	int64_t idx;
+
+	refresh_lookup_tables();
 
 	// first try to find exact match
-	for(it = m_ipv6_interfaces.begin(); it != m_ipv6_interfaces.end(); it++)
+	if(m_ipv6_addresses.match(destination_address))
 	{
-		if(destination_address == it->m_net)
-		{
-			return it->m_net;
-		}
+		return destination_address;
 	}
 
 	// try to find an interface for the same subnet
-	for(it = m_ipv6_interfaces.begin(); it != m_ipv6_interfaces.end(); it++)
+	if((idx = m_ipv6_subnets.find(destination_address)) >= 0)
 	{
-		if(it->m_net.in_subnet(destination_address))
-		{
-			return it->m_net;
-		}
+		return m_ipv6_interfaces[idx].m_net;
 	}
 
 	// otherwise take the first non loopback interface
@@ -354,18 +360,9 @@ bool sinsp_network_interfaces::is_ipv6addr_in_local_machine(ipv6addr &addr, sins
 		return false;
 	}
 
-	std::vector<sinsp_ipv6_ifinfo>::iterator it;
-
-	// try to find an interface that has the given IP as address
-	for(it = m_ipv6_interfaces.begin(); it != m_ipv6_interfaces.end(); it++)
-	{
-		if(addr.in_subnet(it->m_net))
-		{
-			return true;
-		}
-	}
-
-	return false;
+	// try to find an interface in the same subnet of the given IP
+	refresh_lookup_tables();
+	return m_ipv6_subnets.match(addr);
 }
 
 void sinsp_network_interfaces::import_ipv6_ifaddr_list(uint32_t count, scap_ifinfo_ipv6* plist)
@@ -387,6 +384,7 @@ void sinsp_network_interfaces::import_ipv6_ifaddr_list(uint32_t count, scap_ifin
 		m_ipv6_interfaces.push_back(info);
 		plist++;
 	}
+	m_lookup_tables_stale = true;
 }
 
 void sinsp_network_interfaces::import_interfaces(scap_addrlist* paddrlist)
@@ -402,19 +400,24 @@ void sinsp_network_interfaces::import_interfaces(scap_addrlist* paddrlist)
 void sinsp_network_interfaces::import_ipv4_interface(const sinsp_ipv4_ifinfo& ifinfo)
 {
 	m_ipv4_interfaces.push_back(ifinfo);
+	m_lookup_tables_stale = true;
 }
 
 void sinsp_network_interfaces::import_ipv6_interface(const sinsp_ipv6_ifinfo& ifinfo)
 {
 	m_ipv6_interfaces.push_back(ifinfo);
+	m_lookup_tables_stale = true;
 }
 
 std::vector<sinsp_ipv4_ifinfo>* sinsp_network_interfaces::get_ipv4_list()
 {
+	// the caller can modify the list
+	m_lookup_tables_stale = true;
 	return &m_ipv4_interfaces;
 }
 
 std::vector<sinsp_ipv6_ifinfo>* sinsp_network_interfaces::get_ipv6_list()
 {
+	m_lookup_tables_stale = true;
 	return &m_ipv6_interfaces;
 }
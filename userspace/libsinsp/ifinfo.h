@@ -18,6 +18,7 @@ limitations under the License.
 #pragma once
 
 #include "tuples.h"
+#include "subnet_search.h"
 
 #define LOOPBACK_ADDR 0x0100007f
 
@@ -82,8 +83,17 @@ VISIBILITY_PRIVATE
 	void import_ipv4_ifaddr_list(uint32_t count, scap_ifinfo_ipv4* plist);
 	ipv6addr infer_ipv6_address(ipv6addr &destination_address);
 	void import_ipv6_ifaddr_list(uint32_t count, scap_ifinfo_ipv6* plist);
+	void refresh_lookup_tables();
 	std::vector<sinsp_ipv4_ifinfo> m_ipv4_interfaces;
 	std::vector<sinsp_ipv6_ifinfo> m_ipv6_interfaces;
+	// Lookup tables of the interfaces above, the values are their
+	// positions in the lists. Rebuilt on the first lookup after the
+	// lists may have changed.
+	bool m_lookup_tables_stale;
+	subnet_search m_ipv4_subnets;
+	subnet_search m_ipv4_addresses;
+	subnet_search m_ipv6_subnets;
+	subnet_search m_ipv6_addresses;
 	sinsp* m_inspector;
 };
 
@@ -91,4 +101,5 @@ void sinsp_network_interfaces::clear()
 {
 	m_ipv4_interfaces.clear();
 	m_ipv6_interfaces.clear();
+	m_lookup_tables_stale = true;
 }
\ No newline at end of file
@@ -124,6 +124,11 @@ public:
 		m_value--;
 	}
 
+	void add(uint64_t value)
+	{
+		m_value += value;
+	}
+
 	void clear()
 	{
 		m_value = 0;
@@ -0,0 +1,442 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace libsinsp {
+
+template<typename T> class interned_pool;
+
+/**
+ * @brief An immutable vector whose contents are shared by reference with
+ * all the equal vectors interned in the same pool, and with all its copies.
+ * Copying or assigning one never duplicates the contents.
+ */
+template<typename T>
+class interned_vector
+{
+public:
+	using vector_t = std::vector<T>;
+	using const_iterator = typename vector_t::const_iterator;
+
+	interned_vector(): m_values(empty_values()) { }
+
+	/**
+	 * @brief Creates a vector that is not shared with any pool.
+	 */
+	explicit interned_vector(vector_t&& values):
+		m_values(std::make_shared<const vector_t>(std::move(values))) { }
+
+	inline const vector_t& get() const { return *m_values; }
+	inline operator const vector_t&() const { return *m_values; }
+
+	inline size_t size() const { return m_values->size(); }
+	inline bool empty() const { return m_values->empty(); }
+	inline const T& operator[](size_t i) const { return (*m_values)[i]; }
+	inline const T& at(size_t i) const { return m_values->at(i); }
+	inline const_iterator begin() const { return m_values->begin(); }
+	inline const_iterator end() const { return m_values->end(); }
+
+	/**
+	 * @brief Returns true if the two vectors use the same storage.
+	 */
+	inline bool shares_storage_with(const interned_vector& other) const
+	{
+		return m_values == other.m_values;
+	}
+
+	inline bool operator==(const interned_vector& other) const
+	{
+		return m_values == other.m_values || *m_values == *other.m_values;
+	}
+
+	inline bool operator!=(const interned_vector& other) const
+	{
+		return !(*this == other);
+	}
+
+	friend inline bool operator==(const interned_vector& a, const vector_t& b)
+	{
+		return a.get() == b;
+	}
+
+	friend inline bool operator==(const vector_t& a, const interned_vector& b)
+	{
+		return a == b.get();
+	}
+
+private:
+	static const std::shared_ptr<const vector_t>& empty_values()
+	{
+		static const std::shared_ptr<const vector_t> s_empty = std::make_shared<const vector_t>();
+		return s_empty;
+	}
+
+	std::shared_ptr<const vector_t> m_values;
+
+	friend class interned_pool<T>;
+};
+
+namespace interned {
+
+inline size_t hash(const std::string& s)
+{
+	return std::hash<std::string>()(s);
+}
+
+inline size_t hash(const std::pair<std::string, std::string>& p)
+{
+	size_t seed = hash(p.first);
+	seed ^= hash(p.second) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	return seed;
+}
+
+// Heap memory used by a value, on top of sizeof(T)
+inline size_t heap_footprint(const std::string& s)
+{
+	// Short strings live in the inline buffer of std::string
+	return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+inline size_t heap_footprint(const std::pair<std::string, std::string>& p)
+{
+	return heap_footprint(p.first) + heap_footprint(p.second);
+}
+
+} // interned
+
+/**
+ * @brief A set of interned vectors. intern() returns a vector that shares
+ * its storage with the equal vectors still referenced anywhere, so that
+ * a value common to many owners is stored only once. The pool only keeps
+ * weak references: a value is freed as soon as nobody uses it anymore.
+ */
+template<typename T>
+class interned_pool
+{
+public:
+	using vector_t = std::vector<T>;
+
+	struct stats
+	{
+		// Number of distinct values currently alive
+		uint64_t m_values = 0;
+		// Number of references to those values
+		uint64_t m_refs = 0;
+		// Memory used by the distinct values
+		uint64_t m_bytes = 0;
+		// Memory the values would use without sharing
+		uint64_t m_unshared_bytes = 0;
+		// Outcome of the intern() calls
+		uint64_t m_hits = 0;
+		uint64_t m_misses = 0;
+	};
+
+	interned_vector<T> intern(vector_t&& values)
+	{
+		interned_vector<T> res;
+		if(values.empty())
+		{
+			return res;
+		}
+
+		size_t h = hash(values);
+		auto range = m_values.equal_range(h);
+		for(auto it = range.first; it != range.second;)
+		{
+			auto ptr = it->second.lock();
+			if(!ptr)
+			{
+				it = m_values.erase(it);
+				continue;
+			}
+
+			if(*ptr == values)
+			{
+				m_hits++;
+				res.m_values = std::move(ptr);
+				return res;
+			}
+			++it;
+		}
+
+		m_misses++;
+		values.shrink_to_fit();
+		res.m_values = std::make_shared<const vector_t>(std::move(values));
+		m_values.emplace(h, res.m_values);
+
+		// Drop the expired entries once in a while, so that the pool
+		// doesn't grow with values that are no longer used
+		if(m_values.size() >= 2 * m_size_after_collect + 64)
+		{
+			collect();
+		}
+		return res;
+	}
+
+	/**
+	 * @brief Removes the references to the values that have been freed.
+	 */
+	void collect()
+	{
+		for(auto it = m_values.begin(); it != m_values.end();)
+		{
+			if(it->second.expired())
+			{
+				it = m_values.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		m_size_after_collect = m_values.size();
+	}
+
+	stats get_stats() const
+	{
+		stats res;
+		for(const auto& it : m_values)
+		{
+			auto ptr = it.second.lock();
+			if(!ptr)
+			{
+				continue;
+			}
+
+			// Don't count the reference we just took
+			uint64_t refs = ptr.use_count() - 1;
+			uint64_t bytes = sizeof(vector_t) + ptr->capacity() * sizeof(T);
+			for(const auto& v : *ptr)
+			{
+				bytes += interned::heap_footprint(v);
+			}
+
+			res.m_values++;
+			res.m_refs += refs;
+			res.m_bytes += bytes;
+			res.m_unshared_bytes += bytes * refs;
+		}
+		res.m_hits = m_hits;
+		res.m_misses = m_misses;
+		return res;
+	}
+
+	void clear()
+	{
+		m_values.clear();
+		m_size_after_collect = 0;
+	}
+
+private:
+	static size_t hash(const vector_t& values)
+	{
+		size_t seed = values.size();
+		for(const auto& v : values)
+		{
+			seed ^= interned::hash(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		}
+		return seed;
+	}
+
+	std::unordered_multimap<size_t, std::weak_ptr<const vector_t>> m_values;
+	size_t m_size_after_collect = 0;
+	uint64_t m_hits = 0;
+	uint64_t m_misses = 0;
+};
+
+/**
+ * @brief A vector of strings kept as the buffer of NUL-terminated strings
+ * it comes from, e.g. the arguments of an execve, which is split and
+ * interned only the first time the strings are accessed. Copies share the
+ * buffer, and the buffer is dropped once the strings have been built.
+ */
+class lazy_strvec
+{
+public:
+	using vector_t = std::vector<std::string>;
+	using const_iterator = vector_t::const_iterator;
+
+	lazy_strvec(): m_pool(nullptr) { }
+
+	lazy_strvec(interned_vector<std::string> values):
+		m_values(std::move(values)),
+		m_pool(nullptr) { }
+
+	/**
+	 * @brief Replaces the strings with the ones in the len bytes at data,
+	 * to be interned in pool, if any, when they are first accessed. A
+	 * last string without its NUL terminator is kept too.
+	 */
+	void assign(const char* data, size_t len, interned_pool<std::string>* pool)
+	{
+		m_values = interned_vector<std::string>();
+		m_pool = pool;
+		if(len == 0)
+		{
+			m_buf.reset();
+			return;
+		}
+
+		auto buf = std::make_shared<std::string>(data, len);
+		if(buf->back() != '\0')
+		{
+			buf->push_back('\0');
+		}
+		m_buf = std::move(buf);
+	}
+
+	/**
+	 * @brief Returns true if the strings haven't been built yet.
+	 */
+	inline bool is_lazy() const { return m_buf != nullptr; }
+
+	inline const vector_t& get() const
+	{
+		if(m_buf)
+		{
+			materialize();
+		}
+		return m_values.get();
+	}
+
+	inline operator const vector_t&() const { return get(); }
+
+	inline size_t size() const
+	{
+		if(m_buf)
+		{
+			size_t n = 0;
+			for(char c : *m_buf)
+			{
+				n += (c == '\0');
+			}
+			return n;
+		}
+		return m_values.size();
+	}
+
+	inline bool empty() const { return !m_buf && m_values.empty(); }
+	inline const std::string& operator[](size_t i) const { return get()[i]; }
+	inline const std::string& at(size_t i) const { return get().at(i); }
+	inline const_iterator begin() const { return get().begin(); }
+	inline const_iterator end() const { return get().end(); }
+
+	/**
+	 * @brief Appends the strings to out, separated by sep, without
+	 * building them if they haven't been yet.
+	 */
+	void join(std::string& out, char sep) const
+	{
+		if(m_buf)
+		{
+			size_t start = out.size();
+			out.append(*m_buf, 0, m_buf->size() - 1);
+			for(size_t j = start; j < out.size(); j++)
+			{
+				if(out[j] == '\0')
+				{
+					out[j] = sep;
+				}
+			}
+			return;
+		}
+
+		for(size_t j = 0; j < m_values.size(); j++)
+		{
+			if(j != 0)
+			{
+				out += sep;
+			}
+			out += m_values[j];
+		}
+	}
+
+	/**
+	 * @brief Returns true if the two vectors use the same storage.
+	 */
+	inline bool shares_storage_with(const lazy_strvec& other) const
+	{
+		if(m_buf && m_buf == other.m_buf)
+		{
+			return true;
+		}
+		get();
+		other.get();
+		return m_values.shares_storage_with(other.m_values);
+	}
+
+	inline bool operator==(const lazy_strvec& other) const
+	{
+		// the buffers are always NUL-terminated, so that equal buffers
+		// and equal strings go together
+		if(m_buf && other.m_buf)
+		{
+			return m_buf == other.m_buf || *m_buf == *other.m_buf;
+		}
+		return get() == other.get();
+	}
+
+	inline bool operator!=(const lazy_strvec& other) const
+	{
+		return !(*this == other);
+	}
+
+	friend inline bool operator==(const lazy_strvec& a, const vector_t& b)
+	{
+		return a.get() == b;
+	}
+
+	friend inline bool operator==(const vector_t& a, const lazy_strvec& b)
+	{
+		return a == b.get();
+	}
+
+private:
+	void materialize() const
+	{
+		vector_t values;
+		const char* p = m_buf->data();
+		const char* end = p + m_buf->size();
+		while(p < end)
+		{
+			size_t len = strlen(p);
+			values.emplace_back(p, len);
+			p += len + 1;
+		}
+
+		m_values = m_pool ? m_pool->intern(std::move(values)) : interned_vector<std::string>(std::move(values));
+		m_buf.reset();
+	}
+
+	mutable std::shared_ptr<const std::string> m_buf;
+	mutable interned_vector<std::string> m_values;
+	interned_pool<std::string>* m_pool;
+};
+
+} // libsinsp
@@ -24,9 +24,10 @@ limitations under the License.
 
 #include "json_query.h"
 #include "sinsp.h"
+#include <cmath>
 
 json_query::json_query(const std::string& json, const std::string& filter, bool dbg) :
-	m_jq(jq_init()), m_input{0}, m_result{0}, m_processed(false)
+	m_jq(jq_init()), m_input{0}, m_result{0}, m_processed(false), m_compiled(false)
 {
 	if(!m_jq) { cleanup(); }
 	process(json, filter, dbg);
@@ -44,10 +45,16 @@ bool json_query::process(const std::string& json, const std::string& filter, boo
 	clear();
 
 	if(!m_jq) { cleanup(); }
-	if(!jq_compile(m_jq, filter.c_str()))
+	if(!m_compiled || filter != m_compiled_filter)
 	{
-		m_error = "Filter parsing failed.";
-		return false;
+		m_compiled = false;
+		if(!jq_compile(m_jq, filter.c_str()))
+		{
+			m_error = "Filter parsing failed.";
+			return false;
+		}
+		m_compiled_filter = filter;
+		m_compiled = true;
 	}
 
 	m_input = jv_parse/*_sized*/(json.c_str()/*, json.length()*/);
@@ -95,6 +102,88 @@ const std::string& json_query::result(int flags)
 	return m_filtered_json;
 }
 
+bool json_query::result(Json::Value& root)
+{
+	if(!m_processed || !m_error.empty())
+	{
+		return false;
+	}
+
+	to_json(m_result, root);
+	cleanup(m_result);
+	clear();
+	return true;
+}
+
+//
+// Doesn't consume j
+//
+void json_query::to_json(jv j, Json::Value& out)
+{
+	switch(jv_get_kind(j))
+	{
+	case JV_KIND_FALSE:
+		out = false;
+		break;
+	case JV_KIND_TRUE:
+		out = true;
+		break;
+	case JV_KIND_NUMBER:
+	{
+		// jq numbers are doubles; integral ones are kept as integers, as
+		// Json::Reader does when parsing the dumped result
+		double d = jv_number_value(j);
+		if(d == floor(d) && d >= -9223372036854775808.0 && d < 9223372036854775808.0)
+		{
+			out = Json::Value((Json::Int64)d);
+		}
+		else if(d == floor(d) && d > 0 && d < 18446744073709551616.0)
+		{
+			out = Json::Value((Json::UInt64)d);
+		}
+		else
+		{
+			out = d;
+		}
+		break;
+	}
+	case JV_KIND_STRING:
+	{
+		const char* str = jv_string_value(j);
+		out = Json::Value(str, str + jv_string_length_bytes(jv_copy(j)));
+		break;
+	}
+	case JV_KIND_ARRAY:
+	{
+		out = Json::Value(Json::arrayValue);
+		int len = jv_array_length(jv_copy(j));
+		for(int i = 0; i < len; i++)
+		{
+			jv elem = jv_array_get(jv_copy(j), i);
+			to_json(elem, out[(Json::ArrayIndex)i]);
+			jv_free(elem);
+		}
+		break;
+	}
+	case JV_KIND_OBJECT:
+	{
+		out = Json::Value(Json::objectValue);
+		for(int it = jv_object_iter(j); jv_object_iter_valid(j, it); it = jv_object_iter_next(j, it))
+		{
+			jv key = jv_object_iter_key(j, it);
+			jv val = jv_object_iter_value(j, it);
+			to_json(val, out[jv_string_value(key)]);
+			jv_free(key);
+			jv_free(val);
+		}
+		break;
+	}
+	default:
+		out = Json::Value();
+		break;
+	}
+}
+
 void json_query::clear()
 {
 	m_result = jv_null();
@@ -45,6 +45,7 @@ extern "C"
 }
 
 #include <string>
+#include "json/json.h"
 
 class json_query
 {
@@ -61,12 +62,18 @@ public:
 	bool process(const std::string& json, const std::string& filter, bool dbg = false);
 	const std::string& result(int flags = 0);
 
+	// Converts the result of the last process() directly to a Json::Value,
+	// without dumping it to a string and parsing it again; returns false if
+	// there is no result.
+	bool result(Json::Value& root);
+
 	const std::string& get_error() const;
 
 private:
 	void clear();
 	void cleanup();
 	void cleanup(jv& j, const std::string& msg = "");
+	static void to_json(jv j, Json::Value& out);
 
 	jq_state*           m_jq;
 	std::string         m_json;
@@ -75,6 +82,10 @@ private:
 	jv                  m_input;
 	jv                  m_result;
 	bool                m_processed;
+	// the filter currently compiled in m_jq, so that processing many JSONs
+	// with the same filter compiles it only once
+	std::string         m_compiled_filter;
+	bool                m_compiled;
 	mutable std::string m_error;
 };
 
@@ -0,0 +1,751 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <charconv>
+#include <cstring>
+
+#include "json_stream.h"
+
+using namespace libsinsp::json;
+
+reader::reader(const char* data, size_t len):
+	m_begin(data),
+	m_cur(data),
+	m_end(data + len),
+	m_error(false),
+	m_error_msg(NULL),
+	m_error_pos(0)
+{
+}
+
+void reader::fail(const char* msg)
+{
+	if(!m_error)
+	{
+		m_error = true;
+		m_error_msg = msg;
+		m_error_pos = m_cur - m_begin;
+	}
+	m_cur = m_end;
+}
+
+std::string reader::get_error() const
+{
+	if(!m_error)
+	{
+		return "";
+	}
+	return std::string(m_error_msg) + " at offset " + std::to_string(m_error_pos);
+}
+
+void reader::skip_ws()
+{
+	while(m_cur < m_end && (*m_cur == ' ' || *m_cur == '\n' || *m_cur == '\r' || *m_cur == '\t'))
+	{
+		m_cur++;
+	}
+}
+
+reader::value_type reader::peek()
+{
+	skip_ws();
+	if(m_cur == m_end)
+	{
+		return T_INVALID;
+	}
+
+	switch(*m_cur)
+	{
+	case 'n':
+		return T_NULL;
+	case 't':
+	case 'f':
+		return T_BOOL;
+	case '"':
+		return T_STRING;
+	case '[':
+		return T_ARRAY;
+	case '{':
+		return T_OBJECT;
+	case '-':
+		return T_NUMBER;
+	default:
+		return (*m_cur >= '0' && *m_cur <= '9') ? T_NUMBER : T_INVALID;
+	}
+}
+
+bool reader::begin_object()
+{
+	if(peek() != T_OBJECT)
+	{
+		skip();
+		return false;
+	}
+	m_cur++;
+	return true;
+}
+
+//
+// True if nothing was read since the object or array was entered, i.e.
+// the last non-whitespace character is its opening bracket: no value
+// ends with one
+//
+bool reader::at_first_item(char open) const
+{
+	const char* p = m_cur;
+	while(p > m_begin && (p[-1] == ' ' || p[-1] == '\n' || p[-1] == '\r' || p[-1] == '\t'))
+	{
+		p--;
+	}
+	return p > m_begin && p[-1] == open;
+}
+
+bool reader::next_member(std::string& key)
+{
+	return next_member(&key);
+}
+
+bool reader::next_member(std::string* key)
+{
+	skip_ws();
+	if(m_cur == m_end)
+	{
+		fail("unterminated object");
+		return false;
+	}
+
+	if(*m_cur == '}')
+	{
+		m_cur++;
+		return false;
+	}
+
+	if(!at_first_item('{'))
+	{
+		if(*m_cur != ',')
+		{
+			fail("expected ',' or '}'");
+			return false;
+		}
+		m_cur++;
+		skip_ws();
+	}
+
+	if(m_cur == m_end || *m_cur != '"')
+	{
+		fail("expected a member name");
+		return false;
+	}
+
+	if(!parse_string(key))
+	{
+		return false;
+	}
+
+	skip_ws();
+	if(m_cur == m_end || *m_cur != ':')
+	{
+		fail("expected ':'");
+		return false;
+	}
+	m_cur++;
+	return true;
+}
+
+bool reader::begin_array()
+{
+	if(peek() != T_ARRAY)
+	{
+		skip();
+		return false;
+	}
+	m_cur++;
+	return true;
+}
+
+bool reader::next_element()
+{
+	skip_ws();
+	if(m_cur == m_end)
+	{
+		fail("unterminated array");
+		return false;
+	}
+
+	if(*m_cur == ']')
+	{
+		m_cur++;
+		return false;
+	}
+
+	if(!at_first_item('['))
+	{
+		if(*m_cur != ',')
+		{
+			fail("expected ',' or ']'");
+			return false;
+		}
+		m_cur++;
+		skip_ws();
+		if(m_cur == m_end)
+		{
+			fail("unterminated array");
+			return false;
+		}
+		if(*m_cur == ']')
+		{
+			fail("expected a value");
+			return false;
+		}
+	}
+	return true;
+}
+
+static inline int hex_digit(char c)
+{
+	if(c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if(c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	if(c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+static inline bool parse_hex4(const char* p, const char* end, uint32_t& cp)
+{
+	if(end - p < 4)
+	{
+		return false;
+	}
+
+	cp = 0;
+	for(int j = 0; j < 4; j++)
+	{
+		int d = hex_digit(p[j]);
+		if(d < 0)
+		{
+			return false;
+		}
+		cp = (cp << 4) | d;
+	}
+	return true;
+}
+
+static inline void append_utf8(std::string& out, uint32_t cp)
+{
+	if(cp < 0x80)
+	{
+		out.push_back((char)cp);
+	}
+	else if(cp < 0x800)
+	{
+		out.push_back((char)(0xc0 | (cp >> 6)));
+		out.push_back((char)(0x80 | (cp & 0x3f)));
+	}
+	else if(cp < 0x10000)
+	{
+		out.push_back((char)(0xe0 | (cp >> 12)));
+		out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+		out.push_back((char)(0x80 | (cp & 0x3f)));
+	}
+	else
+	{
+		out.push_back((char)(0xf0 | (cp >> 18)));
+		out.push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+		out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+		out.push_back((char)(0x80 | (cp & 0x3f)));
+	}
+}
+
+//
+// Parse the string at m_cur, storing it unescaped in val if not NULL
+//
+bool reader::parse_string(std::string* val)
+{
+	m_cur++;
+	if(val != NULL)
+	{
+		val->clear();
+	}
+
+	while(true)
+	{
+		// Copy the runs of plain characters at once
+		const char* start = m_cur;
+		while(m_cur < m_end && *m_cur != '"' && *m_cur != '\\')
+		{
+			m_cur++;
+		}
+		if(val != NULL)
+		{
+			val->append(start, m_cur - start);
+		}
+
+		if(m_cur == m_end)
+		{
+			fail("unterminated string");
+			return false;
+		}
+
+		if(*m_cur == '"')
+		{
+			m_cur++;
+			return true;
+		}
+
+		// An escape sequence
+		m_cur++;
+		if(m_cur == m_end)
+		{
+			fail("unterminated string");
+			return false;
+		}
+
+		char c = *m_cur++;
+		char unescaped;
+		switch(c)
+		{
+		case '"':
+		case '\\':
+		case '/':
+			unescaped = c;
+			break;
+		case 'b':
+			unescaped = '\b';
+			break;
+		case 'f':
+			unescaped = '\f';
+			break;
+		case 'n':
+			unescaped = '\n';
+			break;
+		case 'r':
+			unescaped = '\r';
+			break;
+		case 't':
+			unescaped = '\t';
+			break;
+		case 'u':
+		{
+			uint32_t cp;
+			if(!parse_hex4(m_cur, m_end, cp))
+			{
+				fail("invalid unicode escape");
+				return false;
+			}
+			m_cur += 4;
+
+			// A surrogate pair
+			uint32_t low;
+			if(cp >= 0xd800 && cp < 0xdc00 &&
+			   m_end - m_cur >= 6 && m_cur[0] == '\\' && m_cur[1] == 'u' &&
+			   parse_hex4(m_cur + 2, m_end, low) && low >= 0xdc00 && low < 0xe000)
+			{
+				cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+				m_cur += 6;
+			}
+
+			if(val != NULL)
+			{
+				append_utf8(*val, cp);
+			}
+			continue;
+		}
+		default:
+			fail("invalid escape");
+			return false;
+		}
+
+		if(val != NULL)
+		{
+			val->push_back(unescaped);
+		}
+	}
+}
+
+bool reader::parse_number(bool& negative, uint64_t& magnitude, bool& integer)
+{
+	negative = false;
+	magnitude = 0;
+	integer = true;
+
+	if(*m_cur == '-')
+	{
+		negative = true;
+		m_cur++;
+	}
+
+	const char* digits = m_cur;
+	while(m_cur < m_end && *m_cur >= '0' && *m_cur <= '9')
+	{
+		uint64_t d = *m_cur - '0';
+		if(magnitude > (UINT64_MAX - d) / 10)
+		{
+			// Too large for an integer
+			integer = false;
+		}
+		magnitude = magnitude * 10 + d;
+		m_cur++;
+	}
+
+	if(m_cur == digits)
+	{
+		fail("invalid number");
+		return false;
+	}
+
+	// Fraction and exponent, each with at least one digit
+	if(m_cur < m_end && *m_cur == '.')
+	{
+		integer = false;
+		m_cur++;
+		if(!skip_digits())
+		{
+			fail("invalid number");
+			return false;
+		}
+	}
+
+	if(m_cur < m_end && (*m_cur == 'e' || *m_cur == 'E'))
+	{
+		integer = false;
+		m_cur++;
+		if(m_cur < m_end && (*m_cur == '+' || *m_cur == '-'))
+		{
+			m_cur++;
+		}
+		if(!skip_digits())
+		{
+			fail("invalid number");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool reader::skip_digits()
+{
+	const char* start = m_cur;
+	while(m_cur < m_end && *m_cur >= '0' && *m_cur <= '9')
+	{
+		m_cur++;
+	}
+	return m_cur != start;
+}
+
+bool reader::expect_literal(const char* lit, size_t len)
+{
+	if((size_t)(m_end - m_cur) < len || memcmp(m_cur, lit, len) != 0)
+	{
+		fail("invalid literal");
+		return false;
+	}
+	m_cur += len;
+	return true;
+}
+
+bool reader::read_string(std::string& val)
+{
+	if(peek() != T_STRING)
+	{
+		skip();
+		return false;
+	}
+	return parse_string(&val);
+}
+
+bool reader::read_int64(int64_t& val)
+{
+	if(peek() != T_NUMBER)
+	{
+		skip();
+		return false;
+	}
+
+	bool negative;
+	uint64_t magnitude;
+	bool integer;
+	if(!parse_number(negative, magnitude, integer) || !integer)
+	{
+		return false;
+	}
+
+	if(negative)
+	{
+		if(magnitude > (uint64_t)INT64_MAX + 1)
+		{
+			return false;
+		}
+		val = (int64_t)(0 - magnitude);
+	}
+	else
+	{
+		if(magnitude > (uint64_t)INT64_MAX)
+		{
+			return false;
+		}
+		val = (int64_t)magnitude;
+	}
+	return true;
+}
+
+bool reader::read_uint64(uint64_t& val)
+{
+	if(peek() != T_NUMBER)
+	{
+		skip();
+		return false;
+	}
+
+	bool negative;
+	uint64_t magnitude;
+	bool integer;
+	if(!parse_number(negative, magnitude, integer) || !integer ||
+	   (negative && magnitude != 0))
+	{
+		return false;
+	}
+
+	val = magnitude;
+	return true;
+}
+
+bool reader::read_bool(bool& val)
+{
+	if(peek() != T_BOOL)
+	{
+		skip();
+		return false;
+	}
+
+	val = *m_cur == 't';
+	return val ? expect_literal("true", 4) : expect_literal("false", 5);
+}
+
+void reader::skip()
+{
+	skip_value(0);
+}
+
+//
+// Skip the next value, validating it like the reads do, so that a
+// malformed document is rejected whichever fields the caller reads
+//
+void reader::skip_value(uint32_t depth)
+{
+	bool negative;
+	uint64_t magnitude;
+	bool integer;
+
+	switch(peek())
+	{
+	case T_NULL:
+		expect_literal("null", 4);
+		return;
+	case T_BOOL:
+		if(*m_cur == 't')
+		{
+			expect_literal("true", 4);
+		}
+		else
+		{
+			expect_literal("false", 5);
+		}
+		return;
+	case T_NUMBER:
+		parse_number(negative, magnitude, integer);
+		return;
+	case T_STRING:
+		parse_string(NULL);
+		return;
+	case T_ARRAY:
+	case T_OBJECT:
+		break;
+	case T_INVALID:
+	default:
+		fail(m_cur == m_end ? "unexpected end" : "unexpected character");
+		return;
+	}
+
+	if(depth >= MAX_DEPTH)
+	{
+		fail("too deeply nested");
+		return;
+	}
+
+	if(*m_cur == '{')
+	{
+		m_cur++;
+		while(next_member(NULL))
+		{
+			skip_value(depth + 1);
+		}
+	}
+	else
+	{
+		m_cur++;
+		while(next_element())
+		{
+			skip_value(depth + 1);
+		}
+	}
+}
+
+bool reader::at_end()
+{
+	skip_ws();
+	return !m_error && m_cur == m_end;
+}
+
+writer::writer(std::string& out):
+	m_out(out),
+	m_need_comma(false)
+{
+}
+
+void writer::begin_object()
+{
+	separator();
+	m_out.push_back('{');
+	m_need_comma = false;
+}
+
+void writer::end_object()
+{
+	m_out.push_back('}');
+	m_need_comma = true;
+}
+
+void writer::begin_array()
+{
+	separator();
+	m_out.push_back('[');
+	m_need_comma = false;
+}
+
+void writer::end_array()
+{
+	m_out.push_back(']');
+	m_need_comma = true;
+}
+
+void writer::key(const char* key)
+{
+	separator();
+	append_quoted(key, strlen(key));
+	m_out.push_back(':');
+	m_need_comma = false;
+}
+
+void writer::value(const char* val, size_t len)
+{
+	separator();
+	append_quoted(val, len);
+}
+
+void writer::value(const char* val)
+{
+	value(val, strlen(val));
+}
+
+void writer::value(int64_t val)
+{
+	char buf[24];
+	separator();
+	m_out.append(buf, std::to_chars(buf, buf + sizeof(buf), val).ptr - buf);
+}
+
+void writer::value(uint64_t val)
+{
+	char buf[24];
+	separator();
+	m_out.append(buf, std::to_chars(buf, buf + sizeof(buf), val).ptr - buf);
+}
+
+void writer::value(bool val)
+{
+	separator();
+	m_out.append(val ? "true" : "false");
+}
+
+void writer::null()
+{
+	separator();
+	m_out.append("null");
+}
+
+void writer::append_quoted(const char* val, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	m_out.push_back('"');
+	const char* end = val + len;
+	while(val < end)
+	{
+		// Copy the runs of characters not needing an escape at once
+		const char* start = val;
+		while(val < end && *val != '"' && *val != '\\' && (unsigned char)*val >= 0x20)
+		{
+			val++;
+		}
+		m_out.append(start, val - start);
+		if(val == end)
+		{
+			break;
+		}
+
+		char c = *val++;
+		switch(c)
+		{
+		case '"':
+			m_out.append("\\\"");
+			break;
+		case '\\':
+			m_out.append("\\\\");
+			break;
+		case '\n':
+			m_out.append("\\n");
+			break;
+		case '\r':
+			m_out.append("\\r");
+			break;
+		case '\t':
+			m_out.append("\\t");
+			break;
+		case '\b':
+			m_out.append("\\b");
+			break;
+		case '\f':
+			m_out.append("\\f");
+			break;
+		default:
+			m_out.append("\\u00");
+			m_out.push_back(hex[(c >> 4) & 0xf]);
+			m_out.push_back(hex[c & 0xf]);
+			break;
+		}
+	}
+	m_out.push_back('"');
+}
@@ -0,0 +1,164 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace libsinsp {
+namespace json {
+
+// A pull parser walking a JSON document in place, for the hot paths that
+// only pick a few known fields out of it (e.g. the container events),
+// without building a Json::Value tree first. The values are read in
+// document order: the caller asks for the type it expects, and any value
+// it's not interested in, or that has another type, is skipped.
+//
+// Malformed documents put the reader in an error state, where every read
+// fails, so that the loops over the members and elements end. The skipped
+// values are validated as well, and at_end() tells whether anything
+// follows the root value.
+class reader
+{
+public:
+	enum value_type
+	{
+		T_NULL,
+		T_BOOL,
+		T_NUMBER,
+		T_STRING,
+		T_ARRAY,
+		T_OBJECT,
+		T_INVALID,
+	};
+
+	reader(const char* data, size_t len);
+
+	//
+	// Return the type of the next value, without consuming it
+	//
+	value_type peek();
+
+	//
+	// Enter an object and iterate its members, storing their key. After
+	// next_member() returns true, the value of the member must be read
+	// or skipped.
+	//
+	bool begin_object();
+	bool next_member(std::string& key);
+
+	//
+	// Enter an array and iterate its elements. After next_element()
+	// returns true, the element must be read or skipped.
+	//
+	bool begin_array();
+	bool next_element();
+
+	//
+	// Read the next value. If it has another type it's skipped and false
+	// is returned. The integer reads also fail if the value is not an
+	// integer or is out of range.
+	//
+	bool read_string(std::string& val);
+	bool read_int64(int64_t& val);
+	bool read_uint64(uint64_t& val);
+	bool read_bool(bool& val);
+
+	void skip();
+
+	//
+	// After the root value, true if only whitespace is left
+	//
+	bool at_end();
+
+	inline bool error() const
+	{
+		return m_error;
+	}
+
+	//
+	// The description of the first error, with its offset
+	//
+	std::string get_error() const;
+
+private:
+	// The nesting allowed in the skipped values, like the jsoncpp reader
+	static constexpr uint32_t MAX_DEPTH = 1000;
+
+	void fail(const char* msg);
+	void skip_ws();
+	bool at_first_item(char open) const;
+	bool next_member(std::string* key);
+	void skip_value(uint32_t depth);
+	bool skip_digits();
+	bool parse_string(std::string* val);
+	bool parse_number(bool& negative, uint64_t& magnitude, bool& integer);
+	bool expect_literal(const char* lit, size_t len);
+
+	const char* m_begin;
+	const char* m_cur;
+	const char* m_end;
+	bool m_error;
+	const char* m_error_msg;
+	size_t m_error_pos;
+};
+
+// Appends a JSON document to a string, without building a Json::Value
+// tree first. The separators are handled by the writer: a member is a
+// key() followed by a value or by a nested object or array.
+class writer
+{
+public:
+	explicit writer(std::string& out);
+
+	void begin_object();
+	void end_object();
+	void begin_array();
+	void end_array();
+
+	void key(const char* key);
+	void value(const char* val, size_t len);
+	void value(const std::string& val)
+	{
+		value(val.data(), val.length());
+	}
+	void value(const char* val);
+	void value(int64_t val);
+	void value(uint64_t val);
+	void value(bool val);
+	void null();
+
+private:
+	inline void separator()
+	{
+		if(m_need_comma)
+		{
+			m_out.push_back(',');
+		}
+		m_need_comma = true;
+	}
+
+	void append_quoted(const char* val, size_t len);
+
+	std::string& m_out;
+	bool m_need_comma;
+};
+
+} // json
+} // libsinsp
@@ -97,8 +97,91 @@ const k8s_component::type_map k8s_component::list =
 	{ k8s_component::K8S_EVENTS,                 "events"                 }
 };
 
+//
+// pair list pool
+//
+
+std::mutex k8s_pair_list_pool::s_mutex;
+std::unordered_multimap<size_t, std::weak_ptr<const k8s_pair_list>> k8s_pair_list_pool::s_lists;
+size_t k8s_pair_list_pool::s_purge_size = 1024;
+
+k8s_pair_list_pool::ptr_t k8s_pair_list_pool::intern(k8s_pair_list&& list)
+{
+	static const ptr_t empty_list = std::make_shared<const k8s_pair_list>();
+	if(list.empty())
+	{
+		return empty_list;
+	}
+
+	size_t h = hash(list);
+	std::lock_guard<std::mutex> lock(s_mutex);
+	auto range = s_lists.equal_range(h);
+	for(auto it = range.first; it != range.second; ++it)
+	{
+		ptr_t existing = it->second.lock();
+		if(existing && *existing == list)
+		{
+			return existing;
+		}
+	}
+
+	ptr_t res = std::make_shared<const k8s_pair_list>(std::move(list));
+	s_lists.emplace(h, res);
+	if(s_lists.size() >= s_purge_size)
+	{
+		purge();
+	}
+	return res;
+}
+
+size_t k8s_pair_list_pool::size()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	size_t n = 0;
+	for(const auto& it : s_lists)
+	{
+		if(!it.second.expired())
+		{
+			n++;
+		}
+	}
+	return n;
+}
+
+size_t k8s_pair_list_pool::hash(const k8s_pair_list& list)
+{
+	std::hash<std::string> hasher;
+	size_t h = list.size();
+	for(const auto& pair : list)
+	{
+		h = h * 31 + hasher(pair.first);
+		h = h * 31 + hasher(pair.second);
+	}
+	return h;
+}
+
+// Drops the lists not used by any component anymore, called with the
+// mutex held whenever the pool doubles in size
+void k8s_pair_list_pool::purge()
+{
+	for(auto it = s_lists.begin(); it != s_lists.end();)
+	{
+		if(it->second.expired())
+		{
+			it = s_lists.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	s_purge_size = std::max<size_t>(1024, 2 * s_lists.size());
+}
+
 k8s_component::k8s_component(type comp_type, const std::string& name, const std::string& uid, const std::string& ns) :
-	m_type(comp_type), m_name(name), m_uid(uid), m_ns(ns)
+	m_type(comp_type), m_name(name), m_uid(uid), m_ns(ns),
+	m_labels(k8s_pair_list_pool::intern(k8s_pair_list())),
+	m_selectors(k8s_pair_list_pool::intern(k8s_pair_list()))
 {
 }
 
@@ -349,50 +432,52 @@ std::string k8s_component::get_api(const std::string& name, ext_list_ptr_t exten
 	return get_api(get_type(name), extensions);
 }
 
-k8s_pair_t* k8s_component::get_label(const k8s_pair_t& label)
+static const k8s_pair_t* find_pair(const k8s_pair_list& list, const k8s_pair_t& pair)
 {
-	for (auto& lbl : m_labels)
+	for (auto& p : list)
 	{
-		if((lbl.first == label.first) && (lbl.second == label.second))
+		if((p.first == pair.first) && (p.second == pair.second))
 		{
-			return &lbl;
+			return &p;
 		}
 	}
 	return 0;
 }
 
+const k8s_pair_t* k8s_component::get_label(const k8s_pair_t& label) const
+{
+	return find_pair(*m_labels, label);
+}
+
 void k8s_component::add_labels(k8s_pair_list&& labels)
 {
+	k8s_pair_list merged(*m_labels);
 	for (auto& label : labels)
 	{
-		if(!get_label(label))
+		if(!find_pair(merged, label))
 		{
-			emplace_label(std::move(label));
+			merged.emplace_back(std::move(label));
 		}
 	}
+	m_labels = k8s_pair_list_pool::intern(std::move(merged));
 }
 
-k8s_pair_t* k8s_component::get_selector(const k8s_pair_t& selector)
+const k8s_pair_t* k8s_component::get_selector(const k8s_pair_t& selector) const
 {
-	for (auto& sel : m_selectors)
-	{
-		if((sel.first == selector.first) && (sel.second == selector.second))
-		{
-			return &sel;
-		}
-	}
-	return 0;
+	return find_pair(*m_selectors, selector);
 }
 
 void k8s_component::add_selectors(k8s_pair_list&& selectors)
 {
+	k8s_pair_list merged(*m_selectors);
 	for (auto& selector : selectors)
 	{
-		if(!get_selector(selector))
+		if(!find_pair(merged, selector))
 		{
-			emplace_selector(std::move(selector));
+			merged.emplace_back(std::move(selector));
 		}
 	}
+	m_selectors = k8s_pair_list_pool::intern(std::move(merged));
 }
 
 // TODO: proper selection process is more complicated, see “Labels and Selectors” at
@@ -31,10 +31,37 @@ limitations under the License.
 #include "user_event_logger.h"
 #include <vector>
 #include <unordered_set>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
 
 typedef std::pair<std::string, std::string> k8s_pair_t;
 typedef std::vector<k8s_pair_t>             k8s_pair_list;
 
+//
+// Label and selector lists are interned: components with the same list
+// (eg. the pods of a replicaset) share one immutable copy, and changing
+// the list of a component replaces its copy.
+//
+class k8s_pair_list_pool
+{
+public:
+	typedef std::shared_ptr<const k8s_pair_list> ptr_t;
+
+	static ptr_t intern(k8s_pair_list&& list);
+
+	// number of distinct lists in use
+	static size_t size();
+
+private:
+	static size_t hash(const k8s_pair_list& list);
+	static void purge();
+
+	static std::mutex s_mutex;
+	static std::unordered_multimap<size_t, std::weak_ptr<const k8s_pair_list>> s_lists;
+	static size_t s_purge_size;
+};
+
 class k8s_pod_t;
 class k8s_service_t;
 
@@ -180,7 +207,7 @@ public:
 
 	void set_namespace(const std::string& ns);
 
-	k8s_pair_t* get_label(const k8s_pair_t& label);
+	const k8s_pair_t* get_label(const k8s_pair_t& label) const;
 
 	const k8s_pair_list& get_labels() const;
 
@@ -194,7 +221,7 @@ public:
 
 	void emplace_label(const k8s_pair_t& label);
 
-	k8s_pair_t* get_selector(const k8s_pair_t& selector);
+	const k8s_pair_t* get_selector(const k8s_pair_t& selector) const;
 
 	const k8s_pair_list& get_selectors() const;
 
@@ -258,8 +285,8 @@ private:
 	std::string   m_name;
 	std::string   m_uid;
 	std::string   m_ns;
-	k8s_pair_list m_labels;
-	k8s_pair_list m_selectors;
+	k8s_pair_list_pool::ptr_t m_labels;
+	k8s_pair_list_pool::ptr_t m_selectors;
 
 	friend class k8s_state_t;
 	friend class k8s_dispatcher;
@@ -668,52 +695,62 @@ inline void k8s_component::set_namespace(const std::string& ns)
 
 inline const k8s_pair_list& k8s_component::get_labels() const
 {
-	return m_labels;
+	return *m_labels;
 }
 
 inline void k8s_component::set_labels(k8s_pair_list&& labels)
 {
-	m_labels = std::move(labels);
+	m_labels = k8s_pair_list_pool::intern(std::move(labels));
 }
 
 inline void k8s_component::swap_labels(k8s_pair_list& new_labels)
 {
-	m_labels.swap(new_labels);
+	k8s_pair_list old_labels(*m_labels);
+	m_labels = k8s_pair_list_pool::intern(std::move(new_labels));
+	new_labels.swap(old_labels);
 }
 
 inline void k8s_component::push_label(const k8s_pair_t& label)
 {
-	m_labels.push_back(label);
+	k8s_pair_list labels(*m_labels);
+	labels.push_back(label);
+	m_labels = k8s_pair_list_pool::intern(std::move(labels));
 }
 
 inline void k8s_component::emplace_label(const k8s_pair_t& label)
 {
-	m_labels.emplace_back(label);
+	push_label(label);
 }
 
 inline const k8s_pair_list& k8s_component::get_selectors() const
 {
-	return m_selectors;
+	return *m_selectors;
 }
 
 inline void k8s_component::set_selectors(k8s_pair_list&& selectors)
 {
-	m_selectors = std::move(selectors);
+	m_selectors = k8s_pair_list_pool::intern(std::move(selectors));
 }
 
 inline void k8s_component::swap_selectors(k8s_pair_list& new_selectors)
 {
-	m_selectors.swap(new_selectors);
+	k8s_pair_list old_selectors(*m_selectors);
+	m_selectors = k8s_pair_list_pool::intern(std::move(new_selectors));
+	new_selectors.swap(old_selectors);
 }
 
 inline void k8s_component::push_selector(const k8s_pair_t& selector)
 {
-	m_selectors.push_back(selector);
+	k8s_pair_list selectors(*m_selectors);
+	selectors.push_back(selector);
+	m_selectors = k8s_pair_list_pool::intern(std::move(selectors));
 }
 
 inline void k8s_component::emplace_selector(k8s_pair_t&& selector)
 {
-	m_selectors.emplace_back(std::move(selector));
+	k8s_pair_list selectors(*m_selectors);
+	selectors.emplace_back(std::move(selector));
+	m_selectors = k8s_pair_list_pool::intern(std::move(selectors));
 }
 
 inline const std::string& k8s_component::get_name(const component_pair& p)
@@ -119,7 +119,7 @@ void k8s_state_t::replace_items(k8s_component::type t, const std::string& name,
 	case k8s_component::K8S_NODES:
 		if(name == "labels")
 		{
-			m_nodes.back().m_labels = std::move(items);
+			m_nodes.back().set_labels(k8s_pair_list(items));
 			return;
 		}
 		break;
@@ -127,7 +127,7 @@ void k8s_state_t::replace_items(k8s_component::type t, const std::string& name,
 	case k8s_component::K8S_NAMESPACES:
 		if(name == "labels")
 		{
-			m_namespaces.back().m_labels = std::move(items);
+			m_namespaces.back().set_labels(k8s_pair_list(items));
 			return;
 		}
 		break;
@@ -135,7 +135,7 @@ void k8s_state_t::replace_items(k8s_component::type t, const std::string& name,
 	case k8s_component::K8S_PODS:
 		if(name == "labels")
 		{
-			m_pods.back().m_labels = std::move(items);
+			m_pods.back().set_labels(k8s_pair_list(items));
 			return;
 		}
 		break;
@@ -143,12 +143,12 @@ void k8s_state_t::replace_items(k8s_component::type t, const std::string& name,
 	case k8s_component::K8S_REPLICATIONCONTROLLERS:
 		if(name == "labels")
 		{
-			m_controllers.back().m_labels = std::move(items);
+			m_controllers.back().set_labels(k8s_pair_list(items));
 			return;
 		}
 		else if(name == "selector")
 		{
-			m_controllers.back().m_selectors = std::move(items);
+			m_controllers.back().set_selectors(k8s_pair_list(items));
 			return;
 		}
 		break;
@@ -156,12 +156,12 @@ void k8s_state_t::replace_items(k8s_component::type t, const std::string& name,
 	case k8s_component::K8S_REPLICASETS:
 		if(name == "labels")
 		{
-			m_replicasets.back().m_labels = std::move(items);
+			m_replicasets.back().set_labels(k8s_pair_list(items));
 			return;
 		}
 		else if(name == "selector")
 		{
-			m_replicasets.back().m_selectors = std::move(items);
+			m_replicasets.back().set_selectors(k8s_pair_list(items));
 			return;
 		}
 		break;
@@ -169,12 +169,12 @@ void k8s_state_t::replace_items(k8s_component::type t, const std::string& name,
 	case k8s_component::K8S_SERVICES:
 		if(name == "labels")
 		{
-			m_services.back().m_labels = std::move(items);
+			m_services.back().set_labels(k8s_pair_list(items));
 			return;
 		}
 		else if(name == "selector")
 		{
-			m_services.back().m_selectors = std::move(items);
+			m_services.back().set_selectors(k8s_pair_list(items));
 			return;
 		}
 		break;
@@ -182,12 +182,12 @@ void k8s_state_t::replace_items(k8s_component::type t, const std::string& name,
 	case k8s_component::K8S_DEPLOYMENTS:
 		if(name == "labels")
 		{
-			m_deployments.back().m_labels = std::move(items);
+			m_deployments.back().set_labels(k8s_pair_list(items));
 			return;
 		}
 		else if(name == "selector")
 		{
-			m_deployments.back().m_selectors = std::move(items);
+			m_deployments.back().set_selectors(k8s_pair_list(items));
 			return;
 		}
 		break;
@@ -195,12 +195,12 @@ void k8s_state_t::replace_items(k8s_component::type t, const std::string& name,
 	case k8s_component::K8S_DAEMONSETS:
 		if(name == "labels")
 		{
-			m_daemonsets.back().m_labels = std::move(items);
+			m_daemonsets.back().set_labels(k8s_pair_list(items));
 			return;
 		}
 		else if(name == "selector")
 		{
-			m_daemonsets.back().m_selectors = std::move(items);
+			m_daemonsets.back().set_selectors(k8s_pair_list(items));
 			return;
 		}
 		break;
@@ -0,0 +1,230 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <cstring>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "latency_profiler.h"
+#include "strlcpy.h"
+
+latency_profiler::latency_profiler():
+	m_sampling_ratio(0),
+	m_num_events(0),
+	m_sampling(false),
+	m_clock(WALL_CLOCK)
+{
+}
+
+bool latency_profiler::set_clock(clock_source clock)
+{
+#ifndef CLOCK_THREAD_CPUTIME_ID
+	if(clock == THREAD_CPU_CLOCK)
+	{
+		return false;
+	}
+#endif
+	if(clock != m_clock)
+	{
+		m_clock = clock;
+		clear();
+	}
+	return true;
+}
+
+void latency_profiler::set_sampling_ratio(uint32_t sampling_ratio)
+{
+	m_sampling_ratio = sampling_ratio;
+	m_num_events = 0;
+	m_sampling = false;
+	if(sampling_ratio != 0 && m_histograms.empty())
+	{
+		m_histograms.resize(STAGE_MAX * (PPM_EVENT_MAX + 1));
+		clear();
+	}
+}
+
+void latency_profiler::clear()
+{
+	if(!m_histograms.empty())
+	{
+		memset(m_histograms.data(), 0, m_histograms.size() * sizeof(histogram));
+	}
+}
+
+static inline void add_sample(latency_profiler::histogram& h, uint32_t bucket, uint64_t ns)
+{
+	h.m_count++;
+	h.m_sum_ns += ns;
+	if(ns > h.m_max_ns)
+	{
+		h.m_max_ns = ns;
+	}
+	h.m_buckets[bucket]++;
+}
+
+void latency_profiler::record(stage s, uint16_t evt_type, uint64_t ns)
+{
+	if(m_histograms.empty() || s >= STAGE_MAX)
+	{
+		return;
+	}
+
+	histogram* stage_histograms = &m_histograms[s * (PPM_EVENT_MAX + 1)];
+	uint32_t bucket = get_bucket(ns);
+	if(evt_type < PPM_EVENT_MAX)
+	{
+		add_sample(stage_histograms[evt_type], bucket, ns);
+	}
+	add_sample(stage_histograms[PPM_EVENT_MAX], bucket, ns);
+}
+
+const latency_profiler::histogram* latency_profiler::get_histogram(stage s, uint16_t evt_type) const
+{
+	if(m_histograms.empty() || s >= STAGE_MAX || evt_type > PPM_EVENT_MAX)
+	{
+		return NULL;
+	}
+
+	const histogram* h = &m_histograms[s * (PPM_EVENT_MAX + 1) + evt_type];
+	return h->m_count != 0 ? h : NULL;
+}
+
+static inline uint64_t bucket_upper_bound(uint32_t bucket)
+{
+	return bucket == 0 ? 0 : (((uint64_t)1) << bucket) - 1;
+}
+
+uint64_t latency_profiler::get_percentile(const histogram& h, double percentile)
+{
+	if(h.m_count == 0)
+	{
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t)(h.m_count * percentile / 100);
+	if(rank == 0)
+	{
+		rank = 1;
+	}
+
+	uint64_t seen = 0;
+	for(uint32_t j = 0; j < NUM_BUCKETS - 1; j++)
+	{
+		seen += h.m_buckets[j];
+		if(seen >= rank)
+		{
+			return std::min(bucket_upper_bound(j), h.m_max_ns);
+		}
+	}
+	return h.m_max_ns;
+}
+
+const char* latency_profiler::get_stage_name(stage s)
+{
+	switch(s)
+	{
+	case STAGE_NEXT:
+		return "next";
+	case STAGE_PARSE:
+		return "parse";
+	case STAGE_FILTER:
+		return "filter";
+	case STAGE_DUMP:
+		return "dump";
+	case STAGE_SCAP:
+		return "scap";
+	case STAGE_FORMAT:
+		return "format";
+	default:
+		return "unknown";
+	}
+}
+
+static void add_stat(std::vector<scap_stats_v2>& stats, const std::string& name, uint64_t value)
+{
+	scap_stats_v2 stat;
+	strlcpy(stat.name, name.c_str(), STATS_NAME_MAX);
+	stat.flags = PPM_SCAP_STATS_LATENCY;
+	stat.type = STATS_VALUE_TYPE_U64;
+	stat.value.u64 = value;
+	stats.push_back(stat);
+}
+
+void latency_profiler::add_stats(const std::string& prefix, const histogram& h, bool buckets)
+{
+	add_stat(m_stats, prefix + ".count", h.m_count);
+	add_stat(m_stats, prefix + ".sum_ns", h.m_sum_ns);
+	add_stat(m_stats, prefix + ".max_ns", h.m_max_ns);
+	add_stat(m_stats, prefix + ".p50_ns", get_percentile(h, 50));
+	add_stat(m_stats, prefix + ".p90_ns", get_percentile(h, 90));
+	add_stat(m_stats, prefix + ".p99_ns", get_percentile(h, 99));
+
+	if(!buckets)
+	{
+		return;
+	}
+
+	for(uint32_t j = 0; j < NUM_BUCKETS; j++)
+	{
+		if(h.m_buckets[j] != 0)
+		{
+			std::string bound = j == NUM_BUCKETS - 1 ? "inf" : std::to_string(bucket_upper_bound(j));
+			add_stat(m_stats, prefix + ".le_" + bound + "_ns", h.m_buckets[j]);
+		}
+	}
+}
+
+const scap_stats_v2* latency_profiler::get_stats(uint32_t* nstats)
+{
+	m_stats.clear();
+	for(uint32_t s = 0; s < STAGE_MAX; s++)
+	{
+		const histogram* total = get_histogram((stage)s, PPM_EVENT_MAX);
+		if(total == NULL)
+		{
+			continue;
+		}
+
+		std::string prefix = std::string(m_clock == THREAD_CPU_CLOCK ? "cpu." : "latency.") + get_stage_name((stage)s);
+		add_stats(prefix, *total, true);
+
+		for(uint16_t type = 0; type < PPM_EVENT_MAX; type++)
+		{
+			const histogram* h = get_histogram((stage)s, type);
+			if(h != NULL)
+			{
+				add_stats(prefix + "." + g_infotables.m_event_info[type].name + "_" + std::to_string(type), *h, false);
+			}
+		}
+	}
+
+	*nstats = m_stats.size();
+	return m_stats.data();
+}
+
+#ifdef GATHER_INTERNAL_STATS
+void latency_profiler::export_stats(internal_metrics::registry& registry)
+{
+	uint32_t nstats;
+	const scap_stats_v2* stats = get_stats(&nstats);
+	for(uint32_t i = 0; i < nstats; i++)
+	{
+		registry.register_counter(internal_metrics::metric_name(stats[i].name, stats[i].name)).add(stats[i].value.u64);
+	}
+}
+#endif
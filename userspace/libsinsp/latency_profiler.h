@@ -0,0 +1,235 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <scap.h>
+#include "sinsp_public.h"
+#include "internal_metrics.h"
+
+// Collects histograms of the time spent by the inspector in each stage of
+// the processing of an event, by event type (see sinsp::set_latency_profiling).
+// One event out of the sampling ratio is timed, so that the cost of reading
+// the clock stays negligible; while profiling is disabled, the only cost is a
+// branch per event.
+//
+// The histograms are log2-bucketed: bucket 0 holds the 0ns samples, bucket i
+// the samples in [2^(i-1), 2^i) ns, and the last bucket everything from
+// 2^(NUM_BUCKETS-2) ns (about 1s) up.
+//
+// The stages are timed with the wall clock by default. With the CPU time of
+// the calling thread instead, the histograms account for what each stage
+// costs to the process, leaving out the time it was preempted or blocked.
+class latency_profiler
+{
+public:
+	enum stage
+	{
+		// the whole sinsp::next, from the read of the event on
+		STAGE_NEXT = 0,
+		// sinsp_parser::process_event, the filter included
+		STAGE_PARSE,
+		// the run of the inspector filter
+		STAGE_FILTER,
+		// the write of the event to the dumper
+		STAGE_DUMP,
+		// the read of the event from libscap
+		STAGE_SCAP,
+		// sinsp_evt_formatter, on the last event returned by next()
+		STAGE_FORMAT,
+		STAGE_MAX
+	};
+
+	enum clock_source
+	{
+		WALL_CLOCK = 0,
+		// CLOCK_THREAD_CPUTIME_ID, where available
+		THREAD_CPU_CLOCK,
+	};
+
+	static const uint32_t NUM_BUCKETS = 32;
+
+	struct histogram
+	{
+		uint64_t m_count;
+		uint64_t m_sum_ns;
+		uint64_t m_max_ns;
+		uint64_t m_buckets[NUM_BUCKETS];
+	};
+
+	latency_profiler();
+
+	//
+	// Time one event out of sampling_ratio. A ratio of 0 disables the
+	// profiling, and keeps the histograms collected so far.
+	//
+	void set_sampling_ratio(uint32_t sampling_ratio);
+
+	inline uint32_t get_sampling_ratio() const
+	{
+		return m_sampling_ratio;
+	}
+
+	//
+	// Select the clock the stages are timed with. Changing it zeroes
+	// the histograms, whose samples would not be comparable. Returns
+	// false if the clock is not available on this platform.
+	//
+	bool set_clock(clock_source clock);
+
+	inline clock_source get_clock() const
+	{
+		return m_clock;
+	}
+
+	//
+	// Zero all the histograms
+	//
+	void clear();
+
+	//
+	// Called at the beginning of every event, returns whether the
+	// event has to be timed
+	//
+	inline bool begin_event()
+	{
+		if(m_sampling_ratio == 0)
+		{
+			m_sampling = false;
+			return false;
+		}
+
+		if(++m_num_events >= m_sampling_ratio)
+		{
+			m_num_events = 0;
+			m_sampling = true;
+		}
+		else
+		{
+			m_sampling = false;
+		}
+		return m_sampling;
+	}
+
+	inline bool is_sampling() const
+	{
+		return m_sampling;
+	}
+
+	//
+	// start() returns the time a stage starts at, and stop() adds the
+	// time elapsed since then to the histograms, if the current event
+	// is being timed
+	//
+	inline uint64_t start() const
+	{
+		return m_sampling ? now_ns() : 0;
+	}
+
+	inline void stop(stage s, uint16_t evt_type, uint64_t start_ns)
+	{
+		if(m_sampling)
+		{
+			record(s, evt_type, now_ns() - start_ns);
+		}
+	}
+
+	void record(stage s, uint16_t evt_type, uint64_t ns);
+
+	//
+	// Return the histogram of a stage for an event type, or of all the
+	// event types if evt_type is PPM_EVENT_MAX. NULL if nothing has
+	// been recorded.
+	//
+	const histogram* get_histogram(stage s, uint16_t evt_type) const;
+
+	//
+	// Return an upper bound of the given percentile (0 to 100) of the
+	// samples of a histogram, which is the upper bound of its bucket
+	// capped to the largest sample
+	//
+	static uint64_t get_percentile(const histogram& h, double percentile);
+
+	static inline uint32_t get_bucket(uint64_t ns)
+	{
+		uint32_t b = 0;
+		while(ns != 0 && b < NUM_BUCKETS - 1)
+		{
+			ns >>= 1;
+			b++;
+		}
+		return b;
+	}
+
+	static const char* get_stage_name(stage s);
+
+	//
+	// Return the histograms as a buffer of scap_stats_v2 metrics, flagged
+	// as PPM_SCAP_STATS_LATENCY. For each stage there are
+	// `latency.<stage>.count`, `.sum_ns`, `.max_ns`, `.p50_ns`, `.p90_ns`,
+	// `.p99_ns` and the non-empty buckets as `.le_<bound>_ns`, then the
+	// same counters, buckets aside, for each event type with samples as
+	// `latency.<stage>.<event name>_<event code>.*`. With the thread CPU
+	// clock, the metrics are named `cpu.<stage>.*` instead.
+	// The buffer is owned by the profiler and valid until the next call.
+	//
+	const scap_stats_v2* get_stats(uint32_t* nstats);
+
+#ifdef GATHER_INTERNAL_STATS
+	//
+	// Register the metrics of get_stats() as counters of the given
+	// registry, replacing the ones registered by a previous call
+	//
+	void export_stats(internal_metrics::registry& registry);
+#endif
+
+private:
+	inline uint64_t now_ns() const
+	{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+		if(m_clock == THREAD_CPU_CLOCK)
+		{
+			struct timespec ts;
+			clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+			return ((uint64_t)ts.tv_sec) * 1000000000 + ts.tv_nsec;
+		}
+#endif
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void add_stats(const std::string& prefix, const histogram& h, bool buckets);
+
+	uint32_t m_sampling_ratio;
+	uint32_t m_num_events;
+	bool m_sampling;
+	clock_source m_clock;
+
+	//
+	// One histogram per stage and event type, plus the totals of the
+	// stage at PPM_EVENT_MAX. Allocated the first time the profiling is
+	// enabled.
+	//
+	std::vector<histogram> m_histograms;
+	std::vector<scap_stats_v2> m_stats;
+};
@@ -0,0 +1,183 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "lazy_fd_loader.h"
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "thread_placement.h"
+
+// Reads the fds of a process in a vector, so that the big threadinfo
+// returned by scap is only kept for the duration of the read
+static bool read_fds(scap_t* h, int64_t pid, std::vector<scap_fdinfo>& fds)
+{
+	scap_threadinfo* scap_tinfo = scap_proc_get_fds(h, pid);
+	if(scap_tinfo == NULL)
+	{
+		return false;
+	}
+
+	scap_fdinfo* fdi;
+	scap_fdinfo* tfdi;
+	HASH_ITER(hh, scap_tinfo->fdlist, fdi, tfdi)
+	{
+		fds.push_back(*fdi);
+	}
+	scap_proc_free(h, scap_tinfo);
+	return true;
+}
+
+sinsp_lazy_fd_loader::sinsp_lazy_fd_loader(sinsp* inspector):
+	m_inspector(inspector),
+	m_stop(false)
+{
+}
+
+sinsp_lazy_fd_loader::~sinsp_lazy_fd_loader()
+{
+	stop();
+}
+
+void sinsp_lazy_fd_loader::request(int64_t pid)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queue.push_back(pid);
+	m_cond.notify_one();
+}
+
+void sinsp_lazy_fd_loader::start()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(m_thread.joinable() || m_queue.empty())
+	{
+		return;
+	}
+
+	m_stop = false;
+	m_thread = std::thread(&sinsp_lazy_fd_loader::run, this);
+}
+
+void sinsp_lazy_fd_loader::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		m_cond.notify_all();
+	}
+
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.m_n_discarded += m_prefetched.size();
+	m_queue.clear();
+	m_prefetched.clear();
+}
+
+void sinsp_lazy_fd_loader::run()
+{
+	libsinsp::thread_placement::apply(libsinsp::thread_placement::thread_class::AUXILIARY);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(!m_stop && !m_queue.empty())
+	{
+		if(m_prefetched.size() >= MAX_PREFETCHED)
+		{
+			// The rest is read on demand
+			m_queue.clear();
+			break;
+		}
+
+		int64_t pid = m_queue.front();
+		m_queue.pop_front();
+
+		lock.unlock();
+		std::vector<scap_fdinfo> fds;
+		bool found = read_fds(m_inspector->m_h, pid, fds);
+		lock.lock();
+
+		if(found)
+		{
+			m_prefetched[pid] = std::move(fds);
+			m_stats.m_n_prefetched++;
+		}
+	}
+}
+
+void sinsp_lazy_fd_loader::load(sinsp_fdtable& table)
+{
+	int64_t pid = table.m_tid;
+	std::vector<scap_fdinfo> fds;
+	bool found = false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.m_n_loads++;
+
+		auto it = m_prefetched.find(pid);
+		if(it != m_prefetched.end())
+		{
+			fds = std::move(it->second);
+			m_prefetched.erase(it);
+			m_stats.m_n_prefetched_loads++;
+			found = true;
+		}
+	}
+
+	if(!found && m_inspector->m_h != NULL)
+	{
+		found = read_fds(m_inspector->m_h, pid, fds);
+	}
+
+	if(!found)
+	{
+		return;
+	}
+
+	auto tinfo = m_inspector->find_thread(pid, true);
+	if(tinfo == nullptr || &tinfo->m_fdtable != &table)
+	{
+		return;
+	}
+
+	sinsp_fdinfo_t sinsp_fdinfo;
+	for(auto& fdi : fds)
+	{
+		tinfo->add_fd_from_scap(&fdi, &sinsp_fdinfo);
+	}
+
+	//
+	// The initial scan skipped the socket direction fix for this process
+	//
+	tinfo->fix_sockets_coming_from_proc();
+}
+
+void sinsp_lazy_fd_loader::discard(int64_t pid)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(m_prefetched.erase(pid) != 0)
+	{
+		m_stats.m_n_discarded++;
+	}
+}
+
+sinsp_lazy_fd_loader::stats sinsp_lazy_fd_loader::get_stats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
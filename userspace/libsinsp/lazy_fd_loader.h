@@ -0,0 +1,106 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "scap.h"
+#include "sinsp_public.h"
+
+class sinsp;
+class sinsp_fdtable;
+
+/*!
+  \brief Populates the fd tables of the processes found by the initial /proc
+  scan when it runs with lazy fds (see `sinsp::set_lazy_fd_scan`).
+
+  The fd table of such processes is marked as pending and gets loaded the first
+  time it's accessed. In the meanwhile, a background thread reads the fds of the
+  pending processes from /proc, so that most of the loads only have to add the
+  prefetched fds to the table. The background thread never touches the inspector
+  state: the fds are always added to the tables by the thread that accesses them.
+*/
+class SINSP_PUBLIC sinsp_lazy_fd_loader
+{
+public:
+	struct stats
+	{
+		// Number of fd tables loaded
+		uint64_t m_n_loads = 0;
+		// Loads that used the fds read by the background thread
+		uint64_t m_n_prefetched_loads = 0;
+		// Fd lists read by the background thread
+		uint64_t m_n_prefetched = 0;
+		// Fd lists read by the background thread, but never used
+		uint64_t m_n_discarded = 0;
+	};
+
+	sinsp_lazy_fd_loader(sinsp* inspector);
+	~sinsp_lazy_fd_loader();
+
+	/*!
+	  \brief Queues the fds of a process for the background thread.
+	*/
+	void request(int64_t pid);
+
+	/*!
+	  \brief Starts reading the queued fds in the background.
+	*/
+	void start();
+
+	/*!
+	  \brief Stops the background thread and forgets the pending processes.
+	  Must be called before closing the scap handle.
+	*/
+	void stop();
+
+	/*!
+	  \brief Adds to the table the fds of the process that owns it.
+	*/
+	void load(sinsp_fdtable& table);
+
+	/*!
+	  \brief Drops the prefetched fds of a process that doesn't need them anymore.
+	*/
+	void discard(int64_t pid);
+
+	stats get_stats();
+
+private:
+	// Max number of prefetched fd lists waiting to be loaded, the fds of
+	// the processes past this are read on demand
+	static const size_t MAX_PREFETCHED = 4096;
+
+	void run();
+
+	sinsp* m_inspector;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	bool m_stop;
+	std::deque<int64_t> m_queue;
+	std::unordered_map<int64_t, std::vector<scap_fdinfo>> m_prefetched;
+	stats m_stats;
+};
@@ -26,6 +26,12 @@ limitations under the License.
 #endif
 #include <stdarg.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 namespace
 {
 
@@ -33,8 +39,173 @@ thread_local char s_tbuf[16384];
 
 const size_t ENCODE_LEN = sizeof(uint64_t);
 
+// Fits the encoded severity and the timestamp
+const size_t PREFIX_LEN = ENCODE_LEN + sizeof("31-12 23:59:59.999999 ");
+
 } // end namespace
 
+/**
+ * Bounded multi-producer, single-consumer ring of log messages, drained
+ * by a background thread. Each slot carries a sequence number telling
+ * whether it is free for the producer at a given position or ready for
+ * the consumer, so producers only need a CAS on the head position.
+ * The slots keep their string buffers, so once the ring is warm
+ * enqueueing a message doesn't allocate.
+ */
+class sinsp_logger::async_sink
+{
+public:
+	async_sink(sinsp_logger* logger, size_t capacity);
+	~async_sink();
+
+	bool push(const char* prefix, const char* msg, size_t len, severity sev);
+
+private:
+	struct slot
+	{
+		std::atomic<size_t> m_seq;
+		std::string m_msg;
+		severity m_sev;
+	};
+
+	size_t drain();
+	void run();
+
+	sinsp_logger* m_logger;
+	std::unique_ptr<slot[]> m_slots;
+	size_t m_mask;
+	std::atomic<size_t> m_head;
+	std::atomic<size_t> m_tail;
+	std::atomic<bool> m_stop;
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	std::thread m_thread;
+};
+
+sinsp_logger::async_sink::async_sink(sinsp_logger* logger, size_t capacity):
+	m_logger(logger),
+	m_head(0),
+	m_tail(0),
+	m_stop(false)
+{
+	size_t size = 2;
+	while(size < capacity)
+	{
+		size <<= 1;
+	}
+
+	m_slots.reset(new slot[size]);
+	m_mask = size - 1;
+	for(size_t j = 0; j < size; j++)
+	{
+		m_slots[j].m_seq.store(j, std::memory_order_relaxed);
+	}
+
+	m_thread = std::thread(&async_sink::run, this);
+}
+
+sinsp_logger::async_sink::~async_sink()
+{
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		m_stop = true;
+	}
+	m_cv.notify_one();
+	m_thread.join();
+}
+
+bool sinsp_logger::async_sink::push(const char* prefix, const char* msg, size_t len, severity sev)
+{
+	slot* s;
+	size_t pos = m_head.load(std::memory_order_relaxed);
+
+	while(true)
+	{
+		s = &m_slots[pos & m_mask];
+		size_t seq = s->m_seq.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+		if(diff == 0)
+		{
+			if(m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if(diff < 0)
+		{
+			// the consumer didn't free this slot yet, the ring is full
+			m_logger->m_async_dropped++;
+			return false;
+		}
+		else
+		{
+			pos = m_head.load(std::memory_order_relaxed);
+		}
+	}
+
+	s->m_msg.assign(prefix);
+	s->m_msg.append(msg, len);
+	s->m_sev = sev;
+	s->m_seq.store(pos + 1, std::memory_order_release);
+
+	//
+	// The consumer polls, wake it up only if the ring is filling up
+	//
+	if(pos - m_tail.load(std::memory_order_relaxed) == (m_mask + 1) / 2)
+	{
+		m_cv.notify_one();
+	}
+
+	return true;
+}
+
+size_t sinsp_logger::async_sink::drain()
+{
+	size_t n = 0;
+	size_t pos = m_tail.load(std::memory_order_relaxed);
+
+	while(true)
+	{
+		slot& s = m_slots[pos & m_mask];
+		if(s.m_seq.load(std::memory_order_acquire) != pos + 1)
+		{
+			break;
+		}
+
+		m_logger->write_to_sink("", s.m_msg.data(), s.m_msg.size(), s.m_sev, false);
+		s.m_seq.store(pos + m_mask + 1, std::memory_order_release);
+		m_tail.store(++pos, std::memory_order_relaxed);
+		n++;
+	}
+
+	if(n > 0)
+	{
+		m_logger->flush_sink();
+	}
+
+	return n;
+}
+
+void sinsp_logger::async_sink::run()
+{
+	while(true)
+	{
+		bool stop = m_stop;
+		if(drain() > 0)
+		{
+			continue;
+		}
+
+		if(stop)
+		{
+			break;
+		}
+
+		std::unique_lock<std::mutex> lk(m_mtx);
+		m_cv.wait_for(lk, std::chrono::milliseconds(10), [this] { return m_stop.load(); });
+	}
+}
+
 const uint32_t sinsp_logger::OT_NONE       = 0;
 const uint32_t sinsp_logger::OT_STDOUT     = 1;
 const uint32_t sinsp_logger::OT_STDERR     = (OT_STDOUT   << 1);
@@ -43,15 +214,21 @@ const uint32_t sinsp_logger::OT_CALLBACK   = (OT_FILE     << 1);
 const uint32_t sinsp_logger::OT_NOTS       = (OT_CALLBACK << 1);
 const uint32_t sinsp_logger::OT_ENCODE_SEV = (OT_NOTS     << 1);
 
+const size_t sinsp_logger::DEFAULT_ASYNC_CAPACITY = 4096;
+
 sinsp_logger::sinsp_logger():
 	m_file(nullptr),
 	m_callback(nullptr),
 	m_flags(OT_NONE),
-	m_sev(SEV_INFO)
+	m_sev(SEV_INFO),
+	m_async(nullptr),
+	m_async_dropped(0)
 { }
 
 sinsp_logger::~sinsp_logger()
 {
+	disable_async();
+
 	if(m_file)
 	{
 		ASSERT(m_flags & sinsp_logger::OT_FILE);
@@ -136,23 +313,60 @@ sinsp_logger::severity sinsp_logger::get_severity() const
 	return m_sev;
 }
 
-void sinsp_logger::log(std::string msg, const severity sev)
+void sinsp_logger::enable_async(const size_t capacity)
 {
-	sinsp_logger_callback cb = nullptr;
+	if(m_async == nullptr)
+	{
+		m_async = new async_sink(this, capacity);
+	}
+}
 
+void sinsp_logger::disable_async()
+{
+	delete m_async.exchange(nullptr);
+}
+
+uint64_t sinsp_logger::get_async_dropped() const
+{
+	return m_async_dropped;
+}
+
+void sinsp_logger::log(const std::string& msg, const severity sev)
+{
 	if(sev > m_sev)
 	{
 		return;
 	}
 
+	emit(msg.data(), msg.size(), sev);
+}
+
+void sinsp_logger::log(const char* const msg, const severity sev)
+{
+	if(sev > m_sev)
+	{
+		return;
+	}
+
+	emit(msg, strlen(msg), sev);
+}
+
+void sinsp_logger::emit(const char* const msg, const size_t len, const severity sev)
+{
+	char prefix[PREFIX_LEN] = "";
+	size_t prefix_len = 0;
+
+	if(m_flags & sinsp_logger::OT_ENCODE_SEV)
+	{
+		prefix_len = strlcpy(prefix, encode_severity(sev), ENCODE_LEN + 1);
+	}
+
 	if((m_flags & sinsp_logger::OT_NOTS) == 0)
 	{
 		struct timeval ts = {};
 
 		if(gettimeofday(&ts, nullptr) == 0)
 		{
-			const std::string::size_type ts_length = sizeof("31-12 23:59:59.999999 ");
-			char ts_buf[ts_length];
 			struct tm* ti;
 			struct tm time_info = {};
 
@@ -163,8 +377,8 @@ void sinsp_logger::log(std::string msg, const severity sev)
 			ti = &time_info;
 #endif
 
-			snprintf(ts_buf,
-				 sizeof(ts_buf),
+			snprintf(prefix + prefix_len,
+				 sizeof(prefix) - prefix_len,
 				 "%.2d-%.2d %.2d:%.2d:%.2d.%.6d ",
 				 ti->tm_mon + 1,
 				 ti->tm_mday,
@@ -173,18 +387,29 @@ void sinsp_logger::log(std::string msg, const severity sev)
 				 ti->tm_sec,
 				 (int)ts.tv_usec);
 
-			ts_buf[sizeof(ts_buf) - 1] = '\0';
-			msg.insert(0, ts_buf);
+			prefix[sizeof(prefix) - 1] = '\0';
 		}
 	}
 
-	if(m_flags & sinsp_logger::OT_ENCODE_SEV)
+	async_sink* async = m_async;
+	if(async != nullptr)
 	{
-		char sev_buf[ENCODE_LEN + 1];
-		strlcpy(sev_buf, encode_severity(sev), sizeof(sev_buf));
-		msg.insert(0, sev_buf);
+		async->push(prefix, msg, len, sev);
+		return;
 	}
 
+	write_to_sink(prefix, msg, len, sev, true);
+}
+
+void sinsp_logger::write_to_sink(const char* const prefix,
+				 const char* const msg,
+				 const size_t len,
+				 const severity sev,
+				 const bool flush)
+{
+	sinsp_logger_callback cb = nullptr;
+	FILE* out = nullptr;
+
 	if(is_callback())
 	{
 		cb = m_callback;
@@ -192,21 +417,51 @@ void sinsp_logger::log(std::string msg, const severity sev)
 
 	if(cb != nullptr)
 	{
-		cb(std::move(msg), sev);
+		std::string str(prefix);
+		str.append(msg, len);
+		cb(std::move(str), sev);
+		return;
+	}
+	else if((m_flags & sinsp_logger::OT_FILE) && m_file)
+	{
+		out = m_file;
+	}
+	else if(m_flags & sinsp_logger::OT_STDOUT)
+	{
+		out = stdout;
+	}
+	else if(m_flags & sinsp_logger::OT_STDERR)
+	{
+		out = stderr;
+	}
+	else
+	{
+		return;
+	}
+
+	fprintf(out, "%s%.*s\n", prefix, (int)len, msg);
+	if(flush)
+	{
+		fflush(out);
+	}
+}
+
+void sinsp_logger::flush_sink()
+{
+	if(is_callback())
+	{
+		return;
 	}
 	else if((m_flags & sinsp_logger::OT_FILE) && m_file)
 	{
-		fprintf(m_file, "%s\n", msg.c_str());
 		fflush(m_file);
 	}
 	else if(m_flags & sinsp_logger::OT_STDOUT)
 	{
-		fprintf(stdout, "%s\n", msg.c_str());
 		fflush(stdout);
 	}
 	else if(m_flags & sinsp_logger::OT_STDERR)
 	{
-		fprintf(stderr, "%s\n", msg.c_str());
 		fflush(stderr);
 	}
 }
@@ -221,21 +476,36 @@ void sinsp_logger::format(const severity sev, const char* const fmt, ...)
 	va_list ap;
 
 	va_start(ap, fmt);
-	vsnprintf(s_tbuf, sizeof s_tbuf, fmt, ap);
+	int len = vsnprintf(s_tbuf, sizeof s_tbuf, fmt, ap);
 	va_end(ap);
 
-	log(s_tbuf, sev);
+	if(len < 0)
+	{
+		return;
+	}
+
+	emit(s_tbuf, std::min((size_t)len, sizeof(s_tbuf) - 1), sev);
 }
 
 void sinsp_logger::format(const char* const fmt, ...)
 {
+	if(SEV_INFO > m_sev)
+	{
+		return;
+	}
+
 	va_list ap;
 
 	va_start(ap, fmt);
-	vsnprintf(s_tbuf, sizeof s_tbuf, fmt, ap);
+	int len = vsnprintf(s_tbuf, sizeof s_tbuf, fmt, ap);
 	va_end(ap);
 
-	log(s_tbuf, SEV_INFO);
+	if(len < 0)
+	{
+		return;
+	}
+
+	emit(s_tbuf, std::min((size_t)len, sizeof(s_tbuf) - 1), SEV_INFO);
 }
 
 const char* sinsp_logger::format_and_return(const severity sev, const char* const fmt, ...)
@@ -20,6 +20,8 @@ limitations under the License.
 #include "sinsp_public.h"
 
 #include <atomic>
+#include <cstdint>
+#include <cstdio>
 #include <string>
 
 /**
@@ -57,6 +59,8 @@ public:
 	const static uint32_t OT_NOTS;
 	const static uint32_t OT_ENCODE_SEV;
 
+	const static size_t DEFAULT_ASYNC_CAPACITY;
+
 	/**
 	 * Initialize this sinsp_logger with no output sinks enabled.
 	 */
@@ -126,11 +130,47 @@ public:
 	 */
 	bool has_output() const { return m_flags != OT_NONE; }
 
+	/**
+	 * Hand log messages off to a background thread, which writes them to
+	 * the configured log sink.  Logging threads only copy the message in
+	 * a bounded lock-free ring of the given capacity (rounded up to a
+	 * power of two); when the ring is full the message is dropped and
+	 * counted in get_async_dropped().  Registered callbacks are invoked
+	 * from the background thread.
+	 *
+	 * Note: this must not be called while other threads are logging.
+	 */
+	void enable_async(size_t capacity = DEFAULT_ASYNC_CAPACITY);
+
+	/**
+	 * Write the messages still in the ring, stop the background thread
+	 * and go back to writing to the log sink synchronously.
+	 *
+	 * Note: this must not be called while other threads are logging.
+	 */
+	void disable_async();
+
+	/** Returns true if log messages are written by a background thread. */
+	bool is_async() const { return m_async != nullptr; }
+
+	/**
+	 * Returns the number of messages dropped so far because the ring of
+	 * the background thread was full.
+	 */
+	uint64_t get_async_dropped() const;
+
+	/**
+	 * Emit the given msg to the configured log sink if the given sev
+	 * is greater than or equal to the minimum configured logging severity.
+	 */
+	void log(const std::string& msg, severity sev = SEV_INFO);
+
 	/**
 	 * Emit the given msg to the configured log sink if the given sev
 	 * is greater than or equal to the minimum configured logging severity.
+	 * No string is built when the severity is disabled.
 	 */
-	void log(std::string msg, severity sev = SEV_INFO);
+	void log(const char* msg, severity sev = SEV_INFO);
 
 	/**
 	 * Write the given printf-style log message of the given severity
@@ -160,9 +200,22 @@ public:
 	static size_t decode_severity(const std::string &s, severity& sev);
 
 private:
+	class async_sink;
+
 	/** Returns true if the callback log sync is enabled, false otherwise. */
 	bool is_callback() const;
 
+	/**
+	 * Prefix msg with the timestamp and severity, as configured, and
+	 * write it to the log sink or to the ring of the background thread.
+	 */
+	void emit(const char* msg, size_t len, severity sev);
+
+	/** Write prefix and msg to the log sink. */
+	void write_to_sink(const char* prefix, const char* msg, size_t len, severity sev, bool flush);
+
+	/** Flush the file, standard output or standard error log sink. */
+	void flush_sink();
 
 	/** Returns a string containing encoded severity, for OT_ENCODE_SEV. */
 	static const char* encode_severity(severity sev);
@@ -170,6 +223,8 @@ private:
 	std::atomic<callback_t> m_callback;
 	std::atomic<uint32_t> m_flags;
 	std::atomic<severity> m_sev;
+	std::atomic<async_sink*> m_async;
+	std::atomic<uint64_t> m_async_dropped;
 };
 
 using sinsp_logger_callback = sinsp_logger::callback_t;
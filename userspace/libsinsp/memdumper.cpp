@@ -0,0 +1,175 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "dumper.h"
+#include "memdumper.h"
+
+//
+// Upper bound of the block that scap_dump() writes around an event:
+// header, flags, cpuid, padding and trailer
+//
+#define MEMDUMPER_BLOCK_OVERHEAD 32
+
+sinsp_memory_dumper::sinsp_memory_dumper(sinsp* inspector):
+	m_inspector(inspector),
+	m_segment_size(0),
+	m_duration_ns(0),
+	m_dropped(0),
+	m_active(0)
+{
+}
+
+sinsp_memory_dumper::~sinsp_memory_dumper()
+{
+	close();
+}
+
+void sinsp_memory_dumper::init(uint64_t bufsize, uint64_t duration_ns)
+{
+	close();
+
+	m_segment_size = bufsize / 2;
+	m_duration_ns = duration_ns;
+	m_dropped = 0;
+	m_active = 0;
+
+	for(auto& s : m_segments)
+	{
+		s.m_buf.reset(new uint8_t[m_segment_size]);
+	}
+
+	reset(m_segments[m_active]);
+}
+
+void sinsp_memory_dumper::close()
+{
+	for(auto& s : m_segments)
+	{
+		s.m_dumper.reset();
+		s.m_buf.reset();
+		s.m_nevts = 0;
+	}
+}
+
+void sinsp_memory_dumper::reset(segment& s)
+{
+	//
+	// The dumper only writes into the buffer, so dropping it is enough
+	// to discard the events of the segment
+	//
+	s.m_dumper.reset();
+	s.m_first_ts = 0;
+	s.m_nevts = 0;
+
+	std::unique_ptr<sinsp_dumper> dumper(new sinsp_dumper(s.m_buf.get(), m_segment_size));
+	dumper->open(m_inspector, "", SCAP_COMPRESSION_NONE, true);
+	s.m_dumper = std::move(dumper);
+}
+
+uint64_t sinsp_memory_dumper::used_bytes(const segment& s) const
+{
+	if(s.m_dumper == nullptr)
+	{
+		return 0;
+	}
+
+	return s.m_dumper->get_memory_dump_cur_buf() - s.m_buf.get();
+}
+
+void sinsp_memory_dumper::process_event(sinsp_evt* evt)
+{
+	segment* s = &m_segments[m_active];
+	if(s->m_dumper == nullptr)
+	{
+		return;
+	}
+
+	scap_evt* pdevt = (evt->m_poriginal_evt)? evt->m_poriginal_evt : evt->m_pevt;
+	uint64_t needed = pdevt->len + MEMDUMPER_BLOCK_OVERHEAD;
+	uint64_t ts = evt->get_ts();
+
+	//
+	// Checking the room up front keeps partially written events out of
+	// the buffer, since the memory dumper fails in the middle of a block
+	//
+	if(used_bytes(*s) + needed >= m_segment_size ||
+	   (m_duration_ns != 0 && s->m_nevts != 0 && ts - s->m_first_ts > m_duration_ns))
+	{
+		m_active = 1 - m_active;
+		s = &m_segments[m_active];
+		reset(*s);
+
+		if(used_bytes(*s) + needed >= m_segment_size)
+		{
+			m_dropped++;
+			return;
+		}
+	}
+
+	if(s->m_nevts == 0)
+	{
+		s->m_first_ts = ts;
+	}
+
+	s->m_dumper->dump(evt);
+	s->m_nevts++;
+}
+
+uint64_t sinsp_memory_dumper::to_file(const std::string& filename)
+{
+	if(m_segments[m_active].m_dumper == nullptr)
+	{
+		throw sinsp_exception("memory dumper not initialized");
+	}
+
+	FILE* f = fopen(filename.c_str(), "wb");
+	if(f == NULL)
+	{
+		throw sinsp_exception("can't open " + filename + ": " + strerror(errno));
+	}
+
+	uint64_t written = 0;
+	const segment* order[] = {&m_segments[1 - m_active], &m_segments[m_active]};
+	for(const segment* s : order)
+	{
+		uint64_t len = used_bytes(*s);
+		if(len == 0 || (s != order[1] && s->m_nevts == 0))
+		{
+			continue;
+		}
+
+		if(fwrite(s->m_buf.get(), 1, len, f) != len)
+		{
+			fclose(f);
+			throw sinsp_exception("error writing " + filename + ": " + strerror(errno));
+		}
+		written += len;
+	}
+
+	if(fclose(f) != 0)
+	{
+		throw sinsp_exception("error writing " + filename + ": " + strerror(errno));
+	}
+
+	return written;
+}
@@ -0,0 +1,110 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class sinsp;
+class sinsp_evt;
+class sinsp_dumper;
+
+/** @addtogroup dump
+ *  @{
+ */
+
+/*!
+  \brief Keeps the most recent events in memory, so that they can be saved
+  to a file after something interesting happened ("flight recorder").
+
+  The memory is split in two halves, each one holding a capture that starts
+  with a snapshot of the inspector state followed by the events. When the
+  half being written is full, or spans more than the configured duration,
+  the older half is discarded and reused, taking a new state snapshot.
+  to_file() writes both halves, which the readers consume as two appended
+  captures, so that between half and all of the memory is saved.
+*/
+class SINSP_PUBLIC sinsp_memory_dumper
+{
+public:
+	sinsp_memory_dumper(sinsp* inspector);
+	~sinsp_memory_dumper();
+
+	/*!
+	  \brief Allocates the memory and takes the first state snapshot. The
+	  inspector must be open.
+
+	  \param bufsize Total size of the memory, in bytes.
+
+	  \param duration_ns If not 0, each half is switched after holding
+	   events for this long, so that at least this much time is kept when
+	   the memory allows it.
+	*/
+	void init(uint64_t bufsize, uint64_t duration_ns = 0);
+
+	/*!
+	  \brief Frees the memory, dropping the events.
+	*/
+	void close();
+
+	/*!
+	  \brief Adds an event to the memory, to be called for each event
+	  returned by sinsp::next().
+	*/
+	void process_event(sinsp_evt* evt);
+
+	/*!
+	  \brief Saves the events currently in memory to a file, which can be
+	  read like any other capture. The events stay in memory.
+
+	  \return The number of bytes written.
+	*/
+	uint64_t to_file(const std::string& filename);
+
+	/*!
+	  \brief Returns the number of events that didn't fit in half of the
+	  memory, and were dropped.
+	*/
+	inline uint64_t dropped_events() const
+	{
+		return m_dropped;
+	}
+
+private:
+	struct segment
+	{
+		std::unique_ptr<uint8_t[]> m_buf;
+		std::unique_ptr<sinsp_dumper> m_dumper;
+		uint64_t m_first_ts;
+		uint64_t m_nevts;
+	};
+
+	void reset(segment& s);
+	uint64_t used_bytes(const segment& s) const;
+
+	sinsp* m_inspector;
+	uint64_t m_segment_size;
+	uint64_t m_duration_ns;
+	uint64_t m_dropped;
+	segment m_segments[2];
+	// Index of the segment being written, the other one is older
+	uint32_t m_active;
+};
+
+/*@}*/
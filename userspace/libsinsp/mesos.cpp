@@ -301,10 +301,11 @@ void mesos::rebuild_mesos_state(bool full)
 	{
 		if(full)
 		{
-			clear_mesos();
+			// the state is updated in place, there is nothing to do when
+			// the master reports it unchanged
 			if(m_state_http)
 			{
-				m_state_http->get_all_data(&mesos::parse_state);
+				m_state_http->get_all_data(&mesos::parse_state, true);
 			}
 			else
 			{
@@ -328,13 +329,13 @@ void mesos::rebuild_marathon_state(bool full)
 	{
 		if(full)
 		{
-			clear_marathon();
+			erase_stale_groups();
 
 			for(auto& group_http : m_marathon_groups_http)
 			{
 				if(group_http.second)
 				{
-					group_http.second->get_all_data(&mesos::parse_groups);
+					group_http.second->get_all_data(&mesos::replace_groups, true);
 				}
 				else
 				{
@@ -346,7 +347,12 @@ void mesos::rebuild_marathon_state(bool full)
 			{
 				if(app_http.second)
 				{
-					app_http.second->get_all_data(&mesos::parse_apps);
+					// apps belong to groups, they must be parsed again
+					// whenever the groups of their Marathon were replaced
+					marathon_http_map::const_iterator group_it = m_marathon_groups_http.find(app_http.first);
+					bool groups_modified = group_it == m_marathon_groups_http.end() ||
+										   !group_it->second || group_it->second->is_modified();
+					app_http.second->get_all_data(&mesos::parse_apps, !groups_modified);
 				}
 				else
 				{
@@ -575,6 +581,33 @@ void mesos::capture_slaves(const Json::Value& root, Json::Value& capture)
 		}
 	}
 }
+
+void mesos::replace_groups(json_ptr_t json, const std::string& framework_id)
+{
+	m_state.erase_groups(framework_id);
+	parse_groups(json, framework_id);
+}
+
+void mesos::erase_stale_groups()
+{
+	std::unordered_set<std::string> framework_ids;
+	for(const auto& group_http : m_marathon_groups_http)
+	{
+		if(group_http.second)
+		{
+			framework_ids.insert(group_http.second->get_framework_id());
+		}
+	}
+	marathon_groups& groups = m_state.get_groups();
+	for(marathon_groups::iterator it = groups.begin(); it != groups.end();)
+	{
+		if(!it->second || framework_ids.find(it->second->get_framework_id()) == framework_ids.end())
+		{
+			it = groups.erase(it);
+		}
+		else { ++it; }
+	}
+}
 #endif // HAS_CAPTURE
 
 bool mesos::collect_data()
@@ -716,6 +749,7 @@ void mesos::handle_frameworks(const Json::Value& root)
 		{
 			if(frameworks.size())
 			{
+				framework_list_t active_frameworks;
 				for(const auto& framework : frameworks)
 				{
 					const Json::Value& uid = framework["id"];
@@ -745,6 +779,7 @@ void mesos::handle_frameworks(const Json::Value& root)
 						}
 						else // active framework detected
 						{
+							active_frameworks.insert(uid.asString());
 							add_framework(framework);
 							if((m_inactive_frameworks.erase(uid.asString())) ||
 							   (m_activated_frameworks.find(uid.asString()) == m_activated_frameworks.end()))
@@ -765,6 +800,19 @@ void mesos::handle_frameworks(const Json::Value& root)
 						}
 					}
 				}
+				// the frameworks gone from the state since the last update
+				std::vector<std::string> removed_frameworks;
+				for(const auto& framework : m_state.get_frameworks())
+				{
+					if(active_frameworks.find(framework.get_uid()) == active_frameworks.end())
+					{
+						removed_frameworks.push_back(framework.get_uid());
+					}
+				}
+				for(const auto& uid : removed_frameworks)
+				{
+					m_state.remove_framework(uid);
+				}
 			}
 			else
 			{
@@ -785,6 +833,7 @@ void mesos::handle_frameworks(const Json::Value& root)
 void mesos::handle_slaves(const Json::Value& root)
 {
 	const Json::Value& slaves = root["slaves"];
+	m_state.get_slaves().clear();
 	if(!slaves.isNull())
 	{
 		for(const auto& slave : slaves)
@@ -811,6 +860,15 @@ void mesos::add_framework(const Json::Value& framework)
 	{
 		uid = fid.asString();
 	}
+	mesos_frameworks& frameworks = m_state.get_frameworks();
+	mesos_frameworks::iterator it = std::find_if(frameworks.begin(), frameworks.end(),
+		[&uid](const mesos_framework& f) { return f.get_uid() == uid; });
+	if(it != frameworks.end())
+	{
+		it->set_name(name);
+		add_tasks(*it, framework);
+		return;
+	}
 	if(!m_creation_logged)
 	{
 		std::ostringstream os;
@@ -868,6 +926,7 @@ void mesos::add_tasks_impl(mesos_framework& framework, const Json::Value& tasks)
 {
 	if(!tasks.isNull())
 	{
+		std::unordered_set<std::string> running_tasks;
 		for(const auto& task : tasks)
 		{
 			if(mesos_task::is_task_running(task))
@@ -876,6 +935,19 @@ void mesos::add_tasks_impl(mesos_framework& framework, const Json::Value& tasks)
 				std::ostringstream os;
 				if(t)
 				{
+					running_tasks.insert(t->get_uid());
+					mesos_task::ptr_t old_task = framework.get_task(t->get_uid());
+					if(old_task)
+					{
+						// unchanged tasks are kept, with their Marathon app
+						if(old_task->get_name() == t->get_name() &&
+						   old_task->get_slave_id() == t->get_slave_id() &&
+						   old_task->get_labels() == t->get_labels())
+						{
+							continue;
+						}
+						t->set_marathon_app_id(old_task->get_marathon_app_id());
+					}
 					os << "Adding Mesos task: [" << framework.get_name() << ':' << t->get_name() << ',' << t->get_uid() << ']';
 					g_logger.log(os.str(), sinsp_logger::SEV_DEBUG);
 					m_state.add_or_replace_task(framework, t);
@@ -895,6 +967,20 @@ void mesos::add_tasks_impl(mesos_framework& framework, const Json::Value& tasks)
 				}
 			}
 		}
+
+		std::vector<std::string> stopped_tasks;
+		for(const auto& task : framework.get_tasks())
+		{
+			if(running_tasks.find(task.first) == running_tasks.end())
+			{
+				stopped_tasks.push_back(task.first);
+			}
+		}
+		for(const auto& uid : stopped_tasks)
+		{
+			g_logger.log("Removing Mesos task: [" + framework.get_name() + ',' + uid + ']', sinsp_logger::SEV_DEBUG);
+			m_state.remove_task(framework, uid);
+		}
 	}
 	else
 	{
@@ -954,7 +1040,8 @@ void mesos::set_state_json(json_ptr_t json, const std::string&)
 
 void mesos::parse_state(Json::Value&& root)
 {
-	clear_mesos();
+	// the state is updated in place: frameworks and tasks that did not
+	// change are kept as they are, the ones gone are removed
 	handle_frameworks(root);
 	handle_slaves(root);
 #if defined(HAS_CAPTURE) && !defined(_WIN32)
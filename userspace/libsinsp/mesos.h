@@ -136,6 +136,8 @@ private:
 	typedef std::unordered_map<std::string, marathon_http::ptr_t> marathon_http_map;
 
 	void remove_framework_http(marathon_http_map& http_map, const std::string& framework_id);
+	void replace_groups(json_ptr_t json, const std::string& framework_id);
+	void erase_stale_groups();
 
 	mesos_http::ptr_t m_state_http;
 	marathon_http_map m_marathon_groups_http;
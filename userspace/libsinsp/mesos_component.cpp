@@ -175,7 +175,7 @@ bool mesos_framework::is_framework_active(const Json::Value& framework)
 
 void mesos_framework::add_or_replace_task(std::shared_ptr<mesos_task> task)
 {
-	m_tasks.insert({task->get_uid(), task});
+	m_tasks[task->get_uid()] = task;
 }
 
 void mesos_framework::remove_task(const std::string& uid)
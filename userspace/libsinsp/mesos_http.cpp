@@ -36,6 +36,8 @@ limitations under the License.
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <cstring>
+#include <algorithm>
+#include <mutex>
 
 mesos_http::mesos_http(mesos& m, const uri& url,
 					bool discover_mesos_lead_master,
@@ -53,7 +55,8 @@ mesos_http::mesos_http(mesos& m, const uri& url,
 	m_is_mesos_state(url.to_string().find(mesos::default_state_api) != std::string::npos),
 	m_discover_lead_master(discover_mesos_lead_master),
 	m_discover_marathon(discover_marathon),
-	m_token(token)
+	m_token(token),
+	m_share(get_share())
 {
 	if(!m_sync_curl || !m_select_curl)
 	{
@@ -75,7 +78,17 @@ mesos_http::mesos_http(mesos& m, const uri& url,
 		check_error(curl_easy_setopt(m_select_curl, CURLOPT_SSL_VERIFYPEER, 0));
 		check_error(curl_easy_setopt(m_select_curl, CURLOPT_SSL_VERIFYHOST, 0));
 	}
-	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_FORBID_REUSE, 1L));
+	if(m_share)
+	{
+		check_error(curl_easy_setopt(m_sync_curl, CURLOPT_SHARE, m_share.get()));
+	}
+#if LIBCURL_VERSION_MAJOR >= 7 && LIBCURL_VERSION_MINOR >= 25
+	// the connections of the synchronous requests are kept in the shared
+	// cache between the refreshes, probe them while they are idle
+	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_TCP_KEEPALIVE, 1L));
+	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_TCP_KEEPIDLE, 300L));
+	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_TCP_KEEPINTVL, 10L));
+#endif // LIBCURL_VERSION_MAJOR >= 7 && LIBCURL_VERSION_MINOR >= 25
 	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_CONNECTTIMEOUT_MS, m_timeout_ms));
 	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_TIMEOUT_MS, m_timeout_ms));
 
@@ -104,6 +117,69 @@ void mesos_http::cleanup(CURL** curl)
 	m_connected = false;
 }
 
+std::shared_ptr<CURLSH> mesos_http::get_share()
+{
+	// all the Mesos and Marathon clients share one connection and DNS cache,
+	// so that their periodic requests reuse the keep-alive connections to
+	// the same masters instead of opening new ones every time
+	static std::mutex share_mutex;
+	static std::mutex lock_mutexes[CURL_LOCK_DATA_LAST];
+	static std::weak_ptr<CURLSH> shared;
+
+	std::lock_guard<std::mutex> lock(share_mutex);
+	std::shared_ptr<CURLSH> share = shared.lock();
+	if(!share)
+	{
+		CURLSH* handle = curl_share_init();
+		if(!handle)
+		{
+			g_logger.log("mesos_http: CURL share initialization failed, connections will not be shared.",
+						 sinsp_logger::SEV_WARNING);
+			return nullptr;
+		}
+		curl_share_setopt(handle, CURLSHOPT_LOCKFUNC,
+			static_cast<curl_lock_function>([](CURL*, curl_lock_data data, curl_lock_access, void*)
+			{
+				lock_mutexes[data].lock();
+			}));
+		curl_share_setopt(handle, CURLSHOPT_UNLOCKFUNC,
+			static_cast<curl_unlock_function>([](CURL*, curl_lock_data data, void*)
+			{
+				lock_mutexes[data].unlock();
+			}));
+		curl_share_setopt(handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+#if LIBCURL_VERSION_NUM >= 0x073900
+		curl_share_setopt(handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif // LIBCURL_VERSION_NUM >= 0x073900
+		share.reset(handle, curl_share_cleanup);
+		shared = share;
+	}
+	return share;
+}
+
+size_t mesos_http::header_callback(char* buffer, size_t size, size_t nitems, void* userdata)
+{
+	mesos_http* http = static_cast<mesos_http*>(userdata);
+	std::string header(buffer, size * nitems);
+	std::string::size_type pos = header.find(':');
+	if(pos != std::string::npos)
+	{
+		std::string name = header.substr(0, pos);
+		std::string value = header.substr(pos + 1);
+		std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+		trim(value);
+		if(name == "etag")
+		{
+			http->m_response_etag = value;
+		}
+		else if(name == "last-modified")
+		{
+			http->m_response_last_modified = value;
+		}
+	}
+	return sinsp_curl::header_callback(buffer, size, nitems, http->m_redirect);
+}
+
 void mesos_http::set_token(const std::string& token)
 {
 	m_token = token;
@@ -419,8 +495,10 @@ CURLcode mesos_http::get_data(const std::string& url, std::ostream& os)
 	g_logger.log(std::string("mesos_http: Retrieving data from ") + uri(url).to_string(false), sinsp_logger::SEV_DEBUG);
 	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_URL, url.c_str()));
 
-	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_HEADERDATA, m_redirect));
-	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_HEADERFUNCTION, sinsp_curl::header_callback));
+	m_response_etag.clear();
+	m_response_last_modified.clear();
+	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_HEADERDATA, this));
+	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_HEADERFUNCTION, mesos_http::header_callback));
 
 	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_NOSIGNAL, 1)); //Prevent "longjmp causes uninitialized stack frame" bug
 	check_error(curl_easy_setopt(m_sync_curl, CURLOPT_ACCEPT_ENCODING, "deflate"));
@@ -431,10 +509,35 @@ CURLcode mesos_http::get_data(const std::string& url, std::ostream& os)
 	return curl_easy_perform(m_sync_curl);
 }
 
-bool mesos_http::get_all_data(callback_func_t parse)
+bool mesos_http::get_all_data(callback_func_t parse, bool conditional)
 {
+	m_modified = true;
+	bool validate = conditional && (!m_etag.empty() || !m_last_modified.empty());
+	if(validate)
+	{
+		// the headers must outlive the request, they are kept until the next one
+		m_conditional_headers.reset(new sinsp_curl_http_headers());
+		if(!m_token.empty())
+		{
+			m_conditional_headers->add(std::string("Authorization: token=") + m_token);
+		}
+		if(!m_etag.empty())
+		{
+			m_conditional_headers->add("If-None-Match: " + m_etag);
+		}
+		if(!m_last_modified.empty())
+		{
+			m_conditional_headers->add("If-Modified-Since: " + m_last_modified);
+		}
+		check_error(curl_easy_setopt(m_sync_curl, CURLOPT_HTTPHEADER, m_conditional_headers->ptr()));
+	}
+
 	std::ostringstream os;
 	CURLcode res = get_data(m_url.to_string(), os);
+	if(validate)
+	{
+		check_error(curl_easy_setopt(m_sync_curl, CURLOPT_HTTPHEADER, m_sync_curl_headers.ptr()));
+	}
 	if(res != CURLE_OK)
 	{
 		std::string errstr = std::string("Could not fetch url:") + curl_easy_strerror(res);
@@ -453,23 +556,37 @@ bool mesos_http::get_all_data(callback_func_t parse)
 			m_connected = false;
 			return false;
 		}
+		else if(http_code == 304)
+		{
+			g_logger.log("mesos_http: [" + m_url.to_string(false) + "] not modified", sinsp_logger::SEV_DEBUG);
+			m_modified = false;
+			m_connected = true;
+			return true;
+		}
 		else if(sinsp_curl::is_redirect(http_code))
 		{
 			g_logger.log("mesos_http: HTTP redirect (" + std::to_string(http_code) + ')', sinsp_logger::SEV_DEBUG);
 			if(sinsp_curl::handle_redirect(m_url, std::string(m_redirect), os))
 			{
 				os.str("");
-				return get_all_data(parse);
+				// the validators belong to the previous location
+				m_etag.clear();
+				m_last_modified.clear();
+				return get_all_data(parse, conditional);
 			}
 		}
 		Json::Reader reader;
 		json_ptr_t root(new Json::Value());
 		if(reader.parse(os.str(), *root))
 		{
+			m_etag = m_response_etag;
+			m_last_modified = m_response_last_modified;
 			(m_mesos.*parse)(root, m_framework_id);
 		}
 		else
 		{
+			m_etag.clear();
+			m_last_modified.clear();
 			std::string errstr;
 			errstr = reader.getFormattedErrorMessages();
 			g_logger.log("mesos_http: Mesos or Marathon Invalid JSON received from [" + m_url.to_string(false) + "]: " + errstr, sinsp_logger::SEV_WARNING);
@@ -50,7 +50,11 @@ public:
 
 	virtual ~mesos_http();
 
-	bool get_all_data(callback_func_t);
+	// with conditional set, the request carries the validators (ETag and
+	// Last-Modified) of the last response and an unchanged resource is not
+	// parsed again, see is_modified()
+	bool get_all_data(callback_func_t, bool conditional = false);
+	bool is_modified() const;
 
 	virtual int get_socket(long timeout_ms = -1);
 
@@ -102,6 +106,9 @@ private:
 
 	void send_request();
 
+	static size_t header_callback(char* buffer, size_t size, size_t nitems, void* userdata);
+	static std::shared_ptr<CURLSH> get_share();
+
 	CURL*                   m_sync_curl;
 	CURL*                   m_select_curl;
 	mesos&                  m_mesos;
@@ -126,6 +133,13 @@ private:
 	char                    m_redirect[CURL_MAX_HTTP_HEADER] = {0};
 	std::string                  m_token;
 	sinsp_curl_http_headers m_sync_curl_headers;
+	std::unique_ptr<sinsp_curl_http_headers> m_conditional_headers;
+	std::shared_ptr<CURLSH> m_share;
+	std::string             m_etag;
+	std::string             m_last_modified;
+	std::string             m_response_etag;
+	std::string             m_response_last_modified;
+	bool                    m_modified = true;
 
 	friend class mesos;
 
@@ -165,6 +179,11 @@ inline const std::string& mesos_http::get_request() const
 	return m_request;
 }
 
+inline bool mesos_http::is_modified() const
+{
+	return m_modified;
+}
+
 inline void mesos_http::set_parse_func(callback_func_t parse)
 {
 	m_callback_func = parse;
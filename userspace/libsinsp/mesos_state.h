@@ -195,6 +195,7 @@ private:
 	marathon_group::ptr_t add_group(const Json::Value& group, marathon_group::ptr_t to_group, const std::string& framework_id);
 	bool handle_groups(const Json::Value& groups, marathon_group::ptr_t p_groups, const std::string& framework_id);
 	marathon_app::ptr_t add_app(const Json::Value& app, const std::string& framework_id);
+	void update_task_framework_cache();
 
 	mesos_frameworks m_frameworks;
 	std::string      m_marathon_uri;
@@ -259,6 +260,7 @@ inline void mesos_state_t::push_framework(const mesos_framework& framework)
 		else { ++it; }
 	}
 	m_frameworks.push_back(framework);
+	update_task_framework_cache();
 }
 
 inline void mesos_state_t::emplace_framework(mesos_framework&& framework)
@@ -272,6 +274,7 @@ inline void mesos_state_t::emplace_framework(mesos_framework&& framework)
 		else { ++it; }
 	}
 	m_frameworks.emplace_back(std::move(framework));
+	update_task_framework_cache();
 }
 
 inline void mesos_state_t::remove_framework(const Json::Value& framework)
@@ -299,16 +302,26 @@ inline void mesos_state_t::remove_framework(const std::string& framework_uid)
 	{
 		if(it->get_uid() == framework_uid)
 		{
-			for(auto& task : it->get_tasks())
-			{
-				m_task_framework_cache.erase(task.first);
-			}
 			m_frameworks.erase(it);
+			update_task_framework_cache();
 			return;
 		}
 	}
 }
 
+// the cache points into the frameworks vector, it must follow its reallocations
+inline void mesos_state_t::update_task_framework_cache()
+{
+	m_task_framework_cache.clear();
+	for(auto& framework : m_frameworks)
+	{
+		for(const auto& task : framework.get_tasks())
+		{
+			m_task_framework_cache[task.first] = &framework;
+		}
+	}
+}
+
 //
 // tasks
 //
@@ -350,7 +363,7 @@ inline void mesos_state_t::remove_task(mesos_framework& framework, const std::st
 		}
 		else
 		{
-			g_logger.log("Task [" + uid + "] has no Marathon app ID.", sinsp_logger::SEV_WARNING);
+			g_logger.log("Task [" + uid + "] has no Marathon app ID.", sinsp_logger::SEV_DEBUG);
 		}
 	}
 	else
@@ -465,6 +478,7 @@ inline void mesos_state_t::clear_mesos()
 {
 	m_frameworks.clear();
 	m_slaves.clear();
+	m_task_framework_cache.clear();
 }
 
 inline void mesos_state_t::clear_marathon()
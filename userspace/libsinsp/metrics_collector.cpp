@@ -0,0 +1,319 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <unordered_set>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "metrics_collector.h"
+#include "strlcpy.h"
+
+// The metrics that only ever grow, exposed as Prometheus counters
+#define METRICS_COUNTER_FLAGS (PPM_SCAP_STATS_KERNEL_COUNTERS | \
+			       PPM_SCAP_STATS_LIBBPF_STATS | \
+			       PPM_SCAP_STATS_PARSE_COUNTERS | \
+			       PPM_SCAP_STATS_WORKLOAD_COUNTERS)
+
+sinsp_metrics_collector::sinsp_metrics_collector(sinsp* inspector, uint32_t flags, const std::string& prefix)
+	: m_inspector(inspector),
+	  m_prefix(prefix),
+	  m_snapshot_ts(0)
+{
+	uint32_t engine_flags = flags & (PPM_SCAP_STATS_KERNEL_COUNTERS | PPM_SCAP_STATS_LIBBPF_STATS);
+	if(engine_flags != 0)
+	{
+		add_source([this, engine_flags](uint32_t* nstats) -> const scap_stats_v2*
+		{
+			*nstats = 0;
+			if(m_inspector->m_h == NULL)
+			{
+				return NULL;
+			}
+			int32_t rc;
+			return m_inspector->get_capture_stats_v2(engine_flags, nstats, &rc);
+		});
+	}
+
+#if defined(__linux__) && !defined(MINIMAL_BUILD)
+	if(flags & PPM_SCAP_STATS_RESOURCE_UTILIZATION)
+	{
+		add_source([this](uint32_t* nstats) -> const scap_stats_v2*
+		{
+			*nstats = 0;
+			const scap_agent_info* agent_info = m_inspector->get_agent_info();
+			if(agent_info == NULL || !m_inspector->is_live())
+			{
+				return NULL;
+			}
+			int32_t rc;
+			return libsinsp::resource_utilization::get_resource_utilization(agent_info,
+				m_inspector->get_sinsp_stats_v2_buffer(), nstats, &rc);
+		});
+	}
+#endif
+
+	if(flags & PPM_SCAP_STATS_LATENCY)
+	{
+		add_source([this](uint32_t* nstats)
+		{
+			return m_inspector->get_latency_profiler().get_stats(nstats);
+		});
+		add_source([this](uint32_t* nstats)
+		{
+			return m_inspector->get_lag_monitor().get_stats(nstats);
+		});
+	}
+
+	if(flags & PPM_SCAP_STATS_PARSE_COUNTERS)
+	{
+		add_source([this](uint32_t* nstats) -> const scap_stats_v2*
+		{
+			*nstats = 0;
+			sinsp_parser* parser = m_inspector->get_parser();
+			return parser != NULL ? parser->get_parse_stats(nstats) : NULL;
+		});
+	}
+
+	if(flags & PPM_SCAP_STATS_WORKLOAD_COUNTERS)
+	{
+		add_source([this](uint32_t* nstats) -> const scap_stats_v2*
+		{
+			*nstats = 0;
+			sinsp_thread_manager* thread_manager = m_inspector->m_thread_manager;
+			return thread_manager != NULL ? thread_manager->get_workload_stats(nstats) : NULL;
+		});
+	}
+
+	if(flags & PPM_SCAP_STATS_MEMORY)
+	{
+		add_source([this](uint32_t* nstats)
+		{
+			return m_inspector->get_memory_stats(nstats);
+		});
+	}
+
+#ifdef GATHER_INTERNAL_STATS
+	if(flags & SINSP_METRICS_INTERNAL_STATS)
+	{
+		add_source([this](uint32_t* nstats)
+		{
+			return get_internal_stats(nstats);
+		});
+	}
+#endif
+}
+
+void sinsp_metrics_collector::add_source(const source_t& source)
+{
+	m_sources.push_back({source, {}});
+}
+
+const sinsp_metrics_collector::metric_name* sinsp_metrics_collector::intern(const scap_stats_v2& stat)
+{
+	auto it = m_names.find(stat.name);
+	if(it != m_names.end())
+	{
+		return it->second.get();
+	}
+
+	std::unique_ptr<metric_name> n(new metric_name());
+	n->m_raw = stat.name;
+	n->m_counter = (stat.flags & METRICS_COUNTER_FLAGS) != 0;
+
+	//
+	// Metric names only allow [a-zA-Z0-9_:], and can't start with a digit
+	//
+	n->m_name = m_prefix;
+	if(!n->m_name.empty())
+	{
+		n->m_name += '_';
+	}
+	else if(isdigit((unsigned char)stat.name[0]))
+	{
+		n->m_name += '_';
+	}
+	for(const char* c = stat.name; *c != '\0'; c++)
+	{
+		n->m_name += (isalnum((unsigned char)*c) || *c == ':') ? *c : '_';
+	}
+	if(n->m_counter && (n->m_name.size() < 6 ||
+			    n->m_name.compare(n->m_name.size() - 6, 6, "_total") != 0))
+	{
+		n->m_name += "_total";
+	}
+
+	const metric_name* res = n.get();
+	m_names[n->m_raw] = std::move(n);
+	return res;
+}
+
+void sinsp_metrics_collector::snapshot()
+{
+	m_staging.clear();
+	for(auto& s : m_sources)
+	{
+		uint32_t nstats = 0;
+		const scap_stats_v2* stats = s.m_fetch(&nstats);
+		if(stats == NULL)
+		{
+			continue;
+		}
+
+		if(s.m_names.size() < nstats)
+		{
+			s.m_names.resize(nstats, NULL);
+		}
+
+		for(uint32_t j = 0; j < nstats; j++)
+		{
+			const scap_stats_v2& stat = stats[j];
+			if(stat.name[0] == '\0')
+			{
+				continue;
+			}
+
+			const metric_name* name = s.m_names[j];
+			if(name == NULL || name->m_raw.compare(stat.name) != 0)
+			{
+				name = intern(stat);
+				s.m_names[j] = name;
+			}
+			m_staging.push_back({name, stat.type, stat.value});
+		}
+	}
+
+	uint64_t ts = sinsp_utils::get_current_time_ns();
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_samples.swap(m_staging);
+	m_snapshot_ts = ts;
+}
+
+uint64_t sinsp_metrics_collector::get_snapshot_ts() const
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_snapshot_ts;
+}
+
+void sinsp_metrics_collector::to_prometheus(std::string& out) const
+{
+	std::vector<sample> samples;
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		samples = m_samples;
+	}
+
+	// A name reported by two sources is only rendered once, the format
+	// doesn't allow duplicated series
+	std::unordered_set<const metric_name*> seen;
+	char buf[32];
+	for(const auto& s : samples)
+	{
+		if(!seen.insert(s.m_name).second)
+		{
+			continue;
+		}
+
+		switch(s.m_type)
+		{
+		case STATS_VALUE_TYPE_U32:
+			snprintf(buf, sizeof(buf), "%u", s.m_value.u32);
+			break;
+		case STATS_VALUE_TYPE_S32:
+			snprintf(buf, sizeof(buf), "%d", s.m_value.s32);
+			break;
+		case STATS_VALUE_TYPE_U64:
+			snprintf(buf, sizeof(buf), "%" PRIu64, s.m_value.u64);
+			break;
+		case STATS_VALUE_TYPE_S64:
+			snprintf(buf, sizeof(buf), "%" PRId64, s.m_value.s64);
+			break;
+		case STATS_VALUE_TYPE_D:
+			snprintf(buf, sizeof(buf), "%.15g", s.m_value.d);
+			break;
+		case STATS_VALUE_TYPE_F:
+			snprintf(buf, sizeof(buf), "%.7g", s.m_value.f);
+			break;
+		case STATS_VALUE_TYPE_I:
+			snprintf(buf, sizeof(buf), "%d", s.m_value.i);
+			break;
+		default:
+			ASSERT(false);
+			continue;
+		}
+
+		out += "# TYPE ";
+		out += s.m_name->m_name;
+		out += s.m_name->m_counter ? " counter\n" : " gauge\n";
+		out += s.m_name->m_name;
+		out += ' ';
+		out += buf;
+		out += '\n';
+	}
+}
+
+#ifdef GATHER_INTERNAL_STATS
+const scap_stats_v2* sinsp_metrics_collector::get_internal_stats(uint32_t* nstats)
+{
+	static const struct
+	{
+		const char* name;
+		uint64_t sinsp_stats::*field;
+	} s_fields[] = {
+		{"sinsp.noncached_fd_lookups", &sinsp_stats::m_n_noncached_fd_lookups},
+		{"sinsp.cached_fd_lookups", &sinsp_stats::m_n_cached_fd_lookups},
+		{"sinsp.failed_fd_lookups", &sinsp_stats::m_n_failed_fd_lookups},
+		{"sinsp.threads", &sinsp_stats::m_n_threads},
+		{"sinsp.fds", &sinsp_stats::m_n_fds},
+		{"sinsp.lazy_fd_loads", &sinsp_stats::m_n_lazy_fd_loads},
+		{"sinsp.prefetched_fd_loads", &sinsp_stats::m_n_prefetched_fd_loads},
+		{"sinsp.interned_vectors", &sinsp_stats::m_n_interned_vectors},
+		{"sinsp.interned_bytes", &sinsp_stats::m_interned_bytes},
+		{"sinsp.interned_unshared_bytes", &sinsp_stats::m_interned_unshared_bytes},
+		{"sinsp.added_fds", &sinsp_stats::m_n_added_fds},
+		{"sinsp.removed_fds", &sinsp_stats::m_n_removed_fds},
+		{"sinsp.stored_evts", &sinsp_stats::m_n_stored_evts},
+		{"sinsp.store_drops", &sinsp_stats::m_n_store_drops},
+		{"sinsp.retrieved_evts", &sinsp_stats::m_n_retrieved_evts},
+		{"sinsp.retrieve_drops", &sinsp_stats::m_n_retrieve_drops},
+	};
+
+	sinsp_stats stats = m_inspector->get_stats();
+	auto& metrics = stats.get_metrics_registry().get_metrics();
+
+	m_internal_stats.resize(sizeof(s_fields) / sizeof(s_fields[0]) + metrics.size());
+	size_t j = 0;
+	for(const auto& f : s_fields)
+	{
+		scap_stats_v2& stat = m_internal_stats[j++];
+		strlcpy(stat.name, f.name, STATS_NAME_MAX);
+		stat.flags = 0;
+		stat.type = STATS_VALUE_TYPE_U64;
+		stat.value.u64 = stats.*f.field;
+	}
+	for(const auto& m : metrics)
+	{
+		scap_stats_v2& stat = m_internal_stats[j++];
+		strlcpy(stat.name, m.first.get_name().c_str(), STATS_NAME_MAX);
+		stat.flags = 0;
+		stat.type = STATS_VALUE_TYPE_U64;
+		stat.value.u64 = m.second->get_value();
+	}
+
+	*nstats = m_internal_stats.size();
+	return m_internal_stats.data();
+}
+#endif
@@ -0,0 +1,156 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <scap.h>
+#include "sinsp_public.h"
+
+class sinsp;
+
+//
+// Collector flag for the sinsp_stats counters and the internal_metrics
+// registry, only available when built with GATHER_INTERNAL_STATS. The
+// other sources are selected with the PPM_SCAP_STATS_* flags.
+//
+#define SINSP_METRICS_INTERNAL_STATS (1u << 31)
+
+/** @defgroup state State management
+ *  @{
+ */
+
+/*!
+  \brief Gathers the metrics of an inspector and of its engine, and renders
+  them in the Prometheus text exposition format.
+
+  Every source hands its metrics as a buffer of \ref scap_stats_v2, and a
+  snapshot only copies their values: the names are converted once, the
+  first time they are seen at a given position of a buffer. The snapshot
+  is taken on the thread calling sinsp::next(), and rendered on demand
+  from any other thread, e.g. the one serving the scrapes, without
+  stopping the capture.
+
+  The sources are selected with the PPM_SCAP_STATS_* flags:
+  - PPM_SCAP_STATS_KERNEL_COUNTERS and PPM_SCAP_STATS_LIBBPF_STATS: the
+    engine stats, see sinsp::get_capture_stats_v2().
+  - PPM_SCAP_STATS_RESOURCE_UTILIZATION: the CPU and memory usage of the
+    process, live captures only. They are read from /proc, which makes
+    this source way more expensive than the others.
+  - PPM_SCAP_STATS_LATENCY: the latency profiler and the lag monitor.
+  - PPM_SCAP_STATS_PARSE_COUNTERS: the parser counters.
+  - PPM_SCAP_STATS_WORKLOAD_COUNTERS: the workload counters.
+  - PPM_SCAP_STATS_MEMORY: the memory of the state tables, see
+    sinsp::get_memory_stats().
+  - SINSP_METRICS_INTERNAL_STATS: sinsp::get_stats().
+  Sources not owned by the inspector, like the profile of a filter ruleset,
+  can be added with add_source().
+*/
+class SINSP_PUBLIC sinsp_metrics_collector
+{
+public:
+	/*!
+	  \brief Returns a buffer of metrics and sets nstats to its size. The
+	   buffer must stay valid until the next call.
+	*/
+	typedef std::function<const scap_stats_v2*(uint32_t* nstats)> source_t;
+
+	/*!
+	  \param inspector The inspector, it must outlive the collector.
+	  \param flags The sources, see above.
+	  \param prefix Prepended to the names of the metrics, with an
+	   underscore.
+	*/
+	sinsp_metrics_collector(sinsp* inspector, uint32_t flags, const std::string& prefix = "libs");
+
+	/*!
+	  \brief Adds a source of metrics. Must not be called while a
+	   snapshot is taken.
+	*/
+	void add_source(const source_t& source);
+
+	/*!
+	  \brief Takes a snapshot of all the sources, replacing the previous
+	   one. Must be called on the thread processing the events.
+	*/
+	void snapshot();
+
+	/*!
+	  \brief Appends the last snapshot to out, in the Prometheus text
+	   exposition format. Can be called from any thread.
+	*/
+	void to_prometheus(std::string& out) const;
+
+	/*!
+	  \brief Returns the time of the last snapshot in nanoseconds since
+	   the epoch, 0 if none was taken.
+	*/
+	uint64_t get_snapshot_ts() const;
+
+private:
+	struct metric_name
+	{
+		std::string m_raw;  ///< The name in the buffer of the source.
+		std::string m_name; ///< The Prometheus name.
+		bool m_counter;
+	};
+
+	struct sample
+	{
+		const metric_name* m_name;
+		scap_stats_v2_value_type m_type;
+		scap_stats_v2_value m_value;
+	};
+
+	struct source
+	{
+		source_t m_fetch;
+		// The name of the metric found at each position of the buffer
+		// in the previous snapshot, the buffers rarely change layout
+		std::vector<const metric_name*> m_names;
+	};
+
+	const metric_name* intern(const scap_stats_v2& stat);
+#ifdef GATHER_INTERNAL_STATS
+	const scap_stats_v2* get_internal_stats(uint32_t* nstats);
+#endif
+
+	sinsp* m_inspector;
+	std::string m_prefix;
+	std::vector<source> m_sources;
+
+	// Only accessed by snapshot(), the names are never freed so that the
+	// samples can point to them
+	std::unordered_map<std::string, std::unique_ptr<metric_name>> m_names;
+	std::vector<sample> m_staging;
+#ifdef GATHER_INTERNAL_STATS
+	std::vector<scap_stats_v2> m_internal_stats;
+#endif
+
+	// Protects the last snapshot
+	mutable std::mutex m_mtx;
+	std::vector<sample> m_samples;
+	uint64_t m_snapshot_ts;
+};
+
+/*@}*/
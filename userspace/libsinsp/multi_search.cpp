@@ -0,0 +1,180 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+#include <queue>
+
+#include "multi_search.h"
+
+multi_search::multi_search(bool case_insensitive):
+	m_case_insensitive(case_insensitive),
+	m_match_all(false),
+	m_has_unanchored(false),
+	m_max_anchored_len(0),
+	m_num_classes(1)
+{
+	build();
+}
+
+multi_search::~multi_search()
+{
+}
+
+void multi_search::add_pattern(const std::string& pattern, bool anchored)
+{
+	m_patterns.push_back({pattern, anchored});
+	if(m_case_insensitive)
+	{
+		for(auto& c : m_patterns.back().m_str)
+		{
+			c = tolower((unsigned char) c);
+		}
+	}
+}
+
+void multi_search::build()
+{
+	m_match_all = false;
+	m_has_unanchored = false;
+	m_max_anchored_len = 0;
+
+	// class 0 is for the bytes not used by any pattern
+	memset(m_classes, 0, sizeof(m_classes));
+	m_num_classes = 1;
+	for(const auto& p : m_patterns)
+	{
+		for(unsigned char c : p.m_str)
+		{
+			if(m_classes[c] == 0)
+			{
+				m_classes[c] = m_num_classes++;
+			}
+		}
+	}
+	if(m_case_insensitive)
+	{
+		for(int c = 'A'; c <= 'Z'; c++)
+		{
+			m_classes[c] = m_classes[tolower(c)];
+		}
+	}
+
+	// build the trie, 0 is both the root and "no transition"
+	m_delta.assign(m_num_classes, 0);
+	m_flags.assign(1, 0);
+	m_depth.assign(1, 0);
+	for(const auto& p : m_patterns)
+	{
+		if(p.m_str.empty())
+		{
+			m_match_all = true;
+			continue;
+		}
+
+		uint32_t state = 0;
+		for(unsigned char c : p.m_str)
+		{
+			uint32_t& next = m_delta[state * m_num_classes + m_classes[c]];
+			if(next == 0)
+			{
+				next = m_flags.size();
+				m_flags.push_back(0);
+				m_depth.push_back(m_depth[state] + 1);
+				m_delta.resize(m_delta.size() + m_num_classes, 0);
+			}
+			// m_delta may have been reallocated
+			state = m_delta[state * m_num_classes + m_classes[c]];
+		}
+
+		if(p.m_anchored)
+		{
+			m_flags[state] |= MATCH_ANCHORED;
+			m_max_anchored_len = std::max(m_max_anchored_len, (uint32_t) p.m_str.size());
+		}
+		else
+		{
+			m_flags[state] |= MATCH_ANYWHERE;
+			m_has_unanchored = true;
+		}
+	}
+
+	// turn the trie into a DFA by following the failure links breadth-first,
+	// so that the failure state of every state is complete when it's needed
+	std::vector<uint32_t> fail(m_flags.size(), 0);
+	std::queue<uint32_t> states;
+	for(uint32_t c = 0; c < m_num_classes; c++)
+	{
+		if(m_delta[c] != 0)
+		{
+			states.push(m_delta[c]);
+		}
+	}
+	while(!states.empty())
+	{
+		uint32_t state = states.front();
+		states.pop();
+		for(uint32_t c = 0; c < m_num_classes; c++)
+		{
+			uint32_t& next = m_delta[state * m_num_classes + c];
+			uint32_t fail_next = m_delta[fail[state] * m_num_classes + c];
+			if(next == 0)
+			{
+				next = fail_next;
+				continue;
+			}
+
+			// anchored patterns only match from the beginning, so they
+			// are not inherited through the failure links
+			fail[next] = fail_next;
+			m_flags[next] |= m_flags[fail_next] & MATCH_ANYWHERE;
+			states.push(next);
+		}
+	}
+}
+
+bool multi_search::match(const char *str) const
+{
+	if(m_match_all)
+	{
+		return true;
+	}
+
+	const uint8_t* p = (const uint8_t*) str;
+	uint32_t state = 0;
+	for(uint32_t pos = 1; *p != '\0'; p++, pos++)
+	{
+		state = m_delta[state * m_num_classes + m_classes[*p]];
+		uint8_t flags = m_flags[state];
+		if(flags != 0)
+		{
+			if((flags & MATCH_ANYWHERE) ||
+			   ((flags & MATCH_ANCHORED) && m_depth[state] == pos))
+			{
+				return true;
+			}
+		}
+
+		if(!m_has_unanchored && pos >= m_max_anchored_len)
+		{
+			return false;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,100 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+//
+// A data structure that allows testing a string S against a set of
+// patterns P in a single pass over S. The search succeeds if any of
+// the patterns Pi is a substring of S or, for the anchored ones,
+// a prefix of S.
+//
+// This is an Aho-Corasick automaton compiled into a deterministic
+// state transition table. The input bytes are mapped to the classes
+// of bytes used by the patterns, so that the table only has as many
+// columns as the distinct bytes of the patterns, plus one for all
+// the other bytes.
+//
+// Here are some examples:
+// - search(/usr/bin/nc -l, [" -l ", "nc -l", anchored "/tmp"])
+//         succeeds because "nc -l" is a substring of /usr/bin/nc -l.
+// - search(/tmp/nc, [" -l ", "nc -l", anchored "/tmp"])
+//         succeeds because /tmp is a prefix of /tmp/nc.
+// - search(/var/tmp/x, [" -l ", "nc -l", anchored "/tmp"])
+//         does not succeed because /tmp is not a prefix of /var/tmp/x.
+//
+class multi_search
+{
+public:
+	// If case_insensitive is true, the patterns and the searched strings
+	// are compared ignoring the case of ASCII characters.
+	multi_search(bool case_insensitive = false);
+	virtual ~multi_search();
+
+	// Patterns can be added until build() is called.
+	void add_pattern(const std::string& pattern, bool anchored = false);
+
+	// Compiles the automaton, must be called before match().
+	void build();
+
+	bool match(const char *str) const;
+
+	inline bool case_insensitive() const
+	{
+		return m_case_insensitive;
+	}
+
+	inline size_t num_patterns() const
+	{
+		return m_patterns.size();
+	}
+
+private:
+	enum match_flags : uint8_t
+	{
+		// a pattern ends in this state, wherever it started
+		MATCH_ANYWHERE = 1,
+		// an anchored pattern ends in this state
+		MATCH_ANCHORED = 2,
+	};
+
+	struct pattern
+	{
+		std::string m_str;
+		bool m_anchored;
+	};
+
+	bool m_case_insensitive;
+	std::vector<pattern> m_patterns;
+
+	// an empty pattern matches all the strings
+	bool m_match_all;
+	bool m_has_unanchored;
+	uint32_t m_max_anchored_len;
+
+	uint16_t m_classes[256];
+	uint32_t m_num_classes;
+	// transitions of the state s are at [s * m_num_classes, (s + 1) * m_num_classes)
+	std::vector<uint32_t> m_delta;
+	std::vector<uint8_t> m_flags;
+	std::vector<uint32_t> m_depth;
+};
@@ -0,0 +1,218 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <algorithm>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "output_queue.h"
+#include "thread_placement.h"
+
+static uint32_t round_up_pow2(uint32_t n)
+{
+	uint32_t res = 1;
+	while(res < n)
+	{
+		res <<= 1;
+	}
+	return res;
+}
+
+sinsp_output_queue::sinsp_output_queue(const batch_callback& callback,
+				       uint32_t capacity,
+				       uint32_t batch_size)
+	: m_mask(round_up_pow2(capacity) - 1),
+	  m_batch_size(batch_size),
+	  m_callback(callback),
+	  m_head(0),
+	  m_tail(0),
+	  m_num_drops(0),
+	  m_waiting(false),
+	  m_flushing(false),
+	  m_stop(false)
+{
+	if(capacity == 0 || batch_size == 0)
+	{
+		throw sinsp_exception("the output queue needs a non-empty ring and batch");
+	}
+
+	m_slots.reset(new output[m_mask + 1]);
+	m_thread = std::thread(&sinsp_output_queue::run, this);
+}
+
+sinsp_output_queue::~sinsp_output_queue()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_stop = true;
+	}
+	m_ready.notify_one();
+	m_thread.join();
+}
+
+sinsp_output_queue::output* sinsp_output_queue::reserve()
+{
+	uint64_t head = m_head.load(std::memory_order_relaxed);
+	if(head - m_tail.load(std::memory_order_acquire) > m_mask)
+	{
+		m_num_drops.fetch_add(1, std::memory_order_relaxed);
+		return NULL;
+	}
+
+	return &m_slots[head & m_mask];
+}
+
+//
+// The output thread sets m_waiting before checking m_head one last time,
+// and this stores m_head before checking m_waiting: either the output
+// thread sees the new output, or this sees it waiting and wakes it up
+//
+void sinsp_output_queue::commit()
+{
+	m_head.fetch_add(1);
+	if(m_waiting.load())
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_ready.notify_one();
+	}
+}
+
+bool sinsp_output_queue::push(sinsp_evt* evt, const std::shared_ptr<sinsp_evt_formatter>& formatter, uint64_t tag)
+{
+	output* out = reserve();
+	if(out == NULL)
+	{
+		return false;
+	}
+
+	if(!formatter->resolve_tokens(evt, out->m_values))
+	{
+		return false;
+	}
+
+	out->m_ts = evt->get_ts();
+	out->m_tag = tag;
+	out->m_formatter = formatter;
+	commit();
+	return true;
+}
+
+bool sinsp_output_queue::push(uint64_t ts, const std::shared_ptr<sinsp_evt_formatter>& formatter, values_t& values, uint64_t tag)
+{
+	output* out = reserve();
+	if(out == NULL)
+	{
+		return false;
+	}
+
+	out->m_values.swap(values);
+	out->m_ts = ts;
+	out->m_tag = tag;
+	out->m_formatter = formatter;
+	commit();
+	return true;
+}
+
+void sinsp_output_queue::flush()
+{
+	std::unique_lock<std::mutex> lock(m_mtx);
+	m_flushing = true;
+	m_drained.wait(lock, [this] {
+		return m_tail.load() == m_head.load(std::memory_order_relaxed);
+	});
+	m_flushing = false;
+
+	if(m_exception)
+	{
+		std::exception_ptr e = m_exception;
+		m_exception = nullptr;
+		std::rethrow_exception(e);
+	}
+}
+
+void sinsp_output_queue::run()
+{
+	libsinsp::thread_placement::apply(libsinsp::thread_placement::thread_class::OUTPUT);
+
+	std::vector<const output*> batch;
+	batch.reserve(m_batch_size);
+
+	while(true)
+	{
+		uint64_t tail = m_tail.load(std::memory_order_relaxed);
+		uint64_t head = m_head.load(std::memory_order_acquire);
+
+		if(head == tail)
+		{
+			std::unique_lock<std::mutex> lock(m_mtx);
+			m_waiting = true;
+			if(m_head.load() == tail)
+			{
+				if(m_stop)
+				{
+					break;
+				}
+				m_ready.wait(lock);
+			}
+			m_waiting = false;
+			continue;
+		}
+
+		uint64_t n = std::min(head - tail, (uint64_t)m_batch_size);
+		batch.clear();
+		for(uint64_t j = 0; j < n; j++)
+		{
+			output& out = m_slots[(tail + j) & m_mask];
+			if(!out.m_formatter->format_values(out.m_values, out.m_text))
+			{
+				out.m_text.clear();
+			}
+			batch.push_back(&out);
+		}
+
+		bool failed;
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			failed = m_exception != nullptr;
+		}
+
+		if(!failed)
+		{
+			try
+			{
+				m_callback(batch);
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> lock(m_mtx);
+				m_exception = std::current_exception();
+			}
+		}
+
+		for(uint64_t j = 0; j < n; j++)
+		{
+			m_slots[(tail + j) & m_mask].m_formatter.reset();
+		}
+
+		m_tail.store(tail + n);
+		if(m_flushing.load())
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_drained.notify_all();
+		}
+	}
+}
@@ -0,0 +1,152 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "eventformatter.h"
+
+class sinsp_evt;
+
+/** @defgroup event Event manipulation
+ *  @{
+ */
+
+/*!
+  \brief Moves the formatting and the delivery of the outputs, e.g. the
+  alerts of the matching rules, off the capture thread.
+
+  The capture thread pushes the values of the fields of the format, extracted
+  from the event while it's still current (see
+  `sinsp_evt_formatter::resolve_tokens`), in a bounded ring of preallocated
+  slots. An output thread renders them with `sinsp_evt_formatter::format_values`
+  and hands them to the callback in batches.
+
+  There is a single producer and a single consumer, so pushing takes neither a
+  lock nor an allocation once the slots have grown: the strings of a slot are
+  reused by the next output written in it. When the ring is full the output is
+  dropped rather than blocking the capture (see `get_num_drops`).
+*/
+class SINSP_PUBLIC sinsp_output_queue
+{
+public:
+	typedef std::vector<std::pair<std::string, std::string>> values_t;
+
+	struct output
+	{
+		uint64_t m_ts; ///< Timestamp of the event.
+		uint64_t m_tag; ///< Set by the producer, e.g. to tell the rule that matched.
+		std::shared_ptr<sinsp_evt_formatter> m_formatter;
+		values_t m_values; ///< The (field name, value) pairs of the format.
+		std::string m_text; ///< The formatted output, empty if some values were missing.
+	};
+
+	/*!
+	  \brief Called on the output thread with up to `batch_size` outputs, in
+	   the order they were pushed. The outputs are only valid during the call.
+	*/
+	typedef std::function<void(const std::vector<const output*>& batch)> batch_callback;
+
+	static const uint32_t DEFAULT_CAPACITY = 4096;
+	static const uint32_t DEFAULT_BATCH_SIZE = 64;
+
+	/*!
+	  \brief Constructs the queue and starts its output thread.
+
+	  \param capacity Maximum number of queued outputs, rounded up to a power of 2.
+	  \param batch_size Maximum number of outputs passed to a single callback.
+	*/
+	sinsp_output_queue(const batch_callback& callback,
+			   uint32_t capacity = DEFAULT_CAPACITY,
+			   uint32_t batch_size = DEFAULT_BATCH_SIZE);
+
+	/*!
+	  \brief Delivers the queued outputs and stops the output thread.
+	*/
+	~sinsp_output_queue();
+
+	sinsp_output_queue(const sinsp_output_queue&) = delete;
+	sinsp_output_queue& operator=(const sinsp_output_queue&) = delete;
+
+	/*!
+	  \brief Extracts the fields of the formatter from the event and queues
+	   them. Must be called from the capture thread.
+
+	  \return false if the output was dropped: the queue is full, or the
+	   formatter requires all the values and some are missing.
+	*/
+	bool push(sinsp_evt* evt, const std::shared_ptr<sinsp_evt_formatter>& formatter, uint64_t tag = 0);
+
+	/*!
+	  \brief Queues values already extracted with `formatter`. They're swapped
+	   with the ones of the slot, so values gets back strings to reuse for
+	   the next extraction. Must be called from the capture thread.
+
+	  \return false if the queue is full, values is left untouched.
+	*/
+	bool push(uint64_t ts, const std::shared_ptr<sinsp_evt_formatter>& formatter, values_t& values, uint64_t tag = 0);
+
+	/*!
+	  \brief Waits for the queued outputs to be delivered. An exception
+	   thrown by the callback is rethrown here, the outputs following it are
+	   dropped until then.
+	*/
+	void flush();
+
+	inline uint64_t get_num_drops() const
+	{
+		return m_num_drops.load(std::memory_order_relaxed);
+	}
+
+private:
+	output* reserve();
+	void commit();
+	void run();
+
+	const uint64_t m_mask;
+	const uint32_t m_batch_size;
+	batch_callback m_callback;
+	std::unique_ptr<output[]> m_slots;
+	// Written by the capture thread
+	std::atomic<uint64_t> m_head;
+	// Written by the output thread, once the batch is delivered
+	std::atomic<uint64_t> m_tail;
+	std::atomic<uint64_t> m_num_drops;
+
+	// Only used to sleep, when the ring is empty or during flush()
+	std::mutex m_mtx;
+	std::condition_variable m_ready;
+	std::condition_variable m_drained;
+	std::atomic<bool> m_waiting;
+	std::atomic<bool> m_flushing;
+	bool m_stop;
+	std::exception_ptr m_exception;
+	std::thread m_thread;
+};
+
+/*@}*/
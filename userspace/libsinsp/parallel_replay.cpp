@@ -0,0 +1,292 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <thread>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "parallel_replay.h"
+
+// Matches buffered by a chunk before they are handed to the calling thread
+#define PARALLEL_REPLAY_BATCH 256
+
+// The inspectors are built and opened one at a time, some of the
+// static tables they initialize on first use are not thread safe
+static std::mutex s_setup_mtx;
+
+sinsp_parallel_replay::sinsp_parallel_replay(const std::string& filename,
+					     uint32_t num_threads,
+					     uint32_t num_chunks,
+					     uint64_t warmup_ns,
+					     const worker_factory& factory,
+					     const match_callback& callback)
+	: m_filename(filename),
+	  m_num_threads(num_threads),
+	  m_num_chunks(num_chunks),
+	  m_warmup_ns(warmup_ns),
+	  m_factory(factory),
+	  m_callback(callback),
+	  m_next_chunk(0),
+	  m_stop(false)
+{
+	if(num_threads == 0 || num_chunks == 0)
+	{
+		throw sinsp_exception("the parallel replay needs at least one thread and one chunk");
+	}
+}
+
+void sinsp_parallel_replay::split()
+{
+	std::vector<std::pair<uint64_t, uint64_t>> index;
+	{
+		std::lock_guard<std::mutex> lock(s_setup_mtx);
+		sinsp inspector;
+		inspector.open_savefile(m_filename);
+		inspector.get_event_index(index);
+	}
+
+	size_t n = m_num_chunks;
+	if(index.size() < n)
+	{
+		n = index.size();
+	}
+	if(n == 0)
+	{
+		n = 1;
+	}
+
+	m_chunks.clear();
+	m_chunks.resize(n);
+	for(size_t k = 0; k < n; k++)
+	{
+		chunk& c = m_chunks[k];
+		c.m_warmup_pos = 0;
+		c.m_start_pos = 0;
+		c.m_start_ts = 0;
+		c.m_end_pos = k + 1 < n ? index[index.size() * (k + 1) / n].second : UINT64_MAX;
+		c.m_done = false;
+		if(k == 0)
+		{
+			continue;
+		}
+
+		size_t first = index.size() * k / n;
+		c.m_start_pos = index[first].second;
+		c.m_start_ts = index[first].first;
+		if(m_warmup_ns == UINT64_MAX)
+		{
+			continue;
+		}
+
+		//
+		// Start from the last indexed event old enough, or from the
+		// beginning if there is none
+		//
+		uint64_t start_ts = index[first].first;
+		size_t w = first;
+		while(w > 0 && (index[w].first > start_ts || start_ts - index[w].first < m_warmup_ns))
+		{
+			w--;
+		}
+		if(index[w].first <= start_ts && start_ts - index[w].first >= m_warmup_ns)
+		{
+			c.m_warmup_pos = index[w].second;
+		}
+	}
+}
+
+uint64_t sinsp_parallel_replay::run()
+{
+	split();
+
+	m_next_chunk = 0;
+	m_stop = false;
+	m_exception = nullptr;
+
+	size_t num_threads = m_num_threads < m_chunks.size() ? m_num_threads : m_chunks.size();
+	std::vector<std::thread> threads;
+	for(size_t j = 0; j < num_threads; j++)
+	{
+		threads.emplace_back(&sinsp_parallel_replay::thread_loop, this);
+	}
+
+	//
+	// Report the chunks in order, as they are processed
+	//
+	uint64_t num_matches = 0;
+	try
+	{
+		std::vector<match> matches;
+		for(uint32_t k = 0; k < m_chunks.size(); k++)
+		{
+			chunk& c = m_chunks[k];
+			bool done = false;
+			while(!done)
+			{
+				{
+					std::unique_lock<std::mutex> lock(m_mtx);
+					m_chunk_updated.wait(lock, [this, &c] { return m_stop || c.m_done || !c.m_matches.empty(); });
+					if(m_stop)
+					{
+						break;
+					}
+					matches.swap(c.m_matches);
+					done = c.m_done;
+				}
+
+				for(const auto& m : matches)
+				{
+					m_callback(k, m.m_ts, m.m_output);
+				}
+				num_matches += matches.size();
+				matches.clear();
+			}
+		}
+	}
+	catch(...)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if(!m_exception)
+		{
+			m_exception = std::current_exception();
+		}
+		m_stop = true;
+	}
+
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+
+	if(m_exception)
+	{
+		std::exception_ptr e = m_exception;
+		m_exception = nullptr;
+		std::rethrow_exception(e);
+	}
+
+	return num_matches;
+}
+
+void sinsp_parallel_replay::thread_loop()
+{
+	uint32_t k;
+	while((k = m_next_chunk.fetch_add(1)) < m_chunks.size())
+	{
+		try
+		{
+			process(k);
+		}
+		catch(...)
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			if(!m_exception)
+			{
+				m_exception = std::current_exception();
+			}
+			// Let the other threads and the reporting stop early.
+			m_stop = true;
+			m_chunk_updated.notify_all();
+			return;
+		}
+	}
+}
+
+void sinsp_parallel_replay::process(uint32_t chunk_idx)
+{
+	chunk& c = m_chunks[chunk_idx];
+	sinsp inspector;
+	worker w;
+
+	{
+		std::lock_guard<std::mutex> lock(s_setup_mtx);
+		w = m_factory(&inspector, chunk_idx);
+		inspector.open_savefile(m_filename);
+	}
+
+	//
+	// A state checkpoint before the chunk gives its state, as long as
+	// no event of the chunk comes before it. Otherwise go back to the
+	// warm-up, the beginning of the capture restarts it with the state
+	// saved there
+	//
+	bool restored = c.m_start_pos != 0 && inspector.restore_checkpoint(c.m_start_ts);
+	if(restored && inspector.get_bytes_read() >= c.m_start_pos)
+	{
+		inspector.fseek(c.m_warmup_pos);
+	}
+	else if(!restored && c.m_warmup_pos != 0)
+	{
+		inspector.fseek(c.m_warmup_pos);
+	}
+
+	std::vector<match> matches;
+	bool done = false;
+	while(!done)
+	{
+		//
+		// The event returned by next() belongs to the chunk if the
+		// block read next is in it
+		//
+		uint64_t pos = inspector.get_bytes_read();
+		sinsp_evt* evt = nullptr;
+		done = pos >= c.m_end_pos;
+		if(!done)
+		{
+			int32_t res = inspector.next(&evt);
+			if(res == SCAP_EOF)
+			{
+				done = true;
+				evt = nullptr;
+			}
+			else if(res == SCAP_TIMEOUT || res == SCAP_FILTERED_EVENT)
+			{
+				evt = nullptr;
+			}
+			else if(res != SCAP_SUCCESS)
+			{
+				throw sinsp_exception(inspector.getlasterr());
+			}
+		}
+
+		if(evt != nullptr && pos >= c.m_start_pos &&
+		   (w.m_filter == nullptr || w.m_filter->run(evt)))
+		{
+			matches.push_back({evt->get_ts(), std::string()});
+			if(w.m_formatter != nullptr)
+			{
+				w.m_formatter->tostring(evt, &matches.back().m_output);
+			}
+		}
+
+		if(done || matches.size() >= PARALLEL_REPLAY_BATCH)
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			if(m_stop)
+			{
+				return;
+			}
+			for(auto& m : matches)
+			{
+				c.m_matches.push_back(std::move(m));
+			}
+			c.m_done = done;
+			m_chunk_updated.notify_all();
+			matches.clear();
+		}
+	}
+}
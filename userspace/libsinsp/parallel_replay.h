@@ -0,0 +1,149 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "filter.h"
+#include "eventformatter.h"
+
+class sinsp;
+class sinsp_evt;
+
+/** @defgroup event Event manipulation
+ *  @{
+ */
+
+/*!
+  \brief Processes a capture file on multiple threads.
+
+  The capture is split into consecutive chunks at the events of its event
+  index (see `sinsp_dumper::enable_index`), and every chunk is read by its
+  own inspector, on one of the threads. The matching events are reported
+  on the calling thread in file order, whatever the number of threads, so
+  the output is deterministic. The first chunk that isn't done is reported
+  as it's processed, the following ones are buffered in the meanwhile.
+
+  If the capture has state checkpoints (see
+  `sinsp_dumper::enable_checkpoints`), an inspector starts from the last
+  one before its chunk, and parses the events in between without reporting
+  them. Otherwise it gets the state saved at the beginning of the capture,
+  then parses the events of the `warmup_ns` nanoseconds before its chunk
+  the same way, to rebuild the state that changed since. The threads and
+  fds created before the warm-up and not seen during it are missing, use
+  UINT64_MAX to parse everything from the beginning of the capture and get
+  the same state as a serial read.
+
+  An event is assigned to a chunk by the position of the next event block
+  in the capture when `sinsp::next()` returns it, so the events generated
+  by the inspector go with the event that follows them.
+
+  Captures without an event index are read as a single chunk.
+*/
+class SINSP_PUBLIC sinsp_parallel_replay
+{
+public:
+	struct worker
+	{
+		std::unique_ptr<sinsp_filter> m_filter; ///< Events not matching it are discarded. Can be null to accept every event.
+		std::unique_ptr<sinsp_evt_formatter> m_formatter; ///< Used to format matching events. Can be null if no output is needed.
+	};
+
+	/*!
+	  \brief Builds the filter and the formatter of the chunk `chunk_idx`.
+	   Called on the thread of the chunk with its inspector, before the
+	   capture is opened, so it can configure the inspector as well.
+	*/
+	typedef std::function<worker(sinsp* inspector, uint32_t chunk_idx)> worker_factory;
+
+	/*!
+	  \brief Called on the thread of `run()` for every matching event, in
+	   file order, with its timestamp and formatted output (empty if the
+	   worker has no formatter).
+	*/
+	typedef std::function<void(uint32_t chunk_idx, uint64_t ts, const std::string& output)> match_callback;
+
+	/*!
+	  \param filename The capture file.
+	  \param num_threads Number of threads reading the chunks.
+	  \param num_chunks Number of chunks, at most the number of entries
+	   of the event index.
+	  \param warmup_ns How long before its chunk an inspector starts
+	   parsing the events.
+	*/
+	sinsp_parallel_replay(const std::string& filename,
+			      uint32_t num_threads,
+			      uint32_t num_chunks,
+			      uint64_t warmup_ns,
+			      const worker_factory& factory,
+			      const match_callback& callback);
+
+	/*!
+	  \brief Processes the whole capture.
+
+	  \return the number of matching events. Exceptions thrown by the
+	   inspectors, the workers or the callback are rethrown here.
+	*/
+	uint64_t run();
+
+private:
+	struct match
+	{
+		uint64_t m_ts;
+		std::string m_output;
+	};
+
+	struct chunk
+	{
+		uint64_t m_warmup_pos;  ///< Where the inspector starts reading, 0 for the beginning of the capture.
+		uint64_t m_start_pos;   ///< The first event of the chunk.
+		uint64_t m_start_ts;    ///< Timestamp of the first event of the chunk.
+		uint64_t m_end_pos;     ///< The first event of the next chunk, UINT64_MAX for the last one.
+		std::vector<match> m_matches; ///< Not reported yet.
+		bool m_done;
+	};
+
+	void split();
+	void thread_loop();
+	void process(uint32_t chunk_idx);
+
+	std::string m_filename;
+	uint32_t m_num_threads;
+	uint32_t m_num_chunks;
+	uint64_t m_warmup_ns;
+	worker_factory m_factory;
+	match_callback m_callback;
+
+	std::vector<chunk> m_chunks;
+	std::atomic<uint32_t> m_next_chunk;
+
+	// Protects the matches and the completion of the chunks.
+	std::mutex m_mtx;
+	std::condition_variable m_chunk_updated;
+	bool m_stop;
+	std::exception_ptr m_exception;
+};
+
+/*@}*/
@@ -46,10 +46,6 @@ bool should_drop(sinsp_evt *evt);
 #endif
 #include "sinsp_int.h"
 
-#if !defined(MINIMAL_BUILD)
-#include "container_engine/docker/async_source.h"
-#endif
-
 extern sinsp_protodecoder_list g_decoderlist;
 extern sinsp_evttables g_infotables;
 
@@ -61,6 +57,8 @@ sinsp_parser::sinsp_parser(sinsp *inspector) :
 {
 	m_fake_userevt = (scap_evt*)m_fake_userevt_storage;
 
+	init_parse_table();
+
 	//
 	// Note: allocated here instead of in the sinsp constructor because sinsp_partial_tracer
 	//       is not defined in sinsp.cpp
@@ -78,12 +76,6 @@ sinsp_parser::~sinsp_parser()
 		delete m_protodecoders[j];
 	}
 
-	while(!m_tmp_events_buffer.empty())
-	{
-		auto ptr = m_tmp_events_buffer.top();
-		free(ptr);
-		m_tmp_events_buffer.pop();
-	}
 	m_protodecoders.clear();
 
 	free(m_k8s_metaevents_state.m_piscapevt);
@@ -95,6 +87,219 @@ sinsp_parser::~sinsp_parser()
 	}
 }
 
+void sinsp_parser::init_parse_table()
+{
+	memset(m_parse_counters, 0, sizeof(m_parse_counters));
+
+	const ppm_event_info* etable = scap_get_event_info_table();
+	for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		parse_descriptor& d = m_parse_table[j];
+		d.m_steps = 0;
+		d.m_exit_fd_param = -1;
+
+		switch(j)
+		{
+		case PPME_CONTAINER_JSON_E:
+		case PPME_CONTAINER_JSON_2_E:
+		case PPME_USER_ADDED_E:
+		case PPME_USER_DELETED_E:
+		case PPME_GROUP_ADDED_E:
+		case PPME_GROUP_DELETED_E:
+			d.m_steps |= PARSE_NO_THREAD;
+			break;
+		case PPME_SYSCALL_CLONE_11_X:
+		case PPME_SYSCALL_CLONE_16_X:
+		case PPME_SYSCALL_CLONE_17_X:
+		case PPME_SYSCALL_CLONE_20_X:
+		case PPME_SYSCALL_FORK_X:
+		case PPME_SYSCALL_FORK_17_X:
+		case PPME_SYSCALL_FORK_20_X:
+		case PPME_SYSCALL_VFORK_X:
+		case PPME_SYSCALL_VFORK_17_X:
+		case PPME_SYSCALL_VFORK_20_X:
+		case PPME_SYSCALL_CLONE3_X:
+			d.m_steps |= PARSE_NO_QUERY_OS | PARSE_CLONE_EXIT;
+			break;
+		case PPME_SCHEDSWITCH_6_E:
+			d.m_steps |= PARSE_NO_QUERY_OS | PARSE_THREAD_ONLY;
+			break;
+		default:
+			break;
+		}
+
+		switch(j)
+		{
+		case PPME_SCHEDSWITCH_1_E:
+		case PPME_SCHEDSWITCH_6_E:
+		case PPME_DROP_E:
+		case PPME_DROP_X:
+		case PPME_SCAPEVENT_E:
+		case PPME_PROCINFO_E:
+		case PPME_CPU_HOTPLUG_E:
+			d.m_steps |= PARSE_KEEP_SELF;
+			break;
+		default:
+			break;
+		}
+
+		if(etable[j].flags & EF_SKIPPARSERESET)
+		{
+			d.m_steps |= PARSE_SKIP_RESET;
+		}
+
+		if(etable[j].flags & EF_USES_FD)
+		{
+			d.m_steps |= PARSE_USES_FD;
+		}
+
+		if(PPME_IS_ENTER(j))
+		{
+			continue;
+		}
+
+		if(etable[j].nparams != 0 &&
+		   (strcmp(etable[j].params[0].name, "res") == 0 ||
+		    strcmp(etable[j].params[0].name, "fd") == 0))
+		{
+			d.m_steps |= PARSE_ERRORCODE;
+
+			if(strcmp(etable[j].params[0].name, "res") == 0)
+			{
+				if(etable[j].flags & EF_READS_FROM_FD)
+				{
+					d.m_steps |= PARSE_READ_BYTES;
+				}
+				if(etable[j].flags & EF_WRITES_TO_FD)
+				{
+					d.m_steps |= PARSE_WRITE_BYTES;
+				}
+			}
+		}
+
+		//
+		// The exit events that carry the fd they use can be parsed
+		// without their enter event (see reset())
+		//
+		if(etable[j].flags & EF_USES_FD)
+		{
+			for(uint32_t k = 1; k < etable[j].nparams; k++)
+			{
+				if(etable[j].params[k].type == PT_FD && strcmp(etable[j].params[k].name, "fd") == 0)
+				{
+					d.m_exit_fd_param = (int8_t)k;
+					break;
+				}
+			}
+		}
+	}
+}
+
+void sinsp_parser::prefetch(const scap_evt* pevt)
+{
+	if(pevt->type >= PPM_EVENT_MAX)
+	{
+		return;
+	}
+
+	const parse_descriptor& desc = m_parse_table[pevt->type];
+	if(desc.m_steps & PARSE_NO_THREAD)
+	{
+		return;
+	}
+
+	//
+	// Not find_thread(), the last thread cache belongs to the
+	// current event
+	//
+	sinsp_threadinfo* tinfo = m_inspector->m_thread_manager->get_threads()->get(pevt->tid);
+	if(tinfo == NULL)
+	{
+		return;
+	}
+
+	SINSP_PREFETCH(tinfo);
+	if(!(desc.m_steps & PARSE_USES_FD))
+	{
+		return;
+	}
+
+	//
+	// The fd of the exit events that don't carry it is set by their
+	// enter event, which most likely hasn't been parsed yet
+	//
+	int32_t fdparam = PPME_IS_ENTER(pevt->type) ? 0 : desc.m_exit_fd_param;
+	if(fdparam < 0 || (uint32_t)fdparam >= pevt->nparams)
+	{
+		return;
+	}
+
+	const char* lens = (const char*)pevt + sizeof(struct ppm_evt_hdr);
+	uint32_t lensize = g_infotables.m_param_layouts[pevt->type].m_lensize;
+	uint32_t off = sizeof(struct ppm_evt_hdr) + lensize * pevt->nparams;
+	for(int32_t j = 0; j <= fdparam; j++)
+	{
+		uint32_t len;
+		if(lensize == sizeof(uint32_t))
+		{
+			memcpy(&len, lens + j * sizeof(uint32_t), sizeof(uint32_t));
+		}
+		else
+		{
+			uint16_t len16;
+			memcpy(&len16, lens + j * sizeof(uint16_t), sizeof(uint16_t));
+			len = len16;
+		}
+
+		if(j == fdparam)
+		{
+			if(len != sizeof(int64_t) || off + len > pevt->len)
+			{
+				return;
+			}
+			break;
+		}
+		off += len;
+	}
+
+	int64_t fd;
+	memcpy(&fd, (const char*)pevt + off, sizeof(int64_t));
+
+	sinsp_fdtable* fdtable = tinfo->get_fd_table();
+	if(fdtable != NULL)
+	{
+		fdtable->prefetch(fd);
+	}
+}
+
+const scap_stats_v2* sinsp_parser::get_parse_stats(uint32_t* nstats)
+{
+	m_parse_stats.clear();
+	for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		if(m_parse_counters[j].m_num_events == 0)
+		{
+			continue;
+		}
+
+		std::string prefix = std::string("parser.") + g_infotables.m_event_info[j].name + "_" + std::to_string(j);
+		scap_stats_v2 stat;
+		stat.flags = PPM_SCAP_STATS_PARSE_COUNTERS;
+		stat.type = STATS_VALUE_TYPE_U64;
+
+		strlcpy(stat.name, (prefix + ".events").c_str(), STATS_NAME_MAX);
+		stat.value.u64 = m_parse_counters[j].m_num_events;
+		m_parse_stats.push_back(stat);
+
+		strlcpy(stat.name, (prefix + ".parsed").c_str(), STATS_NAME_MAX);
+		stat.value.u64 = m_parse_counters[j].m_num_parsed;
+		m_parse_stats.push_back(stat);
+	}
+
+	*nstats = m_parse_stats.size();
+	return m_parse_stats.data();
+}
+
 void sinsp_parser::init_scapevt(metaevents_state& evt_state, uint16_t evt_type, uint16_t buf_size)
 {
 	scap_evt *new_piscapevt = (scap_evt*) realloc(evt_state.m_piscapevt, buf_size);
@@ -124,6 +329,11 @@ void sinsp_parser::set_track_connection_status(bool enabled)
 	m_track_connection_status = enabled;
 }
 
+void sinsp_parser::set_track_workload(bool enabled)
+{
+	m_track_workload = enabled;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // PROCESSING ENTRY POINT
 ///////////////////////////////////////////////////////////////////////////////
@@ -131,6 +341,8 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 {
 	uint16_t etype = evt->m_pevt->type;
 	bool is_live = m_inspector->is_live();
+	parse_counters& counters = m_parse_counters[etype];
+	counters.m_num_events++;
 
 	//
 	// Cleanup the event-related state
@@ -144,13 +356,7 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	if(is_live && !m_inspector->is_debug_enabled())
 	{
 		if(evt->get_tid() == m_inspector->m_self_pid &&
-		   etype != PPME_SCHEDSWITCH_1_E &&
-		   etype != PPME_SCHEDSWITCH_6_E &&
-		   etype != PPME_DROP_E &&
-		   etype != PPME_DROP_X &&
-		   etype != PPME_SCAPEVENT_E &&
-		   etype != PPME_PROCINFO_E &&
-		   etype != PPME_CPU_HOTPLUG_E &&
+		   !(m_parse_table[etype].m_steps & PARSE_KEEP_SELF) &&
 		   m_inspector->m_self_pid)
 		{
 			evt->m_filtered_out = true;
@@ -159,6 +365,33 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	}
 #endif
 
+	//
+	// Workload counters, updated before the filter: they account for what
+	// the threads do, not for what the consumer looks at
+	//
+	if(m_track_workload && evt->m_tinfo != nullptr &&
+	   !(m_parse_table[etype].m_steps & PARSE_NO_THREAD))
+	{
+		sinsp_threadinfo::workload_counters& workload = evt->m_tinfo->m_workload;
+		workload.m_num_events++;
+		if(m_parse_table[etype].m_steps & (PARSE_READ_BYTES | PARSE_WRITE_BYTES))
+		{
+			int64_t retval = evt->get_param(0)->as<int64_t>();
+			if(retval > 0)
+			{
+				// both for copy_file_range
+				if(m_parse_table[etype].m_steps & PARSE_READ_BYTES)
+				{
+					workload.m_bytes_read += retval;
+				}
+				if(m_parse_table[etype].m_steps & PARSE_WRITE_BYTES)
+				{
+					workload.m_bytes_written += retval;
+				}
+			}
+		}
+	}
+
 	//
 	// Filtering
 	//
@@ -208,7 +441,7 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 			{
 				if(evt->m_tinfo != NULL)
 				{
-					if(!(eflags & EF_SKIPPARSERESET || etype == PPME_SCHEDSWITCH_6_E))
+					if(!(m_parse_table[etype].m_steps & (PARSE_SKIP_RESET | PARSE_THREAD_ONLY)))
 					{
 						evt->m_tinfo->m_lastevent_type = PPM_EVENT_MAX;
 					}
@@ -221,6 +454,7 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	}
 
 	evt->m_filtered_out = false;
+	counters.m_num_parsed++;
 
 	//
 	// Route the event to the proper function
@@ -303,12 +537,6 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
 		parse_open_openat_creat_exit(evt);
 		break;
-	case PPME_SYSCALL_SELECT_E:
-	case PPME_SYSCALL_POLL_E:
-	case PPME_SYSCALL_PPOLL_E:
-	case PPME_SYSCALL_EPOLLWAIT_E:
-		parse_select_poll_epollwait_enter(evt);
-		break;
 	case PPME_SYSCALL_UNSHARE_E:
 	case PPME_SYSCALL_SETNS_E:
 		store_event(evt);
@@ -560,6 +788,45 @@ void sinsp_parser::event_cleanup(sinsp_evt *evt)
 // HELPERS
 ///////////////////////////////////////////////////////////////////////////////
 
+// The strings of a thread, see sinsp_threadinfo::m_interned_unknown
+static constexpr uint8_t INTERNED_EXE = 1 << 0;
+static constexpr uint8_t INTERNED_COMM = 1 << 1;
+static constexpr uint8_t INTERNED_CGROUPS = 1 << 2;
+
+// The syscalls whose exit events can intern their strings
+static inline bool can_intern_strings(uint16_t etype)
+{
+	switch(etype)
+	{
+	case PPME_SYSCALL_CLONE_20_E:
+	case PPME_SYSCALL_CLONE3_E:
+	case PPME_SYSCALL_FORK_20_E:
+	case PPME_SYSCALL_VFORK_20_E:
+	case PPME_SYSCALL_EXECVE_19_E:
+	case PPME_SYSCALL_EXECVEAT_E:
+		return true;
+	default:
+		return false;
+	}
+}
+
+//
+// The exit event of a clone or execve of the thread was lost: the probe
+// may have taken the strings it sent as the new ones of the thread, and
+// keeps leaving them out as long as they don't change
+//
+static inline void mark_interned_strings_lost(sinsp_threadinfo *tinfo)
+{
+	tinfo->m_interned_unknown = INTERNED_EXE | INTERNED_COMM | INTERNED_CGROUPS;
+}
+
+// The probe leaves the strings out as empty params, which sinsp_evt decodes
+// as "<NA>"
+static inline bool is_interned_string(const sinsp_evt_param *param)
+{
+	return param->m_len == 0 || (param->m_len == 5 && strncmp(param->m_val, "<NA>", 5) == 0);
+}
+
 //
 // Called before starting the parsing.
 // Returns false in case of issues resetting the state.
@@ -645,7 +912,7 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 			? sinsp_syscall_event_source_name : sinsp_no_event_source_name;
 	}
 
-	ppm_event_flags eflags = evt->get_info_flags();
+	const parse_descriptor& desc = m_parse_table[etype];
 
 	evt->m_fdinfo = NULL;
 	evt->m_errorcode = 0;
@@ -653,11 +920,24 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 	//
 	// Ignore scheduler events
 	//
-	if(eflags & EF_SKIPPARSERESET)
+	if(desc.m_steps & PARSE_SKIP_RESET)
 	{
-		if(etype == PPME_PROCINFO_E)
+		if(etype == PPME_PROCINFO_E || etype == PPME_TASK_AGGREGATE_E)
 		{
-			evt->m_tinfo = m_inspector->get_thread_ref(evt->m_pevt->tid, false, false).get();
+			evt->m_tinfo = m_inspector->get_thread(evt->m_pevt->tid, false, false);
+		}
+		else if(etype == PPME_IO_AGGREGATE_E)
+		{
+			//
+			// The aggregates belong to a process and not to one of its
+			// threads, and they must not touch the last event of the
+			// main thread, which may be in the middle of a syscall
+			//
+			evt->m_tinfo = m_inspector->get_thread(evt->m_pevt->tid, false, false);
+			if(evt->m_tinfo != NULL)
+			{
+				evt->m_fdinfo = evt->m_tinfo->get_fd(*(int64_t *)evt->get_param(0)->m_val);
+			}
 		}
 		else
 		{
@@ -675,60 +955,24 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 	// If we're exiting a clone or if we have a scheduler event
 	// (many kernel thread), we don't look for /proc
 	//
-	bool query_os;
-	if(etype == PPME_SYSCALL_CLONE_11_X ||
-		etype == PPME_SYSCALL_CLONE_16_X ||
-		etype == PPME_SYSCALL_CLONE_17_X ||
-		etype == PPME_SYSCALL_CLONE_20_X ||
-		etype == PPME_SYSCALL_FORK_X ||
-		etype == PPME_SYSCALL_FORK_17_X ||
-		etype == PPME_SYSCALL_FORK_20_X ||
-		etype == PPME_SYSCALL_VFORK_X ||
-		etype == PPME_SYSCALL_VFORK_17_X ||
-		etype == PPME_SYSCALL_VFORK_20_X ||
-		etype == PPME_SYSCALL_CLONE3_X ||
-		etype == PPME_SCHEDSWITCH_6_E)
-	{
-		query_os = false;
-	}
-	else
-	{
-		query_os = true;
-	}
+	bool query_os = !(desc.m_steps & PARSE_NO_QUERY_OS);
 
-	if(etype == PPME_CONTAINER_JSON_E ||
-	   etype == PPME_CONTAINER_JSON_2_E ||
-	   etype == PPME_USER_ADDED_E ||
-	   etype == PPME_USER_DELETED_E ||
-	   etype == PPME_GROUP_ADDED_E ||
-	   etype == PPME_GROUP_DELETED_E)
+	if(desc.m_steps & PARSE_NO_THREAD)
 	{
 		evt->m_tinfo = nullptr;
 		return true;
 	}
-	else
-	{
-		evt->m_tinfo = m_inspector->get_thread_ref(evt->m_pevt->tid, query_os, false).get();
-	}
 
-	if(etype == PPME_SCHEDSWITCH_6_E)
+	evt->m_tinfo = m_inspector->get_thread(evt->m_pevt->tid, query_os, false);
+
+	if(desc.m_steps & PARSE_THREAD_ONLY)
 	{
 		return false;
 	}
 
 	if(!evt->m_tinfo)
 	{
-		if(etype == PPME_SYSCALL_CLONE_11_X ||
-			etype == PPME_SYSCALL_CLONE_16_X ||
-			etype == PPME_SYSCALL_CLONE_17_X ||
-			etype == PPME_SYSCALL_CLONE_20_X ||
-			etype == PPME_SYSCALL_FORK_X ||
-			etype == PPME_SYSCALL_FORK_17_X ||
-			etype == PPME_SYSCALL_FORK_20_X ||
-			etype == PPME_SYSCALL_VFORK_X ||
-			etype == PPME_SYSCALL_VFORK_17_X ||
-			etype == PPME_SYSCALL_VFORK_20_X ||
-			etype == PPME_SYSCALL_CLONE3_X)
+		if(desc.m_steps & PARSE_CLONE_EXIT)
 		{
 #ifdef GATHER_INTERNAL_STATS
 			m_inspector->m_thread_manager->m_failed_lookups->decrement();
@@ -749,22 +993,27 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 
 	if(PPME_IS_ENTER(etype))
 	{
+		// A clone or execve of the thread whose exit never came
+		if(evt->m_info->category & EC_SYSCALL)
+		{
+			if(evt->m_tinfo->m_interned_exit_pending)
+			{
+				mark_interned_strings_lost(evt->m_tinfo);
+			}
+			evt->m_tinfo->m_interned_exit_pending = can_intern_strings(etype);
+		}
+
 		evt->m_tinfo->m_lastevent_fd = -1;
 		evt->m_tinfo->m_lastevent_type = etype;
 
-		if(eflags & EF_USES_FD)
+		if(desc.m_steps & PARSE_USES_FD)
 		{
-			sinsp_evt_param *parinfo;
-
 			//
 			// Get the fd.
 			// The fd is always the first parameter of the enter event.
 			//
-			parinfo = evt->get_param(0);
-			ASSERT(parinfo->m_len == sizeof(int64_t));
 			ASSERT(evt->get_param_info(0)->type == PT_FD);
-
-			evt->m_tinfo->m_lastevent_fd = *(int64_t *)parinfo->m_val;
+			evt->m_tinfo->m_lastevent_fd = evt->get_param(0)->as<int64_t>();
 			evt->m_fdinfo = evt->m_tinfo->get_fd(evt->m_tinfo->m_lastevent_fd);
 		}
 
@@ -784,6 +1033,12 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 			ASSERT((int64_t)tinfo->m_latency >= 0);
 		}
 
+		bool interned_exit_pending = tinfo->m_interned_exit_pending && (evt->m_info->category & EC_SYSCALL);
+		if(interned_exit_pending)
+		{
+			tinfo->m_interned_exit_pending = false;
+		}
+
 		if((etype==PPME_SYSCALL_EXECVE_18_X ||
 		   etype==PPME_SYSCALL_EXECVE_19_X)
 		   &&
@@ -798,8 +1053,21 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 		else
 		{
 			tinfo->set_lastevent_data_validity(false);
+			if(interned_exit_pending)
+			{
+				mark_interned_strings_lost(tinfo);
+			}
 
-			if(tinfo->m_lastevent_type != PPME_TRACER_E)
+			//
+			// The enter event was dropped, or not captured at all. Exit
+			// events carrying their fd can still be parsed on their own.
+			//
+			int8_t fdparam = desc.m_exit_fd_param;
+			if(fdparam > 0 && evt->get_num_params() > (uint32_t)fdparam)
+			{
+				tinfo->m_lastevent_fd = evt->get_param(fdparam)->as<int64_t>();
+			}
+			else if(tinfo->m_lastevent_type != PPME_TRACER_E)
 			{
 				return false;
 			}
@@ -808,20 +1076,9 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 		//
 		// Error detection logic
 		//
-		if(evt->get_num_params() != 0 &&
-			((evt->m_info->params[0].name[0] == 'r' &&
-			  evt->m_info->params[0].name[1] == 'e' &&
-			  evt->m_info->params[0].name[2] == 's' &&
-			  evt->m_info->params[0].name[3] == '\0') ||
-			 (evt->m_info->params[0].name[0] == 'f' &&
-			  evt->m_info->params[0].name[1] == 'd' &&
-			  evt->m_info->params[0].name[2] == '\0')))
-		{
-			sinsp_evt_param *parinfo;
-
-			parinfo = evt->get_param(0);
-			ASSERT(parinfo->m_len == sizeof(int64_t));
-			int64_t res = *(int64_t *)parinfo->m_val;
+		if((desc.m_steps & PARSE_ERRORCODE) && evt->get_num_params() != 0)
+		{
+			int64_t res = evt->get_param(0)->as<int64_t>();
 
 			if(res < 0)
 			{
@@ -832,7 +1089,7 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 		//
 		// Retrieve the fd
 		//
-		if(eflags & EF_USES_FD)
+		if(desc.m_steps & PARSE_USES_FD)
 		{
 			//
 			// The copy_file_range syscall has the peculiarity of using two fds
@@ -840,11 +1097,7 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 			// 
 			if(etype == PPME_SYSCALL_COPY_FILE_RANGE_X)
 			{
-				sinsp_evt_param *parinfo;
-				
-				parinfo = evt->get_param(1);
-				ASSERT(parinfo->m_len == sizeof(int64_t));
-				tinfo->m_lastevent_fd = *(int64_t *)parinfo->m_val;
+				tinfo->m_lastevent_fd = evt->get_param(1)->as<int64_t>();
 			}
 
 			evt->m_fdinfo = tinfo->get_fd(tinfo->m_lastevent_fd);
@@ -916,17 +1169,14 @@ void sinsp_parser::store_event(sinsp_evt *evt)
 	}
 
 	//
-	// Copy the data
+	// Copy the data, in a buffer sized after the event
 	//
 	auto tinfo = evt->m_tinfo;
+	tinfo->m_lastevent_data = reserve_event_buffer(tinfo->m_lastevent_data, elen);
 	if(tinfo->m_lastevent_data == NULL)
 	{
-		tinfo->m_lastevent_data = reserve_event_buffer();
-		if(tinfo->m_lastevent_data == NULL)
-		{
-			throw sinsp_exception("cannot reserve event buffer in sinsp_parser::store_event.");
-			return;
-		}
+		throw sinsp_exception("cannot reserve event buffer in sinsp_parser::store_event.");
+		return;
 	}
 	memcpy(tinfo->m_lastevent_data, evt->m_pevt, elen);
 	tinfo->m_lastevent_cpuid = evt->get_cpuid();
@@ -1027,6 +1277,26 @@ sinsp_protodecoder* sinsp_parser::add_protodecoder(std::string decoder_name)
 	return nd;
 }
 
+void sinsp_parser::register_protocol_callback(sinsp_l7_proto proto, sinsp_pd_callback_type etype, sinsp_protodecoder* dec)
+{
+	ASSERT(proto > L7_PROTO_UNKNOWN && proto < L7_PROTO_MAX);
+
+	switch(etype)
+	{
+	case CT_READ:
+		m_l7_read_callbacks[proto].push_back(dec);
+		break;
+	case CT_WRITE:
+		m_l7_write_callbacks[proto].push_back(dec);
+		break;
+	default:
+		ASSERT(false);
+		return;
+	}
+
+	m_l7_classify = true;
+}
+
 void sinsp_parser::register_event_callback(sinsp_pd_callback_type etype, sinsp_protodecoder* dec)
 {
 	switch(etype)
@@ -1048,6 +1318,70 @@ void sinsp_parser::register_event_callback(sinsp_pd_callback_type etype, sinsp_p
 ///////////////////////////////////////////////////////////////////////////////
 // PARSERS
 ///////////////////////////////////////////////////////////////////////////////
+//
+// With the string interning of the modern BPF probe, the exe, comm and
+// cgroups params of a clone (in the caller) or execve exit event are empty
+// when they didn't change since the previous event of the thread. Point them
+// to the values of the thread, so that the filters see them too, and take
+// the ones that were sent as the new values of the thread, which the next
+// events are resolved against.
+//
+// After the exit event of a clone or execve of the thread was lost (see
+// reset()), the values of the thread may be older than the ones the probe
+// leaves out: they are resolved to "<NA>" (no cgroups) until the probe
+// sends them again.
+//
+void sinsp_parser::resolve_interned_strings(sinsp_evt *evt, sinsp_threadinfo *tinfo)
+{
+	// Same positions in all the clone and execve events that can be interned
+	sinsp_evt_param *exe = evt->get_param(1);
+	sinsp_evt_param *comm = evt->get_param(13);
+	sinsp_evt_param *cgroups = evt->get_param(14);
+
+	if(is_interned_string(exe))
+	{
+		m_interned_exe = (tinfo->m_interned_unknown & INTERNED_EXE) ? "<NA>" : tinfo->m_exe;
+		exe->m_val = const_cast<char *>(m_interned_exe.c_str());
+		exe->m_len = m_interned_exe.size() + 1;
+	}
+	else
+	{
+		tinfo->m_exe = exe->m_val;
+		tinfo->m_interned_unknown &= ~INTERNED_EXE;
+	}
+
+	if(is_interned_string(comm))
+	{
+		m_interned_comm = (tinfo->m_interned_unknown & INTERNED_COMM) ? "<NA>" : tinfo->m_comm;
+		comm->m_val = const_cast<char *>(m_interned_comm.c_str());
+		comm->m_len = m_interned_comm.size() + 1;
+	}
+	else
+	{
+		tinfo->m_comm = comm->m_val;
+		tinfo->m_interned_unknown &= ~INTERNED_COMM;
+	}
+
+	if(cgroups->m_len == 0)
+	{
+		if(tinfo->m_interned_unknown & INTERNED_CGROUPS)
+		{
+			m_interned_cgroups.clear();
+		}
+		else
+		{
+			m_interned_cgroups = tinfo->get_cgroups_param();
+		}
+		cgroups->m_val = const_cast<char *>(m_interned_cgroups.data());
+		cgroups->m_len = m_interned_cgroups.size();
+	}
+	else
+	{
+		tinfo->set_cgroups(cgroups->m_val, cgroups->m_len);
+		tinfo->m_interned_unknown &= ~INTERNED_CGROUPS;
+	}
+}
+
 void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 {
 	sinsp_evt_param* parinfo;
@@ -1107,6 +1441,18 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 		return;
 	}
 
+	//
+	// Only the caller interns its strings, the child always sends them
+	//
+	if(flags & PPM_CL_STRINGS_INTERNED)
+	{
+		if(childtid > 0 && evt->m_tinfo != nullptr)
+		{
+			resolve_interned_strings(evt, evt->m_tinfo);
+		}
+		flags &= ~PPM_CL_STRINGS_INTERNED;
+	}
+
 	//
 	// Get the vtid to check if the clone is within a container
 	//
@@ -1247,7 +1593,7 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 	//
 	// Lookup the thread that called clone() so we can copy its information
 	//
-	sinsp_threadinfo* ptinfo = m_inspector->get_thread_ref(tid, true, true).get();
+	sinsp_threadinfo* ptinfo = m_inspector->get_thread(tid, true, true);
 	if(NULL == ptinfo)
 	{
 		//
@@ -1258,7 +1604,7 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 		return;
 	}
 
-	if(ptinfo->m_comm == "<NA>" && ptinfo->m_user.uid == 0xffffffff)
+	if(ptinfo->m_comm == "<NA>" && ptinfo->get_user()->uid == 0xffffffff)
 	{
 		valid_parent = false;
 	}
@@ -1266,7 +1612,7 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 	//
 	// See if the child is already there
 	//
-	sinsp_threadinfo* child = m_inspector->get_thread_ref(childtid, false, true).get();
+	sinsp_threadinfo* child = m_inspector->get_thread(childtid, false, true);
 	if(NULL != child)
 	{
 		//
@@ -1336,7 +1682,7 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 
 		tinfo->m_tty = ptinfo->m_tty;
 
-		tinfo->m_loginuser = ptinfo->m_loginuser;
+		*tinfo->get_loginuser() = *ptinfo->get_loginuser();
 
 		// Copy the full sets of capabilities from the parent
 		tinfo->m_cap_permitted = ptinfo->m_cap_permitted;
@@ -1372,8 +1718,8 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 		m_inspector->remove_thread(tid, true);
 		tid_collision = true;
 
-		ptinfo = m_inspector->get_thread_ref(tid,
-			true, true).get();
+		ptinfo = m_inspector->get_thread(tid,
+			true, true);
 
 		if(ptinfo == NULL)
 		{
@@ -1390,7 +1736,7 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 			return;
 		}
 
-		if(ptinfo->m_comm != "<NA>" && ptinfo->m_user.uid != 0xffffffff)
+		if(ptinfo->m_comm != "<NA>" && ptinfo->get_user()->uid != 0xffffffff)
 		{
 			//
 			// Parent found in proc, use its data
@@ -1403,7 +1749,7 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 			tinfo->m_sid = ptinfo->m_sid;
 			tinfo->m_vpgid = ptinfo->m_vpgid;
 			tinfo->m_tty = ptinfo->m_tty;
-			tinfo->m_loginuser = ptinfo->m_loginuser;
+			*tinfo->get_loginuser() = *ptinfo->get_loginuser();
 			if(!(flags & PPM_CL_CLONE_THREAD))
 			{
 				tinfo->m_env = ptinfo->m_env;
@@ -1493,10 +1839,11 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 		//
 		// Track down that those are cloned fds
 		//
-		for(auto fdit = tinfo->m_fdtable.m_table.begin(); fdit != tinfo->m_fdtable.m_table.end(); ++fdit)
+		tinfo->m_fdtable.loop([](int64_t fd, sinsp_fdinfo_t& fdinfo)
 		{
-			fdit->second.set_is_cloned();
-		}
+			fdinfo.set_is_cloned();
+			return true;
+		});
 
 		//
 		// It's important to reset the cache of the child thread, to prevent it from
@@ -1720,9 +2067,9 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 	//
 	if(tinfo->m_container_id.empty() == false)
 	{
-		tinfo->set_user(tinfo->m_user.uid);
-		tinfo->set_loginuser(tinfo->m_loginuser.uid);
-		tinfo->set_group(tinfo->m_group.gid);
+		tinfo->set_user(tinfo->get_user()->uid);
+		tinfo->set_loginuser(tinfo->get_loginuser()->uid);
+		tinfo->set_group(tinfo->get_group()->gid);
 	}
 
 	//
@@ -1772,7 +2119,7 @@ void sinsp_parser::parse_execve_enter(sinsp_evt *evt)
 	// was an an exec enter event. When parsing the exit event,
 	// the threadinfo for the tid will be removed, as it no longer
 	// exists.
-	sinsp_threadinfo* main_thread = m_inspector->get_thread_ref(evt->m_tinfo->m_pid, true, true).get();
+	sinsp_threadinfo* main_thread = m_inspector->get_thread(evt->m_tinfo->m_pid, true, true);
 
 	if(!main_thread)
 	{
@@ -1824,6 +2171,18 @@ void sinsp_parser::parse_execve_exit(sinsp_evt *evt)
 		return;
 	}
 
+	// Resolve the interned strings before the thread gets the new ones
+	if((etype == PPME_SYSCALL_EXECVE_19_X || etype == PPME_SYSCALL_EXECVEAT_X) &&
+	   evt->get_num_params() > 19)
+	{
+		parinfo = evt->get_param(19);
+		ASSERT(parinfo->m_len == sizeof(uint32_t));
+		if(*(uint32_t *)parinfo->m_val & PPM_EXE_STRINGS_INTERNED)
+		{
+			resolve_interned_strings(evt, evt->m_tinfo);
+		}
+	}
+
 	// Get the exe
 	parinfo = evt->get_param(1);
 	evt->m_tinfo->m_exe = parinfo->m_val;
@@ -1872,6 +2231,7 @@ void sinsp_parser::parse_execve_exit(sinsp_evt *evt)
 		parinfo = evt->get_param(5);
 		ASSERT(parinfo->m_len == sizeof(uint64_t));
 		evt->m_tinfo->m_ptid = *(uint64_t *)parinfo->m_val;
+		m_inspector->m_thread_manager->invalidate_ancestors();
 	}
 
 	// Get the fdlimit
@@ -2217,7 +2577,7 @@ void sinsp_parser::parse_execve_exit(sinsp_evt *evt)
 	if(evt->get_num_params() > 26)
 	{
 		parinfo = evt->get_param(26);
-		evt->m_tinfo->m_user.uid = *(uint32_t *)parinfo->m_val;
+		evt->m_tinfo->get_user()->uid = *(uint32_t *)parinfo->m_val;
 	}
 	//
 	// execve starts with a clean fd list, so we get rid of the fd list that clone
@@ -2258,9 +2618,9 @@ void sinsp_parser::parse_execve_exit(sinsp_evt *evt)
 	//
 	if(container_id != evt->m_tinfo->m_container_id)
 	{
-		evt->m_tinfo->set_user(evt->m_tinfo->m_user.uid);
-		evt->m_tinfo->set_loginuser(evt->m_tinfo->m_loginuser.uid);
-		evt->m_tinfo->set_group(evt->m_tinfo->m_group.gid);
+		evt->m_tinfo->set_user(evt->m_tinfo->get_user()->uid);
+		evt->m_tinfo->set_loginuser(evt->m_tinfo->get_loginuser()->uid);
+		evt->m_tinfo->set_group(evt->m_tinfo->get_group()->gid);
 	}
 
 	//
@@ -2286,7 +2646,7 @@ void sinsp_parser::parse_execve_exit(sinsp_evt *evt)
 	// into a new process. In any case, all the other threads were
 	// destroyed by doing the exec, so reset the child thread
 	// count.
-	evt->m_tinfo->m_nchilds = 0;
+	m_inspector->m_thread_manager->reset_mainthread_childcount(evt->m_tinfo);
 
 	return;
 }
@@ -2308,8 +2668,10 @@ void sinsp_parser::parse_dirfd(sinsp_evt *evt, char* name, int64_t dirfd, OUT st
 		is_absolute = (name[0] == '/');
 	}
 
-	std::string tdirstr;
-
+	//
+	// sdir is assigned in place, so that a string reused across calls
+	// keeps its buffer
+	//
 	if(is_absolute)
 	{
 		//
@@ -2321,7 +2683,7 @@ void sinsp_parser::parse_dirfd(sinsp_evt *evt, char* name, int64_t dirfd, OUT st
 	}
 	else if(dirfd == PPM_AT_FDCWD)
 	{
-		*sdir = evt->m_tinfo->get_cwd();
+		sdir->assign(evt->m_tinfo->get_cwd());
 	}
 	else
 	{
@@ -2334,14 +2696,11 @@ void sinsp_parser::parse_dirfd(sinsp_evt *evt, char* name, int64_t dirfd, OUT st
 		}
 		else
 		{
-			if(evt->m_fdinfo->m_name[evt->m_fdinfo->m_name.length()] == '/')
-			{
-				*sdir = evt->m_fdinfo->m_name;
-			}
-			else
+			const std::string& dirname = evt->m_fdinfo->m_name;
+			sdir->assign(dirname);
+			if(dirname.empty() || dirname.back() != '/')
 			{
-				tdirstr = evt->m_fdinfo->m_name + '/';
-				*sdir = tdirstr;
+				sdir->push_back('/');
 			}
 		}
 	}
@@ -2474,7 +2833,7 @@ void sinsp_parser::parse_open_openat_creat_exit(sinsp_evt *evt)
 	uint32_t enter_evt_flags;
 	sinsp_fdinfo_t fdi;
 	sinsp_evt *enter_evt = &m_tmp_evt;
-	std::string sdir;
+	std::string& sdir = m_tmp_dir;
 	uint16_t etype = evt->get_type();
 	uint32_t dev = 0;
 	uint64_t ino = 0;
@@ -2548,7 +2907,7 @@ void sinsp_parser::parse_open_openat_creat_exit(sinsp_evt *evt)
 			}
 		}
 
-		sdir = evt->m_tinfo->get_cwd();
+		sdir.assign(evt->m_tinfo->get_cwd());
 	}
 	else if(etype == PPME_SYSCALL_CREAT_X)
 	{
@@ -2587,7 +2946,7 @@ void sinsp_parser::parse_open_openat_creat_exit(sinsp_evt *evt)
 			}
 		}
 
-		sdir = evt->m_tinfo->get_cwd();
+		sdir.assign(evt->m_tinfo->get_cwd());
 	}
 	else if(etype == PPME_SYSCALL_OPENAT_X)
 	{
@@ -2677,7 +3036,7 @@ void sinsp_parser::parse_open_openat_creat_exit(sinsp_evt *evt)
 		namelen = parinfo->m_len;
 
 		// since open_by_handle_at returns an absolute path we will always start at /
-		sdir = "";
+		sdir.clear();
 	}
 	else
 	{
@@ -3363,8 +3722,13 @@ void sinsp_parser::parse_connect_exit(sinsp_evt *evt)
 
 	packed_data = (uint8_t*)parinfo->m_val;
 
+	// the socket may have been connected to another address before
+	update_connection_table(evt->m_tinfo, evt->m_tinfo->m_lastevent_fd, evt->m_fdinfo, false);
+
     fill_client_socket_info(evt, packed_data, force_overwrite_stale_data);
 
+	update_connection_table(evt->m_tinfo, evt->m_tinfo->m_lastevent_fd, evt->m_fdinfo, true);
+
 	//
 	// Call the protocol decoder callbacks associated to this event
 	//
@@ -3504,6 +3868,8 @@ void sinsp_parser::parse_accept_exit(sinsp_evt *evt)
 	// Add the entry to the table
 	//
 	evt->m_fdinfo = evt->m_tinfo->add_fd(fd, &fdi);
+
+	update_connection_table(evt->m_tinfo, fd, evt->m_fdinfo, true);
 }
 
 void sinsp_parser::parse_close_enter(sinsp_evt *evt)
@@ -3553,12 +3919,46 @@ void sinsp_parser::erase_fd(erase_fd_params* params)
 		m_inspector->m_fds_to_remove->push_back(params->m_fd);
 	}
 
+	update_connection_table(params->m_tinfo, params->m_fd, params->m_fdinfo, false);
+
 	if(m_fd_listener)
 	{
 		m_fd_listener->on_erase_fd(params);
 	}
 }
 
+void sinsp_parser::update_connection_table(sinsp_threadinfo* tinfo, int64_t fd, sinsp_fdinfo_t* fdinfo, bool add)
+{
+	sinsp_connection_table* table = m_inspector->m_connection_table.get();
+	if(table == nullptr || tinfo == nullptr || fdinfo == nullptr)
+	{
+		return;
+	}
+
+	if(fdinfo->m_type == SCAP_FD_IPV4_SOCK)
+	{
+		if(add)
+		{
+			table->add(fdinfo->m_sockinfo.m_ipv4info, fdinfo->is_role_server(), tinfo->m_pid, fd);
+		}
+		else
+		{
+			table->remove(fdinfo->m_sockinfo.m_ipv4info, tinfo->m_pid, fd);
+		}
+	}
+	else if(fdinfo->m_type == SCAP_FD_IPV6_SOCK)
+	{
+		if(add)
+		{
+			table->add(fdinfo->m_sockinfo.m_ipv6info, fdinfo->is_role_server(), tinfo->m_pid, fd);
+		}
+		else
+		{
+			table->remove(fdinfo->m_sockinfo.m_ipv6info, tinfo->m_pid, fd);
+		}
+	}
+}
+
 void sinsp_parser::parse_close_exit(sinsp_evt *evt)
 {
 	sinsp_evt_param *parinfo;
@@ -4211,6 +4611,55 @@ bool sinsp_parser::detect_and_process_tracer_write(sinsp_evt *evt,
 	return false;
 }
 
+// Sockets are classified on their first buffers only: after
+// L7_CLASSIFY_MAX_ATTEMPTS buffers matching no protocol, they're left alone
+#define L7_CLASSIFY_MAX_ATTEMPTS 4
+
+//
+// Classify the socket from its first buffers if needed, and call the
+// decoders registered for its protocol
+//
+void sinsp_parser::process_l7_buffer(sinsp_evt *evt, char *data, uint32_t datalen, bool is_read)
+{
+	sinsp_fdinfo_t* fdinfo = evt->m_fdinfo;
+
+	if(fdinfo->m_l7proto == L7_PROTO_UNCLASSIFIED)
+	{
+		if(fdinfo->m_type != SCAP_FD_IPV4_SOCK &&
+		   fdinfo->m_type != SCAP_FD_IPV6_SOCK &&
+		   fdinfo->m_type != SCAP_FD_UNIX_SOCK)
+		{
+			fdinfo->m_l7proto = L7_PROTO_UNKNOWN;
+			return;
+		}
+
+		if(datalen == 0)
+		{
+			return;
+		}
+
+		fdinfo->m_l7proto = m_protodetector.classify(data, datalen, fdinfo->get_l4proto());
+		if(fdinfo->m_l7proto == L7_PROTO_UNKNOWN && ++fdinfo->m_l7_attempts < L7_CLASSIFY_MAX_ATTEMPTS)
+		{
+			fdinfo->m_l7proto = L7_PROTO_UNCLASSIFIED;
+			return;
+		}
+	}
+
+	const auto& cbacks = is_read ? m_l7_read_callbacks[fdinfo->m_l7proto] : m_l7_write_callbacks[fdinfo->m_l7proto];
+	for(auto it = cbacks.begin(); it != cbacks.end(); ++it)
+	{
+		if(is_read)
+		{
+			(*it)->on_read(evt, data, datalen);
+		}
+		else
+		{
+			(*it)->on_write(evt, data, datalen);
+		}
+	}
+}
+
 void sinsp_parser::parse_rw_exit(sinsp_evt *evt)
 {
 	sinsp_evt_param *parinfo;
@@ -4355,6 +4804,11 @@ void sinsp_parser::parse_rw_exit(sinsp_evt *evt)
 					(*it)->on_read(evt, data, datalen);
 				}
 			}
+
+			if(m_l7_classify)
+			{
+				process_l7_buffer(evt, data, datalen, true);
+			}
 		}
 		else
 		{
@@ -4443,6 +4897,11 @@ void sinsp_parser::parse_rw_exit(sinsp_evt *evt)
 					(*it)->on_write(evt, data, datalen);
 				}
 			}
+
+			if(m_l7_classify)
+			{
+				process_l7_buffer(evt, data, datalen, false);
+			}
 		}
 	} else if (m_track_connection_status) {
 		if (evt->m_fdinfo->m_type == SCAP_FD_IPV4_SOCK ||
@@ -4990,7 +5449,7 @@ void sinsp_parser::parse_prlimit_exit(sinsp_evt *evt)
 					tid = evt->get_tid();
 				}
 
-				sinsp_threadinfo* ptinfo = m_inspector->get_thread_ref(tid, true, true).get();
+				sinsp_threadinfo* ptinfo = m_inspector->get_thread(tid, true, true);
 				if(ptinfo == NULL)
 				{
 					ASSERT(false);
@@ -5006,24 +5465,6 @@ void sinsp_parser::parse_prlimit_exit(sinsp_evt *evt)
 	}
 }
 
-void sinsp_parser::parse_select_poll_epollwait_enter(sinsp_evt *evt)
-{
-	if(evt->m_tinfo == nullptr)
-	{
-		ASSERT(false);
-		return;
-	}
-
-	if(evt->m_tinfo->m_lastevent_data == NULL)
-	{
-		evt->m_tinfo->m_lastevent_data = reserve_event_buffer();
-		if(evt->m_tinfo->m_lastevent_data == NULL)
-		{
-			throw sinsp_exception("cannot reserve event buffer in sinsp_parser::parse_select_poll_epollwait_enter.");
-		}
-	}
-	*(uint64_t*)evt->m_tinfo->m_lastevent_data = evt->get_ts();
-}
 void sinsp_parser::parse_fcntl_enter(sinsp_evt *evt)
 {
 	if(evt->m_tinfo == nullptr)
@@ -5237,53 +5678,6 @@ void sinsp_parser::parse_setgid_exit(sinsp_evt *evt)
 	}
 }
 
-namespace
-{
-	std::string generate_error_message(const Json::Value& value, const char* field) {
-		std::string val_as_string = value.isConvertibleTo(Json::stringValue) ? value.asString().c_str() : "value not convertible to string";
-		std::string err_msg = "Unable to convert json value '" + val_as_string + "' for the field: '" + field +"'";
-
-		return err_msg;
-	}
-
-	bool check_int64_json_is_convertible(const Json::Value& value, const char* field) {
-		if(!value.isNull())
-		{
-			// isConvertibleTo doesn't seem to work on large 64 bit numbers
-			if(value.isInt64()) {
-				return true;
-			} else {
-				std::string err_msg = generate_error_message(value, field);
-				SINSP_DEBUG("%s",err_msg.c_str());
-			}
-		}
-		return false;
-	}
-	
-	bool check_json_val_is_convertible(const Json::Value& value, Json::ValueType other, const char* field, bool log_message=false)
-	{
-		if(value.isNull()) {
-			return false;
-		}
-	
-		if(!value.isConvertibleTo(other)) {
-			std::string err_msg;
-		
-			if(log_message) {
-				err_msg = generate_error_message(value, field);
-				SINSP_WARNING("%s",err_msg.c_str());
-			} else {
-				if(g_logger.get_severity() >= sinsp_logger::SEV_DEBUG) {
-					err_msg = generate_error_message(value, field);
-					SINSP_DEBUG("%s",err_msg.c_str());
-				}
-			}			
-			return false;
-		}
-		return true;
-	}
-}
-
 void sinsp_parser::parse_container_json_evt(sinsp_evt *evt)
 {
 	ASSERT(m_inspector);
@@ -5303,249 +5697,40 @@ void sinsp_parser::parse_container_json_evt(sinsp_evt *evt)
 	sinsp_evt_param *parinfo = evt->get_param(0);
 	ASSERT(parinfo);
 	ASSERT(parinfo->m_len > 0);
-	std::string json(parinfo->m_val, parinfo->m_len);
-	SINSP_DEBUG("Parsing Container JSON=%s", json.c_str());
-	Json::Value root;
-	if(Json::Reader().parse(json, root))
-	{
-		auto container_info = std::make_shared<sinsp_container_info>();
-		const Json::Value& container = root["container"];
-		const Json::Value& id = container["id"];
-		if(check_json_val_is_convertible(id, Json::stringValue, "id"))
-		{
-			container_info->m_id = id.asString();
-		}
-		const Json::Value& full_id = container["full_id"];
-		if(check_json_val_is_convertible(full_id, Json::stringValue, "full_id"))
-		{
-			container_info->m_full_id = full_id.asString();
-		}
-		const Json::Value& type = container["type"];
-		if(check_json_val_is_convertible(type, Json::uintValue, "type"))
-		{
-			container_info->m_type = static_cast<sinsp_container_type>(type.asUInt());
-		}
-		const Json::Value& name = container["name"];
-		if(check_json_val_is_convertible(name, Json::stringValue, "name"))
-		{
-			container_info->m_name = name.asString();
-		}
-
-		const Json::Value& is_pod_sandbox = container["is_pod_sandbox"];
-		if(check_json_val_is_convertible(is_pod_sandbox, Json::booleanValue, "is_pod_sandbox"))
-		{
-			container_info->m_is_pod_sandbox = is_pod_sandbox.asBool();
-		}
-
-		const Json::Value& image = container["image"];
-		if(check_json_val_is_convertible(image, Json::stringValue, "image"))
-		{
-			container_info->m_image = image.asString();
-		}
-		const Json::Value& imageid = container["imageid"];
-		if(check_json_val_is_convertible(imageid, Json::stringValue, "imageid"))
-		{
-			container_info->m_imageid = imageid.asString();
-		}
-		const Json::Value& imagerepo = container["imagerepo"];
-		if(check_json_val_is_convertible(imagerepo, Json::stringValue, "imagerepo"))
-		{
-			container_info->m_imagerepo = imagerepo.asString();
-		}
-		const Json::Value& imagetag = container["imagetag"];
-		if(check_json_val_is_convertible(imagetag, Json::stringValue, "imagetag"))
-		{
-			container_info->m_imagetag = imagetag.asString();
-		}
-		const Json::Value& imagedigest = container["imagedigest"];
-		if(check_json_val_is_convertible(imagedigest, Json::stringValue, "imagedigest"))
-		{
-			container_info->m_imagedigest = imagedigest.asString();
-		}
-		const Json::Value& privileged = container["privileged"];
-		if(check_json_val_is_convertible(privileged, Json::booleanValue, "privileged"))
-		{
-			container_info->m_privileged = privileged.asBool();
-		}
-		const Json::Value& lookup_state = container["lookup_state"];
-		if(check_json_val_is_convertible(lookup_state, Json::uintValue, "lookup_state"))
-		{
-			container_info->set_lookup_status(static_cast<sinsp_container_lookup::state>(lookup_state.asUInt()));
-			switch(container_info->get_lookup_status())
-			{
-			case sinsp_container_lookup::state::STARTED:
-			case sinsp_container_lookup::state::SUCCESSFUL:
-			case sinsp_container_lookup::state::FAILED:
-				break;
-			default:
-				container_info->set_lookup_status(sinsp_container_lookup::state::SUCCESSFUL);
-			}
-
-			// state == STARTED doesn't make sense in a scap file
-			// as there's no actual lookup that would ever finish
-			if(!evt->m_tinfo_ref && container_info->get_lookup_status() == sinsp_container_lookup::state::STARTED)
-			{
-				SINSP_DEBUG("Rewriting lookup_state = STARTED from scap file to FAILED for container %s",
-					container_info->m_id.c_str());
-				container_info->set_lookup_status(sinsp_container_lookup::state::FAILED);
-			}
-		}
-
-		const Json::Value& created_time = container["created_time"];
-		if(check_int64_json_is_convertible(created_time, "created_time"))
-		{
-			container_info->m_created_time = created_time.asInt64();
-		}
-
-#if !defined(MINIMAL_BUILD) && !defined(_WIN32)
-		libsinsp::container_engine::docker_async_source::parse_json_mounts(container["Mounts"], container_info->m_mounts);
-#endif
-
-		const Json::Value& user = container["User"];
-		if(check_json_val_is_convertible(user, Json::stringValue, "User"))
-		{
-			container_info->m_container_user = user.asString();
-		}
-
-		sinsp_container_info::container_health_probe::parse_health_probes(container, container_info->m_health_probes);
-
-		const Json::Value& contip = container["ip"];
-		if(check_json_val_is_convertible(contip, Json::stringValue, "ip"))
-		{
-			uint32_t ip;
-
-			if(inet_pton(AF_INET, contip.asString().c_str(), &ip) == -1)
-			{
-				throw sinsp_exception("Invalid 'ip' field while parsing container info: " + json);
-			}
-
-			container_info->m_container_ip = ntohl(ip);
-		}
-
-		const Json::Value& cniresult = container["cni_json"];
-		if(check_json_val_is_convertible(cniresult, Json::stringValue, "cni_json"))
-		{
-			container_info->m_pod_cniresult = cniresult.asString();
-		}
-
-		const Json::Value &port_mappings = container["port_mappings"];
-
-		if(check_json_val_is_convertible(port_mappings, Json::arrayValue, "port_mappings"))
-		{
-			for (Json::Value::ArrayIndex i = 0; i != port_mappings.size(); i++)
-			{
-				sinsp_container_info::container_port_mapping map;
-				const Json::Value &host_ip = port_mappings[i]["HostIp"];
-				// We log message for HostIp conversion failure at Warning level
-				if(check_json_val_is_convertible(host_ip, Json::intValue, "HostIp", true)) {
-					map.m_host_ip = host_ip.asInt();
-				}
-				const Json::Value& host_port = port_mappings[i]["HostPort"];
-				// We log message for HostPort conversion failure at Warning level
-				if(check_json_val_is_convertible(host_port, Json::intValue, "HostPort", true)) {
-					map.m_host_port = (uint16_t) host_port.asInt();
-				}
-				const Json::Value& container_port = port_mappings[i]["ContainerPort"];
-				// We log message for ContainerPort conversion failure at Warning level
-				if(check_json_val_is_convertible(container_port, Json::intValue, "ContainerPort", true)) {
-					map.m_container_port = (uint16_t) container_port.asInt();
-				}
-				container_info->m_port_mappings.push_back(map);
-			}
-		}
-
-		std::vector<std::string> labels = container["labels"].getMemberNames();
-		for(std::vector<std::string>::const_iterator it = labels.begin(); it != labels.end(); ++it)
-		{
-			std::string val = container["labels"][*it].asString();
-			container_info->m_labels[*it] = val;
-		}
-
-		const Json::Value& env_vars = container["env"];
-
-		for(const auto& env_var : env_vars)
-		{
-			if(env_var.isString())
-			{
-				container_info->m_env.emplace_back(env_var.asString());
-			}
-		}
-
-		const Json::Value& memory_limit = container["memory_limit"];
-		if(check_int64_json_is_convertible(memory_limit, "memory_limit"))
-		{
-			container_info->m_memory_limit = memory_limit.asInt64();
-		}
-
-		const Json::Value& swap_limit = container["swap_limit"];
-		if(check_int64_json_is_convertible(swap_limit, "swap_limit"))
-		{
-			container_info->m_swap_limit = swap_limit.asInt64();
-		}
-
-		const Json::Value& cpu_shares = container["cpu_shares"];
-		if(check_int64_json_is_convertible(cpu_shares, "cpu_shares"))
-		{
-			container_info->m_cpu_shares = cpu_shares.asInt64();
-		}
-
-		const Json::Value& cpu_quota = container["cpu_quota"];
-		if(check_int64_json_is_convertible(cpu_quota, "cpu_quota"))
-		{
-			container_info->m_cpu_quota = cpu_quota.asInt64();
-		}
-
-		const Json::Value& cpu_period = container["cpu_period"];
-		if(check_int64_json_is_convertible(cpu_period, "cpu_period"))
-		{
-			container_info->m_cpu_period = cpu_period.asInt64();
-		}
 
-		const Json::Value& cpuset_cpu_count = container["cpuset_cpu_count"];
-		if(check_json_val_is_convertible(cpuset_cpu_count, Json::intValue, "cpuset_cpu_count"))
-		{
-			container_info->m_cpuset_cpu_count = cpuset_cpu_count.asInt();
-		}
-
-		const Json::Value& mesos_task_id = container["mesos_task_id"];
-		if(check_json_val_is_convertible(mesos_task_id, Json::stringValue, "mesos_task_id"))
-		{
-			container_info->m_mesos_task_id = mesos_task_id.asString();
-		}
+	// The JSON is read in place, without its terminator
+	const char* json = parinfo->m_val;
+	size_t len = parinfo->m_len;
+	while(len > 0 && json[len - 1] == '\0')
+	{
+		len--;
+	}
+	SINSP_DEBUG("Parsing Container JSON=%.*s", (int)len, json);
 
-		const Json::Value& metadata_deadline = container["metadata_deadline"];
-		if(!metadata_deadline.isNull())
-		{
-			// isConvertibleTo doesn't seem to work on large 64 bit numbers
-			if(metadata_deadline.isUInt64()) {
-				container_info->m_metadata_deadline = metadata_deadline.asUInt64();
-			} else {
-				SINSP_DEBUG("Unable to convert json value for field: %s", "metadata_deadline");
-			}
-		}
+	auto container_info = std::make_shared<sinsp_container_info>();
+	std::string errstr;
+	if(!sinsp_container_manager::container_from_json(json, len, *container_info, errstr))
+	{
+		throw sinsp_exception("Invalid JSON encountered while parsing container info: " + std::string(json, len) + "error=" + errstr);
+	}
 
-		if(!container_info->is_successful())
-		{
-			SINSP_DEBUG("Filtering container event for failed lookup of %s (but calling callbacks anyway)", container_info->m_id.c_str());
-			evt->m_filtered_out = true;
-		}
-		evt->m_tinfo_ref = container_info->get_tinfo(m_inspector);
-		evt->m_tinfo = evt->m_tinfo_ref.get();
-		m_inspector->m_container_manager.add_container(container_info, evt->get_thread_info(true));
-		/*
-		SINSP_STR_DEBUG("Container\n-------\nID:" + container_info.m_id +
-		                "\nType: " + std::to_string(container_info.m_type) +
-		                "\nName: " + container_info.m_name +
-		                "\nImage: " + container_info.m_image +
-		                "\nMesos Task ID: " + container_info.m_mesos_task_id);
-		*/
+	// state == STARTED doesn't make sense in a scap file
+	// as there's no actual lookup that would ever finish
+	if(!evt->m_tinfo_ref && container_info->get_lookup_status() == sinsp_container_lookup::state::STARTED)
+	{
+		SINSP_DEBUG("Rewriting lookup_state = STARTED from scap file to FAILED for container %s",
+			container_info->m_id.c_str());
+		container_info->set_lookup_status(sinsp_container_lookup::state::FAILED);
 	}
-	else
+
+	if(!container_info->is_successful())
 	{
-		std::string errstr;
-		errstr = Json::Reader().getFormattedErrorMessages();
-		throw sinsp_exception("Invalid JSON encountered while parsing container info: " + json + "error=" + errstr);
+		SINSP_DEBUG("Filtering container event for failed lookup of %s (but calling callbacks anyway)", container_info->m_id.c_str());
+		evt->m_filtered_out = true;
 	}
+	evt->m_tinfo_ref = container_info->get_tinfo(m_inspector);
+	evt->m_tinfo = evt->m_tinfo_ref.get();
+	m_inspector->m_container_manager.add_container(container_info, evt->get_thread_info(true));
 }
 
 void sinsp_parser::parse_container_evt(sinsp_evt *evt)
@@ -5637,18 +5822,9 @@ void sinsp_parser::parse_cpu_hotplug_enter(sinsp_evt *evt)
 	}
 }
 
-uint8_t* sinsp_parser::reserve_event_buffer()
+uint8_t* sinsp_parser::reserve_event_buffer(uint8_t* buf, uint32_t len)
 {
-	if(m_tmp_events_buffer.empty())
-	{
-		return (uint8_t*)malloc(sizeof(uint8_t)*SP_EVT_BUF_SIZE);
-	}
-	else
-	{
-		auto ptr = m_tmp_events_buffer.top();
-		m_tmp_events_buffer.pop();
-		return ptr;
-	}
+	return m_event_buffers.reserve(buf, len);
 }
 
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
@@ -5757,9 +5933,9 @@ void sinsp_parser::parse_chroot_exit(sinsp_evt *evt)
 		//
 		if(container_id != evt->m_tinfo->m_container_id)
 		{
-			evt->m_tinfo->set_user(evt->m_tinfo->m_user.uid);
-			evt->m_tinfo->set_loginuser(evt->m_tinfo->m_loginuser.uid);
-			evt->m_tinfo->set_group(evt->m_tinfo->m_group.gid);
+			evt->m_tinfo->set_user(evt->m_tinfo->get_user()->uid);
+			evt->m_tinfo->set_loginuser(evt->m_tinfo->get_loginuser()->uid);
+			evt->m_tinfo->set_group(evt->m_tinfo->get_group()->gid);
 		}
 	}
 }
@@ -5950,12 +6126,5 @@ void sinsp_parser::parse_unshare_setns_exit(sinsp_evt *evt)
 
 void sinsp_parser::free_event_buffer(uint8_t *ptr)
 {
-	if(m_tmp_events_buffer.size() < m_inspector->m_thread_manager->m_threadtable.size())
-	{
-		m_tmp_events_buffer.push(ptr);
-	}
-	else
-	{
-		free(ptr);
-	}
+	m_event_buffers.release(ptr, m_inspector->m_thread_manager->m_threadtable.size());
 }
@@ -20,6 +20,8 @@ limitations under the License.
 ////////////////////////////////////////////////////////////////////////////
 #pragma once
 #include "sinsp.h"
+#include "event_buffer_pool.h"
+#include "protodetect.h"
 
 class sinsp_fd_listener;
 
@@ -47,6 +49,16 @@ public:
 
 	void erase_fd(erase_fd_params* params);
 
+	//
+	// Start loading the thread and fd info of an event that will be
+	// processed later (see sinsp::set_prefetch_distance)
+	//
+	void prefetch(const scap_evt* pevt);
+
+	// Add the fd of tinfo to the connection table, or remove it, if the
+	// table is enabled and the fd is an IPv4/IPv6 socket
+	void update_connection_table(sinsp_threadinfo* tinfo, int64_t fd, sinsp_fdinfo_t* fdinfo, bool add);
+
 	//
 	// Get the enter event matching the last received event
 	//
@@ -62,6 +74,7 @@ public:
 	//
 	sinsp_protodecoder* add_protodecoder(std::string decoder_name);
 	void register_event_callback(sinsp_pd_callback_type etype, sinsp_protodecoder* dec);
+	void register_protocol_callback(sinsp_l7_proto proto, sinsp_pd_callback_type etype, sinsp_protodecoder* dec);
 
 	void schedule_k8s_events();
 	void schedule_mesos_events();
@@ -72,13 +85,90 @@ public:
 	std::vector<sinsp_protodecoder*> m_open_callbacks;
 	std::vector<sinsp_protodecoder*> m_connect_callbacks;
 
+	//
+	// Protocol decoders called for the buffers of the FDs of a protocol.
+	// The sockets are classified only while there is one
+	//
+	sinsp_protodetector m_protodetector;
+	std::vector<sinsp_protodecoder*> m_l7_read_callbacks[L7_PROTO_MAX];
+	std::vector<sinsp_protodecoder*> m_l7_write_callbacks[L7_PROTO_MAX];
+	bool m_l7_classify = false;
+
 	//
 	// Initializers
 	//
 	static void init_scapevt(metaevents_state& evt_state, uint16_t evt_type, uint16_t buf_size);
 
 	void set_track_connection_status(bool enabled);
+
+	//
+	// Count the events and the bytes read and written by every thread
+	// (see sinsp_threadinfo::workload_counters)
+	//
+	void set_track_workload(bool enabled);
+
+	//
+	// Number of events of a type that went through process_event, and
+	// how many of them were dispatched to the parsers, the others having
+	// been dropped before by the filter or as events of the inspector
+	//
+	struct parse_counters
+	{
+		uint64_t m_num_events;
+		uint64_t m_num_parsed;
+	};
+
+	inline const parse_counters& get_parse_counters(uint16_t etype) const
+	{
+		return m_parse_counters[etype];
+	}
+
+	//
+	// Return the counters of the event types that have been seen as a
+	// buffer of scap_stats_v2 metrics named `parser.<event name>_<code>.events`
+	// and `.parsed`. The buffer is owned by the parser and valid until the
+	// next call.
+	//
+	const scap_stats_v2* get_parse_stats(uint32_t* nstats);
 private:
+	//
+	// What process_event has to do before handing an event to its
+	// parser, precomputed for every event type from the event table
+	//
+	enum parse_step
+	{
+		// EF_SKIPPARSERESET: no thread lookup and no state reset
+		PARSE_SKIP_RESET = (1 << 0),
+		// the event has no thread (container, user and group events)
+		PARSE_NO_THREAD = (1 << 1),
+		// the thread lookup must not fall back to /proc
+		PARSE_NO_QUERY_OS = (1 << 2),
+		// clone and fork exits, whose thread may not exist yet
+		PARSE_CLONE_EXIT = (1 << 3),
+		// only the thread is needed (PPME_SCHEDSWITCH_6_E)
+		PARSE_THREAD_ONLY = (1 << 4),
+		// EF_USES_FD: look the fd up
+		PARSE_USES_FD = (1 << 5),
+		// exit event whose first parameter is a return value
+		PARSE_ERRORCODE = (1 << 6),
+		// not filtered out when generated by the inspector itself
+		PARSE_KEEP_SELF = (1 << 7),
+		// EF_READS_FROM_FD exit event, whose return value is a byte count
+		PARSE_READ_BYTES = (1 << 8),
+		// same, for EF_WRITES_TO_FD
+		PARSE_WRITE_BYTES = (1 << 9),
+	};
+
+	struct parse_descriptor
+	{
+		uint16_t m_steps;
+		// index of the fd parameter of the exit events, -1 if they
+		// don't have one
+		int8_t m_exit_fd_param;
+	};
+
+	void init_parse_table();
+
 	//
 	// Initializers
 	//
@@ -93,6 +183,7 @@ private:
 	//
 	// Parsers
 	//
+	void resolve_interned_strings(sinsp_evt* evt, sinsp_threadinfo* tinfo);
 	void parse_clone_exit(sinsp_evt* evt);
 	void parse_execve_enter(sinsp_evt* evt);
 	void parse_execve_exit(sinsp_evt* evt);
@@ -109,6 +200,7 @@ private:
 	void parse_thread_exit(sinsp_evt* evt);
 	inline bool detect_and_process_tracer_write(sinsp_evt *evt, int64_t retval, ppm_event_flags eflags);
 	inline void parse_rw_exit(sinsp_evt* evt);
+	inline void process_l7_buffer(sinsp_evt* evt, char* data, uint32_t datalen, bool is_read);
 	void parse_sendfile_exit(sinsp_evt* evt);
 	void parse_eventfd_exit(sinsp_evt* evt);
 	void parse_bind_exit(sinsp_evt* evt);
@@ -120,7 +212,6 @@ private:
 	void parse_single_param_fd_exit(sinsp_evt* evt, scap_fd_type type);
 	void parse_getrlimit_setrlimit_exit(sinsp_evt* evt);
 	void parse_prlimit_exit(sinsp_evt* evt);
-	void parse_select_poll_epollwait_enter(sinsp_evt *evt);
 	void parse_fcntl_enter(sinsp_evt* evt);
 	void parse_fcntl_exit(sinsp_evt* evt);
 	void parse_context_switch(sinsp_evt* evt);
@@ -162,7 +253,7 @@ private:
 	bool set_unix_info(sinsp_fdinfo_t* fdinfo, uint8_t* packed_data);
 
 	void swap_addresses(sinsp_fdinfo_t* fdinfo);
-	uint8_t* reserve_event_buffer();
+	uint8_t* reserve_event_buffer(uint8_t* buf, uint32_t len);
 	void free_event_buffer(uint8_t*);
 
 	//
@@ -177,8 +268,16 @@ private:
 	uint8_t m_fake_userevt_storage[4096];
 	scap_evt* m_fake_userevt;
 	std::string m_tracer_error_string;
+	// directory of the file being opened, reused across the open events
+	std::string m_tmp_dir;
+	// values of the interned params of the last clone/execve event, see
+	// resolve_interned_strings()
+	std::string m_interned_exe;
+	std::string m_interned_comm;
+	std::string m_interned_cgroups;
 
 	bool m_track_connection_status = false;
+	bool m_track_workload = false;
 
 	// FD listener callback
 	sinsp_fd_listener* m_fd_listener;
@@ -192,7 +291,12 @@ private:
 	int              m_k8s_capture_version = -1;
 	metaevents_state m_mesos_metaevents_state;
 
-	std::stack<uint8_t*> m_tmp_events_buffer;
+	// the buffers of the stored enter events
+	event_buffer_pool m_event_buffers;
+
+	parse_descriptor m_parse_table[PPM_EVENT_MAX];
+	parse_counters m_parse_counters[PPM_EVENT_MAX];
+	std::vector<scap_stats_v2> m_parse_stats;
 
 	// caches the index of the "syscall" event source
 	size_t m_syscall_event_source_idx;
@@ -24,6 +24,7 @@ limitations under the License.
 #include <set>
 #include <sstream>
 #include <numeric>
+#include <unordered_map>
 #include <json/json.h>
 #include <valijson/adapters/jsoncpp_adapter.hpp>
 #include <valijson/schema.hpp>
@@ -42,6 +43,27 @@ static constexpr const char* s_not_init_err = "plugin capability used before ini
 
 static constexpr const char* s_init_twice_err = "plugin has been initialized twice";
 
+// Fields and init schemas parsed so far, shared by the plugins loaded
+// again, see parse_cache_key()
+static std::mutex s_parse_cache_mtx;
+static std::unordered_map<std::string, std::shared_ptr<const sinsp_plugin_fields>> s_fields_cache;
+static std::unordered_map<std::string, std::shared_ptr<const valijson::Schema>> s_schema_cache;
+
+// The JSON returned by the plugin is identified by its hash, along with the
+// name and version of the plugin. Hashing is much cheaper than parsing.
+static std::string parse_cache_key(const std::string& name, const sinsp_version& version, const char* json)
+{
+	// 64-bit FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	size_t len = 0;
+	for (const char* c = json; *c != '\0'; c++, len++)
+	{
+		hash ^= (uint8_t) *c;
+		hash *= 1099511628211ULL;
+	}
+	return name + "@" + version.as_string() + "#" + std::to_string(hash) + "/" + std::to_string(len);
+}
+
 // Used below--set a std::string from the provided allocated charbuf
 static std::string str_from_alloc_charbuf(const char* charbuf)
 {
@@ -175,6 +197,8 @@ bool sinsp_plugin::init(const std::string &config, std::string &errstr)
 
 void sinsp_plugin::destroy()
 {
+	// the workers may still be extracting fields
+	m_async_extractor.reset();
 	m_inited = false;
 	if(m_state && m_handle->api.destroy)
 	{
@@ -368,6 +392,10 @@ bool sinsp_plugin::resolve_dylib_symbols(std::string &errstr)
 		return false;
 	}
 
+	// the version was already checked to be compatible with the framework
+	m_required_api_version = sinsp_version(
+		str_from_alloc_charbuf(m_handle->api.get_required_api_version()));
+
 	// read capabilities and process their info
 	m_caps = plugin_get_capabilities(m_handle);
 
@@ -395,96 +423,7 @@ bool sinsp_plugin::resolve_dylib_symbols(std::string &errstr)
 			throw sinsp_exception(
 					string("error in plugin ") + name() + ": get_fields returned a null string");
 		}
-		string json(sfields);
-		SINSP_DEBUG("Parsing Fields JSON=%s", json.c_str());
-		Json::Value root;
-		if (Json::Reader().parse(json, root) == false || root.type() != Json::arrayValue) {
-			throw sinsp_exception(
-					string("error in plugin ") + name() + ": get_fields returned an invalid JSON");
-		}
-
-		m_fields.clear();
-		for (Json::Value::ArrayIndex j = 0; j < root.size(); j++) {
-			filtercheck_field_info tf;
-			tf.m_flags = EPF_NONE;
-
-			const Json::Value &jvtype = root[j]["type"];
-			string ftype = jvtype.asString();
-			if (ftype == "") {
-				throw sinsp_exception(
-						string("error in plugin ") + name() + ": field JSON entry has no type");
-			}
-			const Json::Value &jvname = root[j]["name"];
-			string fname = jvname.asString();
-			if (fname == "") {
-				throw sinsp_exception(
-						string("error in plugin ") + name() + ": field JSON entry has no name");
-			}
-			const Json::Value &jvdisplay = root[j]["display"];
-			string fdisplay = jvdisplay.asString();
-			const Json::Value &jvdesc = root[j]["desc"];
-			string fdesc = jvdesc.asString();
-			if (fdesc == "") {
-				throw sinsp_exception(
-						string("error in plugin ") + name() + ": field JSON entry has no desc");
-			}
-
-			strlcpy(tf.m_name, fname.c_str(), sizeof(tf.m_name));
-			strlcpy(tf.m_display, fdisplay.c_str(), sizeof(tf.m_display));
-			strlcpy(tf.m_description, fdesc.c_str(), sizeof(tf.m_description));
-			tf.m_print_format = PF_DEC;
-			if(m_pt_lut.find(ftype) != m_pt_lut.end()) {
-				tf.m_type = m_pt_lut.at(ftype);
-			} else {
-				throw sinsp_exception(
-						string("error in plugin ") + name() + ": invalid field type " + ftype);
-			}
-
-			const Json::Value &jvIsList = root[j].get("isList", Json::Value::null);
-			if (!jvIsList.isNull()) {
-				if (!jvIsList.isBool()) {
-					throw sinsp_exception(string("error in plugin ") + name() + ": field " + fname +
-					                      " isList property is not boolean ");
-				}
-
-				if (jvIsList.asBool()) {
-					tf.m_flags = (filtercheck_field_flags) ((int) tf.m_flags |
-					                                        (int) filtercheck_field_flags::EPF_IS_LIST);
-				}
-			}
-
-			resolve_dylib_field_arg(root[j].get("arg", Json::Value::null), tf);
-
-			const Json::Value &jvProperties = root[j].get("properties", Json::Value::null);
-			if (!jvProperties.isNull()) {
-				if (!jvProperties.isArray()) {
-					throw sinsp_exception(string("error in plugin ") + name() + ": field " + fname +
-					                      " properties property is not array ");
-				}
-
-				for (const auto & prop : jvProperties) {
-						if (!prop.isString()) {
-						throw sinsp_exception(string("error in plugin ") + name() + ": field " + fname +
-						                      " properties value is not string ");
-					}
-
-					const std::string &str = prop.asString();
-
-					// "hidden" is used inside and outside libs. "info" and "conversation" are used outside libs.
-					if (str == "hidden") {
-						tf.m_flags = (filtercheck_field_flags) ((int) tf.m_flags |
-						                                        (int) filtercheck_field_flags::EPF_TABLE_ONLY);
-					} else if (str == "info") {
-						tf.m_flags = (filtercheck_field_flags) ((int) tf.m_flags |
-						                                        (int) filtercheck_field_flags::EPF_INFO);
-					} else if (str == "conversation") {
-						tf.m_flags = (filtercheck_field_flags) ((int) tf.m_flags |
-						                                        (int) filtercheck_field_flags::EPF_CONVERSATION);
-					}
-				}
-			}
-			m_fields.push_back(tf);
-		}
+		m_fields = cached_fields(sfields);
 
 		resolve_dylib_sources_codes(
 			"get_extract_event_sources",
@@ -492,6 +431,11 @@ bool sinsp_plugin::resolve_dylib_symbols(std::string &errstr)
 			m_handle->api.get_extract_event_types,
 			m_extract_event_sources,
 			m_extract_event_codes);
+
+		// the batched extraction is only part of the vtable of plugins
+		// built against the plugin API 3.1.0 or later
+		m_extract_fields_batch = m_required_api_version.m_version_minor >= 1
+			&& m_handle->api.extract_fields_batch != NULL;
 	}
 
 	if(m_caps & CAP_PARSING)
@@ -507,6 +451,122 @@ bool sinsp_plugin::resolve_dylib_symbols(std::string &errstr)
 	return true;
 }
 
+std::shared_ptr<const sinsp_plugin_fields> sinsp_plugin::cached_fields(const char* sfields)
+{
+	std::string key = parse_cache_key(m_name, m_plugin_version, sfields);
+	{
+		std::lock_guard<std::mutex> lock(s_parse_cache_mtx);
+		auto it = s_fields_cache.find(key);
+		if (it != s_fields_cache.end())
+		{
+			return it->second;
+		}
+	}
+
+	auto res = parse_fields(sfields);
+	std::lock_guard<std::mutex> lock(s_parse_cache_mtx);
+	return s_fields_cache.emplace(key, res).first->second;
+}
+
+std::shared_ptr<const sinsp_plugin_fields> sinsp_plugin::parse_fields(const std::string& json)
+{
+	SINSP_DEBUG("Parsing Fields JSON=%s", json.c_str());
+	Json::Value root;
+	if (Json::Reader().parse(json, root) == false || root.type() != Json::arrayValue) {
+		throw sinsp_exception(
+				string("error in plugin ") + name() + ": get_fields returned an invalid JSON");
+	}
+
+	auto res = std::make_shared<sinsp_plugin_fields>();
+	for (Json::Value::ArrayIndex j = 0; j < root.size(); j++) {
+		filtercheck_field_info tf;
+		tf.m_flags = EPF_NONE;
+
+		const Json::Value &jvtype = root[j]["type"];
+		string ftype = jvtype.asString();
+		if (ftype == "") {
+			throw sinsp_exception(
+					string("error in plugin ") + name() + ": field JSON entry has no type");
+		}
+		const Json::Value &jvname = root[j]["name"];
+		string fname = jvname.asString();
+		if (fname == "") {
+			throw sinsp_exception(
+					string("error in plugin ") + name() + ": field JSON entry has no name");
+		}
+		const Json::Value &jvdisplay = root[j]["display"];
+		string fdisplay = jvdisplay.asString();
+		const Json::Value &jvdesc = root[j]["desc"];
+		string fdesc = jvdesc.asString();
+		if (fdesc == "") {
+			throw sinsp_exception(
+					string("error in plugin ") + name() + ": field JSON entry has no desc");
+		}
+
+		strlcpy(tf.m_name, fname.c_str(), sizeof(tf.m_name));
+		strlcpy(tf.m_display, fdisplay.c_str(), sizeof(tf.m_display));
+		strlcpy(tf.m_description, fdesc.c_str(), sizeof(tf.m_description));
+		tf.m_print_format = PF_DEC;
+		if(m_pt_lut.find(ftype) != m_pt_lut.end()) {
+			tf.m_type = m_pt_lut.at(ftype);
+		} else {
+			throw sinsp_exception(
+					string("error in plugin ") + name() + ": invalid field type " + ftype);
+		}
+
+		const Json::Value &jvIsList = root[j].get("isList", Json::Value::null);
+		if (!jvIsList.isNull()) {
+			if (!jvIsList.isBool()) {
+				throw sinsp_exception(string("error in plugin ") + name() + ": field " + fname +
+				                      " isList property is not boolean ");
+			}
+
+			if (jvIsList.asBool()) {
+				tf.m_flags = (filtercheck_field_flags) ((int) tf.m_flags |
+				                                        (int) filtercheck_field_flags::EPF_IS_LIST);
+			}
+		}
+
+		resolve_dylib_field_arg(root[j].get("arg", Json::Value::null), tf);
+
+		const Json::Value &jvProperties = root[j].get("properties", Json::Value::null);
+		if (!jvProperties.isNull()) {
+			if (!jvProperties.isArray()) {
+				throw sinsp_exception(string("error in plugin ") + name() + ": field " + fname +
+				                      " properties property is not array ");
+			}
+
+			for (const auto & prop : jvProperties) {
+					if (!prop.isString()) {
+					throw sinsp_exception(string("error in plugin ") + name() + ": field " + fname +
+					                      " properties value is not string ");
+				}
+
+				const std::string &str = prop.asString();
+
+				// "hidden" is used inside and outside libs. "info" and "conversation" are used outside libs.
+				if (str == "hidden") {
+					tf.m_flags = (filtercheck_field_flags) ((int) tf.m_flags |
+					                                        (int) filtercheck_field_flags::EPF_TABLE_ONLY);
+				} else if (str == "info") {
+					tf.m_flags = (filtercheck_field_flags) ((int) tf.m_flags |
+					                                        (int) filtercheck_field_flags::EPF_INFO);
+				} else if (str == "conversation") {
+					tf.m_flags = (filtercheck_field_flags) ((int) tf.m_flags |
+					                                        (int) filtercheck_field_flags::EPF_CONVERSATION);
+				} else if (str == "async") {
+					// the plugin tolerates extracting this field
+					// concurrently from several threads
+					tf.m_flags = (filtercheck_field_flags) ((int) tf.m_flags |
+					                                        (int) filtercheck_field_flags::EPF_ASYNC);
+				}
+			}
+		}
+		res->add(tf);
+	}
+	return res;
+}
+
 std::string sinsp_plugin::get_init_schema(ss_plugin_schema_type& schema_type) const
 {
 	schema_type = SS_PLUGIN_SCHEMA_NONE;
@@ -539,8 +599,18 @@ void sinsp_plugin::validate_init_config(std::string& config)
 	}
 }
 
-void sinsp_plugin::validate_init_config_json_schema(std::string& config, std::string &schema)
+std::shared_ptr<const valijson::Schema> sinsp_plugin::cached_json_schema(const std::string& schema)
 {
+	std::string key = parse_cache_key(m_name, m_plugin_version, schema.c_str());
+	{
+		std::lock_guard<std::mutex> lock(s_parse_cache_mtx);
+		auto it = s_schema_cache.find(key);
+		if (it != s_schema_cache.end())
+		{
+			return it->second;
+		}
+	}
+
 	Json::Value schemaJson;
 	if(!Json::Reader().parse(schema, schemaJson) || schemaJson.type() != Json::objectValue)
 	{
@@ -550,6 +620,19 @@ void sinsp_plugin::validate_init_config_json_schema(std::string& config, std::st
 			+ ": get_init_schema did not return a json object");
 	}
 
+	auto res = std::make_shared<valijson::Schema>();
+	valijson::SchemaParser schemaParser;
+	valijson::adapters::JsonCppAdapter schemaAdapter(schemaJson);
+	schemaParser.populateSchema(schemaAdapter, *res);
+
+	std::lock_guard<std::mutex> lock(s_parse_cache_mtx);
+	return s_schema_cache.emplace(key, res).first->second;
+}
+
+void sinsp_plugin::validate_init_config_json_schema(std::string& config, std::string &schema)
+{
+	auto schemaDef = cached_json_schema(schema);
+
 	// stub empty configs to an empty json object
 	if (config.size() == 0)
 	{
@@ -565,14 +648,10 @@ void sinsp_plugin::validate_init_config_json_schema(std::string& config, std::st
 	}
 
 	// validate config with json schema
-	valijson::Schema schemaDef;
-	valijson::SchemaParser schemaParser;
 	valijson::Validator validator;
 	valijson::ValidationResults validationResults;
 	valijson::adapters::JsonCppAdapter configAdapter(configJson);
-	valijson::adapters::JsonCppAdapter schemaAdapter(schemaJson);
-	schemaParser.populateSchema(schemaAdapter, schemaDef);
-	if (!validator.validate(schemaDef, configAdapter, &validationResults))
+	if (!validator.validate(*schemaDef, configAdapter, &validationResults))
 	{
 		valijson::ValidationResults::Error error;
 		// report only the top-most error
@@ -755,6 +834,102 @@ bool sinsp_plugin::extract_fields(sinsp_evt* evt, uint32_t num_fields, ss_plugin
 	return m_handle->api.extract_fields(m_state, &ev, &in) == SS_PLUGIN_SUCCESS;
 }
 
+bool sinsp_plugin::extract_fields_batch(uint32_t num_evts, sinsp_evt** evts, uint32_t num_fields, ss_plugin_extract_field *fields) const
+{
+	if (!m_inited)
+	{
+		throw sinsp_exception(std::string(s_not_init_err) + ": " + m_name);
+	}
+
+	if (!m_extract_fields_batch)
+	{
+		throw sinsp_exception("plugin does not support batched field extraction: " + m_name);
+	}
+
+	m_batch_evts.resize(num_evts);
+	for (uint32_t i = 0; i < num_evts; i++)
+	{
+		auto& ev = m_batch_evts[i];
+		ev.evt = (const ss_plugin_event*) evts[i]->m_pevt;
+		ev.evtnum = evts[i]->get_num();
+		ev.evtsrc_idx = evts[i]->get_source_idx();
+		ev.evtsrc_name = evts[i]->get_source_name();
+	}
+
+	ss_plugin_field_extract_input in;
+	in.num_fields = num_fields;
+	in.fields = fields;
+	in.owner = (ss_plugin_owner_t *) this;
+	in.get_owner_last_error = sinsp_plugin::get_owner_last_error;
+	sinsp_plugin::table_read_api(in.table_reader);
+	return m_handle->api.extract_fields_batch(m_state, num_evts, m_batch_evts.data(), &in) == SS_PLUGIN_SUCCESS;
+}
+
+void sinsp_plugin_fields::add(const filtercheck_field_info& info)
+{
+	field f;
+	f.m_type = info.m_type;
+	f.m_flags = info.m_flags;
+	f.m_name = add_str(info.m_name);
+	f.m_display = add_str(info.m_display);
+	f.m_desc = add_str(info.m_description);
+	m_fields.push_back(f);
+}
+
+uint32_t sinsp_plugin_fields::add_str(const char* s)
+{
+	uint32_t off = m_strings.size();
+	m_strings.append(s);
+	m_strings.push_back('\0');
+	return off;
+}
+
+const std::vector<filtercheck_field_info>& sinsp_plugin_fields::infos() const
+{
+	std::call_once(m_infos_once, [this]()
+	{
+		m_infos.resize(m_fields.size());
+		for (size_t i = 0; i < m_fields.size(); i++)
+		{
+			auto& info = m_infos[i];
+			info.m_type = m_fields[i].m_type;
+			info.m_flags = m_fields[i].m_flags;
+			info.m_print_format = PF_DEC;
+			strlcpy(info.m_name, str(m_fields[i].m_name), sizeof(info.m_name));
+			strlcpy(info.m_display, str(m_fields[i].m_display), sizeof(info.m_display));
+			strlcpy(info.m_description, str(m_fields[i].m_desc), sizeof(info.m_description));
+		}
+	});
+	return m_infos;
+}
+
+const std::vector<filtercheck_field_info>& sinsp_plugin::fields() const
+{
+	static const std::vector<filtercheck_field_info> s_no_fields;
+	return m_fields != nullptr ? m_fields->infos() : s_no_fields;
+}
+
+bool sinsp_plugin::has_async_fields() const
+{
+	for (size_t i = 0; m_fields != nullptr && i < m_fields->size(); i++)
+	{
+		if (m_fields->at(i).m_flags & EPF_ASYNC)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void sinsp_plugin::set_async_extraction(uint32_t num_workers, uint64_t max_wait_ns)
+{
+	m_async_extractor.reset();
+	if (num_workers > 0 && has_async_fields())
+	{
+		m_async_extractor = std::make_shared<sinsp_plugin_async_extractor>(this, num_workers, max_wait_ns);
+	}
+}
+
 /** End of Field Extraction CAP **/
 
 /** Event Parsing CAP **/
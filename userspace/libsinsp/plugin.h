@@ -18,6 +18,7 @@ limitations under the License.
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include <unordered_set>
 #include <string>
 #include <vector>
@@ -30,6 +31,54 @@ limitations under the License.
 
 // todo(jasondellaluce: remove this forward declaration)
 class sinsp_filter_check;
+class sinsp_plugin_async_extractor;
+namespace valijson { class Schema; }
+
+/**
+ * @brief The fields exported by a plugin, in a compact form. They are parsed
+ * from get_fields() once per process for each plugin name, version and
+ * fields JSON, and shared by all the plugins loaded with them. The
+ * filtercheck_field_info list is only built when first needed.
+ */
+class sinsp_plugin_fields
+{
+public:
+	struct field
+	{
+		ppm_param_type m_type;
+		uint32_t m_flags;
+		uint32_t m_name;    ///< Offset of the name in the strings pool.
+		uint32_t m_display; ///< Offset of the display name in the strings pool.
+		uint32_t m_desc;    ///< Offset of the description in the strings pool.
+	};
+
+	inline size_t size() const
+	{
+		return m_fields.size();
+	}
+
+	inline const field& at(size_t i) const
+	{
+		return m_fields[i];
+	}
+
+	inline const char* str(uint32_t off) const
+	{
+		return m_strings.data() + off;
+	}
+
+	void add(const filtercheck_field_info& info);
+
+	const std::vector<filtercheck_field_info>& infos() const;
+
+private:
+	uint32_t add_str(const char* s);
+
+	std::vector<field> m_fields;
+	std::string m_strings; // NUL separated
+	mutable std::once_flag m_infos_once;
+	mutable std::vector<filtercheck_field_info> m_infos;
+};
 
 /**
  * @brief An object-oriented representation of a plugin.
@@ -110,12 +159,16 @@ public:
 		m_fields(),
 		m_extract_event_sources(),
 		m_extract_event_codes(),
+		m_extract_fields_batch(false),
+		m_batch_evts(),
+		m_async_extractor(),
 		m_parse_event_sources(),
 		m_parse_event_codes(),
 		m_table_registry(treg),
 		m_table_infos(),
 		m_owned_tables(),
-		m_accessed_tables() { }
+		m_accessed_tables(),
+		m_written_tables() { }
 	virtual ~sinsp_plugin();
 	sinsp_plugin(sinsp_plugin&&) = default;
 	sinsp_plugin& operator = (sinsp_plugin&&) = default;
@@ -185,12 +238,50 @@ public:
 		return m_extract_event_codes;
 	}
 
-	inline const std::vector<filtercheck_field_info>& fields() const
+	const std::vector<filtercheck_field_info>& fields() const;
+
+	bool extract_fields(sinsp_evt* evt, uint32_t num_fields, ss_plugin_extract_field *fields) const;
+
+	/**
+	 * @brief Returns true if the plugin can extract fields from a batch of
+	 * events with a single call, see extract_fields_batch().
+	 */
+	inline bool has_extract_fields_batch() const
 	{
-		return m_fields;
+		return m_extract_fields_batch;
 	}
 
-	bool extract_fields(sinsp_evt* evt, uint32_t num_fields, ss_plugin_extract_field *fields) const;
+	/**
+	 * @brief Extracts fields from num_evts events with a single call into
+	 * the plugin. The fields array contains num_evts * num_fields entries,
+	 * the ones of evts[i] starting at fields[i * num_fields]. The extracted
+	 * values remain valid until the next extraction. Must be used only if
+	 * has_extract_fields_batch() is true.
+	 */
+	bool extract_fields_batch(uint32_t num_evts, sinsp_evt** evts, uint32_t num_fields, ss_plugin_extract_field *fields) const;
+
+	/**
+	 * @brief Returns true if some of the fields are declared with the
+	 * "async" property, see set_async_extraction().
+	 */
+	bool has_async_fields() const;
+
+	/**
+	 * @brief Extracts the async fields on num_workers threads ahead of the
+	 * filter evaluation, waiting at most max_wait_ns for the values of an
+	 * event (see sinsp_plugin_async_extractor). 0 workers disables it, as
+	 * well as a plugin without async fields.
+	 */
+	void set_async_extraction(uint32_t num_workers, uint64_t max_wait_ns);
+
+	/**
+	 * @brief Returns the extractor of the async fields, or nullptr if
+	 * their async extraction is disabled.
+	 */
+	inline sinsp_plugin_async_extractor* async_extractor() const
+	{
+		return m_async_extractor.get();
+	}
 
 	/** Event Parsing **/
 	inline const std::unordered_set<std::string>& parse_event_sources() const
@@ -205,6 +296,16 @@ public:
 
 	bool parse_event(sinsp_evt* evt) const;
 
+	/**
+	 * @brief Returns the names of the state tables that the plugin can
+	 * write while parsing events: the ones it added and the ones it
+	 * accessed during its initialization.
+	 */
+	inline const std::unordered_set<std::string>& written_tables() const
+	{
+		return m_written_tables;
+	}
+
 // note(jasondellaluce): we set these as protected in order to allow unit
 // testing mocking these values, without having to declare their accessors
 // as virtual (thus avoiding performance loss in some hot paths).
@@ -246,9 +347,12 @@ private:
 	scap_source_plugin m_scap_source_plugin;
 
 	/** Field Extraction **/
-	std::vector<filtercheck_field_info> m_fields;
+	std::shared_ptr<const sinsp_plugin_fields> m_fields;
 	std::unordered_set<std::string> m_extract_event_sources;
 	libsinsp::events::set<ppm_event_code> m_extract_event_codes;
+	bool m_extract_fields_batch;
+	mutable std::vector<ss_plugin_event_input> m_batch_evts;
+	std::shared_ptr<sinsp_plugin_async_extractor> m_async_extractor;
 
 	/** Event Parsing **/
 	struct table_input_deleter { void operator()(ss_plugin_table_input* r); };
@@ -260,6 +364,7 @@ private:
 	std::vector<ss_plugin_table_info> m_table_infos;
 	std::unordered_map<std::string, owned_table_t> m_owned_tables;
 	std::unordered_map<std::string, accessed_table_t> m_accessed_tables;
+	std::unordered_set<std::string> m_written_tables;
 
 	/** Generic helpers **/
 	void validate_init_config(std::string& config);
@@ -272,6 +377,9 @@ private:
 		std::unordered_set<std::string>& sources,
 		libsinsp::events::set<ppm_event_code>& codes);
 	void validate_init_config_json_schema(std::string& config, std::string& schema);
+	std::shared_ptr<const valijson::Schema> cached_json_schema(const std::string& schema);
+	std::shared_ptr<const sinsp_plugin_fields> cached_fields(const char* sfields);
+	std::shared_ptr<const sinsp_plugin_fields> parse_fields(const std::string& json);
 	static const char* get_owner_last_error(ss_plugin_owner_t* o);
 
 	/** Event parsing helpers **/
@@ -15,6 +15,9 @@ limitations under the License.
 
 */
 
+#include <atomic>
+#include <chrono>
+
 using namespace std;
 
 #include "plugin_filtercheck.h"
@@ -27,6 +30,8 @@ sinsp_filter_check_plugin::sinsp_filter_check_plugin()
 	m_info.m_nfields = 0;
 	m_info.m_flags = filter_check_info::FL_NONE;
 	m_eplugin = nullptr;
+	m_async_id = 0;
+	m_async_field = 0;
 }
 
 sinsp_filter_check_plugin::sinsp_filter_check_plugin(std::shared_ptr<sinsp_plugin> plugin)
@@ -41,6 +46,8 @@ sinsp_filter_check_plugin::sinsp_filter_check_plugin(std::shared_ptr<sinsp_plugi
 	m_info.m_fields = &m_eplugin->fields()[0]; // we use a vector so this should be safe
 	m_info.m_nfields = m_eplugin->fields().size();
 	m_info.m_flags = filter_check_info::FL_NONE;
+	m_async_id = 0;
+	m_async_field = 0;
 }
 
 sinsp_filter_check_plugin::sinsp_filter_check_plugin(const sinsp_filter_check_plugin &p)
@@ -48,6 +55,8 @@ sinsp_filter_check_plugin::sinsp_filter_check_plugin(const sinsp_filter_check_pl
 	m_eplugin = p.m_eplugin;
 	m_info = p.m_info;
 	m_compatible_plugin_sources_bitmap = p.m_compatible_plugin_sources_bitmap;
+	m_async_id = 0;
+	m_async_field = 0;
 }
 
 int32_t sinsp_filter_check_plugin::parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering)
@@ -118,7 +127,13 @@ sinsp_filter_check* sinsp_filter_check_plugin::allocate_new()
 	return new sinsp_filter_check_plugin(*this);
 }
 
-bool sinsp_filter_check_plugin::extract(sinsp_evt *evt, OUT vector<extract_value_t>& values, bool sanitize_strings)
+double sinsp_filter_check_plugin::get_extraction_cost()
+{
+	// each extraction is a call into the plugin
+	return 8;
+}
+
+bool sinsp_filter_check_plugin::is_event_compatible(sinsp_evt* evt)
 {
 	// reject the event if it comes from an unknown event source
 	if (evt->get_source_idx() == sinsp_no_event_source_idx)
@@ -144,27 +159,24 @@ bool sinsp_filter_check_plugin::extract(sinsp_evt *evt, OUT vector<extract_value
 	}
 
 	// reject the event if its event source is not compatible with the plugin
-	if (!m_compatible_plugin_sources_bitmap[evt->get_source_idx()])
-	{
-		return false;
-	}
+	return m_compatible_plugin_sources_bitmap[evt->get_source_idx()];
+}
 
-	auto type = m_info.m_fields[m_field_id].m_type;
-	uint32_t num_fields = 1;
-	ss_plugin_extract_field efield;
+void sinsp_filter_check_plugin::fill_extract_field(ss_plugin_extract_field& efield) const
+{
 	efield.field_id = m_field_id;
 	efield.field = m_info.m_fields[m_field_id].m_name;
 	efield.arg_key = m_arg_key;
 	efield.arg_index = m_arg_index;
 	efield.arg_present = m_arg_present;
-	efield.ftype = type;
+	efield.ftype = m_info.m_fields[m_field_id].m_type;
 	efield.flist = m_info.m_fields[m_field_id].m_flags & EPF_IS_LIST;
-	if (!m_eplugin->extract_fields(evt, num_fields, &efield) || efield.res_len == 0)
-	{
-		return false;
-	}
+}
 
-	values.clear();
+// converts the values extracted by the plugin
+static void append_values(const ss_plugin_extract_field& efield, std::vector<extract_value_t>& values)
+{
+	auto type = efield.ftype;
 	for (uint32_t i = 0; i < efield.res_len; ++i)
 	{
 		extract_value_t res;
@@ -208,10 +220,117 @@ bool sinsp_filter_check_plugin::extract(sinsp_evt *evt, OUT vector<extract_value
 		}
 		values.push_back(res);
 	}
+}
+
+bool sinsp_filter_check_plugin::extract(sinsp_evt *evt, OUT vector<extract_value_t>& values, bool sanitize_strings)
+{
+	if (!is_event_compatible(evt))
+	{
+		return false;
+	}
 
+	ss_plugin_extract_field efield;
+	fill_extract_field(efield);
+
+	// take the value resolved ahead of time, if the event was prefetched
+	auto async = m_eplugin->async_extractor();
+	if (async != nullptr && (m_info.m_fields[m_field_id].m_flags & EPF_ASYNC))
+	{
+		if (m_async_id != async->id())
+		{
+			m_async_field = async->add_field(efield);
+			m_async_id = async->id();
+		}
+		if (async->get(evt, m_async_field, values))
+		{
+			return !values.empty();
+		}
+	}
+
+	uint32_t num_fields = 1;
+	if (!m_eplugin->extract_fields(evt, num_fields, &efield) || efield.res_len == 0)
+	{
+		return false;
+	}
+
+	values.clear();
+	append_values(efield, values);
 	return true;
 }
 
+void sinsp_filter_check_plugin::extract_batch(sinsp_evt** evts, uint32_t num_evts, OUT vector<vector<extract_value_t>>& values)
+{
+	values.resize(num_evts);
+	for (auto& v : values)
+	{
+		v.clear();
+	}
+
+	if (!m_eplugin->has_extract_fields_batch())
+	{
+		// the values extracted by the plugin only last until its next
+		// call, so we keep a copy of them for each event
+		m_batch_storage.resize(num_evts);
+		vector<extract_value_t> tmp;
+		for (uint32_t i = 0; i < num_evts; i++)
+		{
+			auto& buf = m_batch_storage[i];
+			buf.clear();
+			if (!extract(evts[i], tmp))
+			{
+				continue;
+			}
+			vector<size_t> offsets;
+			for (const auto& v : tmp)
+			{
+				offsets.push_back(buf.size());
+				buf.append((const char*) v.ptr, v.len);
+			}
+			for (size_t j = 0; j < tmp.size(); j++)
+			{
+				extract_value_t res;
+				res.ptr = (uint8_t*) buf.data() + offsets[j];
+				res.len = tmp[j].len;
+				values[i].push_back(res);
+			}
+		}
+		return;
+	}
+
+	m_batch_evts.clear();
+	m_batch_idx.clear();
+	for (uint32_t i = 0; i < num_evts; i++)
+	{
+		if (is_event_compatible(evts[i]))
+		{
+			m_batch_evts.push_back(evts[i]);
+			m_batch_idx.push_back(i);
+		}
+	}
+	if (m_batch_evts.empty())
+	{
+		return;
+	}
+
+	m_batch_fields.resize(m_batch_evts.size());
+	for (auto& efield : m_batch_fields)
+	{
+		fill_extract_field(efield);
+		efield.res_len = 0;
+	}
+
+	uint32_t num_fields = 1;
+	if (!m_eplugin->extract_fields_batch(m_batch_evts.size(), m_batch_evts.data(), num_fields, m_batch_fields.data()))
+	{
+		return;
+	}
+
+	for (size_t k = 0; k < m_batch_fields.size(); k++)
+	{
+		append_values(m_batch_fields[k], values[m_batch_idx[k]]);
+	}
+}
+
 void sinsp_filter_check_plugin::extract_arg_index(const char* full_field_name)
 {
 	int length = m_argstr.length();
@@ -262,3 +381,211 @@ void sinsp_filter_check_plugin::extract_arg_key()
 {
 	m_arg_key = (char*)m_argstr.c_str();
 }
+
+static std::atomic<uint64_t> s_next_async_extractor_id(1);
+
+sinsp_plugin_async_extractor::sinsp_plugin_async_extractor(sinsp_plugin* plugin, uint32_t num_workers, uint64_t max_wait_ns)
+	: m_plugin(plugin),
+	  m_id(s_next_async_extractor_id.fetch_add(1)),
+	  m_max_wait_ns(max_wait_ns),
+	  m_next_evt(0),
+	  m_num_evts(0),
+	  m_running(0),
+	  m_num_timeouts(0),
+	  m_stop(false)
+{
+	for (uint32_t j = 0; j < num_workers; j++)
+	{
+		m_threads.emplace_back(&sinsp_plugin_async_extractor::worker_loop, this);
+	}
+}
+
+sinsp_plugin_async_extractor::~sinsp_plugin_async_extractor()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_stop = true;
+	}
+	m_work.notify_all();
+	for (auto& t : m_threads)
+	{
+		t.join();
+	}
+}
+
+uint32_t sinsp_plugin_async_extractor::add_field(const ss_plugin_extract_field& f)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	for (uint32_t i = 0; i < m_fields.size(); i++)
+	{
+		const auto& cur = m_fields[i];
+		if (cur.m_field.field_id == f.field_id
+		    && cur.m_field.arg_present == f.arg_present
+		    && cur.m_field.arg_index == f.arg_index
+		    && cur.m_arg_key == (f.arg_key != NULL ? f.arg_key : ""))
+		{
+			return i;
+		}
+	}
+
+	m_fields.emplace_back();
+	auto& added = m_fields.back();
+	added.m_field = f;
+	added.m_field.res_len = 0;
+	if (f.arg_key != NULL)
+	{
+		added.m_arg_key = f.arg_key;
+		added.m_field.arg_key = added.m_arg_key.c_str();
+	}
+	return m_fields.size() - 1;
+}
+
+void sinsp_plugin_async_extractor::prefetch(sinsp_evt** evts, uint32_t num_evts)
+{
+	cancel();
+
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (m_fields.empty())
+	{
+		// no filter check asked for an async field yet
+		return;
+	}
+
+	m_batch_fields.clear();
+	for (const auto& f : m_fields)
+	{
+		m_batch_fields.push_back(f.m_field);
+	}
+
+	m_evts.resize(num_evts);
+	for (uint32_t i = 0; i < num_evts; i++)
+	{
+		m_evts[i].m_evt = evts[i];
+		m_evts[i].m_state = EVT_QUEUED;
+		m_evts[i].m_values.clear();
+		m_evt_idx[evts[i]->get_num()] = i;
+	}
+	m_next_evt = 0;
+	m_num_evts = num_evts;
+	m_work.notify_all();
+}
+
+void sinsp_plugin_async_extractor::cancel()
+{
+	std::unique_lock<std::mutex> lock(m_mtx);
+	m_num_evts = m_next_evt;
+	m_done.wait(lock, [this] { return m_running == 0; });
+	m_evt_idx.clear();
+}
+
+bool sinsp_plugin_async_extractor::get(sinsp_evt* evt, uint32_t field_idx, std::vector<extract_value_t>& values)
+{
+	values.clear();
+
+	std::unique_lock<std::mutex> lock(m_mtx);
+	auto it = m_evt_idx.find(evt->get_num());
+	if (it == m_evt_idx.end() || field_idx >= m_batch_fields.size())
+	{
+		return false;
+	}
+
+	auto& ev = m_evts[it->second];
+	if (ev.m_state != EVT_DONE &&
+	    !m_done.wait_for(lock, std::chrono::nanoseconds(m_max_wait_ns), [&ev] { return ev.m_state == EVT_DONE; }))
+	{
+		m_num_timeouts++;
+		return true;
+	}
+
+	for (const auto& v : ev.m_values[field_idx])
+	{
+		extract_value_t res;
+		res.ptr = (uint8_t*) v.data();
+		res.len = v.size();
+		values.push_back(res);
+	}
+	return true;
+}
+
+uint64_t sinsp_plugin_async_extractor::num_timeouts()
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_num_timeouts;
+}
+
+void sinsp_plugin_async_extractor::worker_loop()
+{
+	std::vector<ss_plugin_extract_field> fields;
+	std::vector<std::vector<std::string>> values;
+
+	std::unique_lock<std::mutex> lock(m_mtx);
+	while (true)
+	{
+		m_work.wait(lock, [this] { return m_stop || m_next_evt < m_num_evts; });
+		if (m_stop)
+		{
+			return;
+		}
+
+		// m_evts is not resized while an extraction is running
+		auto& ev = m_evts[m_next_evt++];
+		ev.m_state = EVT_RUNNING;
+		m_running++;
+		fields = m_batch_fields;
+		lock.unlock();
+
+		extract(ev.m_evt, fields, values);
+
+		lock.lock();
+		ev.m_values.swap(values);
+		ev.m_state = EVT_DONE;
+		m_running--;
+		m_done.notify_all();
+	}
+}
+
+void sinsp_plugin_async_extractor::extract(sinsp_evt* evt,
+					    vector<ss_plugin_extract_field>& fields,
+					    vector<vector<string>>& values) const
+{
+	values.resize(fields.size());
+	for (auto& v : values)
+	{
+		v.clear();
+	}
+
+	if (evt->get_source_idx() == sinsp_no_event_source_idx
+	    || !m_plugin->extract_event_codes().contains((ppm_event_code) evt->get_type())
+	    || !sinsp_plugin::is_source_compatible(m_plugin->extract_event_sources(), evt->get_source_name()))
+	{
+		return;
+	}
+
+	// the values are copied, the ones of the plugin only last until its
+	// next call
+	vector<extract_value_t> tmp;
+	try
+	{
+		if (!m_plugin->extract_fields(evt, fields.size(), fields.data()))
+		{
+			return;
+		}
+		for (size_t k = 0; k < fields.size(); k++)
+		{
+			tmp.clear();
+			append_values(fields[k], tmp);
+			for (const auto& v : tmp)
+			{
+				values[k].emplace_back((const char*) v.ptr, v.len);
+			}
+		}
+	}
+	catch (...)
+	{
+		// the fields have no value, like when the plugin fails
+		for (auto& v : values)
+		{
+			v.clear();
+		}
+	}
+}
@@ -17,8 +17,13 @@ limitations under the License.
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include "sinsp_int.h"
 #include "version.h"
@@ -52,6 +57,20 @@ public:
 		OUT std::vector<extract_value_t>& values,
 		bool sanitize_strings = true) override;
 
+	double get_extraction_cost() override;
+
+	/**
+		\brief Extracts the field from a batch of events, with a single
+		call into the plugin when it supports batched extraction. values[i]
+		holds the values extracted from evts[i], and is empty if the field
+		can't be extracted from it. The values remain valid until the next
+		extraction.
+	 */
+	void extract_batch(
+		sinsp_evt** evts,
+		uint32_t num_evts,
+		OUT std::vector<std::vector<extract_value_t>>& values);
+
 private:
 	std::string m_argstr;
 	char* m_arg_key;
@@ -60,6 +79,22 @@ private:
 	std::vector<bool> m_compatible_plugin_sources_bitmap;
 	std::shared_ptr<sinsp_plugin> m_eplugin;
 
+	// scratch space of extract_batch(), reused across batches
+	std::vector<sinsp_evt*> m_batch_evts;
+	std::vector<uint32_t> m_batch_idx;
+	std::vector<ss_plugin_extract_field> m_batch_fields;
+	std::vector<std::string> m_batch_storage;
+
+	// index of the field in the async extractor of the plugin, valid
+	// only if m_async_id matches the id of the extractor
+	uint64_t m_async_id;
+	uint32_t m_async_field;
+
+	// returns true if the plugin can extract fields from the event
+	bool is_event_compatible(sinsp_evt* evt);
+
+	void fill_extract_field(ss_plugin_extract_field& efield) const;
+
 	// extract_arg_index() extracts a valid index from the argument if 
 	// format is valid, otherwise it throws an exception.
 	// `full_field_name` has the format "field[argument]" and it is necessary
@@ -69,4 +104,114 @@ private:
 	// extract_arg_key() extracts a valid string from the argument. If we pass
 	// a numeric argument, it will be converted to string. 
 	void extract_arg_key();
-};
\ No newline at end of file
+};
+
+/**
+	\brief Extracts the async fields of a plugin (the ones declared with the
+	"async" property) on a pool of worker threads, ahead of the filter
+	evaluation. Every batch returned by sinsp::next_batch() is handed to it,
+	and the plugin filter checks then take the values resolved for their
+	event, waiting at most max_wait_ns for them, so the filters are still
+	evaluated in the event order. A field that isn't resolved in time has no
+	value for that event, while the fields of the events that weren't
+	prefetched are extracted synchronously as usual.
+
+	The plugin must tolerate extract_fields running concurrently from
+	several threads for its async fields.
+ */
+class sinsp_plugin_async_extractor
+{
+public:
+	sinsp_plugin_async_extractor(sinsp_plugin* plugin, uint32_t num_workers, uint64_t max_wait_ns);
+
+	~sinsp_plugin_async_extractor();
+
+	sinsp_plugin_async_extractor(const sinsp_plugin_async_extractor&) = delete;
+	sinsp_plugin_async_extractor& operator = (const sinsp_plugin_async_extractor&) = delete;
+
+	/**
+		\brief Unique among the extractors created by the process, lets
+		the filter checks know when they have to add their field again.
+	 */
+	inline uint64_t id() const
+	{
+		return m_id;
+	}
+
+	/**
+		\brief Adds a field to the ones extracted from the following
+		batches, and returns its index. Equal fields share the same index.
+	 */
+	uint32_t add_field(const ss_plugin_extract_field& field);
+
+	/**
+		\brief Starts extracting the fields from a batch of events, after
+		cancelling the previous one. The events must remain valid until
+		the next call to prefetch() or cancel().
+	 */
+	void prefetch(sinsp_evt** evts, uint32_t num_evts);
+
+	/**
+		\brief Drops the extractions not started yet and waits for the
+		running ones.
+	 */
+	void cancel();
+
+	/**
+		\brief Gets the values of the field `field_idx` for the event,
+		waiting for them at most max_wait_ns. Returns false if the event
+		wasn't prefetched with this field, otherwise values is empty if
+		the field has no value or wasn't resolved in time. The values
+		remain valid until the next call to prefetch() or cancel().
+	 */
+	bool get(sinsp_evt* evt, uint32_t field_idx, std::vector<extract_value_t>& values);
+
+	/**
+		\brief Number of fields that weren't resolved in time.
+	 */
+	uint64_t num_timeouts();
+
+private:
+	enum evt_state
+	{
+		EVT_QUEUED,
+		EVT_RUNNING,
+		EVT_DONE,
+	};
+
+	struct field
+	{
+		ss_plugin_extract_field m_field;
+		std::string m_arg_key;
+	};
+
+	struct evt_values
+	{
+		sinsp_evt* m_evt;
+		evt_state m_state;
+		std::vector<std::vector<std::string>> m_values; ///< Values of each field of the batch.
+	};
+
+	void worker_loop();
+	void extract(sinsp_evt* evt,
+		     std::vector<ss_plugin_extract_field>& fields,
+		     std::vector<std::vector<std::string>>& values) const;
+
+	sinsp_plugin* m_plugin;
+	uint64_t m_id;
+	uint64_t m_max_wait_ns;
+
+	std::mutex m_mtx;
+	std::condition_variable m_work;
+	std::condition_variable m_done;
+	std::deque<field> m_fields; // a deque keeps m_arg_key in place
+	std::vector<ss_plugin_extract_field> m_batch_fields;
+	std::vector<evt_values> m_evts;
+	std::unordered_map<uint64_t, uint32_t> m_evt_idx; // by event number
+	uint32_t m_next_evt;
+	uint32_t m_num_evts;
+	uint32_t m_running;
+	uint64_t m_num_timeouts;
+	bool m_stop;
+	std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,201 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <unordered_map>
+
+#include "plugin_parser.h"
+
+sinsp_plugin_parse_pool::sinsp_plugin_parse_pool(uint32_t num_threads)
+	: m_num_parsers(0),
+	  m_parsers(nullptr),
+	  m_evt(nullptr),
+	  m_evt_sources(nullptr),
+	  m_next_group(0),
+	  m_gen(0),
+	  m_busy_workers(0),
+	  m_stop(false)
+{
+	for (uint32_t j = 0; j < num_threads; j++)
+	{
+		m_threads.emplace_back(&sinsp_plugin_parse_pool::worker_loop, this);
+	}
+}
+
+sinsp_plugin_parse_pool::~sinsp_plugin_parse_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_stop = true;
+	}
+	m_work.notify_all();
+	for (auto& t : m_threads)
+	{
+		t.join();
+	}
+}
+
+std::vector<std::vector<size_t>> sinsp_plugin_parse_pool::group_parsers(const std::vector<sinsp_plugin_parser>& parsers)
+{
+	// union-find of the parsers, joined by the tables they write
+	std::vector<size_t> parent(parsers.size());
+	for (size_t i = 0; i < parsers.size(); i++)
+	{
+		parent[i] = i;
+	}
+	auto find = [&parent](size_t i)
+	{
+		while (parent[i] != i)
+		{
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	};
+
+	std::unordered_map<std::string, size_t> writers;
+	for (size_t i = 0; i < parsers.size(); i++)
+	{
+		for (const auto& t : parsers[i].plugin()->written_tables())
+		{
+			auto it = writers.find(t);
+			if (it == writers.end())
+			{
+				writers[t] = i;
+				continue;
+			}
+			size_t a = find(it->second);
+			size_t b = find(i);
+			// the root is the first parser, which keeps the groups in
+			// registration order
+			parent[a > b ? a : b] = a > b ? b : a;
+		}
+	}
+
+	std::vector<std::vector<size_t>> groups;
+	std::vector<size_t> group_of(parsers.size());
+	for (size_t i = 0; i < parsers.size(); i++)
+	{
+		size_t root = find(i);
+		if (root == i)
+		{
+			group_of[i] = groups.size();
+			groups.emplace_back();
+		}
+		groups[group_of[root]].push_back(i);
+	}
+	return groups;
+}
+
+void sinsp_plugin_parse_pool::process_event(std::vector<sinsp_plugin_parser>& parsers, sinsp_evt* evt, const std::vector<std::string>& evt_sources)
+{
+	if (parsers.size() != m_num_parsers)
+	{
+		m_groups = group_parsers(parsers);
+		m_num_parsers = parsers.size();
+	}
+
+	// only wake up the workers if several groups want the event
+	m_active_groups.clear();
+	for (size_t g = 0; g < m_groups.size(); g++)
+	{
+		for (auto i : m_groups[g])
+		{
+			if (parsers[i].plugin()->parse_event_codes().contains((ppm_event_code) evt->get_type()))
+			{
+				m_active_groups.push_back(g);
+				break;
+			}
+		}
+	}
+
+	if (m_active_groups.size() <= 1 || m_threads.empty())
+	{
+		for (auto& pp : parsers)
+		{
+			pp.process_event(evt, evt_sources);
+		}
+		return;
+	}
+
+	m_parsers = &parsers;
+	m_evt = evt;
+	m_evt_sources = &evt_sources;
+	m_next_group = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_gen++;
+		m_busy_workers = m_threads.size();
+	}
+	m_work.notify_all();
+
+	run_groups();
+
+	std::exception_ptr e;
+	{
+		std::unique_lock<std::mutex> lock(m_mtx);
+		m_done.wait(lock, [this] { return m_busy_workers == 0; });
+		e = m_exception;
+		m_exception = nullptr;
+	}
+	if (e)
+	{
+		std::rethrow_exception(e);
+	}
+}
+
+void sinsp_plugin_parse_pool::run_groups()
+{
+	try
+	{
+		size_t k;
+		while ((k = m_next_group.fetch_add(1)) < m_active_groups.size())
+		{
+			for (auto i : m_groups[m_active_groups[k]])
+			{
+				(*m_parsers)[i].process_event(m_evt, *m_evt_sources);
+			}
+		}
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if (!m_exception)
+		{
+			m_exception = std::current_exception();
+		}
+	}
+}
+
+void sinsp_plugin_parse_pool::worker_loop()
+{
+	uint64_t gen = 0;
+	std::unique_lock<std::mutex> lock(m_mtx);
+	while (true)
+	{
+		m_work.wait(lock, [this, gen] { return m_stop || m_gen != gen; });
+		if (m_stop)
+		{
+			return;
+		}
+		gen = m_gen;
+		lock.unlock();
+
+		run_groups();
+
+		lock.lock();
+		if (--m_busy_workers == 0)
+		{
+			m_done.notify_all();
+		}
+	}
+}
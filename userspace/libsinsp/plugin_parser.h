@@ -16,8 +16,13 @@ limitations under the License.
 #include "logger.h"
 #include "plugin.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 /**
@@ -86,4 +91,65 @@ public:
 private:
     std::shared_ptr<sinsp_plugin> m_plugin;
 	std::vector<bool> m_compatible_plugin_sources_bitmap;
-};
\ No newline at end of file
+};
+
+/**
+ * @brief Runs the plugin parsers of an event on a pool of threads. The
+ * parsers are split in groups that write disjoint sets of tables (see
+ * sinsp_plugin::written_tables()): the groups run in parallel, while the
+ * parsers of a group run one after the other in their registration order,
+ * so the result doesn't depend on the scheduling. Events that only some
+ * parsers of a single group are interested in are parsed on the calling
+ * thread. The plugin parsers must not share state outside of the tables.
+ */
+class sinsp_plugin_parse_pool
+{
+public:
+	explicit sinsp_plugin_parse_pool(uint32_t num_threads);
+	~sinsp_plugin_parse_pool();
+	sinsp_plugin_parse_pool(const sinsp_plugin_parse_pool&) = delete;
+	sinsp_plugin_parse_pool& operator = (const sinsp_plugin_parse_pool&) = delete;
+
+	/**
+	 * @brief Parses the event with all the parsers, and returns once they
+	 * are done. The groups are recomputed when parsers are added.
+	 */
+	void process_event(std::vector<sinsp_plugin_parser>& parsers, sinsp_evt* evt, const std::vector<std::string>& evt_sources);
+
+	/**
+	 * @brief Returns the groups of parsers, as indexes in the parsers
+	 * vector of the last event.
+	 */
+	inline const std::vector<std::vector<size_t>>& groups() const
+	{
+		return m_groups;
+	}
+
+	/**
+	 * @brief Splits the parsers in groups that share no written table.
+	 */
+	static std::vector<std::vector<size_t>> group_parsers(const std::vector<sinsp_plugin_parser>& parsers);
+
+private:
+	void worker_loop();
+	void run_groups();
+
+	std::vector<std::vector<size_t>> m_groups;
+	size_t m_num_parsers;
+	std::vector<size_t> m_active_groups;
+
+	// The current event, shared with the workers.
+	std::vector<sinsp_plugin_parser>* m_parsers;
+	sinsp_evt* m_evt;
+	const std::vector<std::string>* m_evt_sources;
+	std::atomic<size_t> m_next_group;
+
+	std::mutex m_mtx;
+	std::condition_variable m_work;
+	std::condition_variable m_done;
+	uint64_t m_gen;
+	uint32_t m_busy_workers;
+	bool m_stop;
+	std::exception_ptr m_exception;
+	std::vector<std::thread> m_threads;
+};
@@ -53,6 +53,11 @@ limitations under the License.
 	} \
 }
 
+// expands to the type and the member pointer of a ss_plugin_state_data field,
+// used as template arguments for resolving the accessed field at compile time
+#define __PLUGIN_STATEDATA_MEMBER(_dtype) \
+	decltype(ss_plugin_state_data::_dtype), &ss_plugin_state_data::_dtype
+
 static inline ss_plugin_state_type typeinfo_to_state_type(const libsinsp::state::typeinfo& i)
 {
     switch(i.index())
@@ -173,6 +178,10 @@ struct sinsp_table_wrapper
 		void* accessor;
 		bool dynamic;
 		ss_plugin_state_type data_type;
+		// resolved once when the accessor is created, so that reading and
+		// writing an entry's field don't switch on its type at every call
+		void (*read)(const field_accessor_wrapper* a, libsinsp::state::table_entry* e, ss_plugin_state_data* out);
+		void (*write)(const field_accessor_wrapper* a, libsinsp::state::table_entry* e, const ss_plugin_state_data* in);
     };
 
 	template <typename T>
@@ -273,6 +282,8 @@ struct sinsp_table_wrapper
 			sinsp_table_wrapper::field_accessor_wrapper acc_wrap; \
 			acc_wrap.dynamic = false; \
 			acc_wrap.data_type = data_type; \
+			acc_wrap.read = read_static_field<_type, __PLUGIN_STATEDATA_MEMBER(_dtype)>; \
+			acc_wrap.write = write_static_field<_type, __PLUGIN_STATEDATA_MEMBER(_dtype)>; \
 			acc_wrap.accessor = new libsinsp::state::static_struct::field_accessor<_type>(acc); \
 			t->m_field_accessors[name] = acc_wrap; \
 			return &t->m_field_accessors[name]; \
@@ -295,6 +306,8 @@ struct sinsp_table_wrapper
 			sinsp_table_wrapper::field_accessor_wrapper acc_wrap; \
 			acc_wrap.dynamic = true; \
 			acc_wrap.data_type = data_type; \
+			acc_wrap.read = read_dynamic_field<_type, __PLUGIN_STATEDATA_MEMBER(_dtype)>; \
+			acc_wrap.write = write_dynamic_field<_type, __PLUGIN_STATEDATA_MEMBER(_dtype)>; \
 			acc_wrap.accessor = new libsinsp::state::dynamic_struct::field_accessor<_type>(acc); \
 			t->m_field_accessors[name] = acc_wrap; \
 			return &t->m_field_accessors[name]; \
@@ -349,22 +362,21 @@ struct sinsp_table_wrapper
 		return 0;
 	}
 
+	// the key type of the table is resolved once when the table is accessed,
+	// and entries are looked up without copying their shared_ptr
+	template <typename KeyType, typename DataType, DataType ss_plugin_state_data::* Member>
 	static ss_plugin_table_entry_t* get_entry(ss_plugin_table_t* _t, const ss_plugin_state_data* key)
 	{
 		auto t = static_cast<sinsp_table_wrapper*>(_t);
-		#define _X(_type, _dtype) \
-		{ \
-			auto tt = static_cast<libsinsp::state::table<_type>*>(t->m_table); \
-			auto ret = tt->get_entry(key->_dtype); \
-			if (ret != nullptr) \
-			{ \
-				return static_cast<ss_plugin_table_entry_t*>(ret.get()); \
-			} \
-		}
 		__CATCH_ERR_MSG(t->m_owner_plugin.m_last_owner_err, {
-			__PLUGIN_STATETYPE_SWITCH(t->m_key_type);
+			auto tt = static_cast<libsinsp::state::table<KeyType>*>(t->m_table);
+			auto ret = tt->get_entry_ptr(key->*Member);
+			if (ret != nullptr)
+			{
+				return static_cast<ss_plugin_table_entry_t*>(ret);
+			}
+			t->m_owner_plugin.m_last_owner_err = "table entry not found";
 		});
-		#undef _X
 		return NULL;
 	}
 
@@ -373,6 +385,40 @@ struct sinsp_table_wrapper
 		to = from;
 	}
 
+	// special case for strings
+	static inline void convert_types(const std::string& from, const char*& to)
+	{
+		to = from.c_str();
+	}
+
+	template <typename T, typename DataType, DataType ss_plugin_state_data::* Member>
+	static void read_static_field(const field_accessor_wrapper* a, libsinsp::state::table_entry* e, ss_plugin_state_data* out)
+	{
+		auto aa = static_cast<libsinsp::state::static_struct::field_accessor<T>*>(a->accessor);
+		convert_types(e->get_static_field(*aa), out->*Member);
+	}
+
+	template <typename T, typename DataType, DataType ss_plugin_state_data::* Member>
+	static void read_dynamic_field(const field_accessor_wrapper* a, libsinsp::state::table_entry* e, ss_plugin_state_data* out)
+	{
+		auto aa = static_cast<libsinsp::state::dynamic_struct::field_accessor<T>*>(a->accessor);
+		convert_types(e->get_dynamic_field(*aa), out->*Member);
+	}
+
+	template <typename T, typename DataType, DataType ss_plugin_state_data::* Member>
+	static void write_static_field(const field_accessor_wrapper* a, libsinsp::state::table_entry* e, const ss_plugin_state_data* in)
+	{
+		auto aa = static_cast<libsinsp::state::static_struct::field_accessor<T>*>(a->accessor);
+		e->set_static_field(*aa, (T) (in->*Member));
+	}
+
+	template <typename T, typename DataType, DataType ss_plugin_state_data::* Member>
+	static void write_dynamic_field(const field_accessor_wrapper* a, libsinsp::state::table_entry* e, const ss_plugin_state_data* in)
+	{
+		auto aa = static_cast<libsinsp::state::dynamic_struct::field_accessor<T>*>(a->accessor);
+		e->set_dynamic_field(*aa, (T) (in->*Member));
+	}
+
 	static ss_plugin_rc read_entry_field(ss_plugin_table_t* _t, ss_plugin_table_entry_t* _e, const ss_plugin_table_field_t* f, ss_plugin_state_data* out);
 
 	static ss_plugin_rc clear(ss_plugin_table_t* _t)
@@ -385,25 +431,18 @@ struct sinsp_table_wrapper
 		return SS_PLUGIN_FAILURE;
 	}
 
+	template <typename KeyType, typename DataType, DataType ss_plugin_state_data::* Member>
 	static ss_plugin_rc erase_entry(ss_plugin_table_t* _t, const ss_plugin_state_data* key)
 	{
 		auto t = static_cast<sinsp_table_wrapper*>(_t);
-		#define _X(_type, _dtype) \
-		{ \
-			if (static_cast<libsinsp::state::table<_type>*>(t->m_table)->erase_entry(key->_dtype)) \
-			{ \
-				return SS_PLUGIN_SUCCESS; \
-			} \
-			else \
-			{ \
-				t->m_owner_plugin.m_last_owner_err = "table entry not found"; \
-				return SS_PLUGIN_FAILURE; \
-			} \
-		}
 		__CATCH_ERR_MSG(t->m_owner_plugin.m_last_owner_err, {
-			__PLUGIN_STATETYPE_SWITCH(t->m_key_type);
+			auto tt = static_cast<libsinsp::state::table<KeyType>*>(t->m_table);
+			if (tt->erase_entry(key->*Member))
+			{
+				return SS_PLUGIN_SUCCESS;
+			}
+			t->m_owner_plugin.m_last_owner_err = "table entry not found";
 		});
-		#undef _X
 		return SS_PLUGIN_FAILURE;
 	}
 
@@ -437,56 +476,32 @@ struct sinsp_table_wrapper
 		#undef _X
 	}
 
+	template <typename KeyType, typename DataType, DataType ss_plugin_state_data::* Member>
 	static ss_plugin_table_entry_t* add_entry(ss_plugin_table_t* _t, const ss_plugin_state_data* key, ss_plugin_table_entry_t* _e)
 	{
 		auto t = static_cast<sinsp_table_wrapper*>(_t);
-		#define _X(_type, _dtype) \
-		{ \
-			auto e = static_cast<libsinsp::state::table_entry*>(_e); \
-			auto ptr = std::unique_ptr<libsinsp::state::table_entry>(e); \
-			auto tt = static_cast<libsinsp::state::table<_type>*>(t->m_table); \
-			auto ret = tt->add_entry(key->_dtype, std::move(ptr)).get(); \
-			return static_cast<ss_plugin_table_entry_t*>(ret); \
-		}
 		__CATCH_ERR_MSG(t->m_owner_plugin.m_last_owner_err, {
-			__PLUGIN_STATETYPE_SWITCH(t->m_key_type);
+			auto e = static_cast<libsinsp::state::table_entry*>(_e);
+			auto ptr = std::unique_ptr<libsinsp::state::table_entry>(e);
+			auto tt = static_cast<libsinsp::state::table<KeyType>*>(t->m_table);
+			auto ret = tt->add_entry(key->*Member, std::move(ptr)).get();
+			return static_cast<ss_plugin_table_entry_t*>(ret);
 		});
-		#undef _X
 		return NULL;
 	}
 
 	static ss_plugin_rc write_entry_field(ss_plugin_table_t* _t, ss_plugin_table_entry_t* e, const ss_plugin_table_field_t* f, const ss_plugin_state_data* in);
 };
 
-// special case for strings
-template<> inline void sinsp_table_wrapper::convert_types(const std::string& from, const char*& to)
-{
-	to = from.c_str();
-}
-
 ss_plugin_rc sinsp_table_wrapper::read_entry_field(ss_plugin_table_t* _t, ss_plugin_table_entry_t* _e, const ss_plugin_table_field_t* f, ss_plugin_state_data* out)
 {
 	auto a = static_cast<const sinsp_table_wrapper::field_accessor_wrapper*>(f);
 	auto t = static_cast<sinsp_table_wrapper*>(_t);
 	auto e = static_cast<libsinsp::state::table_entry*>(_e);
-	#define _X(_type, _dtype) \
-	{ \
-		if (a->dynamic) \
-		{ \
-			auto aa = static_cast<libsinsp::state::dynamic_struct::field_accessor<_type>*>(a->accessor); \
-			convert_types(e->get_dynamic_field(*aa), out->_dtype); \
-		} \
-		else \
-		{ \
-			auto aa = static_cast<libsinsp::state::static_struct::field_accessor<_type>*>(a->accessor); \
-			convert_types(e->get_static_field(*aa), out->_dtype); \
-		} \
-		return SS_PLUGIN_SUCCESS; \
-	}
 	__CATCH_ERR_MSG(t->m_owner_plugin.m_last_owner_err, {
-		__PLUGIN_STATETYPE_SWITCH(a->data_type);
+		a->read(a, e, out);
+		return SS_PLUGIN_SUCCESS;
 	});
-	#undef _X
 	return SS_PLUGIN_FAILURE;
 }
 
@@ -495,24 +510,10 @@ ss_plugin_rc sinsp_table_wrapper::write_entry_field(ss_plugin_table_t* _t, ss_pl
 	auto a = static_cast<const sinsp_table_wrapper::field_accessor_wrapper*>(f);
 	auto t = static_cast<sinsp_table_wrapper*>(_t);
 	auto e = static_cast<libsinsp::state::table_entry*>(_e);
-	#define _X(_type, _dtype) \
-	{ \
-		if (a->dynamic) \
-		{ \
-			auto aa = static_cast<libsinsp::state::dynamic_struct::field_accessor<_type>*>(a->accessor); \
-			e->set_dynamic_field(*aa, (_type) in->_dtype); \
-		} \
-		else \
-		{ \
-			auto aa = static_cast<libsinsp::state::static_struct::field_accessor<_type>*>(a->accessor); \
-			e->set_static_field(*aa, (_type) in->_dtype); \
-		} \
-		return SS_PLUGIN_SUCCESS; \
-	}
 	__CATCH_ERR_MSG(t->m_owner_plugin.m_last_owner_err, {
-		__PLUGIN_STATETYPE_SWITCH(a->data_type);
+		a->write(a, e, in);
+		return SS_PLUGIN_SUCCESS;
 	});
-	#undef _X
 	return SS_PLUGIN_FAILURE;
 }
 
@@ -681,18 +682,21 @@ ss_plugin_table_t* sinsp_plugin::table_api_get_table(ss_plugin_owner_t *o, const
 		res->fields.get_table_field = sinsp_table_wrapper::get_field; \
 		res->reader.get_table_name = sinsp_table_wrapper::get_name; \
 		res->reader.get_table_size = sinsp_table_wrapper::get_size; \
-		res->reader.get_table_entry = sinsp_table_wrapper::get_entry; \
+		res->reader.get_table_entry = sinsp_table_wrapper::get_entry<_type, __PLUGIN_STATEDATA_MEMBER(_dtype)>; \
 		res->reader.read_entry_field = sinsp_table_wrapper::read_entry_field; \
 		res->writer.clear_table = sinsp_table_wrapper::clear; \
-		res->writer.erase_table_entry = sinsp_table_wrapper::erase_entry; \
+		res->writer.erase_table_entry = sinsp_table_wrapper::erase_entry<_type, __PLUGIN_STATEDATA_MEMBER(_dtype)>; \
 		res->writer.create_table_entry = sinsp_table_wrapper::create_table_entry; \
 		res->writer.destroy_table_entry = sinsp_table_wrapper::destroy_table_entry; \
-		res->writer.add_table_entry = sinsp_table_wrapper::add_entry; \
+		res->writer.add_table_entry = sinsp_table_wrapper::add_entry<_type, __PLUGIN_STATEDATA_MEMBER(_dtype)>; \
 		res->writer.write_entry_field = sinsp_table_wrapper::write_entry_field; \
 		p->m_accessed_tables[name] = std::move(res); \
 		return p->m_accessed_tables[name].get(); \
 	};
 	__CATCH_ERR_MSG(p->m_last_owner_err, {
+		// the API gives no read-only access, so we assume the plugin
+		// can write every table it gets
+		p->m_written_tables.insert(name);
 		const auto& tables = p->m_accessed_tables;
 		auto it = tables.find(name);
 		if (it == tables.end())
@@ -716,6 +720,7 @@ ss_plugin_rc sinsp_plugin::table_api_add_table(ss_plugin_owner_t *o, const ss_pl
 		break; \
 	}
 	__CATCH_ERR_MSG(p->m_last_owner_err, {
+		p->m_written_tables.insert(in->name);
 		__PLUGIN_STATETYPE_SWITCH(in->key_type);
 		return SS_PLUGIN_SUCCESS;
 	});
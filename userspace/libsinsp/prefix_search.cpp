@@ -17,12 +17,44 @@ limitations under the License.
 
 #include <string.h>
 
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "prefix_search.h"
 
 using namespace std;
 
+// Calls fn(comp, len) for every non-empty component of the path, stopping
+// when it returns false. Returns false if fn stopped the iteration.
+template<typename Fn>
+static inline bool for_each_component(const uint8_t *path, uint32_t len, Fn fn)
+{
+	const uint8_t *pos = path;
+	const uint8_t *end = path + len;
+
+	while(pos < end)
+	{
+		const uint8_t *sep = (const uint8_t *) memchr(pos, '/', end - pos);
+		if(sep == NULL)
+		{
+			sep = end;
+		}
+		if(sep > pos && !fn(pos, (uint32_t)(sep - pos)))
+		{
+			return false;
+		}
+		pos = sep + 1;
+	}
+	return true;
+}
+
 path_prefix_search::path_prefix_search()
 {
+	// the root, matching the dummy "root" component of path_prefix_map
+	m_nodes.emplace_back();
 }
 
 path_prefix_search::~path_prefix_search()
@@ -31,37 +63,186 @@ path_prefix_search::~path_prefix_search()
 
 void path_prefix_search::add_search_path(const char *path)
 {
-	bool dummy = true;
-	return path_prefix_map<bool>::add_search_path(path, dummy);
+	filter_value_t mem((uint8_t *) path, (uint32_t) strlen(path));
+	return add_search_path(mem);
+}
+
+void path_prefix_search::add_search_path(const std::string &str)
+{
+	filter_value_t mem((uint8_t *) str.c_str(), (uint32_t) str.size());
+	return add_search_path(mem);
 }
 
 void path_prefix_search::add_search_path(const filter_value_t &path)
 {
-	bool dummy = true;
-	return path_prefix_map<bool>::add_search_path(path, dummy);
+	uint32_t cur = 0;
+
+	bool done = !for_each_component(path.first, path.second, [&](const uint8_t *comp, uint32_t len)
+	{
+		// no need to add /usr/lib when /usr exists
+		if(m_nodes[cur].m_terminal)
+		{
+			return false;
+		}
+
+		uint32_t id = intern_component(comp, len);
+		uint32_t child = find_child(m_nodes[cur], id);
+		if(child == 0)
+		{
+			child = m_nodes.size();
+			m_nodes.emplace_back();
+
+			// keep the children sorted by component id
+			node &n = m_nodes[cur];
+			auto pos = std::lower_bound(n.m_child_components.begin(), n.m_child_components.end(), id);
+			n.m_children.insert(n.m_children.begin() + (pos - n.m_child_components.begin()), child);
+			n.m_child_components.insert(pos, id);
+		}
+		cur = child;
+		return true;
+	});
+
+	if(done)
+	{
+		return;
+	}
+
+	// This path is a prefix of the longer ones below it, which can be
+	// dropped: e.g. /usr/lib when adding /usr. Their nodes stay in
+	// m_nodes, unreachable.
+	node &n = m_nodes[cur];
+	n.m_terminal = true;
+	std::vector<uint32_t>().swap(n.m_child_components);
+	std::vector<uint32_t>().swap(n.m_children);
 }
 
-void path_prefix_search::add_search_path(const std::string &str)
+uint32_t path_prefix_search::intern_component(const uint8_t *comp, uint32_t len)
+{
+	auto it = m_component_ids.find(std::string_view((const char *) comp, len));
+	if(it != m_component_ids.end())
+	{
+		return it->second;
+	}
+
+	uint32_t id = m_components.size();
+	m_components.emplace_back((const char *) comp, len);
+	m_component_ids.emplace(m_components.back(), id);
+	return id;
+}
+
+uint32_t path_prefix_search::find_child(const node &n, uint32_t component) const
+{
+	const uint32_t *ids = n.m_child_components.data();
+	size_t i = 0;
+	size_t num = n.m_child_components.size();
+
+	// The ids are sorted: narrow down the range of the many children of
+	// the top directories with a binary search, then scan it
+	while(num - i > 16)
+	{
+		size_t mid = i + (num - i) / 2;
+		if(ids[mid] <= component)
+		{
+			i = mid;
+		}
+		else
+		{
+			num = mid;
+		}
+	}
+
+#ifdef __SSE2__
+	__m128i key = _mm_set1_epi32((int) component);
+	for(; i + 4 <= num; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *) (ids + i));
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, key)));
+		if(mask != 0)
+		{
+			return n.m_children[i + __builtin_ctz(mask)];
+		}
+	}
+#endif
+
+	for(; i < num; i++)
+	{
+		if(ids[i] == component)
+		{
+			return n.m_children[i];
+		}
+	}
+	return 0;
+}
+
+bool path_prefix_search::match(const char *path) const
 {
-	bool dummy = true;
-	return path_prefix_map<bool>::add_search_path(str, dummy);
+	filter_value_t mem((uint8_t *) path, (uint32_t) strlen(path));
+	return match(mem);
 }
 
-bool path_prefix_search::match(const char *path)
+bool path_prefix_search::match(const filter_value_t &path) const
 {
-	const bool *val = path_prefix_map<bool>::match(path);
-	return (val != NULL);
+	uint32_t cur = 0;
+	bool found = false;
+
+	bool completed = for_each_component(path.first, path.second, [&](const uint8_t *comp, uint32_t len)
+	{
+		// /foo/bar matched a prefix /foo, so we're done
+		if(m_nodes[cur].m_terminal)
+		{
+			found = true;
+			return false;
+		}
+
+		// a component that was never added can't match
+		auto it = m_component_ids.find(std::string_view((const char *) comp, len));
+		if(it == m_component_ids.end())
+		{
+			return false;
+		}
+
+		cur = find_child(m_nodes[cur], it->second);
+		return cur != 0;
+	});
+
+	// If there is nothing left in the match path, the node must be the
+	// end of a search path. This ensures that /var matches only /var
+	// and not /var/lib
+	return found || (completed && m_nodes[cur].m_terminal);
 }
 
-bool path_prefix_search::match(const filter_value_t &path)
+std::string path_prefix_search::as_string() const
 {
-	const bool *val = path_prefix_map<bool>::match(path);
-	return (val != NULL);
+	std::ostringstream os;
+	os << "root -> " << std::endl;
+	as_string(m_nodes[0], "    ", os);
+	return os.str();
 }
 
-std::string path_prefix_search::as_string()
+void path_prefix_search::as_string(const node &n, const std::string &prefix, std::ostringstream &os) const
 {
-	return path_prefix_map<bool>::as_string(false);
+	for(size_t i = 0; i < n.m_children.size(); i++)
+	{
+		os << prefix << m_components[n.m_child_components[i]] << " -> " << std::endl;
+		as_string(m_nodes[n.m_children[i]], prefix + "    ", os);
+	}
+}
+
+size_t path_prefix_search::memory_usage() const
+{
+	size_t res = m_nodes.capacity() * sizeof(node);
+	for(const auto &n : m_nodes)
+	{
+		res += (n.m_child_components.capacity() + n.m_children.capacity()) * sizeof(uint32_t);
+	}
+	for(const auto &c : m_components)
+	{
+		res += sizeof(std::string) + (c.capacity() > 15 ? c.capacity() + 1 : 0);
+	}
+	// roughly a node, a key and a hash per entry, plus the buckets
+	res += m_component_ids.size() * (sizeof(void *) * 2 + sizeof(std::string_view) + sizeof(uint32_t) + sizeof(size_t));
+	res += m_component_ids.bucket_count() * sizeof(void *);
+	return res;
 }
 
 void path_prefix_map_ut::split_path(const filter_value_t &path, filter_components_t &components)
@@ -21,8 +21,11 @@ limitations under the License.
 
 #include <string>
 #include <sstream>
+#include <deque>
 #include <list>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include "filter_value.h"
 
@@ -322,7 +325,22 @@ std::string path_prefix_map<Value>::as_string(const std::string &prefix, bool in
 	return os.str();
 }
 
-class path_prefix_search : public path_prefix_map<bool>
+//
+// A set of search paths with the same matching rules as
+// path_prefix_map<bool>, used by the pmatch operator.
+//
+// It is laid out for rules with thousands of prefixes: the path
+// components are interned, so that each distinct component is stored once
+// and compared as a 32-bit id, and the trie nodes live in a single array.
+// Every node keeps the component ids of its children in a sorted,
+// contiguous array: large ones are narrowed down with a binary search, then
+// searched 4 ids at a time with SSE2 where available. Matching a path
+// doesn't allocate.
+//
+// Unlike path_prefix_map, the search paths are copied, so the memory
+// passed to add_search_path() doesn't need to outlive the object.
+//
+class path_prefix_search
 {
 public:
 	path_prefix_search();
@@ -332,11 +350,34 @@ public:
 	void add_search_path(const filter_value_t &path);
 	void add_search_path(const std::string &str);
 
-	// If non-NULL, Value is not allocated. It points to memory
-	// held within this path_prefix_map() and is only valid as
-	// long as the map exists.
-	bool match(const char *path);
-	bool match(const filter_value_t &path);
+	bool match(const char *path) const;
+	bool match(const filter_value_t &path) const;
+
+	std::string as_string() const;
+
+	// Heap memory held by the object, in bytes (approximate)
+	size_t memory_usage() const;
 
-	std::string as_string();
+private:
+	struct node
+	{
+		// component ids of the children, sorted, and their indexes
+		// in m_nodes at the same positions
+		std::vector<uint32_t> m_child_components;
+		std::vector<uint32_t> m_children;
+		// the node is the end of a search path, its children
+		// are not needed anymore
+		bool m_terminal = false;
+	};
+
+	// Returns the index of the child of n for the component, or 0 as the
+	// root is never a child
+	uint32_t find_child(const node &n, uint32_t component) const;
+	uint32_t intern_component(const uint8_t *comp, uint32_t len);
+	void as_string(const node &n, const std::string &prefix, std::ostringstream &os) const;
+
+	std::vector<node> m_nodes;
+	// the interned components, the position is the id
+	std::deque<std::string> m_components;
+	std::unordered_map<std::string_view, uint32_t> m_component_ids;
 };
@@ -87,6 +87,21 @@ void sinsp_protodecoder::unregister_write_callback(sinsp_fdinfo_t* fdinfo)
 	fdinfo->unregister_event_callback(CT_WRITE, this);
 }
 
+void sinsp_protodecoder::register_protocol_callback(sinsp_l7_proto proto, sinsp_pd_callback_type etype)
+{
+	ASSERT(m_inspector != NULL);
+
+	m_inspector->m_parser->register_protocol_callback(proto, etype, this);
+}
+
+void sinsp_protodecoder::add_protocol_signature(sinsp_l7_proto proto, scap_l4_proto l4proto,
+						const uint8_t* value, const uint8_t* mask, uint32_t len)
+{
+	ASSERT(m_inspector != NULL);
+
+	m_inspector->m_parser->m_protodetector.add_signature(proto, l4proto, value, mask, len);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_protodecoder_list implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -96,6 +111,7 @@ sinsp_protodecoder_list::sinsp_protodecoder_list()
 	// ADD NEW DECODER CLASSES HERE
 	//////////////////////////////////////////////////////////////////////////////
 	add_protodecoder(new sinsp_decoder_syslog());
+	add_protodecoder(new sinsp_decoder_http());
 }
 
 sinsp_protodecoder_list::~sinsp_protodecoder_list()
@@ -327,3 +343,207 @@ bool sinsp_decoder_syslog::get_info_line(char** res)
 	*res = (char*)m_infostr.c_str();
 	return (m_priority != -1);
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_decoder_http implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_http_state::sinsp_http_state()
+{
+	m_status = 0;
+	m_msg_evtnum = 0;
+	reset_parser(0);
+	reset_parser(1);
+}
+
+fd_protostate* sinsp_http_state::clone() const
+{
+	return new sinsp_http_state(*this);
+}
+
+void sinsp_http_state::reset_parser(uint32_t dir)
+{
+	http_parser_init(&m_parsers[dir], HTTP_BOTH);
+	m_fresh[dir] = true;
+	m_in_url[dir] = false;
+}
+
+sinsp_decoder_http::sinsp_decoder_http()
+{
+	m_name = "http";
+
+	http_parser_settings_init(&m_settings);
+	m_settings.on_message_begin = on_message_begin;
+	m_settings.on_url = on_url;
+	m_settings.on_status = on_status;
+	m_settings.on_headers_complete = on_headers_complete;
+
+	m_evt = NULL;
+	m_state = NULL;
+	m_dir = 0;
+}
+
+sinsp_protodecoder* sinsp_decoder_http::allocate_new()
+{
+	return (sinsp_protodecoder*) new sinsp_decoder_http();
+}
+
+void sinsp_decoder_http::init()
+{
+	register_protocol_callback(L7_PROTO_HTTP, CT_READ);
+	register_protocol_callback(L7_PROTO_HTTP, CT_WRITE);
+}
+
+void sinsp_decoder_http::on_fd_from_proc(sinsp_fdinfo_t* fdinfo)
+{
+}
+
+void sinsp_decoder_http::on_event(sinsp_evt* evt, sinsp_pd_callback_type etype)
+{
+	ASSERT(false);
+}
+
+void sinsp_decoder_http::on_read(sinsp_evt* evt, char *data, uint32_t len)
+{
+	parse(evt, data, len, 0);
+}
+
+void sinsp_decoder_http::on_write(sinsp_evt* evt, char *data, uint32_t len)
+{
+	parse(evt, data, len, 1);
+}
+
+bool sinsp_decoder_http::get_info_line(char** res)
+{
+	return false;
+}
+
+const sinsp_http_state* sinsp_decoder_http::get_state(sinsp_evt* evt)
+{
+	sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+	if(fdinfo == NULL || fdinfo->get_l7proto() != L7_PROTO_HTTP)
+	{
+		return NULL;
+	}
+
+	return dynamic_cast<const sinsp_http_state*>(fdinfo->get_protostate());
+}
+
+void sinsp_decoder_http::parse(sinsp_evt* evt, char *data, uint32_t len, uint32_t dir)
+{
+	sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+	if(fdinfo->get_protostate() == NULL)
+	{
+		fdinfo->set_protostate(new sinsp_http_state());
+	}
+
+	sinsp_http_state* state = dynamic_cast<sinsp_http_state*>(fdinfo->get_protostate());
+	if(state == NULL)
+	{
+		//
+		// Another decoder of the protocol owns the state
+		//
+		return;
+	}
+
+	http_parser* parser = &state->m_parsers[dir];
+	if(parser->upgrade)
+	{
+		//
+		// The connection switched to another protocol
+		//
+		return;
+	}
+
+	m_evt = evt;
+	m_state = state;
+	m_dir = dir;
+	parser->data = this;
+
+	bool fresh = state->m_fresh[dir];
+	state->m_fresh[dir] = false;
+	http_parser_execute(parser, &m_settings, data, len);
+	if(HTTP_PARSER_ERRNO(parser) != HPE_OK)
+	{
+		//
+		// The parser lost track of the messages, usually because part
+		// of the previous buffers wasn't captured. Try again assuming
+		// that this buffer starts a message
+		//
+		state->reset_parser(dir);
+		if(!fresh)
+		{
+			state->m_fresh[dir] = false;
+			http_parser_execute(parser, &m_settings, data, len);
+			if(HTTP_PARSER_ERRNO(parser) != HPE_OK)
+			{
+				state->reset_parser(dir);
+			}
+		}
+	}
+
+	//
+	// If the buffer was truncated by the snaplen, what follows doesn't
+	// continue it
+	//
+	sinsp_evt_param* parinfo = evt->get_param(0);
+	ASSERT(parinfo->m_len == sizeof(int64_t));
+	if(*(int64_t*)parinfo->m_val > (int64_t)len)
+	{
+		state->reset_parser(dir);
+	}
+}
+
+int sinsp_decoder_http::on_message_begin(http_parser* parser)
+{
+	sinsp_decoder_http* dec = (sinsp_decoder_http*)parser->data;
+
+	dec->m_state->m_msg_evtnum = dec->m_evt->get_num();
+	dec->m_state->m_in_url[dec->m_dir] = false;
+	return 0;
+}
+
+int sinsp_decoder_http::on_url(http_parser* parser, const char* at, size_t length)
+{
+	sinsp_decoder_http* dec = (sinsp_decoder_http*)parser->data;
+	sinsp_http_state* state = dec->m_state;
+
+	//
+	// The target can come in more calls if it spans more buffers
+	//
+	if(state->m_in_url[dec->m_dir])
+	{
+		state->m_path.append(at, length);
+	}
+	else
+	{
+		state->m_method = http_method_str((enum http_method)parser->method);
+		state->m_path.assign(at, length);
+		state->m_in_url[dec->m_dir] = true;
+	}
+
+	return 0;
+}
+
+int sinsp_decoder_http::on_status(http_parser* parser, const char* at, size_t length)
+{
+	sinsp_decoder_http* dec = (sinsp_decoder_http*)parser->data;
+
+	dec->m_state->m_status = parser->status_code;
+	return 0;
+}
+
+int sinsp_decoder_http::on_headers_complete(http_parser* parser)
+{
+	sinsp_decoder_http* dec = (sinsp_decoder_http*)parser->data;
+
+	//
+	// on_status() isn't called for the status lines without a reason
+	//
+	dec->m_state->m_in_url[dec->m_dir] = false;
+	if(parser->type == HTTP_RESPONSE)
+	{
+		dec->m_state->m_status = parser->status_code;
+	}
+
+	return 0;
+}
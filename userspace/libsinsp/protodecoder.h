@@ -17,6 +17,8 @@ limitations under the License.
 
 #pragma once
 
+#include "http_parser.h"
+
 ///////////////////////////////////////////////////////////////////////////////
 // The protocol decoder interface
 ///////////////////////////////////////////////////////////////////////////////
@@ -84,6 +86,15 @@ protected:
 	void unregister_read_callback(sinsp_fdinfo_t* fdinfo);
 	void unregister_write_callback(sinsp_fdinfo_t* fdinfo);
 
+	//
+	// Get the read (CT_READ) or write (CT_WRITE) buffers of all the
+	// sockets classified as proto, and extend the classification
+	// (see sinsp_protodetector::add_signature)
+	//
+	void register_protocol_callback(sinsp_l7_proto proto, sinsp_pd_callback_type etype);
+	void add_protocol_signature(sinsp_l7_proto proto, scap_l4_proto l4proto,
+				    const uint8_t* value, const uint8_t* mask, uint32_t len);
+
 	std::string m_name;
 	sinsp* m_inspector;
 
@@ -140,3 +151,69 @@ private:
 	void decode_message(char *data, uint32_t len, char* pristr, uint32_t pristrlen);
 	std::string m_infostr;
 };
+
+//
+// Per-FD state of the HTTP decoder: the parsers of the two directions,
+// and the request and status lines of the last messages
+//
+class sinsp_http_state : public fd_protostate
+{
+public:
+	sinsp_http_state();
+	fd_protostate* clone() const;
+
+	std::string m_method; // method of the last request
+	std::string m_path; // request target of the last request, as sent
+	uint32_t m_status; // status code of the last response, 0 if none yet
+	uint64_t m_msg_evtnum; // the event whose buffer started the last message
+
+private:
+	void reset_parser(uint32_t dir);
+
+	// 0 for the reads, 1 for the writes
+	http_parser m_parsers[2];
+	// true when the parser is at the beginning of the buffers it got
+	bool m_fresh[2];
+	// true when the request target of the current message is partial
+	bool m_in_url[2];
+
+	friend class sinsp_decoder_http;
+};
+
+//
+// Parses incrementally the HTTP/1.x messages of the sockets classified
+// as HTTP, so that the request and status lines are extracted only once
+// per message instead of being searched in every buffer
+//
+class sinsp_decoder_http : public sinsp_protodecoder
+{
+public:
+	sinsp_decoder_http();
+	sinsp_protodecoder* allocate_new();
+	void init();
+	void on_fd_from_proc(sinsp_fdinfo_t* fdinfo);
+	void on_event(sinsp_evt* evt, sinsp_pd_callback_type etype);
+	void on_read(sinsp_evt* evt, char *data, uint32_t len);
+	void on_write(sinsp_evt* evt, char *data, uint32_t len);
+	bool get_info_line(char** res);
+
+	//
+	// The HTTP state of the FD of evt, NULL if it has none
+	//
+	static const sinsp_http_state* get_state(sinsp_evt* evt);
+
+private:
+	void parse(sinsp_evt* evt, char *data, uint32_t len, uint32_t dir);
+
+	static int on_message_begin(http_parser* parser);
+	static int on_url(http_parser* parser, const char* at, size_t length);
+	static int on_status(http_parser* parser, const char* at, size_t length);
+	static int on_headers_complete(http_parser* parser);
+
+	http_parser_settings m_settings;
+
+	// The buffer being parsed
+	sinsp_evt* m_evt;
+	sinsp_http_state* m_state;
+	uint32_t m_dir;
+};
@@ -0,0 +1,166 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// The first SIGNATURE_LEN bytes of a buffer are copied to a zeroed block
+// once, then every signature is a single masked comparison of the whole
+// block. SSE2 and NEON are part of the base x86_64 and aarch64 ISAs, so
+// unlike the string search kernels no runtime selection is needed.
+//
+
+#include <string.h>
+
+#include "protodetect.h"
+#include "sinsp_exception.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define PROTODETECT_X86
+#include <emmintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define PROTODETECT_NEON
+#include <arm_neon.h>
+#endif
+
+sinsp_protodetector::sinsp_protodetector()
+{
+	//
+	// HTTP/1.x requests and responses, and the HTTP/2 connection preface
+	//
+	for(const char* s : {"GET ", "POST ", "PUT ", "DELETE ", "HEAD ", "OPTIONS ",
+			     "PATCH ", "CONNECT ", "TRACE ", "HTTP/1.", "PRI * HTTP/2.0"})
+	{
+		add_signature(L7_PROTO_HTTP, SCAP_L4_UNKNOWN, s);
+	}
+
+	//
+	// TLS handshake record, versions 3.0 to 3.4, starting with a hello
+	//
+	{
+		const uint8_t v[] = {0x16, 0x03, 0x00, 0x00, 0x00, 0x00};
+		const uint8_t m[] = {0xff, 0xff, 0xf8, 0x00, 0x00, 0xfc};
+		add_signature(L7_PROTO_TLS, SCAP_L4_TCP, v, m, sizeof(v));
+	}
+
+	//
+	// DNS standard queries with one question and no answer, and their
+	// responses. On TCP, the messages start with their length
+	//
+	{
+		const uint8_t q[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+		const uint8_t qm[] = {0x00, 0x00, 0xf8, 0x40, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0xff, 0x00};
+		const uint8_t r[] = {0x00, 0x00, 0x80, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+		const uint8_t rm[] = {0x00, 0x00, 0xf8, 0x40, 0xff, 0xff, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00};
+		add_signature(L7_PROTO_DNS, SCAP_L4_UDP, q, qm, sizeof(q));
+		add_signature(L7_PROTO_DNS, SCAP_L4_UDP, r, rm, sizeof(r));
+
+		uint8_t t[sizeof(q) + 2] = {0};
+		uint8_t tm[sizeof(q) + 2] = {0};
+		memcpy(t + 2, q, sizeof(q));
+		memcpy(tm + 2, qm, sizeof(qm));
+		add_signature(L7_PROTO_DNS, SCAP_L4_TCP, t, tm, sizeof(t));
+		memcpy(t + 2, r, sizeof(r));
+		memcpy(tm + 2, rm, sizeof(rm));
+		add_signature(L7_PROTO_DNS, SCAP_L4_TCP, t, tm, sizeof(t));
+	}
+
+	//
+	// Redis commands, as arrays of bulk strings, and the common replies
+	//
+	{
+		const uint8_t v[] = {'*', '0'};
+		const uint8_t m[] = {0xff, 0xf0};
+		add_signature(L7_PROTO_REDIS, SCAP_L4_UNKNOWN, v, m, sizeof(v));
+	}
+	for(const char* s : {"+OK\r\n", "+PONG\r\n", "-ERR ", "-WRONGTYPE "})
+	{
+		add_signature(L7_PROTO_REDIS, SCAP_L4_UNKNOWN, s);
+	}
+}
+
+void sinsp_protodetector::add_signature(sinsp_l7_proto proto, scap_l4_proto l4proto, const char* value)
+{
+	add_signature(proto, l4proto, (const uint8_t*)value, NULL, strlen(value));
+}
+
+void sinsp_protodetector::add_signature(sinsp_l7_proto proto, scap_l4_proto l4proto,
+					const uint8_t* value, const uint8_t* mask, uint32_t len)
+{
+	if(len == 0 || len > SIGNATURE_LEN)
+	{
+		throw sinsp_exception("protocol signatures must be 1 to " + std::to_string(SIGNATURE_LEN) + " bytes long");
+	}
+
+	signature s = {};
+	for(uint32_t j = 0; j < len; j++)
+	{
+		s.m_mask[j] = mask != NULL ? mask[j] : 0xff;
+		s.m_value[j] = value[j] & s.m_mask[j];
+	}
+	s.m_len = len;
+	s.m_l4proto = l4proto;
+	s.m_proto = proto;
+	m_signatures.push_back(s);
+}
+
+void sinsp_protodetector::clear()
+{
+	m_signatures.clear();
+}
+
+sinsp_l7_proto sinsp_protodetector::classify(const char* buf, uint32_t len, scap_l4_proto l4proto) const
+{
+	alignas(16) uint8_t head[SIGNATURE_LEN] = {0};
+	memcpy(head, buf, len < SIGNATURE_LEN ? len : SIGNATURE_LEN);
+
+#if defined(PROTODETECT_X86)
+	__m128i h = _mm_load_si128((const __m128i*)head);
+#elif defined(PROTODETECT_NEON)
+	uint8x16_t h = vld1q_u8(head);
+#else
+	uint64_t h[2];
+	memcpy(h, head, sizeof(h));
+#endif
+
+	for(const auto& s : m_signatures)
+	{
+		if(s.m_len > len || (s.m_l4proto != SCAP_L4_UNKNOWN && s.m_l4proto != l4proto))
+		{
+			continue;
+		}
+
+#if defined(PROTODETECT_X86)
+		__m128i eq = _mm_cmpeq_epi8(_mm_and_si128(h, _mm_loadu_si128((const __m128i*)s.m_mask)),
+					    _mm_loadu_si128((const __m128i*)s.m_value));
+		bool match = _mm_movemask_epi8(eq) == 0xffff;
+#elif defined(PROTODETECT_NEON)
+		uint8x16_t eq = vceqq_u8(vandq_u8(h, vld1q_u8(s.m_mask)), vld1q_u8(s.m_value));
+		bool match = vminvq_u8(eq) == 0xff;
+#else
+		uint64_t m[2];
+		uint64_t v[2];
+		memcpy(m, s.m_mask, sizeof(m));
+		memcpy(v, s.m_value, sizeof(v));
+		bool match = ((h[0] & m[0]) == v[0]) & ((h[1] & m[1]) == v[1]);
+#endif
+		if(match)
+		{
+			return s.m_proto;
+		}
+	}
+
+	return L7_PROTO_UNKNOWN;
+}
@@ -0,0 +1,83 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "scap.h"
+#include "sinsp_pd_callback_type.h"
+
+/**
+ * @brief Classifies the buffers of the sockets by application protocol,
+ * looking at their first bytes. A signature is a prefix of up to
+ * SIGNATURE_LEN bytes, with a mask telling which bits of every byte must
+ * match, so that a signature can accept ranges like the versions of a
+ * protocol. The prefix of a buffer is compared with all the bits of a
+ * signature at once with SIMD instructions, where available.
+ */
+class sinsp_protodetector
+{
+public:
+	static const uint32_t SIGNATURE_LEN = 16;
+
+	/**
+	 * @brief Creates a detector with the signatures of HTTP, TLS, DNS
+	 * and Redis.
+	 */
+	sinsp_protodetector();
+
+	/**
+	 * @brief Adds a signature, checked after the ones added before.
+	 * @param proto The protocol of the buffers matching it.
+	 * @param l4proto The transport the signature applies to, SCAP_L4_UNKNOWN
+	 * for any of them.
+	 * @param value The first len bytes of the matching buffers.
+	 * @param mask The bits of every byte of value that must match, or NULL
+	 * to match all of them.
+	 * @param len At most SIGNATURE_LEN, shorter buffers never match.
+	 */
+	void add_signature(sinsp_l7_proto proto, scap_l4_proto l4proto,
+			   const uint8_t* value, const uint8_t* mask, uint32_t len);
+
+	/**
+	 * @brief Removes all the signatures.
+	 */
+	void clear();
+
+	/**
+	 * @brief Returns the protocol of the first signature matching the
+	 * buffer, L7_PROTO_UNKNOWN if there is none.
+	 */
+	sinsp_l7_proto classify(const char* buf, uint32_t len, scap_l4_proto l4proto) const;
+
+private:
+	struct signature
+	{
+		alignas(16) uint8_t m_value[SIGNATURE_LEN]; // masked
+		alignas(16) uint8_t m_mask[SIGNATURE_LEN]; // 0 past m_len
+		uint32_t m_len;
+		scap_l4_proto m_l4proto;
+		sinsp_l7_proto m_proto;
+	};
+
+	void add_signature(sinsp_l7_proto proto, scap_l4_proto l4proto, const char* value);
+
+	std::vector<signature> m_signatures;
+};
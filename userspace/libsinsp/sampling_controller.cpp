@@ -0,0 +1,74 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "sampling_controller.h"
+
+sampling_controller::sampling_controller()
+{
+	init(0.75, 0.25, 3, 128);
+}
+
+void sampling_controller::init(double high_watermark, double low_watermark, uint32_t calm_intervals, uint32_t max_ratio)
+{
+	m_high_watermark = high_watermark;
+	m_low_watermark = low_watermark;
+	m_calm_intervals = calm_intervals;
+	m_max_ratio = 1;
+	while(m_max_ratio < max_ratio && m_max_ratio < 128)
+	{
+		m_max_ratio *= 2;
+	}
+
+	reset();
+}
+
+void sampling_controller::reset()
+{
+	m_ratio = 1;
+	m_calm = 0;
+	m_last_drops = 0;
+	m_has_drops = false;
+}
+
+uint32_t sampling_controller::update(double buf_fill, uint64_t n_drops)
+{
+	bool dropping = m_has_drops && n_drops > m_last_drops;
+	m_last_drops = n_drops;
+	m_has_drops = true;
+
+	if(dropping || buf_fill >= m_high_watermark)
+	{
+		m_calm = 0;
+		if(m_ratio < m_max_ratio)
+		{
+			m_ratio *= 2;
+		}
+	}
+	else if(buf_fill < m_low_watermark)
+	{
+		if(++m_calm >= m_calm_intervals && m_ratio > 1)
+		{
+			m_ratio /= 2;
+			m_calm = 0;
+		}
+	}
+	else
+	{
+		m_calm = 0;
+	}
+
+	return m_ratio;
+}
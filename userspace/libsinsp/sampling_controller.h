@@ -0,0 +1,78 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#pragma once
+
+#include <cstdint>
+
+// Picks the sampling ratio of the driver (see sinsp::start_dropping_mode)
+// from how busy the capture is: the ratio doubles while the buffers are
+// filling up or the driver is dropping events, and halves back once they
+// stayed mostly empty for a while. The syscalls that the driver never
+// samples (execve, open, clone, ...) keep full fidelity in any case.
+class sampling_controller
+{
+public:
+	sampling_controller();
+
+	//
+	// Configure the controller and go back to no sampling.
+	// high_watermark and low_watermark are fractions of the buffer
+	// size, calm_intervals is the number of consecutive updates below
+	// low_watermark needed to halve the ratio, max_ratio is a power
+	// of 2 up to 128.
+	//
+	void init(double high_watermark, double low_watermark, uint32_t calm_intervals, uint32_t max_ratio);
+
+	//
+	// Go back to no sampling, keeping the configuration
+	//
+	void reset();
+
+	//
+	// Feed the fill of the fullest buffer, as a fraction of its size,
+	// and the number of events dropped by the driver because of full
+	// buffers since the capture started. Returns the sampling ratio
+	// to apply, 1 meaning no sampling.
+	//
+	uint32_t update(double buf_fill, uint64_t n_drops);
+
+	// Return the current sampling ratio
+	inline uint32_t get_ratio() const
+	{
+		return m_ratio;
+	}
+
+private:
+	double m_high_watermark;
+	double m_low_watermark;
+	uint32_t m_calm_intervals;
+	uint32_t m_max_ratio;
+
+	uint32_t m_ratio;
+
+	//
+	// Number of consecutive updates below the low watermark
+	//
+	uint32_t m_calm;
+
+	//
+	// The drop counter at the previous update, to only react to new
+	// drops. m_has_drops is false until the first update.
+	//
+	uint64_t m_last_drops;
+	bool m_has_drops;
+};
@@ -23,8 +23,8 @@ limitations under the License.
 #define INCLUDE_UNKNOWN_SOCKET_FDS
 
 //
-// Memory storage size for an entry in the event storage LIFO.
-// Events bigger than SP_EVT_BUF_SIZE won't be be stored in the LIFO.
+// Maximum size of an enter event stored by the parser until the matching
+// exit event is parsed (see event_buffer_pool). Bigger events won't be stored.
 //
 #define SP_EVT_BUF_SIZE 4096
 
@@ -44,6 +44,38 @@ limitations under the License.
 //
 #define MAX_FD_TABLE_SIZE 4096
 
+//
+// Max number of threadinfos of removed threads kept around for reuse
+//
+#define DEFAULT_MAX_RECYCLED_THREADS 1024
+
+//
+// Number of threads checked per event while purging the inactive threads,
+// so that the purge of big tables doesn't stall the event processing
+//
+#define DEFAULT_THREAD_PURGE_SLICE_SIZE 256
+
+//
+// Number of threads looked at to pick the coldest one when evicting
+// threads or fds (see sinsp::set_state_eviction), and max number of them
+// evicted to make room for a single new entry
+//
+#define STATE_EVICTION_SLICE_SIZE 32
+#define STATE_EVICTION_MAX_VICTIMS 8
+
+//
+// Max number of events that sinsp::next() looks ahead to prefetch the thread
+// and fd info of the upcoming events (see sinsp::set_prefetch_distance)
+//
+#define SINSP_MAX_PREFETCH_DISTANCE 64
+
+//
+// How long a tid whose /proc lookup failed isn't looked up again, and max
+// number of such tids remembered
+//
+#define DEFAULT_PROC_LOOKUP_NEGATIVE_CACHE_TTL_MS 1000
+#define DEFAULT_PROC_LOOKUP_NEGATIVE_CACHE_SIZE 8192
+
 //
 // How often the container table is scanned for inactive containers
 //
@@ -39,6 +39,7 @@ limitations under the License.
 #include "plugin_manager.h"
 #include "plugin_filtercheck.h"
 #include "strlcpy.h"
+#include "scap_savefile.h"
 
 #ifndef CYGWING_AGENT
 #ifndef MINIMAL_BUILD
@@ -86,11 +87,14 @@ sinsp::sinsp(bool static_container, const std::string &static_id, const std::str
 	m_h = NULL;
 	m_parser = NULL;
 	m_is_dumping = false;
+	m_autodump_background_rotation = false;
 	m_metaevt = NULL;
+	m_batch_res = SCAP_SUCCESS;
 	m_meinfo.m_piscapevt = NULL;
 	m_network_interfaces = NULL;
 	m_parser = new sinsp_parser(this);
 	m_thread_manager = new sinsp_thread_manager(this);
+	m_lazy_fd_loader.reset(new sinsp_lazy_fd_loader(this));
 	m_max_fdtable_size = MAX_FD_TABLE_SIZE;
 	m_inactive_container_scan_time_ns = DEFAULT_INACTIVE_CONTAINER_SCAN_TIME_S * ONE_SECOND_IN_NS;
 	m_deleted_users_groups_scan_time_ns = DEFAULT_DELETED_USERS_GROUPS_SCAN_TIME_S * ONE_SECOND_IN_NS;
@@ -104,10 +108,16 @@ sinsp::sinsp(bool static_container, const std::string &static_id, const std::str
 	m_isdropping = false;
 #endif
 	m_snaplen = DEFAULT_SNAPLEN;
+	for(auto& snaplen : m_fd_type_snaplen)
+	{
+		snaplen = PPM_SNAPLEN_FD_TYPE_DEFAULT;
+	}
+	m_cgroup_filter_mode = PPM_CGROUP_FILTER_NONE;
 	m_buffer_format = sinsp_evt::PF_NORMAL;
 	m_input_fd = 0;
 	m_isdebug_enabled = false;
 	m_isfatfile_enabled = false;
+	m_isminimal_state_dump_enabled = false;
 	m_isinternal_events_enabled = false;
 	m_hostname_and_port_resolution_enabled = false;
 	m_output_time_flag = 'h';
@@ -133,6 +143,22 @@ sinsp::sinsp(bool static_container, const std::string &static_id, const std::str
 
 	m_proc_scan_timeout_ms = SCAP_PROC_SCAN_TIMEOUT_NONE;
 	m_proc_scan_log_interval_ms = SCAP_PROC_SCAN_LOG_NONE;
+	m_proc_scan_threads = SCAP_PROC_SCAN_THREADS_AUTO;
+	m_proc_scan_spill_bytes = 0;
+	m_lazy_fd_scan = false;
+	m_prefetch_distance = 0;
+	m_ringbuffer_merge_mode = SCAP_RINGBUFFER_MERGE_LINEAR;
+	m_ringbuffer_consume_chunk_b = 0;
+	m_ringbuffer_wakeup = false;
+	m_ringbuffer_empty_threshold_b = 0;
+	m_ringbuffer_empty_wait_max_us = 0;
+	m_ringbuffer_wakeup_watermark_b = 0;
+	m_savefile_decompression_threads = 0;
+	m_input_plugin_prefetch = false;
+	m_gvisor_parse_threads = 0;
+	m_autodump_async_bufsize = 0;
+	m_autodump_async_nbufs = 0;
+	m_autodump_dropped_events = 0;
 
 	uint32_t evlen = sizeof(scap_evt) + 2 * sizeof(uint16_t) + 2 * sizeof(uint64_t);
 	m_meinfo.m_piscapevt = (scap_evt*)new char[evlen];
@@ -356,6 +382,8 @@ void sinsp::init()
 
 	m_nevts = 0;
 	m_tid_to_remove = -1;
+	m_batch_exited_threads.clear();
+	m_batch_res = SCAP_SUCCESS;
 	m_lastevent_ts = 0;
 	m_firstevent_ts = 0;
 	m_fds_to_remove->clear();
@@ -383,11 +411,20 @@ void sinsp::init()
 	{
 		import_thread_table();
 	}
+	else if(is_live())
+	{
+		m_container_manager.prune_snapshot();
+	}
 
 	import_ifaddr_list();
 
 	import_user_list();
 
+	//
+	// Read the users and groups of the containers found by the scan
+	//
+	m_usergroup_manager.end_proc_scan();
+
 	//
 	// Scan the list to create the proper parent/child dependencies
 	//
@@ -398,6 +435,29 @@ void sinsp::init()
 	//
 	m_thread_manager->fix_sockets_coming_from_proc();
 
+	//
+	// Index the connections found by the scan
+	//
+	if(m_connection_table)
+	{
+		m_thread_manager->get_threads()->loop([&](sinsp_threadinfo& tinfo) {
+			sinsp_fdtable* fdtable = tinfo.get_fd_table();
+			if(tinfo.is_main_thread() && fdtable != NULL)
+			{
+				fdtable->loop([&](int64_t fd, sinsp_fdinfo_t& fdinfo) {
+					m_parser->update_connection_table(&tinfo, fd, &fdinfo, true);
+					return true;
+				});
+			}
+			return true;
+		});
+	}
+
+	//
+	// Start reading the fds skipped by the scan, if any
+	//
+	m_lazy_fd_loader->start();
+
 	// If we are in capture, this is already called by consume_initialstate_events
 	if (!is_capture() && m_external_event_processor)
 	{
@@ -412,6 +472,38 @@ void sinsp::init()
 		set_snaplen(m_snaplen);
 	}
 
+	//
+	// Same for the snaplens of the fd types
+	//
+	for(uint32_t j = 0; j < PPM_SNAPLEN_FD_MAX; j++)
+	{
+		if(m_fd_type_snaplen[j] != PPM_SNAPLEN_FD_TYPE_DEFAULT)
+		{
+			set_fd_type_snaplen((ppm_snaplen_fd_type)j, m_fd_type_snaplen[j]);
+		}
+	}
+
+	//
+	// And for the syscall limits
+	//
+	for(const auto& it : m_syscall_limits)
+	{
+		set_syscall_limit(it.first, it.second.sample_every, it.second.max_per_sec);
+	}
+
+	//
+	// And for the cgroup filter, the cgroups are listed before the mode is
+	// set so that no task is filtered by an incomplete list
+	//
+	for(uint64_t cgroup_id : m_cgroup_filter)
+	{
+		set_cgroup_filter(cgroup_id, true);
+	}
+	if(m_cgroup_filter_mode != PPM_CGROUP_FILTER_NONE)
+	{
+		set_cgroup_filter_mode(m_cgroup_filter_mode);
+	}
+
 	//
 	// If the port range for increased snaplen was modified, set it now
 	//
@@ -469,15 +561,43 @@ void sinsp::open_common(scap_open_args* oargs)
 	// scap starts scanning proc.
 	m_usergroup_manager.subscribe_container_mgr();
 
+	// The restored containers must be there before scap scans proc
+	scap_t* state_snapshot = nullptr;
+	if(oargs->mode == SCAP_MODE_LIVE)
+	{
+		m_container_manager.load_snapshot();
+
+		// The users and groups of the containers found by the scan
+		// are read all at once by init()
+		m_usergroup_manager.begin_proc_scan();
+
+		// A valid state snapshot replaces the scan
+		state_snapshot = open_state_snapshot(oargs);
+		oargs->proc_scan_skip = state_snapshot != nullptr;
+	}
+
 	add_suppressed_comms(oargs);
 
 	oargs->debug_log_fn = &sinsp_scap_debug_log_fn;
 	oargs->proc_scan_timeout_ms = m_proc_scan_timeout_ms;
 	oargs->proc_scan_log_interval_ms = m_proc_scan_log_interval_ms;
+	oargs->proc_scan_threads = m_proc_scan_threads;
+	oargs->proc_scan_spill_bytes = m_proc_scan_spill_bytes;
+	oargs->proc_scan_lazy_fds = m_lazy_fd_scan;
+	oargs->ringbuffer_merge_mode = m_ringbuffer_merge_mode;
+	oargs->ringbuffer_consume_chunk_b = m_ringbuffer_consume_chunk_b;
+	oargs->ringbuffer_wakeup = m_ringbuffer_wakeup;
+	oargs->ringbuffer_empty_threshold_b = m_ringbuffer_empty_threshold_b;
+	oargs->ringbuffer_empty_wait_max_us = m_ringbuffer_empty_wait_max_us;
+	oargs->ringbuffer_wakeup_watermark_b = m_ringbuffer_wakeup_watermark_b;
 
 	m_h = scap_alloc();
 	if(m_h == NULL)
 	{
+		if(state_snapshot != nullptr)
+		{
+			scap_close(state_snapshot);
+		}
 		throw scap_open_exception("failed to allocate scap handle", SCAP_FAILURE);
 	}
 
@@ -487,10 +607,45 @@ void sinsp::open_common(scap_open_args* oargs)
 		std::string error = scap_getlasterr(m_h);
 		scap_close(m_h);
 		m_h = NULL;
+		if(state_snapshot != nullptr)
+		{
+			scap_close(state_snapshot);
+		}
 		throw scap_open_exception(error, scap_rc);
 	}
 
+	if(state_snapshot != nullptr)
+	{
+		restore_state_snapshot(state_snapshot);
+		scap_close(state_snapshot);
+	}
+
 	init();
+
+	// Settle the capture thread before the first next()
+	libsinsp::thread_placement::apply(libsinsp::thread_placement::thread_class::CAPTURE);
+
+	try
+	{
+		open_plugin_sources();
+	}
+	catch(...)
+	{
+		close();
+		throw;
+	}
+}
+
+void sinsp::open_plugin_sources()
+{
+	for(auto& src : m_plugin_sources)
+	{
+		if(m_mode == SCAP_MODE_PLUGIN && src->plugin() == m_input_plugin)
+		{
+			throw sinsp_exception("plugin " + src->plugin()->name() + " is already the input plugin of the capture.");
+		}
+		src->open();
+	}
 }
 
 scap_open_args sinsp::factory_open_args(const char* engine_name, scap_mode_t scap_mode)
@@ -517,11 +672,67 @@ void sinsp::mark_ppm_sc_of_interest(ppm_sc_code ppm_sc, bool enable)
 	{
 		throw sinsp_exception(scap_getlasterr(m_h));
 	}
+
+	if (enable)
+	{
+		m_ppm_sc_of_interest.insert(ppm_sc);
+	}
+	else
+	{
+		m_ppm_sc_of_interest.remove(ppm_sc);
+	}
 }
 
 
-static void fill_ppm_sc_of_interest(scap_open_args *oargs, const libsinsp::events::set<ppm_sc_code> &ppm_sc_of_interest)
+void sinsp::set_ppm_sc_of_interest(const libsinsp::events::set<ppm_sc_code>& ppm_sc_of_interest)
+{
+	/* This API must be used only after the initialization phase. */
+	if (!m_inited)
+	{
+		throw sinsp_exception("you cannot use this method before opening the inspector!");
+	}
+
+	libsinsp::events::set<ppm_sc_code> new_set = ppm_sc_of_interest;
+	if (new_set.empty())
+	{
+		for (int i = 0; i < PPM_SC_MAX; i++)
+		{
+			new_set.insert((ppm_sc_code)i);
+		}
+	}
+
+	/* Apply only the differences, reverting them all if one fails. */
+	std::vector<std::pair<ppm_sc_code, bool>> changes;
+	new_set.diff(m_ppm_sc_of_interest).for_each([&changes](ppm_sc_code ppm_sc)
+	{
+		changes.push_back({ppm_sc, true});
+		return true;
+	});
+	m_ppm_sc_of_interest.diff(new_set).for_each([&changes](ppm_sc_code ppm_sc)
+	{
+		changes.push_back({ppm_sc, false});
+		return true;
+	});
+
+	for (size_t i = 0; i < changes.size(); i++)
+	{
+		if (scap_set_ppm_sc(m_h, changes[i].first, changes[i].second) != SCAP_SUCCESS)
+		{
+			std::string err = scap_getlasterr(m_h);
+			while (i-- > 0)
+			{
+				scap_set_ppm_sc(m_h, changes[i].first, !changes[i].second);
+			}
+			throw sinsp_exception(err);
+		}
+	}
+
+	m_ppm_sc_of_interest = new_set;
+}
+
+static void fill_ppm_sc_of_interest(scap_open_args *oargs, const libsinsp::events::set<ppm_sc_code> &ppm_sc_of_interest, libsinsp::events::set<ppm_sc_code> &enabled)
 {
+	enabled.clear();
 	for (int i = 0; i < PPM_SC_MAX; i++)
 	{
 		/* If the set is empty, fallback to all interesting syscalls */
@@ -533,6 +744,11 @@ static void fill_ppm_sc_of_interest(scap_open_args *oargs, const libsinsp::event
 		{
 			oargs->ppm_sc_of_interest.ppm_sc[i] = ppm_sc_of_interest.contains((ppm_sc_code)i);
 		}
+
+		if (oargs->ppm_sc_of_interest.ppm_sc[i])
+		{
+			enabled.insert((ppm_sc_code)i);
+		}
 	}
 }
 
@@ -541,11 +757,12 @@ void sinsp::open_kmod(unsigned long driver_buffer_bytes_dim, const libsinsp::eve
 	scap_open_args oargs = factory_open_args(KMOD_ENGINE, SCAP_MODE_LIVE);
 
 	/* Set interesting syscalls and tracepoints. */
-	fill_ppm_sc_of_interest(&oargs, ppm_sc_of_interest);
+	fill_ppm_sc_of_interest(&oargs, ppm_sc_of_interest, m_ppm_sc_of_interest);
 
 	/* Engine-specific args. */
 	struct scap_kmod_engine_params params;
 	params.buffer_bytes_dim = driver_buffer_bytes_dim;
+	m_driver_buffer_bytes_dim = driver_buffer_bytes_dim;
 	oargs.engine_params = &params;
 	open_common(&oargs);
 }
@@ -561,11 +778,12 @@ void sinsp::open_bpf(const std::string& bpf_path, unsigned long driver_buffer_by
 	scap_open_args oargs = factory_open_args(BPF_ENGINE, SCAP_MODE_LIVE);
 
 	/* Set interesting syscalls and tracepoints. */
-	fill_ppm_sc_of_interest(&oargs, ppm_sc_of_interest);
+	fill_ppm_sc_of_interest(&oargs, ppm_sc_of_interest, m_ppm_sc_of_interest);
 
 	/* Engine-specific args. */
 	struct scap_bpf_engine_params params;
 	params.buffer_bytes_dim = driver_buffer_bytes_dim;
+	m_driver_buffer_bytes_dim = driver_buffer_bytes_dim;
 	params.bpf_probe = bpf_path.data();
 	oargs.engine_params = &params;
 	open_common(&oargs);
@@ -577,11 +795,12 @@ void sinsp::open_udig()
 	open_common(&oargs);
 }
 
-void sinsp::open_nodriver(bool full_proc_scan)
+void sinsp::open_nodriver(bool full_proc_scan, bool proc_connector)
 {
 	scap_open_args oargs = factory_open_args(NODRIVER_ENGINE, SCAP_MODE_NODRIVER);
 	struct scap_nodriver_engine_params params;
 	params.full_proc_scan = full_proc_scan;
+	params.proc_connector = proc_connector;
 
 	oargs.engine_params = &params;
 	open_common(&oargs);
@@ -622,6 +841,7 @@ void sinsp::open_savefile(const std::string& filename, int fd)
 
 	params.start_offset = 0;
 	params.fbuffer_size = 0;
+	params.decompression_threads = m_savefile_decompression_threads;
 	oargs.engine_params = &params;
 	open_common(&oargs);
 }
@@ -633,6 +853,7 @@ void sinsp::open_plugin(const std::string& plugin_name, const std::string& plugi
 	set_input_plugin(plugin_name, plugin_open_params);
 	params.input_plugin = &m_input_plugin->as_scap_source();
 	params.input_plugin_params = (char*)m_input_plugin_open_params.c_str();
+	params.input_plugin_prefetch = m_input_plugin_prefetch;
 	oargs.engine_params = &params;
 	open_common(&oargs);
 }
@@ -649,6 +870,11 @@ void sinsp::open_gvisor(const std::string& config_path, const std::string& root_
 	params.gvisor_root_path = root_path.c_str();
 	params.gvisor_config_path = config_path.c_str();
 	params.no_events = no_events;
+	params.parse_threads = m_gvisor_parse_threads;
+	params.thread_start_fn = [](enum scap_gvisor_thread)
+	{
+		libsinsp::thread_placement::apply(libsinsp::thread_placement::thread_class::GVISOR);
+	};
 	oargs.engine_params = &params;
 	open_common(&oargs);
 
@@ -660,13 +886,19 @@ void sinsp::open_modern_bpf(unsigned long driver_buffer_bytes_dim, uint16_t cpus
 	scap_open_args oargs = factory_open_args(MODERN_BPF_ENGINE, SCAP_MODE_LIVE);
 
 	/* Set interesting syscalls and tracepoints. */
-	fill_ppm_sc_of_interest(&oargs, ppm_sc_of_interest);
+	fill_ppm_sc_of_interest(&oargs, ppm_sc_of_interest, m_ppm_sc_of_interest);
 
 	/* Engine-specific args. */
 	struct scap_modern_bpf_engine_params params;
 	params.buffer_bytes_dim = driver_buffer_bytes_dim;
+	m_driver_buffer_bytes_dim = driver_buffer_bytes_dim;
 	params.cpus_for_each_buffer = cpus_for_each_buffer;
 	params.allocate_online_only = online_only;
+	params.numa_aware = m_modern_bpf_numa_aware;
+	params.io_aggregation_period_ms = m_modern_bpf_io_aggregation_period_ms;
+	params.task_aggregation_period_ms = m_modern_bpf_task_aggregation_period_ms;
+	params.prog_budget_ns = m_modern_bpf_prog_budget_ns;
+	params.string_interning = m_modern_bpf_string_interning;
 	params.verbose = g_logger.has_output() && g_logger.is_enabled(sinsp_logger::severity::SEV_DEBUG);
 	oargs.engine_params = &params;
 	open_common(&oargs);
@@ -683,6 +915,16 @@ void sinsp::open_test_input(scap_test_input_data* data)
 	set_get_procs_cpu_from_driver(false);
 }
 
+void sinsp::open_synthetic(const scap_synthetic_engine_params& params)
+{
+	scap_open_args oargs = factory_open_args(SYNTHETIC_ENGINE, SCAP_MODE_TEST);
+	struct scap_synthetic_engine_params engine_params = params;
+	oargs.engine_params = &engine_params;
+	open_common(&oargs);
+
+	set_get_procs_cpu_from_driver(false);
+}
+
 /*=============================== OPEN METHODS ===============================*/
 
 /*=============================== Engine related ===============================*/
@@ -781,6 +1023,28 @@ std::string sinsp::get_error_desc(const std::string& msg)
 
 void sinsp::close()
 {
+	m_lazy_fd_loader->stop();
+
+	for(const auto& p : m_async_extract_plugins)
+	{
+		auto async = p->async_extractor();
+		if(async != nullptr)
+		{
+			async->cancel();
+		}
+	}
+
+	for(auto& src : m_plugin_sources)
+	{
+		src->close();
+	}
+
+	if(m_h && is_live())
+	{
+		m_container_manager.save_snapshot();
+		save_state_snapshot();
+	}
+
 	if(m_h)
 	{
 		scap_close(m_h);
@@ -793,6 +1057,11 @@ void sinsp::close()
 		m_dumper.reset(nullptr);
 	}
 
+	if(m_dumper_closer != nullptr)
+	{
+		m_dumper_closer->wait_all();
+	}
+
 	m_is_dumping = false;
 
 	deinit_state();
@@ -817,6 +1086,13 @@ void sinsp::deinit_state()
 	}
 
 	m_thread_manager->clear();
+	m_event_coalescer.reset();
+	m_event_reorderer.reset();
+
+	if(m_connection_table)
+	{
+		m_connection_table->clear();
+	}
 }
 
 void sinsp::autodump_start(const std::string& dump_filename, bool compress)
@@ -826,20 +1102,36 @@ void sinsp::autodump_start(const std::string& dump_filename, bool compress)
 		throw sinsp_exception("inspector not opened yet");
 	}
 
+	autodump_open(dump_filename, compress, false);
+}
+
+void sinsp::autodump_open(const std::string& dump_filename, bool compress, bool threads_from_sinsp)
+{
 	std::unique_ptr<sinsp_dumper> dumper(new sinsp_dumper);
 
+	// Set before opening, so that the state at the beginning of the file
+	// is compressed and written by the background thread as well: with
+	// large thread tables, writing it used to stall every file rotation
+	if(m_autodump_async_bufsize != 0)
+	{
+		dumper->enable_async(m_autodump_async_bufsize, m_autodump_async_nbufs);
+	}
+
+	dumper->enable_minimal_state(m_isminimal_state_dump_enabled);
+
 	if(compress)
 	{
-		dumper->open(this, dump_filename.c_str(), SCAP_COMPRESSION_GZIP, false);
+		dumper->open(this, dump_filename.c_str(), SCAP_COMPRESSION_GZIP, threads_from_sinsp);
 	}
 	else
 	{
-		dumper->open(this, dump_filename.c_str(), SCAP_COMPRESSION_NONE, false);
+		dumper->open(this, dump_filename.c_str(), SCAP_COMPRESSION_NONE, threads_from_sinsp);
 	}
 
 	m_is_dumping = true;
 
 	m_dumper = std::move(dumper);
+	m_dumper_filename = dump_filename;
 
 	m_container_manager.dump_containers(*m_dumper);
 
@@ -848,8 +1140,35 @@ void sinsp::autodump_start(const std::string& dump_filename, bool compress)
 
 void sinsp::autodump_next_file()
 {
-	autodump_stop();
-	autodump_start(m_cycle_writer->get_current_file_name(), m_compress);
+	if(!m_autodump_background_rotation)
+	{
+		autodump_stop();
+		autodump_start(m_cycle_writer->get_current_file_name(), m_compress);
+		return;
+	}
+
+	if(NULL == m_h)
+	{
+		throw sinsp_exception("inspector not opened yet");
+	}
+
+	if(m_dumper_closer == nullptr)
+	{
+		m_dumper_closer.reset(new sinsp_dumper_closer());
+	}
+
+	if(m_dumper != nullptr)
+	{
+		m_autodump_dropped_events += m_dumper->dropped_events();
+		m_dumper_closer->close(std::move(m_dumper), m_dumper_filename);
+	}
+
+	// The cycle writer reuses the names when it has a file limit
+	std::string filename = m_cycle_writer->get_current_file_name();
+	m_dumper_closer->wait(filename);
+
+	// The thread table is up to date, unlike the one of scap
+	autodump_open(filename, m_compress, true);
 }
 
 void sinsp::autodump_stop()
@@ -861,13 +1180,40 @@ void sinsp::autodump_stop()
 
 	if(m_dumper != NULL)
 	{
+		m_autodump_dropped_events += m_dumper->dropped_events();
 		m_dumper->close();
 		m_dumper = NULL;
 	}
 
+	if(m_dumper_closer != nullptr)
+	{
+		m_dumper_closer->wait_all();
+	}
+
 	m_is_dumping = false;
 }
 
+void sinsp::set_autodump_async(uint32_t bufsize, uint32_t nbufs)
+{
+	m_autodump_async_bufsize = bufsize;
+	m_autodump_async_nbufs = nbufs;
+}
+
+void sinsp::set_autodump_background_rotation(bool enable)
+{
+	m_autodump_background_rotation = enable;
+}
+
+uint64_t sinsp::get_autodump_dropped_events() const
+{
+	uint64_t res = m_autodump_dropped_events;
+	if(m_dumper != nullptr)
+	{
+		res += m_dumper->dropped_events();
+	}
+	return res;
+}
+
 void sinsp::on_new_entry_from_proc(void* context,
 								   int64_t tid,
 								   scap_threadinfo* tinfo,
@@ -914,6 +1260,14 @@ void sinsp::on_new_entry_from_proc(void* context,
 		if (!thread_added) {
 			delete newti;
 		}
+		else if(m_lazy_fd_scan && tinfo->tid == tinfo->pid)
+		{
+			//
+			// The scan skipped the fds, load them when they are needed
+			//
+			newti->m_fdtable.set_lazy_load_pending();
+			m_lazy_fd_loader->request(tid);
+		}
 	}
 	else
 	{
@@ -969,6 +1323,142 @@ void sinsp::import_thread_table()
 	}
 }
 
+scap_t* sinsp::open_state_snapshot(const scap_open_args* oargs)
+{
+	//
+	// gVisor doesn't scan the /proc of the host, so there's nothing to
+	// replace
+	//
+	if(m_state_snapshot_path.empty() || strcmp(oargs->engine_name, GVISOR_ENGINE) == 0)
+	{
+		return nullptr;
+	}
+
+	struct stat st;
+	if(stat(m_state_snapshot_path.c_str(), &st) != 0)
+	{
+		// First run, or the file was removed: scan /proc
+		return nullptr;
+	}
+
+	scap_open_args snapshot_oargs = factory_open_args(SAVEFILE_ENGINE, SCAP_MODE_CAPTURE);
+	struct scap_savefile_engine_params params = {};
+	params.fname = m_state_snapshot_path.c_str();
+	snapshot_oargs.engine_params = &params;
+
+	scap_t* snapshot = scap_alloc();
+	if(snapshot == NULL)
+	{
+		return nullptr;
+	}
+
+	if(scap_init(snapshot, &snapshot_oargs) != SCAP_SUCCESS)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"Ignoring invalid state snapshot %s: %s",
+				m_state_snapshot_path.c_str(), scap_getlasterr(snapshot));
+		scap_close(snapshot);
+		return nullptr;
+	}
+
+	//
+	// The threads of another boot have nothing to do with the running
+	// ones
+	//
+	char error[SCAP_LASTERR_SIZE];
+	uint64_t boot_time = 0;
+	const scap_machine_info* machine_info = scap_get_machine_info(snapshot);
+	if(machine_info == NULL ||
+	   scap_get_boot_time(error, &boot_time) != SCAP_SUCCESS ||
+	   machine_info->boot_ts_epoch != boot_time)
+	{
+		g_logger.format(sinsp_logger::SEV_INFO,
+				"Ignoring state snapshot %s from another boot",
+				m_state_snapshot_path.c_str());
+		scap_close(snapshot);
+		return nullptr;
+	}
+
+	return snapshot;
+}
+
+void sinsp::restore_state_snapshot(scap_t* snapshot)
+{
+	scap_threadinfo *pi;
+	scap_threadinfo *tpi;
+	uint32_t n = 0;
+
+	scap_threadinfo *table = scap_get_proc_table(snapshot);
+
+	HASH_ITER(hh, table, pi, tpi)
+	{
+		sinsp_threadinfo* newti = build_threadinfo();
+		newti->init(pi);
+		if(m_thread_manager->add_thread(newti, true))
+		{
+			n++;
+		}
+		else
+		{
+			delete newti;
+		}
+	}
+
+	//
+	// Check the restored threads against /proc right away, rather than
+	// after the purge interval
+	//
+	m_thread_manager->schedule_purge();
+
+	g_logger.format(sinsp_logger::SEV_INFO,
+			"Restored %u threads from %s",
+			n, m_state_snapshot_path.c_str());
+}
+
+void sinsp::save_state_snapshot()
+{
+	if(m_state_snapshot_path.empty() || check_current_engine(GVISOR_ENGINE))
+	{
+		return;
+	}
+
+	//
+	// Write a temporary file and rename it, so that a crash while
+	// saving doesn't leave a truncated snapshot behind
+	//
+	std::string tmp_path = m_state_snapshot_path + ".tmp";
+	scap_dumper_t* dumper = scap_dump_open(m_h, tmp_path.c_str(), SCAP_COMPRESSION_NONE, true);
+	if(dumper == NULL)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"Unable to write the state snapshot %s: %s",
+				tmp_path.c_str(), scap_getlasterr(m_h));
+		return;
+	}
+
+	try
+	{
+		m_thread_manager->dump_threads_to_file(dumper);
+	}
+	catch(const sinsp_exception& e)
+	{
+		scap_dump_close(dumper);
+		unlink(tmp_path.c_str());
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"Unable to write the state snapshot %s: %s",
+				tmp_path.c_str(), e.what());
+		return;
+	}
+	scap_dump_close(dumper);
+
+	if(rename(tmp_path.c_str(), m_state_snapshot_path.c_str()) != 0)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"Unable to save the state snapshot %s: %s",
+				m_state_snapshot_path.c_str(), strerror(errno));
+	}
+}
+
 void sinsp::import_ifaddr_list()
 {
 	m_network_interfaces = new sinsp_network_interfaces(this);
@@ -1099,23 +1589,171 @@ void sinsp::restart_capture()
 	m_nevts = nevts;
 }
 
-uint64_t sinsp::max_buf_used()
+bool sinsp::restore_checkpoint(uint64_t ts)
 {
-	if(m_h)
+	if(m_h == NULL)
 	{
-		return scap_max_buf_used(m_h);
+		throw sinsp_exception("inspector not opened yet");
 	}
-	else
+
+	// Save state info that could be lost during de-initialization
+	uint64_t nevts = m_nevts;
+
+	// The replayed event, the coalesced runs and the buffered events
+	// belong to the old position
+	m_replay_scap_evt = NULL;
+	m_event_coalescer.reset();
+	m_event_reorderer.reset();
+
+	int32_t res = scap_fseek_checkpoint(m_h, ts);
+	if(res == SCAP_NOT_SUPPORTED)
 	{
-		return 0;
+		return false;
 	}
-}
-
-void sinsp::get_procs_cpu_from_driver(uint64_t ts)
-{
-	if(ts <= m_next_flush_time_ns)
+	else if(res != SCAP_SUCCESS)
 	{
-		return;
+		throw sinsp_exception(std::string("scap error: ") + scap_getlasterr(m_h));
+	}
+
+	// scap has loaded the state of the checkpoint, rebuild ours from it
+	deinit_state();
+	init();
+
+	m_nevts = nevts;
+	return true;
+}
+
+bool sinsp::seek_to_timestamp(uint64_t ts)
+{
+	if(m_h == NULL)
+	{
+		throw sinsp_exception("inspector not opened yet");
+	}
+
+	if(restore_checkpoint(ts))
+	{
+		//
+		// Parse the events between the checkpoint and ts, and leave the
+		// first one not older than ts to be returned by next()
+		//
+		while(true)
+		{
+			if(m_replay_scap_evt == NULL)
+			{
+				scap_evt* pevent;
+				uint16_t cpuid;
+				int32_t res = scap_next(m_h, &pevent, &cpuid);
+				if(res == SCAP_EOF)
+				{
+					break;
+				}
+				else if(res == SCAP_UNEXPECTED_BLOCK)
+				{
+					restart_capture();
+					continue;
+				}
+				else if(res == SCAP_TIMEOUT || res == SCAP_FILTERED_EVENT)
+				{
+					continue;
+				}
+				else if(res != SCAP_SUCCESS)
+				{
+					throw sinsp_exception(std::string("scap error: ") + scap_getlasterr(m_h));
+				}
+				m_replay_scap_evt = pevent;
+				m_replay_scap_cpuid = cpuid;
+			}
+
+			if(m_replay_scap_evt->ts >= ts)
+			{
+				break;
+			}
+
+			sinsp_evt* evt;
+			int32_t res = next(&evt);
+			if(res != SCAP_SUCCESS && res != SCAP_TIMEOUT && res != SCAP_FILTERED_EVENT)
+			{
+				throw sinsp_exception(getlasterr());
+			}
+		}
+		return true;
+	}
+
+	int32_t res = scap_fseek_ts(m_h, ts);
+	if(res == SCAP_NOT_SUPPORTED)
+	{
+		return false;
+	}
+	else if(res != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(std::string("scap error: ") + scap_getlasterr(m_h));
+	}
+	return true;
+}
+
+bool sinsp::set_read_filter(const libsinsp::events::set<ppm_event_code>& event_types, uint64_t ts_min, uint64_t ts_max)
+{
+	if(m_h == NULL)
+	{
+		throw sinsp_exception("inspector not opened yet");
+	}
+
+	int32_t res = scap_set_read_filter(m_h, event_types.data(), ts_min, ts_max);
+	if(res == SCAP_NOT_SUPPORTED)
+	{
+		return false;
+	}
+	else if(res != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(std::string("scap error: ") + scap_getlasterr(m_h));
+	}
+	return true;
+}
+
+bool sinsp::get_event_index(std::vector<std::pair<uint64_t, uint64_t>>& index)
+{
+	if(m_h == NULL)
+	{
+		throw sinsp_exception("inspector not opened yet");
+	}
+
+	const evt_index_entry* entries;
+	uint64_t n_entries;
+	int32_t res = scap_get_event_index(m_h, &entries, &n_entries);
+	if(res == SCAP_NOT_SUPPORTED)
+	{
+		return false;
+	}
+	else if(res != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(std::string("scap error: ") + scap_getlasterr(m_h));
+	}
+
+	index.clear();
+	for(uint64_t j = 0; j < n_entries; j++)
+	{
+		index.emplace_back(entries[j].ts, entries[j].offset);
+	}
+	return n_entries != 0;
+}
+
+uint64_t sinsp::max_buf_used()
+{
+	if(m_h)
+	{
+		return scap_max_buf_used(m_h);
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+void sinsp::get_procs_cpu_from_driver(uint64_t ts)
+{
+	if(ts <= m_next_flush_time_ns)
+	{
+		return;
 	}
 
 	uint64_t next_full_second = ts - (ts % ONE_SECOND_IN_NS) + ONE_SECOND_IN_NS;
@@ -1154,9 +1792,158 @@ void sinsp::get_procs_cpu_from_driver(uint64_t ts)
 }
 
 int32_t sinsp::next(OUT sinsp_evt **puevt)
+{
+	return next_into(NULL, true, puevt);
+}
+
+//
+// The state maintenance that doesn't belong to a specific event. next()
+// runs it before every event, next_batch() once per batch.
+//
+void sinsp::housekeeping(uint64_t ts)
+{
+	if(m_lag_monitor.is_enabled() && is_live())
+	{
+		m_lag_monitor.on_event(ts);
+	}
+
+	if (m_automatic_threadtable_purging)
+	{
+		//
+		// Delayed removal of threads from the thread table, so that
+		// things like exit() or close() can be parsed.
+		//
+		// Note: remove_thread() may itself identify another thread that
+		// needs removal. The threads that exited during the last batch
+		// follow, unless their tid has been reused since, see next_batch().
+		size_t exited = 0;
+		while (m_tid_to_remove != -1 || exited < m_batch_exited_threads.size())
+		{
+			if(m_tid_to_remove == -1)
+			{
+				threadinfo_map_t::ptr_t tinfo = m_batch_exited_threads[exited++].lock();
+				if(tinfo == nullptr || find_thread(tinfo->m_tid, true) != tinfo)
+				{
+					continue;
+				}
+				m_tid_to_remove = tinfo->m_tid;
+			}
+
+			uint64_t remove_tid = m_tid_to_remove;
+			m_tid_to_remove = -1;
+			remove_thread(remove_tid, false);
+		}
+		m_batch_exited_threads.clear();
+
+		if(!is_offline())
+		{
+			m_thread_manager->remove_inactive_threads();
+		}
+	}
+
+	//
+	// The fds over their memory budget are evicted between two events,
+	// see set_state_eviction()
+	//
+	m_thread_manager->evict_requested_fds();
+
+	m_state_views.on_event(this, ts);
+
+#ifndef HAS_ANALYZER
+
+	if(is_debug_enabled() && is_live())
+	{
+		if(ts > m_next_stats_print_time_ns)
+		{
+			if(m_next_stats_print_time_ns)
+			{
+				scap_stats stats;
+				get_capture_stats(&stats);
+
+				g_logger.format(sinsp_logger::SEV_DEBUG,
+					"n_evts:%" PRIu64
+					" n_drops:%" PRIu64
+					" n_drops_buffer:%" PRIu64
+					" n_drops_buffer_clone_fork_enter:%" PRIu64
+					" n_drops_buffer_clone_fork_exit:%" PRIu64
+					" n_drops_buffer_execve_enter:%" PRIu64
+					" n_drops_buffer_execve_exit:%" PRIu64
+					" n_drops_buffer_connect_enter:%" PRIu64
+					" n_drops_buffer_connect_exit:%" PRIu64
+					" n_drops_buffer_open_enter:%" PRIu64
+					" n_drops_buffer_open_exit:%" PRIu64
+					" n_drops_buffer_dir_file_enter:%" PRIu64
+					" n_drops_buffer_dir_file_exit:%" PRIu64
+					" n_drops_buffer_other_interest_enter:%" PRIu64
+					" n_drops_buffer_other_interest_exit:%" PRIu64
+					" n_drops_scratch_map:%" PRIu64
+					" n_drops_pf:%" PRIu64
+					" n_drops_bug:%" PRIu64,
+					stats.n_evts,
+					stats.n_drops,
+					stats.n_drops_buffer,
+					stats.n_drops_buffer_clone_fork_enter,
+					stats.n_drops_buffer_clone_fork_exit,
+					stats.n_drops_buffer_execve_enter,
+					stats.n_drops_buffer_execve_exit,
+					stats.n_drops_buffer_connect_enter,
+					stats.n_drops_buffer_connect_exit,
+					stats.n_drops_buffer_open_enter,
+					stats.n_drops_buffer_open_exit,
+					stats.n_drops_buffer_dir_file_enter,
+					stats.n_drops_buffer_dir_file_exit,
+					stats.n_drops_buffer_other_interest_enter,
+					stats.n_drops_buffer_other_interest_exit,
+					stats.n_drops_scratch_map,
+					stats.n_drops_pf,
+					stats.n_drops_bug);
+			}
+
+			m_next_stats_print_time_ns = ts - (ts % ONE_SECOND_IN_NS) + ONE_SECOND_IN_NS;
+		}
+	}
+
+#ifndef _WIN32
+	if(m_adaptive_sampling && is_live() && ts >= m_next_sampling_check_ns)
+	{
+		update_adaptive_sampling(ts);
+	}
+
+	if(m_adaptive_snaplen && is_live() && ts >= m_next_snaplen_check_ns)
+	{
+		update_adaptive_snaplen(ts);
+	}
+#endif
+
+	//
+	// Run the periodic connection, thread and users/groups table cleanup
+	//
+	if(!is_offline())
+	{
+		m_container_manager.remove_inactive_containers();
+
+#if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
+		update_k8s_state();
+
+		if(m_mesos_client)
+		{
+			update_mesos_state();
+		}
+
+		m_usergroup_manager.clear_host_users_groups();
+#endif // !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
+	}
+#endif // HAS_ANALYZER
+}
+
+int32_t sinsp::next_into(batch_slot* slot, bool run_housekeeping, OUT sinsp_evt **puevt)
 {
 	sinsp_evt* evt;
 	int32_t res;
+	event_coalescer::action coalesce = event_coalescer::DELIVER;
+
+	m_latency_profiler.begin_event();
+	uint64_t next_start_ns = m_latency_profiler.start();
 
 	//
 	// Check if there are fake cpu events to  events
@@ -1181,7 +1968,7 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 #endif
 	else
 	{
-		evt = &m_evt;
+		evt = slot != NULL ? &slot->m_evt : &m_evt;
 
 		//
 		// Reset previous event's decoders if required
@@ -1200,6 +1987,7 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		//
 		// Get the event from libscap
 		//
+		bool replayed = false;
 		if (m_replay_scap_evt != NULL)
 		{
 			// Replay the last event, if we saved one
@@ -1207,12 +1995,40 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 			evt->m_pevt = m_replay_scap_evt;
 			evt->m_cpuid = m_replay_scap_cpuid;
 			m_replay_scap_evt = NULL;
+			replayed = true;
 		}
 		else 
 		{
 			// If no last event was saved, invoke
 			// the actual scap_next
+			uint64_t scap_start_ns = m_latency_profiler.start();
 			res = scap_next(m_h, &(evt->m_pevt), &(evt->m_cpuid));
+			if(res == SCAP_SUCCESS)
+			{
+				m_latency_profiler.stop(latency_profiler::STAGE_SCAP, evt->m_pevt->type, scap_start_ns);
+			}
+
+			if(m_prefetch_distance != 0 && res == SCAP_SUCCESS)
+			{
+				scap_evt* upcoming = scap_peek(m_h, evt->m_cpuid, m_prefetch_distance);
+				if(upcoming != NULL)
+				{
+					m_parser->prefetch(upcoming);
+				}
+			}
+		}
+
+		if(m_event_reorderer.get_window() != 0)
+		{
+			// A replayed event was already delivered in order
+			if(!replayed)
+			{
+				res = reorder_events(res, evt);
+			}
+		}
+		else if(!m_plugin_sources.empty())
+		{
+			res = merge_plugin_sources(res, evt);
 		}
 
 		if(res != SCAP_SUCCESS)
@@ -1264,6 +2080,45 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 
 			return res;
 		}
+
+		evt->m_repeat_count = 0;
+		if(m_event_coalescing)
+		{
+			coalesce = m_event_coalescer.process(evt->m_pevt, evt->m_repeat_count);
+			if(coalesce == event_coalescer::FLUSH)
+			{
+				//
+				// A run of the thread broke: deliver its last
+				// suppressed event, already parsed, and replay
+				// this one
+				//
+				ASSERT(m_replay_scap_evt == NULL);
+				m_replay_scap_evt = evt->m_pevt;
+				m_replay_scap_cpuid = evt->m_cpuid;
+
+				uint32_t repeats;
+				sinsp_evt* flushed = m_event_coalescer.flush(evt->m_pevt, repeats);
+				if(flushed == NULL)
+				{
+					return SCAP_TIMEOUT;
+				}
+				flushed->m_repeat_count = repeats;
+				m_latency_profiler.stop(latency_profiler::STAGE_NEXT, flushed->get_type(), next_start_ns);
+				*puevt = flushed;
+				return SCAP_SUCCESS;
+			}
+		}
+
+		//
+		// The events of a batch outlive the capture buffers, which are
+		// reused by the following reads. The params point into the copy.
+		//
+		if(slot != NULL)
+		{
+			const char* raw = (const char*)evt->m_pevt;
+			slot->m_raw.assign(raw, raw + evt->m_pevt->len);
+			evt->m_pevt = (scap_evt*)slot->m_raw.data();
+		}
 	}
 
 	/* Here we shouldn't receive unknown events */
@@ -1295,101 +2150,11 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 	evt->m_evtnum = m_nevts;
 	m_lastevent_ts = ts;
 
-	if (m_automatic_threadtable_purging)
-	{
-		//
-		// Delayed removal of threads from the thread table, so that
-		// things like exit() or close() can be parsed.
-		//
-		// Note: remove_thread() may itself identify another thread that
-		// needs removal.
-		while (m_tid_to_remove != -1)
-		{
-			uint64_t remove_tid = m_tid_to_remove;
-			m_tid_to_remove = -1;
-			remove_thread(remove_tid, false);
-		}
-
-		if(!is_offline())
-		{
-			m_thread_manager->remove_inactive_threads();
-		}
-	}
-
-#ifndef HAS_ANALYZER
-
-	if(is_debug_enabled() && is_live())
+	if(run_housekeeping)
 	{
-		if(ts > m_next_stats_print_time_ns)
-		{
-			if(m_next_stats_print_time_ns)
-			{
-				scap_stats stats;
-				get_capture_stats(&stats);
-
-				g_logger.format(sinsp_logger::SEV_DEBUG,
-					"n_evts:%" PRIu64
-					" n_drops:%" PRIu64
-					" n_drops_buffer:%" PRIu64
-					" n_drops_buffer_clone_fork_enter:%" PRIu64
-					" n_drops_buffer_clone_fork_exit:%" PRIu64
-					" n_drops_buffer_execve_enter:%" PRIu64
-					" n_drops_buffer_execve_exit:%" PRIu64
-					" n_drops_buffer_connect_enter:%" PRIu64
-					" n_drops_buffer_connect_exit:%" PRIu64
-					" n_drops_buffer_open_enter:%" PRIu64
-					" n_drops_buffer_open_exit:%" PRIu64
-					" n_drops_buffer_dir_file_enter:%" PRIu64
-					" n_drops_buffer_dir_file_exit:%" PRIu64
-					" n_drops_buffer_other_interest_enter:%" PRIu64
-					" n_drops_buffer_other_interest_exit:%" PRIu64
-					" n_drops_scratch_map:%" PRIu64
-					" n_drops_pf:%" PRIu64
-					" n_drops_bug:%" PRIu64,
-					stats.n_evts,
-					stats.n_drops,
-					stats.n_drops_buffer,
-					stats.n_drops_buffer_clone_fork_enter,
-					stats.n_drops_buffer_clone_fork_exit,
-					stats.n_drops_buffer_execve_enter,
-					stats.n_drops_buffer_execve_exit,
-					stats.n_drops_buffer_connect_enter,
-					stats.n_drops_buffer_connect_exit,
-					stats.n_drops_buffer_open_enter,
-					stats.n_drops_buffer_open_exit,
-					stats.n_drops_buffer_dir_file_enter,
-					stats.n_drops_buffer_dir_file_exit,
-					stats.n_drops_buffer_other_interest_enter,
-					stats.n_drops_buffer_other_interest_exit,
-					stats.n_drops_scratch_map,
-					stats.n_drops_pf,
-					stats.n_drops_bug);
-			}
-
-			m_next_stats_print_time_ns = ts - (ts % ONE_SECOND_IN_NS) + ONE_SECOND_IN_NS;
-		}
+		housekeeping(ts);
 	}
 
-	//
-	// Run the periodic connection, thread and users/groups table cleanup
-	//
-	if(!is_offline())
-	{
-		m_container_manager.remove_inactive_containers();
-
-#if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
-		update_k8s_state();
-
-		if(m_mesos_client)
-		{
-			update_mesos_state();
-		}
-
-		m_usergroup_manager.clear_host_users_groups();
-#endif // !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
-	}
-#endif // HAS_ANALYZER
-
 	//
 	// Delayed removal of the fd, so that
 	// things like exit() or close() can be parsed.
@@ -1398,7 +2163,7 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 
 	if(nfdr != 0)
 	{
-		sinsp_threadinfo* ptinfo = get_thread_ref(m_tid_of_fd_to_remove, true, true).get();
+		sinsp_threadinfo* ptinfo = get_thread(m_tid_of_fd_to_remove, true, true);
 		if(!ptinfo)
 		{
 			ASSERT(false);
@@ -1440,7 +2205,9 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		return SCAP_TIMEOUT;
 	}
 #else
+	uint64_t parse_start_ns = m_latency_profiler.start();
 	m_parser->process_event(evt);
+	m_latency_profiler.stop(latency_profiler::STAGE_PARSE, evt->get_type(), parse_start_ns);
 #endif
 
 	// run plugin-implemented parsers
@@ -1449,9 +2216,16 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 	// event for state updates. Sinsp understands this through the
 	// EF_MODIFIES_STATE flag, which however is only relevant in the context of
 	// the internal implementation of libsinsp.
-	for (auto& pp : m_plugin_parsers)
+	if (m_plugin_parse_pool != nullptr)
 	{
-		pp.process_event(evt, m_event_sources);
+		m_plugin_parse_pool->process_event(m_plugin_parsers, evt, m_event_sources);
+	}
+	else
+	{
+		for (auto& pp : m_plugin_parsers)
+		{
+			pp.process_event(evt, m_event_sources);
+		}
 	}
 
 	//
@@ -1478,7 +2252,9 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 			}
 		}
 
+		uint64_t dump_start_ns = m_latency_profiler.start();
 		m_dumper->dump(evt);
+		m_latency_profiler.stop(latency_profiler::STAGE_DUMP, evt->get_type(), dump_start_ns);
 	}
 
 	if(evt->m_filtered_out)
@@ -1489,38 +2265,194 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		// mode and the category of this event is internal.
 		if(!(m_isinternal_events_enabled && (cat & EC_INTERNAL)))
 		{
+			m_latency_profiler.stop(latency_profiler::STAGE_NEXT, evt->get_type(), next_start_ns);
 			*puevt = evt;
 			return SCAP_FILTERED_EVENT;
 		}
 	}
 
 	//
-	// Run the analysis engine
+	// A repeat of the event before it, see set_event_coalescing()
+	//
+	if(coalesce == event_coalescer::SUPPRESS && m_event_coalescer.suppress(*evt))
+	{
+		res = SCAP_FILTERED_EVENT;
+	}
+	//
+	// Run the analysis engine
+	//
+	else if (m_external_event_processor)
+	{
+		m_external_event_processor->process_event(evt, libsinsp::EVENT_RETURN_NONE);
+	}
+
+	// Clean parse related event data after analyzer did its parsing too
+	m_parser->event_cleanup(evt);
+
+	//
+	// Update the last event time for this thread
+	//
+	if(evt->m_tinfo &&
+		evt->get_type() != PPME_SCHEDSWITCH_1_E &&
+		evt->get_type() != PPME_SCHEDSWITCH_6_E)
+	{
+		evt->m_tinfo->m_prevevent_ts = evt->m_tinfo->m_lastevent_ts;
+		evt->m_tinfo->m_lastevent_ts = m_lastevent_ts;
+	}
+
+	m_latency_profiler.stop(latency_profiler::STAGE_NEXT, evt->get_type(), next_start_ns);
+
+	//
+	// Done
+	//
+	*puevt = evt;
+	return res;
+}
+
+sinsp::batch_slot::batch_slot(sinsp* inspector):
+	m_evt(inspector)
+{
+}
+
+int32_t sinsp::next_batch(OUT sinsp_evt** evts, uint32_t max, OUT uint32_t* nevts)
+{
+	int32_t res = SCAP_SUCCESS;
+	sinsp_evt* evt = NULL;
+	uint32_t n = 0;
+	bool housekeeping_pending = true;
+
+	//
+	// The events of the previous batch are about to be reused
+	//
+	for(const auto& p : m_async_extract_plugins)
+	{
+		auto async = p->async_extractor();
+		if(async != nullptr)
+		{
+			async->cancel();
+		}
+	}
+
+	//
+	// The result that ended the previous batch early
+	//
+	if(m_batch_res != SCAP_SUCCESS)
+	{
+		res = m_batch_res;
+		m_batch_res = SCAP_SUCCESS;
+		*nevts = 0;
+		return res;
+	}
+
+	while(n < max)
+	{
+		if(m_batch_slots.size() <= n)
+		{
+			m_batch_slots.emplace_back(new batch_slot(this));
+		}
+
+		batch_slot* slot = m_batch_slots[n].get();
+		slot->m_evt.m_tinfo_ref.reset();
+		slot->m_evt.m_fdinfo_ref.reset();
+		delete[] slot->m_evt.m_pevt_storage;
+		slot->m_evt.m_pevt_storage = nullptr;
+
+		res = next_into(slot, housekeeping_pending, &evt);
+		housekeeping_pending = false;
+
+		//
+		// The threads can't go away while the batch points to them,
+		// their removal waits for the next batch
+		//
+		if(m_automatic_threadtable_purging && m_tid_to_remove != -1)
+		{
+			m_batch_exited_threads.push_back(find_thread(m_tid_to_remove, true));
+			m_tid_to_remove = -1;
+		}
+
+		if(res == SCAP_FILTERED_EVENT)
+		{
+			continue;
+		}
+		else if(res != SCAP_SUCCESS)
+		{
+			break;
+		}
+
+		if(evt != &slot->m_evt)
+		{
+			//
+			// Meta events, state events and the flushed runs of the
+			// coalescer live somewhere else, they're snapshotted.
+			// The event could not be snapshotted, e.g. because its
+			// thread info is not available anymore.
+			//
+			if(!sinsp_evt::clone_event(slot->m_evt, *evt))
+			{
+				continue;
+			}
+		}
+		else
+		{
+			//
+			// The thread info is kept alive, and the fd info is copied
+			// because the fd table reuses the storage of the fds
+			// closed during the batch
+			//
+			if(evt->m_tinfo != nullptr && evt->m_tinfo_ref.get() != evt->m_tinfo)
+			{
+				evt->m_tinfo_ref = find_thread(evt->m_tinfo->m_tid, true);
+				if(evt->m_tinfo_ref.get() != evt->m_tinfo)
+				{
+					continue;
+				}
+			}
+
+			if(evt->m_fdinfo != nullptr)
+			{
+				slot->m_fdinfo = *evt->m_fdinfo;
+				evt->m_fdinfo = &slot->m_fdinfo;
+			}
+		}
+
+		evts[n++] = &slot->m_evt;
+	}
+
+	//
+	// Anything else than a timeout is returned by the next call, which
+	// doesn't read any event
 	//
-	if (m_external_event_processor)
+	if(n > 0 && res != SCAP_SUCCESS && res != SCAP_TIMEOUT)
 	{
-		m_external_event_processor->process_event(evt, libsinsp::EVENT_RETURN_NONE);
+		m_batch_res = res;
 	}
 
-	// Clean parse related event data after analyzer did its parsing too
-	m_parser->event_cleanup(evt);
-
 	//
-	// Update the last event time for this thread
+	// The ancestors of the threads are cached on first use, build them
+	// now so that the consumers of the batch (e.g. the workers of a
+	// sinsp_evt_pipeline) only read them
 	//
-	if(evt->m_tinfo &&
-		evt->get_type() != PPME_SCHEDSWITCH_1_E &&
-		evt->get_type() != PPME_SCHEDSWITCH_6_E)
+	for(uint32_t j = 0; j < n; j++)
 	{
-		evt->m_tinfo->m_prevevent_ts = evt->m_tinfo->m_lastevent_ts;
-		evt->m_tinfo->m_lastevent_ts = m_lastevent_ts;
+		sinsp_threadinfo* tinfo = evts[j]->m_tinfo;
+		sinsp_threadinfo* mt = tinfo == nullptr || tinfo->is_main_thread() ? tinfo : tinfo->get_main_thread();
+		if(mt != nullptr)
+		{
+			mt->get_ancestors();
+		}
 	}
 
-	//
-	// Done
-	//
-	*puevt = evt;
-	return res;
+	for(const auto& p : m_async_extract_plugins)
+	{
+		auto async = p->async_extractor();
+		if(async != nullptr)
+		{
+			async->prefetch(evts, n);
+		}
+	}
+
+	*nevts = n;
+	return n > 0 ? SCAP_SUCCESS : res;
 }
 
 uint64_t sinsp::get_num_events()
@@ -1537,8 +2469,7 @@ uint64_t sinsp::get_num_events()
 
 sinsp_threadinfo* sinsp::find_thread_test(int64_t tid, bool lookup_only)
 {
-	// TODO: we pay the refcount manipulation price here
-	return &*find_thread(tid, lookup_only);
+	return m_thread_manager->find_thread_ptr(tid, lookup_only);
 }
 
 threadinfo_map_t::ptr_t sinsp::get_thread_ref(int64_t tid, bool query_os_if_not_found, bool lookup_only, bool main_thread)
@@ -1546,6 +2477,11 @@ threadinfo_map_t::ptr_t sinsp::get_thread_ref(int64_t tid, bool query_os_if_not_
 	return m_thread_manager->get_thread_ref(tid, query_os_if_not_found, lookup_only, main_thread);
 }
 
+sinsp_threadinfo* sinsp::get_thread(int64_t tid, bool query_os_if_not_found, bool lookup_only, bool main_thread)
+{
+	return m_thread_manager->get_thread(tid, query_os_if_not_found, lookup_only, main_thread);
+}
+
 bool sinsp::add_thread(const sinsp_threadinfo *ptinfo)
 {
 	return m_thread_manager->add_thread((sinsp_threadinfo*)ptinfo, false);
@@ -1631,6 +2567,30 @@ void sinsp::set_cri_async(bool async)
 	m_container_manager.set_cri_async(async);
 }
 
+void sinsp::set_cri_warmup(bool warmup)
+{
+	m_container_manager.set_cri_warmup(warmup);
+}
+
+void sinsp::set_cri_async_workers(uint32_t workers)
+{
+	m_container_manager.set_cri_async_workers(workers);
+}
+
+void sinsp::set_container_snapshot_file(const std::string& path)
+{
+	m_container_manager.set_snapshot_path(path);
+}
+
+void sinsp::set_state_snapshot_file(const std::string& path)
+{
+	m_state_snapshot_path = path;
+	if(!path.empty() && m_container_manager.get_snapshot_path().empty())
+	{
+		m_container_manager.set_snapshot_path(path + ".containers");
+	}
+}
+
 void sinsp::set_container_labels_max_len(uint32_t max_label_len)
 {
 	m_container_manager.set_container_labels_max_len(max_label_len);
@@ -1642,9 +2602,9 @@ void sinsp::set_snaplen(uint32_t snaplen)
 	// If set_snaplen is called before opening of the inspector,
 	// we register the value to be set after its initialization.
 	//
+	m_snaplen = snaplen;
 	if(m_h == NULL)
 	{
-		m_snaplen = snaplen;
 		return;
 	}
 
@@ -1654,6 +2614,91 @@ void sinsp::set_snaplen(uint32_t snaplen)
 	}
 }
 
+void sinsp::set_fd_type_snaplen(ppm_snaplen_fd_type fd_type, uint32_t snaplen)
+{
+	if(fd_type >= PPM_SNAPLEN_FD_MAX)
+	{
+		throw sinsp_exception("invalid fd type " + std::to_string(fd_type));
+	}
+
+	//
+	// As for set_snaplen, the value is registered if the inspector isn't
+	// open yet
+	//
+	if(m_h == NULL)
+	{
+		m_fd_type_snaplen[fd_type] = snaplen;
+		return;
+	}
+
+	if(is_live() && scap_set_fd_type_snaplen(m_h, fd_type, snaplen) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+}
+
+void sinsp::set_syscall_limit(ppm_sc_code ppm_sc, uint32_t sample_every, uint32_t max_per_sec)
+{
+	if(ppm_sc >= PPM_SC_MAX)
+	{
+		throw sinsp_exception("invalid ppm_sc " + std::to_string(ppm_sc));
+	}
+
+	//
+	// As for set_snaplen, the limit is registered if the inspector isn't
+	// open yet
+	//
+	if(m_h == NULL)
+	{
+		m_syscall_limits[ppm_sc] = {sample_every, max_per_sec};
+		return;
+	}
+
+	if(is_live() && scap_set_syscall_limit(m_h, ppm_sc, sample_every, max_per_sec) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+}
+
+void sinsp::set_cgroup_filter_mode(ppm_cgroup_filter_mode mode)
+{
+	//
+	// As for set_snaplen, the mode is registered if the inspector isn't
+	// open yet
+	//
+	if(m_h == NULL)
+	{
+		m_cgroup_filter_mode = mode;
+		return;
+	}
+
+	if(is_live() && scap_set_cgroup_filter_mode(m_h, mode) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+}
+
+void sinsp::set_cgroup_filter(uint64_t cgroup_id, bool listed)
+{
+	if(m_h == NULL)
+	{
+		if(listed)
+		{
+			m_cgroup_filter.insert(cgroup_id);
+		}
+		else
+		{
+			m_cgroup_filter.erase(cgroup_id);
+		}
+		return;
+	}
+
+	if(is_live() && scap_set_cgroup_filter(m_h, cgroup_id, listed) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+}
+
 void sinsp::set_dropfailed(bool dropfailed)
 {
 	if(is_live() && scap_set_dropfailed(m_h, dropfailed) != SCAP_SUCCESS)
@@ -1727,94 +2772,437 @@ std::shared_ptr<sinsp_plugin> sinsp::register_plugin(const std::string& filepath
 	}
 	catch(sinsp_exception const& e)
 	{
-		throw sinsp_exception("cannot register plugin " + filepath + " in inspector: " + e.what());
+		throw sinsp_exception("cannot register plugin " + filepath + " in inspector: " + e.what());
+	}
+
+	return plugin;
+}
+
+std::shared_ptr<sinsp_plugin> sinsp::register_plugin(const plugin_api* api)
+{
+	std::string errstr;
+	std::shared_ptr<sinsp_plugin> plugin = sinsp_plugin::create(api, m_table_registry, errstr);
+	if (!plugin)
+	{
+		throw sinsp_exception("cannot load plugin with custom vtable: " + errstr);
+	}
+
+	try
+	{
+		m_plugin_manager->add(plugin);
+		if (plugin->caps() & CAP_PARSING)
+		{
+			m_plugin_parsers.push_back(sinsp_plugin_parser(plugin));
+		}
+	}
+	catch(sinsp_exception const& e)
+	{
+		throw sinsp_exception("cannot register plugin with custom vtable in inspector: " + std::string(e.what()));
+	}
+
+	return plugin;
+}
+
+void sinsp::set_input_plugin(const std::string& name, const std::string& params)
+{
+	for(auto& it : m_plugin_manager->plugins())
+	{
+		if(it->name() == name)
+		{
+			if(!(it->caps() & CAP_SOURCING))
+			{
+				throw sinsp_exception("plugin " + name + " has not event sourcing capabilities and cannot be used as input.");
+			}
+			m_input_plugin = it;
+			m_input_plugin_open_params = params;
+			return;
+		}
+	}
+	throw sinsp_exception("plugin " + name + " does not exist");
+}
+
+void sinsp::add_plugin_source(const std::string& plugin_name, const std::string& plugin_open_params, uint32_t queue_size)
+{
+	if(m_h != NULL)
+	{
+		throw sinsp_exception("plugin sources must be added before opening the capture");
+	}
+
+	for(auto& it : m_plugin_manager->plugins())
+	{
+		if(it->name() == plugin_name)
+		{
+			if(!(it->caps() & CAP_SOURCING))
+			{
+				throw sinsp_exception("plugin " + plugin_name + " has not event sourcing capabilities and cannot be used as input.");
+			}
+			for(auto& src : m_plugin_sources)
+			{
+				if(src->plugin() == it)
+				{
+					throw sinsp_exception("plugin " + plugin_name + " is already a source of the inspector.");
+				}
+			}
+			m_plugin_sources.emplace_back(new sinsp_source_reader(it, plugin_open_params, queue_size));
+			return;
+		}
+	}
+	throw sinsp_exception("plugin " + plugin_name + " does not exist");
+}
+
+//
+// Picks between the event read from the capture and the oldest ones queued
+// by the plugin sources. Nothing is waited on, so the events of a source
+// that lags behind may come out of order. The event of the capture that
+// isn't picked is replayed by the next call.
+//
+int32_t sinsp::merge_plugin_sources(int32_t res, sinsp_evt* evt)
+{
+	sinsp_source_reader* first = NULL;
+	scap_evt* first_evt = NULL;
+	bool pending = false;
+	for(auto& src : m_plugin_sources)
+	{
+		bool done;
+		scap_evt* e = src->peek(done);
+		pending |= !done;
+		if(e != NULL && (first_evt == NULL || e->ts < first_evt->ts))
+		{
+			first = src.get();
+			first_evt = e;
+		}
+	}
+
+	if(first == NULL)
+	{
+		// Don't end the capture until all the sources are drained
+		return (res == SCAP_EOF && pending) ? SCAP_TIMEOUT : res;
+	}
+
+	if(res == SCAP_SUCCESS)
+	{
+		if(evt->m_pevt->ts <= first_evt->ts)
+		{
+			return res;
+		}
+		m_replay_scap_evt = evt->m_pevt;
+		m_replay_scap_cpuid = evt->m_cpuid;
+	}
+	else if(res != SCAP_TIMEOUT && res != SCAP_EOF)
+	{
+		return res;
+	}
+
+	evt->m_pevt = first->pop();
+	evt->m_cpuid = 0;
+	return SCAP_SUCCESS;
+}
+
+//
+// Buffers the event read from the capture and the ones queued by the plugin
+// sources, and returns the oldest buffered one once it's out of the
+// reordering window. SCAP_EOF is only returned when all the inputs are
+// drained.
+//
+int32_t sinsp::reorder_events(int32_t res, sinsp_evt* evt)
+{
+	if(res == SCAP_SUCCESS)
+	{
+		m_event_reorderer.push(evt->m_pevt, evt->m_cpuid);
+	}
+	else if(res != SCAP_TIMEOUT && res != SCAP_EOF)
+	{
+		return res;
+	}
+
+	bool pending = false;
+	for(auto& src : m_plugin_sources)
+	{
+		bool done;
+		while(src->peek(done) != NULL)
+		{
+			m_event_reorderer.push(src->pop(), 0);
+		}
+		pending |= !done;
+	}
+
+	bool flush = res == SCAP_EOF && !pending;
+	uint64_t watermark = is_live() ? sinsp_utils::get_current_time_ns() : m_event_reorderer.get_max_ts();
+	scap_evt* pevt = m_event_reorderer.pop(watermark, flush, evt->m_cpuid);
+	if(pevt == NULL)
+	{
+		return flush ? SCAP_EOF : SCAP_TIMEOUT;
+	}
+
+	evt->m_pevt = pevt;
+	return SCAP_SUCCESS;
+}
+
+void sinsp::stop_capture()
+{
+	if(scap_stop_capture(m_h) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+}
+
+void sinsp::start_capture()
+{
+	if(scap_start_capture(m_h) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+}
+
+#ifndef _WIN32
+void sinsp::stop_dropping_mode()
+{
+	if(m_mode == SCAP_MODE_LIVE)
+	{
+		g_logger.format(sinsp_logger::SEV_INFO, "stopping drop mode");
+
+		if(scap_stop_dropping_mode(m_h) != SCAP_SUCCESS)
+		{
+			throw sinsp_exception(scap_getlasterr(m_h));
+		}
+	}
+}
+
+void sinsp::start_dropping_mode(uint32_t sampling_ratio)
+{
+	if(m_mode == SCAP_MODE_LIVE)
+	{
+		g_logger.format(sinsp_logger::SEV_INFO, "setting drop mode to %" PRIu32, sampling_ratio);
+
+		if(scap_start_dropping_mode(m_h, sampling_ratio) != SCAP_SUCCESS)
+		{
+			throw sinsp_exception(scap_getlasterr(m_h));
+		}
+	}
+}
+
+void sinsp::set_adaptive_sampling(bool enabled, uint64_t check_interval_ns)
+{
+	if(m_adaptive_sampling && m_sampling_controller.get_ratio() > 1)
+	{
+		stop_dropping_mode();
 	}
 
-	return plugin;
+	m_adaptive_sampling = enabled;
+	m_sampling_check_interval_ns = check_interval_ns;
+	m_next_sampling_check_ns = 0;
+	m_sampling_controller.reset();
 }
 
-std::shared_ptr<sinsp_plugin> sinsp::register_plugin(const plugin_api* api)
+void sinsp::set_adaptive_snaplen(bool enabled, uint64_t check_interval_ns)
 {
-	std::string errstr;
-	std::shared_ptr<sinsp_plugin> plugin = sinsp_plugin::create(api, m_table_registry, errstr);
-	if (!plugin)
+	if(m_adaptive_snaplen)
 	{
-		throw sinsp_exception("cannot load plugin with custom vtable: " + errstr);
+		clear_snaplen_limits();
 	}
 
-	try
-	{
-		m_plugin_manager->add(plugin);
-		if (plugin->caps() & CAP_PARSING)
-		{
-			m_plugin_parsers.push_back(sinsp_plugin_parser(plugin));
-		}
-	}
-	catch(sinsp_exception const& e)
-	{
-		throw sinsp_exception("cannot register plugin with custom vtable in inspector: " + std::string(e.what()));
-	}
+	m_snaplen_controller.set_max_snaplen(m_snaplen);
+	m_adaptive_snaplen = enabled;
+	m_snaplen_check_interval_ns = check_interval_ns;
+	m_next_snaplen_check_ns = 0;
+}
 
-	return plugin;
+void sinsp::set_event_reordering(uint64_t window_ns)
+{
+	m_event_reorderer.set_window(window_ns);
 }
 
-void sinsp::set_input_plugin(const std::string& name, const std::string& params)
+void sinsp::set_event_coalescing(bool enabled, uint64_t window_ns)
 {
-	for(auto& it : m_plugin_manager->plugins())
+	m_event_coalescing = enabled;
+	m_event_coalescer.set_window(window_ns);
+}
+
+void sinsp::clear_snaplen_limits()
+{
+	if(m_h != NULL && is_live())
 	{
-		if(it->name() == name)
+		for(uint32_t j = 0; j < scap_get_ndevs(m_h); j++)
 		{
-			if(!(it->caps() & CAP_SOURCING))
+			if(m_snaplen_controller.get_limit(j) != PPM_SNAPLEN_NO_LIMIT)
 			{
-				throw sinsp_exception("plugin " + name + " has not event sourcing capabilities and cannot be used as input.");
+				scap_set_buffer_snaplen(m_h, j, PPM_SNAPLEN_NO_LIMIT);
 			}
-			m_input_plugin = it;
-			m_input_plugin_open_params = params;
-			return;
 		}
 	}
-	throw sinsp_exception("plugin " + name + " does not exist");
+	m_snaplen_controller.reset();
 }
 
-void sinsp::stop_capture()
+void sinsp::set_latency_profiling(uint32_t sampling_ratio, latency_profiler::clock_source clock)
 {
-	if(scap_stop_capture(m_h) != SCAP_SUCCESS)
+	if(!m_latency_profiler.set_clock(clock))
 	{
-		throw sinsp_exception(scap_getlasterr(m_h));
+		throw sinsp_exception("the thread CPU clock is not available on this platform");
 	}
+	m_latency_profiler.set_sampling_ratio(sampling_ratio);
 }
 
-void sinsp::start_capture()
+void sinsp::set_lag_monitoring(uint32_t sampling_ratio, uint64_t backpressure_threshold_ns, event_lag_monitor::backpressure_cb_t cb)
 {
-	if(scap_start_capture(m_h) != SCAP_SUCCESS)
+	m_lag_monitor.init(sampling_ratio, backpressure_threshold_ns, cb);
+}
+
+void sinsp::set_state_view_interval(uint64_t interval_ns)
+{
+	m_state_views.set_interval(interval_ns);
+}
+
+const sinsp_table_memory& sinsp::get_table_memory(sinsp_state_table table)
+{
+	return table_memory(table);
+}
+
+sinsp_table_memory& sinsp::table_memory(sinsp_state_table table)
+{
+	switch(table)
 	{
-		throw sinsp_exception(scap_getlasterr(m_h));
+	case SINSP_TABLE_THREADS:
+		return m_thread_manager->get_memory();
+	case SINSP_TABLE_FDS:
+		return m_fd_memory;
+	case SINSP_TABLE_CONTAINERS:
+		return m_container_manager.get_memory();
+	case SINSP_TABLE_USERS:
+		return m_usergroup_manager.get_memory();
+	case SINSP_TABLE_DNS:
+		return sinsp_dns_manager::get().get_memory();
+	default:
+		throw sinsp_exception("unknown state table " + std::to_string(table));
 	}
 }
 
-#ifndef _WIN32
-void sinsp::stop_dropping_mode()
+void sinsp::set_memory_budget(sinsp_state_table table, uint64_t bytes)
 {
-	if(m_mode == SCAP_MODE_LIVE)
+	table_memory(table).set_budget(bytes);
+}
+
+void sinsp::set_state_eviction(bool enable)
+{
+	m_thread_manager->set_eviction(enable);
+}
+
+const scap_stats_v2* sinsp::get_memory_stats(uint32_t* nstats)
+{
+	static const char* s_table_names[SINSP_TABLE_MAX] = {
+		"threads",
+		"fds",
+		"containers",
+		"users",
+		"dns",
+	};
+
+	m_memory_stats.resize(SINSP_TABLE_MAX * 5);
+	for(uint32_t j = 0; j < SINSP_TABLE_MAX; j++)
 	{
-		g_logger.format(sinsp_logger::SEV_INFO, "stopping drop mode");
+		const sinsp_table_memory& memory = get_table_memory((sinsp_state_table)j);
+		const struct
+		{
+			const char* name;
+			uint64_t value;
+		} values[] = {
+			{"bytes", memory.get_bytes()},
+			{"entries", memory.get_entries()},
+			{"budget_bytes", memory.get_budget()},
+			{"budget_drops", memory.get_budget_drops()},
+			{"evictions", memory.get_evictions()},
+		};
+
+		for(uint32_t k = 0; k < 5; k++)
+		{
+			scap_stats_v2& stat = m_memory_stats[j * 5 + k];
+			snprintf(stat.name, STATS_NAME_MAX, "memory.%s.%s", s_table_names[j], values[k].name);
+			stat.flags = PPM_SCAP_STATS_MEMORY;
+			stat.type = STATS_VALUE_TYPE_U64;
+			stat.value.u64 = values[k].value;
+		}
+	}
 
-		if(scap_stop_dropping_mode(m_h) != SCAP_SUCCESS)
+	*nstats = m_memory_stats.size();
+	return m_memory_stats.data();
+}
+
+void sinsp::update_adaptive_sampling(uint64_t ts)
+{
+	scap_stats stats;
+	get_capture_stats(&stats);
+
+	double buf_fill = 0;
+	if(m_driver_buffer_bytes_dim != 0)
+	{
+		buf_fill = (double)scap_max_buf_used(m_h) / m_driver_buffer_bytes_dim;
+	}
+
+	uint32_t prev_ratio = m_sampling_controller.get_ratio();
+	uint32_t ratio = m_sampling_controller.update(buf_fill, stats.n_drops_buffer);
+	if(ratio != prev_ratio)
+	{
+		if(ratio == 1)
 		{
-			throw sinsp_exception(scap_getlasterr(m_h));
+			stop_dropping_mode();
+		}
+		else
+		{
+			start_dropping_mode(ratio);
 		}
 	}
+
+	m_next_sampling_check_ns = ts + m_sampling_check_interval_ns;
 }
 
-void sinsp::start_dropping_mode(uint32_t sampling_ratio)
+void sinsp::update_adaptive_snaplen(uint64_t ts)
 {
-	if(m_mode == SCAP_MODE_LIVE)
+	m_next_snaplen_check_ns = ts + m_snaplen_check_interval_ns;
+
+	uint32_t nstats = 0;
+	int32_t rc = 0;
+	const scap_stats_v2* stats = get_capture_stats_v2(PPM_SCAP_STATS_BUFFERS, &nstats, &rc);
+
+	//
+	// The occupancy of every buffer comes as `<prefix>_<n>.used_bytes`
+	// followed by `<prefix>_<n>.size_bytes`
+	//
+	for(uint32_t j = 0; j + 1 < nstats; j++)
 	{
-		g_logger.format(sinsp_logger::SEV_INFO, "setting drop mode to %" PRIu32, sampling_ratio);
+		const char* sep = strchr(stats[j].name, '_');
+		if(stats[j].flags != PPM_SCAP_STATS_BUFFERS || sep == NULL)
+		{
+			continue;
+		}
 
-		if(scap_start_dropping_mode(m_h, sampling_ratio) != SCAP_SUCCESS)
+		char* end = NULL;
+		unsigned long buffer = strtoul(sep + 1, &end, 10);
+		if(end == sep + 1 || strcmp(end, ".used_bytes") != 0 ||
+		   buffer > UINT16_MAX || stats[j + 1].value.u64 == 0)
 		{
-			throw sinsp_exception(scap_getlasterr(m_h));
+			continue;
+		}
+
+		double buf_fill = (double)stats[j].value.u64 / stats[j + 1].value.u64;
+		uint32_t prev_limit = m_snaplen_controller.get_limit(buffer);
+		uint32_t limit = m_snaplen_controller.update(buffer, buf_fill, ts);
+		if(limit == prev_limit)
+		{
+			continue;
+		}
+
+		int32_t res = scap_set_buffer_snaplen(m_h, buffer, limit);
+		if(res == SCAP_NOT_SUPPORTED)
+		{
+			g_logger.format(sinsp_logger::SEV_WARNING,
+				"the driver can't limit the snaplen of a single buffer, disabling the adaptive snaplen");
+			m_snaplen_controller.reset();
+			m_adaptive_snaplen = false;
+			return;
+		}
+		else if(res != SCAP_SUCCESS)
+		{
+			g_logger.format(sinsp_logger::SEV_ERROR,
+				"can't set the snaplen limit of buffer %lu: %s", buffer, scap_getlasterr(m_h));
 		}
 	}
 }
@@ -1845,6 +3233,30 @@ void sinsp::set_filter(const std::string& filter)
 	m_internal_flt_ast = compiler.get_filter_ast();
 }
 
+void sinsp::replace_filter(const std::string& filter)
+{
+	if(filter.empty())
+	{
+		replace_filter((sinsp_filter*)nullptr);
+		return;
+	}
+
+	sinsp_filter_compiler compiler(this, filter);
+	sinsp_filter* new_filter = compiler.compile();
+	delete m_filter;
+	m_filter = new_filter;
+	m_filterstring = filter;
+	m_internal_flt_ast = compiler.get_filter_ast();
+}
+
+void sinsp::replace_filter(sinsp_filter* filter)
+{
+	delete m_filter;
+	m_filter = filter;
+	m_filterstring.clear();
+	m_internal_flt_ast.reset();
+}
+
 const std::string sinsp::get_filter()
 {
 	return m_filterstring;
@@ -1860,9 +3272,12 @@ bool sinsp::run_filters_on_evt(sinsp_evt *evt)
 	//
 	// First run the global filter, if there is one.
 	//
-	if(m_filter && m_filter->run(evt) == true)
+	if(m_filter)
 	{
-		return true;
+		uint64_t filter_start_ns = m_latency_profiler.start();
+		bool res = m_filter->run(evt);
+		m_latency_profiler.stop(latency_profiler::STAGE_FILTER, evt->get_type(), filter_start_ns);
+		return res;
 	}
 
 	return false;
@@ -1943,6 +3358,33 @@ sinsp_stats sinsp::get_stats()
 		m_thread_manager->update_statistics();
 	}
 
+	if(m_latency_profiler.get_sampling_ratio() != 0)
+	{
+		m_latency_profiler.export_stats(m_stats.get_metrics_registry());
+	}
+
+	if(m_parser)
+	{
+		uint32_t nstats;
+		const scap_stats_v2* parse_stats = m_parser->get_parse_stats(&nstats);
+		for(uint32_t i = 0; i < nstats; i++)
+		{
+			m_stats.get_metrics_registry().register_counter(
+				internal_metrics::metric_name(parse_stats[i].name, parse_stats[i].name)).add(parse_stats[i].value.u64);
+		}
+	}
+
+	if(m_thread_manager)
+	{
+		uint32_t nstats;
+		const scap_stats_v2* workload_stats = m_thread_manager->get_workload_stats(&nstats);
+		for(uint32_t i = 0; i < nstats; i++)
+		{
+			m_stats.get_metrics_registry().register_counter(
+				internal_metrics::metric_name(workload_stats[i].name, workload_stats[i].name)).add(workload_stats[i].value.u64);
+		}
+	}
+
 	//
 	// Return the result
 	//
@@ -1998,6 +3440,11 @@ void sinsp::set_large_envs(bool enable)
 	m_large_envs_enabled = enable;
 }
 
+void sinsp::set_workload_counters(bool enable)
+{
+	m_parser->set_track_workload(enable);
+}
+
 void sinsp::set_debug_mode(bool enable_debug)
 {
 	m_isdebug_enabled = enable_debug;
@@ -2013,6 +3460,11 @@ void sinsp::set_fatfile_dump_mode(bool enable_fatfile)
 	m_isfatfile_enabled = enable_fatfile;
 }
 
+void sinsp::set_minimal_state_dump_mode(bool enable)
+{
+	m_isminimal_state_dump_enabled = enable;
+}
+
 void sinsp::set_internal_events_mode(bool enable_internal_events)
 {
 	m_isinternal_events_enabled = enable_internal_events;
@@ -2028,6 +3480,30 @@ void sinsp::set_max_evt_output_len(uint32_t len)
 	m_max_evt_output_len = len;
 }
 
+void sinsp::set_filter_extraction_cache(bool enable)
+{
+	if(!enable)
+	{
+		m_filter_extraction_cache.reset();
+	}
+	else if(m_filter_extraction_cache == nullptr)
+	{
+		m_filter_extraction_cache = std::make_shared<sinsp_filter_extraction_cache>();
+	}
+}
+
+void sinsp::set_filter_eval_cache(bool enable)
+{
+	if(!enable)
+	{
+		m_filter_eval_cache.reset();
+	}
+	else if(m_filter_eval_cache == nullptr)
+	{
+		m_filter_eval_cache = std::make_shared<sinsp_filter_eval_cache>();
+	}
+}
+
 sinsp_protodecoder* sinsp::require_protodecoder(std::string decoder_name)
 {
 	return m_parser->add_protodecoder(decoder_name);
@@ -2604,6 +4080,11 @@ void sinsp::set_thread_purge_interval_s(uint32_t val)
 	m_inactive_thread_scan_time_ns = (uint64_t)val * ONE_SECOND_IN_NS;
 }
 
+void sinsp::set_thread_purge_slice_size(uint32_t val)
+{
+	m_thread_manager->set_purge_slice_size(val);
+}
+
 void sinsp::set_thread_timeout_s(uint32_t val)
 {
 	m_thread_timeout_ns = (uint64_t)val * ONE_SECOND_IN_NS;
@@ -2619,6 +4100,126 @@ void sinsp::set_proc_scan_log_interval_ms(uint64_t val)
 	m_proc_scan_log_interval_ms = val;
 }
 
+void sinsp::set_proc_scan_threads(uint32_t val)
+{
+	m_proc_scan_threads = val;
+}
+
+void sinsp::set_proc_scan_spill_bytes(uint64_t val)
+{
+	m_proc_scan_spill_bytes = val;
+}
+
+void sinsp::set_lazy_fd_scan(bool enable)
+{
+	m_lazy_fd_scan = enable;
+}
+
+void sinsp::set_prefetch_distance(uint32_t distance)
+{
+	m_prefetch_distance = std::min(distance, (uint32_t)SINSP_MAX_PREFETCH_DISTANCE);
+}
+
+void sinsp::set_dense_thread_table(bool enable)
+{
+	if(!m_thread_manager->m_threadtable.set_dense(enable))
+	{
+		throw sinsp_exception("the thread table backend must be chosen before opening the inspector");
+	}
+}
+
+void sinsp::set_connection_table(bool enable, uint32_t max_size)
+{
+	if(enable)
+	{
+		m_connection_table.reset(new sinsp_connection_table(max_size));
+	}
+	else
+	{
+		m_connection_table.reset();
+	}
+}
+
+void sinsp::set_ringbuffer_merge_mode(scap_ringbuffer_merge_mode val)
+{
+	m_ringbuffer_merge_mode = val;
+}
+
+void sinsp::set_ringbuffer_consume_chunk_b(uint32_t val)
+{
+	m_ringbuffer_consume_chunk_b = val;
+}
+
+void sinsp::set_ringbuffer_wakeup(bool val)
+{
+	m_ringbuffer_wakeup = val;
+}
+
+void sinsp::set_ringbuffer_empty_threshold_b(uint32_t val)
+{
+	m_ringbuffer_empty_threshold_b = val;
+}
+
+void sinsp::set_ringbuffer_empty_wait_max_us(uint32_t val)
+{
+	m_ringbuffer_empty_wait_max_us = val;
+}
+
+void sinsp::set_ringbuffer_wakeup_watermark_b(uint32_t val)
+{
+	m_ringbuffer_wakeup_watermark_b = val;
+}
+
+void sinsp::set_savefile_decompression_threads(uint32_t val)
+{
+	m_savefile_decompression_threads = val;
+}
+
+void sinsp::set_input_plugin_prefetch(bool enable)
+{
+	m_input_plugin_prefetch = enable;
+}
+
+void sinsp::set_gvisor_parse_threads(uint32_t val)
+{
+	m_gvisor_parse_threads = val;
+}
+
+void sinsp::set_thread_placement(libsinsp::thread_placement::thread_class cls, const libsinsp::thread_placement::placement& p)
+{
+	if(cls >= libsinsp::thread_placement::thread_class::MAX)
+	{
+		throw sinsp_exception("invalid thread class: " + std::to_string((uint32_t)cls));
+	}
+	libsinsp::thread_placement::set(cls, p);
+}
+
+void sinsp::set_plugin_parse_threads(uint32_t val)
+{
+	m_plugin_parse_pool.reset();
+	if(val > 0)
+	{
+		m_plugin_parse_pool.reset(new sinsp_plugin_parse_pool(val));
+	}
+}
+
+void sinsp::set_plugin_async_extraction(uint32_t num_workers, uint64_t max_wait_ns)
+{
+	m_async_extract_plugins.clear();
+	for(const auto& p : m_plugin_manager->plugins())
+	{
+		if(!(p->caps() & CAP_EXTRACTION))
+		{
+			continue;
+		}
+		p->set_async_extraction(num_workers, max_wait_ns);
+		if(p->async_extractor() != nullptr)
+		{
+			m_async_extract_plugins.push_back(p);
+		}
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Note: this is defined here so we can inline it in sinso::next
 ///////////////////////////////////////////////////////////////////////////////
@@ -2644,52 +4245,71 @@ bool sinsp_thread_manager::remove_inactive_threads()
 		}
 	}
 
-	if(m_inspector->m_lastevent_ts >
-		m_last_flush_time_ns + m_inspector->m_inactive_thread_scan_time_ns)
+	if(!m_purge_in_progress)
 	{
-		std::unordered_map<uint64_t, bool> to_delete;
-
-		res = true;
+		if(!m_purge_scheduled &&
+		   m_inspector->m_lastevent_ts <=
+			m_last_flush_time_ns + m_inspector->m_inactive_thread_scan_time_ns)
+		{
+			return false;
+		}
 
+		m_purge_scheduled = false;
+		m_purge_in_progress = true;
+		m_purge_cursor = 0;
 		m_last_flush_time_ns = m_inspector->m_lastevent_ts;
 
 		g_logger.format(sinsp_logger::SEV_INFO, "Flushing thread table");
+	}
 
-		//
-		// Go through the table and remove dead entries.
-		//
-		m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
-			bool closed = (tinfo.m_flags & PPM_CL_CLOSED) != 0;
+	res = true;
 
-			if(closed ||
-				((m_inspector->m_lastevent_ts > tinfo.m_lastaccess_ts + m_inspector->m_thread_timeout_ns) &&
-					!scap_is_thread_alive(m_inspector->m_h, tinfo.m_pid, tinfo.m_tid, tinfo.m_comm.c_str()))
-					)
-			{
-				//
-				// Reset the cache
-				//
-				m_last_tid = 0;
-				m_last_tinfo.reset();
+	//
+	// Go through the next slice of the table and remove dead entries.
+	//
+	auto check_thread = [&] (sinsp_threadinfo& tinfo) {
+		bool closed = (tinfo.m_flags & PPM_CL_CLOSED) != 0;
+
+		if(closed ||
+			((m_inspector->m_lastevent_ts > tinfo.m_lastaccess_ts + m_inspector->m_thread_timeout_ns) &&
+				!scap_is_thread_alive(m_inspector->m_h, tinfo.m_pid, tinfo.m_tid, tinfo.m_comm.c_str()))
+				)
+		{
+			//
+			// Reset the cache
+			//
+			m_last_tid = 0;
+			m_last_tinfo.reset();
 
 #ifdef GATHER_INTERNAL_STATS
-				m_removed_threads->increment();
+			m_removed_threads->increment();
 #endif
-				to_delete[tinfo.m_tid] = closed;
-			}
+			m_purge_to_delete.emplace_back(tinfo.m_tid, closed);
+		}
+	};
+
+	bool done = true;
+	if(m_purge_slice_size == 0)
+	{
+		m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
+			check_thread(tinfo);
 			return true;
 		});
+	}
+	else
+	{
+		done = m_threadtable.loop_slice(m_purge_cursor, m_purge_slice_size, check_thread);
+	}
 
-		for (auto& it : to_delete)
-		{
-			remove_thread(it.first, it.second);
-		}
+	for (auto& it : m_purge_to_delete)
+	{
+		remove_thread(it.first, it.second);
+	}
+	m_purge_to_delete.clear();
 
-		//
-		// Rebalance the thread table dependency tree, so we free up threads that
-		// exited but that are stuck because of reference counting.
-		//
-		recreate_child_dependencies();
+	if(done)
+	{
+		m_purge_in_progress = false;
 	}
 
 	return res;
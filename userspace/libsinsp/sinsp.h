@@ -45,8 +45,6 @@ limitations under the License.
 
 #ifdef _WIN32
 #pragma warning(disable: 4251 4200 4221 4190)
-#else
-#include "tbb/concurrent_queue.h"
 #endif
 
 #include "sinsp_inet.h"
@@ -74,6 +72,17 @@ limitations under the License.
 #include "event.h"
 #include "filter.h"
 #include "dumper.h"
+#include "memdumper.h"
+#include "sampling_controller.h"
+#include "snaplen_controller.h"
+#include "event_coalescer.h"
+#include "event_reorderer.h"
+#include "async_event_pool.h"
+#include "state_event_queue.h"
+#include "latency_profiler.h"
+#include "event_lag_monitor.h"
+#include "state_view.h"
+#include "table_memory.h"
 #include "stats.h"
 #include "ifinfo.h"
 #include "container.h"
@@ -98,6 +107,9 @@ limitations under the License.
 #include "tuples.h"
 #include "fdinfo.h"
 #include "threadinfo.h"
+#include "lazy_fd_loader.h"
+#include "connection_table.h"
+#include "source_reader.h"
 #include "ifinfo.h"
 #include "eventformatter.h"
 #include "sinsp_pd_callback_type.h"
@@ -105,10 +117,13 @@ limitations under the License.
 #include "include/sinsp_external_processor.h"
 #include "plugin.h"
 #include "gvisor_config.h"
+#include "thread_placement.h"
 class sinsp_partial_transaction;
 class sinsp_parser;
 class sinsp_analyzer;
 class sinsp_filter;
+class sinsp_filter_extraction_cache;
+class sinsp_filter_eval_cache;
 class cycle_writer;
 class sinsp_protodecoder;
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
@@ -227,7 +242,7 @@ public:
 	virtual void open_kmod(unsigned long driver_buffer_bytes_dim = DEFAULT_DRIVER_BUFFER_BYTES_DIM, const libsinsp::events::set<ppm_sc_code> &ppm_sc_of_interest = {});
 	virtual void open_bpf(const std::string &bpf_path, unsigned long driver_buffer_bytes_dim = DEFAULT_DRIVER_BUFFER_BYTES_DIM, const libsinsp::events::set<ppm_sc_code> &ppm_sc_of_interest = {});
 	virtual void open_udig();
-	virtual void open_nodriver(bool full_proc_scan = false);
+	virtual void open_nodriver(bool full_proc_scan = false, bool proc_connector = false);
 	virtual void open_savefile(const std::string &filename, int fd = 0);
 	virtual void open_plugin(const std::string &plugin_name, const std::string &plugin_open_params);
 	virtual void open_gvisor(const std::string &config_path, const std::string &root_path, bool no_events = false);
@@ -236,7 +251,76 @@ public:
 	 * The last one allows allocating ring buffers only for online CPUs and not for all system-available CPUs.
 	 */
 	virtual void open_modern_bpf(unsigned long driver_buffer_bytes_dim = DEFAULT_DRIVER_BUFFER_BYTES_DIM, uint16_t cpus_for_each_buffer = DEFAULT_CPU_FOR_EACH_BUFFER, bool online_only = true, const libsinsp::events::set<ppm_sc_code> &ppm_sc_of_interest = {});
+	/*[EXPERIMENTAL] Make the next open_modern_bpf() group the CPUs of each NUMA node separately, so that
+	 * no ring buffer is shared between nodes, and allocate every ring buffer on the node of its CPUs.
+	 * `cpus_for_each_buffer` is then applied to each node, and the stats include the counters of every buffer.
+	 */
+	void set_modern_bpf_numa_aware(bool numa_aware)
+	{
+		m_modern_bpf_numa_aware = numa_aware;
+	}
+	/*[EXPERIMENTAL] Make the next open_modern_bpf() sum the bytes and the number of the read and write
+	 * syscalls by (process, fd, direction) in the driver, instead of capturing their events. The sums are
+	 * returned as `ioaggregate` events every `period_ms`, 0 disables the aggregation.
+	 */
+	void set_modern_bpf_io_aggregation_period_ms(uint32_t period_ms)
+	{
+		m_modern_bpf_io_aggregation_period_ms = period_ms;
+	}
+	/*[EXPERIMENTAL] Make the next open_modern_bpf() count the context switches and the page faults of
+	 * every thread in the driver, instead of capturing their events. The counts are returned as
+	 * `taskaggregate` events every `period_ms`, 0 disables the aggregation.
+	 */
+	void set_modern_bpf_task_aggregation_period_ms(uint32_t period_ms)
+	{
+		m_modern_bpf_task_aggregation_period_ms = period_ms;
+	}
+	/*[EXPERIMENTAL] Make the next open_modern_bpf() check the median run time of every bpf program
+	 * against `budget_ns` once per second: over budget, `sched_switch` and the page fault programs
+	 * are sampled and `signal_deliver` is detached. 0 disables the budget.
+	 */
+	void set_modern_bpf_prog_budget_ns(uint64_t budget_ns)
+	{
+		m_modern_bpf_prog_budget_ns = budget_ns;
+	}
+	/*[EXPERIMENTAL] Make the next open_modern_bpf() send the exe, comm and cgroups of the clone and
+	 * execve exit events only when they changed since the last event of the thread. The parsers take
+	 * the unchanged ones from the thread table, which can be stale after the driver drops events.
+	 */
+	void set_modern_bpf_string_interning(bool string_interning)
+	{
+		m_modern_bpf_string_interning = string_interning;
+	}
 	virtual void open_test_input(scap_test_input_data *data);
+	/*!
+	  \brief Opens an engine generating a mix of process, file and network
+	  events from a seed, at a configurable rate, e.g. to load test without a driver.
+	*/
+	virtual void open_synthetic(const scap_synthetic_engine_params& params);
+
+	/*!
+	  \brief Adds a source plugin to open next to the capture, so that its
+	  events are returned by next() merged by timestamp with the ones of the
+	  capture, sharing the same thread state. Must be called before opening
+	  the capture, and applies to every following open until the inspector
+	  is destroyed.
+
+	  The events of the plugin are read on a separate thread and buffered in
+	  a queue of up to queue_size events, which is never waited on: when the
+	  plugin is slower than the capture, its events are returned as soon as
+	  they are available, possibly out of timestamp order. The plugin must
+	  tolerate next_batch running concurrently with its other functions, and
+	  can't also be the input plugin of the capture.
+
+	  \param plugin_name the name of a registered plugin with event sourcing
+	   capability.
+
+	  \param plugin_open_params the parameters passed to the open function of
+	   the plugin.
+
+	  \param queue_size the max number of events buffered for the plugin.
+	*/
+	void add_plugin_source(const std::string& plugin_name, const std::string& plugin_open_params, uint32_t queue_size = 1024);
 
 	scap_open_args factory_open_args(const char* engine_name, scap_mode_t scap_mode);
 
@@ -265,6 +349,34 @@ public:
 	*/
 	virtual int32_t next(OUT sinsp_evt **evt);
 
+	/*!
+	  \brief Get up to `max` events from the open capture source in one go.
+	   Events are parsed in order, exactly like \ref next() does, each one in
+	   storage of its own so that all of them stay valid at the same time:
+	   every event keeps its data, a copy of its fd info and a reference to
+	   its thread info. Filtered events are skipped.
+
+	   The state maintenance that doesn't belong to a specific event (e.g.
+	   the purging of the inactive threads) runs once per batch, and the
+	   threads that exit during a batch are removed at the start of the next
+	   one.
+
+	  \param evts an array of at least `max` \ref sinsp_evt pointers that will
+	   be initialized to point to the returned events.
+	  \param max the maximum number of events to return.
+	  \param nevts the number of returned events.
+
+	  \return SCAP_SUCCESS if at least one event is returned. The batch stops
+	   early on any other result of \ref next(). SCAP_TIMEOUT is returned
+	   only if the batch is empty. Any other result (e.g. SCAP_EOF or
+	   SCAP_FAILURE) is returned right away if the batch is empty, otherwise
+	   by the following call, which returns no events.
+
+	  \note: the returned events can be considered valid only until the next
+	   call to \ref next_batch() or \ref next()
+	*/
+	int32_t next_batch(OUT sinsp_evt** evts, uint32_t max, OUT uint32_t* nevts);
+
 	/*!
 	  \brief Get the maximum number of bytes currently in use by any CPU buffer
      */
@@ -297,6 +409,74 @@ public:
 	*/
 	void set_snaplen(uint32_t snaplen);
 
+	/*!
+	  \brief Set the snaplen of the buffers read from or written to one kind
+	  of fd (sockets, pipes or anything else), in place of the one given to
+	  set_snaplen. For example, a small global snaplen with a bigger one for
+	  the sockets keeps the payloads of the network I/O only.
+
+	  \param fd_type the kind of fd.
+	  \param snaplen the snaplen in bytes, or PPM_SNAPLEN_FD_TYPE_DEFAULT to
+	   go back to the global one.
+
+	  \note The dynamic snaplen and the fullcapture port range can still
+	   give a bigger snaplen to the sockets.
+
+	  @throws a sinsp_exception containing the error string is thrown in case
+	   of failure.
+	*/
+	void set_fd_type_snaplen(ppm_snaplen_fd_type fd_type, uint32_t snaplen);
+
+	/*!
+	  \brief Sample and/or rate limit the events of a syscall in the driver,
+	  e.g. to keep one read every 100 or at most 1000 futex per second.
+
+	  \param ppm_sc the syscall.
+	  \param sample_every keep one event every sample_every, 0 or 1 to keep
+	   them all.
+	  \param max_per_sec keep at most max_per_sec events per second on every
+	   CPU, 0 for no limit.
+
+	  \note Enter and exit events are limited on their own, so a kept enter
+	   event may come without its exit. The dropped events are counted in
+	   the n_drops_syscall_limit.<syscall> stats. The sched_switch and page
+	   fault tracepoints can be limited too. Only the modern BPF probe
+	   supports it.
+
+	  @throws a sinsp_exception containing the error string is thrown in case
+	   of failure.
+	*/
+	void set_syscall_limit(ppm_sc_code ppm_sc, uint32_t sample_every, uint32_t max_per_sec);
+
+	/*!
+	  \brief Filter the syscall events in the driver by the cgroup of the
+	  task, e.g. to skip the batch jobs or the system daemons of a node.
+
+	  \param mode PPM_CGROUP_FILTER_ALLOW keeps only the tasks of the cgroups
+	   listed with set_cgroup_filter, PPM_CGROUP_FILTER_DENY drops them,
+	   PPM_CGROUP_FILTER_NONE disables the filter.
+
+	  \note The syscalls building up the process tree (clone, execve,
+	   setuid, ...) are always kept, so the threads of the filtered cgroups
+	   are still tracked. Only the BPF probes support it.
+
+	  @throws a sinsp_exception containing the error string is thrown in case
+	   of failure.
+	*/
+	void set_cgroup_filter_mode(ppm_cgroup_filter_mode mode);
+
+	/*!
+	  \brief Add or remove a cgroup from the cgroup filter, see
+	  set_cgroup_filter_mode.
+
+	  \param cgroup_id the inode number of the cgroup v2 directory.
+	  \param listed whether the cgroup is listed.
+
+	  @throws a sinsp_exception containing the error string is thrown in case
+	   of failure.
+	*/
+	void set_cgroup_filter(uint64_t cgroup_id, bool listed);
+
 	/*!
 	 * \brief (Un)Set the drop failed feature of the drivers.
 		When enabled, drivers will stop sending failed syscalls (exit) events.
@@ -305,6 +485,246 @@ public:
 	 */
 	void set_dropfailed(bool dropfailed);
 
+	/*!
+	  \brief Let the inspector pick the sampling ratio of the driver on its
+	  own (see start_dropping_mode), raising it while the buffers fill up
+	  or the driver drops events, and lowering it once things calm down.
+	  Only live captures are affected.
+
+	  \param enabled whether to enable the feature. Disabling it also
+	   stops the sampling.
+	  \param check_interval_ns how often to check the buffers, in event
+	   time.
+	*/
+	void set_adaptive_sampling(bool enabled, uint64_t check_interval_ns = ONE_SECOND_IN_NS);
+
+	/*!
+	  \brief Returns the controller used by set_adaptive_sampling(), to tune
+	  its thresholds.
+	*/
+	inline sampling_controller& get_sampling_controller()
+	{
+		return m_sampling_controller;
+	}
+
+	/*!
+	  \brief Let the inspector cap the snaplen of every driver buffer on its
+	  own, lowering it while the buffer fills up and raising it back once
+	  the buffer is quiet again (see snaplen_controller), so that the driver
+	  copies less I/O data on the busy CPUs. The limit an event was captured
+	  with is returned by sinsp_evt::get_snaplen_limit() and the
+	  evt.snaplen_limit field. Only live captures with the kernel module or
+	  the modern probe are affected.
+
+	  \param enabled whether to enable the feature. Disabling it also
+	   removes the limits.
+	  \param check_interval_ns how often to check the buffers, in event
+	   time.
+
+	  \note The first and highest limit is the snaplen set with
+	   set_snaplen(), the lowest one is set on the controller.
+	*/
+	void set_adaptive_snaplen(bool enabled, uint64_t check_interval_ns = ONE_SECOND_IN_NS);
+
+	/*!
+	  \brief Returns the controller used by set_adaptive_snaplen(), to tune
+	  its thresholds before enabling it.
+	*/
+	inline snaplen_controller& get_snaplen_controller()
+	{
+		return m_snaplen_controller;
+	}
+
+	/*!
+	  \brief Returns the snaplen limit set by set_adaptive_snaplen() on a
+	  driver buffer at the given time, or PPM_SNAPLEN_NO_LIMIT.
+	*/
+	inline uint32_t get_snaplen_limit(uint16_t cpuid, uint64_t ts) const
+	{
+		if(!m_adaptive_snaplen)
+		{
+			return PPM_SNAPLEN_NO_LIMIT;
+		}
+		return m_snaplen_controller.get_limit(cpuid, ts);
+	}
+
+	/*!
+	  \brief Collapse the runs of identical events of a thread, like the
+	  ones of a busy-polling loop, into one event every window plus a
+	  repeat count (see event_coalescer). The suppressed events are still
+	  parsed, so the state is not affected, and the count is returned by
+	  sinsp_evt::get_repeat_count() and the evt.repeat_count field.
+
+	  \param enabled whether to enable the feature.
+	  \param window_ns how long a run can be collapsed before an event is
+	   delivered again, in event time.
+
+	  \note When a run breaks, its last suppressed event is delivered
+	   before the event that broke it, so it can be older than the events
+	   of the other threads delivered in the meantime.
+	*/
+	void set_event_coalescing(bool enabled, uint64_t window_ns = ONE_SECOND_IN_NS);
+
+	inline bool is_event_coalescing_enabled() const
+	{
+		return m_event_coalescing;
+	}
+
+	inline const event_coalescer& get_event_coalescer() const
+	{
+		return m_event_coalescer;
+	}
+
+	/*!
+	  \brief Deliver the events of the capture and of the plugin sources
+	  (see add_plugin_source()) in timestamp order, even when a source
+	  lags behind the others (see event_reorderer). The events are held
+	  until they are older than the window: the current time in live
+	  captures, the newest event read otherwise.
+
+	  \param window_ns how late an event can arrive and still be
+	   delivered in order. 0 disables the reordering.
+
+	  \note The events arriving later than the window are dropped, and
+	   counted by get_event_reorderer().get_num_late().
+	*/
+	void set_event_reordering(uint64_t window_ns);
+
+	inline const event_reorderer& get_event_reorderer() const
+	{
+		return m_event_reorderer;
+	}
+
+	/*!
+	  \brief Enables the collection of per-event-type latency histograms
+	  of the stages of next(): the whole call, the read of the event from
+	  libscap, the parsing of the event, the run of the filter and the
+	  write to the dumper, plus the formatting of the event returned by
+	  next(). One event out of sampling_ratio is timed.
+
+	  \param sampling_ratio the sampling ratio, 0 disables the profiling
+	   and keeps the histograms collected so far.
+	  \param clock the clock the stages are timed with. The CPU time of
+	   the thread calling next() gives the CPU cost of each stage, to
+	   account for the inspector's own usage.
+
+	  \note The histograms can be read with get_latency_profiler(), as
+	   \ref scap_stats_v2 metrics flagged as PPM_SCAP_STATS_LATENCY, and
+	   are part of get_stats() when built with GATHER_INTERNAL_STATS.
+	*/
+	void set_latency_profiling(uint32_t sampling_ratio, latency_profiler::clock_source clock = latency_profiler::WALL_CLOCK);
+
+	inline latency_profiler& get_latency_profiler()
+	{
+		return m_latency_profiler;
+	}
+
+	/*!
+	  \brief Enables the tracking of how far behind the clock the processing
+	  of the events is, i.e. the difference between the current time and
+	  the timestamp of the events returned by next(). Only live captures
+	  are tracked.
+
+	  \param sampling_ratio one event out of sampling_ratio is measured, 0
+	   disables the tracking.
+	  \param backpressure_threshold_ns the smoothed lag over which the
+	   backpressure signal is raised, 0 to never raise it. The signal is
+	   cleared when the lag goes back under half of it.
+	  \param cb called every time the backpressure signal is raised or
+	   cleared, e.g. to enable set_adaptive_sampling() or to skip the
+	   most expensive rules.
+
+	  \note The lag percentiles and the state of the signal can be read
+	   with get_lag_monitor().
+	*/
+	void set_lag_monitoring(uint32_t sampling_ratio,
+				uint64_t backpressure_threshold_ns = ONE_SECOND_IN_NS,
+				event_lag_monitor::backpressure_cb_t cb = nullptr);
+
+	inline event_lag_monitor& get_lag_monitor()
+	{
+		return m_lag_monitor;
+	}
+
+	/*!
+	  \brief Publish a read-only view of the threads and containers
+	  every interval_ns of event time, for the other threads of the
+	  process (see get_state_view()). 0, the default, disables it.
+
+	  \note Taking a view walks the thread table on the capture thread,
+	   but only the threads accessed since the previous view are copied.
+	*/
+	void set_state_view_interval(uint64_t interval_ns);
+
+	/*!
+	  \brief Returns the last view published with
+	  set_state_view_interval(), nullptr if none.
+
+	  \note Unlike the rest of the inspector, this can be called from any
+	   thread while next() is running. The view never changes, and stays
+	   valid as long as the returned pointer is held.
+	*/
+	inline std::shared_ptr<const state_view> get_state_view() const
+	{
+		return m_state_views.get();
+	}
+
+	/*!
+	  \brief Returns the approximate memory used by a state table, as
+	  accounted by the table on every insertion and removal.
+
+	  \note The DNS cache is shared by all the inspectors of the process.
+	*/
+	const sinsp_table_memory& get_table_memory(sinsp_state_table table);
+
+	/*!
+	  \brief Sets the memory budget of a state table, in bytes. Once the
+	  accounted memory of the table reaches it, the new entries are
+	  refused and counted as dropped, like when the table is full.
+
+	  \param bytes the budget, 0 disables it.
+
+	  \note The budget is approximate too: the estimates don't cover
+	   the overhead of the allocator and of the tables themselves.
+	*/
+	void set_memory_budget(sinsp_state_table table, uint64_t bytes);
+
+	/*!
+	  \brief Makes room in the thread and fd tables by evicting their
+	  coldest entries, rather than refusing the new ones: the threads once
+	  their table is full or over its memory budget, the fds once they
+	  are over their memory budget.
+
+	  The threads are evicted by least recent access (see
+	  sinsp_threadinfo::m_lastaccess_ts), approximated by going around the
+	  table like the hand of a clock and picking the coldest thread of
+	  each slice. The fds are evicted a whole process at a time, picked
+	  the same way, between two events: the fds opened by an event can
+	  take them over their budget until the next one. Only what nothing
+	  else depends on is evicted: not the main threads of the processes
+	  that still have other threads, nor what the current event accessed.
+
+	  In live captures, the evicted entries are read again from /proc
+	  the next time they are looked up, the threads like any thread
+	  missing from the table and the fds like the ones of a lazy fd scan
+	  (see set_lazy_fd_scan). In the other modes they are lost.
+
+	  The evictions are counted in the `memory.<table>.evictions` metrics
+	  of get_memory_stats().
+
+	  \note The limit of the number of fds of a single process is still
+	   enforced by refusing the new fds.
+	*/
+	void set_state_eviction(bool enable);
+
+	/*!
+	  \brief Returns the accounted memory, entries, budget, budget drops
+	  and evictions of every state table, as \ref scap_stats_v2 metrics flagged
+	  as PPM_SCAP_STATS_MEMORY. The buffer is owned by the inspector and
+	  valid until the next call.
+	*/
+	const scap_stats_v2* get_memory_stats(uint32_t* nstats);
+
 	/*!
 	  \brief Determine if this inspector is going to load user tables on
 	  startup.
@@ -357,6 +777,26 @@ public:
 	*/
 	void set_filter(sinsp_filter* filter);
 
+	/*!
+	  \brief Replaces the capture filter, if any, with the given one while
+	   the capture keeps running. The new filter is compiled before the
+	   current one is dropped, so if it is invalid nothing changes. It applies
+	   from the next event returned by next(), and must be set from the
+	   thread that calls next().
+
+	  \param filter the filter string, an empty string removes the filter.
+
+	  @throws a sinsp_exception containing the error string is thrown in case
+	   the filter is invalid.
+	*/
+	void replace_filter(const std::string& filter);
+
+	/*!
+	  \brief Same as above, with a runtime filter object, owned by the
+	   inspector from now on. nullptr removes the filter.
+	*/
+	void replace_filter(sinsp_filter* filter);
+
 	/*!
 	  \brief Return the filter set for this capture.
 
@@ -412,6 +852,14 @@ public:
 	 */
 	void set_thread_purge_interval_s(uint32_t val);
 
+	/*!
+	 * \brief sets how many threads are checked for each event once the thread
+	 *        purge runs, so that the purge of big thread tables is spread over
+	 *        many events instead of stalling a single one. 0 means the whole
+	 *        table is checked at once
+	 */
+	void set_thread_purge_slice_size(uint32_t val);
+
 	/*!
 	 * \brief sets the amount of time after which a thread which has seen no events
 	 *        can be purged. As the purging happens only every m_thread_purge_interval_s,
@@ -433,6 +881,171 @@ public:
 	 */
 	void set_proc_scan_log_interval_ms(uint64_t val);
 
+	/*!
+	 * \brief sets the number of threads used by the initial scan of /proc.
+	 *        Value of SCAP_PROC_SCAN_THREADS_AUTO (default) means one per
+	 *        online CPU, 1 means the scan is serial.
+	 */
+	void set_proc_scan_threads(uint32_t val);
+
+	/*!
+	 * \brief if not 0, the events produced while the initial scan of /proc
+	 *        runs are read into a buffer of this many bytes, instead of
+	 *        waiting in the driver buffers where they could be dropped on
+	 *        the big hosts. They are parsed once the scan is done, against
+	 *        the state it built. The events that don't fit wait in the
+	 *        driver buffers as usual. Only for the kmod, bpf and
+	 *        modern_bpf engines, must be called before opening the
+	 *        inspector. Default: 0.
+	 */
+	void set_proc_scan_spill_bytes(uint64_t val);
+
+	/*!
+	 * \brief if enabled, the initial scan of /proc doesn't read the fds of the
+	 *        processes. The fd table of each process is read the first time
+	 *        it's accessed instead, with a background thread reading the
+	 *        pending ones in the meanwhile. Must be called before opening the
+	 *        inspector. Default: disabled.
+	 */
+	void set_lazy_fd_scan(bool enable);
+
+	/*!
+	 * \brief Make next() look at the event that comes `distance` events
+	 *        later on the CPU of each event it gets from the driver, and
+	 *        prefetch its thread and fd info, so that their lookups mostly
+	 *        hit the cache when it's processed. The events are looked at
+	 *        only while they are in the block being consumed, which the
+	 *        kmod, bpf and udig engines support. 0 disables it, the
+	 *        distance is capped at SINSP_MAX_PREFETCH_DISTANCE. Default: 0.
+	 */
+	void set_prefetch_distance(uint32_t distance);
+
+	/*!
+	 * \brief Store the threads in pages of slots indexed by tid instead of
+	 *        a hash table, which makes the thread lookups cheaper when the
+	 *        tids are small and dense, as with the default Linux pid_max.
+	 *        The tids above 4M still go in a hash table. Must be called
+	 *        before opening the inspector. Default: disabled.
+	 */
+	void set_dense_thread_table(bool enable);
+
+	/*!
+	  \brief Returns the loader of the fd tables left pending by the initial
+	  scan, e.g. to get its stats.
+	*/
+	inline sinsp_lazy_fd_loader* get_lazy_fd_loader()
+	{
+		return m_lazy_fd_loader.get();
+	}
+
+	/*!
+	 * \brief if enabled, the inspector keeps a global table of the IPv4 and
+	 *        IPv6 connections indexed by 5-tuple, with the process and fd of
+	 *        their ends. Must be called before opening the inspector.
+	 *        Default: disabled.
+	 */
+	void set_connection_table(bool enable, uint32_t max_size = DEFAULT_MAX_CONNECTIONS);
+
+	/*!
+	  \brief Returns the connection table, or NULL if it's not enabled.
+	*/
+	inline const sinsp_connection_table* get_connection_table() const
+	{
+		return m_connection_table.get();
+	}
+
+	/*!
+	 * \brief sets the strategy used by the kmod, bpf and udig engines to merge
+	 *        the per-CPU buffers in timestamp order. Must be called before opening
+	 *        the inspector. Default: SCAP_RINGBUFFER_MERGE_LINEAR.
+	 */
+	void set_ringbuffer_merge_mode(scap_ringbuffer_merge_mode val);
+
+	/*!
+	 * \brief if not 0, the kmod, bpf and udig engines give back the consumed data
+	 *        to the drivers every `val` bytes and refill drained buffers on their own,
+	 *        instead of consuming whole blocks. Must be called before opening the inspector.
+	 */
+	void set_ringbuffer_consume_chunk_b(uint32_t val);
+
+	/*!
+	 * \brief if true, when the buffers are almost empty the live engines wait for
+	 *        the drivers to notify new data instead of sleeping with an
+	 *        exponential backoff. Must be called before opening the inspector.
+	 */
+	void set_ringbuffer_wakeup(bool val);
+
+	/*!
+	 * \brief buffers holding less than `val` bytes are considered empty: the engines
+	 *        wait before reading them again. 0 (default) means the libscap default.
+	 */
+	void set_ringbuffer_empty_threshold_b(uint32_t val);
+
+	/*!
+	 * \brief in wakeup mode, the drivers notify new data once a buffer holds `val`
+	 *        bytes. Higher values mean fewer wakeups and bigger batches.
+	 *        0 (default) means the empty threshold.
+	 */
+	void set_ringbuffer_wakeup_watermark_b(uint32_t val);
+
+	/*!
+	 * \brief maximum time in microseconds the engines wait on empty buffers.
+	 *        0 (default) means the libscap default.
+	 */
+	void set_ringbuffer_empty_wait_max_us(uint32_t val);
+
+	/*!
+	 * \brief number of threads inflating the capture files written with
+	 *        SCAP_COMPRESSION_GZIP_BLOCKS. 0 (default) picks a number based
+	 *        on the CPUs. Must be called before opening the capture.
+	 */
+	void set_savefile_decompression_threads(uint32_t val);
+
+	/*!
+	 * \brief if true, the next_batch function of the source plugin is
+	 *        called ahead of time on a separate thread, so that the
+	 *        plugin's latency doesn't stall the event loop. The plugin must
+	 *        tolerate next_batch running concurrently with its other
+	 *        functions. Must be called before opening the plugin.
+	 */
+	void set_input_plugin_prefetch(bool enable);
+
+	/*!
+	 * \brief number of threads parsing the messages of the gVisor
+	 *        sandboxes. 0 (default) parses them on the capture thread.
+	 *        Must be called before opening the gVisor engine.
+	 */
+	void set_gvisor_parse_threads(uint32_t val);
+
+	/*!
+	 * \brief affinity, name and nice value of a class of threads started
+	 *        by the libs (DNS resolver, async lookups, gVisor, ...). The
+	 *        placement is process-wide and applies to the threads started
+	 *        afterwards. The CAPTURE class applies to the thread opening
+	 *        the inspector: pin it to a core on the NUMA node of the
+	 *        driver buffers, and mark it as dedicated to keep the other
+	 *        classes off that core.
+	 */
+	void set_thread_placement(libsinsp::thread_placement::thread_class cls, const libsinsp::thread_placement::placement& p);
+
+	/*!
+	 * \brief number of threads extracting the plugin fields declared as
+	 *        "async" from the events returned by next_batch(), ahead of
+	 *        the filter evaluation. A filter waits at most max_wait_ns for
+	 *        the value of an event, and then gets no value. 0 (default)
+	 *        extracts them synchronously. Must be called after the plugins
+	 *        are registered, see sinsp_plugin_async_extractor.
+	 */
+	void set_plugin_async_extraction(uint32_t num_workers, uint64_t max_wait_ns);
+
+	/*!
+	 * \brief number of threads running the plugin parsers next to the
+	 *        capture thread. The parsers that write different state tables
+	 *        parse the same event in parallel, see sinsp_plugin_parse_pool.
+	 *        0 (default) runs them one after the other on the capture thread.
+	 */
+	void set_plugin_parse_threads(uint32_t val);
+
 
 	/*!
 	  \brief Start writing the captured events to file.
@@ -466,6 +1079,28 @@ public:
 	*/
 	void autodump_stop();
 
+	/*!
+	  \brief Makes the files written by \ref autodump_start(), including the
+	   ones opened when the cycle writer rolls over, write their data from a
+	   background thread (see sinsp_dumper::enable_async). 0 disables it.
+	   Takes effect from the next file.
+	*/
+	void set_autodump_async(uint32_t bufsize, uint32_t nbufs);
+
+	/*!
+	  \brief Returns the number of events dropped by the asynchronous writes
+	   of the files written by \ref autodump_start().
+	*/
+	uint64_t get_autodump_dropped_events() const;
+
+	/*!
+	  \brief When the cycle writer rolls over, closes the previous file on a
+	   background thread, and writes the process table of the next one from
+	   the inspector state instead of scanning /proc again, so that the
+	   rotation doesn't stall the capture. Disabled by default.
+	*/
+	void set_autodump_background_rotation(bool enable);
+
 	/*!
 	  \brief Populate the given vector with the full list of filter check fields
 	   that this version of the library supports.
@@ -524,6 +1159,17 @@ public:
 	*/
 	threadinfo_map_t::ptr_t get_thread_ref(int64_t tid, bool query_os_if_not_found = false, bool lookup_only = true, bool main_thread = false);
 
+	/*!
+	  \brief Same as get_thread_ref(), but returns a borrowed pointer,
+	   without the reference count updates of the shared_ptr.
+
+	  \note the pointer is valid until the thread is removed from the
+	   thread table, which can happen as soon as the next event is
+	   processed. Use get_thread_ref() or sinsp_evt::get_thread_info_ref()
+	   to keep the thread for longer.
+	*/
+	sinsp_threadinfo* get_thread(int64_t tid, bool query_os_if_not_found = false, bool lookup_only = true, bool main_thread = false);
+
 	/*!
 	  \brief Fill the given structure with statistics about the currently
 	   open capture.
@@ -701,6 +1347,19 @@ public:
 	*/
 	void set_large_envs(bool enable);
 
+	/*!
+	  \brief Enable/disable the workload counters
+
+	  \param enable when it is true, the parser counts the events and the
+	  bytes read and written by every thread. They are available as the
+	  "num_events", "bytes_read" and "bytes_written" fields of the thread
+	  table, aggregated by process and container through
+	  sinsp_thread_manager::get_process_workloads() and
+	  get_container_workloads(), and exported by get_stats() as
+	  PPM_SCAP_STATS_WORKLOAD_COUNTERS metrics.
+	*/
+	void set_workload_counters(bool enable);
+
 	/*!
 	  \brief Set the debugging mode of the inspector.
 
@@ -718,6 +1377,16 @@ public:
 	*/
 	void set_fatfile_dump_mode(bool enable_fatfile);
 
+	/*!
+	  \brief Set the minimal state mode when writing events to file with
+	  autodump_start(): of the events filtered out, only the ones needed to
+	  replay the kept ones are saved (see sinsp_dumper::enable_minimal_state).
+
+	  \note This replaces the fatfile mode, saving much less for narrow
+	   filters.
+	*/
+	void set_minimal_state_dump_mode(bool enable);
+
 	/*!
 	  \brief Set internal events mode.
 
@@ -762,6 +1431,49 @@ public:
 	*/
 	void set_max_evt_output_len(uint32_t len);
 
+	/*!
+	  \brief Enables or disables the extraction cache shared by the filters
+	   compiled for this inspector. When enabled, the filters compiled
+	   afterwards extract each field at most once per event, no matter how
+	   many of them use it. Filters compiled before keep their current setting.
+
+	  \note The cache is not thread-safe: don't enable it when the filters are
+	   evaluated concurrently, e.g. by the workers of a sinsp_evt_pipeline.
+	*/
+	void set_filter_extraction_cache(bool enable);
+
+	/*!
+	  \brief Returns the shared extraction cache of the filters, or nullptr
+	   if it is disabled. Its metrics report the hit rate across all the
+	   filters using it.
+	*/
+	inline std::shared_ptr<sinsp_filter_extraction_cache> get_filter_extraction_cache() const
+	{
+		return m_filter_extraction_cache;
+	}
+
+	/*!
+	  \brief Enables or disables the evaluation cache shared by the filters
+	   compiled for this inspector. When enabled, the filters compiled
+	   afterwards evaluate each subexpression they have in common with other
+	   filters at most once per event. Filters compiled before keep their
+	   current setting.
+
+	  \note The cache is not thread-safe: don't enable it when the filters are
+	   evaluated concurrently, e.g. by the workers of a sinsp_evt_pipeline.
+	*/
+	void set_filter_eval_cache(bool enable);
+
+	/*!
+	  \brief Returns the shared evaluation cache of the filters, or nullptr
+	   if it is disabled. Its metrics report the hit rate across all the
+	   filters using it.
+	*/
+	inline std::shared_ptr<sinsp_filter_eval_cache> get_filter_eval_cache() const
+	{
+		return m_filter_eval_cache;
+	}
+
 	/*!
 	  \brief Returns true if the debug mode is enabled.
 	*/
@@ -902,6 +1614,30 @@ public:
 	*/
 	void mark_ppm_sc_of_interest(ppm_sc_code ppm_sc, bool enabled = true);
 
+	/*!
+		\brief Replace the set of interesting scap codes of a running live capture, e.g.
+		when a new ruleset is loaded. Only the codes that differ from the current set are
+		enabled or disabled in the driver, without reopening it, so neither the events of
+		the codes in both sets nor the state of the inspector are lost. If the driver
+		refuses a change, the changes already applied are reverted and an exception
+		is thrown.
+
+		An empty set enables all the codes, as at open time.
+
+		WARNING: as for `mark_ppm_sc_of_interest`, dropping the codes `libsinsp` needs
+		could break its state collection, see `libsinsp::events::sinsp_repair_state_sc_set`.
+	*/
+	void set_ppm_sc_of_interest(const libsinsp::events::set<ppm_sc_code>& ppm_sc_of_interest);
+
+	/*!
+		\brief Return the set of interesting scap codes of the live capture, as set when
+		opening the inspector and modified since then.
+	*/
+	const libsinsp::events::set<ppm_sc_code>& get_ppm_sc_of_interest() const
+	{
+		return m_ppm_sc_of_interest;
+	}
+
 	/*=============================== PPM_SC set related (ppm_sc.cpp) ===============================*/
 
 	/*=============================== Engine related ===============================*/
@@ -926,6 +1662,53 @@ public:
 	{
 		return scap_ftell(m_h);
 	}
+
+	/*!
+	  \brief Moves a capture to its first event not older than ts, so that
+	  it's the next one returned by next(). If the capture has a state
+	  checkpoint older than ts (see sinsp_dumper::enable_checkpoints), the
+	  state is restored from it and the events after it are parsed up to ts.
+	  Otherwise the events skipped are not parsed, so the state they would
+	  build is missing, and an event index is needed (see
+	  sinsp_dumper::enable_index). Either way, the capture must be
+	  uncompressed.
+
+	  \return false if the capture can't be seeked by time.
+	*/
+	bool seek_to_timestamp(uint64_t ts);
+
+	/*!
+	  \brief Moves a capture to its last state checkpoint older than ts
+	  (see sinsp_dumper::enable_checkpoints) and replaces the state with
+	  the one saved there, as if the capture was restarted. next() returns
+	  the events that follow the checkpoint.
+
+	  \return false if the capture has no such checkpoint.
+	*/
+	bool restore_checkpoint(uint64_t ts);
+
+	/*!
+	  \brief Makes next() skip the events of a capture whose type isn't in
+	  event_types or whose timestamp is out of [ts_min, ts_max]. The
+	  savefile reader only reads their header, and they are not parsed:
+	  to keep the state, event_types should include
+	  libsinsp::events::sinsp_state_event_set(), for example merged with
+	  the event codes of the filter (see sinsp_filter::get_event_codes).
+
+	  \return false if the capture can't be filtered this way.
+	*/
+	bool set_read_filter(const libsinsp::events::set<ppm_event_code>& event_types,
+			     uint64_t ts_min = 0, uint64_t ts_max = UINT64_MAX);
+
+	/*!
+	  \brief Fills index with the event index of the capture (see
+	  sinsp_dumper::enable_index): the timestamp and the position of
+	  some of its events, in file order. The positions are comparable
+	  with get_bytes_read().
+
+	  \return false if the capture has no event index.
+	*/
+	bool get_event_index(std::vector<std::pair<uint64_t, uint64_t>>& index);
 	void refresh_ifaddr_list();
 	void refresh_proc_list() {
 		scap_refresh_proc_table(m_h);
@@ -945,7 +1728,8 @@ public:
 #endif
 
 	// Add comm to the list of comms for which the inspector
-	// should not return events.
+	// should not return events. On live captures the driver
+	// drops most of their events too (see scap_suppress_events_comm).
 	bool suppress_events_comm(const std::string &comm);
 
 	bool check_suppressed(int64_t tid);
@@ -969,6 +1753,42 @@ public:
 	void add_cri_socket_path(const std::string &path);
 	void set_cri_timeout(int64_t timeout_ms);
 	void set_cri_async(bool async);
+	/*!
+	  \brief If true (default), the running CRI containers and pod sandboxes
+	  are listed when the CRI engine starts, instead of being looked up one
+	  by one as their threads are found. Must be called before open.
+	*/
+	void set_cri_warmup(bool warmup);
+	/*!
+	  \brief Number of threads doing the asynchronous CRI lookups (1 by
+	  default), so that a burst of new containers doesn't queue up behind
+	  a single one. Must be called before open.
+	*/
+	void set_cri_async_workers(uint32_t workers);
+	/*!
+	  \brief File where the container metadata, with the users and groups
+	  of the containers, is saved when a live capture is closed, and
+	  restored from when the next one is opened. The containers that
+	  aren't running anymore are dropped after the /proc scan, the others
+	  don't need a new lookup. Empty (the default) disables it. Must be
+	  called before open.
+	*/
+	void set_container_snapshot_file(const std::string& path);
+	/*!
+	  \brief File where the threads and their fds are saved, in the
+	  savefile format, when a live capture is closed, and restored from
+	  when the next one is opened instead of scanning /proc, which takes
+	  long on the big hosts. A file from a previous boot is ignored. The
+	  restored threads that are gone are dropped by a purge starting with
+	  the first events, and the processes started in the meantime are
+	  read from /proc when their first event is seen. The fds are
+	  restored as they were saved: the ones closed in the meantime are
+	  replaced when their number is reused. Unless a container snapshot
+	  file is set, the containers with their users and groups are saved
+	  next to it, in <path>.containers (see set_container_snapshot_file).
+	  Empty (the default) disables it. Must be called before open.
+	*/
+	void set_state_snapshot_file(const std::string& path);
 
 	void set_container_labels_max_len(uint32_t max_label_len);
 
@@ -1011,13 +1831,37 @@ VISIBILITY_PRIVATE
 private:
 #endif
 
+	//
+	// The storage of an event returned by next_batch()
+	//
+	struct batch_slot
+	{
+		batch_slot(sinsp* inspector);
+
+		sinsp_evt m_evt;
+		// the event data, the params of m_evt point into it
+		std::vector<char> m_raw;
+		// the fd info of m_evt when it was parsed
+		sinsp_fdinfo_t m_fdinfo;
+	};
+
 	void set_input_plugin(const std::string& name, const std::string& params);
 	void open_common(scap_open_args* oargs);
+	void open_plugin_sources();
+	int32_t merge_plugin_sources(int32_t res, sinsp_evt* evt);
+	int32_t reorder_events(int32_t res, sinsp_evt* evt);
+	// next(), parsing into the storage of a slot of next_batch() if not NULL
+	int32_t next_into(batch_slot* slot, bool run_housekeeping, OUT sinsp_evt **puevt);
+	void housekeeping(uint64_t ts);
 	void init();
 	void deinit_state();
+	void autodump_open(const std::string& dump_filename, bool compress, bool threads_from_sinsp);
 	void consume_initialstate_events();
 	bool is_initialstate_event(scap_evt* pevent);
 	void import_thread_table();
+	scap_t* open_state_snapshot(const scap_open_args* oargs);
+	void restore_state_snapshot(scap_t* snapshot);
+	void save_state_snapshot();
 	void import_ifaddr_list();
 	void import_user_list();
 	void add_protodecoders();
@@ -1053,6 +1897,8 @@ private:
 
 	void fseek(uint64_t filepos)
 	{
+		// The replayed event belongs to the old position
+		m_replay_scap_evt = NULL;
 		scap_fseek(m_h, filepos);
 	}
 
@@ -1068,6 +1914,10 @@ private:
 	void get_read_progress_plugin(OUT double* nres, std::string* sres);
 
 	void get_procs_cpu_from_driver(uint64_t ts);
+	void update_adaptive_sampling(uint64_t ts);
+	void update_adaptive_snaplen(uint64_t ts);
+	void clear_snaplen_limits();
+	sinsp_table_memory& table_memory(sinsp_state_table table);
 
 	scap_t* m_h;
 	uint64_t m_nevts;
@@ -1080,12 +1930,22 @@ private:
 	std::string m_input_filename;
 	bool m_isdebug_enabled;
 	bool m_isfatfile_enabled;
+	bool m_isminimal_state_dump_enabled;
 	bool m_isinternal_events_enabled;
 	bool m_hostname_and_port_resolution_enabled;
 	char m_output_time_flag;
 	uint32_t m_max_evt_output_len;
 	bool m_compress;
 	sinsp_evt m_evt;
+	// storage of the events returned by next_batch(), reused across calls
+	std::vector<std::unique_ptr<batch_slot>> m_batch_slots;
+	// the threads that exited during the last batch, see housekeeping()
+	std::vector<std::weak_ptr<sinsp_threadinfo>> m_batch_exited_threads;
+	// the result that ended the last batch early, for the next call
+	int32_t m_batch_res;
+	// plugins with async fields extracted ahead of time, fed with the
+	// events of next_batch()
+	std::vector<std::shared_ptr<sinsp_plugin>> m_async_extract_plugins;
 	std::string m_lasterr;
 	int64_t m_tid_to_remove;
 	int64_t m_tid_of_fd_to_remove;
@@ -1095,6 +1955,10 @@ private:
 	sinsp_parser* m_parser;
 	// the statistics analysis engine
 	std::unique_ptr<sinsp_dumper> m_dumper;
+	std::string m_dumper_filename;
+	// Closes the files left behind by the background rotations
+	std::unique_ptr<sinsp_dumper_closer> m_dumper_closer;
+	bool m_autodump_background_rotation;
 	bool m_is_dumping;
 	const scap_machine_info* m_machine_info;
 	const scap_agent_info* m_agent_info;
@@ -1169,6 +2033,10 @@ public:
 	sinsp_filter* m_filter;
 	std::string m_filterstring;
 	std::shared_ptr<libsinsp::filter::ast::expr> m_internal_flt_ast;
+	// the scap codes enabled in the driver of a live capture
+	libsinsp::events::set<ppm_sc_code> m_ppm_sc_of_interest;
+	std::shared_ptr<sinsp_filter_extraction_cache> m_filter_extraction_cache;
+	std::shared_ptr<sinsp_filter_eval_cache> m_filter_eval_cache;
 
 	//
 	// Internal stats
@@ -1184,6 +2052,18 @@ public:
 	// Saved snaplen
 	//
 	uint32_t m_snaplen;
+	uint32_t m_fd_type_snaplen[PPM_SNAPLEN_FD_MAX];
+
+	//
+	// Saved syscall limits
+	//
+	std::map<ppm_sc_code, scap_syscall_limit> m_syscall_limits;
+
+	//
+	// Saved cgroup filter
+	//
+	ppm_cgroup_filter_mode m_cgroup_filter_mode;
+	std::set<uint64_t> m_cgroup_filter;
 
 	//
 	// Saved increased capture range
@@ -1200,6 +2080,8 @@ public:
 	// Some thread table limits
 	//
 	uint32_t m_max_fdtable_size;
+	// Accounted memory of the fd tables of all the threads
+	sinsp_table_memory m_fd_memory;
 	bool m_automatic_threadtable_purging = true;
 	uint64_t m_thread_timeout_ns = (uint64_t)1800 * ONE_SECOND_IN_NS;
 	uint64_t m_inactive_thread_scan_time_ns = (uint64_t)1200 * ONE_SECOND_IN_NS;
@@ -1258,12 +2140,15 @@ public:
 	// *	user added/removed events
 	// * 	group added/removed events
 #ifndef _WIN32
-	tbb::concurrent_queue<std::shared_ptr<sinsp_evt>> m_pending_state_evts;
+	state_event_queue m_pending_state_evts;
 #endif
 
 	// Holds an event dequeued from the above queue
 	std::shared_ptr<sinsp_evt> m_state_evt;
 
+	// Recycles the events of the above queue
+	async_event_pool m_async_evt_pool;
+
 	//
 	// End of second housekeeping
 	//
@@ -1272,6 +2157,28 @@ public:
 	uint64_t m_last_procrequest_tod;
 	sinsp_proc_metainfo m_meinfo;
 	uint64_t m_next_stats_print_time_ns;
+	bool m_adaptive_sampling = false;
+	uint64_t m_sampling_check_interval_ns = ONE_SECOND_IN_NS;
+	uint64_t m_next_sampling_check_ns = 0;
+	sampling_controller m_sampling_controller;
+	bool m_adaptive_snaplen = false;
+	uint64_t m_snaplen_check_interval_ns = ONE_SECOND_IN_NS;
+	uint64_t m_next_snaplen_check_ns = 0;
+	snaplen_controller m_snaplen_controller;
+	bool m_event_coalescing = false;
+	event_coalescer m_event_coalescer;
+	event_reorderer m_event_reorderer;
+	latency_profiler m_latency_profiler;
+	event_lag_monitor m_lag_monitor;
+	state_view_publisher m_state_views;
+	std::vector<scap_stats_v2> m_memory_stats;
+	// Size of each driver buffer, 0 if unknown
+	unsigned long m_driver_buffer_bytes_dim = 0;
+	bool m_modern_bpf_numa_aware = false;
+	uint32_t m_modern_bpf_io_aggregation_period_ms = 0;
+	uint32_t m_modern_bpf_task_aggregation_period_ms = 0;
+	uint64_t m_modern_bpf_prog_budget_ns = 0;
+	bool m_modern_bpf_string_interning = false;
 
 	static unsigned int m_num_possible_cpus;
 #if defined(HAS_CAPTURE)
@@ -1283,6 +2190,27 @@ public:
 	//
 	uint64_t m_proc_scan_timeout_ms;
 	uint64_t m_proc_scan_log_interval_ms;
+	uint32_t m_proc_scan_threads;
+	uint64_t m_proc_scan_spill_bytes;
+	bool m_lazy_fd_scan;
+	uint32_t m_prefetch_distance;
+	std::string m_state_snapshot_path;
+	std::unique_ptr<sinsp_lazy_fd_loader> m_lazy_fd_loader;
+	std::unique_ptr<sinsp_connection_table> m_connection_table;
+
+	scap_ringbuffer_merge_mode m_ringbuffer_merge_mode;
+	uint32_t m_ringbuffer_consume_chunk_b;
+	bool m_ringbuffer_wakeup;
+	uint32_t m_ringbuffer_empty_threshold_b;
+	uint32_t m_ringbuffer_empty_wait_max_us;
+	uint32_t m_ringbuffer_wakeup_watermark_b;
+	uint32_t m_savefile_decompression_threads;
+	bool m_input_plugin_prefetch;
+	uint32_t m_gvisor_parse_threads;
+	uint32_t m_autodump_async_bufsize;
+	uint32_t m_autodump_async_nbufs;
+	// Events dropped by the autodump files already closed
+	uint64_t m_autodump_dropped_events;
 
 	// Any thread with a comm in this set will not have its events
 	// returned in sinsp::next()
@@ -1294,6 +2222,7 @@ public:
 	//
 	// Subset of loaded plugins that are used for event parsing.
 	std::vector<sinsp_plugin_parser> m_plugin_parsers;
+	std::unique_ptr<sinsp_plugin_parse_pool> m_plugin_parse_pool;
 	//
 	//
 	// The event sources available in the inspector
@@ -1309,6 +2238,10 @@ public:
 	//
 	std::string m_input_plugin_open_params;
 	//
+	// The source plugins opened next to the capture, see add_plugin_source()
+	//
+	std::vector<std::unique_ptr<sinsp_source_reader>> m_plugin_sources;
+	//
 	// An instance of scap_evt to be used during the next call to sinsp::next().
 	// If non-null, sinsp::next will use this pointer instead of invoking scap_next().
 	// After using this event, sinsp::next() will set this back to NULL.
@@ -1331,6 +2264,7 @@ public:
 	friend class sinsp_evt;
 	friend class sinsp_threadinfo;
 	friend class sinsp_fdtable;
+	friend class sinsp_lazy_fd_loader;
 	friend class sinsp_thread_manager;
 	friend class sinsp_container_manager;
 	friend class sinsp_dumper;
@@ -1349,6 +2283,8 @@ public:
 	friend class sinsp_filter_check_evtin;
 	friend class sinsp_baseliner;
 	friend class sinsp_memory_dumper;
+	friend class sinsp_parallel_replay;
+	friend class sinsp_metrics_collector;
 	friend class sinsp_network_interfaces;
 	friend class test_helper;
 	friend class sinsp_usergroup_manager;
@@ -28,3 +28,18 @@ typedef enum sinsp_pd_callback_type
 	CT_WRITE,
 	CT_TUPLE_CHANGE,
 }sinsp_pd_callback_type;
+
+//
+// Application protocol of a socket, classified from the first buffers
+// read or written on it (see sinsp_protodetector)
+//
+typedef enum sinsp_l7_proto
+{
+	L7_PROTO_UNCLASSIFIED = 0, // no buffer seen yet
+	L7_PROTO_UNKNOWN = 1, // no signature matched, or not a socket
+	L7_PROTO_HTTP = 2,
+	L7_PROTO_TLS = 3,
+	L7_PROTO_DNS = 4,
+	L7_PROTO_REDIS = 5,
+	L7_PROTO_MAX = 6,
+}sinsp_l7_proto;
@@ -18,6 +18,9 @@ limitations under the License.
 
 #define SINSP_PUBLIC
 
+// Size of a cache line, used to lay out the state read for every event
+#define SINSP_CACHE_LINE_SIZE 64
+
 #ifndef ASSERT
 
 #include <assert.h>
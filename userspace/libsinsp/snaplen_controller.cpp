@@ -0,0 +1,112 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "snaplen_controller.h"
+
+snaplen_controller::snaplen_controller():
+	m_max_snaplen(80)
+{
+	init(0.75, 0.25, 3, 16);
+}
+
+void snaplen_controller::init(double high_watermark, double low_watermark, uint32_t calm_intervals, uint32_t min_snaplen)
+{
+	m_high_watermark = high_watermark;
+	m_low_watermark = low_watermark;
+	m_calm_intervals = calm_intervals;
+	m_min_snaplen = min_snaplen;
+
+	reset();
+}
+
+void snaplen_controller::set_max_snaplen(uint32_t max_snaplen)
+{
+	m_max_snaplen = max_snaplen;
+
+	reset();
+}
+
+void snaplen_controller::reset()
+{
+	m_buffers.clear();
+}
+
+uint32_t snaplen_controller::update(uint16_t buffer, double buf_fill, uint64_t ts)
+{
+	if(buffer >= m_buffers.size())
+	{
+		m_buffers.resize(buffer + 1);
+	}
+
+	buffer_state& state = m_buffers[buffer];
+	uint32_t limit = state.m_limit;
+	uint32_t min_snaplen = m_min_snaplen < m_max_snaplen ? m_min_snaplen : m_max_snaplen;
+
+	if(buf_fill >= m_high_watermark)
+	{
+		state.m_calm = 0;
+		if(limit == NO_LIMIT)
+		{
+			limit = m_max_snaplen;
+		}
+		else if(limit > min_snaplen)
+		{
+			limit = limit / 2 > min_snaplen ? limit / 2 : min_snaplen;
+		}
+	}
+	else if(buf_fill < m_low_watermark)
+	{
+		if(++state.m_calm >= m_calm_intervals && limit != NO_LIMIT)
+		{
+			limit = limit < m_max_snaplen / 2 ? limit * 2 : NO_LIMIT;
+			state.m_calm = 0;
+		}
+	}
+	else
+	{
+		state.m_calm = 0;
+	}
+
+	if(limit != state.m_limit)
+	{
+		state.m_prev_limit = state.m_limit;
+		state.m_limit = limit;
+		state.m_change_ts = ts;
+	}
+
+	return limit;
+}
+
+uint32_t snaplen_controller::get_limit(uint16_t buffer) const
+{
+	if(buffer >= m_buffers.size())
+	{
+		return NO_LIMIT;
+	}
+
+	return m_buffers[buffer].m_limit;
+}
+
+uint32_t snaplen_controller::get_limit(uint16_t buffer, uint64_t ts) const
+{
+	if(buffer >= m_buffers.size())
+	{
+		return NO_LIMIT;
+	}
+
+	const buffer_state& state = m_buffers[buffer];
+	return ts < state.m_change_ts ? state.m_prev_limit : state.m_limit;
+}
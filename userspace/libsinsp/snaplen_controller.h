@@ -0,0 +1,112 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Picks the snaplen limit of every driver buffer (see
+// sinsp::set_adaptive_snaplen) from how full it is: the first time a buffer
+// crosses the high watermark its I/O buffers are capped to max_snaplen,
+// which also takes back the longer snaplen of the dynamic snaplen, then the
+// limit halves at every update it stays busy, down to min_snaplen. Once the
+// buffer stayed mostly empty for a while, the limit doubles back until it's
+// removed. Each buffer is controlled on its own, so that a busy CPU doesn't
+// truncate the data of the quiet ones.
+//
+// The controller also remembers when the limit of each buffer last
+// changed, to tell which limit an event read later from that buffer was
+// captured with.
+class snaplen_controller
+{
+public:
+	// The limit of a buffer that is not under pressure, equal to
+	// PPM_SNAPLEN_NO_LIMIT
+	static const uint32_t NO_LIMIT = 0xffffffff;
+
+	snaplen_controller();
+
+	//
+	// Configure the controller and remove all the limits.
+	// high_watermark and low_watermark are fractions of the buffer
+	// size, calm_intervals is the number of consecutive updates below
+	// low_watermark needed to double the limit back, min_snaplen is
+	// the lowest limit.
+	//
+	void init(double high_watermark, double low_watermark, uint32_t calm_intervals, uint32_t min_snaplen);
+
+	//
+	// Set the first and highest limit, usually the global snaplen,
+	// and remove all the limits
+	//
+	void set_max_snaplen(uint32_t max_snaplen);
+
+	//
+	// Remove all the limits, keeping the configuration
+	//
+	void reset();
+
+	//
+	// Feed the fill of a buffer, as a fraction of its size, sampled at
+	// time ts. Returns the limit to apply to the buffer, NO_LIMIT
+	// meaning none.
+	//
+	uint32_t update(uint16_t buffer, double buf_fill, uint64_t ts);
+
+	//
+	// Return the current limit of a buffer
+	//
+	uint32_t get_limit(uint16_t buffer) const;
+
+	//
+	// Return the limit of a buffer at time ts. Only the last change
+	// is remembered: an event older than the one before it gets the
+	// limit in place between the two.
+	//
+	uint32_t get_limit(uint16_t buffer, uint64_t ts) const;
+
+	inline uint32_t get_max_snaplen() const
+	{
+		return m_max_snaplen;
+	}
+
+	inline uint32_t get_min_snaplen() const
+	{
+		return m_min_snaplen;
+	}
+
+private:
+	struct buffer_state
+	{
+		uint32_t m_limit = NO_LIMIT;
+		uint32_t m_prev_limit = NO_LIMIT;
+		uint64_t m_change_ts = 0;
+
+		//
+		// Number of consecutive updates below the low watermark
+		//
+		uint32_t m_calm = 0;
+	};
+
+	double m_high_watermark;
+	double m_low_watermark;
+	uint32_t m_calm_intervals;
+	uint32_t m_max_snaplen;
+	uint32_t m_min_snaplen;
+
+	std::vector<buffer_state> m_buffers;
+};
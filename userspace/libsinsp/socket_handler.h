@@ -464,7 +464,7 @@ public:
 			handled = false;
 			for(auto it = m_json_filters.cbegin(); it != m_json_filters.cend(); ++it)
 			{
-				json_ptr_t pjson = try_parse(m_jq, *js, *it, m_id, m_url.to_string(false));
+				json_ptr_t pjson = try_parse(get_json_query(*it), *js, *it, m_id, m_url.to_string(false));
 				if(pjson)
 				{
 					(m_obj.*m_json_callback)(pjson, m_id);
@@ -736,6 +736,7 @@ public:
 			if(*it == filter)
 			{
 				m_json_filters.erase(it);
+				m_jq.erase(filter);
 				return;
 			}
 		}
@@ -748,6 +749,7 @@ public:
 			if(*it == from)
 			{
 				*it = to;
+				m_jq.erase(from);
 				return;
 			}
 		}
@@ -770,24 +772,24 @@ public:
 	static json_ptr_t try_parse(json_query& jq, const std::string& json, const std::string& filter,
 				    const std::string& id, const std::string& url)
 	{
-		std::string filtered_json(json);
-		if(!filter.empty())
+		json_ptr_t root(new Json::Value());
+		if(filter.empty() || filter == ".")
 		{
-			// failure to parse is ok, it will fail over to the next filter
-			// and log error if all filters fail
-			if(jq.process(json, filter))
+			// identity filter, no need to go through jq
+			try
 			{
-				filtered_json = jq.result();
-				if (filtered_json.empty() && !jq.get_error().empty())
+				if(Json::Reader().parse(json, *root))
 				{
-					g_logger.log("Socket handler (" + id + "), [" +
-						     url + "] filter result is empty \"" +
-						     jq.get_error() + "\"; JSON: <" +
-						     json + ">, jq filter: <" + filter + '>',
-						     sinsp_logger::SEV_DEBUG);
+					return root;
 				}
 			}
-			else
+			catch(...) { }
+		}
+		else
+		{
+			// failure to parse is ok, it will fail over to the next filter
+			// and log error if all filters fail
+			if(!jq.process(json, filter))
 			{
 				g_logger.log("Socket handler (" + id + "), [" +
 					     url + "] filter processing error \"" +
@@ -796,24 +798,13 @@ public:
 					     sinsp_logger::SEV_DEBUG);
 				return nullptr;
 			}
-		}
-		json_ptr_t root(new Json::Value());
-		try
-		{
-			if(Json::Reader().parse(filtered_json, *root))
+
+			// the jq result is converted as it is, parsing the JSON only once
+			if(jq.result(*root))
 			{
-				/*
-				if(g_logger.get_severity() >= sinsp_logger::SEV_TRACE)
-				{
-					g_logger.log("Socket handler (" + id + "), [" + url + "] "
-								 "filtered JSON: " + json_as_string(*root),
-								 sinsp_logger::SEV_TRACE);
-				}
-				*/
 				return root;
 			}
 		}
-		catch(...) { }
 		g_logger.log("Socket handler (" + id + "), [" + url + "] parsing error; JSON: <" +
 					 json + ">, jq filter: <" + filter + '>', sinsp_logger::SEV_ERROR);
 		return nullptr;
@@ -852,6 +843,16 @@ public:
 	}
 
 private:
+	// one jq instance per filter, so that each filter is compiled only once
+	json_query& get_json_query(const std::string& filter)
+	{
+		auto& jq = m_jq[filter];
+		if(!jq)
+		{
+			jq.reset(new json_query());
+		}
+		return *jq;
+	}
 
 	typedef std::vector<char> password_vec_t;
 
@@ -1635,7 +1636,7 @@ private:
 	std::string              m_http_version;
 	std::vector<std::string> m_json_filters;
 	std::vector<std::string> m_json;
-	json_query               m_jq;
+	std::map<std::string, std::unique_ptr<json_query>> m_jq;
 	bool                     m_ssl_init_complete = false;
 	SSL_CTX*                 m_ssl_context = nullptr;
 	SSL*                     m_ssl_connection = nullptr;
@@ -0,0 +1,180 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <string.h>
+
+#include <chrono>
+
+#include "source_reader.h"
+#include "plugin.h"
+#include "logger.h"
+#include "scap_open_exception.h"
+#include "thread_placement.h"
+
+sinsp_source_reader::sinsp_source_reader(std::shared_ptr<sinsp_plugin> plugin,
+	const std::string& open_params, uint32_t queue_size):
+		m_plugin(plugin),
+		m_open_params(open_params),
+		m_queue_size(queue_size > 0 ? queue_size : 1),
+		m_h(NULL),
+		m_stop(false),
+		m_done(true)
+{
+}
+
+sinsp_source_reader::~sinsp_source_reader()
+{
+	close();
+}
+
+void sinsp_source_reader::open()
+{
+	scap_open_args oargs{};
+	struct scap_source_plugin_engine_params params;
+	oargs.engine_name = SOURCE_PLUGIN_ENGINE;
+	oargs.mode = SCAP_MODE_PLUGIN;
+	params.input_plugin = &m_plugin->as_scap_source();
+	params.input_plugin_params = (char*)m_open_params.c_str();
+	params.input_plugin_prefetch = false;
+	oargs.engine_params = &params;
+
+	m_h = scap_alloc();
+	if(m_h == NULL)
+	{
+		throw scap_open_exception("failed to allocate scap handle", SCAP_FAILURE);
+	}
+
+	int32_t scap_rc = scap_init(m_h, &oargs);
+	if(scap_rc != SCAP_SUCCESS)
+	{
+		std::string error = scap_getlasterr(m_h);
+		scap_close(m_h);
+		m_h = NULL;
+		throw scap_open_exception("plugin " + m_plugin->name() + ": " + error, scap_rc);
+	}
+
+	m_stop = false;
+	m_done = false;
+	m_thread = std::thread(&sinsp_source_reader::run, this);
+}
+
+void sinsp_source_reader::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cond.notify_all();
+
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+
+	if(m_h != NULL)
+	{
+		scap_close(m_h);
+		m_h = NULL;
+	}
+
+	m_queue.clear();
+	m_free.clear();
+	m_current.clear();
+	m_done = true;
+}
+
+scap_evt* sinsp_source_reader::peek(bool& done)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	done = m_done;
+	if(m_queue.empty())
+	{
+		return NULL;
+	}
+	return (scap_evt*)m_queue.front().data();
+}
+
+scap_evt* sinsp_source_reader::pop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(!m_current.empty())
+		{
+			m_free.push_back(std::move(m_current));
+		}
+		m_current = std::move(m_queue.front());
+		m_queue.pop_front();
+	}
+	m_cond.notify_all();
+	return (scap_evt*)m_current.data();
+}
+
+void sinsp_source_reader::run()
+{
+	libsinsp::thread_placement::apply(libsinsp::thread_placement::thread_class::AUXILIARY);
+
+	while(true)
+	{
+		scap_evt* evt;
+		uint16_t cpuid;
+		int32_t res = scap_next(m_h, &evt, &cpuid);
+		if(res == SCAP_TIMEOUT || res == SCAP_FILTERED_EVENT)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cond.wait_for(lock, std::chrono::milliseconds(TIMEOUT_WAIT_MS),
+				[this] { return m_stop; });
+			if(m_stop)
+			{
+				break;
+			}
+			continue;
+		}
+
+		if(res != SCAP_SUCCESS)
+		{
+			if(res != SCAP_EOF)
+			{
+				g_logger.format(sinsp_logger::SEV_ERROR,
+					"plugin %s stopped producing events: %s",
+					m_plugin->name().c_str(), scap_getlasterr(m_h));
+			}
+			break;
+		}
+
+		std::vector<uint8_t> buf;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if(!m_free.empty())
+			{
+				buf = std::move(m_free.back());
+				m_free.pop_back();
+			}
+		}
+		buf.assign((uint8_t*)evt, (uint8_t*)evt + evt->len);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait(lock, [this] { return m_stop || m_queue.size() < m_queue_size; });
+		if(m_stop)
+		{
+			break;
+		}
+		m_queue.push_back(std::move(buf));
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_done = true;
+}
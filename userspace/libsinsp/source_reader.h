@@ -0,0 +1,104 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "scap.h"
+#include "sinsp_public.h"
+
+class sinsp_plugin;
+
+/*!
+  \brief Reads the events of an additional source plugin opened next to the
+  main capture of the inspector (see `sinsp::add_plugin_source`).
+
+  The plugin is opened with its own scap handle, and a background thread
+  copies its events in a bounded queue. The inspector merges the queued events
+  with the ones of the main capture by timestamp, without ever waiting for
+  them, so that a slow source never delays the others. When the queue is full
+  the background thread stops reading from the plugin until the inspector
+  catches up.
+*/
+class SINSP_PUBLIC sinsp_source_reader
+{
+public:
+	sinsp_source_reader(std::shared_ptr<sinsp_plugin> plugin,
+		const std::string& open_params, uint32_t queue_size);
+	~sinsp_source_reader();
+
+	inline const std::shared_ptr<sinsp_plugin>& plugin() const
+	{
+		return m_plugin;
+	}
+
+	/*!
+	  \brief Opens the plugin and starts reading its events in the background.
+	  Throws a scap_open_exception if the plugin can't be opened.
+	*/
+	void open();
+
+	/*!
+	  \brief Stops the background thread, drops the queued events and closes
+	  the plugin.
+	*/
+	void close();
+
+	/*!
+	  \brief Returns the oldest queued event without removing it, or NULL if
+	  there is none. `done` is set to true when no more events will be queued.
+	*/
+	scap_evt* peek(bool& done);
+
+	/*!
+	  \brief Removes the oldest queued event and returns it. The event stays
+	  valid until the next call to pop() or close(). Must only be called after
+	  peek() returned an event.
+	*/
+	scap_evt* pop();
+
+private:
+	// How long the background thread waits before asking again for the
+	// events of a plugin that had none
+	static const uint32_t TIMEOUT_WAIT_MS = 1;
+
+	void run();
+
+	std::shared_ptr<sinsp_plugin> m_plugin;
+	std::string m_open_params;
+	size_t m_queue_size;
+	scap_t* m_h;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	bool m_stop;
+	bool m_done;
+	std::deque<std::vector<uint8_t>> m_queue;
+	// Buffers of the events already consumed, reused to copy new ones
+	std::vector<std::vector<uint8_t>> m_free;
+	// Event returned by the last pop()
+	std::vector<uint8_t> m_current;
+};
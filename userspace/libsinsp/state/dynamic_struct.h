@@ -43,6 +43,7 @@ public:
     public:
         field_info():
             m_index((size_t) -1),
+            m_offset(0),
             m_name(""),
             m_info(typeinfo::of<uint8_t>()),
             m_defsptr(NULL) {}
@@ -112,19 +113,15 @@ public:
         }
 
     private:
-        field_info(const std::string& n, size_t in, const typeinfo& i, void* defsptr)
+        field_info(const std::string& n, size_t in, size_t off, const typeinfo& i, void* defsptr)
             : m_index(in),
+              m_offset(off),
               m_name(n),
               m_info(i),
               m_defsptr(defsptr) { }
-        
-        template<typename T>
-        static field_info _build(const std::string& name, size_t index, void* defsptr)
-        {
-            return field_info(name, index, libsinsp::state::typeinfo::of<T>(), defsptr);
-        }
 
         size_t m_index;
+        size_t m_offset;
         std::string m_name;
         libsinsp::state::typeinfo m_info;
         void* m_defsptr;
@@ -173,7 +170,7 @@ public:
     class field_infos
     {
     public:
-        field_infos() = default;
+        field_infos(): m_block_size(0) { }
         virtual ~field_infos() = default;
         field_infos(field_infos&&) = default;
         field_infos& operator = (field_infos&&) = default;
@@ -207,7 +204,12 @@ public:
                 }
                 return it->second;
             }
-            m_definitions.insert({ name, field_info::_build<T>(name, m_definitions.size(), this) });
+            // fields are laid out in a single block in order of definition,
+            // so that the offsets of the fields already defined never change
+            auto t = libsinsp::state::typeinfo::of<T>();
+            size_t offset = (m_block_size + t.alignment() - 1) & ~(t.alignment() - 1);
+            m_definitions.insert({ name, field_info(name, m_definitions.size(), offset, t, this) });
+            m_block_size = offset + t.size();
             const auto& def = m_definitions.at(name);
             m_definitions_ordered.push_back(&def);
             return def;
@@ -216,25 +218,49 @@ public:
     private:
         std::unordered_map<std::string, field_info> m_definitions;
         std::vector<const field_info*> m_definitions_ordered;
+        size_t m_block_size;
         friend class dynamic_struct;
     };
 
     dynamic_struct(const std::shared_ptr<field_infos>& dynamic_fields)
-        : m_fields_len(0), m_fields(), m_dynamic_fields(dynamic_fields) { }
-    dynamic_struct(dynamic_struct&&) = default;
-    dynamic_struct& operator = (dynamic_struct&&) = default;
-    dynamic_struct(const dynamic_struct& s) = default;
-    dynamic_struct& operator = (const dynamic_struct& s) = default;
-    virtual ~dynamic_struct()
+        : m_fields_len(0), m_fields(nullptr), m_dynamic_fields(dynamic_fields) { }
+    dynamic_struct(dynamic_struct&& s)
+        : m_fields_len(s.m_fields_len), m_fields(s.m_fields), m_dynamic_fields(std::move(s.m_dynamic_fields))
     {
-        if (m_dynamic_fields)
+        s.m_fields_len = 0;
+        s.m_fields = nullptr;
+    }
+    dynamic_struct& operator = (dynamic_struct&& s)
+    {
+        if (this != &s)
         {
-            for (size_t i = 0; i < m_fields.size(); i++)
-            {
-                m_dynamic_fields->m_definitions_ordered[i]->info().destroy(m_fields[i]);
-                free(m_fields[i]);
-            }
+            destroy_dynamic_fields();
+            m_fields_len = s.m_fields_len;
+            m_fields = s.m_fields;
+            m_dynamic_fields = std::move(s.m_dynamic_fields);
+            s.m_fields_len = 0;
+            s.m_fields = nullptr;
+        }
+        return *this;
+    }
+    dynamic_struct(const dynamic_struct& s)
+        : m_fields_len(0), m_fields(nullptr), m_dynamic_fields(s.m_dynamic_fields)
+    {
+        _copy_dynamic_fields(s);
+    }
+    dynamic_struct& operator = (const dynamic_struct& s)
+    {
+        if (this != &s)
+        {
+            destroy_dynamic_fields();
+            m_dynamic_fields = s.m_dynamic_fields;
+            _copy_dynamic_fields(s);
         }
+        return *this;
+    }
+    virtual ~dynamic_struct()
+    {
+        destroy_dynamic_fields();
     }
 
     /**
@@ -243,12 +269,7 @@ public:
     template <typename T>
     inline const T& get_dynamic_field(const field_accessor<T>& a)
     {
-        if (!a.info().valid())
-        {
-            throw sinsp_exception("can't get invalid field in dynamic struct");
-        }
-        _check_defsptr(a.info().m_defsptr);
-        return *(reinterpret_cast<T*>(_access_dynamic_field(a.info().m_index)));
+        return *_access_dynamic_field<T>(a);
     }
 
     /**
@@ -257,12 +278,7 @@ public:
     template <typename T>
     inline void set_dynamic_field(const field_accessor<T>& a, const T& v)
     {
-        if (!a.info().valid())
-        {
-            throw sinsp_exception("can't set invalid field in dynamic struct");
-        }
-        _check_defsptr(a.info().m_defsptr);
-        *(reinterpret_cast<T*>(_access_dynamic_field(a.info().m_index))) = v;
+        *_access_dynamic_field<T>(a) = v;
     }
 
     /**
@@ -291,7 +307,53 @@ public:
         m_dynamic_fields = defs;
     }
 
+protected:
+    /**
+     * @brief Destroys the values of all the dynamic fields, which will be
+     * constructed again with their default value when accessed.
+     */
+    inline void destroy_dynamic_fields()
+    {
+        if (m_dynamic_fields)
+        {
+            for (size_t i = 0; i < m_fields_len; i++)
+            {
+                auto def = m_dynamic_fields->m_definitions_ordered[i];
+                def->info().destroy(m_fields + def->m_offset);
+            }
+        }
+        free(m_fields);
+        m_fields = nullptr;
+        m_fields_len = 0;
+    }
+
 private:
+    /**
+     * @brief Returns a pointer to the value of the field of the given
+     * accessor. The fields of a struct are stored in a single block that
+     * is allocated when a field is first accessed, so once all the fields
+     * are defined this is a bounds check and an offset.
+     */
+    template <typename T>
+    inline T* _access_dynamic_field(const field_accessor<T>& a)
+    {
+        // note: invalid accessors have a null defsptr and an index that
+        // is never in range
+        const auto& info = a.m_info;
+        if (info.m_defsptr == m_dynamic_fields.get() && info.m_index < m_fields_len)
+        {
+            return reinterpret_cast<T*>(m_fields + info.m_offset);
+        }
+
+        if (!info.valid())
+        {
+            throw sinsp_exception("can't access invalid field in dynamic struct");
+        }
+        _check_defsptr(info.m_defsptr);
+        _grow_dynamic_fields(info.m_index);
+        return reinterpret_cast<T*>(m_fields + info.m_offset);
+    }
+
     inline void _check_defsptr(void* ptr) const
     {
         if (m_dynamic_fields.get() != ptr)
@@ -300,29 +362,64 @@ private:
         }
     }
 
-    inline void* _access_dynamic_field(size_t index)
+    /**
+     * @brief Reallocates the block of fields so that it fits all the fields
+     * defined so far, constructing the new ones with their default value.
+     * The values of the fields constructed before are moved to the new block.
+     */
+    inline void _grow_dynamic_fields(size_t index)
     {
         if (!m_dynamic_fields)
         {
             throw sinsp_exception("dynamic struct has no field definitions");
         }
-        if (index >= m_dynamic_fields->m_definitions_ordered.size())
+        const auto& defs = m_dynamic_fields->m_definitions_ordered;
+        if (index >= defs.size())
         {
             throw sinsp_exception("dynamic struct access overflow: " + std::to_string(index));
         }
-        while (m_fields_len <= index)
+        auto fields = reinterpret_cast<uint8_t*>(malloc(m_dynamic_fields->m_block_size));
+        if (!fields)
+        {
+            throw sinsp_exception("dynamic struct allocation failed");
+        }
+        for (size_t i = 0; i < defs.size(); i++)
+        {
+            if (i < m_fields_len)
+            {
+                defs[i]->info().relocate(fields + defs[i]->m_offset, m_fields + defs[i]->m_offset);
+            }
+            else
+            {
+                defs[i]->info().construct(fields + defs[i]->m_offset);
+            }
+        }
+        free(m_fields);
+        m_fields = fields;
+        m_fields_len = defs.size();
+    }
+
+    inline void _copy_dynamic_fields(const dynamic_struct& s)
+    {
+        if (s.m_fields_len == 0)
+        {
+            return;
+        }
+        const auto& defs = m_dynamic_fields->m_definitions_ordered;
+        m_fields = reinterpret_cast<uint8_t*>(malloc(m_dynamic_fields->m_block_size));
+        if (!m_fields)
+        {
+            throw sinsp_exception("dynamic struct allocation failed");
+        }
+        for (size_t i = 0; i < s.m_fields_len; i++)
         {
-            auto def = m_dynamic_fields->m_definitions_ordered[m_fields_len];
-            void* fieldbuf = malloc(def->info().size());
-            def->info().construct(fieldbuf);
-            m_fields.push_back(fieldbuf);
+            defs[i]->info().copy(m_fields + defs[i]->m_offset, s.m_fields + defs[i]->m_offset);
             m_fields_len++;
         }
-        return m_fields[index];
     }
 
     size_t m_fields_len;
-    std::vector<void*> m_fields;
+    uint8_t* m_fields;
     std::shared_ptr<field_infos> m_dynamic_fields;
 };
 
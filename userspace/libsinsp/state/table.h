@@ -164,6 +164,21 @@ public:
      */
     virtual std::shared_ptr<table_entry> get_entry(const KeyType& key) = 0;
 
+    /**
+     * @brief Same as get_entry(), but returns a raw pointer owned by the
+     * table. This is meant for callers that don't retain the entry, such
+     * as the plugin API, and tables can override it with a lookup that
+     * avoids the shared_ptr reference counting.
+     *
+     * @param key Key of the entry to be retrieved.
+     * @return table_entry* Pointer to the entry if present in the table
+     * at the given key, and nullptr otherwise.
+     */
+    virtual table_entry* get_entry_ptr(const KeyType& key)
+    {
+        return get_entry(key).get();
+    }
+
     /**
      * @brief Inserts a new entry in the table with the given key. If another
      * entry is already present with the same key, it gets replaced. After
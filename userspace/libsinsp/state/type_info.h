@@ -19,6 +19,8 @@ limitations under the License.
 #include "../sinsp_exception.h"
 #include "../../driver/ppm_events_public.h"
 
+#include <memory>
+#include <new>
 #include <string>
 #include <vector>
 
@@ -92,6 +94,14 @@ public:
         return m_size;
     }
 
+    /**
+     * @brief Returns the alignment required by variables of the given type.
+     */
+    inline size_t alignment() const
+    {
+        return m_align;
+    }
+
     /**
      * @brief Constructs and initializes the given type in the passed-in
      * memory location, which is expected to be larger or equal than size().
@@ -101,6 +111,24 @@ public:
         if (p && m_construct) m_construct(p);
     }
 
+    /**
+     * @brief Constructs the given type in the passed-in memory location
+     * dst as a copy of the value at src.
+     */
+    inline void copy(void* dst, const void* src) const
+    {
+        if (dst && src && m_copy) m_copy(dst, src);
+    }
+
+    /**
+     * @brief Constructs the given type in the passed-in memory location
+     * dst by moving the value at src, and destroys the value at src.
+     */
+    inline void relocate(void* dst, void* src) const noexcept
+    {
+        if (dst && src && m_relocate) m_relocate(dst, src);
+    }
+
     /**
      * @brief Destructs and deinitializes the given type in the passed-in
      * memory location, which is expected to be larger or equal than size().
@@ -111,8 +139,11 @@ public:
     }
 
 private:
-    inline typeinfo(const char* n, index_t k, size_t s, void (*c)(void*), void (*d)(void*))
-        : m_name(n), m_index(k), m_size(s), m_construct(c), m_destroy(d) { }
+    inline typeinfo(const char* n, index_t k, size_t s, size_t a,
+            void (*c)(void*), void (*d)(void*),
+            void (*cp)(void*, const void*), void (*r)(void*, void*))
+        : m_name(n), m_index(k), m_size(s), m_align(a), m_construct(c),
+          m_destroy(d), m_copy(cp), m_relocate(r) { }
 
     template <typename T> static inline void _construct(void* p)
     {
@@ -124,16 +155,31 @@ private:
         std::allocator<T>().destroy(reinterpret_cast<T*>(p));
     }
 
+    template <typename T> static inline void _copy(void* dst, const void* src)
+    {
+        new (dst) T(*reinterpret_cast<const T*>(src));
+    }
+
+    template <typename T> static inline void _relocate(void* dst, void* src)
+    {
+        new (dst) T(std::move(*reinterpret_cast<T*>(src)));
+        _destroy<T>(src);
+    }
+
     template<typename T> static inline typeinfo _build(const char* n, index_t k)
     {
-        return typeinfo(n, k, sizeof(T), _construct<T>, _destroy<T>);
+        return typeinfo(n, k, sizeof(T), alignof(T), _construct<T>, _destroy<T>,
+            _copy<T>, _relocate<T>);
     }
 
     const char* m_name;
     index_t m_index;
     size_t m_size;
+    size_t m_align;
     void (*m_construct)(void*);
     void (*m_destroy)(void*);
+    void (*m_copy)(void*, const void*);
+    void (*m_relocate)(void*, void*);
 };
 
 // below is the manually-controlled list of all the supported types
@@ -0,0 +1,136 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "state_event_queue.h"
+#include "event.h"
+
+state_event_queue::state_event_queue(uint32_t capacity):
+	m_mask(capacity - 1),
+	m_slots(new slot[capacity]),
+	m_head(0),
+	m_tail(0),
+	m_size(0),
+	m_overflowing(false),
+	m_num_overflows(0)
+{
+	ASSERT(capacity != 0 && (capacity & (capacity - 1)) == 0);
+
+	for(uint64_t i = 0; i < capacity; i++)
+	{
+		m_slots[i].m_seq.store(i, std::memory_order_relaxed);
+	}
+}
+
+state_event_queue::~state_event_queue() = default;
+
+//
+// A slot whose sequence number is equal to the position of the producer
+// is free, one past the position of the consumer is ready to be read
+//
+bool state_event_queue::push_ring(std::shared_ptr<sinsp_evt>& evt)
+{
+	uint64_t pos = m_head.load(std::memory_order_relaxed);
+	while(true)
+	{
+		slot& s = m_slots[pos & m_mask];
+		uint64_t seq = s.m_seq.load(std::memory_order_acquire);
+		int64_t diff = (int64_t)seq - (int64_t)pos;
+		if(diff == 0)
+		{
+			if(m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				s.m_evt = std::move(evt);
+				s.m_seq.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if(diff < 0)
+		{
+			// The ring is full
+			return false;
+		}
+		else
+		{
+			pos = m_head.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool state_event_queue::pop_ring(std::shared_ptr<sinsp_evt>& evt)
+{
+	slot& s = m_slots[m_tail & m_mask];
+	if(s.m_seq.load(std::memory_order_acquire) != m_tail + 1)
+	{
+		return false;
+	}
+
+	evt = std::move(s.m_evt);
+	s.m_seq.store(m_tail + m_mask + 1, std::memory_order_release);
+	m_tail++;
+	return true;
+}
+
+void state_event_queue::push(std::shared_ptr<sinsp_evt> evt)
+{
+	if(!m_overflowing.load(std::memory_order_acquire) && push_ring(evt))
+	{
+		m_size.fetch_add(1, std::memory_order_release);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_overflow_mutex);
+	m_overflow.push_back(std::move(evt));
+	m_overflowing.store(true, std::memory_order_release);
+	m_num_overflows.fetch_add(1, std::memory_order_relaxed);
+	m_size.fetch_add(1, std::memory_order_release);
+}
+
+bool state_event_queue::try_pop(std::shared_ptr<sinsp_evt>& evt)
+{
+	if(empty())
+	{
+		return false;
+	}
+
+	if(pop_ring(evt))
+	{
+		m_size.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	//
+	// The ring is drained, the overflowed events come next
+	//
+	if(!m_overflowing.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_overflow_mutex);
+	if(m_overflow.empty())
+	{
+		return false;
+	}
+
+	evt = std::move(m_overflow.front());
+	m_overflow.pop_front();
+	if(m_overflow.empty())
+	{
+		m_overflowing.store(false, std::memory_order_release);
+	}
+	m_size.fetch_sub(1, std::memory_order_relaxed);
+	return true;
+}
@@ -0,0 +1,95 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+class sinsp_evt;
+
+// The queue of the state events built by the inspector itself (see
+// sinsp::m_pending_state_evts), written from any thread, e.g. by the
+// async container lookups, and read by sinsp::next() before every event.
+//
+// The events go through a bounded ring of preallocated slots, each with a
+// sequence number telling whether it's free for the next producer or ready
+// for the consumer, so that pushing and popping don't lock nor allocate.
+// Checking for pending events is a single relaxed load.
+//
+// If the ring is full, e.g. because a burst of containers was started
+// while the consumer was busy, the events go to an overflow list instead
+// of being dropped. Once the overflow list is in use, the next events go
+// there too until it's drained, so that the events of a producer are
+// always read in order.
+class state_event_queue
+{
+public:
+	// Must be a power of 2
+	static const uint32_t DEFAULT_CAPACITY = 1024;
+
+	explicit state_event_queue(uint32_t capacity = DEFAULT_CAPACITY);
+	~state_event_queue();
+
+	state_event_queue(const state_event_queue&) = delete;
+	state_event_queue& operator=(const state_event_queue&) = delete;
+
+	//
+	// Queue an event. Can be called from any thread.
+	//
+	void push(std::shared_ptr<sinsp_evt> evt);
+
+	//
+	// Dequeue the oldest event, if any. Must be called from a single
+	// thread.
+	//
+	bool try_pop(std::shared_ptr<sinsp_evt>& evt);
+
+	inline bool empty() const
+	{
+		return m_size.load(std::memory_order_relaxed) == 0;
+	}
+
+	inline uint64_t get_num_overflows() const
+	{
+		return m_num_overflows.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct slot
+	{
+		std::atomic<uint64_t> m_seq;
+		std::shared_ptr<sinsp_evt> m_evt;
+	};
+
+	bool push_ring(std::shared_ptr<sinsp_evt>& evt);
+	bool pop_ring(std::shared_ptr<sinsp_evt>& evt);
+
+	const uint64_t m_mask;
+	std::unique_ptr<slot[]> m_slots;
+	std::atomic<uint64_t> m_head;
+	// Only read and written by the consumer
+	uint64_t m_tail;
+	std::atomic<uint64_t> m_size;
+
+	std::atomic<bool> m_overflowing;
+	std::mutex m_overflow_mutex;
+	std::deque<std::shared_ptr<sinsp_evt>> m_overflow;
+	std::atomic<uint64_t> m_num_overflows;
+};
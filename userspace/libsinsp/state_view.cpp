@@ -0,0 +1,140 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "state_view.h"
+
+const state_view::thread* state_view::get_thread(int64_t tid) const
+{
+	auto it = m_threads.find(tid);
+	if(it == m_threads.end())
+	{
+		return nullptr;
+	}
+
+	return it->second.get();
+}
+
+sinsp_container_info::ptr_t state_view::get_container(const std::string& id) const
+{
+	auto it = m_containers.find(id);
+	if(it == m_containers.end())
+	{
+		return nullptr;
+	}
+
+	return it->second;
+}
+
+static std::shared_ptr<const state_view::thread> make_thread(sinsp_threadinfo& tinfo)
+{
+	auto thread = std::make_shared<state_view::thread>();
+	thread->m_tid = tinfo.m_tid;
+	thread->m_pid = tinfo.m_pid;
+	thread->m_ptid = tinfo.m_ptid;
+	thread->m_sid = tinfo.m_sid;
+	thread->m_vpgid = tinfo.m_vpgid;
+	thread->m_vtid = tinfo.m_vtid;
+	thread->m_vpid = tinfo.m_vpid;
+	thread->m_comm = tinfo.m_comm;
+	thread->m_exe = tinfo.m_exe;
+	thread->m_exepath = tinfo.m_exepath;
+	thread->m_args = tinfo.m_args.get();
+	thread->m_cwd = tinfo.get_cwd();
+	thread->m_container_id = tinfo.m_container_id;
+	thread->m_uid = tinfo.get_user()->uid;
+	thread->m_gid = tinfo.get_group()->gid;
+	thread->m_loginuid = tinfo.get_loginuser()->uid;
+	thread->m_user = tinfo.get_user()->name;
+	thread->m_clone_ts = tinfo.m_clone_ts;
+	thread->m_lastexec_ts = tinfo.m_lastexec_ts;
+	thread->m_fd_opencount = tinfo.get_fd_opencount();
+	return thread;
+}
+
+state_view_publisher::state_view_publisher():
+	m_interval_ns(0),
+	m_next_publish_ts(0),
+	m_epoch(0)
+{
+}
+
+void state_view_publisher::set_interval(uint64_t interval_ns)
+{
+	m_interval_ns = interval_ns;
+	m_next_publish_ts = 0;
+	if(interval_ns == 0)
+	{
+		std::atomic_store(&m_current, std::shared_ptr<const state_view>());
+	}
+}
+
+void state_view_publisher::publish(sinsp* inspector, uint64_t ts)
+{
+	std::shared_ptr<const state_view> prev = std::atomic_load(&m_current);
+	auto view = std::make_shared<state_view>();
+	view->m_epoch = ++m_epoch;
+	view->m_ts = ts;
+
+	threadinfo_map_t* threads = inspector->m_thread_manager->get_threads();
+	view->m_threads.reserve(threads->size());
+	threads->loop([&](sinsp_threadinfo& tinfo) {
+		const sinsp_threadinfo* main_thread = tinfo.get_main_thread();
+
+		//
+		// Every event touching a thread updates its m_lastaccess_ts:
+		// the record of a thread that, along with its main thread
+		// which keeps the working directory, wasn't accessed since the
+		// previous view is still accurate
+		//
+		if(prev != nullptr &&
+		   tinfo.m_lastaccess_ts < prev->m_ts &&
+		   (main_thread == nullptr || main_thread->m_lastaccess_ts < prev->m_ts))
+		{
+			// The tid may belong to a new thread by now
+			auto it = prev->m_threads.find(tinfo.m_tid);
+			if(it != prev->m_threads.end() &&
+			   it->second->m_pid == tinfo.m_pid &&
+			   it->second->m_clone_ts == tinfo.m_clone_ts)
+			{
+				view->m_threads.emplace(tinfo.m_tid, it->second);
+				return true;
+			}
+		}
+
+		view->m_threads.emplace(tinfo.m_tid, make_thread(tinfo));
+		return true;
+	});
+
+	//
+	// The container infos are immutable already, they're replaced
+	// rather than updated
+	//
+	{
+		auto containers = inspector->m_container_manager.get_containers();
+		view->m_containers.insert(containers->begin(), containers->end());
+	}
+
+	std::atomic_store(&m_current, std::shared_ptr<const state_view>(std::move(view)));
+	m_next_publish_ts = ts + m_interval_ns;
+}
+
+std::shared_ptr<const state_view> state_view_publisher::get() const
+{
+	return std::atomic_load(&m_current);
+}
@@ -0,0 +1,150 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "container_info.h"
+
+class sinsp;
+
+// A read-only copy of the thread and container state, published by the
+// capture thread (see sinsp::set_state_view_interval) for the other
+// threads of the process, e.g. to serve queries while sinsp::next() keeps
+// running. A view is never modified once published: a new one replaces
+// it, and the old one is freed when its last reader drops it, so that
+// the readers never block the capture thread and vice versa.
+class state_view
+{
+public:
+	struct thread
+	{
+		int64_t m_tid;
+		int64_t m_pid;
+		int64_t m_ptid;
+		int64_t m_sid;
+		int64_t m_vpgid;
+		int64_t m_vtid;
+		int64_t m_vpid;
+		std::string m_comm;
+		std::string m_exe;
+		std::string m_exepath;
+		std::vector<std::string> m_args;
+		std::string m_cwd;
+		std::string m_container_id;
+		uint32_t m_uid;
+		uint32_t m_gid;
+		uint32_t m_loginuid;
+		std::string m_user;
+		uint64_t m_clone_ts;
+		uint64_t m_lastexec_ts;
+		uint64_t m_fd_opencount;
+	};
+
+	using thread_map_t = std::unordered_map<int64_t, std::shared_ptr<const thread>>;
+	using container_map_t = std::unordered_map<std::string, sinsp_container_info::ptr_t>;
+
+	//
+	// The number of the view, increasing by one at every publication
+	//
+	inline uint64_t get_epoch() const
+	{
+		return m_epoch;
+	}
+
+	//
+	// The timestamp of the event the view was taken at
+	//
+	inline uint64_t get_ts() const
+	{
+		return m_ts;
+	}
+
+	inline const thread_map_t& get_threads() const
+	{
+		return m_threads;
+	}
+
+	inline const container_map_t& get_containers() const
+	{
+		return m_containers;
+	}
+
+	const thread* get_thread(int64_t tid) const;
+	sinsp_container_info::ptr_t get_container(const std::string& id) const;
+
+private:
+	uint64_t m_epoch = 0;
+	uint64_t m_ts = 0;
+	thread_map_t m_threads;
+	container_map_t m_containers;
+
+	friend class state_view_publisher;
+};
+
+// Publishes the state views of an inspector. Everything but get() must be
+// called from the capture thread.
+class state_view_publisher
+{
+public:
+	state_view_publisher();
+
+	//
+	// Publish a view every interval_ns of event time, 0 disables the
+	// publication and drops the last view
+	//
+	void set_interval(uint64_t interval_ns);
+
+	//
+	// Called for every event with its timestamp
+	//
+	inline void on_event(sinsp* inspector, uint64_t ts)
+	{
+		if(m_interval_ns == 0 || ts < m_next_publish_ts)
+		{
+			return;
+		}
+
+		publish(inspector, ts);
+	}
+
+	//
+	// Take and publish a new view. The records of the threads that
+	// weren't accessed since the previous view are shared with it
+	// rather than copied again.
+	//
+	void publish(sinsp* inspector, uint64_t ts);
+
+	//
+	// Return the last published view, nullptr if none. Safe to call from
+	// any thread.
+	//
+	std::shared_ptr<const state_view> get() const;
+
+private:
+	uint64_t m_interval_ns;
+	uint64_t m_next_publish_ts;
+	uint64_t m_epoch;
+	// Only written by the capture thread, read by the others through
+	// std::atomic_load()
+	std::shared_ptr<const state_view> m_current;
+};
@@ -33,6 +33,11 @@ void sinsp_stats::clear()
 	m_n_failed_fd_lookups = 0;
 	m_n_threads = 0;
 	m_n_fds = 0;
+	m_n_lazy_fd_loads = 0;
+	m_n_prefetched_fd_loads = 0;
+	m_n_interned_vectors = 0;
+	m_interned_bytes = 0;
+	m_interned_unshared_bytes = 0;
 	m_n_added_fds = 0;
 	m_n_removed_fds = 0;
 	m_n_stored_evts = 0;
@@ -56,6 +61,12 @@ void sinsp_stats::emit(FILE* f)
 	fprintf(f, "failed fd lookups: %" PRIu64 "\n", m_n_failed_fd_lookups);
 	fprintf(f, "n. threads: %" PRIu64 "\n", m_n_threads);
 	fprintf(f, "n. fds: %" PRIu64 "\n", m_n_fds);
+	fprintf(f, "lazy fd loads: %" PRIu64 " (%" PRIu64 " prefetched)\n", m_n_lazy_fd_loads, m_n_prefetched_fd_loads);
+	fprintf(f, "thread args/env/cgroups: %" PRIu64 " distinct, %" PRIu64 " bytes (%" PRIu64 " unshared, %" PRIu64 " per thread)\n",
+		m_n_interned_vectors,
+		m_interned_bytes,
+		m_interned_unshared_bytes,
+		m_n_threads ? m_interned_bytes / m_n_threads : 0);
 	fprintf(f, "added fds: %" PRIu64 "\n", m_n_added_fds);
 	fprintf(f, "removed fds: %" PRIu64 "\n", m_n_removed_fds);
 	fprintf(f, "stored evts: %" PRIu64 "\n", m_n_stored_evts);
@@ -45,6 +45,11 @@ public:
 	uint64_t m_n_failed_fd_lookups;
 	uint64_t m_n_threads;
 	uint64_t m_n_fds;
+	uint64_t m_n_lazy_fd_loads;
+	uint64_t m_n_prefetched_fd_loads;
+	uint64_t m_n_interned_vectors;
+	uint64_t m_interned_bytes;
+	uint64_t m_interned_unshared_bytes;
 	uint64_t m_n_added_fds;
 	uint64_t m_n_removed_fds;
 	uint64_t m_n_stored_evts;
@@ -0,0 +1,430 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// The SIMD kernels use the same approach: for every block of input bytes,
+// the first and the last byte of the needle are compared with the bytes of
+// the haystack at the candidate positions, in parallel. Only the candidates
+// matching both are verified with a full comparison. The vector loads never
+// go past the end of the haystack: the last block is moved back to overlap
+// with the previous one. Haystacks shorter than a block use the scalar kernel.
+//
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "strsearch.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define STRSEARCH_X86
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define STRSEARCH_NEON
+#include <arm_neon.h>
+#endif
+
+namespace libsinsp {
+namespace strsearch {
+
+typedef const char* (*find_fn)(const char*, size_t, const char*, size_t);
+
+static inline uint8_t ascii_lower(uint8_t c)
+{
+	return (uint8_t)(c - 'A') < 26 ? c | 0x20 : c;
+}
+
+// Used to verify the candidates of the SIMD kernels. Calling memcmp here
+// would force the compiler to spill the vector registers at every block.
+static inline bool equal(const char* a, const char* b, size_t len)
+{
+	for(size_t i = 0; i < len; i++)
+	{
+		if(a[i] != b[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static inline bool ascii_iequal(const char* a, const char* b, size_t len)
+{
+	for(size_t i = 0; i < len; i++)
+	{
+		if(ascii_lower(a[i]) != ascii_lower(b[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Scalar kernels
+///////////////////////////////////////////////////////////////////////////////
+
+static const char* find_scalar(const char* h, size_t hlen, const char* n, size_t nlen)
+{
+	if(nlen == 0)
+	{
+		return h;
+	}
+
+	const char* end = h + hlen;
+	while(nlen <= (size_t)(end - h))
+	{
+		h = (const char*)memchr(h, n[0], (end - h) - nlen + 1);
+		if(h == NULL)
+		{
+			return NULL;
+		}
+		if(memcmp(h + 1, n + 1, nlen - 1) == 0)
+		{
+			return h;
+		}
+		h++;
+	}
+	return NULL;
+}
+
+static const char* ifind_scalar(const char* h, size_t hlen, const char* n, size_t nlen)
+{
+	if(nlen == 0)
+	{
+		return h;
+	}
+	if(nlen > hlen)
+	{
+		return NULL;
+	}
+
+	uint8_t first = ascii_lower(n[0]);
+	for(size_t i = 0; i <= hlen - nlen; i++)
+	{
+		if(ascii_lower(h[i]) == first && ascii_iequal(h + i + 1, n + 1, nlen - 1))
+		{
+			return h + i;
+		}
+	}
+	return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// x86 kernels
+///////////////////////////////////////////////////////////////////////////////
+#ifdef STRSEARCH_X86
+
+template<bool icase>
+static inline __m128i sse2_load(const char* p)
+{
+	__m128i v = _mm_loadu_si128((const __m128i*)p);
+	if(icase)
+	{
+		// set bit 5 of the bytes in ['A', 'Z']
+		__m128i t = _mm_sub_epi8(v, _mm_set1_epi8('A'));
+		__m128i upper = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(25)), t);
+		v = _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+	}
+	return v;
+}
+
+template<bool icase>
+static inline const char* verify(const char* h, size_t i, uint64_t mask, const char* n, size_t nlen)
+{
+	while(mask != 0)
+	{
+		size_t pos = i + __builtin_ctzll(mask);
+		if(icase ? ascii_iequal(h + pos + 1, n + 1, nlen - 2) : equal(h + pos + 1, n + 1, nlen - 2))
+		{
+			return h + pos;
+		}
+		mask &= mask - 1;
+	}
+	return NULL;
+}
+
+template<bool icase>
+static const char* find_sse2(const char* h, size_t hlen, const char* n, size_t nlen)
+{
+	// the number of candidate positions
+	size_t ncand = hlen - nlen + 1;
+	if(nlen < 2 || nlen > hlen || ncand < 16)
+	{
+		return icase ? ifind_scalar(h, hlen, n, nlen) : find_scalar(h, hlen, n, nlen);
+	}
+
+	const __m128i first = _mm_set1_epi8(icase ? ascii_lower(n[0]) : n[0]);
+	const __m128i last = _mm_set1_epi8(icase ? ascii_lower(n[nlen - 1]) : n[nlen - 1]);
+	auto block = [&](size_t i)
+	{
+		__m128i eq_first = _mm_cmpeq_epi8(first, sse2_load<icase>(h + i));
+		__m128i eq_last = _mm_cmpeq_epi8(last, sse2_load<icase>(h + i + nlen - 1));
+		return (uint64_t)_mm_movemask_epi8(_mm_and_si128(eq_first, eq_last));
+	};
+
+	size_t i = 0;
+	for(; i + 16 <= ncand; i += 16)
+	{
+		const char* res = verify<icase>(h, i, block(i), n, nlen);
+		if(res != NULL)
+		{
+			return res;
+		}
+	}
+
+	// the last block overlaps with the previous one, skip the positions already checked
+	if(i < ncand)
+	{
+		size_t j = ncand - 16;
+		return verify<icase>(h, j, block(j) >> (i - j) << (i - j), n, nlen);
+	}
+	return NULL;
+}
+
+template<bool icase>
+__attribute__((target("avx2")))
+static inline __m256i avx2_load(const char* p)
+{
+	__m256i v = _mm256_loadu_si256((const __m256i*)p);
+	if(icase)
+	{
+		__m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8('A'));
+		__m256i upper = _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(25)), t);
+		v = _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+	}
+	return v;
+}
+
+template<bool icase>
+__attribute__((target("avx2")))
+static const char* find_avx2(const char* h, size_t hlen, const char* n, size_t nlen)
+{
+	size_t ncand = hlen - nlen + 1;
+	if(nlen < 2 || nlen > hlen || ncand < 32)
+	{
+		return find_sse2<icase>(h, hlen, n, nlen);
+	}
+
+	const __m256i first = _mm256_set1_epi8(icase ? ascii_lower(n[0]) : n[0]);
+	const __m256i last = _mm256_set1_epi8(icase ? ascii_lower(n[nlen - 1]) : n[nlen - 1]);
+	size_t i = 0;
+	const char* res = NULL;
+	for(; i < ncand && res == NULL; i += 32)
+	{
+		// the last block overlaps with the previous one, skip the positions already checked
+		size_t j = i + 32 <= ncand ? i : ncand - 32;
+		__m256i eq_first = _mm256_cmpeq_epi8(first, avx2_load<icase>(h + j));
+		__m256i eq_last = _mm256_cmpeq_epi8(last, avx2_load<icase>(h + j + nlen - 1));
+		uint64_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(eq_first, eq_last));
+		res = verify<icase>(h, j, mask >> (i - j) << (i - j), n, nlen);
+	}
+	return res;
+}
+
+#endif // STRSEARCH_X86
+
+///////////////////////////////////////////////////////////////////////////////
+// ARM kernels
+///////////////////////////////////////////////////////////////////////////////
+#ifdef STRSEARCH_NEON
+
+template<bool icase>
+static inline uint8x16_t neon_load(const char* p)
+{
+	uint8x16_t v = vld1q_u8((const uint8_t*)p);
+	if(icase)
+	{
+		uint8x16_t upper = vcleq_u8(vsubq_u8(v, vdupq_n_u8('A')), vdupq_n_u8(25));
+		v = vorrq_u8(v, vandq_u8(upper, vdupq_n_u8(0x20)));
+	}
+	return v;
+}
+
+template<bool icase>
+static const char* find_neon(const char* h, size_t hlen, const char* n, size_t nlen)
+{
+	size_t ncand = hlen - nlen + 1;
+	if(nlen < 2 || nlen > hlen || ncand < 16)
+	{
+		return icase ? ifind_scalar(h, hlen, n, nlen) : find_scalar(h, hlen, n, nlen);
+	}
+
+	const uint8x16_t first = vdupq_n_u8(icase ? ascii_lower(n[0]) : n[0]);
+	const uint8x16_t last = vdupq_n_u8(icase ? ascii_lower(n[nlen - 1]) : n[nlen - 1]);
+	size_t i = 0;
+	for(; i < ncand; i += 16)
+	{
+		// the last block overlaps with the previous one, skip the positions already checked
+		size_t j = i + 16 <= ncand ? i : ncand - 16;
+		uint8x16_t eq = vandq_u8(vceqq_u8(first, neon_load<icase>(h + j)),
+					 vceqq_u8(last, neon_load<icase>(h + j + nlen - 1)));
+		// 4 bits for every byte of the block
+		uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+		mask = mask >> (4 * (i - j)) << (4 * (i - j));
+		while(mask != 0)
+		{
+			size_t pos = j + (__builtin_ctzll(mask) >> 2);
+			if(icase ? ascii_iequal(h + pos + 1, n + 1, nlen - 2) : equal(h + pos + 1, n + 1, nlen - 2))
+			{
+				return h + pos;
+			}
+			mask &= ~(0xfull << (__builtin_ctzll(mask) & ~3));
+		}
+	}
+	return NULL;
+}
+
+#endif // STRSEARCH_NEON
+
+///////////////////////////////////////////////////////////////////////////////
+// Runtime dispatch
+///////////////////////////////////////////////////////////////////////////////
+
+static kernel detect_kernel()
+{
+#if defined(STRSEARCH_X86)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+	{
+		return kernel::AVX2;
+	}
+	return kernel::SSE2;
+#elif defined(STRSEARCH_NEON)
+	return kernel::NEON;
+#else
+	return kernel::SCALAR;
+#endif
+}
+
+static const char* find_resolve(const char* h, size_t hlen, const char* n, size_t nlen);
+static const char* ifind_resolve(const char* h, size_t hlen, const char* n, size_t nlen);
+
+// Start with resolvers that pick the kernel on first use, so that
+// no check is needed on the hot path afterwards
+static std::atomic<find_fn> s_find{find_resolve};
+static std::atomic<find_fn> s_ifind{ifind_resolve};
+static std::atomic<kernel> s_kernel{kernel::SCALAR};
+
+bool is_supported(kernel k)
+{
+	switch(k)
+	{
+	case kernel::SCALAR:
+		return true;
+#if defined(STRSEARCH_X86)
+	case kernel::SSE2:
+		return true;
+	case kernel::AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#elif defined(STRSEARCH_NEON)
+	case kernel::NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+bool set_kernel(kernel k)
+{
+	find_fn f = find_scalar;
+	find_fn fi = ifind_scalar;
+
+	if(!is_supported(k))
+	{
+		return false;
+	}
+
+	switch(k)
+	{
+#if defined(STRSEARCH_X86)
+	case kernel::SSE2:
+		f = find_sse2<false>;
+		fi = find_sse2<true>;
+		break;
+	case kernel::AVX2:
+		f = find_avx2<false>;
+		fi = find_avx2<true>;
+		break;
+#elif defined(STRSEARCH_NEON)
+	case kernel::NEON:
+		f = find_neon<false>;
+		fi = find_neon<true>;
+		break;
+#endif
+	default:
+		break;
+	}
+
+	s_kernel.store(k, std::memory_order_relaxed);
+	s_find.store(f, std::memory_order_relaxed);
+	s_ifind.store(fi, std::memory_order_relaxed);
+	return true;
+}
+
+kernel get_kernel()
+{
+	if(s_find.load(std::memory_order_relaxed) == find_resolve)
+	{
+		set_kernel(detect_kernel());
+	}
+	return s_kernel.load(std::memory_order_relaxed);
+}
+
+static const char* find_resolve(const char* h, size_t hlen, const char* n, size_t nlen)
+{
+	get_kernel();
+	return s_find.load(std::memory_order_relaxed)(h, hlen, n, nlen);
+}
+
+static const char* ifind_resolve(const char* h, size_t hlen, const char* n, size_t nlen)
+{
+	get_kernel();
+	return s_ifind.load(std::memory_order_relaxed)(h, hlen, n, nlen);
+}
+
+const char* find(const char* haystack, size_t haystack_len, const char* needle, size_t needle_len)
+{
+	return s_find.load(std::memory_order_relaxed)(haystack, haystack_len, needle, needle_len);
+}
+
+const char* ifind(const char* haystack, size_t haystack_len, const char* needle, size_t needle_len)
+{
+	return s_ifind.load(std::memory_order_relaxed)(haystack, haystack_len, needle, needle_len);
+}
+
+const char* to_string(kernel k)
+{
+	switch(k)
+	{
+	case kernel::SCALAR:
+		return "scalar";
+	case kernel::SSE2:
+		return "sse2";
+	case kernel::AVX2:
+		return "avx2";
+	case kernel::NEON:
+		return "neon";
+	}
+	return "<unknown>";
+}
+
+} // strsearch
+} // libsinsp
@@ -0,0 +1,68 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+namespace libsinsp {
+namespace strsearch {
+
+/**
+ * @brief The implementations of the search functions. The best one
+ * supported by the CPU is chosen the first time a search is performed.
+ */
+enum class kernel
+{
+	SCALAR = 0,
+	SSE2 = 1,
+	AVX2 = 2,
+	NEON = 3,
+};
+
+/**
+ * @brief Returns a pointer to the first occurrence of the needle in
+ * the haystack, or NULL if there is none. An empty needle is found at
+ * the beginning of the haystack. Neither buffer needs to be NUL-terminated.
+ */
+const char* find(const char* haystack, size_t haystack_len, const char* needle, size_t needle_len);
+
+/**
+ * @brief Same as find(), but ASCII letters are compared ignoring their case.
+ */
+const char* ifind(const char* haystack, size_t haystack_len, const char* needle, size_t needle_len);
+
+/**
+ * @brief Returns the kernel used by find() and ifind().
+ */
+kernel get_kernel();
+
+/**
+ * @brief Returns true if the kernel can be used on this CPU.
+ */
+bool is_supported(kernel k);
+
+/**
+ * @brief Forces the kernel used by find() and ifind(), mostly useful for
+ * testing and benchmarking. Returns false if the kernel is not supported.
+ */
+bool set_kernel(kernel k);
+
+const char* to_string(kernel k);
+
+} // strsearch
+} // libsinsp
@@ -0,0 +1,187 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#else
+#include <winsock2.h>
+#endif
+
+#include "subnet_search.h"
+
+#include <string.h>
+
+static inline uint32_t addr_bit(const uint8_t* addr, uint32_t i)
+{
+	return (addr[i / 8] >> (7 - (i % 8))) & 1;
+}
+
+// Number of leading bits, up to max_len, that a and b have in common
+static uint32_t common_prefix_len(const uint8_t* a, const uint8_t* b, uint32_t max_len)
+{
+	uint32_t len = 0;
+	while(len + 8 <= max_len && a[len / 8] == b[len / 8])
+	{
+		len += 8;
+	}
+	while(len < max_len && addr_bit(a, len) == addr_bit(b, len))
+	{
+		len++;
+	}
+	return len;
+}
+
+uint32_t subnet_search::new_node(std::vector<node>& trie, const uint8_t* addr, uint32_t len, int64_t value)
+{
+	node n;
+	memcpy(n.m_prefix, addr, (len + 7) / 8);
+	if(len % 8 != 0)
+	{
+		n.m_prefix[len / 8] &= (uint8_t)(0xff << (8 - (len % 8)));
+	}
+	n.m_len = len;
+	n.m_value = value;
+	trie.push_back(n);
+	return trie.size() - 1;
+}
+
+void subnet_search::insert(std::vector<node>& trie, const uint8_t* addr, uint32_t prefix_len, uint32_t value)
+{
+	if(trie.empty())
+	{
+		new_node(trie, addr, 0, -1);
+	}
+
+	uint32_t cur = 0;
+	while(trie[cur].m_len < prefix_len)
+	{
+		uint32_t bit = addr_bit(addr, trie[cur].m_len);
+		uint32_t child = trie[cur].m_child[bit];
+		if(child == 0)
+		{
+			uint32_t leaf = new_node(trie, addr, prefix_len, value);
+			trie[cur].m_child[bit] = leaf;
+			return;
+		}
+
+		uint32_t child_len = trie[child].m_len;
+		uint32_t common = common_prefix_len(addr, trie[child].m_prefix,
+						    prefix_len < child_len ? prefix_len : child_len);
+		if(common == child_len)
+		{
+			cur = child;
+			continue;
+		}
+
+		// The new subnet diverges from the child (or contains it): put
+		// a node at the divergence point, between cur and the child
+		uint32_t split = new_node(trie, addr, common, common == prefix_len ? (int64_t)value : -1);
+		trie[split].m_child[addr_bit(trie[child].m_prefix, common)] = child;
+		if(common < prefix_len)
+		{
+			uint32_t leaf = new_node(trie, addr, prefix_len, value);
+			trie[split].m_child[addr_bit(addr, common)] = leaf;
+		}
+		trie[cur].m_child[bit] = split;
+		return;
+	}
+
+	if(trie[cur].m_value < 0 || value < trie[cur].m_value)
+	{
+		trie[cur].m_value = value;
+	}
+}
+
+int64_t subnet_search::lookup(const std::vector<node>& trie, const uint8_t* addr, uint32_t nbits)
+{
+	if(trie.empty())
+	{
+		return -1;
+	}
+
+	// every node on the path is a subnet containing the address
+	int64_t res = trie[0].m_value;
+	uint32_t cur = 0;
+	while(trie[cur].m_len < nbits)
+	{
+		cur = trie[cur].m_child[addr_bit(addr, trie[cur].m_len)];
+		if(cur == 0 ||
+		   common_prefix_len(addr, trie[cur].m_prefix, trie[cur].m_len) != trie[cur].m_len)
+		{
+			break;
+		}
+		if(trie[cur].m_value >= 0 && (res < 0 || trie[cur].m_value < res))
+		{
+			res = trie[cur].m_value;
+		}
+	}
+	return res;
+}
+
+void subnet_search::add(const ipv4net& net, uint32_t value)
+{
+	uint32_t mask = ntohl(net.m_netmask);
+	uint32_t prefix_len = 0;
+	while(prefix_len < 32 && (mask & (1u << (31 - prefix_len))))
+	{
+		prefix_len++;
+	}
+
+	if(prefix_len < 32 && (mask << prefix_len) != 0)
+	{
+		m_ipv4_noncontiguous.emplace_back(net, value);
+		return;
+	}
+
+	insert(m_ipv4, (const uint8_t*)&net.m_ip, prefix_len, value);
+}
+
+void subnet_search::add(const ipv6addr& addr, uint32_t prefix_len, uint32_t value)
+{
+	insert(m_ipv6, (const uint8_t*)addr.m_b, prefix_len > 128 ? 128 : prefix_len, value);
+}
+
+void subnet_search::add(const ipv6net& net, uint32_t value)
+{
+	add(net.addr(), net.prefix_len(), value);
+}
+
+int64_t subnet_search::find(uint32_t addr) const
+{
+	int64_t res = lookup(m_ipv4, (const uint8_t*)&addr, 32);
+	for(const auto& net : m_ipv4_noncontiguous)
+	{
+		if((addr & net.first.m_netmask) == (net.first.m_ip & net.first.m_netmask) &&
+		   (res < 0 || net.second < res))
+		{
+			res = net.second;
+		}
+	}
+	return res;
+}
+
+int64_t subnet_search::find(const ipv6addr& addr) const
+{
+	return lookup(m_ipv6, (const uint8_t*)addr.m_b, 128);
+}
+
+void subnet_search::clear()
+{
+	m_ipv4.clear();
+	m_ipv6.clear();
+	m_ipv4_noncontiguous.clear();
+}
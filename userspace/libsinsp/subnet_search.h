@@ -0,0 +1,93 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "tuples.h"
+
+//
+// A set of IPv4 and IPv6 subnets that an address can be tested against in
+// time proportional to the prefix length, instead of the number of subnets.
+//
+// The subnets are stored in a path-compressed binary (radix) trie per
+// address family, walked from the most significant bit of the address.
+// Chains of nodes with a single child are collapsed into one node holding
+// the whole prefix, so N subnets need at most 2N nodes and a lookup visits
+// at most one node per subnet containing the address, plus one for the
+// branching. Every subnet carries a value,
+// and a lookup returns the smallest value among the subnets containing the
+// address, so that callers can keep the "first match wins" order of a
+// linear scan by using the position of the subnet as its value.
+//
+// Addresses and IPv4 netmasks are in network byte order, as in the rest of
+// sinsp. IPv4 netmasks that are not contiguous can't be stored in the trie
+// and are checked one by one.
+//
+class subnet_search
+{
+public:
+	void add(const ipv4net& net, uint32_t value = 0);
+	void add(const ipv6addr& addr, uint32_t prefix_len, uint32_t value = 0);
+	void add(const ipv6net& net, uint32_t value = 0);
+
+	// Return the smallest value of the subnets containing addr, or -1
+	int64_t find(uint32_t addr) const;
+	int64_t find(const ipv6addr& addr) const;
+
+	inline bool match(uint32_t addr) const
+	{
+		return find(addr) >= 0;
+	}
+
+	inline bool match(const ipv6addr& addr) const
+	{
+		return find(addr) >= 0;
+	}
+
+	void clear();
+
+	inline bool empty() const
+	{
+		return m_ipv4.empty() && m_ipv6.empty() && m_ipv4_noncontiguous.empty();
+	}
+
+private:
+	struct node
+	{
+		// the first m_len bits are the prefix of the node, the other
+		// bits are zero
+		uint8_t m_prefix[16] = {};
+		uint32_t m_len = 0;
+		// 0 means no child, as the root is never a child
+		uint32_t m_child[2] = {0, 0};
+		int64_t m_value = -1;
+	};
+
+	static uint32_t new_node(std::vector<node>& trie, const uint8_t* addr, uint32_t len, int64_t value);
+
+	static void insert(std::vector<node>& trie, const uint8_t* addr, uint32_t prefix_len, uint32_t value);
+	static int64_t lookup(const std::vector<node>& trie, const uint8_t* addr, uint32_t nbits);
+
+	std::vector<node> m_ipv4;
+	std::vector<node> m_ipv6;
+	std::vector<std::pair<ipv4net, uint32_t>> m_ipv4_noncontiguous;
+};
@@ -0,0 +1,165 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+//
+// The state tables whose memory is accounted (see sinsp::get_memory_stats)
+//
+enum sinsp_state_table
+{
+	SINSP_TABLE_THREADS = 0,
+	SINSP_TABLE_FDS = 1,
+	SINSP_TABLE_CONTAINERS = 2,
+	SINSP_TABLE_USERS = 3,
+	SINSP_TABLE_DNS = 4,
+	SINSP_TABLE_MAX = 5,
+};
+
+// Approximate memory used by the entries of a state table, maintained by
+// the table itself on every insertion and removal. Each entry is counted
+// for the size of its structure plus the heap memory of the strings and
+// containers it owns, estimated when it is inserted; the overhead of the
+// allocator and of the table holding the entries is not counted.
+//
+// A budget can be set: once the accounted bytes reach it, the table
+// refuses the new entries and counts them as dropped, like it does when
+// it's full, unless it can evict some cold entries to make room (see
+// sinsp::set_state_eviction). The updates come from a single thread, or
+// under the lock of the table, and the values can be read from any other
+// thread.
+class sinsp_table_memory
+{
+public:
+	// Heap allocation overhead of a node of a std::map or std::set, and
+	// of an std::unordered_map entry
+	static const uint64_t TREE_NODE_BYTES = 4 * sizeof(void*);
+	static const uint64_t HASH_NODE_BYTES = 2 * sizeof(void*);
+
+	sinsp_table_memory():
+		m_bytes(0),
+		m_entries(0),
+		m_budget(0),
+		m_budget_drops(0),
+		m_evictions(0)
+	{
+	}
+
+	sinsp_table_memory(const sinsp_table_memory&) = delete;
+	sinsp_table_memory& operator=(const sinsp_table_memory&) = delete;
+
+	//
+	// Heap memory of a string, nothing for the ones stored inline. The
+	// length is used rather than the capacity, so that two copies of a
+	// string count the same.
+	//
+	static inline uint64_t string_bytes(const std::string& s)
+	{
+		return s.size() < sizeof(std::string) ? 0 : s.size() + 1;
+	}
+
+	inline void add(uint64_t bytes, uint64_t entries = 1)
+	{
+		m_bytes.store(m_bytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+		m_entries.store(m_entries.load(std::memory_order_relaxed) + entries, std::memory_order_relaxed);
+	}
+
+	inline void remove(uint64_t bytes, uint64_t entries = 1)
+	{
+		// The estimates of a table can't go negative, but clamp them
+		// anyway rather than wrapping around if a removal is counted
+		// twice
+		uint64_t cur = m_bytes.load(std::memory_order_relaxed);
+		m_bytes.store(cur > bytes ? cur - bytes : 0, std::memory_order_relaxed);
+		cur = m_entries.load(std::memory_order_relaxed);
+		m_entries.store(cur > entries ? cur - entries : 0, std::memory_order_relaxed);
+	}
+
+	//
+	// Forget all the entries, keeping the budget and the counters
+	//
+	inline void clear()
+	{
+		m_bytes.store(0, std::memory_order_relaxed);
+		m_entries.store(0, std::memory_order_relaxed);
+	}
+
+	//
+	// Whether a new entry must be refused. The caller counts it with
+	// add_budget_drop() when it actually drops it.
+	//
+	inline bool over_budget() const
+	{
+		uint64_t budget = m_budget.load(std::memory_order_relaxed);
+		return budget != 0 && m_bytes.load(std::memory_order_relaxed) >= budget;
+	}
+
+	inline void add_budget_drop()
+	{
+		m_budget_drops.store(m_budget_drops.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	inline void add_evictions(uint64_t entries)
+	{
+		m_evictions.store(m_evictions.load(std::memory_order_relaxed) + entries, std::memory_order_relaxed);
+	}
+
+	//
+	// 0 disables the budget. The entries already in the table are kept
+	// when it's lowered under the bytes they use.
+	//
+	inline void set_budget(uint64_t bytes)
+	{
+		m_budget.store(bytes, std::memory_order_relaxed);
+	}
+
+	inline uint64_t get_bytes() const
+	{
+		return m_bytes.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t get_entries() const
+	{
+		return m_entries.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t get_budget() const
+	{
+		return m_budget.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t get_budget_drops() const
+	{
+		return m_budget_drops.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t get_evictions() const
+	{
+		return m_evictions.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<uint64_t> m_bytes;
+	std::atomic<uint64_t> m_entries;
+	std::atomic<uint64_t> m_budget;
+	std::atomic<uint64_t> m_budget_drops;
+	std::atomic<uint64_t> m_evictions;
+};
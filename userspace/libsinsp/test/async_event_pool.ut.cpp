@@ -0,0 +1,89 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include <string>
+
+#include "async_event_pool.h"
+#include "event.h"
+#include <gtest/gtest.h>
+
+TEST(async_event_pool, encode)
+{
+	async_event_pool pool;
+	std::string error;
+	std::string container_id = "abcdef012345";
+
+	auto evt = pool.encode(error, PPME_USER_ADDED_E, 1234, -1,
+			       (uint32_t)1000, (uint32_t)100, "user", "/home/user", (const char*)nullptr, container_id);
+	ASSERT_NE(evt, nullptr) << error;
+	EXPECT_EQ(evt->get_type(), PPME_USER_ADDED_E);
+	EXPECT_EQ(evt->get_ts(), 1234);
+	EXPECT_EQ(evt->get_tid(), -1);
+	ASSERT_EQ(evt->get_num_params(), 6);
+	EXPECT_EQ(evt->get_param(0)->as<uint32_t>(), 1000);
+	EXPECT_EQ(evt->get_param(1)->as<uint32_t>(), 100);
+	EXPECT_STREQ(evt->get_param(2)->m_val, "user");
+	EXPECT_STREQ(evt->get_param(3)->m_val, "/home/user");
+	// the missing strings are decoded as "<NA>"
+	EXPECT_STREQ(evt->get_param(4)->m_val, "<NA>");
+	EXPECT_EQ(std::string(evt->get_param(5)->m_val), container_id);
+
+	// the integers must have the size of their parameter
+	EXPECT_EQ(pool.encode(error, PPME_USER_ADDED_E, 1234, -1, (uint64_t)1000), nullptr);
+	EXPECT_FALSE(error.empty());
+}
+
+TEST(async_event_pool, reuse)
+{
+	async_event_pool pool(1);
+	std::string error;
+	std::string big(1000, 'x');
+
+	auto evt = pool.encode(error, PPME_CONTAINER_JSON_2_E, 1, -1, big);
+	ASSERT_NE(evt, nullptr) << error;
+	sinsp_evt* first = evt.get();
+	evt.reset();
+	EXPECT_EQ(pool.get_num_cached(), 1);
+
+	// the released event is reused, with its storage
+	evt = pool.encode(error, PPME_CONTAINER_JSON_2_E, 2, -1, "{}");
+	ASSERT_NE(evt, nullptr) << error;
+	EXPECT_EQ(evt.get(), first);
+	EXPECT_EQ(evt->get_ts(), 2);
+	EXPECT_STREQ(evt->get_param(0)->m_val, "{}");
+
+	auto other = pool.encode(error, PPME_CONTAINER_JSON_2_E, 3, -1, big);
+	ASSERT_NE(other, nullptr) << error;
+	EXPECT_EQ(pool.get_num_allocated(), 2);
+
+	// only max_cached events are kept
+	evt.reset();
+	other.reset();
+	EXPECT_EQ(pool.get_num_cached(), 1);
+}
+
+TEST(async_event_pool, outlive_pool)
+{
+	std::shared_ptr<sinsp_evt> evt;
+	{
+		async_event_pool pool;
+		std::string error;
+		evt = pool.encode(error, PPME_GROUP_ADDED_E, 1, -1, (uint32_t)10, "group", "");
+		ASSERT_NE(evt, nullptr) << error;
+	}
+	EXPECT_STREQ(evt->get_param(1)->m_val, "group");
+	evt.reset();
+}
@@ -26,6 +26,7 @@ limitations under the License.
 #include <limits>
 #include <memory>
 #include <thread>
+#include <vector>
 namespace
 {
 
@@ -65,6 +66,10 @@ public:
 
 		while(dequeue_next_key(key, &res))
 		{
+			{
+				std::lock_guard<std::mutex> guard(m_served_mutex);
+				m_served.push_back(key);
+			}
 			if(m_delay_ms > 0)
 			{
 				std::this_thread::sleep_for(std::chrono::milliseconds(m_delay_ms));
@@ -85,7 +90,15 @@ public:
 		}
 	}
 
+	std::vector<std::string> served()
+	{
+		std::lock_guard<std::mutex> guard(m_served_mutex);
+		return m_served;
+	}
+
 protected:
+	std::mutex m_served_mutex;
+	std::vector<std::string> m_served;
 	uint64_t m_delay_ms;
 	short m_num_failures;
 	short m_backoff_ms;
@@ -200,4 +213,74 @@ TEST(async_key_value_source_test, async_ttl_expired)
 	ASSERT_FALSE(t.next_key(key));
 }
 
+TEST(async_key_value_source_test, coalesce)
+{
+	test_key_value_source t(50, 0);
+	result res;
+
+	ASSERT_FALSE(t.lookup("1", res));
+	ASSERT_FALSE(t.lookup("1", res));
+	while(!t.lookup("1", res))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	ASSERT_EQ(1, res.val);
+
+	auto stats = t.get_stats();
+	ASSERT_EQ(1, stats.m_n_requests);
+	ASSERT_LE(2, stats.m_n_coalesced);
+	ASSERT_EQ(1, stats.m_queue_depth[1]);
+	ASSERT_EQ(1, t.served().size());
+}
+
+TEST(async_key_value_source_test, workers)
+{
+	test_key_value_source t(200, 0);
+	t.set_num_workers(4);
+	std::condition_variable cv;
+	std::mutex cv_m;
+	int done = 0;
+
+	for(const char* key : {"1", "2", "3", "4"})
+	{
+		result res;
+		t.lookup(key, res, [&cv, &cv_m, &done](const std::string& key, const result& res)
+			 {
+				std::lock_guard<std::mutex> lk(cv_m);
+				done++;
+				cv.notify_all(); });
+	}
+
+	// Served one after the other, the lookups would take 800ms
+	std::unique_lock<std::mutex> lk(cv_m);
+	if(!cv.wait_for(lk, std::chrono::milliseconds(600), [&done]()
+			{ return done == 4; }))
+		FAIL() << "Timeout expired while waiting for results";
+}
+
+TEST(async_key_value_source_test, prioritize)
+{
+	test_key_value_source t(100, 0);
+	result res;
+
+	// Keep the thread busy while the other keys are queued
+	t.lookup("0", res);
+	while(t.served().empty())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	t.lookup("1", res);
+	t.lookup("2", res);
+	t.lookup("3", res);
+	t.prioritize("3");
+
+	while(!t.lookup("2", res))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	std::vector<std::string> expected = {"0", "3", "1", "2"};
+	ASSERT_EQ(expected, t.served());
+}
+
 } // namespace
@@ -0,0 +1,648 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// Benchmarks of the libsinsp hot paths. Synthetic event streams are
+// replayed through the test input engine, the same way the unit tests do
+// with sinsp_with_test_input, so that no capture file or driver is needed.
+//
+// Usage: bench-libsinsp [--filter <substring>] [--thresholds <file>]
+//
+// Each benchmark prints its rate in operations per second. The thresholds
+// file has one "<benchmark name> <minimum ops/s>" line per benchmark
+// ('#' starts a comment); when given, the program exits with an error if
+// any benchmark runs slower than its minimum.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "sinsp_with_test_input.h"
+#include "eventformatter.h"
+#include "filter/parser.h"
+
+// Exposes the helpers of the unit test fixture outside of gtest
+class bench_input: public sinsp_with_test_input
+{
+public:
+	bench_input() { SetUp(); }
+	~bench_input() { TearDown(); }
+	void TestBody() override { }
+
+	using sinsp_with_test_input::m_inspector;
+	using sinsp_with_test_input::open_inspector;
+	using sinsp_with_test_input::add_event;
+	using sinsp_with_test_input::add_event_advance_ts;
+	using sinsp_with_test_input::add_thread;
+	using sinsp_with_test_input::create_threadinfo;
+	using sinsp_with_test_input::add_default_init_thread;
+	using sinsp_with_test_input::increasing_ts;
+	using sinsp_with_test_input::next_event;
+};
+
+struct bench_result
+{
+	std::string m_name;
+	double m_rate;
+};
+
+static std::vector<bench_result> s_results;
+static std::string s_filter;
+
+static bool selected(const std::string& name)
+{
+	return s_filter.empty() || name.find(s_filter) != std::string::npos;
+}
+
+static void report(const std::string& name, std::chrono::steady_clock::time_point start, uint64_t ops)
+{
+	double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	double rate = ops * 1e9 / ns;
+	printf("%-32s %14.0f ops/s %10.1f ns/op\n", name.c_str(), rate, ns / ops);
+	s_results.push_back({name, rate});
+}
+
+// Times the full consumption of the stream added by gen, with next()
+static void bench_stream(const std::string& name, uint32_t nthreads, const std::function<void(bench_input&, uint64_t n)>& gen, uint64_t n)
+{
+	if(!selected(name))
+	{
+		return;
+	}
+
+	bench_input in;
+	in.add_default_init_thread();
+	for(uint32_t j = 0; j < nthreads; j++)
+	{
+		int64_t tid = 100 + j;
+		in.add_thread(in.create_threadinfo(tid, tid, 1, tid, tid, tid, "bench", "/usr/bin/bench", "/usr/bin/bench",
+			in.increasing_ts(), 0, 0), {});
+	}
+	gen(in, n);
+	in.open_inspector();
+
+	uint64_t nevts = 0;
+	auto start = std::chrono::steady_clock::now();
+	while(in.next_event() != nullptr)
+	{
+		nevts++;
+	}
+	report(name, start, nevts);
+}
+
+// Times the full consumption of the default mix of the synthetic engine,
+// parsing included, without preparing the events upfront
+static void bench_synthetic(uint64_t n)
+{
+	const std::string name = "next.synthetic";
+	if(!selected(name))
+	{
+		return;
+	}
+
+	scap_synthetic_engine_params params = {};
+	params.seed = 1;
+	params.max_events = n;
+
+	sinsp inspector;
+	inspector.open_synthetic(params);
+
+	uint64_t nevts = 0;
+	sinsp_evt* evt = nullptr;
+	auto start = std::chrono::steady_clock::now();
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		nevts++;
+	}
+	report(name, start, nevts);
+	inspector.close();
+}
+
+static void gen_open_close(bench_input& in, uint64_t n)
+{
+	for(uint64_t j = 0; j < n / 4; j++)
+	{
+		uint64_t tid = 100 + j % 16;
+		int64_t fd = 3 + j % 64;
+		std::string path = "/tmp/bench/file_" + std::to_string(j % 1024);
+		in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_OPEN_E, 3, path.c_str(), PPM_O_RDWR, 0);
+		in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_OPEN_X, 6, fd, path.c_str(), PPM_O_RDWR, 0, 5, (uint64_t)j);
+		in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_CLOSE_E, 1, fd);
+		in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	}
+}
+
+// openat of relative names, that the parser joins with the cwd
+static void gen_openat_relative(bench_input& in, uint64_t n)
+{
+	static const char* names[] = {"conf/app.yaml", "../lib/./libbench.so", "logs//bench.log", "./a/../b/c"};
+	for(uint64_t j = 0; j < n / 4; j++)
+	{
+		uint64_t tid = 100 + j % 16;
+		int64_t fd = 3 + j % 64;
+		const char* name = names[j % 4];
+		in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_OPENAT_2_E, 4, (int64_t)PPM_AT_FDCWD, name, PPM_O_RDONLY, 0);
+		in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_OPENAT_2_X, 7, fd, (int64_t)PPM_AT_FDCWD, name, PPM_O_RDONLY, 0, 5, (uint64_t)j);
+		in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_CLOSE_E, 1, fd);
+		in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	}
+}
+
+static void gen_read(bench_input& in, uint64_t n)
+{
+	static const char data[] = "some data read from the file";
+	for(uint64_t j = 0; j < n / 2; j++)
+	{
+		// fd 0 of init is /dev/null
+		in.add_event(in.increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)0, (uint32_t)sizeof(data));
+		in.add_event(in.increasing_ts(), 1, PPME_SYSCALL_READ_X, 2, (int64_t)sizeof(data), scap_const_sized_buffer{data, sizeof(data)});
+	}
+}
+
+static void gen_mixed(bench_input& in, uint64_t n)
+{
+	static const char data[] = "some data";
+	for(uint64_t j = 0; j < n / 8; j++)
+	{
+		uint64_t tid = 100 + j % 16;
+		int64_t fd = 3 + j % 64;
+		std::string path = "/etc/bench/conf_" + std::to_string(j % 256);
+		in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_OPEN_E, 3, path.c_str(), PPM_O_RDONLY, 0);
+		in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_OPEN_X, 6, fd, path.c_str(), PPM_O_RDONLY, 0, 5, (uint64_t)j);
+		for(int r = 0; r < 2; r++)
+		{
+			in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_READ_E, 2, fd, (uint32_t)sizeof(data));
+			in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_READ_X, 2, (int64_t)sizeof(data), scap_const_sized_buffer{data, sizeof(data)});
+		}
+		in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_CLOSE_E, 1, fd);
+		in.add_event(in.increasing_ts(), tid, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	}
+}
+
+// Returns an open exit event, valid until the next call to next_event()
+static sinsp_evt* open_event(bench_input& in)
+{
+	in.add_default_init_thread();
+	in.open_inspector();
+	in.add_event_advance_ts(in.increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/etc/passwd", PPM_O_RDONLY, 0);
+	return in.add_event_advance_ts(in.increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (int64_t)3, "/etc/passwd", PPM_O_RDONLY, 0, 5, (uint64_t)123);
+}
+
+static void bench_filters(uint64_t n)
+{
+	static const std::vector<std::pair<std::string, std::string>> shapes = {
+		{"filter.cmp", "evt.type=open"},
+		{"filter.startswith", "fd.name startswith /etc/"},
+		{"filter.in_list", "proc.name in (bash, sh, zsh, dash, ksh, csh, tcsh, fish, python, python3, perl, ruby, node, java, nc, ncat, socat, curl, wget, init)"},
+		{"filter.glob", "fd.name glob '/etc/*wd'"},
+		{"filter.and_or_not", "evt.type=open and (fd.name contains shadow or proc.name=init) and not evt.dir=>"},
+	};
+
+	for(const auto& shape : shapes)
+	{
+		if(!selected(shape.first))
+		{
+			continue;
+		}
+
+		bench_input in;
+		sinsp_evt* evt = open_event(in);
+		sinsp_filter_compiler compiler(&in.m_inspector, shape.second);
+		std::unique_ptr<sinsp_filter> filter(compiler.compile());
+
+		uint64_t matched = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(uint64_t j = 0; j < n; j++)
+		{
+			matched += filter->run(evt);
+		}
+		report(shape.first, start, n);
+		if(matched != n)
+		{
+			fprintf(stderr, "%s: the filter didn't match the event\n", shape.first.c_str());
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+// Conditions shaped like the ones of a large ruleset once its macros and
+// lists are expanded
+static std::vector<std::string> gen_ruleset(uint64_t n)
+{
+	static const std::vector<std::string> shapes = {
+		"(evt.type in (open, openat, openat2) and evt.is_open_write=true and fd.typechar='f' and fd.num>=0) and (fd.name startswith /etc/%) and not proc.name in (dpkg, rpm, yum, apt, apt-get, %_installer) and not (container.image.repository = docker.io/library/%)",
+		"evt.type in (execve, execveat) and evt.dir=< and (proc.name in (bash, sh, zsh, dash, ksh, %sh) or proc.pname = %) and container.id != host and not user.name in (root, %_user) and proc.args contains \"-c %\"",
+		"(evt.type=connect and evt.dir=< and (fd.typechar=4 or fd.typechar=6)) and fd.sport != 0 and not fd.snet in (\"10.0.0.0/8\", \"172.16.0.0/12\", \"192.168.0.0/16\") and proc.name = % and fd.sport in (22, 443, 8080)",
+		"not (proc.aname[2] = % or proc.aname[3] in (systemd, containerd-shim, runc)) and evt.type = setuid and evt.dir=> and evt.arg.uid = 0 and thread.cap_effective icontains %",
+		"(fd.name glob '/proc/*/%' or fd.directory = /var/run/%) and evt.rawres >= 0 and evt.num > 16 and proc.vpid != 1 and container.name exists and proc.cmdline contains '%'",
+	};
+
+	std::vector<std::string> rules;
+	for(uint64_t j = 0; j < n; j++)
+	{
+		std::string rule = shapes[j % shapes.size()];
+		std::string id = "r" + std::to_string(j);
+		for(size_t pos = rule.find('%'); pos != std::string::npos; pos = rule.find('%', pos + id.size()))
+		{
+			rule.replace(pos, 1, id);
+		}
+		rules.push_back(rule);
+	}
+	return rules;
+}
+
+static void bench_filter_compilation(uint64_t n)
+{
+	std::vector<std::string> rules = gen_ruleset(n);
+
+	if(selected("compile.parse"))
+	{
+		size_t nodes = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(const auto& rule : rules)
+		{
+			libsinsp::filter::parser p(rule);
+			nodes += p.parse() != nullptr;
+		}
+		report("compile.parse", start, nodes);
+	}
+
+	if(selected("compile.filters"))
+	{
+		bench_input in;
+		in.add_default_init_thread();
+		in.open_inspector();
+
+		uint64_t compiled = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(const auto& rule : rules)
+		{
+			sinsp_filter_compiler compiler(&in.m_inspector, rule);
+			std::unique_ptr<sinsp_filter> filter(compiler.compile());
+			compiled += filter != nullptr;
+		}
+		report("compile.filters", start, compiled);
+	}
+}
+
+static void bench_formatters(uint64_t n)
+{
+	static const std::vector<std::pair<std::string, std::string>> formats = {
+		{"format.default", "*%evt.num %evt.outputtime %evt.cpu %proc.name (%thread.tid) %evt.dir %evt.type %evt.info"},
+		{"format.fields", "user=%user.name command=%proc.cmdline file=%fd.name parent=%proc.pname"},
+	};
+
+	for(const auto& format : formats)
+	{
+		if(!selected(format.first))
+		{
+			continue;
+		}
+
+		bench_input in;
+		sinsp_evt* evt = open_event(in);
+		sinsp_evt_formatter formatter(&in.m_inspector, format.second);
+
+		std::string output;
+		auto start = std::chrono::steady_clock::now();
+		for(uint64_t j = 0; j < n; j++)
+		{
+			formatter.tostring(evt, &output);
+		}
+		report(format.first, start, n);
+	}
+}
+
+static void bench_paths(uint64_t n)
+{
+	static const std::vector<std::pair<std::string, std::pair<std::string, std::string>>> cases = {
+		{"paths.relative", {"/home/bench/project/", "src/main.c"}},
+		{"paths.dotdot", {"/home/bench/project/", "../../lib/./x/../libbench.so"}},
+		{"paths.slashes", {"/home//bench/", "logs//2023///bench.log"}},
+		{"paths.absolute", {"/home/bench/project/", "/usr/lib/../lib64/libc.so.6"}},
+	};
+
+	char target[SCAP_MAX_PATH_SIZE];
+	for(const auto& c : cases)
+	{
+		if(!selected(c.first))
+		{
+			continue;
+		}
+
+		const std::string& dir = c.second.first;
+		const std::string& name = c.second.second;
+		uint64_t len = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(uint64_t j = 0; j < n; j++)
+		{
+			sinsp_utils::concatenate_paths(target, sizeof(target),
+				dir.c_str(), (uint32_t)dir.length(),
+				name.c_str(), (uint32_t)name.length());
+			len += strlen(target);
+		}
+		report(c.first, start, n);
+		if(len == 0)
+		{
+			fprintf(stderr, "%s: empty path\n", c.first.c_str());
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+// A container as reported by a Kubernetes node: the labels, mounts and
+// probes make up most of its JSON
+static void build_bench_container(sinsp_container_info& info)
+{
+	info.m_id = "3ad7b26ded6d";
+	info.m_full_id = "3ad7b26ded6d8e0d3d6a8c6f1d1b1e7c5d3e1f5a0e2f4d6b8a0c2e4f6a8b0c2d";
+	info.m_type = CT_CONTAINERD;
+	info.m_name = "k8s_nginx_nginx-5d8b9c4b7f-x2k9p_default_0b1c2d3e-4f5a-6b7c-8d9e-0f1a2b3c4d5e_0";
+	info.m_image = "docker.io/library/nginx:1.23.4";
+	info.m_imageid = "a7be6198544f09a75b26e6376459b47c5b9972e7aa742af9f356b540fe852cd4";
+	info.m_imagerepo = "docker.io/library/nginx";
+	info.m_imagetag = "1.23.4";
+	info.m_imagedigest = "sha256:f5747a42e3adcb3168049d63278d7251d91185bb5111d2563d58729a5c9179b0";
+	info.set_lookup_status(sinsp_container_lookup::state::SUCCESSFUL);
+	info.m_created_time = 1663770709;
+	info.m_container_ip = 0x0af40312;
+	info.m_memory_limit = 536870912;
+	info.m_cpu_shares = 256;
+	info.m_cpu_quota = 50000;
+	info.m_cpu_period = 100000;
+	for(int j = 0; j < 24; j++)
+	{
+		info.m_labels["io.kubernetes.label" + std::to_string(j)] = "value-" + std::to_string(j * 7919);
+	}
+	info.m_labels["io.kubernetes.pod.name"] = "nginx-5d8b9c4b7f-x2k9p";
+	info.m_labels["io.kubernetes.pod.namespace"] = "default";
+	for(int j = 0; j < 8; j++)
+	{
+		info.m_mounts.emplace_back("/var/lib/kubelet/pods/0b1c2d3e/volumes/kubernetes.io~secret/vol" + std::to_string(j),
+					   "/var/run/secrets/vol" + std::to_string(j), "ro", false, "rprivate");
+	}
+	info.m_health_probes.emplace_back(sinsp_container_info::container_health_probe::PT_LIVENESS_PROBE,
+					  "curl", std::vector<std::string>{"-f", "http://localhost:8080/healthz"});
+	info.m_health_probes.emplace_back(sinsp_container_info::container_health_probe::PT_READINESS_PROBE,
+					  "curl", std::vector<std::string>{"-f", "http://localhost:8080/ready"});
+	info.m_env.push_back("MESOS_TASK_ID=nginx.0b1c2d3e");
+}
+
+static void bench_container_json(uint64_t n)
+{
+	sinsp_container_info info;
+	build_bench_container(info);
+	std::string json;
+	sinsp_container_manager::container_to_json(info, json);
+
+	if(selected("container.to_json"))
+	{
+		uint64_t len = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(uint64_t j = 0; j < n; j++)
+		{
+			std::string out;
+			sinsp_container_manager::container_to_json(info, out);
+			len += out.length();
+		}
+		report("container.to_json", start, n);
+		if(len != json.length() * n)
+		{
+			fprintf(stderr, "container.to_json: unexpected length\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if(selected("container.from_json"))
+	{
+		std::string error;
+		auto start = std::chrono::steady_clock::now();
+		for(uint64_t j = 0; j < n; j++)
+		{
+			sinsp_container_info parsed;
+			if(!sinsp_container_manager::container_from_json(json.c_str(), json.length(), parsed, error) ||
+			   parsed.m_labels.size() != info.m_labels.size())
+			{
+				fprintf(stderr, "container.from_json: %s\n", error.c_str());
+				exit(EXIT_FAILURE);
+			}
+		}
+		report("container.from_json", start, n);
+	}
+}
+
+static void bench_thread_table(uint32_t nthreads, uint64_t nlookups, bool dense)
+{
+	std::string prefix = dense ? "threads.dense." : "threads.";
+	if(!selected(prefix))
+	{
+		return;
+	}
+
+	bench_input in;
+	in.add_default_init_thread();
+	in.m_inspector.set_dense_thread_table(dense);
+	in.open_inspector();
+	auto tm = in.m_inspector.m_thread_manager;
+
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t j = 0; j < nthreads; j++)
+	{
+		auto tinfo = tm->new_threadinfo();
+		tinfo->m_tid = 1000 + j;
+		tinfo->m_pid = 1000 + j;
+		tinfo->m_ptid = 1;
+		tinfo->m_comm = "bench";
+		tm->add_thread(tinfo.release(), false);
+	}
+	report(prefix + "add", start, nthreads);
+
+	std::mt19937 rng(1234);
+	std::vector<int64_t> tids(nlookups);
+	for(auto& tid : tids)
+	{
+		tid = 1000 + rng() % nthreads;
+	}
+
+	uint64_t found = 0;
+	start = std::chrono::steady_clock::now();
+	for(auto tid : tids)
+	{
+		found += tm->get_thread_ref(tid, false, true) != nullptr;
+	}
+	report(prefix + "lookup", start, nlookups);
+	if(found != nlookups)
+	{
+		fprintf(stderr, "%slookup: missing threads\n", prefix.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	uint64_t visited = 0;
+	start = std::chrono::steady_clock::now();
+	tm->get_threads()->const_loop([&visited](const sinsp_threadinfo&) { visited++; return true; });
+	report(prefix + "loop", start, visited);
+
+	start = std::chrono::steady_clock::now();
+	for(uint32_t j = 0; j < nthreads; j++)
+	{
+		tm->remove_thread(1000 + j, true);
+	}
+	report(prefix + "remove", start, nthreads);
+}
+
+//
+// Lookups of random fds reading the state the parsers use for every event
+// (type, flags, socket tuple), over fd tables too large for the cache
+//
+static void bench_fd_table(uint32_t ntables, uint32_t nfds, uint64_t nlookups)
+{
+	if(!selected("fds."))
+	{
+		return;
+	}
+
+	bench_input in;
+	std::vector<std::unique_ptr<sinsp_fdtable>> tables;
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t j = 0; j < ntables; j++)
+	{
+		tables.emplace_back(new sinsp_fdtable(&in.m_inspector));
+		sinsp_fdinfo_t fdi;
+		for(uint32_t fd = 0; fd < nfds; fd++)
+		{
+			fdi.m_type = fd % 2 ? SCAP_FD_IPV4_SOCK : SCAP_FD_FILE_V2;
+			fdi.m_name = "/tmp/bench/file";
+			tables.back()->add(fd, &fdi);
+		}
+	}
+	report("fds.add", start, (uint64_t)ntables * nfds);
+
+	std::mt19937 rng(1234);
+	std::vector<std::pair<uint32_t, int64_t>> lookups(nlookups);
+	uint64_t expected = 0;
+	for(auto& l : lookups)
+	{
+		l.first = rng() % ntables;
+		l.second = rng() % nfds;
+		expected += l.second % 2;
+	}
+
+	uint64_t sockets = 0;
+	start = std::chrono::steady_clock::now();
+	for(const auto& l : lookups)
+	{
+		sinsp_fdinfo_t* fdinfo = tables[l.first]->find(l.second);
+		if(fdinfo != nullptr && fdinfo->is_ipv4_socket() && !fdinfo->is_role_server())
+		{
+			sockets += fdinfo->m_sockinfo.m_ipv4info.m_fields.m_l4proto != SCAP_L4_TCP;
+		}
+	}
+	report("fds.lookup", start, nlookups);
+	if(sockets != expected)
+	{
+		fprintf(stderr, "fds.lookup: missing fds\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static bool check_thresholds(const std::string& path)
+{
+	std::ifstream f(path);
+	if(!f)
+	{
+		fprintf(stderr, "can't open thresholds file %s\n", path.c_str());
+		return false;
+	}
+
+	std::map<std::string, double> thresholds;
+	std::string line;
+	while(std::getline(f, line))
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream ss(line);
+		std::string name;
+		double min_rate;
+		if(ss >> name >> min_rate)
+		{
+			thresholds[name] = min_rate;
+		}
+	}
+
+	bool ok = true;
+	for(const auto& res : s_results)
+	{
+		auto it = thresholds.find(res.m_name);
+		if(it != thresholds.end() && res.m_rate < it->second)
+		{
+			fprintf(stderr, "REGRESSION %s: %.0f ops/s, expected at least %.0f\n",
+				res.m_name.c_str(), res.m_rate, it->second);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	std::string thresholds;
+	for(int j = 1; j < argc; j++)
+	{
+		if(!strcmp(argv[j], "--filter") && j + 1 < argc)
+		{
+			s_filter = argv[++j];
+		}
+		else if(!strcmp(argv[j], "--thresholds") && j + 1 < argc)
+		{
+			thresholds = argv[++j];
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--filter <substring>] [--thresholds <file>]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	bench_stream("next.mixed", 16, gen_mixed, 400000);
+	bench_synthetic(1000000);
+	bench_stream("parse.open_close", 16, gen_open_close, 200000);
+	bench_stream("parse.openat_relative", 16, gen_openat_relative, 200000);
+	bench_stream("parse.read", 0, gen_read, 200000);
+	bench_filters(2000000);
+	bench_filter_compilation(5000);
+	bench_formatters(200000);
+	bench_paths(2000000);
+	bench_container_json(50000);
+	bench_thread_table(20000, 1000000, false);
+	bench_thread_table(20000, 1000000, true);
+	bench_fd_table(2000, 64, 2000000);
+
+	if(!thresholds.empty() && !check_thresholds(thresholds))
+	{
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <fstream>
+#include <string>
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "cgroup_limits.h"
+
+using namespace libsinsp::cgroup_limits;
+
+// A fake cgroupfs in a temporary directory, with one directory per subsystem
+class cgroup_limits_cache_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		char tmpl[] = "/tmp/cgroup_limits_XXXXXX";
+		ASSERT_NE(mkdtemp(tmpl), nullptr);
+		m_root = tmpl;
+		for(const char* subsys : {"memory", "cpu", "cpuset"})
+		{
+			ASSERT_EQ(mkdir((m_root + "/" + subsys).c_str(), 0755), 0);
+			ASSERT_EQ(mkdir((m_root + "/" + subsys + "/ctr").c_str(), 0755), 0);
+		}
+		write("memory", "memory.limit_in_bytes", 1000);
+	}
+
+	void TearDown() override
+	{
+		std::string cmd = "rm -rf " + m_root;
+		ASSERT_EQ(system(cmd.c_str()), 0);
+	}
+
+	void write(const std::string& subsys, const std::string& filename, int64_t val)
+	{
+		std::ofstream out(m_root + "/" + subsys + "/ctr/" + filename);
+		out << val;
+	}
+
+	cgroup_limits_cache make_cache()
+	{
+		auto reader = [this](const cgroup_limits_key& key, cgroup_limits_value& value, bool name_check)
+		{
+			m_reads++;
+			std::ifstream in(m_root + "/memory/" + key.m_mem_cgroup + "/memory.limit_in_bytes");
+			in >> value.m_memory_limit;
+			return true;
+		};
+		auto root_lookup = [this](const std::string& subsys)
+		{
+			return std::make_shared<std::string>(m_root + "/" + subsys);
+		};
+		return cgroup_limits_cache(reader, root_lookup);
+	}
+
+	std::string m_root;
+	uint32_t m_reads = 0;
+};
+
+TEST_F(cgroup_limits_cache_test, invalidation)
+{
+	cgroup_limits_cache cache(make_cache());
+	cgroup_limits_key key("ctr", "ctr", "ctr", "ctr");
+	cgroup_limits_value value;
+
+	ASSERT_TRUE(cache.get(key, value));
+	ASSERT_EQ(value.m_memory_limit, 1000);
+	ASSERT_TRUE(cache.get(key, value));
+	ASSERT_EQ(value.m_memory_limit, 1000);
+	ASSERT_EQ(m_reads, 1);
+	ASSERT_EQ(cache.size(), 1);
+
+	// Other files of the cgroup don't invalidate the limits
+	write("memory", "cgroup.procs", 42);
+	ASSERT_TRUE(cache.get(key, value));
+	ASSERT_EQ(m_reads, 1);
+
+	write("memory", "memory.limit_in_bytes", 2000);
+	ASSERT_TRUE(cache.get(key, value));
+	ASSERT_EQ(value.m_memory_limit, 2000);
+	ASSERT_EQ(m_reads, 2);
+
+	write("cpu", "cpu.cfs_quota_us", 50000);
+	ASSERT_TRUE(cache.get(key, value));
+	ASSERT_EQ(m_reads, 3);
+
+	// The limits of removed cgroups are dropped
+	std::string cmd = "rm -rf " + m_root + "/cpuset/ctr";
+	ASSERT_EQ(system(cmd.c_str()), 0);
+	ASSERT_EQ(cache.size(), 0);
+}
+
+TEST_F(cgroup_limits_cache_test, missing_cgroup)
+{
+	cgroup_limits_cache cache(make_cache());
+	cgroup_limits_key key("ctr", "ctr", "ctr", "missing");
+	cgroup_limits_value value;
+
+	// Limits that can't be watched are read on every lookup
+	cache.get(key, value);
+	cache.get(key, value);
+	ASSERT_EQ(m_reads, 2);
+	ASSERT_EQ(cache.size(), 0);
+}
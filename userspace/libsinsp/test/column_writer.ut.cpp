@@ -0,0 +1,131 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <sstream>
+
+#include "sinsp_with_test_input.h"
+#include "column_writer.h"
+
+class column_reader
+{
+public:
+	column_reader(const std::string& data): m_data(data), m_pos(0) {}
+
+	uint32_t u32()
+	{
+		uint32_t v;
+		memcpy(&v, bytes(sizeof(v)), sizeof(v));
+		return v;
+	}
+
+	const char* bytes(size_t len)
+	{
+		EXPECT_LE(m_pos + len, m_data.size());
+		const char* res = m_data.data() + m_pos;
+		m_pos += len;
+		return res;
+	}
+
+	bool at_end()
+	{
+		return m_pos == m_data.size();
+	}
+
+private:
+	const std::string& m_data;
+	size_t m_pos;
+};
+
+TEST_F(sinsp_with_test_input, column_writer)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	std::stringstream out;
+	std::vector<std::string> fields = {"evt.num", "fd.name", "proc.pid"};
+	sinsp_evt_column_writer writer(&m_inspector, fields, out, 2);
+
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	writer.write(evt);
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (int64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	writer.write(evt);
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (int64_t)4, "/tmp/other", PPM_O_RDWR, 0, 5, (uint64_t)124);
+	writer.write(evt);
+	writer.close();
+	ASSERT_EQ(writer.get_n_rows(), 3);
+	ASSERT_THROW(writer.write(evt), sinsp_exception);
+
+	std::string data = out.str();
+	column_reader r(data);
+
+	ASSERT_EQ(std::string(r.bytes(4), 4), COLUMN_WRITER_MAGIC);
+	ASSERT_EQ(r.u32(), COLUMN_WRITER_VERSION);
+	ASSERT_EQ(r.u32(), 3);
+	std::vector<uint32_t> types = {PT_UINT64, PT_CHARBUF, PT_INT64};
+	for(uint32_t j = 0; j < fields.size(); j++)
+	{
+		ASSERT_EQ(r.u32(), types[j]);
+		uint32_t len = r.u32();
+		ASSERT_EQ(std::string(r.bytes(len), len), fields[j]);
+	}
+
+	// first batch: the open enter event has no fd
+	ASSERT_EQ(r.u32(), 2);
+	ASSERT_EQ(*r.bytes(1), 0x3);
+	uint64_t evtnums[2];
+	memcpy(evtnums, r.bytes(16), 16);
+	ASSERT_EQ(evtnums[0] + 1, evtnums[1]);
+	ASSERT_EQ(*r.bytes(1), 0x2);
+	uint32_t offsets[3];
+	memcpy(offsets, r.bytes(12), 12);
+	ASSERT_EQ(offsets[0], 0);
+	ASSERT_EQ(offsets[1], 0);
+	ASSERT_EQ(offsets[2], strlen("/tmp/the_file"));
+	ASSERT_EQ(std::string(r.bytes(offsets[2]), offsets[2]), "/tmp/the_file");
+	ASSERT_EQ(*r.bytes(1), 0x3);
+	int64_t pids[2];
+	memcpy(pids, r.bytes(16), 16);
+	ASSERT_EQ(pids[0], 1);
+	ASSERT_EQ(pids[1], 1);
+
+	// second batch
+	ASSERT_EQ(r.u32(), 1);
+	ASSERT_EQ(*r.bytes(1), 0x1);
+	uint64_t evtnum;
+	memcpy(&evtnum, r.bytes(8), 8);
+	ASSERT_EQ(evtnum, evtnums[1] + 1);
+	ASSERT_EQ(*r.bytes(1), 0x1);
+	memcpy(offsets, r.bytes(8), 8);
+	ASSERT_EQ(std::string(r.bytes(offsets[1]), offsets[1]), "/tmp/other");
+	ASSERT_EQ(*r.bytes(1), 0x1);
+	r.bytes(8);
+
+	// end of the stream
+	ASSERT_EQ(r.u32(), 0);
+	ASSERT_TRUE(r.at_end());
+}
+
+TEST_F(sinsp_with_test_input, column_writer_invalid_fields)
+{
+	std::stringstream out;
+	ASSERT_THROW(sinsp_evt_column_writer(&m_inspector, {}, out), sinsp_exception);
+	ASSERT_THROW(sinsp_evt_column_writer(&m_inspector, {"not.a.field"}, out), sinsp_exception);
+	ASSERT_THROW(sinsp_evt_column_writer(&m_inspector, {"proc.name and"}, out), sinsp_exception);
+}
@@ -0,0 +1,111 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+#include <map>
+
+#include <scap.h>
+#include "connection_table.h"
+
+static ipv4tuple make_ipv4tuple(uint32_t sip, uint16_t sport)
+{
+	ipv4tuple t = {};
+	t.m_fields.m_sip = sip;
+	t.m_fields.m_dip = 0x0100007f;
+	t.m_fields.m_sport = sport;
+	t.m_fields.m_dport = 443;
+	t.m_fields.m_l4proto = SCAP_L4_TCP;
+	return t;
+}
+
+TEST(connection_table, ends)
+{
+	sinsp_connection_table table;
+	ipv4tuple t = make_ipv4tuple(1, 1000);
+	ASSERT_EQ(table.find(t), nullptr);
+
+	table.add(t, false, 10, 3);
+	table.add(t, true, 20, 4);
+	const sinsp_connection* conn = table.find(t);
+	ASSERT_NE(conn, nullptr);
+	ASSERT_EQ(conn->m_client_pid, 10);
+	ASSERT_EQ(conn->m_client_fd, 3);
+	ASSERT_EQ(conn->m_server_pid, 20);
+	ASSERT_EQ(conn->m_server_fd, 4);
+
+	// IPv6 tuples are a different key
+	ipv6tuple t6 = {};
+	t6.m_fields.m_sip.m_b[0] = 1;
+	t6.m_fields.m_dip.m_b[0] = 0x0100007f;
+	t6.m_fields.m_sport = 1000;
+	t6.m_fields.m_dport = 443;
+	t6.m_fields.m_l4proto = SCAP_L4_TCP;
+	ASSERT_EQ(table.find(t6), nullptr);
+
+	// only the matching end goes away
+	table.remove(t, 10, 4);
+	ASSERT_EQ(table.find(t)->m_client_fd, 3);
+	table.remove(t, 10, 3);
+	ASSERT_EQ(table.find(t)->m_client_fd, -1);
+	ASSERT_EQ(table.size(), 1);
+	table.remove(t, 20, 4);
+	ASSERT_EQ(table.find(t), nullptr);
+	ASSERT_EQ(table.size(), 0);
+}
+
+TEST(connection_table, churn)
+{
+	// compare with a std::map under random adds and removes, with
+	// colliding clusters and a full table
+	sinsp_connection_table table(3000);
+	std::map<std::pair<uint32_t, uint16_t>, int64_t> ref;
+	uint32_t seed = 1;
+	for(uint32_t i = 0; i < 100000; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		uint32_t sip = (seed >> 8) % 2000;
+		uint16_t sport = (seed >> 4) % 4;
+		auto key = std::make_pair(sip, sport);
+		ipv4tuple t = make_ipv4tuple(sip, sport);
+		if(seed & 0x10000)
+		{
+			table.add(t, false, 1, sip);
+			if(ref.size() < 3000 || ref.count(key))
+			{
+				ref[key] = sip;
+			}
+		}
+		else
+		{
+			table.remove(t, 1, sip);
+			ref.erase(key);
+		}
+		ASSERT_EQ(table.size(), ref.size());
+	}
+
+	for(const auto& it : ref)
+	{
+		const sinsp_connection* conn = table.find(make_ipv4tuple(it.first.first, it.first.second));
+		ASSERT_NE(conn, nullptr);
+		ASSERT_EQ(conn->m_client_fd, it.second);
+	}
+	ASSERT_GT(table.get_n_drops(), 0);
+
+	table.clear();
+	ASSERT_EQ(table.size(), 0);
+	ASSERT_EQ(table.find(make_ipv4tuple(1, 1)), nullptr);
+}
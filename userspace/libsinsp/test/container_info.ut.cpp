@@ -16,6 +16,8 @@ limitations under the License.
 */
 
 #include "container_info.h"
+#include "container.h"
+#include "sinsp.h"
 #include <gtest/gtest.h>
 #include <tuple>
 #include <vector>
@@ -64,3 +66,45 @@ INSTANTIATE_TEST_CASE_P(sinsp_container_lookup,
 				 std::tuple<short, short, std::vector<short>>{3, 500, {125, 250, 500}},
 				 std::tuple<short, short, std::vector<short>>{5, 1000, {125, 250, 500, 1000, 1000}},
 				 std::tuple<short, short, std::vector<short>>{2, 1, {1, 1}}));
+
+TEST(sinsp_container_manager, thread_handle)
+{
+	sinsp inspector;
+	sinsp_container_manager mgr(&inspector);
+	std::unique_ptr<sinsp_threadinfo> tinfo(inspector.build_threadinfo());
+
+	auto first = std::make_shared<sinsp_container_info>();
+	first->m_id = "3ad7b26ded6d";
+	first->m_name = "nginx";
+	mgr.add_container(first, nullptr);
+
+	auto second = std::make_shared<sinsp_container_info>();
+	second->m_id = "0123456789ab";
+	second->m_name = "redis";
+	mgr.add_container(second, nullptr);
+
+	// Host threads have no container
+	ASSERT_EQ(mgr.get_container(tinfo.get()), nullptr);
+
+	tinfo->m_container_id = "3ad7b26ded6d";
+	ASSERT_EQ(mgr.get_container(tinfo.get()), first);
+	uint64_t handle = tinfo->m_container_handle;
+	ASSERT_EQ(mgr.get_container(tinfo.get()), first);
+	ASSERT_EQ(tinfo->m_container_handle, handle);
+
+	// The replaced container is found through the same handle
+	auto updated = std::make_shared<sinsp_container_info>(*first);
+	updated->m_image = "nginx:1.23";
+	mgr.replace_container(updated);
+	ASSERT_EQ(mgr.get_container(tinfo.get()), updated);
+	ASSERT_EQ(tinfo->m_container_handle, handle);
+
+	// The container id set directly wins over the cached handle
+	tinfo->m_container_id = "0123456789ab";
+	ASSERT_EQ(mgr.get_container(tinfo.get()), second);
+	ASSERT_NE(tinfo->m_container_handle, handle);
+
+	tinfo->m_container_id = "ffffffffffff";
+	ASSERT_EQ(mgr.get_container(tinfo.get()), nullptr);
+	ASSERT_EQ(tinfo->m_container_handle, 0u);
+}
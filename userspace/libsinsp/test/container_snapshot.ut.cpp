@@ -0,0 +1,146 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "sinsp_with_test_input.h"
+#include "container.h"
+#include "strlcpy.h"
+
+class container_snapshot_test : public sinsp_with_test_input
+{
+protected:
+	void SetUp() override
+	{
+		sinsp_with_test_input::SetUp();
+		char path[] = "/tmp/container_snapshot_XXXXXX";
+		int fd = mkstemp(path);
+		ASSERT_NE(fd, -1);
+		close(fd);
+		m_path = path;
+	}
+
+	void TearDown() override
+	{
+		unlink(m_path.c_str());
+		sinsp_with_test_input::TearDown();
+	}
+
+	std::string m_path;
+};
+
+TEST_F(container_snapshot_test, save_load_prune)
+{
+	const std::string id = "3ad7b26ded6d";
+	{
+		sinsp_container_manager mgr(&m_inspector);
+		auto container = std::make_shared<sinsp_container_info>();
+		container->m_id = id;
+		container->m_type = CT_DOCKER;
+		container->m_name = "nginx";
+		container->m_image = "nginx:1.23";
+		container->m_labels["app"] = "web";
+		container->m_memory_limit = 1 << 30;
+		container->set_lookup_status(sinsp_container_lookup::state::SUCCESSFUL);
+		mgr.add_container(container, nullptr);
+
+		auto failed = std::make_shared<sinsp_container_info>();
+		failed->m_id = "0123456789ab";
+		failed->set_lookup_status(sinsp_container_lookup::state::FAILED);
+		mgr.add_container(failed, nullptr);
+
+		m_inspector.m_usergroup_manager.restore_user(id, 101, 101, "nginx", "/var/cache/nginx", "/sbin/nologin");
+		m_inspector.m_usergroup_manager.restore_group(id, 101, "nginx");
+
+		mgr.set_snapshot_path(m_path);
+		mgr.save_snapshot();
+	}
+
+	m_inspector.m_usergroup_manager.rm_user(id, 101);
+	m_inspector.m_usergroup_manager.rm_group(id, 101);
+
+	auto& mgr = m_inspector.m_container_manager;
+	mgr.set_snapshot_path(m_path);
+	ASSERT_EQ(mgr.load_snapshot(), 1u);
+
+	auto container = mgr.get_container(id);
+	ASSERT_NE(container, nullptr);
+	ASSERT_EQ(container->m_type, CT_DOCKER);
+	ASSERT_EQ(container->m_name, "nginx");
+	ASSERT_EQ(container->m_image, "nginx:1.23");
+	ASSERT_EQ(container->m_labels.at("app"), "web");
+	ASSERT_EQ(container->m_memory_limit, 1 << 30);
+	ASSERT_TRUE(container->is_successful());
+	ASSERT_FALSE(mgr.should_lookup(id, CT_DOCKER));
+	ASSERT_EQ(mgr.get_container("0123456789ab"), nullptr);
+
+	auto* user = m_inspector.m_usergroup_manager.get_user(id, 101);
+	ASSERT_NE(user, nullptr);
+	ASSERT_STREQ(user->name, "nginx");
+	ASSERT_STREQ(user->homedir, "/var/cache/nginx");
+	auto* group = m_inspector.m_usergroup_manager.get_group(id, 101);
+	ASSERT_NE(group, nullptr);
+	ASSERT_STREQ(group->name, "nginx");
+
+	// No thread belongs to the container, it's not running anymore
+	mgr.prune_snapshot();
+	ASSERT_EQ(mgr.get_container(id), nullptr);
+	ASSERT_TRUE(mgr.should_lookup(id, CT_DOCKER));
+}
+
+TEST_F(container_snapshot_test, invalid_file)
+{
+	FILE* f = fopen(m_path.c_str(), "w");
+	ASSERT_NE(f, nullptr);
+	fputs("{\"version\": 1, \"containers\": [", f);
+	fclose(f);
+
+	m_inspector.m_container_manager.set_snapshot_path(m_path);
+	ASSERT_EQ(m_inspector.m_container_manager.load_snapshot(), 0u);
+}
+
+TEST_F(container_snapshot_test, save_state)
+{
+	add_default_init_thread();
+
+	scap_fdinfo fdinfo = {};
+	fdinfo.fd = 3;
+	fdinfo.ino = 5;
+	fdinfo.type = SCAP_FD_FILE_V2;
+	fdinfo.info.regularinfo.open_flags = PPM_O_RDONLY;
+	strlcpy(fdinfo.info.regularinfo.fname, "/etc/nginx/nginx.conf", sizeof(fdinfo.info.regularinfo.fname));
+	add_thread(create_threadinfo(100, 100, 1, 100, 100, 100, "nginx", "/usr/sbin/nginx", "/usr/sbin/nginx",
+				     increasing_ts(), 0, 0), {fdinfo});
+	open_inspector();
+
+	m_inspector.set_state_snapshot_file(m_path);
+	test_helper::save_state_snapshot(m_inspector);
+
+	// The snapshot is a capture with the state and no events
+	sinsp restored;
+	restored.open_savefile(m_path);
+	auto tinfo = restored.get_thread_ref(100, false, true);
+	ASSERT_NE(tinfo, nullptr);
+	ASSERT_EQ(tinfo->m_comm, "nginx");
+	ASSERT_EQ(tinfo->m_exepath, "/usr/sbin/nginx");
+	auto fd = tinfo->get_fd(3);
+	ASSERT_NE(fd, nullptr);
+	ASSERT_EQ(fd->m_name, "/etc/nginx/nginx.conf");
+	ASSERT_NE(restored.get_thread_ref(1, false, true), nullptr);
+	restored.close();
+}
@@ -0,0 +1,163 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sinsp_with_test_input.h"
+#include "dumper.h"
+
+TEST_F(sinsp_with_test_input, dumper_minimal_state)
+{
+	char path[] = "/tmp/dumper_minimal_state_XXXXXX";
+	int tmpfd = mkstemp(path);
+	ASSERT_NE(tmpfd, -1);
+	close(tmpfd);
+
+	add_default_init_thread();
+	open_inspector();
+	m_inspector.set_filter("evt.type=read");
+
+	sinsp_dumper dumper;
+	dumper.enable_minimal_state(true);
+	dumper.open(&m_inspector, path, false, true);
+
+	auto next_dump = [&]() {
+		sinsp_evt* evt = nullptr;
+		int32_t res = m_inspector.next(&evt);
+		ASSERT_TRUE(res == SCAP_SUCCESS || res == SCAP_FILTERED_EVENT);
+		dumper.dump(evt);
+	};
+
+	// fd 3 is used by a kept event, fd 4 is closed before
+	add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/kept", PPM_O_RDWR, 0);
+	next_dump();
+	add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (int64_t)3, "/tmp/kept", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	next_dump();
+	add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/dropped", PPM_O_RDWR, 0);
+	next_dump();
+	add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (int64_t)4, "/tmp/dropped", PPM_O_RDWR, 0, 5, (uint64_t)456);
+	next_dump();
+	add_event(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, (int64_t)4);
+	next_dump();
+	add_event(increasing_ts(), 1, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	next_dump();
+	add_event(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+	next_dump();
+	char data[] = "hello";
+	add_event(increasing_ts(), 1, PPME_SYSCALL_READ_X, 2, (int64_t)sizeof(data), scap_const_sized_buffer{data, sizeof(data)});
+	next_dump();
+	dumper.close();
+
+	sinsp replay;
+	replay.open_savefile(path);
+	std::vector<uint16_t> types;
+	std::vector<int32_t> results;
+	sinsp_evt* evt = nullptr;
+	int32_t res;
+	while((res = replay.next(&evt)) != SCAP_EOF)
+	{
+		if(res == SCAP_TIMEOUT)
+		{
+			continue;
+		}
+		ASSERT_TRUE(res == SCAP_SUCCESS || res == SCAP_FILTERED_EVENT);
+		if(evt->get_category() & EC_METAEVENT)
+		{
+			continue;
+		}
+		types.push_back(evt->get_type());
+		results.push_back(res);
+		if(evt->get_type() == PPME_SYSCALL_READ_X)
+		{
+			ASSERT_NE(evt->get_fd_info(), nullptr);
+			ASSERT_EQ(evt->get_fd_info()->m_name, "/tmp/kept");
+		}
+	}
+	replay.close();
+	unlink(path);
+
+	// The opening of fd 3 is written for the state only, right before
+	// the read using it
+	std::vector<uint16_t> expected_types = {PPME_SYSCALL_OPEN_E, PPME_SYSCALL_OPEN_X,
+						PPME_SYSCALL_READ_E, PPME_SYSCALL_READ_X};
+	std::vector<int32_t> expected_results = {SCAP_FILTERED_EVENT, SCAP_FILTERED_EVENT,
+						 SCAP_SUCCESS, SCAP_SUCCESS};
+	ASSERT_EQ(types, expected_types);
+	ASSERT_EQ(results, expected_results);
+}
+
+TEST_F(sinsp_with_test_input, dumper_string_dictionary)
+{
+	char plain_path[] = "/tmp/dumper_strdict_plain_XXXXXX";
+	char dict_path[] = "/tmp/dumper_strdict_XXXXXX";
+	int tmpfd = mkstemp(plain_path);
+	ASSERT_NE(tmpfd, -1);
+	close(tmpfd);
+	tmpfd = mkstemp(dict_path);
+	ASSERT_NE(tmpfd, -1);
+	close(tmpfd);
+
+	add_default_init_thread();
+	open_inspector();
+
+	sinsp_dumper plain;
+	plain.open(&m_inspector, plain_path, false, true);
+	sinsp_dumper dict;
+	dict.open(&m_inspector, dict_path, false, true);
+	dict.enable_string_dictionary(true);
+
+	const char* names[] = {"/usr/lib/x86_64-linux-gnu/libc.so.6", "/etc/ld.so.cache", "short"};
+	for(int i = 0; i < 300; i++)
+	{
+		sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (int64_t)3,
+						      names[i % 3], PPM_O_RDWR, 0, 5, (uint64_t)123);
+		plain.dump(evt);
+		dict.dump(evt);
+	}
+	plain.close();
+	dict.close();
+
+	struct stat plain_st;
+	struct stat dict_st;
+	ASSERT_EQ(stat(plain_path, &plain_st), 0);
+	ASSERT_EQ(stat(dict_path, &dict_st), 0);
+	ASSERT_LT(dict_st.st_size, plain_st.st_size);
+
+	// The references are expanded back by the reader
+	sinsp replay;
+	replay.open_savefile(dict_path);
+	int n = 0;
+	sinsp_evt* evt = nullptr;
+	int32_t res;
+	while((res = replay.next(&evt)) != SCAP_EOF)
+	{
+		if(res == SCAP_TIMEOUT || evt->get_type() != PPME_SYSCALL_OPEN_X)
+		{
+			continue;
+		}
+		ASSERT_EQ(res, SCAP_SUCCESS);
+		ASSERT_EQ(std::string(evt->get_param_value_str("name", false)), names[n % 3]);
+		n++;
+	}
+	replay.close();
+	unlink(plain_path);
+	unlink(dict_path);
+
+	ASSERT_EQ(n, 300);
+}
@@ -0,0 +1,72 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <cstring>
+
+#include "event_buffer_pool.h"
+#include <gtest/gtest.h>
+
+TEST(event_buffer_pool, size_classes)
+{
+	event_buffer_pool pool;
+
+	uint8_t* buf = pool.reserve(NULL, 26);
+	ASSERT_NE(buf, nullptr);
+	EXPECT_EQ(event_buffer_pool::get_capacity(buf), EVENT_BUFFER_MIN_SIZE);
+	memset(buf, 0xaa, 26);
+
+	// reused while large enough
+	EXPECT_EQ(pool.reserve(buf, EVENT_BUFFER_MIN_SIZE), buf);
+
+	// grown otherwise, the old buffer goes to the free list
+	uint8_t* big = pool.reserve(buf, 300);
+	ASSERT_NE(big, nullptr);
+	EXPECT_EQ(event_buffer_pool::get_capacity(big), 512);
+	EXPECT_EQ(pool.get_num_cached(), 1);
+	memset(big, 0xbb, 300);
+
+	EXPECT_EQ(pool.reserve(NULL, SP_EVT_BUF_SIZE + 1), nullptr);
+	uint8_t* max = pool.reserve(NULL, SP_EVT_BUF_SIZE);
+	ASSERT_NE(max, nullptr);
+	EXPECT_EQ(event_buffer_pool::get_capacity(max), SP_EVT_BUF_SIZE);
+
+	event_buffer_pool::free_buffer(max);
+	pool.release(big, 10);
+	EXPECT_EQ(pool.get_num_cached(), 2);
+}
+
+TEST(event_buffer_pool, reuse)
+{
+	event_buffer_pool pool;
+
+	uint8_t* a = pool.reserve(NULL, 40);
+	uint8_t* b = pool.reserve(NULL, 1000);
+	pool.release(a, 10);
+	pool.release(b, 10);
+
+	// the free list of the size class is used
+	EXPECT_EQ(pool.reserve(NULL, 1024), b);
+	EXPECT_EQ(pool.reserve(NULL, 1), a);
+	EXPECT_EQ(pool.get_num_cached(), 0);
+
+	// over the limit, the buffers are freed
+	pool.release(a, 1);
+	pool.release(b, 1);
+	EXPECT_EQ(pool.get_num_cached(), 1);
+	EXPECT_EQ(pool.reserve(NULL, 1), a);
+	event_buffer_pool::free_buffer(a);
+}
@@ -0,0 +1,157 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include "sinsp_with_test_input.h"
+
+namespace
+{
+struct delivered_evt
+{
+	uint16_t type;
+	uint64_t ts;
+	uint32_t repeats;
+};
+}
+
+static std::vector<delivered_evt> read_all(sinsp& inspector)
+{
+	std::vector<delivered_evt> ret;
+	sinsp_evt* evt;
+	int32_t res;
+	while((res = inspector.next(&evt)) != SCAP_EOF)
+	{
+		if(res == SCAP_SUCCESS && evt->get_tid() == 1)
+		{
+			ret.push_back({evt->get_type(), evt->get_ts(), evt->get_repeat_count()});
+		}
+	}
+	return ret;
+}
+
+TEST_F(sinsp_with_test_input, event_coalescing_flush_on_break)
+{
+	add_default_init_thread();
+	open_inspector();
+	m_inspector.set_event_coalescing(true, ONE_SECOND_IN_NS);
+
+	std::vector<uint64_t> ts;
+	for(int i = 0; i < 5; i++)
+	{
+		ts.push_back(increasing_ts());
+		add_event(ts.back(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+		ts.push_back(increasing_ts());
+		add_event(ts.back(), 1, PPME_SYSCALL_READ_X, 2, (int64_t)-11, scap_const_sized_buffer{nullptr, 0});
+	}
+
+	// the last read returns some data and breaks the run
+	std::string data = "hello";
+	ts.push_back(increasing_ts());
+	add_event(ts.back(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+	ts.push_back(increasing_ts());
+	add_event(ts.back(), 1, PPME_SYSCALL_READ_X, 2, (int64_t)data.size(), scap_const_sized_buffer{data.data(), data.size()});
+
+	auto evts = read_all(m_inspector);
+	ASSERT_EQ(evts.size(), 5);
+
+	EXPECT_EQ(evts[0].ts, ts[0]);
+	EXPECT_EQ(evts[0].repeats, 0);
+	EXPECT_EQ(evts[1].ts, ts[1]);
+	EXPECT_EQ(evts[1].repeats, 0);
+
+	// the last suppressed exit and enter events are flushed in order,
+	// with the ones suppressed before them
+	EXPECT_EQ(evts[2].type, PPME_SYSCALL_READ_X);
+	EXPECT_EQ(evts[2].ts, ts[9]);
+	EXPECT_EQ(evts[2].repeats, 3);
+	EXPECT_EQ(evts[3].type, PPME_SYSCALL_READ_E);
+	EXPECT_EQ(evts[3].ts, ts[10]);
+	EXPECT_EQ(evts[3].repeats, 4);
+
+	EXPECT_EQ(evts[4].ts, ts[11]);
+	EXPECT_EQ(evts[4].repeats, 0);
+	EXPECT_EQ(m_inspector.get_event_coalescer().get_num_suppressed(), 7);
+}
+
+TEST_F(sinsp_with_test_input, event_coalescing_window)
+{
+	add_default_init_thread();
+	open_inspector();
+	// the events of a direction are 20 ms apart
+	m_inspector.set_event_coalescing(true, 50000000);
+
+	for(int i = 0; i < 10; i++)
+	{
+		add_event(increasing_ts(), 1, PPME_SYSCALL_EPOLLWAIT_E, 1, (int64_t)16);
+		add_event(increasing_ts(), 1, PPME_SYSCALL_EPOLLWAIT_X, 1, (int64_t)0);
+	}
+
+	auto evts = read_all(m_inspector);
+
+	// every window delivers one event with the count of the ones it
+	// stands for
+	ASSERT_EQ(evts.size(), 8);
+	uint32_t total = 0;
+	for(const auto& e : evts)
+	{
+		total += 1 + e.repeats;
+	}
+	EXPECT_EQ(total, 20);
+	EXPECT_EQ(evts[2].repeats, 2);
+	EXPECT_EQ(evts[3].repeats, 2);
+	EXPECT_EQ(m_inspector.get_event_coalescer().get_num_suppressed(), 12);
+}
+
+TEST_F(sinsp_with_test_input, event_coalescing_state)
+{
+	add_default_init_thread();
+	open_inspector();
+	m_inspector.set_event_coalescing(true);
+
+	// the events changing the state are never suppressed
+	for(int i = 0; i < 3; i++)
+	{
+		add_event(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, (int64_t)3);
+		add_event(increasing_ts(), 1, PPME_SYSCALL_CLOSE_X, 1, (int64_t)-9);
+	}
+	EXPECT_EQ(read_all(m_inspector).size(), 6);
+
+	// the suppressed events are still parsed
+	for(int i = 0; i < 2; i++)
+	{
+		add_event(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+		add_event(increasing_ts(), 1, PPME_SYSCALL_READ_X, 2, (int64_t)-11, scap_const_sized_buffer{nullptr, 0});
+	}
+	uint64_t ts = increasing_ts();
+	add_event(ts, 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+	EXPECT_EQ(read_all(m_inspector).size(), 2);
+	EXPECT_EQ(m_inspector.get_thread_ref(1, false, true)->m_lastevent_ts, ts);
+
+	add_event(increasing_ts(), 1, PPME_SYSCALL_READ_X, 2, (int64_t)5, scap_const_sized_buffer{"hello", 5});
+	sinsp_evt* evt;
+	ASSERT_EQ(m_inspector.next(&evt), SCAP_SUCCESS);
+	EXPECT_EQ(evt->get_type(), PPME_SYSCALL_READ_X);
+	EXPECT_EQ(get_field_as_string(evt, "evt.repeat_count"), "0");
+	ASSERT_EQ(m_inspector.next(&evt), SCAP_SUCCESS);
+	EXPECT_EQ(evt->get_type(), PPME_SYSCALL_READ_E);
+	EXPECT_EQ(evt->get_ts(), ts);
+	EXPECT_EQ(get_field_as_string(evt, "evt.repeat_count"), "1");
+	ASSERT_EQ(m_inspector.next(&evt), SCAP_SUCCESS);
+	EXPECT_EQ(evt->get_type(), PPME_SYSCALL_READ_X);
+	EXPECT_EQ(get_field_as_string(evt, "evt.rawres"), "5");
+}
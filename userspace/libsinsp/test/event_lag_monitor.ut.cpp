@@ -0,0 +1,114 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include "event_lag_monitor.h"
+
+TEST(event_lag_monitor, percentiles)
+{
+	event_lag_monitor m;
+	m.init(1, 0, nullptr);
+
+	uint64_t now = 1000000000000;
+	for(uint64_t lag = 1; lag <= 100; lag++)
+	{
+		m.sample(now - lag * 1000, now);
+	}
+
+	// timestamps from the future count as no lag
+	m.sample(now + 5000, now);
+
+	EXPECT_EQ(m.get_last_lag_ns(), 0);
+	EXPECT_EQ(m.get_histogram().m_count, 101);
+	EXPECT_EQ(m.get_histogram().m_max_ns, 100000);
+	EXPECT_EQ(latency_profiler::get_percentile(m.get_histogram(), 50), 65535);
+	EXPECT_EQ(latency_profiler::get_percentile(m.get_histogram(), 99), 100000);
+	EXPECT_FALSE(m.get_backpressure());
+
+	uint32_t nstats = 0;
+	const scap_stats_v2* stats = m.get_stats(&nstats);
+	ASSERT_EQ(nstats, 9);
+	EXPECT_STREQ(stats[0].name, "lag.count");
+	EXPECT_EQ(stats[0].value.u64, 101);
+	EXPECT_EQ(stats[0].flags, PPM_SCAP_STATS_LATENCY);
+}
+
+TEST(event_lag_monitor, backpressure)
+{
+	std::vector<bool> signals;
+	event_lag_monitor m;
+	m.init(1, 1000, [&](bool backpressure, uint64_t lag_ns)
+	{
+		signals.push_back(backpressure);
+		if(backpressure)
+		{
+			EXPECT_GT(lag_ns, 1000);
+		}
+		else
+		{
+			EXPECT_LT(lag_ns, 500);
+		}
+	});
+
+	uint64_t now = 1000000000000;
+	m.sample(now - 100, now);
+	EXPECT_FALSE(m.get_backpressure());
+
+	// a single slow event doesn't raise the signal
+	m.sample(now - 5000, now);
+	EXPECT_FALSE(m.get_backpressure());
+	m.sample(now - 100, now);
+
+	for(uint32_t j = 0; j < 20 && !m.get_backpressure(); j++)
+	{
+		m.sample(now - 5000, now);
+	}
+	EXPECT_TRUE(m.get_backpressure());
+
+	// still above half of the threshold
+	for(uint32_t j = 0; j < 20; j++)
+	{
+		m.sample(now - 600, now);
+	}
+	EXPECT_TRUE(m.get_backpressure());
+
+	for(uint32_t j = 0; j < 20 && m.get_backpressure(); j++)
+	{
+		m.sample(now, now);
+	}
+	EXPECT_FALSE(m.get_backpressure());
+	EXPECT_EQ(signals, std::vector<bool>({true, false}));
+
+	m.clear();
+	EXPECT_EQ(m.get_histogram().m_count, 0);
+	EXPECT_EQ(m.get_smoothed_lag_ns(), 0);
+}
+
+TEST(event_lag_monitor, sampling)
+{
+	event_lag_monitor m;
+	m.on_event(0);
+	EXPECT_EQ(m.get_histogram().m_count, 0);
+
+	m.init(10, 0, nullptr);
+	for(uint32_t j = 0; j < 100; j++)
+	{
+		m.on_event(sinsp_utils::get_current_time_ns());
+	}
+	EXPECT_EQ(m.get_histogram().m_count, 10);
+}
@@ -0,0 +1,79 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include "sinsp_with_test_input.h"
+
+static std::vector<uint64_t> read_all_ts(sinsp& inspector)
+{
+	std::vector<uint64_t> ret;
+	sinsp_evt* evt;
+	int32_t res;
+	while((res = inspector.next(&evt)) != SCAP_EOF)
+	{
+		if(res == SCAP_SUCCESS && evt->get_tid() == 1)
+		{
+			ret.push_back(evt->get_ts());
+		}
+	}
+	return ret;
+}
+
+TEST_F(sinsp_with_test_input, event_reordering_window)
+{
+	add_default_init_thread();
+	open_inspector();
+	m_inspector.set_event_reordering(1000);
+	m_allow_unordered_events = true;
+
+	uint64_t base = increasing_ts();
+	// 100 and 200 arrive after 300, within the window
+	for(uint64_t delta : {0, 300, 100, 200, 5000, 5001, 5002, 5003})
+	{
+		add_event(base + delta, 1, PPME_SYSCALL_EPOLLWAIT_E, 1, (int64_t)16);
+	}
+	// 250 arrives after 300 was delivered
+	add_event(base + 250, 1, PPME_SYSCALL_EPOLLWAIT_E, 1, (int64_t)16);
+
+	auto ts = read_all_ts(m_inspector);
+	std::vector<uint64_t> expected;
+	for(uint64_t delta : {0, 100, 200, 300, 5000, 5001, 5002, 5003})
+	{
+		expected.push_back(base + delta);
+	}
+	EXPECT_EQ(ts, expected);
+	EXPECT_EQ(m_inspector.get_event_reorderer().get_num_reordered(), 2);
+	EXPECT_EQ(m_inspector.get_event_reorderer().get_num_late(), 1);
+}
+
+TEST_F(sinsp_with_test_input, event_reordering_disabled)
+{
+	add_default_init_thread();
+	open_inspector();
+	m_allow_unordered_events = true;
+
+	uint64_t base = increasing_ts();
+	for(uint64_t delta : {0, 300, 100})
+	{
+		add_event(base + delta, 1, PPME_SYSCALL_EPOLLWAIT_E, 1, (int64_t)16);
+	}
+
+	std::vector<uint64_t> expected = {base, base + 300, base + 100};
+	EXPECT_EQ(read_all_ts(m_inspector), expected);
+	EXPECT_EQ(m_inspector.get_event_reorderer().get_num_late(), 0);
+}
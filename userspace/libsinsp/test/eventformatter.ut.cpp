@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "sinsp.h"
 #include "eventformatter.h"
+#include "sinsp_with_test_input.h"
 
 #include <gtest/gtest.h>
 
@@ -38,4 +39,25 @@ TEST(eventformatter, get_field_names)
 	ASSERT_NE(find(output_fields.begin(), output_fields.end(), "fd.type"), output_fields.end());
 	ASSERT_NE(find(output_fields.begin(), output_fields.end(), "proc.pid"), output_fields.end());
 	delete inspector;
-}
\ No newline at end of file
+}
+
+TEST_F(sinsp_with_test_input, eventformatter_time)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	sinsp_evt_formatter fmt(&m_inspector, "%evt.time %evt.datetime");
+	uint64_t ts = 1700000000999999990ULL;
+	for(uint64_t delta : {0ULL, 5ULL, 15ULL, 1000000000ULL, 1000000001ULL})
+	{
+		sinsp_evt* evt = add_event_advance_ts(ts + delta, 1, PPME_SYSCALL_CLOSE_E, 1, (int64_t)3);
+
+		std::string time, datetime;
+		sinsp_utils::ts_to_string(ts + delta, &time, false, true);
+		sinsp_utils::ts_to_string(ts + delta, &datetime, true, true);
+
+		std::string out;
+		ASSERT_TRUE(fmt.tostring(evt, &out));
+		EXPECT_EQ(out, time + " " + datetime);
+	}
+}
@@ -0,0 +1,216 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include "sinsp_with_test_input.h"
+#include "eventpipeline.h"
+
+#include <map>
+#include <mutex>
+#include <set>
+
+// All the events of a batch stay valid until the next call.
+TEST_F(sinsp_with_test_input, next_batch_snapshots)
+{
+	add_default_init_thread();
+	for(int64_t fd = 3; fd < 13; fd++)
+	{
+		std::string name = "/tmp/file_" + std::to_string(fd);
+		add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, name.c_str(), PPM_O_RDWR, 0);
+		add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, fd, name.c_str(), PPM_O_RDWR, 0, 5, (uint64_t)123);
+	}
+	open_inspector();
+
+	sinsp_evt* evts[8];
+	uint32_t nevts = 0;
+	std::vector<std::string> names;
+	int32_t res;
+	while((res = m_inspector.next_batch(evts, 8, &nevts)) == SCAP_SUCCESS)
+	{
+		ASSERT_GT(nevts, 0);
+		ASSERT_LE(nevts, 8);
+		for(uint32_t i = 0; i < nevts; i++)
+		{
+			if(evts[i]->get_type() == PPME_SYSCALL_OPEN_X)
+			{
+				names.push_back(get_field_as_string(evts[i], "fd.name"));
+				ASSERT_EQ(get_field_as_string(evts[i], "evt.rawarg.name"), names.back());
+			}
+			ASSERT_EQ(evts[i]->get_num(), evts[0]->get_num() + i);
+		}
+	}
+	ASSERT_EQ(res, SCAP_EOF);
+	ASSERT_EQ(nevts, 0);
+	ASSERT_EQ(names.size(), 10);
+	for(int64_t fd = 3; fd < 13; fd++)
+	{
+		ASSERT_EQ(names[fd - 3], "/tmp/file_" + std::to_string(fd));
+	}
+}
+
+// The threads that exit during a batch are removed at the start of the next
+// one, unless their tid has been reused in the meantime.
+TEST_F(sinsp_with_test_input, next_batch_exited_threads)
+{
+	add_default_init_thread();
+	add_thread(create_threadinfo(20, 20, 1, 20, 20, 20, "bash", "/bin/bash", "/bin/bash", increasing_ts(), 0, 0), {});
+	add_thread(create_threadinfo(30, 30, 1, 30, 30, 30, "sleep", "/bin/sleep", "/bin/sleep", increasing_ts(), 0, 0), {});
+
+	scap_const_sized_buffer empty_bytebuf = {nullptr, 0};
+	add_event(increasing_ts(), 20, PPME_PROCEXIT_1_E, 4, (int64_t)0, (int64_t)0, (uint8_t)0, (uint8_t)0);
+	add_event(increasing_ts(), 30, PPME_PROCEXIT_1_E, 4, (int64_t)0, (int64_t)0, (uint8_t)0, (uint8_t)0);
+	add_event(increasing_ts(), 1, PPME_SYSCALL_CLONE_20_E, 0);
+	add_event(increasing_ts(), 1, PPME_SYSCALL_CLONE_20_X, 20, (int64_t)20, "reborn", empty_bytebuf, (int64_t)1, (int64_t)1, (int64_t)0, "", (uint64_t)1024, (uint64_t)0, (uint64_t)0, 0, 0, 0, "reborn", empty_bytebuf, PPM_CL_CLONE_CHILD_CLEARTID | PPM_CL_CLONE_CHILD_SETTID, 0, 0, (int64_t)1, (int64_t)1);
+	add_event(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, (int64_t)3);
+	open_inspector();
+
+	sinsp_evt* evts[4];
+	uint32_t nevts = 0;
+	ASSERT_EQ(m_inspector.next_batch(evts, 4, &nevts), SCAP_SUCCESS);
+	ASSERT_EQ(nevts, 4);
+	ASSERT_EQ(evts[1]->get_tid(), 30);
+	ASSERT_EQ(get_field_as_string(evts[1], "proc.name"), "sleep");
+	ASSERT_NE(m_inspector.get_thread_ref(30, false, true), nullptr);
+
+	ASSERT_EQ(m_inspector.next_batch(evts, 4, &nevts), SCAP_SUCCESS);
+	ASSERT_EQ(nevts, 1);
+	ASSERT_EQ(m_inspector.get_thread_ref(30, false, true), nullptr);
+	auto reborn = m_inspector.get_thread_ref(20, false, true);
+	ASSERT_NE(reborn, nullptr);
+	ASSERT_EQ(reborn->m_comm, "reborn");
+
+	// the end of the capture ended the last batch, it comes with no events
+	ASSERT_EQ(m_inspector.next_batch(evts, 4, &nevts), SCAP_EOF);
+	ASSERT_EQ(nevts, 0);
+}
+
+// A file every 3 is interesting, every event is evaluated by one of the workers.
+TEST_F(sinsp_with_test_input, pipeline_filter_and_format)
+{
+	add_default_init_thread();
+
+	const int64_t num_files = 60;
+	std::set<std::string> expected;
+	for(int64_t fd = 3; fd < num_files + 3; fd++)
+	{
+		std::string name = (fd % 3 == 0 ? "/tmp/match_" : "/tmp/other_") + std::to_string(fd);
+		if(fd % 3 == 0)
+		{
+			expected.insert(name + " " + std::to_string(fd));
+		}
+		add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, name.c_str(), PPM_O_RDWR, 0);
+		add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, fd, name.c_str(), PPM_O_RDWR, 0, 5, (uint64_t)123);
+		// the fd is closed before the next batch, the snapshot keeps its own copy
+		add_event(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, fd);
+		add_event(increasing_ts(), 1, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	}
+
+	open_inspector();
+
+	std::mutex mtx;
+	std::set<std::string> outputs;
+	std::set<uint32_t> workers;
+	sinsp_evt_pipeline pipeline(
+		&m_inspector, 4, 7,
+		[this](uint32_t)
+		{
+			sinsp_evt_pipeline::worker w;
+			sinsp_filter_compiler compiler(&m_inspector, "evt.type=open and evt.dir=< and fd.name contains match");
+			w.m_filter.reset(compiler.compile());
+			w.m_formatter.reset(new sinsp_evt_formatter(&m_inspector, "%fd.name %evt.rawarg.fd"));
+			return w;
+		},
+		[&](uint32_t worker_idx, sinsp_evt* evt, const std::string& output)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			ASSERT_EQ(evt->get_type(), PPME_SYSCALL_OPEN_X);
+			workers.insert(worker_idx);
+			outputs.insert(output);
+		});
+
+	int32_t res;
+	while((res = pipeline.next_batch()) == SCAP_SUCCESS || res == SCAP_TIMEOUT)
+	{
+	}
+	ASSERT_EQ(res, SCAP_EOF);
+	ASSERT_EQ(outputs, expected);
+	ASSERT_FALSE(workers.empty());
+}
+
+TEST_F(sinsp_with_test_input, pipeline_callback_exception)
+{
+	add_default_init_thread();
+	add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	open_inspector();
+
+	sinsp_evt_pipeline pipeline(
+		&m_inspector, 2, 16,
+		[](uint32_t) { return sinsp_evt_pipeline::worker(); },
+		[](uint32_t, sinsp_evt*, const std::string&) { throw sinsp_exception("callback failure"); });
+
+	ASSERT_THROW(pipeline.next_batch(), sinsp_exception);
+}
+
+// The ancestors are evaluated by several workers at once, while the exits
+// of the threads invalidate them at every batch.
+TEST_F(sinsp_with_test_input, pipeline_ancestors)
+{
+	add_default_init_thread();
+	add_thread(create_threadinfo(20, 20, 1, 20, 20, 20, "bash", "/bin/bash", "/bin/bash", increasing_ts(), 0, 0), {});
+
+	const int64_t num_threads = 100;
+	std::set<std::string> expected;
+	for(int64_t tid = 100; tid < 100 + num_threads; tid++)
+	{
+		add_thread(create_threadinfo(tid, tid, 20, tid, tid, tid, "worker", "/bin/worker", "/bin/worker", increasing_ts(), 0, 0), {});
+	}
+	for(int64_t tid = 100; tid < 100 + num_threads; tid++)
+	{
+		add_event(increasing_ts(), tid, PPME_SYSCALL_CLOSE_E, 1, (int64_t)3);
+		add_event(increasing_ts(), tid, PPME_PROCEXIT_1_E, 4, (int64_t)0, (int64_t)0, (uint8_t)0, (uint8_t)0);
+		expected.insert("bash 1 " + std::to_string(tid));
+	}
+
+	open_inspector();
+
+	std::mutex mtx;
+	std::set<std::string> outputs;
+	sinsp_evt_pipeline pipeline(
+		&m_inspector, 4, 8,
+		[this](uint32_t)
+		{
+			sinsp_evt_pipeline::worker w;
+			sinsp_filter_compiler compiler(&m_inspector, "evt.type=close and proc.aname=bash and proc.apid=1 and proc.aname[2]=init");
+			w.m_filter.reset(compiler.compile());
+			w.m_formatter.reset(new sinsp_evt_formatter(&m_inspector, "%proc.aname[1] %proc.apid[2] %proc.pid"));
+			return w;
+		},
+		[&](uint32_t, sinsp_evt*, const std::string& output)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			outputs.insert(output);
+		});
+
+	int32_t res;
+	while((res = pipeline.next_batch()) == SCAP_SUCCESS || res == SCAP_TIMEOUT)
+	{
+	}
+	ASSERT_EQ(res, SCAP_EOF);
+	ASSERT_EQ(outputs, expected);
+}
@@ -19,6 +19,7 @@ limitations under the License.
 
 #include "sinsp_with_test_input.h"
 #include "test_utils.h"
+#include "parsers.h"
 #include <arpa/inet.h>
 #include <netinet/in.h>
 
@@ -36,7 +37,7 @@ limitations under the License.
 
 #define ASSERT_FD_GETTERS_NOT_FILE(x)        \
 	ASSERT_EQ(x->m_name, "");            \
-	ASSERT_EQ(x->m_name_raw, "");        \
+	ASSERT_EQ(x->get_name_raw(), "");    \
 	ASSERT_EQ(x->m_oldname, "");         \
 	ASSERT_EQ(x->get_device(), 0);       \
 	ASSERT_EQ(x->tostring_clean(), "");  \
@@ -66,6 +67,141 @@ TEST_F(sinsp_with_test_input, file_open)
 	ASSERT_EQ(get_field_as_string(evt, "fd.name"), "/tmp/the_file");
 	ASSERT_EQ(get_field_as_string(evt, "fd.directory"), "/tmp");
 	ASSERT_EQ(get_field_as_string(evt, "fd.filename"), "the_file");
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/the_file", PPM_O_RDWR, 0);
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)4, "/the_file", PPM_O_RDWR, 0, 5, (uint64_t)124);
+	ASSERT_EQ(get_field_as_string(evt, "fd.directory"), "/");
+	ASSERT_EQ(get_field_as_string(evt, "fd.filename"), "the_file");
+
+	// the fd keeps its name across events
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+	ASSERT_EQ(get_field_as_string(evt, "fd.directory"), "/tmp");
+	ASSERT_EQ(get_field_as_string(evt, "fd.filename"), "the_file");
+	ASSERT_EQ(get_field_as_string(evt, "fd.containerdirectory"), ":/tmp");
+}
+
+TEST_F(sinsp_with_test_input, io_aggregate)
+{
+	add_default_init_thread();
+
+	open_inspector();
+	sinsp_evt* evt = NULL;
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/other_file", PPM_O_RDWR, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)4, "/tmp/other_file", PPM_O_RDWR, 0, 5, (uint64_t)124);
+
+	// the aggregate comes while the thread is in the middle of a read
+	// of another file
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_IO_AGGREGATE_E, 4, (int64_t)4, (uint8_t)PPM_IO_AGGREGATE_WRITE, (uint64_t)10, (uint64_t)4096);
+
+	ASSERT_EQ(evt->get_type(), PPME_IO_AGGREGATE_E);
+	ASSERT_EQ(get_field_as_string(evt, "fd.name"), "/tmp/other_file");
+	ASSERT_EQ(get_field_as_string(evt, "fd.num"), "4");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.direction"), "WRITE");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.count"), "10");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.bytes"), "4096");
+
+	// the read still finds its enter event
+	std::string data = "hello";
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_X, 2, (int64_t)data.size(), scap_const_sized_buffer{data.data(), data.size()});
+	ASSERT_EQ(get_field_as_string(evt, "fd.name"), "/tmp/the_file");
+}
+
+TEST_F(sinsp_with_test_input, exit_events_without_enter)
+{
+	add_default_init_thread();
+
+	open_inspector();
+	sinsp_evt* evt = NULL;
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+
+	// the exit events carry the fd, no enter event is needed
+	std::string data = "hello";
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_X, 3, (int64_t)data.size(), scap_const_sized_buffer{data.data(), data.size()}, (int64_t)3);
+	ASSERT_EQ(get_field_as_string(evt, "fd.name"), "/tmp/the_file");
+	ASSERT_EQ(get_field_as_string(evt, "fd.num"), "3");
+
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_WRITE_X, 3, (int64_t)data.size(), scap_const_sized_buffer{data.data(), data.size()}, (int64_t)3);
+	ASSERT_EQ(get_field_as_string(evt, "fd.name"), "/tmp/the_file");
+
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_X, 2, (int64_t)0, (int64_t)3);
+	ASSERT_EQ(get_field_as_string(evt, "fd.name"), "/tmp/the_file");
+
+	// the fd is removed when the next event comes
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+	ASSERT_EQ(m_inspector.get_thread_ref(1, false, true)->get_fd(3), nullptr);
+
+	// without the fd, e.g. from an older capture, the exit events are not
+	// parsed without their enter event
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)4, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)4, (uint32_t)64);
+	ASSERT_NE(m_inspector.get_thread_ref(1, false, true)->get_fd(4), nullptr);
+}
+
+TEST_F(sinsp_with_test_input, parse_counters)
+{
+	add_default_init_thread();
+
+	open_inspector();
+	m_inspector.set_filter("evt.type=open");
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+
+	// filtered out before being parsed
+	sinsp_evt* evt = nullptr;
+	add_event(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+	ASSERT_EQ(m_inspector.next(&evt), SCAP_FILTERED_EVENT);
+	add_event(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+	ASSERT_EQ(m_inspector.next(&evt), SCAP_FILTERED_EVENT);
+
+	auto parser = m_inspector.get_parser();
+	EXPECT_EQ(parser->get_parse_counters(PPME_SYSCALL_OPEN_X).m_num_events, 1);
+	EXPECT_EQ(parser->get_parse_counters(PPME_SYSCALL_OPEN_X).m_num_parsed, 1);
+	EXPECT_EQ(parser->get_parse_counters(PPME_SYSCALL_READ_E).m_num_events, 2);
+	EXPECT_EQ(parser->get_parse_counters(PPME_SYSCALL_READ_E).m_num_parsed, 0);
+	EXPECT_EQ(parser->get_parse_counters(PPME_SYSCALL_CLOSE_X).m_num_events, 0);
+
+	uint32_t nstats = 0;
+	const scap_stats_v2* stats = parser->get_parse_stats(&nstats);
+	ASSERT_EQ(nstats, 6);
+	EXPECT_EQ(std::string(stats[0].name), "parser.open_2.events");
+	EXPECT_EQ(stats[0].flags, PPM_SCAP_STATS_PARSE_COUNTERS);
+	EXPECT_EQ(stats[0].value.u64, 1);
+}
+
+TEST_F(sinsp_with_test_input, replace_filter)
+{
+	add_default_init_thread();
+
+	open_inspector();
+	m_inspector.set_filter("evt.type=open");
+
+	sinsp_evt* evt = nullptr;
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	add_event(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+	ASSERT_EQ(m_inspector.next(&evt), SCAP_FILTERED_EVENT);
+
+	// an invalid filter leaves the current one in place
+	ASSERT_THROW(m_inspector.replace_filter("evt.type=="), sinsp_exception);
+	ASSERT_EQ(m_inspector.get_filter(), "evt.type=open");
+
+	m_inspector.replace_filter("evt.type=read");
+	ASSERT_EQ(m_inspector.get_filter(), "evt.type=read");
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+	add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	ASSERT_EQ(m_inspector.next(&evt), SCAP_FILTERED_EVENT);
+
+	m_inspector.replace_filter("");
+	ASSERT_EQ(m_inspector.get_filter(), "");
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, (int64_t)3);
 }
 
 TEST_F(sinsp_with_test_input, dup_dup2_dup3)
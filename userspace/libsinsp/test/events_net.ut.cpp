@@ -147,6 +147,26 @@ TEST_F(sinsp_with_test_input, net_ipv4_connect)
 	ASSERT_EQ(get_field_as_string(evt, "fd.connected"), "true");
 	ASSERT_EQ(get_field_as_string(evt, "fd.sip"), DEFAULT_IPV4_SERVER_STRING);
 
+	/* Every network of the list is checked, not only the first one */
+	ASSERT_TRUE(eval_filter(evt, "fd.net in (10.0.0.0/8, ::1/128, 142.251.0.0/16)"));
+	ASSERT_TRUE(eval_filter(evt, "fd.snet in (10.0.0.0/8, 142.251.111.147/32)"));
+	ASSERT_TRUE(eval_filter(evt, "fd.cnet in (192.168.0.0/16, 172.32.0.0/11)"));
+	ASSERT_FALSE(eval_filter(evt, "fd.net in (10.0.0.0/8, 142.251.111.148/32, fd00::/8)"));
+
+	/* Short and long (hashed) lists of addresses and ports */
+	ASSERT_TRUE(eval_filter(evt, "fd.ip in (10.0.0.1, ::1, " DEFAULT_IPV4_SERVER_STRING ")"));
+	ASSERT_TRUE(eval_filter(evt, "fd.sip in (::1, " DEFAULT_IPV4_SERVER_STRING ")"));
+	ASSERT_FALSE(eval_filter(evt, "fd.ip in (10.0.0.1, ::1)"));
+	std::string ports;
+	for(uint32_t port = 1000; port < 1200; port++)
+	{
+		ports += std::to_string(port) + ", ";
+	}
+	ASSERT_TRUE(eval_filter(evt, "fd.port in (" + ports + DEFAULT_SERVER_PORT_STRING ")"));
+	ASSERT_TRUE(eval_filter(evt, "fd.sport in (" + ports + DEFAULT_SERVER_PORT_STRING ")"));
+	ASSERT_FALSE(eval_filter(evt, "fd.cport in (" + ports + DEFAULT_SERVER_PORT_STRING ")"));
+	ASSERT_FALSE(eval_filter(evt, "fd.port in (" + ports + "1)"));
+
 	/* The concept of remote ip is quite strange, we check if the client address is one of our interfaces, if yes
 	 * the remote ip will be the server otherwise it will be the client! In this case, the client IP is completely random
 	 * so it will be considered as remote, while the server ip will be local!
@@ -614,3 +634,101 @@ TEST_F(sinsp_with_test_input, net_connect_enter_event_is_missing_wo_fd_param_exi
 	fdinfo = evt->get_fd_info();
 	ASSERT_EQ(fdinfo, nullptr);
 }
+
+TEST_F(sinsp_with_test_input, net_connection_table)
+{
+	add_default_init_thread();
+	m_inspector.set_connection_table(true);
+	open_inspector();
+	const sinsp_connection_table* table = m_inspector.get_connection_table();
+	ASSERT_NE(table, nullptr);
+
+	int64_t client_fd = 7;
+	int64_t server_fd = 6;
+	sockaddr_in client = test_utils::fill_sockaddr_in(DEFAULT_CLIENT_PORT, DEFAULT_IPV4_CLIENT_STRING);
+	sockaddr_in server = test_utils::fill_sockaddr_in(DEFAULT_SERVER_PORT, DEFAULT_IPV4_SERVER_STRING);
+	std::vector<uint8_t> server_sockaddr = test_utils::pack_sockaddr(reinterpret_cast<sockaddr*>(&server));
+	std::vector<uint8_t> socktuple = test_utils::pack_socktuple(reinterpret_cast<sockaddr*>(&client), reinterpret_cast<sockaddr*>(&server));
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SOCKET_SOCKET_E, 3, PPM_AF_INET, SOCK_STREAM, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SOCKET_SOCKET_X, 1, client_fd);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SOCKET_CONNECT_E, 2, client_fd, scap_const_sized_buffer{server_sockaddr.data(), server_sockaddr.size()});
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SOCKET_CONNECT_X, 3, return_value, scap_const_sized_buffer{socktuple.data(), socktuple.size()}, client_fd);
+	ipv4tuple tuple = evt->get_fd_info()->m_sockinfo.m_ipv4info;
+
+	const sinsp_connection* conn = table->find(tuple);
+	ASSERT_NE(conn, nullptr);
+	ASSERT_EQ(conn->m_client_pid, 1);
+	ASSERT_EQ(conn->m_client_fd, client_fd);
+	ASSERT_EQ(conn->m_server_pid, -1);
+
+	/* the peer end, accepted by the same process */
+	add_event_advance_ts(increasing_ts(), 1, PPME_SOCKET_ACCEPT_5_E, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SOCKET_ACCEPT_5_X, 5, server_fd, scap_const_sized_buffer{socktuple.data(), socktuple.size()}, 0, 0, 5);
+	conn = table->find(tuple);
+	ASSERT_NE(conn, nullptr);
+	ASSERT_EQ(conn->m_client_fd, client_fd);
+	ASSERT_EQ(conn->m_server_pid, 1);
+	ASSERT_EQ(conn->m_server_fd, server_fd);
+	ASSERT_EQ(table->size(), 1);
+
+	/* the connection goes away with its last end */
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, client_fd);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_X, 1, return_value);
+	conn = table->find(tuple);
+	ASSERT_NE(conn, nullptr);
+	ASSERT_EQ(conn->m_client_fd, -1);
+	ASSERT_EQ(conn->m_server_fd, server_fd);
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, server_fd);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_X, 1, return_value);
+	ASSERT_EQ(table->find(tuple), nullptr);
+	ASSERT_EQ(table->size(), 0);
+}
+
+TEST_F(sinsp_with_test_input, net_http_request_response)
+{
+	add_default_init_thread();
+	open_inspector();
+	m_inspector.require_protodecoder("http");
+	sinsp_evt* evt = NULL;
+	int64_t client_fd = 7;
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SOCKET_SOCKET_E, 3, PPM_AF_INET, SOCK_STREAM, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SOCKET_SOCKET_X, 1, client_fd);
+
+	sockaddr_in client = test_utils::fill_sockaddr_in(DEFAULT_CLIENT_PORT, DEFAULT_IPV4_CLIENT_STRING);
+	sockaddr_in server = test_utils::fill_sockaddr_in(DEFAULT_SERVER_PORT, DEFAULT_IPV4_SERVER_STRING);
+	std::vector<uint8_t> server_sockaddr = test_utils::pack_sockaddr(reinterpret_cast<sockaddr*>(&server));
+	add_event_advance_ts(increasing_ts(), 1, PPME_SOCKET_CONNECT_E, 2, client_fd, scap_const_sized_buffer{server_sockaddr.data(), server_sockaddr.size()});
+	std::vector<uint8_t> socktuple = test_utils::pack_socktuple(reinterpret_cast<sockaddr*>(&client), reinterpret_cast<sockaddr*>(&server));
+	add_event_advance_ts(increasing_ts(), 1, PPME_SOCKET_CONNECT_X, 3, return_value, scap_const_sized_buffer{socktuple.data(), socktuple.size()}, client_fd);
+
+	/* The request line spans two buffers */
+	std::string req1 = "GET /api/v1/us";
+	std::string req2 = "ers?id=3 HTTP/1.1\r\nHost: example.com\r\n\r\n";
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_WRITE_E, 2, client_fd, (uint32_t)req1.size());
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_WRITE_X, 2, (int64_t)req1.size(), scap_const_sized_buffer{req1.data(), req1.size()});
+	ASSERT_EQ(evt->get_fd_info()->get_l7proto(), L7_PROTO_HTTP);
+	ASSERT_EQ(get_field_as_string(evt, "http.method"), "GET");
+	ASSERT_EQ(get_field_as_string(evt, "http.is_msg_start"), "true");
+	ASSERT_FALSE(field_exists(evt, "http.status"));
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_WRITE_E, 2, client_fd, (uint32_t)req2.size());
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_WRITE_X, 2, (int64_t)req2.size(), scap_const_sized_buffer{req2.data(), req2.size()});
+	ASSERT_EQ(get_field_as_string(evt, "http.path"), "/api/v1/users?id=3");
+	ASSERT_EQ(get_field_as_string(evt, "http.is_msg_start"), "false");
+
+	/* The response was truncated by the snaplen, the next read starts a new message */
+	std::string resp = "HTTP/1.1 404 Not Found\r\nContent-Length: 1000\r\n";
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, client_fd, (uint32_t)4096);
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_X, 2, (int64_t)1100, scap_const_sized_buffer{resp.data(), resp.size()});
+	ASSERT_EQ(get_field_as_string(evt, "http.status"), "404");
+	ASSERT_EQ(get_field_as_string(evt, "http.path"), "/api/v1/users?id=3");
+	ASSERT_EQ(get_field_as_string(evt, "http.is_msg_start"), "true");
+
+	resp = "HTTP/1.1 200\r\nContent-Length: 0\r\n\r\n";
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, client_fd, (uint32_t)4096);
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_X, 2, (int64_t)resp.size(), scap_const_sized_buffer{resp.data(), resp.size()});
+	ASSERT_EQ(get_field_as_string(evt, "http.status"), "200");
+}
@@ -138,6 +138,39 @@ TEST_F(sinsp_with_test_input, bytebuf_empty_param)
 	ASSERT_EQ(param->m_len, 0);
 }
 
+/* Assert that the parameter layouts match the event table */
+TEST(events, param_layouts)
+{
+	sinsp inspector;
+	sinsp_evttables* tables = inspector.get_event_info_tables();
+	for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		const ppm_event_info& info = tables->m_event_info[j];
+		const sinsp_evt_param_layout& layout = tables->m_param_layouts[j];
+		ASSERT_EQ(layout.m_nparams, info.nparams);
+		ASSERT_EQ(layout.m_lensize, (info.flags & EF_LARGE_PAYLOAD) ? 4 : 2);
+		for(uint32_t k = 0; k < info.nparams; k++)
+		{
+			bool str = info.params[k].type == PT_CHARBUF ||
+				info.params[k].type == PT_FSPATH ||
+				info.params[k].type == PT_FSRELPATH;
+			ASSERT_EQ((layout.m_str_params >> k) & 1, str ? 1 : 0) << info.name << " " << k;
+		}
+	}
+}
+
+TEST_F(sinsp_with_test_input, param_as)
+{
+	add_default_init_thread();
+
+	open_inspector();
+
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_PREAD_E, 3, (int64_t)7, (uint32_t)64, (uint64_t)1234);
+	ASSERT_EQ(evt->get_param(0)->as<int64_t>(), 7);
+	ASSERT_EQ(evt->get_param(1)->as<uint32_t>(), 64);
+	ASSERT_EQ(evt->get_param(2)->as<uint64_t>(), 1234);
+}
+
 /* Assert that empty (`PT_SOCKADDR`, `PT_SOCKTUPLE`, `PT_FDLIST`) params are NOT converted to `<NA>` */
 TEST_F(sinsp_with_test_input, sockaddr_empty_param)
 {
@@ -395,4 +428,56 @@ TEST_F(sinsp_with_test_input, bitmaskparams)
 	const char *val_str = NULL;
 	evt->get_param_as_str(2, &val_str);
 	ASSERT_STREQ(val_str, "O_RDONLY|O_CLOEXEC");
-}
\ No newline at end of file
+}
+/* Check that the params can be accessed in any order and that accessing a
+ * missing one fails
+ */
+TEST_F(sinsp_with_test_input, params_any_order)
+{
+	add_default_init_thread();
+
+	open_inspector();
+	sinsp_evt* evt = NULL;
+	sinsp_evt_param* param = NULL;
+
+	int64_t fd = 3, dirfd = 0;
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPENAT2_X, 6, fd, dirfd, "/tmp/foo", PPM_O_RDONLY, 0, 0);
+	ASSERT_EQ(evt->get_num_params(), 6);
+
+	param = evt->get_param(2);
+	ASSERT_STREQ(param->m_val, "/tmp/foo");
+
+	param = evt->get_param(0);
+	ASSERT_EQ(*(int64_t *)param->m_val, fd);
+
+	param = evt->get_param(3);
+	ASSERT_EQ(*(uint32_t *)param->m_val, PPM_O_RDONLY);
+
+	ASSERT_THROW(evt->get_param(6), std::out_of_range);
+}
+
+/* Check that the numeric params rendered without get_param_as_str() keep
+ * the same string representation
+ */
+TEST_F(sinsp_with_test_input, numeric_argstr)
+{
+	add_default_init_thread();
+
+	open_inspector();
+	sinsp_evt* evt = NULL;
+
+	int64_t fd = 4;
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_PWRITE_E, 3, fd, (uint32_t)4096, (uint64_t)123456789012);
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.size"), "4096");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.pos"), "123456789012");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg[2]"), "123456789012");
+
+	/* a negative errno still resolves to the error name */
+	int64_t test_errno = -2;
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CHDIR_X, 2, test_errno, "/tmp");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.res"), "ENOENT");
+
+	test_errno = 0;
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CHDIR_X, 2, test_errno, "/tmp");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.res"), "0");
+}
@@ -554,3 +554,143 @@ TEST_F(sinsp_with_test_input, last_exec_ts)
 	// Check we execed after the last clone
 	ASSERT_GT(evt->get_thread_info()->m_lastexec_ts, evt->get_thread_info()->m_clone_ts);
 }
+
+TEST_F(sinsp_with_test_input, ancestors_follow_thread_table)
+{
+	add_default_init_thread();
+	add_thread(create_threadinfo(20, 20, 1, 20, 20, 20, "bash", "/bin/bash", "/bin/bash", increasing_ts(), 0, 0), {});
+	add_thread(create_threadinfo(30, 30, 20, 30, 30, 30, "test-exe", "/bin/test-exe", "/bin/test-exe", increasing_ts(), 0, 0), {});
+
+	open_inspector();
+	int64_t fd = 3;
+
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 30, PPME_SYSCALL_CLOSE_E, 1, fd);
+	ASSERT_EQ(get_field_as_string(evt, "proc.aname[1]"), "bash");
+	ASSERT_EQ(get_field_as_string(evt, "proc.aname[2]"), "init");
+	ASSERT_EQ(get_field_as_string(evt, "proc.apid[2]"), "1");
+	ASSERT_FALSE(field_exists(evt, "proc.aname[3]"));
+	ASSERT_TRUE(eval_filter(evt, "proc.aname = bash"));
+	ASSERT_TRUE(eval_filter(evt, "proc.apid = 1"));
+	ASSERT_TRUE(eval_filter(evt, "proc.aexepath = /sbin/init"));
+
+	// The cached ancestors must not survive the removal of the parent
+	m_inspector.m_thread_manager->remove_thread(20, true);
+	evt = add_event_advance_ts(increasing_ts(), 30, PPME_SYSCALL_CLOSE_E, 1, fd);
+	ASSERT_FALSE(field_exists(evt, "proc.aname[1]"));
+	ASSERT_FALSE(eval_filter(evt, "proc.aname = bash"));
+	ASSERT_FALSE(eval_filter(evt, "proc.apid = 1"));
+}
+
+TEST_F(sinsp_with_test_input, task_aggregate)
+{
+	add_default_init_thread();
+
+	open_inspector();
+	sinsp_evt* evt = NULL;
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+
+	// the aggregate comes while the thread is in the middle of a read
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_TASK_AGGREGATE_E, 2, (uint64_t)42, (uint64_t)7);
+
+	ASSERT_EQ(evt->get_type(), PPME_TASK_AGGREGATE_E);
+	ASSERT_EQ(get_field_as_string(evt, "evt.type"), "taskaggregate");
+	ASSERT_EQ(get_field_as_string(evt, "proc.name"), "init");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.switches"), "42");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.page_faults"), "7");
+
+	// the read still finds its enter event
+	std::string data = "hello";
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_X, 2, (int64_t)data.size(), scap_const_sized_buffer{data.data(), data.size()});
+	ASSERT_EQ(get_field_as_string(evt, "fd.name"), "/tmp/the_file");
+}
+
+TEST_F(sinsp_with_test_input, string_interning)
+{
+	add_default_init_thread();
+
+	open_inspector();
+	sinsp_evt* evt = NULL;
+
+	int64_t parent_tid = 1, child_tid = 20, other_child_tid = 21;
+	uint64_t fdlimit = 1024, pgft_maj = 0, pgft_min = 1;
+	uint64_t exe_ino = 242048, ctime = 1676262698000004577, mtime = 1676262698000004588;
+
+	scap_const_sized_buffer empty_bytebuf = {.buf = nullptr, .size = 0};
+	std::vector<std::string> cgroups = {"cpu=/user.slice", "memory=/user.slice"};
+	std::string cgroupsv = test_utils::to_null_delimited(cgroups);
+	std::vector<std::string> args = {"-c", "'echo hello'"};
+	std::string argsv = test_utils::to_null_delimited(args);
+
+	// the first event of the caller sends all its strings
+	add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_E, 0);
+	add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_X, 20, child_tid, "/sbin/init", empty_bytebuf, parent_tid, parent_tid, (int64_t)0, "", fdlimit, pgft_maj, pgft_min, 12088, 7208, 0, "init", scap_const_sized_buffer{cgroupsv.data(), cgroupsv.size()}, PPM_CL_CLONE_CHILD_CLEARTID | PPM_CL_STRINGS_INTERNED, 0, 0, parent_tid, parent_tid);
+
+	// the next one only the ones that changed, none here: the empty ones
+	// are taken from the caller
+	add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_E, 0);
+	evt = add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_X, 20, other_child_tid, (char*)nullptr, empty_bytebuf, parent_tid, parent_tid, (int64_t)0, "", fdlimit, pgft_maj, pgft_min, 12088, 7208, 0, (char*)nullptr, empty_bytebuf, PPM_CL_CLONE_CHILD_CLEARTID | PPM_CL_STRINGS_INTERNED, 0, 0, parent_tid, parent_tid);
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.exe"), "/sbin/init");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.comm"), "init");
+
+	sinsp_threadinfo* child = m_inspector.get_thread_ref(other_child_tid, false, true).get();
+	ASSERT_NE(child, nullptr);
+	ASSERT_EQ(child->m_exe, "/sbin/init");
+	ASSERT_EQ(child->m_comm, "init");
+	ASSERT_EQ(child->get_cgroups_param(), cgroupsv);
+	ASSERT_EQ(child->m_flags & PPM_CL_STRINGS_INTERNED, 0);
+
+	// the exec of the child keeps its cgroups
+	add_event_advance_ts(increasing_ts(), other_child_tid, PPME_SYSCALL_EXECVE_19_E, 1, "/bin/test-exe");
+	evt = add_event_advance_ts(increasing_ts(), other_child_tid, PPME_SYSCALL_EXECVE_19_X, 27, (int64_t)0, "/bin/test-exe", scap_const_sized_buffer{argsv.data(), argsv.size()}, other_child_tid, other_child_tid, parent_tid, "", fdlimit, pgft_maj, pgft_min, 29612, 4, 0, "test-exe", empty_bytebuf, empty_bytebuf, 34818, parent_tid, 1000, PPM_EXE_STRINGS_INTERNED, parent_tid, parent_tid, parent_tid, exe_ino, ctime, mtime, 0);
+	ASSERT_EQ(get_field_as_string(evt, "proc.exe"), "/bin/test-exe");
+	ASSERT_EQ(get_field_as_string(evt, "proc.name"), "test-exe");
+	ASSERT_EQ(get_field_as_string(evt, "thread.cgroup.memory"), "/user.slice");
+}
+
+TEST_F(sinsp_with_test_input, string_interning_lost_exit)
+{
+	add_default_init_thread();
+
+	open_inspector();
+	sinsp_evt* evt = NULL;
+
+	int64_t parent_tid = 1;
+	uint64_t fdlimit = 1024, pgft_maj = 0, pgft_min = 1;
+
+	scap_const_sized_buffer empty_bytebuf = {.buf = nullptr, .size = 0};
+	std::vector<std::string> cgroups = {"cpu=/user.slice", "memory=/user.slice"};
+	std::string cgroupsv = test_utils::to_null_delimited(cgroups);
+
+	add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_E, 0);
+	add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_X, 20, (int64_t)20, "/sbin/init", empty_bytebuf, parent_tid, parent_tid, (int64_t)0, "", fdlimit, pgft_maj, pgft_min, 12088, 7208, 0, "init", scap_const_sized_buffer{cgroupsv.data(), cgroupsv.size()}, PPM_CL_CLONE_CHILD_CLEARTID | PPM_CL_STRINGS_INTERNED, 0, 0, parent_tid, parent_tid);
+
+	// the exit of the next clone is lost: the probe may have taken the
+	// strings it carried as the new ones of the caller
+	add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_E, 0);
+
+	// so the ones left out afterwards are unknown
+	add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_E, 0);
+	evt = add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_X, 20, (int64_t)22, (char*)nullptr, empty_bytebuf, parent_tid, parent_tid, (int64_t)0, "", fdlimit, pgft_maj, pgft_min, 12088, 7208, 0, (char*)nullptr, empty_bytebuf, PPM_CL_CLONE_CHILD_CLEARTID | PPM_CL_STRINGS_INTERNED, 0, 0, parent_tid, parent_tid);
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.exe"), "<NA>");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.comm"), "<NA>");
+
+	sinsp_threadinfo* child = m_inspector.get_thread_ref(22, false, true).get();
+	ASSERT_NE(child, nullptr);
+	ASSERT_EQ(child->m_exe, "<NA>");
+	ASSERT_EQ(child->m_comm, "<NA>");
+	ASSERT_EQ(child->get_cgroups_param(), "");
+
+	// until the probe sends them again
+	add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_E, 0);
+	evt = add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_X, 20, (int64_t)23, "/sbin/init2", empty_bytebuf, parent_tid, parent_tid, (int64_t)0, "", fdlimit, pgft_maj, pgft_min, 12088, 7208, 0, (char*)nullptr, empty_bytebuf, PPM_CL_CLONE_CHILD_CLEARTID | PPM_CL_STRINGS_INTERNED, 0, 0, parent_tid, parent_tid);
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.exe"), "/sbin/init2");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.comm"), "<NA>");
+
+	add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_E, 0);
+	evt = add_event_advance_ts(increasing_ts(), parent_tid, PPME_SYSCALL_CLONE_20_X, 20, (int64_t)24, (char*)nullptr, empty_bytebuf, parent_tid, parent_tid, (int64_t)0, "", fdlimit, pgft_maj, pgft_min, 12088, 7208, 0, "init2", empty_bytebuf, PPM_CL_CLONE_CHILD_CLEARTID | PPM_CL_STRINGS_INTERNED, 0, 0, parent_tid, parent_tid);
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.exe"), "/sbin/init2");
+	ASSERT_EQ(get_field_as_string(evt, "evt.arg.comm"), "init2");
+}
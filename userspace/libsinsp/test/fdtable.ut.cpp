@@ -0,0 +1,125 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+#include <sinsp.h>
+#include <map>
+
+static std::map<int64_t, std::string> fdtable_contents(sinsp_fdtable& t)
+{
+	std::map<int64_t, std::string> res;
+	t.loop([&res](int64_t fd, sinsp_fdinfo_t& fdinfo)
+	{
+		res[fd] = fdinfo.m_name;
+		return true;
+	});
+	return res;
+}
+
+TEST(fdtable, add_find_erase)
+{
+	sinsp inspector;
+	sinsp_fdtable t(&inspector);
+	sinsp_fdinfo_t fdinfo;
+
+	// dense, sparse and negative fd numbers
+	std::vector<int64_t> fds = {0, 1, 2, 17, 1000, 1 << 20, -100};
+	for(auto fd : fds)
+	{
+		fdinfo.m_name = std::to_string(fd);
+		ASSERT_NE(t.add(fd, &fdinfo), nullptr);
+	}
+	ASSERT_EQ(t.size(), fds.size());
+
+	// pointers returned by find stay valid across insertions
+	sinsp_fdinfo_t* p = t.find(17);
+	ASSERT_NE(p, nullptr);
+	for(int64_t fd = 3; fd < 300; fd++)
+	{
+		if(t.find(fd) == nullptr)
+		{
+			t.add(fd, &fdinfo);
+		}
+	}
+	ASSERT_EQ(t.find(17), p);
+	ASSERT_EQ(p->m_name, "17");
+
+	for(auto fd : fds)
+	{
+		ASSERT_NE(t.find(fd), nullptr);
+		ASSERT_EQ(t.find(fd)->m_name, std::to_string(fd));
+	}
+	ASSERT_EQ(t.find(5000), nullptr);
+
+	// replacing an existing fd doesn't change the size
+	size_t size = t.size();
+	fdinfo.m_name = "replaced";
+	ASSERT_EQ(t.add(17, &fdinfo), p);
+	ASSERT_EQ(t.find(17)->m_name, "replaced");
+	ASSERT_EQ(t.size(), size);
+
+	t.erase(17);
+	t.erase(1 << 20);
+	ASSERT_EQ(t.find(17), nullptr);
+	ASSERT_EQ(t.find(1 << 20), nullptr);
+	ASSERT_EQ(t.size(), size - 2);
+
+	t.clear();
+	ASSERT_EQ(t.size(), 0);
+	ASSERT_EQ(fdtable_contents(t).size(), 0);
+}
+
+TEST(fdtable, loop_and_copy)
+{
+	sinsp inspector;
+	sinsp_fdtable t(&inspector);
+	sinsp_fdinfo_t fdinfo;
+
+	std::map<int64_t, std::string> expected;
+	for(int64_t fd : {3, 0, 64, 15, 16, 100000, -1})
+	{
+		fdinfo.m_name = "fd" + std::to_string(fd);
+		t.add(fd, &fdinfo);
+		expected[fd] = fdinfo.m_name;
+	}
+	ASSERT_EQ(fdtable_contents(t), expected);
+
+	// the visit stops when the callback returns false
+	uint32_t visited = 0;
+	ASSERT_FALSE(t.loop([&visited](int64_t fd, sinsp_fdinfo_t& fdinfo)
+	{
+		return ++visited < 2;
+	}));
+	ASSERT_EQ(visited, 2);
+
+	// copies are deep and don't share the lookup cache
+	ASSERT_NE(t.find(15), nullptr);
+	sinsp_fdtable copy(t);
+	ASSERT_EQ(copy.size(), t.size());
+	ASSERT_EQ(fdtable_contents(copy), expected);
+	ASSERT_NE(copy.find(15), t.find(15));
+
+	copy.erase(15);
+	ASSERT_NE(t.find(15), nullptr);
+
+	sinsp_fdtable assigned(&inspector);
+	fdinfo.m_name = "stale";
+	assigned.add(7, &fdinfo);
+	assigned = t;
+	ASSERT_EQ(assigned.find(7), nullptr);
+	ASSERT_EQ(fdtable_contents(assigned), expected);
+}
@@ -0,0 +1,55 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "filter_check_list.h"
+#include "filterchecks.h"
+#include "sinsp.h"
+
+static std::string check_class(sinsp& inspector, const std::string& name, bool exact = false)
+{
+	std::unique_ptr<sinsp_filter_check> chk(g_filterlist.new_filter_check_from_fldname(name, &inspector, exact));
+	return chk == nullptr ? "" : chk->get_fields()->m_name;
+}
+
+TEST(filter_check_list, lookup)
+{
+	sinsp inspector;
+
+	EXPECT_EQ(check_class(inspector, "proc.name"), "process");
+	EXPECT_EQ(check_class(inspector, "proc.aname[2]"), "process");
+	EXPECT_EQ(check_class(inspector, "fd.name"), "fd");
+	EXPECT_EQ(check_class(inspector, "fdlist.names"), "fdlist");
+	EXPECT_EQ(check_class(inspector, "evt.arg.fd"), "evt");
+	EXPECT_EQ(check_class(inspector, "container.mount.source[/tmp]"), "container");
+	EXPECT_EQ(check_class(inspector, "user.name"), "user");
+
+	// the longest field names win within a class, but the first class
+	// parsing the name wins
+	EXPECT_EQ(check_class(inspector, "proc.name foo %fd.name"), "process");
+	EXPECT_EQ(check_class(inspector, "proc.namex", true), "");
+
+	EXPECT_EQ(check_class(inspector, "not.a.field"), "");
+	EXPECT_EQ(check_class(inspector, ""), "");
+	EXPECT_EQ(check_class(inspector, "proc"), "");
+
+	// names handled in a custom way are still given to their class
+	EXPECT_THROW(check_class(inspector, "arg"), sinsp_exception);
+}
@@ -6,7 +6,8 @@
 using namespace std;
 
 // A mock filtercheck that returns always true or false depending on
-// the passed-in field name. The operation is ignored.
+// the passed-in field name. The operation is ignored, and the check
+// is expensive if its value is "expensive".
 class mock_compiler_filter_check: public gen_event_filter_check
 {
 public:
@@ -17,6 +18,22 @@ public:
 	}
 
 	inline bool compare(gen_event *evt) override
+	{
+		m_hits++;
+		bool res = evaluate();
+		if (res)
+		{
+			m_matched_true++;
+		}
+		return res;
+	}
+
+	inline double get_cost() override
+	{
+		return m_value == "expensive" ? 10 : 1;
+	}
+
+	inline bool evaluate()
 	{
 		if (m_name == "c.true")
 		{
@@ -78,25 +95,44 @@ public:
 
 // Compile a filter, pass a mock event to it, and
 // check that the result of the boolean evaluation is
-// the expected one
+// the expected one, both with the filtercheck tree and
+// with its flattened program, and with its checks reordered
 void test_filter_run(bool result, string filter_str)
 {
 	sinsp inspector;
 	std::shared_ptr<gen_event_filter_factory> factory;
 	factory.reset(new mock_compiler_filter_factory(&inspector));
-	sinsp_filter_compiler compiler(factory, filter_str);
-	try
+	for (int i = 0; i < 4; i++)
 	{
-		auto filter = compiler.compile();
-		if (filter->run(NULL) != result)
+		bool flatten = i & 1;
+		bool reorder = i & 2;
+		sinsp_filter_compiler compiler(factory, filter_str);
+		compiler.set_flatten(flatten);
+		compiler.set_reorder(reorder);
+		try
 		{
-			FAIL() << filter_str << " -> unexpected '" << (result ? "false" : "true") << "' result";
+			auto filter = compiler.compile();
+			ASSERT_EQ(filter->is_flattened(), flatten);
+			if (filter->run(NULL) != result)
+			{
+				FAIL() << filter_str << (flatten ? " (flattened)" : "")
+					<< (reorder ? " (reordered)" : "")
+					<< " -> unexpected '" << (result ? "false" : "true") << "' result";
+			}
+
+			// reordering with the profile of the first run
+			filter->reorder(true);
+			if (filter->run(NULL) != result)
+			{
+				FAIL() << filter_str << (flatten ? " (flattened)" : "")
+					<< " (profiled) -> unexpected '" << (result ? "false" : "true") << "' result";
+			}
+			delete filter;
+		}
+		catch(const sinsp_exception& e)
+		{
+			FAIL() << filter_str << " -> " << e.what();
 		}
-		delete filter;
-	}
-	catch(const sinsp_exception& e)
-	{
-		FAIL() << filter_str << " -> " << e.what();
 	}
 }
 
@@ -165,6 +201,71 @@ TEST(sinsp_filter_compiler, boolean_evaluation)
 	test_filter_run(false, "not ((c.false=1 or not (c.false=1 and not c.true=1)) and c.true=1)");
 }
 
+// The flattened program has one op per check, and
+// the boolean operators become forward jumps
+TEST(sinsp_filter_compiler, flattened_program)
+{
+	sinsp inspector;
+	std::shared_ptr<gen_event_filter_factory> factory(new mock_compiler_filter_factory(&inspector));
+	sinsp_filter_compiler compiler(factory, "c.false=1 or not (c.true=1 and c.false=1)");
+	compiler.set_flatten(true);
+	std::unique_ptr<sinsp_filter> filter(compiler.compile());
+
+	auto& ops = filter->get_program().ops();
+	ASSERT_EQ(ops.size(), 3);
+	ASSERT_EQ(ops[0].m_on_true, gen_event_filter_program::ACCEPT);
+	ASSERT_EQ(ops[0].m_on_false, 1);
+	ASSERT_EQ(ops[1].m_on_true, 2);
+	ASSERT_EQ(ops[1].m_on_false, gen_event_filter_program::ACCEPT);
+	ASSERT_EQ(ops[2].m_on_true, gen_event_filter_program::REJECT);
+	ASSERT_EQ(ops[2].m_on_false, gen_event_filter_program::ACCEPT);
+	ASSERT_TRUE(filter->run(NULL));
+
+	// modifying the tree falls back to its evaluation
+	filter->add_check(factory->new_filtercheck("c.false"));
+	ASSERT_FALSE(filter->is_flattened());
+}
+
+static const mock_compiler_filter_check* get_mock_check(gen_event_filter_expression* expr, size_t i)
+{
+	return dynamic_cast<const mock_compiler_filter_check*>(expr->m_checks[i]);
+}
+
+// Cheap checks are moved first, and the profile moves first the
+// checks that are more likely to end the evaluation
+TEST(sinsp_filter_compiler, reordered_checks)
+{
+	sinsp inspector;
+	std::shared_ptr<gen_event_filter_factory> factory(new mock_compiler_filter_factory(&inspector));
+	sinsp_filter_compiler compiler(factory, "c.true=expensive and not c.false=1 and c.false=1");
+	compiler.set_reorder(true);
+	std::unique_ptr<sinsp_filter> filter(compiler.compile());
+
+	auto expr = dynamic_cast<gen_event_filter_expression*>(filter->m_filter->m_checks[0]);
+	ASSERT_NE(expr, nullptr);
+	// "not" wraps its operand in an expression
+	auto not_expr = dynamic_cast<gen_event_filter_expression*>(expr->m_checks[0]);
+	ASSERT_NE(not_expr, nullptr);
+	ASSERT_EQ(get_mock_check(not_expr, 0)->m_value, "1");
+	ASSERT_EQ(expr->m_checks[0]->m_boolop, BO_NOT);
+	ASSERT_EQ(get_mock_check(expr, 1)->m_name, "c.false");
+	ASSERT_EQ(expr->m_checks[1]->m_boolop, BO_AND);
+	ASSERT_EQ(get_mock_check(expr, 2)->m_value, "expensive");
+	ASSERT_EQ(expr->m_checks[2]->m_boolop, BO_AND);
+
+	// the first check never ends the evaluation
+	ASSERT_FALSE(filter->run(NULL));
+	ASSERT_DOUBLE_EQ(expr->get_short_circuit_rate(), 1.0 / 3);
+
+	filter->reorder(true);
+	ASSERT_EQ(get_mock_check(expr, 0)->m_name, "c.false");
+	ASSERT_EQ(expr->m_checks[0]->m_boolop, BO_NONE);
+	ASSERT_EQ(get_mock_check(expr, 1)->m_value, "expensive");
+	ASSERT_EQ(expr->m_checks[2]->m_boolop, BO_ANDNOT);
+	ASSERT_FALSE(filter->run(NULL));
+	ASSERT_DOUBLE_EQ(expr->get_short_circuit_rate(), (1.0 / 3 + 2.0 / 3) / 2);
+}
+
 TEST(sinsp_filter_compiler, str_escape)
 {
 	test_filter_run(true, "c.singlequote = 'hello \\'quoted\\''");
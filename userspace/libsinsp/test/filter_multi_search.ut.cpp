@@ -0,0 +1,132 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include "sinsp_with_test_input.h"
+#include "multi_search.h"
+
+TEST(multi_search, match)
+{
+	multi_search s;
+	ASSERT_FALSE(s.match("anything"));
+
+	s.add_pattern("he");
+	s.add_pattern("she");
+	s.add_pattern("hers");
+	s.add_pattern("/tmp", true);
+	s.build();
+	ASSERT_EQ(s.num_patterns(), 4);
+	ASSERT_TRUE(s.match("ushers"));
+	ASSERT_TRUE(s.match("ahe"));
+	ASSERT_TRUE(s.match("/tmp/x"));
+	ASSERT_TRUE(s.match("/tmp"));
+	ASSERT_FALSE(s.match("/var/tmp/x"));
+	ASSERT_FALSE(s.match("/tm"));
+	ASSERT_FALSE(s.match("HERS"));
+	ASSERT_FALSE(s.match(""));
+
+	// failure links must not make anchored patterns match elsewhere
+	multi_search anchored;
+	anchored.add_pattern("aab", true);
+	anchored.add_pattern("ab", true);
+	anchored.build();
+	ASSERT_TRUE(anchored.match("aab"));
+	ASSERT_TRUE(anchored.match("abc"));
+	ASSERT_FALSE(anchored.match("aaab"));
+	ASSERT_FALSE(anchored.match("cab"));
+
+	multi_search empty;
+	empty.add_pattern("x");
+	empty.add_pattern("");
+	empty.build();
+	ASSERT_TRUE(empty.match(""));
+}
+
+TEST(multi_search, case_insensitive)
+{
+	multi_search s(true);
+	s.add_pattern("NC -l");
+	s.add_pattern("bash");
+	s.build();
+	ASSERT_TRUE(s.case_insensitive());
+	ASSERT_TRUE(s.match("/usr/bin/nc -L 1234"));
+	ASSERT_TRUE(s.match("/BIN/BASH"));
+	ASSERT_FALSE(s.match("/bin/sh"));
+}
+
+static std::unique_ptr<sinsp_filter> compile(sinsp* inspector, const std::string& filter)
+{
+	sinsp_filter_compiler compiler(inspector, filter);
+	return std::unique_ptr<sinsp_filter>(compiler.compile());
+}
+
+// The number of leaf checks of the filter
+static size_t num_checks(gen_event_filter_check* chk)
+{
+	auto expr = dynamic_cast<gen_event_filter_expression*>(chk);
+	if(expr == nullptr)
+	{
+		return 1;
+	}
+
+	size_t n = 0;
+	for(auto c : expr->m_checks)
+	{
+		n += num_checks(c);
+	}
+	return n;
+}
+
+TEST_F(sinsp_with_test_input, filter_search_patterns)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/The_File", PPM_O_RDWR, 0);
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/The_File", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	ASSERT_EQ(get_field_as_string(evt, "fd.name"), "/tmp/The_File");
+
+	struct
+	{
+		std::string filter;
+		size_t checks;
+		bool result;
+	} cases[] = {
+		{"fd.name contains nope or fd.name contains _File", 1, true},
+		{"fd.name contains nope or fd.name contains _file", 1, false},
+		{"fd.name startswith /etc or fd.name startswith /tmp or fd.name contains nope", 1, true},
+		{"fd.name startswith The or fd.name contains nope", 1, false},
+		{"fd.name icontains nope or fd.name icontains THE_file", 1, true},
+		// contains and icontains are searched separately
+		{"fd.name contains nope or fd.name icontains the_file", 2, true},
+		// checks on other fields or with other operators are left as they are
+		{"fd.name contains nope or proc.name contains ini or fd.name endswith nope", 3, true},
+		{"fd.name contains nope or not fd.name contains nope", 2, true},
+		{"evt.type=open and (fd.name contains nope or fd.name contains The)", 2, true},
+		{"not (fd.name contains nope or fd.name contains The)", 1, false},
+		// ports are numbers, they can't be searched as strings
+		{"fd.sport contains 1 or fd.sport contains 2", 2, false},
+	};
+
+	for(const auto& c : cases)
+	{
+		auto filter = compile(&m_inspector, c.filter);
+		EXPECT_EQ(num_checks(filter->m_filter), c.checks) << c.filter;
+		EXPECT_EQ(filter->run(evt), c.result) << c.filter;
+	}
+}
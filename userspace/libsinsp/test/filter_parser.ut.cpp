@@ -744,3 +744,38 @@ TEST(parser, position_complex_multiline)
 	EXPECT_STREQ(pv.as_string().c_str(), "or0 1 1and2 2 2binary2 2 2value16 2 16binary31 3 10list43 3 22not68 4 8unary72 4 12and95 5 8binary95 5 8value105 5 18binary123 6 12value132 6 21");
 }
 
+
+static void test_check_tokens(const string& in, const string& field, const string& arg, const string& op, const string& value)
+{
+	parser parser(in);
+	auto res = parser.parse();
+	auto check = dynamic_cast<binary_check_expr*>(res.get());
+	ASSERT_NE(check, nullptr) << in;
+	EXPECT_EQ(check->field, field) << in;
+	EXPECT_EQ(check->arg, arg) << in;
+	EXPECT_EQ(check->op, op) << in;
+	auto val = dynamic_cast<value_expr*>(check->value.get());
+	ASSERT_NE(val, nullptr) << in;
+	EXPECT_EQ(val->value, value) << in;
+}
+
+TEST(parser, token_boundaries)
+{
+	test_check_tokens("a.b_1.c2 = x", "a.b_1.c2", "", "=", "x");
+	test_check_tokens("a.b[x/y.z]=v", "a.b", "x/y.z", "=", "v");
+	test_check_tokens("a.b[\"]\"] = v", "a.b", "]", "=", "v");
+	test_check_tokens("a.b < -1.5e+3", "a.b", "", "<", "-1.5e+3");
+	test_check_tokens("a.b >= 12.", "a.b", "", ">=", "12.");
+	test_check_tokens("a.b > 0x1F", "a.b", "", ">", "0x1F");
+	test_check_tokens("a.b = \xc3\xa9t\xc3\xa9", "a.b", "", "=", "\xc3\xa9t\xc3\xa9");
+
+	// the exponent needs its sign, and a field name a component after
+	// each dot
+	test_reject("a.b < 1e3");
+	test_reject("a.b <= 0x");
+	test_reject("a.b contains x=y");
+	test_reject("a.b. = 1");
+	test_reject("a.1b = 1");
+	test_accept("nota.b exists");
+	test_accept("not\ta.b exists");
+}
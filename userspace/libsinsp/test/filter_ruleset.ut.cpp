@@ -0,0 +1,333 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include "sinsp_with_test_input.h"
+#include "filter_ruleset.h"
+
+static std::unique_ptr<sinsp_filter> compile(sinsp* inspector, const std::string& filter)
+{
+	sinsp_filter_compiler compiler(inspector, filter);
+	return std::unique_ptr<sinsp_filter>(compiler.compile());
+}
+
+TEST(sinsp_filter_ruleset, event_codes)
+{
+	sinsp inspector;
+	auto open_filter = compile(&inspector, "evt.type=open");
+	ASSERT_EQ(open_filter->get_event_codes(), libsinsp::events::set<ppm_event_code>({PPME_SYSCALL_OPEN_E, PPME_SYSCALL_OPEN_X}));
+	ASSERT_EQ(open_filter->get_sc_codes(), libsinsp::events::set<ppm_sc_code>({PPM_SC_OPEN}));
+
+	sinsp_filter_ruleset ruleset;
+	ASSERT_TRUE(ruleset.get_event_codes().empty());
+	ruleset.add("open", std::move(open_filter));
+	ruleset.add("close", compile(&inspector, "evt.type=close and evt.dir=<"));
+	ASSERT_EQ(ruleset.size(), 2);
+	ASSERT_EQ(ruleset.get_name(1), "close");
+	ASSERT_EQ(ruleset.get_event_codes(), libsinsp::events::set<ppm_event_code>({PPME_SYSCALL_OPEN_E, PPME_SYSCALL_OPEN_X, PPME_SYSCALL_CLOSE_E, PPME_SYSCALL_CLOSE_X}));
+	ASSERT_EQ(ruleset.get_sc_codes(), libsinsp::events::set<ppm_sc_code>({PPM_SC_OPEN, PPM_SC_CLOSE}));
+
+	// a filter without any event type constraint can match every event
+	ruleset.add("any", compile(&inspector, "proc.name=init"));
+	ASSERT_EQ(ruleset.get_event_codes(), libsinsp::events::all_event_set());
+}
+
+TEST_F(sinsp_with_test_input, filter_ruleset_dispatch)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	sinsp_filter_ruleset ruleset;
+	size_t open_idx = ruleset.add("open", compile(&m_inspector, "evt.type=open and evt.dir=<"));
+	size_t close_idx = ruleset.add("close", compile(&m_inspector, "evt.type=close and evt.dir=<"));
+	size_t file_idx = ruleset.add("file", compile(&m_inspector, "evt.type in (open, close) and fd.name=/tmp/the_file"));
+	size_t any_idx = ruleset.add("any", compile(&m_inspector, "proc.name=init"));
+
+	std::vector<size_t> matches;
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ASSERT_EQ(matches, std::vector<size_t>({any_idx}));
+
+	matches.clear();
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ASSERT_EQ(matches, std::vector<size_t>({open_idx, file_idx, any_idx}));
+
+	matches.clear();
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, (int64_t)3);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ASSERT_EQ(matches, std::vector<size_t>({file_idx, any_idx}));
+
+	matches.clear();
+	// the fd is removed only after the close exit event is parsed
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ASSERT_EQ(matches, std::vector<size_t>({close_idx, file_idx, any_idx}));
+
+	matches.clear();
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ASSERT_EQ(matches, std::vector<size_t>({close_idx, any_idx}));
+
+	// an unknown thread only matches the rules without process constraints
+	matches.clear();
+	evt = add_event_advance_ts(increasing_ts(), 2, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ASSERT_EQ(matches, std::vector<size_t>({close_idx}));
+}
+
+TEST_F(sinsp_with_test_input, filter_ruleset_shared_extraction_cache)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	m_inspector.set_filter_extraction_cache(true);
+	auto cache = m_inspector.get_filter_extraction_cache();
+	ASSERT_NE(cache, nullptr);
+
+	sinsp_filter_ruleset ruleset;
+	ruleset.add("eq", compile(&m_inspector, "fd.name=/tmp/the_file"));
+	ruleset.add("contains", compile(&m_inspector, "fd.name contains the_file"));
+	ruleset.add("proc", compile(&m_inspector, "proc.name=init and fd.name startswith /tmp"));
+	ASSERT_EQ(cache->size(), 2);
+
+	std::vector<size_t> matches;
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ASSERT_EQ(matches, std::vector<size_t>({0, 1, 2}));
+
+	// fd.name is extracted by the first rule only
+	ASSERT_EQ(cache->m_metrics.m_num_extract, 4);
+	ASSERT_EQ(cache->m_metrics.m_num_extract_cache, 2);
+	ASSERT_DOUBLE_EQ(cache->m_metrics.extract_hit_rate(), 0.5);
+
+	// the cached values don't outlive the filter that extracted them
+	auto other = compile(&m_inspector, "fd.name=/tmp/the_file");
+	ASSERT_TRUE(other->run(evt));
+	other.reset();
+	ASSERT_TRUE(ruleset.run(evt, matches));
+
+	// filters compiled after disabling the cache don't use it
+	m_inspector.set_filter_extraction_cache(false);
+	ASSERT_EQ(m_inspector.get_filter_extraction_cache(), nullptr);
+	uint64_t num_extract = cache->m_metrics.m_num_extract;
+	ASSERT_FALSE(compile(&m_inspector, "fd.name=/tmp/other_file")->run(evt));
+	ASSERT_EQ(cache->m_metrics.m_num_extract, num_extract);
+}
+
+TEST_F(sinsp_with_test_input, filter_ruleset_shared_eval_cache)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	m_inspector.set_filter_eval_cache(true);
+	auto cache = m_inspector.get_filter_eval_cache();
+	ASSERT_NE(cache, nullptr);
+
+	sinsp_filter_ruleset ruleset;
+	ruleset.add("a", compile(&m_inspector, "(evt.type=open and proc.name=init) and fd.name=/tmp/the_file"));
+	ruleset.add("b", compile(&m_inspector, "(evt.type=open and proc.name=init) and not fd.name contains other"));
+	ruleset.add("c", compile(&m_inspector, "evt.type=open and proc.name=bash"));
+	// each filter, the shared subexpression, its two checks, fd.name=/tmp/the_file,
+	// fd.name contains other, and proc.name=bash
+	ASSERT_EQ(cache->size(), 9);
+
+	std::vector<size_t> matches;
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ASSERT_EQ(matches, std::vector<size_t>({0, 1}));
+
+	// the shared subexpression is evaluated by the first filter only,
+	// and evt.type=open is reused by the third one
+	ASSERT_EQ(cache->m_metrics.m_num_eval, 11);
+	ASSERT_EQ(cache->m_metrics.m_num_eval_cache, 2);
+
+	// the shared results are the same as the ones of a filter without the cache
+	m_inspector.set_filter_eval_cache(false);
+	ASSERT_EQ(m_inspector.get_filter_eval_cache(), nullptr);
+	ASSERT_TRUE(compile(&m_inspector, "(evt.type=open and proc.name=init) and not fd.name contains other")->run(evt));
+	ASSERT_EQ(cache->m_metrics.m_num_eval, 11);
+
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)4, "/tmp/other", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	ASSERT_FALSE(ruleset.run(evt, matches));
+}
+
+TEST_F(sinsp_with_test_input, filter_ruleset_shared_inspectors)
+{
+	add_default_init_thread();
+	open_inspector();
+	m_inspector.set_filter_eval_cache(true);
+	m_inspector.set_filter_extraction_cache(true);
+
+	// the filters are compiled for another inspector, which doesn't know
+	// the thread of the events
+	sinsp other;
+	other.set_filter_eval_cache(true);
+	other.set_filter_extraction_cache(true);
+	auto other_cache = other.get_filter_eval_cache();
+
+	sinsp_filter_ruleset ruleset;
+	ruleset.add("a", compile(&other, "evt.type=open and proc.name=init"));
+	ruleset.add("b", compile(&other, "evt.type=open and proc.name=init and fd.name=/tmp/the_file"));
+	size_t num_entries = other_cache->size();
+
+	std::vector<size_t> matches;
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ASSERT_EQ(matches, std::vector<size_t>({0, 1}));
+
+	// the filters now share the subexpressions through the cache of the
+	// inspector of the event
+	auto cache = m_inspector.get_filter_eval_cache();
+	ASSERT_EQ(cache->size(), num_entries);
+	ASSERT_EQ(cache->m_metrics.m_num_eval_cache, 2);
+	ASSERT_EQ(other_cache->m_metrics.m_num_eval, 0);
+	ASSERT_GT(m_inspector.get_filter_extraction_cache()->size(), 0);
+
+	// moving the filters back and forth doesn't carry over any result
+	ruleset.set_inspector(&other);
+	matches.clear();
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)4, "/tmp/other", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ASSERT_EQ(matches, std::vector<size_t>({0}));
+	ASSERT_EQ(other_cache->m_metrics.m_num_eval, 0);
+
+	// without caches, the results are the same
+	m_inspector.set_filter_eval_cache(false);
+	m_inspector.set_filter_extraction_cache(false);
+	ruleset.set_inspector(&other);
+	matches.clear();
+	evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)5, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ASSERT_EQ(matches, std::vector<size_t>({0, 1}));
+	ASSERT_EQ(cache->m_metrics.m_num_eval_cache, 4);
+}
+
+TEST_F(sinsp_with_test_input, filter_ruleset_profiling)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	sinsp_filter_ruleset ruleset;
+	ruleset.add("open", compile(&m_inspector, "evt.type=open and fd.name=/tmp/the_file"));
+	ruleset.set_profiling(2);
+	ruleset.add("init", compile(&m_inspector, "proc.name=init"));
+
+	std::vector<size_t> matches;
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ASSERT_TRUE(ruleset.run(evt, matches));
+
+	uint32_t nstats = 0;
+	const scap_stats_v2* stats = ruleset.get_profile_stats(&nstats);
+	std::map<std::string, uint64_t> values;
+	for(uint32_t i = 0; i < nstats; i++)
+	{
+		ASSERT_EQ(stats[i].flags, PPM_SCAP_STATS_RULES_PROFILE);
+		ASSERT_EQ(stats[i].type, STATS_VALUE_TYPE_U64);
+		values[stats[i].name] = stats[i].value.u64;
+	}
+	// 4 metrics for each rule, 5 for each of their checks
+	ASSERT_EQ(nstats, 4 * 2 + 5 * 3);
+
+	ASSERT_EQ(values["rules.open.evaluated"], 2);
+	ASSERT_EQ(values["rules.open.matched"], 2);
+	ASSERT_EQ(values["rules.open.sampled"], 1);
+	ASSERT_EQ(values["rules.init.evaluated"], 2);
+	ASSERT_EQ(values["rules.init.sampled"], 1);
+	ASSERT_EQ(values["rules.open.checks.0.evt.type.evaluated"], 2);
+	ASSERT_EQ(values["rules.open.checks.1.fd.name.matched"], 2);
+	ASSERT_EQ(values["rules.open.checks.1.fd.name.sampled"], 1);
+	ASSERT_EQ(values["rules.init.checks.0.proc.name.sampled"], 1);
+
+	// the values collected so far are kept
+	ruleset.set_profiling(0);
+	ASSERT_TRUE(ruleset.run(evt, matches));
+	ruleset.get_profile_stats(&nstats);
+	ASSERT_EQ(nstats, 4 * 2 + 5 * 3);
+	ASSERT_EQ(ruleset.get_profile_stats(&nstats)[0].value.u64, 2);
+}
+
+TEST_F(sinsp_with_test_input, filter_ruleset_parallel_compile)
+{
+	add_default_init_thread();
+	open_inspector();
+	m_inspector.set_filter_eval_cache(true);
+
+	std::vector<std::string> filters;
+	for(int i = 0; i < 64; i++)
+	{
+		switch(i % 4)
+		{
+		case 0:
+			filters.push_back("evt.type=open and fd.name=/tmp/file_" + std::to_string(i));
+			break;
+		case 1:
+			filters.push_back("evt.type=open and proc.name=init");
+			break;
+		case 2:
+			filters.push_back("evt.type=open and (fd.name=");
+			break;
+		default:
+			filters.push_back("evt.type=open and not_a_field.name=" + std::to_string(i));
+			break;
+		}
+	}
+
+	std::shared_ptr<gen_event_filter_factory> factory(new sinsp_filter_factory(&m_inspector));
+	sinsp_filter_ruleset_compiler compiler(factory, 4);
+	auto results = compiler.compile(filters);
+	ASSERT_EQ(results.size(), filters.size());
+
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/file_8", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	for(size_t i = 0; i < filters.size(); i++)
+	{
+		// the results are the ones of the filters compiled one at a time
+		std::string error;
+		libsinsp::filter::ast::pos_info pos;
+		std::unique_ptr<sinsp_filter> expected;
+		sinsp_filter_compiler single(factory, filters[i]);
+		try
+		{
+			expected.reset(single.compile());
+		}
+		catch(const sinsp_exception& e)
+		{
+			error = e.what();
+			pos = single.get_pos();
+		}
+
+		ASSERT_EQ(results[i].m_error, error) << filters[i];
+		if(expected == nullptr)
+		{
+			ASSERT_EQ(results[i].m_filter, nullptr);
+			if(i % 4 == 3)
+			{
+				ASSERT_EQ(results[i].m_pos, pos);
+			}
+			continue;
+		}
+
+		ASSERT_NE(results[i].m_filter, nullptr);
+		ASSERT_EQ(results[i].m_filter->run(evt), expected->run(evt)) << filters[i];
+		ASSERT_EQ(results[i].m_filter->run(evt), i == 8 || i % 4 == 1) << filters[i];
+	}
+
+	// parse errors report where the parser stopped
+	ASSERT_GE(results[2].m_pos.idx, std::string("evt.type=open and (").size());
+}
@@ -0,0 +1,70 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include "sinsp_with_test_input.h"
+#include "glob_matcher.h"
+#include "utils.h"
+
+TEST(glob_matcher, same_as_glob_match)
+{
+	const char* patterns[] = {
+		"", "*", "**", "/proc/*/mem", "/proc/**/mem", "*/mem", "/proc/*", "*.so*",
+		"/etc/shadow", "a*b*c", "a*ab", "*aa*aa*", "\\*literal", "a\\", "/tmp/?",
+		"/tmp/[ab]*", "/tmp/[!ab]*",
+	};
+	const char* strings[] = {
+		"", "/proc/1/mem", "/proc/1/2/mem", "/proc/mem", "/proc//mem", "/proc/1/memx",
+		"/usr/lib/libc.so.6", "/etc/shadow", "/etc/shadowx", "abc", "aXbYc", "acb", "aab",
+		"ab", "aaaa", "aaaaa", "*literal", "xliteral", "a\\", "/tmp/a", "/tmp/c", "/tmp/ab",
+	};
+
+	for(auto p : patterns)
+	{
+		glob_matcher m(p);
+		for(auto s : strings)
+		{
+			ASSERT_EQ(m.match(s), sinsp_utils::glob_match(p, s)) << "pattern: " << p << " string: " << s;
+		}
+	}
+}
+
+TEST(glob_matcher, compiled)
+{
+#ifndef _WIN32
+	ASSERT_TRUE(glob_matcher("/proc/*/mem").is_compiled());
+	ASSERT_TRUE(glob_matcher("\\*literal").is_compiled());
+#endif
+	ASSERT_FALSE(glob_matcher("/tmp/?").is_compiled());
+	ASSERT_FALSE(glob_matcher("/tmp/[ab]").is_compiled());
+	ASSERT_FALSE(glob_matcher("a\\").is_compiled());
+}
+
+TEST_F(sinsp_with_test_input, filter_glob)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/proc/1/mem", PPM_O_RDWR, 0);
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/proc/1/mem", PPM_O_RDWR, 0, 5, (uint64_t)123);
+
+	ASSERT_TRUE(eval_filter(evt, "fd.name glob /proc/*/mem"));
+	ASSERT_TRUE(eval_filter(evt, "fd.name glob '/proc/?/mem'"));
+	ASSERT_FALSE(eval_filter(evt, "fd.name glob /proc/*/maps"));
+	ASSERT_FALSE(eval_filter(evt, "fd.name glob /proc/*/mem/*"));
+}
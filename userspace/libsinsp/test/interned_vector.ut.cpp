@@ -0,0 +1,159 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+#include <interned_vector.h>
+
+#include "sinsp_with_test_input.h"
+
+using namespace libsinsp;
+
+TEST(interned_vector, pool)
+{
+	interned_pool<std::string> pool;
+
+	auto a = pool.intern({"PATH=/usr/bin:/bin", "HOME=/home/a-user-with-a-long-name"});
+	auto b = pool.intern({"PATH=/usr/bin:/bin", "HOME=/home/a-user-with-a-long-name"});
+	auto c = pool.intern({"PATH=/usr/bin:/bin"});
+	ASSERT_TRUE(a.shares_storage_with(b));
+	ASSERT_FALSE(a.shares_storage_with(c));
+	ASSERT_EQ(a, b);
+	ASSERT_NE(a, c);
+	ASSERT_EQ(a.size(), 2);
+	ASSERT_EQ(a[1], "HOME=/home/a-user-with-a-long-name");
+	ASSERT_TRUE(a == std::vector<std::string>({"PATH=/usr/bin:/bin", "HOME=/home/a-user-with-a-long-name"}));
+
+	auto stats = pool.get_stats();
+	ASSERT_EQ(stats.m_values, 2);
+	ASSERT_EQ(stats.m_refs, 3);
+	ASSERT_EQ(stats.m_hits, 1);
+	ASSERT_EQ(stats.m_misses, 2);
+	ASSERT_GT(stats.m_unshared_bytes, stats.m_bytes);
+
+	// empty vectors are never stored
+	auto e = pool.intern({});
+	ASSERT_TRUE(e.empty());
+	ASSERT_EQ(pool.get_stats().m_values, 2);
+
+	// values are freed when nobody uses them anymore
+	a = c;
+	b = e;
+	stats = pool.get_stats();
+	ASSERT_EQ(stats.m_values, 1);
+	ASSERT_EQ(stats.m_refs, 2);
+
+	pool.collect();
+	auto d = pool.intern({"PATH=/usr/bin:/bin", "HOME=/home/a-user-with-a-long-name"});
+	ASSERT_EQ(pool.get_stats().m_misses, 3);
+}
+
+TEST(interned_vector, lazy_strvec)
+{
+	interned_pool<std::string> pool;
+	const char args[] = "-c\0\0echo hello";
+
+	lazy_strvec a;
+	ASSERT_TRUE(a.empty());
+	a.assign(args, sizeof(args) - 1, &pool);
+	ASSERT_TRUE(a.is_lazy());
+	ASSERT_FALSE(a.empty());
+	ASSERT_EQ(a.size(), 3);
+
+	// joining doesn't split the strings
+	std::string joined = "sh ";
+	a.join(joined, ' ');
+	ASSERT_EQ(joined, "sh -c  echo hello");
+	ASSERT_TRUE(a.is_lazy());
+
+	// copies share the buffer, and compare without splitting it either
+	lazy_strvec b = a;
+	ASSERT_TRUE(a.shares_storage_with(b));
+	lazy_strvec c;
+	c.assign(args, sizeof(args), &pool);
+	ASSERT_EQ(a, c);
+	ASSERT_TRUE(a.is_lazy());
+
+	ASSERT_EQ(a[2], "echo hello");
+	ASSERT_FALSE(a.is_lazy());
+	ASSERT_TRUE(a == std::vector<std::string>({"-c", "", "echo hello"}));
+	ASSERT_EQ(a.size(), 3);
+	ASSERT_EQ(pool.get_stats().m_misses, 1);
+
+	// the copies are interned in the same pool
+	ASSERT_TRUE(a.shares_storage_with(c));
+	ASSERT_EQ(pool.get_stats().m_hits, 1);
+
+	joined.clear();
+	c.join(joined, ',');
+	ASSERT_EQ(joined, "-c,,echo hello");
+
+	c.assign(NULL, 0, &pool);
+	ASSERT_TRUE(c.empty());
+	ASSERT_EQ(c.size(), 0);
+	ASSERT_NE(a, c);
+}
+
+TEST_F(sinsp_with_test_input, interned_thread_vectors)
+{
+	std::vector<std::string> args = {"--config", "/etc/service/config.yaml"};
+	std::vector<std::string> env = {"PATH=/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin", "HOME=/root"};
+	std::vector<std::string> cgroups = {"cpuset=/kubepods/besteffort/pod1234/abcdef0123456789",
+					    "memory=/kubepods/besteffort/pod1234/abcdef0123456789"};
+
+	add_default_init_thread();
+	// two threads of a process and another instance of the same process
+	add_thread(create_threadinfo(100, 100, 1, 100, 100, 100, "service", "/usr/bin/service", "/usr/bin/service",
+				     increasing_ts(), 0, 0, args, 0, env, "/", 0x100000, 0, true, 0x1ffffffffff, 0, 0x1ffffffffff,
+				     10000, 100, 0, 222, 22, cgroups), {});
+	add_thread(create_threadinfo(101, 100, 1, 100, 101, 100, "service", "/usr/bin/service", "/usr/bin/service",
+				     increasing_ts(), 0, 0, args, 0, env, "/", 0x100000, 0, true, 0x1ffffffffff, 0, 0x1ffffffffff,
+				     10000, 100, 0, 222, 22, cgroups), {});
+	add_thread(create_threadinfo(200, 200, 1, 200, 200, 200, "service", "/usr/bin/service", "/usr/bin/service",
+				     increasing_ts(), 0, 0, args, 0, env, "/", 0x100000, 0, true, 0x1ffffffffff, 0, 0x1ffffffffff,
+				     10000, 100, 0, 222, 22, cgroups), {});
+	open_inspector();
+
+	auto t100 = m_inspector.get_thread_ref(100, false, true);
+	auto t101 = m_inspector.get_thread_ref(101, false, true);
+	auto t200 = m_inspector.get_thread_ref(200, false, true);
+	ASSERT_NE(t100, nullptr);
+	ASSERT_NE(t101, nullptr);
+	ASSERT_NE(t200, nullptr);
+
+	// create_threadinfo() ends the args with an empty one
+	std::vector<std::string> expected_args = args;
+	expected_args.push_back("");
+	ASSERT_EQ(t100->m_args, expected_args);
+	ASSERT_EQ(t100->get_env(), env);
+	ASSERT_EQ(t100->cgroups().size(), 2);
+	ASSERT_EQ(t100->cgroups()[1].first, "memory");
+
+	ASSERT_TRUE(t100->m_args.shares_storage_with(t101->m_args));
+	ASSERT_TRUE(t100->m_args.shares_storage_with(t200->m_args));
+	ASSERT_TRUE(t100->m_env.shares_storage_with(t200->m_env));
+	// the cgroups parameter is shared as is, and parsed when needed
+	ASSERT_EQ(&t100->get_cgroups_param(), &t101->get_cgroups_param());
+	ASSERT_EQ(&t100->get_cgroups_param(), &t200->get_cgroups_param());
+	ASSERT_EQ(t101->cgroups().size(), 2);
+	ASSERT_EQ(t200->cgroups().size(), 2);
+	ASSERT_TRUE(t100->m_cgroups.shares_storage_with(t101->m_cgroups));
+	ASSERT_TRUE(t100->m_cgroups.shares_storage_with(t200->m_cgroups));
+
+	auto stats = m_inspector.m_thread_manager->get_cgroups_pool().get_stats();
+	ASSERT_EQ(stats.m_values, 1);
+	ASSERT_EQ(stats.m_refs, 3);
+}
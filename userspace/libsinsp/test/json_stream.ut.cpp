@@ -0,0 +1,249 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include <gtest/gtest.h>
+
+#include "json_stream.h"
+#include "container.h"
+
+using namespace libsinsp;
+
+TEST(json_stream, reader)
+{
+	std::string doc = R"( {"s": "a\"b\\c\n\u00e9\ud83d\ude00", "i": -42, "u": 18446744073709551615,
+		"f": 1.5, "b": true, "n": null, "a": [1, "x", {"k": [[]]}, false], "o": {"x": {}}} )";
+	json::reader r(doc.data(), doc.size());
+
+	std::string key, s;
+	int64_t i;
+	uint64_t u;
+	bool b;
+
+	ASSERT_TRUE(r.begin_object());
+	ASSERT_TRUE(r.next_member(key));
+	EXPECT_EQ(key, "s");
+	ASSERT_TRUE(r.read_string(s));
+	EXPECT_EQ(s, "a\"b\\c\n\xc3\xa9\xf0\x9f\x98\x80");
+
+	ASSERT_TRUE(r.next_member(key));
+	ASSERT_TRUE(r.read_int64(i));
+	EXPECT_EQ(i, -42);
+
+	ASSERT_TRUE(r.next_member(key));
+	EXPECT_EQ(r.peek(), json::reader::T_NUMBER);
+	ASSERT_TRUE(r.read_uint64(u));
+	EXPECT_EQ(u, UINT64_MAX);
+
+	// not an integer
+	ASSERT_TRUE(r.next_member(key));
+	EXPECT_FALSE(r.read_int64(i));
+
+	ASSERT_TRUE(r.next_member(key));
+	ASSERT_TRUE(r.read_bool(b));
+	EXPECT_TRUE(b);
+
+	// a value of another type is skipped
+	ASSERT_TRUE(r.next_member(key));
+	EXPECT_FALSE(r.read_string(s));
+
+	ASSERT_TRUE(r.next_member(key));
+	EXPECT_EQ(key, "a");
+	ASSERT_TRUE(r.begin_array());
+	ASSERT_TRUE(r.next_element());
+	ASSERT_TRUE(r.read_uint64(u));
+	EXPECT_EQ(u, 1);
+	ASSERT_TRUE(r.next_element());
+	ASSERT_TRUE(r.read_string(s));
+	EXPECT_EQ(s, "x");
+	ASSERT_TRUE(r.next_element());
+	r.skip();
+	ASSERT_TRUE(r.next_element());
+	ASSERT_TRUE(r.read_bool(b));
+	EXPECT_FALSE(b);
+	EXPECT_FALSE(r.next_element());
+
+	ASSERT_TRUE(r.next_member(key));
+	EXPECT_EQ(key, "o");
+	r.skip();
+	EXPECT_FALSE(r.next_member(key));
+	EXPECT_TRUE(r.at_end());
+	EXPECT_FALSE(r.error());
+}
+
+TEST(json_stream, reader_errors)
+{
+	for(const std::string doc : {"{\"a\": 1", "{\"a\" 1}", "{\"a\": \"b}", "{\"a\": [1, {]}", "{\"a\": nul}", "{\"a\": \"\\x\"}",
+				     // missing, leading and trailing commas, also in the skipped values
+				     "{\"a\": 1 \"b\": 2}", "{\"a\": [1 2]}", "{\"a\": {\"b\": 1 \"c\": 2}}", "{\"a\": [[1] [2]]}",
+				     "{, \"a\": 1}", "{\"a\": 1,}", "{\"a\": [1,]}", "{\"a\": [,1]}",
+				     // malformed numbers
+				     "{\"a\": 1.}", "{\"a\": 1e}", "{\"a\": 1e5e5}", "{\"a\": -}", "{\"a\": 1.2.3}"})
+	{
+		json::reader r(doc.data(), doc.size());
+		std::string key;
+		ASSERT_TRUE(r.begin_object());
+		while(r.next_member(key))
+		{
+			r.skip();
+		}
+		EXPECT_TRUE(r.error()) << doc;
+		EXPECT_FALSE(r.get_error().empty());
+		EXPECT_FALSE(r.at_end());
+	}
+}
+
+TEST(json_stream, reader_trailing_data)
+{
+	for(const std::string doc : {"{\"a\": 1} x", "{\"a\": 1}}", "{\"a\": 1} {}"})
+	{
+		json::reader r(doc.data(), doc.size());
+		std::string key;
+		ASSERT_TRUE(r.begin_object());
+		while(r.next_member(key))
+		{
+			r.skip();
+		}
+		EXPECT_FALSE(r.error()) << doc;
+		EXPECT_FALSE(r.at_end()) << doc;
+	}
+}
+
+TEST(json_stream, writer)
+{
+	std::string out;
+	json::writer w(out);
+	w.begin_object();
+	w.key("s");
+	w.value("a\"b\\c\n\x01");
+	w.key("a");
+	w.begin_array();
+	w.value((int64_t)-1);
+	w.value((uint64_t)2);
+	w.begin_object();
+	w.end_object();
+	w.null();
+	w.end_array();
+	w.key("b");
+	w.value(false);
+	w.end_object();
+	EXPECT_EQ(out, R"({"s":"a\"b\\c\n\u0001","a":[-1,2,{},null],"b":false})");
+
+	// what is written is read back
+	json::reader r(out.data(), out.size());
+	std::string key, s;
+	ASSERT_TRUE(r.begin_object());
+	ASSERT_TRUE(r.next_member(key));
+	ASSERT_TRUE(r.read_string(s));
+	EXPECT_EQ(s, "a\"b\\c\n\x01");
+}
+
+TEST(json_stream, container_round_trip)
+{
+	sinsp_container_info info;
+	info.m_id = "3ad7b26ded6d";
+	info.m_full_id = "3ad7b26ded6d8e0d3d6a8c6f1d1b1e7c5d3e1f5a0e2f4d6b8a0c2e4f6a8b0c2d";
+	info.m_type = CT_CRI;
+	info.m_name = "nginx \"web\"";
+	info.m_image = "nginx:1.23";
+	info.m_privileged = true;
+	info.m_is_pod_sandbox = true;
+	info.set_lookup_status(sinsp_container_lookup::state::SUCCESSFUL);
+	info.m_created_time = 1663770709;
+	info.m_container_ip = 0xac110002;
+	info.m_labels["app"] = "web";
+	info.m_labels["io.kubernetes.pod.name"] = "nginx-5d8b9c4b7f-x2k9p";
+	info.m_env.push_back("MESOS_TASK_ID=1");
+	info.m_env.push_back("PATH=/usr/bin");
+	info.m_memory_limit = 1 << 30;
+	info.m_cpuset_cpu_count = 2;
+	info.m_metadata_deadline = UINT64_MAX;
+	sinsp_container_info::container_port_mapping map;
+	map.m_host_ip = 0xc0a80001;
+	map.m_host_port = 8080;
+	map.m_container_port = 80;
+	info.m_port_mappings.push_back(map);
+	info.m_health_probes.emplace_back(sinsp_container_info::container_health_probe::PT_READINESS_PROBE,
+					  "curl", std::vector<std::string>{"-f", "http://localhost/"});
+	info.m_health_probes.emplace_back(sinsp_container_info::container_health_probe::PT_HEALTHCHECK,
+					  "true", std::vector<std::string>{});
+
+	std::string json;
+	sinsp_container_manager::container_to_json(info, json);
+
+	sinsp_container_info parsed;
+	std::string error;
+	ASSERT_TRUE(sinsp_container_manager::container_from_json(json.data(), json.size(), parsed, error)) << error;
+	EXPECT_EQ(parsed.m_id, info.m_id);
+	EXPECT_EQ(parsed.m_full_id, info.m_full_id);
+	EXPECT_EQ(parsed.m_type, CT_CRI);
+	EXPECT_EQ(parsed.m_name, info.m_name);
+	EXPECT_EQ(parsed.m_image, info.m_image);
+	EXPECT_TRUE(parsed.m_privileged);
+	EXPECT_TRUE(parsed.m_is_pod_sandbox);
+	EXPECT_TRUE(parsed.is_successful());
+	EXPECT_EQ(parsed.m_created_time, info.m_created_time);
+	EXPECT_EQ(parsed.m_container_ip, info.m_container_ip);
+	EXPECT_EQ(parsed.m_labels, info.m_labels);
+	ASSERT_EQ(parsed.m_env.size(), 1);
+	EXPECT_EQ(parsed.m_env[0], "MESOS_TASK_ID=1");
+	EXPECT_EQ(parsed.m_memory_limit, info.m_memory_limit);
+	EXPECT_EQ(parsed.m_cpuset_cpu_count, 2);
+	EXPECT_EQ(parsed.m_metadata_deadline, UINT64_MAX);
+	ASSERT_EQ(parsed.m_port_mappings.size(), 1);
+	EXPECT_EQ(parsed.m_port_mappings[0].m_host_ip, map.m_host_ip);
+	EXPECT_EQ(parsed.m_port_mappings[0].m_host_port, 8080);
+	EXPECT_EQ(parsed.m_port_mappings[0].m_container_port, 80);
+
+	// the probes come back in the order of their types
+	ASSERT_EQ(parsed.m_health_probes.size(), 2);
+	EXPECT_EQ(parsed.m_health_probes.front().m_probe_type, sinsp_container_info::container_health_probe::PT_HEALTHCHECK);
+	EXPECT_EQ(parsed.m_health_probes.back().m_health_probe_exe, "curl");
+	EXPECT_EQ(parsed.m_health_probes.back().m_health_probe_args.size(), 2);
+
+}
+
+TEST(json_stream, container_from_json)
+{
+	// null and unknown members are ignored
+	std::string json = R"({"container":{"id":"f9c7a020960a","labels":null,"Mounts":null,"type":null,)"
+			   R"("unknown":{"a":[1,2]},"name":"eloquent_mirzakhani","cpuset_cpu_count":4294967296}})";
+	sinsp_container_info info;
+	std::string error;
+	ASSERT_TRUE(sinsp_container_manager::container_from_json(json.data(), json.size(), info, error)) << error;
+	EXPECT_EQ(info.m_id, "f9c7a020960a");
+	EXPECT_EQ(info.m_name, "eloquent_mirzakhani");
+	EXPECT_TRUE(info.m_labels.empty());
+	EXPECT_EQ(info.m_cpuset_cpu_count, 0);
+
+	json = R"({"container":{"id":"f9c7a020960a")";
+	EXPECT_FALSE(sinsp_container_manager::container_from_json(json.data(), json.size(), info, error));
+	EXPECT_FALSE(error.empty());
+
+	json = R"(["container"])";
+	EXPECT_FALSE(sinsp_container_manager::container_from_json(json.data(), json.size(), info, error));
+
+	// rejected by the jsoncpp reader as well
+	json = R"({"container":{"id":"f9c7a020960a" "name":"eloquent_mirzakhani"}})";
+	EXPECT_FALSE(sinsp_container_manager::container_from_json(json.data(), json.size(), info, error));
+	EXPECT_FALSE(error.empty());
+
+	json = R"({"container":{"id":"f9c7a020960a","unknown":[1 2]}})";
+	EXPECT_FALSE(sinsp_container_manager::container_from_json(json.data(), json.size(), info, error));
+
+	json = R"({"container":{"id":"f9c7a020960a"}} garbage)";
+	EXPECT_FALSE(sinsp_container_manager::container_from_json(json.data(), json.size(), info, error));
+	EXPECT_FALSE(error.empty());
+}
@@ -0,0 +1,161 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include "latency_profiler.h"
+#include "sinsp_with_test_input.h"
+
+TEST(latency_profiler, buckets_and_percentiles)
+{
+	EXPECT_EQ(latency_profiler::get_bucket(0), 0);
+	EXPECT_EQ(latency_profiler::get_bucket(1), 1);
+	EXPECT_EQ(latency_profiler::get_bucket(2), 2);
+	EXPECT_EQ(latency_profiler::get_bucket(3), 2);
+	EXPECT_EQ(latency_profiler::get_bucket(1000), 10);
+	EXPECT_EQ(latency_profiler::get_bucket(UINT64_MAX), latency_profiler::NUM_BUCKETS - 1);
+
+	latency_profiler p;
+	p.record(latency_profiler::STAGE_PARSE, PPME_SYSCALL_OPEN_X, 100);
+
+	// nothing is kept until the profiling is enabled
+	EXPECT_EQ(p.get_histogram(latency_profiler::STAGE_PARSE, PPM_EVENT_MAX), nullptr);
+
+	p.set_sampling_ratio(1);
+	for(uint64_t ns = 1; ns <= 100; ns++)
+	{
+		p.record(latency_profiler::STAGE_PARSE, PPME_SYSCALL_OPEN_X, ns * 10);
+	}
+	p.record(latency_profiler::STAGE_PARSE, PPME_SYSCALL_CLOSE_X, 5000);
+
+	auto h = p.get_histogram(latency_profiler::STAGE_PARSE, PPME_SYSCALL_OPEN_X);
+	ASSERT_NE(h, nullptr);
+	EXPECT_EQ(h->m_count, 100);
+	EXPECT_EQ(h->m_sum_ns, 50500);
+	EXPECT_EQ(h->m_max_ns, 1000);
+	EXPECT_EQ(latency_profiler::get_percentile(*h, 50), 511);
+	EXPECT_EQ(latency_profiler::get_percentile(*h, 99), 1000);
+
+	auto total = p.get_histogram(latency_profiler::STAGE_PARSE, PPM_EVENT_MAX);
+	ASSERT_NE(total, nullptr);
+	EXPECT_EQ(total->m_count, 101);
+	EXPECT_EQ(total->m_max_ns, 5000);
+	EXPECT_EQ(p.get_histogram(latency_profiler::STAGE_FILTER, PPM_EVENT_MAX), nullptr);
+
+	p.clear();
+	EXPECT_EQ(p.get_histogram(latency_profiler::STAGE_PARSE, PPM_EVENT_MAX), nullptr);
+}
+
+TEST(latency_profiler, sampling)
+{
+	latency_profiler p;
+	EXPECT_FALSE(p.begin_event());
+
+	p.set_sampling_ratio(4);
+	uint32_t sampled = 0;
+	for(uint32_t j = 0; j < 100; j++)
+	{
+		if(p.begin_event())
+		{
+			sampled++;
+			EXPECT_TRUE(p.is_sampling());
+		}
+	}
+	EXPECT_EQ(sampled, 25);
+
+	p.set_sampling_ratio(0);
+	EXPECT_FALSE(p.begin_event());
+	EXPECT_EQ(p.start(), 0);
+}
+
+TEST_F(sinsp_with_test_input, latency_profiler_stages)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	m_inspector.set_filter("evt.type in (open, close)");
+	m_inspector.set_latency_profiling(1);
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, (int64_t)3);
+
+	auto& p = m_inspector.get_latency_profiler();
+	for(auto s : {latency_profiler::STAGE_NEXT, latency_profiler::STAGE_PARSE, latency_profiler::STAGE_FILTER})
+	{
+		auto h = p.get_histogram(s, PPME_SYSCALL_OPEN_X);
+		ASSERT_NE(h, nullptr);
+		EXPECT_EQ(h->m_count, 1);
+		h = p.get_histogram(s, PPM_EVENT_MAX);
+		ASSERT_NE(h, nullptr);
+		EXPECT_EQ(h->m_count, 3);
+	}
+
+	// no dumper
+	EXPECT_EQ(p.get_histogram(latency_profiler::STAGE_DUMP, PPM_EVENT_MAX), nullptr);
+
+	uint32_t nstats = 0;
+	const scap_stats_v2* stats = p.get_stats(&nstats);
+	ASSERT_GT(nstats, 0);
+	bool found = false;
+	for(uint32_t i = 0; i < nstats; i++)
+	{
+		EXPECT_EQ(stats[i].flags, PPM_SCAP_STATS_LATENCY);
+		if(std::string(stats[i].name) == "latency.parse.count")
+		{
+			EXPECT_EQ(stats[i].value.u64, 3);
+			found = true;
+		}
+	}
+	EXPECT_TRUE(found);
+
+	// disabling keeps the histograms
+	m_inspector.set_latency_profiling(0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	EXPECT_EQ(p.get_histogram(latency_profiler::STAGE_NEXT, PPM_EVENT_MAX)->m_count, 3);
+}
+
+TEST_F(sinsp_with_test_input, latency_profiler_cpu_clock)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	m_inspector.set_latency_profiling(1, latency_profiler::THREAD_CPU_CLOCK);
+	auto& p = m_inspector.get_latency_profiler();
+	EXPECT_EQ(p.get_clock(), latency_profiler::THREAD_CPU_CLOCK);
+
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, (int64_t)3);
+	sinsp_evt_formatter formatter(&m_inspector, "%evt.type %fd.num");
+	std::string output;
+	formatter.tostring(evt, &output);
+
+	for(auto s : {latency_profiler::STAGE_NEXT, latency_profiler::STAGE_SCAP, latency_profiler::STAGE_FORMAT})
+	{
+		auto h = p.get_histogram(s, PPME_SYSCALL_CLOSE_E);
+		ASSERT_NE(h, nullptr);
+		EXPECT_EQ(h->m_count, 1);
+	}
+
+	uint32_t nstats = 0;
+	const scap_stats_v2* stats = p.get_stats(&nstats);
+	ASSERT_GT(nstats, 0);
+	EXPECT_EQ(std::string(stats[0].name).rfind("cpu.", 0), 0);
+
+	// switching clock drops the samples of the other one
+	m_inspector.set_latency_profiling(1);
+	EXPECT_EQ(p.get_histogram(latency_profiler::STAGE_NEXT, PPM_EVENT_MAX), nullptr);
+}
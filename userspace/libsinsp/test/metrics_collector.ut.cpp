@@ -0,0 +1,125 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include "sinsp_with_test_input.h"
+#include "metrics_collector.h"
+#include "strlcpy.h"
+
+static scap_stats_v2 make_stat(const char* name, uint32_t flags, uint64_t value)
+{
+	scap_stats_v2 stat;
+	strlcpy(stat.name, name, STATS_NAME_MAX);
+	stat.flags = flags;
+	stat.type = STATS_VALUE_TYPE_U64;
+	stat.value.u64 = value;
+	return stat;
+}
+
+TEST(sinsp_metrics_collector, prometheus)
+{
+	sinsp inspector;
+	sinsp_metrics_collector collector(&inspector, 0, "test");
+
+	std::vector<scap_stats_v2> stats;
+	stats.push_back(make_stat("n_evts", PPM_SCAP_STATS_KERNEL_COUNTERS, 10));
+	stats.push_back(make_stat("latency.next.p99_ns", PPM_SCAP_STATS_LATENCY, 42));
+	stats.push_back(make_stat("n_drops_total", PPM_SCAP_STATS_KERNEL_COUNTERS, 3));
+	stats.push_back(make_stat("cpu_usage_perc", PPM_SCAP_STATS_RESOURCE_UTILIZATION, 0));
+	stats.back().type = STATS_VALUE_TYPE_D;
+	stats.back().value.d = 1.5;
+	collector.add_source([&stats](uint32_t* nstats)
+	{
+		*nstats = stats.size();
+		return stats.data();
+	});
+
+	// nothing before the first snapshot
+	std::string out;
+	collector.to_prometheus(out);
+	EXPECT_EQ(out, "");
+	EXPECT_EQ(collector.get_snapshot_ts(), 0);
+
+	collector.snapshot();
+	EXPECT_NE(collector.get_snapshot_ts(), 0);
+	collector.to_prometheus(out);
+	EXPECT_EQ(out,
+		  "# TYPE test_n_evts_total counter\n"
+		  "test_n_evts_total 10\n"
+		  "# TYPE test_latency_next_p99_ns gauge\n"
+		  "test_latency_next_p99_ns 42\n"
+		  "# TYPE test_n_drops_total counter\n"
+		  "test_n_drops_total 3\n"
+		  "# TYPE test_cpu_usage_perc gauge\n"
+		  "test_cpu_usage_perc 1.5\n");
+
+	// the rendering only shows the values of the last snapshot
+	stats[0].value.u64 = 20;
+	out.clear();
+	collector.to_prometheus(out);
+	EXPECT_NE(out.find("test_n_evts_total 10\n"), std::string::npos);
+
+	collector.snapshot();
+	out.clear();
+	collector.to_prometheus(out);
+	EXPECT_NE(out.find("test_n_evts_total 20\n"), std::string::npos);
+
+	// a change of layout renames the metrics
+	stats.erase(stats.begin());
+	collector.snapshot();
+	out.clear();
+	collector.to_prometheus(out);
+	EXPECT_EQ(out.find("test_n_evts_total"), std::string::npos);
+	EXPECT_EQ(out.find("# TYPE test_latency_next_p99_ns gauge\n"), 0);
+}
+
+TEST(sinsp_metrics_collector, duplicated_names)
+{
+	sinsp inspector;
+	sinsp_metrics_collector collector(&inspector, 0);
+
+	scap_stats_v2 stat = make_stat("n_evts", PPM_SCAP_STATS_KERNEL_COUNTERS, 1);
+	for(int i = 0; i < 2; i++)
+	{
+		collector.add_source([&stat](uint32_t* nstats)
+		{
+			*nstats = 1;
+			return &stat;
+		});
+	}
+
+	collector.snapshot();
+	std::string out;
+	collector.to_prometheus(out);
+	EXPECT_EQ(out, "# TYPE libs_n_evts_total counter\nlibs_n_evts_total 1\n");
+}
+
+TEST_F(sinsp_with_test_input, metrics_collector_parse_counters)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	sinsp_metrics_collector collector(&m_inspector, PPM_SCAP_STATS_PARSE_COUNTERS);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+
+	collector.snapshot();
+	std::string out;
+	collector.to_prometheus(out);
+	EXPECT_NE(out.find("# TYPE libs_parser_open_2_events_total counter\n"
+			   "libs_parser_open_2_events_total 1\n"), std::string::npos);
+}
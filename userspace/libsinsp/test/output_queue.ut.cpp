@@ -0,0 +1,135 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "sinsp_with_test_input.h"
+#include "output_queue.h"
+
+TEST_F(sinsp_with_test_input, output_queue_batches)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	auto formatter = std::make_shared<sinsp_evt_formatter>(&m_inspector, "%evt.type %fd.name");
+	std::vector<std::string> texts;
+	std::vector<uint64_t> tags;
+	size_t max_batch = 0;
+	std::thread::id output_thread;
+	sinsp_output_queue queue([&](const std::vector<const sinsp_output_queue::output*>& batch) {
+		max_batch = std::max(max_batch, batch.size());
+		output_thread = std::this_thread::get_id();
+		for(auto out : batch)
+		{
+			texts.push_back(out->m_text);
+			tags.push_back(out->m_tag);
+		}
+	}, 16, 4);
+
+	for(int64_t fd = 3; fd < 13; fd++)
+	{
+		std::string name = "/tmp/file_" + std::to_string(fd);
+		sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, fd, name.c_str(), PPM_O_RDWR, 0, 5, (uint64_t)123);
+		ASSERT_TRUE(queue.push(evt, formatter, fd));
+	}
+	queue.flush();
+
+	ASSERT_EQ(texts.size(), 10);
+	for(int64_t fd = 3; fd < 13; fd++)
+	{
+		ASSERT_EQ(texts[fd - 3], "open /tmp/file_" + std::to_string(fd));
+		ASSERT_EQ(tags[fd - 3], (uint64_t)fd);
+	}
+	ASSERT_LE(max_batch, 4);
+	ASSERT_NE(output_thread, std::this_thread::get_id());
+	ASSERT_EQ(queue.get_num_drops(), 0);
+}
+
+TEST_F(sinsp_with_test_input, output_queue_values)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	auto formatter = std::make_shared<sinsp_evt_formatter>(&m_inspector, "%evt.type %fd.name");
+	std::vector<std::string> texts;
+	sinsp_output_queue queue([&](const std::vector<const sinsp_output_queue::output*>& batch) {
+		for(auto out : batch)
+		{
+			texts.push_back(out->m_text);
+		}
+	});
+
+	// The values of a previous output come back to be reused
+	sinsp_output_queue::values_t values;
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (int64_t)3, "/tmp/a", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	ASSERT_TRUE(formatter->resolve_tokens(evt, values));
+	ASSERT_TRUE(queue.push(evt->get_ts(), formatter, values));
+	ASSERT_TRUE(values.empty());
+	queue.flush();
+
+	ASSERT_EQ(texts.size(), 1);
+	ASSERT_EQ(texts[0], "open /tmp/a");
+}
+
+TEST_F(sinsp_with_test_input, output_queue_full)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	auto formatter = std::make_shared<sinsp_evt_formatter>(&m_inspector, "%evt.type");
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+	uint32_t delivered = 0;
+	sinsp_output_queue queue([&](const std::vector<const sinsp_output_queue::output*>& batch) {
+		released.wait();
+		delivered += batch.size();
+	}, 4, 1);
+
+	// The capture never waits for the output thread, it drops instead
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (int64_t)3, "/tmp/a", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	uint32_t pushed = 0;
+	for(int i = 0; i < 10; i++)
+	{
+		pushed += queue.push(evt, formatter) ? 1 : 0;
+	}
+	ASSERT_EQ(pushed, 4);
+	ASSERT_EQ(queue.get_num_drops(), 10 - pushed);
+
+	release.set_value();
+	queue.flush();
+	ASSERT_EQ(delivered, pushed);
+}
+
+TEST_F(sinsp_with_test_input, output_queue_exception)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	auto formatter = std::make_shared<sinsp_evt_formatter>(&m_inspector, "%evt.type");
+	sinsp_output_queue queue([&](const std::vector<const sinsp_output_queue::output*>& batch) {
+		throw std::runtime_error("output error");
+	});
+
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (int64_t)3, "/tmp/a", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	ASSERT_TRUE(queue.push(evt, formatter));
+	ASSERT_THROW(queue.flush(), std::runtime_error);
+	queue.flush();
+}
@@ -0,0 +1,232 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "sinsp_with_test_input.h"
+#include "dumper.h"
+#include "parallel_replay.h"
+
+#define FILTER "evt.type in (open, read, close) and evt.dir=<"
+#define FORMAT "%evt.rawtime %evt.type %fd.name"
+
+class sinsp_parallel_replay_test : public sinsp_with_test_input
+{
+protected:
+	void TearDown() override
+	{
+		if(!m_path.empty())
+		{
+			unlink(m_path.c_str());
+		}
+		sinsp_with_test_input::TearDown();
+	}
+
+	//
+	// A capture with an event index, whose reads need the state built by
+	// the opens before them: the files stay open for a while, so that the
+	// opens and the reads often end up in different chunks
+	//
+	void write_capture()
+	{
+		char path[] = "/tmp/parallel_replay_XXXXXX";
+		int tmpfd = mkstemp(path);
+		ASSERT_NE(tmpfd, -1);
+		close(tmpfd);
+		m_path = path;
+
+		add_default_init_thread();
+		open_inspector();
+
+		sinsp_dumper dumper;
+		dumper.open(&m_inspector, path, false, true);
+		dumper.enable_index(1024);
+
+		char data[] = "hello";
+		for(int64_t i = 0; i < 400; i++)
+		{
+			int64_t fd = 3 + i % 16;
+			std::string name = "/tmp/file_" + std::to_string(i);
+			if(i >= 16)
+			{
+				dumper.dump(add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, fd));
+				dumper.dump(add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0));
+			}
+			dumper.dump(add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, name.c_str(), PPM_O_RDWR, 0));
+			dumper.dump(add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, fd, name.c_str(), PPM_O_RDWR, 0, 5, (uint64_t)i));
+
+			int64_t read_fd = 3 + (i + 8) % 16;
+			dumper.dump(add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, read_fd, (uint32_t)64));
+			dumper.dump(add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_X, 2, (int64_t)sizeof(data), scap_const_sized_buffer{data, sizeof(data)}));
+		}
+		dumper.close();
+	}
+
+	std::vector<std::pair<uint64_t, uint64_t>> event_index()
+	{
+		sinsp inspector;
+		inspector.open_savefile(m_path);
+		std::vector<std::pair<uint64_t, uint64_t>> index;
+		EXPECT_TRUE(inspector.get_event_index(index));
+		return index;
+	}
+
+	// The matching events of a serial read
+	std::vector<std::pair<uint64_t, std::string>> serial_replay()
+	{
+		sinsp inspector;
+		sinsp_filter_compiler compiler(&inspector, FILTER);
+		std::unique_ptr<sinsp_filter> filter(compiler.compile());
+		sinsp_evt_formatter formatter(&inspector, FORMAT);
+		inspector.open_savefile(m_path);
+
+		std::vector<std::pair<uint64_t, std::string>> res;
+		sinsp_evt* evt = nullptr;
+		int32_t rc;
+		while((rc = inspector.next(&evt)) != SCAP_EOF)
+		{
+			if(rc == SCAP_TIMEOUT)
+			{
+				continue;
+			}
+			EXPECT_TRUE(rc == SCAP_SUCCESS || rc == SCAP_FILTERED_EVENT);
+			if(filter->run(evt))
+			{
+				res.emplace_back(evt->get_ts(), std::string());
+				formatter.tostring(evt, &res.back().second);
+			}
+		}
+		return res;
+	}
+
+	std::string m_path;
+};
+
+static sinsp_parallel_replay::worker make_worker(sinsp* inspector, uint32_t)
+{
+	sinsp_parallel_replay::worker w;
+	sinsp_filter_compiler compiler(inspector, FILTER);
+	w.m_filter.reset(compiler.compile());
+	w.m_formatter.reset(new sinsp_evt_formatter(inspector, FORMAT));
+	return w;
+}
+
+TEST_F(sinsp_parallel_replay_test, same_output_as_serial_read)
+{
+	write_capture();
+	std::vector<std::pair<uint64_t, std::string>> expected = serial_replay();
+	ASSERT_EQ(expected.size(), 400 * 3 - 16);
+	// The reads resolve the files opened earlier
+	ASSERT_NE(expected.back().second.find("read /tmp/file_"), std::string::npos);
+
+	for(uint32_t num_threads : {1, 3, 8})
+	{
+		std::vector<std::pair<uint64_t, std::string>> outputs;
+		sinsp_parallel_replay replay(m_path, num_threads, 7, UINT64_MAX, make_worker,
+					     [&](uint32_t, uint64_t ts, const std::string& output)
+					     {
+						     outputs.emplace_back(ts, output);
+					     });
+		ASSERT_EQ(replay.run(), expected.size());
+		ASSERT_EQ(outputs, expected) << num_threads << " threads";
+	}
+}
+
+TEST_F(sinsp_parallel_replay_test, chunks_follow_the_index)
+{
+	write_capture();
+	std::vector<std::pair<uint64_t, uint64_t>> index = event_index();
+	const uint32_t num_chunks = 5;
+	ASSERT_GT(index.size(), num_chunks);
+
+	// Every chunk starts at an indexed event, evenly spaced
+	std::vector<uint64_t> start_ts;
+	for(size_t k = 0; k < num_chunks; k++)
+	{
+		start_ts.push_back(k == 0 ? 0 : index[index.size() * k / num_chunks].first);
+	}
+
+	std::vector<std::pair<uint32_t, uint64_t>> matches;
+	sinsp_parallel_replay replay(m_path, 2, num_chunks, UINT64_MAX, make_worker,
+				     [&](uint32_t chunk_idx, uint64_t ts, const std::string&)
+				     {
+					     matches.emplace_back(chunk_idx, ts);
+				     });
+	replay.run();
+
+	std::vector<uint64_t> first_ts(num_chunks, UINT64_MAX);
+	for(const auto& m : matches)
+	{
+		ASSERT_LT(m.first, num_chunks);
+		ASSERT_GE(m.second, start_ts[m.first]);
+		if(m.first + 1 < num_chunks)
+		{
+			ASSERT_LT(m.second, start_ts[m.first + 1]);
+		}
+		first_ts[m.first] = std::min(first_ts[m.first], m.second);
+	}
+
+	// The indexed events are exits, or the enters right before them (one
+	// increasing_ts() step earlier)
+	for(size_t k = 1; k < num_chunks; k++)
+	{
+		ASSERT_NE(first_ts[k], UINT64_MAX);
+		ASSERT_LE(first_ts[k] - start_ts[k], 10000000);
+	}
+
+	// Too many chunks for the index: one per indexed event at most
+	matches.clear();
+	sinsp_parallel_replay many(m_path, 2, (uint32_t)index.size() * 2, UINT64_MAX, make_worker,
+				   [&](uint32_t chunk_idx, uint64_t ts, const std::string&)
+				   {
+					   matches.emplace_back(chunk_idx, ts);
+				   });
+	many.run();
+	ASSERT_EQ(matches.back().first, index.size() - 1);
+}
+
+TEST_F(sinsp_parallel_replay_test, fseek_after_block_header)
+{
+	write_capture();
+	std::vector<std::pair<uint64_t, uint64_t>> index = event_index();
+	ASSERT_GT(index.size(), 2);
+
+	auto next_ts = [](sinsp& inspector)
+	{
+		sinsp_evt* evt = nullptr;
+		int32_t rc;
+		while((rc = inspector.next(&evt)) == SCAP_TIMEOUT)
+		{
+		}
+		EXPECT_TRUE(rc == SCAP_SUCCESS || rc == SCAP_FILTERED_EVENT);
+		return rc == SCAP_EOF ? 0 : evt->get_ts();
+	};
+
+	// Opening the capture reads the block header of its first event
+	sinsp inspector;
+	inspector.open_savefile(m_path);
+	const auto& middle = index[index.size() / 2];
+	test_helper::fseek(inspector, middle.second);
+	ASSERT_EQ(inspector.get_bytes_read(), middle.second);
+	ASSERT_EQ(next_ts(inspector), middle.first);
+
+	// And back, after reading some events
+	next_ts(inspector);
+	test_helper::fseek(inspector, index[1].second);
+	ASSERT_EQ(next_ts(inspector), index[1].first);
+}
@@ -15,8 +15,14 @@ limitations under the License.
 
 */
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include <gtest/gtest.h>
 #include <plugin.h>
+#include <plugin_filtercheck.h>
+#include <plugin_parser.h>
 
 #include "sinsp_with_test_input.h"
 #include "test_utils.h"
@@ -119,6 +125,84 @@ TEST_F(sinsp_with_test_input, plugin_syscall_extract)
 	ASSERT_FALSE(field_exists(evt, "sample.evt_count", pl_flist));
 }
 
+static std::string batch_value_as_string(const std::vector<extract_value_t>& values)
+{
+	if (values.size() != 1)
+	{
+		return "<" + std::to_string(values.size()) + " values>";
+	}
+	return std::string((const char*) values[0].ptr, values[0].len);
+}
+
+// scenario: a plugin with field extraction capability should extract the
+// values of a batch of events with the same results of one event at a time,
+// both when it supports the batched extraction and when it doesn't
+class sinsp_with_test_input_batch : public sinsp_with_test_input
+{
+protected:
+	void test_extract_batch(bool batch)
+	{
+		filter_check_list pl_flist;
+		auto pl = register_plugin(&m_inspector, [batch](plugin_api& api) {
+			get_plugin_api_sample_syscall_extract(api);
+			if (!batch)
+			{
+				api.extract_fields_batch = NULL;
+			}
+		});
+		ASSERT_EQ(pl->has_extract_fields_batch(), batch);
+		add_plugin_filterchecks(&m_inspector, pl, sinsp_syscall_event_source_name, pl_flist);
+		add_default_init_thread();
+		open_inspector();
+
+		// the inspector reuses its event, so we keep a copy of each one
+		std::vector<std::unique_ptr<sinsp_evt>> evts;
+		auto evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+		evts.emplace_back(new sinsp_evt(*evt));
+		evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_INOTIFY_INIT1_X, 2, (int64_t)12, (uint16_t)32);
+		evts.emplace_back(new sinsp_evt(*evt));
+		evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_BY_HANDLE_AT_X, 4, 4, 5, PPM_O_RDWR, "/tmp/the_file.txt");
+		evts.emplace_back(new sinsp_evt(*evt));
+		std::vector<sinsp_evt*> ptrs;
+		for (auto& e : evts)
+		{
+			ptrs.push_back(e.get());
+		}
+
+		std::unique_ptr<sinsp_filter_check> chk(pl_flist.new_filter_check_from_fldname("sample.is_open", &m_inspector, false));
+		ASSERT_GT(chk->parse_field_name("sample.is_open", true, false), 0);
+		auto pchk = dynamic_cast<sinsp_filter_check_plugin*>(chk.get());
+		ASSERT_NE(pchk, nullptr);
+		std::vector<std::vector<extract_value_t>> values;
+		pchk->extract_batch(ptrs.data(), ptrs.size(), values);
+		ASSERT_EQ(values.size(), 3);
+		uint64_t one = 1, zero = 0;
+		ASSERT_EQ(batch_value_as_string(values[0]), std::string((const char*) &one, sizeof(one)));
+		ASSERT_EQ(batch_value_as_string(values[1]), std::string((const char*) &zero, sizeof(zero)));
+		ASSERT_TRUE(values[2].empty());
+
+		chk.reset(pl_flist.new_filter_check_from_fldname("sample.proc_name", &m_inspector, false));
+		ASSERT_GT(chk->parse_field_name("sample.proc_name", true, false), 0);
+		pchk = dynamic_cast<sinsp_filter_check_plugin*>(chk.get());
+		ASSERT_NE(pchk, nullptr);
+		pchk->extract_batch(ptrs.data(), ptrs.size(), values);
+		ASSERT_EQ(values.size(), 3);
+		ASSERT_EQ(batch_value_as_string(values[0]), "init");
+		ASSERT_EQ(batch_value_as_string(values[1]), "init");
+		ASSERT_TRUE(values[2].empty());
+	}
+};
+
+TEST_F(sinsp_with_test_input_batch, plugin_syscall_extract_batch)
+{
+	test_extract_batch(true);
+}
+
+TEST_F(sinsp_with_test_input_batch, plugin_syscall_extract_batch_fallback)
+{
+	test_extract_batch(false);
+}
+
 // scenario: an event sourcing plugin should produce events of "syscall"
 // event source and we're should be able to extract filter values implemented
 // by both libsinsp and another plugin with field extraction capability
@@ -172,6 +256,78 @@ TEST_F(sinsp_with_test_input, plugin_custom_source)
 	ASSERT_EQ(next_event(), nullptr); // EOF is expected
 }
 
+// scenario: the events of a source plugin should be the same when its batches
+// are prefetched on a separate thread, even if the plugin reuses its memory
+TEST_F(sinsp_with_test_input, plugin_custom_source_prefetch)
+{
+	auto src_pl = register_plugin(&m_inspector, get_plugin_api_sample_plugin_source);
+	auto ext_pl = register_plugin(&m_inspector, get_plugin_api_sample_plugin_extract);
+	add_plugin_filterchecks(&m_inspector, ext_pl, src_pl->event_source());
+
+	m_inspector.set_input_plugin_prefetch(true);
+	m_inspector.open_plugin(src_pl->name(), "5");
+
+	for (int i = 0; i < 5; i++)
+	{
+		auto evt = next_event();
+		ASSERT_NE(evt, nullptr);
+		ASSERT_EQ(evt->get_type(), PPME_PLUGINEVENT_E);
+		ASSERT_EQ(evt->get_source_idx(), 1);
+		ASSERT_EQ(get_field_as_string(evt, "evt.pluginname"), src_pl->name());
+		ASSERT_EQ(get_field_as_string(evt, "sample.hello"), "hello world");
+	}
+	ASSERT_EQ(next_event(), nullptr); // EOF is expected
+}
+
+// scenario: the events of a source plugin added next to the capture should be
+// merged with the ones of the capture, and the capture should end only after
+// all of them have been returned
+TEST_F(sinsp_with_test_input, plugin_source_merge)
+{
+	auto src_pl = register_plugin(&m_inspector, get_plugin_api_sample_plugin_source);
+	auto ext_pl = register_plugin(&m_inspector, get_plugin_api_sample_plugin_extract);
+	add_plugin_filterchecks(&m_inspector, ext_pl, src_pl->event_source());
+
+	// the plugin events get the current time, so they come after these ones
+	add_default_init_thread();
+	add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (uint64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+
+	m_inspector.add_plugin_source(src_pl->name(), "5", 2);
+	ASSERT_ANY_THROW(m_inspector.add_plugin_source(src_pl->name(), "5"));
+	open_inspector();
+	ASSERT_ANY_THROW(m_inspector.add_plugin_source(src_pl->name(), "5"));
+
+	int n_syscall_evts = 0;
+	int n_plugin_evts = 0;
+	uint64_t last_ts = 0;
+	int32_t res;
+	sinsp_evt* evt;
+	while((res = m_inspector.next(&evt)) != SCAP_EOF)
+	{
+		if(res == SCAP_TIMEOUT)
+		{
+			continue;
+		}
+		ASSERT_EQ(res, SCAP_SUCCESS);
+		ASSERT_GE(evt->get_ts(), last_ts);
+		last_ts = evt->get_ts();
+		if(evt->get_type() == PPME_PLUGINEVENT_E)
+		{
+			ASSERT_EQ(evt->get_source_idx(), 1);
+			ASSERT_EQ(get_field_as_string(evt, "sample.hello"), "hello world");
+			n_plugin_evts++;
+		}
+		else
+		{
+			ASSERT_EQ(evt->get_source_idx(), 0);
+			n_syscall_evts++;
+		}
+	}
+	ASSERT_EQ(n_syscall_evts, 2);
+	ASSERT_EQ(n_plugin_evts, 5);
+}
+
 TEST(sinsp_plugin, plugin_extract_compatibility)
 {
 	sinsp i;
@@ -280,3 +436,211 @@ TEST_F(sinsp_with_test_input, plugin_syscall_parse)
 	// this is the second time we see this event type
 	ASSERT_EQ(get_field_as_string(evt, "sample.evt_count", pl_flist), "2");
 }
+
+static const char* async_plugin_get_fields()
+{
+	return
+	"[" \
+		"{\"type\": \"uint64\", \"name\": \"sample.is_open\", \"desc\": \"Value is 1 if event is of open family\", \"properties\": [\"async\"]}," \
+		"{\"type\": \"uint64\", \"name\": \"sample.open_count\", \"desc\": \"Counter for all the events of open family in a given thread\"}," \
+		"{\"type\": \"uint64\", \"name\": \"sample.evt_count\", \"desc\": \"Counter of events of the same type of the current one, counting all threads\"}," \
+		"{\"type\": \"string\", \"name\": \"sample.proc_name\", \"desc\": \"Alias for proc.name, but implemented from a plugin\", \"properties\": [\"async\"]}" \
+	"]";
+}
+
+static ss_plugin_rc (*s_async_plugin_extract_fields)(ss_plugin_t*, const ss_plugin_event_input*, const ss_plugin_field_extract_input*);
+static uint32_t s_async_plugin_delay_ms = 0;
+
+static ss_plugin_rc async_plugin_extract_fields(ss_plugin_t* s, const ss_plugin_event_input* ev, const ss_plugin_field_extract_input* in)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(s_async_plugin_delay_ms));
+	return s_async_plugin_extract_fields(s, ev, in);
+}
+
+// scenario: the fields declared as "async" are extracted from the batches of
+// events by a worker, and read in order by the filter checks
+class sinsp_with_test_input_async : public sinsp_with_test_input
+{
+protected:
+	std::shared_ptr<sinsp_plugin> open_with_async_plugin(filter_check_list& pl_flist, uint32_t delay_ms, uint64_t max_wait_ns)
+	{
+		s_async_plugin_delay_ms = delay_ms;
+		auto pl = register_plugin(&m_inspector, [](plugin_api& api) {
+			get_plugin_api_sample_syscall_extract(api);
+			api.get_fields = async_plugin_get_fields;
+			s_async_plugin_extract_fields = api.extract_fields;
+			api.extract_fields = async_plugin_extract_fields;
+		});
+		add_plugin_filterchecks(&m_inspector, pl, sinsp_syscall_event_source_name, pl_flist);
+		add_default_init_thread();
+		for(int64_t fd = 3; fd < 13; fd++)
+		{
+			add_event(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+			add_event(increasing_ts(), 1, PPME_SYSCALL_INOTIFY_INIT1_X, 2, (int64_t)12, (uint16_t)32);
+		}
+		open_inspector();
+
+		// the sample plugin isn't thread safe, a single worker is
+		m_inspector.set_plugin_async_extraction(1, max_wait_ns);
+		return pl;
+	}
+};
+
+TEST_F(sinsp_with_test_input_async, plugin_syscall_extract_async)
+{
+	filter_check_list pl_flist;
+	auto pl = open_with_async_plugin(pl_flist, 0, 10ULL * 1000 * 1000 * 1000);
+	ASSERT_TRUE(pl->has_async_fields());
+	ASSERT_NE(pl->async_extractor(), nullptr);
+
+	sinsp_evt* evts[4];
+	uint32_t nevts = 0;
+	uint32_t count = 0;
+	while(m_inspector.next_batch(evts, 4, &nevts) == SCAP_SUCCESS)
+	{
+		for(uint32_t i = 0; i < nevts; i++)
+		{
+			bool is_open = evts[i]->get_type() == PPME_SYSCALL_OPEN_E;
+			ASSERT_EQ(get_field_as_string(evts[i], "sample.is_open", pl_flist), is_open ? "1" : "0");
+			ASSERT_EQ(get_field_as_string(evts[i], "sample.proc_name", pl_flist), "init");
+			count++;
+		}
+	}
+	ASSERT_EQ(count, 20);
+	ASSERT_EQ(pl->async_extractor()->num_timeouts(), 0);
+}
+
+TEST_F(sinsp_with_test_input_async, plugin_syscall_extract_async_timeout)
+{
+	// the fields of the first batch are extracted synchronously, as no
+	// filter check asked for them before
+	filter_check_list pl_flist;
+	auto pl = open_with_async_plugin(pl_flist, 50, 1000);
+
+	sinsp_evt* evts[4];
+	uint32_t nevts = 0;
+	ASSERT_EQ(m_inspector.next_batch(evts, 4, &nevts), SCAP_SUCCESS);
+	ASSERT_TRUE(field_exists(evts[0], "sample.is_open", pl_flist));
+
+	// the following ones are too slow and have no value
+	ASSERT_EQ(m_inspector.next_batch(evts, 4, &nevts), SCAP_SUCCESS);
+	ASSERT_FALSE(field_exists(evts[3], "sample.is_open", pl_flist));
+	ASSERT_EQ(pl->async_extractor()->num_timeouts(), 1);
+}
+
+// parsers that count the open events, the second one also gets the
+// thread table and can't run next to the other parsers that get it
+static std::atomic<uint64_t> s_counting_parser_evts[2];
+
+static const char* counting_parser_get_required_api_version() { return PLUGIN_API_VERSION_STR; }
+static const char* counting_parser_get_version() { return "0.1.0"; }
+static const char* counting_parser_get_description() { return "counts the open events"; }
+static const char* counting_parser_get_contact() { return "some contact"; }
+static const char* counting_parser_get_name_0() { return "counting_parser_0"; }
+static const char* counting_parser_get_name_1() { return "counting_parser_1"; }
+static const char* counting_parser_get_last_error(ss_plugin_t* s) { return NULL; }
+static void counting_parser_destroy(ss_plugin_t* s) { }
+static const char* counting_parser_get_parse_event_sources() { return "[\"syscall\"]"; }
+
+static uint16_t* counting_parser_get_parse_event_types(uint32_t* num_types)
+{
+	static uint16_t types[] = { PPME_SYSCALL_OPEN_E, PPME_SYSCALL_OPEN_X };
+	*num_types = sizeof(types) / sizeof(uint16_t);
+	return &types[0];
+}
+
+static ss_plugin_t* counting_parser_init_0(const ss_plugin_init_input* in, ss_plugin_rc* rc)
+{
+	*rc = SS_PLUGIN_SUCCESS;
+	return (ss_plugin_t*) &s_counting_parser_evts[0];
+}
+
+static ss_plugin_t* counting_parser_init_1(const ss_plugin_init_input* in, ss_plugin_rc* rc)
+{
+	*rc = in->tables->get_table(in->owner, "threads", ss_plugin_state_type::SS_PLUGIN_ST_INT64) != NULL
+		? SS_PLUGIN_SUCCESS : SS_PLUGIN_FAILURE;
+	return (ss_plugin_t*) &s_counting_parser_evts[1];
+}
+
+static ss_plugin_rc counting_parser_parse_event(ss_plugin_t* s, const ss_plugin_event_input* ev, const ss_plugin_event_parse_input* in)
+{
+	((std::atomic<uint64_t>*) s)->fetch_add(1);
+	return SS_PLUGIN_SUCCESS;
+}
+
+static void get_plugin_api_counting_parser(plugin_api& api, int idx)
+{
+	memset(&api, 0, sizeof(plugin_api));
+	api.get_required_api_version = counting_parser_get_required_api_version;
+	api.get_version = counting_parser_get_version;
+	api.get_description = counting_parser_get_description;
+	api.get_contact = counting_parser_get_contact;
+	api.get_name = idx == 0 ? counting_parser_get_name_0 : counting_parser_get_name_1;
+	api.get_last_error = counting_parser_get_last_error;
+	api.init = idx == 0 ? counting_parser_init_0 : counting_parser_init_1;
+	api.destroy = counting_parser_destroy;
+	api.get_parse_event_sources = counting_parser_get_parse_event_sources;
+	api.get_parse_event_types = counting_parser_get_parse_event_types;
+	api.parse_event = counting_parser_parse_event;
+}
+
+// scenario: the parsers that write different tables are grouped apart and
+// parse the events in parallel, with the same results of a sequential run
+TEST_F(sinsp_with_test_input, plugin_syscall_parse_parallel)
+{
+	s_counting_parser_evts[0] = 0;
+	s_counting_parser_evts[1] = 0;
+	auto parse_pl = register_plugin(&m_inspector, get_plugin_api_sample_syscall_parse);
+	auto count_pl_0 = register_plugin(&m_inspector, [](plugin_api& api) { get_plugin_api_counting_parser(api, 0); });
+	auto count_pl_1 = register_plugin(&m_inspector, [](plugin_api& api) { get_plugin_api_counting_parser(api, 1); });
+	ASSERT_TRUE(count_pl_0->written_tables().empty());
+	ASSERT_EQ(count_pl_1->written_tables().count("threads"), 1);
+
+	std::vector<sinsp_plugin_parser> parsers = {
+		sinsp_plugin_parser(parse_pl),
+		sinsp_plugin_parser(count_pl_0),
+		sinsp_plugin_parser(count_pl_1),
+	};
+	auto groups = sinsp_plugin_parse_pool::group_parsers(parsers);
+	ASSERT_EQ(groups.size(), 2);
+	ASSERT_EQ(groups[0], std::vector<size_t>({0, 2}));
+	ASSERT_EQ(groups[1], std::vector<size_t>({1}));
+
+	filter_check_list pl_flist;
+	auto extract_pl = register_plugin(&m_inspector, get_plugin_api_sample_syscall_extract);
+	add_plugin_filterchecks(&m_inspector, extract_pl, sinsp_syscall_event_source_name, pl_flist);
+	m_inspector.set_plugin_parse_threads(2);
+	add_default_init_thread();
+	open_inspector();
+
+	sinsp_evt* evt = nullptr;
+	for (uint64_t i = 1; i <= 50; i++)
+	{
+		evt = add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+		ASSERT_EQ(get_field_as_string(evt, "sample.open_count", pl_flist), std::to_string(i));
+	}
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_INOTIFY_INIT1_X, 2, (int64_t)12, (uint16_t)32);
+	ASSERT_EQ(s_counting_parser_evts[0], 50);
+	ASSERT_EQ(s_counting_parser_evts[1], 50);
+}
+
+// scenario: the fields of a plugin are parsed once and shared by all the
+// inspectors loading it, unless the plugin returns different fields
+TEST(sinsp_plugin, fields_cache)
+{
+	sinsp inspector1, inspector2, inspector3;
+	auto pl1 = register_plugin(&inspector1, get_plugin_api_sample_syscall_extract);
+	auto pl2 = register_plugin(&inspector2, get_plugin_api_sample_syscall_extract);
+	auto pl3 = register_plugin(&inspector3, [](plugin_api& api) {
+		get_plugin_api_sample_syscall_extract(api);
+		api.get_fields = async_plugin_get_fields;
+	});
+
+	ASSERT_EQ(pl1->fields().size(), 4);
+	ASSERT_EQ(&pl1->fields(), &pl2->fields());
+	ASSERT_NE(&pl1->fields(), &pl3->fields());
+	ASSERT_EQ(std::string(pl1->fields()[3].m_name), "sample.proc_name");
+	ASSERT_EQ(pl1->fields()[3].m_type, PT_CHARBUF);
+	ASSERT_FALSE(pl1->fields()[0].m_flags & EPF_ASYNC);
+	ASSERT_TRUE(pl3->fields()[0].m_flags & EPF_ASYNC);
+}
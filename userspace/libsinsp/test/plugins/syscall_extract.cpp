@@ -17,6 +17,7 @@ limitations under the License.
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
 #include <sstream>
 
 #include <ppm_events_public.h>
@@ -30,6 +31,7 @@ limitations under the License.
  * - Uses the libsinsp's thread table and accesses the threads' "comm" field
  * - Optionally accesses a field defined at runtime by another plugin on the thread table
  * - Optionally accesses a table defined at runtime by another plugin
+ * - Supports extracting fields from batches of events
  */
 typedef struct plugin_state
 {
@@ -42,6 +44,9 @@ typedef struct plugin_state
     ss_plugin_table_field_t* thread_opencount_field;
     ss_plugin_table_t* evtcount_table;
     ss_plugin_table_field_t* evtcount_count_field;
+    std::deque<uint64_t> u64batch;
+    std::deque<std::string> strbatch;
+    std::deque<const char*> strptrbatch;
 } plugin_state;
 
 static inline bool evt_type_is_open(uint16_t type)
@@ -291,6 +296,43 @@ static ss_plugin_rc plugin_extract_fields(ss_plugin_t *s, const ss_plugin_event_
     return SS_PLUGIN_SUCCESS;
 }
 
+static ss_plugin_rc plugin_extract_fields_batch(ss_plugin_t *s, uint32_t num_evts, const ss_plugin_event_input *evts, const ss_plugin_field_extract_input* in)
+{
+    // extracts from each event on its own, and keeps a copy of the values
+    // so that the ones of all the events stay valid until the next call
+    plugin_state *ps = (plugin_state *) s;
+    ps->u64batch.clear();
+    ps->strbatch.clear();
+    ps->strptrbatch.clear();
+    ss_plugin_field_extract_input evtin = *in;
+    for (uint32_t i = 0; i < num_evts; i++)
+    {
+        evtin.fields = in->fields + i * in->num_fields;
+        auto rc = plugin_extract_fields(s, &evts[i], &evtin);
+        for (uint32_t j = 0; j < in->num_fields; j++)
+        {
+            auto& field = evtin.fields[j];
+            if (rc != SS_PLUGIN_SUCCESS || field.res_len == 0)
+            {
+                field.res_len = 0;
+                continue;
+            }
+            if (field.ftype == PT_CHARBUF)
+            {
+                ps->strbatch.push_back(field.res.str[0]);
+                ps->strptrbatch.push_back(ps->strbatch.back().c_str());
+                field.res.str = &ps->strptrbatch.back();
+            }
+            else
+            {
+                ps->u64batch.push_back(field.res.u64[0]);
+                field.res.u64 = &ps->u64batch.back();
+            }
+        }
+    }
+    return SS_PLUGIN_SUCCESS;
+}
+
 void get_plugin_api_sample_syscall_extract(plugin_api& out)
 {
     memset(&out, 0, sizeof(plugin_api));
@@ -306,4 +348,5 @@ void get_plugin_api_sample_syscall_extract(plugin_api& out)
     out.get_extract_event_sources = plugin_get_extract_event_sources;
     out.get_extract_event_types = plugin_get_extract_event_types;
     out.extract_fields = plugin_extract_fields;
+    out.extract_fields_batch = plugin_extract_fields_batch;
 }
@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+#include <random>
+
+#include "prefix_search.h"
+
+TEST(path_prefix_search, match)
+{
+	path_prefix_search s;
+	s.add_search_path("/var/run");
+	s.add_search_path("/etc");
+	s.add_search_path("/lib");
+	s.add_search_path("/usr/lib");
+	s.add_search_path("/usr");
+
+	ASSERT_TRUE(s.match("/var/run/docker"));
+	ASSERT_TRUE(s.match("/var/run"));
+	ASSERT_TRUE(s.match("/usr/lib/x86_64-linux-gnu"));
+	ASSERT_TRUE(s.match("//etc///passwd"));
+	ASSERT_FALSE(s.match("/boot"));
+	ASSERT_FALSE(s.match("/var/lib/messages"));
+	ASSERT_FALSE(s.match("/var"));
+	ASSERT_FALSE(s.match("/"));
+	ASSERT_FALSE(s.match(""));
+
+	// the search paths are copied
+	std::string tmp = "/tmp/dir";
+	s.add_search_path(filter_value_t((uint8_t*)tmp.data(), tmp.size()));
+	tmp = "/xxx/xxx";
+	ASSERT_TRUE(s.match("/tmp/dir/file"));
+
+	s.add_search_path("/");
+	ASSERT_TRUE(s.match("/boot"));
+	ASSERT_TRUE(s.match("/"));
+}
+
+TEST(path_prefix_search, same_as_path_prefix_map)
+{
+	const char* dirs[] = {"usr", "lib", "bin", "etc", "var", "run", "a", "b", "c", "d",
+		"e", "f", "g", "h", "i", "j", "k", "l", "m", "n", "o", "p", "q", "r"};
+	std::mt19937 rng(42);
+	auto random_path = [&](uint32_t depth)
+	{
+		std::string path;
+		for(uint32_t i = 0; i < depth; i++)
+		{
+			path += "/";
+			path += dirs[rng() % (sizeof(dirs) / sizeof(dirs[0]))];
+		}
+		return path;
+	};
+
+	path_prefix_map<bool> map;
+	path_prefix_search search;
+	bool val = true;
+	for(uint32_t i = 0; i < 2000; i++)
+	{
+		std::string path = random_path(1 + rng() % 4);
+		map.add_search_path(path, val);
+		search.add_search_path(path);
+	}
+
+	for(uint32_t i = 0; i < 10000; i++)
+	{
+		std::string path = random_path(rng() % 6);
+		ASSERT_EQ(map.match(path.c_str()) != NULL, search.match(path.c_str())) << path;
+	}
+}
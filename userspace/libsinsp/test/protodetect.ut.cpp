@@ -0,0 +1,104 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "protodetect.h"
+
+static sinsp_l7_proto classify(const sinsp_protodetector& d, const std::string& buf, scap_l4_proto l4 = SCAP_L4_TCP)
+{
+	return d.classify(buf.data(), buf.size(), l4);
+}
+
+TEST(protodetect, http)
+{
+	sinsp_protodetector d;
+	EXPECT_EQ(classify(d, "GET /index.html HTTP/1.1\r\nHost: a\r\n\r\n"), L7_PROTO_HTTP);
+	EXPECT_EQ(classify(d, "POST /api HTTP/1.1\r\n"), L7_PROTO_HTTP);
+	EXPECT_EQ(classify(d, "HTTP/1.1 200 OK\r\n"), L7_PROTO_HTTP);
+	EXPECT_EQ(classify(d, "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"), L7_PROTO_HTTP);
+	EXPECT_EQ(classify(d, "GET"), L7_PROTO_UNKNOWN);
+	EXPECT_EQ(classify(d, "get / HTTP/1.1"), L7_PROTO_UNKNOWN);
+	EXPECT_EQ(classify(d, "GETTING "), L7_PROTO_UNKNOWN);
+}
+
+TEST(protodetect, tls)
+{
+	sinsp_protodetector d;
+	EXPECT_EQ(classify(d, std::string("\x16\x03\x01\x02\x00\x01\x00\x01\xfc\x03\x03", 11)), L7_PROTO_TLS);
+	EXPECT_EQ(classify(d, std::string("\x16\x03\x03\x00\x7a\x02\x00\x00\x76", 9)), L7_PROTO_TLS);
+	// application data, unknown version, not a hello, too short, not TCP
+	EXPECT_EQ(classify(d, std::string("\x17\x03\x03\x00\x20\x01", 6)), L7_PROTO_UNKNOWN);
+	EXPECT_EQ(classify(d, std::string("\x16\x03\x09\x00\x20\x01", 6)), L7_PROTO_UNKNOWN);
+	EXPECT_EQ(classify(d, std::string("\x16\x03\x03\x00\x20\x0b", 6)), L7_PROTO_UNKNOWN);
+	EXPECT_EQ(classify(d, std::string("\x16\x03\x03", 3)), L7_PROTO_UNKNOWN);
+	EXPECT_EQ(classify(d, std::string("\x16\x03\x01\x02\x00\x01", 6), SCAP_L4_UDP), L7_PROTO_UNKNOWN);
+}
+
+TEST(protodetect, dns)
+{
+	sinsp_protodetector d;
+	// query for example.com with the AD bit, and its response
+	std::string query("\x12\x34\x01\x20\x00\x01\x00\x00\x00\x00\x00\x01\x07" "example\x03" "com\x00\x00\x01\x00\x01", 29);
+	std::string response("\x12\x34\x81\x80\x00\x01\x00\x01\x00\x00\x00\x00\x07" "example\x03" "com\x00\x00\x01\x00\x01", 29);
+	EXPECT_EQ(classify(d, query, SCAP_L4_UDP), L7_PROTO_DNS);
+	EXPECT_EQ(classify(d, response, SCAP_L4_UDP), L7_PROTO_DNS);
+	EXPECT_EQ(classify(d, std::string("\x00\x1d", 2) + query, SCAP_L4_TCP), L7_PROTO_DNS);
+	EXPECT_EQ(classify(d, std::string("\x00\x1d", 2) + response, SCAP_L4_TCP), L7_PROTO_DNS);
+	// the signatures depend on the transport
+	EXPECT_EQ(classify(d, query, SCAP_L4_TCP), L7_PROTO_UNKNOWN);
+	// two questions
+	query[5] = 2;
+	EXPECT_EQ(classify(d, query, SCAP_L4_UDP), L7_PROTO_UNKNOWN);
+}
+
+TEST(protodetect, redis)
+{
+	sinsp_protodetector d;
+	EXPECT_EQ(classify(d, "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$1\r\nv\r\n"), L7_PROTO_REDIS);
+	EXPECT_EQ(classify(d, "+OK\r\n"), L7_PROTO_REDIS);
+	EXPECT_EQ(classify(d, "-ERR unknown command\r\n"), L7_PROTO_REDIS);
+	EXPECT_EQ(classify(d, "+OKAY"), L7_PROTO_UNKNOWN);
+	EXPECT_EQ(classify(d, "*\r\n"), L7_PROTO_UNKNOWN);
+}
+
+TEST(protodetect, custom_signatures)
+{
+	sinsp_protodetector d;
+	EXPECT_EQ(classify(d, "PING\r\n"), L7_PROTO_UNKNOWN);
+
+	const uint8_t ping[] = {'P', 'I', 'N', 'G', '\r', '\n'};
+	d.add_signature(L7_PROTO_REDIS, SCAP_L4_UNKNOWN, ping, NULL, sizeof(ping));
+	EXPECT_EQ(classify(d, "PING\r\n"), L7_PROTO_REDIS);
+
+	// the bits out of the mask are ignored, on the whole signature length
+	const uint8_t v[] = {'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p'};
+	const uint8_t m[] = {0xdf, 0xdf, 0xdf, 0xdf, 0xdf, 0xdf, 0xdf, 0xdf, 0xdf, 0xdf, 0xdf, 0xdf, 0xdf, 0xdf, 0xdf, 0xdf};
+	d.add_signature(L7_PROTO_HTTP, SCAP_L4_UNKNOWN, v, m, sizeof(v));
+	EXPECT_EQ(classify(d, "aBcDeFgHiJkLmNoP and more"), L7_PROTO_HTTP);
+	EXPECT_EQ(classify(d, "aBcDeFgHiJkLmNoQ and more"), L7_PROTO_UNKNOWN);
+	EXPECT_EQ(classify(d, "aBcDeFgHiJkLmNo"), L7_PROTO_UNKNOWN);
+
+	EXPECT_ANY_THROW(d.add_signature(L7_PROTO_HTTP, SCAP_L4_UNKNOWN, v, NULL, 0));
+	EXPECT_ANY_THROW(d.add_signature(L7_PROTO_HTTP, SCAP_L4_UNKNOWN, v, NULL, 17));
+
+	d.clear();
+	EXPECT_EQ(classify(d, "GET / HTTP/1.1\r\n"), L7_PROTO_UNKNOWN);
+	EXPECT_EQ(classify(d, ""), L7_PROTO_UNKNOWN);
+}
@@ -127,6 +127,24 @@ TEST(events_set, set_check_diff)
 	}
 }
 
+TEST(events_set, set_check_word_boundaries)
+{
+	auto codes = std::vector<ppm_sc_code>{(ppm_sc_code)0, (ppm_sc_code)63, (ppm_sc_code)64, (ppm_sc_code)(PPM_SC_MAX - 1)};
+	auto sc_set = libsinsp::events::set<ppm_sc_code>(codes);
+	ASSERT_EQ(sc_set.size(), codes.size());
+	ASSERT_EQ(std::vector<ppm_sc_code>(sc_set.begin(), sc_set.end()), codes);
+	for (auto val : codes) {
+		ASSERT_EQ(sc_set.data()[val], 1);
+	}
+	ASSERT_EQ(sc_set.data()[1], 0);
+
+	auto other = libsinsp::events::set<ppm_sc_code>{(ppm_sc_code)64, (ppm_sc_code)65};
+	sc_set.insert(other);
+	ASSERT_EQ(sc_set.size(), codes.size() + 1);
+	ASSERT_EQ(sc_set.intersect(other), other);
+	ASSERT_EQ(sc_set.diff(other).size(), codes.size() - 1);
+}
+
 TEST(events_set, names_to_event_set)
 {
 	auto event_set = libsinsp::events::names_to_event_set(std::unordered_set<std::string>{"openat","execveat"});
@@ -220,3 +220,86 @@ TEST(filter_ppm_codes, check_sinsp_repair_state_sc_set)
     ASSERT_PPM_SC_CODES_EQ(truth, sc_set);
 
 }
+
+TEST(filter_ppm_codes, check_sinsp_state_sc_set_features)
+{
+    auto proc_sc_set = libsinsp::events::sinsp_state_sc_set(0);
+    ASSERT_TRUE(proc_sc_set.contains(PPM_SC_EXECVE));
+    ASSERT_TRUE(proc_sc_set.contains(PPM_SC_SCHED_PROCESS_EXIT));
+    ASSERT_FALSE(proc_sc_set.contains(PPM_SC_CLOSE));
+    ASSERT_FALSE(proc_sc_set.contains(PPM_SC_SETUID));
+    ASSERT_TRUE(proc_sc_set.diff(libsinsp::events::sinsp_state_sc_set()).empty());
+
+    auto fds_sc_set = libsinsp::events::sinsp_state_sc_set(libsinsp::events::STATE_FDS);
+    ASSERT_TRUE(fds_sc_set.contains(PPM_SC_OPENAT));
+    ASSERT_TRUE(fds_sc_set.contains(PPM_SC_CLOSE));
+    ASSERT_TRUE(fds_sc_set.contains(PPM_SC_DUP2));
+    ASSERT_TRUE(fds_sc_set.contains(PPM_SC_FCNTL));
+    ASSERT_FALSE(fds_sc_set.contains(PPM_SC_CONNECT));
+    ASSERT_FALSE(fds_sc_set.contains(PPM_SC_READ));
+
+    // the network state implies the fd tables
+    auto net_sc_set = libsinsp::events::sinsp_state_sc_set(libsinsp::events::STATE_NET);
+    ASSERT_TRUE(fds_sc_set.diff(net_sc_set).empty());
+    ASSERT_TRUE(net_sc_set.contains(PPM_SC_CONNECT));
+    ASSERT_TRUE(net_sc_set.contains(PPM_SC_BIND));
+    ASSERT_TRUE(net_sc_set.contains(PPM_SC_GETSOCKOPT));
+
+    auto users_sc_set = libsinsp::events::sinsp_state_sc_set(libsinsp::events::STATE_USERS);
+    ASSERT_TRUE(users_sc_set.contains(PPM_SC_SETRESUID));
+    ASSERT_FALSE(users_sc_set.contains(PPM_SC_CAPSET));
+
+    auto caps_sc_set = libsinsp::events::sinsp_state_sc_set(libsinsp::events::STATE_CAPS);
+    ASSERT_TRUE(caps_sc_set.contains(PPM_SC_CAPSET));
+    ASSERT_TRUE(caps_sc_set.contains(PPM_SC_UNSHARE));
+
+    ASSERT_PPM_SC_CODES_EQ(proc_sc_set, libsinsp::events::sinsp_state_sc_set(libsinsp::events::STATE_CONTAINERS));
+}
+
+TEST(filter_ppm_codes, check_field_names_to_state_features)
+{
+    using namespace libsinsp::events;
+
+    ASSERT_EQ(field_names_to_state_features({"proc.name", "evt.type", "evt.rawarg.fd"}), 0);
+    ASSERT_EQ(field_names_to_state_features({"fd.name"}), STATE_FDS);
+    ASSERT_EQ(field_names_to_state_features({"evt.args"}), STATE_FDS);
+    ASSERT_EQ(field_names_to_state_features({"evt.arg.fd"}), STATE_FDS);
+    ASSERT_EQ(field_names_to_state_features({"fd.cip.name"}), STATE_FDS | STATE_NET);
+    ASSERT_EQ(field_names_to_state_features({"fdlist.sports"}), STATE_NET);
+    // only whole field names are matched
+    ASSERT_EQ(field_names_to_state_features({"fd.portname"}), STATE_FDS);
+    ASSERT_EQ(field_names_to_state_features({"evt.argsize"}), 0);
+    ASSERT_EQ(field_names_to_state_features({"user.name", "group.gid"}), STATE_USERS);
+    ASSERT_EQ(field_names_to_state_features({"thread.cap_effective"}), STATE_CAPS);
+    ASSERT_EQ(field_names_to_state_features({"container.id", "k8s.pod.name"}), STATE_CONTAINERS);
+}
+
+TEST(filter_ppm_codes, check_minimal_sc_set)
+{
+    sinsp inspector;
+
+    sinsp_filter_compiler open_compiler(&inspector, "evt.type in (open, openat) and fd.name = /etc/shadow");
+    std::unique_ptr<sinsp_filter> open_filter(open_compiler.compile());
+    sinsp_filter_compiler exec_compiler(&inspector, "evt.type = execve and user.name = root");
+    std::unique_ptr<sinsp_filter> exec_filter(exec_compiler.compile());
+    sinsp_evt_formatter formatter(&inspector, "%proc.name %container.id");
+
+    auto sc_set = libsinsp::events::minimal_sc_set({open_filter.get(), exec_filter.get()}, {&formatter});
+    auto truth = libsinsp::events::sinsp_state_sc_set(
+        libsinsp::events::STATE_FDS | libsinsp::events::STATE_USERS | libsinsp::events::STATE_CONTAINERS);
+    truth.insert(PPM_SC_OPEN);
+    truth.insert(PPM_SC_OPENAT);
+    ASSERT_PPM_SC_CODES_EQ(truth, sc_set);
+    ASSERT_FALSE(sc_set.contains(PPM_SC_CONNECT));
+
+    // explicit features are added to the ones of the fields
+    sc_set = libsinsp::events::minimal_sc_set({exec_filter.get()}, {}, libsinsp::events::STATE_NET);
+    ASSERT_TRUE(sc_set.contains(PPM_SC_CONNECT));
+    ASSERT_TRUE(sc_set.contains(PPM_SC_SETUID));
+
+    // a filter that doesn't check the event type matches every syscall
+    sinsp_filter_compiler any_compiler(&inspector, "proc.name = cat");
+    std::unique_ptr<sinsp_filter> any_filter(any_compiler.compile());
+    sc_set = libsinsp::events::minimal_sc_set({any_filter.get()}, {});
+    ASSERT_PPM_SC_CODES_EQ(libsinsp::events::all_sc_set(), sc_set);
+}
@@ -69,3 +69,59 @@ TEST(sinsp_logger, get_set_severity)
 	ASSERT_FALSE(logger.is_enabled(sinsp_logger::SEV_INFO));
 	ASSERT_TRUE(logger.is_enabled(sinsp_logger::SEV_ERROR));
 }
+
+static std::vector<std::string> s_logged;
+
+static void log_collect_fn(std::string&& str, const sinsp_logger::severity sev)
+{
+	s_logged.push_back(std::move(str));
+}
+
+TEST(sinsp_logger, callback_prefix)
+{
+	auto logger = sinsp_logger();
+	s_logged.clear();
+	logger.disable_timestamps();
+	logger.add_encoded_severity();
+	logger.add_callback_log(log_collect_fn);
+
+	logger.log("hello", sinsp_logger::SEV_ERROR);
+	logger.log(std::string("skipped"), sinsp_logger::SEV_DEBUG);
+	logger.format(sinsp_logger::SEV_WARNING, "n=%d", 42);
+	logger.format(sinsp_logger::SEV_TRACE, "n=%d", 43);
+
+	ASSERT_EQ(s_logged.size(), 2);
+	ASSERT_EQ(s_logged[0], "SEV_ERR hello");
+	ASSERT_EQ(s_logged[1], "SEV_WAR n=42");
+}
+
+TEST(sinsp_logger, async)
+{
+	auto logger = sinsp_logger();
+	s_logged.clear();
+	logger.disable_timestamps();
+	logger.add_callback_log(log_collect_fn);
+	logger.enable_async(64);
+	ASSERT_TRUE(logger.is_async());
+
+	for(int j = 0; j < 1000; j++)
+	{
+		logger.format(sinsp_logger::SEV_INFO, "msg %d", j);
+	}
+
+	logger.disable_async();
+	ASSERT_FALSE(logger.is_async());
+
+	// messages are either written in order or dropped when the ring is full
+	ASSERT_EQ(s_logged.size() + logger.get_async_dropped(), 1000);
+	int last = -1;
+	for(const auto& str : s_logged)
+	{
+		int n = std::stoi(str.substr(4));
+		ASSERT_GT(n, last);
+		last = n;
+	}
+
+	logger.log("sync", sinsp_logger::SEV_INFO);
+	ASSERT_EQ(s_logged.back(), "sync");
+}
@@ -0,0 +1,71 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sampling_controller.h"
+#include <gtest/gtest.h>
+
+TEST(sampling_controller, raise_on_fill)
+{
+	sampling_controller sc;
+	sc.init(0.75, 0.25, 3, 8);
+
+	EXPECT_EQ(sc.get_ratio(), 1);
+	EXPECT_EQ(sc.update(0.5, 0), 1);
+	EXPECT_EQ(sc.update(0.8, 0), 2);
+	EXPECT_EQ(sc.update(0.9, 0), 4);
+	EXPECT_EQ(sc.update(1.0, 0), 8);
+
+	// capped to the max ratio
+	EXPECT_EQ(sc.update(1.0, 0), 8);
+}
+
+TEST(sampling_controller, raise_on_drops)
+{
+	sampling_controller sc;
+	sc.init(0.75, 0.25, 3, 128);
+
+	// the first update only records the drop counter
+	EXPECT_EQ(sc.update(0.5, 100), 1);
+	EXPECT_EQ(sc.update(0.5, 100), 1);
+	EXPECT_EQ(sc.update(0.5, 150), 2);
+	EXPECT_EQ(sc.update(0.5, 150), 2);
+}
+
+TEST(sampling_controller, lower_when_calm)
+{
+	sampling_controller sc;
+	sc.init(0.75, 0.25, 3, 128);
+
+	EXPECT_EQ(sc.update(0.9, 0), 2);
+	EXPECT_EQ(sc.update(0.9, 0), 4);
+
+	// needs 3 consecutive calm updates
+	EXPECT_EQ(sc.update(0.1, 0), 4);
+	EXPECT_EQ(sc.update(0.1, 0), 4);
+	EXPECT_EQ(sc.update(0.5, 0), 4);
+	EXPECT_EQ(sc.update(0.1, 0), 4);
+	EXPECT_EQ(sc.update(0.1, 0), 4);
+	EXPECT_EQ(sc.update(0.1, 0), 2);
+	EXPECT_EQ(sc.update(0.1, 0), 2);
+	EXPECT_EQ(sc.update(0.1, 0), 2);
+	EXPECT_EQ(sc.update(0.1, 0), 1);
+	EXPECT_EQ(sc.update(0.1, 0), 1);
+
+	sc.update(0.9, 0);
+	sc.reset();
+	EXPECT_EQ(sc.get_ratio(), 1);
+}
@@ -16,6 +16,7 @@ limitations under the License.
 */
 
 #include <gtest/gtest.h>
+#include <arpa/inet.h>
 #include "utils.h"
 
 // copy_and_sanitize_path is not exported in utils.h
@@ -137,3 +138,65 @@ TEST(sinsp_utils_test, copy_and_sanitize_path)
 	copy_and_sanitize_path(target, target, path.c_str(), '/');
 	EXPECT_EQ("/dir/...", std::string(target));
 }
+
+TEST(sinsp_utils_test, ip_to_chars)
+{
+	const char* addrs[] = {
+		"::",
+		"::1",
+		"1::",
+		"::ffff:10.0.0.1",
+		"::10.0.0.1",
+		"::0.0.0.1",
+		"2001:db8::1",
+		"2001:db8:0:1:0:0:0:1",
+		"2001:0:0:1:0:0:0:1",
+		"2001:db8:1:2:3:4:5:6",
+		"fe80::abcd:0:0:1",
+		"ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff",
+	};
+
+	for(const char* addr : addrs)
+	{
+		uint8_t raw[16];
+		ASSERT_EQ(inet_pton(AF_INET6, addr, raw), 1);
+
+		char expected[INET6_ADDRSTRLEN];
+		ASSERT_NE(inet_ntop(AF_INET6, raw, expected, sizeof(expected)), nullptr);
+
+		char buf[INET6_ADDRSTRLEN];
+		*sinsp_utils::ipv6_to_chars(buf, raw) = 0;
+		EXPECT_STREQ(buf, expected);
+	}
+
+	uint8_t raw4[] = {192, 168, 0, 255};
+	char buf[INET_ADDRSTRLEN];
+	*sinsp_utils::ipv4_to_chars(buf, raw4) = 0;
+	EXPECT_STREQ(buf, "192.168.0.255");
+}
+
+TEST(sinsp_utils_test, ts_to_string)
+{
+	std::string res;
+	std::string prev;
+	uint64_t ts = 1700000000000000005ULL;
+
+	// the events of the same second only differ by the nanoseconds
+	sinsp_utils::ts_to_string(ts, &prev, true, true);
+	sinsp_utils::ts_to_string(ts + 123456789, &res, true, true);
+	ASSERT_EQ(res.size(), prev.size());
+	EXPECT_EQ(res.substr(0, res.size() - 9), prev.substr(0, prev.size() - 9));
+	EXPECT_EQ(prev.substr(prev.size() - 10), ".000000005");
+	EXPECT_EQ(res.substr(res.size() - 10), ".123456794");
+
+	// with and without the date
+	sinsp_utils::ts_to_string(ts, &res, false, false);
+	EXPECT_EQ(res, prev.substr(11, 8));
+	sinsp_utils::ts_to_string(ts, &res, true, false);
+	EXPECT_EQ(res, prev.substr(0, 19));
+
+	sinsp_utils::ts_to_iso_8601(ts, &res);
+	EXPECT_EQ(res, "2023-11-14T22:13:20.000000005+0000");
+	sinsp_utils::ts_to_iso_8601(ts + 1000000000ULL, &res);
+	EXPECT_EQ(res, "2023-11-14T22:13:21.000000005+0000");
+}
@@ -18,6 +18,7 @@ limitations under the License.
 #pragma once
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <stdexcept>
 
 #include "scap.h"
@@ -26,6 +27,21 @@ limitations under the License.
 #include "strlcpy.h"
 #include "test_utils.h"
 
+// Reaches the internals of the inspector (see the friends of sinsp)
+class test_helper
+{
+public:
+	static void save_state_snapshot(sinsp& inspector)
+	{
+		inspector.save_state_snapshot();
+	}
+
+	static void fseek(sinsp& inspector, uint64_t filepos)
+	{
+		inspector.fseek(filepos);
+	}
+};
+
 class sinsp_with_test_input : public ::testing::Test {
 protected:
 	void SetUp() override
@@ -38,6 +54,7 @@ protected:
 
 		m_test_timestamp = 1566230400000000000;
 		m_last_recorded_timestamp = 0;
+		m_allow_unordered_events = false;
 	}
 
 	void TearDown() override
@@ -101,7 +118,7 @@ protected:
 		va_list args2;
 		va_copy(args2, args);
 
-		if (ts <= m_last_recorded_timestamp) {
+		if (ts <= m_last_recorded_timestamp && !m_allow_unordered_events) {
 			va_end(args2);
 			throw std::runtime_error("the test framework does not currently support equal timestamps or out of order events");
 		}
@@ -138,7 +155,7 @@ protected:
 		m_events.push_back(event);
 		m_test_data->events = m_events.data() + evtoffset;
 		m_test_data->event_count = m_events.size() - evtoffset;
-		m_last_recorded_timestamp = ts;
+		m_last_recorded_timestamp = std::max(m_last_recorded_timestamp, ts);
 
 		va_end(args2);
 		return event;
@@ -288,6 +305,13 @@ protected:
 		return result;
 	}
 
+	bool eval_filter(sinsp_evt *evt, const std::string& filter_str)
+	{
+		sinsp_filter_compiler compiler(&m_inspector, filter_str);
+		std::unique_ptr<sinsp_filter> filter(compiler.compile());
+		return filter->run(evt);
+	}
+
 	sinsp_evt *next_event()
 	{
 		sinsp_evt *evt;
@@ -304,4 +328,7 @@ protected:
 
 	uint64_t m_test_timestamp;
 	uint64_t m_last_recorded_timestamp;
+	// lets add_event() take equal timestamps and out of order events,
+	// add_event_advance_ts() can't find them reliably
+	bool m_allow_unordered_events;
 };
@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "snaplen_controller.h"
+#include <gtest/gtest.h>
+
+static const uint32_t NO_LIMIT = snaplen_controller::NO_LIMIT;
+
+TEST(snaplen_controller, lower_on_fill)
+{
+	snaplen_controller sc;
+	sc.init(0.75, 0.25, 3, 16);
+	sc.set_max_snaplen(80);
+
+	EXPECT_EQ(sc.get_limit(0), NO_LIMIT);
+	EXPECT_EQ(sc.update(0, 0.5, 1), NO_LIMIT);
+	EXPECT_EQ(sc.update(0, 0.8, 2), 80);
+	EXPECT_EQ(sc.update(0, 0.9, 3), 40);
+	EXPECT_EQ(sc.update(0, 0.9, 4), 20);
+	EXPECT_EQ(sc.update(0, 1.0, 5), 16);
+
+	// capped to the min snaplen
+	EXPECT_EQ(sc.update(0, 1.0, 6), 16);
+
+	// the other buffers are left alone
+	EXPECT_EQ(sc.get_limit(1), NO_LIMIT);
+	EXPECT_EQ(sc.update(1, 0.1, 6), NO_LIMIT);
+}
+
+TEST(snaplen_controller, restore_when_calm)
+{
+	snaplen_controller sc;
+	sc.init(0.75, 0.25, 3, 16);
+	sc.set_max_snaplen(80);
+
+	EXPECT_EQ(sc.update(2, 0.9, 1), 80);
+	EXPECT_EQ(sc.update(2, 0.9, 2), 40);
+
+	// needs 3 consecutive calm updates
+	EXPECT_EQ(sc.update(2, 0.1, 3), 40);
+	EXPECT_EQ(sc.update(2, 0.5, 4), 40);
+	EXPECT_EQ(sc.update(2, 0.1, 5), 40);
+	EXPECT_EQ(sc.update(2, 0.1, 6), 40);
+	EXPECT_EQ(sc.update(2, 0.1, 7), NO_LIMIT);
+	EXPECT_EQ(sc.update(2, 0.1, 8), NO_LIMIT);
+
+	EXPECT_EQ(sc.update(2, 0.9, 9), 80);
+	sc.reset();
+	EXPECT_EQ(sc.get_limit(2), NO_LIMIT);
+}
+
+TEST(snaplen_controller, limit_at_ts)
+{
+	snaplen_controller sc;
+	sc.init(0.75, 0.25, 1, 16);
+	sc.set_max_snaplen(64);
+
+	EXPECT_EQ(sc.update(0, 0.9, 100), 64);
+	EXPECT_EQ(sc.update(0, 0.9, 200), 32);
+
+	// the events captured before the last change got the previous limit
+	EXPECT_EQ(sc.get_limit(0, 150), 64);
+	EXPECT_EQ(sc.get_limit(0, 200), 32);
+	EXPECT_EQ(sc.get_limit(0, 250), 32);
+
+	EXPECT_EQ(sc.update(0, 0.1, 300), NO_LIMIT);
+	EXPECT_EQ(sc.get_limit(0, 250), 32);
+	EXPECT_EQ(sc.get_limit(0, 300), NO_LIMIT);
+	EXPECT_EQ(sc.get_limit(7, 300), NO_LIMIT);
+}
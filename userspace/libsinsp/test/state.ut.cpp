@@ -189,6 +189,53 @@ TEST(dynamic_struct, defs_and_access)
     ASSERT_ANY_THROW(s.get_dynamic_field(acc_num2));
 }
 
+TEST(dynamic_struct, layout_and_lifetime)
+{
+    auto fields = std::make_shared<libsinsp::state::dynamic_struct::field_infos>();
+
+    struct sample_struct: public libsinsp::state::dynamic_struct
+    {
+    public:
+        sample_struct(const std::shared_ptr<field_infos>& i): dynamic_struct(i) { }
+    };
+
+    // fields are aligned in order of definition
+    auto acc_u8 = fields->add_field<uint8_t>("u8").new_accessor<uint8_t>();
+    auto acc_str = fields->add_field<std::string>("str").new_accessor<std::string>();
+    auto acc_u16 = fields->add_field<uint16_t>("u16").new_accessor<uint16_t>();
+    auto acc_u64 = fields->add_field<uint64_t>("u64").new_accessor<uint64_t>();
+
+    sample_struct s(fields);
+    s.set_dynamic_field(acc_u8, (uint8_t) 1);
+    s.set_dynamic_field(acc_str, std::string("a string too long for small string optimizations"));
+    s.set_dynamic_field(acc_u16, (uint16_t) 2);
+    s.set_dynamic_field(acc_u64, (uint64_t) 3);
+    ASSERT_EQ(s.get_dynamic_field(acc_u8), 1);
+    ASSERT_EQ(s.get_dynamic_field(acc_str), "a string too long for small string optimizations");
+    ASSERT_EQ(s.get_dynamic_field(acc_u16), 2);
+    ASSERT_EQ(s.get_dynamic_field(acc_u64), 3);
+
+    // fields defined after the first access keep the values of the others
+    auto acc_str2 = fields->add_field<std::string>("str2").new_accessor<std::string>();
+    auto acc_bool = fields->add_field<bool>("bool").new_accessor<bool>();
+    ASSERT_EQ(s.get_dynamic_field(acc_bool), false);
+    ASSERT_EQ(s.get_dynamic_field(acc_str2), "");
+    ASSERT_EQ(s.get_dynamic_field(acc_str), "a string too long for small string optimizations");
+    ASSERT_EQ(s.get_dynamic_field(acc_u64), 3);
+
+    // copies own their values
+    sample_struct c(s);
+    c.set_dynamic_field(acc_str, std::string("copy"));
+    ASSERT_EQ(c.get_dynamic_field(acc_u16), 2);
+    ASSERT_EQ(s.get_dynamic_field(acc_str), "a string too long for small string optimizations");
+    c = s;
+    ASSERT_EQ(c.get_dynamic_field(acc_str), "a string too long for small string optimizations");
+
+    sample_struct m(std::move(c));
+    ASSERT_EQ(m.get_dynamic_field(acc_str), "a string too long for small string optimizations");
+    ASSERT_EQ(m.get_dynamic_field(acc_u8), 1);
+}
+
 TEST(table_registry, defs_and_access)
 {
     class sample_table: public libsinsp::state::table<uint64_t>
@@ -267,7 +314,7 @@ TEST(thread_manager, table_access)
 {
     // note: used for regression checks, keep this updated as we make
     // new fields available
-    static const int s_threadinfo_static_fields_count = 20;
+    static const int s_threadinfo_static_fields_count = 23;
 
     sinsp inspector;
     auto table = static_cast<libsinsp::state::table<int64_t>*>(inspector.m_thread_manager);
@@ -280,6 +327,7 @@ TEST(thread_manager, table_access)
     ASSERT_EQ(table->dynamic_fields()->fields().size(), 0);
     ASSERT_EQ(table->entries_count(), 0);
     ASSERT_EQ(table->get_entry(999), nullptr);
+    ASSERT_EQ(table->get_entry_ptr(999), nullptr);
     ASSERT_EQ(table->erase_entry(999), false);
 
     // create and add a thread
@@ -299,6 +347,7 @@ TEST(thread_manager, table_access)
     ASSERT_EQ(table->entries_count(), 1);
     auto addedt = table->get_entry(999);
     ASSERT_NE(addedt, nullptr);
+    ASSERT_EQ(table->get_entry_ptr(999), addedt.get());
     ASSERT_EQ(addedt->get_static_field(tid_acc), (int64_t) 999);
     ASSERT_EQ(addedt->get_static_field(comm_acc), "test");
 
@@ -0,0 +1,125 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include <thread>
+#include <vector>
+
+#include "state_event_queue.h"
+#include "event.h"
+#include <gtest/gtest.h>
+
+TEST(state_event_queue, order)
+{
+	state_event_queue q(4);
+	std::shared_ptr<sinsp_evt> evt;
+
+	EXPECT_TRUE(q.empty());
+	EXPECT_FALSE(q.try_pop(evt));
+
+	// the events past the capacity of the ring overflow, in order
+	std::vector<std::shared_ptr<sinsp_evt>> evts;
+	for(int i = 0; i < 6; i++)
+	{
+		evts.push_back(std::make_shared<sinsp_evt>());
+		q.push(evts.back());
+	}
+	EXPECT_FALSE(q.empty());
+	EXPECT_EQ(q.get_num_overflows(), 2);
+
+	for(int i = 0; i < 3; i++)
+	{
+		ASSERT_TRUE(q.try_pop(evt));
+		EXPECT_EQ(evt, evts[i]);
+	}
+
+	// while overflowing, the new events follow the overflowed ones
+	evts.push_back(std::make_shared<sinsp_evt>());
+	q.push(evts.back());
+	EXPECT_EQ(q.get_num_overflows(), 3);
+	for(int i = 3; i < 7; i++)
+	{
+		ASSERT_TRUE(q.try_pop(evt));
+		EXPECT_EQ(evt, evts[i]);
+	}
+	EXPECT_TRUE(q.empty());
+	EXPECT_FALSE(q.try_pop(evt));
+
+	// then the ring is used again
+	q.push(evts[0]);
+	EXPECT_EQ(q.get_num_overflows(), 3);
+	ASSERT_TRUE(q.try_pop(evt));
+	EXPECT_EQ(evt, evts[0]);
+}
+
+TEST(state_event_queue, producers)
+{
+	const int num_threads = 4;
+	const int num_evts = 10000;
+	state_event_queue q(64);
+
+	std::vector<std::vector<std::shared_ptr<sinsp_evt>>> evts(num_threads);
+	for(auto& v : evts)
+	{
+		for(int i = 0; i < num_evts; i++)
+		{
+			v.push_back(std::make_shared<sinsp_evt>());
+		}
+	}
+
+	std::vector<std::thread> producers;
+	for(int t = 0; t < num_threads; t++)
+	{
+		producers.emplace_back([&q, &evts, t]()
+		{
+			for(const auto& evt : evts[t])
+			{
+				q.push(evt);
+			}
+		});
+	}
+
+	// every event is read once, and the ones of a producer in order
+	std::vector<size_t> next(num_threads, 0);
+	std::shared_ptr<sinsp_evt> evt;
+	int read = 0;
+	while(read < num_threads * num_evts)
+	{
+		if(!q.try_pop(evt))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		bool found = false;
+		for(int t = 0; t < num_threads; t++)
+		{
+			if(next[t] < evts[t].size() && evts[t][next[t]] == evt)
+			{
+				next[t]++;
+				found = true;
+				break;
+			}
+		}
+		ASSERT_TRUE(found);
+		read++;
+	}
+
+	for(auto& p : producers)
+	{
+		p.join();
+	}
+	EXPECT_TRUE(q.empty());
+}
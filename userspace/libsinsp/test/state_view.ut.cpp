@@ -0,0 +1,100 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "sinsp_with_test_input.h"
+#include "state_view.h"
+
+TEST_F(sinsp_with_test_input, state_view_publish)
+{
+	add_default_init_thread();
+	add_thread(create_threadinfo(100, 100, 1, 100, 100, 100, "nginx", "/usr/sbin/nginx", "/usr/sbin/nginx",
+				     increasing_ts(), 0, 0), {});
+	open_inspector();
+
+	ASSERT_EQ(m_inspector.get_state_view(), nullptr);
+	m_inspector.set_state_view_interval(1);
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/etc/passwd", 0, 0);
+	auto first = m_inspector.get_state_view();
+	ASSERT_NE(first, nullptr);
+	ASSERT_EQ(first->get_epoch(), 1u);
+
+	const state_view::thread* nginx = first->get_thread(100);
+	ASSERT_NE(nginx, nullptr);
+	ASSERT_EQ(nginx->m_pid, 100);
+	ASSERT_EQ(nginx->m_ptid, 1);
+	ASSERT_EQ(nginx->m_comm, "nginx");
+	ASSERT_EQ(nginx->m_exepath, "/usr/sbin/nginx");
+	ASSERT_NE(first->get_thread(1), nullptr);
+	ASSERT_EQ(first->get_thread(200), nullptr);
+
+	// The record of the thread that wasn't accessed is shared
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/etc/group", 0, 0);
+	auto second = m_inspector.get_state_view();
+	ASSERT_NE(second, first);
+	ASSERT_EQ(second->get_epoch(), 2u);
+	ASSERT_EQ(second->get_thread(100), nginx);
+	ASSERT_NE(second->get_thread(1), first->get_thread(1));
+
+	// The held view is still there, and unchanged
+	ASSERT_EQ(first->get_epoch(), 1u);
+	ASSERT_EQ(first->get_thread(100), nginx);
+
+	m_inspector.set_state_view_interval(0);
+	ASSERT_EQ(m_inspector.get_state_view(), nullptr);
+}
+
+TEST_F(sinsp_with_test_input, state_view_concurrent_readers)
+{
+	add_default_init_thread();
+	open_inspector();
+	m_inspector.set_state_view_interval(1);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/etc/passwd", 0, 0);
+
+	std::atomic<bool> done(false);
+	std::atomic<bool> failed(false);
+	std::thread reader([&]() {
+		uint64_t last_epoch = 0;
+		while(!done)
+		{
+			auto view = m_inspector.get_state_view();
+			if(view == nullptr || view->get_epoch() < last_epoch || view->get_thread(1) == nullptr)
+			{
+				failed = true;
+			}
+			else
+			{
+				last_epoch = view->get_epoch();
+			}
+		}
+	});
+
+	for(int i = 0; i < 1000; i++)
+	{
+		add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/etc/passwd", 0, 0);
+	}
+	done = true;
+	reader.join();
+
+	ASSERT_FALSE(failed);
+	ASSERT_EQ(m_inspector.get_state_view()->get_epoch(), 1001u);
+}
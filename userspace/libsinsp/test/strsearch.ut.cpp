@@ -0,0 +1,117 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "strsearch.h"
+
+using namespace libsinsp::strsearch;
+
+static const kernel all_kernels[] = {kernel::SCALAR, kernel::SSE2, kernel::AVX2, kernel::NEON};
+
+static size_t reference_find(const std::string& h, const std::string& n, bool icase)
+{
+	auto lower = [](std::string s)
+	{
+		for(auto& c : s)
+		{
+			c = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+		}
+		return s;
+	};
+	return icase ? lower(h).find(lower(n)) : h.find(n);
+}
+
+static void check(const std::string& h, const std::string& n)
+{
+	for(bool icase : {false, true})
+	{
+		// the search must not read past the end of the haystack
+		std::vector<char> buf(h.begin(), h.end());
+		const char* res = icase ? ifind(buf.data(), buf.size(), n.data(), n.size())
+					: find(buf.data(), buf.size(), n.data(), n.size());
+		size_t expected = reference_find(h, n, icase);
+		if(expected == std::string::npos)
+		{
+			ASSERT_EQ(res, nullptr) << to_string(get_kernel()) << " icase=" << icase
+				<< " haystack=" << h << " needle=" << n;
+		}
+		else
+		{
+			ASSERT_EQ(res, buf.data() + expected) << to_string(get_kernel()) << " icase=" << icase
+				<< " haystack=" << h << " needle=" << n;
+		}
+	}
+}
+
+TEST(strsearch, dispatch)
+{
+	ASSERT_TRUE(is_supported(kernel::SCALAR));
+	ASSERT_TRUE(is_supported(get_kernel()));
+	kernel k = get_kernel();
+	ASSERT_TRUE(set_kernel(kernel::SCALAR));
+	ASSERT_EQ(get_kernel(), kernel::SCALAR);
+	ASSERT_TRUE(set_kernel(k));
+}
+
+TEST(strsearch, kernels)
+{
+	kernel prev = get_kernel();
+	std::mt19937 rng(42);
+	for(kernel k : all_kernels)
+	{
+		if(!set_kernel(k))
+		{
+			continue;
+		}
+
+		check("", "");
+		check("abc", "");
+		check("", "a");
+		check("/etc/shadow", "/etc/shadow");
+		check("/etc/shadow", "/etc/shadow2");
+		check("/usr/bin/nc -l -p 4444", "nc -l");
+		check("/USR/BIN/NC -L -P 4444", "nc -l");
+		check("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", "aab");
+		check("xyz@[\\]^_`{}~AZaz", "`{");
+		check("xyz@[\\]^_`{}~AZaz", "@[");
+		check(std::string(100, 'a') + "Needle" + std::string(3, 'b'), "needle");
+		check(std::string("with\0nul\0bytes", 14), std::string("l\0b", 3));
+
+		// match at all the positions around the block boundaries
+		std::uniform_int_distribution<int> chars('a', 'd');
+		for(size_t len = 0; len < 100; len++)
+		{
+			std::string h;
+			for(size_t i = 0; i < len; i++)
+			{
+				h += (char)chars(rng);
+			}
+			for(size_t nlen = 1; nlen < 6 && nlen <= len; nlen++)
+			{
+				check(h, h.substr(len - nlen));
+				check(h, h.substr(len / 2, nlen));
+				check(h, "cdab" + std::string(1, (char)chars(rng)));
+			}
+		}
+	}
+	set_kernel(prev);
+}
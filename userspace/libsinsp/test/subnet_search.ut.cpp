@@ -0,0 +1,117 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <random>
+
+#include "subnet_search.h"
+
+static uint32_t ipv4(const char* str)
+{
+	uint32_t addr;
+	EXPECT_EQ(inet_pton(AF_INET, str, &addr), 1);
+	return addr;
+}
+
+static ipv4net ipv4_net(const char* str, uint32_t prefix_len)
+{
+	return ipv4net{ipv4(str), prefix_len == 0 ? 0 : htonl(0xffffffff << (32 - prefix_len))};
+}
+
+TEST(subnet_search, ipv4)
+{
+	subnet_search s;
+	ASSERT_TRUE(s.empty());
+	ASSERT_FALSE(s.match(ipv4("10.1.2.3")));
+
+	s.add(ipv4_net("10.0.0.0", 8), 2);
+	s.add(ipv4_net("10.1.0.0", 16), 1);
+	s.add(ipv4_net("192.168.1.7", 32), 3);
+	ASSERT_FALSE(s.empty());
+
+	// the smallest value among the containing subnets wins
+	ASSERT_EQ(s.find(ipv4("10.1.2.3")), 1);
+	ASSERT_EQ(s.find(ipv4("10.2.2.3")), 2);
+	ASSERT_EQ(s.find(ipv4("192.168.1.7")), 3);
+	ASSERT_EQ(s.find(ipv4("192.168.1.8")), -1);
+	ASSERT_EQ(s.find(ipv4("11.0.0.0")), -1);
+
+	s.add(ipv4_net("0.0.0.0", 0), 0);
+	ASSERT_EQ(s.find(ipv4("11.0.0.0")), 0);
+
+	s.clear();
+	ASSERT_TRUE(s.empty());
+	ASSERT_FALSE(s.match(ipv4("10.1.2.3")));
+}
+
+TEST(subnet_search, ipv4_noncontiguous_netmask)
+{
+	subnet_search s;
+	s.add(ipv4net{ipv4("10.0.0.1"), ipv4("255.0.0.255")}, 4);
+	ASSERT_EQ(s.find(ipv4("10.20.30.1")), 4);
+	ASSERT_FALSE(s.match(ipv4("10.20.30.2")));
+}
+
+TEST(subnet_search, ipv6)
+{
+	subnet_search s;
+	s.add(ipv6net("2001:db8::/32"), 1);
+	s.add(ipv6net("2001:db8:aaaa::/60"), 0);
+	s.add(ipv6addr("::1"), 128, 2);
+
+	ASSERT_EQ(s.find(ipv6addr("2001:db8::1")), 1);
+	ASSERT_EQ(s.find(ipv6addr("2001:db8:aaaa:f::1")), 0);
+	ASSERT_EQ(s.find(ipv6addr("2001:db8:aaaa:10::1")), 1);
+	ASSERT_EQ(s.find(ipv6addr("::1")), 2);
+	ASSERT_FALSE(s.match(ipv6addr("::2")));
+	ASSERT_FALSE(s.match(ipv6addr("2001:db9::1")));
+
+	// the two families are kept apart
+	ASSERT_FALSE(s.match(ipv4("32.1.13.184")));
+}
+
+TEST(subnet_search, same_as_linear_scan)
+{
+	// overlapping and nested subnets, compared with a scan of the list
+	std::mt19937 gen(42);
+	std::vector<std::pair<ipv4net, uint32_t>> nets;
+	subnet_search s;
+	for(uint32_t i = 0; i < 10000; i++)
+	{
+		uint32_t prefix_len = gen() % 33;
+		uint32_t mask = prefix_len == 0 ? 0 : 0xffffffff << (32 - prefix_len);
+		ipv4net net{htonl(gen() & 0xff0f0f0f), htonl(mask)};
+		nets.emplace_back(net, i);
+		s.add(net, i);
+	}
+
+	for(uint32_t i = 0; i < 10000; i++)
+	{
+		uint32_t addr = (i % 2) ? htonl(gen() & 0xff0f0f0f) : nets[gen() % nets.size()].first.m_ip;
+		int64_t expected = -1;
+		for(const auto& net : nets)
+		{
+			if((addr & net.first.m_netmask) == (net.first.m_ip & net.first.m_netmask))
+			{
+				expected = net.second;
+				break;
+			}
+		}
+		ASSERT_EQ(s.find(addr), expected);
+	}
+}
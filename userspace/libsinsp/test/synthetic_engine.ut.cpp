@@ -0,0 +1,130 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "sinsp.h"
+
+static std::vector<std::string> synthetic_events(const scap_synthetic_engine_params& params)
+{
+	sinsp inspector;
+	inspector.open_synthetic(params);
+
+	std::vector<std::string> events;
+	sinsp_evt* evt = nullptr;
+	int32_t res;
+	while((res = inspector.next(&evt)) != SCAP_EOF)
+	{
+		EXPECT_EQ(res, SCAP_SUCCESS);
+		if(res != SCAP_SUCCESS)
+		{
+			break;
+		}
+		events.push_back(std::to_string(evt->get_ts()) + " " + std::to_string(evt->get_tid()) + " " +
+				 evt->get_name() + " " + evt->get_param_value_str("fd", false));
+	}
+	inspector.close();
+	return events;
+}
+
+TEST(synthetic_engine, deterministic)
+{
+	scap_synthetic_engine_params params = {};
+	params.seed = 42;
+	params.max_events = 5000;
+
+	auto first = synthetic_events(params);
+	ASSERT_EQ(first.size(), 5000);
+	ASSERT_EQ(synthetic_events(params), first);
+
+	params.seed = 43;
+	ASSERT_NE(synthetic_events(params), first);
+}
+
+TEST(synthetic_engine, state)
+{
+	scap_synthetic_engine_params params = {};
+	params.seed = 7;
+	params.max_events = 50000;
+	params.n_processes = 8;
+	params.fds_per_process = 4;
+
+	sinsp inspector;
+	inspector.open_synthetic(params);
+
+	// The initial processes come from the engine
+	ASSERT_NE(inspector.get_thread_ref(1), nullptr);
+	ASSERT_NE(inspector.get_thread_ref(100), nullptr);
+	ASSERT_EQ(inspector.get_thread_ref(100)->m_comm, "nginx");
+
+	uint64_t n_io = 0;
+	uint64_t n_clones = 0;
+	uint64_t n_exits = 0;
+	uint64_t n_execs = 0;
+	sinsp_evt* evt = nullptr;
+	int32_t res;
+	while((res = inspector.next(&evt)) != SCAP_EOF)
+	{
+		ASSERT_EQ(res, SCAP_SUCCESS);
+		switch(evt->get_type())
+		{
+		case PPME_SYSCALL_READ_X:
+		case PPME_SYSCALL_WRITE_X:
+		case PPME_SOCKET_CONNECT_X:
+			// Every fd used was opened by a previous event of the process, or its parent
+			ASSERT_NE(evt->get_fd_info(), nullptr);
+			n_io++;
+			break;
+		case PPME_SYSCALL_CLONE_20_X:
+			n_clones++;
+			break;
+		case PPME_PROCEXIT_1_E:
+			n_exits++;
+			break;
+		case PPME_SYSCALL_EXECVE_19_X:
+			n_execs++;
+			break;
+		default:
+			break;
+		}
+	}
+
+	ASSERT_GT(n_io, 0);
+	ASSERT_GT(n_clones, 0);
+	ASSERT_GT(n_exits, 0);
+	ASSERT_GT(n_execs, 0);
+
+	scap_stats stats;
+	inspector.get_capture_stats(&stats);
+	ASSERT_EQ(stats.n_evts, params.max_events);
+	inspector.close();
+}
+
+TEST(synthetic_engine, weights)
+{
+	scap_synthetic_engine_params params = {};
+	params.max_events = 1000;
+	params.exec_weight = 1;
+
+	for(const auto& event : synthetic_events(params))
+	{
+		ASSERT_NE(event.find(" execve "), std::string::npos);
+	}
+}
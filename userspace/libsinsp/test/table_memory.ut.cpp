@@ -0,0 +1,209 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+
+#include "sinsp_with_test_input.h"
+#include "table_memory.h"
+#include "strlcpy.h"
+
+TEST(sinsp_table_memory, accounting)
+{
+	sinsp_table_memory memory;
+	memory.add(100);
+	memory.add(50);
+	EXPECT_EQ(memory.get_bytes(), 150);
+	EXPECT_EQ(memory.get_entries(), 2);
+
+	memory.remove(100);
+	EXPECT_EQ(memory.get_bytes(), 50);
+	EXPECT_EQ(memory.get_entries(), 1);
+
+	// never wraps around
+	memory.remove(100, 2);
+	EXPECT_EQ(memory.get_bytes(), 0);
+	EXPECT_EQ(memory.get_entries(), 0);
+
+	EXPECT_FALSE(memory.over_budget());
+	memory.set_budget(10);
+	EXPECT_FALSE(memory.over_budget());
+	memory.add(10);
+	EXPECT_TRUE(memory.over_budget());
+	memory.set_budget(0);
+	EXPECT_FALSE(memory.over_budget());
+}
+
+TEST_F(sinsp_with_test_input, table_memory_fds)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	const sinsp_table_memory& fds = m_inspector.get_table_memory(SINSP_TABLE_FDS);
+	const sinsp_table_memory& threads = m_inspector.get_table_memory(SINSP_TABLE_THREADS);
+	EXPECT_EQ(threads.get_entries(), 1);
+	EXPECT_GE(threads.get_bytes(), sizeof(sinsp_threadinfo));
+	uint64_t bytes = fds.get_bytes();
+	uint64_t entries = fds.get_entries();
+
+	std::string path = "/tmp/" + std::string(256, 'a');
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, path.c_str(), PPM_O_RDWR, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (int64_t)3, path.c_str(), PPM_O_RDWR, 0, 5, (uint64_t)123);
+	EXPECT_EQ(fds.get_entries(), entries + 1);
+	EXPECT_GT(fds.get_bytes(), bytes + sizeof(sinsp_fdinfo_t) + path.size());
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, (int64_t)3);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	// the fd is removed when the next event comes
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_READ_E, 2, (int64_t)3, (uint32_t)64);
+	EXPECT_EQ(fds.get_entries(), entries);
+	EXPECT_EQ(fds.get_bytes(), bytes);
+
+	// over the budget, the new fds are refused
+	m_inspector.set_memory_budget(SINSP_TABLE_FDS, bytes);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (int64_t)4, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	EXPECT_EQ(m_inspector.get_thread_ref(1, false, true)->get_fd(4), nullptr);
+	EXPECT_EQ(fds.get_entries(), entries);
+	EXPECT_EQ(fds.get_budget_drops(), 1);
+
+	uint32_t nstats = 0;
+	const scap_stats_v2* stats = m_inspector.get_memory_stats(&nstats);
+	ASSERT_EQ(nstats, SINSP_TABLE_MAX * 5);
+	EXPECT_STREQ(stats[5].name, "memory.fds.bytes");
+	EXPECT_EQ(stats[5].value.u64, bytes);
+	EXPECT_STREQ(stats[7].name, "memory.fds.budget_bytes");
+	EXPECT_EQ(stats[7].value.u64, bytes);
+	EXPECT_STREQ(stats[8].name, "memory.fds.budget_drops");
+	EXPECT_EQ(stats[8].value.u64, 1);
+	EXPECT_EQ(stats[8].flags, PPM_SCAP_STATS_MEMORY);
+}
+
+TEST_F(sinsp_with_test_input, table_memory_threads)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	auto tm = m_inspector.m_thread_manager;
+	const sinsp_table_memory& threads = m_inspector.get_table_memory(SINSP_TABLE_THREADS);
+	uint64_t bytes = threads.get_bytes();
+
+	auto tinfo = tm->new_threadinfo();
+	tinfo->m_tid = 42;
+	tinfo->m_pid = 42;
+	tinfo->m_ptid = 1;
+	tinfo->m_exepath = "/usr/bin/" + std::string(256, 'a');
+	ASSERT_TRUE(tm->add_thread(tinfo.release(), false));
+	EXPECT_EQ(threads.get_entries(), 2);
+	EXPECT_GT(threads.get_bytes(), bytes + sizeof(sinsp_threadinfo) + 256);
+
+	tm->remove_thread(42, true);
+	EXPECT_EQ(threads.get_entries(), 1);
+	EXPECT_EQ(threads.get_bytes(), bytes);
+
+	// over the budget, the new threads are refused
+	m_inspector.set_memory_budget(SINSP_TABLE_THREADS, bytes);
+	tinfo = tm->new_threadinfo();
+	tinfo->m_tid = 43;
+	tinfo->m_pid = 43;
+	tinfo->m_ptid = 1;
+	sinsp_threadinfo* raw = tinfo.release();
+	ASSERT_FALSE(tm->add_thread(raw, false));
+	delete raw;
+	EXPECT_EQ(m_inspector.get_thread_ref(43, false, true), nullptr);
+	EXPECT_EQ(threads.get_entries(), 1);
+	EXPECT_EQ(threads.get_budget_drops(), 1);
+}
+
+TEST_F(sinsp_with_test_input, table_memory_evict_threads)
+{
+	add_default_init_thread();
+	for(int64_t tid = 100; tid < 104; tid++)
+	{
+		add_thread(create_threadinfo(tid, tid, 1, tid, tid, tid, "init", "/sbin/init", "/sbin/init",
+					     increasing_ts(), 0, 0), {});
+	}
+	open_inspector();
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+
+	auto tm = m_inspector.m_thread_manager;
+	uint64_t lastaccess[] = {10, 5, 20, 30};
+	for(int64_t tid = 100; tid < 104; tid++)
+	{
+		m_inspector.get_thread_ref(tid, false, true)->m_lastaccess_ts = lastaccess[tid - 100];
+	}
+	tm->set_max_thread_table_size(5);
+
+	// a full table refuses the new threads
+	auto tinfo = tm->new_threadinfo();
+	tinfo->m_tid = 200;
+	tinfo->m_pid = 200;
+	tinfo->m_ptid = 1;
+	sinsp_threadinfo* raw = tinfo.release();
+	ASSERT_FALSE(tm->add_thread(raw, false));
+
+	// unless it evicts the coldest one
+	m_inspector.set_state_eviction(true);
+	ASSERT_TRUE(tm->add_thread(raw, false));
+	EXPECT_EQ(tm->get_thread_count(), 5);
+	EXPECT_EQ(m_inspector.get_thread_ref(101, false, true), nullptr);
+	EXPECT_NE(m_inspector.get_thread_ref(100, false, true), nullptr);
+	EXPECT_NE(m_inspector.get_thread_ref(200, false, true), nullptr);
+	EXPECT_EQ(m_inspector.get_table_memory(SINSP_TABLE_THREADS).get_evictions(), 1);
+}
+
+TEST_F(sinsp_with_test_input, table_memory_evict_fds)
+{
+	add_default_init_thread();
+
+	std::vector<scap_fdinfo> fdinfos;
+	for(int64_t fd = 0; fd < 4; fd++)
+	{
+		scap_fdinfo fdinfo = {};
+		fdinfo.fd = fd;
+		fdinfo.ino = 5;
+		fdinfo.type = SCAP_FD_FILE_V2;
+		fdinfo.info.regularinfo.open_flags = PPM_O_RDONLY;
+		std::string fname = "/tmp/cold_" + std::to_string(fd);
+		strlcpy(fdinfo.info.regularinfo.fname, fname.c_str(), sizeof(fdinfo.info.regularinfo.fname));
+		fdinfos.push_back(fdinfo);
+	}
+	add_thread(create_threadinfo(100, 100, 1, 100, 100, 100, "init", "/sbin/init", "/sbin/init",
+				     increasing_ts(), 0, 0), fdinfos);
+	open_inspector();
+
+	const sinsp_table_memory& fds = m_inspector.get_table_memory(SINSP_TABLE_FDS);
+	m_inspector.set_memory_budget(SINSP_TABLE_FDS, fds.get_bytes());
+	m_inspector.set_state_eviction(true);
+
+	// the fd over the budget is admitted, and the fds of the coldest
+	// process are evicted before the next event
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", PPM_O_RDWR, 0);
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_OPEN_X, 6, (int64_t)3, "/tmp/the_file", PPM_O_RDWR, 0, 5, (uint64_t)123);
+	EXPECT_NE(m_inspector.get_thread_ref(1, false, true)->get_fd(3), nullptr);
+	EXPECT_EQ(fds.get_evictions(), 0);
+
+	add_event_advance_ts(increasing_ts(), 1, PPME_SYSCALL_CLOSE_E, 1, (int64_t)3);
+	EXPECT_EQ(fds.get_evictions(), 4);
+	EXPECT_EQ(fds.get_budget_drops(), 0);
+	EXPECT_LT(fds.get_bytes(), fds.get_budget());
+
+	// in a capture the evicted fds can't be read again
+	auto tinfo = m_inspector.get_thread_ref(100, false, true);
+	ASSERT_NE(tinfo, nullptr);
+	EXPECT_EQ(tinfo->get_fd(0), nullptr);
+	EXPECT_NE(m_inspector.get_thread_ref(1, false, true)->get_fd(3), nullptr);
+}
@@ -0,0 +1,354 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest/gtest.h>
+#include <set>
+
+#include "sinsp_with_test_input.h"
+
+TEST_F(sinsp_with_test_input, threadinfo_recycling)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	auto tm = m_inspector.m_thread_manager;
+	auto pool = tm->get_threadinfo_pool();
+	ASSERT_EQ(pool->size(), 0);
+
+	auto tinfo = tm->new_threadinfo();
+	tinfo->m_tid = 42;
+	tinfo->m_pid = 42;
+	tinfo->m_ptid = 1;
+	tinfo->m_comm = "a-rather-long-command-name";
+	tinfo->m_container_id = "abcdef012345";
+	sinsp_threadinfo* raw = tinfo.get();
+	ASSERT_TRUE(tm->add_thread(tinfo.release(), false));
+
+	// the threadinfo goes back to the pool once the last reference is gone
+	auto ref = m_inspector.get_thread_ref(42, false, true);
+	ASSERT_EQ(ref.get(), raw);
+	tm->remove_thread(42, true);
+	ASSERT_EQ(pool->size(), 0);
+	ref.reset();
+	ASSERT_EQ(pool->size(), 1);
+
+	// and is reused, cleared, by the next thread
+	auto reused = tm->new_threadinfo();
+	ASSERT_EQ(reused.get(), raw);
+	ASSERT_EQ(pool->size(), 0);
+	ASSERT_EQ(pool->get_n_reused(), 1);
+	ASSERT_TRUE(reused->m_comm.empty());
+	ASSERT_TRUE(reused->m_container_id.empty());
+	ASSERT_TRUE(reused->m_args.empty());
+	ASSERT_EQ(reused->m_pid, -1);
+	ASSERT_EQ(reused->m_nchilds, 0);
+
+	// recycling can be disabled
+	tm->set_max_recycled_threads(0);
+	reused->m_tid = 43;
+	ASSERT_TRUE(tm->add_thread(reused.release(), false));
+	tm->remove_thread(43, true);
+	ASSERT_EQ(pool->size(), 0);
+}
+
+TEST_F(sinsp_with_test_input, thread_borrowed_lookup)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	auto tm = m_inspector.m_thread_manager;
+	auto tinfo = tm->new_threadinfo();
+	tinfo->m_tid = 42;
+	tinfo->m_pid = 42;
+	tinfo->m_ptid = 1;
+	sinsp_threadinfo* raw = tinfo.get();
+	ASSERT_TRUE(tm->add_thread(tinfo.release(), false));
+
+	// borrowed lookups, cached or not, match the refcounted ones
+	ASSERT_EQ(m_inspector.get_thread(42, false, true), raw);
+	ASSERT_EQ(m_inspector.get_thread(42, false, false), raw);
+	ASSERT_EQ(m_inspector.get_thread(42, false, false), raw);
+	ASSERT_EQ(m_inspector.get_thread_ref(42, false, false).get(), raw);
+	ASSERT_EQ(m_inspector.get_thread(43, false, false), nullptr);
+
+	// an event can keep its thread past its removal
+	sinsp_evt* evt = add_event_advance_ts(increasing_ts(), 42, PPME_SYSCALL_GETCWD_E, 0);
+	ASSERT_EQ(evt->get_thread_info(), raw);
+	auto ref = evt->get_thread_info_ref();
+	ASSERT_EQ(ref.get(), raw);
+	tm->remove_thread(42, true);
+	ASSERT_EQ(m_inspector.get_thread(42, false, false), nullptr);
+	ASSERT_EQ(ref->m_tid, 42);
+}
+
+TEST_F(sinsp_with_test_input, thread_table_loop_slice)
+{
+	add_default_init_thread();
+	for(int64_t tid = 100; tid < 1100; tid++)
+	{
+		add_thread(create_threadinfo(tid, tid, 1, tid, tid, tid, "init", "/sbin/init", "/sbin/init",
+					     increasing_ts(), 0, 0), {});
+	}
+	open_inspector();
+
+	// a visit in slices covers the whole table exactly once
+	auto tt = m_inspector.m_thread_manager->get_threads();
+	std::set<int64_t> visited;
+	size_t cursor = 0;
+	uint32_t calls = 0;
+	bool done = false;
+	while(!done)
+	{
+		size_t before = visited.size();
+		done = tt->loop_slice(cursor, 64, [&visited](sinsp_threadinfo& tinfo) {
+			ASSERT_TRUE(visited.insert(tinfo.m_tid).second);
+		});
+		calls++;
+		ASSERT_LT(visited.size() - before, 64 + 16);
+	}
+	ASSERT_EQ(visited.size(), tt->size());
+	ASSERT_GT(calls, 1);
+}
+
+TEST_F(sinsp_with_test_input, thread_table_range_and_parallel_loop)
+{
+	add_default_init_thread();
+	for(int64_t tid = 100; tid < 1100; tid++)
+	{
+		add_thread(create_threadinfo(tid, tid, 1, tid, tid, tid, "init", "/sbin/init", "/sbin/init",
+					     increasing_ts(), 0, 0), {});
+	}
+	open_inspector();
+
+	auto tt = m_inspector.m_thread_manager->get_threads();
+	std::set<int64_t> visited;
+	for(const auto& tinfo : *tt)
+	{
+		ASSERT_TRUE(visited.insert(tinfo.m_tid).second);
+	}
+	ASSERT_EQ(visited.size(), tt->size());
+
+	// stopping early
+	size_t n = 0;
+	ASSERT_FALSE(tt->const_loop([&n](const sinsp_threadinfo&) { return ++n < 10; }));
+	ASSERT_EQ(n, 10);
+
+	// each worker accumulates in its own slot
+	const size_t n_workers = 4;
+	std::vector<std::set<int64_t>> per_worker(n_workers);
+	tt->const_loop_parallel(n_workers, [&per_worker](size_t worker, const sinsp_threadinfo& tinfo) {
+		per_worker[worker].insert(tinfo.m_tid);
+	});
+	std::set<int64_t> merged;
+	for(const auto& w : per_worker)
+	{
+		for(auto tid : w)
+		{
+			ASSERT_TRUE(merged.insert(tid).second);
+		}
+	}
+	ASSERT_EQ(merged, visited);
+}
+
+TEST_F(sinsp_with_test_input, thread_table_dense)
+{
+	add_default_init_thread();
+	for(int64_t tid = 100; tid < 1100; tid++)
+	{
+		add_thread(create_threadinfo(tid, tid, 1, tid, tid, tid, "init", "/sbin/init", "/sbin/init",
+					     increasing_ts(), 0, 0), {});
+	}
+	// out of the range of the pages, kept in the hash table
+	int64_t big_tid = 1 << 23;
+	add_thread(create_threadinfo(big_tid, big_tid, 1, big_tid, big_tid, big_tid, "init", "/sbin/init", "/sbin/init",
+				     increasing_ts(), 0, 0), {});
+	m_inspector.set_dense_thread_table(true);
+	open_inspector();
+
+	auto tt = m_inspector.m_thread_manager->get_threads();
+	ASSERT_TRUE(tt->is_dense());
+	ASSERT_EQ(tt->size(), 1002);
+	ASSERT_NE(tt->get(500), nullptr);
+	ASSERT_EQ(tt->get(500)->m_tid, 500);
+	ASSERT_NE(tt->get(big_tid), nullptr);
+	ASSERT_EQ(tt->get(2000), nullptr);
+	ASSERT_THROW(m_inspector.set_dense_thread_table(false), sinsp_exception);
+
+	std::set<int64_t> visited;
+	for(const auto& tinfo : *tt)
+	{
+		ASSERT_TRUE(visited.insert(tinfo.m_tid).second);
+	}
+	ASSERT_EQ(visited.size(), tt->size());
+	ASSERT_EQ(visited.count(big_tid), 1);
+
+	std::set<int64_t> sliced;
+	size_t cursor = 0;
+	while(!tt->loop_slice(cursor, 64, [&sliced](sinsp_threadinfo& tinfo) {
+		ASSERT_TRUE(sliced.insert(tinfo.m_tid).second);
+	}));
+	ASSERT_EQ(sliced, visited);
+
+	std::vector<std::set<int64_t>> per_worker(4);
+	tt->const_loop_parallel(4, [&per_worker](size_t worker, const sinsp_threadinfo& tinfo) {
+		per_worker[worker].insert(tinfo.m_tid);
+	});
+	std::set<int64_t> merged;
+	for(const auto& w : per_worker)
+	{
+		merged.insert(w.begin(), w.end());
+	}
+	ASSERT_EQ(merged, visited);
+
+	tt->erase(500);
+	tt->erase(big_tid);
+	ASSERT_EQ(tt->get(500), nullptr);
+	ASSERT_EQ(tt->get(big_tid), nullptr);
+	ASSERT_EQ(tt->size(), 1000);
+}
+
+TEST_F(sinsp_with_test_input, proc_lookup_throttling)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	// the test engine has no /proc, so every lookup fails
+	auto tm = m_inspector.m_thread_manager;
+	tm->set_proc_lookup_budget(0.001, 2);
+	for(int64_t tid = 100; tid < 103; tid++)
+	{
+		ASSERT_NE(tm->get_thread_ref(tid, true), nullptr);
+	}
+	ASSERT_EQ(tm->get_m_n_proc_lookups(), 3);
+	ASSERT_EQ(tm->get_m_n_proc_lookups_throttled(), 1);
+
+	// a tid that just failed isn't looked up again
+	tm->set_proc_lookup_budget(0, 0);
+	tm->remove_thread(100, true);
+	ASSERT_NE(tm->get_thread_ref(100, true), nullptr);
+	ASSERT_EQ(tm->get_m_n_proc_lookups(), 3);
+	ASSERT_EQ(tm->get_m_n_proc_lookups_negative_cached(), 1);
+
+	// unless the negative cache is disabled
+	tm->set_proc_lookup_negative_cache_ttl(0);
+	tm->remove_thread(101, true);
+	ASSERT_NE(tm->get_thread_ref(101, true), nullptr);
+	ASSERT_EQ(tm->get_m_n_proc_lookups(), 4);
+	ASSERT_EQ(tm->get_m_n_proc_lookups_negative_cached(), 1);
+}
+
+TEST_F(sinsp_with_test_input, mainthread_childcount_index)
+{
+	add_default_init_thread();
+	open_inspector();
+
+	auto tm = m_inspector.m_thread_manager;
+	auto add = [&](int64_t tid, int64_t pid, uint32_t flags)
+	{
+		auto tinfo = tm->new_threadinfo();
+		tinfo->m_tid = tid;
+		tinfo->m_pid = pid;
+		tinfo->m_ptid = 1;
+		tinfo->m_flags = flags;
+		ASSERT_TRUE(tm->add_thread(tinfo.release(), false));
+	};
+
+	add(50, 50, 0);
+	add(51, 50, PPM_CL_CLONE_THREAD);
+	add(52, 50, PPM_CL_CLONE_THREAD);
+	ASSERT_EQ(tm->get_process_thread_count(50), 2);
+	ASSERT_EQ(m_inspector.get_thread_ref(50, false, true)->m_nchilds, 2);
+
+	// a thread is counted only once
+	tm->create_child_dependencies();
+	ASSERT_EQ(m_inspector.get_thread_ref(50, false, true)->m_nchilds, 2);
+
+	tm->remove_thread(51, false);
+	ASSERT_EQ(m_inspector.get_thread_ref(50, false, true)->m_nchilds, 1);
+
+	// a main thread re-created after a forced removal gets its refcount back
+	tm->remove_thread(50, true);
+	ASSERT_EQ(tm->get_process_thread_count(50), 1);
+	add(50, 50, 0);
+	ASSERT_EQ(m_inspector.get_thread_ref(50, false, true)->m_nchilds, 1);
+
+	// after an execve the remaining threads are not counted anymore
+	tm->reset_mainthread_childcount(m_inspector.get_thread_ref(50, false, true).get());
+	ASSERT_EQ(tm->get_process_thread_count(50), 0);
+	tm->remove_thread(52, false);
+	ASSERT_EQ(m_inspector.get_thread_ref(50, false, true)->m_nchilds, 0);
+}
+
+TEST_F(sinsp_with_test_input, workload_counters)
+{
+	add_default_init_thread();
+	open_inspector();
+	m_inspector.set_workload_counters(true);
+
+	auto tm = m_inspector.m_thread_manager;
+	auto add = [&](int64_t tid, int64_t pid, uint32_t flags)
+	{
+		auto tinfo = tm->new_threadinfo();
+		tinfo->m_tid = tid;
+		tinfo->m_pid = pid;
+		tinfo->m_ptid = 1;
+		tinfo->m_flags = flags;
+		tinfo->m_container_id = "abcdef012345";
+		ASSERT_TRUE(tm->add_thread(tinfo.release(), false));
+	};
+
+	static const char data[] = "0123456789";
+	add(50, 50, 0);
+	add(51, 50, PPM_CL_CLONE_THREAD);
+	add_event_advance_ts(increasing_ts(), 51, PPME_SYSCALL_READ_E, 2, (int64_t)0, (uint32_t)sizeof(data));
+	add_event_advance_ts(increasing_ts(), 51, PPME_SYSCALL_READ_X, 2, (int64_t)sizeof(data), scap_const_sized_buffer{data, sizeof(data)});
+	add_event_advance_ts(increasing_ts(), 50, PPME_SYSCALL_WRITE_E, 2, (int64_t)0, (uint32_t)sizeof(data));
+	add_event_advance_ts(increasing_ts(), 50, PPME_SYSCALL_WRITE_X, 2, (int64_t)sizeof(data), scap_const_sized_buffer{data, sizeof(data)});
+	// failed reads count as events only
+	add_event_advance_ts(increasing_ts(), 51, PPME_SYSCALL_READ_X, 2, (int64_t)-1, scap_const_sized_buffer{data, 0});
+
+	auto t51 = m_inspector.get_thread_ref(51, false, true);
+	ASSERT_EQ(t51->m_workload.m_num_events, 3);
+	ASSERT_EQ(t51->m_workload.m_bytes_read, sizeof(data));
+	ASSERT_EQ(t51->m_workload.m_bytes_written, 0);
+	auto acc = t51->static_fields().at("bytes_read").new_accessor<uint64_t>();
+	ASSERT_EQ(t51->get_static_field(acc), sizeof(data));
+	t51.reset();
+
+	auto processes = tm->get_process_workloads();
+	ASSERT_EQ(processes[50].m_num_events, 5);
+	ASSERT_EQ(processes[50].m_bytes_read, sizeof(data));
+	ASSERT_EQ(processes[50].m_bytes_written, sizeof(data));
+
+	// removed threads leave their counters to their process, and the
+	// processes to their container
+	tm->remove_thread(51, false);
+	ASSERT_EQ(m_inspector.get_thread_ref(50, false, true)->m_workload.m_num_events, 5);
+	tm->remove_thread(50, false);
+	ASSERT_EQ(tm->get_process_workloads().count(50), 0);
+	auto containers = tm->get_container_workloads();
+	ASSERT_EQ(containers["abcdef012345"].m_num_events, 5);
+	ASSERT_EQ(containers["abcdef012345"].m_bytes_read, sizeof(data));
+	ASSERT_EQ(containers["abcdef012345"].m_bytes_written, sizeof(data));
+
+	uint32_t nstats = 0;
+	const scap_stats_v2* stats = tm->get_workload_stats(&nstats);
+	ASSERT_EQ(nstats, 3);
+	EXPECT_EQ(std::string(stats[0].name), "workload.container.abcdef012345.events");
+	EXPECT_EQ(stats[0].flags, PPM_SCAP_STATS_WORKLOAD_COUNTERS);
+	EXPECT_EQ(stats[0].value.u64, 5);
+}
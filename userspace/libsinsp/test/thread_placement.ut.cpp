@@ -0,0 +1,116 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <algorithm>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <gtest/gtest.h>
+
+#include "thread_placement.h"
+
+using namespace libsinsp::thread_placement;
+
+class thread_placement_test : public testing::Test
+{
+protected:
+	void TearDown() override
+	{
+		reset();
+	}
+};
+
+TEST_F(thread_placement_test, parse_cpu_list)
+{
+	ASSERT_EQ(parse_cpu_list("0-3,8,10-11\n"), std::vector<uint32_t>({0, 1, 2, 3, 8, 10, 11}));
+	ASSERT_EQ(parse_cpu_list("5,1-2,2"), std::vector<uint32_t>({1, 2, 5}));
+	ASSERT_EQ(parse_cpu_list(""), std::vector<uint32_t>());
+	// Malformed ranges are skipped
+	ASSERT_EQ(parse_cpu_list("x,4-2,7"), std::vector<uint32_t>({7}));
+}
+
+TEST_F(thread_placement_test, dedicated_capture)
+{
+	ASSERT_TRUE(effective_cpus(thread_class::DNS_RESOLVER).empty());
+
+	cpu_set_t allowed;
+	ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+	if(CPU_COUNT(&allowed) < 2)
+	{
+		GTEST_SKIP() << "needs at least two CPUs";
+	}
+	uint32_t capture_cpu = 0;
+	while(!CPU_ISSET(capture_cpu, &allowed))
+	{
+		capture_cpu++;
+	}
+
+	placement capture;
+	capture.m_cpus = {capture_cpu};
+	set(thread_class::CAPTURE, capture);
+
+	// Not dedicated, the other classes can run anywhere
+	ASSERT_TRUE(effective_cpus(thread_class::DNS_RESOLVER).empty());
+
+	capture.m_dedicated = true;
+	set(thread_class::CAPTURE, capture);
+	ASSERT_EQ(effective_cpus(thread_class::CAPTURE), std::vector<uint32_t>({capture_cpu}));
+	std::vector<uint32_t> dns_cpus = effective_cpus(thread_class::DNS_RESOLVER);
+	ASSERT_EQ(dns_cpus.size(), (size_t)CPU_COUNT(&allowed) - 1);
+	ASSERT_EQ(std::find(dns_cpus.begin(), dns_cpus.end(), capture_cpu), dns_cpus.end());
+
+	// An explicit placement wins over the dedicated capture CPUs
+	placement dns;
+	dns.m_cpus = {capture_cpu};
+	set(thread_class::DNS_RESOLVER, dns);
+	ASSERT_EQ(effective_cpus(thread_class::DNS_RESOLVER), std::vector<uint32_t>({capture_cpu}));
+}
+
+TEST_F(thread_placement_test, apply)
+{
+	placement p;
+	p.m_name = "a-very-long-thread-name";
+	set(thread_class::AUXILIARY, p);
+
+	std::string name;
+	bool applied = false;
+	std::thread t([&]()
+	{
+		applied = apply(thread_class::AUXILIARY);
+		char buf[32] = {};
+		pthread_getname_np(pthread_self(), buf, sizeof(buf));
+		name = buf;
+	});
+	t.join();
+
+	ASSERT_TRUE(applied);
+	ASSERT_EQ(name, "a-very-long-thr");
+
+	// The default name of the class
+	set(thread_class::AUXILIARY, placement());
+	t = std::thread([&]()
+	{
+		apply(thread_class::AUXILIARY);
+		char buf[32] = {};
+		pthread_getname_np(pthread_self(), buf, sizeof(buf));
+		name = buf;
+	});
+	t.join();
+	ASSERT_EQ(name, default_name(thread_class::AUXILIARY));
+}
@@ -191,4 +191,54 @@ TEST_F(usergroup_manager_host_root_test, host_root_lookup)
 	ASSERT_EQ(group->gid, 0);
 	ASSERT_STREQ(group->name, "toor");
 }
+
+TEST_F(usergroup_manager_host_root_test, proc_scan_batch)
+{
+	// Fake /proc: pid 1 on the host, pids 100 and 200 in two containers
+	std::vector<std::string> dirs = {"/proc", "/proc/1", "/proc/1/root",
+					 "/proc/100", "/proc/100/root", "/proc/100/root/etc",
+					 "/proc/200", "/proc/200/root", "/proc/200/root/etc"};
+	for(const auto& dir : dirs)
+	{
+		ASSERT_EQ(mkdir((m_host_root + dir).c_str(), S_IRWXU), 0);
+	}
+	for(const auto& pid : {"100", "200"})
+	{
+		std::string etc = m_host_root + "/proc/" + pid + "/root/etc";
+		std::ofstream(etc + "/passwd") << "user" << pid << ":x:0:0::/home:/bin/sh\n";
+		std::ofstream(etc + "/group") << "group" << pid << ":x:0:\n";
+	}
+
+	{
+		sinsp_usergroup_manager mgr(&m_inspector);
+
+		// The files are only read at the end of the scan
+		mgr.begin_proc_scan();
+		ASSERT_EQ(mgr.add_user("ctr100", 100, 0, 0, nullptr, nullptr, nullptr), nullptr);
+		ASSERT_EQ(mgr.add_group("ctr200", 200, 0, nullptr), nullptr);
+		ASSERT_EQ(mgr.add_user("ctr200", 200, 0, 0, nullptr, nullptr, nullptr), nullptr);
+		mgr.end_proc_scan();
+
+		auto* user = mgr.get_user("ctr100", 0);
+		ASSERT_NE(user, nullptr);
+		ASSERT_STREQ(user->name, "user100");
+		auto* group = mgr.get_group("ctr100", 0);
+		ASSERT_NE(group, nullptr);
+		ASSERT_STREQ(group->name, "group100");
+		user = mgr.get_user("ctr200", 0);
+		ASSERT_NE(user, nullptr);
+		ASSERT_STREQ(user->name, "user200");
+	}
+
+	for(const auto& pid : {"100", "200"})
+	{
+		std::string etc = m_host_root + "/proc/" + pid + "/root/etc";
+		unlink((etc + "/passwd").c_str());
+		unlink((etc + "/group").c_str());
+	}
+	for(auto it = dirs.rbegin(); it != dirs.rend(); ++it)
+	{
+		rmdir((m_host_root + *it).c_str());
+	}
+}
 #endif
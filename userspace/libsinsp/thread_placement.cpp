@@ -0,0 +1,296 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "thread_placement.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "logger.h"
+
+namespace libsinsp {
+namespace thread_placement {
+
+// Linux limits the thread names to 16 bytes, including the terminator
+constexpr const size_t MAX_THREAD_NAME_LEN = 15;
+
+// The placements are process-wide: the threads are started deep in
+// components (DNS manager, async sources, ...) that have no inspector
+static std::mutex s_mutex;
+static placement s_placements[(uint32_t)thread_class::MAX];
+
+void set(thread_class cls, const placement& p)
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_placements[(uint32_t)cls] = p;
+}
+
+placement get(thread_class cls)
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return s_placements[(uint32_t)cls];
+}
+
+void reset()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	for(auto& p : s_placements)
+	{
+		p = placement();
+	}
+}
+
+const char* default_name(thread_class cls)
+{
+	switch(cls)
+	{
+	case thread_class::CAPTURE:
+		return "sinsp-capture";
+	case thread_class::DNS_RESOLVER:
+		return "sinsp-dns";
+	case thread_class::ASYNC_LOOKUP:
+		return "sinsp-async";
+	case thread_class::GVISOR:
+		return "scap-gvisor";
+	case thread_class::OUTPUT:
+		return "sinsp-output";
+	case thread_class::AUXILIARY:
+	default:
+		return "sinsp-aux";
+	}
+}
+
+std::vector<uint32_t> parse_cpu_list(const std::string& list)
+{
+	std::vector<uint32_t> cpus;
+	size_t pos = 0;
+	while(pos < list.size())
+	{
+		size_t end = list.find(',', pos);
+		if(end == std::string::npos)
+		{
+			end = list.size();
+		}
+
+		std::string range = list.substr(pos, end - pos);
+		pos = end + 1;
+
+		char* next = nullptr;
+		unsigned long first = strtoul(range.c_str(), &next, 10);
+		if(next == range.c_str())
+		{
+			continue;
+		}
+
+		unsigned long last = first;
+		if(*next == '-')
+		{
+			const char* start = next + 1;
+			last = strtoul(start, &next, 10);
+			if(next == start || last < first)
+			{
+				continue;
+			}
+		}
+
+		for(unsigned long cpu = first; cpu <= last; cpu++)
+		{
+			cpus.push_back((uint32_t)cpu);
+		}
+	}
+
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	return cpus;
+}
+
+std::vector<uint32_t> numa_node_cpus(int32_t node)
+{
+	if(node < 0)
+	{
+		return {};
+	}
+
+	std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+	std::string list;
+	if(!std::getline(in, list))
+	{
+		return {};
+	}
+	return parse_cpu_list(list);
+}
+
+static std::vector<uint32_t> placement_cpus(const placement& p)
+{
+	if(p.m_numa_node < 0)
+	{
+		return p.m_cpus;
+	}
+
+	std::vector<uint32_t> node_cpus = numa_node_cpus(p.m_numa_node);
+	if(p.m_cpus.empty())
+	{
+		return node_cpus;
+	}
+
+	std::vector<uint32_t> cpus;
+	for(uint32_t cpu : p.m_cpus)
+	{
+		if(std::find(node_cpus.begin(), node_cpus.end(), cpu) != node_cpus.end())
+		{
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+
+#ifdef __linux__
+static std::vector<uint32_t> allowed_cpus()
+{
+	std::vector<uint32_t> cpus;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(sched_getaffinity(0, sizeof(set), &set) != 0)
+	{
+		return cpus;
+	}
+
+	for(uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if(CPU_ISSET(cpu, &set))
+		{
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+#endif
+
+std::vector<uint32_t> effective_cpus(thread_class cls)
+{
+	placement p = get(cls);
+	std::vector<uint32_t> cpus = placement_cpus(p);
+	if(!cpus.empty() || cls == thread_class::CAPTURE || p.m_numa_node >= 0)
+	{
+		return cpus;
+	}
+
+	placement capture = get(thread_class::CAPTURE);
+	if(!capture.m_dedicated)
+	{
+		return cpus;
+	}
+
+	std::vector<uint32_t> capture_cpus = placement_cpus(capture);
+	if(capture_cpus.empty())
+	{
+		return cpus;
+	}
+
+#ifdef __linux__
+	// Everything the process can run on, apart from the capture CPUs
+	for(uint32_t cpu : allowed_cpus())
+	{
+		if(std::find(capture_cpus.begin(), capture_cpus.end(), cpu) == capture_cpus.end())
+		{
+			cpus.push_back(cpu);
+		}
+	}
+#endif
+	return cpus;
+}
+
+bool apply(thread_class cls)
+{
+#ifdef __linux__
+	placement p = get(cls);
+	bool ok = true;
+
+	// The capture thread belongs to the caller, it's renamed only on request
+	std::string name = p.m_name;
+	if(name.empty() && cls != thread_class::CAPTURE)
+	{
+		name = default_name(cls);
+	}
+	if(!name.empty())
+	{
+		name.resize(std::min(name.size(), MAX_THREAD_NAME_LEN));
+		int err = pthread_setname_np(pthread_self(), name.c_str());
+		if(err != 0)
+		{
+			g_logger.format(sinsp_logger::SEV_WARNING, "(thread-placement) cannot name thread %s: %s",
+					name.c_str(), strerror(err));
+			ok = false;
+		}
+	}
+
+	std::vector<uint32_t> cpus = effective_cpus(cls);
+	if(!cpus.empty())
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for(uint32_t cpu : cpus)
+		{
+			if(cpu < CPU_SETSIZE)
+			{
+				CPU_SET(cpu, &set);
+			}
+		}
+
+		int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		if(err != 0)
+		{
+			g_logger.format(sinsp_logger::SEV_WARNING, "(thread-placement) cannot set the affinity of thread %s: %s",
+					default_name(cls), strerror(err));
+			ok = false;
+		}
+	}
+	else if(p.m_numa_node >= 0)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING, "(thread-placement) no usable CPU on NUMA node %d for thread %s",
+				p.m_numa_node, default_name(cls));
+		ok = false;
+	}
+
+	// On Linux the nice value is per thread
+	if(p.m_set_nice && setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), p.m_nice) != 0)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING, "(thread-placement) cannot set nice %d for thread %s: %s",
+				p.m_nice, default_name(cls), strerror(errno));
+		ok = false;
+	}
+
+	return ok;
+#else
+	return true;
+#endif
+}
+
+}
+}
@@ -0,0 +1,114 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace libsinsp {
+namespace thread_placement {
+
+/**
+ * \brief The classes of the threads started by the libs
+ *
+ * All the threads of a class share the same placement, see
+ * sinsp::set_thread_placement.
+ */
+enum class thread_class : uint32_t {
+	CAPTURE = 0,  ///< the thread opening the inspector and calling next()
+	DNS_RESOLVER, ///< the refresh thread of the sinsp_dns_manager
+	ASYNC_LOOKUP, ///< the workers of the async_key_value_source (container engines, ...)
+	GVISOR,	      ///< the accept and parsing threads of the gVisor engine
+	OUTPUT,	      ///< the formatting and writing threads of the output queue and the dumper
+	AUXILIARY,    ///< the other helper threads (logger, lazy fd loader, user/group refresh, source readers)
+	MAX
+};
+
+/**
+ * \brief Where the threads of a class run, and with which name and priority
+ *
+ * The default placement leaves the threads as they are created, apart
+ * from their name.
+ */
+struct placement {
+	// The thread name, truncated to 15 characters. Empty means the
+	// default name of the class (the capture thread is not renamed).
+	std::string m_name;
+
+	// The CPUs the threads are allowed to run on. Empty means any CPU,
+	// apart from the dedicated capture ones (see m_dedicated).
+	std::vector<uint32_t> m_cpus;
+
+	// If not negative, the threads are restricted to the CPUs of this
+	// NUMA node, on top of m_cpus if it's set.
+	int32_t m_numa_node = -1;
+
+	// The nice value of the threads, applied only if m_set_nice is set.
+	// Negative values need CAP_SYS_NICE.
+	bool m_set_nice = false;
+	int32_t m_nice = 0;
+
+	// Capture class only: keep the other classes off its CPUs, unless
+	// their own placement asks for them explicitly.
+	bool m_dedicated = false;
+};
+
+/**
+ * \brief Set the placement of a class. It applies to the threads started
+ * afterwards, and to the capture thread on the next open.
+ */
+void set(thread_class cls, const placement& p);
+
+placement get(thread_class cls);
+
+/**
+ * \brief Back to the default placement for all the classes
+ */
+void reset();
+
+/**
+ * \brief The default name of the threads of a class, e.g. "sinsp-dns"
+ */
+const char* default_name(thread_class cls);
+
+/**
+ * \brief The CPUs the threads of a class end up on, considering the NUMA
+ * node and the dedicated capture CPUs. Empty means no restriction.
+ */
+std::vector<uint32_t> effective_cpus(thread_class cls);
+
+/**
+ * \brief The CPUs of a NUMA node, empty if it doesn't exist
+ */
+std::vector<uint32_t> numa_node_cpus(int32_t node);
+
+/**
+ * \brief Parse a kernel CPU list, e.g. "0-3,8,10-11"
+ */
+std::vector<uint32_t> parse_cpu_list(const std::string& list);
+
+/**
+ * \brief Apply the placement of a class to the calling thread, at the
+ * start of the thread body. Failures are logged and don't prevent the
+ * thread from running, the return value tells whether everything applied.
+ */
+bool apply(thread_class cls);
+
+}
+}
@@ -18,14 +18,17 @@ limitations under the License.
 #ifndef _WIN32
 #include <inttypes.h>
 #include <unistd.h>
+#include <limits.h>
 #endif
 #include <stdio.h>
 #include <algorithm>
+#include <typeinfo>
 #include "strlcpy.h"
 #include "sinsp.h"
 #include "sinsp_int.h"
 #include "protodecoder.h"
 #include "tracers.h"
+#include "event_buffer_pool.h"
 
 #ifdef HAS_ANALYZER
 #include "tracer_emitter.h"
@@ -48,10 +51,10 @@ static void copy_ipv6_address(uint32_t* dest, uint32_t* src)
 ///////////////////////////////////////////////////////////////////////////////
 sinsp_threadinfo::sinsp_threadinfo(sinsp* inspector, std::shared_ptr<libsinsp::state::dynamic_struct::field_infos> dyn_fields):
 	table_entry(dyn_fields),
-	m_cgroups(new cgroups_t),
 	m_tracer_parser(NULL),
 	m_inspector(inspector),
-	m_fdtable(inspector)
+	m_fdtable(inspector),
+	m_creds(new credentials())
 {
 	// todo(jasondellaluce): support fields of complex type (structs, vectors...)
 	// todo(jasondellaluce): support currently-hidden fields, and decide
@@ -69,9 +72,7 @@ sinsp_threadinfo::sinsp_threadinfo(sinsp* inspector, std::shared_ptr<libsinsp::s
 	// m_args
 	// m_env
 	// m_cgroups
-	// m_user
-	// m_loginuser
-	// m_group
+	// m_creds
 	define_static_field(this, m_container_id, "container_id");
 	// m_flags
 	define_static_field(this, m_fdlimit, "fd_limit");
@@ -97,6 +98,9 @@ sinsp_threadinfo::sinsp_threadinfo(sinsp* inspector, std::shared_ptr<libsinsp::s
 	// m_program_hash
 	define_static_field(this, m_tty, "tty");
 	define_static_field(this, m_cwd, "cwd", true);
+	define_static_field(this, m_workload.m_num_events, "num_events", true);
+	define_static_field(this, m_workload.m_bytes_read, "bytes_read", true);
+	define_static_field(this, m_workload.m_bytes_written, "bytes_written", true);
 	// m_program_hash_scripts
 	// m_category
 
@@ -116,6 +120,7 @@ void sinsp_threadinfo::init()
 	m_lastaccess_ts = 0;
 	m_clone_ts = 0;
 	m_lastexec_ts = 0;
+	m_workload = workload_counters();
 	m_lastevent_category.m_category = EC_UNKNOWN;
 	m_flags = PPM_CL_NAME_CHANGED;
 	m_nchilds = 0;
@@ -136,9 +141,13 @@ void sinsp_threadinfo::init()
 	m_program_hash_scripts = 0;
 	m_lastevent_data = NULL;
 	m_parent_loop_detected = false;
+	m_ancestors.clear();
+	m_ancestors_version = 0;
 	m_tty = 0;
 	m_category = CAT_NONE;
+	m_container_handle = 0;
 	m_blprogram = NULL;
+	m_accounted_bytes = 0;
 	m_cap_inheritable = 0;
 	m_cap_permitted = 0;
 	m_cap_effective = 0;
@@ -147,19 +156,54 @@ void sinsp_threadinfo::init()
 	m_exe_ino_mtime = 0;
 	m_exe_ino_ctime_duration_clone_ts = 0;
 	m_exe_ino_ctime_duration_pidns_start = 0;
+	m_interned_exit_pending = false;
+	m_interned_unknown = 0;
 
-	memset(&m_user, 0, sizeof(scap_userinfo));
-	memset(&m_group, 0, sizeof(scap_groupinfo));
-	memset(&m_loginuser, 0, sizeof(scap_userinfo));
+	memset(m_creds.get(), 0, sizeof(credentials));
 }
 
-sinsp_threadinfo::~sinsp_threadinfo()
+void sinsp_threadinfo::recycle()
 {
-	if(m_lastevent_data)
+	//
+	// Drop everything that refers to the previous thread, but keep the
+	// memory already allocated for the strings, the fd table and the
+	// last event buffer
+	//
+	m_comm.clear();
+	m_exe.clear();
+	m_exepath.clear();
+	m_container_id.clear();
+	m_root.clear();
+	m_cwd.clear();
+	m_args = libsinsp::lazy_strvec();
+	m_env = libsinsp::lazy_strvec();
+	m_cgroups = libsinsp::interned_vector<std::pair<std::string, std::string>>();
+	m_cgroups_param = libsinsp::interned_vector<std::string>();
+	m_cgroups_pending = false;
+	m_exe_writable = false;
+	m_exe_upper_layer = false;
+	m_exec_enter_tid.reset();
+	m_fdtable.clear();
+	m_fdtable.m_tid = 0;
+
+	// The tracer parser and its buffers are kept too, the threads of
+	// the apps emitting tracers are likely to emit them as well
+	if(m_tracer_parser)
 	{
-		free(m_lastevent_data);
+		m_tracer_parser->reset();
 	}
 
+	destroy_dynamic_fields();
+
+	uint8_t* lastevent_data = m_lastevent_data;
+	init();
+	m_lastevent_data = lastevent_data;
+}
+
+sinsp_threadinfo::~sinsp_threadinfo()
+{
+	event_buffer_pool::free_buffer(m_lastevent_data);
+
 	if(m_tracer_parser)
 	{
 		delete m_tracer_parser;
@@ -168,36 +212,43 @@ sinsp_threadinfo::~sinsp_threadinfo()
 
 void sinsp_threadinfo::fix_sockets_coming_from_proc()
 {
-	std::unordered_map<int64_t, sinsp_fdinfo_t>::iterator it;
+	//
+	// Don't force the load of pending fds, they are fixed when loaded
+	//
+	if(m_fdtable.is_lazy_load_pending())
+	{
+		return;
+	}
 
-	for(it = m_fdtable.m_table.begin(); it != m_fdtable.m_table.end(); it++)
+	m_fdtable.loop([this](int64_t fd, sinsp_fdinfo_t& fdi)
 	{
-		if(it->second.m_type == SCAP_FD_IPV4_SOCK)
+		if(fdi.m_type == SCAP_FD_IPV4_SOCK)
 		{
-			if(m_inspector->m_thread_manager->m_server_ports.find(it->second.m_sockinfo.m_ipv4info.m_fields.m_sport) !=
+			if(m_inspector->m_thread_manager->m_server_ports.find(fdi.m_sockinfo.m_ipv4info.m_fields.m_sport) !=
 				m_inspector->m_thread_manager->m_server_ports.end())
 			{
 				uint32_t tip;
 				uint16_t tport;
 
-				tip = it->second.m_sockinfo.m_ipv4info.m_fields.m_sip;
-				tport = it->second.m_sockinfo.m_ipv4info.m_fields.m_sport;
+				tip = fdi.m_sockinfo.m_ipv4info.m_fields.m_sip;
+				tport = fdi.m_sockinfo.m_ipv4info.m_fields.m_sport;
 
-				it->second.m_sockinfo.m_ipv4info.m_fields.m_sip = it->second.m_sockinfo.m_ipv4info.m_fields.m_dip;
-				it->second.m_sockinfo.m_ipv4info.m_fields.m_dip = tip;
-				it->second.m_sockinfo.m_ipv4info.m_fields.m_sport = it->second.m_sockinfo.m_ipv4info.m_fields.m_dport;
-				it->second.m_sockinfo.m_ipv4info.m_fields.m_dport = tport;
+				fdi.m_sockinfo.m_ipv4info.m_fields.m_sip = fdi.m_sockinfo.m_ipv4info.m_fields.m_dip;
+				fdi.m_sockinfo.m_ipv4info.m_fields.m_dip = tip;
+				fdi.m_sockinfo.m_ipv4info.m_fields.m_sport = fdi.m_sockinfo.m_ipv4info.m_fields.m_dport;
+				fdi.m_sockinfo.m_ipv4info.m_fields.m_dport = tport;
 
-				it->second.m_name = ipv4tuple_to_string(&it->second.m_sockinfo.m_ipv4info, m_inspector->m_hostname_and_port_resolution_enabled);
+				fdi.m_name = ipv4tuple_to_string(&fdi.m_sockinfo.m_ipv4info, m_inspector->m_hostname_and_port_resolution_enabled);
 
-				it->second.set_role_server();
+				fdi.set_role_server();
 			}
 			else
 			{
-				it->second.set_role_client();
+				fdi.set_role_client();
 			}
 		}
-	}
+		return true;
+	});
 }
 
 #define STR_AS_NUM_JAVA 0x6176616a
@@ -367,7 +418,7 @@ void sinsp_threadinfo::add_fd_from_scap(scap_fdinfo *fdi, OUT sinsp_fdinfo_t *re
 		break;
 	case SCAP_FD_FILE_V2:
 		newfdi->m_openflags = fdi->info.regularinfo.open_flags;
-		newfdi->m_name = fdi->info.regularinfo.fname;
+		newfdi->add_filename(fdi->info.regularinfo.fname);
 		newfdi->m_dev = fdi->info.regularinfo.dev;
 		newfdi->m_mount_id = fdi->info.regularinfo.mount_id;
 
@@ -394,7 +445,7 @@ void sinsp_threadinfo::add_fd_from_scap(scap_fdinfo *fdi, OUT sinsp_fdinfo_t *re
 	case SCAP_FD_BPF:
 	case SCAP_FD_USERFAULTFD:
 	case SCAP_FD_IOURING:
-		newfdi->m_name = fdi->info.fname;
+		newfdi->add_filename(fdi->info.fname);
 
 		if(newfdi->m_name == USER_EVT_DEVICE_NAME)
 		{
@@ -564,19 +615,19 @@ void sinsp_threadinfo::set_user(uint32_t uid)
 	scap_userinfo *user = m_inspector->m_usergroup_manager.get_user(m_container_id, uid);
 	if (!user)
 	{
-		user = m_inspector->m_usergroup_manager.add_user(m_container_id, m_pid, uid, m_group.gid, NULL, NULL, NULL, m_inspector->is_live());
+		user = m_inspector->m_usergroup_manager.add_user(m_container_id, m_pid, uid, m_creds->m_group.gid, NULL, NULL, NULL, m_inspector->is_live());
 	}
 	if (user)
 	{
-		memcpy(&m_user, user, sizeof(scap_userinfo));
+		memcpy(&m_creds->m_user, user, sizeof(scap_userinfo));
 	}
 	else
 	{
-		m_user.uid = uid;
-		m_user.gid = m_group.gid;
-		strlcpy(m_user.name, (uid == 0) ? "root" : "<NA>", sizeof(m_user.name));
-		strlcpy(m_user.homedir, (uid == 0) ? "/root" : "<NA>", sizeof(m_user.homedir));
-		strlcpy(m_user.shell, "<NA>", sizeof(m_user.shell));
+		m_creds->m_user.uid = uid;
+		m_creds->m_user.gid = m_creds->m_group.gid;
+		strlcpy(m_creds->m_user.name, (uid == 0) ? "root" : "<NA>", sizeof(m_creds->m_user.name));
+		strlcpy(m_creds->m_user.homedir, (uid == 0) ? "/root" : "<NA>", sizeof(m_creds->m_user.homedir));
+		strlcpy(m_creds->m_user.shell, "<NA>", sizeof(m_creds->m_user.shell));
 	}
 }
 
@@ -589,14 +640,14 @@ void sinsp_threadinfo::set_group(uint32_t gid)
 	}
 	if (group)
 	{
-		memcpy(&m_group, group, sizeof(scap_groupinfo));
+		memcpy(&m_creds->m_group, group, sizeof(scap_groupinfo));
 	}
 	else
 	{
-		m_group.gid = gid;
-		strlcpy(m_group.name, (gid == 0) ? "root" : "<NA>", sizeof(m_group.name));
+		m_creds->m_group.gid = gid;
+		strlcpy(m_creds->m_group.name, (gid == 0) ? "root" : "<NA>", sizeof(m_creds->m_group.name));
 	}
-	m_user.gid = m_group.gid;
+	m_creds->m_user.gid = m_creds->m_group.gid;
 }
 
 void sinsp_threadinfo::set_loginuser(uint32_t loginuid)
@@ -604,27 +655,31 @@ void sinsp_threadinfo::set_loginuser(uint32_t loginuid)
 	scap_userinfo *login_user = m_inspector->m_usergroup_manager.get_user(m_container_id, loginuid);
 	if (login_user)
 	{
-		memcpy(&m_loginuser, login_user, sizeof(scap_userinfo));
+		memcpy(&m_creds->m_loginuser, login_user, sizeof(scap_userinfo));
 	}
 	else
 	{
-		m_loginuser.uid = loginuid;
-		m_loginuser.gid = m_group.gid;
-		strlcpy(m_loginuser.name, loginuid == 0 ? "root" : "<NA>", sizeof(m_loginuser.name));
-		strlcpy(m_loginuser.homedir, loginuid == 0  ? "/root" : "<NA>", sizeof(m_loginuser.homedir));
-		strlcpy(m_loginuser.shell, "<NA>", sizeof(m_loginuser.shell));
+		m_creds->m_loginuser.uid = loginuid;
+		m_creds->m_loginuser.gid = m_creds->m_group.gid;
+		strlcpy(m_creds->m_loginuser.name, loginuid == 0 ? "root" : "<NA>", sizeof(m_creds->m_loginuser.name));
+		strlcpy(m_creds->m_loginuser.homedir, loginuid == 0  ? "/root" : "<NA>", sizeof(m_creds->m_loginuser.homedir));
+		strlcpy(m_creds->m_loginuser.shell, "<NA>", sizeof(m_creds->m_loginuser.shell));
 	}
 }
 
-sinsp_threadinfo::cgroups_t& sinsp_threadinfo::cgroups() const
+const sinsp_threadinfo::cgroups_t& sinsp_threadinfo::cgroups() const
 {
-	if(m_cgroups)
+	if(m_cgroups_pending)
 	{
-		return *m_cgroups;
+		parse_cgroups();
 	}
+	return m_cgroups.get();
+}
 
-	static cgroups_t empty;
-	return empty;
+const std::string& sinsp_threadinfo::get_cgroups_param() const
+{
+	static const std::string empty;
+	return m_cgroups_param.empty() ? empty : m_cgroups_param[0];
 }
 
 std::string sinsp_threadinfo::get_comm() const
@@ -642,16 +697,32 @@ std::string sinsp_threadinfo::get_exepath() const
 	return m_exepath;
 }
 
-void sinsp_threadinfo::set_args(const char* args, size_t len)
+libsinsp::interned_vector<std::string> sinsp_threadinfo::intern_strvec(std::vector<std::string>&& strs) const
 {
-	m_args.clear();
+	libsinsp::interned_pool<std::string>* pool = get_strvec_pool();
+	if(pool == NULL)
+	{
+		return libsinsp::interned_vector<std::string>(std::move(strs));
+	}
+	return pool->intern(std::move(strs));
+}
 
-	size_t offset = 0;
-	while(offset < len)
+libsinsp::interned_pool<std::string>* sinsp_threadinfo::get_strvec_pool() const
+{
+	if(m_inspector == NULL || m_inspector->m_thread_manager == NULL)
 	{
-		m_args.push_back(args + offset);
-		offset += m_args.back().length() + 1;
+		return NULL;
 	}
+	return &m_inspector->m_thread_manager->get_strvec_pool();
+}
+
+//
+// The arguments and the environment are kept as they come in the event,
+// and only split into strings when something looks at them
+//
+void sinsp_threadinfo::set_args(const char* args, size_t len)
+{
+	m_args.assign(args, len, get_strvec_pool());
 }
 
 void sinsp_threadinfo::set_env(const char* env, size_t len)
@@ -669,32 +740,20 @@ void sinsp_threadinfo::set_env(const char* env, size_t len)
 		}
 	}
 
-	m_env.clear();
-	size_t offset = 0;
-	while(offset < len)
+	// the environment may actually be shorter than indicated by len,
+	// with the rest zeroed
+	size_t used = len;
+	while(used > 0 && env[used - 1] == '\0')
 	{
-		const char* left = env + offset;
-		// environment string may actually be shorter than indicated by len
-		// if the rest is empty, we bail out early
-		if(!strlen(left))
-		{
-			size_t sz = len - offset;
-			void* zero = calloc(sz, sizeof(char));
-			if(zero == NULL)
-			{
-				throw sinsp_exception("memory allocation error in sinsp_threadinfo::set_env");
-			}
-			if(!memcmp(left, zero, sz))
-			{
-				free(zero);
-				return;
-			}
-			free(zero);
-		}
-		m_env.push_back(left);
-
-		offset += m_env.back().length() + 1;
+		used--;
 	}
+	if(used < len)
+	{
+		// keep the terminator of the last string
+		used++;
+	}
+
+	m_env.assign(env, used, get_strvec_pool());
 }
 
 bool sinsp_threadinfo::set_env_from_proc() {
@@ -707,20 +766,26 @@ bool sinsp_threadinfo::set_env_from_proc() {
 		return false;
 	}
 
-	m_env.clear();
+	std::vector<std::string> tmp_env;
 	while (environment) {
 		std::string env;
 		getline(environment, env, '\0');
 		if (!env.empty())
 		{
-			m_env.emplace_back(env);
+			tmp_env.emplace_back(env);
 		}
 	}
+	m_env = intern_strvec(std::move(tmp_env));
 
 	return true;
 }
 
 const std::vector<std::string>& sinsp_threadinfo::get_env()
+{
+	return get_env_strvec().get();
+}
+
+const libsinsp::lazy_strvec& sinsp_threadinfo::get_env_strvec()
 {
 	if(is_main_thread())
 	{
@@ -731,7 +796,7 @@ const std::vector<std::string>& sinsp_threadinfo::get_env()
 		auto mtinfo = get_main_thread();
 		if(mtinfo != nullptr)
 		{
-			return mtinfo->get_env();
+			return mtinfo->get_env_strvec();
 		}
 		else
 		{
@@ -765,14 +830,58 @@ std::string sinsp_threadinfo::get_env(const std::string& name)
 	return "";
 }
 
+//
+// The cgroups are only parsed when something looks at them: most of the
+// time a process execs in the cgroups it already had, and the container
+// manager recognizes the cgroups it has already resolved from the
+// parameter alone (see get_cgroups_param())
+//
 void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
 {
-	decltype(m_cgroups) tmp_cgroups(new cgroups_t);
+	const std::string& current = get_cgroups_param();
+	size_t cmp_len = (len != 0 && cgroups[len - 1] != '\0') ? len + 1 : len;
+	if(current.size() == cmp_len && memcmp(current.data(), cgroups, len) == 0)
+	{
+		return;
+	}
+
+	if(len == 0)
+	{
+		m_cgroups_param = libsinsp::interned_vector<std::string>();
+		m_cgroups = libsinsp::interned_vector<std::pair<std::string, std::string>>();
+		m_cgroups_pending = false;
+		return;
+	}
+
+	std::vector<std::string> param(1, std::string(cgroups, len));
+	if(param[0].back() != '\0')
+	{
+		param[0].push_back('\0');
+	}
+	m_cgroups_param = intern_strvec(std::move(param));
+	m_cgroups_pending = true;
+}
+
+void sinsp_threadinfo::parse_cgroups() const
+{
+	cgroups_t tmp_cgroups;
+	const std::string& param = get_cgroups_param();
+	const char* cgroups = param.data();
+	size_t len = param.size();
+
+	m_cgroups_pending = false;
 
 	size_t offset = 0;
 	while(offset < len)
 	{
 		const char* str = cgroups + offset;
+		if(*str == '\0')
+		{
+			// An empty entry, e.g. a doubled terminator at the end
+			offset++;
+			continue;
+		}
+
 		const char* sep = strrchr(str, '=');
 		if(sep == NULL)
 		{
@@ -806,16 +915,40 @@ void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
 			subsys = "blkio";
 		}
 
-		tmp_cgroups->push_back(std::make_pair(subsys, cgroup));
+		tmp_cgroups.push_back(std::make_pair(subsys, cgroup));
 		offset += subsys_length + 1 + cgroup.length() + 1;
 	}
 
-	m_cgroups.swap(tmp_cgroups);
+	if(m_inspector == NULL || m_inspector->m_thread_manager == NULL)
+	{
+		m_cgroups = libsinsp::interned_vector<std::pair<std::string, std::string>>(std::move(tmp_cgroups));
+	}
+	else
+	{
+		m_cgroups = m_inspector->m_thread_manager->get_cgroups_pool().intern(std::move(tmp_cgroups));
+	}
 }
 
 sinsp_threadinfo* sinsp_threadinfo::get_parent_thread()
 {
-	return m_inspector->get_thread_ref(m_ptid, false, true).get();
+	return m_inspector->get_thread(m_ptid, false, true);
+}
+
+const std::vector<sinsp_threadinfo*>& sinsp_threadinfo::get_ancestors()
+{
+	uint64_t version = m_inspector->m_thread_manager->get_ancestors_version();
+	if(m_ancestors_version != version)
+	{
+		m_ancestors.clear();
+		visitor_func_t visitor = [this] (sinsp_threadinfo *pt)
+		{
+			m_ancestors.push_back(pt);
+			return true;
+		};
+		traverse_parent_state(visitor);
+		m_ancestors_version = version;
+	}
+	return m_ancestors;
 }
 
 sinsp_fdinfo_t* sinsp_threadinfo::add_fd(int64_t fd, sinsp_fdinfo_t *fdinfo)
@@ -849,8 +982,6 @@ void sinsp_threadinfo::remove_fd(int64_t fd)
 
 bool sinsp_threadinfo::is_bound_to_port(uint16_t number)
 {
-	std::unordered_map<int64_t, sinsp_fdinfo_t>::iterator it;
-
 	sinsp_fdtable* fdt = get_fd_table();
 	if(fdt == NULL)
 	{
@@ -858,31 +989,31 @@ bool sinsp_threadinfo::is_bound_to_port(uint16_t number)
 		return false;
 	}
 
-	for(it = fdt->m_table.begin(); it != fdt->m_table.end(); ++it)
+	bool found = false;
+	fdt->const_loop([&](int64_t fd, const sinsp_fdinfo_t& fdi)
 	{
-		if(it->second.m_type == SCAP_FD_IPV4_SOCK)
+		if(fdi.m_type == SCAP_FD_IPV4_SOCK)
 		{
-			if(it->second.m_sockinfo.m_ipv4info.m_fields.m_dport == number)
+			if(fdi.m_sockinfo.m_ipv4info.m_fields.m_dport == number)
 			{
-				return true;
+				found = true;
 			}
 		}
-		else if(it->second.m_type == SCAP_FD_IPV4_SERVSOCK)
+		else if(fdi.m_type == SCAP_FD_IPV4_SERVSOCK)
 		{
-			if(it->second.m_sockinfo.m_ipv4serverinfo.m_port == number)
+			if(fdi.m_sockinfo.m_ipv4serverinfo.m_port == number)
 			{
-				return true;
+				found = true;
 			}
 		}
-	}
+		return !found;
+	});
 
-	return false;
+	return found;
 }
 
 bool sinsp_threadinfo::uses_client_port(uint16_t number)
 {
-	std::unordered_map<int64_t, sinsp_fdinfo_t>::iterator it;
-
 	sinsp_fdtable* fdt = get_fd_table();
 	if(fdt == NULL)
 	{
@@ -890,19 +1021,20 @@ bool sinsp_threadinfo::uses_client_port(uint16_t number)
 		return false;
 	}
 
-	for(it = fdt->m_table.begin();
-		it != fdt->m_table.end(); ++it)
+	bool found = false;
+	fdt->const_loop([&](int64_t fd, const sinsp_fdinfo_t& fdi)
 	{
-		if(it->second.m_type == SCAP_FD_IPV4_SOCK)
+		if(fdi.m_type == SCAP_FD_IPV4_SOCK)
 		{
-			if(it->second.m_sockinfo.m_ipv4info.m_fields.m_sport == number)
+			if(fdi.m_sockinfo.m_ipv4info.m_fields.m_sport == number)
 			{
-				return true;
+				found = true;
 			}
 		}
-	}
+		return !found;
+	});
 
-	return false;
+	return found;
 }
 
 bool sinsp_threadinfo::is_lastevent_data_valid()
@@ -922,8 +1054,10 @@ sinsp_threadinfo* sinsp_threadinfo::get_cwd_root()
 	}
 }
 
-std::string sinsp_threadinfo::get_cwd()
+const std::string& sinsp_threadinfo::get_cwd()
 {
+	static const std::string fallback = "./";
+
 	// Ideally we should use get_cwd_root()
 	// but scap does not read CLONE_FS from /proc
 	// Also glibc and muslc use always
@@ -938,7 +1072,7 @@ std::string sinsp_threadinfo::get_cwd()
 	else
 	{
 		ASSERT(false);
-		return "./";
+		return fallback;
 	}
 }
 
@@ -1115,10 +1249,10 @@ void sinsp_threadinfo::populate_cmdline(std::string &cmdline, const sinsp_thread
 {
 	cmdline = tinfo->get_comm();
 
-	for (const auto& arg : tinfo->m_args)
+	if(!tinfo->m_args.empty())
 	{
 		cmdline += " ";
-		cmdline += arg;
+		tinfo->m_args.join(cmdline, ' ');
 	}
 }
 
@@ -1378,12 +1512,109 @@ void sinsp_threadinfo::fd_to_scap(scap_fdinfo *dst, sinsp_fdinfo_t* src)
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_threadinfo_pool implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_threadinfo_pool::~sinsp_threadinfo_pool()
+{
+	for(auto tinfo : m_free)
+	{
+		delete tinfo;
+	}
+}
+
+sinsp_threadinfo* sinsp_threadinfo_pool::get(const std::shared_ptr<libsinsp::state::dynamic_struct::field_infos>& dyn_fields)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+
+	while(!m_free.empty())
+	{
+		sinsp_threadinfo* tinfo = m_free.back();
+		m_free.pop_back();
+
+		if(tinfo->dynamic_fields() == dyn_fields)
+		{
+			m_n_reused++;
+			return tinfo;
+		}
+
+		// The definitions of the dynamic fields have changed since this
+		// threadinfo was created, it can't be reused
+		delete tinfo;
+	}
+
+	return NULL;
+}
+
+std::shared_ptr<sinsp_threadinfo> sinsp_threadinfo_pool::wrap(sinsp_threadinfo* tinfo)
+{
+	//
+	// Threadinfos of derived classes (e.g. built by an external event
+	// processor) are destroyed as usual
+	//
+	if(m_max_size == 0 || typeid(*tinfo) != typeid(sinsp_threadinfo))
+	{
+		return std::shared_ptr<sinsp_threadinfo>(tinfo);
+	}
+
+	// The threadinfo can outlive the pool if someone holds a reference
+	std::weak_ptr<sinsp_threadinfo_pool> pool = shared_from_this();
+	return std::shared_ptr<sinsp_threadinfo>(tinfo, [pool](sinsp_threadinfo* t)
+	{
+		auto p = pool.lock();
+		if(p)
+		{
+			p->put(t);
+		}
+		else
+		{
+			delete t;
+		}
+	});
+}
+
+void sinsp_threadinfo_pool::put(sinsp_threadinfo* tinfo)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if(m_free.size() >= m_max_size)
+		{
+			delete tinfo;
+			return;
+		}
+	}
+
+	tinfo->recycle();
+
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_free.push_back(tinfo);
+}
+
+void sinsp_threadinfo_pool::set_max_size(uint32_t max_size)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+
+	m_max_size = max_size;
+	while(m_free.size() > m_max_size)
+	{
+		delete m_free.back();
+		m_free.pop_back();
+	}
+}
+
+uint32_t sinsp_threadinfo_pool::size()
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_free.size();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_thread_manager implementation
 ///////////////////////////////////////////////////////////////////////////////
 sinsp_thread_manager::sinsp_thread_manager(sinsp* inspector)
 	: table(s_thread_table_name, sinsp_threadinfo().static_fields()),
-	  m_max_thread_table_size(m_thread_table_absolute_max_size)
+	  m_max_thread_table_size(m_thread_table_absolute_max_size),
+	  m_threadinfo_pool(std::make_shared<sinsp_threadinfo_pool>(DEFAULT_MAX_RECYCLED_THREADS))
 {
 	m_inspector = inspector;
 	clear();
@@ -1392,10 +1623,18 @@ sinsp_thread_manager::sinsp_thread_manager(sinsp* inspector)
 void sinsp_thread_manager::clear()
 {
 	m_threadtable.clear();
+	m_process_threads.clear();
+	m_memory.clear();
+	invalidate_ancestors();
 	m_last_tid = 0;
 	m_last_tinfo.reset();
 	m_last_flush_time_ns = 0;
+	m_purge_in_progress = false;
+	m_purge_scheduled = false;
+	m_purge_cursor = 0;
 	m_n_drops = 0;
+	m_failed_proc_lookups.clear();
+	m_removed_workloads.clear();
 
 #ifdef GATHER_INTERNAL_STATS
 	m_failed_lookups = &m_inspector->m_stats.get_metrics_registry().register_counter(internal_metrics::metric_name("thread_failed_lookups","Failed thread lookups"));
@@ -1403,6 +1642,8 @@ void sinsp_thread_manager::clear()
 	m_non_cached_lookups = &m_inspector->m_stats.get_metrics_registry().register_counter(internal_metrics::metric_name("thread_non_cached_lookups","Non cached thread lookups"));
 	m_added_threads = &m_inspector->m_stats.get_metrics_registry().register_counter(internal_metrics::metric_name("thread_added","Number of added threads"));
 	m_removed_threads = &m_inspector->m_stats.get_metrics_registry().register_counter(internal_metrics::metric_name("thread_removed","Removed threads"));
+	m_throttled_proc_lookups = &m_inspector->m_stats.get_metrics_registry().register_counter(internal_metrics::metric_name("thread_throttled_proc_lookups","Proc lookups over budget"));
+	m_negative_cached_proc_lookups = &m_inspector->m_stats.get_metrics_registry().register_counter(internal_metrics::metric_name("thread_negative_cached_proc_lookups","Proc lookups of recently failed tids"));
 #endif
 }
 
@@ -1416,10 +1657,16 @@ void sinsp_thread_manager::increment_mainthread_childcount(sinsp_threadinfo* thr
 		//
 		ASSERT(threadinfo->m_pid != threadinfo->m_tid);
 
-		sinsp_threadinfo* main_thread = m_inspector->get_thread_ref(threadinfo->m_pid, true, true).get();
+		if(!m_process_threads[threadinfo->m_pid].insert(threadinfo->m_tid).second)
+		{
+			// Already counted
+			return;
+		}
+
+		sinsp_threadinfo* main_thread = m_inspector->get_thread(threadinfo->m_pid, true, true);
 		if(main_thread)
 		{
-			++main_thread->m_nchilds;
+			main_thread->m_nchilds = get_process_thread_count(threadinfo->m_pid);
 		}
 		else
 		{
@@ -1428,12 +1675,183 @@ void sinsp_thread_manager::increment_mainthread_childcount(sinsp_threadinfo* thr
 	}
 }
 
+void sinsp_thread_manager::decrement_mainthread_childcount(sinsp_threadinfo* threadinfo)
+{
+	auto it = m_process_threads.find(threadinfo->m_pid);
+	if(it == m_process_threads.end() || it->second.erase(threadinfo->m_tid) == 0)
+	{
+		// Never counted, or dropped by an execve of its process
+		return;
+	}
+
+	uint64_t nchilds = it->second.size();
+	if(nchilds == 0)
+	{
+		m_process_threads.erase(it);
+	}
+
+	sinsp_threadinfo* main_thread = m_inspector->get_thread(threadinfo->m_pid, false, true);
+	if(main_thread)
+	{
+		main_thread->m_nchilds = nchilds;
+
+		// If the main thread has already been
+		// closed and now has no children,
+		// remove it now.
+		if((main_thread->m_flags & PPM_CL_CLOSED) &&
+		   main_thread->m_nchilds == 0)
+		{
+			m_inspector->m_tid_to_remove = main_thread->m_tid;
+		}
+	}
+}
+
+void sinsp_thread_manager::reset_mainthread_childcount(sinsp_threadinfo* main_thread)
+{
+	m_process_threads.erase(main_thread->m_pid);
+	main_thread->m_nchilds = 0;
+}
+
+uint64_t sinsp_thread_manager::get_process_thread_count(int64_t pid) const
+{
+	auto it = m_process_threads.find(pid);
+	return it == m_process_threads.end() ? 0 : it->second.size();
+}
+
 std::unique_ptr<sinsp_threadinfo> sinsp_thread_manager::new_threadinfo() const
 {
-	auto tinfo = new sinsp_threadinfo(m_inspector, dynamic_fields());
+	auto tinfo = m_threadinfo_pool->get(dynamic_fields());
+	if(tinfo == NULL)
+	{
+		tinfo = new sinsp_threadinfo(m_inspector, dynamic_fields());
+	}
 	return std::unique_ptr<sinsp_threadinfo>(tinfo);
 }
 
+//
+// The fds are accounted in their own table, and the interned args, env
+// and cgroups are shared with the other threads, so they aren't counted
+//
+uint32_t sinsp_thread_manager::estimate_memory(const sinsp_threadinfo& tinfo)
+{
+	return sizeof(sinsp_threadinfo) +
+		sizeof(sinsp_threadinfo::credentials) +
+		sinsp_table_memory::HASH_NODE_BYTES +
+		sinsp_table_memory::string_bytes(tinfo.m_comm) +
+		sinsp_table_memory::string_bytes(tinfo.m_exe) +
+		sinsp_table_memory::string_bytes(tinfo.m_exepath) +
+		sinsp_table_memory::string_bytes(tinfo.m_container_id) +
+		sinsp_table_memory::string_bytes(tinfo.m_root) +
+		sinsp_table_memory::string_bytes(tinfo.m_cwd);
+}
+
+sinsp_threadinfo* sinsp_thread_manager::find_cold(const std::function<bool(sinsp_threadinfo&)>& evictable)
+{
+	//
+	// Nothing the current event accessed is evicted, the parsers may
+	// still be holding it
+	//
+	uint64_t now = m_inspector->get_lastevent_ts();
+	sinsp_threadinfo* res = nullptr;
+	auto visit = [&](sinsp_threadinfo& tinfo)
+	{
+		if(tinfo.m_lastaccess_ts < now &&
+		   (res == nullptr || tinfo.m_lastaccess_ts < res->m_lastaccess_ts) &&
+#if defined(HAS_CAPTURE)
+		   tinfo.m_pid != m_inspector->m_self_pid &&
+#endif
+		   evictable(tinfo))
+		{
+			res = &tinfo;
+		}
+	};
+
+	//
+	// Past the end of the table, the hand goes back to its start
+	//
+	for(uint32_t j = 0; j < 2 && res == nullptr; j++)
+	{
+		if(m_threadtable.loop_slice(m_eviction_cursor, STATE_EVICTION_SLICE_SIZE, visit))
+		{
+			m_eviction_cursor = 0;
+		}
+	}
+	return res;
+}
+
+bool sinsp_thread_manager::evict_cold_threads(const sinsp_threadinfo* keep)
+{
+	if(!m_eviction)
+	{
+		return false;
+	}
+
+	//
+	// The main threads are only evicted with their process, and the
+	// thread being added keeps its process and its parent
+	//
+	auto evictable = [keep](sinsp_threadinfo& tinfo)
+	{
+		return (!tinfo.is_main_thread() || tinfo.m_nchilds == 0) &&
+			tinfo.m_tid != keep->m_tid &&
+			tinfo.m_tid != keep->m_pid &&
+			tinfo.m_tid != keep->m_ptid;
+	};
+
+	for(uint32_t j = 0; j < STATE_EVICTION_MAX_VICTIMS; j++)
+	{
+		if(m_threadtable.size() < m_max_thread_table_size && !m_memory.over_budget())
+		{
+			return true;
+		}
+
+		sinsp_threadinfo* victim = find_cold(evictable);
+		if(victim == nullptr)
+		{
+			return false;
+		}
+		m_memory.add_evictions(1);
+		remove_thread(victim->m_tid, true);
+	}
+
+	return m_threadtable.size() < m_max_thread_table_size && !m_memory.over_budget();
+}
+
+//
+// The fds are evicted a whole process at a time: its table is emptied,
+// and loaded again from /proc the next time it's accessed, like after a
+// lazy fd scan
+//
+void sinsp_thread_manager::evict_cold_fds()
+{
+	auto evictable = [](sinsp_threadinfo& tinfo)
+	{
+		return tinfo.is_main_thread() &&
+			!tinfo.m_fdtable.is_lazy_load_pending() &&
+			tinfo.m_fdtable.size() != 0;
+	};
+
+	sinsp_table_memory& fd_memory = m_inspector->m_fd_memory;
+	for(uint32_t j = 0; j < STATE_EVICTION_MAX_VICTIMS && fd_memory.over_budget(); j++)
+	{
+		sinsp_threadinfo* victim = find_cold(evictable);
+		if(victim == nullptr)
+		{
+			break;
+		}
+		fd_memory.add_evictions(victim->m_fdtable.size());
+		victim->m_fdtable.clear();
+		victim->m_fdtable.set_lazy_load_pending();
+	}
+
+	//
+	// Try again at the next event while there's no room, the new fds
+	// being refused in the meanwhile
+	//
+	m_fd_eviction_stalled = fd_memory.over_budget();
+	m_fd_eviction_pending = m_fd_eviction_stalled;
+}
+
 bool sinsp_thread_manager::add_thread(sinsp_threadinfo *threadinfo, bool from_scap_proctable)
 {
 #ifdef GATHER_INTERNAL_STATS
@@ -1442,18 +1860,24 @@ bool sinsp_thread_manager::add_thread(sinsp_threadinfo *threadinfo, bool from_sc
 
 	m_last_tinfo.reset();
 
-	if(m_threadtable.size() >= m_max_thread_table_size
+	if((m_threadtable.size() >= m_max_thread_table_size || m_memory.over_budget())
 #if defined(HAS_CAPTURE)
 	   && threadinfo->m_pid != m_inspector->m_self_pid
 #endif
-	)
+	   && !evict_cold_threads(threadinfo))
 	{
+		bool over_budget = m_memory.over_budget();
 		// rate limit messages to avoid spamming the logs
 		if (m_n_drops % m_max_thread_table_size == 0)
 		{
-			g_logger.format(sinsp_logger::SEV_INFO, "Thread table full, dropping tid %lu (pid %lu, comm \"%s\")",
+			g_logger.format(sinsp_logger::SEV_INFO, "Thread table %s, dropping tid %lu (pid %lu, comm \"%s\")",
+				over_budget ? "over its memory budget" : "full",
 				threadinfo->m_tid, threadinfo->m_pid, threadinfo->m_comm.c_str());
 		}
+		if(over_budget)
+		{
+			m_memory.add_budget_drop();
+		}
 		m_n_drops++;
 		return false;
 	}
@@ -1463,6 +1887,15 @@ bool sinsp_thread_manager::add_thread(sinsp_threadinfo *threadinfo, bool from_sc
 		increment_mainthread_childcount(threadinfo);
 	}
 
+	//
+	// A main thread created after its threads (e.g. out of thin air, or
+	// after a forced removal) gets its refcount from the process index
+	//
+	if(threadinfo->m_tid == threadinfo->m_pid)
+	{
+		threadinfo->m_nchilds = get_process_thread_count(threadinfo->m_pid);
+	}
+
 	if (threadinfo->dynamic_fields() == nullptr)
 	{
 		threadinfo->set_dynamic_fields(dynamic_fields());
@@ -1473,14 +1906,23 @@ bool sinsp_thread_manager::add_thread(sinsp_threadinfo *threadinfo, bool from_sc
 	}
 
 	threadinfo->compute_program_hash();
-	m_threadtable.put(threadinfo);
+
+	sinsp_threadinfo* replaced = m_threadtable.get(threadinfo->m_tid);
+	if(replaced != nullptr)
+	{
+		m_memory.remove(replaced->m_accounted_bytes);
+	}
+	threadinfo->m_accounted_bytes = estimate_memory(*threadinfo);
+	m_memory.add(threadinfo->m_accounted_bytes);
+
+	m_threadtable.put(m_threadinfo_pool->wrap(threadinfo));
+	invalidate_ancestors();
 
 	return true;
 }
 
 void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 {
-	uint64_t nchilds;
 	sinsp_threadinfo* tinfo = m_threadtable.get(tid);
 
 	if(tinfo == nullptr)
@@ -1496,7 +1938,7 @@ void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 #endif
 		return;
 	}
-	else if((nchilds = tinfo->m_nchilds) == 0 || force)
+	else if(tinfo->m_nchilds == 0 || force)
 	{
 		//
 		// Decrement the refcount of the main thread/program because
@@ -1505,31 +1947,7 @@ void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 		if(tinfo->m_flags & PPM_CL_CLONE_THREAD)
 		{
 			ASSERT(tinfo->m_pid != tinfo->m_tid);
-			sinsp_threadinfo* main_thread = m_inspector->get_thread_ref(tinfo->m_pid, false, true).get();
-			if(main_thread)
-			{
-				if(main_thread->m_nchilds > 0)
-				{
-					--main_thread->m_nchilds;
-				}
-				else
-				{
-					ASSERT(false);
-				}
-
-				// If the main thread has already been
-				// closed and now has no children,
-				// remove it now.
-				if((main_thread->m_flags & PPM_CL_CLOSED) &&
-				   main_thread->m_nchilds == 0)
-				{
-					m_inspector->m_tid_to_remove = main_thread->m_tid;
-				}
-			}
-			else
-			{
-				ASSERT(false);
-			}
+			decrement_mainthread_childcount(tinfo);
 		}
 
 		//
@@ -1543,27 +1961,49 @@ void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 				ASSERT(false);
 				return;
 			}
-			std::unordered_map<int64_t, sinsp_fdinfo_t>* fdtable = &(fd_table_ptr->m_table);
-
-			std::unordered_map<int64_t, sinsp_fdinfo_t>::iterator fdit;
+			//
+			// Nobody has seen the fds that were never loaded
+			//
+			if(fd_table_ptr->is_lazy_load_pending())
+			{
+				fd_table_ptr->clear();
+			}
 
 			erase_fd_params eparams;
 			eparams.m_remove_from_table = false;
 			eparams.m_tinfo = tinfo;
 			eparams.m_ts = m_inspector->m_lastevent_ts;
 
-			for(fdit = fdtable->begin(); fdit != fdtable->end(); ++fdit)
+			fd_table_ptr->loop([&](int64_t fd, sinsp_fdinfo_t& fdinfo)
 			{
-				eparams.m_fd = fdit->first;
+				eparams.m_fd = fd;
 
 				//
 				// The canceled fd should always be deleted immediately, so if it appears
 				// here it means we have a problem.
 				//
 				ASSERT(eparams.m_fd != CANCELED_FD_NUMBER);
-				eparams.m_fdinfo = &(fdit->second);
+				eparams.m_fdinfo = &fdinfo;
 
 				m_inspector->m_parser->erase_fd(&eparams);
+				return true;
+			});
+		}
+
+		//
+		// Keep the workload counted for the thread: a thread leaves it to
+		// its process, the last thread of a process to its container
+		//
+		if(tinfo->m_workload.m_num_events != 0)
+		{
+			sinsp_threadinfo* main_thread = tinfo->is_main_thread() ? nullptr : tinfo->get_main_thread();
+			if(main_thread != nullptr && main_thread != tinfo)
+			{
+				main_thread->m_workload.add(tinfo->m_workload);
+			}
+			else
+			{
+				m_removed_workloads[tinfo->m_container_id].add(tinfo->m_workload);
 			}
 		}
 
@@ -1577,18 +2017,16 @@ void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 		m_removed_threads->increment();
 #endif
 
+		m_memory.remove(tinfo->m_accounted_bytes);
 		m_threadtable.erase(tid);
+		invalidate_ancestors();
 
 		//
-		// If the thread has a nonzero refcount, it means that we are forcing the removal
-		// of a main process or program that some child refer to.
-		// We need to recalculate the child relationships, or the table will become
-		// corrupted.
+		// If the thread has a nonzero refcount, we are forcing the removal
+		// of a main thread that some threads still refer to. Their entries
+		// stay in the process index, so that a main thread re-created later
+		// gets the right refcount.
 		//
-		if(nchilds != 0)
-		{
-			recreate_child_dependencies();
-		}
 	}
 }
 
@@ -1600,6 +2038,71 @@ void sinsp_thread_manager::fix_sockets_coming_from_proc()
 	});
 }
 
+std::unordered_map<int64_t, sinsp_threadinfo::workload_counters> sinsp_thread_manager::get_process_workloads()
+{
+	std::unordered_map<int64_t, sinsp_threadinfo::workload_counters> res;
+	m_threadtable.const_loop([&res](const sinsp_threadinfo& tinfo)
+	{
+		if(tinfo.m_workload.m_num_events != 0)
+		{
+			res[tinfo.m_pid].add(tinfo.m_workload);
+		}
+		return true;
+	});
+	return res;
+}
+
+std::unordered_map<std::string, sinsp_threadinfo::workload_counters> sinsp_thread_manager::get_container_workloads()
+{
+	std::unordered_map<std::string, sinsp_threadinfo::workload_counters> res = m_removed_workloads;
+	m_threadtable.const_loop([&res](const sinsp_threadinfo& tinfo)
+	{
+		if(tinfo.m_workload.m_num_events != 0)
+		{
+			res[tinfo.m_container_id].add(tinfo.m_workload);
+		}
+		return true;
+	});
+	return res;
+}
+
+static void add_workload_stats(std::vector<scap_stats_v2>& stats, const std::string& prefix, const sinsp_threadinfo::workload_counters& counters)
+{
+	scap_stats_v2 stat;
+	stat.flags = PPM_SCAP_STATS_WORKLOAD_COUNTERS;
+	stat.type = STATS_VALUE_TYPE_U64;
+
+	strlcpy(stat.name, (prefix + ".events").c_str(), STATS_NAME_MAX);
+	stat.value.u64 = counters.m_num_events;
+	stats.push_back(stat);
+
+	strlcpy(stat.name, (prefix + ".bytes_read").c_str(), STATS_NAME_MAX);
+	stat.value.u64 = counters.m_bytes_read;
+	stats.push_back(stat);
+
+	strlcpy(stat.name, (prefix + ".bytes_written").c_str(), STATS_NAME_MAX);
+	stat.value.u64 = counters.m_bytes_written;
+	stats.push_back(stat);
+}
+
+const scap_stats_v2* sinsp_thread_manager::get_workload_stats(uint32_t* nstats)
+{
+	m_workload_stats.clear();
+	for(const auto& it : get_container_workloads())
+	{
+		add_workload_stats(m_workload_stats,
+				   "workload.container." + (it.first.empty() ? std::string("host") : it.first),
+				   it.second);
+	}
+	for(const auto& it : get_process_workloads())
+	{
+		add_workload_stats(m_workload_stats, "workload.process." + std::to_string(it.first), it.second);
+	}
+
+	*nstats = m_workload_stats.size();
+	return m_workload_stats.data();
+}
+
 void sinsp_thread_manager::clear_thread_pointers(sinsp_threadinfo& tinfo)
 {
 	tinfo.m_main_thread.reset();
@@ -1626,6 +2129,7 @@ void sinsp_thread_manager::reset_child_dependencies()
 	m_last_tinfo.reset();
 	m_last_tid = 0;
 
+	m_process_threads.clear();
 	m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
 		tinfo.m_nchilds = 0;
 		clear_thread_pointers(tinfo);
@@ -1653,16 +2157,29 @@ void sinsp_thread_manager::update_statistics()
 	m_inspector->m_stats.m_n_threads = get_thread_count();
 
 	m_inspector->m_stats.m_n_fds = 0;
-	for(threadinfo_map_iterator_t it = m_threadtable.begin(); it != m_threadtable.end(); it++)
+	for(auto& tinfo : m_threadtable)
 	{
-		sinsp_fdtable* fd_table_ptr = it->second.get_fd_table();
+		sinsp_fdtable* fd_table_ptr = tinfo.get_fd_table();
 		if(fd_table_ptr == NULL)
 		{
 			ASSERT(false);
 			return;
 		}
-		m_inspector->m_stats.m_n_fds += fd_table_ptr->size();
+		if(!fd_table_ptr->is_lazy_load_pending())
+		{
+			m_inspector->m_stats.m_n_fds += fd_table_ptr->size();
+		}
 	}
+
+	auto lazy_fd_stats = m_inspector->get_lazy_fd_loader()->get_stats();
+	m_inspector->m_stats.m_n_lazy_fd_loads = lazy_fd_stats.m_n_loads;
+	m_inspector->m_stats.m_n_prefetched_fd_loads = lazy_fd_stats.m_n_prefetched_loads;
+
+	auto strvec_stats = m_strvec_pool.get_stats();
+	auto cgroups_stats = m_cgroups_pool.get_stats();
+	m_inspector->m_stats.m_n_interned_vectors = strvec_stats.m_values + cgroups_stats.m_values;
+	m_inspector->m_stats.m_interned_bytes = strvec_stats.m_bytes + cgroups_stats.m_bytes;
+	m_inspector->m_stats.m_interned_unshared_bytes = strvec_stats.m_unshared_bytes + cgroups_stats.m_unshared_bytes;
 #endif
 }
 
@@ -1695,8 +2212,8 @@ void sinsp_thread_manager::thread_to_scap(sinsp_threadinfo& tinfo, 	scap_threadi
 
 	sctinfo->flags = tinfo.m_flags ;
 	sctinfo->fdlimit = tinfo.m_fdlimit;
-	sctinfo->uid = tinfo.m_user.uid;
-	sctinfo->gid = tinfo.m_group.gid;
+	sctinfo->uid = tinfo.get_user()->uid;
+	sctinfo->gid = tinfo.get_group()->gid;
 	sctinfo->vmsize_kb = tinfo.m_vmsize_kb;
 	sctinfo->vmrss_kb = tinfo.m_vmrss_kb;
 	sctinfo->vmswap_kb = tinfo.m_vmswap_kb;
@@ -1705,7 +2222,7 @@ void sinsp_thread_manager::thread_to_scap(sinsp_threadinfo& tinfo, 	scap_threadi
 	sctinfo->vtid = tinfo.m_vtid;
 	sctinfo->vpid = tinfo.m_vpid;
 	sctinfo->fdlist = NULL;
-	sctinfo->loginuid = tinfo.m_loginuser.uid;
+	sctinfo->loginuid = tinfo.get_loginuser()->uid;
 	sctinfo->filtered_out = false;
 }
 
@@ -1722,27 +2239,29 @@ void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
 			throw sinsp_exception("Failed to create proclist dumper");
 	}
 
+	// thread_to_scap sets all the fields the entries need, so a single
+	// scap_threadinfo serves the whole table
+	scap_threadinfo *sctinfo = scap_proc_alloc(m_inspector->m_h);
+	if(sctinfo == NULL)
+	{
+		scap_dump_close(proclist_dumper);
+		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
+	}
+
 	uint32_t totlen = 0;
+	struct iovec *args_iov, *envs_iov, *cgroups_iov;
+	int argscnt, envscnt, cgroupscnt;
+	std::string argsrem, envsrem, cgroupsrem;
 	m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
-		scap_threadinfo *sctinfo;
-		struct iovec *args_iov, *envs_iov, *cgroups_iov;
-		int argscnt, envscnt, cgroupscnt;
-		std::string argsrem, envsrem, cgroupsrem;
 		uint32_t entrylen = 0;
 		auto cg = tinfo.cgroups();
 
-		if((sctinfo = scap_proc_alloc(m_inspector->m_h)) == NULL)
-		{
-			scap_dump_close(proclist_dumper);
-			throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
-		}
-
 		thread_to_scap(tinfo, sctinfo);
 		tinfo.args_to_iovec(&args_iov, &argscnt, argsrem);
 		tinfo.env_to_iovec(&envs_iov, &envscnt, envsrem);
 		tinfo.cgroups_to_iovec(&cgroups_iov, &cgroupscnt, cgroupsrem, cg);
 
-		if(scap_write_proclist_entry_bufs(proclist_dumper, sctinfo, &entrylen,
+		int32_t res = scap_write_proclist_entry_bufs(proclist_dumper, sctinfo, &entrylen,
 						  tinfo.m_comm.c_str(),
 						  tinfo.m_exe.c_str(),
 						  tinfo.m_exepath.c_str(),
@@ -1750,23 +2269,26 @@ void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
 						  envs_iov, envscnt,
 						  (tinfo.m_cwd == "" ? "/" : tinfo.m_cwd.c_str()),
 						  cgroups_iov, cgroupscnt,
-						  tinfo.m_root.c_str()) != SCAP_SUCCESS)
+						  tinfo.m_root.c_str());
+
+		free(args_iov);
+		free(envs_iov);
+		free(cgroups_iov);
+
+		if(res != SCAP_SUCCESS)
 		{
 			sinsp_exception exc(scap_dump_getlasterr(proclist_dumper));
+			scap_proc_free(m_inspector->m_h, sctinfo);
 			scap_dump_close(proclist_dumper);
 			throw exc;
 		}
 
 		totlen += entrylen;
-
-		free(args_iov);
-		free(envs_iov);
-		free(cgroups_iov);
-
-		scap_proc_free(m_inspector->m_h, sctinfo);
 		return true;
 	});
 
+	scap_proc_free(m_inspector->m_h, sctinfo);
+
 	if(scap_write_proclist_end(dumper, proclist_dumper, totlen) != SCAP_SUCCESS)
 	{
 		throw sinsp_exception(scap_dump_getlasterr(dumper));
@@ -1801,9 +2323,7 @@ void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
 				return false;
 			}
 
-			std::unordered_map<int64_t, sinsp_fdinfo_t>& fdtable = fd_table_ptr->m_table;
-
-			for(auto it = fdtable.begin(); it != fdtable.end(); ++it)
+			bool fds_added = fd_table_ptr->loop([&](int64_t fd, sinsp_fdinfo_t& fdinfo)
 			{
 				//
 				// Allocate the scap fd info
@@ -1818,17 +2338,23 @@ void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
 				//
 				// Populate the fd info
 				//
-				scfdinfo->fd = it->first;
-				tinfo.fd_to_scap(scfdinfo, &it->second);
+				scfdinfo->fd = fd;
+				tinfo.fd_to_scap(scfdinfo, &fdinfo);
 
 				//
 				// Add the new fd to the scap table.
 				//
-				if(scap_fd_add(m_inspector->m_h, sctinfo, it->first, scfdinfo) != SCAP_SUCCESS)
+				if(scap_fd_add(m_inspector->m_h, sctinfo, fd, scfdinfo) != SCAP_SUCCESS)
 				{
 					scap_proc_free(m_inspector->m_h, sctinfo);
 					throw sinsp_exception("error calling scap_fd_add in sinsp_thread_manager::to_scap (" + std::string(scap_getlasterr(m_inspector->m_h)) + ")");
 				}
+				return true;
+			});
+
+			if(!fds_added)
+			{
+				return false;
 			}
 		}
 
@@ -1850,136 +2376,238 @@ threadinfo_map_t::ptr_t sinsp_thread_manager::get_thread_ref(int64_t tid, bool q
 {
     auto sinsp_proc = find_thread(tid, lookup_only);
 
-    if(!sinsp_proc && query_os_if_not_found &&
-       (m_threadtable.size() < m_max_thread_table_size
+    if(!sinsp_proc && query_os_if_not_found && add_thread_from_os(tid, main_thread))
+    {
+        sinsp_proc = find_thread(tid, lookup_only);
+    }
+
+    return sinsp_proc;
+}
+
+sinsp_threadinfo* sinsp_thread_manager::get_thread(int64_t tid, bool query_os_if_not_found, bool lookup_only, bool main_thread)
+{
+    sinsp_threadinfo* sinsp_proc = find_thread_ptr(tid, lookup_only);
+
+    if(!sinsp_proc && query_os_if_not_found && add_thread_from_os(tid, main_thread))
+    {
+        sinsp_proc = find_thread_ptr(tid, lookup_only);
+    }
+
+    return sinsp_proc;
+}
+
+bool sinsp_thread_manager::add_thread_from_os(int64_t tid, bool main_thread)
+{
+    // With the eviction enabled, add_thread() makes room
+    if(m_threadtable.size() >= m_max_thread_table_size && !m_eviction
 #if defined(HAS_CAPTURE)
-	|| tid == m_inspector->m_self_pid
+       && tid != m_inspector->m_self_pid
 #endif
-	))
+       )
     {
-        // Certain code paths can lead to this point from scap_open() (incomplete example:
-        // scap_proc_scan_proc_dir() -> resolve_container() -> get_env()). Adding a
-        // defensive check here to protect both, callers of get_env and get_thread.
-        if (!m_inspector->m_h)
-        {
-            g_logger.format(sinsp_logger::SEV_INFO, "%s: Unable to complete for tid=%"
-                            PRIu64 ": sinsp::scap_t* is uninitialized", __func__, tid);
-            return NULL;
-        }
+        return false;
+    }
+
+    // Certain code paths can lead to this point from scap_open() (incomplete example:
+    // scap_proc_scan_proc_dir() -> resolve_container() -> get_env()). Adding a
+    // defensive check here to protect both, callers of get_env and get_thread.
+    if (!m_inspector->m_h)
+    {
+        g_logger.format(sinsp_logger::SEV_INFO, "%s: Unable to complete for tid=%"
+                        PRIu64 ": sinsp::scap_t* is uninitialized", __func__, tid);
+        return false;
+    }
 
-        scap_threadinfo* scap_proc = NULL;
+    scap_threadinfo* scap_proc = NULL;
+    uint64_t now = sinsp_utils::get_current_time_ns();
+    bool recently_failed = proc_lookup_recently_failed(tid, now);
 
-		// unfortunately, sinsp owns the threade factory
-        sinsp_threadinfo* newti = m_inspector->build_threadinfo();
+    // unfortunately, sinsp owns the threade factory
+    sinsp_threadinfo* newti = m_inspector->build_threadinfo();
 
+    if(recently_failed)
+    {
+        m_n_proc_lookups_negative_cached++;
+#ifdef GATHER_INTERNAL_STATS
+        m_negative_cached_proc_lookups->increment();
+#endif
+    }
+    else
+    {
         m_n_proc_lookups++;
+    }
 
-        if(main_thread)
-        {
-            m_n_main_thread_lookups++;
-        }
+    if(main_thread)
+    {
+        m_n_main_thread_lookups++;
+    }
+
+    if(m_n_proc_lookups == m_max_n_proc_lookups)
+    {
+        g_logger.format(sinsp_logger::SEV_INFO, "Reached max process lookup number, duration=%" PRIu64 "ms",
+            m_n_proc_lookups_duration_ns / 1000000);
+    }
 
-        if(m_n_proc_lookups == m_max_n_proc_lookups)
+    bool over_budget = false;
+    if(!recently_failed && m_proc_lookup_budget_enabled)
+    {
+        over_budget = !m_proc_lookup_budget.claim(1, now);
+        if(over_budget)
         {
-            g_logger.format(sinsp_logger::SEV_INFO, "Reached max process lookup number, duration=%" PRIu64 "ms",
-                m_n_proc_lookups_duration_ns / 1000000);
+            m_n_proc_lookups_throttled++;
+#ifdef GATHER_INTERNAL_STATS
+            m_throttled_proc_lookups->increment();
+#endif
+            if(!m_proc_lookup_budget_exhausted)
+            {
+                g_logger.format(sinsp_logger::SEV_INFO, "Proc lookup budget exhausted, tid=%" PRIu64 ", throttled so far=%" PRIu64,
+                    tid, m_n_proc_lookups_throttled);
+            }
         }
+        m_proc_lookup_budget_exhausted = over_budget;
+    }
 
-        if(m_max_n_proc_lookups < 0 ||
-           m_n_proc_lookups <= m_max_n_proc_lookups)
-        {
+    if(!recently_failed && !over_budget &&
+       (m_max_n_proc_lookups < 0 ||
+        m_n_proc_lookups <= m_max_n_proc_lookups))
+    {
 #ifdef HAS_ANALYZER
-            tracer_emitter("sinsp_proc_lookup");
+        tracer_emitter("sinsp_proc_lookup");
 #endif
 
-            bool scan_sockets = false;
+        bool scan_sockets = false;
+
+        if(m_max_n_proc_socket_lookups < 0 ||
+           m_n_proc_lookups <= m_max_n_proc_socket_lookups)
+        {
+            scan_sockets = true;
+            if(m_n_proc_lookups == m_max_n_proc_socket_lookups)
+            {
+                g_logger.format(sinsp_logger::SEV_INFO, "Reached max socket lookup number, tid=%" PRIu64 ", duration=%" PRIu64 "ms",
+                    tid, m_n_proc_lookups_duration_ns / 1000000);
+            }
 
-            if(m_max_n_proc_socket_lookups < 0 ||
-               m_n_proc_lookups <= m_max_n_proc_socket_lookups)
+            if(m_proc_socket_lookup_budget_enabled &&
+               !m_proc_socket_lookup_budget.claim(1, now))
             {
-                scan_sockets = true;
-                if(m_n_proc_lookups == m_max_n_proc_socket_lookups)
-                {
-                    g_logger.format(sinsp_logger::SEV_INFO, "Reached max socket lookup number, tid=%" PRIu64 ", duration=%" PRIu64 "ms",
-                        tid, m_n_proc_lookups_duration_ns / 1000000);
-                }
+                scan_sockets = false;
+                m_n_proc_socket_lookups_throttled++;
             }
+        }
 
 #ifdef HAS_ANALYZER
-            uint64_t ts = sinsp_utils::get_current_time_ns();
+        uint64_t ts = sinsp_utils::get_current_time_ns();
 #endif
-            scap_proc = scap_proc_get(m_inspector->m_h, tid, scan_sockets);
+        scap_proc = scap_proc_get(m_inspector->m_h, tid, scan_sockets);
 #ifdef HAS_ANALYZER
-            m_n_proc_lookups_duration_ns += sinsp_utils::get_current_time_ns() - ts;
+        m_n_proc_lookups_duration_ns += sinsp_utils::get_current_time_ns() - ts;
 #endif
-        }
-
-        if(scap_proc)
+        if(!scap_proc)
         {
-            newti->init(scap_proc);
-            scap_proc_free(m_inspector->m_h, scap_proc);
-        }
-        else
-        {
-            //
-            // Add a fake entry to avoid a continuous lookup
-            //
-            newti->m_tid = tid;
-            newti->m_pid = tid;
-            newti->m_ptid = -1;
-            newti->m_comm = "<NA>";
-            newti->m_exe = "<NA>";
-            newti->m_user.uid = 0xffffffff;
-            newti->m_group.gid = 0xffffffff;
-            newti->m_nchilds = 0;
-            newti->m_loginuser.uid = 0xffffffff;
+            add_failed_proc_lookup(tid, now);
         }
+    }
 
+    if(scap_proc)
+    {
+        newti->init(scap_proc);
+        scap_proc_free(m_inspector->m_h, scap_proc);
+    }
+    else
+    {
         //
-        // Since this thread is created out of thin air, we need to
-        // properly set its reference count, by scanning the table
+        // Add a fake entry to avoid a continuous lookup
         //
-        m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
-            if(tinfo.m_pid == tid)
-            {
-                newti->m_nchilds++;
-            }
-            return true;
-        });
+        newti->m_tid = tid;
+        newti->m_pid = tid;
+        newti->m_ptid = -1;
+        newti->m_comm = "<NA>";
+        newti->m_exe = "<NA>";
+        newti->get_user()->uid = 0xffffffff;
+        newti->get_group()->gid = 0xffffffff;
+        newti->m_nchilds = 0;
+        newti->get_loginuser()->uid = 0xffffffff;
+    }
 
-        //
-        // Done. Add the new thread to the list.
-        //
-        add_thread(newti, false);
-        sinsp_proc = find_thread(tid, lookup_only);
+    //
+    // Done. Add the new thread to the list.
+    //
+    if(!add_thread(newti, false))
+    {
+        delete newti;
+        return false;
     }
+    return true;
+}
 
-    return sinsp_proc;
+bool sinsp_thread_manager::proc_lookup_recently_failed(int64_t tid, uint64_t now)
+{
+	auto it = m_failed_proc_lookups.find(tid);
+	if(it == m_failed_proc_lookups.end())
+	{
+		return false;
+	}
+
+	if(now - it->second < m_proc_lookup_negative_cache_ttl_ns)
+	{
+		return true;
+	}
+
+	m_failed_proc_lookups.erase(it);
+	return false;
+}
+
+void sinsp_thread_manager::add_failed_proc_lookup(int64_t tid, uint64_t now)
+{
+	if(m_proc_lookup_negative_cache_ttl_ns == 0)
+	{
+		return;
+	}
+
+	if(m_failed_proc_lookups.size() >= DEFAULT_PROC_LOOKUP_NEGATIVE_CACHE_SIZE)
+	{
+		for(auto it = m_failed_proc_lookups.begin(); it != m_failed_proc_lookups.end();)
+		{
+			if(now - it->second >= m_proc_lookup_negative_cache_ttl_ns)
+			{
+				it = m_failed_proc_lookups.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		// Still full of recent failures, forget them rather than growing
+		if(m_failed_proc_lookups.size() >= DEFAULT_PROC_LOOKUP_NEGATIVE_CACHE_SIZE)
+		{
+			m_failed_proc_lookups.clear();
+		}
+	}
+
+	m_failed_proc_lookups[tid] = now;
 }
 
 threadinfo_map_t::ptr_t sinsp_thread_manager::find_thread(int64_t tid, bool lookup_only)
 {
-	threadinfo_map_t::ptr_t thr;
 	//
 	// Try looking up in our simple cache
 	//
-	if(tid == m_last_tid)
+	if(tid == m_last_tid && m_last_tinfo)
 	{
-		thr = m_last_tinfo.lock();
-		if (thr)                                                                                     {
 #ifdef GATHER_INTERNAL_STATS
-			m_cached_lookups->increment();
+		m_cached_lookups->increment();
 #endif
-			// This allows us to avoid performing an actual timestamp lookup
-			// for something that may not need to be precise
-			thr->m_lastaccess_ts = m_inspector->get_lastevent_ts();
-			return thr;
-		}                                                                                        }
+		// This allows us to avoid performing an actual timestamp lookup
+		// for something that may not need to be precise
+		m_last_tinfo->m_lastaccess_ts = m_inspector->get_lastevent_ts();
+		return m_last_tinfo;
+	}
 
 	//
 	// Caching failed, do a real lookup
 	//
-	thr = m_threadtable.get_ref(tid);
+	threadinfo_map_t::ptr_t thr = m_threadtable.get_ref(tid);
 
 	if(thr)
 	{
@@ -2003,12 +2631,95 @@ threadinfo_map_t::ptr_t sinsp_thread_manager::find_thread(int64_t tid, bool look
 	}
 }
 
+sinsp_threadinfo* sinsp_thread_manager::find_thread_ptr(int64_t tid, bool lookup_only)
+{
+	if(tid == m_last_tid && m_last_tinfo)
+	{
+#ifdef GATHER_INTERNAL_STATS
+		m_cached_lookups->increment();
+#endif
+		m_last_tinfo->m_lastaccess_ts = m_inspector->get_lastevent_ts();
+		return m_last_tinfo.get();
+	}
+
+	sinsp_threadinfo* thr;
+	if(lookup_only)
+	{
+		thr = m_threadtable.get(tid);
+	}
+	else
+	{
+		//
+		// The cache keeps its own reference, the only count update
+		// happens when the event thread changes
+		//
+		threadinfo_map_t::ptr_t ref = m_threadtable.get_ref(tid);
+		thr = ref.get();
+		if(thr)
+		{
+			m_last_tid = tid;
+			m_last_tinfo = std::move(ref);
+		}
+	}
+
+	if(thr)
+	{
+#ifdef GATHER_INTERNAL_STATS
+		m_non_cached_lookups->increment();
+#endif
+		if(!lookup_only)
+		{
+			thr->m_lastaccess_ts = m_inspector->get_lastevent_ts();
+		}
+	}
+#ifdef GATHER_INTERNAL_STATS
+	else
+	{
+		m_failed_lookups->increment();
+	}
+#endif
+	return thr;
+}
+
 void sinsp_thread_manager::set_max_thread_table_size(uint32_t value)
 {
     m_max_thread_table_size = std::min(value, m_thread_table_absolute_max_size);
 }
 
+void sinsp_thread_manager::set_proc_lookup_budget(double rate, double max_burst)
+{
+	m_proc_lookup_budget_enabled = rate > 0;
+	m_proc_lookup_budget_exhausted = false;
+	if(m_proc_lookup_budget_enabled)
+	{
+		m_proc_lookup_budget.init(rate, max_burst);
+	}
+}
+
+void sinsp_thread_manager::set_proc_socket_lookup_budget(double rate, double max_burst)
+{
+	m_proc_socket_lookup_budget_enabled = rate > 0;
+	if(m_proc_socket_lookup_budget_enabled)
+	{
+		m_proc_socket_lookup_budget.init(rate, max_burst);
+	}
+}
+
 std::unique_ptr<libsinsp::state::table_entry> sinsp_thread_manager::new_entry() const
 {
 	return std::unique_ptr<libsinsp::state::table_entry>(m_inspector->build_threadinfo());
 }
+
+libsinsp::state::table_entry* sinsp_thread_manager::get_entry_ptr(const int64_t& key)
+{
+	//
+	// Like find_thread(), but without copying the shared_ptr of the
+	// thread, and without updating the last lookup cache
+	//
+	sinsp_threadinfo* tinfo = m_threadtable.get(key);
+	if(tinfo)
+	{
+		tinfo->m_lastaccess_ts = m_inspector->get_lastevent_ts();
+	}
+	return tinfo;
+}
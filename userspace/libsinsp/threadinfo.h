@@ -32,10 +32,17 @@ struct iovec {
 
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include "fdinfo.h"
+#include "interned_vector.h"
 #include "internal_metrics.h"
 #include "state/table.h"
+#include "table_memory.h"
+#include "token_bucket.h"
 
 class sinsp_delays_info;
 class sinsp_tracerparser;
@@ -91,7 +98,7 @@ public:
 	/*!
 	  \brief Return the working directory of the process containing this thread.
 	*/
-	std::string get_cwd();
+	const std::string& get_cwd();
 
 	/*!
 	  \brief Return the values of all environment variables for the process
@@ -99,6 +106,12 @@ public:
 	*/
 	const std::vector<std::string>& get_env();
 
+	/*!
+	  \brief Same as get_env(), without splitting the environment into
+	  strings if it hasn't been yet.
+	*/
+	const libsinsp::lazy_strvec& get_env_strvec();
+
 	/*!
 	  \brief Return the value of the specified environment variable for the process
 	  containing this thread. Returns empty string if variable is not found.
@@ -167,6 +180,16 @@ public:
 	*/
 	sinsp_threadinfo* get_parent_thread();
 
+	/*!
+	  \brief Get the ancestors of this thread, starting from its parent, as
+	  they are visited by traverse_parent_state(). The vector is cached and
+	  built again only after the thread table has changed, so it must not be
+	  kept across events. Building it is not thread-safe: sinsp::next_batch()
+	  builds the ones of the threads of its events, so that concurrent
+	  readers of a batch only find them cached.
+	*/
+	const std::vector<sinsp_threadinfo*>& get_ancestors();
+
 	/*!
 	  \brief Retrieve information about one of this thread/process FDs.
 
@@ -270,8 +293,42 @@ public:
 	void set_group(uint32_t gid);
 	void set_loginuser(uint32_t loginuid);
 
+	/*!
+	  \brief Return the user, login user (auid) and group infos of the
+	  thread, as set by set_user(), set_loginuser() and set_group().
+	*/
+	inline const scap_userinfo* get_user() const
+	{
+		return &m_creds->m_user;
+	}
+	inline scap_userinfo* get_user()
+	{
+		return &m_creds->m_user;
+	}
+	inline const scap_userinfo* get_loginuser() const
+	{
+		return &m_creds->m_loginuser;
+	}
+	inline scap_userinfo* get_loginuser()
+	{
+		return &m_creds->m_loginuser;
+	}
+	inline const scap_groupinfo* get_group() const
+	{
+		return &m_creds->m_group;
+	}
+	inline scap_groupinfo* get_group()
+	{
+		return &m_creds->m_group;
+	}
+
 	using cgroups_t = std::vector<std::pair<std::string, std::string>>;
-	cgroups_t& cgroups() const;
+	const cgroups_t& cgroups() const;
+
+	// The cgroups parameter the cgroups come from, as NUL-separated
+	// "subsystem=path" strings. It identifies the cgroups without
+	// having to parse them.
+	const std::string& get_cgroups_param() const;
 
 	// In rare cases, a thread may do an exec, which results in
 	// the thread having its tid reset to be the main thread of
@@ -283,27 +340,49 @@ public:
 	// pid.
 	std::unique_ptr<int64_t> m_exec_enter_tid;
 
+	// String interning of the modern BPF probe, see
+	// sinsp_parser::resolve_interned_strings(). Whether the exit event of
+	// the last clone or execve of the thread is still expected, and which
+	// of its strings can't be resolved because such an exit was lost.
+	bool m_interned_exit_pending;
+	uint8_t m_interned_unknown;
+
 	//
-	// Core state
+	// Hot state, read or written while parsing almost every event of the
+	// thread. It's kept together at the start of a cache line, so that a
+	// lookup doesn't pull the whole threadinfo in.
 	//
-	int64_t m_tid;  ///< The id of this thread
+	alignas(SINSP_CACHE_LINE_SIZE) int64_t m_tid;  ///< The id of this thread
 	int64_t m_pid; ///< The id of the process containing this thread. In single thread threads, this is equal to tid.
 	int64_t m_ptid; ///< The id of the process that started this thread.
+	int64_t m_lastevent_fd; ///< The FD os the last event used by this thread.
+	uint64_t m_lastevent_ts; ///< timestamp of the last event for this thread.
+	uint64_t m_prevevent_ts; ///< timestamp of the event before the last for this thread.
+	uint64_t m_lastaccess_ts; ///< The last time this thread was looked up. Used when cleaning up the table.
+	uint32_t m_flags; ///< The thread flags. See the PPM_CL_* declarations in ppm_events_public.h.
+VISIBILITY_PRIVATE
+	uint16_t m_lastevent_type;
+	uint16_t m_lastevent_cpuid;
+	uint8_t* m_lastevent_data; // Used by some event parsers to store the last enter event
+	sinsp_evt::category m_lastevent_category;
+	mutable std::weak_ptr<sinsp_threadinfo> m_main_thread;
+public:
+
+	//
+	// Core state
+	//
 	int64_t m_sid; ///< The session id of the process containing this thread.
 	std::string m_comm; ///< Command name (e.g. "top")
 	std::string m_exe; ///< argv[0] (e.g. "sshd: user@pts/4")
 	std::string m_exepath; ///< full executable path
 	bool m_exe_writable;
 	bool m_exe_upper_layer; ///< True if the executable file belongs to upper layer in overlayfs
-	std::vector<std::string> m_args; ///< Command line arguments (e.g. "-d1")
-	std::vector<std::string> m_env; ///< Environment variables
-	std::unique_ptr<cgroups_t> m_cgroups; ///< subsystem-cgroup pairs
+	libsinsp::lazy_strvec m_args; ///< Command line arguments (e.g. "-d1")
+	libsinsp::lazy_strvec m_env; ///< Environment variables
+	mutable libsinsp::interned_vector<std::pair<std::string, std::string>> m_cgroups; ///< subsystem-cgroup pairs, see cgroups()
 	std::string m_container_id; ///< heuristic-based container id
-	uint32_t m_flags; ///< The thread flags. See the PPM_CL_* declarations in ppm_events_public.h.
+	uint64_t m_container_handle; ///< cached handle of the container, see sinsp_container_manager::get_container()
 	int64_t m_fdlimit;  ///< The maximum number of FDs this thread can open
-	scap_userinfo m_user; ///< user infos
-	scap_userinfo m_loginuser; ///< loginuser infos (auid)
-	scap_groupinfo m_group; ///< group infos
 	uint64_t m_cap_permitted; ///< permitted capabilities
 	uint64_t m_cap_effective; ///< effective capabilities
 	uint64_t m_cap_inheritable; ///< inheritable capabilities
@@ -347,15 +426,33 @@ public:
 	command_category m_category;
 
 	//
-	// State for multi-event processing
+	// State for multi-event processing, see also the hot state above
 	//
-	int64_t m_lastevent_fd; ///< The FD os the last event used by this thread.
-	uint64_t m_lastevent_ts; ///< timestamp of the last event for this thread.
-	uint64_t m_prevevent_ts; ///< timestamp of the event before the last for this thread.
-	uint64_t m_lastaccess_ts; ///< The last time this thread was looked up. Used when cleaning up the table.
 	uint64_t m_clone_ts; ///< When the clone that started this process happened.
 	uint64_t m_lastexec_ts; ///< The last time exec was called
 
+	//
+	// Events and I/O volume of the thread, maintained by the parser when
+	// the workload counters are enabled (see sinsp::set_workload_counters()).
+	// When a thread goes away its counts are moved to its main thread, or
+	// to its container once the whole process is gone.
+	//
+	struct workload_counters
+	{
+		uint64_t m_num_events = 0;
+		uint64_t m_bytes_read = 0;
+		uint64_t m_bytes_written = 0;
+
+		inline void add(const workload_counters& other)
+		{
+			m_num_events += other.m_num_events;
+			m_bytes_read += other.m_bytes_read;
+			m_bytes_written += other.m_bytes_written;
+		}
+	};
+
+	workload_counters m_workload;
+
 	//
 	// Parser for the user events. Public so that filter fields can access it
 	//
@@ -459,6 +556,9 @@ VISIBILITY_PRIVATE
 	void compute_program_hash();
 	std::shared_ptr<sinsp_threadinfo> lookup_thread() const;
 
+	void recycle();
+	libsinsp::interned_vector<std::string> intern_strvec(std::vector<std::string>&& strs) const;
+	libsinsp::interned_pool<std::string>* get_strvec_pool() const;
 	size_t strvec_len(const std::vector<std::string> &strs) const;
 	void strvec_to_iovec(const std::vector<std::string> &strs,
 			     struct iovec **iov, int *iovcnt,
@@ -471,6 +571,7 @@ VISIBILITY_PRIVATE
 			  std::string &rem) const;
 
 	void fd_to_scap(scap_fdinfo *dst, sinsp_fdinfo_t* src);
+	void parse_cgroups() const;
 
 	//  void push_fdop(sinsp_fdop* op);
 	// the queue of recent fd operations
@@ -482,14 +583,30 @@ VISIBILITY_PRIVATE
 	//
 	sinsp_fdtable m_fdtable; // The fd table of this thread
 	std::string m_cwd; // current working directory
-	mutable std::weak_ptr<sinsp_threadinfo> m_main_thread;
-	uint8_t* m_lastevent_data; // Used by some event parsers to store the last enter event
 
-	uint16_t m_lastevent_type;
-	uint16_t m_lastevent_cpuid;
-	sinsp_evt::category m_lastevent_category;
+	// The last cgroups parameter, interned as a single string, and
+	// whether m_cgroups still has to be parsed from it
+	libsinsp::interned_vector<std::string> m_cgroups_param;
+	mutable bool m_cgroups_pending = false;
+
 	bool m_parent_loop_detected;
+	// Cached ancestors, valid while m_ancestors_version matches the one of
+	// the thread manager
+	std::vector<sinsp_threadinfo*> m_ancestors;
+	uint64_t m_ancestors_version;
 	blprogram* m_blprogram;
+	// What the thread table accounted for this entry when it was added
+	uint32_t m_accounted_bytes;
+
+	// The user and group infos, see get_user(). They are few KBs, and
+	// rarely read, so they don't sit in the threadinfo
+	struct credentials
+	{
+		scap_userinfo m_user;
+		scap_userinfo m_loginuser;
+		scap_groupinfo m_group;
+	};
+	std::unique_ptr<credentials> m_creds;
 
 	friend class sinsp;
 	friend class sinsp_parser;
@@ -501,10 +618,50 @@ VISIBILITY_PRIVATE
 	friend class sinsp_tracerparser;
 	friend class lua_cbacks;
 	friend class sinsp_baseliner;
+	friend class sinsp_threadinfo_pool;
+	friend class sinsp_lazy_fd_loader;
 };
 
 /*@}*/
 
+//
+// Keeps the threadinfos of the threads that have been removed, so that new
+// threads can reuse them together with the memory already allocated for
+// their strings, vectors and fd table. Short-lived processes otherwise
+// cause a constant churn of allocations.
+//
+class sinsp_threadinfo_pool: public std::enable_shared_from_this<sinsp_threadinfo_pool>
+{
+public:
+	sinsp_threadinfo_pool(uint32_t max_size): m_max_size(max_size) { }
+	~sinsp_threadinfo_pool();
+
+	// Returns a recycled threadinfo with the given dynamic fields,
+	// or NULL if there is none
+	sinsp_threadinfo* get(const std::shared_ptr<libsinsp::state::dynamic_struct::field_infos>& dyn_fields);
+
+	// Wraps the threadinfo in a shared pointer that gives it back to the
+	// pool when its last reference is released
+	std::shared_ptr<sinsp_threadinfo> wrap(sinsp_threadinfo* tinfo);
+
+	void set_max_size(uint32_t max_size);
+
+	uint32_t size();
+
+	uint64_t get_n_reused() const
+	{
+		return m_n_reused;
+	}
+
+private:
+	void put(sinsp_threadinfo* tinfo);
+
+	std::mutex m_mtx;
+	std::vector<sinsp_threadinfo*> m_free;
+	uint32_t m_max_size;
+	uint64_t m_n_reused = 0;
+};
+
 class threadinfo_map_t
 {
 public:
@@ -512,13 +669,74 @@ public:
 	typedef std::function<bool(sinsp_threadinfo&)> visitor_t;
 	typedef std::shared_ptr<sinsp_threadinfo> ptr_t;
 
+	/*!
+	  \brief Store the threads whose tid is below MAX_DENSE_TID in pages
+	  of slots indexed directly by tid, instead of the hash table. Linux
+	  tids are bounded by pid_max and mostly dense, so their lookups cost
+	  an index computation instead of hashing and walking a bucket. The
+	  other tids still go in the hash table.
+
+	  \return false if the table isn't empty, the backend can only be
+	  chosen before adding threads.
+	*/
+	inline bool set_dense(bool enable)
+	{
+		if(size() != 0)
+		{
+			return false;
+		}
+
+		m_dense = enable;
+		m_pages.clear();
+		return true;
+	}
+
+	inline bool is_dense() const
+	{
+		return m_dense;
+	}
+
 	inline void put(sinsp_threadinfo* tinfo)
 	{
-		m_threads[tinfo->m_tid] = ptr_t(tinfo);
+		put(ptr_t(tinfo));
+	}
+
+	inline void put(ptr_t tinfo)
+	{
+		int64_t tid = tinfo->m_tid;
+		if(in_pages(tid))
+		{
+			uint64_t pg = ((uint64_t) tid) >> TIDS_PER_PAGE_BITS;
+			if(pg >= m_pages.size())
+			{
+				m_pages.resize(pg + 1);
+			}
+			if(!m_pages[pg])
+			{
+				m_pages[pg].reset(new page());
+			}
+
+			ptr_t& slot = m_pages[pg]->m_slots[tid & (TIDS_PER_PAGE - 1)];
+			if(!slot)
+			{
+				m_pages[pg]->m_used++;
+				m_dense_size++;
+			}
+			slot = std::move(tinfo);
+			return;
+		}
+
+		m_threads[tid] = std::move(tinfo);
 	}
 
 	inline sinsp_threadinfo* get(uint64_t tid)
 	{
+		if(in_pages(tid))
+		{
+			const ptr_t* slot = find_slot(tid);
+			return slot ? slot->get() : nullptr;
+		}
+
 		auto it = m_threads.find(tid);
 		if (it == m_threads.end())
 		{
@@ -529,6 +747,12 @@ public:
 
 	inline ptr_t get_ref(uint64_t tid)
 	{
+		if(in_pages(tid))
+		{
+			const ptr_t* slot = find_slot(tid);
+			return slot ? *slot : nullptr;
+		}
+
 		auto it = m_threads.find(tid);
 		if (it == m_threads.end())
 		{
@@ -539,16 +763,122 @@ public:
 
 	inline void erase(uint64_t tid)
 	{
+		if(in_pages(tid))
+		{
+			uint64_t pg = tid >> TIDS_PER_PAGE_BITS;
+			if(pg >= m_pages.size() || !m_pages[pg])
+			{
+				return;
+			}
+
+			//
+			// Drop the thread only once the table no longer
+			// references it, its destructor may look at the table
+			//
+			ptr_t tinfo = std::move(m_pages[pg]->m_slots[tid & (TIDS_PER_PAGE - 1)]);
+			if(tinfo)
+			{
+				m_dense_size--;
+				if(--m_pages[pg]->m_used == 0)
+				{
+					m_pages[pg].reset();
+				}
+			}
+			return;
+		}
+
 		m_threads.erase(tid);
 	}
 
 	inline void clear()
 	{
+		m_pages.clear();
+		m_dense_size = 0;
 		m_threads.clear();
 	}
 
-	bool const_loop(const_visitor_t callback) const
+	/*!
+	  \brief Iterator over the threads of the table, dereferencing to the
+	  threadinfo itself rather than to the key/pointer pair. The threads
+	  stored in pages come first, in tid order.
+	*/
+	template<typename MapIt, typename T>
+	class base_iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = T*;
+		using reference = T&;
+
+		base_iterator() = default;
+		base_iterator(const threadinfo_map_t* table, size_t slot, MapIt it):
+			m_table(table), m_slot(table->next_used_slot(slot)), m_it(it) { }
+
+		reference operator*() const { return *operator->(); }
+		pointer operator->() const
+		{
+			if(m_slot < m_table->num_dense_slots())
+			{
+				return m_table->m_pages[m_slot >> TIDS_PER_PAGE_BITS]->m_slots[m_slot & (TIDS_PER_PAGE - 1)].get();
+			}
+			return m_it->second.get();
+		}
+		base_iterator& operator++()
+		{
+			if(m_slot < m_table->num_dense_slots())
+			{
+				m_slot = m_table->next_used_slot(m_slot + 1);
+			}
+			else
+			{
+				++m_it;
+			}
+			return *this;
+		}
+		base_iterator operator++(int) { base_iterator tmp = *this; ++(*this); return tmp; }
+		bool operator==(const base_iterator& o) const { return m_slot == o.m_slot && m_it == o.m_it; }
+		bool operator!=(const base_iterator& o) const { return !(*this == o); }
+
+	private:
+		const threadinfo_map_t* m_table = nullptr;
+		size_t m_slot = 0;
+		MapIt m_it;
+	};
+
+	using iterator = base_iterator<std::unordered_map<int64_t, ptr_t>::iterator, sinsp_threadinfo>;
+	using const_iterator = base_iterator<std::unordered_map<int64_t, ptr_t>::const_iterator, const sinsp_threadinfo>;
+
+	inline iterator begin() { return iterator(this, 0, m_threads.begin()); }
+	inline iterator end() { return iterator(this, num_dense_slots(), m_threads.end()); }
+	inline const_iterator begin() const { return const_iterator(this, 0, m_threads.begin()); }
+	inline const_iterator end() const { return const_iterator(this, num_dense_slots(), m_threads.end()); }
+
+	/*!
+	  \brief Invokes callback for each thread of the table, until it
+	  returns false. The callback is inlined, any callable taking a
+	  const sinsp_threadinfo& and returning bool can be passed.
+
+	  \return true if all the threads were visited.
+	*/
+	template<typename F>
+	bool const_loop(F&& callback) const
 	{
+		for (const auto& pg : m_pages)
+		{
+			if (!pg)
+			{
+				continue;
+			}
+			for (const auto& tinfo : pg->m_slots)
+			{
+				if (tinfo && !callback(*tinfo.get()))
+				{
+					return false;
+				}
+			}
+		}
 		for (const auto& it : m_threads)
 		{
 			if (!callback(*it.second.get()))
@@ -559,8 +889,26 @@ public:
 		return true;
 	}
 
-	bool loop(visitor_t callback)
+	/*!
+	  \brief Same as const_loop(), for callbacks taking a sinsp_threadinfo&.
+	*/
+	template<typename F>
+	bool loop(F&& callback)
 	{
+		for (auto& pg : m_pages)
+		{
+			if (!pg)
+			{
+				continue;
+			}
+			for (auto& tinfo : pg->m_slots)
+			{
+				if (tinfo && !callback(*tinfo.get()))
+				{
+					return false;
+				}
+			}
+		}
 		for (auto& it : m_threads)
 		{
 			if (!callback(*it.second.get()))
@@ -571,12 +919,196 @@ public:
 		return true;
 	}
 
+	/*!
+	  \brief Visits all the threads of the table with up to n_workers
+	  threads, each scanning a contiguous range of slots (the page slots,
+	  then the hash buckets). The calling thread scans the first range.
+	  This is meant for read-only scans of large tables: callback(worker,
+	  tinfo) is invoked concurrently from different workers, with worker
+	  being the index of the range in [0, n_workers), so that workers can
+	  accumulate results in per-worker slots without synchronization.
+
+	  \note the table must not be modified until this returns, and the
+	  callback must not throw nor modify state shared between threads.
+	*/
+	template<typename F>
+	void const_loop_parallel(size_t n_workers, F&& callback) const
+	{
+		size_t n_slots = num_slots();
+		if (n_workers > n_slots)
+		{
+			n_workers = n_slots;
+		}
+
+		auto visit_range = [this, &callback](size_t worker, size_t from, size_t to)
+		{
+			size_t slot = from;
+			while (slot < to)
+			{
+				visit_slot(slot, [&callback, worker](sinsp_threadinfo& tinfo) {
+					callback(worker, (const sinsp_threadinfo&) tinfo);
+				});
+			}
+		};
+
+		if (n_workers <= 1)
+		{
+			visit_range(0, 0, n_slots);
+			return;
+		}
+
+		size_t chunk = (n_slots + n_workers - 1) / n_workers;
+		std::vector<std::thread> workers;
+		workers.reserve(n_workers - 1);
+		for (size_t w = 1; w < n_workers; w++)
+		{
+			size_t from = std::min(w * chunk, n_slots);
+			size_t to = std::min(from + chunk, n_slots);
+			workers.emplace_back(visit_range, w, from, to);
+		}
+		visit_range(0, 0, std::min(chunk, n_slots));
+		for (auto& t : workers)
+		{
+			t.join();
+		}
+	}
+
+	/*!
+	  \brief Visits the threads of the table one slice at a time, so that a
+	  full visit can be spread over several calls. The visit starts from
+	  the slot (a page slot, an empty page or a hash bucket) pointed by
+	  cursor, and stops at the end of the slot in which at least
+	  max_visits threads have been visited, or once 4 * max_visits slots
+	  have been scanned. The cursor is updated to resume the visit from
+	  there.
+
+	  \return true if the visit reached the end of the table.
+
+	  \note the callback must not add or remove threads. Threads added or
+	  removed between two calls can be visited twice or be skipped if
+	  the table gets rehashed in the meanwhile.
+	*/
+	bool loop_slice(size_t& cursor, size_t max_visits, const std::function<void(sinsp_threadinfo&)>& callback)
+	{
+		size_t visits = 0;
+		size_t scanned = 0;
+		while(cursor < num_slots() && scanned < 4 * max_visits && visits < max_visits)
+		{
+			visits += visit_slot(cursor, callback);
+			scanned++;
+		}
+		return cursor >= num_slots();
+	}
+
 	inline size_t size() const
 	{
-		return m_threads.size();
+		return m_dense_size + m_threads.size();
 	}
 
 protected:
+	//
+	// 512 slots of 16 bytes per page, and the Linux limit of pid_max
+	//
+	static const uint32_t TIDS_PER_PAGE_BITS = 9;
+	static const uint32_t TIDS_PER_PAGE = 1 << TIDS_PER_PAGE_BITS;
+	static const int64_t MAX_DENSE_TID = 1 << 22;
+
+	struct page
+	{
+		uint32_t m_used = 0;
+		ptr_t m_slots[TIDS_PER_PAGE];
+	};
+
+	inline bool in_pages(int64_t tid) const
+	{
+		return m_dense && tid >= 0 && tid < MAX_DENSE_TID;
+	}
+
+	inline const ptr_t* find_slot(uint64_t tid) const
+	{
+		uint64_t pg = tid >> TIDS_PER_PAGE_BITS;
+		if(pg >= m_pages.size() || !m_pages[pg])
+		{
+			return nullptr;
+		}
+
+		const ptr_t& slot = m_pages[pg]->m_slots[tid & (TIDS_PER_PAGE - 1)];
+		return slot ? &slot : nullptr;
+	}
+
+	inline size_t num_dense_slots() const
+	{
+		return m_pages.size() << TIDS_PER_PAGE_BITS;
+	}
+
+	// The page slots come first, then the hash buckets
+	inline size_t num_slots() const
+	{
+		return num_dense_slots() + m_threads.bucket_count();
+	}
+
+	// The first page slot holding a thread from slot on, num_dense_slots()
+	// if there is none
+	inline size_t next_used_slot(size_t slot) const
+	{
+		size_t n = num_dense_slots();
+		while(slot < n)
+		{
+			const page* pg = m_pages[slot >> TIDS_PER_PAGE_BITS].get();
+			if(!pg)
+			{
+				slot = ((slot >> TIDS_PER_PAGE_BITS) + 1) << TIDS_PER_PAGE_BITS;
+				continue;
+			}
+			if(pg->m_slots[slot & (TIDS_PER_PAGE - 1)])
+			{
+				return slot;
+			}
+			slot++;
+		}
+		return n;
+	}
+
+	// Visits the threads of a slot and moves to the next one, skipping
+	// the rest of an empty page at once
+	template<typename F>
+	inline size_t visit_slot(size_t& slot, F&& callback) const
+	{
+		size_t n_dense = num_dense_slots();
+		if(slot < n_dense)
+		{
+			const page* pg = m_pages[slot >> TIDS_PER_PAGE_BITS].get();
+			if(!pg)
+			{
+				slot = ((slot >> TIDS_PER_PAGE_BITS) + 1) << TIDS_PER_PAGE_BITS;
+				return 0;
+			}
+
+			const ptr_t& tinfo = pg->m_slots[slot & (TIDS_PER_PAGE - 1)];
+			slot++;
+			if(tinfo)
+			{
+				callback(*tinfo.get());
+				return 1;
+			}
+			return 0;
+		}
+
+		size_t n = 0;
+		size_t bucket = slot - n_dense;
+		for(auto it = m_threads.begin(bucket); it != m_threads.end(bucket); ++it)
+		{
+			callback(*it->second.get());
+			n++;
+		}
+		slot++;
+		return n;
+	}
+
+	bool m_dense = false;
+	std::vector<std::unique_ptr<page>> m_pages;
+	size_t m_dense_size = 0;
+	// All the threads when not dense, the ones out of the pages otherwise
 	std::unordered_map<int64_t, ptr_t> m_threads;
 };
 
@@ -592,13 +1124,20 @@ public:
 	std::unique_ptr<sinsp_threadinfo> new_threadinfo() const;
 	bool add_thread(sinsp_threadinfo *threadinfo, bool from_scap_proctable);
 	void remove_thread(int64_t tid, bool force);
-	// Returns true if the table is actually scanned
+	// Returns true if the table is actually scanned. Once the purge
+	// interval has elapsed, every call scans the next slice of the table
+	// until all of it has been covered.
 	// NOTE: this is implemented in sinsp.cpp so we can inline it from there
 	inline bool remove_inactive_threads();
 	void fix_sockets_coming_from_proc();
 	void reset_child_dependencies();
 	void create_child_dependencies();
 	void recreate_child_dependencies();
+	// Drops all the threads counted for the process of main_thread, e.g.
+	// because they were destroyed by an execve.
+	void reset_mainthread_childcount(sinsp_threadinfo* main_thread);
+	// Number of threads (other than the main one) counted for a process
+	uint64_t get_process_thread_count(int64_t pid) const;
 
 	/*!
       \brief Look up a thread given its tid and return its information,
@@ -630,6 +1169,21 @@ public:
     //
     threadinfo_map_t::ptr_t find_thread(int64_t tid, bool lookup_only);
 
+	/*!
+	  \brief Same as get_thread_ref(), but returns a borrowed pointer, which
+	  saves the reference count updates of the shared_ptr. The pointer stays
+	  valid until the thread is removed from the table, i.e. at least until
+	  the next event is processed. Use get_thread_ref() to keep the thread
+	  for longer.
+	*/
+	sinsp_threadinfo* get_thread(int64_t tid, bool query_os_if_not_found = false, bool lookup_only = true, bool main_thread = false);
+
+	/*!
+	  \brief Same as find_thread(), but returns a borrowed pointer, see
+	  get_thread().
+	*/
+	sinsp_threadinfo* find_thread_ptr(int64_t tid, bool lookup_only);
+
 
 	void dump_threads_to_file(scap_dumper_t* dumper);
 
@@ -645,10 +1199,132 @@ public:
 		return &m_threadtable;
 	}
 
+	//
+	// Pools of the argument, environment and cgroup vectors of the threads.
+	// Those are mostly the same for all the threads of a process and for
+	// the processes of a container, so they are stored only once. The raw
+	// cgroups parameters go to the string pool too.
+	//
+	libsinsp::interned_pool<std::string>& get_strvec_pool()
+	{
+		return m_strvec_pool;
+	}
+
+	libsinsp::interned_pool<std::pair<std::string, std::string>>& get_cgroups_pool()
+	{
+		return m_cgroups_pool;
+	}
+
+	//
+	// Workload counters of the processes and of the containers (the host
+	// being the "" container), summing the counters of the live threads
+	// and those left by the threads already removed
+	//
+	std::unordered_map<int64_t, sinsp_threadinfo::workload_counters> get_process_workloads();
+	std::unordered_map<std::string, sinsp_threadinfo::workload_counters> get_container_workloads();
+
+	//
+	// Same as above, as a buffer of scap_stats_v2 metrics named
+	// `workload.process.<pid>.<counter>` and `workload.container.<id>.<counter>`,
+	// with <id> "host" for the host. The buffer is owned by the thread
+	// manager and valid until the next call.
+	//
+	const scap_stats_v2* get_workload_stats(uint32_t* nstats);
+
+	//
+	// Approximate memory used by the thread table, the fds excluded
+	//
+	inline sinsp_table_memory& get_memory()
+	{
+		return m_memory;
+	}
+
+	//
+	// Evict cold threads and fds rather than refusing new ones, see
+	// sinsp::set_state_eviction
+	//
+	inline void set_eviction(bool enable)
+	{
+		m_eviction = enable;
+	}
+
+	//
+	// Called by the fd tables over their memory budget. With the eviction
+	// enabled the new fd is admitted, and cold fds are evicted before the
+	// next event: until then, the parsers may be holding pointers to any
+	// fd. Returns false if the fd must be refused, i.e. the eviction is
+	// disabled or the last one couldn't make enough room.
+	//
+	inline bool request_fd_eviction()
+	{
+		if(!m_eviction)
+		{
+			return false;
+		}
+		m_fd_eviction_pending = true;
+		return !m_fd_eviction_stalled;
+	}
+
+	inline void evict_requested_fds()
+	{
+		if(m_fd_eviction_pending)
+		{
+			evict_cold_fds();
+		}
+	}
+
 	std::set<uint16_t> m_server_ports;
 
 	void set_max_thread_table_size(uint32_t value);
 
+	//
+	// Number of threads checked by each call of remove_inactive_threads()
+	// while purging the table, 0 checks the whole table at once
+	//
+	void set_purge_slice_size(uint32_t value)
+	{
+		m_purge_slice_size = value;
+	}
+
+	//
+	// Makes the next call of remove_inactive_threads() start a purge
+	// without waiting for the interval, e.g. to drop the restored threads
+	// that are gone
+	//
+	void schedule_purge()
+	{
+		m_purge_scheduled = true;
+	}
+
+	//
+	// Maximum number of threadinfos of removed threads kept around for reuse,
+	// 0 disables the recycling
+	//
+	void set_max_recycled_threads(uint32_t value)
+	{
+		m_threadinfo_pool->set_max_size(value);
+	}
+
+	sinsp_threadinfo_pool* get_threadinfo_pool() const
+	{
+		return m_threadinfo_pool.get();
+	}
+
+	//
+	// Version of the parent relationships of the thread table, increased
+	// every time a thread is added or removed or its parent changes. The
+	// ancestors cached by the threads are valid only for one version
+	//
+	uint64_t get_ancestors_version() const
+	{
+		return m_ancestors_version;
+	}
+
+	void invalidate_ancestors()
+	{
+		m_ancestors_version++;
+	}
+
 	int32_t get_m_n_proc_lookups() const { return m_n_proc_lookups; }
 	int32_t get_m_n_main_thread_lookups() const { return m_n_main_thread_lookups; }
 	uint64_t get_m_n_proc_lookups_duration_ns() const { return m_n_proc_lookups_duration_ns; }
@@ -657,6 +1333,32 @@ public:
 	void set_m_max_n_proc_lookups(int32_t val) { m_max_n_proc_lookups = val; }
 	void set_m_max_n_proc_socket_lookups(int32_t val) { m_max_n_proc_socket_lookups = val; }
 
+	//
+	// Limit the /proc lookups of unknown threads to rate lookups per second,
+	// with bursts of up to max_burst lookups. A rate of 0 removes the limit
+	//
+	void set_proc_lookup_budget(double rate, double max_burst);
+
+	//
+	// Same as set_proc_lookup_budget, for the lookups that also scan the
+	// sockets of the process. Lookups over budget skip the sockets
+	//
+	void set_proc_socket_lookup_budget(double rate, double max_burst);
+
+	//
+	// Tids whose /proc lookup failed aren't looked up again for ttl_ms,
+	// 0 disables the negative cache
+	//
+	void set_proc_lookup_negative_cache_ttl(uint64_t ttl_ms)
+	{
+		m_proc_lookup_negative_cache_ttl_ns = ttl_ms * 1000000;
+		m_failed_proc_lookups.clear();
+	}
+
+	uint64_t get_m_n_proc_lookups_throttled() const { return m_n_proc_lookups_throttled; }
+	uint64_t get_m_n_proc_socket_lookups_throttled() const { return m_n_proc_socket_lookups_throttled; }
+	uint64_t get_m_n_proc_lookups_negative_cached() const { return m_n_proc_lookups_negative_cached; }
+
 	// ---- libsinsp::state::table implementation ----
 
 	size_t entries_count() const override
@@ -667,13 +1369,16 @@ public:
 	void clear_entries() override
 	{
 		m_threadtable.clear();
+		m_process_threads.clear();
+		m_memory.clear();
+		invalidate_ancestors();
 	}
 
 	std::unique_ptr<libsinsp::state::table_entry> new_entry() const override;
 
 	bool foreach_entry(std::function<bool(libsinsp::state::table_entry& e)> pred) override
 	{
-		return m_threadtable.loop([&pred](sinsp_threadinfo& e){ return pred(e); });
+		return m_threadtable.loop(pred);
 	}
 
 	std::shared_ptr<libsinsp::state::table_entry> get_entry(const int64_t& key) override
@@ -681,6 +1386,8 @@ public:
 		return find_thread(key, false);
 	}
 
+	libsinsp::state::table_entry* get_entry_ptr(const int64_t& key) override;
+
 	std::shared_ptr<libsinsp::state::table_entry> add_entry(const int64_t& key, std::unique_ptr<libsinsp::state::table_entry> entry) override
 	{
 		if (!entry)
@@ -717,16 +1424,45 @@ public:
 
 private:
 	void increment_mainthread_childcount(sinsp_threadinfo* threadinfo);
+	void decrement_mainthread_childcount(sinsp_threadinfo* threadinfo);
 	inline void clear_thread_pointers(sinsp_threadinfo& threadinfo);
 	void free_dump_fdinfos(std::vector<scap_fdinfo*>* fdinfos_to_free);
 	void thread_to_scap(sinsp_threadinfo& tinfo, scap_threadinfo* sctinfo);
+	// Adds the thread read from /proc, or a placeholder if the lookup
+	// fails. Returns false if the thread can't be added to the table.
+	bool add_thread_from_os(int64_t tid, bool main_thread);
+	bool proc_lookup_recently_failed(int64_t tid, uint64_t now);
+	void add_failed_proc_lookup(int64_t tid, uint64_t now);
+	static uint32_t estimate_memory(const sinsp_threadinfo& tinfo);
+	bool evict_cold_threads(const sinsp_threadinfo* keep);
+	void evict_cold_fds();
+	sinsp_threadinfo* find_cold(const std::function<bool(sinsp_threadinfo&)>& evictable);
 
 	sinsp* m_inspector;
 	threadinfo_map_t m_threadtable;
+	// pid -> tids of the threads counted in the m_nchilds of its main thread.
+	// Maintained on thread add/remove, so that the refcounts never need
+	// a full table rebuild.
+	std::unordered_map<int64_t, std::unordered_set<int64_t>> m_process_threads;
+	// Starts from 1, so that threads with a zero version have no cached ancestors
+	uint64_t m_ancestors_version = 1;
 	int64_t m_last_tid;
-	std::weak_ptr<sinsp_threadinfo> m_last_tinfo;
+	// Strong, so that the cache hits need no reference count update. Every
+	// removal from the table resets it.
+	threadinfo_map_t::ptr_t m_last_tinfo;
 	uint64_t m_last_flush_time_ns;
+	bool m_purge_in_progress;
+	bool m_purge_scheduled;
+	size_t m_purge_cursor;
+	uint32_t m_purge_slice_size = DEFAULT_THREAD_PURGE_SLICE_SIZE;
+	std::vector<std::pair<int64_t, bool>> m_purge_to_delete;
 	uint32_t m_n_drops;
+	sinsp_table_memory m_memory;
+	bool m_eviction = false;
+	bool m_fd_eviction_pending = false;
+	bool m_fd_eviction_stalled = false;
+	// The hand of the clock going around the table to find cold entries
+	size_t m_eviction_cursor = 0;
 	const uint32_t m_thread_table_absolute_max_size = 131072;
 	uint32_t m_max_thread_table_size;
 	int32_t m_n_proc_lookups = 0;
@@ -734,12 +1470,31 @@ private:
 	int32_t m_n_main_thread_lookups = 0;
 	int32_t m_max_n_proc_lookups = -1;
 	int32_t m_max_n_proc_socket_lookups = -1;
+	token_bucket m_proc_lookup_budget;
+	bool m_proc_lookup_budget_enabled = false;
+	bool m_proc_lookup_budget_exhausted = false;
+	token_bucket m_proc_socket_lookup_budget;
+	bool m_proc_socket_lookup_budget_enabled = false;
+	uint64_t m_n_proc_lookups_throttled = 0;
+	uint64_t m_n_proc_socket_lookups_throttled = 0;
+	uint64_t m_proc_lookup_negative_cache_ttl_ns = DEFAULT_PROC_LOOKUP_NEGATIVE_CACHE_TTL_MS * 1000000;
+	// Tids whose /proc lookup failed, and when
+	std::unordered_map<int64_t, uint64_t> m_failed_proc_lookups;
+	uint64_t m_n_proc_lookups_negative_cached = 0;
+	std::shared_ptr<sinsp_threadinfo_pool> m_threadinfo_pool;
+	libsinsp::interned_pool<std::string> m_strvec_pool;
+	libsinsp::interned_pool<std::pair<std::string, std::string>> m_cgroups_pool;
+	// counters of the removed processes, by container
+	std::unordered_map<std::string, sinsp_threadinfo::workload_counters> m_removed_workloads;
+	std::vector<scap_stats_v2> m_workload_stats;
 
 	INTERNAL_COUNTER(m_failed_lookups);
 	INTERNAL_COUNTER(m_cached_lookups);
 	INTERNAL_COUNTER(m_non_cached_lookups);
 	INTERNAL_COUNTER(m_added_threads);
 	INTERNAL_COUNTER(m_removed_threads);
+	INTERNAL_COUNTER(m_throttled_proc_lookups);
+	INTERNAL_COUNTER(m_negative_cached_proc_lookups);
 
 	friend class sinsp_parser;
 	friend class sinsp_analyzer;
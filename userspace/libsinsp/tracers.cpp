@@ -49,6 +49,15 @@ void sinsp_tracerparser::set_storage_size(uint32_t newsize)
 	m_storage_size = newsize;
 }
 
+void sinsp_tracerparser::reset()
+{
+	m_res = sinsp_tracerparser::RES_OK;
+	m_fragment_size = 0;
+	m_fullfragment_storage_str.clear();
+	m_enter_pae = NULL;
+	m_tinfo = NULL;
+}
+
 sinsp_tracerparser::parse_result sinsp_tracerparser::process_event_data(char *data, uint32_t datalen, uint64_t ts)
 {
 	ASSERT(data != NULL);
@@ -1220,25 +1229,18 @@ inline void sinsp_tracerparser::init_partial_tracer(sinsp_partial_tracer* pae)
 	ASSERT(m_argvals.size() == m_argvallens.size());
 
 	//
-	// Pack the tags
+	// Pack the tags, argnames and argvals
 	//
-	pae->m_tags.clear();
-	pae->m_taglens.clear();
 	pae->m_ntags = (uint32_t)m_tags.size();
+	pae->m_nargs = (uint32_t)m_argnames.size();
 	uint32_t encoded_tags_len = m_tot_taglens + pae->m_ntags + 1;
+	uint32_t encoded_argnames_len = m_tot_argnamelens + pae->m_nargs + 1;
+	uint32_t encoded_argvals_len = m_tot_argvallens + pae->m_nargs + 1;
 
-	if(pae->m_tags_storage_size < encoded_tags_len)
-	{
-		char *new_tags_storage = (char*)realloc(pae->m_tags_storage, encoded_tags_len);
-		if(new_tags_storage == NULL)
-		{
-			free(pae->m_tags_storage);
-			throw sinsp_exception("memory reallocation error in sinsp_tracerparser::init_partial_tracer.");
-		}
-		pae->m_tags_storage = new_tags_storage;
-		pae->m_tags_storage_size = encoded_tags_len;
-	}
+	pae->reserve_storage(encoded_tags_len, encoded_argnames_len, encoded_argvals_len);
 
+	pae->m_tags.clear();
+	pae->m_taglens.clear();
 	char* p = pae->m_tags_storage;
 	for(it = m_tags.begin(), sit = m_taglens.begin(); 
 	it != m_tags.end(); ++it, ++sit)
@@ -1252,26 +1254,8 @@ inline void sinsp_tracerparser::init_partial_tracer(sinsp_partial_tracer* pae)
 	*p++ = 0;
 	pae->m_tags_len = (uint32_t)(p - pae->m_tags_storage);
 
-	//
-	// Pack the argnames
-	//
 	pae->m_argnames.clear();
 	pae->m_argnamelens.clear();
-	pae->m_nargs = (uint32_t)m_argnames.size();
-	uint32_t encoded_argnames_len = m_tot_argnamelens + pae->m_nargs + 1;
-
-	if(pae->m_argnames_storage_size < encoded_argnames_len)
-	{
-		char *new_argnames_storage = (char*)realloc(pae->m_argnames_storage, encoded_argnames_len);
-		if(new_argnames_storage == NULL)
-		{
-			free(pae->m_argnames_storage);
-			throw sinsp_exception("memory reallocation error in sinsp_tracerparser::init_partial_tracer.");
-		}
-		pae->m_argnames_storage = new_argnames_storage;
-		pae->m_argnames_storage_size = encoded_argnames_len;
-	}
-
 	p = pae->m_argnames_storage;
 	for(it = m_argnames.begin(), sit = m_argnamelens.begin(); 
 	it != m_argnames.end(); ++it, ++sit)
@@ -1285,25 +1269,8 @@ inline void sinsp_tracerparser::init_partial_tracer(sinsp_partial_tracer* pae)
 	*p++ = 0;
 	pae->m_argnames_len = (uint32_t)(p - pae->m_argnames_storage);
 
-	//
-	// Pack the argvals
-	//
 	pae->m_argvals.clear();
 	pae->m_argvallens.clear();
-	uint32_t encoded_argvals_len = m_tot_argvallens + pae->m_nargs + 1;
-
-	if(pae->m_argvals_storage_size < encoded_argvals_len)
-	{
-		char *new_argvals_storage = (char*)realloc(pae->m_argvals_storage, encoded_argvals_len);
-		if(new_argvals_storage == NULL)
-		{
-			free(pae->m_argvals_storage);
-			throw sinsp_exception("memory reallocation error in sinsp_tracerparser::init_partial_tracer.");
-		}
-		pae->m_argvals_storage = new_argvals_storage;
-		pae->m_argvals_storage_size = encoded_argvals_len;
-	}
-
 	p = pae->m_argvals_storage;
 	for(it = m_argvals.begin(), sit = m_argvallens.begin(); 
 	it != m_argvals.end(); ++it, ++sit)
@@ -23,32 +23,55 @@ limitations under the License.
 class sinsp_partial_tracer
 {
 public:
-	sinsp_partial_tracer()
+	//
+	// The storage is allocated by the first init_partial_tracer(), since
+	// most of the preallocated tracers (see sinsp::m_partial_tracers_pool)
+	// and of the exit tracers of the parsers are never used
+	//
+	sinsp_partial_tracer():
+		m_tags_storage(NULL),
+		m_argnames_storage(NULL),
+		m_argvals_storage(NULL),
+		m_storage(NULL),
+		m_storage_size(0)
 	{
-		m_tags_storage = (char*)malloc(UESTORAGE_INITIAL_BUFSIZE);
-		m_argnames_storage = (char*)malloc(UESTORAGE_INITIAL_BUFSIZE);
-		m_argvals_storage = (char*)malloc(UESTORAGE_INITIAL_BUFSIZE);
-		m_tags_storage_size = UESTORAGE_INITIAL_BUFSIZE;
-		m_argnames_storage_size = UESTORAGE_INITIAL_BUFSIZE;
-		m_argvals_storage_size = UESTORAGE_INITIAL_BUFSIZE;
 	}
 
 	~sinsp_partial_tracer()
 	{
-		if(m_tags_storage)
-		{
-			free(m_tags_storage);
-		}
+		free(m_storage);
+	}
 
-		if(m_argnames_storage)
-		{
-			free(m_argnames_storage); 
-		}
+	sinsp_partial_tracer(const sinsp_partial_tracer&) = delete;
+	sinsp_partial_tracer& operator=(const sinsp_partial_tracer&) = delete;
 
-		if(m_argvals_storage)
+	//
+	// Make room for the packed tags, argnames and argvals, which share a
+	// single buffer
+	//
+	inline void reserve_storage(uint32_t tags_len, uint32_t argnames_len, uint32_t argvals_len)
+	{
+		uint32_t len = tags_len + argnames_len + argvals_len;
+		if(m_storage_size < len)
 		{
-			free(m_argvals_storage); 
+			uint32_t size = m_storage_size == 0 ? UESTORAGE_INITIAL_BUFSIZE : m_storage_size;
+			while(size < len)
+			{
+				size *= 2;
+			}
+
+			char* storage = (char*)realloc(m_storage, size);
+			if(storage == NULL)
+			{
+				throw sinsp_exception("memory reallocation error in sinsp_partial_tracer::reserve_storage.");
+			}
+			m_storage = storage;
+			m_storage_size = size;
 		}
+
+		m_tags_storage = m_storage;
+		m_argnames_storage = m_tags_storage + tags_len;
+		m_argvals_storage = m_argnames_storage + argnames_len;
 	}
 
 	inline bool compare(sinsp_partial_tracer* other)
@@ -95,15 +118,15 @@ public:
 		return false;
 	}
 
+	// Parts of m_storage, see reserve_storage()
 	char* m_tags_storage;
 	char* m_argnames_storage;
 	char* m_argvals_storage;
 	uint32_t m_tags_len;
 	uint32_t m_argnames_len;
 	uint32_t m_argvals_len;
-	uint32_t m_tags_storage_size;
-	uint32_t m_argnames_storage_size;
-	uint32_t m_argvals_storage_size;
+	char* m_storage;
+	uint32_t m_storage_size;
 	uint64_t m_id;
 	std::vector<char*> m_tags;
 	std::vector<char*> m_argnames;
@@ -139,6 +162,9 @@ public:
 		return m_storage_size;
 	}
 	void set_storage_size(uint32_t newsize);
+	// Forget the fragments of the previous thread, keeping the storage,
+	// see sinsp_threadinfo::recycle()
+	void reset();
 	parse_result process_event_data(char *data, uint32_t datalen, uint64_t ts);
 	inline void parse_json(char* evtstr);
 	inline void parse_simple(char* evtstr);
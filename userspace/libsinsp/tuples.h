@@ -73,6 +73,16 @@ private:
 public:
 	ipv6net(const std::string &str);
 	bool in_cidr(const ipv6addr &other) const;
+
+	inline const ipv6addr& addr() const
+	{
+		return m_addr;
+	}
+
+	inline uint32_t prefix_len() const
+	{
+		return m_mask_len_bytes * 8 + (8 - m_mask_tail_bits);
+	}
 };
 
 /*!
@@ -22,6 +22,12 @@ limitations under the License.
 #include "logger.h"
 #include "sinsp.h"
 #include "strlcpy.h"
+#include "thread_placement.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <unordered_set>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 #ifdef HAVE_PWD_H
@@ -43,6 +49,10 @@ limitations under the License.
 
 #endif
 
+// Accounted memory of an entry of the user and group tables
+static const uint64_t USER_ENTRY_BYTES = sizeof(scap_userinfo) + sinsp_table_memory::HASH_NODE_BYTES;
+static const uint64_t GROUP_ENTRY_BYTES = sizeof(scap_groupinfo) + sinsp_table_memory::HASH_NODE_BYTES;
+
 #ifdef HAVE_PWD_H
 static struct passwd *__getpwuid(uint32_t uid, const std::string &host_root)
 {
@@ -113,6 +123,76 @@ static struct group *__getgrgid(uint32_t gid, const std::string &host_root)
 }
 #endif
 
+#if (defined HAVE_PWD_H || defined HAVE_GRP_H) && defined HAVE_FGET__ENT
+//
+// Minimum time between two checks for changes of the passwd and group
+// files of a container
+//
+#define CONTAINER_FILES_CHECK_INTERVAL_NS (2 * ONE_SECOND_IN_NS)
+
+//
+// Maximum number of threads reading the files of the containers found
+// by the initial proc scan
+//
+#define PROC_SCAN_FILES_MAX_WORKERS 8
+
+static uint64_t file_mtime_ns(const std::string &path)
+{
+	struct stat st;
+	if(stat(path.c_str(), &st) != 0)
+	{
+		return 0;
+	}
+	return st.st_mtim.tv_sec * ONE_SECOND_IN_NS + st.st_mtim.tv_nsec;
+}
+
+//
+// The files are parsed by hand rather than with fgetpwent() and
+// fgetgrent(), which aren't reentrant, since they are also read by the
+// background checker
+//
+// name:password:uid:gid:gecos:home:shell
+static void read_passwd(const std::string &path, std::vector<scap_userinfo> &users)
+{
+	std::ifstream f(path);
+	std::string line;
+	while(std::getline(f, line))
+	{
+		std::vector<std::string> fields = sinsp_split(line, ':');
+		scap_userinfo user;
+		if(fields.size() < 6 || fields[0].empty() ||
+		   !sinsp_numparser::tryparseu32(fields[2], &user.uid) ||
+		   !sinsp_numparser::tryparseu32(fields[3], &user.gid))
+		{
+			continue;
+		}
+		strlcpy(user.name, fields[0].c_str(), MAX_CREDENTIALS_STR_LEN);
+		strlcpy(user.homedir, fields[5].c_str(), SCAP_MAX_PATH_SIZE);
+		strlcpy(user.shell, fields.size() > 6 ? fields[6].c_str() : "", SCAP_MAX_PATH_SIZE);
+		users.push_back(user);
+	}
+}
+
+// name:password:gid:members
+static void read_group(const std::string &path, std::vector<scap_groupinfo> &groups)
+{
+	std::ifstream f(path);
+	std::string line;
+	while(std::getline(f, line))
+	{
+		std::vector<std::string> fields = sinsp_split(line, ':');
+		scap_groupinfo group;
+		if(fields.size() < 3 || fields[0].empty() ||
+		   !sinsp_numparser::tryparseu32(fields[2], &group.gid))
+		{
+			continue;
+		}
+		strlcpy(group.name, fields[0].c_str(), MAX_CREDENTIALS_STR_LEN);
+		groups.push_back(group);
+	}
+}
+#endif
+
 using namespace std;
 
 // clang-format off
@@ -126,6 +206,8 @@ sinsp_usergroup_manager::sinsp_usergroup_manager(sinsp* inspector)
 #else
 	, m_ns_helper(nullptr)
 #endif
+	, m_proc_scan(false)
+	, m_files_stop(false)
 {
 	strlcpy(m_fallback_user.name, "<NA>", sizeof(m_fallback_user.name));
 	strlcpy(m_fallback_user.homedir, "<NA>", sizeof(m_fallback_user.homedir));
@@ -135,6 +217,7 @@ sinsp_usergroup_manager::sinsp_usergroup_manager(sinsp* inspector)
 
 sinsp_usergroup_manager::~sinsp_usergroup_manager()
 {
+	stop_files_checker();
 #if defined(HAVE_PWD_H) || defined(HAVE_GRP_H)
 	delete m_ns_helper;
 #endif
@@ -159,9 +242,9 @@ void sinsp_usergroup_manager::dump_users_groups(sinsp_dumper& dumper) {
 		std::string container_id = it.first;
 		auto usrlist = m_userlist[container_id];
 		for (const auto &user: usrlist) {
-			sinsp_evt evt;
-			if (user_to_sinsp_event(&user.second, &evt, container_id, PPME_USER_ADDED_E)) {
-				dumper.dump(&evt);
+			auto evt = user_to_sinsp_event(&user.second, container_id, PPME_USER_ADDED_E);
+			if (evt != nullptr) {
+				dumper.dump(evt.get());
 			}
 		}
 	}
@@ -170,9 +253,9 @@ void sinsp_usergroup_manager::dump_users_groups(sinsp_dumper& dumper) {
 		std::string container_id = it.first;
 		auto grplist = m_grouplist[container_id];
 		for (const auto &group: grplist) {
-			sinsp_evt evt;
-			if (group_to_sinsp_event(&group.second, &evt, container_id, PPME_GROUP_ADDED_E)) {
-				dumper.dump(&evt);
+			auto evt = group_to_sinsp_event(&group.second, container_id, PPME_GROUP_ADDED_E);
+			if (evt != nullptr) {
+				dumper.dump(evt.get());
 			}
 		}
 	}
@@ -202,8 +285,17 @@ void sinsp_usergroup_manager::delete_container_users_groups(const sinsp_containe
 		}
 	}
 
+	if (usrlist)
+	{
+		m_memory.remove(usrlist->size() * USER_ENTRY_BYTES, usrlist->size());
+	}
+	if (grplist)
+	{
+		m_memory.remove(grplist->size() * GROUP_ENTRY_BYTES, grplist->size());
+	}
 	m_userlist.erase(cinfo.m_id);
 	m_grouplist.erase(cinfo.m_id);
+	m_container_files.erase(cinfo.m_id);
 }
 
 bool sinsp_usergroup_manager::clear_host_users_groups()
@@ -229,8 +321,12 @@ bool sinsp_usergroup_manager::clear_host_users_groups()
 
 		// Clear everything, so that new threadinfos incoming will update
 		// user and group informations
-		m_userlist[""].clear();
-		m_grouplist[""].clear();
+		auto &usrlist = m_userlist[""];
+		auto &grplist = m_grouplist[""];
+		m_memory.remove(usrlist.size() * USER_ENTRY_BYTES, usrlist.size());
+		m_memory.remove(grplist.size() * GROUP_ENTRY_BYTES, grplist.size());
+		usrlist.clear();
+		grplist.clear();
 	}
 	return res;
 }
@@ -247,6 +343,16 @@ scap_userinfo *sinsp_usergroup_manager::userinfo_map_insert(
 	ASSERT(home);
 	ASSERT(shell);
 
+	if(map.find(uid) == map.end())
+	{
+		if(m_memory.over_budget())
+		{
+			m_memory.add_budget_drop();
+			return nullptr;
+		}
+		m_memory.add(USER_ENTRY_BYTES);
+	}
+
 	auto &usr = map[uid];
 	usr.uid = uid;
 	usr.gid = gid;
@@ -266,6 +372,16 @@ scap_groupinfo *sinsp_usergroup_manager::groupinfo_map_insert(
 {
 	ASSERT(name);
 
+	if(map.find(gid) == map.end())
+	{
+		if(m_memory.over_budget())
+		{
+			m_memory.add_budget_drop();
+			return nullptr;
+		}
+		m_memory.add(GROUP_ENTRY_BYTES);
+	}
+
 	auto &grp = map[gid];
 	grp.gid = gid;
 	strlcpy(grp.name, (name != nullptr) ? name : "<NA>", MAX_CREDENTIALS_STR_LEN);
@@ -302,6 +418,16 @@ scap_userinfo *sinsp_usergroup_manager::add_user(const string &container_id, int
 	return add_container_user(container_id, pid, uid, notify);
 }
 
+scap_userinfo *sinsp_usergroup_manager::restore_user(const string &container_id, uint32_t uid, uint32_t gid, const char *name, const char *home, const char *shell)
+{
+	if (!m_import_users)
+	{
+		return nullptr;
+	}
+
+	return userinfo_map_insert(m_userlist[container_id], uid, gid, name, home, shell);
+}
+
 scap_userinfo *sinsp_usergroup_manager::add_host_user(uint32_t uid, uint32_t gid, const char *name, const char *home, const char *shell, bool notify)
 {
 	g_logger.format(sinsp_logger::SEV_DEBUG,
@@ -351,39 +477,8 @@ scap_userinfo *sinsp_usergroup_manager::add_container_user(const std::string &co
 	scap_userinfo *retval{nullptr};
 
 #if defined HAVE_PWD_H && defined HAVE_FGET__ENT
-	if(!m_ns_helper->in_own_ns_mnt(pid))
-	{
-		return retval;
-	}
-
-	std::string path = m_ns_helper->get_pid_root(pid) + "/etc/passwd";
-	auto pwd_file = fopen(path.c_str(), "r");
-	if(pwd_file)
-	{
-		auto &userlist = m_userlist[container_id];
-		while(auto p = fgetpwent(pwd_file))
-		{
-			// Here we cache all container users
-			auto *usr = userinfo_map_insert(
-				userlist,
-				p->pw_uid,
-				p->pw_gid,
-				p->pw_name,
-				p->pw_dir,
-				p->pw_shell);
-
-			if(notify)
-			{
-				notify_user_changed(usr, container_id);
-			}
-
-			if(uid == p->pw_uid)
-			{
-				retval = usr;
-			}
-		}
-		fclose(pwd_file);
-	}
+	lookup_container_files(container_id, pid, notify);
+	retval = get_user(container_id, uid);
 #endif
 
 	return retval;
@@ -403,6 +498,7 @@ bool sinsp_usergroup_manager::rm_user(const string &container_id, uint32_t uid,
 			notify_user_changed(usr, container_id, false);
 		}
 		m_userlist[container_id].erase(uid);
+		m_memory.remove(USER_ENTRY_BYTES);
 		res = true;
 	}
 	return res;
@@ -434,6 +530,16 @@ scap_groupinfo *sinsp_usergroup_manager::add_group(const string &container_id, i
 	return add_container_group(container_id, pid, gid, notify);
 }
 
+scap_groupinfo *sinsp_usergroup_manager::restore_group(const string &container_id, uint32_t gid, const char *name)
+{
+	if (!m_import_users)
+	{
+		return nullptr;
+	}
+
+	return groupinfo_map_insert(m_grouplist[container_id], gid, name);
+}
+
 scap_groupinfo *sinsp_usergroup_manager::add_host_group(uint32_t gid, const char *name, bool notify)
 {
 	g_logger.format(sinsp_logger::SEV_DEBUG,
@@ -471,36 +577,282 @@ scap_groupinfo *sinsp_usergroup_manager::add_container_group(const std::string &
 	scap_groupinfo *retval{nullptr};
 
 #if defined HAVE_GRP_H && defined HAVE_FGET__ENT
+	lookup_container_files(container_id, pid, notify);
+	retval = get_group(container_id, gid);
+#endif
+
+	return retval;
+}
+
+void sinsp_usergroup_manager::lookup_container_files(const std::string &container_id, int64_t pid, bool notify)
+{
+#if (defined HAVE_PWD_H || defined HAVE_GRP_H) && defined HAVE_FGET__ENT
+	apply_files_updates(notify);
+
+	auto it = m_container_files.find(container_id);
+	if(it != m_container_files.end())
+	{
+		//
+		// Already parsed, the tables are up to date unless the files
+		// changed, which is checked in the background
+		//
+		container_files &files = it->second;
+		uint64_t now = sinsp_utils::get_current_time_ns();
+		if(!files.m_check_pending &&
+		   now - files.m_last_check_ns > CONTAINER_FILES_CHECK_INTERVAL_NS &&
+		   m_ns_helper->in_own_ns_mnt(pid))
+		{
+			files.m_check_pending = true;
+			files.m_last_check_ns = now;
+
+			std::lock_guard<std::mutex> lock(m_files_mutex);
+			if(!m_files_thread.joinable())
+			{
+				m_files_thread = std::thread(&sinsp_usergroup_manager::run_files_checker, this);
+			}
+			m_files_requests.push_back({container_id,
+						    m_ns_helper->get_pid_root(pid),
+						    files.m_passwd_mtime_ns,
+						    files.m_group_mtime_ns});
+			m_files_cond.notify_one();
+		}
+		return;
+	}
+
 	if(!m_ns_helper->in_own_ns_mnt(pid))
 	{
-		return retval;
+		return;
 	}
 
-	std::string path = m_ns_helper->get_pid_root(pid) + "/etc/group";
-	auto group_file = fopen(path.c_str(), "r");
-	if(group_file)
+	if(m_proc_scan)
 	{
-		auto &grouplist = m_grouplist[container_id];
-		while(auto g = fgetgrent(group_file))
+		// Read with the other containers at the end of the scan
+		if(m_proc_scan_requests.find(container_id) == m_proc_scan_requests.end())
 		{
-			// Here we cache all container groups
-			auto *gr = groupinfo_map_insert(grouplist, g->gr_gid, g->gr_name);
+			m_proc_scan_requests[container_id] = {container_id, m_ns_helper->get_pid_root(pid), 0, 0};
+		}
+		return;
+	}
+
+	// First time for this container, it must be read right away
+	files_update update;
+	read_container_files({container_id, m_ns_helper->get_pid_root(pid), 0, 0}, update);
+	m_container_files[container_id].m_last_check_ns = sinsp_utils::get_current_time_ns();
+	apply_files_update(update, notify);
+#endif
+}
+
+void sinsp_usergroup_manager::read_container_files(const files_request &req, files_update &update)
+{
+	update.m_container_id = req.m_container_id;
+	update.m_passwd_changed = false;
+	update.m_group_changed = false;
+
+#if (defined HAVE_PWD_H || defined HAVE_GRP_H) && defined HAVE_FGET__ENT
+	std::string path = req.m_root + "/etc/passwd";
+	update.m_passwd_mtime_ns = file_mtime_ns(path);
+	if(update.m_passwd_mtime_ns != req.m_passwd_mtime_ns)
+	{
+		update.m_passwd_changed = true;
+		read_passwd(path, update.m_users);
+	}
+
+	path = req.m_root + "/etc/group";
+	update.m_group_mtime_ns = file_mtime_ns(path);
+	if(update.m_group_mtime_ns != req.m_group_mtime_ns)
+	{
+		update.m_group_changed = true;
+		read_group(path, update.m_groups);
+	}
+#endif
+}
+
+void sinsp_usergroup_manager::apply_files_update(files_update &update, bool notify)
+{
+	auto it = m_container_files.find(update.m_container_id);
+	if(it == m_container_files.end())
+	{
+		// The container went away in the meantime
+		return;
+	}
+
+	container_files &files = it->second;
+	files.m_check_pending = false;
 
-			if(notify)
+	if(update.m_passwd_changed)
+	{
+		files.m_passwd_mtime_ns = update.m_passwd_mtime_ns;
+		for(const auto &u : update.m_users)
+		{
+			// Here we cache all container users
+			auto *usr = userinfo_map_insert(
+				m_userlist[update.m_container_id],
+				u.uid,
+				u.gid,
+				u.name,
+				u.homedir,
+				u.shell);
+
+			if(usr != nullptr && notify)
 			{
-				notify_group_changed(gr, container_id, true);
+				notify_user_changed(usr, update.m_container_id);
 			}
+		}
+	}
+
+	if(update.m_group_changed)
+	{
+		files.m_group_mtime_ns = update.m_group_mtime_ns;
+		for(const auto &g : update.m_groups)
+		{
+			// Here we cache all container groups
+			auto *gr = groupinfo_map_insert(m_grouplist[update.m_container_id], g.gid, g.name);
 
-			if(gid == g->gr_gid)
+			if(gr != nullptr && notify)
 			{
-				retval = gr;
+				notify_group_changed(gr, update.m_container_id, true);
 			}
 		}
-		fclose(group_file);
 	}
-#endif
+}
 
-	return retval;
+void sinsp_usergroup_manager::apply_files_updates(bool notify)
+{
+	std::vector<files_update> updates;
+	{
+		std::lock_guard<std::mutex> lock(m_files_mutex);
+		if(m_files_updates.empty())
+		{
+			return;
+		}
+		updates.swap(m_files_updates);
+	}
+
+	for(auto &update : updates)
+	{
+		apply_files_update(update, notify);
+	}
+}
+
+void sinsp_usergroup_manager::run_files_checker()
+{
+	libsinsp::thread_placement::apply(libsinsp::thread_placement::thread_class::AUXILIARY);
+
+	std::unique_lock<std::mutex> lock(m_files_mutex);
+	while(true)
+	{
+		m_files_cond.wait(lock, [this]() { return m_files_stop || !m_files_requests.empty(); });
+		if(m_files_stop)
+		{
+			break;
+		}
+
+		files_request req = std::move(m_files_requests.front());
+		m_files_requests.pop_front();
+		lock.unlock();
+
+		files_update update;
+		read_container_files(req, update);
+
+		lock.lock();
+		m_files_updates.push_back(std::move(update));
+	}
+}
+
+void sinsp_usergroup_manager::stop_files_checker()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_files_mutex);
+		m_files_stop = true;
+		m_files_cond.notify_all();
+	}
+
+	if(m_files_thread.joinable())
+	{
+		m_files_thread.join();
+	}
+}
+
+void sinsp_usergroup_manager::begin_proc_scan()
+{
+	m_proc_scan = true;
+	m_proc_scan_requests.clear();
+}
+
+void sinsp_usergroup_manager::end_proc_scan()
+{
+	if(!m_proc_scan)
+	{
+		return;
+	}
+	m_proc_scan = false;
+
+#if (defined HAVE_PWD_H || defined HAVE_GRP_H) && defined HAVE_FGET__ENT
+	if(m_proc_scan_requests.empty())
+	{
+		return;
+	}
+
+	uint64_t start_ns = sinsp_utils::get_current_time_ns();
+	std::vector<files_request> requests;
+	requests.reserve(m_proc_scan_requests.size());
+	for(auto &it : m_proc_scan_requests)
+	{
+		requests.push_back(std::move(it.second));
+	}
+	m_proc_scan_requests.clear();
+
+	std::vector<files_update> updates(requests.size());
+	std::atomic<size_t> next(0);
+	auto read_files = [&]()
+	{
+		size_t j;
+		while((j = next.fetch_add(1)) < requests.size())
+		{
+			read_container_files(requests[j], updates[j]);
+		}
+	};
+
+	// The capture thread reads files too
+	size_t n_workers = std::min({requests.size(),
+				     (size_t)std::max(std::thread::hardware_concurrency(), 1u),
+				     (size_t)PROC_SCAN_FILES_MAX_WORKERS});
+	std::vector<std::thread> workers;
+	for(size_t j = 1; j < n_workers; j++)
+	{
+		workers.emplace_back(read_files);
+	}
+	read_files();
+	for(auto &worker : workers)
+	{
+		worker.join();
+	}
+
+	std::unordered_set<std::string> containers;
+	uint64_t now = sinsp_utils::get_current_time_ns();
+	for(auto &update : updates)
+	{
+		m_container_files[update.m_container_id].m_last_check_ns = now;
+		apply_files_update(update, m_inspector->is_live());
+		containers.insert(update.m_container_id);
+	}
+
+	// The threads of these containers were imported without their users
+	// and groups
+	m_inspector->m_thread_manager->get_threads()->loop([&](sinsp_threadinfo &tinfo) {
+		if(containers.find(tinfo.m_container_id) != containers.end())
+		{
+			tinfo.set_group(tinfo.get_group()->gid);
+			tinfo.set_user(tinfo.get_user()->uid);
+			tinfo.set_loginuser(tinfo.get_loginuser()->uid);
+		}
+		return true;
+	});
+
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"read the users and groups of %zu containers with %zu threads in %" PRIu64 " ms",
+			containers.size(), n_workers, (sinsp_utils::get_current_time_ns() - start_ns) / 1000000);
+#endif
 }
 
 bool sinsp_usergroup_manager::rm_group(const string &container_id, uint32_t gid, bool notify)
@@ -517,6 +869,7 @@ bool sinsp_usergroup_manager::rm_group(const string &container_id, uint32_t gid,
 			notify_group_changed(gr, container_id, false);
 		}
 		m_grouplist[container_id].erase(gid);
+		m_memory.remove(GROUP_ENTRY_BYTES);
 		res = true;
 	}
 	return res;
@@ -572,117 +925,47 @@ scap_groupinfo* sinsp_usergroup_manager::get_group(const std::string &container_
 	return &it->second;
 }
 
-bool sinsp_usergroup_manager::user_to_sinsp_event(const scap_userinfo *user, sinsp_evt* evt, const string &container_id, uint16_t ev_type)
+uint64_t sinsp_usergroup_manager::get_event_ts() const
 {
-	// 6 lens, uid, gid, name, home, shell, container_id
-	size_t totlen = sizeof(scap_evt) + 6 * sizeof(uint16_t) +
-			sizeof(uint32_t) + sizeof(uint32_t) +
-			strlen(user->name) + 1 +
-			strlen(user->homedir) + 1 +
-			strlen(user->shell) + 1 +
-			container_id.length() + 1;
-
-	ASSERT(evt->m_pevt_storage == nullptr);
-	evt->m_pevt_storage = new char[totlen];
-	evt->m_pevt = (scap_evt *) evt->m_pevt_storage;
-
-	evt->m_cpuid = 0;
-	evt->m_evtnum = 0;
-	evt->m_inspector = m_inspector;
-
-	scap_evt* scapevt = evt->m_pevt;
-
 	if(m_inspector->m_lastevent_ts == 0)
 	{
 		// This can happen at startup when containers are
 		// being created as a part of the initial process
 		// scan.
-		scapevt->ts = sinsp_utils::get_current_time_ns();
+		return sinsp_utils::get_current_time_ns();
 	}
-	else
-	{
-		scapevt->ts = m_inspector->m_lastevent_ts;
-	}
-	scapevt->tid = -1;
-	scapevt->len = (uint32_t)totlen;
-	scapevt->type = ev_type;
-	scapevt->nparams = 6;
-
-	auto* lens = (uint16_t*)((char *)scapevt + sizeof(struct ppm_evt_hdr));
-	char* valptr = (char*)lens + scapevt->nparams * sizeof(uint16_t);
-
-	lens[0] = sizeof(uint32_t);
-	lens[1] = sizeof(uint32_t);
-	lens[2] = strlen(user->name) + 1;
-	lens[3] = strlen(user->homedir) + 1;
-	lens[4] = strlen(user->shell) + 1;
-	lens[5] = container_id.length() + 1;
-
-	memcpy(valptr, &user->uid, lens[0]);
-	valptr += lens[0];
-	memcpy(valptr, &user->gid, lens[1]);
-	valptr += lens[1];
-	memcpy(valptr, user->name, lens[2]);
-	valptr += lens[2];
-	memcpy(valptr, user->homedir, lens[3]);
-	valptr += lens[3];
-	memcpy(valptr, user->shell, lens[4]);
-	valptr += lens[4];
-	memcpy(valptr, container_id.c_str(), lens[5]);
-
-	evt->init();
-	return true;
-}
-
-bool sinsp_usergroup_manager::group_to_sinsp_event(const scap_groupinfo *group, sinsp_evt* evt, const string &container_id, uint16_t ev_type)
-{
-	// gid, name, container_id
-	size_t totlen = sizeof(scap_evt) + 3 * sizeof(uint16_t) +
-			sizeof(uint32_t) +
-			strlen(group->name) + 1 +
-			container_id.length() + 1;
-
-	ASSERT(evt->m_pevt_storage == nullptr);
-	evt->m_pevt_storage = new char[totlen];
-	evt->m_pevt = (scap_evt *) evt->m_pevt_storage;
-
-	evt->m_cpuid = 0;
-	evt->m_evtnum = 0;
-	evt->m_inspector = m_inspector;
-
-	scap_evt* scapevt = evt->m_pevt;
+	return m_inspector->m_lastevent_ts;
+}
 
-	if(m_inspector->m_lastevent_ts == 0)
-	{
-		// This can happen at startup when containers are
-		// being created as a part of the initial process
-		// scan.
-		scapevt->ts = sinsp_utils::get_current_time_ns();
-	}
-	else
+std::shared_ptr<sinsp_evt> sinsp_usergroup_manager::user_to_sinsp_event(const scap_userinfo *user, const string &container_id, uint16_t ev_type)
+{
+	std::string error;
+	std::shared_ptr<sinsp_evt> evt = m_inspector->m_async_evt_pool.encode(error, (ppm_event_code)ev_type, get_event_ts(), -1,
+									      user->uid, user->gid, (const char*)user->name,
+									      (const char*)user->homedir, (const char*)user->shell, container_id);
+	if(evt == nullptr)
 	{
-		scapevt->ts = m_inspector->m_lastevent_ts;
+		g_logger.format(sinsp_logger::SEV_DEBUG, "Could not encode user event: %s", error.c_str());
+		return nullptr;
 	}
-	scapevt->tid = -1;
-	scapevt->len = (uint32_t)totlen;
-	scapevt->type = ev_type;
-	scapevt->nparams = 3;
 
-	auto* lens = (uint16_t*)((char *)scapevt + sizeof(struct ppm_evt_hdr));
-	char* valptr = (char*)lens + scapevt->nparams * sizeof(uint16_t);
-
-	lens[0] = sizeof(uint32_t);
-	lens[1] = strlen(group->name) + 1;
-	lens[2] = container_id.length() + 1;
+	evt->m_inspector = m_inspector;
+	return evt;
+}
 
-	memcpy(valptr, &group->gid, lens[0]);
-	valptr += lens[0];
-	memcpy(valptr, group->name, lens[1]);
-	valptr += lens[1];
-	memcpy(valptr, container_id.c_str(), lens[2]);
+std::shared_ptr<sinsp_evt> sinsp_usergroup_manager::group_to_sinsp_event(const scap_groupinfo *group, const string &container_id, uint16_t ev_type)
+{
+	std::string error;
+	std::shared_ptr<sinsp_evt> evt = m_inspector->m_async_evt_pool.encode(error, (ppm_event_code)ev_type, get_event_ts(), -1,
+									      group->gid, (const char*)group->name, container_id);
+	if(evt == nullptr)
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG, "Could not encode group event: %s", error.c_str());
+		return nullptr;
+	}
 
-	evt->init();
-	return true;
+	evt->m_inspector = m_inspector;
+	return evt;
 }
 
 void sinsp_usergroup_manager::notify_user_changed(const scap_userinfo *user, const string &container_id, bool added)
@@ -692,25 +975,18 @@ void sinsp_usergroup_manager::notify_user_changed(const scap_userinfo *user, con
 		return;
 	}
 
-	auto *evt = new sinsp_evt();
-
-	if (added)
-	{
-		user_to_sinsp_event(user, evt, container_id, PPME_USER_ADDED_E);
-	}
-	else
+	std::shared_ptr<sinsp_evt> cevt = user_to_sinsp_event(user, container_id, added ? PPME_USER_ADDED_E : PPME_USER_DELETED_E);
+	if(cevt == nullptr)
 	{
-		user_to_sinsp_event(user, evt, container_id, PPME_USER_DELETED_E);
+		return;
 	}
 
 	g_logger.format(sinsp_logger::SEV_DEBUG,
 			"notify_user_changed (%d): USER event, queuing to inspector",
 			user->uid);
 
-	std::shared_ptr<sinsp_evt> cevt(evt);
-
 #ifndef _WIN32
-	m_inspector->m_pending_state_evts.push(cevt);
+	m_inspector->m_pending_state_evts.push(std::move(cevt));
 #endif
 }
 
@@ -721,23 +997,17 @@ void sinsp_usergroup_manager::notify_group_changed(const scap_groupinfo *group,
 		return;
 	}
 
-	auto *evt = new sinsp_evt();
-	if (added)
+	std::shared_ptr<sinsp_evt> cevt = group_to_sinsp_event(group, container_id, added ? PPME_GROUP_ADDED_E : PPME_GROUP_DELETED_E);
+	if(cevt == nullptr)
 	{
-		group_to_sinsp_event(group, evt, container_id, PPME_GROUP_ADDED_E);
-	}
-	else
-	{
-		group_to_sinsp_event(group, evt, container_id, PPME_GROUP_DELETED_E);
+		return;
 	}
 
 	g_logger.format(sinsp_logger::SEV_DEBUG,
 			"notify_group_changed (%d): GROUP event, queuing to inspector",
 			group->gid);
 
-	std::shared_ptr<sinsp_evt> cevt(evt);
-
 #ifndef _WIN32
-	m_inspector->m_pending_state_evts.push(cevt);
+	m_inspector->m_pending_state_evts.push(std::move(cevt));
 #endif
 }
@@ -18,10 +18,16 @@ limitations under the License.
 #ifndef FALCOSECURITY_LIBS_USER_H
 #define FALCOSECURITY_LIBS_USER_H
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <string>
+#include <vector>
 #include "container_info.h"
 #include "procfs_utils.h"
+#include "table_memory.h"
 #include "scap.h"
 
 class sinsp;
@@ -123,11 +129,30 @@ public:
 	scap_userinfo *add_user(const std::string &container_id, int64_t pid, uint32_t uid, uint32_t gid, const char *name, const char *home, const char *shell, bool notify = false);
 	scap_groupinfo *add_group(const std::string &container_id, int64_t pid, uint32_t gid, const char *name, bool notify = false);
 
+	// Add a container user or group as it was saved earlier, without
+	// reading it from the container filesystem (see sinsp_container_manager::load_snapshot)
+	scap_userinfo *restore_user(const std::string &container_id, uint32_t uid, uint32_t gid, const char *name, const char *home, const char *shell);
+	scap_groupinfo *restore_group(const std::string &container_id, uint32_t gid, const char *name);
+
 	bool rm_user(const std::string &container_id, uint32_t uid, bool notify = false);
 	bool rm_group(const std::string &container_id, uint32_t gid, bool notify = false);
 
 	bool clear_host_users_groups();
 
+	// During the initial proc scan, the passwd and group files of the
+	// containers aren't read as their threads are imported: the
+	// containers are only collected. end_proc_scan() then reads the
+	// files of all of them at once on a few worker threads, fills the
+	// tables and sets the users and groups of their threads.
+	void begin_proc_scan();
+	void end_proc_scan();
+
+	// Approximate memory used by the user and group tables
+	inline sinsp_table_memory& get_memory()
+	{
+		return m_memory;
+	}
+
 	//
 	// User and group tables
 	//
@@ -140,8 +165,9 @@ private:
 	scap_groupinfo *add_host_group(uint32_t gid, const char *name, bool notify);
 	scap_groupinfo *add_container_group(const std::string &container_id, int64_t pid, uint32_t gid, bool notify);
 
-	bool user_to_sinsp_event(const scap_userinfo *user, sinsp_evt* evt, const std::string &container_id, uint16_t ev_type);
-	bool group_to_sinsp_event(const scap_groupinfo *group, sinsp_evt* evt, const std::string &container_id, uint16_t ev_type);
+	uint64_t get_event_ts() const;
+	std::shared_ptr<sinsp_evt> user_to_sinsp_event(const scap_userinfo *user, const std::string &container_id, uint16_t ev_type);
+	std::shared_ptr<sinsp_evt> group_to_sinsp_event(const scap_groupinfo *group, const std::string &container_id, uint16_t ev_type);
 
 	void delete_container_users_groups(const sinsp_container_info &cinfo);
 
@@ -165,6 +191,7 @@ private:
 
 	std::unordered_map<std::string, userinfo_map> m_userlist;
 	std::unordered_map<std::string, groupinfo_map> m_grouplist;
+	sinsp_table_memory m_memory;
 	uint64_t m_last_flush_time_ns;
 	sinsp *m_inspector;
 
@@ -174,6 +201,64 @@ private:
 
 	const std::string &m_host_root;
 	libsinsp::procfs_utils::ns_helper *m_ns_helper;
+
+	//
+	// The /etc/passwd and /etc/group files of the containers are parsed
+	// once, then only checked again for changes in the background, so
+	// that an unknown uid or gid doesn't cost a read of both files.
+	// The results are added to the tables, and notified, by the
+	// capture thread.
+	//
+	struct container_files
+	{
+		// mtime of the files when they were parsed, 0 if missing
+		uint64_t m_passwd_mtime_ns = 0;
+		uint64_t m_group_mtime_ns = 0;
+		uint64_t m_last_check_ns = 0;
+		bool m_check_pending = false;
+	};
+
+	struct files_request
+	{
+		std::string m_container_id;
+		std::string m_root;
+		uint64_t m_passwd_mtime_ns;
+		uint64_t m_group_mtime_ns;
+	};
+
+	struct files_update
+	{
+		std::string m_container_id;
+		uint64_t m_passwd_mtime_ns;
+		uint64_t m_group_mtime_ns;
+		bool m_passwd_changed;
+		bool m_group_changed;
+		std::vector<scap_userinfo> m_users;
+		std::vector<scap_groupinfo> m_groups;
+	};
+
+	// Parses the files that changed since the request's mtimes
+	static void read_container_files(const files_request &req, files_update &update);
+	// Makes sure the files of the container have been parsed, and
+	// schedules a check for changes if the last one is old enough
+	void lookup_container_files(const std::string &container_id, int64_t pid, bool notify);
+	void apply_files_update(files_update &update, bool notify);
+	void apply_files_updates(bool notify);
+	void run_files_checker();
+	void stop_files_checker();
+
+	// Only used by the capture thread
+	std::unordered_map<std::string, container_files> m_container_files;
+	bool m_proc_scan;
+	std::unordered_map<std::string, files_request> m_proc_scan_requests;
+
+	// Shared with m_files_thread
+	std::thread m_files_thread;
+	std::mutex m_files_mutex;
+	std::condition_variable m_files_cond;
+	std::deque<files_request> m_files_requests;
+	std::vector<files_update> m_files_updates;
+	bool m_files_stop;
 };
 
 #endif // FALCOSECURITY_LIBS_USER_H
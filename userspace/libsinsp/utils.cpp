@@ -66,6 +66,7 @@ limitations under the License.
 //
 // These are the libsinsp globals
 //
+static sinsp_evt_param_layout s_param_layouts[PPM_EVENT_MAX];
 sinsp_evttables g_infotables;
 sinsp_logger g_logger;
 sinsp_initializer g_initializer;
@@ -81,6 +82,23 @@ sinsp_initializer::sinsp_initializer()
 	// Init the event tables
 	//
 	g_infotables.m_event_info = scap_get_event_info_table();
+	for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		const ppm_event_info& info = g_infotables.m_event_info[j];
+		sinsp_evt_param_layout& layout = s_param_layouts[j];
+		layout.m_nparams = info.nparams;
+		layout.m_lensize = (info.flags & EF_LARGE_PAYLOAD) ? sizeof(uint32_t) : sizeof(uint16_t);
+		layout.m_str_params = 0;
+		for(uint32_t k = 0; k < info.nparams; k++)
+		{
+			ppm_param_type type = info.params[k].type;
+			if(type == PT_CHARBUF || type == PT_FSRELPATH || type == PT_FSPATH)
+			{
+				layout.m_str_params |= 1U << k;
+			}
+		}
+	}
+	g_infotables.m_param_layouts = s_param_layouts;
 
 	//
 	// Init the logger
@@ -786,6 +804,113 @@ bool sinsp_utils::is_ipv4_mapped_ipv6(uint8_t* paddr)
 	}
 }
 
+static inline char* u8_to_chars(char* buf, uint8_t val)
+{
+	if(val >= 100)
+	{
+		*buf++ = '0' + val / 100;
+		val %= 100;
+		*buf++ = '0' + val / 10;
+	}
+	else if(val >= 10)
+	{
+		*buf++ = '0' + val / 10;
+	}
+	*buf++ = '0' + val % 10;
+	return buf;
+}
+
+char* sinsp_utils::ipv4_to_chars(char* buf, const uint8_t* addr)
+{
+	buf = u8_to_chars(buf, addr[0]);
+	for(uint32_t j = 1; j < 4; j++)
+	{
+		*buf++ = '.';
+		buf = u8_to_chars(buf, addr[j]);
+	}
+	return buf;
+}
+
+char* sinsp_utils::ipv6_to_chars(char* buf, const uint8_t* addr)
+{
+	static const char digits[] = "0123456789abcdef";
+	uint16_t words[8];
+	for(uint32_t j = 0; j < 8; j++)
+	{
+		words[j] = (addr[j * 2] << 8) | addr[j * 2 + 1];
+	}
+
+	//
+	// Find the first longest run of zero words, which is replaced by
+	// "::" if it's at least two words long
+	//
+	int32_t best_base = -1;
+	int32_t best_len = 0;
+	int32_t cur_base = -1;
+	for(int32_t j = 0; j <= 8; j++)
+	{
+		if(j < 8 && words[j] == 0)
+		{
+			if(cur_base == -1)
+			{
+				cur_base = j;
+			}
+			continue;
+		}
+
+		if(cur_base != -1 && j - cur_base > best_len)
+		{
+			best_base = cur_base;
+			best_len = j - cur_base;
+		}
+		cur_base = -1;
+	}
+	if(best_len < 2)
+	{
+		best_base = -1;
+	}
+
+	for(int32_t j = 0; j < 8; j++)
+	{
+		if(best_base != -1 && j >= best_base && j < best_base + best_len)
+		{
+			if(j == best_base)
+			{
+				*buf++ = ':';
+			}
+			continue;
+		}
+
+		if(j != 0)
+		{
+			*buf++ = ':';
+		}
+
+		// IPv4-compatible and IPv4-mapped addresses
+		if(j == 6 && best_base == 0 && (best_len == 6 || (best_len == 5 && words[5] == 0xffff)))
+		{
+			return ipv4_to_chars(buf, addr + 12);
+		}
+
+		bool leading = true;
+		for(int32_t shift = 12; shift >= 0; shift -= 4)
+		{
+			uint32_t d = (words[j] >> shift) & 0xf;
+			if(d != 0 || !leading || shift == 0)
+			{
+				*buf++ = digits[d];
+				leading = false;
+			}
+		}
+	}
+
+	if(best_base != -1 && best_base + best_len == 8)
+	{
+		*buf++ = ':';
+	}
+	return buf;
+}
+
 const struct ppm_param_info* sinsp_utils::find_longest_matching_evt_param(std::string name)
 {
 	uint32_t maxlen = 0;
@@ -979,73 +1104,109 @@ const char* sinsp_utils::event_name_by_id(uint16_t id)
 	return g_infotables.m_event_info[id].name;
 }
 
+// Writes the nanoseconds as ".NNNNNNNNN"
+static inline void nsec_to_chars(char* buf, uint32_t nsec)
+{
+	buf[0] = '.';
+	for(uint32_t j = 9; j > 0; j--)
+	{
+		buf[j] = '0' + nsec % 10;
+		nsec /= 10;
+	}
+}
+
+//
+// The events of the same second share everything but the nanoseconds, and
+// the timezone lookups are expensive, so the rest is formatted once per
+// second. There's one entry for the times with the date and one for the
+// ones without, as outputs often have both.
+//
+struct ts_string_cache
+{
+	uint64_t m_sec = UINT64_MAX;
+	uint32_t m_len = 0;
+	char m_buf[64];
+};
+
 void sinsp_utils::ts_to_string(uint64_t ts, OUT std::string* res, bool date, bool ns)
 {
-	struct tm *tm;
-	time_t Time;
+	static thread_local ts_string_cache s_cache[2];
+	ts_string_cache& cache = s_cache[date ? 1 : 0];
 	uint64_t sec = ts / ONE_SECOND_IN_NS;
 	uint64_t nsec = ts % ONE_SECOND_IN_NS;
-	int32_t thiszone = gmt2local(0);
-	int32_t s = (sec + thiszone) % 86400;
-	int32_t bufsize = 0;
-	char buf[256];
 
-	if(date)
+	if(sec != cache.m_sec)
 	{
-		Time = (sec + thiszone) - s;
-		tm = gmtime (&Time);
-		if(!tm)
-		{
-			bufsize = sprintf(buf, "<date error> ");
-		}
-		else
+		struct tm *tm;
+		time_t Time;
+		int32_t thiszone = gmt2local(0);
+		int32_t s = (sec + thiszone) % 86400;
+		int32_t bufsize = 0;
+		char* buf = cache.m_buf;
+
+		if(date)
 		{
-			bufsize = sprintf(buf, "%04d-%02d-%02d ",
-				   tm->tm_year+1900, tm->tm_mon+1, tm->tm_mday);
+			Time = (sec + thiszone) - s;
+			tm = gmtime (&Time);
+			if(!tm)
+			{
+				bufsize = snprintf(buf, sizeof(cache.m_buf), "<date error> ");
+			}
+			else
+			{
+				bufsize = snprintf(buf, sizeof(cache.m_buf), "%04d-%02d-%02d ",
+					   tm->tm_year+1900, tm->tm_mon+1, tm->tm_mday);
+			}
 		}
+
+		bufsize += snprintf(buf + bufsize, sizeof(cache.m_buf) - bufsize, "%02d:%02d:%02d",
+				s / 3600, (s % 3600) / 60, s % 60);
+
+		cache.m_sec = sec;
+		cache.m_len = std::min(bufsize, (int32_t)sizeof(cache.m_buf) - 1);
 	}
 
+	res->assign(cache.m_buf, cache.m_len);
 	if(ns)
 	{
-		sprintf(buf + bufsize, "%02d:%02d:%02d.%09u",
-				s / 3600, (s % 3600) / 60, s % 60, (unsigned)nsec);
+		char nsbuf[10];
+		nsec_to_chars(nsbuf, (uint32_t)nsec);
+		res->append(nsbuf, sizeof(nsbuf));
 	}
-	else
-	{
-		sprintf(buf + bufsize, "%02d:%02d:%02d",
-				s / 3600, (s % 3600) / 60, s % 60);
-	}
-
-	*res = buf;
 }
 
 #define TS_STR_FMT "YYYY-MM-DDTHH:MM:SS-0000"
 void sinsp_utils::ts_to_iso_8601(uint64_t ts, OUT std::string* res)
 {
 	static const char *fmt = TS_STR_FMT;
-	char buf[sizeof(TS_STR_FMT)];
+
+	// the date, the time and the timezone of the last second
+	static thread_local time_t s_sec = -1;
+	static thread_local bool s_valid = false;
+	static thread_local char s_time[sizeof(TS_STR_FMT)];
+	static thread_local char s_zone[sizeof(TS_STR_FMT)];
+
 	uint64_t ns = ts % ONE_SECOND_IN_NS;
 	time_t sec = ts / ONE_SECOND_IN_NS;
 
-	if(strftime(buf, sizeof(buf), "%FT%T", gmtime(&sec)) == 0)
+	if(sec != s_sec)
 	{
-		*res = fmt;
-		return;
+		s_sec = sec;
+		s_valid = strftime(s_time, sizeof(s_time), "%FT%T", gmtime(&sec)) != 0
+			&& strftime(s_zone, sizeof(s_zone), "%z", gmtime(&sec)) != 0;
 	}
 
-	*res = buf;
-	if(sprintf(buf, ".%09u", (unsigned) ns) < 0)
+	if(!s_valid)
 	{
 		*res = fmt;
 		return;
 	}
-	*res += buf;
-	if(strftime(buf, sizeof(buf), "%z", gmtime(&sec)) == 0)
-	{
-		*res = fmt;
-		return;
-	}
-	*res += buf;
+
+	char nsbuf[10];
+	nsec_to_chars(nsbuf, (uint32_t)ns);
+	*res = s_time;
+	res->append(nsbuf, sizeof(nsbuf));
+	*res += s_zone;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -102,6 +102,14 @@ public:
 	//
 	static bool is_ipv4_mapped_ipv6(uint8_t* paddr);
 
+	//
+	// Write an address at buf in the same format as inet_ntop(), without
+	// the terminating NUL, and return the end of the string. buf must
+	// hold at least 15 chars for IPv4 and 45 chars for IPv6.
+	//
+	static char* ipv4_to_chars(char* buf, const uint8_t* addr);
+	static char* ipv6_to_chars(char* buf, const uint8_t* addr);
+
 	//
 	// Given a string, scan the event list and find the longest argument that the input string contains
 	//
@@ -164,12 +172,9 @@ struct g_invalidchar
 {
     bool operator()(char c) const
     {
-	    if(c < -1)
-	    {
-		    return true;
-	    }
-
-	    return !isprint((unsigned)c);
+	    // The printable characters of the C locale, without the
+	    // isprint() call for every character of every path
+	    return !(c >= 0x20 && c < 0x7f);
     }
 };
 
@@ -28,7 +28,7 @@ extern "C" {
 // API versions of this plugin framework
 //
 #define PLUGIN_API_VERSION_MAJOR 3
-#define PLUGIN_API_VERSION_MINOR 0
+#define PLUGIN_API_VERSION_MINOR 1
 #define PLUGIN_API_VERSION_PATCH 0
 
 //
@@ -606,6 +606,10 @@ typedef struct
 		//                display the field instead of the name. Used in tools
 		//                like wireshark.
 		//     "desc": a string with a description of the field
+		//     "properties": (optional) an array of strings. "async" notes
+		//                   that the framework can extract the field ahead
+		//                   of time on other threads, so extract_fields
+		//                   must tolerate concurrent calls for it.
 		// Example return value:
 		// [
 		//    {"type": "uint64", "name": "field1", "desc": "Describing field 1"},
@@ -695,6 +699,35 @@ typedef struct
 		// must not be shared across multiple distinct ss_plugin_t* values.
 		ss_plugin_rc (*parse_event)(ss_plugin_t *s, const ss_plugin_event_input *evt, const ss_plugin_event_parse_input* in);
 	};
+
+	// Field extraction capability API (since 3.1.0)
+	struct
+	{
+		//
+		// Extract one or more filter field values from a batch of events,
+		// crossing the plugin boundary once for all of them. The semantics
+		// are the same of extract_fields(), applied to each event.
+		// Required: no
+		// Arguments:
+		// - num_evts: the number of events in the batch.
+		// - evts: an array of num_evts event inputs provided by the framework.
+		// - input: An input struct representing the extraction request.
+		//   The in->fields array contains num_evts * in->num_fields entries,
+		//   and the fields to extract from evts[i] are the in->num_fields
+		//   entries starting at in->fields[i * in->num_fields].
+		//   A field that can't be extracted from an event must have its
+		//   res_len set to 0, without failing the whole batch.
+		//
+		// Return value: A ss_plugin_rc with values SS_PLUGIN_SUCCESS or SS_PLUGIN_FAILURE.
+		//
+		// This function is optional--if NULL, the framework extracts the
+		// fields with one extract_fields() call per event.
+		// The values extracted from all the events of the batch must not be
+		// deallocated or modified until the next extract_fields() or
+		// extract_fields_batch() call.
+		// The same concurrency rules of extract_fields() apply.
+		ss_plugin_rc (*extract_fields_batch)(ss_plugin_t *s, uint32_t num_evts, const ss_plugin_event_input *evts, const ss_plugin_field_extract_input* in);
+	};
 } plugin_api;
 
 #ifdef __cplusplus